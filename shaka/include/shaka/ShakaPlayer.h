@@ -330,6 +330,21 @@ SHAKA_EXPORT
  */
 - (NSArray<ShakaTrack *> *)getVariantTracks;
 
+/**
+ * The same as the getters above, but these don't block while waiting for the
+ * JavaScript thread.  The block is called on the main thread with either the
+ * value or the error that occurred.  If the track lists haven't changed, the
+ * same array object is returned as the last call.
+ */
+- (void)getStatsWithBlock:(void (^)(ShakaStats * _Nullable,
+                                    ShakaPlayerError * _Nullable))block;
+- (void)getBufferedInfoWithBlock:(void (^)(ShakaBufferedInfo * _Nullable,
+                                           ShakaPlayerError * _Nullable))block;
+- (void)getTextTracksWithBlock:(void (^)(NSArray<ShakaTrack *> * _Nullable,
+                                         ShakaPlayerError * _Nullable))block;
+- (void)getVariantTracksWithBlock:(void (^)(NSArray<ShakaTrack *> * _Nullable,
+                                            ShakaPlayerError * _Nullable))block;
+
 /**
  * Load the given manifest asynchronously.
  *
@@ -352,6 +367,14 @@ withStartTime:(double)startTime
 /** Unload the current manifest and make the Player available for re-use. */
 - (void)unloadWithBlock:(ShakaPlayerAsyncBlock)block;
 
+/**
+ * Starts loading the given native (src=) asset, such as an HLS playlist played
+ * by AVPlayer, in the background so it starts faster when it is loaded later.
+ *
+ * @param uri The uri of the asset to preload.
+ */
+- (void)preload:(NSString *)uri;
+
 
 /**
  * Applies a configuration.
@@ -366,6 +389,10 @@ withStartTime:(double)startTime
 /**
  * Applies a configuration.
  *
+ * For native (src=) playback, @"streaming.bufferingGoal" also sets how far
+ * ahead AVPlayer buffers and @"abr.restrictions.maxBandwidth" also limits the
+ * bitrate AVPlayer picks.
+ *
  * @param namePath The path of the parameter to configure.
  *   I.e. @"manifest.dash.defaultPresentationDelay" corresponds to
  *   {manifest: {dash: {defaultPresentationDelay: *your value*}}}
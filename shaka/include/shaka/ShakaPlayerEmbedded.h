@@ -34,19 +34,23 @@
 
 // Include C++ headers if we are compiling in C++ or Objective-C++.
 #ifdef __cplusplus
+#  include "abr_manager.h"
 #  include "async_results.h"
 #  include "error.h"
 #  include "js_manager.h"
 #  include "manifest.h"
 #  include "offline_externs.h"
 #  include "optional.h"
+#  include "pipeline_telemetry.h"
 #  include "player.h"
 #  include "player_externs.h"
 #  ifdef SHAKA_SDL_VIDEO
 #    include "sdl_frame_drawer.h"
 #  endif
+#  include "startup_trace.h"
 #  include "stats.h"
 #  include "storage.h"
+#  include "thread_options.h"
 #  include "track.h"
 #  include "utils.h"
 #  include "variant.h"
@@ -68,7 +72,9 @@
 #    include "media/default_media_player.h"
 #  endif
 #  include "media/demuxer.h"
+#  include "media/frame_snapshot.h"
 #  include "media/frames.h"
+#  include "media/media_allocator.h"
 #  include "media/media_capabilities.h"
 #  include "media/media_player.h"
 #  include "media/media_track.h"
@@ -78,11 +84,15 @@
 #    include "media/sdl_audio_renderer.h"
 #  endif
 #  ifdef SHAKA_SDL_VIDEO
+#    include "media/sdl_multiview_renderer.h"
 #    include "media/sdl_video_renderer.h"
 #  endif
 #  include "media/stream_info.h"
 #  include "media/streams.h"
 #  include "media/text_track.h"
 #  include "media/vtt_cue.h"
+#  ifdef SHAKA_DEFAULT_MEDIA_PLAYER
+#    include "media/worker_pool.h"
+#  endif
 #  include "net.h"
 #endif
@@ -52,6 +52,27 @@ SHAKA_EXPORT
 - (nullable instancetype)initWithPlayer:(ShakaPlayer * _Nullable) player
                                andError:(NSError * _Nullable __autoreleasing * _Nullable)error NS_SWIFT_NAME(init(player:));
 
+/**
+ * Makes "http" and "https" requests use NSURLSession.  While content is being
+ * stored, segments are downloaded with a background session, so the transfers
+ * continue while the app is suspended.  This applies to every player and
+ * storage instance, so it should be called once, when the app starts.
+ *
+ * @param identifier The identifier of the background session.  Use the same
+ *   one each time the app runs.
+ */
++ (void)enableBackgroundDownloadsWithIdentifier:(NSString *)identifier;
+
+/**
+ * Passes on the events of the background session.  Call this from
+ * <code>application:handleEventsForBackgroundURLSession:completionHandler:</code>
+ * after calling <code>enableBackgroundDownloadsWithIdentifier:</code>.
+ *
+ * @return YES if the session is the one used for background downloads.
+ */
++ (BOOL)handleEventsForBackgroundURLSession:(NSString *)identifier
+                          completionHandler:(void (^)(void))completionHandler;
+
 /** A client that receives events during storage. */
 @property(atomic, weak, nullable) id<ShakaPlayerStorageClient> client;
 
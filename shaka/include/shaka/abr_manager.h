@@ -0,0 +1,148 @@
+// Copyright 2020 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     https://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef SHAKA_EMBEDDED_ABR_MANAGER_H_
+#define SHAKA_EMBEDDED_ABR_MANAGER_H_
+
+#include <stdint.h>
+
+#include <vector>
+
+#include "macros.h"
+
+namespace shaka {
+
+/**
+ * Defines an interface for a native ABR manager.  Once one is given to
+ * Player::SetAbrManager, Shaka Player delegates choosing variants to it
+ * instead of using its own JavaScript ABR manager.  This mirrors Shaka
+ * Player's shaka.extern.AbrManager interface.
+ *
+ * The native signals (see Signals) can be read from any thread without
+ * going through JavaScript, so an implementation can react to changes as
+ * they happen, e.g. from its own timer.  Device state that the library
+ * doesn't track, such as the thermal state, can be read by the
+ * implementation directly.
+ *
+ * Unless noted otherwise, the methods are called on the JS main thread, so
+ * they should return quickly.
+ *
+ * @ingroup player
+ */
+class SHAKA_EXPORT AbrManager {
+ public:
+  /** A variant (a combination of audio and video) that can be chosen. */
+  struct Variant final {
+    /** The ID of the variant; this is unique within the manifest. */
+    int id = 0;
+    /** The total bandwidth of the variant, in bits per second. */
+    double bandwidth = 0;
+    /** The width of the video, or 0 if unknown or audio-only. */
+    uint32_t width = 0;
+    /** The height of the video, or 0 if unknown or audio-only. */
+    uint32_t height = 0;
+    /** The frame rate of the video, or 0 if unknown or audio-only. */
+    double frame_rate = 0;
+  };
+
+  /** The current state of the native pipeline. */
+  struct Signals final {
+    /**
+     * The moving average of the native network throughput, in bits per
+     * second, or 0 if there were no requests yet.
+     */
+    double bandwidth_estimate = 0;
+    /** The 10th percentile throughput of the recent requests. */
+    double bandwidth_low = 0;
+    /** The moving average of the time to first byte, in milliseconds. */
+    double ttfb_ms = 0;
+    /** The number of requests the throughput estimates are based on. */
+    uint64_t bandwidth_samples = 0;
+
+    /** The number of seconds buffered ahead of the playhead. */
+    double buffered_ahead = 0;
+    /** The current playback rate. */
+    double playback_rate = 0;
+    /** The total number of video frames played. */
+    uint32_t total_video_frames = 0;
+    /** The number of video frames that have been dropped. */
+    uint32_t dropped_video_frames = 0;
+  };
+
+  /** Defines the methods the AbrManager can use to control playback. */
+  class SHAKA_EXPORT Client {
+   public:
+    SHAKA_DECLARE_INTERFACE_METHODS(Client);
+
+    /**
+     * @return The current native signals.  This can be called from any
+     *   thread.
+     */
+    virtual Signals GetSignals() const = 0;
+
+    /**
+     * Switches to the variant with the given ID.  This is ignored while the
+     * AbrManager is disabled.  This can be called from any thread; the
+     * switch happens asynchronously on the JS main thread.
+     *
+     * @param id The ID of the variant to switch to.
+     * @param clear_buffer Whether to clear the already-buffered content.
+     */
+    virtual void SwitchVariant(int id, bool clear_buffer) = 0;
+  };
+
+  SHAKA_DECLARE_INTERFACE_METHODS(AbrManager);
+
+  /**
+   * Called when content is being loaded.  The given client can be used until
+   * Stop() is called.
+   */
+  virtual void Init(Client* client) = 0;
+
+  /** Called when the content is unloaded; this should stop any switches. */
+  virtual void Stop() = 0;
+
+  /** Sets the variants that can be chosen. */
+  virtual void SetVariants(const std::vector<Variant>& variants) = 0;
+
+  /**
+   * Chooses the variant to play.  This is called when the Player needs a
+   * variant immediately, e.g. when starting playback.
+   *
+   * @return The ID of one of the variants given to SetVariants().
+   */
+  virtual int ChooseVariant() = 0;
+
+  /**
+   * Called when the AbrManager is allowed to switch variants.  By default,
+   * this is called after the first variant is chosen.
+   */
+  virtual void Enable();
+
+  /** Called when the AbrManager should stop switching variants. */
+  virtual void Disable();
+
+  /**
+   * Called when a segment is downloaded.  The native signals already include
+   * these downloads, so this only needs to be implemented to react to them.
+   *
+   * @param delta_ms The time the download took, in milliseconds.
+   * @param bytes The number of bytes downloaded.
+   */
+  virtual void SegmentDownloaded(double delta_ms, double bytes);
+};
+
+}  // namespace shaka
+
+#endif  // SHAKA_EMBEDDED_ABR_MANAGER_H_
@@ -16,6 +16,7 @@
 #define SHAKA_EMBEDDED_ASYNC_RESULTS_H_
 
 #include <chrono>
+#include <functional>
 #include <future>
 #include <type_traits>
 
@@ -129,6 +130,25 @@ class AsyncResults final {
   std::shared_future<variant_type> future_;
 };
 
+/**
+ * A callback that is given the results of an asynchronous operation.  This is
+ * an alternative to AsyncResults that doesn't need a future; it is given
+ * either the results of the operation or the Error that occurred.
+ *
+ * @ingroup player
+ */
+template <typename T>
+using AsyncCallback =
+    std::function<void(const typename AsyncResults<T>::variant_type&)>;
+
+/**
+ * Runs the given task, e.g. by posting it to the app's UI thread.  This is
+ * used to choose which thread an AsyncCallback is called on.
+ *
+ * @ingroup player
+ */
+using AsyncExecutor = std::function<void(std::function<void()>)>;
+
 }  // namespace shaka
 
 #endif  // SHAKA_EMBEDDED_ASYNC_RESULTS_H_
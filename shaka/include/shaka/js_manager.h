@@ -15,20 +15,38 @@
 #ifndef SHAKA_EMBEDDED_JS_MANAGER_H_
 #define SHAKA_EMBEDDED_JS_MANAGER_H_
 
+#include <stddef.h>
+#include <stdint.h>
+
 #include <memory>
 #include <string>
+#include <vector>
 
 #include "async_results.h"
 #include "macros.h"
 #include "net.h"
+#include "pipeline_telemetry.h"
+#include "thread_options.h"
 
 namespace shaka {
 
 class JsManagerImpl;
 
+namespace media {
+class MediaAllocator;
+}  // namespace media
+
 /**
  * @defgroup exported Public Types
  * Types exported by the library.
+ *
+ * Structs that the app creates (e.g. JsManager::StartupOptions) or gets back
+ * by value (e.g. JsManager::MemoryUsage) are allocated by the app, so their
+ * size is part of the public ABI.  Once a release includes one of these
+ * structs, it can't gain fields without breaking compatibility.  New settings
+ * are added as a new struct or a new setter instead (e.g.
+ * JsManager::HeapOptions or JsManager::SetThreadOptions).  Classes that need
+ * to grow hide their members behind a pointer instead (e.g. Player).
  */
 
 /**
@@ -53,9 +71,6 @@ class JsManagerImpl;
 class SHAKA_EXPORT JsManager final {
  public:
   struct StartupOptions final {
-    // This type is stack allocated, so the size is part of the public ABI;
-    // fields can't be added without breaking compatibility.
-
     /**
      * The path to store persistent data (e.g. IndexedDB data).  This directory
      * needs write access, but can be initially empty.  It is assumed that we
@@ -70,6 +85,10 @@ class SHAKA_EXPORT JsManager final {
      * The path to static library data (e.g. shaka-player.compiled.js).  This
      * directory only needs read access.
      *
+     * This can also contain a prebuilt <code>shaka-player.code_cache</code>,
+     * copied from the dynamic data dir of a device with the same build, so the
+     * first launch doesn't need to parse the library.
+     *
      * See <code>is_static_relative_to_bundle</code> for handling of relative
      * paths.
      */
@@ -84,8 +103,486 @@ class SHAKA_EXPORT JsManager final {
     bool is_static_relative_to_bundle = false;
   };
 
+  /**
+   * Options for how native network requests share connections.  These can be
+   * changed at any time and apply to requests sent after the change.
+   *
+   * These are separate from StartupOptions so they can be added without
+   * changing the size of that type.
+   */
+  struct NetworkOptions final {
+    /**
+     * If <code>true</code>, requests share a DNS cache and TLS sessions.
+     * Connections are always reused between requests when possible.
+     */
+    bool share_connections = true;
+
+    /**
+     * If <code>true</code>, use HTTP/2 for HTTPS requests when the server
+     * supports it, and multiplex requests to the same host over one
+     * connection.
+     */
+    bool enable_http2 = true;
+
+    /**
+     * If <code>true</code>, the TLS sessions of requests are stored in the
+     * dynamic data directory, so the first connection to each host after the
+     * app restarts can resume a session instead of doing a full handshake.
+     *
+     * The file is only readable by the app, but it is <b>not encrypted</b>.
+     * It holds the session tickets and the secrets needed to resume them.
+     * Anyone who can read it can resume those sessions and may be able to
+     * decrypt recorded traffic from them until they expire.  Only enable this
+     * if the app's data directory is trusted (e.g. not on shared or backed-up
+     * storage).  When this is <code>false</code>, sessions are only kept in
+     * memory and stored sessions are deleted once a new one is made, so set
+     * this before making requests.
+     */
+    bool persist_tls_sessions = false;
+
+    /**
+     * The maximum number of connections to open to a single host.  Requests
+     * beyond this are queued until a connection is free.  If this is 0, there
+     * is no limit.
+     */
+    uint32_t max_connections_per_host = 6;
+
+    /**
+     * The maximum number of bytes of segment data to keep in memory.  When
+     * non-zero, successful GET responses are cached by URI and Range header so
+     * repeated requests (e.g. after a seek or an ABR switch) don't use the
+     * network.  Manifests and responses marked as no-store/no-cache are not
+     * cached.  If this is 0, the cache is disabled.
+     */
+    uint64_t segment_cache_size = 0;
+
+    /**
+     * The maximum number of bytes to store on disk for the responses that are
+     * needed each time content is played: manifests, playlists, and init
+     * segments.  These follow the HTTP caching headers (Cache-Control,
+     * Expires, ETag, and Last-Modified); stale entries are revalidated with
+     * the server, so starting the same content again skips those round trips.
+     * The files are stored in the dynamic data directory.  If this is 0, the
+     * cache is disabled.
+     */
+    uint64_t http_cache_size = 32 * 1024 * 1024;
+
+    /**
+     * The maximum number of bytes per second to download, across all
+     * requests.  This is useful to keep background work like offline storage
+     * from using all the bandwidth.  Requests over the limit are paused until
+     * more data can be received.  If this is 0, there is no limit.
+     */
+    uint64_t max_download_bytes_per_second = 0;
+
+    /**
+     * The maximum number of response bytes held, across all requests, by
+     * requests that haven't completed yet.  Beyond this, requests are paused
+     * until others complete, except the one that has received the most so it
+     * can complete.  This keeps memory flat when many large downloads (e.g.
+     * offline storage) run at once.  If this is 0, there is no limit.
+     */
+    uint64_t max_in_flight_bytes = 64 * 1024 * 1024;
+
+    /**
+     * The number of response bytes each request can hold regardless of
+     * <code>max_in_flight_bytes</code>, so small requests like manifests and
+     * licenses aren't stalled by large downloads.
+     */
+    uint64_t max_request_in_flight_bytes = 1024 * 1024;
+
+    /**
+     * The minimum time, in milliseconds, between "progress" events for a
+     * request.  The events report all the bytes received since the last one,
+     * so a larger interval means less work on the JavaScript thread.  If this
+     * is 0, the events aren't throttled; there is still at most one pending
+     * event per request, which reports all the bytes received before it runs.
+     */
+    uint32_t progress_interval_ms = 50;
+
+    /**
+     * If <code>true</code>, GET requests for adjacent byte ranges of the same
+     * URL that are made at about the same time (e.g. the init segment and
+     * index of a SegmentBase stream) are downloaded with a single request.
+     * Each request still gets its own response.  Ranged requests are held for
+     * a couple of milliseconds to find adjacent ranges.
+     */
+    bool coalesce_range_requests = true;
+
+    /**
+     * If <code>true</code>, requests are prioritized by their type: license
+     * requests first, then manifest and timing requests, then segments.  New
+     * requests wait while more important requests are in progress, and with
+     * HTTP/2 the more important streams get a larger share of the connection.
+     */
+    bool prioritize_requests = true;
+
+    /**
+     * If <code>true</code>, requests for whole resources (i.e. without a Range
+     * header) accept compressed responses (e.g. gzip or Brotli, depending on
+     * how CURL was built).  The response is decoded on the network thread, so
+     * JavaScript always gets the decoded body.
+     */
+    bool accept_compressed_responses = true;
+
+    /**
+     * If non-zero, a segment request that has waited longer for its first
+     * byte than this percentile of the recent requests (e.g. 95) is hedged: a
+     * duplicate is sent to another URI of the request (e.g. another CDN), or
+     * to the same URI over a new connection, and whichever response completes
+     * first is used.  The other URIs are the ones left in the request after
+     * the network filters run.  If this is 0, requests aren't hedged.
+     */
+    uint32_t hedge_percentile = 0;
+  };
+
+  /**
+   * Options for the size of the JavaScript heap.  These are separate from
+   * StartupOptions so they can be added without changing the size of that
+   * type.  These are only used with V8; other engines don't support limiting
+   * the heap.
+   */
+  struct HeapOptions final {
+    /**
+     * The maximum size, in bytes, of the JavaScript heap.  If JavaScript uses
+     * more than this, the engine will abort.  If this is 0, the engine picks a
+     * limit based on the device's memory.
+     */
+    uint64_t max_heap_size = 0;
+
+    /**
+     * The maximum size, in bytes, of the young generation of the heap, where
+     * new objects are allocated.  A smaller young generation uses less memory
+     * but collects garbage more often.  If this is 0, this is based on
+     * <code>max_heap_size</code>.
+     */
+    uint64_t max_young_generation_size = 0;
+  };
+
+  /**
+   * Limits on how much demuxed media each MSE SourceBuffer can hold.  An
+   * append that would go over the limit first removes media that has already
+   * played; if the SourceBuffer is still too full, the append fails with a
+   * QuotaExceededError, which tells the player to buffer less.
+   */
+  struct SourceBufferQuota final {
+    /**
+     * The number of bytes a video SourceBuffer can hold.  If this is 0, the
+     * limit is based on the amount of physical memory on the device.
+     */
+    uint64_t video_bytes = 0;
+
+    /**
+     * The number of bytes an audio SourceBuffer can hold.  If this is 0, the
+     * limit is based on the amount of physical memory on the device.
+     */
+    uint64_t audio_bytes = 0;
+
+    /**
+     * If <code>true</code>, an append that would go over the limit removes
+     * media before the playhead (keeping the GOP being played) to make room.
+     * If <code>false</code>, the append fails and it is up to the player to
+     * remove media.
+     */
+    bool evict_played_media = true;
+  };
+
+  /** Statistics about the memory used by JavaScript. */
+  struct JsHeapStats final {
+    /** The number of bytes used by JavaScript objects. */
+    uint64_t used_heap_size = 0;
+    /** The number of bytes the engine has allocated for the heap. */
+    uint64_t total_heap_size = 0;
+    /** The maximum size the heap can grow to, or 0 if unknown. */
+    uint64_t heap_size_limit = 0;
+    /**
+     * The number of bytes held outside the heap by JavaScript objects (e.g.
+     * ArrayBuffer data).
+     */
+    uint64_t external_memory = 0;
+    /**
+     * The number of native objects (e.g. elements, SourceBuffers, and events)
+     * that are tracked by the JavaScript garbage collector.
+     */
+    uint64_t native_object_count = 0;
+    /**
+     * How long each garbage collection paused JavaScript for.  For JSC, this
+     * only includes the tracing of native objects, since JSC doesn't report
+     * its own pauses.
+     */
+    PipelineTelemetry::Histogram gc_pauses;
+    /**
+     * The number of times garbage collection work was done while the
+     * JavaScript thread was idle, instead of during a task.
+     */
+    uint64_t idle_gc_count = 0;
+  };
+
+  /** Statistics about how long the JavaScript tasks run and wait to run. */
+  struct EventLoopStats final {
+    /** A task that ran for longer than the long task threshold. */
+    struct LongTask final {
+      /**
+       * The name of the task, or the kind of task (e.g. "(Timer)") if it
+       * doesn't have a name.
+       */
+      std::string name;
+      /** How long the task ran for, in microseconds. */
+      uint64_t duration_us = 0;
+    };
+
+    /** The times for all the tasks with a given name. */
+    struct TaskTiming final {
+      std::string name;
+      /** The number of times a task with this name ran. */
+      uint64_t count = 0;
+      /** The total time, in microseconds, these tasks ran for. */
+      uint64_t total_us = 0;
+      /** The longest time, in microseconds, one of these tasks ran for. */
+      uint64_t max_us = 0;
+    };
+
+    /** How late timers ran after they were due. */
+    PipelineTelemetry::Histogram timer_delay;
+    /** How long internal tasks (e.g. calls from the app) waited to run. */
+    PipelineTelemetry::Histogram internal_wait;
+    /** How long events (e.g. media and EME events) waited to run. */
+    PipelineTelemetry::Histogram event_wait;
+    /** How long the highest priority tasks waited to run. */
+    PipelineTelemetry::Histogram immediate_wait;
+    /** How long each task ran for. */
+    PipelineTelemetry::Histogram task_duration;
+    /** The number of tasks that ran longer than the long task threshold. */
+    uint64_t long_task_count = 0;
+    /** The most recent long tasks, oldest first. */
+    std::vector<LongTask> recent_long_tasks;
+    /** The times of the named tasks, sorted by total time, longest first. */
+    std::vector<TaskTiming> named_tasks;
+  };
+
+  /** Statistics about the native segment cache. */
+  struct SegmentCacheStats final {
+    /** The number of requests that were served from the cache. */
+    uint64_t hits = 0;
+    /** The number of requests that weren't in the cache. */
+    uint64_t misses = 0;
+    /** The number of entries removed to make room for new ones. */
+    uint64_t evictions = 0;
+    /** The number of responses currently in the cache. */
+    uint64_t entry_count = 0;
+    /** The number of bytes currently in the cache. */
+    uint64_t total_bytes = 0;
+  };
+
+  /** Options for the native analytics beacon uploader. */
+  struct BeaconOptions final {
+    /** The URL to POST the batches to.  If empty, events are ignored. */
+    std::string url;
+    /** How long to wait after the first pending item before uploading. */
+    uint64_t flush_interval_ms = 60000;
+    /**
+     * The maximum number of events in a batch.  Once this many are pending,
+     * the batch is uploaded immediately.
+     */
+    uint32_t max_events = 256;
+    /** Whether to compress batches with gzip. */
+    bool compress = true;
+  };
+
+  /** Statistics about the native analytics beacon uploader. */
+  struct BeaconStats final {
+    /** The number of batches that were uploaded. */
+    uint64_t batch_count = 0;
+    /** The number of batches that failed to upload; these aren't retried. */
+    uint64_t failed_batch_count = 0;
+    /** The number of events and metrics that were added. */
+    uint64_t item_count = 0;
+    /** The number of items that were merged into an earlier item. */
+    uint64_t coalesced_count = 0;
+    /** The number of events dropped because the batch was full. */
+    uint64_t dropped_count = 0;
+  };
+
+  /** Statistics about the background thread that runs IndexedDB requests. */
+  struct StorageStats final {
+    /** The number of database operations that have completed. */
+    uint64_t operation_count = 0;
+    /** The number of operations that are waiting or running. */
+    uint64_t queue_depth = 0;
+    /** The largest number of operations that were waiting at once. */
+    uint64_t max_queue_depth = 0;
+    /**
+     * The average time, in milliseconds, between an operation being requested
+     * and it completing.
+     */
+    double average_latency_ms = 0;
+    /** The longest time one operation took to complete, in milliseconds. */
+    uint64_t max_latency_ms = 0;
+  };
+
+  /**
+   * Statistics about the WebAssembly modules that JavaScript compiled and
+   * instantiated.  Compiled modules are stored in the dynamic data directory,
+   * so later launches can load them instead of compiling them again.  With
+   * JavaScriptCore, modules aren't cached and these aren't recorded.
+   */
+  struct WasmStats final {
+    /** The number of modules that were loaded from the cache. */
+    uint64_t cache_hit_count = 0;
+    /** The number of modules that weren't in the cache and were compiled. */
+    uint64_t cache_miss_count = 0;
+    /**
+     * How long modules that weren't in the cache took to compile, until their
+     * fully optimized code was ready.
+     */
+    PipelineTelemetry::Histogram compile_times;
+    /** How long modules that were in the cache took to load. */
+    PipelineTelemetry::Histogram cached_compile_times;
+    /**
+     * How long WebAssembly.instantiate and instantiateStreaming took to create
+     * an instance of a compiled module.  This doesn't include modules created
+     * with the WebAssembly.Instance constructor.
+     */
+    PipelineTelemetry::Histogram instantiate_times;
+  };
+
+  /**
+   * How much memory the media caches of every player are using; see
+   * SetMemoryBudget.
+   */
+  struct MemoryUsage final {
+    /** The memory budget, or 0 if there is no limit. */
+    uint64_t budget = 0;
+    /** The total number of bytes used by the caches below. */
+    uint64_t total_bytes = 0;
+    /** The bytes used by responses in the native segment cache. */
+    uint64_t segment_cache_bytes = 0;
+    /** The bytes used by unused decoder frame buffers. */
+    uint64_t frame_pool_bytes = 0;
+    /** The bytes used by decoded frames waiting to be rendered. */
+    uint64_t decoded_frame_bytes = 0;
+    /** The bytes used by demuxed frames in the MSE SourceBuffers. */
+    uint64_t encoded_frame_bytes = 0;
+    /** The bytes used by downloads in progress. */
+    uint64_t network_bytes = 0;
+    /** The total number of bytes evicted to fit in the budget. */
+    uint64_t evicted_bytes = 0;
+  };
+
+  /** The memory used by a single media buffer (e.g. one SourceBuffer). */
+  struct BufferMemoryUsage final {
+    /**
+     * The name of the buffer.  For SourceBuffers, this is the MIME type it was
+     * created with.
+     */
+    std::string name;
+    /** The number of bytes the buffer holds. */
+    uint64_t bytes = 0;
+  };
+
+  /** The native objects of a single type that are tracked by the GC. */
+  struct NativeTypeMemoryUsage final {
+    /** The name of the type (e.g. "SourceBuffer"). */
+    std::string type_name;
+    /** The number of objects of this type. */
+    uint64_t count = 0;
+    /**
+     * The number of bytes the objects use, not including the memory they
+     * point to (e.g. buffered media, which is counted in MemoryUsage).
+     */
+    uint64_t bytes = 0;
+  };
+
+  /** A breakdown of the memory the library is using; see GetMemoryReport. */
+  struct MemoryReport final {
+    /** The memory used by the media caches, by subsystem. */
+    MemoryUsage media;
+    /** The memory used by the JavaScript engine. */
+    JsHeapStats js_heap;
+    /** The native objects tracked by the GC, sorted by size, largest first. */
+    std::vector<NativeTypeMemoryUsage> native_types;
+    /** The demuxed frames held by each MSE SourceBuffer. */
+    std::vector<BufferMemoryUsage> source_buffers;
+    /** The decoded frames held by each decoder. */
+    std::vector<BufferMemoryUsage> decoded_streams;
+  };
+
+  /** A function (or task) in the call tree of a CpuProfile. */
+  struct CpuProfileNode final {
+    /**
+     * The name of the function.  For task nodes, this is the name of the
+     * task (e.g. "LowMemoryNotification" or "(Timer)").
+     */
+    std::string function_name;
+    /** The URL of the script the function is in, if known. */
+    std::string url;
+    /** The 1-based line number of the function, or 0 if unknown. */
+    int line = 0;
+    /** The 1-based column number of the function, or 0 if unknown. */
+    int column = 0;
+    /** The index of the caller in CpuProfile::nodes, or -1 for the root. */
+    int32_t parent = -1;
+    /**
+     * Whether this is a native frame for the task the event loop was running,
+     * instead of a JavaScript function.  These are the direct children of the
+     * root and the JavaScript functions the task called are under them.
+     */
+    bool is_task = false;
+  };
+
+  /**
+   * The results of sampling the JavaScript thread; see StartCpuProfiling.
+   * This uses the same structure as the Chrome DevTools
+   * <code>.cpuprofile</code> format, so it is compact and easy to convert.
+   */
+  struct CpuProfile final {
+    /** When profiling started, in microseconds on a monotonic clock. */
+    uint64_t start_time_us = 0;
+    /** When profiling stopped, in microseconds on the same clock. */
+    uint64_t end_time_us = 0;
+    /** The nodes of the call tree; the first node is the root. */
+    std::vector<CpuProfileNode> nodes;
+    /** The index of the node that was running at each sample. */
+    std::vector<uint32_t> samples;
+    /**
+     * The time of each sample, in microseconds, relative to the previous
+     * sample; the first one is relative to @a start_time_us.
+     */
+    std::vector<uint32_t> time_deltas_us;
+  };
+
+  /**
+   * How much memory pressure the device is under.  This should be set based
+   * on the platform's low-memory notifications.
+   */
+  enum class MemoryPressure : uint8_t {
+    /** There is enough memory; this is the default. */
+    None,
+    /** Memory is running low; caches should be reduced. */
+    Moderate,
+    /** Memory is critically low; use as little memory as possible. */
+    Critical,
+  };
+
+  /** Where the JavaScript code is run. */
+  enum class EventLoopMode : uint8_t {
+    /** JavaScript runs on a background thread owned by the JsManager. */
+    OwnThread,
+    /**
+     * JavaScript runs on the thread that creates the JsManager, whenever the
+     * app calls RunUntilIdle; this is meant for apps that already have a run
+     * loop (e.g. a game loop).  Calls to Player on that thread run
+     * synchronously, so the returned results are already complete.  The
+     * JsManager must also be destroyed on that thread.
+     */
+    AppThread,
+  };
+
   JsManager();
   JsManager(const StartupOptions& options);
+  JsManager(const StartupOptions& options, const HeapOptions& heap_options);
+  JsManager(const StartupOptions& options, const HeapOptions& heap_options,
+            EventLoopMode mode);
   JsManager(JsManager&&);
   ~JsManager();
 
@@ -114,6 +611,295 @@ class SHAKA_EXPORT JsManager final {
    */
   AsyncResults<void> RunScript(const std::string& path);
 
+  /**
+   * Runs the pending JavaScript tasks until there are none ready or until the
+   * given time has passed.  This can only be used with
+   * EventLoopMode::AppThread and must be called on the thread that created
+   * this object.  This should be called often (e.g. once per frame), since
+   * all the JavaScript, including events and timers, only runs in here.
+   *
+   * @param max_time The maximum time, in seconds, to run tasks for.  The task
+   *   that is running at that time is allowed to finish.
+   * @return The time, in seconds, until the next timer is ready; 0 if there
+   *   are still tasks ready; or infinity if nothing is scheduled.  More tasks
+   *   can be added by other threads at any time, so this is only a hint.
+   */
+  double RunUntilIdle(double max_time);
+
+  /**
+   * Gets results that resolve once the JavaScript engine is running and the
+   * Shaka Player library is loaded.
+   *
+   * Creating a JsManager doesn't block on any of its startup work: the engine
+   * is started on the JavaScript thread while the library and its code cache
+   * are read on a background thread.  Apps can create the JsManager as early
+   * as possible (e.g. together with Preconnect) and use this to know when a
+   * Player can be created without waiting.
+   */
+  AsyncResults<void> WhenReady() const;
+
+  /**
+   * Connects to the host of the given URL in the background, so the DNS
+   * lookup and TLS session are ready for the requests that follow.  This is
+   * useful for the hosts of the manifest and license server while the app is
+   * still starting.  This has no effect if connections aren't shared (see
+   * NetworkOptions).  This can be called from any thread.
+   *
+   * The segment hosts a manifest refers to (e.g. in DASH BaseURL elements) are
+   * connected to automatically once the manifest is downloaded, so this is
+   * only needed for hosts the manifest doesn't name.
+   *
+   * @param url A URL on the host to connect to.
+   */
+  void Preconnect(const std::string& url);
+
+  /**
+   * Connects to the hosts of each of the given URLs, like above.  This can be
+   * used to pass a list of hints, such as the CDNs the app's content uses.
+   *
+   * @param urls URLs on the hosts to connect to.
+   */
+  void Preconnect(const std::vector<std::string>& urls);
+
+  /** Changes how native network requests share connections. */
+  void SetNetworkOptions(const NetworkOptions& options);
+
+  /**
+   * Adds the given response data to the native segment cache.  This can be
+   * used (e.g. from a network filter or scheme plugin) to download segments
+   * ahead of when the player needs them.  This does nothing if the cache is
+   * disabled.  This can be called from any thread.
+   *
+   * @param uri The URI of the segment.
+   * @param range The value of the Range header the player will use (e.g.
+   *   "bytes=0-499"), or an empty string for the whole resource.
+   * @param data The data of the response.
+   * @param size The number of bytes in @a data.
+   */
+  void AddCachedSegment(const std::string& uri, const std::string& range,
+                        const uint8_t* data, size_t size);
+
+  /** @return The current statistics of the native segment cache. */
+  SegmentCacheStats GetSegmentCacheStats() const;
+
+  /** @return The current statistics of the IndexedDB storage thread. */
+  StorageStats GetStorageStats() const;
+
+  /**
+   * @return The current statistics of the WebAssembly modules.  This can be
+   *   called from any thread.
+   */
+  WasmStats GetWasmStats() const;
+
+  /**
+   * Changes where and how often analytics beacons are uploaded.  Events and
+   * metrics are collected in memory and uploaded together as one JSON batch
+   * (see BeaconOptions).  The uploads use the lowest request priority, so
+   * they wait for any media requests.  This can be called from any thread.
+   */
+  void SetBeaconOptions(const BeaconOptions& options);
+
+  /**
+   * Adds an event to the next analytics batch.  Consecutive events with the
+   * same name and data are sent once with a count.  This can be called from
+   * any thread.
+   *
+   * @param name The name of the event.
+   * @param data Extra data for the event; this is sent as a string.
+   */
+  void AddBeaconEvent(const std::string& name, const std::string& data);
+
+  /**
+   * Adds a value of a metric to the next analytics batch.  The values of
+   * each metric are summarized (count, sum, min, max, and last) rather than
+   * sent individually.  This can be called from any thread.
+   */
+  void AddBeaconMetric(const std::string& name, double value);
+
+  /** @return The current statistics of the analytics beacon uploader. */
+  BeaconStats GetBeaconStats() const;
+
+  /**
+   * Sets how much memory pressure the device is under.  While under pressure,
+   * the DefaultMediaPlayer decodes fewer frames ahead of the playhead and keeps
+   * fewer unused frame buffers, and the JavaScript engine is asked to free as
+   * much memory as it can.  Critical pressure also clears the native segment
+   * cache.  This applies to all players and can be called from any thread.
+   */
+  void SetMemoryPressure(MemoryPressure pressure);
+
+  /**
+   * Sets how much media each MSE SourceBuffer can hold.  The limits are
+   * checked at the start of every append, so this applies to existing
+   * SourceBuffers too.  While under memory pressure, the limits are reduced.
+   * This applies to all players and can be called from any thread.
+   */
+  void SetSourceBufferQuota(const SourceBufferQuota& quota);
+
+  /**
+   * Sets the maximum amount of memory the media caches of every player can use
+   * together.  When an allocation wouldn't fit, the caches are evicted in
+   * order: the native segment cache, unused decoder frame buffers, and then
+   * media in the SourceBuffers that was already played.  If that isn't
+   * enough, the DefaultMediaPlayer decodes fewer frames ahead and appends
+   * fail with a QuotaExceededError, which makes Shaka Player buffer less.
+   * This doesn't include the JavaScript heap, which is limited by
+   * HeapOptions.  This can be called from any thread.
+   *
+   * @param bytes The budget, in bytes, or 0 for no limit (the default).
+   */
+  void SetMemoryBudget(uint64_t bytes);
+
+  /**
+   * Gets how much memory the media caches of every player are using.  This
+   * can be called from any thread.
+   */
+  MemoryUsage GetMemoryUsage() const;
+
+  /**
+   * Sets how the library's threads with the given role are scheduled.  This
+   * only applies to threads that start after this is called, so this should be
+   * called before creating the JsManager to also apply to the JavaScript
+   * thread.  By default, audio and video threads use
+   * ThreadPriority::UserInteractive, background threads use
+   * ThreadPriority::Utility, and the others use ThreadPriority::UserInitiated.
+   * This applies to all players and can be called from any thread.
+   *
+   * This is a setter instead of a StartupOptions field since StartupOptions
+   * was already released and can't gain fields (see Public Types).
+   */
+  static void SetThreadOptions(ThreadRole role, const ThreadOptions& options);
+
+  /**
+   * Sets the allocator used for the large media buffers: downloaded segments,
+   * demuxed frames, and decoded video frames (from the FFmpeg decoder).  This
+   * only applies to buffers allocated after this is called, and the allocator
+   * must outlive all the buffers allocated from it (i.e. every Player and
+   * JsManager).  This applies to all players and can be called from any
+   * thread.
+   *
+   * @param allocator The allocator to use, or nullptr to use the heap.
+   */
+  static void SetMediaAllocator(media::MediaAllocator* allocator);
+
+  /**
+   * Gets how much memory JavaScript is using.  All players share the same
+   * JavaScript engine, so this includes every player.  If this is called from
+   * a thread other than the JavaScript thread, this blocks until that thread
+   * is free.
+   */
+  JsHeapStats GetJsHeapStats() const;
+
+  /**
+   * Gets a breakdown of the memory the library is using: the media caches, the
+   * JavaScript heap, and the native objects by type.  This is meant for
+   * diagnosing memory growth in long sessions and is cheap enough to call
+   * periodically (e.g. once a minute).  Like GetJsHeapStats, this blocks until
+   * the JavaScript thread is free.
+   */
+  MemoryReport GetMemoryReport() const;
+
+  /**
+   * Starts a sampling profiler on the JavaScript thread.  Profiling stops
+   * automatically after @a max_duration; the profile is kept until
+   * StopCpuProfiling is called.  This is only supported with V8; with other
+   * engines, the results contain an error.  This can be called from any
+   * thread.
+   *
+   * @param max_duration The maximum time, in seconds, to profile for.
+   * @param sample_interval_us The time, in microseconds, between samples.
+   */
+  AsyncResults<void> StartCpuProfiling(double max_duration,
+                                       uint32_t sample_interval_us);
+
+  /**
+   * Stops the profiler, if it is still running, and gets the profile.  The
+   * samples are grouped under the event loop task that was running, so the
+   * profile shows which native tasks (e.g. media events or timers) called the
+   * hot JavaScript functions.  This can be called from any thread.
+   */
+  AsyncResults<CpuProfile> StopCpuProfiling();
+
+  /**
+   * Sets the granularity that JavaScript timers are aligned to.  When this is
+   * non-zero, setTimeout and setInterval callbacks are delayed until the next
+   * multiple of this many milliseconds so timers that are close together run
+   * on the same wakeup.  This can be used to reduce power usage while the app
+   * is in the background (e.g. with 50ms).  This can be called from any thread.
+   *
+   * @param slack_ms The granularity, in milliseconds, or 0 to disable.
+   */
+  void SetTimerSlack(uint64_t slack_ms);
+
+  /**
+   * @return How long the JavaScript tasks have run and waited to run.  A long
+   *   task delays every task behind it, including media events and EME
+   *   callbacks, so this shows which tasks cause the delays.  This can be
+   *   called from any thread.
+   */
+  EventLoopStats GetEventLoopStats() const;
+
+  /**
+   * Sets the time, in milliseconds, that a JavaScript task must run for to be
+   * reported as a long task.  The default is 50 milliseconds.
+   */
+  void SetLongTaskThreshold(uint64_t threshold_ms);
+
+  /**
+   * Sets whether to record how long threads wait for, and hold, the internal
+   * locks, and how long they wait for internal events.  This is disabled by
+   * default and adds a small cost to every lock while enabled.  This applies
+   * to all instances and can be called from any thread.
+   */
+  void SetLockProfilingEnabled(bool enabled);
+
+  /**
+   * @return A human-readable table of the lock profile recorded so far, with
+   *   a row for each named lock or event.
+   */
+  std::string GetLockProfile() const;
+
+  /** Clears the lock profile recorded so far. */
+  void ResetLockProfile();
+
+  /**
+   * Sets whether to record how long the garbage collector spends tracing each
+   * type of object.  This is disabled by default and adds a clock read for
+   * every object traced while enabled.  This can be called from any thread.
+   */
+  void SetGcProfilingEnabled(bool enabled);
+
+  /**
+   * @return A human-readable table of the GC tracing profile recorded so far,
+   *   with a row for each type, sorted by the total time spent tracing it.
+   */
+  std::string GetGcProfile() const;
+
+  /** Clears the GC tracing profile recorded so far. */
+  void ResetGcProfile();
+
+  /**
+   * Sets whether to record trace events for the media pipeline.  This records
+   * the demuxing, decrypting, decoding, and presenting of each frame, linked
+   * together with flow events, plus the network and JavaScript tasks.  This is
+   * disabled by default and only the most recent events are kept.  The events
+   * are only available if the library was built with tracing enabled (the
+   * default).  This applies to all instances and can be called from any thread.
+   *
+   * This is separate from StartupOptions so tracing can be started and stopped
+   * around the part of playback being investigated.
+   */
+  void SetTracingEnabled(bool enabled);
+
+  /**
+   * @return The trace events recorded so far, in the Chrome trace event JSON
+   *   format.  This can be loaded in chrome://tracing or the Perfetto UI.
+   */
+  std::string GetTraceJson() const;
+
+  /** Clears the trace events recorded so far. */
+  void ResetTrace();
+
   /**
    * Registers a network scheme plugin that handles network requests.  This is
    * global and applies to all requests for this scheme.
@@ -21,6 +21,7 @@
 
 #include "../macros.h"
 #include "../utils.h"
+#include "frame_snapshot.h"
 #include "renderer.h"
 
 namespace shaka {
@@ -54,6 +55,59 @@ class SHAKA_EXPORT AppleVideoRenderer final : public VideoRenderer {
   CGImageRef Render(double* delay = nullptr,
                     Rational<uint32_t>* sample_aspect_ratio = nullptr);
 
+  /**
+   * Gets the current video frame as a pixel buffer.  This is like Render, but
+   * doesn't convert the frame to a CGImage.  Frames from VideoToolbox are
+   * returned as-is, so they can be displayed from their IOSurface (e.g. using
+   * an AVSampleBufferDisplayLayer) without copying them.
+   *
+   * This follows the CREATE rule.
+   *
+   * @param delay [OUT] Optional, if given, will be filled with the delay, in
+   *   seconds, until the next call to RenderPixelBuffer should be made.
+   * @param sample_aspect_ratio [OUT] Optional, if given, will be filled with
+   *   the sample aspect ratio of the image.
+   */
+  CVPixelBufferRef RenderPixelBuffer(
+      double* delay = nullptr,
+      Rational<uint32_t>* sample_aspect_ratio = nullptr);
+
+  /**
+   * Gets the video frame that should be visible at the next vsync as a pixel
+   * buffer.  Unlike RenderPixelBuffer, this keeps each frame on screen for a
+   * steady number of vsyncs (e.g. 3:2 pulldown of 24fps content at 60Hz), so
+   * frames aren't shown off-cadence when the clock jitters.  This should be
+   * called once per vsync, e.g. from a CADisplayLink.  This returns nullptr
+   * if the frame is the same as the previous call.
+   *
+   * This follows the CREATE rule.
+   *
+   * @param vsync_delay The time, in seconds, until the frame will be shown.
+   * @param refresh_interval The time, in seconds, between vsyncs.
+   * @param sample_aspect_ratio [OUT] Optional, if given, will be filled with
+   *   the sample aspect ratio of the image.
+   */
+  CVPixelBufferRef RenderPixelBufferForVsync(
+      double vsync_delay, double refresh_interval,
+      Rational<uint32_t>* sample_aspect_ratio = nullptr);
+
+  /**
+   * @return The frame rate of the content, based on the frames rendered so
+   *   far, or 0 if it isn't known yet.
+   */
+  double FrameRate() const;
+
+  /**
+   * Converts the frame that was last rendered to RGBA on a background thread.
+   * This doesn't block rendering or decoding.  VideoToolbox frames aren't
+   * supported, so this only works with software decoding.
+   *
+   * @param callback The callback to call with the image, or with nullptr if
+   *   there is no frame or it can't be converted.  This is called on a
+   *   background thread.
+   */
+  void TakeSnapshot(SnapshotCallback callback) const;
+
 
   void SetPlayer(const MediaPlayer* player) override;
   void Attach(const DecodedStream* stream) override;
@@ -61,6 +115,7 @@ class SHAKA_EXPORT AppleVideoRenderer final : public VideoRenderer {
 
   struct VideoPlaybackQuality VideoPlaybackQuality() const override;
   bool SetVideoFillMode(VideoFillMode mode) override;
+  void OnFramePresented(double age) override;
 
  private:
   class Impl;
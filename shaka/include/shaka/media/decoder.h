@@ -15,8 +15,12 @@
 #ifndef SHAKA_EMBEDDED_MEDIA_DECODER_H_
 #define SHAKA_EMBEDDED_MEDIA_DECODER_H_
 
+#include <stdint.h>
+
 #include <memory>
 #include <string>
+#include <unordered_map>
+#include <vector>
 
 #include "../eme/implementation.h"
 #include "../macros.h"
@@ -26,6 +30,114 @@
 namespace shaka {
 namespace media {
 
+class WorkerPool;
+
+/**
+ * Defines how a software decoder splits the decoding work between threads.
+ *
+ * @ingroup media
+ */
+enum class DecoderThreadType : uint8_t {
+  /** Let the decoder choose; this allows both frame and slice threading. */
+  Auto,
+
+  /**
+   * Decode several frames in parallel.  This gives the best throughput, but
+   * each thread adds a frame of latency.
+   */
+  Frame,
+
+  /**
+   * Decode the slices of a single frame in parallel.  This doesn't add latency,
+   * but only helps if the content was encoded with multiple slices.
+   */
+  Slice,
+};
+
+/**
+ * Defines the threading configuration of a software decoder.
+ *
+ * @ingroup media
+ */
+struct SHAKA_EXPORT DecoderThreadingOptions final {
+  /** The number of threads to use.  If 0, this is based on the CPU count. */
+  uint32_t thread_count = 0;
+
+  /** The kind of threading to use. */
+  DecoderThreadType thread_type = DecoderThreadType::Auto;
+
+  /**
+   * Whether to output frames as soon as possible instead of reordering them
+   * inside the decoder.  This disables frame threading.
+   */
+  bool low_delay = false;
+};
+
+/**
+ * Defines options used to create the built-in decoder.
+ *
+ * @ingroup media
+ */
+struct SHAKA_EXPORT DecoderOptions final {
+  DecoderOptions();
+  DecoderOptions(const DecoderOptions&);
+  DecoderOptions(DecoderOptions&&);
+  ~DecoderOptions();
+
+  DecoderOptions& operator=(const DecoderOptions&);
+  DecoderOptions& operator=(DecoderOptions&&);
+
+  /** The threading options to use for codecs not in |codec_threading|. */
+  DecoderThreadingOptions threading;
+
+  /**
+   * The threading options to use for specific codecs.  The keys are codec
+   * strings as they appear in MIME types (e.g. "hvc1" or "vp09"); any profile
+   * info after the first period is ignored.
+   */
+  std::unordered_map<std::string, DecoderThreadingOptions> codec_threading;
+
+  /**
+   * If true, encrypted frames are decrypted on a separate thread ahead of the
+   * playhead instead of right before they are decoded.  This allows decryption
+   * to overlap with decoding, which helps slow CDMs and hardware decoders.
+   * This is only used by the DefaultMediaPlayer and applies to any decoder.
+   */
+  bool decrypt_ahead = false;
+
+  /**
+   * If set, the DefaultMediaPlayer decodes frames and monitors the pipeline on
+   * this pool instead of on its own threads.  The same pool can be given to
+   * many players.  The pool must outlive any player created with these
+   * options.
+   */
+  WorkerPool* worker_pool = nullptr;
+
+  /**
+   * If true, the built-in decoder skips the loop filter and allows other
+   * shortcuts that lower the quality of the frames to decode faster.  This is
+   * meant for frames that are shown small, like thumbnails.
+   */
+  bool fast_decode = false;
+
+  /**
+   * Reduces the resolution the built-in decoder outputs, dividing the width
+   * and height by 2^lowres.  Only some codecs support this; others decode at
+   * full resolution.
+   */
+  uint8_t lowres = 0;
+
+  /**
+   * Whether to apply the film grain that AV1 streams can signal.  The grain
+   * is synthesized after decoding, which costs a pass over every frame; if
+   * false, frames are shown without it, which is smoother than intended.
+   */
+  bool apply_film_grain = true;
+
+  /** @return The threading options to use for the given codec string. */
+  const DecoderThreadingOptions& GetThreading(const std::string& codec) const;
+};
+
 /**
  * This is used by the DefaultMediaPlayer to decode EncodedFrame objects into
  * DecodedFrame objects.  If using a custom MediaPlayer, this type doesn't have
@@ -75,12 +187,98 @@ class SHAKA_EXPORT Decoder {
       std::vector<std::shared_ptr<DecodedFrame>>* frames,
       std::string* extra_info) = 0;
 
+  /**
+   * Decodes several frames in one call.  This is the same as calling Decode
+   * for each frame in order, but lets decoders avoid per-call overhead (e.g.
+   * locking) when frames are small, like audio.  This stops at the first frame
+   * that doesn't decode successfully.  The default calls Decode for each
+   * frame.
+   *
+   * @param input The frames to decode, in DTS order.  These can't be nullptr;
+   *   use Decode to flush the decoder.
+   * @param eme The EME implementation used to decrypt frames, or nullptr if not
+   *   using EME.
+   * @param frames [OUT] Where to insert newly created frames.
+   * @param consumed [OUT] Will contain the number of frames from |input| that
+   *   were decoded successfully.  The frames decoded before an error are
+   *   still inserted into |frames|.
+   * @param extra_info [OUT] If this returns FatalError, this argument will be
+   *   set to a description of what error happened.
+   * @return The status of the first frame that didn't decode successfully, or
+   *   Success if they all did.
+   */
+  virtual MediaStatus DecodeBatch(
+      const std::vector<std::shared_ptr<EncodedFrame>>& input,
+      const eme::Implementation* eme,
+      std::vector<std::shared_ptr<DecodedFrame>>* frames, size_t* consumed,
+      std::string* extra_info);
+
+  /**
+   * Sets whether to skip decoding frames that no other frame references.  The
+   * DefaultMediaPlayer sets this while decoding is behind the playhead, since
+   * those frames would be dropped by the renderer anyway; skipped frames don't
+   * produce any output.  Decoders that can't tell which frames are references
+   * can ignore this, which is the default.
+   */
+  virtual void SetSkipNonReferenceFrames(bool skip);
+
+  /**
+   * Sets the largest size, in pixels, that video frames are drawn at.  When
+   * frames are drawn much smaller than they are encoded (e.g. picture-in-
+   * picture or multiview tiles), decoders that can output a reduced
+   * resolution can use this to save decoding time and memory bandwidth.  The
+   * frames must stay at least this large.  A size of 0 means there is no
+   * limit, which is the default.  Decoders that can't scale their output can
+   * ignore this, which is the default.
+   */
+  virtual void SetMaxOutputSize(uint32_t width, uint32_t height);
+
+  /**
+   * Sets the pixel formats the renderer can draw without converting them,
+   * most preferred first.  Decoders that can output one of these (e.g. by
+   * picking it from the codec's supported formats, or by converting frames
+   * after decoding) should do so; otherwise the renderer converts each frame
+   * as it uploads it.  An empty list means any format is fine, which is the
+   * default.  Decoders that can only output one format can ignore this, which
+   * is the default.
+   */
+  virtual void SetPreferredPixelFormats(
+      const std::vector<PixelFormat>& formats);
+
 
   /**
    * Creates a new instance of the built-in decoder.  This returns nullptr if
    * the built-in decoder was removed from the build.
    */
   static std::unique_ptr<Decoder> CreateDefaultDecoder();
+
+  /**
+   * Creates a new instance of the built-in decoder using the given options.
+   * This returns nullptr if the built-in decoder was removed from the build.
+   * Options the built-in decoder doesn't support are ignored.
+   */
+  static std::unique_ptr<Decoder> CreateDefaultDecoder(
+      const DecoderOptions& options);
+
+  /**
+   * Creates a decoder for audio passthrough.  Frames of the given codecs aren't
+   * decoded; instead they are packed into IEC 61937 bursts (see
+   * SampleFormat::Iec61937) so an S/PDIF or HDMI sink (e.g. an AV receiver)
+   * can decode them.  This saves decoding on the device and keeps formats like
+   * Dolby Atmos that a PCM decode would lose.  DecodingInfo reports these
+   * codecs as supported and power efficient.
+   *
+   * The only codecs supported are "ac-3" and "ec-3" (which includes Atmos);
+   * list the ones the sink supports.  The audio renderer must open a device
+   * that sends the samples to the sink unchanged (e.g. an SdlAudioRenderer
+   * using an IEC 958 passthrough device).
+   *
+   * @param fallback The decoder used for other codecs, or nullptr to not
+   *   support other codecs.  This must outlive the returned decoder.
+   * @param codecs The codecs to pass through.
+   */
+  static std::unique_ptr<Decoder> CreatePassthroughDecoder(
+      Decoder* fallback, const std::vector<std::string>& codecs);
 };
 
 }  // namespace media
@@ -15,7 +15,10 @@
 #ifndef SHAKA_EMBEDDED_MEDIA_DEFAULT_MEDIA_PLAYER_H_
 #define SHAKA_EMBEDDED_MEDIA_DEFAULT_MEDIA_PLAYER_H_
 
+#include <stdint.h>
+
 #include <memory>
+#include <string>
 
 #include "../macros.h"
 #include "decoder.h"
@@ -25,6 +28,27 @@
 namespace shaka {
 namespace media {
 
+/**
+ * Defines how far ahead of the playhead the DefaultMediaPlayer decodes a
+ * stream.  Decoding pauses once any limit is reached.  Decoding further ahead
+ * can make playback smoother (e.g. with slow decoders), but uses more memory.
+ *
+ * @ingroup media
+ */
+struct SHAKA_EXPORT DecodeAheadPolicy final {
+  /** The number of seconds to decode ahead.  If 0, there is no limit. */
+  double seconds = 1;
+
+  /** The number of frames to decode ahead.  If 0, there is no limit. */
+  uint32_t frames = 0;
+
+  /**
+   * The number of bytes of decoded frames to keep.  If this is 0, the limit is
+   * based on the amount of physical memory on the device.
+   */
+  uint64_t bytes = 0;
+};
+
 /**
  * Defines the default MediaPlayer implementation.  This handles the current
  * time tracking and defines interfaces to swap out decryption (through EME
@@ -44,6 +68,19 @@ class SHAKA_EXPORT DefaultMediaPlayer final : public ProxyMediaPlayer {
    */
   DefaultMediaPlayer(VideoRenderer* video_renderer,
                      AudioRenderer* audio_renderer);
+
+  /**
+   * Creates a new DefaultMediaPlayer instance that uses the given objects to
+   * render the full-frames.  The built-in decoders (if used) are created with
+   * the given options.
+   *
+   * @param video_renderer The renderer used to draw video frames.
+   * @param audio_renderer The renderer used to play audio frames.
+   * @param decoder_options The options used to create the built-in decoders.
+   */
+  DefaultMediaPlayer(VideoRenderer* video_renderer,
+                     AudioRenderer* audio_renderer,
+                     const DecoderOptions& decoder_options);
   ~DefaultMediaPlayer() override;
 
   /**
@@ -59,6 +96,182 @@ class SHAKA_EXPORT DefaultMediaPlayer final : public ProxyMediaPlayer {
    */
   void SetDecoders(Decoder* video_decoder, Decoder* audio_decoder);
 
+  /**
+   * Sets how far ahead of the playhead each stream is decoded.  This can be
+   * changed at any time.  While the device is under memory pressure, these
+   * limits are reduced; see JsManager::SetMemoryPressure.
+   *
+   * By default, video is decoded 1 second ahead and audio is decoded 3 seconds
+   * ahead.
+   *
+   * @param video The policy for decoding video frames.
+   * @param audio The policy for decoding audio frames.
+   */
+  void SetDecodeAheadPolicy(const DecodeAheadPolicy& video,
+                            const DecodeAheadPolicy& audio);
+
+  /**
+   * Sets the priority of this player's work on the WorkerPool given in the
+   * DecoderOptions.  When the pool is busy, work from players with a higher
+   * priority runs first; for example, an app showing many players can give the
+   * focused player a higher priority.  This can be changed at any time and is
+   * ignored if there isn't a pool.  The default priority is 0.
+   *
+   * @param priority The priority of this player.
+   */
+  void SetWorkerPriority(int priority);
+
+  /**
+   * Sets whether to tune the pipeline for low-latency live streams.  In this
+   * mode, playback starts and resumes with less content buffered ahead of the
+   * playhead and fewer decoded frames are kept behind it.  Apps should also
+   * lower the decode-ahead policy and the audio renderer's buffer size (e.g.
+   * SdlAudioRenderer::SetBufferSize) to match.  This can be changed at any
+   * time.
+   *
+   * @param low_latency Whether to use low-latency mode.
+   */
+  void SetLowLatencyMode(bool low_latency);
+
+  /**
+   * Sets whether the audio device is the master clock.  By default, the
+   * current time advances with the system clock and the audio renderer
+   * inserts silence or drops audio to stay in sync with it.  When enabled,
+   * the current time follows the audio the device is playing (see
+   * AudioRenderer::GetDeviceTime) while it is playing, and video is synced to
+   * that.  This avoids audio glitches on devices whose audio clock deviates
+   * from the system clock.  The system clock is still used when there is no
+   * audio or it can't be played (e.g. at unsupported playback rates).  This
+   * has no effect on src= playback and can be changed at any time.
+   *
+   * @param enabled Whether to use the audio device as the master clock.
+   */
+  void SetAudioMasterClock(bool enabled);
+
+  /**
+   * Sets how many seconds of decoded frames are kept behind the playhead.  A
+   * seek that lands in these frames (e.g. a short scrub backwards) resumes
+   * right away without decoding them again.  Keeping more frames uses more
+   * memory, especially for video.  In low-latency mode, at most 0.25 seconds
+   * are kept.  This can be changed at any time; the default is 1 second.
+   *
+   * @param seconds The number of seconds to keep.
+   */
+  void SetRetainBehind(double seconds);
+
+  /**
+   * Sets whether video decoding is suspended, for example when the app is in
+   * the background and only audio is playing.  While suspended, video frames
+   * aren't decoded or rendered, the frames already decoded are freed, and
+   * playback only waits for audio.  When resumed, video decoding starts from
+   * the keyframe before the playhead.  Apps should also use
+   * JsManager::SetTimerSlack to reduce JavaScript wakeups while hidden.  This
+   * has no effect on src= playback and can be changed at any time.
+   *
+   * @param suspended Whether to suspend video.
+   */
+  void SetVideoSuspended(bool suspended);
+
+  /**
+   * Sets whether this player is preloading the next asset in the background.
+   * An app can create a second Player with its own DefaultMediaPlayer, load
+   * the next asset paused while the current one plays, then swap it in when
+   * the current asset ends.  While preloading, only the first frames are
+   * decoded, the decoders run at a lower priority than the app's priority, and
+   * audio isn't sent to the audio renderer.  Stop preloading when the player
+   * is shown.  This has no effect on src= playback and can be changed at any
+   * time.
+   *
+   * The amount of encoded content buffered is controlled by the Player's
+   * streaming configuration (e.g. a small bufferingGoal).
+   *
+   * @param preloading Whether this player is preloading.
+   * @param memory_cap The number of bytes of decoded frames to keep for each
+   *   stream while preloading, or 0 to use the decode-ahead policy's limit.
+   */
+  void SetPreloading(bool preloading, uint64_t memory_cap = 0);
+
+  /**
+   * Gets how long ago the content at the current time was appended, in
+   * seconds.  For live streams, this is the latency the media pipeline adds
+   * between appending content and presenting it.  This only tracks content
+   * appended to the end of the buffer since the last seek.
+   *
+   * @return The latency in seconds, or NAN if unknown.
+   */
+  double AppendToPresentLatency() const;
+
+  /**
+   * Adds a segment of a trick-play (I-frame only) video stream to use for scrub
+   * previews.  The app fetches the segments (e.g. from the I-frame playlist of
+   * an HLS stream) and passes them here; the keyframes in them are decoded
+   * into thumbnails when GetThumbnail asks for them.  The decoding runs in the
+   * background at a lower priority than playback, with a single thread, at a
+   * reduced quality, and with a CPU limit (see SetThumbnailLimits).
+   * Encrypted frames are ignored.
+   *
+   * @param mime The full MIME type of the segment.
+   * @param timestamp_offset The number of seconds to move the timestamps
+   *   forward.
+   * @param data The segment data; this is copied.
+   * @param size The number of bytes in |data|.
+   * @return False if the MIME type isn't supported.
+   */
+  bool AppendThumbnailSegment(const std::string& mime, double timestamp_offset,
+                              const uint8_t* data, size_t size);
+
+  /**
+   * Gets the thumbnail for the keyframe at or before the given time.  If that
+   * thumbnail hasn't been decoded yet, it is queued to be decoded and the
+   * closest thumbnail that was decoded is returned instead; call this again
+   * (e.g. on the next scrub update) to get it.
+   *
+   * @param time The time, in seconds, to get the thumbnail for.
+   * @return The thumbnail, or nullptr if none are available yet.
+   */
+  std::shared_ptr<DecodedFrame> GetThumbnail(double time);
+
+  /**
+   * Sets the limits of the thumbnail decoding.  By default, 16 thumbnails are
+   * kept and the decoding uses at most a quarter of a CPU core.
+   *
+   * @param cache_size The number of decoded thumbnails to keep; the least
+   *   recently used ones are removed.
+   * @param cpu_limit The fraction of a CPU core the decoding can use.
+   */
+  void SetThumbnailLimits(size_t cache_size, double cpu_limit);
+
+  /** Removes the thumbnail segments and the decoded thumbnails. */
+  void ClearThumbnails();
+
+  /**
+   * Starts loading the given src= asset in the background so it starts faster
+   * when it is played.  On iOS, this loads the playlist and track info of an
+   * AVURLAsset, which is then used when the same URL is loaded.  A few assets
+   * are kept, including the last one played so replaying it is fast.  This
+   * has no effect on other platforms.
+   *
+   * @param src The URL of the asset.
+   */
+  void PreloadSource(const std::string& src);
+
+  /**
+   * Sets how far ahead of the playhead to buffer for src= playback, in
+   * seconds.  On iOS, this sets the AVPlayerItem's
+   * preferredForwardBufferDuration; 0 lets AVPlayer choose.  This has no
+   * effect on MSE playback, which uses the Player's streaming configuration,
+   * and can be changed at any time.
+   */
+  void SetSourceForwardBufferDuration(double seconds);
+
+  /**
+   * Sets the maximum bitrate to use for src= playback (e.g. native HLS), in
+   * bits per second.  On iOS, this sets the AVPlayerItem's
+   * preferredPeakBitRate; 0 removes the limit.  This has no effect on MSE
+   * playback and can be changed at any time.
+   */
+  void SetSourcePeakBitRate(double bits_per_second);
+
   /**
    * Gets the iOS CALayer that is used to draw native src= content.  The
    * returned value has been retained and should use CFBridgingRelease to
@@ -0,0 +1,88 @@
+// Copyright 2020 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     https://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef SHAKA_EMBEDDED_MEDIA_FRAME_SNAPSHOT_H_
+#define SHAKA_EMBEDDED_MEDIA_FRAME_SNAPSHOT_H_
+
+#include <stdint.h>
+
+#include <functional>
+#include <memory>
+#include <vector>
+
+#include "../macros.h"
+#include "frames.h"
+
+namespace shaka {
+namespace media {
+
+/**
+ * Holds a copy of a video frame converted to RGBA.
+ *
+ * @ingroup media
+ */
+class SHAKA_EXPORT FrameSnapshot final {
+ public:
+  FrameSnapshot(double pts, uint32_t width, uint32_t height);
+  ~FrameSnapshot();
+
+  SHAKA_NON_COPYABLE_OR_MOVABLE_TYPE(FrameSnapshot);
+
+  /** The presentation time of the frame, in seconds. */
+  const double pts;
+  /** The width of the image, in pixels. */
+  const uint32_t width;
+  /** The height of the image, in pixels. */
+  const uint32_t height;
+
+  /**
+   * The pixel data.  Each pixel is four bytes in R-G-B-A order and the rows
+   * have no padding, so each row is @a width * 4 bytes.
+   */
+  std::vector<uint8_t> pixels;
+};
+
+/**
+ * Called with the result of a snapshot, or with nullptr if there was no frame
+ * or it couldn't be converted.
+ */
+using SnapshotCallback = std::function<void(std::shared_ptr<FrameSnapshot>)>;
+
+/**
+ * Converts the given video frame to RGBA.  This supports the 8-bit and 10-bit
+ * YUV 4:2:0 formats and RGB24; hardware frames and app-defined formats aren't
+ * supported.
+ *
+ * @param frame The frame to convert.
+ * @return The converted image, or nullptr if the format isn't supported.
+ */
+SHAKA_EXPORT std::shared_ptr<FrameSnapshot> ConvertFrameToRgba(
+    const DecodedFrame& frame);
+
+/**
+ * Converts the given video frame to RGBA on a background thread.  The frame
+ * is kept alive until the conversion is done, so this can be given the frame
+ * that is being drawn without blocking the drawing or the decoder.
+ *
+ * @param frame The frame to convert.
+ * @param callback The callback to call with the result.  This is called on
+ *   the background thread.
+ */
+SHAKA_EXPORT void TakeFrameSnapshot(std::shared_ptr<DecodedFrame> frame,
+                                    SnapshotCallback callback);
+
+}  // namespace media
+}  // namespace shaka
+
+#endif  // SHAKA_EMBEDDED_MEDIA_FRAME_SNAPSHOT_H_
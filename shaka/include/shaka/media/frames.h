@@ -88,6 +88,33 @@ enum class PixelFormat : uint8_t {
    */
   VideoToolbox,
 
+  /**
+   * Planar YUV 4:2:0, 15bpp, using 10 bits per component.  This is FFmpeg's
+   * AV_PIX_FMT_YUV420P10LE.
+   *
+   * This is laid out like YUV420P, except each component is a little-endian
+   * 16-bit value holding 10 bits of data in the low bits.
+   */
+  YUV420P10,
+
+  /**
+   * Planar YUV 4:2:0, 15bpp, using interleaved U/V components and 10 bits per
+   * component.  This is FFmpeg's AV_PIX_FMT_P010LE.
+   *
+   * This is laid out like NV12, except each component is a little-endian
+   * 16-bit value holding 10 bits of data in the high bits.
+   */
+  P010,
+
+  /**
+   * A frame in protected memory that the CPU can't read, from a secure
+   * hardware decoder.  @a data[0] will contain the platform handle to the
+   * surface.  These frames can't be converted or drawn by this library; the
+   * app's VideoRenderer needs to present them directly (e.g. on a hardware
+   * video plane).
+   */
+  SecureSurface,
+
   /**
    * Apps can define custom pixel formats and use any values above 128.  This
    * library doesn't care about the PixelFormat outside of the Decoder and the
@@ -143,6 +170,16 @@ enum class SampleFormat : uint8_t {
   /** Planar 64-bit floats. */
   PlanarDouble,
 
+  /**
+   * IEC 61937 bursts of compressed audio (e.g. AC-3 or E-AC-3), carried as
+   * packed signed 16-bit stereo samples in little-endian order.  The audio
+   * sink decodes the bursts, so the samples must be sent to it unchanged; the
+   * volume can't be applied and the audio can't be time-stretched.  The
+   * frame's StreamInfo gives the sample rate the bursts play at.  These are
+   * produced by Decoder::CreatePassthroughDecoder.
+   */
+  Iec61937,
+
   /**
    * Apps can define custom sample formats and use any values above 128.  This
    * library doesn't care about the SampleFormat outside of the Decoder and the
@@ -271,6 +308,9 @@ class SHAKA_EXPORT EncodedFrame : public BaseFrame {
   size_t EstimateSize() const override;
 
  private:
+  // This uses |impl_| to find its frames without RTTI.
+  friend class SegmentEncodedFrame;
+
   class Impl;
   std::unique_ptr<Impl> impl_;
 };
@@ -325,6 +365,13 @@ class SHAKA_EXPORT DecodedFrame : public BaseFrame {
   const variant<PixelFormat, SampleFormat> format;
 
 
+  /**
+   * Gets the color and HDR metadata of this video frame.  The default uses
+   * the metadata of the stream; decoders can override this with metadata
+   * found in the bitstream, which can change from frame to frame.
+   */
+  virtual HdrMetadata GetHdrMetadata() const;
+
   size_t EstimateSize() const override;
 
  private:
@@ -0,0 +1,114 @@
+// Copyright 2020 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     https://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef SHAKA_EMBEDDED_MEDIA_MEDIA_ALLOCATOR_H_
+#define SHAKA_EMBEDDED_MEDIA_MEDIA_ALLOCATOR_H_
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "../macros.h"
+
+namespace shaka {
+namespace media {
+
+/**
+ * The kinds of large media buffers the library allocates.
+ *
+ * @ingroup media
+ */
+enum class MediaAllocationCategory : uint8_t {
+  /** Downloaded data (e.g. segments) that is waiting to be appended. */
+  Network,
+  /** Demuxed frames that are waiting to be decoded. */
+  EncodedFrame,
+  /** Decoded video frames. */
+  DecodedFrame,
+};
+
+/**
+ * Defines an interface to allocate the large buffers that hold media.  By
+ * default, these come from the normal heap.  Apps can register their own
+ * allocator with JsManager::SetMediaAllocator, for example to allocate the
+ * buffers from a memory pool that a hardware decoder can read directly.
+ *
+ * This is only used for new buffers; buffers that were allocated before the
+ * allocator was changed are freed with the allocator they came from, so an
+ * allocator must outlive every buffer allocated from it.
+ *
+ * The methods can be called from any thread, so they must be thread-safe.
+ *
+ * @ingroup media
+ */
+class SHAKA_EXPORT MediaAllocator {
+ public:
+  /**
+   * The minimum alignment of every buffer, in bytes.  This is enough for SIMD
+   * instructions and for FFmpeg.
+   */
+  static constexpr const size_t kAlignment = 64;
+
+  /** Statistics about the buffers of one category. */
+  struct Stats final {
+    /** The number of bytes currently allocated. */
+    uint64_t current_bytes = 0;
+    /** The most bytes that were allocated at once. */
+    uint64_t peak_bytes = 0;
+    /** The number of buffers currently allocated. */
+    uint64_t current_buffers = 0;
+    /** The total number of buffers that were allocated. */
+    uint64_t total_allocations = 0;
+    /** The number of allocations that failed. */
+    uint64_t failed_allocations = 0;
+  };
+
+  MediaAllocator();
+  virtual ~MediaAllocator();
+
+  SHAKA_NON_COPYABLE_OR_MOVABLE_TYPE(MediaAllocator);
+
+  /**
+   * Allocates a new buffer.
+   *
+   * @param size The number of bytes to allocate; this is never 0.
+   * @param alignment The alignment the buffer must have.  This is a power of
+   *   two and at least kAlignment.
+   * @param category The kind of data the buffer will hold.
+   * @return The new buffer, or nullptr on failure.
+   */
+  virtual void* Allocate(size_t size, size_t alignment,
+                         MediaAllocationCategory category) = 0;
+
+  /**
+   * Frees a buffer that was returned from Allocate.
+   *
+   * @param buffer The buffer to free.
+   * @param size The size that was given to Allocate.
+   * @param category The category that was given to Allocate.
+   */
+  virtual void Free(void* buffer, size_t size,
+                    MediaAllocationCategory category) = 0;
+
+  /**
+   * Gets the statistics about the buffers of the given category.  This
+   * includes buffers from every allocator.  This can be called from any
+   * thread.
+   */
+  static Stats GetStats(MediaAllocationCategory category);
+};
+
+}  // namespace media
+}  // namespace shaka
+
+#endif  // SHAKA_EMBEDDED_MEDIA_MEDIA_ALLOCATOR_H_
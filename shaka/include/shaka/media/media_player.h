@@ -153,6 +153,45 @@ struct SHAKA_EXPORT VideoPlaybackQuality {
 
   /** The number of video frames that have been corrupted. */
   uint32_t corrupted_video_frames;
+
+  /**
+   * When frames are selected for each vsync, the number of vsyncs where a
+   * frame was shown longer than its cadence called for (e.g. the fourth vsync
+   * of a 24fps frame on a 60Hz display).
+   */
+  uint32_t repeated_vsyncs;
+
+  /**
+   * When frames are selected for each vsync, the number of times the cadence
+   * was broken to match the playback clock, e.g. by skipping a frame.
+   */
+  uint32_t cadence_breaks;
+
+  /**
+   * The number of video frames the app reported as shown on the display.  This
+   * and the fields below are only updated when the app calls
+   * VideoRenderer::OnFramePresented.
+   */
+  uint32_t presented_video_frames;
+
+  /**
+   * The number of presented video frames that were shown after the time the
+   * next frame should have been shown.
+   */
+  uint32_t late_video_frames;
+
+  /**
+   * The average difference, in seconds, between the playback time when a
+   * frame was shown and the frame's timestamp; positive values mean video is
+   * shown after the matching audio.
+   */
+  double av_sync_offset;
+
+  /**
+   * The average time, in seconds, between selecting a frame and it being shown
+   * that is being compensated for when selecting frames.
+   */
+  double render_latency;
 };
 
 
@@ -189,7 +228,9 @@ class SHAKA_EXPORT MediaPlayer {
    * any thread and can be called concurrently on multiple threads.
    *
    * These are called synchronously with a lock held on the MediaPlayer, so
-   * you can't call back into the MediaPlayer instance from a callback.
+   * you can't call back into the MediaPlayer instance from a callback.  Clients
+   * added with AddAsyncClient are instead called on their own thread, without
+   * any locks held.
    */
   class SHAKA_EXPORT Client {
    public:
@@ -314,6 +355,23 @@ class SHAKA_EXPORT MediaPlayer {
     ~ClientList() override;
 
     void AddClient(Client* client);
+
+    /**
+     * Adds a client that is called on its own thread.  Events are queued for
+     * the client, so the thread raising the event never waits on it.  Queued
+     * state changes of the same kind (ready state, playback state, and
+     * playback rate) are merged, so the client only sees the overall change;
+     * changes that cancel out aren't delivered at all.
+     *
+     * OnUserEvent is still called synchronously since its data is only valid
+     * during the call.
+     */
+    void AddAsyncClient(Client* client);
+
+    /**
+     * Removes the given client.  Once this returns, the client won't be called
+     * again; any events still queued for an async client are dropped.
+     */
     void RemoveClient(Client* client);
 
     void OnAddAudioTrack(std::shared_ptr<MediaTrack> track) override;
@@ -395,6 +453,13 @@ class SHAKA_EXPORT MediaPlayer {
    */
   virtual void AddClient(Client* client) const = 0;
 
+  /**
+   * Adds a new client listener that is called on its own thread, so slow
+   * clients don't hold up playback; see ClientList::AddAsyncClient.  By
+   * default, this just calls AddClient.
+   */
+  virtual void AddAsyncClient(Client* client) const;
+
   /**
    * Removes a client listener.  The given client will no longer be called when
    * events happen.
@@ -408,6 +473,15 @@ class SHAKA_EXPORT MediaPlayer {
    */
   virtual std::vector<BufferedRange> GetBuffered() const = 0;
 
+  /**
+   * Gets a number that changes every time the buffered ranges change.  This
+   * allows callers to avoid calling GetBuffered when nothing changed.  The
+   * numbers are never reused, even between different players.  The default
+   * returns 0, which means the changes aren't tracked and GetBuffered must
+   * always be called.
+   */
+  virtual uint64_t GetBufferedVersion() const;
+
   /** @return The current VideoReadyState of the media. */
   virtual VideoReadyState ReadyState() const = 0;
 
@@ -34,6 +34,12 @@ namespace media {
  * Instead, subclasses should use the GetClientList method and call methods
  * on that.
  *
+ * While one MediaPlayer is playing, another can be prepared in the background
+ * and then take over playback (a "handoff"), for example to switch between
+ * native HLS and MSE playback mid-session.  Subclasses that support this
+ * should have each MediaPlayer fire its events to a BackendClient so events
+ * from the MediaPlayer that isn't active are dropped.
+ *
  * @ingroup media
  */
 class SHAKA_EXPORT ProxyMediaPlayer : public MediaPlayer {
@@ -43,8 +49,10 @@ class SHAKA_EXPORT ProxyMediaPlayer : public MediaPlayer {
 
   struct VideoPlaybackQuality VideoPlaybackQuality() const override;
   void AddClient(Client* client) const override;
+  void AddAsyncClient(Client* client) const override;
   void RemoveClient(Client* client) const override;
   std::vector<BufferedRange> GetBuffered() const override;
+  uint64_t GetBufferedVersion() const override;
   VideoReadyState ReadyState() const override;
   VideoPlaybackState PlaybackState() const override;
 
@@ -75,15 +83,102 @@ class SHAKA_EXPORT ProxyMediaPlayer : public MediaPlayer {
                             eme::Implementation* implementation) override;
   void Detach() override;
 
+  /**
+   * Prepares a src= MediaPlayer to take over playback from the current one,
+   * without interrupting the current one.  The new MediaPlayer loads |src|
+   * paused and muted, starting at |start_time|, and its events aren't fired
+   * until CompleteHandoff is called.  It must be a different MediaPlayer from
+   * the current one (e.g. when going from MSE to native HLS).  This replaces
+   * any MediaPlayer that was already prepared.
+   *
+   * @param src The URL to pull data from.
+   * @param start_time The time the handoff is expected to happen at.
+   * @return True on success, false on error or if it isn't supported.
+   */
+  bool PrepareSourceHandoff(const std::string& src, double start_time);
+
+  /**
+   * Prepares an MSE MediaPlayer to take over playback from the current one.
+   * This is like PrepareSourceHandoff, except the app needs to add content to
+   * it; while it is prepared, the AddMseBuffer, LoadedMetaData, and
+   * MseEndOfStream calls go to it instead of the current MediaPlayer.
+   *
+   * @param start_time The time the handoff is expected to happen at.
+   * @return True on success, false on error or if it isn't supported.
+   */
+  bool PrepareMseHandoff(double start_time);
+
+  /**
+   * Switches playback to the prepared MediaPlayer.  It continues from the
+   * current time (only seeking if it isn't already there) with the current
+   * playback rate, volume, and play/pause state, then the old MediaPlayer is
+   * detached.  The renderers of the new MediaPlayer stay attached.  If the
+   * ready or playback states differ, the state change events are fired.
+   *
+   * @return False if there isn't a prepared MediaPlayer.
+   */
+  bool CompleteHandoff();
+
+  /** Detaches the prepared MediaPlayer without switching to it. */
+  void CancelHandoff();
+
  protected:
+  /**
+   * Forwards the events of a single MediaPlayer to the ClientList of a
+   * ProxyMediaPlayer, but only while that MediaPlayer is the active one (or
+   * while no MediaPlayer is active).  The MediaPlayer should be given its own
+   * ClientList that this is added to.
+   */
+  class SHAKA_EXPORT BackendClient final : public Client {
+   public:
+    BackendClient(const ProxyMediaPlayer* proxy, const MediaPlayer* backend);
+    ~BackendClient() override;
+
+    SHAKA_NON_COPYABLE_OR_MOVABLE_TYPE(BackendClient);
+
+    void OnAddAudioTrack(std::shared_ptr<MediaTrack> track) override;
+    void OnRemoveAudioTrack(std::shared_ptr<MediaTrack> track) override;
+    void OnAddVideoTrack(std::shared_ptr<MediaTrack> track) override;
+    void OnRemoveVideoTrack(std::shared_ptr<MediaTrack> track) override;
+    void OnAddTextTrack(std::shared_ptr<TextTrack> track) override;
+    void OnRemoveTextTrack(std::shared_ptr<TextTrack> track) override;
+    void OnReadyStateChanged(VideoReadyState old_state,
+                             VideoReadyState new_state) override;
+    void OnPlaybackStateChanged(VideoPlaybackState old_state,
+                                VideoPlaybackState new_state) override;
+    void OnPlaybackRateChanged(double old_rate, double new_rate) override;
+    void OnError(const std::string& error) override;
+    void OnAttachMse() override;
+    void OnAttachSource() override;
+    void OnDetach() override;
+    void OnPlay() override;
+    void OnSeeking() override;
+    void OnWaitingForKey() override;
+    void OnUserEvent(const std::string& name, void* user_data) override;
+
+   private:
+    bool IsActive() const;
+
+    const ProxyMediaPlayer* const proxy_;
+    const MediaPlayer* const backend_;
+  };
+
   /** @return The current ClientList used to fire events. */
   ClientList* GetClientList() const;
 
+  /**
+   * @return The MediaPlayer that is currently used for playback, or nullptr.
+   *   This doesn't include a MediaPlayer prepared for a handoff.
+   */
+  const MediaPlayer* GetActivePlayer() const;
+
  private:
   /**
    * Gets a MediaPlayer implementation that is used to play MSE content.  It is
    * expected the state has been reset to the default and the returned object
-   * will live until this object is destroyed or until a call to Detach.
+   * will live until this object is destroyed or until a call to Detach.  This
+   * is also called to prepare a handoff while another MediaPlayer is active;
+   * return null if the MSE MediaPlayer is the active one.
    *
    * @return The resulting MediaPlayer implementation, or null on error or if it
    *   isn't supported.
@@ -94,7 +189,9 @@ class SHAKA_EXPORT ProxyMediaPlayer : public MediaPlayer {
    * Gets a MediaPlayer implementation that is used to play the given content.
    * This is only called for src= playback.  It is expected the state
    * has been reset to the default and the returned object will live until this
-   * object is destroyed or until a call to Detach.
+   * object is destroyed or until a call to Detach.  This is also called to
+   * prepare a handoff while another MediaPlayer is active; return null if the
+   * src= MediaPlayer is the active one.
    *
    * @param src The URL to pull data from.
    * @return The resulting MediaPlayer implementation, or null on error or if it
@@ -103,6 +200,7 @@ class SHAKA_EXPORT ProxyMediaPlayer : public MediaPlayer {
   virtual MediaPlayer* CreateSource(const std::string& src) = 0;
 
   void SetFields(MediaPlayer* player);
+  bool PrepareHandoff(MediaPlayer* player, bool is_mse, double start_time);
 
   class Impl;
   std::unique_ptr<Impl> impl_;
@@ -15,7 +15,10 @@
 #ifndef SHAKA_EMBEDDED_MEDIA_RENDERER_H_
 #define SHAKA_EMBEDDED_MEDIA_RENDERER_H_
 
+#include <vector>
+
 #include "../macros.h"
+#include "frames.h"
 #include "streams.h"
 #include "media_player.h"
 
@@ -79,6 +82,19 @@ class SHAKA_EXPORT AudioRenderer : public Renderer {
 
   /** Sets whether the audio is muted. */
   virtual void SetMuted(bool muted) = 0;
+
+  /**
+   * Gets the media time of the audio the device is playing now, based on the
+   * device's played position rather than the wall clock.  This is used as the
+   * master clock when enabled with DefaultMediaPlayer::SetAudioMasterClock.
+   * This is called from many threads, often several times per frame, so it
+   * must not block.  The default gives false.
+   *
+   * @param time Will be set to the media time, in seconds.
+   * @return Whether the time is known; this is false when the device isn't
+   *   playing.
+   */
+  virtual bool GetDeviceTime(double* time) const;
 };
 
 /**
@@ -92,6 +108,35 @@ class SHAKA_EXPORT VideoRenderer : public Renderer {
 
   /** @see MediaPlayer::SetVideoFillMode */
   virtual bool SetVideoFillMode(VideoFillMode mode) = 0;
+
+  /**
+   * Gets the largest size, in pixels, that video frames need to be decoded at.
+   * When the video is drawn much smaller than it is encoded, the decoder can
+   * use this to output smaller frames; see Decoder::SetMaxOutputSize.  The
+   * default gives 0x0, which means frames are decoded at their full size.
+   */
+  virtual void GetMaxFrameSize(uint32_t* width, uint32_t* height) const;
+
+  /**
+   * Gets the pixel formats this renderer can draw without converting them,
+   * most preferred first.  The decoder uses this to pick its output format so
+   * frames are converted at most once, on the decode thread, instead of when
+   * they are drawn; see Decoder::SetPreferredPixelFormats.  The default is
+   * empty, which means the decoder should output whatever is natural for it.
+   */
+  virtual std::vector<PixelFormat> GetPreferredPixelFormats() const;
+
+  /**
+   * Called by the app once the frame it last rendered is actually shown on the
+   * display (e.g. after SDL_RenderPresent returns or from a Metal drawable's
+   * presented handler).  This is used to measure and compensate for the
+   * rendering latency and to track late frames in VideoPlaybackQuality.  The
+   * default does nothing.
+   *
+   * @param age The time, in seconds, since the frame was shown; 0 if it was
+   *   just shown.
+   */
+  virtual void OnFramePresented(double age);
 };
 
 }  // namespace media
@@ -45,6 +45,26 @@ class SHAKA_EXPORT SdlAudioRenderer final : public AudioRenderer {
    */
   static std::vector<std::string> ListDevices();
 
+  /**
+   * Sets how many seconds of audio are written to the audio device ahead of
+   * the current time.  Smaller values need less audio to be decoded ahead,
+   * which helps low-latency live streams, but are more likely to run out of
+   * audio if the app is busy.  The default is 2 seconds.
+   *
+   * @param seconds The number of seconds to buffer.
+   */
+  void SetBufferSize(double seconds);
+
+  /**
+   * Sets whether to open the audio device and fill it with audio while the
+   * player is paused.  When the player plays, the audio starts right away
+   * instead of waiting for the device to open and fill.  This keeps the audio
+   * device open while paused.  This is off by default.
+   *
+   * @param preroll Whether to pre-roll the audio while paused.
+   */
+  void SetPrerollWhilePaused(bool preroll);
+
   void SetPlayer(const MediaPlayer* player) override;
   void Attach(const DecodedStream* stream) override;
   void Detach() override;
@@ -0,0 +1,138 @@
+// Copyright 2020 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     https://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef SHAKA_EMBEDDED_MEDIA_SDL_MULTIVIEW_RENDERER_H_
+#define SHAKA_EMBEDDED_MEDIA_SDL_MULTIVIEW_RENDERER_H_
+
+#include <stddef.h>
+
+#include <memory>
+
+#include "../macros.h"
+#include "renderer.h"
+
+struct SDL_Rect;
+struct SDL_Renderer;
+
+namespace shaka {
+namespace media {
+
+/**
+ * Defines a renderer that draws the video of several players into one SDL
+ * window, for example a mosaic of channels.  Each player is given one of the
+ * tiles as its VideoRenderer.  All the tiles are composited into a single
+ * render-target texture, which is copied to the window once per Render call,
+ * so the app only needs one present for all the videos.  A tile is only drawn
+ * into the composited texture when its frame changes, and all the tiles pick
+ * their frames for the same time, so they advance together.
+ *
+ * Frames are decoded and uploaded at the size of their tile (see
+ * SdlManualVideoRenderer::SetScaleToDisplaySize), except for the focused tile,
+ * which is decoded at its full size and uploaded before the others.  Apps
+ * using a WorkerPool should also give the focused player a higher priority
+ * with DefaultMediaPlayer::SetWorkerPriority.
+ *
+ * If the renderer doesn't support render targets, the tiles are drawn to the
+ * window directly on every call to Render.
+ *
+ * @ingroup media
+ */
+class SHAKA_EXPORT SdlMultiviewRenderer final {
+ public:
+  /**
+   * Creates a new renderer that draws using the given renderer.
+   *
+   * @param renderer The renderer used to create textures.  If not given, apps
+   *   must call SetRenderer before calling Render.
+   */
+  explicit SdlMultiviewRenderer(SDL_Renderer* renderer = nullptr);
+  ~SdlMultiviewRenderer();
+
+  SHAKA_NON_COPYABLE_OR_MOVABLE_TYPE(SdlMultiviewRenderer);
+
+  /**
+   * Sets the renderer used to create textures.  This invalidates all the
+   * textures, so this should also be called (with the same renderer) after SDL
+   * reports that render targets were reset.
+   *
+   * @param renderer The renderer used to create textures.
+   */
+  void SetRenderer(SDL_Renderer* renderer);
+
+  /**
+   * Adds a new tile that draws to the given region of the window.  The tile
+   * lives as long as this object.
+   *
+   * @param region The region of the window to draw the tile to.
+   * @return The index of the new tile.
+   */
+  size_t AddTile(const SDL_Rect& region);
+
+  /** @return The number of tiles. */
+  size_t TileCount() const;
+
+  /**
+   * @return The VideoRenderer for the given tile, to give to the player, or
+   *   nullptr if the index is invalid.
+   */
+  VideoRenderer* GetTile(size_t index) const;
+
+  /** Moves the given tile to a new region of the window. */
+  void SetTileRegion(size_t index, const SDL_Rect& region);
+
+  /**
+   * Sets the tile the user is focused on.  That tile is decoded at its full
+   * size and its frames are uploaded first.
+   */
+  void SetFocusedTile(size_t index);
+
+  /** Removes the focus from all the tiles. */
+  void ClearFocusedTile();
+
+  /**
+   * Draws the current frame of every tile to the renderer.  This covers the
+   * whole window, so the app should draw anything else on top afterwards and
+   * then present the renderer.
+   *
+   * @return The suggested delay, in seconds, before the next call to Render;
+   *   this is the shortest delay of all the tiles.
+   */
+  double Render();
+
+  /**
+   * Draws the frame of every tile that should be visible at the next vsync.
+   * This should be called once per vsync; see
+   * SdlManualVideoRenderer::RenderForVsync.
+   *
+   * @param vsync_delay The time, in seconds, until the frame will be shown.
+   * @param refresh_interval The time, in seconds, between vsyncs.
+   */
+  void RenderForVsync(double vsync_delay, double refresh_interval);
+
+  /**
+   * Uploads the next frame of every tile to a texture, starting with the
+   * focused tile.  This is optional and should be called after presenting,
+   * while waiting for the next call to Render.
+   */
+  void PrepareNextFrames();
+
+ private:
+  class Impl;
+  std::unique_ptr<Impl> impl_;
+};
+
+}  // namespace media
+}  // namespace shaka
+
+#endif  // SHAKA_EMBEDDED_MEDIA_SDL_MULTIVIEW_RENDERER_H_
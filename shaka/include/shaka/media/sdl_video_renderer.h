@@ -19,6 +19,7 @@
 #include <string>
 
 #include "../macros.h"
+#include "frame_snapshot.h"
 #include "renderer.h"
 
 struct SDL_Rect;
@@ -61,7 +62,8 @@ class SHAKA_EXPORT SdlManualVideoRenderer : public VideoRenderer {
 
   /**
    * Renders the current video frame to the given sub-region of the current
-   * renderer.
+   * renderer.  Calling OnFramePresented after SDL_RenderPresent lets this
+   * compensate for the time it takes frames to reach the display.
    *
    * @param region The region to draw the video to.  If not given, video will
    *   take up the entire window.
@@ -70,6 +72,49 @@ class SHAKA_EXPORT SdlManualVideoRenderer : public VideoRenderer {
    */
   double Render(const SDL_Rect* region = nullptr);
 
+  /**
+   * Renders the video frame that should be visible at the next vsync.  Unlike
+   * Render, this keeps a steady cadence of frames (e.g. 3:2 for 24fps content
+   * on a 60Hz display) instead of picking the frame closest to the current
+   * time, which avoids judder when the app's render loop jitters.  This should
+   * be called once per vsync.
+   *
+   * @param vsync_delay The time, in seconds, until the frame will be shown.
+   * @param refresh_interval The time, in seconds, between vsyncs.
+   * @param region The region to draw the video to.  If not given, video will
+   *   take up the entire window.
+   */
+  void RenderForVsync(double vsync_delay, double refresh_interval,
+                      const SDL_Rect* region = nullptr);
+
+  /**
+   * Uploads the frame after the one last rendered to a texture, so the next
+   * call to Render doesn't need to upload it.  This is optional and should be
+   * called after SDL_RenderPresent, while waiting for the next call to Render.
+   */
+  void PrepareNextFrame();
+
+  /**
+   * Converts the frame that was last rendered to RGBA on a background thread.
+   * This doesn't block rendering or decoding.
+   *
+   * @param callback The callback to call with the image, or with nullptr if
+   *   no frame has been rendered since the last seek.  This is called on a
+   *   background thread.
+   */
+  void TakeSnapshot(SnapshotCallback callback) const;
+
+  /**
+   * Sets whether to scale frames to the size they are drawn at.  When the
+   * video is drawn much smaller than it is encoded (e.g. picture-in-picture
+   * or multiview tiles), this tells the decoder to output smaller frames if
+   * it can, and downscales the frames by a power of two while uploading them
+   * otherwise.  This reduces the memory bandwidth used by each video, at the
+   * cost of some sharpness.  The frames are never made smaller than they are
+   * drawn.  This is off by default.
+   */
+  void SetScaleToDisplaySize(bool enabled);
+
 
   void SetPlayer(const MediaPlayer* player) override;
   void Attach(const DecodedStream* stream) override;
@@ -77,6 +122,9 @@ class SHAKA_EXPORT SdlManualVideoRenderer : public VideoRenderer {
 
   struct VideoPlaybackQuality VideoPlaybackQuality() const override;
   bool SetVideoFillMode(VideoFillMode mode) override;
+  void GetMaxFrameSize(uint32_t* width, uint32_t* height) const override;
+  std::vector<PixelFormat> GetPreferredPixelFormats() const override;
+  void OnFramePresented(double age) override;
 
  private:
   class Impl;
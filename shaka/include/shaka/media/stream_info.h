@@ -15,6 +15,8 @@
 #ifndef SHAKA_EMBEDDED_MEDIA_STREAM_INFO_H_
 #define SHAKA_EMBEDDED_MEDIA_STREAM_INFO_H_
 
+#include <stdint.h>
+
 #include <memory>
 #include <string>
 #include <vector>
@@ -25,6 +27,62 @@
 namespace shaka {
 namespace media {
 
+/**
+ * Defines the color and HDR metadata of a video stream or frame.  The color
+ * fields are ISO/IEC 23091-2 (H.273) code points, and the mastering display
+ * and light level fields use the units of SMPTE ST 2086 and CTA-861.3.  These
+ * are the values stored in the MP4 'colr', 'mdcv', and 'clli' boxes and in
+ * the codec's SEI messages, so they can be given to platform APIs as-is.
+ *
+ * @ingroup media
+ */
+struct SHAKA_EXPORT HdrMetadata {
+  /** The H.273 code point for "unspecified". */
+  static constexpr const uint8_t kUnspecified = 2;
+  /** The H.273 code point for BT.2020 primaries and (non-constant) matrix. */
+  static constexpr const uint8_t kBt2020 = 9;
+  /** The H.273 code point for the SMPTE ST 2084 (PQ) transfer, e.g. HDR10. */
+  static constexpr const uint8_t kTransferPq = 16;
+  /** The H.273 code point for the ARIB STD-B67 (HLG) transfer. */
+  static constexpr const uint8_t kTransferHlg = 18;
+
+  HdrMetadata();
+
+  /** The color primaries. */
+  uint8_t color_primaries;
+  /** The transfer characteristics (EOTF). */
+  uint8_t transfer_characteristics;
+  /** The matrix coefficients used to convert from YUV to RGB. */
+  uint8_t matrix_coefficients;
+  /** Whether the samples use the full range rather than the video range. */
+  bool full_range;
+
+  /** Whether the mastering display fields are set. */
+  bool has_mastering_display;
+  /**
+   * The CIE 1931 x and y coordinates of the mastering display's primaries in
+   * G, B, R order, in units of 0.00002.
+   */
+  uint16_t display_primaries_x[3];
+  uint16_t display_primaries_y[3];
+  /** The white point of the mastering display, in units of 0.00002. */
+  uint16_t white_point_x;
+  uint16_t white_point_y;
+  /** The luminance range of the mastering display, in units of 0.0001 nits. */
+  uint32_t max_display_mastering_luminance;
+  uint32_t min_display_mastering_luminance;
+
+  /** Whether the content light level fields are set. */
+  bool has_content_light_level;
+  /** The maximum content light level (MaxCLL), in nits. */
+  uint16_t max_content_light_level;
+  /** The maximum frame-average light level (MaxFALL), in nits. */
+  uint16_t max_frame_average_light_level;
+
+  /** @return Whether this uses an HDR transfer (PQ or HLG). */
+  bool IsHdr() const;
+};
+
 /**
  * Defines information about a stream; this is used to initialize decoders.
  *
@@ -37,7 +95,8 @@ class SHAKA_EXPORT StreamInfo {
              Rational<uint32_t> sample_aspect_ratio,
              const std::vector<uint8_t>& extra_data,
              uint32_t width, uint32_t height, uint32_t channel_count,
-             uint32_t sample_rate);
+             uint32_t sample_rate,
+             const HdrMetadata& hdr_metadata = HdrMetadata());
   virtual ~StreamInfo();
 
   SHAKA_NON_COPYABLE_OR_MOVABLE_TYPE(StreamInfo);
@@ -90,6 +149,12 @@ class SHAKA_EXPORT StreamInfo {
    */
   const uint32_t sample_rate;
 
+  /**
+   * If this is a video stream, this is the color and HDR metadata given by the
+   * container.  Frames may override this; see DecodedFrame::GetHdrMetadata.
+   */
+  const HdrMetadata hdr_metadata;
+
  private:
   class Impl;
   std::unique_ptr<Impl> impl_;
@@ -15,6 +15,7 @@
 #ifndef SHAKA_EMBEDDED_MEDIA_STREAMS_H_
 #define SHAKA_EMBEDDED_MEDIA_STREAMS_H_
 
+#include <functional>
 #include <memory>
 #include <type_traits>
 #include <vector>
@@ -32,6 +33,8 @@ enum class FrameLocation : uint8_t {
   Near,
   /** Locates the frame that starts after the given time. */
   After,
+  /** Locates the first keyframe that starts after the given time. */
+  KeyFrameAfter,
 };
 
 
@@ -105,6 +108,30 @@ class SHAKA_EXPORT StreamBase {
    */
   std::vector<BufferedRange> GetBufferedRanges() const;
 
+  /**
+   * Sets a callback that is called whenever the buffered ranges change (e.g.
+   * when frames are added or removed).  This replaces any existing callback;
+   * pass an empty function to remove it.  This doesn't change the frames, so
+   * it can be used on a const stream.
+   *
+   * The callback is called synchronously on the thread that changed the stream
+   * with the stream's lock held; so it must not use this stream and should
+   * return quickly.
+   */
+  void SetOnBufferedChanged(std::function<void()> on_buffered_changed) const;
+
+  /**
+   * Sets a callback that is called when Remove() removes frames, with the
+   * range that was passed to Remove().  This is called before the callback
+   * from SetOnBufferedChanged.  This replaces any existing callback; pass an
+   * empty function to remove it.
+   *
+   * Like SetOnBufferedChanged, the callback is called synchronously with the
+   * stream's lock held; so it must not use this stream and should return
+   * quickly.
+   */
+  void SetOnRemoved(std::function<void(double, double)> on_removed) const;
+
   /**
    * Estimates the size of the stream by adding up all the stored frames.
    * @return The estimated size of the stream, in bytes.
@@ -162,7 +189,15 @@ class SHAKA_EXPORT StreamBase {
    */
   void AddFrameInternal(std::shared_ptr<BaseFrame> frame);
 
+  /**
+   * Adds several frames to the stream.  This is the same as calling
+   * AddFrameInternal for each frame, but only locks the stream and updates
+   * the buffered ranges once.
+   */
+  void AddFramesInternal(const std::vector<std::shared_ptr<BaseFrame>>& frames);
+
  private:
+  void AddFrameLocked(std::shared_ptr<BaseFrame> frame);
   void DebugPrintLocked(bool all_frames) const;
   void AssertRangesSorted() const;
 
@@ -189,6 +224,12 @@ class SHAKA_EXPORT Stream : public StreamBase {
     AddFrameInternal(frame);
   }
 
+  /** @see StreamBase::AddFramesInternal */
+  void AddFrames(const std::vector<std::shared_ptr<T>>& frames) {
+    AddFramesInternal(
+        std::vector<std::shared_ptr<BaseFrame>>(frames.begin(), frames.end()));
+  }
+
   /** @see StreamBase::GetFrameInternal */
   std::shared_ptr<T> GetFrame(
       double time, FrameLocation kind = FrameLocation::After) const {
@@ -144,12 +144,41 @@ class SHAKA_EXPORT TextTrack {
    */
   double NextCueChangeTime(double time) const;
 
+  /**
+   * Gets the cues that started or stopped being displayed between two times.
+   * This allows a renderer to update the cues it is displaying rather than
+   * replacing them all.  This is based on the current list of cues, so a cue
+   * that was added or removed between the two times is not included unless
+   * its display changed.
+   *
+   * @param previous_time The media time the renderer last drew.
+   * @param time The current media time.
+   * @param added [OUT] Will contain the cues that are only active at @a time.
+   * @param removed [OUT] Will contain the cues that are only active at
+   *   @a previous_time.
+   */
+  void GetActiveCueChanges(double previous_time, double time,
+                           std::vector<std::shared_ptr<VTTCue>>* added,
+                           std::vector<std::shared_ptr<VTTCue>>* removed) const;
+
   /** Adds the provided cue to the list of cues in the text track. */
   virtual void AddCue(std::shared_ptr<VTTCue> cue);
 
   /** Removes the given cue from the list of cues. */
   virtual void RemoveCue(std::shared_ptr<VTTCue> cue);
 
+  /**
+   * Parses the given WebVTT text and adds its cues to the text track.  This
+   * allows adding subtitles without creating an object for each cue in
+   * JavaScript.
+   *
+   * @param data The WebVTT text, encoded in UTF-8.
+   * @param size The number of bytes in @a data.
+   * @param offset The time, in seconds, to add to each cue.
+   * @return True on success, false if the text isn't valid WebVTT.
+   */
+  bool AddWebVttCues(const uint8_t* data, size_t size, double offset = 0);
+
 
   /** Adds the given client to receive calls for events. */
   void AddClient(Client* client);
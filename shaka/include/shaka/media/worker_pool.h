@@ -0,0 +1,66 @@
+// Copyright 2020 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     https://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef SHAKA_EMBEDDED_MEDIA_WORKER_POOL_H_
+#define SHAKA_EMBEDDED_MEDIA_WORKER_POOL_H_
+
+#include <stddef.h>
+
+#include <memory>
+
+#include "../macros.h"
+
+namespace shaka {
+namespace media {
+
+class WorkerTask;
+
+/**
+ * Defines a pool of threads that can be shared between DefaultMediaPlayer
+ * instances.  By default, each player uses its own threads to decode content
+ * and to monitor the pipeline; when a pool is given in the DecoderOptions, that
+ * work is run on the pool instead.  This allows apps that show many players at
+ * once to keep the number of threads based on the number of cores.
+ *
+ * Work from players with a higher priority is run first; see
+ * DefaultMediaPlayer::SetWorkerPriority.
+ *
+ * @ingroup media
+ */
+class SHAKA_EXPORT WorkerPool final {
+ public:
+  /**
+   * Creates a new pool and starts its threads.
+   *
+   * @param thread_count The number of threads to use.  If 0, this uses one
+   *   thread per CPU core.
+   */
+  explicit WorkerPool(size_t thread_count = 0);
+  ~WorkerPool();
+
+  SHAKA_NON_COPYABLE_OR_MOVABLE_TYPE(WorkerPool);
+
+  /** @return The number of threads in the pool. */
+  size_t thread_count() const;
+
+ private:
+  friend class WorkerTask;
+  class Impl;
+  std::unique_ptr<Impl> impl_;
+};
+
+}  // namespace media
+}  // namespace shaka
+
+#endif  // SHAKA_EMBEDDED_MEDIA_WORKER_POOL_H_
@@ -15,6 +15,7 @@
 #ifndef SHAKA_EMBEDDED_NET_H_
 #define SHAKA_EMBEDDED_NET_H_
 
+#include <functional>
 #include <future>
 #include <memory>
 #include <string>
@@ -148,6 +149,15 @@ class SHAKA_EXPORT Response final {
   /** Sets the body of the response to a copy of the given data. */
   void SetDataCopy(const uint8_t* data, size_t size);
 
+  /**
+   * Sets the body of the response to the given data without copying it.  The
+   * data must remain valid until @a on_free is called, which happens once the
+   * response and any JavaScript buffers that refer to it are destroyed.  Note
+   * that JavaScript can write to the data.
+   */
+  void SetDataExternal(const uint8_t* data, size_t size,
+                       std::function<void()> on_free);
+
  private:
   friend class JsManager;
   friend class Player;
@@ -214,6 +224,33 @@ class SHAKA_EXPORT SchemePlugin {
                                                         Response* response) = 0;
 };
 
+/**
+ * A scheme plugin that serves local files for "file:" URIs.  The file is
+ * mapped into memory and the response refers to the mapping directly, so the
+ * data is only read from disk (or the page cache) as it is used, without an
+ * extra copy.  Requests with a single "Range: bytes=" header get only that part
+ * of the file.
+ *
+ * This isn't registered by default; to use it, register it with
+ * JsManager::RegisterNetworkScheme for the "file" scheme.  The object must
+ * outlive the registration.
+ *
+ * @ingroup player
+ */
+class SHAKA_EXPORT FileSchemePlugin final : public SchemePlugin {
+ public:
+  FileSchemePlugin();
+  ~FileSchemePlugin() override;
+
+  SHAKA_NON_COPYABLE_OR_MOVABLE_TYPE(FileSchemePlugin);
+
+  std::future<optional<Error>> OnNetworkRequest(const std::string& uri,
+                                                RequestType type,
+                                                const Request& request,
+                                                Client* client,
+                                                Response* response) override;
+};
+
 /**
  * Defines an interface for request/response filters.  These are used by Shaka
  * Player as part of making a network request.  These allow modifying the
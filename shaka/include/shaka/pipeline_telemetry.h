@@ -0,0 +1,127 @@
+// Copyright 2020 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     https://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef SHAKA_EMBEDDED_PIPELINE_TELEMETRY_H_
+#define SHAKA_EMBEDDED_PIPELINE_TELEMETRY_H_
+
+#include <stdint.h>
+
+#include <string>
+#include <vector>
+
+#include "macros.h"
+
+namespace shaka {
+
+/**
+ * Exposes counters about the threads and streams of the media pipeline.  This
+ * is always recorded and is cheap enough to leave on in production builds, so
+ * it can be polled periodically for fleet monitoring.
+ *
+ * The counters are global to the process; if there are multiple Player
+ * instances, the stream counters include the frames of all of them.  This can
+ * be called from any thread.
+ *
+ * @ingroup player
+ */
+class SHAKA_EXPORT PipelineTelemetry final {
+ public:
+  /** A summary of a histogram of durations. */
+  struct Histogram final {
+    /** The number of durations recorded. */
+    uint64_t count;
+    /** The average duration, in microseconds. */
+    double average_us;
+    /** The median duration, in microseconds, rounded up to a bucket bound. */
+    uint64_t p50_us;
+    /** The 99th percentile, in microseconds, rounded up to a bucket bound. */
+    uint64_t p99_us;
+    /** The longest duration, in microseconds. */
+    uint64_t max_us;
+    /**
+     * The number of durations in each bucket.  Bucket i counts durations
+     * under 2^i microseconds; the last bucket counts everything longer.
+     */
+    std::vector<uint64_t> buckets;
+  };
+
+  /** The counters for a single background thread. */
+  struct Thread final {
+    /** The name of the thread, e.g. "Decoder" or "Networking". */
+    std::string name;
+    /** The CPU time, in seconds, the thread has used since it started. */
+    double cpu_seconds;
+    /** The number of times the thread woke up after waiting for work. */
+    uint64_t wakeups;
+    /**
+     * How long work waited after being queued or woken until the thread
+     * started running it.
+     */
+    Histogram queue_latency;
+  };
+
+  /** The counters for a type of stream, e.g. "audio" or "video". */
+  struct Stream final {
+    /** The type of the stream. */
+    std::string name;
+    /** The number of frames added to the stream by the demuxer. */
+    uint64_t frames_demuxed;
+    /** The number of frames the decoder produced. */
+    uint64_t frames_decoded;
+    /** The number of decoded frames that were dropped before being shown. */
+    uint64_t frames_dropped;
+    /**
+     * The number of frames that weren't decoded since decoding was too far
+     * behind the playhead to show them.
+     */
+    uint64_t frames_skipped;
+    /** How long each call to the decoder took. */
+    Histogram decode_latency;
+  };
+
+  /** The counters for the pools that media frame objects are allocated from. */
+  struct FrameAllocations final {
+    /** The number of frame objects that were created. */
+    uint64_t frames_allocated;
+    /**
+     * The number of those that needed a new heap allocation since there
+     * wasn't a freed one to reuse.
+     */
+    uint64_t heap_allocations;
+  };
+
+  PipelineTelemetry() = delete;
+
+  /** @return The counters for the threads that currently exist. */
+  static std::vector<Thread> GetThreads();
+
+  /** @return The counters for the streams that have been played. */
+  static std::vector<Stream> GetStreams();
+
+  /**
+   * @return The frame allocation counters.  Polling these periodically gives
+   *   the allocation rate.
+   */
+  static FrameAllocations GetFrameAllocations();
+
+  /**
+   * Clears the wakeup, latency, frame, and allocation counters.  This doesn't
+   * change the CPU times.
+   */
+  static void Reset();
+};
+
+}  // namespace shaka
+
+#endif  // SHAKA_EMBEDDED_PIPELINE_TELEMETRY_H_
@@ -22,6 +22,7 @@
 #include <type_traits>
 #include <vector>
 
+#include "abr_manager.h"
 #include "async_results.h"
 #include "error.h"
 #include "js_manager.h"
@@ -73,6 +74,39 @@ class SHAKA_EXPORT Player final {
     virtual void OnBuffering(bool is_buffering);
   };
 
+  /**
+   * A snapshot of the commonly-polled Player state.  This is updated
+   * periodically on the JavaScript thread; see SetStateSnapshotInterval().
+   */
+  struct StateSnapshot final {
+    /** Whether this contains any data; this is false until the first update. */
+    bool valid = false;
+    /** Whether the Player is in a buffering state. */
+    bool is_buffering = false;
+    /** Whether the stream is live. */
+    bool is_live = false;
+    /** Whether the stream is audio-only. */
+    bool is_audio_only = false;
+    /** The currently seekable range. */
+    BufferedRange seek_range;
+    /** The current buffered ranges. */
+    BufferedInfo buffered_info;
+    /** The playback and adaptation stats. */
+    Stats stats;
+  };
+
+  /** The playback position of the attached MediaPlayer. */
+  struct PlaybackPosition final {
+    /** The current time, in seconds. */
+    double current_time = 0;
+    /** The duration of the content, in seconds. */
+    double duration = 0;
+    /** The current playback rate. */
+    double playback_rate = 0;
+    /** The current playback state. */
+    media::VideoPlaybackState state = media::VideoPlaybackState::Detached;
+  };
+
   /**
    * Creates a new Player instance.
    * @param engine The JavaScript engine to use.
@@ -219,6 +253,81 @@ class SHAKA_EXPORT Player final {
   /** @return A future to the currently seekable range. */
   AsyncResults<BufferedRange> SeekRange() const;
 
+  //@{
+  /**
+   * The same as the getters above, but these pass the results to the given
+   * callback instead of returning a future.  This avoids allocating a future
+   * and blocking a thread to wait for it, which helps when the values are
+   * polled often (e.g. to update a UI).
+   *
+   * @param callback The callback to give the results to.
+   * @param executor If given, this is used to run the callback (e.g. by posting
+   *   it to the UI thread).  Otherwise the callback is run on the JavaScript
+   *   thread, so it must not block or wait for the results of other calls.
+   */
+  void IsAudioOnly(AsyncCallback<bool> callback,
+                   AsyncExecutor executor = nullptr) const;
+  void IsBuffering(AsyncCallback<bool> callback,
+                   AsyncExecutor executor = nullptr) const;
+  void IsInProgress(AsyncCallback<bool> callback,
+                    AsyncExecutor executor = nullptr) const;
+  void IsLive(AsyncCallback<bool> callback,
+              AsyncExecutor executor = nullptr) const;
+  void IsTextTrackVisible(AsyncCallback<bool> callback,
+                          AsyncExecutor executor = nullptr) const;
+  void UsingEmbeddedTextTrack(AsyncCallback<bool> callback,
+                              AsyncExecutor executor = nullptr) const;
+  void AssetUri(AsyncCallback<optional<std::string>> callback,
+                AsyncExecutor executor = nullptr) const;
+  void DrmInfo(AsyncCallback<optional<shaka::DrmInfo>> callback,
+               AsyncExecutor executor = nullptr) const;
+  void GetAudioLanguagesAndRoles(
+      AsyncCallback<std::vector<LanguageRole>> callback,
+      AsyncExecutor executor = nullptr) const;
+  void GetBufferedInfo(AsyncCallback<BufferedInfo> callback,
+                       AsyncExecutor executor = nullptr) const;
+  void GetExpiration(AsyncCallback<double> callback,
+                     AsyncExecutor executor = nullptr) const;
+  void GetStats(AsyncCallback<Stats> callback,
+                AsyncExecutor executor = nullptr) const;
+  void GetTextTracks(AsyncCallback<std::vector<Track>> callback,
+                     AsyncExecutor executor = nullptr) const;
+  void GetVariantTracks(AsyncCallback<std::vector<Track>> callback,
+                        AsyncExecutor executor = nullptr) const;
+  void GetTextLanguagesAndRoles(
+      AsyncCallback<std::vector<LanguageRole>> callback,
+      AsyncExecutor executor = nullptr) const;
+  void KeySystem(AsyncCallback<std::string> callback,
+                 AsyncExecutor executor = nullptr) const;
+  void SeekRange(AsyncCallback<BufferedRange> callback,
+                 AsyncExecutor executor = nullptr) const;
+  //@}
+
+  /**
+   * Sets how often to update the state snapshot returned by GetStateSnapshot().
+   * The snapshot is refreshed on the JavaScript thread in one task, so reading
+   * it doesn't need a round trip to JavaScript per value.  This is disabled by
+   * default.
+   *
+   * @param interval_ms The time between updates, in milliseconds, or 0 to stop
+   *   updating the snapshot.
+   */
+  void SetStateSnapshotInterval(uint64_t interval_ms);
+
+  /**
+   * @return The most recent state snapshot.  This can be called from any
+   *   thread and never waits for the JavaScript thread.
+   */
+  StateSnapshot GetStateSnapshot() const;
+
+  /**
+   * Gets the playback position directly from the attached MediaPlayer.  This
+   * doesn't use the JavaScript thread, so it is cheap enough to call every
+   * frame (e.g. to update a scrub bar).  This can be called from any thread.
+   * If there is no MediaPlayer attached, this returns a Detached position.
+   */
+  PlaybackPosition GetPlaybackPosition() const;
+
 
   /**
    * Loads the given manifest.  Returns a future that will resolve when the
@@ -380,6 +489,16 @@ class SHAKA_EXPORT Player final {
   /** Stops the given object from receiving calls for network requests. */
   void RemoveNetworkFilters(NetworkFilters* filters);
 
+  /**
+   * Sets a native AbrManager that Shaka Player uses to choose variants,
+   * instead of its own.  This takes effect on the next Load().  Passing
+   * nullptr restores Shaka Player's default AbrManager.
+   *
+   * @param abr The AbrManager to use.  This must remain alive until it is
+   *   replaced and the content is unloaded, or until the Player is destroyed.
+   */
+  AsyncResults<void> SetAbrManager(AbrManager* abr);
+
   //@{
   /**
    * Configures the player with the given data buffer.
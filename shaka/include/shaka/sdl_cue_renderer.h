@@ -0,0 +1,154 @@
+// Copyright 2020 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     https://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef SHAKA_EMBEDDED_SDL_CUE_RENDERER_H_
+#define SHAKA_EMBEDDED_SDL_CUE_RENDERER_H_
+
+#include <stdint.h>
+
+#include <memory>
+#include <vector>
+
+#include "media/text_track.h"
+#include "media/vtt_cue.h"
+#include "macros.h"
+
+struct SDL_Renderer;
+struct SDL_Texture;
+
+namespace shaka {
+
+/**
+ * A helper class that draws the active text cues onto an SDL texture, so apps
+ * using SdlFrameDrawer don't need to render subtitles themselves.  Cues are
+ * laid out using their position, line, size, and alignment settings, and the
+ * glyphs are cached in an atlas texture, so each glyph is only rasterized
+ * once.  The returned texture is only redrawn when the active cues change; the
+ * rest of the time, drawing the subtitles is a single SDL_RenderCopy.
+ *
+ * This doesn't depend on a font library; the app provides a GlyphRasterizer
+ * (e.g. using SDL_ttf or FreeType) to rasterize the glyphs.  Cue text is drawn
+ * left-to-right; markup tags are ignored and vertical cues are drawn
+ * horizontally.
+ *
+ * This needs a renderer that supports render targets.  This must only be used
+ * on the thread that uses the renderer.
+ *
+ * @ingroup utils
+ */
+class SHAKA_EXPORT SdlCueRenderer final {
+ public:
+  /** Rasterizes single glyphs of the font used to draw cues. */
+  class GlyphRasterizer {
+   public:
+    /** Defines a single rasterized glyph. */
+    struct Glyph {
+      Glyph();
+      ~Glyph();
+
+      /** The coverage of each pixel, row-major with |width| bytes per row. */
+      std::vector<uint8_t> alpha;
+      /** The size of the bitmap, which can be empty (e.g. for spaces). */
+      int width;
+      int height;
+      /** The offset from the pen position to the left of the bitmap. */
+      int left;
+      /** The offset from the baseline up to the top of the bitmap. */
+      int top;
+      /** How far to move the pen after this glyph. */
+      int advance;
+    };
+
+    virtual ~GlyphRasterizer();
+
+    /**
+     * Gets the line metrics of the font at the given size.
+     *
+     * @param pixel_size The size of the font, in pixels.
+     * @param ascent [OUT] Where to put the distance from the top of a line to
+     *   the baseline.
+     * @param line_height [OUT] Where to put the distance between lines.
+     */
+    virtual void GetLineMetrics(int pixel_size, int* ascent,
+                                int* line_height) = 0;
+
+    /**
+     * Rasterizes the given character.
+     *
+     * @param codepoint The Unicode code point to rasterize.
+     * @param pixel_size The size of the font, in pixels.
+     * @param glyph [OUT] Where to put the glyph.
+     * @return True on success, false if the glyph isn't in the font.
+     */
+    virtual bool RasterizeGlyph(uint32_t codepoint, int pixel_size,
+                                Glyph* glyph) = 0;
+  };
+
+  explicit SdlCueRenderer(std::shared_ptr<GlyphRasterizer> rasterizer);
+  SdlCueRenderer(SdlCueRenderer&&);
+  ~SdlCueRenderer();
+
+  SdlCueRenderer& operator=(SdlCueRenderer&&);
+
+  SHAKA_NON_COPYABLE_TYPE(SdlCueRenderer);
+
+
+  /**
+   * Sets the renderer used to create textures.  This MUST be called at least
+   * once before calling Draw.  This can be changed at any time, but will
+   * invalidate any existing textures.  This should also be called again after
+   * SDL_RENDER_TARGETS_RESET or SDL_RENDER_DEVICE_RESET, since those lose the
+   * texture contents.
+   */
+  void SetRenderer(SDL_Renderer* renderer);
+
+  /**
+   * Sets the size, in pixels, of the region the video is drawn to.  The
+   * returned textures are this size and should be drawn over the video.  The
+   * font size is 5% of the height.  This MUST be called at least once before
+   * calling Draw.
+   */
+  void SetSize(uint32_t width, uint32_t height);
+
+  /**
+   * Draws the cues of the given text track that are active at the given time.
+   * This is the same as calling Draw with |track.active_cues(time)|.
+   *
+   * @param track The text track to draw.
+   * @param time The current media time, in seconds.
+   * @return The texture holding the cues, or nullptr if there are no cues to
+   *   draw or on error.
+   */
+  SDL_Texture* Draw(const media::TextTrack& track, double time);
+
+  /**
+   * Draws the given cues onto a texture.  If the cues are the same as the last
+   * call, this returns the same texture without drawing it again.  The
+   * returned texture stays valid until the next call to Draw, SetRenderer, or
+   * SetSize.
+   *
+   * @param cues The cues to draw.
+   * @return The texture holding the cues, or nullptr if there are no cues to
+   *   draw or on error.
+   */
+  SDL_Texture* Draw(const std::vector<std::shared_ptr<media::VTTCue>>& cues);
+
+ private:
+  class Impl;
+  std::unique_ptr<Impl> impl_;
+};
+
+}  // namespace shaka
+
+#endif  // SHAKA_EMBEDDED_SDL_CUE_RENDERER_H_
@@ -16,6 +16,7 @@
 #define SHAKA_EMBEDDED_SDL_FRAME_DRAWER_H_
 
 #include <memory>
+#include <vector>
 
 #include "media/frames.h"
 #include "macros.h"
@@ -29,6 +30,11 @@ namespace shaka {
  * A helper class that is used to convert Shaka Embedded Frame objects into an
  * SDL texture.
  *
+ * On macOS, when using SDL's "opengl" renderer, VideoToolbox frames are
+ * converted to RGB on the GPU directly from their IOSurface, so the pixels are
+ * never copied through the CPU.  Otherwise the frame data is uploaded to a
+ * streaming texture.
+ *
  * @ingroup utils
  */
 class SHAKA_EXPORT SdlFrameDrawer final {
@@ -50,14 +56,45 @@ class SHAKA_EXPORT SdlFrameDrawer final {
   void SetRenderer(SDL_Renderer* renderer);
 
   /**
-   * Draws the given frame onto a texture.  This may invalidate any existing
-   * textures.
+   * Sets the size, in pixels, that frames are drawn at.  Frames at least twice
+   * this size in both directions are downscaled by a power of two while being
+   * uploaded, so less data is uploaded and the textures are smaller.  This is
+   * done for 8-bit YUV frames; the returned texture is smaller than the frame,
+   * so the source rectangle needs to be scaled to the texture size.  A size
+   * of 0 (the default) uploads frames at their full size.
+   */
+  void SetMaxFrameSize(uint32_t width, uint32_t height);
+
+  /**
+   * @return The pixel formats the current renderer can draw without
+   *   converting them, most preferred first.  Other frames (e.g. 10-bit ones)
+   *   are converted while they are uploaded.
+   */
+  std::vector<media::PixelFormat> GetPreferredPixelFormats() const;
+
+  /**
+   * Draws the given frame onto a texture.  If the frame was already uploaded
+   * (by an earlier call or by Prepare), this reuses that texture without
+   * uploading it again.  The returned texture stays valid until the next call
+   * to Draw or SetRenderer; other textures may be invalidated.
    *
    * @param frame The frame to draw.
    * @return The created texture, or nullptr on error.
    */
   SDL_Texture* Draw(std::shared_ptr<media::DecodedFrame> frame);
 
+  /**
+   * Uploads the given frame to a texture ahead of time, so a later call to
+   * Draw with the same frame only needs to return the texture.  This never
+   * overwrites the texture returned by the last call to Draw.  This should be
+   * called after presenting the current frame, while waiting for the next
+   * one, so the upload doesn't delay the presentation.
+   *
+   * @param frame The frame to upload.
+   * @return True if the frame is ready to draw, false on error.
+   */
+  bool Prepare(std::shared_ptr<media::DecodedFrame> frame);
+
  private:
   class Impl;
   std::unique_ptr<Impl> impl_;
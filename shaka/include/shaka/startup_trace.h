@@ -0,0 +1,89 @@
+// Copyright 2020 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     https://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef SHAKA_EMBEDDED_STARTUP_TRACE_H_
+#define SHAKA_EMBEDDED_STARTUP_TRACE_H_
+
+#include <stdint.h>
+
+#include <string>
+#include <vector>
+
+#include "macros.h"
+
+namespace shaka {
+
+/**
+ * Records when each stage of startup happens, from creating the JsManager to
+ * rendering the first frame.  This can be used to measure the time to first
+ * frame and to see which stage it is spent in.
+ *
+ * The library records these events:
+ * - "JsManager created" when the JsManager is constructed.
+ * - "JsEngine init" for setting up the JavaScript engine.
+ * - "Environment install" for adding the native types to JavaScript.
+ * - "Compile shaka-player.compiled.js" for loading the player script.
+ * - "Player::Load" when Player::Load is called.
+ * - "Manifest received" when the first DASH or HLS manifest is downloaded.
+ * - "First append" when the first data is appended to a SourceBuffer.
+ * - "First decode" when the first frame is decoded.
+ * - "First render" when the first video frame is given to be drawn.
+ *
+ * The "first" events are recorded once until Reset() is called.  This can be
+ * called from any thread.
+ *
+ * @ingroup player
+ */
+class SHAKA_EXPORT StartupTrace final {
+ public:
+  /** A single event in the trace. */
+  struct Event final {
+    /** The name of the event. */
+    std::string name;
+    /** The monotonic time, in milliseconds, that the event started. */
+    uint64_t start_ms;
+    /**
+     * The duration of the event, in milliseconds.  This is 0 for events that
+     * mark a single point in time.
+     */
+    uint64_t duration_ms;
+  };
+
+  StartupTrace() = delete;
+
+  /** @return The events recorded so far, in the order they started. */
+  static std::vector<Event> GetEvents();
+
+  /**
+   * @return The events recorded so far, in the Chrome trace event JSON format.
+   *   This can be loaded in chrome://tracing or saved to compare runs.
+   */
+  static std::string GetChromeTraceJson();
+
+  /**
+   * Adds an event for the current time.  This can be used to add app-specific
+   * stages (e.g. when the app starts) to the trace.
+   */
+  static void AddMilestone(const std::string& name);
+
+  /**
+   * Removes all the recorded events.  Call this before loading new content to
+   * record the "first" events again.
+   */
+  static void Reset();
+};
+
+}  // namespace shaka
+
+#endif  // SHAKA_EMBEDDED_STARTUP_TRACE_H_
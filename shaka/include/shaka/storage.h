@@ -139,6 +139,13 @@ class SHAKA_EXPORT Storage final {
    * representing all stored content. The <code>offlineUri</code> member of the
    * structure is the URI that should be given to <code>Player::Load()</code> to
    * play this piece of content offline.
+   *
+   * The results are kept in an index in the dynamic data directory, which is
+   * updated as content is stored and removed through this type, so later calls
+   * (even after a restart) don't need to read every stored manifest.  If a
+   * store or remove fails, the next call reads the database again.  Content
+   * stored or removed directly through the JavaScript Storage isn't seen by the
+   * index.
    */
   AsyncResults<std::vector<StoredContent>> List();
 
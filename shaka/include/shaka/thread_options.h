@@ -0,0 +1,102 @@
+// Copyright 2020 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     https://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef SHAKA_EMBEDDED_THREAD_OPTIONS_H_
+#define SHAKA_EMBEDDED_THREAD_OPTIONS_H_
+
+#include <stdint.h>
+
+namespace shaka {
+
+/**
+ * The kinds of work the library's background threads do.  Each thread has one
+ * role, which is used to pick how that thread is scheduled.
+ *
+ * @ingroup exported
+ */
+enum class ThreadRole : uint8_t {
+  /** Threads that don't have one of the other roles. */
+  Default,
+  /**
+   * The threads that render audio.  These have to run on time or the audio
+   * will underrun.
+   */
+  Audio,
+  /** The threads that render video. */
+  Video,
+  /** The threads that demux, decrypt, and decode media. */
+  Media,
+  /** The thread that downloads content. */
+  Network,
+  /** The threads that run JavaScript. */
+  JavaScript,
+  /**
+   * Threads that do work the user isn't waiting for (e.g. monitoring the
+   * pipeline or generating thumbnails).
+   */
+  Background,
+};
+
+/**
+ * The relative importance of a thread.  On Apple platforms, this maps to the
+ * QoS classes (e.g. <code>QOS_CLASS_USER_INTERACTIVE</code>); on other POSIX
+ * platforms, this maps to the nice value of the thread.
+ *
+ * @ingroup exported
+ */
+enum class ThreadPriority : uint8_t {
+  /** Maps to <code>QOS_CLASS_BACKGROUND</code> or a nice value of 10. */
+  Background,
+  /** Maps to <code>QOS_CLASS_UTILITY</code> or a nice value of 5. */
+  Utility,
+  /** Leaves the thread with the default scheduling of the process. */
+  Default,
+  /** Maps to <code>QOS_CLASS_USER_INITIATED</code> or a nice value of -5. */
+  UserInitiated,
+  /** Maps to <code>QOS_CLASS_USER_INTERACTIVE</code> or a nice value of -10. */
+  UserInteractive,
+};
+
+/**
+ * Defines how threads with a given ThreadRole are scheduled.  Setting these
+ * can fail without the needed permissions (e.g. a negative nice value or
+ * real-time scheduling on Linux); in that case, the thread keeps the default
+ * scheduling.
+ *
+ * @ingroup exported
+ */
+struct ThreadOptions final {
+  /** The priority of the threads. */
+  ThreadPriority priority = ThreadPriority::Default;
+
+  /**
+   * If true, use real-time (<code>SCHED_FIFO</code>) scheduling for the
+   * threads.  This only affects Linux and Android, and is used instead of
+   * @a priority.  The threads must not spin or they will starve the rest of
+   * the system.
+   */
+  bool realtime = false;
+
+  /**
+   * A bitmask of the CPUs the threads are allowed to run on (e.g. 0xf0 for
+   * CPUs 4-7, which are usually the big cores of a big.LITTLE SoC).  If this
+   * is 0, the threads can run on any CPU.  This only affects Linux and
+   * Android; Apple platforms don't support setting the affinity.
+   */
+  uint64_t cpu_affinity = 0;
+};
+
+}  // namespace shaka
+
+#endif  // SHAKA_EMBEDDED_THREAD_OPTIONS_H_
@@ -0,0 +1,143 @@
+// Copyright 2020 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     https://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "src/core/bandwidth_estimator.h"
+
+#include <algorithm>
+#include <cmath>
+#include <mutex>
+#include <utility>
+
+namespace shaka {
+
+namespace {
+
+/** The half-life of the throughput average, in milliseconds of transfer. */
+constexpr const double kThroughputHalfLifeMs = 3000;
+/** The half-life of the latency averages, in requests. */
+constexpr const double kLatencyHalfLife = 5;
+/** Transfers shorter than this are counted as taking this long. */
+constexpr const double kMinTransferMs = 1;
+
+}  // namespace
+
+constexpr const uint64_t BandwidthEstimator::kMinThroughputBytes;
+constexpr const size_t BandwidthEstimator::kWindowSize;
+constexpr const size_t BandwidthEstimator::kMaxHosts;
+
+BandwidthEstimator::Ewma::Ewma(double half_life)
+    : alpha_(std::exp(std::log(0.5) / half_life)) {}
+
+void BandwidthEstimator::Ewma::Sample(double weight, double value) {
+  const double adjusted_alpha = std::pow(alpha_, weight);
+  estimate_ = value * (1 - adjusted_alpha) + adjusted_alpha * estimate_;
+  total_weight_ += weight;
+}
+
+double BandwidthEstimator::Ewma::Get() const {
+  // The average starts at 0, so early estimates are biased low; this corrects
+  // for that.
+  const double zero_factor = 1 - std::pow(alpha_, total_weight_);
+  return zero_factor > 0 ? estimate_ / zero_factor : 0;
+}
+
+
+BandwidthEstimator::Stats::Stats()
+    : throughput(kThroughputHalfLifeMs),
+      ttfb(kLatencyHalfLife),
+      connect(kLatencyHalfLife) {}
+
+void BandwidthEstimator::Stats::AddTransfer(const Transfer& transfer) {
+  request_count++;
+  ttfb.Sample(1, transfer.ttfb_ms);
+  if (transfer.connect_ms > 0)
+    connect.Sample(1, transfer.connect_ms);
+
+  if (transfer.bytes >= kMinThroughputBytes) {
+    const double transfer_ms =
+        std::max(transfer.total_ms - transfer.ttfb_ms, kMinTransferMs);
+    const double bps = transfer.bytes * 8 * 1000 / transfer_ms;
+    throughput.Sample(transfer_ms, bps);
+    window[window_next] = bps;
+    window_next = (window_next + 1) % kWindowSize;
+    throughput_samples++;
+  }
+}
+
+void BandwidthEstimator::Stats::GetEstimate(Estimate* estimate) const {
+  estimate->throughput_bps = throughput.Get();
+  estimate->ttfb_ms = ttfb.Get();
+  estimate->connect_ms = connect.Get();
+  estimate->throughput_samples = throughput_samples;
+  estimate->request_count = request_count;
+
+  const size_t count =
+      static_cast<size_t>(std::min<uint64_t>(throughput_samples, kWindowSize));
+  if (count == 0) {
+    estimate->throughput_p50_bps = estimate->throughput_p10_bps = 0;
+    return;
+  }
+  std::array<double, kWindowSize> sorted;
+  std::copy(window.begin(), window.begin() + count, sorted.begin());
+  std::sort(sorted.begin(), sorted.begin() + count);
+  estimate->throughput_p50_bps = sorted[count / 2];
+  estimate->throughput_p10_bps = sorted[count / 10];
+}
+
+
+BandwidthEstimator::BandwidthEstimator()
+    : mutex_("BandwidthEstimator"), update_count_(0) {}
+
+BandwidthEstimator::~BandwidthEstimator() {}
+
+void BandwidthEstimator::AddTransfer(const std::string& host,
+                                     const Transfer& transfer) {
+  std::unique_lock<Mutex> lock(mutex_);
+  update_count_++;
+  all_.AddTransfer(transfer);
+
+  auto it = hosts_.find(host);
+  if (it == hosts_.end()) {
+    if (hosts_.size() >= kMaxHosts) {
+      using Entry = std::pair<const std::string, Stats>;
+      auto oldest = std::min_element(
+          hosts_.begin(), hosts_.end(), [](const Entry& a, const Entry& b) {
+            return a.second.last_update < b.second.last_update;
+          });
+      hosts_.erase(oldest);
+    }
+    it = hosts_.emplace(host, Stats()).first;
+  }
+  it->second.AddTransfer(transfer);
+  it->second.last_update = update_count_;
+}
+
+bool BandwidthEstimator::GetEstimate(const std::string& host,
+                                     Estimate* estimate) const {
+  std::unique_lock<Mutex> lock(mutex_);
+  const Stats* stats = &all_;
+  if (!host.empty()) {
+    auto it = hosts_.find(host);
+    if (it == hosts_.end())
+      return false;
+    stats = &it->second;
+  }
+  if (stats->request_count == 0)
+    return false;
+
+  stats->GetEstimate(estimate);
+  return true;
+}
+
+}  // namespace shaka
@@ -0,0 +1,143 @@
+// Copyright 2020 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     https://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef SHAKA_EMBEDDED_CORE_BANDWIDTH_ESTIMATOR_H_
+#define SHAKA_EMBEDDED_CORE_BANDWIDTH_ESTIMATOR_H_
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <array>
+#include <string>
+#include <unordered_map>
+
+#include "src/debug/mutex.h"
+#include "src/util/macros.h"
+
+namespace shaka {
+
+/**
+ * Estimates network throughput and latency from the timings CURL reports for
+ * completed requests.  This tracks an estimate for each host and one for all
+ * requests combined.
+ *
+ * Throughput is measured over the time spent receiving the body, so it isn't
+ * skewed by the time to first byte; the latency is tracked separately.  Each
+ * estimate has an exponentially-weighted moving average, weighted by transfer
+ * time like Shaka Player's EWMA estimator, plus percentiles over the most
+ * recent samples.
+ *
+ * This type is thread-safe.
+ */
+class BandwidthEstimator {
+ public:
+  /** The timings of a single completed request. */
+  struct Transfer {
+    /** The number of body bytes received. */
+    uint64_t bytes = 0;
+    /** The time to connect, 0 if an existing connection was reused. */
+    double connect_ms = 0;
+    /** The time from the start of the request to the first byte. */
+    double ttfb_ms = 0;
+    /** The total time of the request. */
+    double total_ms = 0;
+  };
+
+  struct Estimate {
+    /** The moving average of throughput, in bits per second. */
+    double throughput_bps = 0;
+    /** The median throughput of the recent samples, in bits per second. */
+    double throughput_p50_bps = 0;
+    /** The 10th percentile throughput of the recent samples. */
+    double throughput_p10_bps = 0;
+    /** The moving average of the time to first byte, in milliseconds. */
+    double ttfb_ms = 0;
+    /** The moving average of the connect time of new connections. */
+    double connect_ms = 0;
+    /** The number of samples used for the throughput estimate. */
+    uint64_t throughput_samples = 0;
+    /** The number of requests seen. */
+    uint64_t request_count = 0;
+  };
+
+  /**
+   * Requests smaller than this are only used for latency; they finish too
+   * quickly to measure throughput.  This matches Shaka Player's default.
+   */
+  static constexpr const uint64_t kMinThroughputBytes = 16000;
+  /** The number of recent throughput samples kept for percentiles. */
+  static constexpr const size_t kWindowSize = 20;
+  /** The number of hosts to keep estimates for. */
+  static constexpr const size_t kMaxHosts = 32;
+
+  BandwidthEstimator();
+  ~BandwidthEstimator();
+
+  SHAKA_NON_COPYABLE_OR_MOVABLE_TYPE(BandwidthEstimator);
+
+  /** Records a completed request to the given host. */
+  void AddTransfer(const std::string& host, const Transfer& transfer);
+
+  /**
+   * Gets the current estimate for the given host.  If |host| is empty, this
+   * gets the estimate for all requests.
+   *
+   * @return True if there is an estimate, false if there were no requests.
+   */
+  bool GetEstimate(const std::string& host, Estimate* estimate) const;
+
+ private:
+  /**
+   * A weighted moving average.  The half-life is in the same units as the
+   * sample weights.
+   */
+  class Ewma {
+   public:
+    explicit Ewma(double half_life);
+
+    void Sample(double weight, double value);
+    double Get() const;
+
+   private:
+    const double alpha_;
+    double estimate_ = 0;
+    double total_weight_ = 0;
+  };
+
+  struct Stats {
+    Stats();
+
+    void AddTransfer(const Transfer& transfer);
+    void GetEstimate(Estimate* estimate) const;
+
+    Ewma throughput;
+    Ewma ttfb;
+    Ewma connect;
+    std::array<double, kWindowSize> window;
+    size_t window_next = 0;
+    uint64_t throughput_samples = 0;
+    uint64_t request_count = 0;
+    // The |update_count_| when this was last updated, for eviction.
+    uint64_t last_update = 0;
+  };
+
+  mutable Mutex mutex_;
+  Stats all_;
+  std::unordered_map<std::string, Stats> hosts_;
+  uint64_t update_count_;
+};
+
+}  // namespace shaka
+
+#endif  // SHAKA_EMBEDDED_CORE_BANDWIDTH_ESTIMATOR_H_
@@ -0,0 +1,62 @@
+// Copyright 2018 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     https://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "src/core/bandwidth_limiter.h"
+
+#include <algorithm>
+
+namespace shaka {
+
+BandwidthLimiter::BandwidthLimiter(const util::Clock* clock)
+    : clock_(clock), limit_(0), available_(0), last_refill_ms_(0) {}
+
+BandwidthLimiter::~BandwidthLimiter() {}
+
+void BandwidthLimiter::SetLimit(uint64_t bytes_per_second) {
+  limit_ = bytes_per_second;
+  // Start with a full bucket so new requests don't wait.
+  available_ = static_cast<int64_t>(limit_ * 1000);
+  last_refill_ms_ = clock_->GetMonotonicTime();
+}
+
+bool BandwidthLimiter::CanReceive() {
+  return GetDelayMs() == 0;
+}
+
+void BandwidthLimiter::OnReceived(size_t bytes) {
+  if (limit_ != 0)
+    available_ -= static_cast<int64_t>(bytes) * 1000;
+}
+
+uint64_t BandwidthLimiter::GetDelayMs() {
+  if (limit_ == 0)
+    return 0;
+
+  Refill();
+  if (available_ >= 1000)
+    return 0;
+  // Round up so waiting this long always makes a whole byte available.
+  const uint64_t missing = static_cast<uint64_t>(1000 - available_);
+  return (missing + limit_ - 1) / limit_;
+}
+
+void BandwidthLimiter::Refill() {
+  const uint64_t now = clock_->GetMonotonicTime();
+  const int64_t max = static_cast<int64_t>(limit_ * 1000);
+  const int64_t added = static_cast<int64_t>((now - last_refill_ms_) * limit_);
+  available_ = std::min(available_ + added, max);
+  last_refill_ms_ = now;
+}
+
+}  // namespace shaka
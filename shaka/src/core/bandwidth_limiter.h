@@ -0,0 +1,75 @@
+// Copyright 2018 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     https://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef SHAKA_EMBEDDED_CORE_BANDWIDTH_LIMITER_H_
+#define SHAKA_EMBEDDED_CORE_BANDWIDTH_LIMITER_H_
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "src/util/clock.h"
+#include "src/util/macros.h"
+
+namespace shaka {
+
+/**
+ * Limits the rate that data is downloaded across all requests using a token
+ * bucket.  Requests can receive data while there are bytes available; they
+ * are allowed to go over the limit for one chunk, which is paid back before
+ * any request can receive more.  This allows bursts of up to one second of
+ * data.
+ *
+ * This type is NOT thread-safe.
+ */
+class BandwidthLimiter {
+ public:
+  explicit BandwidthLimiter(const util::Clock* clock);
+  ~BandwidthLimiter();
+
+  SHAKA_NON_COPYABLE_OR_MOVABLE_TYPE(BandwidthLimiter);
+
+  /**
+   * Changes the maximum number of bytes per second to allow.  If this is 0,
+   * there is no limit.
+   */
+  void SetLimit(uint64_t bytes_per_second);
+
+  /** @return Whether a request can receive more data now. */
+  bool CanReceive();
+
+  /** Records that a request received the given number of bytes. */
+  void OnReceived(size_t bytes);
+
+  /**
+   * @return The number of milliseconds until a request can receive more data,
+   *   or 0 if it can receive data now.
+   */
+  uint64_t GetDelayMs();
+
+ private:
+  /** Adds the bytes that are available since the last call. */
+  void Refill();
+
+  const util::Clock* const clock_;
+  uint64_t limit_;
+  // The number of bytes available, in thousandths of a byte so partial bytes
+  // aren't lost when this is called often.  This can be negative if a request
+  // went over the limit.
+  int64_t available_;
+  uint64_t last_refill_ms_;
+};
+
+}  // namespace shaka
+
+#endif  // SHAKA_EMBEDDED_CORE_BANDWIDTH_LIMITER_H_
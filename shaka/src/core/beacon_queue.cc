@@ -0,0 +1,246 @@
+// Copyright 2020 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     https://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "src/core/beacon_queue.h"
+
+#include <glog/logging.h>
+#include <stdio.h>
+#include <zlib.h>
+
+#include <algorithm>
+#include <cmath>
+#include <mutex>
+
+namespace shaka {
+
+namespace {
+
+/** Appends the given string as a JSON string literal. */
+void AppendJsonString(const std::string& str, std::string* out) {
+  out->push_back('"');
+  for (char c : str) {
+    if (c == '"' || c == '\\') {
+      out->push_back('\\');
+      out->push_back(c);
+    } else if (static_cast<unsigned char>(c) < 0x20) {
+      char buffer[8];
+      snprintf(buffer, sizeof(buffer), "\\u%04x", c);
+      out->append(buffer);
+    } else {
+      out->push_back(c);
+    }
+  }
+  out->push_back('"');
+}
+
+void AppendJsonNumber(double value, std::string* out) {
+  char buffer[32];
+  snprintf(buffer, sizeof(buffer), "%.9g", value);
+  out->append(buffer);
+}
+
+}  // namespace
+
+BeaconQueue::BeaconQueue(const util::Clock* clock)
+    : clock_(clock),
+      mutex_("BeaconQueue"),
+      first_pending_time_(0),
+      dropped_since_batch_(0) {}
+
+BeaconQueue::~BeaconQueue() {}
+
+void BeaconQueue::SetOptions(const Options& options) {
+  std::unique_lock<Mutex> lock(mutex_);
+  options_ = options;
+  options_.max_events = std::max<size_t>(options_.max_events, 1);
+  if (options_.url.empty()) {
+    events_.clear();
+    metrics_.clear();
+    dropped_since_batch_ = 0;
+  }
+  while (events_.size() > options_.max_events) {
+    events_.pop_front();
+    dropped_since_batch_++;
+    stats_.dropped_count++;
+  }
+}
+
+bool BeaconQueue::AddEvent(const std::string& name, const std::string& data) {
+  std::unique_lock<Mutex> lock(mutex_);
+  if (options_.url.empty())
+    return false;
+
+  stats_.item_count++;
+  if (!events_.empty() && events_.back().name == name &&
+      events_.back().data == data) {
+    events_.back().count++;
+    stats_.coalesced_count++;
+    return false;
+  }
+
+  if (events_.size() >= options_.max_events) {
+    events_.pop_front();
+    dropped_since_batch_++;
+    stats_.dropped_count++;
+  }
+  const bool is_first = OnItemAdded();
+  events_.push_back({name, data, clock_->GetEpochTime(), 1});
+  return is_first || events_.size() == options_.max_events;
+}
+
+bool BeaconQueue::AddMetric(const std::string& name, double value) {
+  // NaN and infinity can't be represented in JSON.
+  if (!std::isfinite(value))
+    return false;
+
+  std::unique_lock<Mutex> lock(mutex_);
+  if (options_.url.empty())
+    return false;
+
+  stats_.item_count++;
+  auto it = metrics_.find(name);
+  if (it != metrics_.end()) {
+    Metric& metric = it->second;
+    metric.count++;
+    metric.sum += value;
+    metric.min = std::min(metric.min, value);
+    metric.max = std::max(metric.max, value);
+    metric.last = value;
+    stats_.coalesced_count++;
+    return false;
+  }
+
+  const bool is_first = OnItemAdded();
+  metrics_.emplace(name, Metric{1, value, value, value, value});
+  return is_first;
+}
+
+int64_t BeaconQueue::GetDelayMs() const {
+  std::unique_lock<Mutex> lock(mutex_);
+  if (!HasPending())
+    return -1;
+  if (events_.size() >= options_.max_events)
+    return 0;
+
+  const uint64_t waited = clock_->GetMonotonicTime() - first_pending_time_;
+  return waited >= options_.flush_interval_ms
+             ? 0
+             : static_cast<int64_t>(options_.flush_interval_ms - waited);
+}
+
+bool BeaconQueue::TakeBatch(Batch* batch) {
+  std::string body;
+  {
+    std::unique_lock<Mutex> lock(mutex_);
+    if (!HasPending())
+      return false;
+    const uint64_t waited = clock_->GetMonotonicTime() - first_pending_time_;
+    if (events_.size() < options_.max_events &&
+        waited < options_.flush_interval_ms) {
+      return false;
+    }
+
+    body = "{\"events\":[";
+    for (auto it = events_.begin(); it != events_.end(); it++) {
+      if (it != events_.begin())
+        body.push_back(',');
+      body.append("{\"name\":");
+      AppendJsonString(it->name, &body);
+      body.append(",\"data\":");
+      AppendJsonString(it->data, &body);
+      body.append(",\"time\":" + std::to_string(it->time));
+      body.append(",\"count\":" + std::to_string(it->count) + "}");
+    }
+    body.append("],\"metrics\":[");
+    for (auto it = metrics_.begin(); it != metrics_.end(); it++) {
+      if (it != metrics_.begin())
+        body.push_back(',');
+      body.append("{\"name\":");
+      AppendJsonString(it->first, &body);
+      body.append(",\"count\":" + std::to_string(it->second.count));
+      body.append(",\"sum\":");
+      AppendJsonNumber(it->second.sum, &body);
+      body.append(",\"min\":");
+      AppendJsonNumber(it->second.min, &body);
+      body.append(",\"max\":");
+      AppendJsonNumber(it->second.max, &body);
+      body.append(",\"last\":");
+      AppendJsonNumber(it->second.last, &body);
+      body.push_back('}');
+    }
+    body.append("],\"dropped\":" + std::to_string(dropped_since_batch_) + "}");
+
+    events_.clear();
+    metrics_.clear();
+    dropped_since_batch_ = 0;
+    stats_.batch_count++;
+    batch->url = options_.url;
+    batch->compressed = options_.compress;
+  }
+
+  // Compress without holding the lock so other threads can keep adding.
+  if (batch->compressed && !Gzip(body, &batch->body)) {
+    LOG(WARNING) << "Unable to compress beacon batch, sending it uncompressed";
+    batch->compressed = false;
+  }
+  if (!batch->compressed)
+    batch->body = std::move(body);
+  return true;
+}
+
+void BeaconQueue::OnBatchFailed() {
+  std::unique_lock<Mutex> lock(mutex_);
+  stats_.failed_batch_count++;
+}
+
+BeaconQueue::Stats BeaconQueue::GetStats() const {
+  std::unique_lock<Mutex> lock(mutex_);
+  return stats_;
+}
+
+bool BeaconQueue::Gzip(const std::string& data, std::string* out) {
+  z_stream stream = {};
+  // A window of 15 bits, plus 16 to write a gzip header instead of a zlib
+  // one.
+  if (deflateInit2(&stream, Z_DEFAULT_COMPRESSION, Z_DEFLATED, 15 + 16, 8,
+                   Z_DEFAULT_STRATEGY) != Z_OK) {
+    return false;
+  }
+
+  out->resize(deflateBound(&stream, data.size()) + 32);
+  stream.next_in =
+      reinterpret_cast<Bytef*>(const_cast<char*>(data.data()));
+  stream.avail_in = static_cast<uInt>(data.size());
+  stream.next_out = reinterpret_cast<Bytef*>(&(*out)[0]);
+  stream.avail_out = static_cast<uInt>(out->size());
+  const int result = deflate(&stream, Z_FINISH);
+  deflateEnd(&stream);
+  if (result != Z_STREAM_END)
+    return false;
+  out->resize(stream.total_out);
+  return true;
+}
+
+bool BeaconQueue::OnItemAdded() {
+  if (HasPending())
+    return false;
+  first_pending_time_ = clock_->GetMonotonicTime();
+  return true;
+}
+
+bool BeaconQueue::HasPending() const {
+  return !events_.empty() || !metrics_.empty();
+}
+
+}  // namespace shaka
@@ -0,0 +1,165 @@
+// Copyright 2020 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     https://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef SHAKA_EMBEDDED_CORE_BEACON_QUEUE_H_
+#define SHAKA_EMBEDDED_CORE_BEACON_QUEUE_H_
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <deque>
+#include <map>
+#include <string>
+
+#include "src/debug/mutex.h"
+#include "src/util/clock.h"
+#include "src/util/macros.h"
+
+namespace shaka {
+
+/**
+ * Collects analytics events and metrics so they can be uploaded in batches
+ * instead of as one request each.  Events are kept in a ring buffer, so the
+ * oldest are dropped if they are added faster than they are uploaded; an
+ * event that repeats the previous one only increases its count.  Values of
+ * the same metric are coalesced into a count, sum, minimum, maximum, and last
+ * value.
+ *
+ * A batch is ready once the oldest pending item has waited for the flush
+ * interval, or once the ring buffer is full.  Batches are JSON, optionally
+ * gzip-compressed:
+ *
+ * {"events":[{"name":..,"data":..,"time":..,"count":..}],
+ *  "metrics":[{"name":..,"count":..,"sum":..,"min":..,"max":..,"last":..}],
+ *  "dropped":..}
+ *
+ * This only builds the batches; NetworkThread uploads them.
+ *
+ * This type is thread-safe.
+ */
+class BeaconQueue {
+ public:
+  struct Options {
+    /** The URL to POST the batches to; if empty, nothing is collected. */
+    std::string url;
+    /** The longest time, in milliseconds, an item waits to be uploaded. */
+    uint64_t flush_interval_ms = 60 * 1000;
+    /** The size of the ring buffer of events. */
+    size_t max_events = 256;
+    /** Whether to gzip the batches. */
+    bool compress = true;
+  };
+
+  struct Batch {
+    std::string url;
+    std::string body;
+    bool compressed = false;
+  };
+
+  struct Stats {
+    /** The number of batches that were built. */
+    uint64_t batch_count = 0;
+    /** The number of batches that couldn't be uploaded. */
+    uint64_t failed_batch_count = 0;
+    /** The number of events and metric values that were added. */
+    uint64_t item_count = 0;
+    /** The number of items merged into an earlier event or metric. */
+    uint64_t coalesced_count = 0;
+    /** The number of events dropped because the ring buffer was full. */
+    uint64_t dropped_count = 0;
+  };
+
+  explicit BeaconQueue(const util::Clock* clock);
+  ~BeaconQueue();
+
+  SHAKA_NON_COPYABLE_OR_MOVABLE_TYPE(BeaconQueue);
+
+  /**
+   * Changes the options.  If the URL is cleared, the pending items are
+   * dropped.
+   */
+  void SetOptions(const Options& options);
+
+  /**
+   * Adds an event; |data| is stored as a string (e.g. JSON text).
+   * @return Whether this changed when the next batch is ready, so the thread
+   *   that sends them should wake up.
+   */
+  bool AddEvent(const std::string& name, const std::string& data);
+
+  /** Adds a value of the given metric; this returns like AddEvent. */
+  bool AddMetric(const std::string& name, double value);
+
+  /**
+   * @return The time, in milliseconds, until a batch is ready, or -1 if
+   *   nothing is pending.
+   */
+  int64_t GetDelayMs() const;
+
+  /**
+   * Takes the pending items as a batch, if one is ready.
+   * @return Whether |batch| was filled.
+   */
+  bool TakeBatch(Batch* batch);
+
+  /** Records that a batch couldn't be uploaded; it isn't retried. */
+  void OnBatchFailed();
+
+  /** @return The current statistics of the queue. */
+  Stats GetStats() const;
+
+  /** Compresses |data| in the gzip format. */
+  static bool Gzip(const std::string& data, std::string* out);
+
+ private:
+  struct Event {
+    std::string name;
+    std::string data;
+    uint64_t time;
+    uint64_t count;
+  };
+
+  struct Metric {
+    uint64_t count;
+    double sum;
+    double min;
+    double max;
+    double last;
+  };
+
+  /**
+   * Records that an item is being added; |mutex_| must be held.
+   * @return Whether it is the first pending item.
+   */
+  bool OnItemAdded();
+
+  /** @return Whether anything is pending; |mutex_| must be held. */
+  bool HasPending() const;
+
+  const util::Clock* const clock_;
+  mutable Mutex mutex_;
+  Options options_;
+  // Oldest first.
+  std::deque<Event> events_;
+  // Sorted by name so batches are stable.
+  std::map<std::string, Metric> metrics_;
+  // The monotonic time the oldest pending item was added.
+  uint64_t first_pending_time_;
+  uint64_t dropped_since_batch_;
+  Stats stats_;
+};
+
+}  // namespace shaka
+
+#endif  // SHAKA_EMBEDDED_CORE_BEACON_QUEUE_H_
@@ -0,0 +1,73 @@
+// Copyright 2020 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     https://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "src/core/completion_queue.h"
+
+namespace shaka {
+
+CompletionQueue::CompletionQueue(TaskRunner* runner,
+                                 std::function<void()> after_batch)
+    : runner_(runner),
+      after_batch_(std::move(after_batch)),
+      head_(nullptr),
+      batch_count_(0) {}
+
+CompletionQueue::~CompletionQueue() {
+  Completion* cur = head_.exchange(nullptr, std::memory_order_acquire);
+  while (cur) {
+    Completion* next = cur->next;
+    delete cur;
+    cur = next;
+  }
+}
+
+void CompletionQueue::PushCompletion(Completion* completion) {
+  completion->next = head_.load(std::memory_order_relaxed);
+  while (!head_.compare_exchange_weak(completion->next, completion,
+                                      std::memory_order_release,
+                                      std::memory_order_relaxed)) {
+  }
+
+  // Only the push that made the list non-empty posts a task; the others are
+  // picked up by that task.
+  if (!completion->next) {
+    batch_count_.fetch_add(1, std::memory_order_relaxed);
+    runner_->PostTask(TaskPriority::Internal, [this]() { RunBatch(); });
+  }
+}
+
+void CompletionQueue::RunBatch() {
+  Completion* cur = head_.exchange(nullptr, std::memory_order_acquire);
+
+  // The list is most recent first, so reverse it to run in push order.
+  Completion* ordered = nullptr;
+  while (cur) {
+    Completion* next = cur->next;
+    cur->next = ordered;
+    ordered = cur;
+    cur = next;
+  }
+
+  while (ordered) {
+    Completion* next = ordered->next;
+    ordered->Call();
+    delete ordered;
+    ordered = next;
+  }
+
+  if (after_batch_)
+    after_batch_();
+}
+
+}  // namespace shaka
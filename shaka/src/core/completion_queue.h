@@ -0,0 +1,95 @@
+// Copyright 2020 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     https://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef SHAKA_EMBEDDED_CORE_COMPLETION_QUEUE_H_
+#define SHAKA_EMBEDDED_CORE_COMPLETION_QUEUE_H_
+
+#include <atomic>
+#include <functional>
+#include <type_traits>
+#include <utility>
+
+#include "src/core/task_runner.h"
+#include "src/util/macros.h"
+
+namespace shaka {
+
+/**
+ * Collects work that native threads complete (e.g. settling Promises) and runs
+ * it on a TaskRunner in batches.  Posting a task for every completion means
+ * every one pays for its own task, HandleScope, and microtask checkpoint.
+ * Instead, completions are pushed onto a lock-free list and the first push
+ * onto an empty list posts a single task that runs everything queued by the
+ * time it runs.  After each batch, |after_batch| is called once; this is used
+ * to run the JavaScript microtasks the batch queued.
+ *
+ * Completions pushed from one thread run in the order they were pushed.
+ *
+ * This type is thread-safe.
+ */
+class CompletionQueue final {
+ public:
+  CompletionQueue(TaskRunner* runner, std::function<void()> after_batch);
+  ~CompletionQueue();
+
+  SHAKA_NON_COPYABLE_OR_MOVABLE_TYPE(CompletionQueue);
+
+  /**
+   * Adds a callback that will be called on the TaskRunner's thread with the
+   * next batch.  This can be called from any thread.
+   */
+  template <typename Func>
+  void Push(Func&& callback) {
+    PushCompletion(new CompletionImpl<typename std::decay<Func>::type>(
+        std::forward<Func>(callback)));
+  }
+
+  /** @return The number of batch tasks posted.  This is used for testing. */
+  size_t batch_count() const {
+    return batch_count_.load(std::memory_order_relaxed);
+  }
+
+ private:
+  struct Completion {
+    virtual ~Completion() {}
+    virtual void Call() = 0;
+
+    Completion* next = nullptr;
+  };
+
+  template <typename Func>
+  struct CompletionImpl : Completion {
+    explicit CompletionImpl(Func&& callback) : callback(std::move(callback)) {}
+    explicit CompletionImpl(const Func& callback) : callback(callback) {}
+
+    void Call() override {
+      callback();
+    }
+
+    Func callback;
+  };
+
+  void PushCompletion(Completion* completion);
+  void RunBatch();
+
+  TaskRunner* const runner_;
+  const std::function<void()> after_batch_;
+  // The completions waiting for the next batch, most recent first.
+  std::atomic<Completion*> head_;
+  std::atomic<size_t> batch_count_;
+};
+
+}  // namespace shaka
+
+#endif  // SHAKA_EMBEDDED_CORE_COMPLETION_QUEUE_H_
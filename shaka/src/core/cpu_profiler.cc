@@ -0,0 +1,151 @@
+// Copyright 2020 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     https://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "src/core/cpu_profiler.h"
+
+#include <glog/logging.h>
+
+#include <map>
+#include <string>
+#include <unordered_map>
+#include <utility>
+
+#include "src/mapping/js_engine.h"
+
+namespace shaka {
+
+CpuProfiler::CpuProfiler(TaskRunner* runner)
+    : runner_(runner), timer_id_(0), running_(false), has_profile_(false) {}
+
+CpuProfiler::~CpuProfiler() {
+  // The engine's profiler needs to be stopped before the engine is destroyed.
+  Finish();
+}
+
+bool CpuProfiler::Start(uint64_t max_duration_ms,
+                        uint32_t sample_interval_us) {
+  DCHECK(runner_->BelongsToCurrentThread());
+  if (running_)
+    return false;
+  if (!JsEngine::Instance()->StartCpuProfiling(sample_interval_us))
+    return false;
+
+  VLOG(1) << "Started CPU profiling for " << max_duration_ms << "ms";
+  running_ = true;
+  has_profile_ = false;
+  profile_ = JsManager::CpuProfile();
+  runner_->TakeTaskSpans();
+  runner_->SetRecordTaskSpans(true);
+  timer_id_ = runner_->AddTimer(max_duration_ms, [this]() {
+    timer_id_ = 0;
+    Finish();
+  });
+  return true;
+}
+
+bool CpuProfiler::Stop(JsManager::CpuProfile* profile) {
+  DCHECK(runner_->BelongsToCurrentThread());
+  Finish();
+  if (!has_profile_)
+    return false;
+
+  *profile = std::move(profile_);
+  profile_ = JsManager::CpuProfile();
+  has_profile_ = false;
+  return true;
+}
+
+// static
+void CpuProfiler::AddTaskFrames(const std::vector<TaskRunner::TaskSpan>& spans,
+                                JsManager::CpuProfile* profile) {
+  if (profile->nodes.empty())
+    return;
+
+  // Rebuild the tree so each sample's path is under the task node.  The same
+  // function can be called from many tasks, so nodes are keyed by their new
+  // parent and their old index.
+  const std::vector<JsManager::CpuProfileNode> old_nodes =
+      std::move(profile->nodes);
+  profile->nodes.clear();
+  profile->nodes.push_back(old_nodes[0]);
+  profile->nodes[0].parent = -1;
+
+  std::map<std::pair<uint32_t, uint32_t>, uint32_t> js_nodes;
+  std::unordered_map<std::string, uint32_t> task_nodes;
+  std::vector<uint32_t> path;
+  auto span = spans.begin();
+  uint64_t time = profile->start_time_us;
+  for (size_t i = 0; i < profile->samples.size(); i++) {
+    if (i < profile->time_deltas_us.size())
+      time += profile->time_deltas_us[i];
+    while (span != spans.end() && span->end_us < time)
+      span++;
+
+    uint32_t parent = 0;
+    if (span != spans.end() && span->start_us <= time) {
+      auto it = task_nodes.find(span->name);
+      if (it == task_nodes.end()) {
+        JsManager::CpuProfileNode node;
+        node.function_name = span->name;
+        node.parent = 0;
+        node.is_task = true;
+        profile->nodes.push_back(std::move(node));
+        it = task_nodes.emplace(span->name, profile->nodes.size() - 1).first;
+      }
+      parent = it->second;
+    }
+
+    // Parents come before their children, which also guards against cycles.
+    path.clear();
+    for (uint32_t node = profile->samples[i];
+         node < old_nodes.size() && old_nodes[node].parent >= 0 &&
+         static_cast<uint32_t>(old_nodes[node].parent) < node;
+         node = old_nodes[node].parent) {
+      path.push_back(node);
+    }
+    for (auto it = path.rbegin(); it != path.rend(); it++) {
+      const auto key = std::make_pair(parent, *it);
+      auto found = js_nodes.find(key);
+      if (found == js_nodes.end()) {
+        JsManager::CpuProfileNode node = old_nodes[*it];
+        node.parent = static_cast<int32_t>(parent);
+        profile->nodes.push_back(std::move(node));
+        found = js_nodes.emplace(key, profile->nodes.size() - 1).first;
+      }
+      parent = found->second;
+    }
+    profile->samples[i] = parent;
+  }
+}
+
+void CpuProfiler::Finish() {
+  if (!running_)
+    return;
+
+  running_ = false;
+  if (timer_id_ != 0) {
+    runner_->CancelTimer(timer_id_);
+    timer_id_ = 0;
+  }
+  runner_->SetRecordTaskSpans(false);
+  has_profile_ = JsEngine::Instance()->StopCpuProfiling(&profile_);
+  if (has_profile_)
+    AddTaskFrames(runner_->TakeTaskSpans(), &profile_);
+  else
+    runner_->TakeTaskSpans();
+  VLOG(1) << "Stopped CPU profiling with " << profile_.samples.size()
+          << " samples";
+}
+
+}  // namespace shaka
@@ -0,0 +1,78 @@
+// Copyright 2020 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     https://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef SHAKA_EMBEDDED_CORE_CPU_PROFILER_H_
+#define SHAKA_EMBEDDED_CORE_CPU_PROFILER_H_
+
+#include <stdint.h>
+
+#include <vector>
+
+#include "shaka/js_manager.h"
+#include "src/core/task_runner.h"
+#include "src/util/macros.h"
+
+namespace shaka {
+
+/**
+ * Runs the JavaScript engine's sampling profiler for a bounded time and adds
+ * the names of the event loop tasks that were running to the profile.
+ *
+ * This must only be used on the JavaScript thread.
+ */
+class CpuProfiler {
+ public:
+  explicit CpuProfiler(TaskRunner* runner);
+  ~CpuProfiler();
+
+  SHAKA_NON_COPYABLE_OR_MOVABLE_TYPE(CpuProfiler);
+
+  /**
+   * Starts profiling; this replaces any profile that wasn't taken yet.
+   * @return False if profiling is already running or the engine doesn't
+   *   support it.
+   */
+  bool Start(uint64_t max_duration_ms, uint32_t sample_interval_us);
+
+  /**
+   * Stops profiling, if needed, and gets the profile.
+   * @return False if there is no profile (i.e. Start wasn't called).
+   */
+  bool Stop(JsManager::CpuProfile* profile);
+
+  /**
+   * Moves the samples of the given profile under a node for the task that was
+   * running at the time of the sample.  Nodes that have no samples are
+   * removed.
+   *
+   * @param spans The tasks that ran, sorted by time.
+   * @param profile The profile to update.
+   */
+  static void AddTaskFrames(const std::vector<TaskRunner::TaskSpan>& spans,
+                            JsManager::CpuProfile* profile);
+
+ private:
+  /** Stops the engine's profiler and stores the profile in |profile_|. */
+  void Finish();
+
+  TaskRunner* const runner_;
+  JsManager::CpuProfile profile_;
+  int timer_id_;
+  bool running_;
+  bool has_profile_;
+};
+
+}  // namespace shaka
+
+#endif  // SHAKA_EMBEDDED_CORE_CPU_PROFILER_H_
@@ -17,10 +17,14 @@
 #include <glog/logging.h>
 
 #include <atomic>
+#include <functional>
 #include <string>
+#include <type_traits>
+#include <utility>
 
 #include "shaka/eme/implementation_registry.h"
 #include "src/core/js_manager_impl.h"
+#include "src/debug/startup_tracer.h"
 #include "src/js/base_64.h"
 #include "src/js/console.h"
 #include "src/js/debug.h"
@@ -44,9 +48,11 @@
 #include "src/js/events/media_key_message_event.h"
 #include "src/js/events/progress_event.h"
 #include "src/js/events/version_change_event.h"
+#include "src/js/hls_playlist_tokenizer.h"
 #include "src/js/idb/cursor.h"
 #include "src/js/idb/database.h"
 #include "src/js/idb/idb_factory.h"
+#include "src/js/idb/key_range.h"
 #include "src/js/idb/object_store.h"
 #include "src/js/idb/open_db_request.h"
 #include "src/js/idb/request.h"
@@ -61,16 +67,20 @@
 #include "src/js/mse/time_ranges.h"
 #include "src/js/mse/track_list.h"
 #include "src/js/mse/video_element.h"
+#include "src/js/native_abr_manager.h"
 #include "src/js/navigator.h"
+#include "src/js/network_information.h"
 #include "src/js/test_type.h"
 #include "src/js/text_coders.h"
 #include "src/js/timeouts.h"
 #include "src/js/url.h"
 #include "src/js/vtt_cue.h"
 #include "src/js/xml_http_request.h"
+#include "src/mapping/any.h"
 #include "src/mapping/js_engine.h"
 #include "src/mapping/js_wrappers.h"
 #include "src/mapping/register_member.h"
+#include "src/util/macros.h"
 
 namespace shaka {
 
@@ -88,6 +98,103 @@ void CreateInstance(const std::string& name,
   SetMemberRaw(JsEngine::Instance()->global_handle(), name, value);
 }
 
+/**
+ * Defines a global that is an accessor until it is first used.  The first get
+ * or set deletes the accessor and calls |create|, which must set the real
+ * value on the global.
+ */
+void DefineLazyGlobal(const std::string& name, std::function<void()> create) {
+  auto materialize = [=]() {
+    DeleteMemberRaw(JsEngine::Instance()->global_handle(), name);
+    create();
+  };
+  auto getter = [=]() {
+    materialize();
+    Any ret;
+    ret.TryConvert(GetMemberRaw(JsEngine::Instance()->global_handle(), name));
+    return ret;
+  };
+  auto setter = [=](Any value) {
+    materialize();
+    LocalVar<JsValue> js_value(value.ToJsValue());
+    SetMemberRaw(JsEngine::Instance()->global_handle(), name, js_value);
+  };
+
+  LocalVar<JsFunction> js_getter =
+      CreateStaticFunction("window", "get_" + name, std::move(getter));
+  LocalVar<JsFunction> js_setter =
+      CreateStaticFunction("window", "set_" + name, std::move(setter));
+  SetGenericPropertyRaw(JsEngine::Instance()->global_handle(), name, js_getter,
+                        js_setter);
+}
+
+/**
+ * Holds a factory that is only created when it is first needed, so types the
+ * app never uses don't cost anything at startup.  Until then, the global
+ * constructor is a lazy accessor.  The factory is created when JavaScript
+ * uses the constructor or when native code needs the factory to wrap an
+ * object.  This must be created on the event thread.
+ */
+template <typename Factory>
+class LazyFactory {
+ public:
+  LazyFactory() {
+    Registry::SetLazyCreator(std::bind(&LazyFactory::Get, this));
+    DefineLazyGlobal(Type::name(), std::bind(&LazyFactory::Get, this));
+  }
+  ~LazyFactory() {
+    Registry::SetLazyCreator(nullptr);
+  }
+
+  SHAKA_NON_COPYABLE_OR_MOVABLE_TYPE(LazyFactory);
+
+  /** @return The factory, creating it if needed. */
+  Factory* Get() {
+    if (!factory_) {
+      StartupSpan span("Install " + Type::name());
+      // The factory sets the constructor on the global, which would call the
+      // lazy setter if it was still there.
+      DeleteMemberRaw(JsEngine::Instance()->global_handle(), Type::name());
+      factory_.reset(new Factory);
+    }
+    return factory_.get();
+  }
+
+ private:
+  template <typename T, typename Base>
+  static T* GetType(BackingObjectFactory<T, Base>*);
+  using Type = typename std::remove_pointer<decltype(
+      GetType(static_cast<Factory*>(nullptr)))>::type;
+  using Registry = BackingObjectFactoryRegistry<Type>;
+
+  std::unique_ptr<Factory> factory_;
+};
+
+#if defined(USING_JSC)
+/**
+ * Adds the WebAssembly streaming functions, which JavaScriptCore only defines
+ * in WebKit, so WebAssembly plugins can use the same calls with either engine.
+ * Unlike V8, the sources can only be ArrayBuffers (or promises of them) and
+ * the compiled modules aren't cached.
+ */
+constexpr const char kWasmStreamingPolyfill[] = R"(
+(function() {
+  if (typeof WebAssembly != 'object' || WebAssembly.compileStreaming)
+    return;
+  WebAssembly.compileStreaming = function(source) {
+    return Promise.resolve(source).then(function(bytes) {
+      return WebAssembly.compile(bytes);
+    });
+  };
+  WebAssembly.instantiateStreaming = function(source, imports) {
+    return Promise.resolve(source).then(function(bytes) {
+      return WebAssembly.instantiate(bytes, imports);
+    });
+  };
+})();
+)";
+#endif
+
 #if defined(USING_JSC) && !defined(NDEBUG)
 void GC() {
   // A global JavaScript method that runs the garbage collector.  V8 defines its
@@ -99,66 +206,71 @@ void GC() {
 }  // namespace
 
 struct Environment::Impl {
-  // NOTE: Any base types MUST appear above the derived types.
+  // NOTE: Any base types MUST appear above the derived types so they are
+  // destroyed after them.
 
-  js::events::EventTargetFactory event_target;
+  LazyFactory<js::events::EventTargetFactory> event_target;
 
 #ifndef NDEBUG
-  js::DebugFactory debug;
-  js::TestTypeFactory test_type;
+  LazyFactory<js::DebugFactory> debug;
+  LazyFactory<js::TestTypeFactory> test_type;
 #endif
 
-  js::ConsoleFactory console;
-  js::LocationFactory location;
-  js::NavigatorFactory navigator;
-  js::TextDecoderFactory text_decoder;
-  js::TextEncoderFactory text_encoder;
-  js::URLFactory url;
-  js::VTTCueFactory vtt_cue;
-  js::XMLHttpRequestFactory xml_http_request;
-
-  js::events::EventFactory event;
-  js::events::IDBVersionChangeEventFactory version_change_event;
-  js::events::ProgressEventFactory progress_event;
-  js::events::MediaEncryptedEventFactory media_encrypted_event;
-  js::events::MediaKeyMessageEventFactory media_key_message_event;
-
-  js::dom::NodeFactory node;
-  js::dom::AttrFactory attr;
-  js::dom::ContainerNodeFactory container_node;
-  js::dom::CharacterDataFactory character_data;
-  js::dom::ElementFactory element;
-  js::dom::CommentFactory comment;
-  js::dom::TextFactory text;
-  js::dom::DocumentFactory document;
-  js::dom::DOMExceptionFactory dom_exception;
-  js::dom::DOMParserFactory dom_parser;
-  js::dom::DOMStringListFactory dom_string_list;
-
-  js::mse::AudioTrackFactory audio_track;
-  js::mse::AudioTrackListFactory audio_track_list;
-  js::mse::MediaErrorFactory media_error;
-  js::mse::MediaSourceFactory media_source;
-  js::mse::SourceBufferFactory source_buffer;
-  js::mse::TextTrackFactory text_track;
-  js::mse::TextTrackListFactory text_track_list;
-  js::mse::TimeRangesFactory time_ranges;
-  js::mse::HTMLMediaElementFactory media_element;
-  js::mse::HTMLVideoElementFactory video_element;
-  js::mse::VideoTrackFactory video_track;
-  js::mse::VideoTrackListFactory video_track_list;
-
-  js::eme::MediaKeySessionFactory media_key_session;
-  js::eme::MediaKeySystemAccessFactory media_key_system_access;
-  js::eme::MediaKeysFactory media_keys;
-
-  js::idb::IDBCursorFactory idb_cursor;
-  js::idb::IDBDatabaseFactory idb_database;
-  js::idb::IDBFactoryFactory idb_factory;
-  js::idb::IDBObjectStoreFactory idb_object_store;
-  js::idb::IDBRequestFactory idb_request;
-  js::idb::IDBOpenDBRequestFactory idb_open_db_request;
-  js::idb::IDBTransactionFactory idb_transaction;
+  LazyFactory<js::ConsoleFactory> console;
+  LazyFactory<js::HlsPlaylistTokenizerFactory> hls_playlist_tokenizer;
+  LazyFactory<js::LocationFactory> location;
+  LazyFactory<js::NativeAbrManagerFactory> native_abr_manager;
+  LazyFactory<js::NavigatorFactory> navigator;
+  LazyFactory<js::NetworkInformationFactory> network_information;
+  LazyFactory<js::TextDecoderFactory> text_decoder;
+  LazyFactory<js::TextEncoderFactory> text_encoder;
+  LazyFactory<js::URLFactory> url;
+  LazyFactory<js::VTTCueFactory> vtt_cue;
+  LazyFactory<js::XMLHttpRequestFactory> xml_http_request;
+
+  LazyFactory<js::events::EventFactory> event;
+  LazyFactory<js::events::IDBVersionChangeEventFactory> version_change_event;
+  LazyFactory<js::events::ProgressEventFactory> progress_event;
+  LazyFactory<js::events::MediaEncryptedEventFactory> media_encrypted_event;
+  LazyFactory<js::events::MediaKeyMessageEventFactory> media_key_message_event;
+
+  LazyFactory<js::dom::NodeFactory> node;
+  LazyFactory<js::dom::AttrFactory> attr;
+  LazyFactory<js::dom::ContainerNodeFactory> container_node;
+  LazyFactory<js::dom::CharacterDataFactory> character_data;
+  LazyFactory<js::dom::ElementFactory> element;
+  LazyFactory<js::dom::CommentFactory> comment;
+  LazyFactory<js::dom::TextFactory> text;
+  LazyFactory<js::dom::DocumentFactory> document;
+  LazyFactory<js::dom::DOMExceptionFactory> dom_exception;
+  LazyFactory<js::dom::DOMParserFactory> dom_parser;
+  LazyFactory<js::dom::DOMStringListFactory> dom_string_list;
+
+  LazyFactory<js::mse::AudioTrackFactory> audio_track;
+  LazyFactory<js::mse::AudioTrackListFactory> audio_track_list;
+  LazyFactory<js::mse::MediaErrorFactory> media_error;
+  LazyFactory<js::mse::MediaSourceFactory> media_source;
+  LazyFactory<js::mse::SourceBufferFactory> source_buffer;
+  LazyFactory<js::mse::TextTrackFactory> text_track;
+  LazyFactory<js::mse::TextTrackListFactory> text_track_list;
+  LazyFactory<js::mse::TimeRangesFactory> time_ranges;
+  LazyFactory<js::mse::HTMLMediaElementFactory> media_element;
+  LazyFactory<js::mse::HTMLVideoElementFactory> video_element;
+  LazyFactory<js::mse::VideoTrackFactory> video_track;
+  LazyFactory<js::mse::VideoTrackListFactory> video_track_list;
+
+  LazyFactory<js::eme::MediaKeySessionFactory> media_key_session;
+  LazyFactory<js::eme::MediaKeySystemAccessFactory> media_key_system_access;
+  LazyFactory<js::eme::MediaKeysFactory> media_keys;
+
+  LazyFactory<js::idb::IDBCursorFactory> idb_cursor;
+  LazyFactory<js::idb::IDBDatabaseFactory> idb_database;
+  LazyFactory<js::idb::IDBFactoryFactory> idb_factory;
+  LazyFactory<js::idb::IDBKeyRangeFactory> idb_key_range;
+  LazyFactory<js::idb::IDBObjectStoreFactory> idb_object_store;
+  LazyFactory<js::idb::IDBRequestFactory> idb_request;
+  LazyFactory<js::idb::IDBOpenDBRequestFactory> idb_open_db_request;
+  LazyFactory<js::idb::IDBTransactionFactory> idb_transaction;
 };
 
 Environment::Environment() {}
@@ -166,6 +278,7 @@ Environment::~Environment() {}
 
 
 void Environment::Install() {
+  const uint64_t install_start = StartupTracer::Instance.Now();
   RegisterDefaultKeySystems();
 
   impl_.reset(new Impl);
@@ -183,22 +296,34 @@ void Environment::Install() {
   RegisterGlobalFunction("gc", &GC);
 #endif
 
-  LocalVar<JsValue> document(
-      impl_->document.WrapInstance(js::dom::Document::EnsureGlobalDocument()));
+  LocalVar<JsValue> document(impl_->document.Get()->WrapInstance(
+      js::dom::Document::EnsureGlobalDocument()));
   SetMemberRaw(JsEngine::Instance()->global_handle(), "document", document);
 
-  CreateInstance("console", &impl_->console);
-  CreateInstance("location", &impl_->location);
-  CreateInstance("navigator", &impl_->navigator);
-  CreateInstance("indexedDB", &impl_->idb_factory);
+  CreateInstance("console", impl_->console.Get());
+  CreateInstance("location", impl_->location.Get());
+  CreateInstance("navigator", impl_->navigator.Get());
+  // Only apps using offline storage use IndexedDB, so create it when used.
+  Impl* impl = impl_.get();
+  DefineLazyGlobal("indexedDB", [impl]() {
+    CreateInstance("indexedDB", impl->idb_factory.Get());
+  });
 
   js::Base64::Install();
   js::Timeouts::Install();
+#if defined(USING_JSC)
+  CHECK(RunScript("wasm_streaming.js",
+                  reinterpret_cast<const uint8_t*>(kWasmStreamingPolyfill),
+                  sizeof(kWasmStreamingPolyfill) - 1));
+#endif
+  StartupTracer::Instance.AddSpan("Environment install", install_start);
 
   // Run the script directly since we are initializing, so this is
-  // effectively the event thread.
-  JsManagerImpl* manager = JsManagerImpl::Instance();
-  CHECK(RunScript(manager->GetPathForStaticFile("shaka-player.compiled.js")));
+  // effectively the event thread.  The files were read on the worker thread
+  // while the engine started.
+  ScriptFiles script = JsManagerImpl::Instance()->TakeShakaScript();
+  StartupSpan span("Compile shaka-player.compiled.js");
+  CHECK(RunScriptWithCodeCache(std::move(script)));
 }
 
 
@@ -210,9 +335,12 @@ void Environment::Install() {
 // \cond Doxygen_Skip
 ADD_GET_FACTORY(js::Console, console);
 ADD_GET_FACTORY(js::Debug, debug);
+ADD_GET_FACTORY(js::HlsPlaylistTokenizer, hls_playlist_tokenizer);
 ADD_GET_FACTORY(js::Location, location);
 ADD_GET_FACTORY(js::TestType, test_type);
+ADD_GET_FACTORY(js::NativeAbrManager, native_abr_manager);
 ADD_GET_FACTORY(js::Navigator, navigator);
+ADD_GET_FACTORY(js::NetworkInformation, network_information);
 ADD_GET_FACTORY(js::TextDecoder, text_decoder);
 ADD_GET_FACTORY(js::TextEncoder, text_encoder);
 ADD_GET_FACTORY(js::URL, url);
@@ -258,6 +386,7 @@ ADD_GET_FACTORY(js::eme::MediaKeys, media_keys);
 ADD_GET_FACTORY(js::idb::IDBCursor, idb_cursor);
 ADD_GET_FACTORY(js::idb::IDBDatabase, idb_database);
 ADD_GET_FACTORY(js::idb::IDBFactory, idb_factory);
+ADD_GET_FACTORY(js::idb::IDBKeyRange, idb_key_range);
 ADD_GET_FACTORY(js::idb::IDBObjectStore, idb_object_store);
 ADD_GET_FACTORY(js::idb::IDBRequest, idb_request);
 ADD_GET_FACTORY(js::idb::IDBOpenDBRequest, idb_open_db_request);
@@ -0,0 +1,92 @@
+// Copyright 2020 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     https://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "src/core/hedge_policy.h"
+
+#include <algorithm>
+#include <mutex>
+
+namespace shaka {
+
+constexpr const size_t HedgePolicy::kWindowSize;
+constexpr const size_t HedgePolicy::kMinSamples;
+constexpr const double HedgePolicy::kMinDelayMs;
+constexpr const size_t HedgePolicy::kMaxAlternates;
+
+HedgePolicy::HedgePolicy()
+    : mutex_("HedgePolicy"), window_(), window_next_(0), sample_count_(0) {}
+
+HedgePolicy::~HedgePolicy() {}
+
+void HedgePolicy::AddTtfb(double ttfb_ms) {
+  std::unique_lock<Mutex> lock(mutex_);
+  window_[window_next_] = ttfb_ms;
+  window_next_ = (window_next_ + 1) % kWindowSize;
+  sample_count_ = std::min(sample_count_ + 1, kWindowSize);
+}
+
+double HedgePolicy::GetDelayMs(uint32_t percentile) const {
+  std::unique_lock<Mutex> lock(mutex_);
+  if (sample_count_ < kMinSamples)
+    return -1;
+
+  std::vector<double> samples(window_.begin(),
+                              window_.begin() + sample_count_);
+  const size_t index =
+      std::min<size_t>(samples.size() * std::min(percentile, 100u) / 100,
+                       samples.size() - 1);
+  std::nth_element(samples.begin(), samples.begin() + index, samples.end());
+  return std::max(samples[index], kMinDelayMs);
+}
+
+void HedgePolicy::AddAlternates(const std::vector<std::string>& uris) {
+  if (uris.size() < 2)
+    return;
+
+  std::unique_lock<Mutex> lock(mutex_);
+  for (size_t i = 0; i < uris.size(); i++) {
+    auto it = index_.find(uris[i]);
+    if (it != index_.end()) {
+      alternates_.erase(it->second);
+      index_.erase(it);
+    }
+
+    alternates_.emplace_front(uris[i], uris[(i + 1) % uris.size()]);
+    index_.emplace(uris[i], alternates_.begin());
+    if (alternates_.size() > kMaxAlternates) {
+      index_.erase(alternates_.back().first);
+      alternates_.pop_back();
+    }
+  }
+}
+
+std::string HedgePolicy::GetAlternate(const std::string& url) const {
+  std::unique_lock<Mutex> lock(mutex_);
+  auto it = index_.find(url);
+  return it != index_.end() ? it->second->second : "";
+}
+
+void HedgePolicy::OnHedgeDone(bool won) {
+  std::unique_lock<Mutex> lock(mutex_);
+  stats_.hedge_count++;
+  if (won)
+    stats_.win_count++;
+}
+
+HedgePolicy::Stats HedgePolicy::GetStats() const {
+  std::unique_lock<Mutex> lock(mutex_);
+  return stats_;
+}
+
+}  // namespace shaka
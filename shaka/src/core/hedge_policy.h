@@ -0,0 +1,109 @@
+// Copyright 2020 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     https://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef SHAKA_EMBEDDED_CORE_HEDGE_POLICY_H_
+#define SHAKA_EMBEDDED_CORE_HEDGE_POLICY_H_
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <array>
+#include <list>
+#include <string>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include "src/debug/mutex.h"
+#include "src/util/macros.h"
+
+namespace shaka {
+
+/**
+ * Decides when a slow request should be hedged, i.e. duplicated so the first
+ * of the two responses can be used, and where the duplicate goes.  A request
+ * is hedged once it has waited longer for its first byte than a percentile of
+ * the recent times to first byte.  The duplicate goes to another URI of the
+ * same request (e.g. another CDN), which are recorded after the request
+ * filters run; if there is none, it goes to the same URI on a new connection.
+ *
+ * This type is thread-safe.
+ */
+class HedgePolicy {
+ public:
+  struct Stats {
+    /** The number of duplicate requests that were sent. */
+    uint64_t hedge_count = 0;
+    /** The number of duplicates that finished before the original. */
+    uint64_t win_count = 0;
+  };
+
+  /** The number of recent times to first byte to use. */
+  static constexpr const size_t kWindowSize = 50;
+  /** The number of samples needed before requests are hedged. */
+  static constexpr const size_t kMinSamples = 10;
+  /** The shortest time to wait before hedging, in milliseconds. */
+  static constexpr const double kMinDelayMs = 100;
+  /** The number of requests to remember alternate URIs for. */
+  static constexpr const size_t kMaxAlternates = 64;
+
+  HedgePolicy();
+  ~HedgePolicy();
+
+  SHAKA_NON_COPYABLE_OR_MOVABLE_TYPE(HedgePolicy);
+
+  /** Records the time to first byte of a completed request. */
+  void AddTtfb(double ttfb_ms);
+
+  /**
+   * @return The time, in milliseconds, a request should wait for its first
+   *   byte before it is hedged, or a negative number if there aren't enough
+   *   samples yet.
+   */
+  double GetDelayMs(uint32_t percentile) const;
+
+  /**
+   * Records that the given URIs are alternates for the same request; each
+   * is used to hedge a request for the others.
+   */
+  void AddAlternates(const std::vector<std::string>& uris);
+
+  /**
+   * @return The URI to send the duplicate of a request for |url| to, or an
+   *   empty string if there is no alternate.
+   */
+  std::string GetAlternate(const std::string& url) const;
+
+  /** Records the result of a duplicate request. */
+  void OnHedgeDone(bool won);
+
+  /** @return The current statistics of the hedged requests. */
+  Stats GetStats() const;
+
+ private:
+  using Entry = std::pair<std::string, std::string>;
+
+  mutable Mutex mutex_;
+  std::array<double, kWindowSize> window_;
+  size_t window_next_;
+  size_t sample_count_;
+  // Most recently added first; this maps each URI to its alternate.
+  std::list<Entry> alternates_;
+  std::unordered_map<std::string, std::list<Entry>::iterator> index_;
+  Stats stats_;
+};
+
+}  // namespace shaka
+
+#endif  // SHAKA_EMBEDDED_CORE_HEDGE_POLICY_H_
@@ -0,0 +1,445 @@
+// Copyright 2020 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     https://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "src/core/http_cache.h"
+
+#include <glog/logging.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <iterator>
+#include <sstream>
+
+#include "src/core/task_runner.h"
+#include "src/util/crypto.h"
+#include "src/util/file_system.h"
+#include "src/util/utils.h"
+
+namespace shaka {
+
+namespace {
+
+/** The first line of each file; this changes if the format changes. */
+constexpr const char* kFileHeader = "shaka-http-cache 1";
+
+/** The response headers that a "304 Not Modified" response can't change. */
+const char* const kBodyHeaders[] = {"content-encoding", "content-length",
+                                    "content-range", "content-type"};
+
+std::string GetHeader(const std::map<std::string, std::string>& headers,
+                      const std::string& name) {
+  auto it = headers.find(name);
+  return it == headers.end() ? "" : it->second;
+}
+
+/**
+ * Parses a date in the format servers are required to send (e.g.
+ * "Sun, 06 Nov 1994 08:49:37 GMT").
+ * @return Whether the date was valid.
+ */
+bool ParseHttpDate(const std::string& value, uint64_t* time) {
+  const char* const kMonths[] = {"jan", "feb", "mar", "apr", "may", "jun",
+                                 "jul", "aug", "sep", "oct", "nov", "dec"};
+  char month_name[4];
+  int day, year, hour, minute, second;
+  if (sscanf(value.c_str(), "%*3s, %2d %3s %4d %2d:%2d:%2d GMT", &day,
+             month_name, &year, &hour, &minute, &second) != 6) {
+    return false;
+  }
+  int month = 0;
+  while (month < 12 && util::ToAsciiLower(month_name) != kMonths[month])
+    month++;
+  if (month == 12 || year < 1970 || day < 1 || day > 31 || hour > 23 ||
+      minute > 59 || second > 60) {
+    return false;
+  }
+
+  // Count the days since the epoch, with March as the first month of the year
+  // so the leap day is at the end.
+  const int64_t y = month < 2 ? year - 1 : year;
+  const int64_t shifted_month = month < 2 ? month + 10 : month - 2;
+  const int64_t day_of_year = (153 * shifted_month + 2) / 5 + day - 1;
+  const int64_t days =
+      y * 365 + y / 4 - y / 100 + y / 400 + day_of_year - 719468;
+  *time = static_cast<uint64_t>(days * 86400 + hour * 3600 + minute * 60 +
+                                second);
+  return true;
+}
+
+/** @return The Cache-Control directives of the given headers. */
+std::vector<std::string> GetCacheControl(
+    const std::map<std::string, std::string>& headers) {
+  std::vector<std::string> ret;
+  std::stringstream stream(
+      util::ToAsciiLower(GetHeader(headers, "cache-control")));
+  std::string directive;
+  while (std::getline(stream, directive, ','))
+    ret.push_back(util::TrimAsciiWhitespace(directive));
+  return ret;
+}
+
+bool HasDirective(const std::vector<std::string>& directives,
+                  const std::string& name) {
+  for (const std::string& directive : directives) {
+    const std::string prefix = name + "=";
+    if (directive == name || directive.compare(0, prefix.size(), prefix) == 0)
+      return true;
+  }
+  return false;
+}
+
+std::vector<uint8_t> Serialize(const std::string& key,
+                               const HttpCache::Entry& entry) {
+  // After the header, a line with the sizes, then the key, then a line each
+  // for the status text, URI, and headers, then the body.
+  std::string head = std::string(kFileHeader) + "\n" +
+                     std::to_string(key.size()) + " " +
+                     std::to_string(entry.status) + " " +
+                     std::to_string(entry.fresh_until) + " " +
+                     std::to_string(entry.headers.size()) + " " +
+                     std::to_string(entry.data.size()) + "\n" + key + "\n" +
+                     entry.status_text + "\n" + entry.uri + "\n";
+  for (auto& header : entry.headers)
+    head += header.first + ": " + header.second + "\n";
+
+  std::vector<uint8_t> ret;
+  ret.reserve(head.size() + entry.data.size());
+  ret.insert(ret.end(), head.begin(), head.end());
+  ret.insert(ret.end(), entry.data.begin(), entry.data.end());
+  return ret;
+}
+
+/** Reads a line of |data| starting at |*pos|. */
+bool ReadLine(const std::vector<uint8_t>& data, size_t* pos,
+              std::string* line) {
+  const uint8_t* start = data.data() + *pos;
+  const void* end = memchr(start, '\n', data.size() - *pos);
+  if (!end)
+    return false;
+  line->assign(start, static_cast<const uint8_t*>(end));
+  *pos += line->size() + 1;
+  return true;
+}
+
+std::shared_ptr<const HttpCache::Entry> Deserialize(
+    const std::vector<uint8_t>& data, const std::string& key) {
+  size_t pos = 0;
+  std::string line;
+  if (!ReadLine(data, &pos, &line) || line != kFileHeader ||
+      !ReadLine(data, &pos, &line)) {
+    return nullptr;
+  }
+
+  std::shared_ptr<HttpCache::Entry> ret(new HttpCache::Entry);
+  size_t key_size;
+  size_t header_count;
+  size_t body_size;
+  std::stringstream sizes(line);
+  if (!(sizes >> key_size >> ret->status >> ret->fresh_until >> header_count >>
+        body_size) ||
+      key_size != key.size() || data.size() - pos < key_size + 1 ||
+      memcmp(data.data() + pos, key.data(), key_size) != 0) {
+    return nullptr;
+  }
+  pos += key_size + 1;
+  if (!ReadLine(data, &pos, &ret->status_text) ||
+      !ReadLine(data, &pos, &ret->uri)) {
+    return nullptr;
+  }
+  for (size_t i = 0; i < header_count; i++) {
+    if (!ReadLine(data, &pos, &line))
+      return nullptr;
+    const size_t split = line.find(": ");
+    if (split == std::string::npos)
+      return nullptr;
+    ret->headers[line.substr(0, split)] = line.substr(split + 2);
+  }
+  if (data.size() - pos != body_size)
+    return nullptr;
+  ret->data.assign(data.begin() + pos, data.end());
+  return ret;
+}
+
+}  // namespace
+
+constexpr const size_t HttpCache::kMaxMemoryBytes;
+constexpr const size_t HttpCache::kMaxEntryBytes;
+
+std::vector<std::string> HttpCache::Entry::GetValidatorHeaders() const {
+  std::vector<std::string> ret;
+  const std::string etag = GetHeader(headers, "etag");
+  if (!etag.empty())
+    ret.push_back("If-None-Match: " + etag);
+  const std::string last_modified = GetHeader(headers, "last-modified");
+  if (!last_modified.empty())
+    ret.push_back("If-Modified-Since: " + last_modified);
+  return ret;
+}
+
+HttpCache::HttpCache(size_t max_bytes)
+    : mutex_("HttpCache"),
+      disk_runner_(nullptr),
+      max_bytes_(max_bytes),
+      memory_bytes_(0),
+      disk_bytes_(0) {}
+
+HttpCache::~HttpCache() {}
+
+// static
+uint64_t HttpCache::GetFreshUntil(
+    const std::map<std::string, std::string>& headers, uint64_t now) {
+  const std::vector<std::string> directives = GetCacheControl(headers);
+  if (HasDirective(directives, "no-cache"))
+    return now;
+  for (const std::string& directive : directives) {
+    if (directive.compare(0, 8, "max-age=") == 0)
+      return now + strtoull(directive.c_str() + 8, nullptr, 10);
+  }
+
+  // Expires is relative to the server's clock, so use its Date if it has one.
+  uint64_t expires;
+  if (!ParseHttpDate(GetHeader(headers, "expires"), &expires))
+    return now;
+  uint64_t date;
+  if (ParseHttpDate(GetHeader(headers, "date"), &date))
+    return expires > date ? now + (expires - date) : now;
+  return expires > now ? expires : now;
+}
+
+// static
+bool HttpCache::CanStore(int status,
+                         const std::map<std::string, std::string>& headers,
+                         uint64_t now) {
+  if (status != 200 && status != 206)
+    return false;
+  // The cache isn't keyed on the user, so don't keep responses that are only
+  // meant for one user.
+  const std::vector<std::string> directives = GetCacheControl(headers);
+  if (HasDirective(directives, "no-store") ||
+      HasDirective(directives, "private")) {
+    return false;
+  }
+  // Requests are always sent with the same headers, except for the encodings
+  // that are accepted, so other Vary values can't be matched.
+  const std::string vary =
+      util::ToAsciiLower(util::TrimAsciiWhitespace(GetHeader(headers, "vary")));
+  if (!vary.empty() && vary != "accept-encoding")
+    return false;
+
+  return GetFreshUntil(headers, now) > now || headers.count("etag") > 0 ||
+         headers.count("last-modified") > 0;
+}
+
+void HttpCache::SetDirectory(const std::string& dir, TaskRunner* disk_runner) {
+  std::unique_lock<Mutex> lock(mutex_);
+  dir_ = dir;
+  disk_runner_ = disk_runner;
+  disk_lru_.clear();
+  disk_entries_.clear();
+  disk_bytes_ = 0;
+
+  util::FileSystem fs;
+  std::vector<std::string> files;
+  if (!fs.DirectoryExists(dir) && !fs.CreateDirectory(dir)) {
+    LOG(ERROR) << "Unable to create HTTP cache directory";
+    dir_.clear();
+    return;
+  }
+  if (!fs.ListFiles(dir, &files))
+    return;
+  for (const std::string& file : files) {
+    const ssize_t size = fs.FileSize(util::FileSystem::PathJoin(dir, file));
+    if (size < 0)
+      continue;
+    disk_lru_.emplace_back(file, static_cast<size_t>(size));
+    disk_entries_.emplace(file, std::prev(disk_lru_.end()));
+    disk_bytes_ += static_cast<size_t>(size);
+  }
+  EvictUntilFits(0);
+  VLOG(1) << "Found " << disk_lru_.size() << " HTTP cache entries using "
+          << disk_bytes_ << " bytes";
+}
+
+bool HttpCache::enabled() const {
+  std::unique_lock<Mutex> lock(mutex_);
+  return max_bytes_ > 0;
+}
+
+void HttpCache::SetMaxSize(size_t max_bytes) {
+  std::unique_lock<Mutex> lock(mutex_);
+  max_bytes_ = max_bytes;
+  EvictUntilFits(0);
+  if (max_bytes == 0) {
+    memory_lru_.clear();
+    memory_entries_.clear();
+    memory_bytes_ = 0;
+  }
+}
+
+std::shared_ptr<const HttpCache::Entry> HttpCache::Get(
+    const std::string& key) {
+  const std::string file_name = GetFileName(key);
+  std::string path;
+  {
+    std::unique_lock<Mutex> lock(mutex_);
+    auto it = memory_entries_.find(key);
+    if (it != memory_entries_.end()) {
+      memory_lru_.splice(memory_lru_.begin(), memory_lru_, it->second);
+      return it->second->second;
+    }
+    if (dir_.empty() || disk_entries_.count(file_name) == 0)
+      return nullptr;
+    path = util::FileSystem::PathJoin(dir_, file_name);
+  }
+
+  // Don't hold the lock while reading.  If the file is being written, it won't
+  // parse and this is just a miss.
+  util::FileSystem fs;
+  std::vector<uint8_t> data;
+  if (!fs.ReadFile(path, &data))
+    return nullptr;
+  std::shared_ptr<const Entry> entry = Deserialize(data, key);
+  if (!entry)
+    return nullptr;
+
+  std::unique_lock<Mutex> lock(mutex_);
+  auto it = disk_entries_.find(file_name);
+  if (it == disk_entries_.end())
+    return nullptr;
+  disk_lru_.splice(disk_lru_.begin(), disk_lru_, it->second);
+  AddToMemory(key, entry);
+  return entry;
+}
+
+void HttpCache::Put(const std::string& key,
+                    std::shared_ptr<const Entry> entry) {
+  if (entry->data.size() > kMaxEntryBytes)
+    return;
+
+  std::unique_lock<Mutex> lock(mutex_);
+  if (max_bytes_ == 0)
+    return;
+  AddToMemory(key, entry);
+  if (dir_.empty())
+    return;
+
+  const std::string file_name = GetFileName(key);
+  auto data = std::make_shared<std::vector<uint8_t>>(Serialize(key, *entry));
+  auto existing = disk_entries_.find(file_name);
+  if (data->size() > max_bytes_) {
+    if (existing != disk_entries_.end())
+      RemoveFile(existing->second);
+    return;
+  }
+  if (existing != disk_entries_.end()) {
+    // The file is replaced below, so only remove it from the index.
+    disk_bytes_ -= existing->second->second;
+    disk_lru_.erase(existing->second);
+    disk_entries_.erase(existing);
+  }
+  EvictUntilFits(data->size());
+  disk_lru_.emplace_front(file_name, data->size());
+  disk_entries_.emplace(file_name, disk_lru_.begin());
+  disk_bytes_ += data->size();
+
+  const std::string path = util::FileSystem::PathJoin(dir_, file_name);
+  RunOnDisk([path, data]() {
+    util::FileSystem fs;
+    if (!fs.WriteFile(path, *data))
+      LOG(WARNING) << "Unable to write HTTP cache entry";
+  });
+}
+
+std::shared_ptr<const HttpCache::Entry> HttpCache::Refresh(
+    const std::string& key, const std::map<std::string, std::string>& headers,
+    uint64_t now) {
+  std::shared_ptr<const Entry> old_entry = Get(key);
+  if (!old_entry)
+    return nullptr;
+
+  std::shared_ptr<Entry> entry(new Entry(*old_entry));
+  for (auto& header : headers) {
+    bool is_body_header = false;
+    for (const char* name : kBodyHeaders)
+      is_body_header |= header.first == name;
+    if (!is_body_header)
+      entry->headers[header.first] = header.second;
+  }
+  entry->fresh_until = GetFreshUntil(entry->headers, now);
+  Put(key, entry);
+  return entry;
+}
+
+void HttpCache::ClearMemory() {
+  std::unique_lock<Mutex> lock(mutex_);
+  memory_lru_.clear();
+  memory_entries_.clear();
+  memory_bytes_ = 0;
+}
+
+// static
+std::string HttpCache::GetFileName(const std::string& key) {
+  const std::vector<uint8_t> hash = util::HashData(
+      reinterpret_cast<const uint8_t*>(key.data()), key.size());
+  return util::ToHexString(hash.data(), hash.size());
+}
+
+void HttpCache::AddToMemory(const std::string& key,
+                            std::shared_ptr<const Entry> entry) {
+  auto it = memory_entries_.find(key);
+  if (it != memory_entries_.end()) {
+    memory_bytes_ -= it->second->second->data.size();
+    memory_lru_.erase(it->second);
+    memory_entries_.erase(it);
+  }
+
+  const size_t size = entry->data.size();
+  if (size > kMaxMemoryBytes)
+    return;
+  while (!memory_lru_.empty() && memory_bytes_ + size > kMaxMemoryBytes) {
+    memory_bytes_ -= memory_lru_.back().second->data.size();
+    memory_entries_.erase(memory_lru_.back().first);
+    memory_lru_.pop_back();
+  }
+  memory_lru_.emplace_front(key, std::move(entry));
+  memory_entries_.emplace(key, memory_lru_.begin());
+  memory_bytes_ += size;
+}
+
+void HttpCache::RemoveFile(DiskList::iterator it) {
+  const std::string path = util::FileSystem::PathJoin(dir_, it->first);
+  disk_bytes_ -= it->second;
+  disk_entries_.erase(it->first);
+  disk_lru_.erase(it);
+  RunOnDisk([path]() {
+    util::FileSystem fs;
+    if (fs.FileExists(path) && !fs.DeleteFile(path))
+      LOG(WARNING) << "Unable to delete HTTP cache entry";
+  });
+}
+
+void HttpCache::EvictUntilFits(size_t extra_bytes) {
+  while (!disk_lru_.empty() && disk_bytes_ + extra_bytes > max_bytes_)
+    RemoveFile(std::prev(disk_lru_.end()));
+}
+
+void HttpCache::RunOnDisk(std::function<void()> work) {
+  if (disk_runner_)
+    disk_runner_->PostTask(TaskPriority::Internal, std::move(work));
+  else
+    work();
+}
+
+}  // namespace shaka
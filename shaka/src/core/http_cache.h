@@ -0,0 +1,179 @@
+// Copyright 2020 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     https://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef SHAKA_EMBEDDED_CORE_HTTP_CACHE_H_
+#define SHAKA_EMBEDDED_CORE_HTTP_CACHE_H_
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <functional>
+#include <list>
+#include <map>
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include "src/core/segment_cache.h"
+#include "src/debug/mutex.h"
+#include "src/util/macros.h"
+
+namespace shaka {
+
+class TaskRunner;
+
+/**
+ * A persistent cache of network responses that follows the HTTP caching
+ * headers.  This is used for the responses that are needed again each time
+ * the same content is played (manifests, playlists, and init segments), so
+ * starting it again can skip those round trips.
+ *
+ * Entries are stored as one file each in a directory and the total size of
+ * the files is bounded; the most recently used entries are also kept in
+ * memory.  An entry is used directly while it is fresh (per Cache-Control
+ * max-age or Expires); after that, the request is sent with its validators
+ * (ETag or Last-Modified) and a "304 Not Modified" response reuses the body.
+ *
+ * This type is thread-safe.
+ */
+class HttpCache {
+ public:
+  struct Entry : SegmentCache::Entry {
+    /**
+     * The time, in seconds since the epoch, until which this can be used
+     * without asking the server.
+     */
+    uint64_t fresh_until = 0;
+
+    /** @return Whether this can be used at the given time without asking. */
+    bool IsFresh(uint64_t now) const {
+      return now < fresh_until;
+    }
+
+    /** @return The request headers to ask the server if this changed. */
+    std::vector<std::string> GetValidatorHeaders() const;
+  };
+
+  /** The maximum number of bytes of entries to keep in memory. */
+  static constexpr const size_t kMaxMemoryBytes = 4 * 1024 * 1024;
+
+  /** The largest response body to store. */
+  static constexpr const size_t kMaxEntryBytes = 4 * 1024 * 1024;
+
+  /** Creates a new cache holding at most |max_bytes| on disk. */
+  explicit HttpCache(size_t max_bytes = 0);
+  ~HttpCache();
+
+  SHAKA_NON_COPYABLE_OR_MOVABLE_TYPE(HttpCache);
+
+  /**
+   * Gets the time, in seconds since the epoch, until which a response with the
+   * given headers is fresh.  This is |now| if it needs to be validated before
+   * each use.
+   */
+  static uint64_t GetFreshUntil(
+      const std::map<std::string, std::string>& headers, uint64_t now);
+
+  /**
+   * @return Whether a response with the given status and headers can be
+   *   stored.  It must be allowed by Cache-Control (i.e. not "no-store" or
+   *   "private") and either be fresh or have a validator.
+   */
+  static bool CanStore(int status,
+                       const std::map<std::string, std::string>& headers,
+                       uint64_t now);
+
+  /**
+   * Sets the directory to store entries in and finds the entries already
+   * there.  The files are written and deleted on the given task runner; if it
+   * is null, that is done on the calling thread.
+   */
+  void SetDirectory(const std::string& dir, TaskRunner* disk_runner);
+
+  /** @return Whether the cache will store any entries. */
+  bool enabled() const;
+
+  /**
+   * Changes the maximum size of the files.  This will evict entries if the
+   * cache is larger than the new size.  A size of 0 disables the cache.
+   */
+  void SetMaxSize(size_t max_bytes);
+
+  /**
+   * Looks up the given entry, reading it from disk if it isn't in memory.
+   * The caller should check whether it is fresh.
+   * @return The entry, or nullptr if it isn't in the cache.
+   */
+  std::shared_ptr<const Entry> Get(const std::string& key);
+
+  /**
+   * Adds the given entry, replacing any existing entry with the same key.
+   * Entries that are larger than kMaxEntryBytes or the max size are ignored.
+   */
+  void Put(const std::string& key, std::shared_ptr<const Entry> entry);
+
+  /**
+   * Updates an entry with the headers of a "304 Not Modified" response for it.
+   * @return The updated entry, or nullptr if it is no longer in the cache.
+   */
+  std::shared_ptr<const Entry> Refresh(
+      const std::string& key, const std::map<std::string, std::string>& headers,
+      uint64_t now);
+
+  /** Removes all entries from memory; the files are kept. */
+  void ClearMemory();
+
+ private:
+  using MemoryList =
+      std::list<std::pair<std::string, std::shared_ptr<const Entry>>>;
+  // The file names and sizes of the stored entries.
+  using DiskList = std::list<std::pair<std::string, size_t>>;
+
+  /** @return The name of the file that stores the given key. */
+  static std::string GetFileName(const std::string& key);
+
+  /** Adds the entry to the memory tier, evicting older entries. */
+  void AddToMemory(const std::string& key, std::shared_ptr<const Entry> entry);
+
+  /** Removes the given file from the index and deletes it. */
+  void RemoveFile(DiskList::iterator it);
+
+  /** Removes the least-recently-used files until |extra_bytes| fit. */
+  void EvictUntilFits(size_t extra_bytes);
+
+  /** Runs the given disk work on |disk_runner_|. */
+  void RunOnDisk(std::function<void()> work);
+
+  mutable Mutex mutex_;
+  std::string dir_;
+  TaskRunner* disk_runner_;
+  size_t max_bytes_;
+
+  // Most-recently-used entries are at the front.
+  MemoryList memory_lru_;
+  std::unordered_map<std::string, MemoryList::iterator> memory_entries_;
+  size_t memory_bytes_;
+
+  // Most-recently-used files are at the front.  The files found on startup
+  // are all treated as the least recently used.
+  DiskList disk_lru_;
+  std::unordered_map<std::string, DiskList::iterator> disk_entries_;
+  size_t disk_bytes_;
+};
+
+}  // namespace shaka
+
+#endif  // SHAKA_EMBEDDED_CORE_HTTP_CACHE_H_
@@ -0,0 +1,65 @@
+// Copyright 2020 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     https://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "src/core/in_flight_limiter.h"
+
+#include <glog/logging.h>
+
+namespace shaka {
+
+InFlightLimiter::InFlightLimiter()
+    : max_bytes_(0), max_request_bytes_(0), total_(0), released_(false) {}
+
+InFlightLimiter::~InFlightLimiter() {}
+
+void InFlightLimiter::SetLimits(uint64_t max_bytes,
+                                uint64_t max_request_bytes) {
+  max_bytes_ = max_bytes;
+  max_request_bytes_ = max_request_bytes;
+  released_ = true;
+}
+
+bool InFlightLimiter::TryReceive(const void* request, size_t bytes) {
+  uint64_t& held = requests_[request];
+  if (max_bytes_ != 0 && held + bytes > max_request_bytes_ &&
+      total_ + bytes > max_bytes_) {
+    for (auto& pair : requests_) {
+      if (pair.second > held)
+        return false;
+    }
+  }
+
+  held += bytes;
+  total_ += bytes;
+  return true;
+}
+
+void InFlightLimiter::Release(const void* request) {
+  auto it = requests_.find(request);
+  if (it == requests_.end())
+    return;
+  DCHECK_GE(total_, it->second);
+  total_ -= it->second;
+  if (it->second > 0)
+    released_ = true;
+  requests_.erase(it);
+}
+
+bool InFlightLimiter::TakeReleased() {
+  const bool ret = released_;
+  released_ = false;
+  return ret;
+}
+
+}  // namespace shaka
@@ -0,0 +1,85 @@
+// Copyright 2020 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     https://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef SHAKA_EMBEDDED_CORE_IN_FLIGHT_LIMITER_H_
+#define SHAKA_EMBEDDED_CORE_IN_FLIGHT_LIMITER_H_
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <unordered_map>
+
+#include "src/util/macros.h"
+
+namespace shaka {
+
+/**
+ * Limits the number of response bytes held by requests that haven't
+ * completed yet.  Each request can always hold up to the per-request limit,
+ * so small requests aren't stalled by large downloads; beyond that, a request
+ * can only receive more while the total is under the global limit.  The
+ * request holding the most bytes is always allowed to continue so it can
+ * complete and free its bytes.
+ *
+ * Requests are identified by an opaque pointer.
+ *
+ * This type is NOT thread-safe.
+ */
+class InFlightLimiter {
+ public:
+  InFlightLimiter();
+  ~InFlightLimiter();
+
+  SHAKA_NON_COPYABLE_OR_MOVABLE_TYPE(InFlightLimiter);
+
+  /**
+   * Changes the limits.  If |max_bytes| is 0, there is no limit.
+   * @param max_bytes The maximum number of bytes across all requests.
+   * @param max_request_bytes The number of bytes each request can hold
+   *   regardless of the global limit.
+   */
+  void SetLimits(uint64_t max_bytes, uint64_t max_request_bytes);
+
+  /** @return The number of bytes held across all requests. */
+  uint64_t in_flight_bytes() const {
+    return total_;
+  }
+
+  /**
+   * Records that the given request received the given number of bytes, if it
+   * is allowed to.
+   * @return False if the request should pause instead.
+   */
+  bool TryReceive(const void* request, size_t bytes);
+
+  /** Records that the given request completed or was stopped. */
+  void Release(const void* request);
+
+  /**
+   * @return Whether bytes were released or the limits changed since the last
+   *   call, so paused requests should try again.
+   */
+  bool TakeReleased();
+
+ private:
+  uint64_t max_bytes_;
+  uint64_t max_request_bytes_;
+  uint64_t total_;
+  std::unordered_map<const void*, uint64_t> requests_;
+  bool released_;
+};
+
+}  // namespace shaka
+
+#endif  // SHAKA_EMBEDDED_CORE_IN_FLIGHT_LIMITER_H_
@@ -14,27 +14,140 @@
 
 #include "src/core/js_manager_impl.h"
 
+#include <memory>
 #include <utility>
 
+#include "src/core/offline_index.h"
+#include "src/core/wasm_module_cache.h"
+#include "src/debug/startup_tracer.h"
+#include "src/js/dom/mpd_patcher.h"
 #include "src/mapping/convert_js.h"
 #include "src/mapping/js_engine.h"
+#include "src/media/decoding_info_cache.h"
 #include "src/util/clock.h"
 #include "src/util/file_system.h"
+#include "src/util/url.h"
 
 namespace shaka {
 
 using std::placeholders::_1;
 
-JsManagerImpl::JsManagerImpl(const JsManager::StartupOptions& options)
+namespace {
+
+/** The file to store the results of decoder capability queries in. */
+constexpr const char* kDecodingInfoCacheFileName = "decoding_info.cache";
+
+/** The file to store the metadata of the content stored offline in. */
+constexpr const char* kOfflineIndexFileName = "offline_index.cache";
+
+/** The directory to store the responses of the HTTP cache in. */
+constexpr const char* kHttpCacheDirName = "http_cache";
+
+/** The directory to store compiled WebAssembly modules in. */
+constexpr const char* kWasmCacheDirName = "wasm_cache";
+
+/** The file to store TLS sessions in so they can be resumed on the next run. */
+constexpr const char* kTlsSessionCacheFileName = "tls_sessions.cache";
+
+/** The file, in the static data dir, containing the Shaka Player library. */
+constexpr const char* kShakaScriptFileName = "shaka-player.compiled.js";
+
+/**
+ * The file to store the player's code cache in.  This is written to the
+ * dynamic data dir; a prebuilt copy can also be shipped in the static data
+ * dir so the first launch doesn't need to parse the player either.
+ */
+constexpr const char* kCodeCacheFileName = "shaka-player.code_cache";
+
+/** @return The URL of the static data dir, ending in a slash. */
+std::string GetBaseUrl(const JsManager::StartupOptions& options) {
+  const std::string dir = util::FileSystem::AbsolutePath(
+      util::FileSystem::GetPathForStaticFile(
+          options.static_data_dir, options.is_static_relative_to_bundle, ""));
+  const std::string url = util::FilePathToUrl(dir);
+  return url[url.size() - 1] == '/' ? url : url + "/";
+}
+
+/**
+ * Runs the given script callback on the event thread.  If this is already the
+ * event thread (i.e. the app runs the event loop), this runs it now so the app
+ * can wait for the result without deadlocking.
+ */
+template <typename Func>
+std::shared_ptr<ThreadEvent<bool>> RunScriptTask(TaskRunner* event_loop,
+                                                 Func&& callback) {
+  if (event_loop->BelongsToCurrentThread()) {
+    auto ret = std::make_shared<ThreadEvent<bool>>("RunScript");
+    ret->SignalAllIfNotSet(callback());
+    return ret;
+  }
+  return event_loop->AddInternalTask(TaskPriority::Immediate, "RunScript",
+                                     std::forward<Func>(callback));
+}
+
+}  // namespace
+
+JsManagerImpl::JsManagerImpl(const JsManager::StartupOptions& options,
+                             const JsManager::HeapOptions& heap_options,
+                             JsManager::EventLoopMode mode)
     : tracker_(&heap_tracer_),
       startup_options_(options),
-      event_loop_(std::bind(&JsManagerImpl::EventThreadWrapper, this, _1),
-                  &util::Clock::Instance, /* is_worker */ false) {}
+      heap_options_(heap_options),
+      base_url_(GetBaseUrl(options)),
+      shaka_script_future_(shaka_script_.get_future()),
+      ready_future_(ready_.get_future().share()),
+      event_loop_(mode == JsManager::EventLoopMode::AppThread
+                      ? std::function<void(TaskRunner::RunLoop)>(
+                            &JsManagerImpl::AppThreadWrapper)
+                      : std::bind(&JsManagerImpl::EventThreadWrapper, this,
+                                  _1),
+                  &util::Clock::Instance, /* is_worker */ false,
+                  /* is_manual */ mode == JsManager::EventLoopMode::AppThread),
+      completions_(&event_loop_, &JsManagerImpl::RunMicrotasks),
+      worker_([](TaskRunner::RunLoop run_loop) { run_loop(); },
+              &util::Clock::Instance, /* is_worker */ true),
+      storage_thread_(&event_loop_, &util::Clock::Instance) {
+  // Read the files on the worker thread so it happens while the event thread
+  // starts the JavaScript engine and so this doesn't block the app.
+  worker_.PostTask(TaskPriority::Immediate, [this]() {
+    StartupSpan span("Read shaka-player.compiled.js");
+    shaka_script_.set_value(
+        ReadScriptFiles(GetPathForStaticFile(kShakaScriptFileName),
+                        GetPathForDynamicFile(kCodeCacheFileName),
+                        GetPathForStaticFile(kCodeCacheFileName)));
+  });
+  worker_.PostTask(TaskPriority::Internal, [this]() {
+    media::DecodingInfoCache::Instance.SetFile(
+        GetPathForDynamicFile(kDecodingInfoCacheFileName));
+    OfflineIndex::Instance.SetFile(
+        GetPathForDynamicFile(kOfflineIndexFileName));
+    network_thread_.tls_session_cache()->SetFile(
+        GetPathForDynamicFile(kTlsSessionCacheFileName));
+    network_thread_.http_cache()->SetDirectory(
+        GetPathForDynamicFile(kHttpCacheDirName), &worker_);
+    WasmModuleCache::Instance.SetDirectory(
+        GetPathForDynamicFile(kWasmCacheDirName));
+  });
+  // There is no event thread, so start the engine on this thread, which is
+  // the one that will run the tasks.
+  if (mode == JsManager::EventLoopMode::AppThread)
+    StartEngine();
+  StartupTracer::Instance.AddMilestone("JsManager created");
+}
 
 JsManagerImpl::~JsManagerImpl() {
   Stop();
 }
 
+void JsManagerImpl::Stop() {
+  event_loop_.Stop();
+  // When the app runs the event loop, nothing else destroys the engine.
+  if (engine_)
+    StopEngine();
+  worker_.Stop();
+  storage_thread_.Stop();
+}
+
 std::string JsManagerImpl::GetPathForStaticFile(const std::string& file) const {
   return util::FileSystem::GetPathForStaticFile(
       startup_options_.static_data_dir,
@@ -47,6 +160,10 @@ std::string JsManagerImpl::GetPathForDynamicFile(
       startup_options_.dynamic_data_dir, file);
 }
 
+ScriptFiles JsManagerImpl::TakeShakaScript() {
+  return shaka_script_future_.get();
+}
+
 void JsManagerImpl::WaitUntilFinished() {
   if (event_loop_.is_running() && event_loop_.HasPendingWork()) {
     event_loop_.WaitUntilFinished();
@@ -59,8 +176,7 @@ std::shared_ptr<ThreadEvent<bool>> JsManagerImpl::RunScript(
   CHECK(event_loop_.is_running());
   auto callback = std::bind(
       static_cast<bool (*)(const std::string&)>(&shaka::RunScript), path);
-  return event_loop_.AddInternalTask(TaskPriority::Immediate, "RunScript",
-                                     std::move(callback));
+  return RunScriptTask(&event_loop_, std::move(callback));
 }
 
 std::shared_ptr<ThreadEvent<bool>> JsManagerImpl::RunScript(
@@ -71,27 +187,63 @@ std::shared_ptr<ThreadEvent<bool>> JsManagerImpl::RunScript(
       static_cast<bool (*)(const std::string&, const uint8_t*, size_t)>(
           &shaka::RunScript);
   auto callback = std::bind(run_script, path, data, data_size);
-  return event_loop_.AddInternalTask(TaskPriority::Immediate, "RunScript",
-                                     std::move(callback));
+  return RunScriptTask(&event_loop_, std::move(callback));
 }
 
-void JsManagerImpl::EventThreadWrapper(TaskRunner::RunLoop run_loop) {
-  JsEngine engine;
+// static
+void JsManagerImpl::RunMicrotasks() {
+#ifdef USING_V8
+  // Completions settle Promises without running their handlers, so run them
+  // once for the whole batch.  JSC runs them as part of settling the Promise.
+  GetIsolate()->RunMicrotasks();
+#endif
+}
 
+void JsManagerImpl::EventThreadWrapper(TaskRunner::RunLoop run_loop) {
+  StartEngine();
   {
     JsEngine::SetupContext setup;
+    run_loop();
+  }
+  StopEngine();
+}
+
+// static
+void JsManagerImpl::AppThreadWrapper(TaskRunner::RunLoop run_loop) {
+  JsEngine::SetupContext setup;
+  run_loop();
+}
+
+void JsManagerImpl::StartEngine() {
+  const uint64_t engine_start = StartupTracer::Instance.Now();
+  engine_.reset(new JsEngine(heap_options_));
+
+  JsEngine::SetupContext setup;
 #ifdef USING_V8
-    engine.isolate()->SetEmbedderHeapTracer(&heap_tracer_);
+  engine_->isolate()->SetEmbedderHeapTracer(&heap_tracer_);
 #endif
+  StartupTracer::Instance.AddSpan("JsEngine init", engine_start);
 
-    Environment env;
-    env.Install();
+  env_.reset(new Environment);
+  env_->Install();
+  ready_.set_value();
 
-    run_loop();
+  // Collect garbage between tasks when possible so it doesn't pause them.
+  event_loop_.SetIdleHandler(
+      [](uint64_t idle_ms) { return JsEngine::Instance()->OnIdle(idle_ms); });
+  cpu_profiler_.reset(new class CpuProfiler(&event_loop_));
+}
 
+void JsManagerImpl::StopEngine() {
+  {
+    JsEngine::SetupContext setup;
+    cpu_profiler_.reset();
     network_thread_.Stop();
+    js::dom::MpdPatcher::Instance()->Clear();
     tracker_.Dispose();
+    env_.reset();
   }
+  engine_.reset();
 }
 
 }  // namespace shaka
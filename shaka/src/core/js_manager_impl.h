@@ -18,14 +18,19 @@
 #include <glog/logging.h>
 
 #include <functional>
+#include <future>
 #include <memory>
 #include <string>
 
 #include "shaka/js_manager.h"
+#include "src/core/completion_queue.h"
+#include "src/core/cpu_profiler.h"
 #include "src/core/environment.h"
 #include "src/core/network_thread.h"
+#include "src/core/storage_thread.h"
 #include "src/core/task_runner.h"
 #include "src/debug/thread_event.h"
+#include "src/mapping/js_wrappers.h"
 #include "src/memory/heap_tracer.h"
 #include "src/memory/object_tracker.h"
 #ifdef USING_V8
@@ -35,28 +40,79 @@
 
 namespace shaka {
 
+class JsEngine;
+
 class JsManagerImpl : public PseudoSingleton<JsManagerImpl> {
  public:
-  explicit JsManagerImpl(const JsManager::StartupOptions& options);
+  JsManagerImpl(const JsManager::StartupOptions& options,
+                const JsManager::HeapOptions& heap_options,
+                JsManager::EventLoopMode mode);
   ~JsManagerImpl();
 
   TaskRunner* MainThread() {
     return &event_loop_;
   }
+  /**
+   * @return A queue that batches work completed by native threads (e.g.
+   *   settling Promises) onto the main thread.
+   */
+  CompletionQueue* MainThreadCompletions() {
+    return &completions_;
+  }
+  /**
+   * @return A task runner for native background work (e.g. parsing).  This
+   *   can't run JavaScript.
+   */
+  TaskRunner* WorkerThread() {
+    return &worker_;
+  }
   NetworkThread* NetworkThread() {
     return &network_thread_;
   }
+  /** @return The thread that runs the IndexedDB database work. */
+  StorageThread* StorageThread() {
+    return &storage_thread_;
+  }
   memory::HeapTracer* HeapTracer() {
     return &heap_tracer_;
   }
+  /**
+   * @return The JavaScript CPU profiler.  This can only be used on the event
+   *   thread.
+   */
+  CpuProfiler* CpuProfiler() {
+    return cpu_profiler_.get();
+  }
 
   std::string GetPathForStaticFile(const std::string& file) const;
   std::string GetPathForDynamicFile(const std::string& file) const;
 
-  void Stop() {
-    event_loop_.Stop();
+  /**
+   * @return The URL that relative URLs (e.g. in XMLHttpRequest.open) are
+   *   resolved against.  This is the file: URL of the static data directory,
+   *   which is where the page's scripts are loaded from.
+   */
+  const std::string& BaseUrl() const {
+    return base_url_;
   }
 
+  /**
+   * Waits for the Shaka Player library and its code cache to be read, which
+   * is started on the worker thread when this is created so it happens while
+   * the JavaScript engine starts.  This can only be called once.
+   */
+  ScriptFiles TakeShakaScript();
+
+  /**
+   * @return A future that is resolved once the environment is installed and
+   *   the Shaka Player library has been run.
+   */
+  std::shared_future<void> ready() const {
+    return ready_future_;
+  }
+
+  void Stop();
+
   void WaitUntilFinished();
 
   std::shared_ptr<ThreadEvent<bool>> RunScript(const std::string& path);
@@ -65,7 +121,18 @@ class JsManagerImpl : public PseudoSingleton<JsManagerImpl> {
                                                size_t data_size);
 
  private:
+  static void RunMicrotasks();
   void EventThreadWrapper(TaskRunner::RunLoop run_loop);
+  /** Wraps each call to run the tasks when the app runs the event loop. */
+  static void AppThreadWrapper(TaskRunner::RunLoop run_loop);
+
+  /**
+   * Creates the JavaScript engine and installs the environment on the
+   * current thread.  This sets |engine_| and |env_|.
+   */
+  void StartEngine();
+  /** Stops the threads that use the engine, then destroys it. */
+  void StopEngine();
 
 #ifdef USING_V8
   memory::V8HeapTracer heap_tracer_;
@@ -74,8 +141,22 @@ class JsManagerImpl : public PseudoSingleton<JsManagerImpl> {
 #endif
   memory::ObjectTracker tracker_;
   JsManager::StartupOptions startup_options_;
+  JsManager::HeapOptions heap_options_;
+  std::string base_url_;
+  // These are created before the event loop starts since it uses them.
+  std::promise<ScriptFiles> shaka_script_;
+  std::future<ScriptFiles> shaka_script_future_;
+  std::promise<void> ready_;
+  std::shared_future<void> ready_future_;
+  // These are only used on the event thread.
+  std::unique_ptr<JsEngine> engine_;
+  std::unique_ptr<Environment> env_;
+  std::unique_ptr<class CpuProfiler> cpu_profiler_;
 
   TaskRunner event_loop_;
+  CompletionQueue completions_;
+  TaskRunner worker_;
+  class StorageThread storage_thread_;
   class NetworkThread network_thread_;
 };
 
@@ -87,8 +168,8 @@ template <typename... Args>
 std::function<void(Args...)> MainThreadCallback(
     std::function<void(Args...)> cb) {
   return [=](Args... args) {
-    JsManagerImpl::Instance()->MainThread()->AddInternalTask(
-        TaskPriority::Internal, "", std::bind(cb, args...));
+    JsManagerImpl::Instance()->MainThread()->PostTask(TaskPriority::Internal,
+                                                      std::bind(cb, args...));
   };
 }
 
@@ -94,6 +94,27 @@ class JsObjectWrapper {
     return CallMethodCommon<Ret>(&object_, name, std::forward<Args>(args)...);
   }
 
+  /**
+   * Calls the given member method like CallMethod, but passes the converted
+   * value to the given callback instead of creating a future.
+   *
+   * @param callback The callback to give the results to.
+   * @param executor If set, this is used to run the callback; otherwise the
+   *   callback is run on the JS main thread.
+   * @param name The name of the member method to call.
+   * @param args The arguments to pass to the function.
+   */
+  template <typename Ret, typename... Args>
+  void CallMethodWithCallback(AsyncCallback<Ret> callback,
+                              AsyncExecutor executor, const std::string& name,
+                              Args&&... args) const {
+    CallbackSink<Ret> sink;
+    sink.callback = std::move(callback);
+    sink.executor = std::move(executor);
+    CallMethodWithSink<Ret>(std::move(sink), &object_, name,
+                            std::forward<Args>(args)...);
+  }
+
   /**
    * Calls the given global method and converts the returned value to the given
    * type.  If the function returns a Promise, this waits for the Promise to
@@ -173,19 +194,19 @@ class JsObjectWrapper {
   }
 
   /**
-   * Calls the given function and stores the result in the given Promise.  This
+   * Calls the given function and passes the result to the given sink.  This
    * can only be called on the JS main thread.
    *
-   * @param p The Promise that will be given the results
+   * @param p The sink that will be given the results (see PromiseSink and
+   *   CallbackSink).
    * @param that The "this" object; either an instance object or a "path" for
    *   a global object.
    * @param name The name of the member to call.
    * @param args The arguments to pass to the call.
    */
-  template <typename Ret, typename... Args>
+  template <typename Ret, typename Sink, typename... Args>
   static void CallMethodRaw(
-      std::shared_ptr<std::promise<typename Converter<Ret>::variant_type>> p,
-      variant<const Global<JsObject>*, std::vector<std::string>> that,
+      Sink p, variant<const Global<JsObject>*, std::vector<std::string>> that,
       const std::string& name, Args&&... args) {
     DCHECK(JsManagerImpl::Instance()->MainThread()->BelongsToCurrentThread());
     LocalVar<JsObject> that_obj;
@@ -196,7 +217,7 @@ class JsObjectWrapper {
           GetDescendant(JsEngine::Instance()->global_handle(),
                         get<std::vector<std::string>>(that));
       if (!IsObject(temp)) {
-        p->set_value(Error("Unable to find object."));
+        p(Error("Unable to find object."));
         return;
       }
       that_obj = UnsafeJsCast<JsObject>(temp);
@@ -207,25 +228,25 @@ class JsObjectWrapper {
     auto error =
         CallMemberFunction(that_obj, name, sizeof...(args), js_args, &result);
     if (holds_alternative<Error>(error)) {
-      p->set_value(get<Error>(error));
+      p(get<Error>(error));
       return;
     }
 
     auto js_promise = Converter<Promise>::Convert(name, result);
     if (holds_alternative<Error>(js_promise)) {
-      p->set_value(Converter<Ret>::Convert(name, result));
+      p(Converter<Ret>::Convert(name, result));
       return;
     }
 
     get<Promise>(js_promise)
         .Then(
-            [p, name](Any res) {
+            [p, name](Any res) mutable {
               LocalVar<JsValue> value = res.ToJsValue();
-              p->set_value(Converter<Ret>::Convert(name, value));
+              p(Converter<Ret>::Convert(name, value));
             },
-            [p](Any except) {
+            [p](Any except) mutable {
               LocalVar<JsValue> val = except.ToJsValue();
-              p->set_value(ConvertError(val));
+              p(ConvertError(val));
             });
   }
 
@@ -239,34 +260,81 @@ class JsObjectWrapper {
   using bind_forward =
       typename std::add_const<typename std::remove_reference<T>::type>::type&;
 
+  /** Stores the results of a call in a std::promise. */
+  template <typename Ret>
+  struct PromiseSink {
+    void operator()(typename Converter<Ret>::variant_type results) {
+      promise->set_value(std::move(results));
+    }
+
+    std::shared_ptr<std::promise<typename Converter<Ret>::variant_type>>
+        promise;
+  };
+
   /**
-   * Calls the given function, returning a Promise to the value.  If this is
-   * called form the main thread, invokes it immediately; otherwise schedules it
-   * to be called later.
+   * Passes the results of a call to a callback, using the executor if there is
+   * one.
+   */
+  template <typename Ret>
+  struct CallbackSink {
+    void operator()(typename Converter<Ret>::variant_type results) {
+      if (executor) {
+        AsyncCallback<Ret> cb = callback;
+        executor([cb, results]() { cb(results); });
+      } else {
+        callback(results);
+      }
+    }
+
+    AsyncCallback<Ret> callback;
+    AsyncExecutor executor;
+  };
+
+  /**
+   * Calls the given function, passing the results to the given sink.  If this
+   * is called from the main thread, invokes it immediately; otherwise schedules
+   * it to be called later.
    *
+   * @param sink The sink that will be given the results.
    * @param that The "this" object; either an instance object or a "path" for
    *   a global object.
    * @param name The name of the member to call.
    * @param args The arguments to pass to the call.
-   * @return A Future to the converted return value of the call.
    */
-  template <typename Ret, typename... Args>
-  static typename Converter<Ret>::future_type CallMethodCommon(
+  template <typename Ret, typename Sink, typename... Args>
+  static void CallMethodWithSink(
+      Sink sink,
       variant<const Global<JsObject>*, std::vector<std::string>> that,
       const std::string& name, Args&&... args) {
-    auto promise =
-        std::make_shared<std::promise<typename Converter<Ret>::variant_type>>();
     if (JsManagerImpl::Instance()->MainThread()->BelongsToCurrentThread()) {
-      CallMethodRaw<Ret>(promise, std::move(that), name,
+      CallMethodRaw<Ret>(std::move(sink), std::move(that), name,
                          std::forward<Args>(args)...);
     } else {
       auto callback =
-          std::bind(&CallMethodRaw<Ret, bind_forward<Args>...>, promise,
-                    std::move(that), name, std::forward<Args>(args)...);
+          std::bind(&CallMethodRaw<Ret, Sink, bind_forward<Args>...>,
+                    std::move(sink), std::move(that), name,
+                    std::forward<Args>(args)...);
       JsManagerImpl::Instance()->MainThread()->AddInternalTask(
           TaskPriority::Internal, name, std::move(callback));
     }
-    return promise->get_future().share();
+  }
+
+  /**
+   * Calls the given function, returning a Promise to the value.
+   * @see CallMethodWithSink
+   * @return A Future to the converted return value of the call.
+   */
+  template <typename Ret, typename... Args>
+  static typename Converter<Ret>::future_type CallMethodCommon(
+      variant<const Global<JsObject>*, std::vector<std::string>> that,
+      const std::string& name, Args&&... args) {
+    PromiseSink<Ret> sink;
+    sink.promise =
+        std::make_shared<std::promise<typename Converter<Ret>::variant_type>>();
+    auto future = sink.promise->get_future().share();
+    CallMethodWithSink<Ret>(std::move(sink), std::move(that), name,
+                            std::forward<Args>(args)...);
+    return future;
   }
 
   Global<JsObject> object_;
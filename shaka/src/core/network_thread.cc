@@ -15,41 +15,176 @@
 #include "src/core/network_thread.h"
 
 #include <curl/curl.h>
+#include <fcntl.h>
 #include <sys/select.h>
+#include <unistd.h>
 
 #include <algorithm>
 #include <cerrno>
+#include <string>
 
+#include "src/core/range_coalescer.h"
+#include "src/debug/trace_event.h"
 #include "src/js/xml_http_request.h"
+#include "src/mapping/byte_buffer.h"
+#include "src/util/clock.h"
+#include "src/util/url.h"
 #include "src/util/utils.h"
 
 namespace shaka {
 
 namespace {
 
-constexpr const long kSmallDelayMs = 100;  // NOLINT
-constexpr const long kMaxDelayMs = 500;    // NOLINT
+// The longest time to wait when CURL doesn't give us a timeout.  New requests
+// will wake the thread, so this only affects how often CURL gets to do
+// internal bookkeeping.
+constexpr const long kMaxDelayMs = 500;  // NOLINT
+
+// How long to hold ranged requests so requests for adjacent ranges, made at
+// about the same time, can be coalesced.
+constexpr const uint64_t kCoalesceDelayMs = 2;
+
+// The longest time a request waits for more important requests to finish.
+// This keeps a slow license server from stalling segment downloads.
+constexpr const uint64_t kMaxHoldMs = 1000;
+
+// The maximum number of manifest hosts to remember having preconnected to.
+constexpr const size_t kMaxPreconnectedOrigins = 64;
+
+// The maximum number of duplicate requests in progress at once.  When many
+// requests are slow, the network itself is probably slow, so more duplicates
+// would just compete with the originals.
+constexpr const size_t kMaxActiveHedges = 2;
+
+/** The response of a duplicate request, which is kept until it completes. */
+struct HedgeResponse {
+  // The raw header lines, including the status lines.
+  std::vector<std::string> headers;
+  ByteBuffer body;
+};
+
+// Gets the time remaining until a request that was added at |start_time|
+// has waited |delay_ms|.
+uint64_t GetRemainingDelay(uint64_t start_time, uint64_t delay_ms) {
+  const uint64_t waited = util::Clock::Instance.GetMonotonicTime() - start_time;
+  return waited >= delay_ms ? 0 : delay_ms - waited;
+}
+
+std::array<int, 2> CreateWakeUpPipe() {
+  int fds[2];
+  PCHECK(pipe(fds) == 0) << "Error creating network wakeup pipe";
+  for (int fd : fds) {
+    const int flags = fcntl(fd, F_GETFL);
+    PCHECK(flags >= 0 && fcntl(fd, F_SETFL, flags | O_NONBLOCK) == 0 &&
+           fcntl(fd, F_SETFD, FD_CLOEXEC) == 0);
+  }
+  return {{fds[0], fds[1]}};
+}
+
+void LockShare(CURL* /* curl */, curl_lock_data /* data */,
+               curl_lock_access /* access */, void* user_data) {
+  reinterpret_cast<std::mutex*>(user_data)->lock();
+}
+
+void UnlockShare(CURL* /* curl */, curl_lock_data /* data */,
+                 void* user_data) {
+  reinterpret_cast<std::mutex*>(user_data)->unlock();
+}
+
+size_t DiscardCallback(char* /* buffer */, size_t member_size,
+                       size_t member_count, void* /* user_data */) {
+  return member_size * member_count;
+}
+
+size_t HedgeDownloadCallback(char* buffer, size_t member_size,
+                             size_t member_count, void* user_data) {
+  auto* response = reinterpret_cast<HedgeResponse*>(user_data);
+  const size_t total_size = member_size * member_count;
+  response->body.AppendCopy(reinterpret_cast<uint8_t*>(buffer), total_size);
+  return total_size;
+}
+
+size_t HedgeHeaderCallback(char* buffer, size_t member_size,
+                           size_t member_count, void* user_data) {
+  auto* response = reinterpret_cast<HedgeResponse*>(user_data);
+  const size_t total_size = member_size * member_count;
+  response->headers.emplace_back(buffer, buffer + total_size);
+  return total_size;
+}
 
 }  // namespace
 
+struct NetworkThread::Hedge {
+  RefPtr<js::XMLHttpRequest> request;
+  CURL* curl;
+  HedgeResponse response;
+};
+
 NetworkThread::NetworkThread()
     : mutex_("NetworkThread"),
-      cond_("Networking new request"),
+      wakeup_fds_(CreateWakeUpPipe()),
       multi_handle_(curl_multi_init()),
+      share_handle_(curl_share_init()),
+      segment_cache_(static_cast<size_t>(options_.segment_cache_size)),
+      http_cache_(static_cast<size_t>(options_.http_cache_size)),
+      bandwidth_limiter_(&util::Clock::Instance),
+      active_counts_(),
+      beacon_queue_(&util::Clock::Instance),
+      progress_interval_ms_(options_.progress_interval_ms),
+      completed_request_count_(0),
+      reused_connection_count_(0),
+      compressed_response_count_(0),
+      compressed_wire_bytes_(0),
+      compressed_decoded_bytes_(0),
       shutdown_(false),
-      thread_("Networking", std::bind(&NetworkThread::ThreadMain, this)) {
+      thread_("Networking", std::bind(&NetworkThread::ThreadMain, this),
+              ThreadRole::Network) {
   CHECK(multi_handle_);
+  CHECK(share_handle_);
+
+  // Connections are already cached by the multi handle; the share handle
+  // allows DNS results and TLS sessions to be reused across requests too.
+  curl_share_setopt(share_handle_, CURLSHOPT_SHARE, CURL_LOCK_DATA_DNS);
+  curl_share_setopt(share_handle_, CURLSHOPT_SHARE, CURL_LOCK_DATA_SSL_SESSION);
+  curl_share_setopt(share_handle_, CURLSHOPT_LOCKFUNC, &LockShare);
+  curl_share_setopt(share_handle_, CURLSHOPT_UNLOCKFUNC, &UnlockShare);
+  curl_share_setopt(share_handle_, CURLSHOPT_USERDATA, &share_mutex_);
+
+  std::unique_lock<Mutex> lock(mutex_);
+  ApplyMultiOptions();
+  in_flight_limiter_.SetLimits(options_.max_in_flight_bytes,
+                               options_.max_request_in_flight_bytes);
 }
 
 NetworkThread::~NetworkThread() {
   CHECK(!thread_.joinable()) << "Need to call Stop() before destroying";
   DCHECK(requests_.empty());
+  for (auto& hedge : hedges_) {
+    curl_multi_remove_handle(multi_handle_, hedge->curl);
+    curl_easy_cleanup(hedge->curl);
+  }
+  for (auto& beacon : beacons_) {
+    if (beacon.started)
+      curl_multi_remove_handle(multi_handle_, beacon.curl);
+    curl_easy_cleanup(beacon.curl);
+    curl_slist_free_all(beacon.headers);
+  }
+  for (CURL* curl : preconnects_) {
+    curl_multi_remove_handle(multi_handle_, curl);
+    curl_easy_cleanup(curl);
+  }
   curl_multi_cleanup(multi_handle_);
+  // This will fail if there are still handles using it; those will be freed
+  // when the XMLHttpRequest objects are destroyed.
+  if (curl_share_cleanup(share_handle_) != CURLSHE_OK)
+    LOG(WARNING) << "Network share handle still in use during shutdown";
+  close(wakeup_fds_[0]);
+  close(wakeup_fds_[1]);
 }
 
 void NetworkThread::Stop() {
   shutdown_.store(true, std::memory_order_release);
-  cond_.SignalAllIfNotSet();
+  WakeUp();
   thread_.join();
 }
 
@@ -63,20 +198,582 @@ void NetworkThread::AddRequest(RefPtr<js::XMLHttpRequest> request) {
   DCHECK(!shutdown_.load(std::memory_order_acquire));
   DCHECK(!util::contains(requests_, request));
   requests_.push_back(request);
-  CHECK_EQ(curl_multi_add_handle(multi_handle_, request->curl_), CURLM_OK);
-  cond_.SignalAllIfNotSet();
+  request->priority_ = priority_hints_.Get(request->request_url_);
+
+  std::string key;
+  uint64_t start;
+  uint64_t end;
+  if (options_.coalesce_range_requests &&
+      request->GetCoalesceInfo(&key, &start, &end)) {
+    queued_.push_back(
+        {request, util::Clock::Instance.GetMonotonicTime()});
+  } else {
+    StartRequest(request.get());
+  }
+  WakeUp();
 }
 
 void NetworkThread::AbortRequest(RefPtr<js::XMLHttpRequest> request) {
   std::unique_lock<Mutex> lock(mutex_);
-  for (auto it = requests_.begin(); it != requests_.end(); it++) {
-    if (*it == request) {
-      CHECK_EQ(curl_multi_remove_handle(multi_handle_, request->curl_),
+  auto it = std::find(requests_.begin(), requests_.end(), request);
+  if (it == requests_.end())
+    return;
+  requests_.erase(it);
+
+  // If the request hasn't started or another request is downloading its data,
+  // there is no CURL transfer to stop.
+  for (auto queued = queued_.begin(); queued != queued_.end(); queued++) {
+    if (queued->request == request) {
+      queued_.erase(queued);
+      return;
+    }
+  }
+  for (auto held = held_.begin(); held != held_.end(); held++) {
+    if (held->request == request) {
+      held_.erase(held);
+      return;
+    }
+  }
+  for (auto& pair : coalesced_) {
+    auto follower = std::find(pair.second.begin(), pair.second.end(), request);
+    if (follower != pair.second.end()) {
+      pair.second.erase(follower);
+      return;
+    }
+  }
+
+  CancelHedge(request.get());
+  CHECK_EQ(curl_multi_remove_handle(multi_handle_, request->curl_), CURLM_OK);
+  util::RemoveElement(&paused_requests_, request->curl_);
+  ReleaseInFlight(request.get());
+  active_counts_[static_cast<size_t>(request->priority_)]--;
+  if (!held_.empty())
+    WakeUp();
+
+  // The requests coalesced into this one need to be made on their own now.
+  auto group = coalesced_.find(request->curl_);
+  if (group != coalesced_.end()) {
+    for (auto& follower : group->second)
+      StartRequest(follower.get());
+    coalesced_.erase(group);
+    WakeUp();
+  }
+}
+
+void NetworkThread::Preconnect(const std::string& url) {
+  std::unique_lock<Mutex> lock(mutex_);
+  PreconnectLocked(url);
+}
+
+void NetworkThread::Preconnect(const std::vector<std::string>& urls) {
+  std::unique_lock<Mutex> lock(mutex_);
+  for (const std::string& url : urls)
+    PreconnectLocked(url);
+}
+
+void NetworkThread::PreconnectLocked(const std::string& url) {
+  if (!options_.share_connections ||
+      shutdown_.load(std::memory_order_acquire)) {
+    return;
+  }
+
+  CURL* curl = curl_easy_init();
+  if (!curl) {
+    LOG(ERROR) << "Unable to create CURL handle for preconnect";
+    return;
+  }
+  curl_easy_setopt(curl, CURLOPT_URL, url.c_str());
+  // Stop once connected (including the TLS handshake); no request is sent.
+  curl_easy_setopt(curl, CURLOPT_CONNECT_ONLY, 1L);
+  ApplyRequestOptions(curl, RequestPriority::Normal);
+  CHECK_EQ(curl_multi_add_handle(multi_handle_, curl), CURLM_OK);
+  preconnects_.push_back(curl);
+  WakeUp();
+}
+
+void NetworkThread::PreconnectManifestOrigins(js::XMLHttpRequest* request) {
+  std::vector<std::string> origins;
+  {
+    std::unique_lock<Mutex> lock(request->mutex_);
+    origins.swap(request->manifest_origins_);
+  }
+
+  if (manifest_origins_.size() + origins.size() > kMaxPreconnectedOrigins)
+    manifest_origins_.clear();
+  for (const std::string& origin : origins) {
+    if (manifest_origins_.insert(origin).second) {
+      VLOG(1) << "Preconnecting to manifest host " << origin;
+      PreconnectLocked(origin);
+    }
+  }
+}
+
+void NetworkThread::SetOptions(const JsManager::NetworkOptions& options) {
+  std::unique_lock<Mutex> lock(mutex_);
+  options_ = options;
+  ApplyMultiOptions();
+  segment_cache_.SetMaxSize(static_cast<size_t>(options_.segment_cache_size));
+  http_cache_.SetMaxSize(static_cast<size_t>(options_.http_cache_size));
+  tls_session_cache_.SetPersistent(options_.persist_tls_sessions);
+  bandwidth_limiter_.SetLimit(options_.max_download_bytes_per_second);
+  in_flight_limiter_.SetLimits(options_.max_in_flight_bytes,
+                               options_.max_request_in_flight_bytes);
+  progress_interval_ms_.store(options_.progress_interval_ms,
+                              std::memory_order_relaxed);
+  // Paused requests may be able to resume with the new limit.
+  WakeUp();
+}
+
+void NetworkThread::SetBeaconOptions(const BeaconQueue::Options& options) {
+  beacon_queue_.SetOptions(options);
+  WakeUp();
+}
+
+void NetworkThread::AddBeaconEvent(const std::string& name,
+                                   const std::string& data) {
+  // Only wake the thread when the time of the next batch changes.
+  if (beacon_queue_.AddEvent(name, data))
+    WakeUp();
+}
+
+void NetworkThread::AddBeaconMetric(const std::string& name, double value) {
+  if (beacon_queue_.AddMetric(name, value))
+    WakeUp();
+}
+
+bool NetworkThread::AllowDownload(js::XMLHttpRequest* request, size_t bytes) {
+  // This is called from within curl_multi_perform, so |mutex_| is already
+  // held.
+  if (!bandwidth_limiter_.CanReceive()) {
+    if (!util::contains(paused_requests_, request->curl_))
+      paused_requests_.push_back(request->curl_);
+    return false;
+  }
+  if (!in_flight_limiter_.TryReceive(request, bytes)) {
+    if (!util::contains(backpressured_requests_, request->curl_))
+      backpressured_requests_.push_back(request->curl_);
+    return false;
+  }
+  bandwidth_limiter_.OnReceived(bytes);
+  return true;
+}
+
+void NetworkThread::ApplyMultiOptions() {
+  const long pipelining =  // NOLINT
+      options_.enable_http2 ? CURLPIPE_MULTIPLEX : CURLPIPE_NOTHING;
+  curl_multi_setopt(multi_handle_, CURLMOPT_PIPELINING, pipelining);
+  curl_multi_setopt(multi_handle_, CURLMOPT_MAX_HOST_CONNECTIONS,
+                    static_cast<long>(  // NOLINT
+                        options_.max_connections_per_host));
+}
+
+void NetworkThread::ApplyRequestOptions(CURL* curl,
+                                        RequestPriority priority) {
+  curl_easy_setopt(curl, CURLOPT_SHARE,
+                   options_.share_connections ? share_handle_ : nullptr);
+  tls_session_cache_.Apply(curl);
+  if (options_.enable_http2) {
+    // Streams with a larger weight get a larger share of the connection.
+    curl_easy_setopt(curl, CURLOPT_STREAM_WEIGHT,
+                     options_.prioritize_requests ? GetStreamWeight(priority)
+                                                  : 16L);
+    // This may fail if CURL was built without HTTP/2 support, but then it will
+    // just use HTTP/1.1.
+    curl_easy_setopt(curl, CURLOPT_HTTP_VERSION, CURL_HTTP_VERSION_2TLS);
+    // Wait for an existing connection to see if we can multiplex on it
+    // instead of opening a new one.
+    curl_easy_setopt(curl, CURLOPT_PIPEWAIT, 1L);
+  }
+}
+
+void NetworkThread::WakeUp() {
+  const char value = 0;
+  // If the pipe is full, there is already a pending wakeup.
+  if (write(wakeup_fds_[1], &value, 1) < 0 && errno != EAGAIN &&
+      errno != EWOULDBLOCK) {
+    PLOG(ERROR) << "Error waking network thread";
+  }
+}
+
+void NetworkThread::DrainWakeUps() {
+  char buffer[64];
+  while (read(wakeup_fds_[0], buffer, sizeof(buffer)) > 0) {}
+}
+
+void NetworkThread::ResumePausedRequests() {
+  // Resuming a request can deliver its data immediately, which may pause it
+  // again, so swap the lists first.
+  std::vector<CURL*> paused;
+  if (!paused_requests_.empty() && bandwidth_limiter_.CanReceive())
+    paused.swap(paused_requests_);
+  // Requests paused by the in-flight limit can only continue once another
+  // request frees its bytes.
+  if (in_flight_limiter_.TakeReleased()) {
+    paused.insert(paused.end(), backpressured_requests_.begin(),
+                  backpressured_requests_.end());
+    backpressured_requests_.clear();
+  }
+  for (CURL* curl : paused) {
+    if (curl_easy_pause(curl, CURLPAUSE_CONT) != CURLE_OK)
+      LOG(ERROR) << "Error resuming network request";
+  }
+}
+
+void NetworkThread::ReleaseInFlight(js::XMLHttpRequest* request) {
+  util::RemoveElement(&backpressured_requests_, request->curl_);
+  in_flight_limiter_.Release(request);
+  if (!backpressured_requests_.empty())
+    WakeUp();
+}
+
+void NetworkThread::RecordCompressedResponse(uint64_t wire_bytes,
+                                             uint64_t decoded_bytes) {
+  compressed_response_count_.fetch_add(1, std::memory_order_relaxed);
+  compressed_wire_bytes_.fetch_add(wire_bytes, std::memory_order_relaxed);
+  compressed_decoded_bytes_.fetch_add(decoded_bytes,
+                                      std::memory_order_relaxed);
+}
+
+void NetworkThread::RecordTransfer(CURL* curl) {
+  // These are all in seconds from the start of the request.
+  double bytes = 0;
+  double connect = 0;
+  double app_connect = 0;
+  double start_transfer = 0;
+  double total = 0;
+  char* url = nullptr;
+  if (curl_easy_getinfo(curl, CURLINFO_SIZE_DOWNLOAD, &bytes) != CURLE_OK ||
+      curl_easy_getinfo(curl, CURLINFO_CONNECT_TIME, &connect) != CURLE_OK ||
+      curl_easy_getinfo(curl, CURLINFO_APPCONNECT_TIME, &app_connect) !=
+          CURLE_OK ||
+      curl_easy_getinfo(curl, CURLINFO_STARTTRANSFER_TIME, &start_transfer) !=
+          CURLE_OK ||
+      curl_easy_getinfo(curl, CURLINFO_TOTAL_TIME, &total) != CURLE_OK ||
+      curl_easy_getinfo(curl, CURLINFO_EFFECTIVE_URL, &url) != CURLE_OK) {
+    return;
+  }
+
+  util::Url parsed;
+  if (!url || !util::Url::Parse(url, &parsed))
+    return;
+
+  BandwidthEstimator::Transfer transfer;
+  transfer.bytes = static_cast<uint64_t>(bytes);
+  // Include the TLS handshake, if any, in the connect time.
+  transfer.connect_ms = std::max(connect, app_connect) * 1000;
+  transfer.ttfb_ms = start_transfer * 1000;
+  transfer.total_ms = total * 1000;
+  bandwidth_estimator_.AddTransfer(parsed.host(), transfer);
+  hedge_policy_.AddTtfb(transfer.ttfb_ms);
+}
+
+void NetworkThread::StartHedges() {
+  if (options_.hedge_percentile == 0 || hedge_candidates_.empty())
+    return;
+  const double delay_ms = hedge_policy_.GetDelayMs(options_.hedge_percentile);
+  if (delay_ms < 0)
+    return;
+
+  // The candidates are oldest first, so stop at the first that can still wait.
+  while (!hedge_candidates_.empty() && hedges_.size() < kMaxActiveHedges &&
+         GetRemainingDelay(hedge_candidates_.front().queued_time,
+                           static_cast<uint64_t>(delay_ms)) == 0) {
+    RefPtr<js::XMLHttpRequest> request =
+        std::move(hedge_candidates_.front().request);
+    hedge_candidates_.erase(hedge_candidates_.begin());
+
+    // Once the response has started, a duplicate wouldn't finish sooner.
+    long response_code = 0;  // NOLINT
+    curl_easy_getinfo(request->curl_, CURLINFO_RESPONSE_CODE, &response_code);
+    if (response_code == 0)
+      StartHedge(request.get());
+  }
+}
+
+void NetworkThread::StartHedge(js::XMLHttpRequest* request) {
+  // The duplicate has the same options as the request, including its headers,
+  // which stay alive until the request completes or is aborted.
+  CURL* curl = curl_easy_duphandle(request->curl_);
+  if (!curl) {
+    LOG(ERROR) << "Unable to create CURL handle for hedged request";
+    return;
+  }
+
+  std::unique_ptr<Hedge> hedge(new Hedge);
+  hedge->request = request;
+  hedge->curl = curl;
+  curl_easy_setopt(curl, CURLOPT_WRITEFUNCTION, HedgeDownloadCallback);
+  curl_easy_setopt(curl, CURLOPT_WRITEDATA, &hedge->response);
+  curl_easy_setopt(curl, CURLOPT_HEADERFUNCTION, HedgeHeaderCallback);
+  curl_easy_setopt(curl, CURLOPT_HEADERDATA, &hedge->response);
+
+  const std::string alternate =
+      hedge_policy_.GetAlternate(request->request_url_);
+  if (!alternate.empty()) {
+    VLOG(1) << "Hedging slow request to " << alternate;
+    curl_easy_setopt(curl, CURLOPT_URL, alternate.c_str());
+  } else {
+    // Another stream on the same connection would likely be just as slow.
+    VLOG(1) << "Hedging slow request on a new connection";
+    curl_easy_setopt(curl, CURLOPT_FRESH_CONNECT, 1L);
+    curl_easy_setopt(curl, CURLOPT_PIPEWAIT, 0L);
+  }
+  CHECK_EQ(curl_multi_add_handle(multi_handle_, curl), CURLM_OK);
+  hedges_.push_back(std::move(hedge));
+}
+
+bool NetworkThread::OnHedgeComplete(CURL* curl, CURLcode code) {
+  auto it = std::find_if(
+      hedges_.begin(), hedges_.end(),
+      [&](const std::unique_ptr<Hedge>& hedge) { return hedge->curl == curl; });
+  if (it == hedges_.end())
+    return false;
+  std::unique_ptr<Hedge> hedge = std::move(*it);
+  hedges_.erase(it);
+  CHECK_EQ(curl_multi_remove_handle(multi_handle_, curl), CURLM_OK);
+
+  // Only use successful responses; if the duplicate failed, the original may
+  // still succeed.
+  long status = 0;  // NOLINT
+  curl_easy_getinfo(curl, CURLINFO_RESPONSE_CODE, &status);
+  const bool won = code == CURLE_OK && status >= 200 && status < 300;
+  hedge_policy_.OnHedgeDone(won);
+  if (won) {
+    RecordTransfer(curl);
+    RefPtr<js::XMLHttpRequest> request = std::move(hedge->request);
+    VLOG(1) << "Hedged request finished first for " << request->request_url_;
+    CHECK_EQ(curl_multi_remove_handle(multi_handle_, request->curl_),
+             CURLM_OK);
+    util::RemoveElement(&paused_requests_, request->curl_);
+    ReleaseInFlight(request.get());
+    util::RemoveElement(&requests_, request);
+    active_counts_[static_cast<size_t>(request->priority_)]--;
+    if (!held_.empty())
+      WakeUp();
+
+    char* url = nullptr;
+    curl_easy_getinfo(curl, CURLINFO_EFFECTIVE_URL, &url);
+    request->OnHedgeComplete(hedge->response.headers,
+                             std::move(hedge->response.body), url ? url : "");
+    PreconnectManifestOrigins(request.get());
+  } else {
+    VLOG(2) << "Hedged request failed: " << code << ", status " << status;
+  }
+  curl_easy_cleanup(curl);
+  return true;
+}
+
+void NetworkThread::StartBeacons() {
+  BeaconQueue::Batch batch;
+  if (beacon_queue_.TakeBatch(&batch)) {
+    CURL* curl = curl_easy_init();
+    if (curl) {
+      curl_slist* headers =
+          curl_slist_append(nullptr, "Content-Type: application/json");
+      if (batch.compressed)
+        headers = curl_slist_append(headers, "Content-Encoding: gzip");
+      curl_easy_setopt(curl, CURLOPT_URL, batch.url.c_str());
+      curl_easy_setopt(curl, CURLOPT_HTTPHEADER, headers);
+      // The size needs to be set first since the body may contain nulls.
+      curl_easy_setopt(curl, CURLOPT_POSTFIELDSIZE_LARGE,
+                       static_cast<curl_off_t>(batch.body.size()));
+      curl_easy_setopt(curl, CURLOPT_COPYPOSTFIELDS, batch.body.data());
+      curl_easy_setopt(curl, CURLOPT_WRITEFUNCTION, DiscardCallback);
+      beacons_.push_back(
+          {curl, headers, util::Clock::Instance.GetMonotonicTime(), false});
+    } else {
+      LOG(ERROR) << "Unable to create CURL handle for beacon upload";
+      beacon_queue_.OnBatchFailed();
+    }
+  }
+
+  for (auto& beacon : beacons_) {
+    if (!beacon.started &&
+        (!IsHeldBack(RequestPriority::Background) ||
+         GetRemainingDelay(beacon.queued_time, kMaxHoldMs) == 0)) {
+      ApplyRequestOptions(beacon.curl, RequestPriority::Background);
+      CHECK_EQ(curl_multi_add_handle(multi_handle_, beacon.curl), CURLM_OK);
+      active_counts_[static_cast<size_t>(RequestPriority::Background)]++;
+      beacon.started = true;
+    }
+  }
+}
+
+bool NetworkThread::OnBeaconComplete(CURL* curl, CURLcode code) {
+  auto it = std::find_if(
+      beacons_.begin(), beacons_.end(),
+      [&](const BeaconUpload& beacon) { return beacon.curl == curl; });
+  if (it == beacons_.end())
+    return false;
+
+  long status = 0;  // NOLINT
+  curl_easy_getinfo(curl, CURLINFO_RESPONSE_CODE, &status);
+  if (code != CURLE_OK || status < 200 || status >= 300) {
+    LOG(WARNING) << "Error uploading beacon batch: " << code << ", status "
+                 << status;
+    beacon_queue_.OnBatchFailed();
+  }
+  CHECK_EQ(curl_multi_remove_handle(multi_handle_, curl), CURLM_OK);
+  active_counts_[static_cast<size_t>(RequestPriority::Background)]--;
+  curl_easy_cleanup(curl);
+  curl_slist_free_all(it->headers);
+  beacons_.erase(it);
+  return true;
+}
+
+void NetworkThread::CancelHedge(js::XMLHttpRequest* request) {
+  for (auto it = hedge_candidates_.begin(); it != hedge_candidates_.end();
+       it++) {
+    if (it->request == request) {
+      hedge_candidates_.erase(it);
+      return;
+    }
+  }
+  for (auto it = hedges_.begin(); it != hedges_.end(); it++) {
+    if ((*it)->request == request) {
+      CHECK_EQ(curl_multi_remove_handle(multi_handle_, (*it)->curl),
                CURLM_OK);
-      requests_.erase(it);
+      curl_easy_cleanup((*it)->curl);
+      hedges_.erase(it);
+      hedge_policy_.OnHedgeDone(/* won= */ false);
+      return;
+    }
+  }
+}
+
+void NetworkThread::StartRequest(js::XMLHttpRequest* request) {
+  if (IsHeldBack(request->priority_)) {
+    held_.push_back({request, util::Clock::Instance.GetMonotonicTime()});
+    return;
+  }
+  AddToMultiHandle(request);
+}
+
+void NetworkThread::AddToMultiHandle(js::XMLHttpRequest* request) {
+  ApplyRequestOptions(request->curl_, request->priority_);
+  // Compressed ranges are ranges of the compressed data, which can't be
+  // decoded on their own, so only ask for compression for whole responses.
+  // An empty string lets CURL offer every encoding it was built with.
+  const bool compress =
+      options_.accept_compressed_responses && request->request_range_.empty();
+  curl_easy_setopt(request->curl_, CURLOPT_ACCEPT_ENCODING,
+                   compress ? "" : nullptr);
+  CHECK_EQ(curl_multi_add_handle(multi_handle_, request->curl_), CURLM_OK);
+  active_counts_[static_cast<size_t>(request->priority_)]++;
+
+  // Only hedge segment requests; a coalesced request would need the
+  // duplicate to be split too.
+  if (options_.hedge_percentile != 0 &&
+      request->priority_ == RequestPriority::Normal && request->CanHedge() &&
+      coalesced_.count(request->curl_) == 0) {
+    hedge_candidates_.push_back(
+        {request, util::Clock::Instance.GetMonotonicTime()});
+  }
+}
+
+bool NetworkThread::IsHeldBack(RequestPriority priority) const {
+  if (!options_.prioritize_requests)
+    return false;
+  for (size_t i = 0; i < static_cast<size_t>(priority); i++) {
+    if (active_counts_[i] > 0)
+      return true;
+  }
+  return false;
+}
+
+void NetworkThread::StartHeldRequests() {
+  // Starting a request may hold back the ones after it, so check each in turn.
+  for (auto it = held_.begin(); it != held_.end();) {
+    if (!IsHeldBack(it->request->priority_) ||
+        GetRemainingDelay(it->queued_time, kMaxHoldMs) == 0) {
+      AddToMultiHandle(it->request.get());
+      it = held_.erase(it);
+    } else {
+      it++;
+    }
+  }
+}
+
+void NetworkThread::StartQueuedRequests() {
+  if (queued_.empty() ||
+      GetRemainingDelay(queued_.front().queued_time, kCoalesceDelayMs) > 0) {
+    return;
+  }
+
+  std::vector<RefPtr<js::XMLHttpRequest>> requests;
+  std::vector<RangeRequest> ranges(queued_.size());
+  requests.reserve(queued_.size());
+  for (size_t i = 0; i < queued_.size(); i++) {
+    requests.push_back(std::move(queued_[i].request));
+    CHECK(requests[i]->GetCoalesceInfo(&ranges[i].key, &ranges[i].start,
+                                       &ranges[i].end));
+  }
+  queued_.clear();
+
+  for (const RangeGroup& group : GroupRangeRequests(ranges)) {
+    RefPtr<js::XMLHttpRequest>& leader = requests[group.requests[0]];
+    if (group.requests.size() > 1) {
+      VLOG(2) << "Coalescing " << group.requests.size() << " range requests";
+      leader->SetCoalescedRange(group.end);
+      auto* followers = &coalesced_[leader->curl_];
+      for (size_t i = 1; i < group.requests.size(); i++)
+        followers->push_back(std::move(requests[group.requests[i]]));
+    }
+    StartRequest(leader.get());
+  }
+}
+
+void NetworkThread::CompleteCoalescedRequests(js::XMLHttpRequest* request,
+                                              CURLcode code) {
+  auto group = coalesced_.find(request->curl_);
+  if (group == coalesced_.end())
+    return;
+  std::vector<RefPtr<js::XMLHttpRequest>> followers = std::move(group->second);
+  coalesced_.erase(group);
+
+  if (request->SplitCoalescedResponse(code, followers)) {
+    for (auto& follower : followers)
+      util::RemoveElement(&requests_, follower);
+  } else {
+    // The server didn't return the whole range, so fall back to separate
+    // requests.
+    VLOG(1) << "Unable to split coalesced response, retrying separately";
+    for (auto& follower : followers)
+      StartRequest(follower.get());
+    WakeUp();
+  }
+}
+
+long NetworkThread::GetStartDelayMs() const {  // NOLINT
+  uint64_t delay = UINT64_MAX;
+  if (!queued_.empty()) {
+    delay = GetRemainingDelay(queued_.front().queued_time, kCoalesceDelayMs);
+  }
+  if (!held_.empty()) {
+    delay = std::min(delay,
+                     GetRemainingDelay(held_.front().queued_time, kMaxHoldMs));
+  }
+  const int64_t beacon_delay_ms = beacon_queue_.GetDelayMs();
+  if (beacon_delay_ms >= 0)
+    delay = std::min(delay, static_cast<uint64_t>(beacon_delay_ms));
+  for (auto& beacon : beacons_) {
+    if (!beacon.started) {
+      delay = std::min(delay,
+                       GetRemainingDelay(beacon.queued_time, kMaxHoldMs));
       break;
     }
   }
+  if (options_.hedge_percentile != 0 && !hedge_candidates_.empty() &&
+      hedges_.size() < kMaxActiveHedges) {
+    const double hedge_delay_ms =
+        hedge_policy_.GetDelayMs(options_.hedge_percentile);
+    if (hedge_delay_ms >= 0) {
+      delay = std::min(
+          delay, GetRemainingDelay(hedge_candidates_.front().queued_time,
+                                   static_cast<uint64_t>(hedge_delay_ms)));
+    }
+  }
+  return delay == UINT64_MAX ? -1 : static_cast<long>(delay);  // NOLINT
 }
 
 void NetworkThread::ThreadMain() {
@@ -84,11 +781,21 @@ void NetworkThread::ThreadMain() {
     fd_set fdread;
     fd_set fdwrite;
     fd_set fdexc;
+    FD_ZERO(&fdread);
+    FD_ZERO(&fdwrite);
+    FD_ZERO(&fdexc);
     long timeout_ms = -1;  // NOLINT
     int maxfd = -1;
     bool no_handles;
     {
+      TRACE_EVENT("network", "Network perform");
       std::unique_lock<Mutex> lock(mutex_);
+      ResumePausedRequests();
+      StartQueuedRequests();
+      StartHeldRequests();
+      StartHedges();
+      StartBeacons();
+
       // This will still return success if there are no requests or if there is
       // an error in one request.
       int handles = 0;
@@ -98,11 +805,47 @@ void NetworkThread::ThreadMain() {
       // Get any pending messages and complete any requests that are done.
       int msg_count;
       while (CURLMsg* msg = curl_multi_info_read(multi_handle_, &msg_count)) {
-        if (msg->msg == CURLMSG_DONE) {
+        if (msg->msg == CURLMSG_DONE &&
+            util::contains(preconnects_, msg->easy_handle)) {
+          VLOG(2) << "Preconnect complete: " << msg->data.result;
+          util::RemoveElement(&preconnects_, msg->easy_handle);
+          CHECK_EQ(curl_multi_remove_handle(multi_handle_, msg->easy_handle),
+                   CURLM_OK);
+          curl_easy_cleanup(msg->easy_handle);
+        } else if (msg->msg == CURLMSG_DONE &&
+                   OnHedgeComplete(msg->easy_handle, msg->data.result)) {
+          // The duplicate of a slow request finished.
+        } else if (msg->msg == CURLMSG_DONE &&
+                   OnBeaconComplete(msg->easy_handle, msg->data.result)) {
+          // A beacon batch was uploaded.
+        } else if (msg->msg == CURLMSG_DONE) {
+          TRACE_EVENT("network", "Request complete");
+          // CURL reports the number of new connections needed for the
+          // request; if it is 0, an existing connection was reused.
+          long num_connects = 0;  // NOLINT
+          curl_easy_getinfo(msg->easy_handle, CURLINFO_NUM_CONNECTS,
+                            &num_connects);
+          completed_request_count_.fetch_add(1, std::memory_order_relaxed);
+          if (num_connects == 0)
+            reused_connection_count_.fetch_add(1, std::memory_order_relaxed);
+          VLOG(2) << "Network request complete, reused connection: "
+                  << (num_connects == 0 ? "yes" : "no");
+          if (msg->data.result == CURLE_OK)
+            RecordTransfer(msg->easy_handle);
+
+          util::RemoveElement(&paused_requests_, msg->easy_handle);
           for (auto it = requests_.begin(); it != requests_.end(); it++) {
             if ((*it)->curl_ == msg->easy_handle) {
-              (*it)->OnRequestComplete(msg->data.result);  // NOLINT
+              RefPtr<js::XMLHttpRequest> request = std::move(*it);
               requests_.erase(it);
+              ReleaseInFlight(request.get());
+              active_counts_[static_cast<size_t>(request->priority_)]--;
+              if (!held_.empty())
+                WakeUp();
+              CancelHedge(request.get());
+              CompleteCoalescedRequests(request.get(), msg->data.result);
+              request->OnRequestComplete(msg->data.result);  // NOLINT
+              PreconnectManifestOrigins(request.get());
               break;
             }
           }
@@ -114,35 +857,51 @@ void NetworkThread::ThreadMain() {
         }
       }
 
-      if (curl_multi_fdset(multi_handle_, &fdread, &fdwrite, &fdexc, &maxfd) !=
-          CURLM_OK) {
-        LOG(ERROR) << "Error getting file descriptors from CURL";
+      if (handles > 0) {
+        if (curl_multi_fdset(multi_handle_, &fdread, &fdwrite, &fdexc,
+                             &maxfd) != CURLM_OK) {
+          LOG(ERROR) << "Error getting file descriptors from CURL";
+        }
+        if (curl_multi_timeout(multi_handle_, &timeout_ms) != CURLM_OK) {
+          LOG(ERROR) << "Error getting timeout from CURL";
+        }
+        if (timeout_ms < 0 || timeout_ms > kMaxDelayMs)
+          timeout_ms = kMaxDelayMs;
+
+        // CURL doesn't know when paused requests can resume, so wake up then.
+        if (!paused_requests_.empty()) {
+          timeout_ms = std::min(
+              timeout_ms,
+              static_cast<long>(bandwidth_limiter_.GetDelayMs()));  // NOLINT
+        }
       }
-      if (curl_multi_timeout(multi_handle_, &timeout_ms) != CURLM_OK) {
-        LOG(ERROR) << "Error getting timeout from CURL";
+
+      // Wake up when the queued or held requests should start.
+      const long start_delay_ms = GetStartDelayMs();  // NOLINT
+      if (start_delay_ms >= 0) {
+        timeout_ms = no_handles ? start_delay_ms
+                                : std::min(timeout_ms, start_delay_ms);
+        no_handles = false;
       }
-      if (timeout_ms < 0)
-        // If we failed to query CURL, use a default.
-        timeout_ms = kSmallDelayMs;
-      else
-        timeout_ms = std::min(timeout_ms, kMaxDelayMs);
     }
 
-    // Wait until we have something to do.
-    if (no_handles) {
-      std::unique_lock<Mutex> lock(mutex_);
-      cond_.ResetAndWaitWhileUnlocked(lock);
-    } else {
-      timeval timeout = {.tv_sec = timeout_ms / 1000,
-                         .tv_usec = (timeout_ms % 1000) * 1000};
-      if (select(maxfd + 1, &fdread, &fdwrite, &fdexc, &timeout) < 0) {
-        if (errno == EBADF) {
-          // If another thread aborts the request, it will close the file
-          // descriptor, causing an error here, so just ignore it.
-        } else {
-          PLOG(ERROR) << "Error waiting for network handles";
-        }
+    // Wait until we have something to do.  This will wake up when there is
+    // network activity, when CURL needs to do work, or when a new request is
+    // added.  If there are no requests, this waits until there is a new one.
+    FD_SET(wakeup_fds_[0], &fdread);
+    maxfd = std::max(maxfd, wakeup_fds_[0]);
+    timeval timeout = {.tv_sec = timeout_ms / 1000,
+                       .tv_usec = (timeout_ms % 1000) * 1000};
+    if (select(maxfd + 1, &fdread, &fdwrite, &fdexc,
+               no_handles ? nullptr : &timeout) < 0) {
+      if (errno == EBADF || errno == EINTR) {
+        // If another thread aborts the request, it will close the file
+        // descriptor, causing an error here, so just ignore it.
+      } else {
+        PLOG(ERROR) << "Error waiting for network handles";
       }
+    } else if (FD_ISSET(wakeup_fds_[0], &fdread)) {
+      DrainWakeUps();
     }
   }
 }
@@ -15,15 +15,32 @@
 #ifndef SHAKA_EMBEDDED_CORE_NETWORK_THREAD_H_
 #define SHAKA_EMBEDDED_CORE_NETWORK_THREAD_H_
 
+#include <array>
 #include <atomic>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <unordered_set>
 #include <vector>
 
+#include "shaka/js_manager.h"
+#include "src/core/bandwidth_estimator.h"
+#include "src/core/bandwidth_limiter.h"
+#include "src/core/beacon_queue.h"
+#include "src/core/hedge_policy.h"
+#include "src/core/http_cache.h"
+#include "src/core/in_flight_limiter.h"
 #include "src/core/ref_ptr.h"
+#include "src/core/request_priority.h"
+#include "src/core/segment_cache.h"
+#include "src/core/tls_session_cache.h"
 #include "src/debug/mutex.h"
 #include "src/debug/thread.h"
-#include "src/debug/thread_event.h"
 
+typedef void CURL;
 typedef void CURLM;
+typedef void CURLSH;
 
 namespace shaka {
 
@@ -37,6 +54,9 @@ class XMLHttpRequest;
  * request happens, the background thread will make calls into the XHR object.
  * The XHR object MUST handle any synchronization required for cross-thread
  * access.
+ *
+ * The background thread blocks on the CURL sockets and a wakeup pipe, so it
+ * doesn't use any CPU when idle and will start new requests immediately.
  */
 class NetworkThread {
  public:
@@ -64,13 +84,309 @@ class NetworkThread {
    */
   void AbortRequest(RefPtr<js::XMLHttpRequest> request);
 
+  /**
+   * Opens a connection to the host of the given URL without making a request.
+   * This fills the shared DNS and TLS session caches so the first real request
+   * to that host doesn't wait for them.  This only has an effect if the
+   * connections are shared.
+   */
+  void Preconnect(const std::string& url);
+
+  /** Calls Preconnect for each of the given URLs. */
+  void Preconnect(const std::vector<std::string>& urls);
+
+  /** Changes how new requests share connections. */
+  void SetOptions(const JsManager::NetworkOptions& options);
+
+  /**
+   * Changes where and how often analytics beacons are uploaded.  This can be
+   * called from any thread.
+   */
+  void SetBeaconOptions(const BeaconQueue::Options& options);
+
+  /**
+   * Adds an analytics event or metric to the next beacon batch.  These can be
+   * called from any thread.
+   */
+  void AddBeaconEvent(const std::string& name, const std::string& data);
+  void AddBeaconMetric(const std::string& name, double value);
+
+  /** @return The current statistics of the analytics beacons. */
+  BeaconQueue::Stats GetBeaconStats() const {
+    return beacon_queue_.GetStats();
+  }
+
+  /**
+   * Called on the background thread when a request receives data.  If this
+   * returns false, the request should pause (i.e. return CURL_WRITEFUNC_PAUSE)
+   * since it is over the bandwidth limit or too many bytes are held by
+   * incomplete requests; it will be resumed once more data can be received.
+   */
+  bool AllowDownload(js::XMLHttpRequest* request, size_t bytes);
+
+  /**
+   * @return The cache of responses.  Requests check this before using the
+   *   network and store responses in it when they complete.
+   */
+  SegmentCache* segment_cache() {
+    return &segment_cache_;
+  }
+
+  /**
+   * @return The persistent cache of responses that follows the HTTP caching
+   *   headers.  Requests for manifests and init segments use this.
+   */
+  HttpCache* http_cache() {
+    return &http_cache_;
+  }
+
+  /**
+   * @return The TLS sessions stored across runs.  Every request resumes and
+   *   stores sessions here.
+   */
+  TlsSessionCache* tls_session_cache() {
+    return &tls_session_cache_;
+  }
+
+  /**
+   * @return The estimator of network throughput and latency.  This is updated
+   *   with the CURL timings of every successful request.
+   */
+  const BandwidthEstimator* bandwidth_estimator() const {
+    return &bandwidth_estimator_;
+  }
+
+  /**
+   * @return The RequestType hints for new requests.  Requests use the
+   *   priority of the type they were made as.
+   */
+  RequestPriorityHints* priority_hints() {
+    return &priority_hints_;
+  }
+
+  /**
+   * @return The history used to decide when to hedge slow requests and the
+   *   alternate URIs to send the duplicates to.
+   */
+  HedgePolicy* hedge_policy() {
+    return &hedge_policy_;
+  }
+
+  /**
+   * @return The minimum delay between "progress" events for a request, or 0
+   *   to not throttle them.
+   */
+  uint32_t progress_interval_ms() const {
+    return progress_interval_ms_.load(std::memory_order_relaxed);
+  }
+
+  /** @return The number of requests that have completed. */
+  uint64_t completed_request_count() const {
+    return completed_request_count_.load(std::memory_order_relaxed);
+  }
+
+  /** @return The number of completed requests that reused a connection. */
+  uint64_t reused_connection_count() const {
+    return reused_connection_count_.load(std::memory_order_relaxed);
+  }
+
+  /**
+   * Called when a request completes with a compressed response.  This can be
+   * called from any thread.
+   * @param wire_bytes The number of body bytes received over the network.
+   * @param decoded_bytes The number of body bytes after decoding.
+   */
+  void RecordCompressedResponse(uint64_t wire_bytes, uint64_t decoded_bytes);
+
+  /** @return The number of completed requests that were compressed. */
+  uint64_t compressed_response_count() const {
+    return compressed_response_count_.load(std::memory_order_relaxed);
+  }
+
+  /** @return The total received size of the compressed responses. */
+  uint64_t compressed_wire_bytes() const {
+    return compressed_wire_bytes_.load(std::memory_order_relaxed);
+  }
+
+  /** @return The total decoded size of the compressed responses. */
+  uint64_t compressed_decoded_bytes() const {
+    return compressed_decoded_bytes_.load(std::memory_order_relaxed);
+  }
+
  private:
+  /** Starts a preconnect to the given URL; |mutex_| must be held. */
+  void PreconnectLocked(const std::string& url);
+
+  /**
+   * Preconnects to the segment hosts found in the given request's manifest
+   * response, unless they were already connected to for an earlier manifest.
+   */
+  void PreconnectManifestOrigins(js::XMLHttpRequest* request);
+
+  /** Applies the current options to |multi_handle_|. */
+  void ApplyMultiOptions();
+
+  /** Applies the current options to the given request handle. */
+  void ApplyRequestOptions(CURL* curl, RequestPriority priority);
+
   void ThreadMain();
 
+  /** Wakes up the background thread if it is waiting on the network. */
+  void WakeUp();
+
+  /** Reads any pending wakeup signals from the wakeup pipe. */
+  void DrainWakeUps();
+
+  /** Resumes the paused requests if they can receive more data. */
+  void ResumePausedRequests();
+
+  /**
+   * Stops counting the bytes the given request received against the
+   * in-flight limit, since it completed or was stopped.
+   */
+  void ReleaseInFlight(js::XMLHttpRequest* request);
+
+  /** Adds the timings of a successful request to |bandwidth_estimator_|. */
+  void RecordTransfer(CURL* curl);
+
+  /**
+   * Sends a duplicate of each request in |hedge_candidates_| that has waited
+   * too long for its first byte.
+   */
+  void StartHedges();
+
+  /** Sends a duplicate of the given request. */
+  void StartHedge(js::XMLHttpRequest* request);
+
+  /**
+   * Creates the upload for the next beacon batch, if one is ready, and starts
+   * the uploads that no longer need to wait for more important requests.
+   */
+  void StartBeacons();
+
+  /**
+   * Called when a transfer completes.  If it is a beacon upload, this frees
+   * it.
+   * @return Whether |curl| was a beacon upload.
+   */
+  bool OnBeaconComplete(CURL* curl, CURLcode code);
+
+  /**
+   * Called when a transfer completes.  If it is the duplicate of a request
+   * and it succeeded, this stops the original request and completes it with
+   * the duplicate's response.
+   * @return Whether |curl| was the duplicate of a request.
+   */
+  bool OnHedgeComplete(CURL* curl, CURLcode code);
+
+  /**
+   * Stops tracking the given request for hedging, cancelling its duplicate,
+   * if any.
+   */
+  void CancelHedge(js::XMLHttpRequest* request);
+
+  /**
+   * Starts the given request, or adds it to |held_| if more important
+   * requests are in progress.
+   */
+  void StartRequest(js::XMLHttpRequest* request);
+
+  /** Adds the given request to |multi_handle_| so it starts. */
+  void AddToMultiHandle(js::XMLHttpRequest* request);
+
+  /**
+   * @return Whether a request with the given priority should wait for the more
+   *   important requests that are in progress.
+   */
+  bool IsHeldBack(RequestPriority priority) const;
+
+  /** Starts the requests in |held_| that no longer need to wait. */
+  void StartHeldRequests();
+
+  /**
+   * Starts the requests in |queued_| once they have waited long enough,
+   * coalescing requests for adjacent ranges of the same URL.
+   */
+  void StartQueuedRequests();
+
+  /**
+   * Completes the requests that were coalesced into the given one, or starts
+   * them on their own if the response couldn't be split.
+   */
+  void CompleteCoalescedRequests(js::XMLHttpRequest* request, CURLcode code);
+
+  /**
+   * @return The time, in milliseconds, until requests in |queued_| or |held_|
+   *   should be started, requests should be hedged, or a beacon batch is ready,
+   *   or -1 if there are none.
+   */
+  long GetStartDelayMs() const;  // NOLINT
+
+  struct Hedge;
+
   mutable Mutex mutex_;
-  ThreadEvent<void> cond_;
   std::vector<RefPtr<js::XMLHttpRequest>> requests_;
+  // A pipe used to wake the background thread; index 0 is the read end.
+  const std::array<int, 2> wakeup_fds_;
   CURLM* multi_handle_;
+  CURLSH* share_handle_;
+  JsManager::NetworkOptions options_;
+  SegmentCache segment_cache_;
+  HttpCache http_cache_;
+  TlsSessionCache tls_session_cache_;
+  BandwidthLimiter bandwidth_limiter_;
+  BandwidthEstimator bandwidth_estimator_;
+  InFlightLimiter in_flight_limiter_;
+  // The requests that were paused because of the bandwidth limit.
+  std::vector<CURL*> paused_requests_;
+  // The requests that were paused because of the in-flight limit.
+  std::vector<CURL*> backpressured_requests_;
+  // The handles opened by Preconnect; these aren't tied to any request.
+  std::vector<CURL*> preconnects_;
+  // The origins found in manifests that were already preconnected to, so live
+  // manifest updates don't connect again.
+  std::unordered_set<std::string> manifest_origins_;
+  // Ranged requests that are waiting briefly to be coalesced with requests
+  // for adjacent ranges, oldest first.  These are also in |requests_|.
+  struct QueuedRequest {
+    RefPtr<js::XMLHttpRequest> request;
+    uint64_t queued_time;
+  };
+  std::vector<QueuedRequest> queued_;
+  // The requests whose data is downloaded by another request, keyed by the
+  // CURL handle of that request.  These are also in |requests_|.
+  std::unordered_map<CURL*, std::vector<RefPtr<js::XMLHttpRequest>>>
+      coalesced_;
+  // The requests waiting for more important requests to finish, oldest first.
+  // These are also in |requests_|.
+  std::vector<QueuedRequest> held_;
+  // The number of requests of each priority in |multi_handle_|.
+  std::array<size_t, kRequestPriorityCount> active_counts_;
+  RequestPriorityHints priority_hints_;
+  HedgePolicy hedge_policy_;
+  // The requests in |multi_handle_| that can be hedged, oldest first.
+  std::vector<QueuedRequest> hedge_candidates_;
+  // The duplicates of slow requests that are in |multi_handle_|.
+  std::vector<std::unique_ptr<Hedge>> hedges_;
+  BeaconQueue beacon_queue_;
+  // The uploads of beacon batches, oldest first.  Like |held_|, these wait
+  // for more important requests before they start.
+  struct BeaconUpload {
+    CURL* curl;
+    curl_slist* headers;
+    uint64_t queued_time;
+    bool started;
+  };
+  std::vector<BeaconUpload> beacons_;
+  // Locks the shared data in |share_handle_|.  Requests only run on the
+  // background thread, but handles can be destroyed on other threads.
+  std::mutex share_mutex_;
+  std::atomic<uint32_t> progress_interval_ms_;
+  std::atomic<uint64_t> completed_request_count_;
+  std::atomic<uint64_t> reused_connection_count_;
+  std::atomic<uint64_t> compressed_response_count_;
+  std::atomic<uint64_t> compressed_wire_bytes_;
+  std::atomic<uint64_t> compressed_decoded_bytes_;
   std::atomic<bool> shutdown_;
 
   Thread thread_;
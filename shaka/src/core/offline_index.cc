@@ -0,0 +1,299 @@
+// Copyright 2020 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     https://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "src/core/offline_index.h"
+
+#include <glog/logging.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include <algorithm>
+#include <sstream>
+#include <utility>
+
+#include "src/util/file_system.h"
+#include "src/util/utils.h"
+
+namespace shaka {
+
+namespace {
+
+/** The first line of the file; this changes if the format changes. */
+constexpr const char* kFileHeader = "shaka-offline-index 1";
+
+/** Used in place of the offline URI of content that doesn't have one. */
+constexpr const char* kNoUri = "-";
+
+std::string ToHex(const std::string& str) {
+  return util::ToHexString(reinterpret_cast<const uint8_t*>(str.data()),
+                           str.size());
+}
+
+int FromHexDigit(char c) {
+  if (c >= '0' && c <= '9')
+    return c - '0';
+  if (c >= 'A' && c <= 'F')
+    return c - 'A' + 10;
+  return -1;
+}
+
+bool FromHex(const std::string& hex, std::string* str) {
+  if (hex.size() % 2 != 0)
+    return false;
+  str->resize(hex.size() / 2);
+  for (size_t i = 0; i < str->size(); i++) {
+    const int high = FromHexDigit(hex[i * 2]);
+    const int low = FromHexDigit(hex[i * 2 + 1]);
+    if (high < 0 || low < 0)
+      return false;
+    (*str)[i] = static_cast<char>((high << 4) | low);
+  }
+  return true;
+}
+
+std::string FormatDouble(double value) {
+  // Use enough digits that the value is read back exactly.
+  char buffer[32];
+  snprintf(buffer, sizeof(buffer), "%.17g", value);
+  return buffer;
+}
+
+bool ParseDouble(const std::string& str, double* value) {
+  char* end;
+  *value = strtod(str.c_str(), &end);
+  return !str.empty() && *end == '\0';
+}
+
+std::vector<std::string> Split(const std::string& str, char sep) {
+  std::vector<std::string> ret;
+  size_t start = 0;
+  while (true) {
+    const size_t end = str.find(sep, start);
+    ret.emplace_back(str.substr(start, end - start));
+    if (end == std::string::npos)
+      return ret;
+    start = end + 1;
+  }
+}
+
+bool ParseEntry(const std::string& line, OfflineIndex::Entry* entry) {
+  const std::vector<std::string> fields = Split(line, '\t');
+  if (fields.size() != 6)
+    return false;
+
+  if (fields[0] != kNoUri) {
+    std::string uri;
+    if (!FromHex(fields[0], &uri))
+      return false;
+    entry->offline_uri = std::move(uri);
+  }
+  if (!FromHex(fields[1], &entry->original_manifest_uri) ||
+      !ParseDouble(fields[2], &entry->duration) ||
+      !ParseDouble(fields[3], &entry->size) ||
+      !ParseDouble(fields[4], &entry->expiration)) {
+    return false;
+  }
+  if (fields[5].empty())
+    return true;
+  for (const std::string& pair : Split(fields[5], ',')) {
+    const size_t colon = pair.find(':');
+    std::string key, value;
+    if (colon == std::string::npos || !FromHex(pair.substr(0, colon), &key) ||
+        !FromHex(pair.substr(colon + 1), &value)) {
+      return false;
+    }
+    entry->app_metadata[key] = std::move(value);
+  }
+  return true;
+}
+
+std::string FormatEntry(const OfflineIndex::Entry& entry) {
+  std::string ret = entry.offline_uri.has_value()
+                        ? ToHex(entry.offline_uri.value())
+                        : std::string(kNoUri);
+  ret += "\t" + ToHex(entry.original_manifest_uri) + "\t" +
+         FormatDouble(entry.duration) + "\t" + FormatDouble(entry.size) +
+         "\t" + FormatDouble(entry.expiration) + "\t";
+  bool first = true;
+  for (auto& pair : entry.app_metadata) {
+    if (!first)
+      ret += ",";
+    first = false;
+    ret += ToHex(pair.first) + ":" + ToHex(pair.second);
+  }
+  return ret;
+}
+
+}  // namespace
+
+// static
+OfflineIndex OfflineIndex::Instance;
+
+OfflineIndex::Entry::Entry() : duration(0), size(0), expiration(0) {}
+OfflineIndex::Entry::~Entry() {}
+
+OfflineIndex::OfflineIndex()
+    : generation_(0), pending_updates_(0), complete_(false) {}
+
+OfflineIndex::~OfflineIndex() {}
+
+void OfflineIndex::SetFile(const std::string& path) {
+  std::unique_lock<std::mutex> lock(mutex_);
+  path_ = path;
+  // If the content was already listed, that is newer than the file.
+  if (complete_) {
+    if (pending_updates_ == 0)
+      Save();
+  } else {
+    Load();
+  }
+}
+
+bool OfflineIndex::GetAll(std::vector<Entry>* entries) const {
+  std::unique_lock<std::mutex> lock(mutex_);
+  if (!complete_ || pending_updates_ > 0)
+    return false;
+  *entries = entries_;
+  return true;
+}
+
+uint64_t OfflineIndex::GetGeneration() const {
+  std::unique_lock<std::mutex> lock(mutex_);
+  return generation_;
+}
+
+void OfflineIndex::Reset(const std::vector<Entry>& entries,
+                         uint64_t generation) {
+  std::unique_lock<std::mutex> lock(mutex_);
+  if (generation != generation_ || pending_updates_ > 0)
+    return;
+  entries_ = entries;
+  complete_ = true;
+  Save();
+}
+
+void OfflineIndex::Invalidate() {
+  std::unique_lock<std::mutex> lock(mutex_);
+  generation_++;
+  entries_.clear();
+  complete_ = false;
+  Save();
+}
+
+void OfflineIndex::BeginUpdate() {
+  std::unique_lock<std::mutex> lock(mutex_);
+  generation_++;
+  if (pending_updates_++ == 0) {
+    // Remove the file while updating so it isn't used if the app exits before
+    // the update finishes.
+    Save();
+  }
+}
+
+void OfflineIndex::FinishStore(const Entry& entry) {
+  std::unique_lock<std::mutex> lock(mutex_);
+  if (entry.offline_uri.has_value()) {
+    auto it = std::find_if(entries_.begin(), entries_.end(),
+                           [&](const Entry& other) {
+                             return other.offline_uri == entry.offline_uri;
+                           });
+    if (it != entries_.end())
+      *it = entry;
+    else
+      entries_.emplace_back(entry);
+  } else {
+    // Content is only stored without a URI if it failed part way, which
+    // Storage reports as an error.
+    complete_ = false;
+  }
+  EndUpdate();
+}
+
+void OfflineIndex::FinishRemove(const std::string& offline_uri) {
+  std::unique_lock<std::mutex> lock(mutex_);
+  entries_.erase(std::remove_if(entries_.begin(), entries_.end(),
+                                [&](const Entry& entry) {
+                                  return entry.offline_uri == offline_uri;
+                                }),
+                 entries_.end());
+  EndUpdate();
+}
+
+void OfflineIndex::FailUpdate() {
+  std::unique_lock<std::mutex> lock(mutex_);
+  // The content may be partly stored or removed, so list it again.
+  entries_.clear();
+  complete_ = false;
+  EndUpdate();
+}
+
+void OfflineIndex::EndUpdate() {
+  DCHECK_GT(pending_updates_, 0u);
+  generation_++;
+  if (--pending_updates_ == 0)
+    Save();
+}
+
+void OfflineIndex::Load() {
+  entries_.clear();
+  complete_ = false;
+  util::FileSystem fs;
+  std::vector<uint8_t> data;
+  if (path_.empty() || !fs.FileExists(path_) || !fs.ReadFile(path_, &data))
+    return;
+
+  // After the header, each line is one entry: the hex-encoded offline URI (or
+  // "-"), the hex-encoded manifest URI, the duration, size, and expiration,
+  // then the hex-encoded app metadata as comma-separated "key:value" pairs,
+  // all separated by tabs.
+  std::stringstream stream(std::string(data.begin(), data.end()));
+  std::string line;
+  if (!std::getline(stream, line) || line != kFileHeader) {
+    VLOG(1) << "Ignoring offline index in an unknown format";
+    return;
+  }
+  while (std::getline(stream, line)) {
+    Entry entry;
+    if (!ParseEntry(line, &entry)) {
+      // Don't use a partial index; the content will be listed again.
+      LOG(WARNING) << "Ignoring invalid offline index";
+      entries_.clear();
+      return;
+    }
+    entries_.emplace_back(std::move(entry));
+  }
+  complete_ = true;
+  VLOG(1) << "Loaded offline index with " << entries_.size() << " entries";
+}
+
+void OfflineIndex::Save() const {
+  if (path_.empty())
+    return;
+
+  util::FileSystem fs;
+  if (!complete_ || pending_updates_ > 0) {
+    // Only complete indexes are stored.
+    if (fs.FileExists(path_) && !fs.DeleteFile(path_))
+      LOG(WARNING) << "Unable to delete offline index";
+    return;
+  }
+
+  std::string data = std::string(kFileHeader) + "\n";
+  for (auto& entry : entries_)
+    data += FormatEntry(entry) + "\n";
+  if (!fs.WriteFile(path_, std::vector<uint8_t>(data.begin(), data.end())))
+    LOG(WARNING) << "Unable to write offline index";
+}
+
+}  // namespace shaka
@@ -0,0 +1,121 @@
+// Copyright 2020 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     https://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef SHAKA_EMBEDDED_CORE_OFFLINE_INDEX_H_
+#define SHAKA_EMBEDDED_CORE_OFFLINE_INDEX_H_
+
+#include <stdint.h>
+
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "shaka/optional.h"
+#include "src/util/macros.h"
+
+namespace shaka {
+
+/**
+ * Stores the metadata of the content stored offline in a small file, so
+ * Storage::List doesn't need to read every stored manifest from IndexedDB.
+ * Storage keeps this updated as content is stored and removed.
+ *
+ * The index is only used while it is known to match the database.  It is
+ * dropped when a store or remove fails (or the app exits during one), and the
+ * next list through JavaScript rebuilds it.  Content stored or removed by
+ * calling shaka.offline.Storage directly from JavaScript isn't seen here.
+ *
+ * This type is thread-safe.
+ */
+class OfflineIndex final {
+ public:
+  /** The metadata of one piece of stored content. */
+  struct Entry {
+    Entry();
+    ~Entry();
+
+    optional<std::string> offline_uri;
+    std::string original_manifest_uri;
+    double duration;
+    double size;
+    double expiration;
+    std::unordered_map<std::string, std::string> app_metadata;
+  };
+
+  OfflineIndex();
+  ~OfflineIndex();
+
+  SHAKA_NON_COPYABLE_OR_MOVABLE_TYPE(OfflineIndex);
+
+  /** The instance used by Storage. */
+  static OfflineIndex Instance;
+
+  /** Loads the index stored in the given file and stores changes there. */
+  void SetFile(const std::string& path);
+
+  /**
+   * Gets every stored content.
+   * @return True on success, false if the index isn't known to be complete.
+   */
+  bool GetAll(std::vector<Entry>* entries) const;
+
+  /**
+   * @return A number that changes whenever content is stored or removed.  This
+   *   is passed to Reset to check nothing changed while listing the content.
+   */
+  uint64_t GetGeneration() const;
+
+  /**
+   * Replaces the index with the given content, which was listed from the
+   * database.  This is ignored if content was stored or removed since
+   * |generation| was read.
+   */
+  void Reset(const std::vector<Entry>& entries, uint64_t generation);
+
+  /** Drops the index, so the next list reads the database. */
+  void Invalidate();
+
+  /**
+   * Called before storing or removing content.  The index isn't used until the
+   * matching FinishStore, FinishRemove, or FailUpdate call.
+   */
+  void BeginUpdate();
+  /** Called once the given content is stored. */
+  void FinishStore(const Entry& entry);
+  /** Called once the content with the given offline URI is removed. */
+  void FinishRemove(const std::string& offline_uri);
+  /** Called when storing or removing content fails; drops the index. */
+  void FailUpdate();
+
+ private:
+  void Load();
+  void Save() const;
+  /** Finishes an update, saving the index if it is complete. */
+  void EndUpdate();
+
+  // This uses a plain mutex since |Instance| is statically initialized.
+  mutable std::mutex mutex_;
+  std::string path_;
+  std::vector<Entry> entries_;
+  uint64_t generation_;
+  // The number of stores/removes that haven't finished.
+  size_t pending_updates_;
+  // Whether |entries_| holds every stored content.
+  bool complete_;
+};
+
+}  // namespace shaka
+
+#endif  // SHAKA_EMBEDDED_CORE_OFFLINE_INDEX_H_
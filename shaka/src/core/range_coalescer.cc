@@ -0,0 +1,67 @@
+// Copyright 2020 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     https://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "src/core/range_coalescer.h"
+
+#include <algorithm>
+#include <tuple>
+
+namespace shaka {
+
+std::vector<RangeGroup> GroupRangeRequests(
+    const std::vector<RangeRequest>& ranges) {
+  std::vector<size_t> order(ranges.size());
+  for (size_t i = 0; i < order.size(); i++)
+    order[i] = i;
+  std::stable_sort(order.begin(), order.end(), [&](size_t a, size_t b) {
+    return std::tie(ranges[a].key, ranges[a].start) <
+           std::tie(ranges[b].key, ranges[b].start);
+  });
+
+  std::vector<RangeGroup> ret;
+  for (size_t i = 0; i < order.size();) {
+    const RangeRequest& first = ranges[order[i]];
+    RangeGroup group;
+    group.requests.push_back(order[i]);
+    group.end = first.end;
+
+    // Add the requests that start within, or directly after, the combined
+    // range so far.
+    size_t next = i + 1;
+    for (; next < order.size(); next++) {
+      const RangeRequest& range = ranges[order[next]];
+      if (range.key != first.key || range.start > group.end + 1)
+        break;
+      group.requests.push_back(order[next]);
+      group.end = std::max(group.end, range.end);
+    }
+
+    ret.push_back(std::move(group));
+    i = next;
+  }
+  return ret;
+}
+
+bool GetCoalescedPart(uint64_t body_start, size_t body_size,
+                      const RangeRequest& range, size_t* offset, size_t* size) {
+  if (range.start < body_start || range.end < range.start ||
+      range.end - body_start >= body_size) {
+    return false;
+  }
+  *offset = static_cast<size_t>(range.start - body_start);
+  *size = static_cast<size_t>(range.end - range.start + 1);
+  return true;
+}
+
+}  // namespace shaka
@@ -0,0 +1,76 @@
+// Copyright 2020 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     https://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef SHAKA_EMBEDDED_CORE_RANGE_COALESCER_H_
+#define SHAKA_EMBEDDED_CORE_RANGE_COALESCER_H_
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <string>
+#include <vector>
+
+namespace shaka {
+
+/** A request for a closed byte range that may be coalesced with others. */
+struct RangeRequest {
+  /** Requests with the same key are for the same URL with the same headers. */
+  std::string key;
+  /** The first byte requested. */
+  uint64_t start;
+  /** The last byte requested (inclusive). */
+  uint64_t end;
+};
+
+/** A group of requests that are downloaded with a single request. */
+struct RangeGroup {
+  /**
+   * The indices of the requests in the group, ordered by start.  The first
+   * one downloads the combined range for the others.
+   */
+  std::vector<size_t> requests;
+  /** The last byte of the combined range (inclusive). */
+  uint64_t end;
+};
+
+/**
+ * Groups requests that can be downloaded with a single request.  Requests for
+ * the same key are grouped when their ranges overlap or are adjacent, so the
+ * combined range has no gaps; requests with a gap between them aren't.
+ *
+ * @param ranges The requests to group.
+ * @return The groups, one per request to make.  Every request is in exactly
+ *   one group.
+ */
+std::vector<RangeGroup> GroupRangeRequests(
+    const std::vector<RangeRequest>& ranges);
+
+/**
+ * Finds the part of a coalesced response body that belongs to one of the
+ * requests in its group.
+ *
+ * @param body_start The first byte of the response body.
+ * @param body_size The number of bytes in the response body.
+ * @param range The request to find the part of.
+ * @param offset [OUT] Where to put the offset of the part in the body.
+ * @param size [OUT] Where to put the size of the part.
+ * @return True on success, false if the body doesn't cover the range (e.g.
+ *   the server shortened it).
+ */
+bool GetCoalescedPart(uint64_t body_start, size_t body_size,
+                      const RangeRequest& range, size_t* offset, size_t* size);
+
+}  // namespace shaka
+
+#endif  // SHAKA_EMBEDDED_CORE_RANGE_COALESCER_H_
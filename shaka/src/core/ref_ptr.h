@@ -68,15 +68,16 @@ class RefPtr {
   }
 
   // Move-constructors cannot have a template, even if it can be deduced.
-  RefPtr(RefPtr&& other) {
-    reset(other.ptr_);
-    other.reset();
+  // Moving takes the reference from |other|, so the ref count doesn't change.
+  RefPtr(RefPtr&& other) : ptr_(other.ptr_) {
+    other.ptr_ = nullptr;
   }
 
   template <typename U>
-  RefPtr(RefPtr<U>&& other) {
-    reset(other.ptr_);
-    other.reset();
+  RefPtr(RefPtr<U>&& other) : ptr_(other.ptr_) {
+    static_assert(std::is_convertible<U*, T*>::value,
+                  "U must be implicitly convertible to T");
+    other.ptr_ = nullptr;
   }
 
   ~RefPtr() {
@@ -99,8 +100,11 @@ class RefPtr {
     return *this;
   }
   RefPtr& operator=(RefPtr&& other) {
-    reset(other.ptr_);
-    other.reset();
+    if (this != &other) {
+      memory::ObjectTracker::Instance()->RemoveRef(ptr_);
+      ptr_ = other.ptr_;
+      other.ptr_ = nullptr;
+    }
     return *this;
   }
 
@@ -160,16 +164,19 @@ struct impl::ConvertHelper<RefPtr<T>> {
       return true;
     }
 
-    // Get backing pointer and verify the type of the backing is correct.
+    // Get backing pointer and verify the type of the backing is correct.  The
+    // name is cached since this is done for |this| on every call from
+    // JavaScript.
+    static const std::string type_name = TypeName<T>::name();
     BackingObject* ptr = GetInternalPointer(source);
-    if (!IsDerivedFrom(ptr, TypeName<T>::name()))
+    if (!IsDerivedFrom(ptr, type_name))
       return false;
 
     dest->reset(static_cast<T*>(ptr));
     return true;
   }
 
-  static ReturnVal<JsValue> ToJsValue(RefPtr<T> source) {
+  static ReturnVal<JsValue> ToJsValue(const RefPtr<T>& source) {
     if (source.empty())
       return JsNull();
     else
@@ -28,8 +28,8 @@ void RejectedPromiseHandler::AddPromise(Handle<JsPromise> promise,
   promises_.emplace_back(promise, value);
   if (!has_callback_) {
     has_callback_ = true;
-    JsManagerImpl::Instance()->MainThread()->AddInternalTask(
-        TaskPriority::Immediate, "", [this]() { LogUnhandledRejection(); });
+    JsManagerImpl::Instance()->MainThread()->PostTask(
+        TaskPriority::Immediate, [this]() { LogUnhandledRejection(); });
   }
 }
 
@@ -0,0 +1,77 @@
+// Copyright 2020 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     https://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "src/core/request_priority.h"
+
+#include <mutex>
+
+namespace shaka {
+
+constexpr const size_t RequestPriorityHints::kMaxHints;
+
+RequestPriority GetRequestPriority(RequestType type) {
+  switch (type) {
+    case RequestType::License:
+      return RequestPriority::Critical;
+    case RequestType::Manifest:
+    case RequestType::Timing:
+      return RequestPriority::High;
+    default:
+      return RequestPriority::Normal;
+  }
+}
+
+long GetStreamWeight(RequestPriority priority) {  // NOLINT
+  // CURL uses a weight of 16 by default.
+  switch (priority) {
+    case RequestPriority::Critical:
+      return 256;
+    case RequestPriority::High:
+      return 128;
+    case RequestPriority::Background:
+      return 1;
+    default:
+      return 16;
+  }
+}
+
+
+RequestPriorityHints::RequestPriorityHints()
+    : mutex_("RequestPriorityHints") {}
+
+RequestPriorityHints::~RequestPriorityHints() {}
+
+void RequestPriorityHints::Add(const std::string& url, RequestType type) {
+  std::unique_lock<Mutex> lock(mutex_);
+  auto it = index_.find(url);
+  if (it != index_.end()) {
+    entries_.erase(it->second);
+    index_.erase(it);
+  }
+
+  entries_.emplace_front(url, GetRequestPriority(type));
+  index_.emplace(url, entries_.begin());
+  if (entries_.size() > kMaxHints) {
+    index_.erase(entries_.back().first);
+    entries_.pop_back();
+  }
+}
+
+RequestPriority RequestPriorityHints::Get(const std::string& url) const {
+  std::unique_lock<Mutex> lock(mutex_);
+  auto it = index_.find(url);
+  return it != index_.end() ? it->second->second : RequestPriority::Normal;
+}
+
+}  // namespace shaka
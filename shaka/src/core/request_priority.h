@@ -0,0 +1,93 @@
+// Copyright 2020 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     https://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef SHAKA_EMBEDDED_CORE_REQUEST_PRIORITY_H_
+#define SHAKA_EMBEDDED_CORE_REQUEST_PRIORITY_H_
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <list>
+#include <string>
+#include <unordered_map>
+#include <utility>
+
+#include "shaka/net.h"
+#include "src/debug/mutex.h"
+#include "src/util/macros.h"
+
+namespace shaka {
+
+/**
+ * The priority class of a network request.  Lower values are more important;
+ * requests are held back while more important requests are in progress.
+ */
+enum class RequestPriority : uint8_t {
+  /** Requests that block playback from starting, like license requests. */
+  Critical = 0,
+  /** Small requests that keep playback going, like manifest updates. */
+  High = 1,
+  /** Media segments and anything else. */
+  Normal = 2,
+  /** Native uploads that nothing waits for, like analytics beacons. */
+  Background = 3,
+};
+
+/** The number of RequestPriority values. */
+constexpr const size_t kRequestPriorityCount = 4;
+
+/** @return The priority class for requests of the given type. */
+RequestPriority GetRequestPriority(RequestType type);
+
+/** @return The HTTP/2 stream weight (1-256) for the given priority. */
+long GetStreamWeight(RequestPriority priority);  // NOLINT
+
+/**
+ * Remembers the RequestType of recent requests by URL.  The RequestType is
+ * only known to the NetworkingEngine, so this is filled by a request filter
+ * and read when the XMLHttpRequest for that URL is sent.
+ *
+ * This type is thread-safe.
+ */
+class RequestPriorityHints {
+ public:
+  /** The number of URLs to remember. */
+  static constexpr const size_t kMaxHints = 64;
+
+  RequestPriorityHints();
+  ~RequestPriorityHints();
+
+  SHAKA_NON_COPYABLE_OR_MOVABLE_TYPE(RequestPriorityHints);
+
+  /** Records that the given URL is about to be requested as |type|. */
+  void Add(const std::string& url, RequestType type);
+
+  /**
+   * @return The priority of the given URL, or Normal if there isn't a hint for
+   *   it.
+   */
+  RequestPriority Get(const std::string& url) const;
+
+ private:
+  using Entry = std::pair<std::string, RequestPriority>;
+
+  mutable Mutex mutex_;
+  // Most recently added first.
+  std::list<Entry> entries_;
+  std::unordered_map<std::string, std::list<Entry>::iterator> index_;
+};
+
+}  // namespace shaka
+
+#endif  // SHAKA_EMBEDDED_CORE_REQUEST_PRIORITY_H_
@@ -0,0 +1,128 @@
+// Copyright 2018 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     https://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "src/core/segment_cache.h"
+
+#include <iterator>
+
+namespace shaka {
+
+SegmentCache::SegmentCache(size_t max_bytes)
+    : mutex_("SegmentCache"),
+      max_bytes_(max_bytes),
+      total_bytes_(0),
+      hits_(0),
+      misses_(0),
+      evictions_(0),
+      budget_consumer_(memory::MemorySubsystem::SegmentCache, "SegmentCache",
+                       [this]() { return GetStats().total_bytes; },
+                       [this](size_t bytes) { return EvictBytes(bytes); }) {}
+
+SegmentCache::~SegmentCache() {}
+
+// static
+std::string SegmentCache::MakeKey(const std::string& uri,
+                                  const std::string& range) {
+  // A newline can't appear in either a URI or a header value.
+  return range.empty() ? uri : uri + "\n" + range;
+}
+
+bool SegmentCache::enabled() const {
+  std::unique_lock<Mutex> lock(mutex_);
+  return max_bytes_ > 0;
+}
+
+void SegmentCache::SetMaxSize(size_t max_bytes) {
+  std::unique_lock<Mutex> lock(mutex_);
+  max_bytes_ = max_bytes;
+  EvictUntilFits(0);
+}
+
+std::shared_ptr<const SegmentCache::Entry> SegmentCache::Get(
+    const std::string& key) {
+  std::unique_lock<Mutex> lock(mutex_);
+  auto it = entries_.find(key);
+  if (it == entries_.end()) {
+    misses_++;
+    return nullptr;
+  }
+
+  hits_++;
+  lru_.splice(lru_.begin(), lru_, it->second);
+  return it->second->second;
+}
+
+void SegmentCache::Put(const std::string& key,
+                       std::shared_ptr<const Entry> entry) {
+  std::unique_lock<Mutex> lock(mutex_);
+  auto it = entries_.find(key);
+  if (it != entries_.end())
+    RemoveEntry(it->second);
+
+  const size_t size = entry->data.size();
+  if (size > max_bytes_)
+    return;
+
+  EvictUntilFits(size);
+  lru_.emplace_front(key, std::move(entry));
+  entries_.emplace(key, lru_.begin());
+  total_bytes_ += size;
+
+  // Evict other caches (or our older entries) if this went over budget.
+  lock.unlock();
+  memory::MemoryBudget::Instance()->Enforce(0);
+}
+
+void SegmentCache::Clear() {
+  std::unique_lock<Mutex> lock(mutex_);
+  lru_.clear();
+  entries_.clear();
+  total_bytes_ = 0;
+}
+
+SegmentCache::Stats SegmentCache::GetStats() const {
+  std::unique_lock<Mutex> lock(mutex_);
+  Stats ret;
+  ret.hits = hits_;
+  ret.misses = misses_;
+  ret.evictions = evictions_;
+  ret.entry_count = entries_.size();
+  ret.total_bytes = total_bytes_;
+  return ret;
+}
+
+void SegmentCache::EvictUntilFits(size_t extra_bytes) {
+  while (!lru_.empty() && total_bytes_ + extra_bytes > max_bytes_) {
+    RemoveEntry(std::prev(lru_.end()));
+    evictions_++;
+  }
+}
+
+size_t SegmentCache::EvictBytes(size_t bytes) {
+  std::unique_lock<Mutex> lock(mutex_);
+  const size_t old_size = total_bytes_;
+  while (!lru_.empty() && old_size - total_bytes_ < bytes) {
+    RemoveEntry(std::prev(lru_.end()));
+    evictions_++;
+  }
+  return old_size - total_bytes_;
+}
+
+void SegmentCache::RemoveEntry(LruList::iterator it) {
+  total_bytes_ -= it->second->data.size();
+  entries_.erase(it->first);
+  lru_.erase(it);
+}
+
+}  // namespace shaka
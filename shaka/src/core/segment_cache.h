@@ -0,0 +1,130 @@
+// Copyright 2018 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     https://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef SHAKA_EMBEDDED_CORE_SEGMENT_CACHE_H_
+#define SHAKA_EMBEDDED_CORE_SEGMENT_CACHE_H_
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <list>
+#include <map>
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include "src/debug/mutex.h"
+#include "src/memory/memory_budget.h"
+#include "src/util/macros.h"
+
+namespace shaka {
+
+/**
+ * A bounded, least-recently-used cache of network responses.  This is used by
+ * the network layer to serve repeated segment requests (e.g. after a seek or a
+ * quality switch) from memory.  Entries are keyed by the URI and the Range
+ * header of the request.  The entries count against the MemoryBudget and are
+ * the first thing evicted when over budget.
+ *
+ * This type is thread-safe.
+ */
+class SegmentCache {
+ public:
+  struct Entry {
+    int status = 200;
+    std::string status_text;
+    std::string uri;
+    std::map<std::string, std::string> headers;
+    std::vector<uint8_t> data;
+  };
+
+  struct Stats {
+    uint64_t hits = 0;
+    uint64_t misses = 0;
+    uint64_t evictions = 0;
+    size_t entry_count = 0;
+    size_t total_bytes = 0;
+  };
+
+  /** Creates a new cache holding at most |max_bytes| of response data. */
+  explicit SegmentCache(size_t max_bytes = 0);
+  ~SegmentCache();
+
+  SHAKA_NON_COPYABLE_OR_MOVABLE_TYPE(SegmentCache);
+
+  /** @return The key used to store the given request. */
+  static std::string MakeKey(const std::string& uri, const std::string& range);
+
+  /** @return Whether the cache will store any entries. */
+  bool enabled() const;
+
+  /**
+   * Changes the maximum size of the cache.  This will evict entries if the
+   * cache is larger than the new size.  A size of 0 disables the cache.
+   */
+  void SetMaxSize(size_t max_bytes);
+
+  /**
+   * Looks up the given entry and marks it as recently used.
+   * @return The entry, or nullptr if it isn't in the cache.
+   */
+  std::shared_ptr<const Entry> Get(const std::string& key);
+
+  /**
+   * Adds the given entry, replacing any existing entry with the same key.
+   * Entries that are larger than the max size of the cache are ignored.
+   */
+  void Put(const std::string& key, std::shared_ptr<const Entry> entry);
+
+  /** Removes all entries from the cache. */
+  void Clear();
+
+  /** @return The current statistics of the cache. */
+  Stats GetStats() const;
+
+ private:
+  using LruList =
+      std::list<std::pair<std::string, std::shared_ptr<const Entry>>>;
+
+  /** Removes the least-recently-used entries until we fit in |max_bytes_|. */
+  void EvictUntilFits(size_t extra_bytes);
+
+  /**
+   * Removes the least-recently-used entries until at least |bytes| are freed.
+   * @return The number of bytes freed.
+   */
+  size_t EvictBytes(size_t bytes);
+
+  /** Removes the given entry, updating |total_bytes_|. */
+  void RemoveEntry(LruList::iterator it);
+
+  mutable Mutex mutex_;
+  // Most-recently-used entries are at the front.
+  LruList lru_;
+  std::unordered_map<std::string, LruList::iterator> entries_;
+  size_t max_bytes_;
+  size_t total_bytes_;
+  uint64_t hits_;
+  uint64_t misses_;
+  uint64_t evictions_;
+
+  // This must be last so it is unregistered before the rest is destroyed.
+  memory::MemoryBudget::Consumer budget_consumer_;
+};
+
+}  // namespace shaka
+
+#endif  // SHAKA_EMBEDDED_CORE_SEGMENT_CACHE_H_
@@ -0,0 +1,73 @@
+// Copyright 2020 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     https://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "src/core/storage_thread.h"
+
+#include <glog/logging.h>
+
+#include <algorithm>
+#include <utility>
+
+namespace shaka {
+
+StorageThread::StorageThread(TaskRunner* main_thread, const util::Clock* clock)
+    : mutex_("StorageThread"),
+      main_thread_(main_thread),
+      clock_(clock),
+      runner_([](TaskRunner::RunLoop run_loop) { run_loop(); }, clock,
+              /* is_worker */ true) {}
+
+StorageThread::~StorageThread() {}
+
+void StorageThread::Stop() {
+  runner_.Stop();
+}
+
+void StorageThread::AddTask(const std::string& name, std::function<void()> work,
+                            std::function<void()> done) {
+  {
+    std::unique_lock<Mutex> lock(mutex_);
+    stats_.queue_depth++;
+    stats_.max_queue_depth =
+        std::max(stats_.max_queue_depth, stats_.queue_depth);
+  }
+
+  const uint64_t start_ms = clock_->GetMonotonicTime();
+  runner_.AddInternalTask(
+      TaskPriority::Internal, name,
+      [this, name, start_ms, work, done]() mutable {
+        work();
+        OnTaskDone(start_ms);
+        main_thread_->AddInternalTask(TaskPriority::Internal, name,
+                                      std::move(done));
+      });
+}
+
+StorageThread::Stats StorageThread::GetStats() const {
+  std::unique_lock<Mutex> lock(mutex_);
+  return stats_;
+}
+
+void StorageThread::OnTaskDone(uint64_t start_ms) {
+  const uint64_t latency_ms = clock_->GetMonotonicTime() - start_ms;
+
+  std::unique_lock<Mutex> lock(mutex_);
+  DCHECK_GT(stats_.queue_depth, 0u);
+  stats_.queue_depth--;
+  stats_.task_count++;
+  stats_.total_latency_ms += latency_ms;
+  stats_.max_latency_ms = std::max(stats_.max_latency_ms, latency_ms);
+}
+
+}  // namespace shaka
@@ -0,0 +1,91 @@
+// Copyright 2020 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     https://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef SHAKA_EMBEDDED_CORE_STORAGE_THREAD_H_
+#define SHAKA_EMBEDDED_CORE_STORAGE_THREAD_H_
+
+#include <stdint.h>
+
+#include <functional>
+#include <string>
+
+#include "src/core/task_runner.h"
+#include "src/debug/mutex.h"
+#include "src/util/clock.h"
+#include "src/util/macros.h"
+
+namespace shaka {
+
+/**
+ * Runs the IndexedDB database work on a background thread so slow disk access
+ * doesn't block JavaScript.  Tasks run one at a time in the order they are
+ * added, and each one has a callback that is then run on the main thread.
+ *
+ * This type is thread-safe.
+ */
+class StorageThread {
+ public:
+  struct Stats {
+    /** The number of tasks that have completed. */
+    uint64_t task_count = 0;
+    /** The number of tasks that are waiting or running. */
+    uint64_t queue_depth = 0;
+    /** The largest value |queue_depth| has had. */
+    uint64_t max_queue_depth = 0;
+    /**
+     * The total time, in milliseconds, between adding a task and it
+     * completing; this includes the time waiting for earlier tasks.
+     */
+    uint64_t total_latency_ms = 0;
+    /** The longest time a single task took to complete, in milliseconds. */
+    uint64_t max_latency_ms = 0;
+  };
+
+  /**
+   * @param main_thread The task runner to run the completion callbacks on.
+   * @param clock The clock used to measure latency.
+   */
+  StorageThread(TaskRunner* main_thread, const util::Clock* clock);
+  ~StorageThread();
+
+  SHAKA_NON_COPYABLE_OR_MOVABLE_TYPE(StorageThread);
+
+  /** Stops the background thread; any pending tasks aren't run. */
+  void Stop();
+
+  /**
+   * Runs |work| on the background thread, then runs |done| on the main thread.
+   * |done| is only moved between the threads, so it can hold references to
+   * JavaScript objects as long as |work| doesn't.
+   */
+  void AddTask(const std::string& name, std::function<void()> work,
+               std::function<void()> done);
+
+  /** @return The current statistics of the tasks. */
+  Stats GetStats() const;
+
+ private:
+  /** Records that a task added at the given time has completed. */
+  void OnTaskDone(uint64_t start_ms);
+
+  mutable Mutex mutex_;
+  TaskRunner* const main_thread_;
+  const util::Clock* const clock_;
+  Stats stats_;
+  TaskRunner runner_;
+};
+
+}  // namespace shaka
+
+#endif  // SHAKA_EMBEDDED_CORE_STORAGE_THREAD_H_
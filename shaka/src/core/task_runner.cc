@@ -16,19 +16,63 @@
 
 #include <glog/logging.h>
 
+#include <algorithm>
 #include <chrono>
 #include <limits>
 
+#include "src/debug/telemetry.h"
+#include "src/debug/trace_event.h"
 #include "src/mapping/js_wrappers.h"
 
 namespace shaka {
 
+namespace {
+
+/** The default time a task must run for to be counted as a long task. */
+constexpr const uint64_t kDefaultLongTaskThresholdMs = 50;
+
+/** The number of recent long tasks to keep. */
+constexpr const size_t kMaxRecentLongTasks = 16;
+
+/**
+ * The maximum number of task names to keep times for.  Names are normally
+ * constants, so this only limits a bug that uses unique names.
+ */
+constexpr const size_t kMaxTaskNames = 256;
+
+/**
+ * The maximum number of task spans to record for a CPU profile.  Profiles
+ * are bounded in time, so this only limits very short tasks.
+ */
+constexpr const size_t kMaxTaskSpans = 64 * 1024;
+
+/** The time a task can run for before ShouldYield returns true. */
+constexpr const uint64_t kTimeSliceMs = 5;
+
+const char* GetUnnamedTaskName(TaskPriority priority) {
+  switch (priority) {
+    case TaskPriority::Timer:
+      return "(Timer)";
+    case TaskPriority::Internal:
+      return "(Internal)";
+    case TaskPriority::Events:
+      return "(Events)";
+    case TaskPriority::Immediate:
+      return "(Immediate)";
+  }
+  return "";
+}
+
+}  // namespace
+
 namespace impl {
 
 PendingTaskBase::PendingTaskBase(const util::Clock* clock,
                                  TaskPriority priority, uint64_t delay_ms,
                                  int id, bool loop)
-    : start_ms(clock->GetMonotonicTime()),
+    : pool(nullptr),
+      alloc_size(0),
+      start_ms(clock->GetMonotonicTime()),
       delay_ms(delay_ms),
       priority(priority),
       id(id),
@@ -37,19 +81,85 @@ PendingTaskBase::PendingTaskBase(const util::Clock* clock,
 
 PendingTaskBase::~PendingTaskBase() {}
 
+std::string PendingTaskBase::name() const {
+  return "";
+}
+
+void TaskDeleter::operator()(PendingTaskBase* task) const {
+  TaskPool* pool = task->pool;
+  const size_t size = task->alloc_size;
+  task->~PendingTaskBase();
+  pool->Free(task, size);
+}
+
+constexpr const size_t TaskPool::kBlockSize;
+constexpr const size_t TaskPool::kMaxFreeBlocks;
+
+TaskPool::TaskPool() : heap_allocation_count_(0) {}
+
+TaskPool::~TaskPool() {
+  for (void* block : free_blocks_)
+    ::operator delete(block);
+}
+
+void* TaskPool::Allocate(size_t size) {
+  if (size <= kBlockSize) {
+    std::unique_lock<std::mutex> lock(mutex_);
+    if (!free_blocks_.empty()) {
+      void* ret = free_blocks_.back();
+      free_blocks_.pop_back();
+      return ret;
+    }
+    size = kBlockSize;
+  }
+  heap_allocation_count_++;
+  return ::operator new(size);
+}
+
+void TaskPool::Free(void* memory, size_t size) {
+  if (size <= kBlockSize) {
+    std::unique_lock<std::mutex> lock(mutex_);
+    if (free_blocks_.size() < kMaxFreeBlocks) {
+      free_blocks_.push_back(memory);
+      return;
+    }
+  }
+  ::operator delete(memory);
+}
+
 }  // namespace impl
 
+constexpr const uint64_t TaskRunner::kMinIdleMs;
+constexpr const uint64_t TaskRunner::kMaxIdleMs;
+
 TaskRunner::TaskRunner(std::function<void(RunLoop)> wrapper,
-                       const util::Clock* clock, bool is_worker)
-    : mutex_(is_worker ? "TaskRunner worker" : "TaskRunner main"),
+                       const util::Clock* clock, bool is_worker,
+                       bool is_manual)
+    : pending_count_(0),
+      timer_slack_ms_(0),
+      mutex_(is_worker ? "TaskRunner worker" : "TaskRunner main"),
       clock_(clock),
       waiting_("TaskRunner wait until finished"),
       running_(true),
       next_id_(0),
       is_worker_(is_worker),
-      worker_(is_worker ? "JS Worker" : "JS Main Thread",
-              std::bind(&TaskRunner::Run, this, std::move(wrapper))) {
-  waiting_.SetProvider(&worker_);
+      manual_wrapper_(is_manual ? wrapper : nullptr),
+      thread_id_(is_manual ? std::this_thread::get_id() : std::thread::id()),
+      has_new_work_(false),
+      wakeup_count_(0),
+      wakeup_start_ms_(clock->GetMonotonicTime()),
+      task_start_ms_(0),
+      has_idle_work_(true),
+      record_task_spans_(false),
+      long_task_threshold_us_(kDefaultLongTaskThresholdMs * 1000),
+      long_task_count_(0),
+      worker_(is_manual
+                  ? nullptr
+                  : new Thread(is_worker ? "JS Worker" : "JS Main Thread",
+                               std::bind(&TaskRunner::Run, this,
+                                         std::move(wrapper)),
+                               ThreadRole::JavaScript)) {
+  waiting_.SetProvider(worker_.get());
 }
 
 TaskRunner::~TaskRunner() {
@@ -58,15 +168,11 @@ TaskRunner::~TaskRunner() {
 
 bool TaskRunner::HasPendingWork() const {
   std::unique_lock<Mutex> lock(mutex_);
-  for (auto& task : tasks_) {
-    if (!task->loop)
-      return true;
-  }
-  return false;
+  return pending_count_ > 0;
 }
 
 bool TaskRunner::BelongsToCurrentThread() const {
-  return running_ && std::this_thread::get_id() == worker_.get_id();
+  return running_ && std::this_thread::get_id() == thread_id_.load();
 }
 
 void TaskRunner::Stop() {
@@ -77,93 +183,309 @@ void TaskRunner::Stop() {
       running_ = false;
       join = true;
       waiting_.SignalAllIfNotSet();
+      WakeWorker();
     }
   }
   if (join) {
-    worker_.join();
+    if (worker_) {
+      worker_->join();
+    } else {
+      DCHECK_EQ(std::this_thread::get_id(), thread_id_.load())
+          << "A manual TaskRunner must be stopped on its own thread";
+      manual_wrapper_([this]() { ClearTasks(); });
+    }
   }
 }
 
 void TaskRunner::WaitUntilFinished() {
+  if (!worker_ && BelongsToCurrentThread()) {
+    // Nothing else will run the tasks, so run them here.
+    while (running_ && HasPendingWork()) {
+      const uint64_t delay_ms =
+          RunUntilIdle(std::numeric_limits<uint64_t>::max());
+      if (HasPendingWork())
+        OnIdle(delay_ms);
+    }
+    return;
+  }
+
   if (running_ && HasPendingWork()) {
     std::unique_lock<Mutex> lock(mutex_);
-    waiting_.ResetAndWaitWhileUnlocked(lock);
+    // Check again with the lock held.  The worker doesn't poll, so if the work
+    // finished before we reset the event, it won't be signaled again.
+    if (pending_count_ > 0)
+      waiting_.ResetAndWaitWhileUnlocked(lock);
   }
 }
 
 void TaskRunner::CancelTimer(int id) {
   std::unique_lock<Mutex> lock(mutex_);
-  for (auto& task : tasks_) {
-    if (task->id == id) {
-      task->should_remove = true;
-      return;
-    }
+  auto it = timers_by_id_.find(id);
+  if (it != timers_by_id_.end()) {
+    // The timer will be removed from the heap once it reaches the top.
+    MarkRemoved(it->second);
+    // Wake the worker so it can signal WaitUntilFinished if this was the last
+    // pending task.
+    WakeWorker();
   }
 }
 
+void TaskRunner::SetTimerSlack(uint64_t slack_ms) {
+  std::unique_lock<Mutex> lock(mutex_);
+  timer_slack_ms_ = slack_ms;
+  // Wake the worker so it recalculates how long to wait for the next timer.
+  WakeWorker();
+}
+
+double TaskRunner::GetWakeupsPerSecond() {
+  std::unique_lock<Mutex> lock(mutex_);
+  const uint64_t now = clock_->GetMonotonicTime();
+  const uint64_t count = wakeup_count_.exchange(0);
+  const uint64_t elapsed_ms = now - wakeup_start_ms_;
+  wakeup_start_ms_ = now;
+  return elapsed_ms > 0 ? count * 1000.0 / elapsed_ms : 0;
+}
+
+JsManager::EventLoopStats TaskRunner::GetStats() const {
+  JsManager::EventLoopStats ret;
+  ret.timer_delay = Telemetry::Summarize(
+      queue_wait_[static_cast<size_t>(TaskPriority::Timer)]);
+  ret.internal_wait = Telemetry::Summarize(
+      queue_wait_[static_cast<size_t>(TaskPriority::Internal)]);
+  ret.event_wait = Telemetry::Summarize(
+      queue_wait_[static_cast<size_t>(TaskPriority::Events)]);
+  ret.immediate_wait = Telemetry::Summarize(
+      queue_wait_[static_cast<size_t>(TaskPriority::Immediate)]);
+  ret.task_duration = Telemetry::Summarize(task_duration_);
+
+  std::unique_lock<std::mutex> lock(stats_mutex_);
+  ret.long_task_count = long_task_count_;
+  ret.recent_long_tasks.assign(recent_long_tasks_.begin(),
+                               recent_long_tasks_.end());
+  ret.named_tasks.reserve(task_timings_.size());
+  for (auto& pair : task_timings_)
+    ret.named_tasks.emplace_back(pair.second);
+  std::sort(ret.named_tasks.begin(), ret.named_tasks.end(),
+            [](const JsManager::EventLoopStats::TaskTiming& a,
+               const JsManager::EventLoopStats::TaskTiming& b) {
+              return a.total_us > b.total_us;
+            });
+  return ret;
+}
+
+void TaskRunner::SetLongTaskThreshold(uint64_t threshold_ms) {
+  long_task_threshold_us_.store(threshold_ms * 1000,
+                                std::memory_order_relaxed);
+}
+
+bool TaskRunner::ShouldYield() const {
+  DCHECK(BelongsToCurrentThread());
+  const uint64_t now = clock_->GetMonotonicTime();
+  if (now - task_start_ms_ < kTimeSliceMs)
+    return false;
+
+  std::unique_lock<Mutex> lock(mutex_);
+  for (auto& queue : internal_tasks_) {
+    if (!queue.empty())
+      return true;
+  }
+  // The top of the heap is the first timer to fire; a canceled timer may
+  // cause an extra yield, which is harmless.
+  return !timers_.empty() && AlignedDeadline(*timers_.front()) <= now;
+}
+
+void TaskRunner::PostSlicedTask(TaskPriority priority,
+                                std::function<bool()> step) {
+  PostTask(priority, [this, priority, step]() {
+    while (step()) {
+      if (ShouldYield()) {
+        PostSlicedTask(priority, step);
+        return;
+      }
+    }
+  });
+}
+
 void TaskRunner::Run(std::function<void(RunLoop)> wrapper) {
+  thread_id_.store(std::this_thread::get_id());
   wrapper([this]() {
     while (running_) {
       // Handle a task.  This will only handle one task, then loop.
-      if (HandleTask())
+      uint64_t delay_ms;
+      if (HandleTask(&delay_ms))
         continue;
 
       if (!HasPendingWork()) {
         waiting_.SignalAllIfNotSet();
       }
 
-      // We don't have any work to do, wait for a while.
-      OnIdle();
+      // Use the time until the next task for idle work (e.g. GC), then check
+      // for new tasks again.
+      if (RunIdleHandler(delay_ms))
+        continue;
+
+      // We don't have any work to do, wait until the next timer or new work.
+      OnIdle(delay_ms);
     }
 
-    // If we stop early, delete any pending tasks.  This must be done on the
-    // worker thread so we can delete JavaScript objects.
-    tasks_.clear();
-    waiting_.SignalAllIfNotSet();
+    // If we stop early, delete any pending tasks.
+    ClearTasks();
+  });
+}
+
+uint64_t TaskRunner::RunUntilIdle(uint64_t deadline_ms) {
+  DCHECK(!worker_) << "Only a manual TaskRunner can be run by the app";
+  DCHECK(BelongsToCurrentThread());
+
+  uint64_t delay_ms = std::numeric_limits<uint64_t>::max();
+  manual_wrapper_([&]() {
+    while (running_ && HandleTask(&delay_ms)) {
+      if (clock_->GetMonotonicTime() >= deadline_ms) {
+        delay_ms = 0;
+        return;
+      }
+    }
   });
+
+  if (!HasPendingWork())
+    waiting_.SignalAllIfNotSet();
+  return delay_ms;
+}
+
+void TaskRunner::RecordTaskDuration(const impl::PendingTaskBase& task,
+                                    uint64_t duration_us) {
+  task_duration_.Add(duration_us);
+  const bool is_long =
+      duration_us >= long_task_threshold_us_.load(std::memory_order_relaxed);
+  std::string name = task.name();
+  if (name.empty() && !is_long)
+    return;
+
+  std::unique_lock<std::mutex> lock(stats_mutex_);
+  if (!name.empty() && (task_timings_.size() < kMaxTaskNames ||
+                        task_timings_.count(name) > 0)) {
+    auto& timing = task_timings_[name];
+    timing.name = name;
+    timing.count++;
+    timing.total_us += duration_us;
+    timing.max_us = std::max(timing.max_us, duration_us);
+  }
+  if (is_long) {
+    if (name.empty())
+      name = GetUnnamedTaskName(task.priority);
+    VLOG(1) << "Long task on " << (is_worker_ ? "worker" : "main")
+            << " thread: " << name << " ran for " << duration_us << "us";
+    long_task_count_++;
+    if (recent_long_tasks_.size() >= kMaxRecentLongTasks)
+      recent_long_tasks_.pop_front();
+    JsManager::EventLoopStats::LongTask long_task;
+    long_task.name = std::move(name);
+    long_task.duration_us = duration_us;
+    recent_long_tasks_.push_back(std::move(long_task));
+  }
 }
 
-void TaskRunner::OnIdle() {
-  // TODO: Since we have no work, we will never add work ourselves.  Consider
-  // using signalling rather than polling.
-  clock_->SleepSeconds(0.001);
+void TaskRunner::ClearTasks() {
+  {
+    std::unique_lock<Mutex> lock(mutex_);
+    for (auto& queue : internal_tasks_)
+      queue.clear();
+    timers_.clear();
+    timers_by_id_.clear();
+    pending_count_ = 0;
+  }
+  waiting_.SignalAllIfNotSet();
+}
+
+void TaskRunner::SetRecordTaskSpans(bool enabled) {
+  DCHECK(BelongsToCurrentThread());
+  record_task_spans_ = enabled;
+}
+
+std::vector<TaskRunner::TaskSpan> TaskRunner::TakeTaskSpans() {
+  DCHECK(BelongsToCurrentThread());
+  std::vector<TaskSpan> ret;
+  ret.swap(task_spans_);
+  return ret;
+}
+
+void TaskRunner::SetIdleHandler(std::function<bool(uint64_t)> handler) {
+  DCHECK(BelongsToCurrentThread());
+  idle_handler_ = std::move(handler);
+  has_idle_work_ = true;
+}
+
+bool TaskRunner::RunIdleHandler(uint64_t delay_ms) {
+  if (!idle_handler_ || !has_idle_work_ || delay_ms < kMinIdleMs)
+    return false;
+  {
+    // Don't start if a task was added since the queues were checked.
+    std::unique_lock<std::mutex> lock(idle_mutex_);
+    if (has_new_work_)
+      return false;
+  }
+
+  TRACE_EVENT("js", "Idle work");
+  has_idle_work_ = idle_handler_(std::min(delay_ms, kMaxIdleMs));
+  return true;
 }
 
-bool TaskRunner::HandleTask() {
+void TaskRunner::OnIdle(uint64_t delay_ms) {
+  std::unique_lock<std::mutex> lock(idle_mutex_);
+  // If work was added after we checked the queues, we will have been signaled
+  // already, so don't wait.  Spurious wakeups are fine since the caller will
+  // check the queues again.
+  if (!has_new_work_ && running_) {
+    if (delay_ms == std::numeric_limits<uint64_t>::max())
+      idle_cond_.wait(lock);
+    else
+      clock_->WaitForSignal(&idle_cond_, &lock, delay_ms / 1000.0);
+  }
+  has_new_work_ = false;
+  wakeup_count_++;
+  Telemetry::OnWakeup();
+}
+
+void TaskRunner::WakeWorker() {
+  std::unique_lock<std::mutex> lock(idle_mutex_);
+  has_new_work_ = true;
+  idle_cond_.notify_one();
+}
+
+bool TaskRunner::HandleTask(uint64_t* delay_ms) {
   // We need to be careful here because:
   // 1) We may be called from another thread to change tasks.
   // 2) The callback may change tasks (including its own).
+  //
+  // The task is removed from the queues while it is running, but timers stay
+  // in |timers_by_id_| so they can still be canceled by the callback.
 
   const uint64_t now = clock_->GetMonotonicTime();
-  impl::PendingTaskBase* task = nullptr;
+  impl::TaskPtr task;
+  uint64_t ready_ms = now;
   {
-    // Find the earliest timer we can finish.  If there are multiple with the
-    // same time, pick the one registered earlier (lower ID).
     std::unique_lock<Mutex> lock(mutex_);
-    uint64_t min_time = std::numeric_limits<uint64_t>::max();
-    TaskPriority max_priority = TaskPriority::Timer;
-    for (auto it = tasks_.begin(); it != tasks_.end();) {
-      if ((*it)->should_remove) {
-        it = tasks_.erase(it);
-      } else {
-        if ((*it)->priority > max_priority) {
-          max_priority = (*it)->priority;
-          task = it->get();
-        } else if (max_priority == TaskPriority::Timer) {
-          const uint64_t it_time = (*it)->start_ms + (*it)->delay_ms;
-          if (it_time <= now && it_time < min_time) {
-            min_time = it_time;
-            task = it->get();
-          }
-        }
-        ++it;
-      }
+    task = PopReadyTask(now, delay_ms);
+    // Timers are deliberately delayed to align them, so measure from when
+    // they were due to fire.
+    if (task) {
+      ready_ms = task->priority == TaskPriority::Timer
+                     ? AlignedDeadline(*task)
+                     : task->deadline_ms();
     }
   }
 
   if (!task)
     return false;
+  const uint64_t queued_ms = now - std::min(now, ready_ms);
+  queue_wait_[static_cast<size_t>(task->priority)].Add(queued_ms * 1000);
+  if (task->priority != TaskPriority::Timer)
+    Telemetry::OnQueueLatency(queued_ms * 1000);
 
+  task_start_ms_ = now;
+  const uint64_t start_us = DurationHistogram::Now();
+
+  TRACE_EVENT("js", "Run task");
 #ifdef USING_V8
   if (!is_worker_) {
     // V8 attaches v8::Local<T> instances to the most recent v8::HandleScope
@@ -179,14 +501,102 @@ bool TaskRunner::HandleTask() {
   task->Call();
   (void)is_worker_;
 #endif
+  const uint64_t end_us = DurationHistogram::Now();
+  RecordTaskDuration(*task, end_us - start_us);
+  if (record_task_spans_ && task_spans_.size() < kMaxTaskSpans) {
+    std::string name = task->name();
+    if (name.empty())
+      name = GetUnnamedTaskName(task->priority);
+    task_spans_.push_back({std::move(name), start_us, end_us});
+  }
+  // The task may have created garbage, so there may be idle work again.
+  has_idle_work_ = true;
 
-  if (task->loop) {
-    task->start_ms = now;
-  } else {
-    task->should_remove = true;
-    // Will be removed in the next iteration.
+  {
+    std::unique_lock<Mutex> lock(mutex_);
+    if (task->loop && !task->should_remove) {
+      task->start_ms = now;
+      timers_.push_back(std::move(task));
+      std::push_heap(timers_.begin(), timers_.end(), TimerCompare());
+    } else {
+      MarkRemoved(task.get());
+      if (task->priority == TaskPriority::Timer)
+        timers_by_id_.erase(task->id);
+    }
   }
+  // If the task wasn't re-added, it is destroyed here, outside the lock.
   return true;
 }
 
+impl::TaskPtr TaskRunner::PopReadyTask(uint64_t now, uint64_t* delay_ms) {
+  *delay_ms = std::numeric_limits<uint64_t>::max();
+  // Higher priority tasks run first; within a priority, tasks run in the order
+  // they were registered.
+  for (size_t i = kInternalPriorityCount; i > 0; i--) {
+    auto& queue = internal_tasks_[i - 1];
+    if (!queue.empty()) {
+      impl::TaskPtr ret = std::move(queue.front());
+      queue.pop_front();
+      return ret;
+    }
+  }
+
+  // Find the earliest timer we can finish.  If there are multiple with the
+  // same time, pick the one registered earlier (lower ID).
+  while (!timers_.empty()) {
+    std::pop_heap(timers_.begin(), timers_.end(), TimerCompare());
+    if (timers_.back()->should_remove) {
+      timers_by_id_.erase(timers_.back()->id);
+      timers_.pop_back();
+      continue;
+    }
+    // Aligning doesn't change the order of timers, so the top of the heap is
+    // still the first to fire.
+    const uint64_t deadline = AlignedDeadline(*timers_.back());
+    if (deadline > now) {
+      *delay_ms = deadline - now;
+      std::push_heap(timers_.begin(), timers_.end(), TimerCompare());
+      break;
+    }
+
+    impl::TaskPtr ret = std::move(timers_.back());
+    timers_.pop_back();
+    return ret;
+  }
+  return nullptr;
+}
+
+uint64_t TaskRunner::AlignedDeadline(const impl::PendingTaskBase& task) const {
+  const uint64_t deadline = task.deadline_ms();
+  if (timer_slack_ms_ == 0)
+    return deadline;
+  // Round up so timers never fire early.
+  return (deadline + timer_slack_ms_ - 1) / timer_slack_ms_ * timer_slack_ms_;
+}
+
+void TaskRunner::PushInternalTask(impl::TaskPtr task) {
+  DCHECK(task->priority != TaskPriority::Timer);
+  const size_t index = static_cast<size_t>(task->priority) - 1;
+  pending_count_++;
+  internal_tasks_[index].emplace_back(std::move(task));
+  WakeWorker();
+}
+
+void TaskRunner::PushTimer(impl::TaskPtr task) {
+  DCHECK(task->priority == TaskPriority::Timer);
+  if (!task->loop)
+    pending_count_++;
+  timers_by_id_.emplace(task->id, task.get());
+  timers_.emplace_back(std::move(task));
+  std::push_heap(timers_.begin(), timers_.end(), TimerCompare());
+  WakeWorker();
+}
+
+void TaskRunner::MarkRemoved(impl::PendingTaskBase* task) {
+  if (!task->should_remove.exchange(true) && !task->loop) {
+    DCHECK_GT(pending_count_, 0u);
+    pending_count_--;
+  }
+}
+
 }  // namespace shaka
@@ -18,14 +18,23 @@
 #include <glog/logging.h>
 
 #include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
 #include <functional>
-#include <list>
 #include <memory>
+#include <mutex>
+#include <new>
 #include <string>
+#include <thread>
 #include <type_traits>
+#include <unordered_map>
 #include <utility>
+#include <vector>
 
+#include "shaka/js_manager.h"
 #include "src/core/ref_ptr.h"
+#include "src/debug/duration_histogram.h"
 #include "src/debug/mutex.h"
 #include "src/debug/thread.h"
 #include "src/debug/thread_event.h"
@@ -46,6 +55,8 @@ namespace impl {
 template <typename Func>
 using RetOf = typename std::result_of<Func()>::type;
 
+class TaskPool;
+
 /** Defines a base class for a pending task. */
 class PendingTaskBase {
  public:
@@ -56,6 +67,19 @@ class PendingTaskBase {
   /** Performs the task. */
   virtual void Call() = 0;
 
+  /** @return The name of the task, or an empty string if it has none. */
+  virtual std::string name() const;
+
+  /** @return The monotonic time this task should run at. */
+  uint64_t deadline_ms() const {
+    return start_ms + delay_ms;
+  }
+
+  // The pool this was allocated from and the size of the allocation; these are
+  // set by TaskPool::New.
+  TaskPool* pool;
+  size_t alloc_size;
+
   uint64_t start_ms;
   const uint64_t delay_ms;
   const TaskPriority priority;
@@ -106,6 +130,10 @@ class PendingTask : public PendingTaskBase {
     SetHelper<Func, Ret>::Set(&callback, &event);
   }
 
+  std::string name() const override {
+    return event->name();
+  }
+
   typename std::decay<Func>::type callback;
   std::shared_ptr<ThreadEvent<Ret>> event;
 
@@ -127,6 +155,90 @@ class PendingTask : public PendingTaskBase {
   };
 };
 
+/**
+ * A pending task that doesn't report its result.  This avoids allocating a
+ * ThreadEvent, so it is used for timers and for TaskRunner::PostTask.
+ */
+template <typename Func>
+class PendingCall : public PendingTaskBase {
+ public:
+  static_assert(!std::is_base_of<memory::Traceable,
+                                typename std::decay<Func>::type>::value,
+                "Cannot pass Traceable objects to TaskRunner");
+
+  PendingCall(const util::Clock* clock, Func&& callback, TaskPriority priority,
+              uint64_t delay_ms, int id, bool loop)
+      : PendingTaskBase(clock, priority, delay_ms, id, loop),
+        callback(std::forward<Func>(callback)) {}
+
+  void Call() override {
+    callback();
+  }
+
+  typename std::decay<Func>::type callback;
+};
+
+/** Destroys a task and returns its memory to the pool it came from. */
+struct TaskDeleter {
+  void operator()(PendingTaskBase* task) const;
+};
+
+using TaskPtr = std::unique_ptr<PendingTaskBase, TaskDeleter>;
+
+/**
+ * A free-list of memory blocks for pending tasks.  Most tasks hold a small
+ * callback, so they fit in a block and posting one reuses the memory of a
+ * task that already finished instead of allocating.  Larger tasks are
+ * allocated normally.
+ *
+ * This type is thread-safe.
+ */
+class TaskPool {
+ public:
+  /** The size of a pooled block; larger tasks use the heap directly. */
+  static constexpr const size_t kBlockSize = 128;
+  /** The maximum number of unused blocks to keep. */
+  static constexpr const size_t kMaxFreeBlocks = 64;
+
+  TaskPool();
+  ~TaskPool();
+
+  /** Creates a new task of type T using memory from this pool. */
+  template <typename T, typename... Args>
+  TaskPtr New(Args&&... args) {
+    static_assert(alignof(T) <= alignof(std::max_align_t),
+                  "Task type is over-aligned");
+    void* memory = Allocate(sizeof(T));
+    T* ret = new (memory) T(std::forward<Args>(args)...);
+    ret->pool = this;
+    ret->alloc_size = sizeof(T);
+    return TaskPtr(ret);
+  }
+
+  /**
+   * @return The number of times memory was allocated from the heap, used to
+   *   measure how well the blocks are reused.
+   */
+  size_t heap_allocation_count() const {
+    return heap_allocation_count_;
+  }
+
+ private:
+  friend struct TaskDeleter;
+
+  TaskPool(const TaskPool&) = delete;
+  TaskPool& operator=(const TaskPool&) = delete;
+
+  void* Allocate(size_t size);
+  void Free(void* memory, size_t size);
+
+  // This uses a plain mutex since it is only held briefly and can be used
+  // while holding the TaskRunner's mutex.
+  std::mutex mutex_;
+  std::vector<void*> free_blocks_;
+  std::atomic<size_t> heap_allocation_count_;
+};
+
 template <typename T>
 struct FutureResolver {
   template <typename Func>
@@ -150,13 +262,29 @@ struct FutureResolver<void> {
  * Schedules and manages tasks to be run on a worker thread.  This manages a
  * background thread to run the tasks.  It is safe to call all these methods
  * from any thread.
+ *
+ * A manual TaskRunner doesn't create a thread; instead the thread that creates
+ * it runs the tasks by calling RunUntilIdle, e.g. once per frame of the app's
+ * own run loop.  That thread is the "worker thread" for the other methods.
  */
 class TaskRunner {
  public:
   using RunLoop = std::function<void()>;
 
+  /**
+   * Creates a new TaskRunner.
+   *
+   * @param wrapper A callback that is called on the worker thread with a
+   *   callback that runs the tasks.  For a manual TaskRunner, this is called
+   *   for each call to RunUntilIdle (and Stop), so it shouldn't do expensive
+   *   setup.
+   * @param clock The clock used for timers.
+   * @param is_worker Whether this is a worker that can't run JavaScript.
+   * @param is_manual Whether the tasks are run by calls to RunUntilIdle
+   *   instead of a background thread.
+   */
   TaskRunner(std::function<void(RunLoop)> wrapper, const util::Clock* clock,
-             bool is_worker);
+             bool is_worker, bool is_manual = false);
   ~TaskRunner();
 
   /** @return Whether the background thread is running. */
@@ -177,9 +305,26 @@ class TaskRunner {
    */
   void Stop();
 
-  /** Blocks the calling thread until the worker has no more work to do. */
+  /**
+   * Blocks the calling thread until the worker has no more work to do.  For a
+   * manual TaskRunner, if this is called on its thread, this runs the tasks
+   * itself until there are none left.
+   */
   void WaitUntilFinished();
 
+  /**
+   * Runs the tasks that are ready until there are none left or until the
+   * given deadline.  This can only be called on the thread that created a
+   * manual TaskRunner.
+   *
+   * @param deadline_ms The monotonic time, in milliseconds, to stop at.  The
+   *   task that is running at that time is allowed to finish.
+   * @return The time, in milliseconds, until the next timer is ready; 0 if
+   *   this stopped because of the deadline; or the max value if nothing is
+   *   scheduled.
+   */
+  uint64_t RunUntilIdle(uint64_t deadline_ms);
+
 
   /**
    * If called from the thread this manages, the given callback is invoked
@@ -222,13 +367,43 @@ class TaskRunner {
 
     std::unique_lock<Mutex> lock(mutex_);
     const int id = ++next_id_;
-    auto pending_task =
-        new impl::PendingTask<Func>(clock_, std::forward<Func>(callback), name,
-                                    priority, 0, id, /* loop */ false);
-    tasks_.emplace_back(pending_task);
-    pending_task->event->SetProvider(&worker_);
+    impl::TaskPtr pending_task = pool_.New<impl::PendingTask<Func>>(
+        clock_, std::forward<Func>(callback), name, priority, 0, id,
+        /* loop */ false);
+    auto event =
+        static_cast<impl::PendingTask<Func>*>(pending_task.get())->event;
+    event->SetProvider(worker_.get());
+    PushInternalTask(std::move(pending_task));
+
+    return event;
+  }
 
-    return pending_task->event;
+  /**
+   * Registers an internal task to be called on the worker thread, without a
+   * way to wait for it or get its result.  This is cheaper than
+   * AddInternalTask since it doesn't allocate a ThreadEvent, so this should be
+   * used for callbacks that are posted often (e.g. from the media threads).
+   *
+   * @param priority The priority of the task.
+   * @param callback The callback object.
+   */
+  template <typename Func>
+  void PostTask(TaskPriority priority, Func&& callback) {
+    DCHECK(priority != TaskPriority::Timer) << "Use AddTimer for timers";
+
+    std::unique_lock<Mutex> lock(mutex_);
+    const int id = ++next_id_;
+    PushInternalTask(pool_.New<impl::PendingCall<Func>>(
+        clock_, std::forward<Func>(callback), priority, 0, id,
+        /* loop */ false));
+  }
+
+  /**
+   * @return The number of times memory for tasks was allocated from the heap.
+   *   This is used for testing.
+   */
+  size_t task_allocation_count() const {
+    return pool_.heap_allocation_count();
   }
 
   /**
@@ -244,10 +419,9 @@ class TaskRunner {
     std::unique_lock<Mutex> lock(mutex_);
     const int id = ++next_id_;
 
-    tasks_.emplace_back(
-        new impl::PendingTask<Func>(clock_, std::forward<Func>(callback), "",
-                                    TaskPriority::Timer, delay_ms, id,
-                                    /* loop= */ false));
+    PushTimer(pool_.New<impl::PendingCall<Func>>(
+        clock_, std::forward<Func>(callback), TaskPriority::Timer, delay_ms, id,
+        /* loop= */ false));
 
     return id;
   }
@@ -268,10 +442,9 @@ class TaskRunner {
     std::unique_lock<Mutex> lock(mutex_);
     const int id = ++next_id_;
 
-    tasks_.emplace_back(
-        new impl::PendingTask<Func>(clock_, std::forward<Func>(callback), "",
-                                    TaskPriority::Timer, delay_ms, id,
-                                    /* loop= */ true));
+    PushTimer(pool_.New<impl::PendingCall<Func>>(
+        clock_, std::forward<Func>(callback), TaskPriority::Timer, delay_ms, id,
+        /* loop= */ true));
 
     return id;
   }
@@ -279,6 +452,92 @@ class TaskRunner {
   /** Cancels a pending timer with the given ID. */
   void CancelTimer(int id);
 
+  /**
+   * Sets the granularity that timers are aligned to.  When this is non-zero,
+   * timers will be delayed until the next multiple of |slack_ms| on the
+   * monotonic clock so that timers that are close together fire on the same
+   * wakeup.  This doesn't affect internal tasks.
+   *
+   * @param slack_ms The granularity, in milliseconds, or 0 to disable.
+   */
+  void SetTimerSlack(uint64_t slack_ms);
+
+  /**
+   * Gets the average number of times per second the worker thread woke up
+   * from being idle.  This is measured since the last call to this method (or
+   * since the TaskRunner was created).  This is used for debugging.
+   */
+  double GetWakeupsPerSecond();
+
+  /** @return How long the tasks have run and waited to run. */
+  JsManager::EventLoopStats GetStats() const;
+
+  /**
+   * Sets the time, in milliseconds, that a task must run for to be counted as
+   * a long task.
+   */
+  void SetLongTaskThreshold(uint64_t threshold_ms);
+
+  /** When a task ran; used to add the task names to CPU profiles. */
+  struct TaskSpan {
+    std::string name;
+    /** The times, in microseconds, from DurationHistogram::Now. */
+    uint64_t start_us;
+    uint64_t end_us;
+  };
+
+  /**
+   * Sets whether to record when each task runs (see TakeTaskSpans).  This
+   * must be called on the worker thread.
+   */
+  void SetRecordTaskSpans(bool enabled);
+
+  /**
+   * Gets the tasks that ran while recording, oldest first, and clears them.
+   * This must be called on the worker thread.
+   */
+  std::vector<TaskSpan> TakeTaskSpans();
+
+  /**
+   * Sets a callback that is called on the worker thread when it is about to
+   * wait for at least kMinIdleMs for the next task.  This is used to do
+   * garbage collection between tasks instead of during them.  This must be
+   * called on the worker thread.  A manual TaskRunner doesn't call this since
+   * the app decides how long it is idle.
+   *
+   * @param handler The callback to call.  This is given the time, in
+   *   milliseconds, it can use and returns whether it has more work to do;
+   *   once it returns false, it isn't called again until another task runs.
+   */
+  void SetIdleHandler(std::function<bool(uint64_t)> handler);
+
+  /** The minimum idle time, in milliseconds, to call the idle handler for. */
+  static constexpr const uint64_t kMinIdleMs = 10;
+  /** The maximum time, in milliseconds, to give the idle handler at once. */
+  static constexpr const uint64_t kMaxIdleMs = 50;
+
+  /**
+   * Called by a task that does a lot of work, between steps of that work.
+   * This must be called on the worker thread.
+   *
+   * @return Whether the current task has run for longer than a time slice
+   *   while other tasks are ready; if so, the task should post the rest of
+   *   its work as a new task and return.
+   */
+  bool ShouldYield() const;
+
+  /**
+   * Posts a task that does its work in steps, yielding to other tasks between
+   * steps when it runs for too long (see ShouldYield).  The remaining steps
+   * are posted again with the same priority, so they run after the tasks
+   * that were waiting.
+   *
+   * @param priority The priority of the task.
+   * @param step Called to perform one step of the work; returns whether there
+   *   is more work to do.
+   */
+  void PostSlicedTask(TaskPriority priority, std::function<bool()> step);
+
  private:
   TaskRunner(const TaskRunner&) = delete;
   TaskRunner(TaskRunner&&) = delete;
@@ -292,20 +551,103 @@ class TaskRunner {
   void Run(std::function<void(RunLoop)> wrapper);
 
   /**
-   * Called when there is no work to be done.  This should yield to other
-   * threads and/or wait until more work is scheduled.
+   * Records the time the given task ran for.  This must be called on the
+   * worker thread.
+   */
+  void RecordTaskDuration(const impl::PendingTaskBase& task,
+                          uint64_t duration_us);
+
+  /**
+   * Deletes all the pending tasks once stopped.  This must be called on the
+   * worker thread so it can delete JavaScript objects.
+   */
+  void ClearTasks();
+
+  /**
+   * Called when there is no work to be done.  This blocks until new work is
+   * scheduled or until the given delay passes.
+   *
+   * @param delay_ms The time until the next timer is ready, or the max value if
+   *   there are no timers.
+   */
+  void OnIdle(uint64_t delay_ms);
+
+  /**
+   * Calls the idle handler if there is enough time before the next task.
+   * This must be called on the worker thread.
+   *
+   * @param delay_ms The time until the next timer is ready, or the max value
+   *   if there are no timers.
+   * @return Whether the idle handler was called.
    */
-  void OnIdle();
+  bool RunIdleHandler(uint64_t delay_ms);
+
+  /** Wakes up the worker thread if it is waiting in OnIdle. */
+  void WakeWorker();
 
   /**
    * Pops a task from the queue and handles it.
+   * @param delay_ms [OUT] If there are no tasks ready, will contain the time
+   *   until the next timer is ready, or the max value if there are no timers.
    * @return True if there were any task in the queue, false otherwise.
    */
-  bool HandleTask();
+  bool HandleTask(uint64_t* delay_ms);
+
+  /**
+   * Removes the next task that should be run from the queues.  This must be
+   * called with |mutex_| held.
+   * @param delay_ms [OUT] If there are no tasks ready, will contain the time
+   *   until the next timer is ready, or the max value if there are no timers.
+   * @return The task to run, or nullptr if there is nothing ready to run.
+   */
+  impl::TaskPtr PopReadyTask(uint64_t now, uint64_t* delay_ms);
+
+  /**
+   * @return The time the given timer should fire at, after applying the timer
+   *   slack.  This must be called with |mutex_| held.
+   */
+  uint64_t AlignedDeadline(const impl::PendingTaskBase& task) const;
 
+  /** Adds a new internal task.  This must be called with |mutex_| held. */
+  void PushInternalTask(impl::TaskPtr task);
 
-  // TODO: Consider a different data structure.
-  std::list<std::unique_ptr<impl::PendingTaskBase>> tasks_;
+  /** Adds a new or repeating timer.  This must be called with |mutex_| held. */
+  void PushTimer(impl::TaskPtr task);
+
+  /**
+   * Marks the given task as complete so it is no longer counted as pending
+   * work.  This must be called with |mutex_| held.
+   */
+  void MarkRemoved(impl::PendingTaskBase* task);
+
+  /** Orders |timers_| as a min-heap on the deadline, then on the ID. */
+  struct TimerCompare {
+    bool operator()(const impl::TaskPtr& a, const impl::TaskPtr& b) const {
+      const uint64_t a_time = a->deadline_ms();
+      const uint64_t b_time = b->deadline_ms();
+      return a_time != b_time ? a_time > b_time : a->id > b->id;
+    }
+  };
+
+  static constexpr const size_t kInternalPriorityCount =
+      static_cast<size_t>(TaskPriority::Immediate);
+
+  // This must be destroyed after the tasks below.
+  impl::TaskPool pool_;
+
+  // One FIFO queue for each non-timer priority; index 0 is
+  // TaskPriority::Internal.
+  std::deque<impl::TaskPtr> internal_tasks_[kInternalPriorityCount];
+  // A min-heap of pending timers.  Canceled timers stay in the heap until they
+  // reach the top so canceling doesn't need to re-order the heap.
+  std::vector<impl::TaskPtr> timers_;
+  // Every timer that hasn't been removed yet, including one that is currently
+  // running; used to cancel timers.
+  std::unordered_map<int, impl::PendingTaskBase*> timers_by_id_;
+  // The number of non-repeating tasks that haven't finished or been canceled.
+  size_t pending_count_;
+  // The granularity to align timers to, in milliseconds; 0 means no alignment.
+  uint64_t timer_slack_ms_;
 
   mutable Mutex mutex_;
   const util::Clock* clock_;
@@ -313,8 +655,42 @@ class TaskRunner {
   std::atomic<bool> running_;
   int next_id_;
   bool is_worker_;
-
-  Thread worker_;
+  // For a manual TaskRunner, the wrapper passed in; otherwise this is unused.
+  const std::function<void(RunLoop)> manual_wrapper_;
+  // The thread that runs the tasks.  The worker thread sets this itself when
+  // it starts, so it is correct even before |worker_| is assigned.
+  std::atomic<std::thread::id> thread_id_;
+
+  // Used to wake up the worker thread when new work is added.  These use a
+  // plain std::mutex since they are used with a std::condition_variable.
+  std::mutex idle_mutex_;
+  std::condition_variable idle_cond_;
+  bool has_new_work_;
+
+  std::atomic<uint64_t> wakeup_count_;
+  uint64_t wakeup_start_ms_;
+
+  // The time the current task started; only used on the worker thread.
+  uint64_t task_start_ms_;
+  // These are only used on the worker thread.
+  std::function<bool(uint64_t)> idle_handler_;
+  bool has_idle_work_;
+  bool record_task_spans_;
+  std::vector<TaskSpan> task_spans_;
+  // How long tasks waited to run, indexed by TaskPriority.
+  DurationHistogram queue_wait_[kInternalPriorityCount + 1];
+  DurationHistogram task_duration_;
+  std::atomic<uint64_t> long_task_threshold_us_;
+  // These are only used while holding |stats_mutex_|, which is separate from
+  // |mutex_| so reading the stats doesn't block posting tasks.
+  mutable std::mutex stats_mutex_;
+  uint64_t long_task_count_;
+  std::deque<JsManager::EventLoopStats::LongTask> recent_long_tasks_;
+  std::unordered_map<std::string, JsManager::EventLoopStats::TaskTiming>
+      task_timings_;
+
+  // This is null for a manual TaskRunner.
+  const std::unique_ptr<Thread> worker_;
 };
 
 }  // namespace shaka
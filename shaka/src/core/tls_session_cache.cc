@@ -0,0 +1,198 @@
+// Copyright 2020 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     https://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "src/core/tls_session_cache.h"
+
+#include <glog/logging.h>
+#include <stdlib.h>
+#include <time.h>
+
+#include <sstream>
+#include <utility>
+
+#include "src/util/file_system.h"
+#include "src/util/utils.h"
+
+namespace shaka {
+
+namespace {
+
+/** The first line of the file; this changes if the format changes. */
+constexpr const char* kFileHeader = "shaka-tls-sessions 1";
+
+uint64_t Now() {
+  return static_cast<uint64_t>(time(nullptr));
+}
+
+int FromHexDigit(char c) {
+  if (c >= '0' && c <= '9')
+    return c - '0';
+  if (c >= 'A' && c <= 'F')
+    return c - 'A' + 10;
+  return -1;
+}
+
+bool FromHexString(const std::string& hex, std::vector<uint8_t>* data) {
+  if (hex.size() % 2 != 0)
+    return false;
+  data->resize(hex.size() / 2);
+  for (size_t i = 0; i < data->size(); i++) {
+    const int high = FromHexDigit(hex[i * 2]);
+    const int low = FromHexDigit(hex[i * 2 + 1]);
+    if (high < 0 || low < 0)
+      return false;
+    (*data)[i] = static_cast<uint8_t>((high << 4) | low);
+  }
+  return true;
+}
+
+}  // namespace
+
+constexpr const size_t TlsSessionCache::kMaxEntries;
+
+TlsSessionCache::TlsSessionCache()
+    : mutex_("TlsSessionCache"), persistent_(false), checked_file_(false) {}
+
+TlsSessionCache::~TlsSessionCache() {}
+
+void TlsSessionCache::SetFile(const std::string& path) {
+  std::unique_lock<Mutex> lock(mutex_);
+  path_ = path;
+  checked_file_ = false;
+  if (persistent_)
+    Load();
+}
+
+void TlsSessionCache::SetPersistent(bool persistent) {
+  std::unique_lock<Mutex> lock(mutex_);
+  if (persistent == persistent_)
+    return;
+  persistent_ = persistent;
+  if (persistent) {
+    Load();
+    Save();
+  } else {
+    DeleteFile();
+  }
+}
+
+bool TlsSessionCache::Get(const std::string& host,
+                          std::vector<uint8_t>* session) const {
+  std::unique_lock<Mutex> lock(mutex_);
+  auto it = entries_.find(host);
+  if (it == entries_.end() || it->second.expiration <= Now())
+    return false;
+  *session = it->second.session;
+  return true;
+}
+
+void TlsSessionCache::Put(const std::string& host,
+                          const std::vector<uint8_t>& session,
+                          uint64_t expiration) {
+  const uint64_t now = Now();
+  if (host.empty() || session.empty() || expiration <= now ||
+      host.find_first_of("\t\n") != std::string::npos) {
+    return;
+  }
+
+  std::unique_lock<Mutex> lock(mutex_);
+  // Make room by dropping expired sessions, then the one that expires first.
+  if (entries_.size() >= kMaxEntries && entries_.count(host) == 0) {
+    auto oldest = entries_.begin();
+    for (auto it = entries_.begin(); it != entries_.end();) {
+      if (it->second.expiration <= now) {
+        it = entries_.erase(it);
+        oldest = entries_.begin();
+      } else {
+        if (it->second.expiration < oldest->second.expiration)
+          oldest = it;
+        it++;
+      }
+    }
+    if (entries_.size() >= kMaxEntries)
+      entries_.erase(oldest);
+  }
+  entries_[host] = {session, expiration};
+  if (persistent_) {
+    Save();
+  } else if (!checked_file_) {
+    // Delete sessions stored while persistence was enabled.  This waits for a
+    // new session so the app can enable persistence after setting the file.
+    DeleteFile();
+    checked_file_ = true;
+  }
+}
+
+void TlsSessionCache::Load() {
+  util::FileSystem fs;
+  std::vector<uint8_t> data;
+  if (path_.empty() || !fs.FileExists(path_) || !fs.ReadFile(path_, &data))
+    return;
+
+  // After the header, each line is the expiration, a tab, the host, a tab,
+  // and the session in hex.
+  std::stringstream stream(std::string(data.begin(), data.end()));
+  std::string line;
+  if (!std::getline(stream, line) || line != kFileHeader) {
+    VLOG(1) << "Ignoring TLS session cache in an unknown format";
+    return;
+  }
+  const uint64_t now = Now();
+  while (std::getline(stream, line) && entries_.size() < kMaxEntries) {
+    const size_t host_start = line.find('\t');
+    const size_t session_start = line.find('\t', host_start + 1);
+    if (host_start == std::string::npos || session_start == std::string::npos)
+      continue;
+
+    Entry entry;
+    entry.expiration = strtoull(line.c_str(), nullptr, 10);
+    if (entry.expiration <= now ||
+        !FromHexString(line.substr(session_start + 1), &entry.session)) {
+      continue;
+    }
+    // Sessions from this run are newer than the stored ones.
+    entries_.emplace(
+        line.substr(host_start + 1, session_start - host_start - 1),
+        std::move(entry));
+  }
+  VLOG(1) << "Loaded " << entries_.size() << " TLS sessions";
+}
+
+void TlsSessionCache::Save() const {
+  if (path_.empty())
+    return;
+
+  std::string data = std::string(kFileHeader) + "\n";
+  for (auto& entry : entries_) {
+    data += std::to_string(entry.second.expiration) + "\t" + entry.first +
+            "\t" +
+            util::ToHexString(entry.second.session.data(),
+                              entry.second.session.size()) +
+            "\n";
+  }
+
+  util::FileSystem fs;
+  if (!fs.WritePrivateFile(path_,
+                           std::vector<uint8_t>(data.begin(), data.end()))) {
+    LOG(WARNING) << "Unable to write TLS session cache";
+  }
+}
+
+void TlsSessionCache::DeleteFile() const {
+  util::FileSystem fs;
+  if (!path_.empty() && fs.FileExists(path_) && !fs.DeleteFile(path_))
+    LOG(WARNING) << "Unable to delete TLS session cache";
+}
+
+}  // namespace shaka
@@ -0,0 +1,112 @@
+// Copyright 2020 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     https://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef SHAKA_EMBEDDED_CORE_TLS_SESSION_CACHE_H_
+#define SHAKA_EMBEDDED_CORE_TLS_SESSION_CACHE_H_
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "src/debug/mutex.h"
+#include "src/util/macros.h"
+
+typedef void CURL;
+
+namespace shaka {
+
+/**
+ * Stores the TLS sessions of network requests, keyed by host.  When persistence
+ * is enabled, they are also stored in a file so the first connection to each
+ * host after the app restarts can resume the session instead of doing a full
+ * handshake.  CURL already reuses sessions within a run; this only covers the
+ * first connection.
+ *
+ * The sessions hold the keys needed to resume them and the file isn't
+ * encrypted, so persistence is off by default (see
+ * JsManager::NetworkOptions::persist_tls_sessions).  The file is only readable
+ * by the app, entries are dropped once the server's lifetime for them has
+ * passed, and the file is deleted when persistence is off.  This is only
+ * supported when CURL uses OpenSSL (or BoringSSL); with other TLS libraries
+ * Apply does nothing.
+ *
+ * This type is thread-safe.
+ */
+class TlsSessionCache final {
+ public:
+  /** The maximum number of hosts to keep sessions for. */
+  static constexpr const size_t kMaxEntries = 32;
+
+  TlsSessionCache();
+  ~TlsSessionCache();
+
+  SHAKA_NON_COPYABLE_OR_MOVABLE_TYPE(TlsSessionCache);
+
+  /**
+   * Sets the file to store sessions in.  If persistence is enabled, this loads
+   * the sessions stored there.  Expired or unreadable entries are dropped.
+   */
+  void SetFile(const std::string& path);
+
+  /**
+   * Sets whether sessions are stored in the file.  Enabling this loads the
+   * stored sessions and saves the current ones; disabling it deletes the file.
+   */
+  void SetPersistent(bool persistent);
+
+  /** Sets up the given CURL handle to resume and store sessions here. */
+  void Apply(CURL* curl);
+
+  /**
+   * Gets the serialized session for the given host.
+   * @return True if there is an unexpired session.
+   */
+  bool Get(const std::string& host, std::vector<uint8_t>* session) const;
+
+  /**
+   * Stores the serialized session for the given host, replacing any existing
+   * one.  This saves the file if persistence is enabled; otherwise the first
+   * call deletes any file stored while it was enabled.
+   * @param host The host the session is for.
+   * @param session The serialized session.
+   * @param expiration The time, in seconds since the epoch, the session
+   *   expires.
+   */
+  void Put(const std::string& host, const std::vector<uint8_t>& session,
+           uint64_t expiration);
+
+ private:
+  struct Entry {
+    std::vector<uint8_t> session;
+    uint64_t expiration;
+  };
+
+  void Load();
+  void Save() const;
+  void DeleteFile() const;
+
+  mutable Mutex mutex_;
+  std::string path_;
+  bool persistent_;
+  // Whether a file stored while persistence was enabled has been deleted.
+  bool checked_file_;
+  std::unordered_map<std::string, Entry> entries_;
+};
+
+}  // namespace shaka
+
+#endif  // SHAKA_EMBEDDED_CORE_TLS_SESSION_CACHE_H_
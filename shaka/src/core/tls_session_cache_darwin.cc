@@ -0,0 +1,24 @@
+// Copyright 2020 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     https://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "src/core/tls_session_cache.h"
+
+namespace shaka {
+
+void TlsSessionCache::Apply(CURL* /* curl */) {
+  // CURL uses Secure Transport here, which keeps its session cache in memory
+  // and doesn't allow sessions to be exported.
+}
+
+}  // namespace shaka
@@ -0,0 +1,117 @@
+// Copyright 2020 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     https://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <curl/curl.h>
+#include <glog/logging.h>
+#include <openssl/ssl.h>
+
+#include <mutex>
+
+#include "src/core/tls_session_cache.h"
+
+namespace shaka {
+
+namespace {
+
+using NewSessionCallback = int (*)(SSL*, SSL_SESSION*);
+using InfoCallback = void (*)(const SSL*, int, int);
+
+/**
+ * The index of the SSL_CTX data that holds the TlsSessionCache, and the
+ * callbacks CURL installed before ours.  CURL uses the same callbacks for
+ * every context, so these are only set once.
+ */
+struct Globals {
+  int cache_index = -1;
+  NewSessionCallback curl_new_session = nullptr;
+  InfoCallback curl_info = nullptr;
+};
+Globals globals;
+std::once_flag globals_flag;
+
+TlsSessionCache* GetCache(const SSL* ssl) {
+  return static_cast<TlsSessionCache*>(
+      SSL_CTX_get_ex_data(SSL_get_SSL_CTX(ssl), globals.cache_index));
+}
+
+int OnNewSession(SSL* ssl, SSL_SESSION* session) {
+  const char* host = SSL_get_servername(ssl, TLSEXT_NAMETYPE_host_name);
+  TlsSessionCache* cache = GetCache(ssl);
+  if (cache && host && SSL_SESSION_is_resumable(session)) {
+    const int size = i2d_SSL_SESSION(session, nullptr);
+    if (size > 0) {
+      std::vector<uint8_t> data(static_cast<size_t>(size));
+      uint8_t* ptr = data.data();
+      i2d_SSL_SESSION(session, &ptr);
+      cache->Put(host, data,
+                 static_cast<uint64_t>(SSL_SESSION_get_time(session)) +
+                     static_cast<uint64_t>(SSL_SESSION_get_timeout(session)));
+    }
+  }
+
+  // The return value says whether the callback kept a reference to the
+  // session; we copied it, so only CURL's callback can.
+  return globals.curl_new_session ? globals.curl_new_session(ssl, session) : 0;
+}
+
+void OnInfo(const SSL* ssl, int where, int ret) {
+  if (globals.curl_info)
+    globals.curl_info(ssl, where, ret);
+  // CURL sets its own session, from memory, before the handshake starts; this
+  // is still before the ClientHello is sent, so the session can be changed.
+  if (!(where & SSL_CB_HANDSHAKE_START) || SSL_get_session(ssl))
+    return;
+
+  const char* host = SSL_get_servername(ssl, TLSEXT_NAMETYPE_host_name);
+  TlsSessionCache* cache = GetCache(ssl);
+  std::vector<uint8_t> data;
+  if (!cache || !host || !cache->Get(host, &data))
+    return;
+
+  const uint8_t* ptr = data.data();
+  SSL_SESSION* session = d2i_SSL_SESSION(nullptr, &ptr, data.size());
+  if (session) {
+    VLOG(2) << "Resuming stored TLS session for " << host;
+    SSL_set_session(const_cast<SSL*>(ssl), session);
+    SSL_SESSION_free(session);
+  }
+}
+
+CURLcode SetUpContext(CURL* /* curl */, void* ssl_ctx, void* user_data) {
+  auto* ctx = static_cast<SSL_CTX*>(ssl_ctx);
+  std::call_once(globals_flag, [ctx]() {
+    globals.cache_index =
+        SSL_CTX_get_ex_new_index(0, nullptr, nullptr, nullptr, nullptr);
+    globals.curl_new_session = SSL_CTX_sess_get_new_cb(ctx);
+    globals.curl_info = SSL_CTX_get_info_callback(ctx);
+  });
+
+  SSL_CTX_set_ex_data(ctx, globals.cache_index, user_data);
+  // Clients only call the new session callback if client caching is on; the
+  // sessions are kept by CURL and by us, so OpenSSL doesn't need to.
+  SSL_CTX_set_session_cache_mode(
+      ctx, SSL_SESS_CACHE_CLIENT | SSL_SESS_CACHE_NO_INTERNAL_STORE);
+  SSL_CTX_sess_set_new_cb(ctx, &OnNewSession);
+  SSL_CTX_set_info_callback(ctx, &OnInfo);
+  return CURLE_OK;
+}
+
+}  // namespace
+
+void TlsSessionCache::Apply(CURL* curl) {
+  curl_easy_setopt(curl, CURLOPT_SSL_CTX_FUNCTION, &SetUpContext);
+  curl_easy_setopt(curl, CURLOPT_SSL_CTX_DATA, this);
+}
+
+}  // namespace shaka
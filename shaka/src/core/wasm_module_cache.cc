@@ -0,0 +1,162 @@
+// Copyright 2020 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     https://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "src/core/wasm_module_cache.h"
+
+#include <glog/logging.h>
+#include <string.h>
+
+#include "src/util/crypto.h"
+#include "src/util/file_system.h"
+#include "src/util/utils.h"
+
+namespace shaka {
+
+namespace {
+
+/** The extension of the files holding compiled modules. */
+constexpr const char* kFileExtension = ".wasm_cache";
+
+bool EndsWith(const std::string& str, const std::string& suffix) {
+  return str.size() >= suffix.size() &&
+         str.compare(str.size() - suffix.size(), suffix.size(), suffix) == 0;
+}
+
+}  // namespace
+
+// static
+WasmModuleCache WasmModuleCache::Instance;
+
+WasmModuleCache::WasmModuleCache()
+    : hit_count_(0), miss_count_(0), total_bytes_(0) {}
+
+WasmModuleCache::~WasmModuleCache() {}
+
+// static
+std::string WasmModuleCache::MakeKey(const uint8_t* data, size_t size) {
+  const std::vector<uint8_t> hash = util::HashData(data, size);
+  return util::ToHexString(hash.data(), hash.size());
+}
+
+void WasmModuleCache::SetDirectory(const std::string& dir) {
+  std::unique_lock<std::mutex> lock(mutex_);
+  dir_ = dir;
+  files_.clear();
+  total_bytes_ = 0;
+
+  util::FileSystem fs;
+  std::vector<std::string> names;
+  if (!fs.DirectoryExists(dir) && !fs.CreateDirectory(dir)) {
+    LOG(ERROR) << "Unable to create WebAssembly cache directory";
+    dir_.clear();
+    return;
+  }
+  if (!fs.ListFiles(dir, &names))
+    return;
+  for (const std::string& name : names) {
+    if (!EndsWith(name, kFileExtension))
+      continue;
+    const ssize_t size = fs.FileSize(util::FileSystem::PathJoin(dir, name));
+    if (size < 0)
+      continue;
+    const std::string key =
+        name.substr(0, name.size() - strlen(kFileExtension));
+    files_.push_back({key, static_cast<size_t>(size)});
+    total_bytes_ += static_cast<size_t>(size);
+  }
+  EvictUntilFits(0);
+}
+
+bool WasmModuleCache::Read(const std::string& key,
+                           std::vector<uint8_t>* compiled) {
+  std::unique_lock<std::mutex> lock(mutex_);
+  for (auto it = files_.begin(); it != files_.end(); it++) {
+    if (it->key != key)
+      continue;
+
+    util::FileSystem fs;
+    const std::string path = util::FileSystem::PathJoin(dir_, key) +
+                             kFileExtension;
+    if (!fs.ReadFile(path, compiled) || compiled->empty()) {
+      RemoveLocked(key);
+      break;
+    }
+    // Keep the most recently used modules the longest.
+    files_.splice(files_.end(), files_, it);
+    hit_count_.fetch_add(1, std::memory_order_relaxed);
+    return true;
+  }
+
+  miss_count_.fetch_add(1, std::memory_order_relaxed);
+  return false;
+}
+
+void WasmModuleCache::Write(const std::string& key, const uint8_t* data,
+                            size_t size) {
+  std::unique_lock<std::mutex> lock(mutex_);
+  if (dir_.empty() || size > kMaxBytes)
+    return;
+
+  RemoveLocked(key);
+  EvictUntilFits(size);
+  util::FileSystem fs;
+  const std::string path = util::FileSystem::PathJoin(dir_, key) +
+                           kFileExtension;
+  if (!fs.WriteFile(path, std::vector<uint8_t>(data, data + size))) {
+    LOG(WARNING) << "Unable to write compiled WebAssembly module";
+    return;
+  }
+  files_.push_back({key, size});
+  total_bytes_ += size;
+  VLOG(1) << "Stored compiled WebAssembly module " << key << " (" << size
+          << " bytes)";
+}
+
+void WasmModuleCache::Remove(const std::string& key) {
+  std::unique_lock<std::mutex> lock(mutex_);
+  RemoveLocked(key);
+}
+
+void WasmModuleCache::AddCompileTime(uint64_t duration_us, bool from_cache) {
+  if (from_cache)
+    cached_compile_times_.Add(duration_us);
+  else
+    compile_times_.Add(duration_us);
+}
+
+void WasmModuleCache::AddInstantiateTime(uint64_t duration_us) {
+  instantiate_times_.Add(duration_us);
+}
+
+void WasmModuleCache::RemoveLocked(const std::string& key) {
+  for (auto it = files_.begin(); it != files_.end(); it++) {
+    if (it->key == key) {
+      util::FileSystem fs;
+      const std::string path = util::FileSystem::PathJoin(dir_, key) +
+                               kFileExtension;
+      if (fs.FileExists(path) && !fs.DeleteFile(path))
+        LOG(WARNING) << "Unable to delete compiled WebAssembly module";
+      total_bytes_ -= it->size;
+      files_.erase(it);
+      return;
+    }
+  }
+}
+
+void WasmModuleCache::EvictUntilFits(size_t size) {
+  while (!files_.empty() && total_bytes_ + size > kMaxBytes)
+    RemoveLocked(files_.front().key);
+}
+
+}  // namespace shaka
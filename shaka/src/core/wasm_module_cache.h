@@ -0,0 +1,126 @@
+// Copyright 2020 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     https://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef SHAKA_EMBEDDED_CORE_WASM_MODULE_CACHE_H_
+#define SHAKA_EMBEDDED_CORE_WASM_MODULE_CACHE_H_
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <atomic>
+#include <list>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include "src/debug/duration_histogram.h"
+#include "src/util/macros.h"
+
+namespace shaka {
+
+/**
+ * Stores compiled WebAssembly modules on disk so later launches can load them
+ * instead of compiling them again.  Each module is stored in its own file,
+ * named by the hash of the module's bytes; the engine checks that a stored
+ * module was made by the same engine version when it loads it.  When the
+ * files use more than the size limit, the oldest are deleted.
+ *
+ * This also keeps the times WebAssembly modules took to compile and
+ * instantiate.  This type is thread-safe.
+ */
+class WasmModuleCache final {
+ public:
+  /** The largest number of bytes of compiled modules to keep. */
+  static constexpr const size_t kMaxBytes = 32 * 1024 * 1024;
+
+  WasmModuleCache();
+  ~WasmModuleCache();
+
+  SHAKA_NON_COPYABLE_OR_MOVABLE_TYPE(WasmModuleCache);
+
+  /** The instance used by the JavaScript engine. */
+  static WasmModuleCache Instance;
+
+  /** @return The key to store the module with the given bytes under. */
+  static std::string MakeKey(const uint8_t* data, size_t size);
+
+  /**
+   * Sets the directory to store the modules in, creating it if needed.  Until
+   * this is called, nothing is cached.
+   */
+  void SetDirectory(const std::string& dir);
+
+  /**
+   * Reads the compiled module stored with the given key.
+   * @return True if the module was found.
+   */
+  bool Read(const std::string& key, std::vector<uint8_t>* compiled);
+
+  /** Stores a compiled module, replacing any that has the same key. */
+  void Write(const std::string& key, const uint8_t* data, size_t size);
+
+  /** Deletes the module with the given key; e.g. if the engine rejected it. */
+  void Remove(const std::string& key);
+
+  /**
+   * Records how long a module took to compile.
+   * @param from_cache Whether the module was loaded from the cache.
+   */
+  void AddCompileTime(uint64_t duration_us, bool from_cache);
+  void AddInstantiateTime(uint64_t duration_us);
+
+  const DurationHistogram& compile_times() const {
+    return compile_times_;
+  }
+  const DurationHistogram& cached_compile_times() const {
+    return cached_compile_times_;
+  }
+  const DurationHistogram& instantiate_times() const {
+    return instantiate_times_;
+  }
+  /** @return The number of compiled modules that were read from disk. */
+  uint64_t hit_count() const {
+    return hit_count_.load(std::memory_order_relaxed);
+  }
+  /** @return The number of modules that weren't stored on disk. */
+  uint64_t miss_count() const {
+    return miss_count_.load(std::memory_order_relaxed);
+  }
+
+ private:
+  struct File {
+    std::string key;
+    size_t size;
+  };
+
+  void RemoveLocked(const std::string& key);
+  void EvictUntilFits(size_t size);
+
+  DurationHistogram compile_times_;
+  DurationHistogram cached_compile_times_;
+  DurationHistogram instantiate_times_;
+  std::atomic<uint64_t> hit_count_;
+  std::atomic<uint64_t> miss_count_;
+
+  // This uses a plain mutex since |Instance| is statically initialized.
+  std::mutex mutex_;
+  std::string dir_;
+  // The stored files, oldest first.
+  std::list<File> files_;
+  size_t total_bytes_;
+};
+
+}  // namespace shaka
+
+#endif  // SHAKA_EMBEDDED_CORE_WASM_MODULE_CACHE_H_
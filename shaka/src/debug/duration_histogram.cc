@@ -0,0 +1,67 @@
+// Copyright 2020 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     https://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "src/debug/duration_histogram.h"
+
+#include <chrono>
+
+namespace shaka {
+
+DurationHistogram::DurationHistogram() {
+  Reset();
+}
+
+// static
+uint64_t DurationHistogram::Now() {
+  return std::chrono::duration_cast<std::chrono::microseconds>(
+             std::chrono::steady_clock::now().time_since_epoch())
+      .count();
+}
+
+void DurationHistogram::Add(uint64_t duration_us) {
+  size_t bucket = 0;
+  while (bucket < kBucketCount - 1 && (duration_us >> bucket) != 0)
+    bucket++;
+  buckets[bucket].fetch_add(1, std::memory_order_relaxed);
+  count.fetch_add(1, std::memory_order_relaxed);
+  total_us.fetch_add(duration_us, std::memory_order_relaxed);
+
+  uint64_t max = max_us.load(std::memory_order_relaxed);
+  while (duration_us > max &&
+         !max_us.compare_exchange_weak(max, duration_us,
+                                       std::memory_order_relaxed)) {
+  }
+}
+
+void DurationHistogram::Reset() {
+  count.store(0, std::memory_order_relaxed);
+  total_us.store(0, std::memory_order_relaxed);
+  max_us.store(0, std::memory_order_relaxed);
+  for (auto& bucket : buckets)
+    bucket.store(0, std::memory_order_relaxed);
+}
+
+uint64_t DurationHistogram::Percentile(double percent) const {
+  const uint64_t total = count.load(std::memory_order_relaxed);
+  const uint64_t target = static_cast<uint64_t>(total * percent / 100);
+  uint64_t seen = 0;
+  for (size_t i = 0; i < kBucketCount - 1; i++) {
+    seen += buckets[i].load(std::memory_order_relaxed);
+    if (seen > target)
+      return 1ull << i;
+  }
+  return max_us.load(std::memory_order_relaxed);
+}
+
+}  // namespace shaka
@@ -0,0 +1,62 @@
+// Copyright 2020 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     https://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef SHAKA_EMBEDDED_DEBUG_DURATION_HISTOGRAM_H_
+#define SHAKA_EMBEDDED_DEBUG_DURATION_HISTOGRAM_H_
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <atomic>
+
+#include "src/util/macros.h"
+
+namespace shaka {
+
+/**
+ * A lock-free histogram of durations, in microseconds.  This can be added to
+ * from any number of threads at once.
+ */
+struct DurationHistogram {
+  /**
+   * The number of histogram buckets.  Bucket i counts durations under 2^i
+   * microseconds; the last bucket counts everything longer.
+   */
+  static constexpr const size_t kBucketCount = 24;
+
+  DurationHistogram();
+
+  SHAKA_NON_COPYABLE_OR_MOVABLE_TYPE(DurationHistogram);
+
+  /** @return The current monotonic time, in microseconds. */
+  static uint64_t Now();
+
+  void Add(uint64_t duration_us);
+  void Reset();
+
+  /**
+   * @return The upper bound of the bucket containing the given percentile, or
+   *   the max if it is in the last bucket.
+   */
+  uint64_t Percentile(double percent) const;
+
+  std::atomic<uint64_t> count;
+  std::atomic<uint64_t> total_us;
+  std::atomic<uint64_t> max_us;
+  std::atomic<uint64_t> buckets[kBucketCount];
+};
+
+}  // namespace shaka
+
+#endif  // SHAKA_EMBEDDED_DEBUG_DURATION_HISTOGRAM_H_
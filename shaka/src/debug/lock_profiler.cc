@@ -0,0 +1,118 @@
+// Copyright 2020 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     https://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "src/debug/lock_profiler.h"
+
+#include <algorithm>
+#include <memory>
+#include <mutex>
+#include <unordered_map>
+#include <vector>
+
+#include "src/util/utils.h"
+
+namespace shaka {
+
+namespace {
+
+struct Entries {
+  std::mutex mutex;
+  std::unordered_map<std::string, std::unique_ptr<LockProfiler::Entry>> map;
+};
+
+Entries* GetEntries() {
+  // This is never freed since locks can still be used while exiting.
+  static Entries* entries = new Entries;
+  return entries;
+}
+
+std::string FormatHistogram(const LockProfiler::Histogram& histogram) {
+  const uint64_t count = histogram.count.load(std::memory_order_relaxed);
+  const uint64_t total = histogram.total_us.load(std::memory_order_relaxed);
+  return util::StringPrintf(
+      "%10llu %10.1f %10llu %10llu %10llu",
+      static_cast<unsigned long long>(count),  // NOLINT
+      count ? static_cast<double>(total) / count : 0.0,
+      static_cast<unsigned long long>(histogram.Percentile(50)),  // NOLINT
+      static_cast<unsigned long long>(histogram.Percentile(99)),  // NOLINT
+      static_cast<unsigned long long>(  // NOLINT
+          histogram.max_us.load(std::memory_order_relaxed)));
+}
+
+}  // namespace
+
+std::atomic<bool> LockProfiler::enabled_{false};
+
+LockProfiler::Entry::Entry(Kind kind, const std::string& name)
+    : kind(kind), name(name) {}
+
+// static
+void LockProfiler::SetEnabled(bool enabled) {
+  enabled_.store(enabled, std::memory_order_relaxed);
+}
+
+// static
+LockProfiler::Entry* LockProfiler::GetEntry(Kind kind,
+                                            const std::string& name) {
+  const std::string key = (kind == Kind::Lock ? "L:" : "E:") + name;
+  Entries* entries = GetEntries();
+  std::unique_lock<std::mutex> lock(entries->mutex);
+  auto& entry = entries->map[key];
+  if (!entry)
+    entry.reset(new Entry(kind, name));
+  return entry.get();
+}
+
+// static
+std::string LockProfiler::Dump() {
+  std::vector<const Entry*> sorted;
+  {
+    Entries* entries = GetEntries();
+    std::unique_lock<std::mutex> lock(entries->mutex);
+    for (auto& pair : entries->map) {
+      if (pair.second->wait.count.load(std::memory_order_relaxed) > 0)
+        sorted.emplace_back(pair.second.get());
+    }
+  }
+  // Show the entries with the most time spent waiting first.
+  std::sort(sorted.begin(), sorted.end(), [](const Entry* a, const Entry* b) {
+    return a->wait.total_us.load(std::memory_order_relaxed) >
+           b->wait.total_us.load(std::memory_order_relaxed);
+  });
+
+  std::string ret = util::StringPrintf(
+      "%-30s %-5s %10s %10s %10s %10s %10s %10s %10s %10s %10s %10s\n", "Name",
+      "Kind", "Waits", "Avg(us)", "P50(us)", "P99(us)", "Max(us)", "Holds",
+      "Avg(us)", "P50(us)", "P99(us)", "Max(us)");
+  for (const Entry* entry : sorted) {
+    ret += util::StringPrintf(
+        "%-30s %-5s %s %s\n", entry->name.c_str(),
+        entry->kind == Kind::Lock ? "lock" : "event",
+        FormatHistogram(entry->wait).c_str(),
+        entry->kind == Kind::Lock ? FormatHistogram(entry->hold).c_str() : "");
+  }
+  return ret;
+}
+
+// static
+void LockProfiler::Reset() {
+  Entries* entries = GetEntries();
+  std::unique_lock<std::mutex> lock(entries->mutex);
+  for (auto& pair : entries->map) {
+    pair.second->wait.Reset();
+    pair.second->hold.Reset();
+  }
+}
+
+}  // namespace shaka
@@ -0,0 +1,153 @@
+// Copyright 2020 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     https://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef SHAKA_EMBEDDED_DEBUG_LOCK_PROFILER_H_
+#define SHAKA_EMBEDDED_DEBUG_LOCK_PROFILER_H_
+
+#include <stdint.h>
+
+#include <atomic>
+#include <string>
+
+#include "src/debug/duration_histogram.h"
+#include "src/util/macros.h"
+
+namespace shaka {
+
+/**
+ * Records how long threads wait for and hold locks, and how long they wait for
+ * events, grouped by the name of the lock or event.  This is usable in release
+ * builds; while it is disabled (the default), each operation only checks an
+ * atomic flag.  Recording is lock-free, so this adds little contention itself.
+ */
+class LockProfiler {
+ public:
+  using Histogram = DurationHistogram;
+  static constexpr const size_t kBucketCount = DurationHistogram::kBucketCount;
+
+  enum class Kind : uint8_t {
+    Lock,
+    Event,
+  };
+
+  /** The profile of every lock or event with the same name. */
+  struct Entry {
+    Entry(Kind kind, const std::string& name);
+
+    const Kind kind;
+    const std::string name;
+    /** The time spent waiting to acquire the lock, or for the event. */
+    Histogram wait;
+    /** The time the lock was held; unused for events. */
+    Histogram hold;
+  };
+
+  static bool IsEnabled() {
+    return enabled_.load(std::memory_order_relaxed);
+  }
+
+  static void SetEnabled(bool enabled);
+
+  /** @return The current time, in microseconds. */
+  static uint64_t Now() {
+    return DurationHistogram::Now();
+  }
+
+  /**
+   * Gets the entry for the given name.  Entries are never freed, so the
+   * returned pointer can be stored.
+   */
+  static Entry* GetEntry(Kind kind, const std::string& name);
+
+  /** @return A human-readable table of the recorded profile. */
+  static std::string Dump();
+
+  /** Clears all the recorded durations. */
+  static void Reset();
+
+ private:
+  LockProfiler() {}
+
+  static std::atomic<bool> enabled_;
+};
+
+/**
+ * Holds the profile of a single lock.  This is used by the Mutex types to
+ * record their wait and hold times.  Calls must happen while holding the
+ * lock, except for BeforeLock.
+ */
+class LockProfile {
+ public:
+  explicit LockProfile(const std::string& name)
+      : entry_(LockProfiler::GetEntry(LockProfiler::Kind::Lock, name)) {}
+
+  SHAKA_NON_COPYABLE_OR_MOVABLE_TYPE(LockProfile);
+
+  /** @return The start time to pass to OnLocked, or 0 if disabled. */
+  uint64_t BeforeLock() const {
+    return LockProfiler::IsEnabled() ? LockProfiler::Now() : 0;
+  }
+
+  void OnLocked(uint64_t start) {
+    if (start) {
+      locked_at_ = LockProfiler::Now();
+      entry_->wait.Add(locked_at_ - start);
+    } else {
+      locked_at_ = 0;
+    }
+  }
+
+  void OnTryLocked() {
+    locked_at_ = LockProfiler::IsEnabled() ? LockProfiler::Now() : 0;
+  }
+
+  void OnSharedLocked(uint64_t start) {
+    // There can be multiple readers, so only track how long they waited.
+    if (start)
+      entry_->wait.Add(LockProfiler::Now() - start);
+  }
+
+  void OnUnlock() {
+    if (locked_at_) {
+      entry_->hold.Add(LockProfiler::Now() - locked_at_);
+      locked_at_ = 0;
+    }
+  }
+
+ private:
+  LockProfiler::Entry* const entry_;
+  uint64_t locked_at_ = 0;
+};
+
+/** Records the time this object lives as a wait in the given entry. */
+class ProfiledWait {
+ public:
+  /** @param entry The entry to record in, or nullptr to do nothing. */
+  explicit ProfiledWait(LockProfiler::Entry* entry)
+      : entry_(entry), start_(entry ? LockProfiler::Now() : 0) {}
+  ~ProfiledWait() {
+    if (entry_)
+      entry_->wait.Add(LockProfiler::Now() - start_);
+  }
+
+  SHAKA_NON_COPYABLE_OR_MOVABLE_TYPE(ProfiledWait);
+
+ private:
+  LockProfiler::Entry* const entry_;
+  const uint64_t start_;
+};
+
+}  // namespace shaka
+
+#endif  // SHAKA_EMBEDDED_DEBUG_LOCK_PROFILER_H_
@@ -23,6 +23,7 @@
 #include <thread>
 #include <unordered_set>
 
+#include "src/debug/lock_profiler.h"
 #include "src/debug/waitable.h"
 #include "src/debug/waiting_tracker.h"
 #include "src/util/shared_lock.h"
@@ -43,7 +44,7 @@ template <typename _Mutex>
 class DebugMutex : public Waitable {
  public:
   explicit DebugMutex(const std::string& name)
-    : Waitable(name), locked_by_(std::thread::id()) {}
+    : Waitable(name), profile_(name), locked_by_(std::thread::id()) {}
   ~DebugMutex() override {
     CHECK_EQ(locked_by_, std::thread::id())
         << "Attempt to destroy locked mutex.";
@@ -64,7 +65,9 @@ class DebugMutex : public Waitable {
     // deadlocks for the exclusive lock.
 #endif
 
+    const uint64_t start = profile_.BeforeLock();
     mutex_.lock();
+    profile_.OnLocked(start);
 
     locked_by_ = std::this_thread::get_id();
   }
@@ -76,8 +79,10 @@ class DebugMutex : public Waitable {
 
     bool ret = mutex_.try_lock();
 
-    if (ret)
+    if (ret) {
+      profile_.OnTryLocked();
       locked_by_ = std::this_thread::get_id();
+    }
 
     return ret;
   }
@@ -87,6 +92,7 @@ class DebugMutex : public Waitable {
         << "Attempt to unlock from wrong thread.";
     locked_by_ = std::thread::id();
 
+    profile_.OnUnlock();
     mutex_.unlock();
   }
 
@@ -99,7 +105,9 @@ class DebugMutex : public Waitable {
     // for the exclusive lock because there can be multiple readers and it could
     // report a false-positive.
 
+    const uint64_t start = profile_.BeforeLock();
     mutex_.lock_shared();
+    profile_.OnSharedLocked(start);
 
     add_shared_lock();
   }
@@ -141,6 +149,7 @@ class DebugMutex : public Waitable {
     shared_locked_by_.erase(std::this_thread::get_id());
   }
   _Mutex mutex_;
+  LockProfile profile_;
   std::atomic<std::thread::id> locked_by_;
   std::atomic<bool> is_upgrading_{false};
 
@@ -152,13 +161,69 @@ class DebugMutex : public Waitable {
 using Mutex = DebugMutex<std::mutex>;
 using SharedMutex = DebugMutex<util::shared_mutex>;
 #else
+/**
+ * A std::mutex that records its wait and hold times in the LockProfiler.
+ */
 class Mutex final : public std::mutex {
  public:
-  explicit Mutex(const std::string&) {}
+  explicit Mutex(const std::string& name) : profile_(name) {}
+
+  void lock() {
+    const uint64_t start = profile_.BeforeLock();
+    std::mutex::lock();
+    profile_.OnLocked(start);
+  }
+
+  bool try_lock() {
+    if (!std::mutex::try_lock())
+      return false;
+    profile_.OnTryLocked();
+    return true;
+  }
+
+  void unlock() {
+    profile_.OnUnlock();
+    std::mutex::unlock();
+  }
+
+ private:
+  LockProfile profile_;
 };
+
+/**
+ * A util::shared_mutex that records its wait and hold times in the
+ * LockProfiler.
+ */
 class SharedMutex final : public util::shared_mutex {
  public:
-  explicit SharedMutex(const std::string&) {}
+  explicit SharedMutex(const std::string& name) : profile_(name) {}
+
+  void lock() {
+    const uint64_t start = profile_.BeforeLock();
+    util::shared_mutex::lock();
+    profile_.OnLocked(start);
+  }
+
+  bool try_lock() {
+    if (!util::shared_mutex::try_lock())
+      return false;
+    profile_.OnTryLocked();
+    return true;
+  }
+
+  void unlock() {
+    profile_.OnUnlock();
+    util::shared_mutex::unlock();
+  }
+
+  void lock_shared() {
+    const uint64_t start = profile_.BeforeLock();
+    util::shared_mutex::lock_shared();
+    profile_.OnSharedLocked(start);
+  }
+
+ private:
+  LockProfile profile_;
 };
 #endif
 
@@ -0,0 +1,123 @@
+// Copyright 2020 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     https://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "src/debug/startup_tracer.h"
+
+#include <stdio.h>
+
+#include <algorithm>
+
+namespace shaka {
+
+namespace {
+
+/** Appends the given string as a JSON string literal. */
+void AppendJsonString(const std::string& str, std::string* out) {
+  out->push_back('"');
+  for (char c : str) {
+    if (c == '"' || c == '\\') {
+      out->push_back('\\');
+      out->push_back(c);
+    } else if (static_cast<unsigned char>(c) < 0x20) {
+      char buffer[8];
+      snprintf(buffer, sizeof(buffer), "\\u%04x", c);
+      out->append(buffer);
+    } else {
+      out->push_back(c);
+    }
+  }
+  out->push_back('"');
+}
+
+}  // namespace
+
+StartupTracer StartupTracer::Instance(&util::Clock::Instance);
+
+StartupTracer::StartupTracer(const util::Clock* clock) : clock_(clock) {}
+
+StartupTracer::~StartupTracer() {}
+
+uint64_t StartupTracer::Now() const {
+  return clock_->GetMonotonicTime();
+}
+
+void StartupTracer::AddMilestone(const std::string& name) {
+  const uint64_t now = Now();
+  std::unique_lock<std::mutex> lock(mutex_);
+  AddEvent(name, now, now);
+}
+
+void StartupTracer::AddFirstMilestone(const std::string& name) {
+  const uint64_t now = Now();
+  std::unique_lock<std::mutex> lock(mutex_);
+  for (auto& event : events_) {
+    if (event.name == name)
+      return;
+  }
+  AddEvent(name, now, now);
+}
+
+void StartupTracer::AddSpan(const std::string& name, uint64_t start_ms) {
+  const uint64_t now = Now();
+  std::unique_lock<std::mutex> lock(mutex_);
+  AddEvent(name, start_ms, std::max(start_ms, now));
+}
+
+std::vector<StartupTrace::Event> StartupTracer::GetEvents() const {
+  std::unique_lock<std::mutex> lock(mutex_);
+  return events_;
+}
+
+std::string StartupTracer::GetChromeTraceJson() const {
+  // This uses the "Trace Event Format" that chrome://tracing loads.
+  std::string ret = "{\"traceEvents\":[";
+  bool first = true;
+  for (auto& event : GetEvents()) {
+    if (!first)
+      ret.push_back(',');
+    first = false;
+
+    // Timestamps are in microseconds.
+    ret.append("{\"name\":");
+    AppendJsonString(event.name, &ret);
+    ret.append(",\"cat\":\"startup\",\"pid\":0,\"tid\":0,\"ts\":");
+    ret.append(std::to_string(event.start_ms * 1000));
+    if (event.duration_ms > 0) {
+      ret.append(",\"ph\":\"X\",\"dur\":");
+      ret.append(std::to_string(event.duration_ms * 1000));
+    } else {
+      ret.append(",\"ph\":\"i\",\"s\":\"g\"");
+    }
+    ret.push_back('}');
+  }
+  ret.append("],\"displayTimeUnit\":\"ms\"}");
+  return ret;
+}
+
+void StartupTracer::Reset() {
+  std::unique_lock<std::mutex> lock(mutex_);
+  events_.clear();
+}
+
+void StartupTracer::AddEvent(const std::string& name, uint64_t start_ms,
+                             uint64_t end_ms) {
+  // Spans are added when they end, so keep the events sorted by start time.
+  auto it = std::upper_bound(events_.begin(), events_.end(), start_ms,
+                             [](uint64_t start, const StartupTrace::Event& e) {
+                               return start < e.start_ms;
+                             });
+  events_.insert(it, {name, start_ms, end_ms - start_ms});
+}
+
+}  // namespace shaka
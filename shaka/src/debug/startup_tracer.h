@@ -0,0 +1,87 @@
+// Copyright 2020 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     https://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef SHAKA_EMBEDDED_DEBUG_STARTUP_TRACER_H_
+#define SHAKA_EMBEDDED_DEBUG_STARTUP_TRACER_H_
+
+#include <stdint.h>
+
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include "shaka/startup_trace.h"
+#include "src/util/clock.h"
+#include "src/util/macros.h"
+
+namespace shaka {
+
+/**
+ * Records the events for the public StartupTrace type.  This is a separate
+ * type so it can be tested with a fake clock.
+ */
+class StartupTracer {
+ public:
+  explicit StartupTracer(const util::Clock* clock);
+  ~StartupTracer();
+
+  SHAKA_NON_COPYABLE_OR_MOVABLE_TYPE(StartupTracer);
+
+  /** The instance used for the public StartupTrace type. */
+  static StartupTracer Instance;
+
+  /** @return The current time, in milliseconds, to start a span with. */
+  uint64_t Now() const;
+
+  /** Adds an event for the current time. */
+  void AddMilestone(const std::string& name);
+
+  /** Adds an event for the current time if there isn't one with the name. */
+  void AddFirstMilestone(const std::string& name);
+
+  /** Adds an event that started at the given time and ends now. */
+  void AddSpan(const std::string& name, uint64_t start_ms);
+
+  std::vector<StartupTrace::Event> GetEvents() const;
+  std::string GetChromeTraceJson() const;
+  void Reset();
+
+ private:
+  /** Adds the event.  This must be called while holding |mutex_|. */
+  void AddEvent(const std::string& name, uint64_t start_ms, uint64_t end_ms);
+
+  const util::Clock* const clock_;
+  mutable std::mutex mutex_;
+  std::vector<StartupTrace::Event> events_;
+};
+
+/** Adds a StartupTrace span that lasts as long as this object lives. */
+class StartupSpan {
+ public:
+  explicit StartupSpan(const std::string& name)
+      : name_(name), start_(StartupTracer::Instance.Now()) {}
+  ~StartupSpan() {
+    StartupTracer::Instance.AddSpan(name_, start_);
+  }
+
+  SHAKA_NON_COPYABLE_OR_MOVABLE_TYPE(StartupSpan);
+
+ private:
+  const std::string name_;
+  const uint64_t start_;
+};
+
+}  // namespace shaka
+
+#endif  // SHAKA_EMBEDDED_DEBUG_STARTUP_TRACER_H_
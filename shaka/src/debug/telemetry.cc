@@ -0,0 +1,244 @@
+// Copyright 2020 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     https://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "src/debug/telemetry.h"
+
+#if defined(OS_MAC) || defined(OS_IOS)
+#  include <mach/mach.h>
+#endif
+#include <time.h>
+
+#include <algorithm>
+#include <mutex>
+#include <unordered_set>
+#include <utility>
+
+#include "src/memory/pool_allocator.h"
+
+namespace shaka {
+
+namespace {
+
+struct Threads {
+  std::mutex mutex;
+  std::unordered_set<Telemetry::ThreadEntry*> entries;
+};
+
+Threads* GetThreadList() {
+  // This is never freed since threads can still be running while exiting.
+  static Threads* threads = new Threads;
+  return threads;
+}
+
+thread_local Telemetry::ThreadEntry* current_thread = nullptr;
+
+/** @return The CPU time, in seconds, the given (running) thread has used. */
+double GetCpuSeconds(pthread_t thread) {
+#if defined(OS_MAC) || defined(OS_IOS)
+  thread_basic_info_data_t info;
+  mach_msg_type_number_t count = THREAD_BASIC_INFO_COUNT;
+  if (thread_info(pthread_mach_thread_np(thread), THREAD_BASIC_INFO,
+                  reinterpret_cast<thread_info_t>(&info),
+                  &count) != KERN_SUCCESS) {
+    return 0;
+  }
+  return info.user_time.seconds + info.system_time.seconds +
+         (info.user_time.microseconds + info.system_time.microseconds) / 1e6;
+#elif defined(OS_POSIX)
+  clockid_t clock;
+  struct timespec time;
+  if (pthread_getcpuclockid(thread, &clock) != 0 ||
+      clock_gettime(clock, &time) != 0) {
+    return 0;
+  }
+  return time.tv_sec + time.tv_nsec / 1e9;
+#else
+#  error "Not implemented for Windows"
+#endif
+}
+
+}  // namespace
+
+Telemetry::ThreadEntry::ThreadEntry(const std::string& name)
+    : name(name),
+      wakeups(0),
+      running(false),
+      handle(),
+      exit_cpu_seconds(0) {}
+
+Telemetry::StreamEntry::StreamEntry(const std::string& name)
+    : name(name),
+      frames_demuxed(0),
+      frames_decoded(0),
+      frames_dropped(0),
+      frames_skipped(0) {}
+
+// static
+Telemetry::ThreadEntry* Telemetry::AddThread(const std::string& name) {
+  ThreadEntry* entry = new ThreadEntry(name);
+  Threads* threads = GetThreadList();
+  std::unique_lock<std::mutex> lock(threads->mutex);
+  threads->entries.insert(entry);
+  return entry;
+}
+
+// static
+void Telemetry::RemoveThread(ThreadEntry* entry) {
+  {
+    Threads* threads = GetThreadList();
+    std::unique_lock<std::mutex> lock(threads->mutex);
+    threads->entries.erase(entry);
+  }
+  delete entry;
+}
+
+// static
+void Telemetry::OnThreadStart(ThreadEntry* entry) {
+  current_thread = entry;
+  Threads* threads = GetThreadList();
+  std::unique_lock<std::mutex> lock(threads->mutex);
+  entry->handle = pthread_self();
+  entry->running = true;
+}
+
+// static
+void Telemetry::OnThreadExit() {
+  ThreadEntry* entry = current_thread;
+  current_thread = nullptr;
+  if (!entry)
+    return;
+
+  // Store the final CPU time since the handle can't be used once the thread
+  // exits.  The lock ensures GetThreads isn't using the handle.
+  Threads* threads = GetThreadList();
+  std::unique_lock<std::mutex> lock(threads->mutex);
+  entry->exit_cpu_seconds = GetCpuSeconds(entry->handle);
+  entry->running = false;
+}
+
+// static
+void Telemetry::OnWakeup() {
+  if (current_thread)
+    current_thread->wakeups.fetch_add(1, std::memory_order_relaxed);
+}
+
+// static
+void Telemetry::OnQueueLatency(uint64_t latency_us) {
+  if (current_thread)
+    current_thread->queue_latency.Add(latency_us);
+}
+
+// static
+Telemetry::StreamEntry* Telemetry::GetStream(bool is_video) {
+  // These are never freed since frames can still be decoded while exiting.
+  static StreamEntry* audio = new StreamEntry("audio");
+  static StreamEntry* video = new StreamEntry("video");
+  return is_video ? video : audio;
+}
+
+// static
+// static
+PipelineTelemetry::Histogram Telemetry::Summarize(
+    const DurationHistogram& histogram) {
+  PipelineTelemetry::Histogram ret;
+  ret.count = histogram.count.load(std::memory_order_relaxed);
+  ret.average_us =
+      ret.count ? static_cast<double>(histogram.total_us.load(
+                      std::memory_order_relaxed)) /
+                      ret.count
+                : 0;
+  ret.p50_us = histogram.Percentile(50);
+  ret.p99_us = histogram.Percentile(99);
+  ret.max_us = histogram.max_us.load(std::memory_order_relaxed);
+  ret.buckets.reserve(DurationHistogram::kBucketCount);
+  for (auto& bucket : histogram.buckets)
+    ret.buckets.emplace_back(bucket.load(std::memory_order_relaxed));
+  return ret;
+}
+
+std::vector<PipelineTelemetry::Thread> Telemetry::GetThreads() {
+  std::vector<PipelineTelemetry::Thread> ret;
+  {
+    Threads* threads = GetThreadList();
+    std::unique_lock<std::mutex> lock(threads->mutex);
+    ret.reserve(threads->entries.size());
+    for (ThreadEntry* entry : threads->entries) {
+      PipelineTelemetry::Thread thread;
+      thread.name = entry->name;
+      thread.cpu_seconds = entry->running ? GetCpuSeconds(entry->handle)
+                                          : entry->exit_cpu_seconds;
+      thread.wakeups = entry->wakeups.load(std::memory_order_relaxed);
+      thread.queue_latency = Summarize(entry->queue_latency);
+      ret.emplace_back(std::move(thread));
+    }
+  }
+  std::sort(ret.begin(), ret.end(),
+            [](const PipelineTelemetry::Thread& a,
+               const PipelineTelemetry::Thread& b) { return a.name < b.name; });
+  return ret;
+}
+
+// static
+std::vector<PipelineTelemetry::Stream> Telemetry::GetStreams() {
+  std::vector<PipelineTelemetry::Stream> ret;
+  for (bool is_video : {false, true}) {
+    const StreamEntry* entry = GetStream(is_video);
+    PipelineTelemetry::Stream stream;
+    stream.name = entry->name;
+    stream.frames_demuxed =
+        entry->frames_demuxed.load(std::memory_order_relaxed);
+    stream.frames_decoded =
+        entry->frames_decoded.load(std::memory_order_relaxed);
+    stream.frames_dropped =
+        entry->frames_dropped.load(std::memory_order_relaxed);
+    stream.frames_skipped =
+        entry->frames_skipped.load(std::memory_order_relaxed);
+    stream.decode_latency = Summarize(entry->decode_latency);
+    if (stream.frames_demuxed > 0 || stream.frames_decoded > 0)
+      ret.emplace_back(std::move(stream));
+  }
+  return ret;
+}
+
+// static
+PipelineTelemetry::FrameAllocations Telemetry::GetFrameAllocations() {
+  const memory::BlockPool::Stats stats = memory::BlockPool::GetStats();
+  PipelineTelemetry::FrameAllocations ret;
+  ret.frames_allocated = stats.allocations;
+  ret.heap_allocations = stats.heap_allocations;
+  return ret;
+}
+
+// static
+void Telemetry::Reset() {
+  {
+    Threads* threads = GetThreadList();
+    std::unique_lock<std::mutex> lock(threads->mutex);
+    for (ThreadEntry* entry : threads->entries) {
+      entry->wakeups.store(0, std::memory_order_relaxed);
+      entry->queue_latency.Reset();
+    }
+  }
+  for (bool is_video : {false, true}) {
+    StreamEntry* entry = GetStream(is_video);
+    entry->frames_demuxed.store(0, std::memory_order_relaxed);
+    entry->frames_decoded.store(0, std::memory_order_relaxed);
+    entry->frames_dropped.store(0, std::memory_order_relaxed);
+    entry->frames_skipped.store(0, std::memory_order_relaxed);
+    entry->decode_latency.Reset();
+  }
+  memory::BlockPool::ResetStats();
+}
+
+}  // namespace shaka
@@ -0,0 +1,105 @@
+// Copyright 2020 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     https://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef SHAKA_EMBEDDED_DEBUG_TELEMETRY_H_
+#define SHAKA_EMBEDDED_DEBUG_TELEMETRY_H_
+
+#include <pthread.h>
+#include <stdint.h>
+
+#include <atomic>
+#include <string>
+#include <vector>
+
+#include "shaka/pipeline_telemetry.h"
+#include "src/debug/duration_histogram.h"
+#include "src/util/macros.h"
+
+namespace shaka {
+
+/**
+ * Records the counters for the public PipelineTelemetry type.  Recording is
+ * lock-free, except when threads start and stop.
+ */
+class Telemetry {
+ public:
+  /** The counters for a single Thread. */
+  struct ThreadEntry {
+    explicit ThreadEntry(const std::string& name);
+
+    SHAKA_NON_COPYABLE_OR_MOVABLE_TYPE(ThreadEntry);
+
+    const std::string name;
+    std::atomic<uint64_t> wakeups;
+    DurationHistogram queue_latency;
+
+    // These are only used while holding the global lock.
+    bool running;
+    pthread_t handle;
+    double exit_cpu_seconds;
+  };
+
+  /** The counters for a type of stream. */
+  struct StreamEntry {
+    explicit StreamEntry(const std::string& name);
+
+    SHAKA_NON_COPYABLE_OR_MOVABLE_TYPE(StreamEntry);
+
+    const std::string name;
+    std::atomic<uint64_t> frames_demuxed;
+    std::atomic<uint64_t> frames_decoded;
+    std::atomic<uint64_t> frames_dropped;
+    std::atomic<uint64_t> frames_skipped;
+    DurationHistogram decode_latency;
+  };
+
+  /** Creates the entry for a new Thread.  Must call RemoveThread to free it. */
+  static ThreadEntry* AddThread(const std::string& name);
+  static void RemoveThread(ThreadEntry* entry);
+
+  /**
+   * Called on the new thread when it starts.  Until OnThreadExit is called,
+   * the counters below are recorded in the given entry.
+   */
+  static void OnThreadStart(ThreadEntry* entry);
+  static void OnThreadExit();
+
+  /** Called when the current thread wakes up after waiting for work. */
+  static void OnWakeup();
+
+  /**
+   * Called when the current thread starts running work that was queued the
+   * given number of microseconds ago.
+   */
+  static void OnQueueLatency(uint64_t latency_us);
+
+  /** @return The entry for the audio or video streams. */
+  static StreamEntry* GetStream(bool is_video);
+
+  /** @return The public summary of the given histogram. */
+  static PipelineTelemetry::Histogram Summarize(
+      const DurationHistogram& histogram);
+
+  static std::vector<PipelineTelemetry::Thread> GetThreads();
+  static std::vector<PipelineTelemetry::Stream> GetStreams();
+  static PipelineTelemetry::FrameAllocations GetFrameAllocations();
+  static void Reset();
+
+ private:
+  Telemetry() {}
+};
+
+}  // namespace shaka
+
+#endif  // SHAKA_EMBEDDED_DEBUG_TELEMETRY_H_
@@ -15,7 +15,19 @@
 #include "src/debug/thread.h"
 
 #include <glog/logging.h>
+#include <pthread.h>
+#if defined(OS_MAC) || defined(OS_IOS)
+#  include <sys/qos.h>
+#elif defined(OS_POSIX)
+#  include <errno.h>
+#  include <sched.h>
+#  include <string.h>
+#  include <sys/resource.h>
+#  include <sys/syscall.h>
+#  include <unistd.h>
+#endif
 
+#include <mutex>
 #include <utility>
 
 #include "src/debug/waiting_tracker.h"
@@ -25,7 +37,132 @@ namespace shaka {
 
 namespace {
 
-void ThreadMain(const std::string& name, std::function<void()> callback) {
+constexpr const size_t kRoleCount =
+    static_cast<size_t>(ThreadRole::Background) + 1;
+
+ThreadOptions GetDefaultOptions(ThreadRole role) {
+  ThreadOptions ret;
+  switch (role) {
+    case ThreadRole::Audio:
+    case ThreadRole::Video:
+      ret.priority = ThreadPriority::UserInteractive;
+      break;
+    case ThreadRole::Media:
+    case ThreadRole::Network:
+    case ThreadRole::JavaScript:
+      ret.priority = ThreadPriority::UserInitiated;
+      break;
+    case ThreadRole::Background:
+      ret.priority = ThreadPriority::Utility;
+      break;
+    case ThreadRole::Default:
+      break;
+  }
+  return ret;
+}
+
+struct OptionsTable {
+  OptionsTable() {
+    for (size_t i = 0; i < kRoleCount; i++)
+      options[i] = GetDefaultOptions(static_cast<ThreadRole>(i));
+  }
+
+  // This uses a plain mutex since the options can be set before any threads
+  // (including the ones used to debug deadlocks) exist.
+  std::mutex mutex;
+  ThreadOptions options[kRoleCount];
+};
+
+OptionsTable* GetOptionsTable() {
+  static OptionsTable table;
+  return &table;
+}
+
+/** Applies the given options to the current thread. */
+void ApplyOptions(const std::string& name, const ThreadOptions& options) {
+#if defined(OS_MAC) || defined(OS_IOS)
+  qos_class_t qos = QOS_CLASS_UNSPECIFIED;
+  switch (options.priority) {
+    case ThreadPriority::Background:
+      qos = QOS_CLASS_BACKGROUND;
+      break;
+    case ThreadPriority::Utility:
+      qos = QOS_CLASS_UTILITY;
+      break;
+    case ThreadPriority::Default:
+      break;
+    case ThreadPriority::UserInitiated:
+      qos = QOS_CLASS_USER_INITIATED;
+      break;
+    case ThreadPriority::UserInteractive:
+      qos = QOS_CLASS_USER_INTERACTIVE;
+      break;
+  }
+  if (qos != QOS_CLASS_UNSPECIFIED) {
+    const int ret = pthread_set_qos_class_self_np(qos, 0);
+    if (ret != 0) {
+      LOG(WARNING) << "Unable to set QoS class of thread " << name << ": "
+                   << ret;
+    }
+  }
+#elif defined(OS_POSIX)
+  if (options.realtime) {
+    sched_param param;
+    memset(&param, 0, sizeof(param));
+    param.sched_priority = sched_get_priority_min(SCHED_FIFO);
+    const int ret = pthread_setschedparam(pthread_self(), SCHED_FIFO, &param);
+    if (ret != 0) {
+      LOG(WARNING) << "Unable to use real-time scheduling for thread " << name
+                   << ": " << strerror(ret);
+    }
+  } else {
+    int nice = 0;
+    switch (options.priority) {
+      case ThreadPriority::Background:
+        nice = 10;
+        break;
+      case ThreadPriority::Utility:
+        nice = 5;
+        break;
+      case ThreadPriority::Default:
+        break;
+      case ThreadPriority::UserInitiated:
+        nice = -5;
+        break;
+      case ThreadPriority::UserInteractive:
+        nice = -10;
+        break;
+    }
+    // On Linux, the nice value applies to a single thread when given its
+    // thread ID.  Raising the priority needs permission, so failing here is
+    // expected for the defaults and isn't an error.
+    if (nice != 0 &&
+        setpriority(PRIO_PROCESS, static_cast<id_t>(syscall(SYS_gettid)),
+                    nice) != 0) {
+      VLOG(1) << "Unable to set nice value of thread " << name << " to "
+              << nice << ": " << strerror(errno);
+    }
+  }
+
+  if (options.cpu_affinity != 0) {
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    for (size_t cpu = 0; cpu < 64 && cpu < CPU_SETSIZE; cpu++) {
+      if (options.cpu_affinity & (1ull << cpu))
+        CPU_SET(cpu, &set);
+    }
+    // A thread ID of 0 means the current thread.
+    if (sched_setaffinity(0, sizeof(set), &set) != 0) {
+      LOG(WARNING) << "Unable to set CPU affinity of thread " << name << ": "
+                   << strerror(errno);
+    }
+  }
+#endif
+}
+
+void ThreadMain(const std::string& name, ThreadOptions options,
+                Telemetry::ThreadEntry* telemetry,
+                std::function<void()> callback) {
 #if defined(OS_MAC) || defined(OS_IOS)
   pthread_setname_np(name.c_str());
 #elif defined(OS_POSIX)
@@ -33,7 +170,10 @@ void ThreadMain(const std::string& name, std::function<void()> callback) {
 #else
 #  error "Not implemented for Windows"
 #endif
+  ApplyOptions(name, options);
 
+  Telemetry::OnThreadStart(telemetry);
+  util::Finally telemetry_scope(&Telemetry::OnThreadExit);
 #ifdef DEBUG_DEADLOCKS
   util::Finally scope(&WaitingTracker::ThreadExit);
 #endif
@@ -42,8 +182,13 @@ void ThreadMain(const std::string& name, std::function<void()> callback) {
 
 }  // namespace
 
-Thread::Thread(const std::string& name, std::function<void()> callback)
-    : name_(name), thread_(&ThreadMain, name, std::move(callback)) {
+Thread::Thread(const std::string& name, std::function<void()> callback,
+               ThreadRole role)
+    : name_(name),
+      role_(role),
+      telemetry_(Telemetry::AddThread(name)),
+      thread_(&ThreadMain, name, GetOptions(role), telemetry_,
+              std::move(callback)) {
   DCHECK_LT(name.size(), 16u) << "Name too long: " << name;
 #ifdef DEBUG_DEADLOCKS
   original_id_ = thread_.get_id();
@@ -53,9 +198,28 @@ Thread::Thread(const std::string& name, std::function<void()> callback)
 
 Thread::~Thread() {
   DCHECK(!thread_.joinable());
+  Telemetry::RemoveThread(telemetry_);
 #ifdef DEBUG_DEADLOCKS
   WaitingTracker::RemoveThread(this);
 #endif
 }
 
+// static
+void Thread::SetOptions(ThreadRole role, const ThreadOptions& options) {
+  const size_t index = static_cast<size_t>(role);
+  CHECK_LT(index, kRoleCount);
+  OptionsTable* table = GetOptionsTable();
+  std::unique_lock<std::mutex> lock(table->mutex);
+  table->options[index] = options;
+}
+
+// static
+ThreadOptions Thread::GetOptions(ThreadRole role) {
+  const size_t index = static_cast<size_t>(role);
+  CHECK_LT(index, kRoleCount);
+  OptionsTable* table = GetOptionsTable();
+  std::unique_lock<std::mutex> lock(table->mutex);
+  return table->options[index];
+}
+
 }  // namespace shaka
@@ -19,20 +19,46 @@
 #include <string>
 #include <thread>
 
+#include "shaka/thread_options.h"
+#include "src/debug/telemetry.h"
+
 namespace shaka {
 
 class Thread final {
  public:
-  Thread(const std::string& name, std::function<void()> callback);
+  /**
+   * Starts a new thread that runs the given callback.
+   *
+   * @param name The name of the thread, for debugging.
+   * @param callback The function to run on the new thread.
+   * @param role The kind of work the thread does, which is used to pick how
+   *   the thread is scheduled (see SetOptions).
+   */
+  Thread(const std::string& name, std::function<void()> callback,
+         ThreadRole role = ThreadRole::Default);
   Thread(const Thread&) = delete;
   Thread(Thread&&) = delete;
   ~Thread();
 
+  /**
+   * Sets how threads with the given role are scheduled.  This only applies to
+   * threads that start after this is called.
+   */
+  static void SetOptions(ThreadRole role, const ThreadOptions& options);
+
+  /** @return How threads with the given role are scheduled. */
+  static ThreadOptions GetOptions(ThreadRole role);
+
   /** @return The name of the thread. */
   std::string name() const {
     return name_;
   }
 
+  /** @return The kind of work the thread does. */
+  ThreadRole role() const {
+    return role_;
+  }
+
   /** @return Whether you can call join() on the thread. */
   bool joinable() const {
     return thread_.joinable();
@@ -59,6 +85,8 @@ class Thread final {
 
  private:
   const std::string name_;
+  const ThreadRole role_;
+  Telemetry::ThreadEntry* const telemetry_;
   std::thread thread_;
 #ifdef DEBUG_DEADLOCKS
   std::thread::id original_id_;
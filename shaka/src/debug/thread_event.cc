@@ -19,7 +19,7 @@
 namespace shaka {
 
 ThreadEventBase::ThreadEventBase(const std::string& name)
-    : Waitable(name), provider_(nullptr) {}
+    : Waitable(name), provider_(nullptr), profile_entry_(nullptr) {}
 
 ThreadEventBase::~ThreadEventBase() {}
 
@@ -33,4 +33,18 @@ std::thread::id ThreadEventBase::GetProvider() const {
   return thread ? thread->get_id() : std::thread::id();
 }
 
+LockProfiler::Entry* ThreadEventBase::profile_entry() {
+  if (!LockProfiler::IsEnabled())
+    return nullptr;
+
+  // Look up the entry the first time it is needed since events are created
+  // often and most are never waited on.
+  LockProfiler::Entry* entry = profile_entry_.load(std::memory_order_acquire);
+  if (!entry) {
+    entry = LockProfiler::GetEntry(LockProfiler::Kind::Event, name());
+    profile_entry_.store(entry, std::memory_order_release);
+  }
+  return entry;
+}
+
 }  // namespace shaka
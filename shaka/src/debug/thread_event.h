@@ -22,6 +22,8 @@
 #include <string>
 #include <utility>
 
+#include "src/debug/lock_profiler.h"
+#include "src/debug/telemetry.h"
 #include "src/debug/waitable.h"
 #include "src/debug/waiting_tracker.h"
 #include "src/util/utils.h"
@@ -53,9 +55,17 @@ class ThreadEventBase : public Waitable {
 #endif
   }
 
+ protected:
+  /**
+   * @return The LockProfiler entry to record waits in, or nullptr if profiling
+   *   is disabled.
+   */
+  LockProfiler::Entry* profile_entry();
+
  private:
   const std::string name_;
   std::atomic<Thread*> provider_;
+  std::atomic<LockProfiler::Entry*> profile_entry_;
 };
 
 /**
@@ -83,6 +93,7 @@ class ThreadEvent final : public ThreadEventBase {
 #ifdef DEBUG_DEADLOCKS
     auto scope = WaitingTracker::ThreadWaiting(this);
 #endif
+    ProfiledWait profile(profile_entry());
     return future.get();
   }
 
@@ -117,6 +128,9 @@ class ThreadEvent final : public ThreadEventBase {
 #ifdef DEBUG_DEADLOCKS
     auto scope = WaitingTracker::ThreadWaiting(this);
 #endif
+    ProfiledWait profile(profile_entry());
+    future.wait();
+    Telemetry::OnWakeup();
     return future.get();
   }
 
@@ -0,0 +1,152 @@
+// Copyright 2020 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     https://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "src/debug/trace_event.h"
+
+#include <pthread.h>
+
+#include <mutex>
+#include <vector>
+
+namespace shaka {
+
+namespace {
+
+struct Event {
+  const char* category;
+  const char* name;
+  TraceRecorder::Phase phase;
+  uint32_t tid;
+  uint64_t start_us;
+  uint64_t duration_us;
+  uint64_t id;
+};
+
+struct Events {
+  std::mutex mutex;
+  // A ring buffer of events; once full, |next| is the oldest event.
+  std::vector<Event> events;
+  size_t next = 0;
+  // The names of the threads, indexed by the trace thread ID.
+  std::vector<std::string> thread_names;
+};
+
+Events* GetEvents() {
+  // This is never freed since events can still be added while exiting.
+  static Events* events = new Events;
+  return events;
+}
+
+/**
+ * @return The trace thread ID of the current thread.  This must be called
+ *   while holding the lock.
+ */
+uint32_t GetThreadId(Events* events) {
+  // 0 means not assigned yet, so the IDs start at 1.
+  thread_local uint32_t tid = 0;
+  if (tid == 0) {
+    char name[64] = {0};
+    pthread_getname_np(pthread_self(), name, sizeof(name));
+    events->thread_names.emplace_back(name);
+    tid = static_cast<uint32_t>(events->thread_names.size());
+  }
+  return tid;
+}
+
+void AppendEvent(const Event& event, std::string* out) {
+  out->append("{\"cat\":\"");
+  out->append(event.category);
+  out->append("\",\"name\":\"");
+  out->append(event.name);
+  out->append("\",\"ph\":\"");
+  out->push_back(static_cast<char>(event.phase));
+  out->append("\",\"pid\":0,\"tid\":");
+  out->append(std::to_string(event.tid));
+  out->append(",\"ts\":");
+  out->append(std::to_string(event.start_us));
+  if (event.phase == TraceRecorder::Phase::Complete) {
+    out->append(",\"dur\":");
+    out->append(std::to_string(event.duration_us));
+  } else {
+    // Bind the flow event to the enclosing slice.
+    out->append(",\"bp\":\"e\",\"id\":");
+    out->append(std::to_string(event.id));
+  }
+  out->push_back('}');
+}
+
+}  // namespace
+
+std::atomic<bool> TraceRecorder::enabled_{false};
+
+// static
+void TraceRecorder::SetEnabled(bool enabled) {
+  enabled_.store(enabled, std::memory_order_relaxed);
+}
+
+// static
+void TraceRecorder::AddEvent(const char* category, const char* name,
+                             Phase phase, uint64_t start_us,
+                             uint64_t duration_us, uint64_t id) {
+  Events* events = GetEvents();
+  std::unique_lock<std::mutex> lock(events->mutex);
+  const Event event = {category,    name, phase, GetThreadId(events), start_us,
+                       duration_us, id};
+  if (events->events.size() < kMaxEvents) {
+    events->events.emplace_back(event);
+  } else {
+    events->events[events->next] = event;
+    events->next = (events->next + 1) % kMaxEvents;
+  }
+}
+
+// static
+std::string TraceRecorder::GetChromeTraceJson() {
+  Events* events = GetEvents();
+  std::unique_lock<std::mutex> lock(events->mutex);
+
+  std::string ret = "{\"traceEvents\":[";
+  // Name the threads with metadata events.
+  for (size_t i = 0; i < events->thread_names.size(); i++) {
+    if (i > 0)
+      ret.push_back(',');
+    ret.append("{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":0,\"tid\":");
+    ret.append(std::to_string(i + 1));
+    ret.append(",\"args\":{\"name\":\"");
+    for (char c : events->thread_names[i]) {
+      // App threads can have any name, so drop characters that need escaping.
+      if (c != '"' && c != '\\' && static_cast<unsigned char>(c) >= 0x20)
+        ret.push_back(c);
+    }
+    ret.append("\"}}");
+  }
+  const size_t count = events->events.size();
+  for (size_t i = 0; i < count; i++) {
+    if (i > 0 || !events->thread_names.empty())
+      ret.push_back(',');
+    AppendEvent(events->events[(events->next + i) % count], &ret);
+  }
+  ret.append("],\"displayTimeUnit\":\"ms\"}");
+  return ret;
+}
+
+// static
+void TraceRecorder::Reset() {
+  Events* events = GetEvents();
+  std::unique_lock<std::mutex> lock(events->mutex);
+  events->events.clear();
+  events->next = 0;
+}
+
+}  // namespace shaka
@@ -0,0 +1,147 @@
+// Copyright 2020 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     https://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef SHAKA_EMBEDDED_DEBUG_TRACE_EVENT_H_
+#define SHAKA_EMBEDDED_DEBUG_TRACE_EVENT_H_
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <atomic>
+#include <string>
+
+#include "src/debug/duration_histogram.h"
+#include "src/util/macros.h"
+
+namespace shaka {
+
+/**
+ * Records trace events in the Chrome "Trace Event Format", which can be loaded
+ * in chrome://tracing or Perfetto.  Frames are followed through the pipeline
+ * with flow events, using the address of the frame as its ID.
+ *
+ * Recording is disabled by default; while disabled, each event only checks an
+ * atomic flag.  The events are kept in a fixed-size ring buffer, so only the
+ * most recent events are kept.  Use the TRACE_* macros instead of calling
+ * this directly so the events can be compiled out.
+ */
+class TraceRecorder {
+ public:
+  /** The maximum number of events to keep. */
+  static constexpr const size_t kMaxEvents = 256 * 1024;
+
+  enum class Phase : char {
+    Complete = 'X',
+    FlowBegin = 's',
+    FlowStep = 't',
+    FlowEnd = 'f',
+  };
+
+  static bool IsEnabled() {
+    return enabled_.load(std::memory_order_relaxed);
+  }
+
+  static void SetEnabled(bool enabled);
+
+  /** @return The current time, in microseconds. */
+  static uint64_t Now() {
+    return DurationHistogram::Now();
+  }
+
+  /** @return The flow ID to use for the given frame. */
+  static uint64_t FrameId(const void* frame) {
+    return reinterpret_cast<uintptr_t>(frame);
+  }
+
+  /**
+   * Adds an event for the current thread.  The category and name must be
+   * string literals since only the pointers are stored.
+   */
+  static void AddEvent(const char* category, const char* name, Phase phase,
+                       uint64_t start_us, uint64_t duration_us, uint64_t id);
+
+  /** @return The recorded events, in the Chrome trace event JSON format. */
+  static std::string GetChromeTraceJson();
+
+  /** Removes all the recorded events. */
+  static void Reset();
+
+ private:
+  TraceRecorder() {}
+
+  static std::atomic<bool> enabled_;
+};
+
+/** Adds a complete trace event that lasts as long as this object lives. */
+class ScopedTraceEvent {
+ public:
+  ScopedTraceEvent(const char* category, const char* name)
+      : category_(category),
+        name_(name),
+        start_(TraceRecorder::IsEnabled() ? TraceRecorder::Now() : 0) {}
+  ~ScopedTraceEvent() {
+    if (start_) {
+      TraceRecorder::AddEvent(category_, name_,
+                              TraceRecorder::Phase::Complete, start_,
+                              TraceRecorder::Now() - start_, 0);
+    }
+  }
+
+  SHAKA_NON_COPYABLE_OR_MOVABLE_TYPE(ScopedTraceEvent);
+
+ private:
+  const char* const category_;
+  const char* const name_;
+  const uint64_t start_;
+};
+
+}  // namespace shaka
+
+#ifdef ENABLE_TRACING
+#  define SHAKA_TRACE_CONCAT_INNER(a, b) a##b
+#  define SHAKA_TRACE_CONCAT(a, b) SHAKA_TRACE_CONCAT_INNER(a, b)
+
+/** Adds a trace event that lasts until the end of the current scope. */
+#  define TRACE_EVENT(category, name)                                       \
+    ::shaka::ScopedTraceEvent SHAKA_TRACE_CONCAT(trace_event_, __LINE__)(   \
+        category, name)
+
+/**
+ * Adds a frame flow event to the enclosing TRACE_EVENT.  The flow of a frame
+ * starts with TRACE_FRAME_BEGIN, continues with any number of
+ * TRACE_FRAME_STEP, and ends with TRACE_FRAME_END.
+ */
+#  define TRACE_FRAME_FLOW(phase, frame)                                    \
+    do {                                                                    \
+      if (::shaka::TraceRecorder::IsEnabled()) {                            \
+        ::shaka::TraceRecorder::AddEvent(                                   \
+            "frame", "frame", ::shaka::TraceRecorder::Phase::phase,         \
+            ::shaka::TraceRecorder::Now(), 0,                               \
+            ::shaka::TraceRecorder::FrameId(frame));                        \
+      }                                                                     \
+    } while (false)
+#else
+#  define TRACE_EVENT(category, name)                                       \
+    do {                                                                    \
+    } while (false)
+#  define TRACE_FRAME_FLOW(phase, frame)                                    \
+    do {                                                                    \
+    } while (false)
+#endif
+
+#define TRACE_FRAME_BEGIN(frame) TRACE_FRAME_FLOW(FlowBegin, frame)
+#define TRACE_FRAME_STEP(frame) TRACE_FRAME_FLOW(FlowStep, frame)
+#define TRACE_FRAME_END(frame) TRACE_FRAME_FLOW(FlowEnd, frame)
+
+#endif  // SHAKA_EMBEDDED_DEBUG_TRACE_EVENT_H_
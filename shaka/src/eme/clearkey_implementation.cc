@@ -117,8 +117,7 @@ bool ParsePssh(const Data& data, std::vector<std::string>* base64_keyids) {
         LOG(ERROR) << "Truncated init data";
         return false;
       }
-      base64_keyids->emplace_back(
-          js::Base64::EncodeUrl(ByteString(key_id, key_id + kKeyIdSize)));
+      base64_keyids->emplace_back(js::Base64::EncodeUrl(key_id, kKeyIdSize));
     }
     return true;
   }
@@ -128,15 +127,15 @@ bool ParsePssh(const Data& data, std::vector<std::string>* base64_keyids) {
 }
 
 bool ParseAndGenerateRequest(MediaKeyInitDataType type, const Data& data,
+                             std::vector<std::string>* key_ids,
                              std::string* message) {
-  std::vector<std::string> key_ids;
   switch (type) {
     case MediaKeyInitDataType::KeyIds:
-      if (!ParseKeyIds(data, &key_ids))
+      if (!ParseKeyIds(data, key_ids))
         return false;
       break;
     case MediaKeyInitDataType::Cenc:
-      if (!ParsePssh(data, &key_ids))
+      if (!ParsePssh(data, key_ids))
         return false;
       break;
 
@@ -146,7 +145,7 @@ bool ParseAndGenerateRequest(MediaKeyInitDataType type, const Data& data,
   }
 
   std::string ids_json;
-  for (const std::string& id : key_ids) {
+  for (const std::string& id : *key_ids) {
     if (ids_json.empty())
       ids_json = '"' + id + '"';
     else
@@ -156,9 +155,10 @@ bool ParseAndGenerateRequest(MediaKeyInitDataType type, const Data& data,
   return true;
 }
 
-// This needs to be a template to access the private type |Session::Key|.
+// This needs to be a template to access the private type |Key|.
 template <typename KeyType>
-bool ParseResponse(const Data& data, std::list<KeyType>* keys) {
+bool ParseResponse(const Data& data,
+                   std::list<std::shared_ptr<const KeyType>>* keys) {
   LocalVar<JsValue> data_val =
       ParseJsonString(std::string(data.data(), data.data() + data.size()));
   if (!IsObject(data_val)) {
@@ -202,8 +202,8 @@ bool ParseResponse(const Data& data, std::list<KeyType>* keys) {
       LOG(ERROR) << "Key or key ID is not correct size.";
       return false;
     }
-    keys->emplace_back(std::move(get<ByteString>(kid)),
-                       std::move(get<ByteString>(k)));
+    keys->emplace_back(new KeyType(std::move(get<ByteString>(kid)),
+                                   std::move(get<ByteString>(k))));
   }
 
   return true;
@@ -212,7 +212,11 @@ bool ParseResponse(const Data& data, std::list<KeyType>* keys) {
 }  // namespace
 
 ClearKeyImplementation::ClearKeyImplementation(ImplementationHelper* helper)
-    : helper_(helper), cur_session_id_(0) {}
+    : ImplementationExtensions(this),
+      key_index_(new KeyIndex),
+      helper_(helper),
+      cur_session_id_(0),
+      key_cache_loaded_(false) {}
 ClearKeyImplementation::~ClearKeyImplementation() {}
 
 bool ClearKeyImplementation::GetExpiration(const std::string& session_id,
@@ -229,7 +233,7 @@ bool ClearKeyImplementation::GetKeyStatuses(
 
   statuses->clear();
   for (auto& key : sessions_.at(session_id).keys)
-    statuses->emplace_back(key.key_id, MediaKeyStatus::Usable);
+    statuses->emplace_back(key->key_id, MediaKeyStatus::Usable);
   return true;
 }
 
@@ -251,13 +255,39 @@ void ClearKeyImplementation::CreateSessionAndGenerateRequest(
   Session* session = &sessions_[session_id];
   DCHECK(!session->callable);
 
+  std::vector<std::string> key_ids;
   std::string message;
-  if (!ParseAndGenerateRequest(init_data_type, data, &message)) {
+  if (!ParseAndGenerateRequest(init_data_type, data, &key_ids, &message)) {
     promise.Reject(ExceptionType::TypeError,
                    "Invalid initialization data given.");
     return;
   }
 
+  // If we already have all the keys from an earlier license, use them and
+  // skip the license request entirely.
+  LoadKeyCacheIfNeeded();
+  std::list<std::shared_ptr<const Key>> cached_keys;
+  for (const std::string& id : key_ids) {
+    ExceptionOr<ByteString> key_id = js::Base64::DecodeUrl(id);
+    std::vector<uint8_t> key;
+    if (holds_alternative<js::JsError>(key_id) ||
+        !key_cache_.Get(get<ByteString>(key_id), &key)) {
+      cached_keys.clear();
+      break;
+    }
+    cached_keys.emplace_back(
+        new Key(std::move(get<ByteString>(key_id)), std::move(key)));
+  }
+  if (!cached_keys.empty()) {
+    VLOG(1) << "Using cached keys for session " << session_id;
+    session->keys = std::move(cached_keys);
+    UpdateKeyIndex();
+    set_session_id(session_id);
+    helper_->OnKeyStatusChange(session_id);
+    promise.Resolve();
+    return;
+  }
+
   session->callable = true;
   set_session_id(session_id);
   helper_->OnMessage(session_id, MediaKeyMessageType::LicenseRequest,
@@ -288,15 +318,20 @@ void ClearKeyImplementation::Update(const std::string& session_id,
     return;
   }
 
-  std::list<Session::Key> keys;
+  std::list<std::shared_ptr<const Key>> keys;
   if (!ParseResponse(data, &keys)) {
     promise.Reject(ExceptionType::InvalidState, "Invalid response data.");
     return;
   }
 
   session->callable = false;
+  LoadKeyCacheIfNeeded();
+  for (auto& key : keys)
+    key_cache_.Put(key->key_id, key->key);
+  key_cache_.Save();
   // Move all keys into the session.
   session->keys.splice(session->keys.end(), std::move(keys));
+  UpdateKeyIndex();
   helper_->OnKeyStatusChange(session_id);
   promise.Resolve();
 }
@@ -305,6 +340,7 @@ void ClearKeyImplementation::Close(const std::string& session_id,
                                    EmePromise promise) {
   std::unique_lock<std::mutex> lock(mutex_);
   sessions_.erase(session_id);
+  UpdateKeyIndex();
   promise.Resolve();
 }
 
@@ -318,26 +354,93 @@ DecryptStatus ClearKeyImplementation::Decrypt(const FrameEncryptionInfo* info,
                                               const uint8_t* data,
                                               size_t data_size,
                                               uint8_t* dest) const {
+  // The index holds a reference to the keys, so they stay alive while
+  // decrypting even if the session is closed.
+  std::shared_ptr<const KeyIndex> index = std::atomic_load(&key_index_);
+  return DecryptWithKey(FindKey(*index, info->key_id), info, data, data_size,
+                        dest);
+}
+
+void ClearKeyImplementation::DecryptSamples(DecryptSample* samples,
+                                            size_t count) const {
+  std::shared_ptr<const KeyIndex> index = std::atomic_load(&key_index_);
+  // Frames from the same stream usually share a key, so only look up the key
+  // when it changes.
+  const Key* key = nullptr;
+  for (size_t i = 0; i < count; i++) {
+    const FrameEncryptionInfo* info = samples[i].info;
+    if (!key || key->key_id != info->key_id)
+      key = FindKey(*index, info->key_id);
+    samples[i].status = DecryptWithKey(key, info, samples[i].data,
+                                       samples[i].data_size, samples[i].dest);
+  }
+}
+
+void ClearKeyImplementation::PrefetchLicense(
+    MediaKeyInitDataType /* init_data_type */, const uint8_t* /* data */,
+    size_t /* data_size */) const {
+  // Generating the request is cheap, but loading the stored keys reads and
+  // decrypts a file; do that now so generateRequest doesn't wait for it.
   std::unique_lock<std::mutex> lock(mutex_);
+  LoadKeyCacheIfNeeded();
+}
 
-  const std::vector<uint8_t>* key = nullptr;
+void ClearKeyImplementation::LoadKeyCacheIfNeeded() const {
+  if (!key_cache_loaded_ && helper_)
+    key_cache_.SetDirectory(helper_->DataPathPrefix());
+  key_cache_loaded_ = true;
+}
+
+void ClearKeyImplementation::UpdateKeyIndex() {
+  std::shared_ptr<KeyIndex> index(new KeyIndex);
   for (auto& session_pair : sessions_) {
-    for (auto& cur_key : session_pair.second.keys) {
-      if (cur_key.key_id == info->key_id) {
-        key = &cur_key.key;
-        break;
-      }
-    }
+    for (auto& key : session_pair.second.keys)
+      index->emplace(key->key_id, key);
   }
+  std::atomic_store(&key_index_, std::shared_ptr<const KeyIndex>(index));
+}
+
+const ClearKeyImplementation::Key* ClearKeyImplementation::FindKey(
+    const KeyIndex& index, const std::vector<uint8_t>& key_id) {
+  auto it = index.find(key_id);
+  return it != index.end() ? it->second.get() : nullptr;
+}
+
+DecryptStatus ClearKeyImplementation::DecryptWithKey(
+    const Key* key, const FrameEncryptionInfo* info, const uint8_t* data,
+    size_t data_size, uint8_t* dest) const {
   if (!key) {
     LOG(ERROR) << "Unable to find key ID: "
                << util::ToHexString(info->key_id.data(), info->key_id.size());
     return DecryptStatus::KeyNotFound;
   }
 
-  util::Decryptor decryptor(info->scheme, *key, info->iv);
+  std::unique_ptr<util::Decryptor> decryptor;
+  {
+    std::unique_lock<std::mutex> lock(key->decryptors_mutex);
+    if (!key->decryptors.empty()) {
+      decryptor = std::move(key->decryptors.back());
+      key->decryptors.pop_back();
+    }
+  }
+  if (!decryptor || decryptor->scheme() != info->scheme) {
+    decryptor.reset(new util::Decryptor(info->scheme, key->key, info->iv));
+  } else if (!decryptor->ResetIv(info->iv)) {
+    return DecryptStatus::OtherError;
+  }
+
+  const DecryptStatus ret =
+      DecryptSubsamples(info, data, data_size, dest, decryptor.get());
+  std::unique_lock<std::mutex> lock(key->decryptors_mutex);
+  key->decryptors.emplace_back(std::move(decryptor));
+  return ret;
+}
+
+DecryptStatus ClearKeyImplementation::DecryptSubsamples(
+    const FrameEncryptionInfo* info, const uint8_t* data, size_t data_size,
+    uint8_t* dest, util::Decryptor* decryptor) const {
   if (info->subsamples.empty()) {
-    return DecryptBlock(info, data, data_size, 0, dest, &decryptor);
+    return DecryptBlock(info, data, data_size, 0, dest, decryptor);
   } else {
     size_t block_offset = 0;
     for (const auto& subsample : info->subsamples) {
@@ -347,15 +450,17 @@ DecryptStatus ClearKeyImplementation::Decrypt(const FrameEncryptionInfo* info,
         return DecryptStatus::OtherError;
       }
 
-      // The clear portion appears first.
-      memcpy(dest, data, subsample.clear_bytes);
+      // The clear portion appears first.  This may be decrypting in place, in
+      // which case there is nothing to copy.
+      if (dest != data)
+        memcpy(dest, data, subsample.clear_bytes);
       data += subsample.clear_bytes;
       dest += subsample.clear_bytes;
       data_size -= subsample.clear_bytes;
 
       // Then the encrypted portion.
       const auto ret = DecryptBlock(info, data, subsample.protected_bytes,
-                                    block_offset, dest, &decryptor);
+                                    block_offset, dest, decryptor);
       if (ret != DecryptStatus::Success)
         return ret;
       data += subsample.protected_bytes;
@@ -392,36 +497,12 @@ DecryptStatus ClearKeyImplementation::DecryptBlock(
   }
 
   if (info->pattern.clear_blocks != 0) {
-    const size_t protected_size =
-        AES_BLOCK_SIZE * info->pattern.encrypted_blocks;
-    const size_t clear_size = AES_BLOCK_SIZE * info->pattern.clear_blocks;
-    const size_t pattern_size_in_blocks =
-        info->pattern.encrypted_blocks + info->pattern.clear_blocks;
-    const size_t data_size_in_blocks = data_size / AES_BLOCK_SIZE;
-    for (size_t i = 0; i < data_size_in_blocks / pattern_size_in_blocks; i++) {
-      if (!decryptor->Decrypt(data + num_bytes_read, protected_size,
-                              dest + num_bytes_read)) {
-        return DecryptStatus::OtherError;
-      }
-      num_bytes_read += protected_size;
-
-      memcpy(dest + num_bytes_read, data + num_bytes_read, clear_size);
-      num_bytes_read += clear_size;
-    }
-
-    // If the last pattern block isn't big enough for the whole
-    // encrypted_blocks, then it is ignored.
-    if (data_size_in_blocks % pattern_size_in_blocks >=
-        info->pattern.encrypted_blocks) {
-      if (!decryptor->Decrypt(data + num_bytes_read, protected_size,
-                              dest + num_bytes_read)) {
-        return DecryptStatus::OtherError;
-      }
-      num_bytes_read += protected_size;
+    if (!decryptor->DecryptPattern(
+            data + num_bytes_read, data_size - num_bytes_read,
+            info->pattern.encrypted_blocks, info->pattern.clear_blocks,
+            dest + num_bytes_read)) {
+      return DecryptStatus::OtherError;
     }
-
-    memcpy(dest + num_bytes_read, data + num_bytes_read,
-           data_size - num_bytes_read);
   } else {
     if (!decryptor->Decrypt(data + num_bytes_read, data_size - num_bytes_read,
                             dest + num_bytes_read)) {
@@ -437,13 +518,26 @@ void ClearKeyImplementation::LoadKeyForTesting(std::vector<uint8_t> key_id,
   std::unique_lock<std::mutex> lock(mutex_);
   const std::string session_id = std::to_string(++cur_session_id_);
   sessions_.emplace(session_id, Session());
-  sessions_.at(session_id).keys.emplace_back(std::move(key_id), std::move(key));
+  sessions_.at(session_id).keys.emplace_back(
+      new Key(std::move(key_id), std::move(key)));
+  UpdateKeyIndex();
 }
 
-ClearKeyImplementation::Session::Key::Key(std::vector<uint8_t> key_id,
-                                          std::vector<uint8_t> key)
+ClearKeyImplementation::Key::Key(std::vector<uint8_t> key_id,
+                                 std::vector<uint8_t> key)
     : key_id(std::move(key_id)), key(std::move(key)) {}
-ClearKeyImplementation::Session::Key::~Key() {}
+ClearKeyImplementation::Key::~Key() {}
+
+size_t ClearKeyImplementation::KeyIdHash::operator()(
+    const std::vector<uint8_t>& key_id) const {
+  // FNV-1a; key IDs are short and usually random, so this spreads them well.
+  uint64_t hash = 14695981039346656037ull;
+  for (uint8_t byte : key_id) {
+    hash ^= byte;
+    hash *= 1099511628211ull;
+  }
+  return static_cast<size_t>(hash);
+}
 
 ClearKeyImplementation::Session::Session() {}
 ClearKeyImplementation::Session::~Session() {}
@@ -16,6 +16,7 @@
 #define SHAKA_EMBEDDED_EME_CLEARKEY_FACTORY_H_
 
 #include <list>
+#include <memory>
 #include <mutex>
 #include <string>
 #include <unordered_map>
@@ -23,12 +24,18 @@
 
 #include "shaka/eme/implementation.h"
 #include "shaka/eme/implementation_helper.h"
+#include "src/eme/clearkey_key_cache.h"
+#include "src/eme/implementation_extensions.h"
 #include "src/util/decryptor.h"
 
 #define AES_BLOCK_SIZE 16u
 
 namespace shaka {
 
+namespace benchmark {
+class DecryptBenchmark;
+}  // namespace benchmark
+
 namespace media {
 class DecoderIntegration;
 class DecoderDecryptIntegration;
@@ -36,7 +43,8 @@ class DecoderDecryptIntegration;
 
 namespace eme {
 
-class ClearKeyImplementation final : public Implementation {
+class ClearKeyImplementation final : public Implementation,
+                                     public ImplementationExtensions {
  public:
   explicit ClearKeyImplementation(ImplementationHelper* helper);
   ~ClearKeyImplementation() override;
@@ -66,18 +74,35 @@ class ClearKeyImplementation final : public Implementation {
 
   DecryptStatus Decrypt(const FrameEncryptionInfo* info, const uint8_t* data,
                         size_t data_size, uint8_t* dest) const override;
+  void DecryptSamples(DecryptSample* samples, size_t count) const override;
+  void PrefetchLicense(MediaKeyInitDataType init_data_type,
+                       const uint8_t* data, size_t data_size) const override;
 
  private:
-  struct Session {
-    struct Key {
-      Key(std::vector<uint8_t> key_id, std::vector<uint8_t> key);
-      ~Key();
+  struct Key {
+    Key(std::vector<uint8_t> key_id, std::vector<uint8_t> key);
+    ~Key();
+
+    const std::vector<uint8_t> key_id;
+    const std::vector<uint8_t> key;  // This contains the raw AES key.
+
+    // Cached decryptors for this key.  These are reused between frames so the
+    // key is only expanded once.  Each decrypt takes one out of the list while
+    // it runs, so frames from different streams can be decrypted in parallel;
+    // |decryptors_mutex| is only held to take and return them.
+    mutable std::mutex decryptors_mutex;
+    mutable std::vector<std::unique_ptr<util::Decryptor>> decryptors;
+  };
 
-      // TODO: Consider storing keys in OpenSSL key objects instead.
-      std::vector<uint8_t> key_id;
-      std::vector<uint8_t> key;  // This contains the raw AES key.
-    };
+  struct KeyIdHash {
+    size_t operator()(const std::vector<uint8_t>& key_id) const;
+  };
+
+  /** Maps a key ID to the key; this is never changed once published. */
+  using KeyIndex = std::unordered_map<std::vector<uint8_t>,
+                                      std::shared_ptr<const Key>, KeyIdHash>;
 
+  struct Session {
     Session();
     ~Session();
 
@@ -86,14 +111,37 @@ class ClearKeyImplementation final : public Implementation {
     Session& operator=(Session&&);
     Session& operator=(const Session&) = delete;
 
-    std::list<Key> keys;
+    std::list<std::shared_ptr<const Key>> keys;
     bool callable = false;
   };
 
   friend class ClearKeyImplementationTest;
+  friend class benchmark::DecryptBenchmark;
   friend class media::DecoderIntegration;
   friend class media::DecoderDecryptIntegration;
 
+  /** Loads the stored keys the first time the cache is needed. */
+  void LoadKeyCacheIfNeeded() const;
+
+  /**
+   * Publishes a new key index for the current sessions.  This must be called
+   * with |mutex_| held whenever the keys change.
+   */
+  void UpdateKeyIndex();
+
+  /** @return The key with the given ID, or nullptr if not found. */
+  static const Key* FindKey(const KeyIndex& index,
+                            const std::vector<uint8_t>& key_id);
+
+  DecryptStatus DecryptWithKey(const Key* key, const FrameEncryptionInfo* info,
+                               const uint8_t* data, size_t data_size,
+                               uint8_t* dest) const;
+
+  DecryptStatus DecryptSubsamples(const FrameEncryptionInfo* info,
+                                  const uint8_t* data, size_t data_size,
+                                  uint8_t* dest,
+                                  util::Decryptor* decryptor) const;
+
   DecryptStatus DecryptBlock(const FrameEncryptionInfo* info,
                              const uint8_t* data, size_t data_size,
                              size_t block_offset, uint8_t* dest,
@@ -101,10 +149,18 @@ class ClearKeyImplementation final : public Implementation {
 
   void LoadKeyForTesting(std::vector<uint8_t> key_id, std::vector<uint8_t> key);
 
+  // This guards the sessions; decrypting doesn't use it.
   mutable std::mutex mutex_;
   std::unordered_map<std::string, Session> sessions_;
+  // The keys of all the sessions.  This is only accessed with
+  // std::atomic_load/atomic_store so it can be read without a lock.
+  std::shared_ptr<const KeyIndex> key_index_;
   ImplementationHelper* helper_;
   uint32_t cur_session_id_;
+  // Keys from earlier licenses; these are only loaded when first needed since
+  // the helper can't be used in the constructor.  Guarded by |mutex_|.
+  mutable ClearKeyKeyCache key_cache_;
+  mutable bool key_cache_loaded_;
 };
 
 }  // namespace eme
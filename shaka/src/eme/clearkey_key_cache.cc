@@ -0,0 +1,124 @@
+// Copyright 2020 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     https://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "src/eme/clearkey_key_cache.h"
+
+#include <glog/logging.h>
+#include <string.h>
+
+#include "src/util/file_system.h"
+
+namespace shaka {
+namespace eme {
+
+namespace {
+
+constexpr const char kKeysFile[] = "clearkey_keys";
+/** The key used by older versions to obfuscate the keys file. */
+constexpr const char kOldStorageKeyFile[] = "clearkey_keys.secret";
+/** The start of the file, used to detect files in another format. */
+constexpr const uint8_t kMagic[] = {'s', 'h', 'a', 'k', 'a', '-', 'k', 'e',
+                                    'y', 'c', 'a', 'c', 'h', 'e', '-', '2'};
+constexpr const size_t kKeySize = 16;
+
+}  // namespace
+
+ClearKeyKeyCache::ClearKeyKeyCache() {}
+ClearKeyKeyCache::~ClearKeyKeyCache() {}
+
+void ClearKeyKeyCache::SetDirectory(const std::string& dir) {
+  dir_ = dir;
+  Load();
+}
+
+bool ClearKeyKeyCache::Get(const std::vector<uint8_t>& key_id,
+                           std::vector<uint8_t>* key) const {
+  for (auto& pair : keys_) {
+    if (pair.first == key_id) {
+      *key = pair.second;
+      return true;
+    }
+  }
+  return false;
+}
+
+void ClearKeyKeyCache::Put(const std::vector<uint8_t>& key_id,
+                           const std::vector<uint8_t>& key) {
+  if (key_id.size() != kKeySize || key.size() != kKeySize)
+    return;
+
+  for (auto it = keys_.begin(); it != keys_.end(); it++) {
+    if (it->first == key_id) {
+      keys_.erase(it);
+      break;
+    }
+  }
+  keys_.emplace_back(key_id, key);
+  while (keys_.size() > kMaxKeys)
+    keys_.pop_front();
+}
+
+void ClearKeyKeyCache::Save() const {
+  if (dir_.empty())
+    return;
+
+  util::FileSystem fs;
+  if (!fs.DirectoryExists(dir_) && !fs.CreateDirectory(dir_)) {
+    LOG(WARNING) << "Unable to create clear-key cache directory";
+    return;
+  }
+
+  std::vector<uint8_t> data(kMagic, kMagic + sizeof(kMagic));
+  for (auto& pair : keys_) {
+    data.insert(data.end(), pair.first.begin(), pair.first.end());
+    data.insert(data.end(), pair.second.begin(), pair.second.end());
+  }
+  if (!fs.WritePrivateFile(util::FileSystem::PathJoin(dir_, kKeysFile), data))
+    LOG(WARNING) << "Unable to write clear-key cache";
+
+  const std::string old_path =
+      util::FileSystem::PathJoin(dir_, kOldStorageKeyFile);
+  if (fs.FileExists(old_path) && !fs.DeleteFile(old_path))
+    LOG(WARNING) << "Unable to delete old clear-key cache secret";
+}
+
+void ClearKeyKeyCache::Load() {
+  if (dir_.empty())
+    return;
+
+  util::FileSystem fs;
+  const std::string path = util::FileSystem::PathJoin(dir_, kKeysFile);
+  std::vector<uint8_t> data;
+  if (!fs.FileExists(path) || !fs.ReadFile(path, &data))
+    return;
+
+  // The file is the magic followed by entries of the key ID followed by the
+  // key.  Files from older versions have a different magic and are ignored.
+  if (data.size() < sizeof(kMagic) ||
+      (data.size() - sizeof(kMagic)) % (2 * kKeySize) != 0 ||
+      memcmp(data.data(), kMagic, sizeof(kMagic)) != 0) {
+    LOG(WARNING) << "Ignoring invalid clear-key cache";
+    return;
+  }
+
+  keys_.clear();
+  for (size_t i = sizeof(kMagic); i < data.size(); i += 2 * kKeySize) {
+    const auto start = data.begin() + i;
+    Put(std::vector<uint8_t>(start, start + kKeySize),
+        std::vector<uint8_t>(start + kKeySize, start + 2 * kKeySize));
+  }
+}
+
+}  // namespace eme
+}  // namespace shaka
@@ -0,0 +1,82 @@
+// Copyright 2020 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     https://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef SHAKA_EMBEDDED_EME_CLEARKEY_KEY_CACHE_H_
+#define SHAKA_EMBEDDED_EME_CLEARKEY_KEY_CACHE_H_
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <list>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "src/util/macros.h"
+
+namespace shaka {
+namespace eme {
+
+/**
+ * Stores the clear-key keys from earlier license responses so a later session
+ * for the same key IDs (e.g. re-watching content, or another period using the
+ * same keys) can be satisfied without a license request.
+ *
+ * The keys are stored unencrypted in a file in the given directory.  The file
+ * is only readable by the current user (mode 0600); anything that can read
+ * the app's data directory as that user can read the keys.  Apps that need
+ * more protection shouldn't give a data path to the CDM.
+ *
+ * This type is not thread-safe.
+ */
+class ClearKeyKeyCache final {
+ public:
+  /** The maximum number of keys to store; the oldest keys are dropped. */
+  static constexpr const size_t kMaxKeys = 256;
+
+  ClearKeyKeyCache();
+  ~ClearKeyKeyCache();
+
+  SHAKA_NON_COPYABLE_OR_MOVABLE_TYPE(ClearKeyKeyCache);
+
+  /**
+   * Loads the keys stored in the given directory and stores new keys there.
+   * If this is empty, keys are only cached in memory.
+   */
+  void SetDirectory(const std::string& dir);
+
+  /**
+   * Gets the key with the given key ID.
+   * @return True if the key was found, false otherwise.
+   */
+  bool Get(const std::vector<uint8_t>& key_id, std::vector<uint8_t>* key) const;
+
+  /** Adds the given (key ID, key) pair, replacing any existing key. */
+  void Put(const std::vector<uint8_t>& key_id, const std::vector<uint8_t>& key);
+
+  /** Writes the keys to the file, if there is one. */
+  void Save() const;
+
+ private:
+  void Load();
+
+  std::string dir_;
+  // Ordered from oldest to newest.
+  std::list<std::pair<std::vector<uint8_t>, std::vector<uint8_t>>> keys_;
+};
+
+}  // namespace eme
+}  // namespace shaka
+
+#endif  // SHAKA_EMBEDDED_EME_CLEARKEY_KEY_CACHE_H_
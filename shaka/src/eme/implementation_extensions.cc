@@ -0,0 +1,79 @@
+// Copyright 2020 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     https://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "src/eme/implementation_extensions.h"
+
+#include <glog/logging.h>
+
+#include <mutex>
+#include <unordered_map>
+
+namespace shaka {
+namespace eme {
+
+namespace {
+
+struct Registry {
+  std::mutex mutex;
+  std::unordered_map<const Implementation*, const ImplementationExtensions*>
+      map;
+};
+
+Registry* GetRegistry() {
+  // This is never freed since CDMs can still be destroyed while exiting.
+  static Registry* registry = new Registry;
+  return registry;
+}
+
+}  // namespace
+
+ImplementationExtensions::ImplementationExtensions(
+    const Implementation* implementation)
+    : implementation_(implementation) {
+  Registry* registry = GetRegistry();
+  std::unique_lock<std::mutex> lock(registry->mutex);
+  const bool added = registry->map.emplace(implementation, this).second;
+  DCHECK(added) << "Implementation registered twice";
+}
+
+ImplementationExtensions::~ImplementationExtensions() {
+  Registry* registry = GetRegistry();
+  std::unique_lock<std::mutex> lock(registry->mutex);
+  registry->map.erase(implementation_);
+}
+
+// static
+const ImplementationExtensions* ImplementationExtensions::Get(
+    const Implementation* implementation) {
+  if (!implementation)
+    return nullptr;
+
+  Registry* registry = GetRegistry();
+  std::unique_lock<std::mutex> lock(registry->mutex);
+  auto it = registry->map.find(implementation);
+  return it != registry->map.end() ? it->second : nullptr;
+}
+
+DecryptStatus ImplementationExtensions::DecryptToSecureBuffer(
+    const FrameEncryptionInfo* info, const uint8_t* data, size_t data_size,
+    const SecureBuffer& dest) const {
+  return DecryptStatus::NotSupported;
+}
+
+void ImplementationExtensions::PrefetchLicense(
+    MediaKeyInitDataType init_data_type, const uint8_t* data,
+    size_t data_size) const {}
+
+}  // namespace eme
+}  // namespace shaka
@@ -0,0 +1,158 @@
+// Copyright 2020 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     https://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef SHAKA_EMBEDDED_EME_IMPLEMENTATION_EXTENSIONS_H_
+#define SHAKA_EMBEDDED_EME_IMPLEMENTATION_EXTENSIONS_H_
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "shaka/eme/configuration.h"
+#include "shaka/eme/implementation.h"
+#include "src/util/macros.h"
+
+namespace shaka {
+namespace eme {
+
+/**
+ * Defines a single frame to decrypt as part of a batch.  See
+ * ImplementationExtensions::DecryptSamples.
+ */
+struct DecryptSample final {
+  /** Contains information about how the frame is encrypted. */
+  const FrameEncryptionInfo* info;
+  /** The data to decrypt. */
+  const uint8_t* data;
+  /** The size of |data|. */
+  size_t data_size;
+  /** The destination buffer; this has the same rules as in Decrypt(). */
+  uint8_t* dest;
+  /** [OUT] Will contain the result of decrypting this frame. */
+  DecryptStatus status;
+};
+
+/**
+ * Refers to a buffer in protected memory that the CPU can't read, like an
+ * input buffer of a secure hardware decoder.  The handle is defined by the
+ * platform (e.g. a native buffer object or a file descriptor), so the CDM and
+ * the decoder need to agree on what it is.  See
+ * ImplementationExtensions::DecryptToSecureBuffer.
+ */
+struct SecureBuffer final {
+  /** The platform handle to the buffer. */
+  void* handle;
+  /** The offset, in bytes, in the buffer to write the frame to. */
+  size_t offset;
+  /** The number of bytes that can be written, starting at |offset|. */
+  size_t size;
+};
+
+/**
+ * Defines extra operations that the built-in EME implementations support.
+ *
+ * Implementation is subclassed by apps, so it can't gain new virtual methods
+ * without breaking ABI compatibility.  Instead, built-in implementations also
+ * derive from this type and register themselves here, so the media pipeline
+ * can find the extensions for a CDM.  We don't have RTTI, so this can't use
+ * dynamic_cast.  App implementations are never registered, so they only get
+ * the calls from Implementation.
+ *
+ * Implementations that have extensions also allow decrypting "cenc" frames in
+ * place: |dest| in Implementation::Decrypt() can be the same as |data|.  In
+ * that case, the data must not be changed if Decrypt() returns KeyNotFound, so
+ * the frame can be decrypted again once the key is added.
+ */
+class ImplementationExtensions {
+ public:
+  /**
+   * Registers the extensions for the given implementation; this is normally
+   * the object that derives from this.  It is unregistered when this is
+   * destroyed.
+   */
+  explicit ImplementationExtensions(const Implementation* implementation);
+  virtual ~ImplementationExtensions();
+
+  SHAKA_NON_COPYABLE_OR_MOVABLE_TYPE(ImplementationExtensions);
+
+  /**
+   * @return The extensions for the given implementation, or nullptr if it
+   *   doesn't have any (e.g. it is from the app).
+   */
+  static const ImplementationExtensions* Get(
+      const Implementation* implementation);
+
+  /**
+   * Decrypts several frames in one call.  This is used to decrypt frames that
+   * are buffered ahead of the decoder, so implementations can share work
+   * between them (e.g. key lookups or cipher setup).  Each frame is handled
+   * the same as in Implementation::Decrypt() and the result is stored in its
+   * |status| field; a failure for one frame doesn't affect the others.
+   *
+   * This can be called from any thread, like Decrypt().
+   *
+   * @param samples The frames to decrypt.
+   * @param count The number of elements in |samples|.
+   */
+  virtual void DecryptSamples(DecryptSample* samples, size_t count) const = 0;
+
+  /**
+   * Decrypts the given data into protected memory that is given straight to a
+   * secure decoder.  This is needed for CDMs whose keys can't be used to
+   * decrypt into normal memory (e.g. hardware-backed CDMs) and avoids copying
+   * the clear frame.  The whole frame is written to the buffer, including the
+   * clear portions.  This is only called by decoders that can read from
+   * secure buffers, which output frames as PixelFormat::SecureSurface.
+   *
+   * This is optional; by default this returns NotSupported, in which case the
+   * decoder uses Implementation::Decrypt() instead.
+   *
+   * @param info Contains information about how the frame is encrypted.  If
+   *   this is nullptr, the frame is clear and only needs to be copied into the
+   *   buffer.
+   * @param data The data to decrypt.
+   * @param data_size The size of |data|.
+   * @param dest The buffer to write the frame to.  Has room for at least
+   *   |data_size| bytes.
+   * @returns The resulting status code.
+   */
+  virtual DecryptStatus DecryptToSecureBuffer(const FrameEncryptionInfo* info,
+                                              const uint8_t* data,
+                                              size_t data_size,
+                                              const SecureBuffer& dest) const;
+
+  /**
+   * Called when the media contains new initialization data, before the
+   * "encrypted" event is raised for it.  This allows the implementation to
+   * start work for the license request (e.g. loading stored keys) before the
+   * app calls generateRequest.  This doesn't create a session and the app
+   * still needs to create one to use the keys.
+   *
+   * This is optional; by default this does nothing.  This is called on the
+   * JS main thread.
+   *
+   * @param init_data_type The type of the initialization data.
+   * @param data The initialization data.
+   * @param data_size The size of |data|.
+   */
+  virtual void PrefetchLicense(MediaKeyInitDataType init_data_type,
+                               const uint8_t* data, size_t data_size) const;
+
+ private:
+  const Implementation* const implementation_;
+};
+
+}  // namespace eme
+}  // namespace shaka
+
+#endif  // SHAKA_EMBEDDED_EME_IMPLEMENTATION_EXTENSIONS_H_
@@ -14,6 +14,16 @@
 
 #include "src/js/base_64.h"
 
+#include <string.h>
+
+#if defined(__SSSE3__)
+#  include <tmmintrin.h>
+#  define USE_SSSE3
+#elif defined(__aarch64__) && defined(__ARM_NEON)
+#  include <arm_neon.h>
+#  define USE_NEON
+#endif
+
 #include "src/js/js_error.h"
 #include "src/mapping/register_member.h"
 
@@ -23,7 +33,9 @@ namespace js {
 namespace {
 
 constexpr const char kCodes[] =
-    "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/=";
+    "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+constexpr const char kUrlCodes[] =
+    "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789-_";
 
 // Gets the low |n| bits of |in|.
 #define GET_LOW_BITS(in, n) ((in) & ((1 << (n)) - 1))
@@ -32,11 +44,19 @@ constexpr const char kCodes[] =
 // Calculates a/b using round-up division (only works for positive numbers).
 #define CEIL_DIVIDE(a, b) ((((a)-1) / (b)) + 1)
 
-int32_t DecodeChar(char c) {
-  const char* it = strchr(kCodes, c);
-  if (it == nullptr)
-    return -1;
-  return it - kCodes;
+/** @return The 6-bit value of the given character, or -1 if invalid. */
+int32_t DecodeChar(char c, const char* codes) {
+  if (c >= 'A' && c <= 'Z')
+    return c - 'A';
+  if (c >= 'a' && c <= 'z')
+    return c - 'a' + 26;
+  if (c >= '0' && c <= '9')
+    return c - '0' + 52;
+  if (c == codes[62])
+    return 62;
+  if (c == codes[63])
+    return 63;
+  return -1;
 }
 
 JsError BadEncoding() {
@@ -44,73 +64,241 @@ JsError BadEncoding() {
       "The string to be decoded is not correctly encoded.");
 }
 
-}  // namespace
+/**
+ * Encodes whole 3-byte groups from the start of |input| using vector
+ * instructions.
+ * @return The number of input bytes consumed; this is a multiple of 3.
+ */
+size_t EncodeBlocks(const uint8_t* input, size_t size, const char* codes,
+                    char* output) {
+  size_t i = 0;
+#if defined(USE_SSSE3)
+  // See http://0x80.pl/notesen/2016-01-12-sse-base64-encoding.html.  Each
+  // iteration converts 12 bytes to 16 characters, but reads 16 bytes.
+  const __m128i shuffle =
+      _mm_set_epi8(10, 11, 9, 10, 7, 8, 6, 7, 4, 5, 3, 4, 1, 2, 0, 1);
+  // Maps the result of the range reduction below to the offset to add to get
+  // the ASCII character.
+  const __m128i offsets = _mm_setr_epi8(
+      'a' - 26, '0' - 52, '0' - 52, '0' - 52, '0' - 52, '0' - 52, '0' - 52,
+      '0' - 52, '0' - 52, '0' - 52, '0' - 52, codes[62] - 62, codes[63] - 63,
+      'A', 0, 0);
+  size_t out_i = 0;
+  for (; i + 16 <= size; i += 12, out_i += 16) {
+    __m128i in = _mm_loadu_si128(reinterpret_cast<const __m128i*>(input + i));
+    // Each 32-bit lane becomes [b1, b0, b2, b1], then the multiplies shift
+    // each 6-bit index into its own byte.
+    in = _mm_shuffle_epi8(in, shuffle);
+    const __m128i ac = _mm_mulhi_epu16(
+        _mm_and_si128(in, _mm_set1_epi32(0x0fc0fc00)),
+        _mm_set1_epi32(0x04000040));
+    const __m128i bd = _mm_mullo_epi16(
+        _mm_and_si128(in, _mm_set1_epi32(0x003f03f0)),
+        _mm_set1_epi32(0x01000010));
+    const __m128i indices = _mm_or_si128(ac, bd);
 
-void Base64::Install() {
-  RegisterGlobalFunction("btoa", &Base64::Encode);
-  RegisterGlobalFunction("atob", &Base64::Decode);
+    // Reduce the indices to 0 for A-Z, 1 for a-z, 2-11 for 0-9, 12 for 62,
+    // and 13 for 63.
+    __m128i reduced = _mm_subs_epu8(indices, _mm_set1_epi8(51));
+    const __m128i less = _mm_cmpgt_epi8(_mm_set1_epi8(26), indices);
+    reduced = _mm_or_si128(reduced, _mm_and_si128(less, _mm_set1_epi8(13)));
+    const __m128i chars =
+        _mm_add_epi8(_mm_shuffle_epi8(offsets, reduced), indices);
+    _mm_storeu_si128(reinterpret_cast<__m128i*>(output + out_i), chars);
+  }
+#elif defined(USE_NEON)
+  uint8x16x4_t table;
+  for (size_t j = 0; j < 4; j++)
+    table.val[j] = vld1q_u8(reinterpret_cast<const uint8_t*>(codes) + j * 16);
+  const uint8x16_t mask = vdupq_n_u8(0x3f);
+  size_t out_i = 0;
+  for (; i + 48 <= size; i += 48, out_i += 64) {
+    // This de-interleaves the bytes, so lane j of each register holds one
+    // byte of the j-th 3-byte group.
+    const uint8x16x3_t in = vld3q_u8(input + i);
+    uint8x16x4_t indices;
+    indices.val[0] = vshrq_n_u8(in.val[0], 2);
+    indices.val[1] = vandq_u8(
+        vorrq_u8(vshlq_n_u8(in.val[0], 4), vshrq_n_u8(in.val[1], 4)), mask);
+    indices.val[2] = vandq_u8(
+        vorrq_u8(vshlq_n_u8(in.val[1], 2), vshrq_n_u8(in.val[2], 6)), mask);
+    indices.val[3] = vandq_u8(in.val[2], mask);
+
+    uint8x16x4_t chars;
+    for (size_t j = 0; j < 4; j++)
+      chars.val[j] = vqtbl4q_u8(table, indices.val[j]);
+    vst4q_u8(reinterpret_cast<uint8_t*>(output + out_i), chars);
+  }
+#endif
+  return i;
 }
 
-// https://en.wikipedia.org/wiki/Base64
-// Text    |       M        |       a       |       n        |
-// ASCI    |   77 (0x4d)    |   97 (0x61)   |   110 (0x6e)   |
-// Bits    | 0 1 0 0 1 1 0 1 0 1 1 0 0 0 0 1 0 1 1 0 1 1 1 0 |
-// Index   |     19     |     22    |      5    |     46     |
-// Base64  |      T     |      W    |      F    |      u     |
-//         | <-----------------  24-bits  -----------------> |
+/**
+ * Decodes whole 4-character groups from the start of |input| using vector
+ * instructions.  This stops at the first block that contains a padding or
+ * invalid character so the scalar code can handle (and report) it.
+ * @return The number of characters consumed; this is a multiple of 4.
+ */
+size_t DecodeBlocks(const char* input, size_t size, const char* codes,
+                    uint8_t* output) {
+  size_t i = 0;
+#if defined(USE_SSSE3)
+  // See http://0x80.pl/notesen/2016-01-17-sse-base64-decoding.html.  Each
+  // iteration converts 16 characters to 12 bytes.
+  const __m128i pack_shuffle =
+      _mm_setr_epi8(2, 1, 0, 6, 5, 4, 10, 9, 8, 14, 13, 12, -1, -1, -1, -1);
+  size_t out_i = 0;
+  for (; i + 16 <= size; i += 16, out_i += 12) {
+    const __m128i in =
+        _mm_loadu_si128(reinterpret_cast<const __m128i*>(input + i));
+    // Non-ASCII characters are negative so they don't match any range.
+    const __m128i upper =
+        _mm_and_si128(_mm_cmpgt_epi8(in, _mm_set1_epi8('A' - 1)),
+                      _mm_cmplt_epi8(in, _mm_set1_epi8('Z' + 1)));
+    const __m128i lower =
+        _mm_and_si128(_mm_cmpgt_epi8(in, _mm_set1_epi8('a' - 1)),
+                      _mm_cmplt_epi8(in, _mm_set1_epi8('z' + 1)));
+    const __m128i digit =
+        _mm_and_si128(_mm_cmpgt_epi8(in, _mm_set1_epi8('0' - 1)),
+                      _mm_cmplt_epi8(in, _mm_set1_epi8('9' + 1)));
+    const __m128i c62 = _mm_cmpeq_epi8(in, _mm_set1_epi8(codes[62]));
+    const __m128i c63 = _mm_cmpeq_epi8(in, _mm_set1_epi8(codes[63]));
+    const __m128i valid = _mm_or_si128(
+        _mm_or_si128(upper, lower),
+        _mm_or_si128(digit, _mm_or_si128(c62, c63)));
+    if (_mm_movemask_epi8(valid) != 0xffff)
+      break;
 
-std::string Base64::Encode(ByteString input) {
-  if (input.empty())
-    return "";
+    // The ranges are disjoint, so OR-ing the masked offsets selects one.
+    __m128i shift = _mm_and_si128(upper, _mm_set1_epi8(-'A'));
+    shift = _mm_or_si128(
+        shift, _mm_and_si128(lower, _mm_set1_epi8(26 - 'a')));
+    shift = _mm_or_si128(
+        shift, _mm_and_si128(digit, _mm_set1_epi8(52 - '0')));
+    shift = _mm_or_si128(
+        shift, _mm_and_si128(c62, _mm_set1_epi8(62 - codes[62])));
+    shift = _mm_or_si128(
+        shift, _mm_and_si128(c63, _mm_set1_epi8(63 - codes[63])));
+    const __m128i values = _mm_add_epi8(in, shift);
 
-  // Stores a 24-bit block that is treated as an array where insertions occur
-  // from high to low.
-  uint32_t temp = 0;
+    // Merge each group of four 6-bit values into 24 bits, then move the bytes
+    // into big-endian order at the start of the register.
+    const __m128i merged = _mm_madd_epi16(
+        _mm_maddubs_epi16(values, _mm_set1_epi32(0x01400140)),
+        _mm_set1_epi32(0x00011000));
+    alignas(16) uint8_t temp[16];
+    _mm_store_si128(reinterpret_cast<__m128i*>(temp),
+                    _mm_shuffle_epi8(merged, pack_shuffle));
+    memcpy(output + out_i, temp, 12);
+  }
+#elif defined(USE_NEON)
+  const uint8x16_t c62 = vdupq_n_u8(static_cast<uint8_t>(codes[62]));
+  const uint8x16_t c63 = vdupq_n_u8(static_cast<uint8_t>(codes[63]));
   size_t out_i = 0;
-  const size_t out_size = CEIL_DIVIDE(input.size(), 3) * 4;
-  std::string result(out_size, '\0');
-  for (size_t i = 0; i < input.size(); i++) {
-    // "insert" 8-bits of data
-    temp |= (input[i] << ((2 - (i % 3)) * 8));
-
-    if (i % 3 == 2) {
-      result[out_i++] = kCodes[GET_BITS(temp, 18, 24)];
-      result[out_i++] = kCodes[GET_BITS(temp, 12, 18)];
-      result[out_i++] = kCodes[GET_BITS(temp, 6, 12)];
-      result[out_i++] = kCodes[GET_BITS(temp, 0, 6)];
-      temp = 0;
+  for (; i + 64 <= size; i += 64, out_i += 48) {
+    // This de-interleaves the characters, so lane j of each register holds
+    // one character of the j-th 4-character group.
+    const uint8x16x4_t in =
+        vld4q_u8(reinterpret_cast<const uint8_t*>(input + i));
+    uint8x16x4_t values;
+    uint8x16_t valid = vdupq_n_u8(0xff);
+    for (size_t j = 0; j < 4; j++) {
+      const uint8x16_t c = in.val[j];
+      // Unsigned wrap-around makes each range check a single compare.
+      const uint8x16_t upper_val = vsubq_u8(c, vdupq_n_u8('A'));
+      const uint8x16_t lower_val = vsubq_u8(c, vdupq_n_u8('a' - 26));
+      const uint8x16_t digit_val =
+          vsubq_u8(c, vdupq_n_u8(static_cast<uint8_t>('0' - 52)));
+      const uint8x16_t upper = vcltq_u8(upper_val, vdupq_n_u8(26));
+      const uint8x16_t lower = vcltq_u8(vsubq_u8(c, vdupq_n_u8('a')),
+                                        vdupq_n_u8(26));
+      const uint8x16_t digit = vcltq_u8(vsubq_u8(c, vdupq_n_u8('0')),
+                                        vdupq_n_u8(10));
+      const uint8x16_t is62 = vceqq_u8(c, c62);
+      const uint8x16_t is63 = vceqq_u8(c, c63);
+      valid = vandq_u8(valid, vorrq_u8(vorrq_u8(upper, lower),
+                                       vorrq_u8(digit, vorrq_u8(is62, is63))));
+
+      uint8x16_t value = vandq_u8(upper, upper_val);
+      value = vorrq_u8(value, vandq_u8(lower, lower_val));
+      value = vorrq_u8(value, vandq_u8(digit, digit_val));
+      value = vorrq_u8(value, vandq_u8(is62, vdupq_n_u8(62)));
+      value = vorrq_u8(value, vandq_u8(is63, vdupq_n_u8(63)));
+      values.val[j] = value;
     }
+    if (vminvq_u8(valid) == 0)
+      break;
+
+    uint8x16x3_t out;
+    out.val[0] =
+        vorrq_u8(vshlq_n_u8(values.val[0], 2), vshrq_n_u8(values.val[1], 4));
+    out.val[1] =
+        vorrq_u8(vshlq_n_u8(values.val[1], 4), vshrq_n_u8(values.val[2], 2));
+    out.val[2] = vorrq_u8(vshlq_n_u8(values.val[2], 6), values.val[3]);
+    vst3q_u8(output + out_i, out);
+  }
+#endif
+  return i;
+}
+
+std::string EncodeInternal(const uint8_t* input, size_t size,
+                           const char* codes, bool pad) {
+  if (size == 0)
+    return "";
+
+  const size_t out_size = CEIL_DIVIDE(size, 3) * 4;
+  std::string result(out_size, '\0');
+  const size_t block_size = EncodeBlocks(input, size, codes, &result[0]);
+  size_t out_i = block_size / 3 * 4;
+
+  size_t i = block_size;
+  for (; i + 3 <= size; i += 3) {
+    const uint32_t temp = (input[i] << 16) | (input[i + 1] << 8) | input[i + 2];
+    result[out_i++] = codes[GET_BITS(temp, 18, 24)];
+    result[out_i++] = codes[GET_BITS(temp, 12, 18)];
+    result[out_i++] = codes[GET_BITS(temp, 6, 12)];
+    result[out_i++] = codes[GET_BITS(temp, 0, 6)];
   }
 
-  if (input.size() % 3 == 1) {
-    result[out_i++] = kCodes[GET_BITS(temp, 18, 24)];
-    result[out_i++] = kCodes[GET_BITS(temp, 12, 18)];
-    result[out_i++] = '=';
-    result[out_i++] = '=';
-  } else if (input.size() % 3 == 2) {
-    result[out_i++] = kCodes[GET_BITS(temp, 18, 24)];
-    result[out_i++] = kCodes[GET_BITS(temp, 12, 18)];
-    result[out_i++] = kCodes[GET_BITS(temp, 6, 12)];
-    result[out_i++] = '=';
+  if (size - i == 1) {
+    const uint32_t temp = input[i] << 16;
+    result[out_i++] = codes[GET_BITS(temp, 18, 24)];
+    result[out_i++] = codes[GET_BITS(temp, 12, 18)];
+    if (pad) {
+      result[out_i++] = '=';
+      result[out_i++] = '=';
+    }
+  } else if (size - i == 2) {
+    const uint32_t temp = (input[i] << 16) | (input[i + 1] << 8);
+    result[out_i++] = codes[GET_BITS(temp, 18, 24)];
+    result[out_i++] = codes[GET_BITS(temp, 12, 18)];
+    result[out_i++] = codes[GET_BITS(temp, 6, 12)];
+    if (pad)
+      result[out_i++] = '=';
   }
 
-  DCHECK_EQ(out_size, out_i);
+  DCHECK(pad ? out_i == out_size : out_i <= out_size);
+  result.resize(out_i);
   return result;
 }
 
-ExceptionOr<ByteString> Base64::Decode(const std::string& input) {
+ExceptionOr<ByteString> DecodeInternal(const std::string& input,
+                                       const char* codes) {
   if (input.empty())
     return "";
 
   const size_t out_size_max = CEIL_DIVIDE(input.size() * 3, 4);
-  std::string result(out_size_max, '\0');
+  ByteString result(out_size_max);
+
+  const size_t block_size =
+      DecodeBlocks(input.data(), input.size(), codes, result.data());
+  size_t out_i = block_size / 4 * 3;
 
   // Stores 24-bits of data that is treated like an array where insertions occur
   // from high to low.
   uint32_t temp = 0;
-  size_t out_i = 0;
   size_t i;
-  for (i = 0; i < input.size(); i++) {
+  for (i = block_size; i < input.size(); i++) {
     if (input[i] == '=') {
       // We want i to remain at the first '=', so we need an inner loop.
       for (size_t j = i; j < input.size(); j++) {
@@ -120,7 +308,7 @@ ExceptionOr<ByteString> Base64::Decode(const std::string& input) {
       break;
     }
 
-    const int32_t decoded = DecodeChar(input[i]);
+    const int32_t decoded = DecodeChar(input[i], codes);
     if (decoded < 0)
       return BadEncoding();
     // "insert" 6-bits of data
@@ -149,28 +337,46 @@ ExceptionOr<ByteString> Base64::Decode(const std::string& input) {
   return result;
 }
 
+}  // namespace
+
+void Base64::Install() {
+  RegisterGlobalFunction(
+      "btoa", static_cast<std::string (*)(ByteString)>(&Base64::Encode));
+  RegisterGlobalFunction("atob", &Base64::Decode);
+}
+
+// https://en.wikipedia.org/wiki/Base64
+// Text    |       M        |       a       |       n        |
+// ASCI    |   77 (0x4d)    |   97 (0x61)   |   110 (0x6e)   |
+// Bits    | 0 1 0 0 1 1 0 1 0 1 1 0 0 0 0 1 0 1 1 0 1 1 1 0 |
+// Index   |     19     |     22    |      5    |     46     |
+// Base64  |      T     |      W    |      F    |      u     |
+//         | <-----------------  24-bits  -----------------> |
+
+std::string Base64::Encode(ByteString input) {
+  return EncodeInternal(input.data(), input.size(), kCodes, /* pad= */ true);
+}
+
+std::string Base64::Encode(const uint8_t* data, size_t size) {
+  return EncodeInternal(data, size, kCodes, /* pad= */ true);
+}
+
+ExceptionOr<ByteString> Base64::Decode(const std::string& input) {
+  return DecodeInternal(input, kCodes);
+}
+
 std::string Base64::EncodeUrl(ByteString input) {
-  std::string ret = Encode(input);
-  for (char& c : ret) {
-    if (c == '+')
-      c = '-';
-    else if (c == '/')
-      c = '_';
-  }
-  ret.erase(ret.find('='));  // Erase any trailing '='
-  return ret;
+  return EncodeInternal(input.data(), input.size(), kUrlCodes,
+                        /* pad= */ false);
+}
+
+std::string Base64::EncodeUrl(const uint8_t* data, size_t size) {
+  return EncodeInternal(data, size, kUrlCodes, /* pad= */ false);
 }
 
 ExceptionOr<ByteString> Base64::DecodeUrl(const std::string& input) {
-  std::string converted_input = input;
-  for (char& c : converted_input) {
-    if (c == '-')
-      c = '+';
-    else if (c == '_')
-      c = '/';
-  }
-  // Note Decode() will ignore any missing '='
-  return Decode(converted_input);
+  // Note this will ignore any missing '='
+  return DecodeInternal(input, kUrlCodes);
 }
 
 }  // namespace js
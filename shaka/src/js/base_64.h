@@ -15,6 +15,9 @@
 #ifndef SHAKA_EMBEDDED_JS_BASE_64_H_
 #define SHAKA_EMBEDDED_JS_BASE_64_H_
 
+#include <stddef.h>
+#include <stdint.h>
+
 #include <string>
 
 #include "src/mapping/byte_string.h"
@@ -23,14 +26,22 @@
 namespace shaka {
 namespace js {
 
+/**
+ * Implements base-64 encoding and decoding.  Whole blocks are converted using
+ * SSSE3 or NEON when available, falling back to scalar code for the rest.
+ */
 class Base64 {
  public:
   static void Install();
 
   static std::string Encode(ByteString input);
+  /** Encodes the given bytes directly, without copying them to a ByteString. */
+  static std::string Encode(const uint8_t* data, size_t size);
   static ExceptionOr<ByteString> Decode(const std::string& input);
 
+  /** Encodes using the URL-safe alphabet without padding. */
   static std::string EncodeUrl(ByteString input);
+  static std::string EncodeUrl(const uint8_t* data, size_t size);
   static ExceptionOr<ByteString> DecodeUrl(const std::string& input);
 };
 
@@ -0,0 +1,78 @@
+// Copyright 2020 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     https://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "src/js/chunked_response.h"
+
+namespace shaka {
+namespace js {
+
+size_t FindCompleteBoxes(const uint8_t* data, size_t size) {
+  constexpr const size_t kHeaderSize = 8;
+  constexpr const size_t kLargeHeaderSize = 16;
+  size_t pos = 0;
+  while (size - pos >= kHeaderSize) {
+    const uint8_t* header = data + pos;
+    uint64_t box_size = (static_cast<uint32_t>(header[0]) << 24) |
+                        (static_cast<uint32_t>(header[1]) << 16) |
+                        (static_cast<uint32_t>(header[2]) << 8) | header[3];
+    if (box_size == 0) {
+      // The box extends to the end of the response.
+      break;
+    } else if (box_size == 1) {
+      if (size - pos < kLargeHeaderSize)
+        break;
+      box_size = 0;
+      for (size_t i = 0; i < 8; i++)
+        box_size = (box_size << 8) | header[kHeaderSize + i];
+      if (box_size < kLargeHeaderSize)
+        return size;
+    } else if (box_size < kHeaderSize) {
+      return size;
+    }
+
+    if (box_size > size - pos)
+      break;
+    pos += static_cast<size_t>(box_size);
+  }
+  return pos;
+}
+
+
+ChunkedResponse::ChunkedResponse() : start_(0), finished_(false) {}
+
+bool ChunkedResponse::NextChunk(const uint8_t* data, size_t size,
+                                size_t* start, size_t* length) {
+  if (finished_)
+    return false;
+
+  *start = start_;
+  *length = FindCompleteBoxes(data + start_, size - start_);
+  start_ += *length;
+  return true;
+}
+
+void ChunkedResponse::Finish(size_t size, size_t* start, size_t* length) {
+  *start = start_;
+  *length = size - start_;
+  start_ = size;
+  finished_ = true;
+}
+
+void ChunkedResponse::Reset() {
+  start_ = 0;
+  finished_ = false;
+}
+
+}  // namespace js
+}  // namespace shaka
@@ -0,0 +1,71 @@
+// Copyright 2020 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     https://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef SHAKA_EMBEDDED_JS_CHUNKED_RESPONSE_H_
+#define SHAKA_EMBEDDED_JS_CHUNKED_RESPONSE_H_
+
+#include <stddef.h>
+#include <stdint.h>
+
+namespace shaka {
+namespace js {
+
+/**
+ * Finds the end of the last complete top-level MP4 box in the given buffer.
+ * If the data doesn't look like MP4 boxes, this returns the whole buffer so
+ * the data is still given to JavaScript.
+ * @return The number of bytes, from the start of |data|, of complete boxes.
+ */
+size_t FindCompleteBoxes(const uint8_t* data, size_t size);
+
+/**
+ * Tracks which parts of a chunked XMLHttpRequest response have been given to
+ * JavaScript.  Each chunk is the complete MP4 boxes received since the last
+ * one; once the request completes, the final chunk holds the rest.  This type
+ * isn't thread-safe.
+ */
+class ChunkedResponse {
+ public:
+  ChunkedResponse();
+
+  /**
+   * Gets the next chunk of complete boxes.  This can be empty if no box was
+   * completed since the last chunk.
+   * @param data The response received so far.
+   * @param size The number of bytes in |data|.
+   * @param start [OUT] Where to put the offset of the chunk in |data|.
+   * @param length [OUT] Where to put the length of the chunk.
+   * @return False if the response already finished, so there is no chunk.
+   */
+  bool NextChunk(const uint8_t* data, size_t size, size_t* start,
+                 size_t* length);
+
+  /**
+   * Gets the final chunk, which holds all the data that wasn't given yet.
+   * After this, NextChunk doesn't return any more chunks.
+   */
+  void Finish(size_t size, size_t* start, size_t* length);
+
+  void Reset();
+
+ private:
+  // The number of bytes that have already been given to JavaScript.
+  size_t start_;
+  bool finished_;
+};
+
+}  // namespace js
+}  // namespace shaka
+
+#endif  // SHAKA_EMBEDDED_JS_CHUNKED_RESPONSE_H_
@@ -17,6 +17,8 @@
 #include <chrono>
 #include <thread>
 
+#include "src/core/js_manager_impl.h"
+
 namespace shaka {
 namespace js {
 
@@ -45,11 +47,62 @@ void Debug::Sleep(uint64_t delay_ms) {
   std::this_thread::sleep_for(std::chrono::microseconds(delay_ms));
 }
 
+double Debug::MainThreadWakeupsPerSecond() {
+  return JsManagerImpl::Instance()->MainThread()->GetWakeupsPerSecond();
+}
+
+uint64_t Debug::NetworkRequestCount() {
+  return JsManagerImpl::Instance()->NetworkThread()->completed_request_count();
+}
+
+uint64_t Debug::NetworkReusedConnectionCount() {
+  return JsManagerImpl::Instance()->NetworkThread()->reused_connection_count();
+}
+
+uint64_t Debug::NetworkCompressedResponseCount() {
+  auto* network = JsManagerImpl::Instance()->NetworkThread();
+  return network->compressed_response_count();
+}
+
+double Debug::NetworkCompressionRatio() {
+  auto* network = JsManagerImpl::Instance()->NetworkThread();
+  const uint64_t wire_bytes = network->compressed_wire_bytes();
+  if (wire_bytes == 0)
+    return 0;
+  return static_cast<double>(network->compressed_decoded_bytes()) /
+         static_cast<double>(wire_bytes);
+}
+
+uint64_t Debug::NetworkHedgeCount() {
+  auto* network = JsManagerImpl::Instance()->NetworkThread();
+  return network->hedge_policy()->GetStats().hedge_count;
+}
+
+double Debug::NetworkHedgeWinRate() {
+  auto* network = JsManagerImpl::Instance()->NetworkThread();
+  const HedgePolicy::Stats stats = network->hedge_policy()->GetStats();
+  if (stats.hedge_count == 0)
+    return 0;
+  return static_cast<double>(stats.win_count) /
+         static_cast<double>(stats.hedge_count);
+}
+
 
 DebugFactory::DebugFactory() {
   AddStaticFunction("internalTypeName", &Debug::InternalTypeName);
   AddStaticFunction("indirectBases", &Debug::IndirectBases);
   AddStaticFunction("sleep", &Debug::Sleep);
+  AddStaticFunction("mainThreadWakeupsPerSecond",
+                    &Debug::MainThreadWakeupsPerSecond);
+  AddStaticFunction("networkRequestCount", &Debug::NetworkRequestCount);
+  AddStaticFunction("networkReusedConnectionCount",
+                    &Debug::NetworkReusedConnectionCount);
+  AddStaticFunction("networkCompressedResponseCount",
+                    &Debug::NetworkCompressedResponseCount);
+  AddStaticFunction("networkCompressionRatio",
+                    &Debug::NetworkCompressionRatio);
+  AddStaticFunction("networkHedgeCount", &Debug::NetworkHedgeCount);
+  AddStaticFunction("networkHedgeWinRate", &Debug::NetworkHedgeWinRate);
 }
 
 
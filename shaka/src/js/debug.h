@@ -38,6 +38,42 @@ class Debug : public BackingObject {
   static std::string IndirectBases(RefPtr<BackingObject> object);
 
   static void Sleep(uint64_t delay_ms);
+
+  /**
+   * @return The average number of times per second the main thread woke up
+   *   from being idle, since the last call.
+   */
+  static double MainThreadWakeupsPerSecond();
+
+  /** @return The number of native network requests that have completed. */
+  static uint64_t NetworkRequestCount();
+
+  /**
+   * @return The number of completed native network requests that reused an
+   *   existing connection.
+   */
+  static uint64_t NetworkReusedConnectionCount();
+
+  /**
+   * @return The number of completed native network requests that were
+   *   compressed.
+   */
+  static uint64_t NetworkCompressedResponseCount();
+
+  /**
+   * @return The average compression ratio (decoded size / received size) of
+   *   the compressed responses, or 0 if there were none.
+   */
+  static double NetworkCompressionRatio();
+
+  /** @return The number of duplicates sent for slow network requests. */
+  static uint64_t NetworkHedgeCount();
+
+  /**
+   * @return The fraction of the duplicates of slow network requests that
+   *   finished before the original, or 0 if there were none.
+   */
+  static double NetworkHedgeWinRate();
 };
 
 class DebugFactory : public BackingObjectFactory<Debug> {
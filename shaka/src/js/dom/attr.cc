@@ -14,6 +14,8 @@
 
 #include "src/js/dom/attr.h"
 
+#include <utility>
+
 #include "src/js/dom/document.h"
 #include "src/js/dom/element.h"
 
@@ -24,7 +26,7 @@ namespace dom {
 Attr::Attr(RefPtr<Document> document, RefPtr<Element> owner,
            const std::string& local_name, optional<std::string> namespace_uri,
            optional<std::string> namespace_prefix, const std::string& value)
-    : Node(ATTRIBUTE_NODE, document),
+    : Node(ATTRIBUTE_NODE, std::move(document)),
       namespace_uri(namespace_uri),
       namespace_prefix(namespace_prefix),
       local_name(local_name),
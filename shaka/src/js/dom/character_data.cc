@@ -14,6 +14,8 @@
 
 #include "src/js/dom/character_data.h"
 
+#include <utility>
+
 #include "src/js/dom/document.h"
 #include "src/js/js_error.h"
 #include "src/util/utils.h"
@@ -23,11 +25,11 @@ namespace js {
 namespace dom {
 
 CharacterData::CharacterData(NodeType type, RefPtr<Document> document)
-    : Node(type, document) {}
+    : Node(type, std::move(document)) {}
 
 CharacterData::CharacterData(NodeType type, RefPtr<Document> document,
                              const std::string& data)
-    : Node(type, document), data_(data) {}
+    : Node(type, std::move(document)), data_(data) {}
 
 // \cond Doxygen_Skip
 CharacterData::~CharacterData() {}
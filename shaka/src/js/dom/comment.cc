@@ -14,6 +14,8 @@
 
 #include "src/js/dom/comment.h"
 
+#include <utility>
+
 #include "src/js/dom/document.h"
 
 namespace shaka {
@@ -21,7 +23,7 @@ namespace js {
 namespace dom {
 
 Comment::Comment(RefPtr<Document> document, const std::string& data)
-    : CharacterData(COMMENT_NODE, document, data) {}
+    : CharacterData(COMMENT_NODE, std::move(document), data) {}
 
 // \cond Doxygen_Skip
 Comment::~Comment() {}
@@ -15,6 +15,7 @@
 #include "src/js/dom/container_node.h"
 
 #include <cctype>
+#include <utility>
 
 #include "src/js/dom/document.h"
 #include "src/js/dom/element.h"
@@ -27,16 +28,22 @@ namespace dom {
 
 namespace {
 
-RefPtr<Element> ToElement(RefPtr<Node> node) {
-  if (!node->is_element())
-    return nullptr;
-  return static_cast<Element*>(node.get());
+void AppendElementsByTagName(const Node* node, const std::string& name,
+                             std::vector<RefPtr<Element>>* result) {
+  for (auto& child : node->children()) {
+    if (child->is_element()) {
+      Element* elem = static_cast<Element*>(child.get());
+      if (elem->tag_name() == name)
+        result->emplace_back(elem);
+      AppendElementsByTagName(elem, name, result);
+    }
+  }
 }
 
 }  // namespace
 
 ContainerNode::ContainerNode(NodeType type, RefPtr<Document> document)
-    : Node(type, document) {}
+    : Node(type, std::move(document)) {}
 
 // \cond Doxygen_Skip
 ContainerNode::~ContainerNode() {}
@@ -45,18 +52,12 @@ ContainerNode::~ContainerNode() {}
 std::vector<RefPtr<Element>> ContainerNode::GetElementsByTagName(
     const std::string& name) const {
   std::vector<RefPtr<Element>> ret;
-  for (auto& child : child_nodes()) {
-    RefPtr<Element> elem = ToElement(child);
-    if (elem) {
-      if (elem->tag_name() == name) {
-        ret.push_back(elem);
-      }
-
-      auto temp = elem->GetElementsByTagName(name);
-      ret.insert(ret.end(), temp.begin(), temp.end());
-    }
-  }
-
+  // Use the Document's tag index if this node is in its tree; otherwise
+  // (e.g. for a detached element) search the children.
+  const Document* doc =
+      is_document() ? static_cast<const Document*>(this) : document().get();
+  if (!doc || !doc->FindElementsByTagName(this, name, &ret))
+    AppendElementsByTagName(this, name, &ret);
   return ret;
 }
 
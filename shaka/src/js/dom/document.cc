@@ -14,6 +14,8 @@
 
 #include "src/js/dom/document.h"
 
+#include <algorithm>
+
 #include "src/js/dom/attr.h"
 #include "src/js/dom/comment.h"
 #include "src/js/dom/element.h"
@@ -31,6 +33,9 @@ namespace {
 constexpr const char* kXmlNamespace = "http://www.w3.org/XML/1998/namespace";
 constexpr const char* kXmlNsNamespace = "http://www.w3.org/2000/xmlns/";
 
+/** Used to give each build of a tag index a unique stamp. */
+std::atomic<uint64_t> g_next_index_stamp{1};
+
 }  // namespace
 
 std::atomic<Document*> Document::instance_{nullptr};
@@ -92,6 +97,34 @@ std::vector<RefPtr<Element>> Document::GetElementsByTagName(
   return ContainerNode::GetElementsByTagName(name);
 }
 
+bool Document::FindElementsByTagName(
+    const ContainerNode* root, const std::string& name,
+    std::vector<RefPtr<Element>>* result) const {
+  EnsureIndex();
+
+  // Descendants of an element are the positions after it up to its end.
+  uint32_t begin = 0;
+  uint32_t end = UINT32_MAX;
+  if (root != this) {
+    DCHECK(root->is_element());
+    const Element* elem = static_cast<const Element*>(root);
+    if (elem->index_stamp_ != index_stamp_)
+      return false;
+    begin = elem->index_begin_ + 1;
+    end = elem->index_end_;
+  }
+
+  auto it = tag_index_.find(name);
+  if (it == tag_index_.end())
+    return true;
+  const TagEntry& entry = it->second;
+  auto pos = std::lower_bound(entry.positions.begin(), entry.positions.end(),
+                              begin);
+  for (; pos != entry.positions.end() && *pos < end; pos++)
+    result->emplace_back(entry.elements[pos - entry.positions.begin()]);
+  return true;
+}
+
 RefPtr<Element> Document::CreateElement(const std::string& name) {
   if (name == "video") {
     // This should only be used in Shaka Player integration tests.
@@ -108,6 +141,51 @@ RefPtr<Text> Document::CreateTextNode(const std::string& data) {
   return new Text(this, data);
 }
 
+Document::TagEntry::TagEntry() {}
+
+Document::TagEntry::~TagEntry() {}
+
+void Document::EnsureIndex() const {
+  if (index_stamp_ != 0)
+    return;
+
+  const uint64_t stamp = g_next_index_stamp.fetch_add(1);
+  tag_index_.clear();
+
+  // Walk the tree in pre-order, giving each element its position.  This
+  // avoids recursion since documents can be deeply nested.
+  struct Frame {
+    const Node* node;
+    size_t next_child;
+  };
+  std::vector<Frame> stack;
+  stack.push_back({this, 0});
+  uint32_t position = 0;
+  while (!stack.empty()) {
+    const Node* node = stack.back().node;
+    const size_t index = stack.back().next_child++;
+    if (index == node->children().size()) {
+      if (node->is_element())
+        static_cast<const Element*>(node)->index_end_ = position;
+      stack.pop_back();
+      continue;
+    }
+
+    Node* child = node->children()[index].get();
+    if (child->is_element()) {
+      Element* elem = static_cast<Element*>(child);
+      elem->index_stamp_ = stamp;
+      elem->index_begin_ = position;
+      TagEntry& entry = tag_index_[elem->tag_name()];
+      entry.positions.push_back(position);
+      entry.elements.push_back(elem);
+      position++;
+      stack.push_back({child, 0});
+    }
+  }
+  index_stamp_ = stamp;
+}
+
 ExceptionOr<RefPtr<Attr>> Document::CreateAttribute(const std::string& name) {
   // TODO: Validate valid XML characters.
   if (name.empty())
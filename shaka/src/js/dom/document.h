@@ -17,6 +17,7 @@
 
 #include <atomic>
 #include <string>
+#include <unordered_map>
 #include <vector>
 
 #include "shaka/optional.h"
@@ -69,9 +70,51 @@ class Document : public ContainerNode {
   ExceptionOr<RefPtr<Attr>> CreateAttributeNS(
       const std::string& namespace_uri, const std::string& qualified_name);
 
+  /**
+   * Finds the descendants of |root| with the given tag name, in document order,
+   * using an index of this Document's tree.  The index is built when first
+   * needed and is reused until the tree changes, so parsed documents (e.g.
+   * manifests) are only walked once no matter how many queries are made.
+   *
+   * @param root The node to search under; this must be this Document or an
+   *   element.
+   * @param name The tag name to search for.
+   * @param result The vector to append the found elements to.
+   * @return False if |root| isn't in this Document's tree, in which case
+   *   |result| isn't changed.
+   */
+  bool FindElementsByTagName(const ContainerNode* root,
+                             const std::string& name,
+                             std::vector<RefPtr<Element>>* result) const;
+
+  /** Called when this Document's tree changes. */
+  void InvalidateIndex() {
+    index_stamp_ = 0;
+  }
+
  private:
+  /** The elements with one tag name, in document order. */
+  struct TagEntry {
+    TagEntry();
+    ~TagEntry();
+
+    // The pre-order position of each element in |elements|.
+    std::vector<uint32_t> positions;
+    std::vector<Element*> elements;
+  };
+
+  /** Rebuilds the tag index if the tree has changed. */
+  void EnsureIndex() const;
+
   static std::atomic<Document*> instance_;
   const uint64_t created_at_;
+
+  // The tag index; this doesn't need to be traced since the elements are
+  // held by the tree and the index is rebuilt when the tree changes.  The
+  // stamp is unique to each build (or 0 if it needs rebuilding) so elements
+  // moved between Documents aren't mistaken as being in this index.
+  mutable std::unordered_map<std::string, TagEntry> tag_index_;
+  mutable uint64_t index_stamp_ = 0;
 };
 
 class DocumentFactory : public BackingObjectFactory<Document, ContainerNode> {
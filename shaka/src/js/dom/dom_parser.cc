@@ -14,7 +14,14 @@
 
 #include "src/js/dom/dom_parser.h"
 
+#include <memory>
+#include <mutex>
+#include <utility>
+
+#include "src/core/js_manager_impl.h"
+#include "src/debug/mutex.h"
 #include "src/js/dom/document.h"
+#include "src/js/dom/mpd_patcher.h"
 #include "src/js/dom/xml_document_parser.h"
 #include "src/js/js_error.h"
 #include "src/util/utils.h"
@@ -23,6 +30,73 @@ namespace shaka {
 namespace js {
 namespace dom {
 
+namespace {
+
+struct PreparsedDocument {
+  std::string source;
+  std::string url;
+  XMLParsedEvents parsed;
+  bool done = false;
+  bool success = false;
+};
+
+class PreparseCache {
+ public:
+  PreparseCache() : mutex_("PreparseCache") {}
+
+  static PreparseCache* Instance() {
+    static PreparseCache instance;
+    return &instance;
+  }
+
+  void Start(std::string source, std::string url) {
+    std::shared_ptr<PreparsedDocument> doc(new PreparsedDocument);
+    doc->source = std::move(source);
+    doc->url = std::move(url);
+    {
+      std::unique_lock<Mutex> lock(mutex_);
+      current_ = doc;
+    }
+
+    JsManagerImpl::Instance()->WorkerThread()->AddInternalTask(
+        TaskPriority::Internal, "Preparse XML", [this, doc]() {
+          // Parsing may be slow, so only lock when storing the result.
+          XMLParsedEvents parsed;
+          const bool success = parsed.Parse(doc->source);
+
+          std::unique_lock<Mutex> lock(mutex_);
+          doc->parsed = std::move(parsed);
+          doc->success = success;
+          doc->done = true;
+        });
+  }
+
+  /**
+   * @param source The text being parsed.
+   * @param url Will be set to the URL the text was downloaded from, if known.
+   * @return The parsed events for the given text, or nullptr if it isn't
+   *   available (yet).
+   */
+  std::shared_ptr<PreparsedDocument> Take(const std::string& source,
+                                          std::string* url) {
+    std::unique_lock<Mutex> lock(mutex_);
+    if (!current_ || current_->source != source)
+      return nullptr;
+    *url = current_->url;
+
+    // If it isn't done yet, it's just as fast to parse it on this thread.
+    std::shared_ptr<PreparsedDocument> ret = std::move(current_);
+    current_.reset();
+    return ret->done && ret->success ? ret : nullptr;
+  }
+
+ private:
+  Mutex mutex_;
+  std::shared_ptr<PreparsedDocument> current_;
+};
+
+}  // namespace
+
 DOMParser::DOMParser() {}
 // \cond Doxygen_Skip
 DOMParser::~DOMParser() {}
@@ -34,12 +108,28 @@ ExceptionOr<RefPtr<Document>> DOMParser::ParseFromString(
   if (type_lower == "text/xml" || type_lower == "application/xml") {
     RefPtr<Document> ret = new Document();
     XMLDocumentParser parser(ret);
-    return parser.Parse(source);
+    std::string url;
+    auto preparsed = PreparseCache::Instance()->Take(source, &url);
+    if (preparsed) {
+      parser.Replay(&preparsed->parsed);
+    } else {
+      auto parsed = parser.Parse(source);
+      if (holds_alternative<JsError>(parsed))
+        return parsed;
+    }
+
+    // Live DASH manifests are kept so MPD patches can be applied to them.
+    MpdPatcher::Instance()->OnDocumentParsed(ret, url);
+    return MpdPatcher::Instance()->MaybeApplyPatch(ret);
   }
 
   return JsError::TypeError("Unsupported parse type " + type);
 }
 
+void DOMParser::Preparse(std::string source, std::string url) {
+  PreparseCache::Instance()->Start(std::move(source), std::move(url));
+}
+
 
 DOMParserFactory::DOMParserFactory() {
   AddMemberFunction("parseFromString", &DOMParser::ParseFromString);
@@ -49,6 +49,18 @@ class DOMParser : public BackingObject {
    */
   ExceptionOr<RefPtr<Document>> ParseFromString(const std::string& source,
                                                 const std::string& type) const;
+
+  /**
+   * Starts parsing the given XML document on the worker thread.  If
+   * JavaScript later parses the same text after it finishes, the nodes are
+   * created from the already parsed events.  This allows manifests to be
+   * parsed while the main thread is busy with other work.  Only the most
+   * recent document is kept.  This can be called from any thread.
+   *
+   * @param source The text of the document.
+   * @param url The URL the document was downloaded from.
+   */
+  static void Preparse(std::string source, std::string url);
 };
 
 class DOMParserFactory : public BackingObjectFactory<DOMParser> {
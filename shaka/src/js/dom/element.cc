@@ -14,6 +14,8 @@
 
 #include "src/js/dom/element.h"
 
+#include <utility>
+
 #include "src/js/dom/attr.h"
 #include "src/js/dom/document.h"
 #include "src/js/dom/text.h"
@@ -23,13 +25,42 @@ namespace shaka {
 namespace js {
 namespace dom {
 
-Element::Element(RefPtr<Document> document, const std::string& local_name,
+namespace {
+
+/** Holds the interned attribute names for all elements. */
+util::AtomTable* GetNameTable() {
+  static util::AtomTable* table = new util::AtomTable;
+  return table;
+}
+
+}  // namespace
+
+Element::AttrData::AttrData(optional<std::string> namespace_uri,
+                            optional<std::string> namespace_prefix,
+                            std::string local_name, std::string value)
+    : namespace_uri(std::move(namespace_uri)),
+      namespace_prefix(std::move(namespace_prefix)),
+      local_name(std::move(local_name)),
+      value(std::move(value)) {
+  local_name_atom = GetNameTable()->Intern(this->local_name);
+  if (this->namespace_prefix.has_value())
+    name_atom = GetNameTable()->Intern(attr_name());
+  else
+    name_atom = local_name_atom;
+}
+
+Element::AttrData::~AttrData() {}
+
+Element::AttrData::AttrData(AttrData&&) = default;
+Element::AttrData& Element::AttrData::operator=(AttrData&&) = default;
+
+Element::Element(RefPtr<Document> document, std::string local_name,
                  optional<std::string> namespace_uri,
                  optional<std::string> namespace_prefix)
-    : ContainerNode(ELEMENT_NODE, document),
-      namespace_uri(namespace_uri),
-      namespace_prefix(namespace_prefix),
-      local_name(local_name) {}
+    : ContainerNode(ELEMENT_NODE, std::move(document)),
+      namespace_uri(std::move(namespace_uri)),
+      namespace_prefix(std::move(namespace_prefix)),
+      local_name(std::move(local_name)) {}
 
 // \cond Doxygen_Skip
 Element::~Element() {}
@@ -37,7 +68,7 @@ Element::~Element() {}
 
 void Element::Trace(memory::HeapTracer* tracer) const {
   ContainerNode::Trace(tracer);
-  tracer->Trace(&attributes_);
+  tracer->Trace(&attribute_nodes_);
 }
 
 std::string Element::tag_name() const {
@@ -72,7 +103,7 @@ optional<std::string> Element::GetAttribute(const std::string& name) const {
   auto it = FindAttribute(name);
   if (it == attributes_.end())
     return nullopt;
-  return (*it)->value;
+  return it->value;
 }
 
 optional<std::string> Element::GetAttributeNS(const std::string& ns,
@@ -80,7 +111,7 @@ optional<std::string> Element::GetAttributeNS(const std::string& ns,
   auto it = FindAttributeNS(ns, name);
   if (it == attributes_.end())
     return nullopt;
-  return (*it)->value;
+  return it->value;
 }
 
 bool Element::HasAttribute(const std::string& name) const {
@@ -95,10 +126,15 @@ bool Element::HasAttributeNS(const std::string& ns,
 void Element::SetAttribute(const std::string& key, const std::string& value) {
   auto it = FindAttribute(key);
   if (it != attributes_.end()) {
-    (*it)->value = value;
+    it->value = value;
+    if (!attribute_nodes_.empty())
+      attribute_nodes_[it - attributes_.begin()]->value = value;
   } else {
-    attributes_.emplace_back(
-        new Attr(document(), this, key, nullopt, nullopt, value));
+    attributes_.emplace_back(nullopt, nullopt, key, value);
+    if (!attribute_nodes_.empty()) {
+      attribute_nodes_.emplace_back(
+          new Attr(document(), this, key, nullopt, nullopt, value));
+    }
   }
 }
 
@@ -113,30 +149,65 @@ void Element::SetAttributeNS(const std::string& ns, const std::string& key,
 
   auto it = FindAttributeNS(ns, local_name);
   if (it != attributes_.end()) {
-    (*it)->value = value;
+    it->value = value;
+    if (!attribute_nodes_.empty())
+      attribute_nodes_[it - attributes_.begin()]->value = value;
   } else {
-    attributes_.push_back(
-        new Attr(document(), this, local_name, ns, prefix, value));
+    attributes_.emplace_back(ns, prefix, local_name, value);
+    if (!attribute_nodes_.empty()) {
+      attribute_nodes_.emplace_back(
+          new Attr(document(), this, local_name, ns, prefix, value));
+    }
   }
 }
 
+void Element::AddParsedAttribute(optional<std::string> namespace_uri,
+                                 optional<std::string> namespace_prefix,
+                                 std::string local_name, std::string value) {
+  DCHECK(attribute_nodes_.empty());
+  attributes_.emplace_back(std::move(namespace_uri),
+                           std::move(namespace_prefix), std::move(local_name),
+                           std::move(value));
+}
+
 void Element::RemoveAttribute(const std::string& attr) {
   auto it = FindAttribute(attr);
   if (it != attributes_.end())
-    attributes_.erase(it);
+    EraseAttribute(it);
 }
 
 void Element::RemoveAttributeNS(const std::string& ns,
                                 const std::string& attr) {
   auto it = FindAttributeNS(ns, attr);
   if (it != attributes_.end())
-    attributes_.erase(it);
+    EraseAttribute(it);
+}
+
+std::string Element::AttrData::attr_name() const {
+  if (!namespace_prefix.has_value())
+    return local_name;
+  return namespace_prefix.value() + ":" + local_name;
+}
+
+void Element::EraseAttribute(attr_iter it) {
+  if (!attribute_nodes_.empty()) {
+    attribute_nodes_.erase(attribute_nodes_.begin() +
+                           (it - attributes_.begin()));
+  }
+  attributes_.erase(it);
 }
 
 Element::attr_iter Element::FindAttribute(const std::string& name) {
+  if (attributes_.empty())
+    return attributes_.end();
+  // If the name was never interned, no element has this attribute.
+  const util::AtomTable::Atom atom = GetNameTable()->FindAtom(name);
+  if (atom == util::AtomTable::kNoAtom)
+    return attributes_.end();
+
   auto it = attributes_.begin();
   for (; it != attributes_.end(); it++) {
-    if ((*it)->attr_name() == name)
+    if (it->name_atom == atom)
       return it;
   }
   return it;
@@ -144,16 +215,33 @@ Element::attr_iter Element::FindAttribute(const std::string& name) {
 
 Element::attr_iter Element::FindAttributeNS(const std::string& ns,
                                             const std::string& name) {
+  if (attributes_.empty())
+    return attributes_.end();
+  const util::AtomTable::Atom atom = GetNameTable()->FindAtom(name);
+  if (atom == util::AtomTable::kNoAtom)
+    return attributes_.end();
+
   auto it = attributes_.begin();
   for (; it != attributes_.end(); it++) {
-    if ((*it)->namespace_uri == ns && (*it)->local_name == name)
+    if (it->local_name_atom == atom && it->namespace_uri == ns)
       return it;
   }
   return it;
 }
 
 std::vector<RefPtr<Attr>> Element::attributes() const {
-  return std::vector<RefPtr<Attr>>(attributes_.begin(), attributes_.end());
+  if (attribute_nodes_.size() != attributes_.size()) {
+    DCHECK(attribute_nodes_.empty());
+    RefPtr<Element> self(const_cast<Element*>(this));
+    attribute_nodes_.reserve(attributes_.size());
+    for (auto& attr : attributes_) {
+      attribute_nodes_.emplace_back(
+          new Attr(document(), self, attr.local_name, attr.namespace_uri,
+                   attr.namespace_prefix, attr.value));
+    }
+  }
+  return std::vector<RefPtr<Attr>>(attribute_nodes_.begin(),
+                                   attribute_nodes_.end());
 }
 
 ElementFactory::ElementFactory() {
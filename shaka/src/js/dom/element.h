@@ -21,6 +21,7 @@
 
 #include "shaka/optional.h"
 #include "src/js/dom/container_node.h"
+#include "src/util/atom_table.h"
 
 namespace shaka {
 namespace js {
@@ -35,7 +36,7 @@ class Element : public ContainerNode {
   DECLARE_TYPE_INFO(Element);
 
  public:
-  Element(RefPtr<Document> document, const std::string& local_name,
+  Element(RefPtr<Document> document, std::string local_name,
           optional<std::string> namespace_uri,
           optional<std::string> namespace_prefix);
 
@@ -66,11 +67,49 @@ class Element : public ContainerNode {
   virtual void RemoveAttribute(const std::string& attr);
   void RemoveAttributeNS(const std::string& ns, const std::string& attr);
 
+  /**
+   * Adds a new attribute without checking for an existing one with the same
+   * name.  This is used by the parser since the XML parser already rejects
+   * duplicate attributes; this avoids searching the attributes for each one
+   * added.
+   */
+  void AddParsedAttribute(optional<std::string> namespace_uri,
+                          optional<std::string> namespace_prefix,
+                          std::string local_name, std::string value);
+
   std::vector<RefPtr<Attr>> attributes() const;
 
  private:
-  using attr_iter = std::vector<Member<Attr>>::iterator;
-  using const_attr_iter = std::vector<Member<Attr>>::const_iterator;
+  friend class Document;
+
+  /**
+   * The data of a single attribute.  Parsed documents (e.g. manifests) have
+   * many attributes that are only read with GetAttribute, so the Attr objects
+   * are only created when JavaScript asks for them.
+   */
+  struct AttrData {
+    AttrData(optional<std::string> namespace_uri,
+             optional<std::string> namespace_prefix, std::string local_name,
+             std::string value);
+    ~AttrData();
+
+    AttrData(AttrData&&);
+    AttrData& operator=(AttrData&&);
+
+    optional<std::string> namespace_uri;
+    optional<std::string> namespace_prefix;
+    std::string local_name;
+    std::string value;
+    // The interned qualified name and local name, so lookups compare integers
+    // instead of building and comparing strings.
+    util::AtomTable::Atom name_atom;
+    util::AtomTable::Atom local_name_atom;
+
+    std::string attr_name() const;
+  };
+
+  using attr_iter = std::vector<AttrData>::iterator;
+  using const_attr_iter = std::vector<AttrData>::const_iterator;
 
   attr_iter FindAttribute(const std::string& name);
   const_attr_iter FindAttribute(const std::string& name) const {
@@ -83,7 +122,20 @@ class Element : public ContainerNode {
     return const_cast<Element*>(this)->FindAttributeNS(ns, name);
   }
 
-  std::vector<Member<Attr>> attributes_;
+  /** Removes the given attribute and its Attr object, if created. */
+  void EraseAttribute(attr_iter it);
+
+  std::vector<AttrData> attributes_;
+  // The Attr objects for |attributes_|, in the same order.  This is empty
+  // until attributes() is called.
+  mutable std::vector<Member<Attr>> attribute_nodes_;
+
+  // The position of this element in its Document's tag index; this is only
+  // valid if |index_stamp_| matches the Document's.  The descendants of
+  // this element are in the range (index_begin_, index_end_).
+  mutable uint64_t index_stamp_ = 0;
+  mutable uint32_t index_begin_ = 0;
+  mutable uint32_t index_end_ = 0;
 };
 
 class ElementFactory : public BackingObjectFactory<Element, ContainerNode> {
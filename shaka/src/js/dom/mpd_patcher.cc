@@ -0,0 +1,438 @@
+// Copyright 2020 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     https://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "src/js/dom/mpd_patcher.h"
+
+#include <glog/logging.h>
+
+#include <cstdlib>
+#include <utility>
+
+#include "src/js/dom/document.h"
+#include "src/js/dom/element.h"
+#include "src/js/js_error.h"
+#include "src/util/clock.h"
+#include "src/util/url.h"
+
+namespace shaka {
+namespace js {
+namespace dom {
+
+namespace {
+
+/** One step of a patch selector, e.g. "Period[@id='1']" or "@duration". */
+struct SelectorStep {
+  std::string name;
+  bool is_attribute = false;
+  std::vector<std::pair<std::string, std::string>> attributes;
+  // The 1-based position among the matching siblings, or 0 for all.
+  size_t position = 0;
+};
+
+/** @return The given name without its namespace prefix. */
+std::string StripPrefix(const std::string& name) {
+  const size_t colon = name.find(':');
+  return colon == std::string::npos ? name : name.substr(colon + 1);
+}
+
+/**
+ * Parses a predicate, without the brackets, into |step|.  This only supports
+ * the forms used by MPD patches: an attribute value or a position.
+ */
+bool ParsePredicate(const std::string& pred, SelectorStep* step) {
+  if (pred.empty())
+    return false;
+  if (pred[0] != '@') {
+    char* end;
+    const unsigned long pos = strtoul(pred.c_str(), &end, 10);  // NOLINT
+    if (*end != '\0' || pos == 0)
+      return false;
+    step->position = pos;
+    return true;
+  }
+
+  const size_t equals = pred.find('=');
+  if (equals == std::string::npos || equals + 2 >= pred.size())
+    return false;
+  const char quote = pred[equals + 1];
+  if ((quote != '\'' && quote != '"') || pred.back() != quote)
+    return false;
+  step->attributes.emplace_back(
+      pred.substr(1, equals - 1),
+      pred.substr(equals + 2, pred.size() - equals - 3));
+  return true;
+}
+
+/**
+ * Parses a selector of the restricted XPath form MPD patches use, e.g.
+ * "/MPD/Period[@id='1']/AdaptationSet[2]/@id".
+ */
+bool ParseSelector(const std::string& sel, std::vector<SelectorStep>* steps) {
+  if (sel.empty() || sel[0] != '/')
+    return false;
+
+  size_t pos = 1;
+  while (pos <= sel.size()) {
+    // Find the end of the step, skipping slashes within predicates.
+    size_t end = pos;
+    char quote = '\0';
+    for (; end < sel.size(); end++) {
+      if (quote) {
+        if (sel[end] == quote)
+          quote = '\0';
+      } else if (sel[end] == '\'' || sel[end] == '"') {
+        quote = sel[end];
+      } else if (sel[end] == '/') {
+        break;
+      }
+    }
+    const std::string text = sel.substr(pos, end - pos);
+    pos = end + 1;
+
+    SelectorStep step;
+    const size_t bracket = text.find('[');
+    step.name = text.substr(0, bracket);
+    if (!steps->empty() && steps->back().is_attribute)
+      return false;
+    if (!step.name.empty() && step.name[0] == '@') {
+      step.is_attribute = true;
+      step.name = step.name.substr(1);
+      if (bracket != std::string::npos)
+        return false;
+    } else {
+      step.name = StripPrefix(step.name);
+    }
+    if (step.name.empty())
+      return false;
+
+    size_t pred_start = bracket;
+    while (pred_start != std::string::npos) {
+      const size_t pred_end = text.find(']', pred_start);
+      if (pred_end == std::string::npos)
+        return false;
+      const std::string pred =
+          text.substr(pred_start + 1, pred_end - pred_start - 1);
+      if (!ParsePredicate(pred, &step))
+        return false;
+      if (pred_end + 1 == text.size())
+        break;
+      if (text[pred_end + 1] != '[')
+        return false;
+      pred_start = pred_end + 1;
+    }
+    steps->emplace_back(std::move(step));
+  }
+  return !steps->empty() && !steps->front().is_attribute;
+}
+
+bool MatchesStep(const Element* elem, const SelectorStep& step) {
+  if (step.name != "*" && elem->local_name != step.name)
+    return false;
+  for (const auto& attr : step.attributes) {
+    auto value = elem->GetAttribute(attr.first);
+    if (!value.has_value() || value.value() != attr.second)
+      return false;
+  }
+  return true;
+}
+
+/**
+ * Finds the element the given selector refers to.  If the selector ends with
+ * an attribute, |attribute| is set to its name.
+ * @return The element, or nullptr if it doesn't refer to exactly one element.
+ */
+Element* FindTarget(Document* doc, const std::string& sel,
+                    std::string* attribute) {
+  std::vector<SelectorStep> steps;
+  if (!ParseSelector(sel, &steps))
+    return nullptr;
+
+  std::vector<Node*> current = {doc};
+  for (const SelectorStep& step : steps) {
+    if (step.is_attribute) {
+      *attribute = step.name;
+      break;
+    }
+
+    std::vector<Node*> next;
+    for (Node* node : current) {
+      size_t count = 0;
+      for (const auto& child : node->children()) {
+        if (!child->is_element())
+          continue;
+        Element* elem = static_cast<Element*>(child.get());
+        if (!MatchesStep(elem, step))
+          continue;
+        count++;
+        if (step.position == 0 || step.position == count)
+          next.push_back(elem);
+      }
+    }
+    current = std::move(next);
+  }
+  return current.size() == 1 && current[0]->is_element()
+             ? static_cast<Element*>(current[0])
+             : nullptr;
+}
+
+/** @return The nodes to insert for the given add or replace operation. */
+std::vector<RefPtr<Node>> GetNewNodes(const Element* op) {
+  std::vector<RefPtr<Node>> ret;
+  for (const auto& child : op->children()) {
+    if (child->is_element())
+      ret.emplace_back(child);
+  }
+  return ret;
+}
+
+/** Applies a single patch operation to |doc|. */
+bool ApplyOperation(Document* doc, const Element* op) {
+  auto sel = op->GetAttribute("sel");
+  if (!sel.has_value())
+    return false;
+  std::string attribute;
+  RefPtr<Element> target = FindTarget(doc, sel.value(), &attribute);
+  if (!target)
+    return false;
+
+  const std::string& type = op->local_name;
+  if (type == "add") {
+    auto attr_type = op->GetAttribute("type");
+    if (attr_type.has_value()) {
+      if (!attribute.empty() || attr_type->empty() || attr_type->at(0) != '@')
+        return false;
+      target->SetAttribute(attr_type->substr(1),
+                           op->TextContent().value_or(""));
+      return true;
+    }
+    if (!attribute.empty())
+      return false;
+
+    const std::string pos = op->GetAttribute("pos").value_or("");
+    RefPtr<Node> parent = target;
+    RefPtr<Node> before;
+    if (pos == "prepend") {
+      before = target->first_child();
+    } else if (pos == "before" || pos == "after") {
+      parent = target->parent_node();
+      if (!parent || parent->is_document())
+        return false;
+      before = target;
+      if (pos == "after") {
+        const auto& siblings = parent->children();
+        before = nullptr;
+        for (size_t i = 0; i + 1 < siblings.size(); i++) {
+          if (siblings[i].get() == target.get())
+            before = siblings[i + 1];
+        }
+      }
+    } else if (!pos.empty()) {
+      return false;
+    }
+    for (RefPtr<Node>& node : GetNewNodes(op))
+      parent->InsertBefore(node, before);
+    return true;
+  }
+
+  if (type == "replace") {
+    if (!attribute.empty()) {
+      if (!target->HasAttribute(attribute))
+        return false;
+      target->SetAttribute(attribute, op->TextContent().value_or(""));
+      return true;
+    }
+
+    RefPtr<Node> parent = target->parent_node();
+    std::vector<RefPtr<Node>> nodes = GetNewNodes(op);
+    if (!parent || (parent->is_document() && nodes.size() != 1))
+      return false;
+    for (RefPtr<Node>& node : nodes)
+      parent->InsertBefore(node, target);
+    parent->RemoveChild(target);
+    return true;
+  }
+
+  if (type == "remove") {
+    if (!attribute.empty()) {
+      if (!target->HasAttribute(attribute))
+        return false;
+      target->RemoveAttribute(attribute);
+      return true;
+    }
+    RefPtr<Node> parent = target->parent_node();
+    if (!parent || parent->is_document())
+      return false;
+    parent->RemoveChild(target);
+    return true;
+  }
+
+  return false;
+}
+
+}  // namespace
+
+MpdPatcher::Manifest::Manifest() : expires_at(0) {}
+MpdPatcher::Manifest::~Manifest() {}
+MpdPatcher::Manifest::Manifest(Manifest&&) = default;
+MpdPatcher::Manifest& MpdPatcher::Manifest::operator=(Manifest&&) = default;
+
+MpdPatcher::MpdPatcher() : mutex_("MpdPatcher") {}
+MpdPatcher::~MpdPatcher() {}
+
+MpdPatcher* MpdPatcher::Instance() {
+  static MpdPatcher instance;
+  return &instance;
+}
+
+void MpdPatcher::OnDocumentParsed(RefPtr<Document> doc,
+                                  const std::string& url) {
+  RefPtr<Element> root = doc->DocumentElement();
+  if (!root || root->local_name != "MPD")
+    return;
+
+  Manifest manifest;
+  manifest.document = doc;
+  manifest.url = url;
+  manifest.mpd_id = root->GetAttribute("id").value_or("");
+  manifest.publish_time = root->GetAttribute("publishTime").value_or("");
+
+  std::unique_lock<Mutex> lock(mutex_);
+  auto it = FindLocked(manifest.mpd_id);
+  if (it != manifests_.end())
+    manifests_.erase(it);
+  if (manifest.mpd_id.empty() || manifest.publish_time.empty() ||
+      !ReadPatchLocation(&manifest)) {
+    return;
+  }
+
+  if (manifests_.size() >= kMaxManifests)
+    manifests_.erase(manifests_.begin());
+  manifests_.emplace_back(std::move(manifest));
+}
+
+ExceptionOr<RefPtr<Document>> MpdPatcher::MaybeApplyPatch(
+    RefPtr<Document> patch) {
+  RefPtr<Element> root = patch->DocumentElement();
+  if (!root || root->local_name != "Patch")
+    return patch;
+  const std::string mpd_id = root->GetAttribute("mpdId").value_or("");
+  const std::string original =
+      root->GetAttribute("originalPublishTime").value_or("");
+
+  std::unique_lock<Mutex> lock(mutex_);
+  auto it = FindLocked(mpd_id);
+  if (it == manifests_.end())
+    return patch;
+  if (it->publish_time != original) {
+    manifests_.erase(it);
+    return JsError::DOMException(
+        InvalidStateError, "MPD patch doesn't apply to the current manifest");
+  }
+
+  // Copy the operations first since applying them moves nodes out of |root|.
+  std::vector<RefPtr<Element>> ops;
+  for (const auto& child : root->children()) {
+    if (child->is_element())
+      ops.emplace_back(static_cast<Element*>(child.get()));
+  }
+  for (const RefPtr<Element>& op : ops) {
+    if (!ApplyOperation(it->document.get(), op.get())) {
+      LOG(WARNING) << "Unable to apply MPD patch operation "
+                   << op->local_name << " "
+                   << op->GetAttribute("sel").value_or("");
+      manifests_.erase(it);
+      return JsError::DOMException(NotFoundError,
+                                   "Unable to apply MPD patch");
+    }
+  }
+
+  RefPtr<Element> mpd = it->document->DocumentElement();
+  const auto publish_time = root->GetAttribute("publishTime");
+  if (publish_time.has_value())
+    mpd->SetAttribute("publishTime", publish_time.value());
+  it->publish_time = mpd->GetAttribute("publishTime").value_or("");
+  RefPtr<Document> ret = it->document;
+  if (!ReadPatchLocation(&*it))
+    manifests_.erase(it);
+  return ret;
+}
+
+std::string MpdPatcher::GetPatchUrl(const std::string& manifest_url) const {
+  const uint64_t now = util::Clock::Instance.GetMonotonicTime();
+  std::unique_lock<Mutex> lock(mutex_);
+  for (const Manifest& manifest : manifests_) {
+    if (manifest.url == manifest_url &&
+        (manifest.expires_at == 0 || now < manifest.expires_at)) {
+      return manifest.patch_url;
+    }
+  }
+  return "";
+}
+
+void MpdPatcher::OnPatchFailed(const std::string& manifest_url) {
+  // Only forget the URL; the Document is released on the main thread once
+  // the full manifest is parsed again.
+  std::unique_lock<Mutex> lock(mutex_);
+  for (Manifest& manifest : manifests_) {
+    if (manifest.url == manifest_url)
+      manifest.patch_url.clear();
+  }
+}
+
+void MpdPatcher::Clear() {
+  std::unique_lock<Mutex> lock(mutex_);
+  manifests_.clear();
+}
+
+bool MpdPatcher::ReadPatchLocation(Manifest* manifest) {
+  RefPtr<Element> root = manifest->document->DocumentElement();
+  for (const auto& child : root->children()) {
+    if (!child->is_element() ||
+        static_cast<Element*>(child.get())->local_name != "PatchLocation") {
+      continue;
+    }
+
+    Element* location = static_cast<Element*>(child.get());
+    const std::string text = location->TextContent().value_or("");
+    manifest->patch_url.clear();
+    if (!manifest->url.empty() &&
+        !util::ResolveUrl(manifest->url, text, &manifest->patch_url)) {
+      return false;
+    }
+
+    manifest->expires_at = 0;
+    auto ttl = location->GetAttribute("ttl");
+    if (ttl.has_value()) {
+      const double seconds = strtod(ttl->c_str(), nullptr);
+      manifest->expires_at =
+          util::Clock::Instance.GetMonotonicTime() +
+          static_cast<uint64_t>(seconds > 0 ? seconds * 1000 : 0);
+    }
+    return true;
+  }
+  return false;
+}
+
+std::vector<MpdPatcher::Manifest>::iterator MpdPatcher::FindLocked(
+    const std::string& mpd_id) {
+  for (auto it = manifests_.begin(); it != manifests_.end(); it++) {
+    if (it->mpd_id == mpd_id)
+      return it;
+  }
+  return manifests_.end();
+}
+
+}  // namespace dom
+}  // namespace js
+}  // namespace shaka
@@ -0,0 +1,123 @@
+// Copyright 2020 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     https://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef SHAKA_EMBEDDED_JS_DOM_MPD_PATCHER_H_
+#define SHAKA_EMBEDDED_JS_DOM_MPD_PATCHER_H_
+
+#include <stdint.h>
+
+#include <string>
+#include <vector>
+
+#include "src/core/ref_ptr.h"
+#include "src/debug/mutex.h"
+#include "src/mapping/exception_or.h"
+#include "src/util/macros.h"
+
+namespace shaka {
+namespace js {
+namespace dom {
+
+class Document;
+
+/**
+ * Keeps the recently parsed DASH manifests that have a PatchLocation so live
+ * manifest updates can be fetched as MPD Patch documents (ISO/IEC 23009-1
+ * 5.15, based on the RFC 5261 XML patch operations) instead of the whole
+ * manifest.  The patch is applied in place to the retained Document, so only
+ * the changed parts of the tree are created again.
+ *
+ * The Documents are only used on the JS main thread; the patch URLs can be
+ * queried and invalidated from any thread.
+ */
+class MpdPatcher {
+ public:
+  /** The maximum number of manifests to keep. */
+  static constexpr const size_t kMaxManifests = 4;
+
+  MpdPatcher();
+  ~MpdPatcher();
+
+  SHAKA_NON_COPYABLE_OR_MOVABLE_TYPE(MpdPatcher);
+
+  static MpdPatcher* Instance();
+
+  /**
+   * Called when a document was parsed.  If it is an MPD with an id,
+   * publishTime, and PatchLocation, it is kept so later patches can be applied
+   * to it.  This must be called on the JS main thread.
+   *
+   * @param doc The parsed document.
+   * @param url The URL the manifest was downloaded from, or empty if unknown.
+   */
+  void OnDocumentParsed(RefPtr<Document> doc, const std::string& url);
+
+  /**
+   * If |patch| is an MPD Patch for a kept manifest, applies it to that
+   * manifest.  This must be called on the JS main thread.
+   *
+   * @return The patched manifest, |patch| itself if it isn't a patch for a
+   *   kept manifest, or an error if the patch couldn't be applied.  On error,
+   *   the manifest is no longer kept so the next update fetches all of it.
+   */
+  ExceptionOr<RefPtr<Document>> MaybeApplyPatch(RefPtr<Document> patch);
+
+  /**
+   * @return The URL to fetch a patch from instead of downloading the manifest
+   *   at the given URL, or an empty string to download the manifest.
+   */
+  std::string GetPatchUrl(const std::string& manifest_url) const;
+
+  /**
+   * Called when fetching a patch for the given manifest URL failed; the next
+   * update will download the whole manifest.
+   */
+  void OnPatchFailed(const std::string& manifest_url);
+
+  /** Drops all the kept manifests; this is called when the engine stops. */
+  void Clear();
+
+ private:
+  struct Manifest {
+    Manifest();
+    ~Manifest();
+
+    Manifest(Manifest&&);
+    Manifest& operator=(Manifest&&);
+
+    RefPtr<Document> document;
+    std::string url;
+    std::string mpd_id;
+    std::string publish_time;
+    std::string patch_url;
+    // The monotonic time, in milliseconds, the patch URL expires at, or 0 if
+    // it doesn't expire.
+    uint64_t expires_at;
+  };
+
+  /** Reads the PatchLocation of the kept manifest into |manifest|. */
+  static bool ReadPatchLocation(Manifest* manifest);
+
+  std::vector<Manifest>::iterator FindLocked(const std::string& mpd_id);
+
+  mutable Mutex mutex_;
+  // The kept manifests, oldest first.
+  std::vector<Manifest> manifests_;
+};
+
+}  // namespace dom
+}  // namespace js
+}  // namespace shaka
+
+#endif  // SHAKA_EMBEDDED_JS_DOM_MPD_PATCHER_H_
@@ -14,6 +14,9 @@
 
 #include "src/js/dom/node.h"
 
+#include <algorithm>
+#include <utility>
+
 #include "src/js/dom/document.h"
 #include "src/js/dom/element.h"
 #include "src/js/js_error.h"
@@ -24,8 +27,8 @@ namespace js {
 namespace dom {
 
 Node::Node(NodeType type, RefPtr<Document> document)
-    : owner_document_(document), node_type_(type) {
-  DCHECK(!document.empty() || type == DOCUMENT_NODE);
+    : owner_document_(std::move(document)), node_type_(type) {
+  DCHECK(!owner_document_.empty() || type == DOCUMENT_NODE);
 }
 
 // \cond Doxygen_Skip
@@ -74,6 +77,32 @@ RefPtr<Node> Node::AppendChild(RefPtr<Node> new_child) {
 
   new_child->parent_ = this;
   children_.emplace_back(new_child);
+  OnChildrenChanged();
+  return new_child;
+}
+
+RefPtr<Node> Node::InsertBefore(RefPtr<Node> new_child,
+                                RefPtr<Node> ref_child) {
+  if (!ref_child)
+    return AppendChild(new_child);
+
+  CHECK(is_element() || node_type_ == DOCUMENT_NODE);
+  CHECK(new_child);
+  CHECK_EQ(ref_child->parent_node(), this);
+  if (new_child == ref_child)
+    return new_child;
+
+  if (new_child->parent_node()) {
+    new_child->parent_node()->RemoveChild(new_child);
+  }
+
+  auto it = std::find_if(children_.begin(), children_.end(),
+                         [&](const Member<Node>& child) {
+                           return child.get() == ref_child.get();
+                         });
+  new_child->parent_ = this;
+  children_.emplace(it, new_child);
+  OnChildrenChanged();
   return new_child;
 }
 
@@ -84,9 +113,21 @@ RefPtr<Node> Node::RemoveChild(RefPtr<Node> to_remove) {
 
   to_remove->parent_ = nullptr;
   util::RemoveElement(&children_, to_remove);
+  OnChildrenChanged();
   return to_remove;
 }
 
+void Node::OnChildrenChanged() {
+  // Only a Document indexes its tree, so find the root of this tree.  This
+  // can't use |owner_document_| since a node can be moved to another
+  // Document's tree.
+  Node* root = this;
+  while (root->parent_)
+    root = root->parent_.get();
+  if (root->is_document())
+    static_cast<Document*>(root)->InvalidateIndex();
+}
+
 
 NodeFactory::NodeFactory() {
   AddConstant("ELEMENT_NODE", Node::ELEMENT_NODE);
@@ -124,6 +165,7 @@ NodeFactory::NodeFactory() {
   AddGenericProperty("textContent", &Node::TextContent);
 
   AddMemberFunction("appendChild", &Node::AppendChild);
+  AddMemberFunction("insertBefore", &Node::InsertBefore);
   AddMemberFunction("removeChild", &Node::RemoveChild);
 
   NotImplemented("parentElement");
@@ -135,7 +177,6 @@ NodeFactory::NodeFactory() {
   NotImplemented("normalize");
   NotImplemented("contains");
 
-  NotImplemented("insertBefore");
   NotImplemented("replaceChild");
 
   NotImplemented("isConnected");
@@ -104,9 +104,14 @@ class Node : public events::EventTarget {
 
   RefPtr<Node> AppendChild(RefPtr<Node> new_child);
 
+  RefPtr<Node> InsertBefore(RefPtr<Node> new_child, RefPtr<Node> ref_child);
+
   RefPtr<Node> RemoveChild(RefPtr<Node> to_remove);
 
   // Internal only methods.
+  const std::vector<Member<Node>>& children() const {
+    return children_;
+  }
   bool is_document() const {
     return node_type_ == DOCUMENT_NODE;
   }
@@ -120,6 +125,9 @@ class Node : public events::EventTarget {
   }
 
  private:
+  /** Called when the children of this node change. */
+  void OnChildrenChanged();
+
   std::vector<Member<Node>> children_;
   Member<Node> parent_;
   const Member<Document> owner_document_;
@@ -15,6 +15,7 @@
 #include "src/js/dom/text.h"
 
 #include <deque>
+#include <utility>
 
 #include "src/js/dom/container_node.h"
 #include "src/js/dom/document.h"
@@ -24,7 +25,7 @@ namespace js {
 namespace dom {
 
 Text::Text(RefPtr<Document> document, const std::string& data)
-    : CharacterData(TEXT_NODE, document, data) {}
+    : CharacterData(TEXT_NODE, std::move(document), data) {}
 
 // \cond Doxygen_Skip
 Text::~Text() {}
@@ -38,52 +38,140 @@ namespace {
 static_assert(sizeof(xmlChar) == sizeof(char), "Must be raw characters");
 
 
-XMLDocumentParser* GetParser(void* context) {
-  return reinterpret_cast<XMLDocumentParser*>(context);
+/**
+ * Records the SAX events into an XMLParsedEvents object.  This has the same
+ * callbacks as XMLDocumentParser, but doesn't create any nodes or JavaScript
+ * objects, so it can be used on any thread.
+ */
+class XMLEventRecorder {
+ public:
+  explicit XMLEventRecorder(XMLParsedEvents* parsed)
+      : parsed_(parsed), failed_(false) {}
+
+  bool failed() const {
+    return failed_;
+  }
+
+  void EndDocument() {
+    FinishText();
+  }
+
+  void StartElement(std::string local_name,
+                    optional<std::string> namespace_uri,
+                    optional<std::string> namespace_prefix,
+                    size_t attribute_count, const char** attributes) {
+    FinishText();
+    XMLParsedEvents::Event event;
+    event.type = XMLParsedEvents::Event::kStartElement;
+    event.text = std::move(local_name);
+    event.namespace_uri = std::move(namespace_uri);
+    event.namespace_prefix = std::move(namespace_prefix);
+    event.attributes.reserve(attribute_count);
+    for (size_t i = 0; i < attribute_count; i++) {
+      const char* namespace_uri = attributes[i * 5 + 2];
+      const char* namespace_prefix = attributes[i * 5 + 1];
+      event.attributes.push_back(
+          {namespace_uri ? optional<std::string>(namespace_uri) : nullopt,
+           namespace_uri && namespace_prefix
+               ? optional<std::string>(namespace_prefix)
+               : nullopt,
+           attributes[i * 5],
+           std::string(attributes[i * 5 + 3], attributes[i * 5 + 4])});
+    }
+    parsed_->events.emplace_back(std::move(event));
+  }
+
+  void EndElement() {
+    FinishText();
+    AddEvent(XMLParsedEvents::Event::kEndElement, "");
+  }
+
+  void Text(const char* text, size_t size) {
+    current_text_.append(text, size);
+  }
+
+  void Comment(const std::string& text) {
+    FinishText();
+    AddEvent(XMLParsedEvents::Event::kComment, text);
+  }
+
+  void Error(const std::string& /* message */) {
+    failed_ = true;
+  }
+
+  void ProcessingInstruction() {
+    failed_ = true;
+  }
+
+ private:
+  void AddEvent(XMLParsedEvents::Event::Type type, std::string text) {
+    XMLParsedEvents::Event event;
+    event.type = type;
+    event.text = std::move(text);
+    parsed_->events.emplace_back(std::move(event));
+  }
+
+  void FinishText() {
+    if (!current_text_.empty()) {
+      AddEvent(XMLParsedEvents::Event::kText, std::move(current_text_));
+      current_text_.clear();
+    }
+  }
+
+  XMLParsedEvents* parsed_;
+  std::string current_text_;
+  bool failed_;
+};
+
+
+template <typename Sink>
+Sink* GetSink(void* context) {
+  return reinterpret_cast<Sink*>(context);
 }
 
 std::string ToString(const xmlChar* data) {
   return reinterpret_cast<const char*>(data);
 }
 
-std::string ToString(const xmlChar* data, int length) {
-  auto* text = reinterpret_cast<const char*>(data);
-  return std::string(text, text + length);
-}
-
 
+template <typename Sink>
 void SaxEndDocument(void* context) {
-  GetParser(context)->EndDocument();
+  GetSink<Sink>(context)->EndDocument();
 }
 
+template <typename Sink>
 void SaxStartElementNS(void* context, const xmlChar* local_name,
                        const xmlChar* prefix, const xmlChar* namespace_uri,
                        int /* nb_namespaces */,
                        const xmlChar** /* namespaces */, int nb_attributes,
                        int /* nb_defaulted */, const xmlChar** attributes) {
-  GetParser(context)->StartElement(
+  GetSink<Sink>(context)->StartElement(
       ToString(local_name),
       namespace_uri ? optional<std::string>(ToString(namespace_uri)) : nullopt,
       prefix ? optional<std::string>(ToString(prefix)) : nullopt, nb_attributes,
       reinterpret_cast<const char**>(attributes));
 }
 
+template <typename Sink>
 void SaxEndElementNS(void* context, const xmlChar* /* localname */,
                      const xmlChar* /* prefix */, const xmlChar* /* URI */) {
-  GetParser(context)->EndElement();
+  GetSink<Sink>(context)->EndElement();
 }
 
+template <typename Sink>
 void SaxCharacters(void* context, const xmlChar* raw_data, int size) {
-  GetParser(context)->Text(ToString(raw_data, size));
+  GetSink<Sink>(context)->Text(reinterpret_cast<const char*>(raw_data), size);
 }
 
+template <typename Sink>
 void SaxProcessingInstruction(void* context, const xmlChar* /* target */,
                               const xmlChar* /* data */) {
-  GetParser(context)->SetException(JsError::DOMException(NotSupportedError));
+  GetSink<Sink>(context)->ProcessingInstruction();
 }
 
+template <typename Sink>
 void SaxComment(void* context, const xmlChar* raw_data) {
-  GetParser(context)->Comment(ToString(raw_data));
+  GetSink<Sink>(context)->Comment(ToString(raw_data));
 }
 
 PRINTF_FORMAT(2, 3)
@@ -96,6 +184,7 @@ void SaxWarning(  // NOLINT(cert-dcl50-cpp)
   va_end(args);
 }
 
+template <typename Sink>
 PRINTF_FORMAT(2, 3)
 void SaxError(  // NOLINT(cert-dcl50-cpp)
     void* context, const char* format, ...) {
@@ -104,24 +193,18 @@ void SaxError(  // NOLINT(cert-dcl50-cpp)
   std::string message = util::StringPrintfV(format, args);
   va_end(args);
 
-  GetParser(context)->SetException(
-      JsError::DOMException(UnknownError, message));
+  GetSink<Sink>(context)->Error(message);
 }
 
+template <typename Sink>
 void SaxCdata(void* context, const xmlChar* value, int len) {
   // We do not have a separate CDATA type, so treat as text.
-  GetParser(context)->Text(ToString(value, len));
+  GetSink<Sink>(context)->Text(reinterpret_cast<const char*>(value), len);
 }
 
-}  // namespace
-
-XMLDocumentParser::XMLDocumentParser(RefPtr<Document> document)
-    : document_(document), current_node_(document) {}
-
-XMLDocumentParser::~XMLDocumentParser() {}
-
-ExceptionOr<RefPtr<Document>> XMLDocumentParser::Parse(
-    const std::string& source) {
+/** Parses the given document, calling the SAX callbacks on |sink|. */
+template <typename Sink>
+int ParseWithSax(const std::string& source, Sink* sink) {
   // TODO: libxml says we should call xmlInitParser in case of multithreaded
   // programs; however it works without it.  We may not want to change global
   // state of libxml so embedders can use it without us changing it.
@@ -129,18 +212,42 @@ ExceptionOr<RefPtr<Document>> XMLDocumentParser::Parse(
   xmlSAXHandler sax;
   memset(&sax, 0, sizeof(sax));
   sax.initialized = XML_SAX2_MAGIC;
-  sax.endDocument = &SaxEndDocument;
-  sax.startElementNs = &SaxStartElementNS;
-  sax.endElementNs = &SaxEndElementNS;
-  sax.characters = &SaxCharacters;
-  sax.processingInstruction = &SaxProcessingInstruction;
-  sax.comment = &SaxComment;
+  sax.endDocument = &SaxEndDocument<Sink>;
+  sax.startElementNs = &SaxStartElementNS<Sink>;
+  sax.endElementNs = &SaxEndElementNS<Sink>;
+  sax.characters = &SaxCharacters<Sink>;
+  sax.processingInstruction = &SaxProcessingInstruction<Sink>;
+  sax.comment = &SaxComment<Sink>;
   sax.warning = &SaxWarning;
-  sax.error = &SaxError;
-  sax.fatalError = &SaxError;
-  sax.cdataBlock = &SaxCdata;
+  sax.error = &SaxError<Sink>;
+  sax.fatalError = &SaxError<Sink>;
+  sax.cdataBlock = &SaxCdata<Sink>;
+
+  return xmlSAXUserParseMemory(&sax, sink, source.c_str(), source.size());
+}
+
+}  // namespace
+
+bool XMLParsedEvents::Parse(const std::string& source) {
+  events.clear();
+  XMLEventRecorder recorder(this);
+  const int code = ParseWithSax(source, &recorder);
+  if (code < 0 || recorder.failed()) {
+    events.clear();
+    return false;
+  }
+  return true;
+}
 
-  int code = xmlSAXUserParseMemory(&sax, this, source.c_str(), source.size());
+
+XMLDocumentParser::XMLDocumentParser(RefPtr<Document> document)
+    : document_(document), current_node_(document) {}
+
+XMLDocumentParser::~XMLDocumentParser() {}
+
+ExceptionOr<RefPtr<Document>> XMLDocumentParser::Parse(
+    const std::string& source) {
+  int code = ParseWithSax(source, this);
   if (code < 0) {
     LOG(ERROR) << "Error parsing XML document, code=" << code;
     return error_ ? std::move(*error_) : JsError::DOMException(UnknownError);
@@ -151,19 +258,51 @@ ExceptionOr<RefPtr<Document>> XMLDocumentParser::Parse(
   return document_;
 }
 
+RefPtr<Document> XMLDocumentParser::Replay(XMLParsedEvents* parsed) {
+  for (auto& event : parsed->events) {
+    switch (event.type) {
+      case XMLParsedEvents::Event::kStartElement: {
+        RefPtr<Element> child = PushElement(std::move(event.text),
+                                            std::move(event.namespace_uri),
+                                            std::move(event.namespace_prefix));
+        for (auto& attr : event.attributes) {
+          child->AddParsedAttribute(
+              std::move(attr.namespace_uri), std::move(attr.namespace_prefix),
+              std::move(attr.local_name), std::move(attr.value));
+        }
+        break;
+      }
+      case XMLParsedEvents::Event::kEndElement:
+        EndElement();
+        break;
+      case XMLParsedEvents::Event::kText:
+        current_node_->AppendChild(document_->CreateTextNode(event.text));
+        break;
+      case XMLParsedEvents::Event::kComment:
+        Comment(event.text);
+        break;
+    }
+  }
+  parsed->events.clear();
+  return document_;
+}
+
 void XMLDocumentParser::EndDocument() {
   FinishTextNode();
 }
 
-void XMLDocumentParser::StartElement(const std::string& local_name,
+void XMLDocumentParser::StartElement(std::string local_name,
                                      optional<std::string> namespace_uri,
                                      optional<std::string> namespace_prefix,
                                      size_t attribute_count,
                                      const char** attributes) {
   FinishTextNode();
 
+  // Large manifests have many elements, so avoid copying the names and avoid
+  // searching the existing attributes when adding new ones.
   RefPtr<Element> child =
-      new Element(document_, local_name, namespace_uri, namespace_prefix);
+      PushElement(std::move(local_name), std::move(namespace_uri),
+                  std::move(namespace_prefix));
   for (size_t i = 0; i < attribute_count; i++) {
     // Each attribute has the following values in |attributes|.
     const char* local_name = attributes[i * 5];
@@ -172,22 +311,13 @@ void XMLDocumentParser::StartElement(const std::string& local_name,
     const char* value_begin = attributes[i * 5 + 3];
     const char* value_end = attributes[i * 5 + 4];
 
-    if (namespace_uri) {
-      std::string qualified_name;
-      if (namespace_prefix)
-        qualified_name = std::string(namespace_prefix) + ":" + local_name;
-      else
-        qualified_name = local_name;
-
-      child->SetAttributeNS(namespace_uri, qualified_name,
-                            std::string(value_begin, value_end));
-    } else {
-      child->SetAttribute(local_name, std::string(value_begin, value_end));
-    }
+    child->AddParsedAttribute(
+        namespace_uri ? optional<std::string>(namespace_uri) : nullopt,
+        namespace_uri && namespace_prefix
+            ? optional<std::string>(namespace_prefix)
+            : nullopt,
+        local_name, std::string(value_begin, value_end));
   }
-
-  current_node_->AppendChild(child);
-  current_node_ = child;
 }
 
 void XMLDocumentParser::EndElement() {
@@ -196,8 +326,8 @@ void XMLDocumentParser::EndElement() {
   DCHECK(!current_node_.empty());
 }
 
-void XMLDocumentParser::Text(const std::string& text) {
-  current_text_.append(text);
+void XMLDocumentParser::Text(const char* text, size_t size) {
+  current_text_.append(text, size);
 }
 
 void XMLDocumentParser::Comment(const std::string& text) {
@@ -205,8 +335,12 @@ void XMLDocumentParser::Comment(const std::string& text) {
   current_node_->AppendChild(document_->CreateComment(text));
 }
 
-void XMLDocumentParser::SetException(JsError error) {
-  error_.reset(new JsError(std::move(error)));
+void XMLDocumentParser::Error(const std::string& message) {
+  error_.reset(new JsError(JsError::DOMException(UnknownError, message)));
+}
+
+void XMLDocumentParser::ProcessingInstruction() {
+  error_.reset(new JsError(JsError::DOMException(NotSupportedError)));
 }
 
 void XMLDocumentParser::FinishTextNode() {
@@ -216,6 +350,17 @@ void XMLDocumentParser::FinishTextNode() {
   }
 }
 
+RefPtr<Element> XMLDocumentParser::PushElement(
+    std::string local_name, optional<std::string> namespace_uri,
+    optional<std::string> namespace_prefix) {
+  RefPtr<Element> child =
+      new Element(document_, std::move(local_name), std::move(namespace_uri),
+                  std::move(namespace_prefix));
+  current_node_->AppendChild(child);
+  current_node_ = child;
+  return child;
+}
+
 }  // namespace dom
 }  // namespace js
 }  // namespace shaka
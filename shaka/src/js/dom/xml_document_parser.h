@@ -28,10 +28,52 @@
 namespace shaka {
 namespace js {
 namespace dom {
-class Node;
 class Document;
+class Element;
+class Node;
 class Text;
 
+/**
+ * The SAX events from parsing an XML document.  This doesn't contain any nodes
+ * or JavaScript objects, so documents can be parsed into this on a background
+ * thread and the nodes created later on the main thread.
+ */
+struct XMLParsedEvents {
+  struct Attribute {
+    optional<std::string> namespace_uri;
+    optional<std::string> namespace_prefix;
+    std::string local_name;
+    std::string value;
+  };
+
+  struct Event {
+    enum Type {
+      kStartElement,
+      kEndElement,
+      kText,
+      kComment,
+    };
+
+    Type type;
+    // The local name for elements, or the contents of text/comment nodes.
+    std::string text;
+    optional<std::string> namespace_uri;
+    optional<std::string> namespace_prefix;
+    std::vector<Attribute> attributes;
+  };
+
+  std::vector<Event> events;
+
+  /**
+   * Parses the given document into events.  This can be called from any
+   * thread.
+   *
+   * @return True on success, false on error.  Errors are only reported when
+   *   parsing the document with XMLDocumentParser.
+   */
+  bool Parse(const std::string& source);
+};
+
 /**
  * Parses XML text data into a DOM tree.  All work is synchronous and no events
  * are fired.  This also is a strict parser, so it will reject documents that
@@ -50,22 +92,34 @@ class XMLDocumentParser {
 
   ExceptionOr<RefPtr<Document>> Parse(const std::string& source);
 
+  /**
+   * Creates the nodes from events that were already parsed.  This moves the
+   * strings out of |parsed|.
+   */
+  RefPtr<Document> Replay(XMLParsedEvents* parsed);
+
   // Callbacks from SAX
   void EndDocument();
-  void StartElement(const std::string& local_name,
+  void StartElement(std::string local_name,
                     optional<std::string> namespace_uri,
                     optional<std::string> namespace_prefix,
                     size_t attribute_count,
                     const char** attributes);
   void EndElement();
-  void Text(const std::string& text);
+  void Text(const char* text, size_t size);
   void Comment(const std::string& text);
-  void SetException(JsError error);
+  void Error(const std::string& message);
+  void ProcessingInstruction();
 
  private:
   /** If there is any cached text, create a new Text node for it. */
   void FinishTextNode();
 
+  /** Adds a new element as a child of the current node and enters it. */
+  RefPtr<Element> PushElement(std::string local_name,
+                              optional<std::string> namespace_uri,
+                              optional<std::string> namespace_prefix);
+
   const Member<Document> document_;
   Member<Node> current_node_;
   std::string current_text_;
@@ -15,12 +15,16 @@
 #include "src/js/eme/search_registry.h"
 
 #include <memory>
+#include <sstream>
+#include <unordered_map>
 #include <utility>
 
 #include "shaka/eme/implementation.h"
 #include "shaka/eme/implementation_factory.h"
 #include "shaka/eme/implementation_registry.h"
+#include "src/core/js_manager_impl.h"
 #include "src/core/ref_ptr.h"
+#include "src/debug/mutex.h"
 #include "src/js/eme/media_key_system_access.h"
 #include "src/js/js_error.h"
 #include "src/mapping/js_utils.h"
@@ -249,12 +253,94 @@ bool GetSupportedConfiguration(
   return true;
 }
 
+/**
+ * Caches the results of GetSupportedConfiguration.  The implementations answer
+ * the same way each time, so a configuration only needs to be checked once.
+ */
+class ConfigurationCache {
+ public:
+  ConfigurationCache() : mutex_("ConfigurationCache") {}
+
+  static ConfigurationCache* Instance() {
+    static ConfigurationCache instance;
+    return &instance;
+  }
+
+  /** Like GetSupportedConfiguration, but uses the cached result if any. */
+  bool Get(std::shared_ptr<ImplementationFactory> implementation,
+           const MediaKeySystemConfiguration& candidate_config,
+           MediaKeySystemConfiguration* supported_config) {
+    const std::string key = MakeKey(implementation.get(), candidate_config);
+    {
+      std::unique_lock<Mutex> lock(mutex_);
+      auto it = entries_.find(key);
+      if (it != entries_.end()) {
+        if (it->second.supported)
+          *supported_config = it->second.config;
+        return it->second.supported;
+      }
+    }
+
+    // Don't hold the lock while asking the implementation since it can be
+    // slow.
+    Entry entry;
+    entry.supported = GetSupportedConfiguration(
+        implementation, candidate_config, &entry.config);
+    if (entry.supported)
+      *supported_config = entry.config;
+    const bool supported = entry.supported;
+
+    std::unique_lock<Mutex> lock(mutex_);
+    entries_.emplace(key, std::move(entry));
+    return supported;
+  }
+
+ private:
+  struct Entry {
+    bool supported = false;
+    MediaKeySystemConfiguration config;
+  };
+
+  static void AppendString(const std::string& str, std::stringstream* out) {
+    // Prefix the length so the fields can't run together.
+    *out << str.size() << ":" << str;
+  }
+
+  static std::string MakeKey(const ImplementationFactory* implementation,
+                             const MediaKeySystemConfiguration& config) {
+    std::stringstream ret;
+    ret << implementation << "|";
+    AppendString(config.label, &ret);
+    for (auto type : config.initDataTypes)
+      ret << "|i" << static_cast<int>(type);
+    for (auto& cap : config.audioCapabilities) {
+      ret << "|a";
+      AppendString(cap.contentType, &ret);
+      AppendString(cap.robustness, &ret);
+    }
+    for (auto& cap : config.videoCapabilities) {
+      ret << "|v";
+      AppendString(cap.contentType, &ret);
+      AppendString(cap.robustness, &ret);
+    }
+    ret << "|d" << static_cast<int>(config.distinctiveIdentifier) << "|p"
+        << static_cast<int>(config.persistentState);
+    for (auto type : config.sessionTypes)
+      ret << "|s" << static_cast<int>(type);
+    return ret.str();
+  }
+
+  Mutex mutex_;
+  std::unordered_map<std::string, Entry> entries_;
+};
+
 }  // namespace
 
 SearchRegistry::SearchRegistry(Promise promise, std::string key_system,
                                std::vector<MediaKeySystemConfiguration> configs)
     : promise_(MakeJsRef<Promise>(std::move(promise))),
-      key_system_(std::move(key_system)) {
+      key_system_(std::move(key_system)),
+      found_(false) {
   for (auto& config : configs) {
     configs_.emplace_back(
         MakeJsRef<MediaKeySystemConfiguration>(std::move(config)));
@@ -271,14 +357,27 @@ void SearchRegistry::operator()() {
   // reject promise with a NotSupportedError. String comparison is
   // case-sensitive.
   // 2. Let implementation be the implementation of keySystem.
-  auto implementation = ImplementationRegistry::GetImplementation(key_system_);
-  if (!implementation) {
+  implementation_ = ImplementationRegistry::GetImplementation(key_system_);
+  if (!implementation_) {
     VLOG(1) << "No implementation found for: " << key_system_;
     promise_->RejectWith(JsError::DOMException(
         NotSupportedError, "Key system " + key_system_ + " is not supported."));
     return;
   }
 
+  // Check the configurations on the worker thread, then settle the Promise
+  // back on the main thread.
+  std::shared_ptr<SearchRegistry> self(new SearchRegistry(std::move(*this)));
+  JsManagerImpl::Instance()->WorkerThread()->AddInternalTask(
+      TaskPriority::Internal, "probe eme configurations", [self]() {
+        self->Probe();
+        JsManagerImpl::Instance()->MainThread()->AddInternalTask(
+            TaskPriority::Internal, "finish eme registry search",
+            [self]() { self->Finish(); });
+      });
+}
+
+void SearchRegistry::Probe() {
   // 3. For each value in supportedConfigurations:
   for (auto& candidate_config : configs_) {
     // 1. Let candidate configuration be the value.
@@ -287,21 +386,27 @@ void SearchRegistry::operator()() {
     // configuration, and origin.
     // 3. If supported configuration is not NotSupported, run the following
     // steps:
-    MediaKeySystemConfiguration supported_config;
-    if (GetSupportedConfiguration(implementation, *candidate_config,
-                                  &supported_config)) {
-      // 1. Let access be a new MediaKeySystemAccess object, and initialize it
-      // as follows:
-      RefPtr<MediaKeySystemAccess> access(new MediaKeySystemAccess(
-          key_system_, supported_config, implementation));
-
-      // 2. Resolve promise with access and abort the parallel steps of this
-      // algorithm.
-      LocalVar<JsValue> value(ToJsValue(access));
-      promise_->ResolveWith(value);
+    if (ConfigurationCache::Instance()->Get(implementation_, *candidate_config,
+                                            &supported_config_)) {
+      found_ = true;
       return;
     }
   }
+}
+
+void SearchRegistry::Finish() {
+  if (found_) {
+    // 1. Let access be a new MediaKeySystemAccess object, and initialize it
+    // as follows:
+    RefPtr<MediaKeySystemAccess> access(new MediaKeySystemAccess(
+        key_system_, supported_config_, implementation_));
+
+    // 2. Resolve promise with access and abort the parallel steps of this
+    // algorithm.
+    LocalVar<JsValue> value(ToJsValue(access));
+    promise_->ResolveWith(value);
+    return;
+  }
 
   // 4. Reject promise with NotSupportedError.
   promise_->RejectWith(JsError::DOMException(
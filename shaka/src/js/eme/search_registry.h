@@ -15,10 +15,12 @@
 #ifndef SHAKA_EMBEDDED_JS_EME_SEARCH_REGISTRY_H_
 #define SHAKA_EMBEDDED_JS_EME_SEARCH_REGISTRY_H_
 
+#include <memory>
 #include <string>
 #include <vector>
 
 #include "shaka/eme/configuration.h"
+#include "shaka/eme/implementation_factory.h"
 #include "src/core/ref_ptr.h"
 #include "src/js/eme/media_key_system_configuration.h"
 #include "src/mapping/promise.h"
@@ -31,6 +33,12 @@ namespace eme {
 /**
  * A task type that searches the ImplementationRegistry for a compatible
  * implementation and resolves/rejects the given Promise appropriately.
+ *
+ * This is run on the main thread, but the configurations are checked against
+ * the implementation on the worker thread since a real CDM can be slow to
+ * answer.  This way, searches for several key systems don't block JavaScript
+ * and are checked while the app requests the others.  The answers are cached
+ * for the life of the process.
  */
 class SearchRegistry {
  public:
@@ -46,9 +54,17 @@ class SearchRegistry {
   void operator()();
 
  private:
+  /** Finds the first supported configuration; called on the worker thread. */
+  void Probe();
+  /** Settles the Promise with the result; called on the main thread. */
+  void Finish();
+
   RefPtr<Promise> promise_;
   std::string key_system_;
   std::vector<RefPtr<MediaKeySystemConfiguration>> configs_;
+  std::shared_ptr<ImplementationFactory> implementation_;
+  bool found_;
+  MediaKeySystemConfiguration supported_config_;
 };
 
 }  // namespace eme
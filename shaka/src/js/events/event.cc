@@ -23,12 +23,15 @@ namespace shaka {
 namespace js {
 namespace events {
 
-Event::Event(EventType type) : Event(to_string(type)) {}
+Event::Event(EventType type) : Event(to_string(type), ToEventAtom(type)) {}
 
-Event::Event(const std::string& type)
+Event::Event(const std::string& type) : Event(type, InternEventType(type)) {}
+
+Event::Event(const std::string& type, EventAtom type_atom)
     : type(type),
       time_stamp(util::Clock::Instance.GetMonotonicTime() -
-                 dom::Document::EnsureGlobalDocument()->created_at()) {}
+                 dom::Document::EnsureGlobalDocument()->created_at()),
+      type_atom_(type_atom) {}
 
 // \cond Doxygen_Skip
 Event::~Event() {}
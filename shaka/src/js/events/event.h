@@ -57,6 +57,10 @@ class Event : public BackingObject {
   bool is_immediate_stopped() const {
     return stop_immediate_propagation_;
   }
+  /** @return The interned value of |type|. */
+  EventAtom type_atom() const {
+    return type_atom_;
+  }
 
   // Exposed methods.
   void PreventDefault();
@@ -75,6 +79,9 @@ class Event : public BackingObject {
   bool default_prevented = false;
 
  private:
+  Event(const std::string& type, EventAtom type_atom);
+
+  const EventAtom type_atom_;
   bool stop_propagation_ = false;
   bool stop_immediate_propagation_ = false;
 };
@@ -0,0 +1,49 @@
+// Copyright 2020 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     https://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "src/js/events/event_coalescer.h"
+
+namespace shaka {
+namespace js {
+namespace events {
+
+EventCoalescer::EventCoalescer() : last_id_(0) {}
+
+void EventCoalescer::OnEventScheduled() {
+  last_id_++;
+}
+
+uint64_t EventCoalescer::OnCoalescedEventScheduled(EventType type) {
+  for (const PendingEvent& pending : pending_) {
+    if (pending.type == type && pending.id == last_id_)
+      return 0;
+  }
+
+  last_id_++;
+  pending_.push_back({type, last_id_});
+  return last_id_;
+}
+
+void EventCoalescer::OnCoalescedEventDispatched(uint64_t id) {
+  for (auto it = pending_.begin(); it != pending_.end(); it++) {
+    if (it->id == id) {
+      pending_.erase(it);
+      return;
+    }
+  }
+}
+
+}  // namespace events
+}  // namespace js
+}  // namespace shaka
@@ -0,0 +1,72 @@
+// Copyright 2020 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     https://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef SHAKA_EMBEDDED_JS_EVENTS_EVENT_COALESCER_H_
+#define SHAKA_EMBEDDED_JS_EVENTS_EVENT_COALESCER_H_
+
+#include <stdint.h>
+
+#include <vector>
+
+#include "src/js/events/event_names.h"
+
+namespace shaka {
+namespace js {
+namespace events {
+
+/**
+ * Decides which events scheduled on one target can be merged with one that is
+ * still pending.  An event is only merged when the pending one of the same
+ * type is the last event scheduled on the target; otherwise dropping it would
+ * change the order JavaScript sees (e.g. "waiting" before an earlier
+ * "playing").  This type isn't thread-safe.
+ */
+class EventCoalescer {
+ public:
+  EventCoalescer();
+
+  /** Records that an event that can't be coalesced was scheduled. */
+  void OnEventScheduled();
+
+  /**
+   * Records that an event that can be coalesced was scheduled.
+   * @return The ID of the new pending event, or 0 if it was merged with the
+   *   pending event before it and shouldn't be dispatched.
+   */
+  uint64_t OnCoalescedEventScheduled(EventType type);
+
+  /**
+   * Records that the pending event with the given ID is being dispatched.
+   * After this, a new event of that type won't be merged with it.
+   */
+  void OnCoalescedEventDispatched(uint64_t id);
+
+ private:
+  struct PendingEvent {
+    EventType type;
+    uint64_t id;
+  };
+
+  // The ID of the last event scheduled on the target, of any kind.
+  uint64_t last_id_;
+  // The coalesced events that haven't been dispatched yet.  There are only a
+  // few types, so a vector is fine.
+  std::vector<PendingEvent> pending_;
+};
+
+}  // namespace events
+}  // namespace js
+}  // namespace shaka
+
+#endif  // SHAKA_EMBEDDED_JS_EVENTS_EVENT_COALESCER_H_
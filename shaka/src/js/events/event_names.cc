@@ -0,0 +1,46 @@
+// Copyright 2020 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     https://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "src/js/events/event_names.h"
+
+#include <glog/logging.h>
+
+#include "src/util/atom_table.h"
+
+namespace shaka {
+namespace js {
+
+namespace {
+
+util::AtomTable* GetEventAtomTable() {
+  static util::AtomTable* table = []() {
+    // Add the built-in types first so they get the atoms ToEventAtom returns.
+    auto* ret = new util::AtomTable;
+    for (size_t i = 0; i < kEventTypeCount; i++) {
+      const EventType type = static_cast<EventType>(i);
+      CHECK_EQ(ret->Intern(to_string(type)), ToEventAtom(type));
+    }
+    return ret;
+  }();
+  return table;
+}
+
+}  // namespace
+
+EventAtom InternEventType(const std::string& type) {
+  return GetEventAtomTable()->Intern(type);
+}
+
+}  // namespace js
+}  // namespace shaka
@@ -15,6 +15,11 @@
 #ifndef SHAKA_EMBEDDED_JS_EVENTS_EVENT_NAMES_H_
 #define SHAKA_EMBEDDED_JS_EVENTS_EVENT_NAMES_H_
 
+#include <stddef.h>
+#include <stdint.h>
+
+#include <string>
+
 #include "src/util/macros.h"
 
 namespace shaka {
@@ -69,8 +74,31 @@ namespace js {
   DEFINE_EVENT(VersionChange, "versionchange")
 
 DEFINE_ENUM_AND_TO_STRING_2(EventType, DEFINE_EVENTS_);
+
+#define COUNT_EVENT_(name, str) +1
+/** The number of values in EventType. */
+constexpr const size_t kEventTypeCount = 0 DEFINE_EVENTS_(COUNT_EVENT_);
+#undef COUNT_EVENT_
 #undef DEFINE_EVENTS_
 
+/**
+ * A small integer that identifies an event type, so event listeners can be
+ * looked up by index instead of comparing type strings.  The values of
+ * EventType are their own atoms; other types (e.g. custom events from
+ * JavaScript) are given the following values as they are first seen.
+ */
+using EventAtom = uint32_t;
+
+inline EventAtom ToEventAtom(EventType type) {
+  return static_cast<EventAtom>(type);
+}
+
+/**
+ * Gets the atom for the given event type, adding it if it hasn't been seen.
+ * This is thread-safe.
+ */
+EventAtom InternEventType(const std::string& type);
+
 }  // namespace js
 }  // namespace shaka
 
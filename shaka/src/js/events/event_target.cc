@@ -14,8 +14,10 @@
 
 #include "src/js/events/event_target.h"
 
+#include <algorithm>
 #include <vector>
 
+#include "src/debug/mutex.h"
 #include "src/js/js_error.h"
 #include "src/memory/heap_tracer.h"
 
@@ -23,46 +25,107 @@ namespace shaka {
 namespace js {
 namespace events {
 
-EventTarget::EventTarget() : is_dispatching_(false) {}
+namespace {
+
+/** @return The mutex that guards EventTarget::coalescer_. */
+Mutex* GetCoalesceMutex() {
+  static Mutex mutex("EventTarget coalesce");
+  return &mutex;
+}
+
+}  // namespace
+
+EventTarget::EventTarget()
+    : is_dispatching_(false), has_removed_listeners_(false) {}
 // \cond Doxygen_Skip
 EventTarget::~EventTarget() {}
 // \endcond Doxygen_Skip
 
 void EventTarget::Trace(memory::HeapTracer* tracer) const {
   BackingObject::Trace(tracer);
-  for (auto& listener : listeners_) {
-    tracer->Trace(&listener.callback_);
+  for (auto& list : listeners_) {
+    for (auto& listener : list)
+      tracer->Trace(&listener.callback_);
   }
-  for (auto& pair : on_listeners_) {
-    tracer->Trace(pair.second);
+  for (Listener* on_field : on_listeners_) {
+    if (on_field)
+      tracer->Trace(on_field);
   }
 }
 
 void EventTarget::AddEventListener(const std::string& type, Listener callback) {
-  if (FindListener(callback, type) != listeners_.end())
+  const EventAtom atom = InternEventType(type);
+  if (listeners_.size() <= atom)
+    listeners_.resize(atom + 1);
+  ListenerList& list = listeners_[atom];
+  if (FindListener(list, callback) != list.size())
     return;
-  listeners_.emplace_back(callback, type);
+  list.emplace_back(callback);
 }
 
 void EventTarget::SetCppEventListener(EventType type,
                                       std::function<void()> callback) {
-  cpp_listeners_.emplace(to_string(type), callback);
+  const EventAtom atom = ToEventAtom(type);
+  if (cpp_listeners_.size() <= atom)
+    cpp_listeners_.resize(atom + 1);
+  if (!cpp_listeners_[atom])
+    cpp_listeners_[atom] = std::move(callback);
 }
 
 void EventTarget::RemoveEventListener(const std::string& type,
                                       Listener callback) {
-  auto it = FindListener(callback, type);
-  if (it != listeners_.end()) {
+  const EventAtom atom = InternEventType(type);
+  if (atom >= listeners_.size())
+    return;
+  ListenerList& list = listeners_[atom];
+  const size_t index = FindListener(list, callback);
+  if (index != list.size()) {
     if (is_dispatching_) {
-      it->should_remove_ = true;
+      list[index].should_remove_ = true;
+      has_removed_listeners_ = true;
     } else {
-      listeners_.erase(it);
+      list.erase(list.begin() + index);
     }
   }
 }
 
 void EventTarget::UnsetCppEventListener(EventType type) {
-  cpp_listeners_.erase(to_string(type));
+  const EventAtom atom = ToEventAtom(type);
+  if (atom < cpp_listeners_.size())
+    cpp_listeners_[atom] = nullptr;
+}
+
+void EventTarget::ScheduleCoalescedEvent(EventType type) {
+  uint64_t id;
+  {
+    std::unique_lock<Mutex> lock(*GetCoalesceMutex());
+    id = coalescer_.OnCoalescedEventScheduled(type);
+    if (id == 0)
+      return;
+  }
+
+  RefPtr<EventTarget> target(this);
+  JsManagerImpl::Instance()->MainThread()->PostTask(
+      TaskPriority::Events, [target, type, id]() {
+        // Remove it before dispatching so listeners can cause another one.
+        {
+          std::unique_lock<Mutex> lock(*GetCoalesceMutex());
+          target->coalescer_.OnCoalescedEventDispatched(id);
+        }
+
+        RefPtr<Event> event = new Event(type);
+        ExceptionOr<bool> val = target->DispatchEvent(std::move(event));
+        if (holds_alternative<JsError>(val)) {
+          LocalVar<JsValue> except = get<JsError>(val).error();
+          LOG(INFO) << "Exception thrown while raising event: "
+                    << ConvertToString(except);
+        }
+      });
+}
+
+void EventTarget::OnEventScheduled() {
+  std::unique_lock<Mutex> lock(*GetCoalesceMutex());
+  coalescer_.OnEventScheduled();
 }
 
 ExceptionOr<bool> EventTarget::DispatchEventInternal(
@@ -86,11 +149,15 @@ ExceptionOr<bool> EventTarget::DispatchEventInternal(
 
   // Now that we are done firing events, remove the event listeners that have
   // been marked for removal.
-  for (auto it = listeners_.begin(); it != listeners_.end();) {
-    if (it->should_remove_)
-      it = listeners_.erase(it);
-    else
-      ++it;
+  if (has_removed_listeners_) {
+    for (auto& list : listeners_) {
+      list.erase(std::remove_if(list.begin(), list.end(),
+                                [](const ListenerInfo& info) {
+                                  return info.should_remove_;
+                                }),
+                 list.end());
+    }
+    has_removed_listeners_ = false;
   }
 
   is_dispatching_ = false;
@@ -99,34 +166,32 @@ ExceptionOr<bool> EventTarget::DispatchEventInternal(
   return !event->default_prevented;
 }
 
-EventTarget::ListenerInfo::ListenerInfo(Listener listener,
-                                        const std::string& type)
-    : callback_(listener), type_(type), should_remove_(false) {}
+EventTarget::ListenerInfo::ListenerInfo(Listener listener)
+    : callback_(listener), should_remove_(false) {}
 
 EventTarget::ListenerInfo::~ListenerInfo() {}
 
-void EventTarget::InvokeListeners(RefPtr<Event> event,
+void EventTarget::InvokeListeners(const RefPtr<Event>& event,
                                   bool* did_listeners_throw) {
   if (event->is_stopped())
     return;
 
   event->current_target = this;
+  const EventAtom atom = event->type_atom();
 
   // First, evoke the cpp callbacks.  They have priority, due to being internal.
   // It is assumed that they will not change during this process.
-  if (cpp_listeners_.count(event->type) > 0)
-    cpp_listeners_.at(event->type)();
+  if (atom < cpp_listeners_.size() && cpp_listeners_[atom])
+    cpp_listeners_[atom]();
 
   // Invoke the on-event listeners second.  This is slightly different from
   // Chrome which will invoke it in the order it was set (i.e. calling
   // addEventListener then setting onerror will call callbacks in that order).
-  auto on_iter = on_listeners_.find(event->type);
-  if (on_iter != on_listeners_.end()) {
-    // Note that even though it exists in the map does not mean the field is
-    // set.
-    if (on_iter->second->has_value()) {
-      ExceptionOr<void> except =
-          on_iter->second->value().CallWithThis(this, event);
+  if (atom < on_listeners_.size() && on_listeners_[atom]) {
+    // Note that even though it is registered does not mean the field is set.
+    Listener* on_field = on_listeners_[atom];
+    if (on_field->has_value()) {
+      ExceptionOr<void> except = on_field->value().CallWithThis(this, event);
       if (holds_alternative<JsError>(except)) {
         OnUncaughtException(get<JsError>(except).error(),
                             /* in_promise */ false);
@@ -139,47 +204,42 @@ void EventTarget::InvokeListeners(RefPtr<Event> event,
     }
   }
 
-  if (listeners_.empty())
+  if (atom >= listeners_.size())
     return;
 
-  // Store the end of the list.  Elements are added to the end of the list so
-  // we will not fire events added after this one.  This needs to be inclusive
-  // since the pseudo-value for end() may not remain valid after insertions.
-  auto end = --listeners_.end();
-
-  // We need to process all items in the range [begin, end].  We cannot use a
-  // for loop because we still need to process the |end| element.  So we process
-  // |it|, then increment, then compare the old value to |end|.  Note that
-  // since |end| is valid, the last increment is still valid.
-  auto it = listeners_.begin();
-  do {
-    if (it->should_remove_)
+  // Listeners are added to the end of the list, so only invoke the ones that
+  // were there when dispatching started.  Listeners are only marked for
+  // removal while dispatching, so the indices stay valid.  Listeners added by
+  // a callback can reallocate the list, so copy the callback before calling it.
+  const size_t count = listeners_[atom].size();
+  for (size_t i = 0; i < count; i++) {
+    const ListenerInfo& info = listeners_[atom][i];
+    if (info.should_remove_ || !info.callback_.has_value())
       continue;
 
-    if (it->type_ == event->type && it->callback_.has_value()) {
-      ExceptionOr<void> except = it->callback_->CallWithThis(this, event);
-      if (holds_alternative<JsError>(except)) {
-        OnUncaughtException(get<JsError>(except).error(),
-                            /* in_promise */ false);
-        if (did_listeners_throw)
-          *did_listeners_throw = true;
-      }
+    const Callback callback = info.callback_.value();
+    ExceptionOr<void> except = callback.CallWithThis(this, event);
+    if (holds_alternative<JsError>(except)) {
+      OnUncaughtException(get<JsError>(except).error(),
+                          /* in_promise */ false);
+      if (did_listeners_throw)
+        *did_listeners_throw = true;
     }
 
     if (event->is_immediate_stopped())
       break;
-  } while ((it++) != end);
+  }
 }
 
-std::list<EventTarget::ListenerInfo>::iterator EventTarget::FindListener(
-    const Listener& callback, const std::string& type) {
-  auto it = listeners_.begin();
-  for (; it != listeners_.end(); it++) {
-    if (it->type_ == type && callback == it->callback_) {
+// static
+size_t EventTarget::FindListener(const ListenerList& list,
+                                 const Listener& callback) {
+  size_t i = 0;
+  for (; i < list.size(); i++) {
+    if (callback == list[i].callback_)
       break;
-    }
   }
-  return it;
+  return i;
 }
 
 EventTargetFactory::EventTargetFactory() {
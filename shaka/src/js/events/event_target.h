@@ -15,11 +15,10 @@
 #ifndef SHAKA_EMBEDDED_JS_EVENTS_EVENT_TARGET_H_
 #define SHAKA_EMBEDDED_JS_EVENTS_EVENT_TARGET_H_
 
-#include <list>
 #include <memory>
 #include <string>
-#include <unordered_map>
 #include <utility>
+#include <vector>
 
 #include "shaka/optional.h"
 #include "src/core/js_manager_impl.h"
@@ -27,6 +26,7 @@
 #include "src/core/ref_ptr.h"
 #include "src/debug/thread_event.h"
 #include "src/js/events/event.h"
+#include "src/js/events/event_coalescer.h"
 #include "src/js/events/event_names.h"
 #include "src/mapping/backing_object.h"
 #include "src/mapping/backing_object_factory.h"
@@ -84,7 +84,7 @@ class EventTarget : public BackingObject {
    * @return False if one listener called preventDefault, otherwise true.
    */
   ExceptionOr<bool> DispatchEvent(RefPtr<Event> event) {
-    return DispatchEventInternal(event, nullptr);
+    return DispatchEventInternal(std::move(event), nullptr);
   }
 
   /**
@@ -108,10 +108,11 @@ class EventTarget : public BackingObject {
   std::shared_ptr<ThreadEvent<bool>> ScheduleEvent(Args&&... args) {
     RefPtr<EventType> event = new EventType(std::forward<Args>(args)...);
     RefPtr<EventTarget> target(this);
+    OnEventScheduled();
     return JsManagerImpl::Instance()->MainThread()->AddInternalTask(
         TaskPriority::Events, std::string("Schedule ") + EventType::name(),
-        [=]() {
-          ExceptionOr<bool> val = target->DispatchEvent(event);
+        [=]() mutable {
+          ExceptionOr<bool> val = target->DispatchEvent(std::move(event));
           if (holds_alternative<bool>(val)) {
             return get<bool>(val);
           } else {
@@ -123,6 +124,15 @@ class EventTarget : public BackingObject {
         });
   }
 
+  /**
+   * Asynchronously raises a plain Event of the given type, unless one of the
+   * same type is pending for this object and no other event was scheduled
+   * after it.  This is used for events that can happen many times in a row
+   * (e.g. "ratechange"), so only one is dispatched per burst, without changing
+   * the order of events.  It is safe to call this from any thread.
+   */
+  void ScheduleCoalescedEvent(EventType type);
+
   /**
    * Synchronously raises the given event on this.  This must only be called
    * from the event thread.
@@ -130,41 +140,59 @@ class EventTarget : public BackingObject {
   template <typename EventType, typename... Args>
   ExceptionOr<bool> RaiseEvent(Args... args) {
     RefPtr<EventType> backing = new EventType(args...);
-    return this->DispatchEvent(backing);
+    return this->DispatchEvent(std::move(backing));
   }
 
  protected:
   /** Registers an event on the target. */
   void AddListenerField(EventType type, Listener* on_field) {
-    on_listeners_[to_string(type)] = on_field;
+    const EventAtom atom = ToEventAtom(type);
+    if (on_listeners_.size() <= atom)
+      on_listeners_.resize(atom + 1);
+    on_listeners_[atom] = on_field;
   }
 
  private:
   struct ListenerInfo {
-    ListenerInfo(Listener listener, const std::string& type);
+    explicit ListenerInfo(Listener listener);
     ~ListenerInfo();
 
     Listener callback_;
-    std::string type_;
     bool should_remove_;
   };
+  using ListenerList = std::vector<ListenerInfo>;
 
-  /** Invokes all the listeners for the given event */
-  void InvokeListeners(RefPtr<Event> event, bool* did_listeners_throw);
-
-  /** Finds the listener info that matches the given callback. */
-  std::list<ListenerInfo>::iterator FindListener(const Listener& callback,
-                                                 const std::string& type);
+  /** Records a ScheduleEvent call so later events aren't coalesced past it. */
+  void OnEventScheduled();
 
-  std::unordered_map<std::string, std::function<void()>> cpp_listeners_;
+  /** Invokes all the listeners for the given event */
+  void InvokeListeners(const RefPtr<Event>& event, bool* did_listeners_throw);
 
-  // Elements are stored in insert order. Use a list since we store an iterator
-  // while invoking and it needs to remain valid with concurrent inserts.  This
-  // will also have faster removals since we only use iterators.
-  std::list<ListenerInfo> listeners_;
-  // A map of the on-event listeners (e.g. onerror).
-  std::unordered_map<std::string, Listener*> on_listeners_;
+  /**
+   * Finds the listener info that matches the given callback.
+   * @return The index in |list|, or |list.size()| if not found.
+   */
+  static size_t FindListener(const ListenerList& list,
+                             const Listener& callback);
+
+  // The C++ listeners, indexed by EventType.
+  std::vector<std::function<void()>> cpp_listeners_;
+
+  // The addEventListener listeners, indexed by EventAtom, each in insert
+  // order.  Dispatching indexes this directly by the event's atom, so there
+  // are no string compares.  Listeners are accessed by index while invoking
+  // since inserts may reallocate the list.
+  std::vector<ListenerList> listeners_;
+  // The on-event listeners (e.g. onerror), indexed by EventType.  Note that
+  // the fields may be unset.
+  std::vector<Listener*> on_listeners_;
   bool is_dispatching_;
+  // Whether a listener was marked for removal while dispatching.
+  bool has_removed_listeners_;
+
+  // Tracks the ScheduleCoalescedEvent events that haven't been dispatched yet.
+  // This is guarded by a mutex shared by all targets to keep nodes small.
+  EventCoalescer coalescer_;
 };
 
 class EventTargetFactory : public BackingObjectFactory<EventTarget> {
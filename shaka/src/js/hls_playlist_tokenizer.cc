@@ -0,0 +1,61 @@
+// Copyright 2020 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     https://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "src/js/hls_playlist_tokenizer.h"
+
+#include <string>
+#include <utility>
+
+#include "src/js/js_error.h"
+
+namespace shaka {
+namespace js {
+
+DEFINE_STRUCT_SPECIAL_METHODS_MOVE_ONLY(HlsTokens);
+
+HlsPlaylistTokenizer::HlsPlaylistTokenizer() {}
+
+// \cond Doxygen_Skip
+HlsPlaylistTokenizer::~HlsPlaylistTokenizer() {}
+// \endcond Doxygen_Skip
+
+ExceptionOr<HlsTokens> HlsPlaylistTokenizer::Tokenize(ByteBuffer data) {
+  media::HlsTokenTable table;
+  std::string error;
+  if (!tokenizer_.Tokenize(data.data(), data.size(), &table, &error))
+    return JsError::TypeError(error);
+
+  HlsTokens ret;
+  ret.lines.SetFromBuffer(table.lines.data(),
+                          table.lines.size() * sizeof(uint32_t));
+  ret.attributes.SetFromBuffer(table.attributes.data(),
+                               table.attributes.size() * sizeof(uint32_t));
+  ret.matchStart = static_cast<int>(table.match_start);
+  ret.matchEnd = static_cast<int>(table.match_end);
+  ret.matchOffset = table.match_offset;
+  return std::move(ret);
+}
+
+void HlsPlaylistTokenizer::Reset() {
+  tokenizer_.Reset();
+}
+
+
+HlsPlaylistTokenizerFactory::HlsPlaylistTokenizerFactory() {
+  AddMemberFunction("tokenize", &HlsPlaylistTokenizer::Tokenize);
+  AddMemberFunction("reset", &HlsPlaylistTokenizer::Reset);
+}
+
+}  // namespace js
+}  // namespace shaka
@@ -0,0 +1,73 @@
+// Copyright 2020 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     https://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef SHAKA_EMBEDDED_JS_HLS_PLAYLIST_TOKENIZER_H_
+#define SHAKA_EMBEDDED_JS_HLS_PLAYLIST_TOKENIZER_H_
+
+#include "src/mapping/backing_object.h"
+#include "src/mapping/backing_object_factory.h"
+#include "src/mapping/byte_buffer.h"
+#include "src/mapping/exception_or.h"
+#include "src/mapping/struct.h"
+#include "src/media/hls_playlist_tokenizer.h"
+
+namespace shaka {
+namespace js {
+
+/**
+ * The result of tokenizing a playlist.  |lines| and |attributes| hold the
+ * arrays of media::HlsTokenTable, to be viewed as a Uint32Array.
+ */
+struct HlsTokens : public Struct {
+  DECLARE_STRUCT_SPECIAL_METHODS_MOVE_ONLY(HlsTokens);
+
+  ADD_DICT_FIELD(lines, ByteBuffer);
+  ADD_DICT_FIELD(attributes, ByteBuffer);
+  ADD_DICT_FIELD(matchStart, int);
+  ADD_DICT_FIELD(matchEnd, int);
+  ADD_DICT_FIELD(matchOffset, int);
+};
+
+/**
+ * A non-standard type that lets JavaScript tokenize HLS playlists natively.
+ * Each object keeps the last playlist it was given, so one should be used per
+ * media playlist for the matches to be useful.
+ */
+class HlsPlaylistTokenizer : public BackingObject {
+  DECLARE_TYPE_INFO(HlsPlaylistTokenizer);
+
+ public:
+  HlsPlaylistTokenizer();
+
+  static HlsPlaylistTokenizer* Create() {
+    return new HlsPlaylistTokenizer;
+  }
+
+  ExceptionOr<HlsTokens> Tokenize(ByteBuffer data);
+  void Reset();
+
+ private:
+  media::HlsPlaylistTokenizer tokenizer_;
+};
+
+class HlsPlaylistTokenizerFactory
+    : public BackingObjectFactory<HlsPlaylistTokenizer> {
+ public:
+  HlsPlaylistTokenizerFactory();
+};
+
+}  // namespace js
+}  // namespace shaka
+
+#endif  // SHAKA_EMBEDDED_JS_HLS_PLAYLIST_TOKENIZER_H_
@@ -0,0 +1,160 @@
+// Copyright 2020 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     https://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "src/js/idb/blob_store.h"
+
+#include <glog/logging.h>
+
+#include <functional>
+#include <unordered_set>
+#include <utility>
+#include <vector>
+
+#include "src/js/idb/sqlite.h"
+#include "src/util/crypto.h"
+#include "src/util/utils.h"
+
+namespace shaka {
+namespace js {
+namespace idb {
+
+namespace {
+
+/** The suffix added to the database path to get the directory of files. */
+constexpr const char* kDirSuffix = "-blobs";
+
+}  // namespace
+
+BlobStore::BlobStore(const std::string& dir) : dir_(dir) {}
+BlobStore::~BlobStore() {}
+
+// static
+std::string BlobStore::DirForDatabase(const std::string& db_path) {
+  // Temporary databases don't have a path, so store everything inline.
+  return db_path.empty() ? "" : db_path + kDirSuffix;
+}
+
+bool BlobStore::StoreLargeValues(proto::Value* value) const {
+  if (dir_.empty())
+    return true;
+
+  if (value->has_value_object()) {
+    for (auto& entry : *value->mutable_value_object()->mutable_entries()) {
+      if (!StoreLargeValues(entry.mutable_value()))
+        return false;
+    }
+    return true;
+  }
+  if (!value->has_value_bytes() || value->value_bytes().size() < kMinFileSize)
+    return true;
+
+  const std::string& bytes = value->value_bytes();
+  const uint8_t* data = reinterpret_cast<const uint8_t*>(bytes.data());
+  const std::vector<uint8_t> hash = util::HashData(data, bytes.size());
+  const std::string name = util::ToHexString(hash.data(), hash.size()) + "-" +
+                           std::to_string(bytes.size());
+  const std::string path = util::FileSystem::PathJoin(dir_, name);
+
+  // A file with the same name already has the same contents.  Check the size
+  // in case an earlier write was interrupted.
+  if (!fs_.FileExists(path) ||
+      fs_.FileSize(path) != static_cast<ssize_t>(bytes.size())) {
+    if (!fs_.CreateDirectory(dir_) ||
+        !fs_.WriteFile(path,
+                       std::vector<uint8_t>(data, data + bytes.size()))) {
+      LOG(ERROR) << "Error storing IndexedDB value in '" << path << "'";
+      return false;
+    }
+  }
+
+  // This replaces the bytes since they are part of the same oneof.
+  value->set_value_file(name);
+  return true;
+}
+
+bool BlobStore::Load(const std::string& file, ByteBuffer* buffer) const {
+  if (dir_.empty())
+    return false;
+
+  const uint8_t* data;
+  size_t size;
+  std::function<void()> unmap =
+      fs_.MapFile(util::FileSystem::PathJoin(dir_, file), &data, &size);
+  if (!unmap)
+    return false;
+  buffer->SetFromExternal(data, size, std::move(unmap));
+  return true;
+}
+
+// static
+bool BlobStore::BuildFileIndex(SqliteTransaction* transaction) {
+  bool has_index;
+  if (transaction->HasFileIndex(&has_index) != DatabaseStatus::Success)
+    return false;
+  if (has_index)
+    return true;
+
+  VLOG(1) << "Indexing IndexedDB file references";
+  // If we can't read every entry, we can't know which files are used, so
+  // this fails and the files are kept.
+  const DatabaseStatus status = transaction->BuildFileIndex(
+      [](const uint8_t* body, size_t size, std::vector<std::string>* files) {
+        proto::Value value;
+        if (!value.ParseFromArray(body, size))
+          return false;
+        FindFiles(value, files);
+        return true;
+      });
+  return status == DatabaseStatus::Success;
+}
+
+void BlobStore::RemoveUnusedFiles(SqliteTransaction* transaction) const {
+  if (dir_.empty() || !fs_.DirectoryExists(dir_))
+    return;
+  std::vector<std::string> files;
+  if (!fs_.ListFiles(dir_, &files) || files.empty())
+    return;
+
+  bool has_index;
+  if (transaction->HasFileIndex(&has_index) != DatabaseStatus::Success ||
+      !has_index) {
+    return;
+  }
+  std::unordered_set<std::string> used;
+  if (transaction->ListReferencedFiles(&used) != DatabaseStatus::Success)
+    return;
+
+  for (const std::string& file : files) {
+    if (used.count(file) == 0) {
+      VLOG(1) << "Deleting unused IndexedDB file: " << file;
+      if (!fs_.DeleteFile(util::FileSystem::PathJoin(dir_, file)))
+        LOG(WARNING) << "Error deleting unused IndexedDB file: " << file;
+    }
+  }
+}
+
+// static
+void BlobStore::FindFiles(const proto::Value& value,
+                          std::vector<std::string>* files) {
+  if (value.has_value_file()) {
+    files->push_back(value.value_file());
+  } else if (value.has_value_object()) {
+    for (const auto& entry : value.value_object().entries())
+      FindFiles(entry.value(), files);
+  }
+}
+
+}  // namespace idb
+}  // namespace js
+}  // namespace shaka
@@ -0,0 +1,101 @@
+// Copyright 2020 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     https://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef SHAKA_EMBEDDED_JS_IDB_BLOB_STORE_H_
+#define SHAKA_EMBEDDED_JS_IDB_BLOB_STORE_H_
+
+#include <string>
+#include <vector>
+
+#include "src/js/idb/database.pb.h"
+#include "src/mapping/byte_buffer.h"
+#include "src/util/file_system.h"
+
+namespace shaka {
+namespace js {
+namespace idb {
+
+class SqliteTransaction;
+
+/**
+ * Stores large binary values (e.g. media segments) in files next to the sqlite
+ * database instead of inside it.  This avoids writing the data twice through
+ * the journal and lets it be memory-mapped when read back.  Files are named
+ * after the hash of their contents, so storing the same data twice (e.g. the
+ * same segment in two offline assets) only uses one file.
+ *
+ * The database records which files each entry refers to (see
+ * SqliteTransaction::AddData), which counts the references to each file.
+ * Files are only written, never changed; ones that are no longer referenced
+ * (e.g. the entry was deleted or the transaction was rolled back) are removed
+ * by RemoveUnusedFiles.
+ */
+class BlobStore {
+ public:
+  /** Values with at least this many bytes are stored in files. */
+  static constexpr const size_t kMinFileSize = 64 * 1024;
+
+  /**
+   * @param dir The directory to store the files in.  If this is empty, all
+   *   values are stored in the database.
+   */
+  explicit BlobStore(const std::string& dir);
+  ~BlobStore();
+
+  /** @return The directory to store files in for the given database file. */
+  static std::string DirForDatabase(const std::string& db_path);
+
+  /**
+   * Moves any large binary data in the given value into files, replacing it
+   * with references to the files.
+   * @return True on success, false on error.
+   */
+  bool StoreLargeValues(proto::Value* value) const;
+
+  /**
+   * Maps the given file into the given buffer.
+   * @return True on success, false on error.
+   */
+  bool Load(const std::string& file, ByteBuffer* buffer) const;
+
+  /**
+   * Records the files each entry refers to, for databases created before the
+   * references were recorded.  This does nothing if they already are.
+   * @return True on success, false on error.
+   */
+  static bool BuildFileIndex(SqliteTransaction* transaction);
+
+  /**
+   * Deletes the files that aren't referenced by any entry in the database.
+   * This must be called when there are no transactions that have stored
+   * values but aren't committed yet.  This only reads the file references, so
+   * it does nothing until BuildFileIndex has been committed.
+   */
+  void RemoveUnusedFiles(SqliteTransaction* transaction) const;
+
+  /** Gets the names of the files the given value refers to. */
+  static void FindFiles(const proto::Value& value,
+                        std::vector<std::string>* files);
+
+ private:
+
+  const std::string dir_;
+  const util::FileSystem fs_;
+};
+
+}  // namespace idb
+}  // namespace js
+}  // namespace shaka
+
+#endif  // SHAKA_EMBEDDED_JS_IDB_BLOB_STORE_H_
@@ -38,6 +38,22 @@ void IDBCursor::Trace(memory::HeapTracer* tracer) const {
   tracer->Trace(&value);
 }
 
+void IDBCursor::OnEntriesChanged(const std::string& store_name,
+                                 optional<IdbKeyType> key) {
+  if (store_name != source->store_name)
+    return;
+  if (!key.has_value()) {
+    read_ahead.clear();
+    return;
+  }
+  for (auto it = read_ahead.begin(); it != read_ahead.end(); it++) {
+    if (it->key == key.value()) {
+      read_ahead.erase(it);
+      break;
+    }
+  }
+}
+
 ExceptionOr<void> IDBCursor::Continue(optional<Any> key) {
   // 1. Let transaction be this cursor's transaction.
   RefPtr<IDBTransaction> transaction = request->transaction;
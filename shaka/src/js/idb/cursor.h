@@ -15,6 +15,9 @@
 #ifndef SHAKA_EMBEDDED_JS_IDB_CURSOR_H_
 #define SHAKA_EMBEDDED_JS_IDB_CURSOR_H_
 
+#include <list>
+#include <string>
+
 #include "shaka/optional.h"
 #include "src/core/member.h"
 #include "src/js/idb/idb_utils.h"
@@ -56,6 +59,20 @@ class IDBCursor : public BackingObject {
   optional<IdbKeyType> key;
   Any value;
   bool got_value = false;
+  // The entries after |key| that were read from the database with the last
+  // iteration.  These are used by later iterations so we don't need to query
+  // the database for each entry.
+  std::list<StoredEntry> read_ahead;
+
+  /**
+   * Called when an entry in the given object store changes.  This drops any
+   * read-ahead entries that may no longer be valid.
+   * @param store_name The name of the object store that changed.
+   * @param key The key that was deleted, or nullopt if any entry may have
+   *   been added or changed.
+   */
+  void OnEntriesChanged(const std::string& store_name,
+                        optional<IdbKeyType> key);
 
   ExceptionOr<void> Continue(optional<Any> key);
   ExceptionOr<RefPtr<IDBRequest>> Delete();
@@ -32,6 +32,7 @@ IDBDatabase::IDBDatabase(std::shared_ptr<SqliteConnection> connection,
     : db_name(name),
       object_store_names(new dom::DOMStringList(store_names)),
       version(version),
+      blobs(BlobStore::DirForDatabase(connection->path())),
       connection_(connection) {
   AddListenerField(EventType::Abort, &on_abort);
   AddListenerField(EventType::Error, &on_error);
@@ -46,6 +47,7 @@ void IDBDatabase::Trace(memory::HeapTracer* tracer) const {
   events::EventTarget::Trace(tracer);
   tracer->Trace(&object_store_names);
   tracer->Trace(&version_change_trans_);
+  tracer->Trace(&waiting_transactions_);
 }
 
 ExceptionOr<RefPtr<IDBObjectStore>> IDBDatabase::CreateObjectStore(
@@ -168,14 +170,40 @@ ExceptionOr<RefPtr<IDBTransaction>> IDBDatabase::Transaction(
   // 8. Set transaction’s cleanup event loop to the current event loop.
   RefPtr<IDBTransaction> ret = new IDBTransaction(this, real_mode, scope);
 
-  std::shared_ptr<SqliteConnection> connection = connection_;
+  RefPtr<IDBDatabase> self(this);
   JsManagerImpl::Instance()->MainThread()->AddInternalTask(
       TaskPriority::Internal, "IndexedDb Commit Transaction",
-      [ret, connection]() { ret->DoCommit(connection.get()); });
+      [self, ret]() { self->RunTransaction(ret); });
   // 9. Return an IDBTransaction object representing transaction.
   return ret;
 }
 
+void IDBDatabase::RunTransaction(RefPtr<IDBTransaction> trans) {
+  // The connection can only have one sqlite transaction at once, so wait for
+  // the previous commit to finish.
+  if (committing_) {
+    // Don't allow adding requests while waiting, like the transaction already
+    // started.
+    trans->active = false;
+    waiting_transactions_.emplace_back(trans);
+    return;
+  }
+
+  committing_ = true;
+  trans->active = !trans->aborted;
+  RefPtr<IDBDatabase> self(this);
+  trans->DoCommit(connection_, [self]() { self->OnCommitDone(); });
+}
+
+void IDBDatabase::OnCommitDone() {
+  committing_ = false;
+  if (!waiting_transactions_.empty()) {
+    RefPtr<IDBTransaction> next = waiting_transactions_.front();
+    waiting_transactions_.pop_front();
+    RunTransaction(next);
+  }
+}
+
 void IDBDatabase::Close() {
   if (!close_pending_) {
     close_pending_ = true;
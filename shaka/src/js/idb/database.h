@@ -15,6 +15,7 @@
 #ifndef SHAKA_EMBEDDED_JS_IDB_DATABASE_H_
 #define SHAKA_EMBEDDED_JS_IDB_DATABASE_H_
 
+#include <list>
 #include <memory>
 #include <string>
 #include <vector>
@@ -25,6 +26,7 @@
 #include "src/core/ref_ptr.h"
 #include "src/js/dom/dom_string_list.h"
 #include "src/js/events/event_target.h"
+#include "src/js/idb/blob_store.h"
 #include "src/js/idb/sqlite.h"
 #include "src/js/idb/transaction.h"
 #include "src/mapping/backing_object_factory.h"
@@ -65,6 +67,8 @@ class IDBDatabase : public events::EventTarget {
   const std::string db_name;  // JavaScript "name"
   Member<dom::DOMStringList> object_store_names;
   const int64_t version;
+  // Holds the large values stored outside the database.
+  const BlobStore blobs;
 
   ExceptionOr<RefPtr<IDBObjectStore>> CreateObjectStore(
       const std::string& name, optional<IDBObjectStoreParameters> parameters);
@@ -80,7 +84,17 @@ class IDBDatabase : public events::EventTarget {
   }
 
  private:
+  /**
+   * Runs the requests in the given transaction, or waits until the previous
+   * transaction has been committed.
+   */
+  void RunTransaction(RefPtr<IDBTransaction> trans);
+  void OnCommitDone();
+
   Member<IDBTransaction> version_change_trans_;
+  // Transactions waiting for the current one to be committed.
+  std::list<Member<IDBTransaction>> waiting_transactions_;
+  bool committing_ = false;
   std::shared_ptr<SqliteConnection> connection_;
   bool close_pending_ = false;
 };
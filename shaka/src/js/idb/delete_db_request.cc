@@ -19,6 +19,7 @@
 #include <memory>
 
 #include "src/js/events/version_change_event.h"
+#include "src/js/idb/blob_store.h"
 #include "src/js/idb/database.h"
 #include "src/js/idb/object_store.h"
 #include "src/js/idb/sqlite.h"
@@ -56,6 +57,15 @@ void IDBDeleteDBRequest::DoOperation(const std::string& db_path) {
     status = transaction.Commit();
     if (status != DatabaseStatus::Success)
       return CompleteError(status);
+
+    // Delete the files that were only used by the deleted database.  This only
+    // reads, so the transaction is just rolled back.  See IDBOpenDBRequest for
+    // why this waits for running transactions.
+    if (!IDBTransaction::HasPendingTransactions() &&
+        connection->BeginTransaction(&transaction) == DatabaseStatus::Success) {
+      BlobStore(BlobStore::DirForDatabase(db_path))
+          .RemoveUnusedFiles(&transaction);
+    }
   }
 
   // Don't use CompleteSuccess so we can fire a special event instead.
@@ -64,8 +74,12 @@ void IDBDeleteDBRequest::DoOperation(const std::string& db_path) {
                                             nullopt);
 }
 
-void IDBDeleteDBRequest::PerformOperation(
-    SqliteTransaction* /* transaction */) {
+std::function<void(SqliteTransaction*)>
+IDBDeleteDBRequest::StartOperation() {
+  LOG(FATAL) << "Not reached";
+}
+
+void IDBDeleteDBRequest::FinishOperation() {
   LOG(FATAL) << "Not reached";
 }
 
@@ -29,7 +29,8 @@ class IDBDeleteDBRequest : public IDBRequest {
 
   void DoOperation(const std::string& db_path);
 
-  void PerformOperation(SqliteTransaction* transaction) override;
+  std::function<void(SqliteTransaction*)> StartOperation() override;
+  void FinishOperation() override;
 
  private:
   const std::string name_;
@@ -71,7 +71,7 @@ RefPtr<IDBRequest> IDBFactory::DeleteDatabase(const std::string& name) {
 ExceptionOr<Any> IDBFactory::CloneForTesting(Any value) {
   proto::Value temp;
   RETURN_IF_ERROR(StoreInProto(value, &temp));
-  return LoadFromProto(temp);
+  return LoadFromProto(&temp);
 }
 
 
@@ -18,6 +18,7 @@
 
 #include <vector>
 
+#include "src/js/idb/blob_store.h"
 #include "src/js/js_error.h"
 #include "src/mapping/byte_buffer.h"
 #include "src/mapping/convert_js.h"
@@ -30,6 +31,12 @@ namespace idb {
 
 namespace {
 
+/**
+ * Binary values smaller than this are copied into a new ArrayBuffer; larger
+ * ones give their memory to the ArrayBuffer instead.
+ */
+constexpr const size_t kMinExternalSize = 4096;
+
 ReturnVal<JsValue> ToJsObject(bool value) {
 #ifdef USING_V8
   return v8::BooleanObject::New(GetIsolate(), value);
@@ -63,7 +70,8 @@ ReturnVal<JsValue> ToJsObject(const std::string& value) {
 
 ExceptionOr<void> StoreValue(Handle<JsValue> input, proto::Value* output,
                              std::vector<ReturnVal<JsValue>>* memory);
-ReturnVal<JsValue> InternalFromStored(const proto::Value& item);
+ReturnVal<JsValue> InternalFromStored(proto::Value* item,
+                                      const BlobStore* blobs, bool* failed);
 
 ExceptionOr<void> StoreObject(proto::ValueType kind, Handle<JsObject> object,
                               proto::Object* output,
@@ -162,22 +170,26 @@ ExceptionOr<void> StoreValue(Handle<JsValue> input, proto::Value* output,
 }
 
 
-ReturnVal<JsValue> FromStoredObject(const proto::Object& object) {
+ReturnVal<JsValue> FromStoredObject(proto::Object* object,
+                                    const BlobStore* blobs, bool* failed) {
   LocalVar<JsObject> ret;
-  if (object.has_array_length())
-    ret = CreateArray(object.array_length());
+  if (object->has_array_length())
+    ret = CreateArray(object->array_length());
   else
     ret = CreateObject();
 
-  for (const proto::Object::Entry& entry : object.entries()) {
-    LocalVar<JsValue> value = InternalFromStored(entry.value());
+  for (proto::Object::Entry& entry : *object->mutable_entries()) {
+    LocalVar<JsValue> value =
+        InternalFromStored(entry.mutable_value(), blobs, failed);
     SetMemberRaw(ret, entry.key(), value);
   }
 
   return RawToJsValue(ret);
 }
 
-ReturnVal<JsValue> InternalFromStored(const proto::Value& item) {
+ReturnVal<JsValue> InternalFromStored(proto::Value* value,
+                                      const BlobStore* blobs, bool* failed) {
+  const proto::Value& item = *value;
   DCHECK(item.IsInitialized());
   switch (item.kind()) {
     case proto::Undefined:
@@ -215,14 +227,33 @@ ReturnVal<JsValue> InternalFromStored(const proto::Value& item) {
     case proto::Float32Array:
     case proto::Float64Array:
     case proto::DataView: {
+      if (item.has_value_file()) {
+        ByteBuffer temp;
+        if (!blobs || !blobs->Load(item.value_file(), &temp)) {
+          *failed = true;
+          return JsUndefined();
+        }
+        return temp.ToJsValue(item.kind());
+      }
+
       DCHECK(item.has_value_bytes());
       const std::string& str = item.value_bytes();
-      ByteBuffer temp(reinterpret_cast<const uint8_t*>(&str[0]), str.size());
+      if (str.size() < kMinExternalSize) {
+        ByteBuffer temp(reinterpret_cast<const uint8_t*>(&str[0]), str.size());
+        return temp.ToJsValue(item.kind());
+      }
+
+      // Give the parsed bytes to the ArrayBuffer instead of copying them.
+      // JavaScript owns the only reference, so it can write to them.
+      std::string* owned = value->release_value_bytes();
+      ByteBuffer temp;
+      temp.SetFromExternal(reinterpret_cast<const uint8_t*>(&(*owned)[0]),
+                           owned->size(), [owned]() { delete owned; });
       return temp.ToJsValue(item.kind());
     }
     case proto::Array:
     case proto::OtherObject:
-      return FromStoredObject(item.value_object());
+      return FromStoredObject(value->mutable_value_object(), blobs, failed);
     default:
       LOG(FATAL) << "Invalid stored value " << item.kind();
   }
@@ -235,9 +266,16 @@ ExceptionOr<void> StoreInProto(Any input, proto::Value* result) {
   return StoreValue(input.ToJsValue(), result, &seen);
 }
 
-Any LoadFromProto(const proto::Value& value) {
+ExceptionOr<Any> LoadFromProto(proto::Value* value, const BlobStore* blobs) {
+  bool failed = false;
+  LocalVar<JsValue> value_js = InternalFromStored(value, blobs, &failed);
+  if (failed) {
+    return JsError::DOMException(UnknownError,
+                                 "Unable to read value stored on disk");
+  }
+
   Any ret;
-  CHECK(ret.TryConvert(InternalFromStored(value)));
+  CHECK(ret.TryConvert(value_js));
   return ret;
 }
 
@@ -26,8 +26,18 @@ namespace shaka {
 namespace js {
 namespace idb {
 
+class BlobStore;
+
 using IdbKeyType = int64_t;
 
+/** An entry read from the database, before it is converted to JavaScript. */
+struct StoredEntry {
+  IdbKeyType key = 0;
+  /** False if the stored data couldn't be parsed. */
+  bool valid = false;
+  proto::Value value;
+};
+
 /**
  * Converts the given JavaScript object into a stored item.  This is an
  * expensive operation that makes copies of the data.  Therefore, this should
@@ -50,10 +60,17 @@ ExceptionOr<void> StoreInProto(Any input, proto::Value* result);
 
 /**
  * Converts the given stored Item and converts it into a new JavaScript object.
+ * Large binary data is moved out of |value| into the new ArrayBuffers instead
+ * of being copied, so |value| can't be used again afterwards.
+ *
  * @param value The stored object to convert.
- * @return A new JavaScript value that is the equivalent to |value|.
+ * @param blobs The BlobStore to read values stored in files from, or nullptr
+ *   if there aren't any.
+ * @return A new JavaScript value that is the equivalent to |value|, or the
+ *   thrown exception if a value stored in a file couldn't be read.
  */
-Any LoadFromProto(const proto::Value& value);
+ExceptionOr<Any> LoadFromProto(proto::Value* value,
+                               const BlobStore* blobs = nullptr);
 
 }  // namespace idb
 }  // namespace js
@@ -0,0 +1,125 @@
+// Copyright 2020 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     https://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "src/js/idb/key_range.h"
+
+#include "src/js/js_error.h"
+
+namespace shaka {
+namespace js {
+namespace idb {
+
+namespace {
+
+KeyRange MakeRange(optional<IdbKeyType> lower, optional<IdbKeyType> upper,
+                   bool lower_open, bool upper_open) {
+  KeyRange ret;
+  ret.lower = lower;
+  ret.upper = upper;
+  ret.lower_open = lower_open;
+  ret.upper_open = upper_open;
+  return ret;
+}
+
+}  // namespace
+
+IDBKeyRange::IDBKeyRange(const KeyRange& range)
+    : lower(range.lower),
+      upper(range.upper),
+      lower_open(range.lower_open),
+      upper_open(range.upper_open) {}
+// \cond Doxygen_Skip
+IDBKeyRange::~IDBKeyRange() {}
+// \endcond Doxygen_Skip
+
+// static
+RefPtr<IDBKeyRange> IDBKeyRange::Only(IdbKeyType key) {
+  return new IDBKeyRange(MakeRange(key, key, false, false));
+}
+
+// static
+RefPtr<IDBKeyRange> IDBKeyRange::LowerBound(IdbKeyType lower,
+                                            optional<bool> open) {
+  return new IDBKeyRange(
+      MakeRange(lower, nullopt, open.value_or(false), false));
+}
+
+// static
+RefPtr<IDBKeyRange> IDBKeyRange::UpperBound(IdbKeyType upper,
+                                            optional<bool> open) {
+  return new IDBKeyRange(
+      MakeRange(nullopt, upper, false, open.value_or(false)));
+}
+
+// static
+ExceptionOr<RefPtr<IDBKeyRange>> IDBKeyRange::Bound(
+    IdbKeyType lower, IdbKeyType upper, optional<bool> lower_open,
+    optional<bool> upper_open) {
+  // 3. If lower is greater than upper, throw a "DataError" DOMException.
+  // 4. If lower is equal to upper and either lowerOpen or upperOpen is true,
+  //    throw a "DataError" DOMException.
+  if (lower > upper || (lower == upper && (lower_open.value_or(false) ||
+                                           upper_open.value_or(false)))) {
+    return JsError::DOMException(DataError);
+  }
+  return RefPtr<IDBKeyRange>(new IDBKeyRange(MakeRange(
+      lower, upper, lower_open.value_or(false), upper_open.value_or(false))));
+}
+
+// static
+KeyRange IDBKeyRange::ToRange(
+    const optional<variant<IdbKeyType, RefPtr<IDBKeyRange>>>& query) {
+  if (!query.has_value())
+    return KeyRange();
+  if (holds_alternative<IdbKeyType>(query.value())) {
+    const IdbKeyType key = get<IdbKeyType>(query.value());
+    return MakeRange(key, key, false, false);
+  }
+  return get<RefPtr<IDBKeyRange>>(query.value())->range();
+}
+
+bool IDBKeyRange::Includes(IdbKeyType key) const {
+  if (lower.has_value() &&
+      (lower_open ? key <= lower.value() : key < lower.value())) {
+    return false;
+  }
+  if (upper.has_value() &&
+      (upper_open ? key >= upper.value() : key > upper.value())) {
+    return false;
+  }
+  return true;
+}
+
+KeyRange IDBKeyRange::range() const {
+  return MakeRange(lower, upper, lower_open, upper_open);
+}
+
+
+IDBKeyRangeFactory::IDBKeyRangeFactory() {
+  AddReadOnlyProperty("lower", &IDBKeyRange::lower);
+  AddReadOnlyProperty("upper", &IDBKeyRange::upper);
+  AddReadOnlyProperty("lowerOpen", &IDBKeyRange::lower_open);
+  AddReadOnlyProperty("upperOpen", &IDBKeyRange::upper_open);
+
+  AddMemberFunction("includes", &IDBKeyRange::Includes);
+
+  AddStaticFunction("only", &IDBKeyRange::Only);
+  AddStaticFunction("lowerBound", &IDBKeyRange::LowerBound);
+  AddStaticFunction("upperBound", &IDBKeyRange::UpperBound);
+  AddStaticFunction("bound", &IDBKeyRange::Bound);
+}
+
+}  // namespace idb
+}  // namespace js
+}  // namespace shaka
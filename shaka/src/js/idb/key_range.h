@@ -0,0 +1,72 @@
+// Copyright 2020 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     https://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef SHAKA_EMBEDDED_JS_IDB_KEY_RANGE_H_
+#define SHAKA_EMBEDDED_JS_IDB_KEY_RANGE_H_
+
+#include "shaka/optional.h"
+#include "shaka/variant.h"
+#include "src/core/ref_ptr.h"
+#include "src/js/idb/idb_utils.h"
+#include "src/js/idb/sqlite.h"
+#include "src/mapping/backing_object.h"
+#include "src/mapping/backing_object_factory.h"
+#include "src/mapping/exception_or.h"
+
+namespace shaka {
+namespace js {
+namespace idb {
+
+class IDBKeyRange : public BackingObject {
+  DECLARE_TYPE_INFO(IDBKeyRange);
+
+ public:
+  explicit IDBKeyRange(const KeyRange& range);
+
+  static RefPtr<IDBKeyRange> Only(IdbKeyType key);
+  static RefPtr<IDBKeyRange> LowerBound(IdbKeyType lower, optional<bool> open);
+  static RefPtr<IDBKeyRange> UpperBound(IdbKeyType upper, optional<bool> open);
+  static ExceptionOr<RefPtr<IDBKeyRange>> Bound(IdbKeyType lower,
+                                                IdbKeyType upper,
+                                                optional<bool> lower_open,
+                                                optional<bool> upper_open);
+
+  /**
+   * Converts the "query" argument of the object store methods to a range.  A
+   * missing query is the unbounded range and a key is a range of just that
+   * key.
+   */
+  static KeyRange ToRange(
+      const optional<variant<IdbKeyType, RefPtr<IDBKeyRange>>>& query);
+
+  const optional<IdbKeyType> lower;
+  const optional<IdbKeyType> upper;
+  const bool lower_open;
+  const bool upper_open;
+
+  bool Includes(IdbKeyType key) const;
+
+  KeyRange range() const;
+};
+
+class IDBKeyRangeFactory : public BackingObjectFactory<IDBKeyRange> {
+ public:
+  IDBKeyRangeFactory();
+};
+
+}  // namespace idb
+}  // namespace js
+}  // namespace shaka
+
+#endif  // SHAKA_EMBEDDED_JS_IDB_KEY_RANGE_H_
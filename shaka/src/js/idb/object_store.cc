@@ -108,6 +108,51 @@ ExceptionOr<RefPtr<IDBRequest>> IDBObjectStore::Get(IdbKeyType key) {
   return transaction->AddRequest(new IDBGetRequest(this, transaction, key));
 }
 
+ExceptionOr<RefPtr<IDBRequest>> IDBObjectStore::GetAll(
+    optional<variant<IdbKeyType, RefPtr<IDBKeyRange>>> query,
+    optional<uint32_t> count) {
+  // 1-4
+  RETURN_IF_ERROR(CheckState(/* need_write */ false));
+  // 5. Let range be the result of running convert a value to a key range with
+  //    query. Rethrow any exceptions.
+  const KeyRange range = IDBKeyRange::ToRange(query);
+  // 6. Return the result (an IDBRequest) of running asynchronously execute a
+  //    request with this object store handle as source and retrieve multiple
+  //    values from an object store as operation, using the current Realm as
+  //    targetRealm, store, range, and count if given.
+  return transaction->AddRequest(new IDBGetAllRequest(
+      this, transaction, range, count.value_or(0), /* keys_only */ false));
+}
+
+ExceptionOr<RefPtr<IDBRequest>> IDBObjectStore::GetAllKeys(
+    optional<variant<IdbKeyType, RefPtr<IDBKeyRange>>> query,
+    optional<uint32_t> count) {
+  // 1-4
+  RETURN_IF_ERROR(CheckState(/* need_write */ false));
+  // 5. Let range be the result of running convert a value to a key range with
+  //    query. Rethrow any exceptions.
+  const KeyRange range = IDBKeyRange::ToRange(query);
+  // 6. Return the result (an IDBRequest) of running asynchronously execute a
+  //    request with this object store handle as source and retrieve multiple
+  //    keys from an object store as operation, using store, range, and count
+  //    if given.
+  return transaction->AddRequest(new IDBGetAllRequest(
+      this, transaction, range, count.value_or(0), /* keys_only */ true));
+}
+
+ExceptionOr<RefPtr<IDBRequest>> IDBObjectStore::Count(
+    optional<variant<IdbKeyType, RefPtr<IDBKeyRange>>> query) {
+  // 1-4
+  RETURN_IF_ERROR(CheckState(/* need_write */ false));
+  // 5. Let range be the result of running convert a value to a key range with
+  //    query. Rethrow any exceptions.
+  const KeyRange range = IDBKeyRange::ToRange(query);
+  // 6. Return the result (an IDBRequest) of running asynchronously execute a
+  //    request with this object store handle as source and count the records
+  //    in a range as operation, using source and range.
+  return transaction->AddRequest(new IDBCountRequest(this, transaction, range));
+}
+
 ExceptionOr<RefPtr<IDBRequest>> IDBObjectStore::OpenCursor(
     optional<IdbKeyType> range, optional<IDBCursorDirection> direction) {
   if (range)
@@ -130,6 +175,7 @@ ExceptionOr<RefPtr<IDBRequest>> IDBObjectStore::OpenCursor(
       new IDBIterateCursorRequest(this, transaction, cursor, 1);
   // 8. Set cursor’s request to request.
   cursor->request = request;
+  transaction->AddCursor(cursor);
   // 9. Return request.
   return transaction->AddRequest(request);
 }
@@ -159,13 +205,15 @@ IDBObjectStoreFactory::IDBObjectStoreFactory() {
   AddReadOnlyProperty("transaction", &IDBObjectStore::transaction);
 
   AddMemberFunction("add", &IDBObjectStore::Add);
+  AddMemberFunction("count", &IDBObjectStore::Count);
   AddMemberFunction("delete", &IDBObjectStore::Delete);
   AddMemberFunction("get", &IDBObjectStore::Get);
+  AddMemberFunction("getAll", &IDBObjectStore::GetAll);
+  AddMemberFunction("getAllKeys", &IDBObjectStore::GetAllKeys);
   AddMemberFunction("openCursor", &IDBObjectStore::OpenCursor);
   AddMemberFunction("put", &IDBObjectStore::Put);
 
   NotImplemented("clear");
-  NotImplemented("count");
   NotImplemented("createIndex");
   NotImplemented("deleteIndex");
   NotImplemented("index");
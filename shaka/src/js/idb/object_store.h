@@ -22,6 +22,7 @@
 #include "src/core/ref_ptr.h"
 #include "src/js/idb/cursor.h"
 #include "src/js/idb/idb_utils.h"
+#include "src/js/idb/key_range.h"
 #include "src/mapping/any.h"
 #include "src/mapping/backing_object.h"
 #include "src/mapping/backing_object_factory.h"
@@ -51,6 +52,14 @@ class IDBObjectStore : public BackingObject {
   ExceptionOr<RefPtr<IDBRequest>> Put(Any value, optional<IdbKeyType> key);
   ExceptionOr<RefPtr<IDBRequest>> Delete(IdbKeyType key);
   ExceptionOr<RefPtr<IDBRequest>> Get(IdbKeyType key);
+  ExceptionOr<RefPtr<IDBRequest>> GetAll(
+      optional<variant<IdbKeyType, RefPtr<IDBKeyRange>>> query,
+      optional<uint32_t> count);
+  ExceptionOr<RefPtr<IDBRequest>> GetAllKeys(
+      optional<variant<IdbKeyType, RefPtr<IDBKeyRange>>> query,
+      optional<uint32_t> count);
+  ExceptionOr<RefPtr<IDBRequest>> Count(
+      optional<variant<IdbKeyType, RefPtr<IDBKeyRange>>> query);
   ExceptionOr<RefPtr<IDBRequest>> OpenCursor(
       optional<IdbKeyType> range, optional<IDBCursorDirection> direction);
 
@@ -21,6 +21,7 @@
 
 #include "src/js/dom/dom_exception.h"
 #include "src/js/events/version_change_event.h"
+#include "src/js/idb/blob_store.h"
 #include "src/js/idb/database.h"
 #include "src/js/idb/object_store.h"
 #include "src/js/idb/sqlite.h"
@@ -48,9 +49,27 @@ void IDBOpenDBRequest::DoOperation(const std::string& db_path) {
     return CompleteError(status);
 
   SqliteTransaction transaction;
+  // Databases from older versions don't record which files their entries use.
+  // This is done in its own transaction since the one below is usually rolled
+  // back.  If it fails, the files are kept until it can be done.
   status = connection->BeginTransaction(&transaction);
   if (status != DatabaseStatus::Success)
     return CompleteError(status);
+  if (BlobStore::BuildFileIndex(&transaction))
+    transaction.Commit();
+  else
+    transaction.Rollback();
+
+  status = connection->BeginTransaction(&transaction);
+  if (status != DatabaseStatus::Success)
+    return CompleteError(status);
+
+  // Running transactions may have stored files their entries aren't visible
+  // for yet, so only look for unused files if there aren't any.
+  if (!IDBTransaction::HasPendingTransactions()) {
+    BlobStore(BlobStore::DirForDatabase(db_path))
+        .RemoveUnusedFiles(&transaction);
+  }
 
   int64_t version = 0;
   status = transaction.GetDbVersion(name_, &version);
@@ -108,7 +127,12 @@ void IDBOpenDBRequest::DoOperation(const std::string& db_path) {
   CompleteSuccess(Any(idb_connection));
 }
 
-void IDBOpenDBRequest::PerformOperation(SqliteTransaction* /* transaction */) {
+std::function<void(SqliteTransaction*)>
+IDBOpenDBRequest::StartOperation() {
+  LOG(FATAL) << "Not reached";
+}
+
+void IDBOpenDBRequest::FinishOperation() {
   LOG(FATAL) << "Not reached";
 }
 
@@ -36,7 +36,8 @@ class IDBOpenDBRequest : public IDBRequest {
 
   void DoOperation(const std::string& db_path);
 
-  void PerformOperation(SqliteTransaction* transaction) override;
+  std::function<void(SqliteTransaction*)> StartOperation() override;
+  void FinishOperation() override;
 
   Listener on_upgrade_needed;
 
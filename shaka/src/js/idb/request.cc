@@ -45,6 +45,13 @@ void IDBRequest::Trace(memory::HeapTracer* tracer) const {
   tracer->Trace(&transaction);
 }
 
+void IDBRequest::PerformOperation(SqliteTransaction* transaction) {
+  std::function<void(SqliteTransaction*)> work = StartOperation();
+  if (work)
+    work(transaction);
+  FinishOperation();
+}
+
 void IDBRequest::OnAbort() {
   CompleteError(JsError::DOMException(AbortError));
 }
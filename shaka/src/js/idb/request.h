@@ -15,6 +15,8 @@
 #ifndef SHAKA_EMBEDDED_JS_IDB_REQUEST_H_
 #define SHAKA_EMBEDDED_JS_IDB_REQUEST_H_
 
+#include <functional>
+
 #include "shaka/optional.h"
 #include "shaka/variant.h"
 #include "src/core/member.h"
@@ -55,10 +57,26 @@ class IDBRequest : public events::EventTarget {
   void Trace(memory::HeapTracer* tracer) const override;
 
   /**
-   * Performs the operation for this request.  This will synchronously fire
-   * events into JavaScript.
+   * Starts the operation for this request.  This is called on the main thread
+   * and returns the database work to do, which is run on the storage thread.
+   * The returned callback MUST NOT use any JavaScript objects; it should store
+   * its results in this object.  Once it is done, FinishOperation is called on
+   * the main thread.  This can return an empty callback if there is no
+   * database work to do.
+   */
+  virtual std::function<void(SqliteTransaction*)> StartOperation() = 0;
+
+  /**
+   * Finishes the operation using the results of the database work.  This will
+   * synchronously fire events into JavaScript.
+   */
+  virtual void FinishOperation() = 0;
+
+  /**
+   * Synchronously performs the operation for this request using the given
+   * transaction.  This will synchronously fire events into JavaScript.
    */
-  virtual void PerformOperation(SqliteTransaction* transaction) = 0;
+  void PerformOperation(SqliteTransaction* transaction);
 
   /**
    * Called if the request is part of a transaction that gets aborted.  This
@@ -14,16 +14,19 @@
 
 #include "src/js/idb/request_impls.h"
 
+#include <iterator>
 #include <string>
 #include <utility>
 #include <vector>
 
+#include "src/js/idb/blob_store.h"
 #include "src/js/idb/cursor.h"
 #include "src/js/idb/database.h"
 #include "src/js/idb/idb_utils.h"
 #include "src/js/idb/object_store.h"
 #include "src/js/idb/transaction.h"
 #include "src/mapping/byte_string.h"
+#include "src/mapping/js_wrappers.h"
 
 namespace shaka {
 namespace js {
@@ -31,28 +34,36 @@ namespace idb {
 
 namespace {
 
-ExceptionOr<Any> ReadAndLoad(SqliteTransaction* transaction,
-                             const std::string& db_name,
-                             const std::string& store_name, IdbKeyType key,
-                             bool allow_not_found) {
-  std::vector<uint8_t> data;
-  const DatabaseStatus status =
-      transaction->GetData(db_name, store_name, key, &data);
-  if (status == DatabaseStatus::NotFound) {
-    if (allow_not_found)
-      return Any();  // Undefined
-    return JsError::DOMException(NotFoundError);
-  }
-  if (status != DatabaseStatus::Success)
-    return JsError::DOMException(UnknownError);
+/** Parses the given stored body into the entry. */
+void ParseEntry(int64_t key, const uint8_t* body, size_t size,
+                StoredEntry* entry) {
+  entry->key = key;
+  entry->valid = entry->value.ParseFromArray(body, size);
+}
+
+/** Reads the given entry.  This is called on the storage thread. */
+DatabaseStatus ReadEntry(SqliteTransaction* transaction,
+                         const std::string& db_name,
+                         const std::string& store_name, IdbKeyType key,
+                         StoredEntry* entry) {
+  // Parse directly from sqlite's buffer so the body isn't copied first.
+  return transaction->GetData(
+      db_name, store_name, key,
+      [entry](int64_t found_key, const uint8_t* body, size_t size) {
+        ParseEntry(found_key, body, size, entry);
+      });
+}
 
-  proto::Value proto;
-  if (!proto.ParseFromArray(data.data(), data.size())) {
+/**
+ * Converts the given entry to JavaScript.  This moves the binary data out of
+ * the entry.
+ */
+ExceptionOr<Any> LoadEntry(StoredEntry* entry, const IDBDatabase* db) {
+  if (!entry->valid) {
     return JsError::DOMException(UnknownError,
                                  "Invalid data stored in database");
   }
-
-  return LoadFromProto(proto);
+  return LoadFromProto(&entry->value, &db->blobs);
 }
 
 }  // namespace
@@ -60,22 +71,117 @@ ExceptionOr<Any> ReadAndLoad(SqliteTransaction* transaction,
 IDBGetRequest::IDBGetRequest(
     optional<variant<Member<IDBObjectStore>, Member<IDBCursor>>> source,
     RefPtr<IDBTransaction> transaction, IdbKeyType key)
-    : IDBRequest(source, transaction), key_(key) {}
+    : IDBRequest(source, transaction),
+      key_(key),
+      status_(DatabaseStatus::UnknownError) {}
 IDBGetRequest::~IDBGetRequest() {}
 
-void IDBGetRequest::PerformOperation(SqliteTransaction* transaction) {
+std::function<void(SqliteTransaction*)> IDBGetRequest::StartOperation() {
   RefPtr<IDBObjectStore> store = get<Member<IDBObjectStore>>(source.value());
-  RefPtr<IDBDatabase> db = store->transaction->db;
+  const std::string db_name = store->transaction->db->db_name;
+  const std::string store_name = store->store_name;
+  return [=](SqliteTransaction* transaction) {
+    status_ = ReadEntry(transaction, db_name, store_name, key_, &entry_);
+  };
+}
+
+void IDBGetRequest::FinishOperation() {
+  if (status_ == DatabaseStatus::NotFound)
+    return CompleteSuccess(Any());  // Undefined
+  if (status_ != DatabaseStatus::Success)
+    return CompleteError(JsError::DOMException(UnknownError));
 
-  ExceptionOr<Any> data =
-      ReadAndLoad(transaction, db->db_name, store->store_name, key_,
-                  /* allow_not_found */ true);
+  RefPtr<IDBDatabase> db = transaction->db;
+  ExceptionOr<Any> data = LoadEntry(&entry_, db.get());
   if (holds_alternative<JsError>(data))
     return CompleteError(get<JsError>(std::move(data)));
   return CompleteSuccess(get<Any>(data));
 }
 
 
+IDBGetAllRequest::IDBGetAllRequest(
+    optional<variant<Member<IDBObjectStore>, Member<IDBCursor>>> source,
+    RefPtr<IDBTransaction> transaction, const KeyRange& range,
+    uint32_t count, bool keys_only)
+    : IDBRequest(source, transaction),
+      range_(range),
+      count_(count),
+      keys_only_(keys_only),
+      status_(DatabaseStatus::UnknownError) {}
+IDBGetAllRequest::~IDBGetAllRequest() {}
+
+std::function<void(SqliteTransaction*)> IDBGetAllRequest::StartOperation() {
+  RefPtr<IDBObjectStore> store = get<Member<IDBObjectStore>>(source.value());
+  const std::string db_name = store->transaction->db->db_name;
+  const std::string store_name = store->store_name;
+  return [=](SqliteTransaction* transaction) {
+    keys_.clear();
+    entries_.clear();
+    if (keys_only_) {
+      status_ = transaction->GetAllKeys(db_name, store_name, range_, count_,
+                                        &keys_);
+      return;
+    }
+
+    status_ = transaction->GetAllData(
+        db_name, store_name, range_, count_,
+        [this](int64_t key, const uint8_t* body, size_t size) {
+          entries_.emplace_back();
+          ParseEntry(key, body, size, &entries_.back());
+        });
+  };
+}
+
+void IDBGetAllRequest::FinishOperation() {
+  if (status_ != DatabaseStatus::Success)
+    return CompleteError(status_);
+  if (keys_only_)
+    return CompleteSuccess(Any(keys_));
+
+  // Build the array directly so the values are kept alive by it while the
+  // rest are converted.
+  RefPtr<IDBDatabase> db = transaction->db;
+  LocalVar<JsObject> array(CreateArray(entries_.size()));
+  for (size_t i = 0; i < entries_.size(); i++) {
+    ExceptionOr<Any> data = LoadEntry(&entries_[i], db.get());
+    if (holds_alternative<JsError>(data))
+      return CompleteError(get<JsError>(std::move(data)));
+    LocalVar<JsValue> value(get<Any>(data).ToJsValue());
+    SetArrayIndexRaw(array, i, value);
+  }
+  entries_.clear();
+
+  Any result;
+  CHECK(result.TryConvert(RawToJsValue(array)));
+  return CompleteSuccess(result);
+}
+
+
+IDBCountRequest::IDBCountRequest(
+    optional<variant<Member<IDBObjectStore>, Member<IDBCursor>>> source,
+    RefPtr<IDBTransaction> transaction, const KeyRange& range)
+    : IDBRequest(source, transaction),
+      range_(range),
+      status_(DatabaseStatus::UnknownError),
+      count_(0) {}
+IDBCountRequest::~IDBCountRequest() {}
+
+std::function<void(SqliteTransaction*)> IDBCountRequest::StartOperation() {
+  RefPtr<IDBObjectStore> store = get<Member<IDBObjectStore>>(source.value());
+  const std::string db_name = store->transaction->db->db_name;
+  const std::string store_name = store->store_name;
+  return [=](SqliteTransaction* transaction) {
+    status_ = transaction->CountData(db_name, store_name, range_, &count_);
+  };
+}
+
+void IDBCountRequest::FinishOperation() {
+  if (status_ != DatabaseStatus::Success)
+    return CompleteError(status_);
+  return CompleteSuccess(Any(count_));
+}
+
+
 IDBStoreRequest::IDBStoreRequest(
     optional<variant<Member<IDBObjectStore>, Member<IDBCursor>>> source,
     RefPtr<IDBTransaction> transaction, proto::Value value,
@@ -83,60 +189,108 @@ IDBStoreRequest::IDBStoreRequest(
     : IDBRequest(source, transaction),
       value_(std::move(value)),
       key_(key),
-      no_override_(no_override) {}
+      no_override_(no_override),
+      result_type_(Result::DatabaseError),
+      status_(DatabaseStatus::UnknownError),
+      new_key_(0) {}
 IDBStoreRequest::~IDBStoreRequest() {}
 
-void IDBStoreRequest::PerformOperation(SqliteTransaction* transaction) {
+std::function<void(SqliteTransaction*)> IDBStoreRequest::StartOperation() {
   RefPtr<IDBObjectStore> store = get<Member<IDBObjectStore>>(source.value());
   RefPtr<IDBDatabase> db = store->transaction->db;
+  const std::string db_name = db->db_name;
+  const std::string store_name = store->store_name;
+  // The database is kept alive by the transaction until the operation is done.
+  const BlobStore* blobs = &db->blobs;
 
-  DatabaseStatus status;
-  if (key_.has_value()) {
-    std::vector<uint8_t> ignored;
-    status = transaction->GetData(db->db_name, store->store_name, key_.value(),
-                                  &ignored);
-    if (status == DatabaseStatus::Success) {
-      if (no_override_) {
-        return CompleteError(JsError::DOMException(
-            ConstraintError, "An object with the given key already exists"));
+  return [=](SqliteTransaction* transaction) {
+    result_type_ = Result::DatabaseError;
+    if (key_.has_value()) {
+      status_ = transaction->GetData(db_name, store_name, key_.value(),
+                                     [](int64_t, const uint8_t*, size_t) {});
+      if (status_ == DatabaseStatus::Success) {
+        if (no_override_) {
+          result_type_ = Result::KeyExists;
+          return;
+        }
+      } else if (status_ != DatabaseStatus::NotFound) {
+        return;
       }
-    } else if (status != DatabaseStatus::NotFound) {
-      return CompleteError(status);
     }
-  }
 
-  std::string data;
-  if (!value_.SerializeToString(&data))
-    return CompleteError(JsError::DOMException(UnknownError));
-  std::vector<uint8_t> data_vec(data.begin(), data.end());
-  IdbKeyType key{};
-  if (key_.has_value()) {
-    status = transaction->UpdateData(db->db_name, store->store_name,
-                                     key_.value(), data_vec);
-  } else {
-    status =
-        transaction->AddData(db->db_name, store->store_name, data_vec, &key);
+    if (!blobs->StoreLargeValues(&value_)) {
+      result_type_ = Result::FileError;
+      return;
+    }
+
+    if (!value_.IsInitialized()) {
+      result_type_ = Result::SerializeError;
+      return;
+    }
+    // Serialize directly into the buffer that is bound to the statement.
+    std::vector<uint8_t> data_vec(value_.ByteSizeLong());
+    value_.SerializeWithCachedSizesToArray(data_vec.data());
+    // Record the files so they are kept while this entry refers to them.
+    std::vector<std::string> files;
+    BlobStore::FindFiles(value_, &files);
+    if (key_.has_value()) {
+      new_key_ = key_.value();
+      status_ = transaction->UpdateData(db_name, store_name, new_key_,
+                                        data_vec, files);
+    } else {
+      status_ = transaction->AddData(db_name, store_name, data_vec, &new_key_,
+                                     files);
+    }
+    if (status_ == DatabaseStatus::Success)
+      result_type_ = Result::Success;
+  };
+}
+
+void IDBStoreRequest::FinishOperation() {
+  // Adding or replacing an entry may change what the cursors see next.
+  RefPtr<IDBObjectStore> store = get<Member<IDBObjectStore>>(source.value());
+  transaction->OnEntriesChanged(store->store_name, nullopt);
+
+  switch (result_type_) {
+    case Result::Success:
+      return CompleteSuccess(Any(new_key_));
+    case Result::KeyExists:
+      return CompleteError(JsError::DOMException(
+          ConstraintError, "An object with the given key already exists"));
+    case Result::FileError:
+      return CompleteError(JsError::DOMException(
+          UnknownError, "Unable to store value on disk"));
+    case Result::SerializeError:
+      return CompleteError(JsError::DOMException(UnknownError));
+    case Result::DatabaseError:
+      return CompleteError(status_);
   }
-  if (status != DatabaseStatus::Success)
-    return CompleteError(status);
-  return CompleteSuccess(Any(key_.value_or(key)));
 }
 
 
 IDBDeleteRequest::IDBDeleteRequest(
     optional<variant<Member<IDBObjectStore>, Member<IDBCursor>>> source,
     RefPtr<IDBTransaction> transaction, IdbKeyType key)
-    : IDBRequest(source, transaction), key_(key) {}
+    : IDBRequest(source, transaction),
+      key_(key),
+      status_(DatabaseStatus::UnknownError) {}
 IDBDeleteRequest::~IDBDeleteRequest() {}
 
-void IDBDeleteRequest::PerformOperation(SqliteTransaction* transaction) {
+std::function<void(SqliteTransaction*)> IDBDeleteRequest::StartOperation() {
   RefPtr<IDBObjectStore> store = get<Member<IDBObjectStore>>(source.value());
-  RefPtr<IDBDatabase> db = store->transaction->db;
+  const std::string db_name = store->transaction->db->db_name;
+  const std::string store_name = store->store_name;
+  return [=](SqliteTransaction* transaction) {
+    status_ = transaction->DeleteData(db_name, store_name, key_);
+  };
+}
+
+void IDBDeleteRequest::FinishOperation() {
+  RefPtr<IDBObjectStore> store = get<Member<IDBObjectStore>>(source.value());
+  transaction->OnEntriesChanged(store->store_name, key_);
 
-  const DatabaseStatus status =
-      transaction->DeleteData(db->db_name, store->store_name, key_);
-  if (status != DatabaseStatus::Success)
-    return CompleteError(status);
+  if (status_ != DatabaseStatus::Success)
+    return CompleteError(status_);
   return CompleteSuccess(Any());  // undefined
 }
 
@@ -145,7 +299,11 @@ IDBIterateCursorRequest::IDBIterateCursorRequest(
     optional<variant<Member<IDBObjectStore>, Member<IDBCursor>>> source,
     RefPtr<IDBTransaction> transaction, RefPtr<IDBCursor> cursor,
     uint32_t count)
-    : IDBRequest(source, transaction), count(count), cursor_(cursor) {}
+    : IDBRequest(source, transaction),
+      count(count),
+      cursor_(cursor),
+      did_read_(false),
+      status_(DatabaseStatus::UnknownError) {}
 IDBIterateCursorRequest::~IDBIterateCursorRequest() {}
 
 void IDBIterateCursorRequest::Trace(memory::HeapTracer* tracer) const {
@@ -153,35 +311,57 @@ void IDBIterateCursorRequest::Trace(memory::HeapTracer* tracer) const {
   tracer->Trace(&cursor_);
 }
 
-void IDBIterateCursorRequest::PerformOperation(SqliteTransaction* transaction) {
-  RefPtr<IDBObjectStore> store = get<Member<IDBObjectStore>>(source.value());
-  RefPtr<IDBDatabase> db = store->transaction->db;
+std::function<void(SqliteTransaction*)>
+IDBIterateCursorRequest::StartOperation() {
+  // If the last query read enough entries, we don't need the database.
+  did_read_ = cursor_->read_ahead.size() < count;
+  if (!did_read_)
+    return nullptr;
 
-  optional<int64_t> position = cursor_->key;
+  RefPtr<IDBObjectStore> store = get<Member<IDBObjectStore>>(source.value());
+  const std::string db_name = store->transaction->db->db_name;
+  const std::string store_name = store->store_name;
+  const optional<int64_t> position = cursor_->key;
   const bool ascending = cursor_->direction == IDBCursorDirection::NEXT ||
                          cursor_->direction == IDBCursorDirection::NEXT_UNIQUE;
-  for (uint32_t i = 0; i < count; i++) {
-    int64_t new_key;
-    const DatabaseStatus status = transaction->FindData(
-        db->db_name, store->store_name, position, ascending, &new_key);
-    if (status == DatabaseStatus::NotFound) {
-      cursor_->key = nullopt;
-      cursor_->value = Any();
-      return CompleteSuccess(Any(nullptr));
-    }
-    if (status != DatabaseStatus::Success) {
-      return CompleteError(status);
-    }
-    position = new_key;
+  const size_t read_count = count + kReadAheadCount;
+  return [=](SqliteTransaction* transaction) {
+    entries_.clear();
+    status_ = transaction->ListData(
+        db_name, store_name, position, ascending, read_count,
+        [this](int64_t key, const uint8_t* body, size_t size) {
+          entries_.emplace_back();
+          ParseEntry(key, body, size, &entries_.back());
+        });
+  };
+}
+
+void IDBIterateCursorRequest::FinishOperation() {
+  if (did_read_) {
+    if (status_ != DatabaseStatus::Success)
+      return CompleteError(status_);
+    cursor_->read_ahead = std::move(entries_);
+    entries_.clear();
   }
 
-  ExceptionOr<Any> data =
-      ReadAndLoad(transaction, db->db_name, store->store_name, position.value(),
-                  /* allow_not_found */ false);
+  auto& read_ahead = cursor_->read_ahead;
+  if (read_ahead.size() < count) {
+    read_ahead.clear();
+    cursor_->key = nullopt;
+    cursor_->value = Any();
+    return CompleteSuccess(Any(nullptr));
+  }
+
+  auto end = std::next(read_ahead.begin(), count);
+  StoredEntry entry = std::move(*std::prev(end));
+  read_ahead.erase(read_ahead.begin(), end);
+
+  RefPtr<IDBDatabase> db = transaction->db;
+  ExceptionOr<Any> data = LoadEntry(&entry, db.get());
   if (holds_alternative<JsError>(data))
     return CompleteError(get<JsError>(std::move(data)));
 
-  cursor_->key = position;
+  cursor_->key = entry.key;
   cursor_->value = get<Any>(data);
   cursor_->got_value = true;
   return CompleteSuccess(Any(cursor_));
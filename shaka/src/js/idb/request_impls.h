@@ -15,12 +15,17 @@
 #ifndef SHAKA_EMBEDDED_JS_IDB_REQUEST_IMPLS_H_
 #define SHAKA_EMBEDDED_JS_IDB_REQUEST_IMPLS_H_
 
+#include <functional>
+#include <list>
+#include <vector>
+
 #include "shaka/optional.h"
 #include "src/core/member.h"
 #include "src/core/ref_ptr.h"
 #include "src/js/idb/database.pb.h"
 #include "src/js/idb/idb_utils.h"
 #include "src/js/idb/request.h"
+#include "src/js/idb/sqlite.h"
 
 namespace shaka {
 namespace js {
@@ -35,10 +40,53 @@ class IDBGetRequest : public IDBRequest {
       RefPtr<IDBTransaction> transaction, IdbKeyType key);
   ~IDBGetRequest() override;
 
-  void PerformOperation(SqliteTransaction* transaction) override;
+  std::function<void(SqliteTransaction*)> StartOperation() override;
+  void FinishOperation() override;
 
  private:
   const IdbKeyType key_;
+  // These are set on the storage thread.
+  DatabaseStatus status_;
+  StoredEntry entry_;
+};
+
+/** Implements getAll and getAllKeys with a single database query. */
+class IDBGetAllRequest : public IDBRequest {
+ public:
+  IDBGetAllRequest(
+      optional<variant<Member<IDBObjectStore>, Member<IDBCursor>>> source,
+      RefPtr<IDBTransaction> transaction, const KeyRange& range,
+      uint32_t count, bool keys_only);
+  ~IDBGetAllRequest() override;
+
+  std::function<void(SqliteTransaction*)> StartOperation() override;
+  void FinishOperation() override;
+
+ private:
+  const KeyRange range_;
+  const uint32_t count_;
+  const bool keys_only_;
+  // These are set on the storage thread.
+  DatabaseStatus status_;
+  std::vector<IdbKeyType> keys_;
+  std::vector<StoredEntry> entries_;
+};
+
+class IDBCountRequest : public IDBRequest {
+ public:
+  IDBCountRequest(
+      optional<variant<Member<IDBObjectStore>, Member<IDBCursor>>> source,
+      RefPtr<IDBTransaction> transaction, const KeyRange& range);
+  ~IDBCountRequest() override;
+
+  std::function<void(SqliteTransaction*)> StartOperation() override;
+  void FinishOperation() override;
+
+ private:
+  const KeyRange range_;
+  // These are set on the storage thread.
+  DatabaseStatus status_;
+  int64_t count_;
 };
 
 class IDBStoreRequest : public IDBRequest {
@@ -49,12 +97,27 @@ class IDBStoreRequest : public IDBRequest {
       optional<IdbKeyType> key, bool no_override);
   ~IDBStoreRequest() override;
 
-  void PerformOperation(SqliteTransaction* transaction) override;
+  std::function<void(SqliteTransaction*)> StartOperation() override;
+  void FinishOperation() override;
 
  private:
-  const proto::Value value_;
+  enum class Result {
+    Success,
+    KeyExists,
+    FileError,
+    SerializeError,
+    DatabaseError,
+  };
+
+  // Not const so large values can be moved to files when stored.  This is
+  // only used on the storage thread once the operation starts.
+  proto::Value value_;
   const optional<IdbKeyType> key_;
   const bool no_override_;
+  // These are set on the storage thread.
+  Result result_type_;
+  DatabaseStatus status_;
+  IdbKeyType new_key_;
 };
 
 class IDBDeleteRequest : public IDBRequest {
@@ -64,10 +127,13 @@ class IDBDeleteRequest : public IDBRequest {
       RefPtr<IDBTransaction> transaction, IdbKeyType key);
   ~IDBDeleteRequest() override;
 
-  void PerformOperation(SqliteTransaction* transaction) override;
+  std::function<void(SqliteTransaction*)> StartOperation() override;
+  void FinishOperation() override;
 
  private:
   const IdbKeyType key_;
+  // This is set on the storage thread.
+  DatabaseStatus status_;
 };
 
 class IDBIterateCursorRequest : public IDBRequest {
@@ -78,13 +144,22 @@ class IDBIterateCursorRequest : public IDBRequest {
       uint32_t count);
   ~IDBIterateCursorRequest() override;
 
+  /** The number of entries to read after the current one in a single query. */
+  static constexpr const size_t kReadAheadCount = 16;
+
   void Trace(memory::HeapTracer* tracer) const override;
-  void PerformOperation(SqliteTransaction* transaction) override;
+  std::function<void(SqliteTransaction*)> StartOperation() override;
+  void FinishOperation() override;
 
   uint32_t count;
 
  private:
   const Member<IDBCursor> cursor_;
+  // Whether this operation read new entries from the database.
+  bool did_read_;
+  // These are set on the storage thread.
+  DatabaseStatus status_;
+  std::list<StoredEntry> entries_;
 };
 
 }  // namespace idb
@@ -16,8 +16,12 @@
 
 #include <sqlite3.h>
 
+#include <algorithm>
 #include <functional>
+#include <limits>
 #include <memory>
+#include <mutex>
+#include <string>
 #include <utility>
 
 #include "src/util/utils.h"
@@ -93,6 +97,24 @@ struct GetColumn<int64_t> {
   }
 };
 
+/**
+ * A view of a BLOB column.  This is owned by sqlite and is only valid until the
+ * statement is stepped or reset.
+ */
+struct BlobView {
+  const uint8_t* data;
+  size_t size;
+};
+template <>
+struct GetColumn<BlobView> {
+  static BlobView Get(sqlite3_stmt* stmt, size_t index) {
+    // Get the blob first since it may change the size when converting types.
+    auto* data =
+        reinterpret_cast<const uint8_t*>(sqlite3_column_blob(stmt, index));
+    return {data, static_cast<size_t>(sqlite3_column_bytes(stmt, index))};
+  }
+};
+
 template <typename Func, typename... Columns>
 struct GetColumns;
 template <typename Func>
@@ -115,13 +137,16 @@ struct GetColumns<Func, T, Rest...> {
   }
 };
 
+// Arguments are bound with SQLITE_STATIC so sqlite doesn't copy them (which
+// matters for large bodies).  This is safe since the bindings are cleared in
+// ResetStatement before ExecGetResults returns and the arguments go away.
 template <typename T>
 struct BindSingleArg;
 template <>
 struct BindSingleArg<std::string> {
   static int Bind(sqlite3_stmt* stmt, size_t index, const std::string& arg) {
     return sqlite3_bind_text(stmt, index, arg.c_str(), arg.size(),
-                             SQLITE_TRANSIENT);  // NOLINT
+                             SQLITE_STATIC);  // NOLINT
   }
 };
 template <>
@@ -129,7 +154,7 @@ struct BindSingleArg<std::vector<uint8_t>> {
   static int Bind(sqlite3_stmt* stmt, size_t index,
                   const std::vector<uint8_t>& arg) {
     return sqlite3_bind_blob64(stmt, index, arg.data(), arg.size(),
-                               SQLITE_TRANSIENT);  // NOLINT
+                               SQLITE_STATIC);  // NOLINT
   }
 };
 template <>
@@ -160,17 +185,24 @@ struct BindArgs<T, Rest...> {
 };
 
 
+int ResetStatement(sqlite3_stmt* stmt) {
+  // Clear the bindings so we don't keep a copy of the last body alive.
+  sqlite3_clear_bindings(stmt);
+  return sqlite3_reset(stmt);
+}
+
 template <typename... InParams, typename... Columns>
-DatabaseStatus ExecGetResults(sqlite3* db, std::function<int(Columns...)> cb,
+DatabaseStatus ExecGetResults(sqlite3* db, SqliteStatementCache* statements,
+                              std::function<int(Columns...)> cb,
                               const std::string& cmd, InParams&&... params) {
   VLOG(2) << "Querying sqlite: " << cmd;
 
   sqlite3_stmt* stmt;
-  int ret = sqlite3_prepare_v2(db, cmd.c_str(), cmd.size(), &stmt, nullptr);
+  int ret = statements->Get(db, cmd, &stmt);
   if (ret != SQLITE_OK)
     return MapErrorCode(ret);
   std::unique_ptr<sqlite3_stmt, int (*)(sqlite3_stmt*)> stmt_safe(
-      stmt, &sqlite3_finalize);
+      stmt, &ResetStatement);
 
   ret = BindArgs<InParams...>::Bind(stmt, 1, std::forward<InParams>(params)...);
   if (ret != SQLITE_OK)
@@ -186,14 +218,16 @@ DatabaseStatus ExecGetResults(sqlite3* db, std::function<int(Columns...)> cb,
 }
 
 template <typename... Args>
-DatabaseStatus ExecCommand(sqlite3* db, const std::string& cmd,
-                           Args&&... args) {
+DatabaseStatus ExecCommand(sqlite3* db, SqliteStatementCache* statements,
+                           const std::string& cmd, Args&&... args) {
   std::function<int()> ignore = []() { return SQLITE_OK; };
-  return ExecGetResults(db, ignore, cmd, std::forward<Args>(args)...);
+  return ExecGetResults(db, statements, ignore, cmd,
+                        std::forward<Args>(args)...);
 }
 
 template <typename T, typename... Args>
-DatabaseStatus ExecGetSingleResult(sqlite3* db, T* result,
+DatabaseStatus ExecGetSingleResult(sqlite3* db,
+                                   SqliteStatementCache* statements, T* result,
                                    const std::string& cmd, Args&&... args) {
   bool got = false;
   std::function<int(T)> get = [&](T value) {
@@ -206,17 +240,82 @@ DatabaseStatus ExecGetSingleResult(sqlite3* db, T* result,
     got = true;
     return SQLITE_OK;
   };
-  RETURN_IF_ERROR(ExecGetResults(db, get, cmd, std::forward<Args>(args)...));
+  RETURN_IF_ERROR(
+      ExecGetResults(db, statements, get, cmd, std::forward<Args>(args)...));
   return got ? DatabaseStatus::Success : DatabaseStatus::NotFound;
 }
 
+/**
+ * Gets the SQL condition for the given range.  The bounds are bound to the
+ * ?3 and ?4 parameters; see GetRangeBounds.  The objects table's primary key
+ * is (store, key), so this is a single index range scan.
+ */
+std::string GetRangeCondition(const KeyRange& range) {
+  // Use StringPrintf since Sqlite parameters can't introduce syntax.  A
+  // missing bound uses the min/max value, which is always included.
+  return util::StringPrintf(
+      R"(
+          store == (SELECT id FROM object_stores
+                    WHERE db_name == ?1 AND store_name == ?2) AND
+          key %s ?3 AND key %s ?4
+      )",
+      range.lower.has_value() && range.lower_open ? ">" : ">=",
+      range.upper.has_value() && range.upper_open ? "<" : "<=");
+}
+
+std::pair<int64_t, int64_t> GetRangeBounds(const KeyRange& range) {
+  return {range.lower.value_or(std::numeric_limits<int64_t>::min()),
+          range.upper.value_or(std::numeric_limits<int64_t>::max())};
+}
+
+/**
+ * The database's user_version once every entry's file references are in the
+ * object_files table.  Databases from older versions have version 0.
+ */
+constexpr const int64_t kFileIndexVersion = 1;
+
+/** @return The SQL LIMIT value for the given count; -1 is no limit. */
+int64_t GetLimit(size_t count) {
+  return count == 0 ? -1 : static_cast<int64_t>(count);
+}
+
 }  // namespace
 
 
-SqliteTransaction::SqliteTransaction() : db_(nullptr) {}
+SqliteStatementCache::SqliteStatementCache() {}
+SqliteStatementCache::~SqliteStatementCache() {
+  Clear();
+}
+
+int SqliteStatementCache::Get(sqlite3* db, const std::string& cmd,
+                              sqlite3_stmt** stmt) {
+  std::unique_lock<std::mutex> lock(mutex_);
+  auto it = statements_.find(cmd);
+  if (it != statements_.end()) {
+    *stmt = it->second;
+    return SQLITE_OK;
+  }
+
+  const int ret =
+      sqlite3_prepare_v2(db, cmd.c_str(), cmd.size(), stmt, nullptr);
+  if (ret == SQLITE_OK)
+    statements_.emplace(cmd, *stmt);
+  return ret;
+}
+
+void SqliteStatementCache::Clear() {
+  std::unique_lock<std::mutex> lock(mutex_);
+  for (auto& pair : statements_)
+    sqlite3_finalize(pair.second);
+  statements_.clear();
+}
+
+
+SqliteTransaction::SqliteTransaction() : db_(nullptr), statements_(nullptr) {}
 SqliteTransaction::SqliteTransaction(SqliteTransaction&& other)
-    : db_(other.db_) {
+    : db_(other.db_), statements_(other.statements_) {
   other.db_ = nullptr;
+  other.statements_ = nullptr;
 }
 SqliteTransaction::~SqliteTransaction() {
   if (db_) {
@@ -229,7 +328,9 @@ SqliteTransaction& SqliteTransaction::operator=(SqliteTransaction&& other) {
     Rollback();
   }
   db_ = other.db_;
+  statements_ = other.statements_;
   other.db_ = nullptr;
+  other.statements_ = nullptr;
   return *this;
 }
 
@@ -242,7 +343,7 @@ DatabaseStatus SqliteTransaction::CreateDb(const std::string& db_name,
 
   const std::string cmd =
       "INSERT INTO databases (name, version) VALUES (?1, ?2)";
-  return ExecCommand(db_, cmd, db_name, version);
+  return ExecCommand(db_, statements_, cmd, db_name, version);
 }
 
 DatabaseStatus SqliteTransaction::UpdateDbVersion(const std::string& db_name,
@@ -254,7 +355,7 @@ DatabaseStatus SqliteTransaction::UpdateDbVersion(const std::string& db_name,
     return DatabaseStatus::BadVersionNumber;
 
   const std::string cmd = "UPDATE databases SET version = ?2 WHERE name == ?1";
-  return ExecCommand(db_, cmd, db_name, version);
+  return ExecCommand(db_, statements_, cmd, db_name, version);
 }
 
 DatabaseStatus SqliteTransaction::DeleteDb(const std::string& db_name) {
@@ -266,14 +367,14 @@ DatabaseStatus SqliteTransaction::DeleteDb(const std::string& db_name) {
   // Because of the "ON CASCADE" on the table, we don't need to explicitly
   // delete the stores or the data entries.
   const std::string delete_cmd = "DELETE FROM databases WHERE name == ?1";
-  return ExecCommand(db_, delete_cmd, db_name);
+  return ExecCommand(db_, statements_, delete_cmd, db_name);
 }
 
 DatabaseStatus SqliteTransaction::GetDbVersion(const std::string& db_name,
                                                int64_t* version) {
   DCHECK(db_) << "Transaction is closed";
   const std::string cmd = "SELECT version FROM databases WHERE name == ?1";
-  return ExecGetSingleResult(db_, version, cmd, db_name);
+  return ExecGetSingleResult(db_, statements_, version, cmd, db_name);
 }
 
 
@@ -285,7 +386,7 @@ DatabaseStatus SqliteTransaction::CreateObjectStore(
   // If the database doesn't exist, we'll get a foreign key error.
   // If there is a store with the same name already, we'll get a primary key
   // error.
-  return ExecCommand(db_, cmd, db_name, store_name);
+  return ExecCommand(db_, statements_, cmd, db_name, store_name);
 }
 
 DatabaseStatus SqliteTransaction::DeleteObjectStore(
@@ -299,7 +400,7 @@ DatabaseStatus SqliteTransaction::DeleteObjectStore(
   // delete the data entries.
   const std::string cmd =
       "DELETE FROM object_stores WHERE db_name == ?1 AND store_name == ?2";
-  return ExecCommand(db_, cmd, db_name, store_name);
+  return ExecCommand(db_, statements_, cmd, db_name, store_name);
 }
 
 DatabaseStatus SqliteTransaction::ListObjectStores(
@@ -317,51 +418,77 @@ DatabaseStatus SqliteTransaction::ListObjectStores(
   };
   const std::string cmd =
       "SELECT store_name FROM object_stores WHERE db_name == ?1";
-  return ExecGetResults(db_, cb, cmd, db_name);
+  return ExecGetResults(db_, statements_, cb, cmd, db_name);
 }
 
 
-DatabaseStatus SqliteTransaction::AddData(const std::string& db_name,
-                                          const std::string& store_name,
-                                          const std::vector<uint8_t>& data,
-                                          int64_t* key) {
+DatabaseStatus SqliteTransaction::AddData(
+    const std::string& db_name, const std::string& store_name,
+    const std::vector<uint8_t>& data, int64_t* key,
+    const std::vector<std::string>& files) {
   DCHECK(db_) << "Transaction is closed";
   int64_t store_id;
   RETURN_IF_ERROR(GetStoreId(db_name, store_name, &store_id));
 
   const std::string select_cmd =
       "SELECT COALESCE(MAX(key), 0) FROM objects WHERE store == ?1";
-  RETURN_IF_ERROR(ExecGetSingleResult(db_, key, select_cmd, store_id));
+  RETURN_IF_ERROR(
+      ExecGetSingleResult(db_, statements_, key, select_cmd, store_id));
   (*key)++;
 
   const std::string insert_cmd =
       "INSERT INTO objects (store, key, body) VALUES (?1, ?2, ?3)";
-  return ExecCommand(db_, insert_cmd, store_id, *key, data);
+  RETURN_IF_ERROR(
+      ExecCommand(db_, statements_, insert_cmd, store_id, *key, data));
+  return AddFileReferences(store_id, *key, files);
 }
 
 DatabaseStatus SqliteTransaction::GetData(const std::string& db_name,
                                           const std::string& store_name,
                                           int64_t key,
                                           std::vector<uint8_t>* data) {
+  DCHECK(data);
+  return GetData(db_name, store_name, key,
+                 [&](int64_t /* key */, const uint8_t* body, size_t size) {
+                   data->assign(body, body + size);
+                 });
+}
+
+DatabaseStatus SqliteTransaction::GetData(const std::string& db_name,
+                                          const std::string& store_name,
+                                          int64_t key,
+                                          const DataCallback& callback) {
   DCHECK(db_) << "Transaction is closed";
+  bool got = false;
+  std::function<int(BlobView)> cb = [&](BlobView body) {
+    if (got)
+      return SQLITE_ERROR;
+    got = true;
+    callback(key, body.data, body.size);
+    return SQLITE_OK;
+  };
   const std::string cmd =
       "SELECT body FROM objects "
       "INNER JOIN object_stores ON object_stores.id == objects.store "
       "WHERE db_name == ?1 AND store_name == ?2 AND key == ?3";
-  return ExecGetSingleResult(db_, data, cmd, db_name, store_name, key);
+  RETURN_IF_ERROR(
+      ExecGetResults(db_, statements_, cb, cmd, db_name, store_name, key));
+  return got ? DatabaseStatus::Success : DatabaseStatus::NotFound;
 }
 
-DatabaseStatus SqliteTransaction::UpdateData(const std::string& db_name,
-                                             const std::string& store_name,
-                                             int64_t key,
-                                             const std::vector<uint8_t>& data) {
+DatabaseStatus SqliteTransaction::UpdateData(
+    const std::string& db_name, const std::string& store_name, int64_t key,
+    const std::vector<uint8_t>& data, const std::vector<std::string>& files) {
   DCHECK(db_) << "Transaction is closed";
   int64_t store_id;
   RETURN_IF_ERROR(GetStoreId(db_name, store_name, &store_id));
 
+  // Replacing the row deletes the old file references through the foreign
+  // key.
   const std::string cmd =
       "INSERT OR REPLACE INTO objects (store, key, body) VALUES (?1, ?2, ?3)";
-  return ExecCommand(db_, cmd, store_id, key, data);
+  RETURN_IF_ERROR(ExecCommand(db_, statements_, cmd, store_id, key, data));
+  return AddFileReferences(store_id, key, files);
 }
 
 DatabaseStatus SqliteTransaction::DeleteData(const std::string& db_name,
@@ -372,7 +499,7 @@ DatabaseStatus SqliteTransaction::DeleteData(const std::string& db_name,
       DELETE FROM objects WHERE key == ?3 AND store == (
           SELECT id FROM object_stores WHERE db_name == ?1 AND store_name == ?2)
   )";
-  return ExecCommand(db_, cmd, db_name, store_name, key);
+  return ExecCommand(db_, statements_, cmd, db_name, store_name, key);
 }
 
 DatabaseStatus SqliteTransaction::FindData(const std::string& db_name,
@@ -393,7 +520,8 @@ DatabaseStatus SqliteTransaction::FindData(const std::string& db_name,
             LIMIT 1
         )",
         ascending ? "ASC" : "DESC");
-    return ExecGetSingleResult(db_, found_key, cmd, db_name, store_name);
+    return ExecGetSingleResult(db_, statements_, found_key, cmd, db_name,
+                               store_name);
   }
   cmd = util::StringPrintf(
       R"(
@@ -405,23 +533,201 @@ DatabaseStatus SqliteTransaction::FindData(const std::string& db_name,
           LIMIT 1
       )",
       ascending ? ">" : "<", ascending ? "ASC" : "DESC");
-  return ExecGetSingleResult(db_, found_key, cmd, db_name, store_name,
-                             key.value());
+  return ExecGetSingleResult(db_, statements_, found_key, cmd, db_name,
+                             store_name, key.value());
+}
+
+DatabaseStatus SqliteTransaction::ListData(
+    const std::string& db_name, const std::string& store_name,
+    optional<int64_t> key, bool ascending, size_t count,
+    std::vector<std::pair<int64_t, std::vector<uint8_t>>>* entries) {
+  DCHECK(entries);
+  return ListData(db_name, store_name, key, ascending, count,
+                  [&](int64_t key, const uint8_t* body, size_t size) {
+                    entries->emplace_back(
+                        key, std::vector<uint8_t>(body, body + size));
+                  });
+}
+
+DatabaseStatus SqliteTransaction::ListData(const std::string& db_name,
+                                           const std::string& store_name,
+                                           optional<int64_t> key,
+                                           bool ascending, size_t count,
+                                           const DataCallback& callback) {
+  DCHECK(db_) << "Transaction is closed";
+  std::function<int(int64_t, BlobView)> cb = [&](int64_t key, BlobView body) {
+    callback(key, body.data, body.size);
+    return SQLITE_OK;
+  };
+  // Use a key past the end when there isn't one so there is only one command.
+  const int64_t start =
+      key.value_or(ascending ? std::numeric_limits<int64_t>::min()
+                             : std::numeric_limits<int64_t>::max());
+  const std::string cmd = util::StringPrintf(
+      R"(
+          SELECT key, body FROM objects
+          WHERE store == (SELECT id FROM object_stores
+                          WHERE db_name == ?1 AND store_name == ?2) AND
+                key %s ?3
+          ORDER BY key %s
+          LIMIT ?4
+      )",
+      ascending ? ">" : "<", ascending ? "ASC" : "DESC");
+  return ExecGetResults(db_, statements_, cb, cmd, db_name, store_name, start,
+                        static_cast<int64_t>(count));
+}
+
+DatabaseStatus SqliteTransaction::GetAllData(
+    const std::string& db_name, const std::string& store_name,
+    const KeyRange& range, size_t count,
+    std::vector<std::pair<int64_t, std::vector<uint8_t>>>* entries) {
+  DCHECK(entries);
+  return GetAllData(db_name, store_name, range, count,
+                    [&](int64_t key, const uint8_t* body, size_t size) {
+                      entries->emplace_back(
+                          key, std::vector<uint8_t>(body, body + size));
+                    });
+}
+
+DatabaseStatus SqliteTransaction::GetAllData(const std::string& db_name,
+                                             const std::string& store_name,
+                                             const KeyRange& range,
+                                             size_t count,
+                                             const DataCallback& callback) {
+  DCHECK(db_) << "Transaction is closed";
+  std::function<int(int64_t, BlobView)> cb = [&](int64_t key, BlobView body) {
+    callback(key, body.data, body.size);
+    return SQLITE_OK;
+  };
+  const auto bounds = GetRangeBounds(range);
+  const std::string cmd = "SELECT key, body FROM objects WHERE " +
+                          GetRangeCondition(range) +
+                          " ORDER BY key ASC LIMIT ?5";
+  return ExecGetResults(db_, statements_, cb, cmd, db_name, store_name,
+                        bounds.first, bounds.second, GetLimit(count));
+}
+
+DatabaseStatus SqliteTransaction::GetAllKeys(const std::string& db_name,
+                                             const std::string& store_name,
+                                             const KeyRange& range,
+                                             size_t count,
+                                             std::vector<int64_t>* keys) {
+  DCHECK(db_) << "Transaction is closed";
+  DCHECK(keys);
+  std::function<int(int64_t)> cb = [&](int64_t key) {
+    keys->push_back(key);
+    return SQLITE_OK;
+  };
+  const auto bounds = GetRangeBounds(range);
+  const std::string cmd = "SELECT key FROM objects WHERE " +
+                          GetRangeCondition(range) +
+                          " ORDER BY key ASC LIMIT ?5";
+  return ExecGetResults(db_, statements_, cb, cmd, db_name, store_name,
+                        bounds.first, bounds.second, GetLimit(count));
+}
+
+DatabaseStatus SqliteTransaction::CountData(const std::string& db_name,
+                                            const std::string& store_name,
+                                            const KeyRange& range,
+                                            int64_t* count) {
+  DCHECK(db_) << "Transaction is closed";
+  const auto bounds = GetRangeBounds(range);
+  const std::string cmd =
+      "SELECT COUNT(*) FROM objects WHERE " + GetRangeCondition(range);
+  return ExecGetSingleResult(db_, statements_, count, cmd, db_name, store_name,
+                             bounds.first, bounds.second);
+}
+
+DatabaseStatus SqliteTransaction::HasFileIndex(bool* has_index) {
+  DCHECK(db_) << "Transaction is closed";
+  int64_t version;
+  RETURN_IF_ERROR(
+      ExecGetSingleResult(db_, statements_, &version, "PRAGMA user_version"));
+  *has_index = version >= kFileIndexVersion;
+  return DatabaseStatus::Success;
+}
+
+DatabaseStatus SqliteTransaction::SetHasFileIndex(bool has_index) {
+  DCHECK(db_) << "Transaction is closed";
+  // Pragmas can't use parameters.
+  const int64_t version = has_index ? kFileIndexVersion : 0;
+  return ExecCommand(db_, statements_,
+                     "PRAGMA user_version = " + std::to_string(version));
+}
+
+DatabaseStatus SqliteTransaction::BuildFileIndex(
+    std::function<bool(const uint8_t* body, size_t size,
+                       std::vector<std::string>* files)> get_files) {
+  DCHECK(db_) << "Transaction is closed";
+
+  // Read everything first so we don't change the table while reading it.
+  struct Entry {
+    int64_t store_id;
+    int64_t key;
+    std::vector<std::string> files;
+  };
+  std::vector<Entry> entries;
+  bool parsed = true;
+  std::function<int(int64_t, int64_t, BlobView)> cb =
+      [&](int64_t store_id, int64_t key, BlobView body) {
+        std::vector<std::string> files;
+        if (!get_files(body.data, body.size, &files)) {
+          // Stop reading; SQLITE_DONE ends the query without an error.
+          parsed = false;
+          return SQLITE_DONE;
+        }
+        if (!files.empty())
+          entries.push_back({store_id, key, std::move(files)});
+        return SQLITE_OK;
+      };
+  const DatabaseStatus status = ExecGetResults(
+      db_, statements_, cb, "SELECT store, key, body FROM objects");
+  if (!parsed)
+    return DatabaseStatus::UnknownError;
+  RETURN_IF_ERROR(status);
+
+  for (const Entry& entry : entries)
+    RETURN_IF_ERROR(AddFileReferences(entry.store_id, entry.key, entry.files));
+  return SetHasFileIndex(true);
+}
+
+DatabaseStatus SqliteTransaction::ListReferencedFiles(
+    std::unordered_set<std::string>* files) {
+  DCHECK(db_) << "Transaction is closed";
+  DCHECK(files);
+  std::function<int(std::string)> cb = [&](std::string file) {
+    files->insert(std::move(file));
+    return SQLITE_OK;
+  };
+  // This only reads the file index, not the entries.
+  return ExecGetResults(db_, statements_, cb,
+                        "SELECT DISTINCT file FROM object_files");
+}
+
+DatabaseStatus SqliteTransaction::CountFileReferences(const std::string& file,
+                                                      int64_t* count) {
+  DCHECK(db_) << "Transaction is closed";
+  const std::string cmd = "SELECT COUNT(*) FROM object_files WHERE file == ?1";
+  return ExecGetSingleResult(db_, statements_, count, cmd, file);
 }
 
 
 DatabaseStatus SqliteTransaction::Commit() {
   DCHECK(db_) << "Transaction is closed";
   auto* db = db_;
+  auto* statements = statements_;
   db_ = nullptr;
-  return ExecCommand(db, "COMMIT");
+  statements_ = nullptr;
+  return ExecCommand(db, statements, "COMMIT");
 }
 
 DatabaseStatus SqliteTransaction::Rollback() {
   DCHECK(db_) << "Transaction is closed";
   auto* db = db_;
+  auto* statements = statements_;
   db_ = nullptr;
-  return ExecCommand(db, "ROLLBACK");
+  statements_ = nullptr;
+  return ExecCommand(db, statements, "ROLLBACK");
 }
 
 
@@ -431,14 +737,37 @@ DatabaseStatus SqliteTransaction::GetStoreId(const std::string& db_name,
   const std::string get_cmd =
       "SELECT id FROM object_stores "
       "WHERE db_name == ?1 AND store_name == ?2";
-  return ExecGetSingleResult(db_, store_id, get_cmd, db_name, store_name);
+  return ExecGetSingleResult(db_, statements_, store_id, get_cmd, db_name,
+                             store_name);
 }
 
+DatabaseStatus SqliteTransaction::AddFileReferences(
+    int64_t store_id, int64_t key, const std::vector<std::string>& files) {
+  // An entry can refer to the same file more than once.
+  const std::string cmd =
+      "INSERT OR IGNORE INTO object_files (store, key, file) "
+      "VALUES (?1, ?2, ?3)";
+  for (const std::string& file : files)
+    RETURN_IF_ERROR(ExecCommand(db_, statements_, cmd, store_id, key, file));
+  return DatabaseStatus::Success;
+}
+
+
+constexpr const int SqliteConnection::kCheckpointPages;
+constexpr const int64_t SqliteConnection::kMinVacuumPages;
+constexpr const int64_t SqliteConnection::kVacuumPages;
 
 SqliteConnection::SqliteConnection(const std::string& file_path)
-    : path_(file_path), db_(nullptr) {}
+    : path_(file_path),
+      wal_pages_(0),
+      checkpointed_pages_(0),
+      incremental_vacuum_(false),
+      db_(nullptr) {}
 SqliteConnection::~SqliteConnection() {
   if (db_) {
+    // Sqlite won't close the connection while there are unfinalized
+    // statements.
+    statements_.Clear();
     const auto ret = sqlite3_close(db_);
     if (ret != SQLITE_OK) {
       LOG(ERROR) << "Error closing sqlite connection: " << sqlite3_errstr(ret);
@@ -460,6 +789,13 @@ DatabaseStatus SqliteConnection::Init() {
       -- should never get busy normally.
       PRAGMA busy_timeout = 250;
       PRAGMA foreign_keys = ON;
+      -- These only apply to new databases and must be set before the journal
+      -- mode.  Most of the space is used by large values, so use bigger
+      -- pages to reduce the number of overflow pages they need.  Deletions
+      -- leave free pages that RunMaintenance returns to the file system a few
+      -- at a time.
+      PRAGMA page_size = 16384;
+      PRAGMA auto_vacuum = INCREMENTAL;
       -- Switch to WAL journaling mode; this is faster (usually) and allows for
       -- non-exclusive write transactions.
       PRAGMA journal_mode = WAL;
@@ -485,23 +821,98 @@ DatabaseStatus SqliteConnection::Init() {
         PRIMARY KEY (store, key),
         FOREIGN KEY (store) REFERENCES object_stores (id) ON DELETE CASCADE
       ) WITHOUT ROWID;
+
+      -- The BlobStore files each entry refers to.  Entries with the same
+      -- data share a file, so this counts the references to each file.
+      CREATE TABLE IF NOT EXISTS object_files (
+        store INTEGER NOT NULL,
+        key INTEGER NOT NULL,
+        file TEXT NOT NULL,
+        PRIMARY KEY (store, key, file),
+        FOREIGN KEY (store, key) REFERENCES objects (store, key)
+            ON DELETE CASCADE
+      ) WITHOUT ROWID;
+      CREATE INDEX IF NOT EXISTS object_files_by_file ON object_files (file);
   )";
   RETURN_IF_ERROR(MapErrorCode(
       sqlite3_exec(db, init_cmd.c_str(), nullptr, nullptr, nullptr)));
 
+  // Replace the automatic checkpoint, which runs as part of a commit, with
+  // one in RunMaintenance.
+  sqlite3_wal_hook(db, &SqliteConnection::OnWalCommit, this);
+  int64_t auto_vacuum;
+  RETURN_IF_ERROR(ExecGetSingleResult(db, &statements_, &auto_vacuum,
+                                      "PRAGMA auto_vacuum"));
+  incremental_vacuum_ = auto_vacuum == 2;  // INCREMENTAL
+
+  // A new database has nothing to index.  Older databases are indexed by
+  // BlobStore::BuildFileIndex since it needs to parse the entries.
+  const std::string mark_cmd = R"(
+      SELECT CASE WHEN EXISTS (SELECT 1 FROM objects) THEN 0 ELSE 1 END
+  )";
+  int64_t is_empty;
+  RETURN_IF_ERROR(
+      ExecGetSingleResult(db, &statements_, &is_empty, mark_cmd));
+  if (is_empty) {
+    RETURN_IF_ERROR(ExecCommand(
+        db, &statements_,
+        "PRAGMA user_version = " + std::to_string(kFileIndexVersion)));
+  }
+
   return DatabaseStatus::Success;
 }
 
 DatabaseStatus SqliteConnection::BeginTransaction(
     SqliteTransaction* transaction) {
-  RETURN_IF_ERROR(ExecCommand(db_, "BEGIN TRANSACTION"));
+  RETURN_IF_ERROR(ExecCommand(db_, &statements_, "BEGIN TRANSACTION"));
   transaction->db_ = db_;
+  transaction->statements_ = &statements_;
   return DatabaseStatus::Success;
 }
 
 DatabaseStatus SqliteConnection::Flush() {
-  return MapErrorCode(sqlite3_wal_checkpoint_v2(
-      db_, nullptr, SQLITE_CHECKPOINT_PASSIVE, nullptr, nullptr));
+  int log_pages;
+  int checkpointed_pages;
+  RETURN_IF_ERROR(MapErrorCode(
+      sqlite3_wal_checkpoint_v2(db_, nullptr, SQLITE_CHECKPOINT_PASSIVE,
+                                &log_pages, &checkpointed_pages)));
+  // Readers can stop the checkpoint from copying every page; the rest are
+  // copied by the next one.
+  checkpointed_pages_ = std::max(checkpointed_pages, 0);
+  return DatabaseStatus::Success;
+}
+
+DatabaseStatus SqliteConnection::RunMaintenance() {
+  if (!sqlite3_get_autocommit(db_))
+    return DatabaseStatus::Success;
+
+  if (incremental_vacuum_) {
+    int64_t free_pages;
+    RETURN_IF_ERROR(ExecGetSingleResult(db_, &statements_, &free_pages,
+                                        "PRAGMA freelist_count"));
+    if (free_pages >= kMinVacuumPages) {
+      VLOG(1) << "Vacuuming " << std::min(free_pages, kVacuumPages) << " of "
+              << free_pages << " free pages";
+      RETURN_IF_ERROR(ExecCommand(
+          db_, &statements_,
+          "PRAGMA incremental_vacuum(" + std::to_string(kVacuumPages) + ")"));
+    }
+  }
+
+  if (wal_pages_ - checkpointed_pages_ >= kCheckpointPages)
+    RETURN_IF_ERROR(Flush());
+  return DatabaseStatus::Success;
+}
+
+// static
+int SqliteConnection::OnWalCommit(void* self, sqlite3* /* db */,
+                                  const char* /* name */, int pages) {
+  auto* connection = static_cast<SqliteConnection*>(self);
+  // The journal starts over once it has been fully checkpointed.
+  if (pages < connection->wal_pages_)
+    connection->checkpointed_pages_ = 0;
+  connection->wal_pages_ = pages;
+  return SQLITE_OK;
 }
 
 }  // namespace idb
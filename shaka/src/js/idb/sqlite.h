@@ -16,13 +16,19 @@
 #define SHAKA_EMBEDDED_JS_IDB_SQLITE_H
 
 #include <atomic>
+#include <functional>
+#include <mutex>
 #include <string>
+#include <unordered_map>
+#include <unordered_set>
+#include <utility>
 #include <vector>
 
 #include "shaka/optional.h"
 #include "src/util/macros.h"
 
 struct sqlite3;
+struct sqlite3_stmt;
 
 namespace shaka {
 namespace js {
@@ -45,6 +51,47 @@ enum class DatabaseStatus {
   UnknownError,
 };
 
+/**
+ * A range of keys to query.  A missing bound means the range is unbounded in
+ * that direction.
+ */
+struct KeyRange {
+  optional<int64_t> lower;
+  optional<int64_t> upper;
+  /** Whether |lower| itself is excluded from the range. */
+  bool lower_open = false;
+  /** Whether |upper| itself is excluded from the range. */
+  bool upper_open = false;
+};
+
+/**
+ * Holds the prepared statements for a single connection, keyed by the text of
+ * the command.  Preparing a statement is a large part of the cost of small
+ * queries, so this allows reusing them between calls and transactions.
+ */
+class SqliteStatementCache {
+ public:
+  SqliteStatementCache();
+  ~SqliteStatementCache();
+
+  SHAKA_NON_COPYABLE_OR_MOVABLE_TYPE(SqliteStatementCache);
+
+  /**
+   * Gets a prepared statement for the given command, preparing a new one if
+   * needed.  The caller must reset the statement once it is done with it, so
+   * it can't be used for more than one query at once.
+   * @return The sqlite error code from preparing the statement.
+   */
+  int Get(sqlite3* db, const std::string& cmd, sqlite3_stmt** stmt);
+
+  /** Finalizes all the statements.  This must be done before closing. */
+  void Clear();
+
+ private:
+  std::mutex mutex_;
+  std::unordered_map<std::string, sqlite3_stmt*> statements_;
+};
+
 /**
  * Represents a single transaction within an sqlite database.  There can only be
  * one transaction alive at one time.  The caller must call Commit or Rollback
@@ -53,6 +100,14 @@ enum class DatabaseStatus {
  */
 class SqliteTransaction {
  public:
+  /**
+   * Called with the key and body of an entry.  The body is owned by sqlite and
+   * is only valid during the call, so this avoids copying it when it will be
+   * parsed anyway.
+   */
+  using DataCallback =
+      std::function<void(int64_t key, const uint8_t* body, size_t size)>;
+
   SqliteTransaction();
   SqliteTransaction(SqliteTransaction&&);
   ~SqliteTransaction();
@@ -77,21 +132,29 @@ class SqliteTransaction {
   DatabaseStatus ListObjectStores(const std::string& db_name,
                                   std::vector<std::string>* names);
 
-  /** This will insert a new entry with an auto-generated key. */
+  /**
+   * This will insert a new entry with an auto-generated key.
+   * @param files The names of the BlobStore files the entry refers to.
+   */
   DatabaseStatus AddData(const std::string& db_name,
                          const std::string& store_name,
-                         const std::vector<uint8_t>& data, int64_t* key);
+                         const std::vector<uint8_t>& data, int64_t* key,
+                         const std::vector<std::string>& files = {});
   /** Gets the value of the given entry. */
   DatabaseStatus GetData(const std::string& db_name,
                          const std::string& store_name, int64_t key,
                          std::vector<uint8_t>* data);
+  DatabaseStatus GetData(const std::string& db_name,
+                         const std::string& store_name, int64_t key,
+                         const DataCallback& callback);
   /**
    * This will update an existing entry, or create a new one if it doesn't
    * exist.
    */
   DatabaseStatus UpdateData(const std::string& db_name,
                             const std::string& store_name, int64_t key,
-                            const std::vector<uint8_t>& data);
+                            const std::vector<uint8_t>& data,
+                            const std::vector<std::string>& files = {});
   /** Deletes an existing entry.  Does nothing if it doesn't exist. */
   DatabaseStatus DeleteData(const std::string& db_name,
                             const std::string& store_name, int64_t key);
@@ -99,6 +162,63 @@ class SqliteTransaction {
   DatabaseStatus FindData(const std::string& db_name,
                           const std::string& store_name, optional<int64_t> key,
                           bool ascending, int64_t* found_key);
+  /**
+   * Gets up to |count| entries following (or preceding if not |ascending|) the
+   * given key, in the same order as FindData.  If there aren't any, this
+   * succeeds with an empty list.
+   */
+  DatabaseStatus ListData(
+      const std::string& db_name, const std::string& store_name,
+      optional<int64_t> key, bool ascending, size_t count,
+      std::vector<std::pair<int64_t, std::vector<uint8_t>>>* entries);
+  DatabaseStatus ListData(const std::string& db_name,
+                          const std::string& store_name,
+                          optional<int64_t> key, bool ascending, size_t count,
+                          const DataCallback& callback);
+  /**
+   * Gets the entries in the given range in ascending key order, in a single
+   * query.  If there aren't any, this succeeds with an empty list.
+   * @param count The maximum number of entries to get, or 0 for all of them.
+   */
+  DatabaseStatus GetAllData(
+      const std::string& db_name, const std::string& store_name,
+      const KeyRange& range, size_t count,
+      std::vector<std::pair<int64_t, std::vector<uint8_t>>>* entries);
+  DatabaseStatus GetAllData(const std::string& db_name,
+                            const std::string& store_name,
+                            const KeyRange& range, size_t count,
+                            const DataCallback& callback);
+  /** Same as GetAllData, but only gets the keys. */
+  DatabaseStatus GetAllKeys(const std::string& db_name,
+                            const std::string& store_name,
+                            const KeyRange& range, size_t count,
+                            std::vector<int64_t>* keys);
+  /** Counts the entries in the given range. */
+  DatabaseStatus CountData(const std::string& db_name,
+                           const std::string& store_name,
+                           const KeyRange& range, int64_t* count);
+
+  /**
+   * Gets whether every entry's file references are recorded.  Databases
+   * created by older versions didn't record them; see BuildFileIndex.
+   */
+  DatabaseStatus HasFileIndex(bool* has_index);
+  /** Sets whether the file references are complete.  This is for testing. */
+  DatabaseStatus SetHasFileIndex(bool has_index);
+  /**
+   * Records the file references of every entry in every store and marks the
+   * index as complete.
+   * @param get_files Called with each entry's body to get the names of the
+   *   files it refers to; this returns false if the body can't be parsed,
+   *   which stops the index from being built.
+   */
+  DatabaseStatus BuildFileIndex(
+      std::function<bool(const uint8_t* body, size_t size,
+                         std::vector<std::string>* files)> get_files);
+  /** Gets the names of the files that at least one entry refers to. */
+  DatabaseStatus ListReferencedFiles(std::unordered_set<std::string>* files);
+  /** Gets how many entries refer to the given file. */
+  DatabaseStatus CountFileReferences(const std::string& file, int64_t* count);
 
   DatabaseStatus Commit();
   DatabaseStatus Rollback();
@@ -106,9 +226,12 @@ class SqliteTransaction {
  private:
   DatabaseStatus GetStoreId(const std::string& db_name,
                             const std::string& store_name, int64_t* store_id);
+  DatabaseStatus AddFileReferences(int64_t store_id, int64_t key,
+                                   const std::vector<std::string>& files);
 
   friend class SqliteConnection;
   sqlite3* db_;
+  SqliteStatementCache* statements_;
 };
 
 /**
@@ -128,6 +251,11 @@ class SqliteConnection {
 
   SHAKA_NON_COPYABLE_OR_MOVABLE_TYPE(SqliteConnection);
 
+  /** @return The path to the database file, or empty for a temporary one. */
+  const std::string& path() const {
+    return path_;
+  }
+
   /**
    * Initializes the connection and sets up the database as needed.  This MUST
    * be called before calling any other method.
@@ -143,10 +271,9 @@ class SqliteConnection {
 
 
   /**
-   * Flushes pending transactions from the journal to the database.  Note this
-   * doesn't need to be called and will be handled automatically by the database
-   * ending.  Also note a crash will preserve the journal and there will be no
-   * data loss.
+   * Flushes pending transactions from the journal to the database.  This is
+   * done by RunMaintenance and when the database is closed.  Note a crash will
+   * preserve the journal and there will be no data loss.
    *
    * This is called to reduce the size of the journal to make reads faster.
    * This can be called from a background thread to periodically update the
@@ -154,8 +281,38 @@ class SqliteConnection {
    */
   DatabaseStatus Flush();
 
+  /**
+   * Does the upkeep that Sqlite would otherwise do in the middle of a commit.
+   * Once the journal has grown by kCheckpointPages since the last checkpoint,
+   * this does a passive checkpoint.  If deletions have left at least
+   * kMinVacuumPages free, this returns up to kVacuumPages of them to the file
+   * system.  Both are bounded so this doesn't hold up the next transaction for
+   * long; this should be called after each commit.
+   *
+   * This does nothing while a transaction is happening on this connection.
+   */
+  DatabaseStatus RunMaintenance();
+
+  /** The number of new journal pages before RunMaintenance checkpoints. */
+  static constexpr const int kCheckpointPages = 1000;
+  /** The number of free pages before RunMaintenance vacuums. */
+  static constexpr const int64_t kMinVacuumPages = 64;
+  /** The maximum number of pages RunMaintenance vacuums at once. */
+  static constexpr const int64_t kVacuumPages = 256;
+
  private:
+  static int OnWalCommit(void* self, sqlite3* db, const char* name, int pages);
+
   const std::string path_;
+  SqliteStatementCache statements_;
+  // The size of the journal after the last commit and the number of those
+  // pages that have been checkpointed.  These are only used on the thread that
+  // writes to the database.
+  int wal_pages_;
+  int checkpointed_pages_;
+  // Whether the database supports incremental vacuums.  Databases made before
+  // this was enabled need a full VACUUM to change it.
+  bool incremental_vacuum_;
   // Use an atomic variable so it can be accessed from different threads without
   // a lock.  Sqlite is internally thread-safe.
   std::atomic<sqlite3*> db_;
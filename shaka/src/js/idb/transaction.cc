@@ -14,8 +14,15 @@
 
 #include "src/js/idb/transaction.h"
 
+#include <glog/logging.h>
+
+#include <functional>
+#include <memory>
+#include <utility>
+
 #include "src/core/js_manager_impl.h"
 #include "src/js/dom/dom_exception.h"
+#include "src/js/idb/cursor.h"
 #include "src/js/idb/database.h"
 #include "src/js/idb/object_store.h"
 #include "src/js/idb/request.h"
@@ -26,6 +33,25 @@ namespace shaka {
 namespace js {
 namespace idb {
 
+namespace {
+
+/**
+ * The number of transactions running on the storage thread.  This is only used
+ * on the main thread.
+ */
+size_t pending_transaction_count = 0;
+
+}  // namespace
+
+// Keeps the connection alive until the transaction is done.  The transaction
+// is declared after it so it is destroyed first.  This is only used on the
+// storage thread once the transaction has started.
+struct IDBTransaction::PendingTransaction {
+  std::shared_ptr<SqliteConnection> connection;
+  SqliteTransaction transaction;
+  DatabaseStatus status = DatabaseStatus::Success;
+};
+
 IDBTransaction::IDBTransaction(RefPtr<IDBDatabase> db, IDBTransactionMode mode,
                                const std::vector<std::string>& scope)
     : db(db),
@@ -53,6 +79,7 @@ void IDBTransaction::Trace(memory::HeapTracer* tracer) const {
   tracer->Trace(&db);
   tracer->Trace(&error);
   tracer->Trace(&requests_);
+  tracer->Trace(&cursors_);
   for (const auto& pair : scope_)
     tracer->Trace(&pair.second);
 }
@@ -88,22 +115,61 @@ RefPtr<IDBRequest> IDBTransaction::AddRequest(RefPtr<IDBRequest> request) {
   return request;
 }
 
-void IDBTransaction::DoCommit(SqliteConnection* connection) {
+void IDBTransaction::DoCommit(std::shared_ptr<SqliteConnection> connection,
+                              std::function<void()> on_done) {
   DCHECK(JsManagerImpl::Instance()->MainThread()->BelongsToCurrentThread());
   DCHECK(!done);
+  DCHECK(!pending_);
 
-  SqliteTransaction transaction;
-  DatabaseStatus status = connection->BeginTransaction(&transaction);
-  if (status != DatabaseStatus::Success) {
-    error = new dom::DOMException(UnknownError);
-    aborted = true;
-    active = false;
-    RaiseEvent<events::Event>(EventType::Error);
-  }
-  DoCommit(&transaction);
+  pending_transaction_count++;
+  pending_.reset(new PendingTransaction);
+  pending_->connection = connection;
+  on_done_ = std::move(on_done);
+  // The transaction is only active while the request callbacks are running.
+  active = false;
+
+  // Only the callbacks run on the main thread reference JavaScript objects;
+  // the work callbacks only use |pending|.
+  RefPtr<IDBTransaction> self(this);
+  std::shared_ptr<PendingTransaction> pending = pending_;
+  JsManagerImpl::Instance()->StorageThread()->AddTask(
+      "IndexedDb Begin",
+      [pending]() {
+        pending->status =
+            pending->connection->BeginTransaction(&pending->transaction);
+      },
+      [self]() {
+        if (self->pending_->status != DatabaseStatus::Success) {
+          self->error = new dom::DOMException(UnknownError);
+          self->aborted = true;
+          self->RaiseEvent<events::Event>(EventType::Error);
+        }
+        self->RunNextRequest();
+      });
 }
 
 void IDBTransaction::DoCommit(SqliteTransaction* transaction) {
+  RunRequests(transaction);
+  OnCommitDone(aborted ? transaction->Rollback() : transaction->Commit());
+}
+
+// static
+bool IDBTransaction::HasPendingTransactions() {
+  DCHECK(JsManagerImpl::Instance()->MainThread()->BelongsToCurrentThread());
+  return pending_transaction_count > 0;
+}
+
+void IDBTransaction::AddCursor(RefPtr<IDBCursor> cursor) {
+  cursors_.emplace_back(cursor);
+}
+
+void IDBTransaction::OnEntriesChanged(const std::string& store_name,
+                                      optional<IdbKeyType> key) {
+  for (auto& cursor : cursors_)
+    cursor->OnEntriesChanged(store_name, key);
+}
+
+void IDBTransaction::RunRequests(SqliteTransaction* transaction) {
   sqlite_transaction = transaction;
 
   for (auto it = requests_.begin(); it != requests_.end(); it++) {
@@ -119,9 +185,95 @@ void IDBTransaction::DoCommit(SqliteTransaction* transaction) {
   sqlite_transaction = nullptr;
   active = false;
   done = true;
+}
+
+void IDBTransaction::RunNextRequest() {
+  while (!requests_.empty()) {
+    // The request callbacks can add more requests at the end, so only remove
+    // the request once we start it.
+    RefPtr<IDBRequest> request = requests_.front();
+    requests_.pop_front();
+
+    if (aborted) {
+      request->OnAbort();
+      continue;
+    }
+
+    std::function<void(SqliteTransaction*)> work = request->StartOperation();
+    if (!work) {
+      active = true;
+      request->FinishOperation();
+      active = false;
+      continue;
+    }
+
+    RefPtr<IDBTransaction> self(this);
+    std::shared_ptr<PendingTransaction> pending = pending_;
+    JsManagerImpl::Instance()->StorageThread()->AddTask(
+        "IndexedDb Request",
+        [pending, work]() { work(&pending->transaction); },
+        [self, request]() {
+          // The transaction may have been aborted while this was running.
+          self->active = !self->aborted;
+          request->FinishOperation();
+          DCHECK(request->ready_state == IDBRequestReadyState::DONE);
+          self->active = false;
+          self->RunNextRequest();
+        });
+    return;
+  }
+
+  FinishTransaction();
+}
+
+void IDBTransaction::FinishTransaction() {
+  active = false;
+  done = true;
+  cursors_.clear();
+
+  RefPtr<IDBTransaction> self(this);
+  std::shared_ptr<PendingTransaction> pending = pending_;
+  const bool rollback = aborted;
+  JsManagerImpl::Instance()->StorageThread()->AddTask(
+      "IndexedDb Commit",
+      [pending, rollback]() {
+        if (!rollback) {
+          pending->status = pending->transaction.Commit();
+        } else if (pending->transaction.valid()) {
+          pending->status = pending->transaction.Rollback();
+        } else {
+          pending->status = DatabaseStatus::Success;
+        }
+      },
+      [self, rollback]() {
+        const DatabaseStatus status = self->pending_->status;
+        std::function<void()> on_done = std::move(self->on_done_);
+        std::shared_ptr<SqliteConnection> connection =
+            self->pending_->connection;
+        self->pending_.reset();
+        self->on_done_ = nullptr;
+        pending_transaction_count--;
+
+        // Checkpoint and vacuum in a separate task so the events aren't
+        // delayed by it.
+        if (!rollback && status == DatabaseStatus::Success) {
+          JsManagerImpl::Instance()->StorageThread()->AddTask(
+              "IndexedDb Maintenance",
+              [connection]() {
+                const DatabaseStatus status = connection->RunMaintenance();
+                LOG_IF(WARNING, status != DatabaseStatus::Success)
+                    << "Error in IndexedDb maintenance: "
+                    << static_cast<int>(status);
+              },
+              []() {});
+        }
+
+        self->OnCommitDone(status);
+        on_done();
+      });
+}
 
-  const DatabaseStatus status =
-      aborted ? transaction->Rollback() : transaction->Commit();
+void IDBTransaction::OnCommitDone(DatabaseStatus status) {
   if (status != DatabaseStatus::Success) {
     error = new dom::DOMException(UnknownError);
     aborted = true;
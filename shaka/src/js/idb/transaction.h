@@ -15,14 +15,18 @@
 #ifndef SHAKA_EMBEDDED_JS_IDB_TRANSACTION_H_
 #define SHAKA_EMBEDDED_JS_IDB_TRANSACTION_H_
 
+#include <functional>
 #include <list>
+#include <memory>
 #include <string>
 #include <unordered_map>
 #include <vector>
 
 #include "src/core/member.h"
+#include "shaka/optional.h"
 #include "src/core/ref_ptr.h"
 #include "src/js/events/event_target.h"
+#include "src/js/idb/idb_utils.h"
 #include "src/js/idb/sqlite.h"
 #include "src/mapping/backing_object_factory.h"
 #include "src/mapping/enum.h"
@@ -37,6 +41,7 @@ class DOMException;
 
 namespace idb {
 
+class IDBCursor;
 class IDBDatabase;
 class IDBObjectStore;
 class IDBRequest;
@@ -62,13 +67,38 @@ class IDBTransaction : public events::EventTarget {
   RefPtr<IDBRequest> AddRequest(RefPtr<IDBRequest> request);
 
   /**
-   * Not to be confused with the JavaScript commit() method, this synchronously
-   * runs all the pending requests and executes the transaction in the given
-   * sqlite connection.
+   * Not to be confused with the JavaScript commit() method, this runs all the
+   * pending requests in a new transaction in the given sqlite connection.  The
+   * database work for each request is done on the storage thread so the main
+   * thread isn't blocked on the disk; the requests still run one at a time and
+   * in order.  The "complete" event is raised and |on_done| is called on the
+   * main thread once the transaction has been committed.  The connection can't
+   * be used until then.
+   */
+  void DoCommit(std::shared_ptr<SqliteConnection> connection,
+                std::function<void()> on_done);
+  /**
+   * Synchronously runs all the pending requests and commits the given sqlite
+   * transaction.
    */
-  void DoCommit(SqliteConnection* connection);
   void DoCommit(SqliteTransaction* transaction);
 
+  /**
+   * @return Whether there are transactions running on the storage thread.  The
+   *   values they have stored aren't visible to other connections until they
+   *   finish.
+   */
+  static bool HasPendingTransactions();
+
+  /** Adds a cursor that was opened in this transaction. */
+  void AddCursor(RefPtr<IDBCursor> cursor);
+  /**
+   * Called when a request changes the entries in the given object store.  This
+   * updates the cursors that read ahead in the store.
+   */
+  void OnEntriesChanged(const std::string& store_name,
+                        optional<IdbKeyType> key);
+
   void AddObjectStore(const std::string& name);
   void DeleteObjectStore(const std::string& name);
 
@@ -88,9 +118,28 @@ class IDBTransaction : public events::EventTarget {
   SqliteTransaction* sqlite_transaction;
 
  private:
+  struct PendingTransaction;
+
+  /** Runs the pending requests in the given transaction. */
+  void RunRequests(SqliteTransaction* transaction);
+  /**
+   * Runs the next pending request using the storage thread.  Once all the
+   * requests are done, this finishes the transaction.
+   */
+  void RunNextRequest();
+  /** Commits or rolls back the transaction on the storage thread. */
+  void FinishTransaction();
+  /** Raises the final events once the transaction has been committed. */
+  void OnCommitDone(DatabaseStatus status);
+
   // This must be a list to ensure existing iterators aren't invalidated when
   // inserting.
   std::list<Member<IDBRequest>> requests_;
+  std::vector<Member<IDBCursor>> cursors_;
+
+  // These are only set while running on the storage thread.
+  std::shared_ptr<PendingTransaction> pending_;
+  std::function<void()> on_done_;
 
   std::unordered_map<std::string, Member<IDBObjectStore>> scope_;
 };
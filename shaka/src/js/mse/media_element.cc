@@ -15,6 +15,7 @@
 #include "src/js/mse/media_element.h"
 
 #include <cmath>
+#include <utility>
 
 #include "src/core/js_manager_impl.h"
 #include "src/js/dom/document.h"
@@ -41,7 +42,7 @@ namespace mse {
 HTMLMediaElement::HTMLMediaElement(RefPtr<dom::Document> document,
                                    const std::string& name,
                                    media::MediaPlayer* player)
-    : dom::Element(document, name, nullopt, nullopt),
+    : dom::Element(std::move(document), name, nullopt, nullopt),
       autoplay(false),
       loop(false),
       default_muted(false),
@@ -49,6 +50,7 @@ HTMLMediaElement::HTMLMediaElement(RefPtr<dom::Document> document,
       video_tracks(new VideoTrackList(player)),
       text_tracks(new TextTrackList(player)),
       player_(player),
+      buffered_version_(0),
       clock_(&util::Clock::Instance),
       default_playback_rate_(1) {
   AddListenerField(EventType::Encrypted, &on_encrypted);
@@ -67,6 +69,7 @@ void HTMLMediaElement::Trace(memory::HeapTracer* tracer) const {
   dom::Element::Trace(tracer);
   tracer->Trace(&error);
   tracer->Trace(&media_source_);
+  tracer->Trace(&buffered_);
   tracer->Trace(&audio_tracks);
   tracer->Trace(&video_tracks);
   tracer->Trace(&text_tracks);
@@ -102,7 +105,7 @@ Promise HTMLMediaElement::SetMediaKeys(RefPtr<eme::MediaKeys> media_keys) {
         JsError::TypeError("Error changing MediaKeys on the MediaPlayer"));
   }
 
-  this->media_keys = media_keys;
+  this->media_keys = std::move(media_keys);
   return Promise::Resolved();
 }
 
@@ -142,8 +145,17 @@ media::VideoReadyState HTMLMediaElement::GetReadyState() const {
 }
 
 RefPtr<TimeRanges> HTMLMediaElement::Buffered() const {
-  return new TimeRanges(player_ ? player_->GetBuffered()
-                                : std::vector<media::BufferedRange>{});
+  if (!player_)
+    return new TimeRanges(std::vector<media::BufferedRange>{});
+
+  // Get the version first so a change while getting the ranges will cause the
+  // next call to get them again.
+  const uint64_t version = player_->GetBufferedVersion();
+  if (!buffered_ || version == 0 || version != buffered_version_) {
+    buffered_ = new TimeRanges(player_->GetBuffered());
+    buffered_version_ = version;
+  }
+  return buffered_;
 }
 
 RefPtr<TimeRanges> HTMLMediaElement::Seekable() const {
@@ -339,10 +351,10 @@ void HTMLMediaElement::OnReadyStateChanged(media::VideoReadyState old_state,
   if (old_state >= media::VideoReadyState::HaveFutureData &&
       new_state < media::VideoReadyState::HaveFutureData &&
       new_state > media::VideoReadyState::HaveNothing) {
-    ScheduleEvent<events::Event>(EventType::Waiting);
+    ScheduleCoalescedEvent(EventType::Waiting);
   }
 
-  ScheduleEvent<events::Event>(EventType::ReadyStateChange);
+  ScheduleCoalescedEvent(EventType::ReadyStateChange);
 }
 
 void HTMLMediaElement::OnPlaybackStateChanged(
@@ -355,7 +367,7 @@ void HTMLMediaElement::OnPlaybackStateChanged(
       ScheduleEvent<events::Event>(EventType::Pause);
       break;
     case media::VideoPlaybackState::Buffering:
-      ScheduleEvent<events::Event>(EventType::Waiting);
+      ScheduleCoalescedEvent(EventType::Waiting);
       break;
     case media::VideoPlaybackState::Playing:
       ScheduleEvent<events::Event>(EventType::Playing);
@@ -379,7 +391,7 @@ void HTMLMediaElement::OnPlaybackStateChanged(
 }
 
 void HTMLMediaElement::OnPlaybackRateChanged(double old_rate, double new_rate) {
-  ScheduleEvent<events::Event>(EventType::RateChange);
+  ScheduleCoalescedEvent(EventType::RateChange);
 }
 
 void HTMLMediaElement::OnError(const std::string& error) {
@@ -401,7 +413,7 @@ void HTMLMediaElement::OnSeeking() {
 }
 
 void HTMLMediaElement::OnWaitingForKey() {
-  ScheduleEvent<events::Event>(EventType::WaitingForKey);
+  ScheduleCoalescedEvent(EventType::WaitingForKey);
 }
 
 
@@ -123,6 +123,10 @@ class HTMLMediaElement : public dom::Element, media::MediaPlayer::Client {
   void OnWaitingForKey() override;
 
   Member<MediaSource> media_source_;
+  // The last value returned from Buffered() and the player's buffered version
+  // it was created from; this is reused until the version changes.
+  mutable Member<TimeRanges> buffered_;
+  mutable uint64_t buffered_version_;
   const util::Clock* const clock_;
   std::string src_;
   double default_playback_rate_;
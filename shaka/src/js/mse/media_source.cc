@@ -23,6 +23,8 @@
 #include <vector>
 
 #include "shaka/media/demuxer.h"
+#include "src/core/js_manager_impl.h"
+#include "src/eme/implementation_extensions.h"
 #include "src/js/events/event.h"
 #include "src/js/events/event_names.h"
 #include "src/js/events/media_encrypted_event.h"
@@ -260,6 +262,22 @@ void MediaSource::OnLoadedMetaData(double duration) {
 
 void MediaSource::OnEncrypted(eme::MediaKeyInitDataType type,
                               const uint8_t* data, size_t size) {
+  // Let a built-in CDM start on the license before the app sees the event.
+  // This is queued first with the same priority, so it runs before the
+  // event is dispatched.
+  RefPtr<MediaSource> self(this);
+  std::vector<uint8_t> init_data(data, data + size);
+  JsManagerImpl::Instance()->MainThread()->AddInternalTask(
+      TaskPriority::Events, "MediaSource prefetch license",
+      [self, type, init_data]() {
+        if (!self->video_ || !self->video_->media_keys)
+          return;
+        auto* extensions = ::shaka::eme::ImplementationExtensions::Get(
+            self->video_->media_keys->GetCdm());
+        if (extensions)
+          extensions->PrefetchLicense(type, init_data.data(), init_data.size());
+      });
+
   if (video_) {
     video_->ScheduleEvent<events::MediaEncryptedEvent>(
         EventType::Encrypted, type, ByteBuffer(data, size));
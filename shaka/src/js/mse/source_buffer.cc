@@ -17,6 +17,7 @@
 #include <cmath>
 #include <utility>
 
+#include "src/debug/startup_tracer.h"
 #include "src/js/events/event.h"
 #include "src/js/events/event_names.h"
 #include "src/js/js_error.h"
@@ -33,10 +34,14 @@ SourceBuffer::SourceBuffer(const std::string& mime,
     : mode(AppendMode::SEGMENTS),
       updating(false),
       demuxer_(mime, media_source.get(), &frames_),
+      player_(nullptr),
+      is_video_(false),
       media_source_(media_source),
       timestamp_offset_(0),
       append_window_start_(0),
-      append_window_end_(HUGE_VAL /* Infinity */) {
+      append_window_end_(HUGE_VAL /* Infinity */),
+      budget_consumer_(memory::MemorySubsystem::EncodedFrames, mime,
+                       [this]() { return frames_.EstimateSize(); }) {
   AddListenerField(EventType::UpdateStart, &on_update_start);
   AddListenerField(EventType::Update, &on_update);
   AddListenerField(EventType::UpdateEnd, &on_update_end);
@@ -56,12 +61,15 @@ void SourceBuffer::Trace(memory::HeapTracer* tracer) const {
 
 bool SourceBuffer::Attach(const std::string& mime, media::MediaPlayer* player,
                           bool is_video) {
+  player_ = player;
+  is_video_ = is_video;
   return player->AddMseBuffer(mime, is_video, &frames_);
 }
 
 void SourceBuffer::Detach() {
   demuxer_.Stop();
   media_source_ = nullptr;
+  player_ = nullptr;
 }
 
 ExceptionOr<void> SourceBuffer::AppendBuffer(ByteBuffer data) {
@@ -73,6 +81,10 @@ ExceptionOr<void> SourceBuffer::AppendBuffer(ByteBuffer data) {
     return JsError::DOMException(InvalidStateError,
                                  "Already performing an update.");
   }
+  if (!EvictCodedFrames(data.size())) {
+    return JsError::DOMException(QuotaExceededError,
+                                 "SourceBuffer is full.");
+  }
 
   if (media_source_->ready_state == MediaSourceReadyState::ENDED) {
     media_source_->ready_state = MediaSourceReadyState::OPEN;
@@ -80,12 +92,18 @@ ExceptionOr<void> SourceBuffer::AppendBuffer(ByteBuffer data) {
   }
 
   append_buffer_ = std::move(data);
-  demuxer_.AppendData(
-      timestamp_offset_, append_window_start_, append_window_end_,
-      append_buffer_.data(), append_buffer_.size(),
-      std::bind(&SourceBuffer::OnAppendComplete, this, std::placeholders::_1));
+  if (!demuxer_.AppendData(timestamp_offset_, append_window_start_,
+                           append_window_end_, append_buffer_.data(),
+                           append_buffer_.size(),
+                           std::bind(&SourceBuffer::OnAppendComplete, this,
+                                     std::placeholders::_1))) {
+    append_buffer_.Clear();
+    return JsError::DOMException(QuotaExceededError,
+                                 "Too many pending appends.");
+  }
 
   updating = true;
+  StartupTracer::Instance.AddFirstMilestone("First append");
   return {};
 }
 
@@ -208,6 +226,15 @@ void SourceBuffer::OnAppendComplete(bool success) {
           << (success ? "success" : "error");
   updating = false;
   append_buffer_.Clear();
+  if (success && is_video_ && player_ && !caption_track_ &&
+      demuxer_.HasCaptions()) {
+    // Tracks need to be created on the event thread, so the demuxer holds the
+    // captions it finds until the track exists.
+    caption_track_ =
+        player_->AddTextTrack(media::TextTrackKind::Captions, "CC1", "");
+    if (caption_track_)
+      demuxer_.SetCaptionTrack(caption_track_);
+  }
   if (!success) {
     Abort();
     ScheduleEvent<events::Event>(EventType::Error);
@@ -215,6 +242,45 @@ void SourceBuffer::OnAppendComplete(bool success) {
   ScheduleEvent<events::Event>(EventType::UpdateEnd);
 }
 
+bool SourceBuffer::EvictCodedFrames(size_t new_data_size) {
+  // See: https://w3c.github.io/media-source/#sourcebuffer-coded-frame-eviction
+  // The demuxed frames are about the same size as the segment data, so use
+  // that to estimate how much the append will add.
+  const JsManager::SourceBufferQuota quota = media::GetSourceBufferQuota();
+  const uint64_t max_bytes = media::GetEffectiveSourceBufferQuota(
+      quota, is_video_, media::GetMemoryPressure(),
+      media::GetPhysicalMemory());
+  // Let the other caches make room in the memory budget first; the frames
+  // here can only be removed once they are played.
+  memory::MemoryBudget* budget = memory::MemoryBudget::Instance();
+  const bool fits_budget = budget->Enforce(new_data_size);
+  if (fits_budget &&
+      (max_bytes == 0 || frames_.EstimateSize() + new_data_size <= max_bytes)) {
+    return true;
+  }
+
+  if ((quota.evict_played_media || !fits_budget) && player_) {
+    // Remove everything before the GOP being played; the frames are held by
+    // the decoder until they are no longer needed.
+    auto key_frame = frames_.GetFrame(player_->CurrentTime(),
+                                      media::FrameLocation::KeyFrameBefore);
+    const media::BufferedRanges ranges = frames_.GetBufferedRanges();
+    if (key_frame && !ranges.empty() && ranges.front().start < key_frame->pts) {
+      const size_t old_size = frames_.EstimateSize();
+      frames_.Remove(ranges.front().start, key_frame->pts);
+      VLOG(1) << "Evicted " << (old_size - frames_.EstimateSize())
+              << " bytes of played media to fit an append of "
+              << new_data_size << " bytes";
+    }
+  }
+
+  // Don't reject appends to an empty buffer because of the budget, since
+  // playback couldn't continue otherwise.
+  const size_t size = frames_.EstimateSize();
+  return (max_bytes == 0 || size + new_data_size <= max_bytes) &&
+         (size == 0 || budget->Fits(new_data_size));
+}
+
 
 SourceBufferFactory::SourceBufferFactory() {
   AddListenerField(EventType::UpdateStart, &SourceBuffer::on_update_start);
@@ -20,6 +20,7 @@
 #include "shaka/media/demuxer.h"
 #include "shaka/media/media_player.h"
 #include "shaka/media/streams.h"
+#include "shaka/media/text_track.h"
 #include "src/core/member.h"
 #include "src/js/events/event_target.h"
 #include "src/mapping/byte_buffer.h"
@@ -27,6 +28,7 @@
 #include "src/mapping/exception_or.h"
 #include "src/media/demuxer_thread.h"
 #include "src/media/types.h"
+#include "src/memory/memory_budget.h"
 
 namespace shaka {
 namespace js {
@@ -79,14 +81,28 @@ class SourceBuffer : public events::EventTarget {
   /** Called when an append operation completes. */
   void OnAppendComplete(bool success);
 
+  /**
+   * Makes room for an append of the given size, removing played media if
+   * allowed by the SourceBufferQuota or if needed to fit in the MemoryBudget.
+   * @return True if there is room for the append.
+   */
+  bool EvictCodedFrames(size_t new_data_size);
+
   media::ElementaryStream frames_;
   media::DemuxerThread demuxer_;
+  media::MediaPlayer* player_;
+  bool is_video_;
+  // The track holding the closed captions found in the video, if any.
+  std::shared_ptr<media::TextTrack> caption_track_;
 
   Member<MediaSource> media_source_;
   ByteBuffer append_buffer_;
   double timestamp_offset_;
   double append_window_start_;
   double append_window_end_;
+
+  // This must be last so it is unregistered before the rest is destroyed.
+  memory::MemoryBudget::Consumer budget_consumer_;
 };
 
 class SourceBufferFactory
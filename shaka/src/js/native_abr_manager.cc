@@ -0,0 +1,214 @@
+// Copyright 2020 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     https://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "src/js/native_abr_manager.h"
+
+#include <utility>
+
+#include "src/core/js_manager_impl.h"
+#include "src/core/ref_ptr.h"
+
+namespace shaka {
+
+// \cond Doxygen_Skip
+AbrManager::AbrManager() {}
+AbrManager::~AbrManager() {}
+AbrManager::Client::Client() {}
+AbrManager::Client::~Client() {}
+// \endcond Doxygen_Skip
+
+void AbrManager::Enable() {}
+void AbrManager::Disable() {}
+void AbrManager::SegmentDownloaded(double /* delta_ms */, double /* bytes */) {}
+
+namespace js {
+
+DEFINE_STRUCT_SPECIAL_METHODS_COPYABLE(AbrStream);
+DEFINE_STRUCT_SPECIAL_METHODS_COPYABLE(AbrVariant);
+DEFINE_STRUCT_SPECIAL_METHODS_COPYABLE(AbrConfiguration);
+
+NativeAbrManager::NativeAbrManager(
+    AbrManager* abr, const std::atomic<media::MediaPlayer*>* media_player)
+    : abr_(abr), media_player_(media_player) {}
+// \cond Doxygen_Skip
+NativeAbrManager::~NativeAbrManager() {}
+// \endcond Doxygen_Skip
+
+void NativeAbrManager::Trace(memory::HeapTracer* tracer) const {
+  BackingObject::Trace(tracer);
+  tracer->Trace(&switch_);
+  tracer->Trace(&variants_);
+}
+
+AbrManager::Signals NativeAbrManager::GetSignals() const {
+  AbrManager::Signals ret;
+  BandwidthEstimator::Estimate estimate;
+  if (JsManagerImpl::Instance()
+          ->NetworkThread()
+          ->bandwidth_estimator()
+          ->GetEstimate("", &estimate)) {
+    if (estimate.throughput_samples > 0) {
+      ret.bandwidth_estimate = estimate.throughput_bps;
+      ret.bandwidth_low = estimate.throughput_p10_bps;
+    }
+    ret.ttfb_ms = estimate.ttfb_ms;
+    ret.bandwidth_samples = estimate.throughput_samples;
+  }
+
+  media::MediaPlayer* player = media_player_->load(std::memory_order_acquire);
+  if (player) {
+    const double time = player->CurrentTime();
+    for (const auto& range : player->GetBuffered()) {
+      if (range.start <= time && time < range.end) {
+        ret.buffered_ahead = range.end - time;
+        break;
+      }
+    }
+    ret.playback_rate = player->PlaybackRate();
+
+    const media::VideoPlaybackQuality quality = player->VideoPlaybackQuality();
+    ret.total_video_frames = quality.total_video_frames;
+    ret.dropped_video_frames = quality.dropped_video_frames;
+  }
+  return ret;
+}
+
+void NativeAbrManager::SwitchVariant(int id, bool clear_buffer) {
+  RefPtr<NativeAbrManager> self(this);
+  JsManagerImpl::Instance()->MainThread()->AddInternalTask(
+      TaskPriority::Internal, "NativeAbrManager switch",
+      [self, id, clear_buffer]() { self->DoSwitch(id, clear_buffer); });
+}
+
+void NativeAbrManager::Init(Callback switch_callback) {
+  switch_ = std::move(switch_callback);
+  abr_->Init(this);
+}
+
+void NativeAbrManager::Stop() {
+  abr_->Stop();
+  switch_ = Callback();
+  variants_.clear();
+  native_variants_.clear();
+  enabled_ = false;
+}
+
+Any NativeAbrManager::ChooseVariant() {
+  if (variants_.empty())
+    return Any(nullptr);
+
+  const int id = abr_->ChooseVariant();
+  Any ret = FindVariant(id);
+  if (ret.IsTruthy())
+    return ret;
+  LOG(WARNING) << "AbrManager chose unknown variant " << id
+               << "; using the first variant";
+  return variants_[0];
+}
+
+void NativeAbrManager::Enable() {
+  enabled_ = true;
+  abr_->Enable();
+}
+
+void NativeAbrManager::Disable() {
+  enabled_ = false;
+  abr_->Disable();
+}
+
+void NativeAbrManager::SegmentDownloaded(double delta_ms, double bytes) {
+  abr_->SegmentDownloaded(delta_ms, bytes);
+}
+
+double NativeAbrManager::GetBandwidthEstimate() const {
+  const AbrManager::Signals signals = GetSignals();
+  return signals.bandwidth_estimate > 0 ? signals.bandwidth_estimate
+                                        : default_estimate_;
+}
+
+void NativeAbrManager::SetVariants(std::vector<Any> variants) {
+  std::vector<AbrManager::Variant> native_variants;
+  native_variants.reserve(variants.size());
+  for (const Any& variant : variants) {
+    AbrVariant converted;
+    if (!variant.TryConvertTo(&converted)) {
+      LOG(DFATAL) << "Invalid variant given to AbrManager";
+      return;
+    }
+
+    AbrManager::Variant native;
+    native.id = converted.id;
+    native.bandwidth = converted.bandwidth;
+    if (converted.video.has_value()) {
+      const AbrStream& video = converted.video.value();
+      native.width = static_cast<uint32_t>(video.width.value_or(0));
+      native.height = static_cast<uint32_t>(video.height.value_or(0));
+      native.frame_rate = video.frameRate.value_or(0);
+    }
+    native_variants.emplace_back(native);
+  }
+
+  variants_ = std::move(variants);
+  native_variants_ = std::move(native_variants);
+  abr_->SetVariants(native_variants_);
+}
+
+void NativeAbrManager::PlaybackRateChanged(double /* rate */) {
+  // The AbrManager reads the playback rate from the signals.
+}
+
+void NativeAbrManager::Configure(AbrConfiguration config) {
+  default_estimate_ = config.defaultBandwidthEstimate;
+}
+
+Any NativeAbrManager::FindVariant(int id) const {
+  for (size_t i = 0; i < native_variants_.size(); i++) {
+    if (native_variants_[i].id == id)
+      return variants_[i];
+  }
+  return Any(nullptr);
+}
+
+void NativeAbrManager::DoSwitch(int id, bool clear_buffer) {
+  // Shaka Player doesn't allow switching while disabled, e.g. when the app
+  // chose a track itself.
+  if (!enabled_ || switch_.empty())
+    return;
+
+  Any variant = FindVariant(id);
+  if (!variant.IsTruthy()) {
+    LOG(WARNING) << "AbrManager switched to unknown variant " << id;
+    return;
+  }
+  switch_(variant, clear_buffer);
+}
+
+
+NativeAbrManagerFactory::NativeAbrManagerFactory() {
+  AddMemberFunction("init", &NativeAbrManager::Init);
+  AddMemberFunction("stop", &NativeAbrManager::Stop);
+  AddMemberFunction("chooseVariant", &NativeAbrManager::ChooseVariant);
+  AddMemberFunction("enable", &NativeAbrManager::Enable);
+  AddMemberFunction("disable", &NativeAbrManager::Disable);
+  AddMemberFunction("segmentDownloaded", &NativeAbrManager::SegmentDownloaded);
+  AddMemberFunction("getBandwidthEstimate",
+                    &NativeAbrManager::GetBandwidthEstimate);
+  AddMemberFunction("setVariants", &NativeAbrManager::SetVariants);
+  AddMemberFunction("playbackRateChanged",
+                    &NativeAbrManager::PlaybackRateChanged);
+  AddMemberFunction("configure", &NativeAbrManager::Configure);
+}
+
+}  // namespace js
+}  // namespace shaka
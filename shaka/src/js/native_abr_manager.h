@@ -0,0 +1,113 @@
+// Copyright 2020 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     https://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef SHAKA_EMBEDDED_JS_NATIVE_ABR_MANAGER_H_
+#define SHAKA_EMBEDDED_JS_NATIVE_ABR_MANAGER_H_
+
+#include <atomic>
+#include <vector>
+
+#include "shaka/abr_manager.h"
+#include "shaka/media/media_player.h"
+#include "shaka/optional.h"
+#include "src/mapping/any.h"
+#include "src/mapping/backing_object.h"
+#include "src/mapping/backing_object_factory.h"
+#include "src/mapping/callback.h"
+#include "src/mapping/struct.h"
+
+namespace shaka {
+namespace js {
+
+/** The fields of a Shaka Player stream that are given to the AbrManager. */
+struct AbrStream : Struct {
+  DECLARE_STRUCT_SPECIAL_METHODS_COPYABLE(AbrStream);
+
+  ADD_DICT_FIELD(width, optional<double>);
+  ADD_DICT_FIELD(height, optional<double>);
+  ADD_DICT_FIELD(frameRate, optional<double>);
+};
+
+/** The fields of a Shaka Player variant that are given to the AbrManager. */
+struct AbrVariant : Struct {
+  DECLARE_STRUCT_SPECIAL_METHODS_COPYABLE(AbrVariant);
+
+  ADD_DICT_FIELD(id, int);
+  ADD_DICT_FIELD(bandwidth, double);
+  ADD_DICT_FIELD(video, optional<AbrStream>);
+};
+
+/** The fields of Shaka Player's ABR configuration that are used here. */
+struct AbrConfiguration : Struct {
+  DECLARE_STRUCT_SPECIAL_METHODS_COPYABLE(AbrConfiguration);
+
+  ADD_DICT_FIELD(defaultBandwidthEstimate, double);
+};
+
+/**
+ * Implements Shaka Player's AbrManager interface by forwarding to a native
+ * AbrManager (see Player::SetAbrManager).  This also gives the native
+ * AbrManager the pipeline signals, which are read directly from the native
+ * types.
+ */
+class NativeAbrManager : public BackingObject, public AbrManager::Client {
+  DECLARE_TYPE_INFO(NativeAbrManager);
+
+ public:
+  NativeAbrManager(AbrManager* abr,
+                   const std::atomic<media::MediaPlayer*>* media_player);
+
+  void Trace(memory::HeapTracer* tracer) const override;
+
+  AbrManager::Signals GetSignals() const override;
+  void SwitchVariant(int id, bool clear_buffer) override;
+
+  void Init(Callback switch_callback);
+  void Stop();
+  Any ChooseVariant();
+  void Enable();
+  void Disable();
+  void SegmentDownloaded(double delta_ms, double bytes);
+  double GetBandwidthEstimate() const;
+  void SetVariants(std::vector<Any> variants);
+  void PlaybackRateChanged(double rate);
+  void Configure(AbrConfiguration config);
+
+ private:
+  /** @return The JavaScript variant with the given ID, or null. */
+  Any FindVariant(int id) const;
+
+  /** Called on the JS main thread to switch after SwitchVariant. */
+  void DoSwitch(int id, bool clear_buffer);
+
+  AbrManager* const abr_;
+  const std::atomic<media::MediaPlayer*>* const media_player_;
+  Callback switch_;
+  // The variants from Shaka Player, with the converted copies given to
+  // |abr_| at the same indices.
+  std::vector<Any> variants_;
+  std::vector<AbrManager::Variant> native_variants_;
+  double default_estimate_ = 0;
+  bool enabled_ = false;
+};
+
+class NativeAbrManagerFactory : public BackingObjectFactory<NativeAbrManager> {
+ public:
+  NativeAbrManagerFactory();
+};
+
+}  // namespace js
+}  // namespace shaka
+
+#endif  // SHAKA_EMBEDDED_JS_NATIVE_ABR_MANAGER_H_
@@ -23,11 +23,16 @@
 namespace shaka {
 namespace js {
 
-Navigator::Navigator() {}
+Navigator::Navigator() : connection(new NetworkInformation) {}
 // \cond Doxygen_Skip
 Navigator::~Navigator() {}
 // \endcond Doxygen_Skip
 
+void Navigator::Trace(memory::HeapTracer* tracer) const {
+  BackingObject::Trace(tracer);
+  tracer->Trace(&connection);
+}
+
 Promise Navigator::RequestMediaKeySystemAccess(
     std::string key_system,
     std::vector<eme::MediaKeySystemConfiguration> configs) {
@@ -60,6 +65,16 @@ Promise Navigator::RequestMediaKeySystemAccess(
   return promise;
 }
 
+void Navigator::QueueBeaconEvent(const std::string& name,
+                                 optional<std::string> data) {
+  JsManagerImpl::Instance()->NetworkThread()->AddBeaconEvent(
+      name, data.value_or(""));
+}
+
+void Navigator::QueueBeaconMetric(const std::string& name, double value) {
+  JsManagerImpl::Instance()->NetworkThread()->AddBeaconMetric(name, value);
+}
+
 
 NavigatorFactory::NavigatorFactory() {
   AddReadOnlyProperty("appName", &Navigator::app_name);
@@ -71,9 +86,12 @@ NavigatorFactory::NavigatorFactory() {
   AddReadOnlyProperty("vendor", &Navigator::vendor);
   AddReadOnlyProperty("vendorSub", &Navigator::vendor_sub);
   AddReadOnlyProperty("userAgent", &Navigator::user_agent);
+  AddReadOnlyProperty("connection", &Navigator::connection);
 
   AddMemberFunction("requestMediaKeySystemAccess",
                     &Navigator::RequestMediaKeySystemAccess);
+  AddMemberFunction("queueBeaconEvent", &Navigator::QueueBeaconEvent);
+  AddMemberFunction("queueBeaconMetric", &Navigator::QueueBeaconMetric);
 }
 NavigatorFactory::~NavigatorFactory() {}
 
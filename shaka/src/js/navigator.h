@@ -18,8 +18,11 @@
 #include <string>
 #include <vector>
 
+#include "shaka/optional.h"
 #include "shaka/version.h"
+#include "src/core/member.h"
 #include "src/js/eme/media_key_system_configuration.h"
+#include "src/js/network_information.h"
 #include "src/mapping/backing_object.h"
 #include "src/mapping/backing_object_factory.h"
 #include "src/mapping/promise.h"
@@ -50,6 +53,8 @@ class Navigator : public BackingObject {
  public:
   Navigator();
 
+  void Trace(memory::HeapTracer* tracer) const override;
+
   const std::string app_name = APP_NAME;
   const std::string app_code_name = APP_CODE_NAME;
   const std::string app_version = APP_VERSION;
@@ -59,10 +64,17 @@ class Navigator : public BackingObject {
   const std::string vendor = VENDOR;
   const std::string vendor_sub = VENDOR_SUB;
   const std::string user_agent = USER_AGENT;
+  const Member<NetworkInformation> connection;
 
   Promise RequestMediaKeySystemAccess(
       std::string key_system,
       std::vector<eme::MediaKeySystemConfiguration> configs);
+
+  // Non-standard: adds to the native analytics batches (see
+  // JsManager::SetBeaconOptions).  sendBeacon isn't used since it sends each
+  // call as its own request.
+  void QueueBeaconEvent(const std::string& name, optional<std::string> data);
+  void QueueBeaconMetric(const std::string& name, double value);
 };
 
 class NavigatorFactory : public BackingObjectFactory<Navigator> {
@@ -0,0 +1,81 @@
+// Copyright 2020 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     https://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "src/js/network_information.h"
+
+#include "src/core/js_manager_impl.h"
+
+namespace shaka {
+namespace js {
+
+namespace {
+
+bool GetNativeEstimate(const std::string& host,
+                       BandwidthEstimator::Estimate* estimate) {
+  return JsManagerImpl::Instance()
+      ->NetworkThread()
+      ->bandwidth_estimator()
+      ->GetEstimate(host, estimate);
+}
+
+}  // namespace
+
+DEFINE_STRUCT_SPECIAL_METHODS_COPYABLE(NetworkEstimate);
+
+NetworkInformation::NetworkInformation() {}
+// \cond Doxygen_Skip
+NetworkInformation::~NetworkInformation() {}
+// \endcond Doxygen_Skip
+
+double NetworkInformation::Downlink() const {
+  BandwidthEstimator::Estimate estimate;
+  if (!GetNativeEstimate("", &estimate) || estimate.throughput_samples == 0)
+    return 0;
+  return estimate.throughput_bps / 1e6;
+}
+
+double NetworkInformation::Rtt() const {
+  BandwidthEstimator::Estimate estimate;
+  if (!GetNativeEstimate("", &estimate))
+    return 0;
+  return estimate.ttfb_ms;
+}
+
+optional<NetworkEstimate> NetworkInformation::GetEstimate(
+    const std::string& host) const {
+  BandwidthEstimator::Estimate estimate;
+  if (!GetNativeEstimate(host, &estimate))
+    return nullopt;
+
+  NetworkEstimate ret;
+  ret.throughput = estimate.throughput_bps;
+  ret.throughputMedian = estimate.throughput_p50_bps;
+  ret.throughputLow = estimate.throughput_p10_bps;
+  ret.ttfbMs = estimate.ttfb_ms;
+  ret.connectMs = estimate.connect_ms;
+  ret.sampleCount = estimate.throughput_samples;
+  ret.requestCount = estimate.request_count;
+  return ret;
+}
+
+
+NetworkInformationFactory::NetworkInformationFactory() {
+  AddGenericProperty("downlink", &NetworkInformation::Downlink);
+  AddGenericProperty("rtt", &NetworkInformation::Rtt);
+
+  AddMemberFunction("getEstimate", &NetworkInformation::GetEstimate);
+}
+
+}  // namespace js
+}  // namespace shaka
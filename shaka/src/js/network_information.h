@@ -0,0 +1,74 @@
+// Copyright 2020 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     https://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef SHAKA_EMBEDDED_JS_NETWORK_INFORMATION_H_
+#define SHAKA_EMBEDDED_JS_NETWORK_INFORMATION_H_
+
+#include <string>
+
+#include "shaka/optional.h"
+#include "src/js/events/event_target.h"
+#include "src/mapping/backing_object_factory.h"
+#include "src/mapping/struct.h"
+
+namespace shaka {
+namespace js {
+
+/** The native estimate for a host; see BandwidthEstimator::Estimate. */
+struct NetworkEstimate : Struct {
+  DECLARE_STRUCT_SPECIAL_METHODS_COPYABLE(NetworkEstimate);
+
+  ADD_DICT_FIELD(throughput, double);
+  ADD_DICT_FIELD(throughputMedian, double);
+  ADD_DICT_FIELD(throughputLow, double);
+  ADD_DICT_FIELD(ttfbMs, double);
+  ADD_DICT_FIELD(connectMs, double);
+  ADD_DICT_FIELD(sampleCount, uint64_t);
+  ADD_DICT_FIELD(requestCount, uint64_t);
+};
+
+/**
+ * Implements navigator.connection using the estimates from the native network
+ * thread.  Shaka Player's ABR manager reads |downlink| from this when
+ * useNetworkInformation is set.  These come from CURL's timings, so they
+ * aren't affected by how progress events are throttled.
+ */
+class NetworkInformation : public events::EventTarget {
+  DECLARE_TYPE_INFO(NetworkInformation);
+
+ public:
+  NetworkInformation();
+
+  /** @return The estimated throughput, in megabits per second. */
+  double Downlink() const;
+  /** @return The estimated time to first byte, in milliseconds. */
+  double Rtt() const;
+
+  /**
+   * Non-standard: gets the estimate for requests to the given host, or for
+   * all requests if |host| is empty.
+   */
+  optional<NetworkEstimate> GetEstimate(const std::string& host) const;
+};
+
+class NetworkInformationFactory
+    : public BackingObjectFactory<NetworkInformation, events::EventTarget> {
+ public:
+  NetworkInformationFactory();
+};
+
+}  // namespace js
+}  // namespace shaka
+
+#endif  // SHAKA_EMBEDDED_JS_NETWORK_INFORMATION_H_
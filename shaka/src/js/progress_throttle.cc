@@ -0,0 +1,43 @@
+// Copyright 2020 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     https://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "src/js/progress_throttle.h"
+
+namespace shaka {
+namespace js {
+
+ProgressThrottle::ProgressThrottle()
+    : last_time_(0), has_posted_(false), pending_(false) {}
+
+bool ProgressThrottle::OnDataReceived(uint64_t now, uint32_t interval_ms) {
+  if (pending_ || (has_posted_ && now - last_time_ < interval_ms))
+    return false;
+
+  last_time_ = now;
+  has_posted_ = true;
+  pending_ = true;
+  return true;
+}
+
+void ProgressThrottle::OnTaskRun() {
+  pending_ = false;
+}
+
+void ProgressThrottle::Reset() {
+  last_time_ = 0;
+  has_posted_ = false;
+}
+
+}  // namespace js
+}  // namespace shaka
@@ -0,0 +1,58 @@
+// Copyright 2020 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     https://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef SHAKA_EMBEDDED_JS_PROGRESS_THROTTLE_H_
+#define SHAKA_EMBEDDED_JS_PROGRESS_THROTTLE_H_
+
+#include <stdint.h>
+
+namespace shaka {
+namespace js {
+
+/**
+ * Decides when an XMLHttpRequest should post a task to raise "progress"
+ * events.  The first data always posts one so readyState changes; after that
+ * they are throttled to the given interval.  Only one task is pending at a
+ * time; it reads the current size when it runs, so the bytes received in the
+ * meantime are coalesced into it.  This type isn't thread-safe.
+ */
+class ProgressThrottle {
+ public:
+  ProgressThrottle();
+
+  /**
+   * Called when response data is received.
+   * @param now The current monotonic time, in milliseconds.
+   * @param interval_ms The minimum time between tasks; 0 means no throttling.
+   * @return Whether to post a task to raise the events.
+   */
+  bool OnDataReceived(uint64_t now, uint32_t interval_ms);
+
+  /** Called when the posted task runs. */
+  void OnTaskRun();
+
+  /** Resets the throttling for a new request. */
+  void Reset();
+
+ private:
+  uint64_t last_time_;
+  bool has_posted_;
+  // Whether a task is posted but hasn't run yet.
+  bool pending_;
+};
+
+}  // namespace js
+}  // namespace shaka
+
+#endif  // SHAKA_EMBEDDED_JS_PROGRESS_THROTTLE_H_
@@ -197,6 +197,12 @@ const ByteBuffer& TestType::GetByteBuffer() const {
   return buffer;
 }
 
+ByteBuffer TestType::GetExternalByteBuffer() const {
+  ByteBuffer ret;
+  ret.SetFromExternal(EXPECTED_DATA, EXPECTED_DATA_SIZE, []() {});
+  return ret;
+}
+
 std::string TestType::ToPrettyString(Any anything) const {
   LocalVar<JsValue> value = anything.ToJsValue();
   return Console::ConvertToPrettyString(value);
@@ -257,6 +263,7 @@ TestTypeFactory::TestTypeFactory() {
   AddMemberFunction("getArrayOfStrings", &TestType::GetArrayOfStrings);
   AddMemberFunction("getMapOfStrings", &TestType::GetMapOfStrings);
   AddMemberFunction("getByteBuffer", &TestType::GetByteBuffer);
+  AddMemberFunction("getExternalByteBuffer", &TestType::GetExternalByteBuffer);
 
   AddMemberFunction("toPrettyString", &TestType::ToPrettyString);
 
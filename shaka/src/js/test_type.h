@@ -130,6 +130,7 @@ class TestType : public BackingObject {
   std::vector<std::string> GetArrayOfStrings() const;
   std::unordered_map<std::string, std::string> GetMapOfStrings() const;
   const ByteBuffer& GetByteBuffer() const;
+  ByteBuffer GetExternalByteBuffer() const;
 
   std::string ToPrettyString(Any anything) const;
 
@@ -14,7 +14,11 @@
 
 #include "src/js/text_coders.h"
 
+#include <glog/logging.h>
+
 #include "src/js/js_error.h"
+#include "src/mapping/js_wrappers.h"
+#include "src/util/utf8.h"
 
 namespace shaka {
 namespace js {
@@ -34,7 +38,8 @@ bool GetEncoding(const std::string& value, TextEncoding* encoding) {
 
 DEFINE_STRUCT_SPECIAL_METHODS_COPYABLE(TextDecoderOptions);
 
-TextDecoder::TextDecoder(TextEncoding encoding) : encoding(encoding) {}
+TextDecoder::TextDecoder(TextEncoding encoding, bool fatal)
+    : encoding(encoding), fatal(fatal) {}
 
 // \cond Doxygen_Skip
 TextDecoder::~TextDecoder() {}
@@ -48,18 +53,20 @@ ExceptionOr<TextDecoder*> TextDecoder::Create(
     return JsError::DOMException(NotSupportedError,
                                  "Unsupported encoding: " + encoding.value());
   }
-  if (options.has_value() && options->fatal) {
-    return JsError::DOMException(NotSupportedError,
-                                 "Fatal decoder errors aren't supported");
-  }
-
-  return new TextDecoder(parsed_encoding);
+  const bool fatal = options.has_value() && options->fatal;
+  return new TextDecoder(parsed_encoding, fatal);
 }
 
-ExceptionOr<std::string> TextDecoder::Decode(ByteBuffer buffer) {
-  // std::string is already UTF-8, so just use the mapping framework to convert.
-  return std::string{reinterpret_cast<const char*>(buffer.data()),
-                     buffer.size()};
+ExceptionOr<Any> TextDecoder::Decode(ByteBuffer buffer) {
+  if (fatal && !util::IsValidUtf8(buffer.data(), buffer.size()))
+    return JsError::TypeError("The encoded data was not valid.");
+
+  // The engine decodes the UTF-8 (replacing invalid sequences), and ASCII is
+  // copied directly.
+  LocalVar<JsString> str = JsStringFromUtf8(buffer.data(), buffer.size());
+  Any ret;
+  CHECK(ret.TryConvert(RawToJsValue(str)));
+  return ret;
 }
 
 
@@ -18,6 +18,7 @@
 #include <string>
 
 #include "shaka/optional.h"
+#include "src/mapping/any.h"
 #include "src/mapping/backing_object.h"
 #include "src/mapping/backing_object_factory.h"
 #include "src/mapping/byte_buffer.h"
@@ -42,16 +43,21 @@ class TextDecoder : public BackingObject {
   DECLARE_TYPE_INFO(TextDecoder);
 
  public:
-  explicit TextDecoder(TextEncoding encoding);
+  TextDecoder(TextEncoding encoding, bool fatal);
 
   const TextEncoding encoding;
-  const bool fatal = false;
+  const bool fatal;
   const bool ignoreBOM = true;
 
   static ExceptionOr<TextDecoder*> Create(
       optional<std::string> encoding, optional<TextDecoderOptions> options);
 
-  ExceptionOr<std::string> Decode(ByteBuffer buffer);
+  /**
+   * Decodes the given buffer directly into a JavaScript string, without an
+   * intermediate std::string copy.  If |fatal| is set, this throws a
+   * TypeError for invalid UTF-8; otherwise invalid sequences are replaced.
+   */
+  ExceptionOr<Any> Decode(ByteBuffer buffer);
 };
 
 class TextDecoderFactory : public BackingObjectFactory<TextDecoder> {
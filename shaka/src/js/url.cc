@@ -14,22 +14,81 @@
 
 #include "src/js/url.h"
 
+#include <utility>
+
 #include "src/js/mse/media_source.h"
 
 namespace shaka {
 namespace js {
 
-URL::URL() {}
+URL::URL(util::Url url) : url_(std::move(url)) {}
 // \cond Doxygen_Skip
 URL::~URL() {}
 // \endcond Doxygen_Skip
 
+ExceptionOr<URL*> URL::Create(const std::string& url,
+                              optional<std::string> base) {
+  std::string resolved = url;
+  if (base.has_value() && !util::ResolveUrl(base.value(), url, &resolved))
+    return JsError::TypeError("Invalid URL: " + url);
+
+  util::Url parsed;
+  if (!util::Url::Parse(resolved, &parsed) || !parsed.is_absolute())
+    return JsError::TypeError("Invalid URL: " + url);
+  return new URL(std::move(parsed));
+}
+
 std::string URL::CreateObjectUrl(RefPtr<mse::MediaSource> media_source) {
   return media_source->url;
 }
 
+std::string URL::Href() const {
+  return url_.spec();
+}
+
+std::string URL::Protocol() const {
+  return url_.scheme() + ":";
+}
+
+std::string URL::Host() const {
+  return url_.authority().substr(url_.authority().rfind('@') + 1);
+}
+
+std::string URL::Hostname() const {
+  return url_.host();
+}
+
+std::string URL::Port() const {
+  return url_.port();
+}
+
+std::string URL::Pathname() const {
+  return url_.path();
+}
+
+std::string URL::Search() const {
+  const std::string query = url_.query();
+  return query.empty() ? "" : "?" + query;
+}
+
+std::string URL::Hash() const {
+  const std::string fragment = url_.fragment();
+  return fragment.empty() ? "" : "#" + fragment;
+}
+
 
 URLFactory::URLFactory() {
+  AddGenericProperty("href", &URL::Href);
+  AddGenericProperty("protocol", &URL::Protocol);
+  AddGenericProperty("host", &URL::Host);
+  AddGenericProperty("hostname", &URL::Hostname);
+  AddGenericProperty("port", &URL::Port);
+  AddGenericProperty("pathname", &URL::Pathname);
+  AddGenericProperty("search", &URL::Search);
+  AddGenericProperty("hash", &URL::Hash);
+
+  AddMemberFunction("toString", &URL::Href);
+
   AddStaticFunction("createObjectURL", &URL::CreateObjectUrl);
 }
 
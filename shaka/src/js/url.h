@@ -17,9 +17,12 @@
 
 #include <string>
 
+#include "shaka/optional.h"
 #include "src/core/ref_ptr.h"
 #include "src/mapping/backing_object.h"
 #include "src/mapping/backing_object_factory.h"
+#include "src/mapping/exception_or.h"
+#include "src/util/url.h"
 
 namespace shaka {
 namespace js {
@@ -32,9 +35,24 @@ class URL : public BackingObject {
   DECLARE_TYPE_INFO(URL);
 
  public:
-  URL();
+  explicit URL(util::Url url);
+
+  static ExceptionOr<URL*> Create(const std::string& url,
+                                  optional<std::string> base);
 
   static std::string CreateObjectUrl(RefPtr<mse::MediaSource> media_source);
+
+  std::string Href() const;
+  std::string Protocol() const;
+  std::string Host() const;
+  std::string Hostname() const;
+  std::string Port() const;
+  std::string Pathname() const;
+  std::string Search() const;
+  std::string Hash() const;
+
+ private:
+  const util::Url url_;
 };
 
 class URLFactory : public BackingObjectFactory<URL> {
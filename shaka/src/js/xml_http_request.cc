@@ -23,6 +23,12 @@
 
 #include "src/core/environment.h"
 #include "src/core/js_manager_impl.h"
+#include "src/core/http_cache.h"
+#include "src/core/range_coalescer.h"
+#include "src/core/segment_cache.h"
+#include "src/debug/startup_tracer.h"
+#include "src/js/dom/dom_parser.h"
+#include "src/js/dom/mpd_patcher.h"
 #include "src/js/events/event.h"
 #include "src/js/events/event_names.h"
 #include "src/js/events/progress_event.h"
@@ -31,6 +37,8 @@
 #include "src/js/timeouts.h"
 #include "src/memory/heap_tracer.h"
 #include "src/util/clock.h"
+#include "src/util/manifest_origins.h"
+#include "src/util/url.h"
 #include "src/util/utils.h"
 
 namespace shaka {
@@ -38,11 +46,20 @@ namespace js {
 
 namespace {
 
-/** The minimum delay, in milliseconds, between "progress" events. */
-constexpr size_t kProgressInterval = 15;
+/**
+ * The maximum number of bytes to pre-allocate based on the Content-Length
+ * header; larger bodies will grow as they are downloaded.
+ */
+constexpr const size_t kMaxReserveSize = 64 * 1024 * 1024;
 
 constexpr const char* kCookieFileName = "net_cookies.dat";
 
+// The maximum number of segment hosts to connect to when a manifest arrives.
+constexpr const size_t kMaxManifestOrigins = 4;
+
+/** The response type that gives the body to JavaScript as it is received. */
+constexpr const char* kChunkedResponseType = "moz-chunked-arraybuffer";
+
 size_t UploadCallback(void* buffer, size_t member_size, size_t member_count,
                       void* user_data) {
   auto* request = reinterpret_cast<XMLHttpRequest*>(user_data);
@@ -56,6 +73,11 @@ size_t DownloadCallback(void* buffer, size_t member_size, size_t member_count,
   auto* request = reinterpret_cast<XMLHttpRequest*>(user_data);
   auto* buffer_bytes = reinterpret_cast<uint8_t*>(buffer);
   size_t total_size = member_size * member_count;
+  // CURL will give us the same data again once the request is resumed.
+  if (!JsManagerImpl::Instance()->NetworkThread()->AllowDownload(request,
+                                                                 total_size)) {
+    return CURL_WRITEFUNC_PAUSE;
+  }
   request->OnDataReceived(buffer_bytes, total_size);
   return total_size;
 }
@@ -69,6 +91,43 @@ size_t HeaderCallback(char* buffer, size_t member_size, size_t member_count,
   return total_size;
 }
 
+/**
+ * Parses a Range header value with a single closed range ("bytes=a-b").
+ * @return Whether the value is a single closed range.
+ */
+bool ParseClosedRange(const std::string& value, uint64_t* start,
+                      uint64_t* end) {
+  constexpr const char kPrefix[] = "bytes=";
+  constexpr const size_t kPrefixSize = sizeof(kPrefix) - 1;
+  if (value.compare(0, kPrefixSize, kPrefix) != 0)
+    return false;
+
+  const char* str = value.c_str() + kPrefixSize;
+  char* parse_end;
+  if (!isdigit(*str))
+    return false;
+  errno = 0;
+  *start = strtoull(str, &parse_end, 10);
+  if (*parse_end != '-' || !isdigit(parse_end[1]))
+    return false;
+  *end = strtoull(parse_end + 1, &parse_end, 10);
+  return errno != ERANGE && *parse_end == '\0' && *start <= *end;
+}
+
+/**
+ * Updates the Content-Range and Content-Length headers for a response that
+ * was split out of a coalesced response.
+ */
+void SetPartialResponseHeaders(uint64_t start, uint64_t end,
+                               std::map<std::string, std::string>* headers) {
+  // Keep the "/<total>" part of the original header.
+  std::string& range = (*headers)["content-range"];
+  const size_t slash = range.find('/');
+  range = "bytes " + std::to_string(start) + "-" + std::to_string(end) +
+          (slash == std::string::npos ? "" : range.substr(slash));
+  (*headers)["content-length"] = std::to_string(end - start + 1);
+}
+
 double CurrentDownloadSize(CURL* curl) {
   double ret;
   CHECK_EQ(CURLE_OK, curl_easy_getinfo(curl, CURLINFO_SIZE_DOWNLOAD, &ret));
@@ -123,6 +182,53 @@ bool ParseStatusLine(const char* buffer, size_t length, int* code,
   return true;
 }
 
+/** @return Whether the response headers are for a DASH or HLS manifest. */
+bool IsManifestResponse(const std::map<std::string, std::string>& headers) {
+  auto content_type = headers.find("content-type");
+  if (content_type == headers.end())
+    return false;
+  const std::string type = util::ToAsciiLower(content_type->second);
+  return type.find("dash+xml") != std::string::npos ||
+         type.find("mpegurl") != std::string::npos;
+}
+
+/** @return Whether the given body starts with an MP4 or WebM init segment. */
+bool IsInitSegment(const ByteBuffer& data) {
+  if (data.size() < 8)
+    return false;
+  const uint8_t* bytes = data.data();
+  return memcmp(bytes + 4, "ftyp", 4) == 0 ||
+         memcmp(bytes + 4, "moov", 4) == 0 ||
+         memcmp(bytes, "\x1a\x45\xdf\xa3", 4) == 0;
+}
+
+/** @return The current time, in seconds since the epoch. */
+uint64_t GetEpochSeconds() {
+  return util::Clock::Instance.GetEpochTime() / 1000;
+}
+
+/** @return Whether the response headers are for a DASH manifest. */
+bool IsDashManifestResponse(
+    const std::map<std::string, std::string>& headers) {
+  auto content_type = headers.find("content-type");
+  return content_type != headers.end() &&
+         util::ToAsciiLower(content_type->second).find("dash+xml") !=
+             std::string::npos;
+}
+
+/**
+ * Starts parsing the given DASH manifest in the background, so the nodes can
+ * be created quickly when JavaScript parses it.
+ */
+void PreparseManifest(const ByteBuffer& data, const std::string& url) {
+  // JavaScript decodes the text before parsing, which removes the BOM.
+  const char* begin = reinterpret_cast<const char*>(data.data());
+  const char* end = begin + data.size();
+  if (data.size() >= 3 && memcmp(begin, "\xef\xbb\xbf", 3) == 0)
+    begin += 3;
+  dom::DOMParser::Preparse(std::string(begin, end), url);
+}
+
 }  // namespace
 
 XMLHttpRequest::XMLHttpRequest()
@@ -130,6 +236,8 @@ XMLHttpRequest::XMLHttpRequest()
       mutex_("XMLHttpRequest"),
       curl_(curl_easy_init()),
       request_headers_(nullptr),
+      is_get_request_(false),
+      priority_(RequestPriority::Normal),
       with_credentials_(false) {
   AddListenerField(EventType::Abort, &on_abort);
   AddListenerField(EventType::Error, &on_error);
@@ -222,6 +330,13 @@ ExceptionOr<void> XMLHttpRequest::Open(const std::string& method,
                                  "Synchronous requests are not supported.");
   }
 
+  // Like a browser, relative URLs are resolved against the page's URL.
+  std::string resolved_url;
+  if (!util::ResolveUrl(JsManagerImpl::Instance()->BaseUrl(), url,
+                        &resolved_url)) {
+    return JsError::DOMException(SyntaxError, "Invalid URL: " + url);
+  }
+
   // This will call Abort() which may call back into JavaScript by firing
   // events synchronously.
   Reset();
@@ -230,8 +345,10 @@ ExceptionOr<void> XMLHttpRequest::Open(const std::string& method,
   this->ready_state = XMLHttpRequest::ReadyState::Opened;
   ScheduleEvent<events::Event>(EventType::ReadyStateChange);
 
-  curl_easy_setopt(curl_, CURLOPT_URL, url.c_str());
+  request_url_ = resolved_url;
+  curl_easy_setopt(curl_, CURLOPT_URL, request_url_.c_str());
   curl_easy_setopt(curl_, CURLOPT_CUSTOMREQUEST, method.c_str());
+  is_get_request_ = method == "GET";
   if (method == "HEAD")
     curl_easy_setopt(curl_, CURLOPT_NOBODY, 1L);
 
@@ -256,11 +373,25 @@ ExceptionOr<void> XMLHttpRequest::Send(
       return JsError::DOMException(InvalidStateError,
                                    "The object's state must be OPENED.");
     }
-    if (response_type != "arraybuffer") {
+    if (response_type != "arraybuffer" &&
+        response_type != kChunkedResponseType) {
       return JsError::DOMException(
           NotSupportedError,
           "Response type " + response_type + " is not supported");
     }
+    is_chunked_ = response_type == kChunkedResponseType;
+
+    // Live DASH manifests that have a PatchLocation are updated by fetching
+    // an MPD patch instead; DOMParser applies it to the previous manifest.
+    if (is_get_request_ && !is_chunked_ && !maybe_data.has_value())
+      patch_url_ = dom::MpdPatcher::Instance()->GetPatchUrl(request_url_);
+    if (!patch_url_.empty()) {
+      VLOG(2) << "Requesting MPD patch " << patch_url_ << " for "
+              << request_url_;
+      curl_easy_setopt(curl_, CURLOPT_URL, patch_url_.c_str());
+    } else if (!maybe_data.has_value() && LoadFromCache()) {
+      return {};
+    }
 
     if (maybe_data.has_value()) {
       if (holds_alternative<ByteBuffer>(*maybe_data)) {
@@ -299,6 +430,10 @@ ExceptionOr<void> XMLHttpRequest::SetRequestHeader(const std::string& key,
   }
   const std::string header = key + ": " + value;
   request_headers_ = curl_slist_append(request_headers_, header.c_str());
+  if (util::ToAsciiLower(key) == "range")
+    request_range_ = value;
+  else
+    has_other_headers_ = true;
   return {};
 }
 
@@ -306,6 +441,14 @@ bool XMLHttpRequest::WithCredentials() const {
   return with_credentials_;
 }
 
+std::string XMLHttpRequest::ResponseText() const {
+  std::unique_lock<Mutex> lock(mutex_);
+  // Only create the string when requested since most requests (e.g. segments)
+  // only use the ArrayBuffer.
+  return std::string(reinterpret_cast<const char*>(response.data()),
+                     response.size());
+}
+
 ExceptionOr<void> XMLHttpRequest::SetWithCredentials(bool with_credentials) {
   if (ready_state != XMLHttpRequest::ReadyState::Unsent &&
       ready_state != XMLHttpRequest::ReadyState::Opened) {
@@ -319,22 +462,44 @@ ExceptionOr<void> XMLHttpRequest::SetWithCredentials(bool with_credentials) {
 }
 
 void XMLHttpRequest::RaiseProgressEvents() {
+  // The request can complete on the network thread while this runs.  Once it
+  // is Done, the completion has already scheduled the final events and put
+  // the rest of a chunked response in |response|, so this must not change
+  // either of them.
+  auto set_state = [this](ReadyState state) {
+    std::unique_lock<Mutex> lock(mutex_);
+    if (ready_state == XMLHttpRequest::ReadyState::Done)
+      return false;
+    this->ready_state = state;
+    return true;
+  };
+
+  {
+    std::unique_lock<Mutex> lock(mutex_);
+    progress_throttle_.OnTaskRun();
+  }
   if (abort_pending_)
     return;
 
   if (ready_state == XMLHttpRequest::ReadyState::Opened) {
-    this->ready_state = XMLHttpRequest::ReadyState::HeadersReceived;
+    if (!set_state(XMLHttpRequest::ReadyState::HeadersReceived))
+      return;
     RaiseEvent<events::Event>(EventType::ReadyStateChange);
   }
   if (ready_state != XMLHttpRequest::ReadyState::Loading) {
-    this->ready_state = XMLHttpRequest::ReadyState::Loading;
+    if (!set_state(XMLHttpRequest::ReadyState::Loading))
+      return;
     RaiseEvent<events::Event>(EventType::ReadyStateChange);
   }
 
   double cur_size;
   {
     std::unique_lock<Mutex> lock(mutex_);
+    if (ready_state == XMLHttpRequest::ReadyState::Done)
+      return;
     cur_size = CurrentDownloadSize(curl_);
+    if (is_chunked_)
+      UpdateChunk();
   }
   RaiseEvent<events::ProgressEvent>(EventType::Progress, estimated_size_ != 0,
                                     cur_size, estimated_size_);
@@ -346,12 +511,12 @@ void XMLHttpRequest::OnDataReceived(uint8_t* buffer, size_t length) {
   // We need to schedule these events from this callback since we don't know
   // when the last header will be received.
   const uint64_t now = util::Clock::Instance.GetMonotonicTime();
-  if (!abort_pending_ && now - last_progress_time_ >= kProgressInterval) {
-    last_progress_time_ = now;
-
+  const uint32_t interval =
+      JsManagerImpl::Instance()->NetworkThread()->progress_interval_ms();
+  if (!abort_pending_ && progress_throttle_.OnDataReceived(now, interval)) {
     RefPtr<XMLHttpRequest> req(this);
-    JsManagerImpl::Instance()->MainThread()->AddInternalTask(
-        TaskPriority::Internal, "Schedule XHR events",
+    JsManagerImpl::Instance()->MainThread()->PostTask(
+        TaskPriority::Internal,
         std::bind(&XMLHttpRequest::RaiseProgressEvents, req));
   }
 
@@ -403,6 +568,10 @@ void XMLHttpRequest::OnHeaderReceived(const uint8_t* buffer, size_t length) {
         const auto size = strtol(value.c_str(), &end, 10);
         if (errno != ERANGE && end == value.c_str() + value.size()) {
           estimated_size_ = size;
+          // Pre-allocate the body so we don't need to re-allocate while
+          // downloading.  Don't trust very large values from the server.
+          if (size > 0)
+            temp_data_.Reserve(std::min<size_t>(size, kMaxReserveSize));
         }
       }
     }
@@ -426,17 +595,25 @@ size_t XMLHttpRequest::OnUpload(uint8_t* buffer, size_t length) {
   return length;
 }
 
+void XMLHttpRequest::UpdateChunk() {
+  size_t start;
+  size_t length;
+  if (chunked_response_.NextChunk(temp_data_.data(), temp_data_.size(), &start,
+                                  &length)) {
+    response.SetFromBuffer(temp_data_.data() + start, length);
+  }
+}
+
 void XMLHttpRequest::Reset() {
   Abort();
   response.Clear();
-  response_text = "";
   response_type = "arraybuffer";
   response_url = "";
   status = 0;
   status_text = "";
   timeout_ms = 0;
 
-  last_progress_time_ = 0;
+  progress_throttle_.Reset();
   estimated_size_ = 0;
   parsing_headers_ = false;
   abort_pending_ = false;
@@ -444,6 +621,15 @@ void XMLHttpRequest::Reset() {
   response_headers_.clear();
   temp_data_.Clear();
   upload_data_.Clear();
+  chunked_response_.Reset();
+  is_chunked_ = false;
+  request_url_.clear();
+  request_range_.clear();
+  has_other_headers_ = false;
+  patch_url_.clear();
+  is_get_request_ = false;
+  manifest_origins_.clear();
+  revalidating_entry_.reset();
 
   curl_easy_reset(curl_);
   curl_easy_setopt(curl_, CURLOPT_WRITEFUNCTION, DownloadCallback);
@@ -482,7 +668,7 @@ void XMLHttpRequest::OnRequestComplete(CURLcode code) {
     const auto res =
         curl_easy_getinfo(curl_, CURLINFO_CONTENT_LENGTH_DOWNLOAD_T, &len);
     if (res == 0) {
-      if (len < 0 && temp_data_.Size() > 0) {
+      if (len < 0 && temp_data_.size() > 0) {
         // We don't know when the request ends; assume we have everything so
         // long as we have seen the headers and gotten some data back.  This
         // could mask a real network abort, but we'll probably get errors
@@ -491,7 +677,7 @@ void XMLHttpRequest::OnRequestComplete(CURLcode code) {
                         "We can't tell if the request was aborted due to lack "
                         "of Content-Length header.";
         code = CURLE_OK;
-      } else if (len > 0 && temp_data_.Size() == static_cast<size_t>(len)) {
+      } else if (len > 0 && temp_data_.size() == static_cast<size_t>(len)) {
         // Since we have the Content-Length header, we know when we have
         // received all the data.  Only ignore when we have received everything.
         VLOG(1) << "Ignoring CURLE_RECV_ERROR due to possible iOS bug.";
@@ -501,14 +687,62 @@ void XMLHttpRequest::OnRequestComplete(CURLcode code) {
   }
 #endif
 
-  if (code == CURLE_OK) {
-    response_text = temp_data_.CreateString();
-    response.SetFromDynamicBuffer(temp_data_);
-    temp_data_.Clear();
+  // CURL decodes compressed responses as they are received, so the body is
+  // already decoded; record how much it was compressed.
+  auto encoding = response_headers_.find("content-encoding");
+  if (code == CURLE_OK && !is_chunked_ && encoding != response_headers_.end() &&
+      encoding->second != "identity") {
+    JsManagerImpl::Instance()->NetworkThread()->RecordCompressedResponse(
+        static_cast<uint64_t>(CurrentDownloadSize(curl_)), temp_data_.size());
+  }
 
-    char* url;
+  char* url = nullptr;
+  if (code == CURLE_OK)
     curl_easy_getinfo(curl_, CURLINFO_EFFECTIVE_URL, &url);
-    response_url = url;
+  double total_size = CurrentDownloadSize(curl_);
+  if (code == CURLE_OK)
+    UseRevalidatedEntry(&total_size);
+  CompleteLocked(code, url ? url : "", total_size);
+}
+
+void XMLHttpRequest::CompleteLocked(CURLcode code,
+                                    const std::string& effective_url,
+                                    double total_size) {
+  if (code == CURLE_OK) {
+    if (patch_url_.empty()) {
+      response_url = effective_url;
+      MaybeCacheResponse(temp_data_);
+      MaybeStoreInHttpCache(temp_data_);
+    } else {
+      // The patch is reported as the manifest, so relative URLs in it are
+      // still resolved against the manifest.
+      response_url = request_url_;
+      if (status != 200)
+        dom::MpdPatcher::Instance()->OnPatchFailed(request_url_);
+    }
+    if (IsManifestResponse(response_headers_)) {
+      StartupTracer::Instance.AddFirstMilestone("Manifest received");
+      if (status == 200 && !is_chunked_) {
+        const char* data = reinterpret_cast<const char*>(temp_data_.data());
+        manifest_origins_ = util::FindManifestOrigins(
+            std::string(data, data + temp_data_.size()), effective_url,
+            kMaxManifestOrigins);
+      }
+    }
+    if (status == 200 && !is_chunked_ &&
+        IsDashManifestResponse(response_headers_)) {
+      PreparseManifest(temp_data_, request_url_);
+    }
+
+    if (is_chunked_) {
+      size_t start;
+      size_t length;
+      chunked_response_.Finish(temp_data_.size(), &start, &length);
+      response.SetFromBuffer(temp_data_.data() + start, length);
+    } else {
+      temp_data_.ShrinkToFit();
+      response = std::move(temp_data_);
+    }
 
     // Flush cookie list to disk so other instances can access them.
     curl_easy_setopt(curl_, CURLOPT_COOKIELIST, "FLUSH");
@@ -517,6 +751,8 @@ void XMLHttpRequest::OnRequestComplete(CURLcode code) {
     // But we do need to set these as they are set in OnHeaderReceived.
     status = 0;
     status_text = "";
+    if (!patch_url_.empty())
+      dom::MpdPatcher::Instance()->OnPatchFailed(request_url_);
   }
 
   // Don't schedule events if we are aborted, they will be called within
@@ -525,7 +761,6 @@ void XMLHttpRequest::OnRequestComplete(CURLcode code) {
     this->ready_state = XMLHttpRequest::ReadyState::Done;
     ScheduleEvent<events::Event>(EventType::ReadyStateChange);
 
-    double total_size = CurrentDownloadSize(curl_);
     ScheduleEvent<events::ProgressEvent>(EventType::Progress, true, total_size,
                                          total_size);
     switch (code) {
@@ -545,6 +780,288 @@ void XMLHttpRequest::OnRequestComplete(CURLcode code) {
   }
 }
 
+bool XMLHttpRequest::GetCoalesceInfo(std::string* key, uint64_t* start,
+                                     uint64_t* end) const {
+  std::unique_lock<Mutex> lock(mutex_);
+  if (!is_get_request_ || is_chunked_ || upload_data_.size() != 0 ||
+      revalidating_entry_ || !ParseClosedRange(request_range_, start, end)) {
+    return false;
+  }
+
+  // Only coalesce requests that would send the same headers.
+  *key = request_url_;
+  for (curl_slist* item = request_headers_; item; item = item->next) {
+    const std::string header = item->data;
+    if (util::ToAsciiLower(header.substr(0, 6)) != "range:")
+      key->append("\n" + header);
+  }
+  key->append(with_credentials_ ? "\n1" : "\n0");
+  return true;
+}
+
+void XMLHttpRequest::SetCoalescedRange(uint64_t end) {
+  std::unique_lock<Mutex> lock(mutex_);
+  uint64_t start;
+  uint64_t own_end;
+  CHECK(ParseClosedRange(request_range_, &start, &own_end));
+
+  // Rebuild the header list with the wider range; |request_range_| keeps the
+  // original range since that is what this request returns.
+  curl_slist* headers = nullptr;
+  for (curl_slist* item = request_headers_; item; item = item->next) {
+    const std::string header = item->data;
+    if (util::ToAsciiLower(header.substr(0, 6)) != "range:")
+      headers = curl_slist_append(headers, header.c_str());
+  }
+  const std::string range = "Range: bytes=" + std::to_string(start) + "-" +
+                            std::to_string(end);
+  headers = curl_slist_append(headers, range.c_str());
+  curl_slist_free_all(request_headers_);
+  request_headers_ = headers;
+  curl_easy_setopt(curl_, CURLOPT_HTTPHEADER, request_headers_);
+}
+
+bool XMLHttpRequest::SplitCoalescedResponse(
+    CURLcode code, const std::vector<RefPtr<XMLHttpRequest>>& others) {
+  std::unique_lock<Mutex> lock(mutex_);
+  uint64_t start;
+  uint64_t own_end;
+  CHECK(ParseClosedRange(request_range_, &start, &own_end));
+  if (code != CURLE_OK || status != 206)
+    return false;
+
+  // The server may ignore or shorten the range, so make sure the body starts
+  // where we asked and covers every request.
+  auto content_range = response_headers_.find("content-range");
+  const std::string expected_prefix = "bytes " + std::to_string(start) + "-";
+  if (content_range == response_headers_.end() ||
+      content_range->second.compare(0, expected_prefix.size(),
+                                    expected_prefix) != 0) {
+    return false;
+  }
+
+  // Find each request's part of the body before completing any of them, so
+  // none are completed if the body doesn't cover them all.
+  std::vector<std::pair<size_t, size_t>> parts(others.size());
+  for (size_t i = 0; i < others.size(); i++) {
+    RangeRequest range;
+    CHECK(others[i]->GetCoalesceRange(&range.start, &range.end));
+    if (!GetCoalescedPart(start, temp_data_.size(), range, &parts[i].first,
+                          &parts[i].second)) {
+      return false;
+    }
+  }
+  size_t own_offset;
+  size_t own_size;
+  if (!GetCoalescedPart(start, temp_data_.size(), {"", start, own_end},
+                        &own_offset, &own_size)) {
+    return false;
+  }
+
+  // Each request refers to its part of the shared body, so it isn't copied.
+  std::shared_ptr<ByteBuffer> body(new ByteBuffer(std::move(temp_data_)));
+  char* url = nullptr;
+  curl_easy_getinfo(curl_, CURLINFO_EFFECTIVE_URL, &url);
+  for (size_t i = 0; i < others.size(); i++) {
+    others[i]->OnCoalescedComplete(*this, url ? url : "", body,
+                                   parts[i].first, parts[i].second);
+  }
+  temp_data_.SetFromExternal(body->data() + own_offset, own_size,
+                             [body]() {});
+  SetPartialResponseHeaders(start, own_end, &response_headers_);
+  return true;
+}
+
+bool XMLHttpRequest::GetCoalesceRange(uint64_t* start, uint64_t* end) const {
+  std::unique_lock<Mutex> lock(mutex_);
+  return ParseClosedRange(request_range_, start, end);
+}
+
+void XMLHttpRequest::OnCoalescedComplete(const XMLHttpRequest& source,
+                                         const std::string& effective_url,
+                                         std::shared_ptr<ByteBuffer> body,
+                                         size_t offset, size_t size) {
+  std::unique_lock<Mutex> lock(mutex_);
+  status = source.status;
+  status_text = source.status_text;
+  response_headers_ = source.response_headers_;
+  uint64_t start;
+  uint64_t end;
+  CHECK(ParseClosedRange(request_range_, &start, &end));
+  SetPartialResponseHeaders(start, end, &response_headers_);
+
+  temp_data_.SetFromExternal(body->data() + offset, size, [body]() {});
+  CompleteLocked(CURLE_OK, effective_url, size);
+}
+
+bool XMLHttpRequest::CanHedge() const {
+  std::unique_lock<Mutex> lock(mutex_);
+  return is_get_request_ && !is_chunked_ && upload_data_.size() == 0 &&
+         !revalidating_entry_ && patch_url_.empty();
+}
+
+void XMLHttpRequest::OnHedgeComplete(const std::vector<std::string>& headers,
+                                     ByteBuffer body,
+                                     const std::string& effective_url) {
+  {
+    std::unique_lock<Mutex> lock(mutex_);
+    parsing_headers_ = false;
+    temp_data_.Clear();
+  }
+  // The request was removed from the multi handle, so its own callbacks won't
+  // run again.
+  for (const std::string& header : headers) {
+    OnHeaderReceived(reinterpret_cast<const uint8_t*>(header.data()),
+                     header.size());
+  }
+
+  std::unique_lock<Mutex> lock(mutex_);
+  const double total_size = body.size();
+  temp_data_ = std::move(body);
+  CompleteLocked(CURLE_OK, effective_url, total_size);
+}
+
+bool XMLHttpRequest::LoadFromCache() {
+  // The caches are keyed only on the URL and Range, so the stored response
+  // could be wrong for a request with other headers.
+  if (!is_get_request_ || has_other_headers_)
+    return false;
+
+  NetworkThread* network = JsManagerImpl::Instance()->NetworkThread();
+  const std::string key = SegmentCache::MakeKey(request_url_, request_range_);
+  if (network->segment_cache()->enabled()) {
+    std::shared_ptr<const SegmentCache::Entry> entry =
+        network->segment_cache()->Get(key);
+    if (entry) {
+      VLOG(2) << "Using cached response for " << request_url_;
+      CompleteFromCache(entry);
+      return true;
+    }
+  }
+
+  if (is_chunked_ || !network->http_cache()->enabled())
+    return false;
+  std::shared_ptr<const HttpCache::Entry> entry =
+      network->http_cache()->Get(key);
+  if (!entry)
+    return false;
+  if (entry->IsFresh(GetEpochSeconds())) {
+    VLOG(2) << "Using fresh HTTP cache entry for " << request_url_;
+    CompleteFromCache(entry);
+    return true;
+  }
+
+  // Requests that are already conditional have other headers, so they don't
+  // get here.
+  VLOG(2) << "Revalidating HTTP cache entry for " << request_url_;
+  for (const std::string& header : entry->GetValidatorHeaders())
+    request_headers_ = curl_slist_append(request_headers_, header.c_str());
+  revalidating_entry_ = entry;
+  return false;
+}
+
+void XMLHttpRequest::CompleteFromCache(
+    std::shared_ptr<const SegmentCache::Entry> entry) {
+  status = entry->status;
+  status_text = entry->status_text;
+  response_url = entry->uri;
+  response_headers_ = entry->headers;
+  // Refer to the cached data directly; the entry is kept alive until the
+  // ArrayBuffer is freed.  The caches only hold manifests and segments, which
+  // the player doesn't modify in place.
+  response.SetFromExternal(entry->data.data(), entry->data.size(),
+                           [entry]() {});
+
+  // Events are still fired asynchronously, as if the request was made.
+  const double total_size = entry->data.size();
+  this->ready_state = XMLHttpRequest::ReadyState::Done;
+  ScheduleEvent<events::Event>(EventType::ReadyStateChange);
+  ScheduleEvent<events::ProgressEvent>(EventType::Progress, true, total_size,
+                                       total_size);
+  ScheduleEvent<events::Event>(EventType::Load);
+  ScheduleEvent<events::ProgressEvent>(EventType::LoadEnd, true, total_size,
+                                       total_size);
+}
+
+bool XMLHttpRequest::UseRevalidatedEntry(double* total_size) {
+  if (status != 304 || !revalidating_entry_)
+    return false;
+
+  // Update the stored headers and freshness; if the entry was evicted in the
+  // meantime, the body we have is still current.
+  std::shared_ptr<const HttpCache::Entry> entry =
+      JsManagerImpl::Instance()->NetworkThread()->http_cache()->Refresh(
+          SegmentCache::MakeKey(request_url_, request_range_),
+          response_headers_, GetEpochSeconds());
+  if (!entry)
+    entry = revalidating_entry_;
+  VLOG(2) << "Using revalidated HTTP cache entry for " << request_url_;
+
+  status = entry->status;
+  status_text = entry->status_text;
+  response_headers_ = entry->headers;
+  temp_data_.SetFromExternal(entry->data.data(), entry->data.size(),
+                             [entry]() {});
+  *total_size = entry->data.size();
+  revalidating_entry_.reset();
+  return true;
+}
+
+void XMLHttpRequest::MaybeCacheResponse(const ByteBuffer& data) {
+  SegmentCache* cache =
+      JsManagerImpl::Instance()->NetworkThread()->segment_cache();
+  if (!is_get_request_ || has_other_headers_ ||
+      (status != 200 && status != 206) || !cache->enabled()) {
+    return;
+  }
+
+  // Manifests can change (e.g. for live streams), so never cache them.
+  if (IsManifestResponse(response_headers_))
+    return;
+  auto cache_control = response_headers_.find("cache-control");
+  if (cache_control != response_headers_.end()) {
+    const std::string value = util::ToAsciiLower(cache_control->second);
+    if (value.find("no-store") != std::string::npos ||
+        value.find("no-cache") != std::string::npos ||
+        value.find("private") != std::string::npos) {
+      return;
+    }
+  }
+
+  std::shared_ptr<SegmentCache::Entry> entry(new SegmentCache::Entry);
+  entry->status = status;
+  entry->status_text = status_text;
+  entry->uri = response_url;
+  entry->headers = response_headers_;
+  entry->data.assign(data.data(), data.data() + data.size());
+  cache->Put(SegmentCache::MakeKey(request_url_, request_range_),
+             std::move(entry));
+}
+
+void XMLHttpRequest::MaybeStoreInHttpCache(const ByteBuffer& data) {
+  HttpCache* cache = JsManagerImpl::Instance()->NetworkThread()->http_cache();
+  const uint64_t now = GetEpochSeconds();
+  if (!is_get_request_ || is_chunked_ || has_other_headers_ ||
+      !cache->enabled() || data.size() > HttpCache::kMaxEntryBytes ||
+      !HttpCache::CanStore(status, response_headers_, now)) {
+    return;
+  }
+  // Only store what is requested each time the content starts; media
+  // segments use the segment cache.
+  if (!IsManifestResponse(response_headers_) && !IsInitSegment(data))
+    return;
+
+  std::shared_ptr<HttpCache::Entry> entry(new HttpCache::Entry);
+  entry->status = status;
+  entry->status_text = status_text;
+  entry->uri = response_url;
+  entry->headers = response_headers_;
+  entry->data.assign(data.data(), data.data() + data.size());
+  entry->fresh_until = HttpCache::GetFreshUntil(response_headers_, now);
+  cache->Put(SegmentCache::MakeKey(request_url_, request_range_),
+             std::move(entry));
+}
+
 
 XMLHttpRequestFactory::XMLHttpRequestFactory() {
   AddConstant("UNSENT", XMLHttpRequest::ReadyState::Unsent);
@@ -555,7 +1072,7 @@ XMLHttpRequestFactory::XMLHttpRequestFactory() {
 
   AddReadOnlyProperty("readyState", &XMLHttpRequest::ready_state);
   AddReadOnlyProperty("response", &XMLHttpRequest::response);
-  AddReadOnlyProperty("responseText", &XMLHttpRequest::response_text);
+  AddGenericProperty("responseText", &XMLHttpRequest::ResponseText);
   AddReadWriteProperty("responseType", &XMLHttpRequest::response_type);
   AddReadOnlyProperty("responseURL", &XMLHttpRequest::response_url);
   AddReadOnlyProperty("status", &XMLHttpRequest::status);
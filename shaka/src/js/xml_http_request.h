@@ -19,18 +19,24 @@
 
 #include <atomic>
 #include <map>
+#include <memory>
 #include <string>
+#include <vector>
 
 #include "shaka/optional.h"
 #include "shaka/variant.h"
+#include "src/core/http_cache.h"
+#include "src/core/ref_ptr.h"
+#include "src/core/request_priority.h"
 #include "src/debug/mutex.h"
+#include "src/js/chunked_response.h"
 #include "src/js/events/event_target.h"
+#include "src/js/progress_throttle.h"
 #include "src/mapping/backing_object_factory.h"
 #include "src/mapping/byte_buffer.h"
 #include "src/mapping/byte_string.h"
 #include "src/mapping/enum.h"
 #include "src/mapping/exception_or.h"
-#include "src/util/dynamic_buffer.h"
 
 namespace shaka {
 class NetworkThread;
@@ -43,7 +49,12 @@ namespace js {
  *
  * Notes:
  * - Only supports asynchronous mode.
- * - Only support 'arraybuffer' responseType, but still sets responseText.
+ * - Only support 'arraybuffer' and 'moz-chunked-arraybuffer' responseType,
+ *   but still sets responseText.
+ * - With 'moz-chunked-arraybuffer', each "progress" event sets response to
+ *   the complete top-level MP4 boxes (e.g. moof+mdat chunks) received since
+ *   the previous event; the last event before "load" has the remaining data.
+ *   This allows appending CMAF chunks before the whole segment is downloaded.
  * - Send() supports string, ArrayBuffer, or ArrayBufferView.
  * - Supports responseURL.
  * - Supports request/response headers.
@@ -86,6 +97,7 @@ class XMLHttpRequest : public events::EventTarget {
                                      const std::string& value);
   bool WithCredentials() const;
   ExceptionOr<void> SetWithCredentials(bool with_credentials);
+  std::string ResponseText() const;
 
   /**
    * Called from a CURL callback when (part of) the body data is received.
@@ -113,7 +125,6 @@ class XMLHttpRequest : public events::EventTarget {
 
   ReadyState ready_state;
   ByteBuffer response;
-  std::string response_text;
   std::string response_type;
   std::string response_url;
   int status;
@@ -125,20 +136,154 @@ class XMLHttpRequest : public events::EventTarget {
 
   void RaiseProgressEvents();
 
+  /**
+   * Moves the complete MP4 boxes received since the last chunk into
+   * |response|.  This must be called while holding |mutex_|.
+   */
+  void UpdateChunk();
+
   /** Called when the request completes. */
   void OnRequestComplete(CURLcode code);
 
+  /**
+   * Completes the request, firing the events.  This must be called while
+   * holding |mutex_|.
+   * @param code The result of the transfer.
+   * @param effective_url The URL of the response, after redirects.
+   * @param total_size The number of body bytes received.
+   */
+  void CompleteLocked(CURLcode code, const std::string& effective_url,
+                      double total_size);
+
+  /**
+   * Gets the info used to coalesce this request with requests for adjacent
+   * ranges.  Only GET requests for a single closed byte range can be
+   * coalesced.  This must be called before the request starts.
+   * @param key [OUT] Requests with the same key are for the same URL with the
+   *   same headers, other than Range.
+   * @param start [OUT] The first byte requested.
+   * @param end [OUT] The last byte requested (inclusive).
+   * @return Whether this request can be coalesced.
+   */
+  bool GetCoalesceInfo(std::string* key, uint64_t* start, uint64_t* end) const;
+
+  /** Gets the byte range this request asked for, like GetCoalesceInfo. */
+  bool GetCoalesceRange(uint64_t* start, uint64_t* end) const;
+
+  /**
+   * Changes the request to download from its own start to the given end
+   * (inclusive), so it covers the ranges of the requests coalesced into it.
+   * This must be called before the request starts.
+   */
+  void SetCoalescedRange(uint64_t end);
+
+  /**
+   * Called on the network thread when a coalesced request finishes, before
+   * OnRequestComplete.  If the server returned the whole combined range, this
+   * completes |others| with their parts of the body and trims this request's
+   * body to its own range.
+   * @return True if |others| were completed; false if they need to be retried
+   *   on their own.
+   */
+  bool SplitCoalescedResponse(
+      CURLcode code, const std::vector<RefPtr<XMLHttpRequest>>& others);
+
+  /**
+   * Completes this request with part of the body of a coalesced request.
+   * |body| is shared with the other requests so it isn't copied.
+   */
+  void OnCoalescedComplete(const XMLHttpRequest& source,
+                           const std::string& effective_url,
+                           std::shared_ptr<ByteBuffer> body, size_t offset,
+                           size_t size);
+
+  /**
+   * @return Whether a duplicate of this request can be sent if it is slow.
+   *   Only GET requests that don't stream their response can be duplicated.
+   */
+  bool CanHedge() const;
+
+  /**
+   * Called on the network thread when a duplicate of this request completes
+   * first.  The request must have been removed from the multi handle.  This
+   * replaces anything received so far with the duplicate's response.
+   * @param headers The raw header lines of the duplicate's response.
+   * @param body The body of the duplicate's response.
+   * @param effective_url The URL of the response, after redirects.
+   */
+  void OnHedgeComplete(const std::vector<std::string>& headers,
+                       ByteBuffer body, const std::string& effective_url);
+
+  /**
+   * Completes the request using the segment cache or the HTTP cache, if
+   * possible.  If the HTTP cache has a stale entry, this adds its validators
+   * to the request instead.  This must be called while holding |mutex_|.
+   * @return True if the request was completed from a cache.
+   */
+  bool LoadFromCache();
+
+  /**
+   * Completes the request with the given cached response, firing the events
+   * asynchronously.  This must be called while holding |mutex_|.
+   */
+  void CompleteFromCache(std::shared_ptr<const SegmentCache::Entry> entry);
+
+  /**
+   * If the server said the HTTP cache entry the request was validating is
+   * still current, replaces the "304 Not Modified" response with the stored
+   * one.  This must be called while holding |mutex_|.
+   * @param total_size [OUT] Set to the size of the stored body.
+   * @return True if the stored response was used.
+   */
+  bool UseRevalidatedEntry(double* total_size);
+
+  /**
+   * Stores the completed response body in the segment cache, if allowed.  This
+   * must be called while holding |mutex_|.
+   */
+  void MaybeCacheResponse(const ByteBuffer& data);
+
+  /**
+   * Stores the completed response in the HTTP cache if it is a manifest or an
+   * init segment and the headers allow it.  This must be called while holding
+   * |mutex_|.
+   */
+  void MaybeStoreInHttpCache(const ByteBuffer& data);
+
   void Reset();
 
   mutable Mutex mutex_;
   std::map<std::string, std::string> response_headers_;
-  util::DynamicBuffer temp_data_;
+  // The body is downloaded directly into this buffer, which is then moved into
+  // |response| so it can be given to JavaScript without a copy.
+  ByteBuffer temp_data_;
   ByteBuffer upload_data_;
+  // When using chunked responses, which parts of |temp_data_| have already
+  // been given to JavaScript.
+  ChunkedResponse chunked_response_;
+  bool is_chunked_;
+  // The URL and Range header of the request, used as the cache key.
+  std::string request_url_;
+  std::string request_range_;
+  // Whether the request has headers other than Range.  The response could
+  // depend on these (e.g. credentials) and they aren't part of the cache key,
+  // so these requests don't use the caches.
+  bool has_other_headers_;
+  // The MPD patch URL that is requested instead of |request_url_|, if any.
+  std::string patch_url_;
+  bool is_get_request_;
+  // The priority class of the request; this is only used by NetworkThread.
+  RequestPriority priority_;
+  // The other hosts a manifest response refers to; NetworkThread takes these
+  // once the request completes and connects to them.
+  std::vector<std::string> manifest_origins_;
+  // The stale HTTP cache entry whose validators were sent with the request.
+  std::shared_ptr<const HttpCache::Entry> revalidating_entry_;
 
   CURL* curl_;
   curl_slist* request_headers_;
   size_t upload_pos_;
-  uint64_t last_progress_time_;
+  ProgressThrottle progress_throttle_;
   double estimated_size_;
   bool parsing_headers_;
   bool with_credentials_;
@@ -48,6 +48,10 @@ bool BackingObject::IsRootedAlive() const {
 #endif
 }
 
+std::string BackingObject::TraceTypeName() const {
+  return name();
+}
+
 std::string BackingObject::name() const {
   return factory()->name();
 }
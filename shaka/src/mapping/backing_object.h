@@ -36,16 +36,19 @@ class Debug;
 
 class BackingObjectFactoryBase;
 
-#define DECLARE_TYPE_INFO(type) \
- public:                        \
-  static std::string name() {   \
-    return #type;               \
-  }                             \
-                                \
- protected:                     \
-  ~type() override;             \
-                                \
- public:                        \
+#define DECLARE_TYPE_INFO(type)       \
+ public:                              \
+  static std::string name() {         \
+    return #type;                     \
+  }                                   \
+                                      \
+ protected:                           \
+  ~type() override;                   \
+                                      \
+ public:                              \
+  size_t TraceSize() const override { \
+    return sizeof(type);              \
+  }                                   \
   ::shaka::BackingObjectFactoryBase* factory() const override
 
 /**
@@ -69,6 +72,7 @@ class BackingObject : public memory::Traceable {
 
   void Trace(memory::HeapTracer* tracer) const override;
   bool IsRootedAlive() const override;
+  std::string TraceTypeName() const override;
 
   /** @return The name of the type. */
   std::string name() const;
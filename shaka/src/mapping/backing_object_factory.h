@@ -323,26 +323,37 @@ class BackingObjectFactoryBase {
   using get_this = typename std::conditional<std::is_same<Derived, void>::value,
                                              This, Derived>::type;
 
+  // These call the member function directly instead of through a
+  // std::function.  These are called for every property access from
+  // JavaScript, so this avoids the extra indirect call.
   template <typename Derived, typename Callback>
   struct MakeMemFnImpl;
   template <typename Derived, typename This, typename Ret, typename... Args>
   struct MakeMemFnImpl<Derived, Ret (This::*)(Args...)> {
     using ArgThis = get_this<Derived, This>;
-    using type = std::function<Ret(RefPtr<ArgThis>, Args...)>;
-    static type Make(Ret (This::*callback)(Args...)) {
-      return [=](RefPtr<ArgThis> that, Args... args) -> Ret {
+    struct type {
+      Ret operator()(RefPtr<ArgThis> that, Args... args) const {
         return ((that.get())->*(callback))(std::move(args)...);
-      };
+      }
+
+      Ret (This::*callback)(Args...);
+    };
+    static type Make(Ret (This::*callback)(Args...)) {
+      return type{callback};
     }
   };
   template <typename Derived, typename This, typename Ret, typename... Args>
   struct MakeMemFnImpl<Derived, Ret (This::*)(Args...) const> {
     using ArgThis = get_this<Derived, This>;
-    using type = std::function<Ret(RefPtr<ArgThis>, Args...)>;
-    static type Make(Ret (This::*callback)(Args...) const) {
-      return [=](RefPtr<ArgThis> that, Args... args) -> Ret {
+    struct type {
+      Ret operator()(RefPtr<ArgThis> that, Args... args) const {
         return ((that.get())->*(callback))(std::move(args)...);
-      };
+      }
+
+      Ret (This::*callback)(Args...) const;
+    };
+    static type Make(Ret (This::*callback)(Args...) const) {
+      return type{callback};
     }
   };
 
@@ -384,17 +395,33 @@ class BackingObjectFactoryRegistry
 
   /**
    * Returns the instance of the factory that will generate objects of type T.
-   * Instance() will CHECK for the value not being null.  There is a
+   * If the factory doesn't exist yet, this calls the lazy creator to create
+   * it.  Instance() will CHECK for the value not being null.  There is a
    * specialization below for T == void so this will still return null on that
    * case.
    */
   static BackingObjectFactoryBase* CheckedInstance() {
+    if (!BackingObjectFactoryRegistry::InstanceOrNull() && lazy_creator_)
+      lazy_creator_();
     return BackingObjectFactoryRegistry::Instance();
   }
 
+  /**
+   * Sets a function that creates the factory the first time it is needed, so
+   * the type can be installed lazily.  Pass nullptr to clear it.  This can only
+   * be used on the event thread.
+   */
+  static void SetLazyCreator(std::function<void()> creator) {
+    lazy_creator_ = std::move(creator);
+  }
+
  private:
   friend class PseudoSingleton<BackingObjectFactoryRegistry<T>>;
+
+  static std::function<void()> lazy_creator_;
 };
+template <typename T>
+std::function<void()> BackingObjectFactoryRegistry<T>::lazy_creator_;
 template <>
 inline BackingObjectFactoryBase*
 BackingObjectFactoryRegistry<void>::CheckedInstance() {
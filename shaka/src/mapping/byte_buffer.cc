@@ -14,8 +14,10 @@
 
 #include "src/mapping/byte_buffer.h"
 
+#include <algorithm>
 #include <utility>
 
+#include "src/mapping/js_engine.h"
 #include "src/memory/heap_tracer.h"
 
 namespace shaka {
@@ -29,6 +31,12 @@ uint8_t* GetDataPointer(v8::Local<v8::ArrayBuffer> buffer) {
 void FreeData(void* data, void*) {
   std::free(data);  // NOLINT
 }
+
+void FreeExternalData(void* /* data */, void* context) {
+  auto* on_free = reinterpret_cast<std::function<void()>*>(context);
+  (*on_free)();
+  delete on_free;
+}
 #endif
 }  // namespace
 
@@ -42,7 +50,9 @@ ByteBuffer::ByteBuffer(ByteBuffer&& other)
     : buffer_(std::move(other.buffer_)),
       ptr_(other.ptr_),
       size_(other.size_),
-      own_ptr_(other.own_ptr_) {
+      capacity_(other.capacity_),
+      own_ptr_(other.own_ptr_),
+      external_free_(std::move(other.external_free_)) {
   other.ClearFields();
 }
 
@@ -56,7 +66,9 @@ ByteBuffer& ByteBuffer::operator=(ByteBuffer&& other) {
   buffer_ = std::move(other.buffer_);
   ptr_ = other.ptr_;
   size_ = other.size_;
+  capacity_ = other.capacity_;
   own_ptr_ = other.own_ptr_;
+  external_free_ = std::move(other.external_free_);
 
   other.ClearFields();
   return *this;
@@ -66,6 +78,8 @@ ByteBuffer& ByteBuffer::operator=(ByteBuffer&& other) {
 void ByteBuffer::Clear() {
   if (own_ptr_)
     std::free(ptr_);  // NOLINT
+  if (external_free_)
+    external_free_();
   ClearFields();
 }
 
@@ -79,6 +93,57 @@ void ByteBuffer::SetFromBuffer(const void* buffer, size_t size) {
   std::memcpy(ptr_, buffer, size_);
 }
 
+void ByteBuffer::SetFromExternal(const uint8_t* buffer, size_t size,
+                                 std::function<void()> on_free) {
+  Clear();
+  if (size == 0) {
+    // The engines may not free empty buffers, so don't refer to the data.
+    on_free();
+    return;
+  }
+
+  ptr_ = const_cast<uint8_t*>(buffer);
+  size_ = size;
+  external_free_ = std::move(on_free);
+}
+
+void ByteBuffer::Reserve(size_t capacity) {
+  if (!own_ptr_) {
+    CHECK(buffer_.empty() && !ptr_) << "Cannot resize a JavaScript buffer";
+    ClearAndAllocateBuffer(0);
+  }
+  if (capacity <= capacity_)
+    return;
+
+  // Use realloc so the data stays compatible with the JavaScript allocator.
+  auto* ptr = reinterpret_cast<uint8_t*>(std::realloc(ptr_, capacity));  // NOLINT
+  CHECK(ptr);
+  ptr_ = ptr;
+  capacity_ = capacity;
+}
+
+void ByteBuffer::AppendCopy(const void* buffer, size_t size) {
+  if (size_ + size > capacity_) {
+    // Grow geometrically so appending many small chunks is amortized.
+    Reserve(std::max(size_ + size, capacity_ * 2));
+  } else if (!own_ptr_) {
+    Reserve(size);
+  }
+  std::memcpy(ptr_ + size_, buffer, size);
+  size_ += size;
+}
+
+void ByteBuffer::ShrinkToFit() {
+  if (!own_ptr_ || capacity_ == size_ || size_ == 0)
+    return;
+
+  // Shrinking is usually done in-place, so this won't copy the data.
+  auto* ptr = reinterpret_cast<uint8_t*>(std::realloc(ptr_, size_));  // NOLINT
+  CHECK(ptr);
+  ptr_ = ptr;
+  capacity_ = size_;
+}
+
 bool ByteBuffer::TryConvert(Handle<JsValue> value) {
 #if defined(USING_V8)
   if (value.IsEmpty())
@@ -117,18 +182,32 @@ bool ByteBuffer::TryConvert(Handle<JsValue> value) {
   buffer_ = object;
 #endif
   own_ptr_ = false;
+  capacity_ = 0;
   return true;
 }
 
 ReturnVal<JsValue> ByteBuffer::ToJsValue() const {
   if (buffer_.empty()) {
-    DCHECK(own_ptr_ || (!ptr_ && size_ == 0));
+    DCHECK(own_ptr_ || external_free_ || (!ptr_ && size_ == 0));
 #if defined(USING_V8)
+    // The ArrayBuffer takes ownership of the data either way; for external
+    // data, the engine will call |external_free_| instead of freeing it.
     buffer_ = v8::ArrayBuffer::New(GetIsolate(), ptr_, size_,
                                    v8::ArrayBufferCreationMode::kInternalized);
+    if (external_free_) {
+      JsEngine::Instance()->AddExternalBuffer(ptr_, std::move(external_free_));
+      external_free_ = nullptr;
+    }
 #elif defined(USING_JSC)
-    buffer_ = Handle<JsObject>(JSObjectMakeArrayBufferWithBytesNoCopy(
-        GetContext(), ptr_, size_, &FreeData, nullptr, nullptr));
+    if (external_free_) {
+      auto* on_free = new std::function<void()>(std::move(external_free_));
+      external_free_ = nullptr;
+      buffer_ = Handle<JsObject>(JSObjectMakeArrayBufferWithBytesNoCopy(
+          GetContext(), ptr_, size_, &FreeExternalData, on_free, nullptr));
+    } else {
+      buffer_ = Handle<JsObject>(JSObjectMakeArrayBufferWithBytesNoCopy(
+          GetContext(), ptr_, size_, &FreeData, nullptr, nullptr));
+    }
 #endif
     CHECK(!buffer_.empty());
     own_ptr_ = false;
@@ -245,7 +324,9 @@ void ByteBuffer::ClearFields() {
   buffer_.reset();
   ptr_ = nullptr;
   size_ = 0;
+  capacity_ = 0;
   own_ptr_ = false;
+  external_free_ = nullptr;
 }
 
 void ByteBuffer::ClearAndAllocateBuffer(size_t size) {
@@ -255,8 +336,9 @@ void ByteBuffer::ClearAndAllocateBuffer(size_t size) {
   // Must also be compatible with JSC (uses free()).
   own_ptr_ = true;
   size_ = size;
+  capacity_ = size;
   ptr_ = reinterpret_cast<uint8_t*>(std::malloc(size_));  // NOLINT
-  CHECK(ptr_);
+  CHECK(ptr_ || size_ == 0);
 }
 
 }  // namespace shaka
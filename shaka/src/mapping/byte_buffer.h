@@ -16,6 +16,7 @@
 #define SHAKA_EMBEDDED_MAPPING_BYTE_BUFFER_H_
 
 #include <cstring>
+#include <functional>
 #include <string>
 
 #include "src/mapping/generic_converter.h"
@@ -73,6 +74,33 @@ class ByteBuffer : public GenericConverter, public memory::Traceable {
   /** Similar to SetFromDynamicBuffer, except accepts a single buffer source. */
   void SetFromBuffer(const void* buffer, size_t size);
 
+  /**
+   * Clears the buffer and refers to the given data without copying it.  The
+   * data must stay valid until |on_free| is called, which happens once this
+   * object and any ArrayBuffer created for it are destroyed.  JavaScript can
+   * write to the ArrayBuffer, so this should only be used for data that
+   * JavaScript doesn't modify (e.g. media segments).
+   */
+  void SetFromExternal(const uint8_t* buffer, size_t size,
+                       std::function<void()> on_free);
+
+  /**
+   * Ensures the buffer can hold at least the given number of bytes without
+   * reallocating.  This can only be called on a buffer that this object owns
+   * (i.e. one that hasn't been passed to JavaScript yet).
+   */
+  void Reserve(size_t capacity);
+
+  /**
+   * Appends a copy of the given data to the end of the buffer.  This can be
+   * called from any thread, but only on a buffer that this object owns.  This
+   * allows building the buffer incrementally and then passing it into
+   * JavaScript without any more copies.
+   */
+  void AppendCopy(const void* buffer, size_t size);
+
+  /** Frees any unused capacity from calls to Reserve or AppendCopy. */
+  void ShrinkToFit();
 
   bool TryConvert(Handle<JsValue> value) override;
   ReturnVal<JsValue> ToJsValue() const override;
@@ -99,10 +127,15 @@ class ByteBuffer : public GenericConverter, public memory::Traceable {
   mutable WeakJsPtr<JsObject> buffer_;
   uint8_t* ptr_ = nullptr;
   size_t size_ = 0;
+  // The allocated size of |ptr_| when we own it.
+  size_t capacity_ = 0;
   // Whether we own |ptr_|, this may be slightly different from
   // |buffer_.empty()| since the ArrayBuffer may be destroyed before we
   // are during a GC run.
   mutable bool own_ptr_ = false;
+  // When using external data, this is called when the data is no longer used.
+  // This is moved to the ArrayBuffer when it is created.
+  mutable std::function<void()> external_free_;
 };
 
 inline bool operator==(const ByteBuffer& lhs, const ByteBuffer& rhs) {
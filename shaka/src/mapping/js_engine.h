@@ -17,15 +17,24 @@
 
 #include <glog/logging.h>
 
+#include <atomic>
 #include <functional>
 #include <memory>
+#include <mutex>
 #include <thread>
 #include <unordered_map>
+#include <vector>
 
+#include "shaka/js_manager.h"
 #include "src/core/rejected_promise_handler.h"
+#include "src/debug/duration_histogram.h"
 #include "src/mapping/js_wrappers.h"
 #include "src/util/pseudo_singleton.h"
 
+#if defined(USING_V8)
+#  include <v8-profiler.h>
+#endif
+
 namespace shaka {
 
 /**
@@ -38,14 +47,70 @@ namespace shaka {
 class JsEngine : public PseudoSingleton<JsEngine> {
  public:
   JsEngine();
+  explicit JsEngine(const JsManager::HeapOptions& heap_options);
   ~JsEngine();
 
   Handle<JsObject> global_handle();
   ReturnVal<JsValue> global_value();
 
+  /**
+   * Asks the engine to free as much memory as it can.  This should be called
+   * when the device is low on memory.
+   */
+  void OnLowMemory();
+
+  /**
+   * Called when the JavaScript thread is idle and expects to stay idle for
+   * the given time.  This does garbage collection work that would otherwise
+   * pause a task that runs JavaScript.
+   *
+   * @param idle_ms The time, in milliseconds, this can use.
+   * @return Whether there is more idle work to do.
+   */
+  bool OnIdle(uint64_t idle_ms);
+
+  /**
+   * @return The current heap statistics; |native_object_count| isn't set
+   *   since that is tracked by ObjectTracker.
+   */
+  JsManager::JsHeapStats GetHeapStats() const;
+
+  /**
+   * Starts the engine's sampling profiler.
+   * @return False if the engine doesn't support profiling or it is already
+   *   running.
+   */
+  bool StartCpuProfiling(uint32_t sample_interval_us);
+
+  /**
+   * Stops the profiler and fills in the given profile.  The times use the
+   * DurationHistogram::Now clock and the nodes are sorted so parents come
+   * before their children.
+   *
+   * @return False if the profiler wasn't running.
+   */
+  bool StopCpuProfiling(JsManager::CpuProfile* profile);
+
+  /**
+   * @return The JavaScript string for the given property name.  This is
+   *   created the first time it is used and reused after that.
+   */
+  ReturnVal<JsString> GetPropertyName(const PropertyName& name);
+
 #if defined(USING_V8)
+  /**
+   * @return The current time, in milliseconds, using the clock V8 uses for GC
+   *   deadlines.
+   */
+  static double MonotonicTimeMs();
+
   void OnPromiseReject(v8::PromiseRejectMessage message);
   void AddDestructor(void* object, std::function<void(void*)> destruct);
+  /**
+   * Registers an ArrayBuffer's data that isn't owned by V8.  When V8 frees the
+   * ArrayBuffer, this calls |on_free| instead of freeing the data.
+   */
+  void AddExternalBuffer(void* data, std::function<void()> on_free);
   v8::Isolate* isolate() const {
     // Verify this thread can use the isolate.
     DCHECK(isolate_);
@@ -70,7 +135,16 @@ class JsEngine : public PseudoSingleton<JsEngine> {
   };
 
  private:
+  // These are first since the engine can collect garbage while it is created.
+  DurationHistogram gc_pauses_;
+  std::atomic<uint64_t> idle_gc_count_;
+
 #if defined(USING_V8)
+  static void OnGcPrologue(v8::Isolate* isolate, v8::GCType type,
+                           v8::GCCallbackFlags flags, void* data);
+  static void OnGcEpilogue(v8::Isolate* isolate, v8::GCType type,
+                           v8::GCCallbackFlags flags, void* data);
+
   class ArrayBufferAllocator : public v8::ArrayBuffer::Allocator {
    public:
     void* Allocate(size_t length) override;
@@ -78,16 +152,35 @@ class JsEngine : public PseudoSingleton<JsEngine> {
     void Free(void* data, size_t) override;
   };
 
-  v8::Isolate* CreateIsolate();
+  v8::Isolate* CreateIsolate(const JsManager::HeapOptions& heap_options);
   v8::Global<v8::Context> CreateContext();
 
   ArrayBufferAllocator allocator_;
   std::unordered_map<void*, std::function<void(void*)>> destructors_;
+  // V8 may free ArrayBuffers on a background thread, so this is locked.  The
+  // same data can be used by more than one ArrayBuffer.
+  std::mutex external_mutex_;
+  std::unordered_multimap<void*, std::function<void()>> external_buffers_;
   v8::Isolate* isolate_;
   v8::Global<v8::Context> context_;
+  // The internalized PropertyName strings, indexed by their id.
+  std::vector<v8::Eternal<v8::String>> property_names_;
+  // When the current GC pause started, in microseconds.
+  uint64_t gc_start_us_;
+  // Set while the CPU profiler is running.
+  v8::CpuProfiler* cpu_profiler_;
+  // When the CPU profiler started, using DurationHistogram::Now.
+  uint64_t profile_start_us_;
 #elif defined(USING_JSC)
+  /** Frees the native objects JavaScript no longer uses, then runs JSC's GC. */
+  void CollectGarbage();
+
   JSGlobalContextRef context_;
   std::thread::id thread_id_;
+  // When CollectGarbage last ran, in monotonic milliseconds.
+  uint64_t last_gc_ms_;
+  // The PropertyName strings, indexed by their id.
+  std::vector<util::CFRef<JSStringRef>> property_names_;
 #endif
 
   RejectedPromiseHandler promise_handler_;
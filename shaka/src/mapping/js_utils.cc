@@ -14,6 +14,7 @@
 
 #include "src/mapping/js_utils.h"
 
+#include <atomic>
 #include <memory>
 
 #include "src/core/js_manager_impl.h"
@@ -47,8 +48,20 @@ js::JsError MakeError(const Error& error) {
   return js::JsError::Rethrow(results);
 }
 
+/** Used to give each PropertyName its slot in the JsEngine. */
+std::atomic<size_t> g_next_property_name_id{0};
+
 }  // namespace
 
+PropertyName::PropertyName(const char* name)
+    : name_(name), id_(g_next_property_name_id.fetch_add(1)) {}
+
+PropertyName::~PropertyName() {}
+
+ReturnVal<JsString> PropertyName::handle() const {
+  return JsEngine::Instance()->GetPropertyName(*this);
+}
+
 ReturnVal<JsValue> GetDescendant(Handle<JsObject> root,
                                  const std::vector<std::string>& names) {
   if (names.empty())
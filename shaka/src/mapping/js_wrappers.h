@@ -20,6 +20,7 @@
 #include <string>
 #include <vector>
 
+#include "src/util/file_system.h"
 #include "src/util/macros.h"
 // Use the IndexedDB protobuf for ValueType so we don't have to duplicate
 // the enum here and for IndexedDB storage.
@@ -214,6 +215,34 @@ inline size_t ArgumentCount(const CallbackArguments& arguments) {
 #endif
 }
 
+/**
+ * A property name that is converted to a JavaScript string once per JsEngine
+ * and reused, instead of being converted from UTF-8 on every access.  Since
+ * each one reserves a slot in the JsEngine, these should only be static
+ * objects (e.g. in the code generated for IDL dictionaries).
+ */
+class PropertyName final {
+ public:
+  explicit PropertyName(const char* name);
+  ~PropertyName();
+
+  SHAKA_NON_COPYABLE_OR_MOVABLE_TYPE(PropertyName);
+
+  const char* name() const {
+    return name_;
+  }
+  size_t id() const {
+    return id_;
+  }
+
+  /** @return The JavaScript string for this name in the current JsEngine. */
+  ReturnVal<JsString> handle() const;
+
+ private:
+  const char* const name_;
+  const size_t id_;
+};
+
 /**
  * Get the properties of the current object. This will only return the
  * properties on 'this' and not on the prototype.
@@ -228,6 +257,11 @@ ReturnVal<JsValue> GetMemberRaw(Handle<JsObject> object,
                                 const std::string& name,
                                 LocalVar<JsValue>* exception = nullptr);
 
+/** @return The given member of the given object. */
+ReturnVal<JsValue> GetMemberRaw(Handle<JsObject> object,
+                                const PropertyName& name,
+                                LocalVar<JsValue>* exception = nullptr);
+
 /** @return The member at the given index of the given object. */
 ReturnVal<JsValue> GetArrayIndexRaw(Handle<JsObject> object, size_t index,
                                     LocalVar<JsValue>* exception = nullptr);
@@ -236,10 +270,20 @@ ReturnVal<JsValue> GetArrayIndexRaw(Handle<JsObject> object, size_t index,
 void SetMemberRaw(Handle<JsObject> object, const std::string& name,
                   Handle<JsValue> value);
 
+/** Sets the given member on the given object. */
+void SetMemberRaw(Handle<JsObject> object, const PropertyName& name,
+                  Handle<JsValue> value);
+
 /** Sets the member at the given index of the given object. */
 void SetArrayIndexRaw(Handle<JsObject> object, size_t i, Handle<JsValue> value);
 
-/** Adds a generic property on the given object. */
+/** Deletes the given member from the given object. */
+void DeleteMemberRaw(Handle<JsObject> object, const std::string& name);
+
+/**
+ * Adds a generic property on the given object.  The property is configurable,
+ * so it can be deleted or redefined later.
+ */
 void SetGenericPropertyRaw(Handle<JsObject> object, const std::string& name,
                            Handle<JsFunction> getter,
                            Handle<JsFunction> setter);
@@ -318,6 +362,59 @@ bool RunScript(const std::string& path);
  */
 bool RunScript(const std::string& path, const uint8_t* data, size_t data_size);
 
+/**
+ * A script and the code cache to run it with, read from disk.  Reading these
+ * doesn't use the JavaScript engine, so it can be done on a background thread
+ * while the engine starts.
+ */
+struct ScriptFiles {
+  ScriptFiles();
+  ScriptFiles(ScriptFiles&&);
+  ~ScriptFiles();
+
+  ScriptFiles& operator=(ScriptFiles&&);
+
+  SHAKA_NON_COPYABLE_TYPE(ScriptFiles);
+
+  /** The path to the JavaScript file. */
+  std::string path;
+  /** The path to store a new code cache in. */
+  std::string cache_path;
+  /** The contents of the JavaScript file. */
+  util::MappedFile source;
+  /** The hash of |source|, which a code cache file starts with. */
+  std::vector<uint8_t> hash;
+  /**
+   * The contents of the code cache file to use, including the hash; this is
+   * empty if there isn't a cache for this script.
+   */
+  std::vector<uint8_t> cache;
+};
+
+/**
+ * Reads a JavaScript file and its code cache.  This uses the code cache from
+ * the given file if it was made for this script; otherwise this uses the
+ * prebuilt cache, which lets the first launch skip parsing too.  This can be
+ * called on any thread.  If the engine doesn't support code caching, this
+ * only reads the script.
+ *
+ * @param path The file path to the JavaScript file.
+ * @param cache_path The file path to store the code cache in.
+ * @param prebuilt_cache_path The file path of a read-only code cache that is
+ *   shipped with the script, or empty for none.
+ */
+ScriptFiles ReadScriptFiles(const std::string& path,
+                            const std::string& cache_path,
+                            const std::string& prebuilt_cache_path);
+
+/**
+ * Executes the given script in the current isolate using its code cache, so
+ * the script doesn't need to be parsed again.  If there was no cache or the
+ * engine rejects it, this compiles the script from source and writes a new
+ * cache for the next launch.
+ */
+bool RunScriptWithCodeCache(ScriptFiles files);
+
 /**
  * Parses the given string as JSON and returns the given value.
  * @param json The input string.
@@ -420,8 +517,9 @@ inline size_t ArrayLength(Handle<JsObject> value) {
   DCHECK(GetValueType(value) == proto::ValueType::Array);
   return value.As<v8::Array>()->Length();
 #elif defined(USING_JSC)
+  static const PropertyName kLength("length");
   auto* ctx = GetContext();
-  LocalVar<JsValue> length(GetMemberRaw(value, "length"));
+  LocalVar<JsValue> length(GetMemberRaw(value, kLength));
   CHECK(length && JSValueIsNumber(ctx, length));
   return static_cast<size_t>(JSValueToNumber(ctx, length, nullptr));
 #endif
@@ -15,33 +15,37 @@
 #include "src/mapping/js_engine.h"
 
 #include "src/core/js_manager_impl.h"
+#include "src/debug/telemetry.h"
 #include "src/memory/heap_tracer.h"
 #include "src/memory/object_tracker.h"
+#include "src/util/clock.h"
 
 namespace shaka {
 
 namespace {
 constexpr const uint64_t kGcIntervalMs = 30 * 1000;
+/**
+ * The minimum time between collections when the thread is idle.  This is
+ * shorter than the timer interval since the idle ones don't delay any task.
+ */
+constexpr const uint64_t kIdleGcIntervalMs = 5 * 1000;
 }  // namespace
 
 // \cond Doxygen_Skip
 
-JsEngine::JsEngine()
-    : context_(JSGlobalContextCreate(nullptr)),
-      thread_id_(std::this_thread::get_id()) {
+JsEngine::JsEngine() : JsEngine(JsManager::HeapOptions()) {}
+
+JsEngine::JsEngine(const JsManager::HeapOptions& /* heap_options */)
+    : idle_gc_count_(0),
+      context_(JSGlobalContextCreate(nullptr)),
+      thread_id_(std::this_thread::get_id()),
+      last_gc_ms_(util::Clock::Instance.GetMonotonicTime()) {
   auto task = []() {
-    VLOG(1) << "Begin GC run";
-    auto* object_tracker = memory::ObjectTracker::Instance();
-    auto* heap_tracer = JsManagerImpl::Instance()->HeapTracer();
-    heap_tracer->BeginPass();
-    heap_tracer->TraceAll(object_tracker->GetAliveObjects());
-    object_tracker->FreeDeadObjects(heap_tracer->alive());
-
-    // This will signal to JSC that we have just destroyed a lot of objects.
-    // See http://bugs.webkit.org/show_bug.cgi?id=84476
-    JSGarbageCollect(GetContext());
-
-    VLOG(1) << "End GC run";
+    // Skip this if it already ran while the thread was idle.
+    JsEngine* engine = JsEngine::Instance();
+    const uint64_t now = util::Clock::Instance.GetMonotonicTime();
+    if (now - engine->last_gc_ms_ >= kGcIntervalMs)
+      engine->CollectGarbage();
   };
 
   // If the engine was created as part of a test, then don't create the timer
@@ -55,6 +59,15 @@ JsEngine::~JsEngine() {
   JSGlobalContextRelease(context_);
 }
 
+ReturnVal<JsString> JsEngine::GetPropertyName(const PropertyName& name) {
+  if (property_names_.size() <= name.id())
+    property_names_.resize(name.id() + 1);
+  util::CFRef<JSStringRef>& slot = property_names_[name.id()];
+  if (!slot)
+    slot = JSStringCreateWithUTF8CString(name.name());
+  return slot;
+}
+
 Handle<JsObject> JsEngine::global_handle() {
   return JSContextGetGlobalObject(context());
 }
@@ -63,6 +76,39 @@ ReturnVal<JsValue> JsEngine::global_value() {
   return JSContextGetGlobalObject(context());
 }
 
+void JsEngine::OnLowMemory() {
+  JSGarbageCollect(context());
+}
+
+bool JsEngine::OnIdle(uint64_t /* idle_ms */) {
+  // The tracing pass can't be split up, so there is never more work to do.
+  if (!JsManagerImpl::InstanceOrNull() ||
+      util::Clock::Instance.GetMonotonicTime() - last_gc_ms_ <
+          kIdleGcIntervalMs) {
+    return false;
+  }
+  idle_gc_count_.fetch_add(1, std::memory_order_relaxed);
+  CollectGarbage();
+  return false;
+}
+
+JsManager::JsHeapStats JsEngine::GetHeapStats() const {
+  // JSC doesn't expose the size of the heap.
+  JsManager::JsHeapStats ret;
+  ret.gc_pauses = Telemetry::Summarize(gc_pauses_);
+  ret.idle_gc_count = idle_gc_count_.load(std::memory_order_relaxed);
+  return ret;
+}
+
+bool JsEngine::StartCpuProfiling(uint32_t /* sample_interval_us */) {
+  // JSC's sampling profiler is only available through its private C++ API.
+  return false;
+}
+
+bool JsEngine::StopCpuProfiling(JsManager::CpuProfile* /* profile */) {
+  return false;
+}
+
 JSContextRef JsEngine::context() const {
   // TODO: Consider asserting we are on the correct thread.  Unlike other
   // JavaScript engines, JSC allows access from any thread and will just
@@ -71,6 +117,24 @@ JSContextRef JsEngine::context() const {
   return context_;
 }
 
+void JsEngine::CollectGarbage() {
+  VLOG(1) << "Begin GC run";
+  const uint64_t start_us = DurationHistogram::Now();
+  auto* object_tracker = memory::ObjectTracker::Instance();
+  auto* heap_tracer = JsManagerImpl::Instance()->HeapTracer();
+  heap_tracer->BeginPass();
+  heap_tracer->TraceAll(object_tracker->GetAliveObjects());
+  object_tracker->FreeDeadObjects(heap_tracer->alive());
+
+  // This will signal to JSC that we have just destroyed a lot of objects.
+  // See http://bugs.webkit.org/show_bug.cgi?id=84476
+  JSGarbageCollect(context());
+
+  gc_pauses_.Add(DurationHistogram::Now() - start_us);
+  last_gc_ms_ = util::Clock::Instance.GetMonotonicTime();
+  VLOG(1) << "End GC run";
+}
+
 JsEngine::SetupContext::SetupContext() {}
 JsEngine::SetupContext::~SetupContext() {}
 
@@ -127,6 +127,18 @@ ReturnVal<JsValue> GetMemberRaw(Handle<JsObject> object,
   return ret;
 }
 
+ReturnVal<JsValue> GetMemberRaw(Handle<JsObject> object,
+                                const PropertyName& name,
+                                LocalVar<JsValue>* exception) {
+  JSValueRef raw_except = nullptr;
+  auto* ret =
+      JSObjectGetProperty(GetContext(), object, name.handle(), &raw_except);
+  if (exception) {
+    *exception = raw_except;
+  }
+  return ret;
+}
+
 ReturnVal<JsValue> GetArrayIndexRaw(Handle<JsObject> object, size_t index,
                                     LocalVar<JsValue>* exception) {
   JSValueRef raw_except = nullptr;
@@ -144,17 +156,29 @@ void SetMemberRaw(Handle<JsObject> object, const std::string& name,
                       kJSPropertyAttributeNone, nullptr);
 }
 
+void SetMemberRaw(Handle<JsObject> object, const PropertyName& name,
+                  Handle<JsValue> value) {
+  JSObjectSetProperty(GetContext(), object, name.handle(), value,
+                      kJSPropertyAttributeNone, nullptr);
+}
+
 void SetArrayIndexRaw(Handle<JsObject> object, size_t i,
                       Handle<JsValue> value) {
   JSObjectSetPropertyAtIndex(GetContext(), object, i, value, nullptr);
 }
 
+void DeleteMemberRaw(Handle<JsObject> object, const std::string& name) {
+  CHECK(JSObjectDeleteProperty(GetContext(), object, JsStringFromUtf8(name),
+                               nullptr));
+}
+
 void SetGenericPropertyRaw(Handle<JsObject> object, const std::string& name,
                            Handle<JsFunction> getter,
                            Handle<JsFunction> setter) {
   // TODO: Find a better way to do this.
   // This works by effectively running the following JavaScript:
-  //   Object.defineProperty($object, $name, {get: $getter, set: $setter});
+  //   Object.defineProperty($object, $name,
+  //                         {get: $getter, set: $setter, configurable: true});
   LocalVar<JsValue> js_Object =
       GetMemberRaw(JSContextGetGlobalObject(GetContext()), "Object");
   CHECK(js_Object && IsObject(js_Object));
@@ -166,6 +190,8 @@ void SetGenericPropertyRaw(Handle<JsObject> object, const std::string& name,
   SetMemberRaw(props, "get", getter);
   if (setter)
     SetMemberRaw(props, "set", setter);
+  // V8 accessors are configurable, so match that.
+  SetMemberRaw(props, "configurable", ToJsValue(true));
 
   LocalVar<JsValue> args[] = {object, ToJsValue(name), props};
   LocalVar<JsValue> except;
@@ -240,12 +266,38 @@ bool IsDerivedFrom(BackingObject* ptr, const std::string& name) {
 }
 
 bool RunScript(const std::string& path) {
+  // JavaScriptCore copies the source into its own string, but mapping the file
+  // avoids another copy.
   util::FileSystem fs;
-  std::vector<uint8_t> code;
-  CHECK(fs.ReadFile(path, &code));
+  util::MappedFile code;
+  CHECK(fs.MapFile(path, &code));
   return RunScript(path, code.data(), code.size());
 }
 
+ScriptFiles::ScriptFiles() {}
+ScriptFiles::ScriptFiles(ScriptFiles&&) = default;
+ScriptFiles::~ScriptFiles() {}
+
+ScriptFiles& ScriptFiles::operator=(ScriptFiles&&) = default;
+
+ScriptFiles ReadScriptFiles(const std::string& path,
+                            const std::string& cache_path,
+                            const std::string& /* prebuilt_cache_path */) {
+  // The C API of JavaScriptCore doesn't expose bytecode caching; JSC caches
+  // bytecode internally for the life of the process.  So this only needs the
+  // script.
+  ScriptFiles ret;
+  ret.path = path;
+  ret.cache_path = cache_path;
+  util::FileSystem fs;
+  CHECK(fs.MapFile(path, &ret.source));
+  return ret;
+}
+
+bool RunScriptWithCodeCache(ScriptFiles files) {
+  return RunScript(files.path, files.source.data(), files.source.size());
+}
+
 bool RunScript(const std::string& path, const uint8_t* data, size_t size) {
   LocalVar<JsString> code = JsStringFromUtf8(data, size);
   LocalVar<JsString> source = JsStringFromUtf8(path);
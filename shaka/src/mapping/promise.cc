@@ -40,8 +40,9 @@ Handle<JSObjectRef> NewPromise(WeakJsPtr<JsObject>* resolve,
     *reject = UnsafeJsCast<JsObject>(on_reject.ToJsValue());
   };
 
+  static const PropertyName kPromise("Promise");
   JSValueRef ctor =
-      GetMemberRaw(JSContextGetGlobalObject(GetContext()), "Promise");
+      GetMemberRaw(JSContextGetGlobalObject(GetContext()), kPromise);
   DCHECK_EQ(GetValueType(ctor), proto::ValueType::Function);
   LocalVar<JsFunction> ctor_obj = UnsafeJsCast<JsFunction>(ctor);
 
@@ -139,7 +140,8 @@ void Promise::RejectWith(const js::JsError& error, bool run_events) {
 void Promise::Then(std::function<void(Any)> on_resolve,
                    std::function<void(Any)> on_reject) {
   // Note this will get from the prototype chain too.
-  LocalVar<JsValue> member_val = GetMemberRaw(promise_.handle(), "then");
+  static const PropertyName kThen("then");
+  LocalVar<JsValue> member_val = GetMemberRaw(promise_.handle(), kThen);
   LocalVar<JsFunction> member = UnsafeJsCast<JsFunction>(member_val);
 
   LocalVar<JsValue> except;
@@ -316,7 +316,11 @@ struct InternalCallbackData : InternalCallbackDataBase {
   bool is_member_func;
 };
 
-constexpr const char* kHiddenPropertyName = "$__shaka_extra_data";
+/** @return The name of the property that holds a function's callback data. */
+inline const PropertyName& HiddenPropertyName() {
+  static const PropertyName name("$__shaka_extra_data");
+  return name;
+}
 
 #if defined(USING_JSC)
 
@@ -400,7 +404,7 @@ T* GetInternalData(const Info& arguments) {
 #elif defined(USING_JSC)
 template <typename T>
 T* GetInternalData(const CallbackArguments& arguments) {
-  JSValueRef data = GetMemberRaw(arguments.callee(), kHiddenPropertyName);
+  JSValueRef data = GetMemberRaw(arguments.callee(), HiddenPropertyName());
   void* ptr = IsObject(data) ? JSObjectGetPrivate(UnsafeJsCast<JsObject>(data))
                              : nullptr;
   if (!ptr) {
@@ -596,8 +600,8 @@ ReturnVal<JsFunction> CreateJsFunctionFromCallback(const std::string& target,
   const int attributes = kJSPropertyAttributeReadOnly |
                          kJSPropertyAttributeDontEnum |
                          kJSPropertyAttributeDontDelete;
-  JSObjectSetProperty(cx, ret, JsStringFromUtf8(impl::kHiddenPropertyName),
-                      js_value, attributes, nullptr);
+  JSObjectSetProperty(cx, ret, impl::HiddenPropertyName().handle(), js_value,
+                      attributes, nullptr);
   return ret;
 #endif
 }
@@ -34,8 +34,15 @@ namespace shaka {
 // type name to the macro |&THIS_TYPE::member|.
 #define THIS_TYPE std::decay<decltype(*this)>::type
 
+// The lambda gives each field its own static PropertyName, so the JavaScript
+// string for the name is only created once.
 #define ADD_NAMED_DICT_FIELD(member, name, ...) \
-  __VA_ARGS__ member = CreateFieldConverter(name, &THIS_TYPE::member)
+  __VA_ARGS__ member = CreateFieldConverter(    \
+      []() -> const PropertyName& {             \
+        static const PropertyName kName(name);  \
+        return kName;                           \
+      }(),                                      \
+      &THIS_TYPE::member)
 #define ADD_DICT_FIELD(member, ...) \
     ADD_NAMED_DICT_FIELD(member, #member, __VA_ARGS__)
 
@@ -108,20 +115,20 @@ class FieldConverterBase {
 template <typename Parent, typename Field>
 class FieldConverter : public FieldConverterBase {
  public:
-  FieldConverter(const std::string& name, Field Parent::*member)
+  FieldConverter(const PropertyName* name, Field Parent::*member)
       : name_(name), member_(member) {}
 
 
   void SearchAndStore(Struct* dict, Handle<JsObject> object) override {
     auto parent = static_cast<Parent*>(dict);
-    LocalVar<JsValue> member(GetMemberRaw(object, name_));
+    LocalVar<JsValue> member(GetMemberRaw(object, *name_));
     (void)FromJsValue(member, &(parent->*member_));
   }
 
   void AddToObject(const Struct* dict, Handle<JsObject> object) const override {
     auto parent = static_cast<const Parent*>(dict);
     LocalVar<JsValue> value(ToJsValue(parent->*member_));
-    SetMemberRaw(object, name_, value);
+    SetMemberRaw(object, *name_, value);
   }
 
   void Trace(const Struct* dict, memory::HeapTracer* tracer) const override {
@@ -130,7 +137,7 @@ class FieldConverter : public FieldConverterBase {
   }
 
  private:
-  std::string name_;
+  const PropertyName* name_;
   // Store as a pointer to member so if we are copied, we don't need to update
   // the pointers (or make the type non-copyable).
   Field Parent::*member_;
@@ -162,6 +169,10 @@ class FieldConverter : public FieldConverterBase {
  * return that if this came from JavaScript; otherwise this creates a new
  * JavaScript object to return.  Any fields that are changed in C++ will be
  * updated when returned back to JavaScript.
+ *
+ * The dictionaries generated from IDL (see exposed_type_generator.py) don't use
+ * ADD_DICT_FIELD; they override TryConvert, ToJsValue, and Trace with code
+ * for each field that uses static PropertyName objects.
  */
 class Struct : public GenericConverter, public memory::Traceable {
  public:
@@ -181,10 +192,10 @@ class Struct : public GenericConverter, public memory::Traceable {
 
  protected:
   template <typename Parent, typename Field>
-  Field CreateFieldConverter(const std::string& name, Field Parent::*field) {
+  Field CreateFieldConverter(const PropertyName& name, Field Parent::*field) {
     static_assert(std::is_base_of<Struct, Parent>::value,
                   "Must be derived from Struct");
-    auto convert = new impl::FieldConverter<Parent, Field>(name, field);
+    auto convert = new impl::FieldConverter<Parent, Field>(&name, field);
     converters_.emplace_back(convert);
     return Field();
   }
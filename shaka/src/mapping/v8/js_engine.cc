@@ -19,7 +19,15 @@
 
 #include <libplatform/libplatform.h>
 
+#include <algorithm>
 #include <cstring>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include "src/core/wasm_module_cache.h"
+#include "src/debug/telemetry.h"
+#include "src/mapping/byte_buffer.h"
 
 namespace shaka {
 
@@ -34,8 +42,261 @@ void OnPromiseReject(v8::PromiseRejectMessage message) {
   JsEngine::Instance()->OnPromiseReject(message);
 }
 
+v8::Platform* platform = nullptr;
+
+/** The size of the chunks that WebAssembly bytes are given to V8 in. */
+constexpr const size_t kWasmChunkSize = 64 * 1024;
+
+/** The indices of the original WebAssembly functions in the wrappers' data. */
+enum WasmOriginal : uint32_t {
+  kCompileStreaming = 0,
+  kInstantiate = 1,
+};
+
+/**
+ * Stores a module once V8 has finished compiling it, so later launches can
+ * load the compiled code instead.  V8 only calls this for modules that weren't
+ * loaded from the cache.
+ */
+class WasmCacheClient : public v8::WasmStreaming::Client {
+ public:
+  WasmCacheClient(const std::string& key, uint64_t start_us)
+      : key_(key), start_us_(start_us) {}
+
+  void OnModuleCompiled(v8::CompiledWasmModule compiled_module) override {
+    WasmModuleCache::Instance.AddCompileTime(
+        DurationHistogram::Now() - start_us_, /* from_cache= */ false);
+    v8::OwnedBuffer serialized = compiled_module.Serialize();
+    if (serialized.size > 0) {
+      WasmModuleCache::Instance.Write(key_, serialized.buffer.get(),
+                                      serialized.size);
+    }
+  }
+
+ private:
+  const std::string key_;
+  const uint64_t start_us_;
+};
+
+/**
+ * Called by WebAssembly.compileStreaming and instantiateStreaming once the
+ * source has resolved.  The source can be an ArrayBuffer or a view on one.
+ * This loads the compiled module from the cache if it is there; otherwise the
+ * bytes are compiled while they are given to V8 and the result is cached.
+ */
+void OnWasmStreaming(const v8::FunctionCallbackInfo<v8::Value>& info) {
+  v8::Isolate* isolate = info.GetIsolate();
+  std::shared_ptr<v8::WasmStreaming> streaming =
+      v8::WasmStreaming::Unpack(isolate, info.Data());
+
+  ByteBuffer source;
+  if (!source.TryConvert(info[0])) {
+    streaming->Abort(v8::Exception::TypeError(
+        v8::String::NewFromUtf8(
+            isolate,
+            "WebAssembly source must be an ArrayBuffer or ArrayBufferView",
+            v8::NewStringType::kNormal)
+            .ToLocalChecked()));
+    return;
+  }
+
+  const uint64_t start_us = DurationHistogram::Now();
+  const std::string key =
+      WasmModuleCache::MakeKey(source.data(), source.size());
+  // V8 only keeps a pointer to the compiled bytes, so they need to live until
+  // Finish returns.
+  std::vector<uint8_t> compiled;
+  bool from_cache = false;
+  if (WasmModuleCache::Instance.Read(key, &compiled)) {
+    from_cache =
+        streaming->SetCompiledModuleBytes(compiled.data(), compiled.size());
+    if (!from_cache) {
+      VLOG(1) << "Compiled WebAssembly module rejected";
+      WasmModuleCache::Instance.Remove(key);
+    }
+  }
+  if (!from_cache)
+    streaming->SetClient(std::make_shared<WasmCacheClient>(key, start_us));
+
+  for (size_t offset = 0; offset < source.size(); offset += kWasmChunkSize) {
+    streaming->OnBytesReceived(
+        source.data() + offset,
+        std::min(kWasmChunkSize, source.size() - offset));
+  }
+  streaming->Finish();
+
+  // The compiled module is loaded while finishing; compiling from the bytes
+  // continues in the background and is recorded by WasmCacheClient.
+  if (from_cache) {
+    WasmModuleCache::Instance.AddCompileTime(
+        DurationHistogram::Now() - start_us, /* from_cache= */ true);
+  }
+}
+
+v8::Local<v8::String> MakeName(v8::Isolate* isolate, const char* name) {
+  return v8::String::NewFromUtf8(isolate, name,
+                                 v8::NewStringType::kInternalized)
+      .ToLocalChecked();
+}
+
+v8::Local<v8::Function> GetWasmOriginal(v8::Local<v8::Value> data,
+                                        WasmOriginal index) {
+  v8::Isolate* isolate = v8::Isolate::GetCurrent();
+  return data.As<v8::Array>()
+      ->Get(isolate->GetCurrentContext(), index)
+      .ToLocalChecked()
+      .As<v8::Function>();
+}
+
+/**
+ * Calls the original WebAssembly.instantiate with a compiled module and
+ * records how long it took.  V8 instantiates the module before this returns,
+ * only the promise is resolved later.
+ */
+v8::MaybeLocal<v8::Value> InstantiateModule(v8::Local<v8::Value> data,
+                                            v8::Local<v8::Value> module,
+                                            v8::Local<v8::Value> imports) {
+  v8::Isolate* isolate = v8::Isolate::GetCurrent();
+  v8::Local<v8::Value> args[] = {module, imports};
+  const uint64_t start_us = DurationHistogram::Now();
+  v8::MaybeLocal<v8::Value> ret =
+      GetWasmOriginal(data, kInstantiate)
+          ->Call(isolate->GetCurrentContext(), v8::Undefined(isolate), 2, args);
+  WasmModuleCache::Instance.AddInstantiateTime(DurationHistogram::Now() -
+                                               start_us);
+  return ret;
+}
+
+/** Resolves instantiate's promise with the module and its instance. */
+void OnWasmInstantiated(const v8::FunctionCallbackInfo<v8::Value>& info) {
+  v8::Isolate* isolate = info.GetIsolate();
+  v8::Local<v8::Context> context = isolate->GetCurrentContext();
+  v8::Local<v8::Object> ret = v8::Object::New(isolate);
+  if (ret->Set(context, MakeName(isolate, "module"), info.Data()).IsJust() &&
+      ret->Set(context, MakeName(isolate, "instance"), info[0]).IsJust()) {
+    info.GetReturnValue().Set(ret);
+  }
+}
+
+/** Instantiates a module once it has been compiled from its bytes. */
+void OnWasmCompiled(const v8::FunctionCallbackInfo<v8::Value>& info) {
+  v8::Isolate* isolate = info.GetIsolate();
+  v8::Local<v8::Context> context = isolate->GetCurrentContext();
+  v8::Local<v8::Array> data = info.Data().As<v8::Array>();
+  v8::Local<v8::Value> originals = data->Get(context, 0).ToLocalChecked();
+  v8::Local<v8::Value> imports = data->Get(context, 1).ToLocalChecked();
+
+  v8::Local<v8::Value> instance;
+  v8::Local<v8::Function> on_instantiated;
+  if (InstantiateModule(originals, info[0], imports).ToLocal(&instance) &&
+      v8::Function::New(context, &OnWasmInstantiated, info[0])
+          .ToLocal(&on_instantiated)) {
+    v8::Local<v8::Promise> ret;
+    v8::Local<v8::Promise> promise = instance.As<v8::Promise>();
+    if (promise->Then(context, on_instantiated).ToLocal(&ret))
+      info.GetReturnValue().Set(ret);
+  }
+}
+
+/**
+ * Compiles the given source using compileStreaming, so it uses the module
+ * cache, then instantiates it.  The returned promise resolves with an object
+ * holding the module and the instance, like WebAssembly.instantiate.
+ */
+void CompileAndInstantiate(const v8::FunctionCallbackInfo<v8::Value>& info) {
+  v8::Isolate* isolate = info.GetIsolate();
+  v8::Local<v8::Context> context = isolate->GetCurrentContext();
+  v8::Local<v8::Value> args[] = {info[0]};
+  v8::Local<v8::Value> compiled;
+  if (!GetWasmOriginal(info.Data(), kCompileStreaming)
+           ->Call(context, info.This(), 1, args)
+           .ToLocal(&compiled)) {
+    return;
+  }
+
+  v8::Local<v8::Array> data = v8::Array::New(isolate, 2);
+  v8::Local<v8::Function> on_compiled;
+  v8::Local<v8::Promise> ret;
+  if (data->Set(context, 0, info.Data()).IsJust() &&
+      data->Set(context, 1, info[1]).IsJust() &&
+      v8::Function::New(context, &OnWasmCompiled, data).ToLocal(&on_compiled) &&
+      compiled.As<v8::Promise>()->Then(context, on_compiled).ToLocal(&ret)) {
+    info.GetReturnValue().Set(ret);
+  }
+}
+
+/** Replaces WebAssembly.compile so modules compiled from bytes are cached. */
+void WasmCompile(const v8::FunctionCallbackInfo<v8::Value>& info) {
+  v8::Local<v8::Value> args[] = {info[0]};
+  v8::Local<v8::Value> ret;
+  if (GetWasmOriginal(info.Data(), kCompileStreaming)
+          ->Call(info.GetIsolate()->GetCurrentContext(), info.This(), 1, args)
+          .ToLocal(&ret)) {
+    info.GetReturnValue().Set(ret);
+  }
+}
+
+/**
+ * Replaces WebAssembly.instantiate so modules compiled from bytes are cached
+ * and the instantiation is timed.
+ */
+void WasmInstantiate(const v8::FunctionCallbackInfo<v8::Value>& info) {
+  if (!info[0]->IsWasmModuleObject()) {
+    CompileAndInstantiate(info);
+    return;
+  }
+
+  v8::Local<v8::Value> ret;
+  if (InstantiateModule(info.Data(), info[0], info[1]).ToLocal(&ret))
+    info.GetReturnValue().Set(ret);
+}
+
+/**
+ * Wraps the WebAssembly functions that compile from bytes so they use the
+ * streaming pipeline, which caches the compiled modules, and so the
+ * instantiation times are recorded.  WebAssembly.compileStreaming uses the
+ * cache directly.  This does nothing if WebAssembly isn't available.
+ */
+void InstallWasmHooks(v8::Isolate* isolate, v8::Local<v8::Context> context) {
+  v8::Local<v8::Value> wasm;
+  if (!context->Global()
+           ->Get(context, MakeName(isolate, "WebAssembly"))
+           .ToLocal(&wasm) ||
+      !wasm->IsObject()) {
+    LOG(INFO) << "WebAssembly isn't available";
+    return;
+  }
+
+  v8::Local<v8::Object> wasm_obj = wasm.As<v8::Object>();
+  v8::Local<v8::Value> compile_streaming;
+  v8::Local<v8::Value> instantiate;
+  if (!wasm_obj->Get(context, MakeName(isolate, "compileStreaming"))
+           .ToLocal(&compile_streaming) ||
+      !compile_streaming->IsFunction() ||
+      !wasm_obj->Get(context, MakeName(isolate, "instantiate"))
+           .ToLocal(&instantiate) ||
+      !instantiate->IsFunction()) {
+    LOG(DFATAL) << "WebAssembly streaming compilation isn't available";
+    return;
+  }
+
+  v8::Local<v8::Array> originals = v8::Array::New(isolate, 2);
+  CHECK(originals->Set(context, kCompileStreaming, compile_streaming)
+            .FromJust());
+  CHECK(originals->Set(context, kInstantiate, instantiate).FromJust());
+
+  auto replace = [&](const char* name, v8::FunctionCallback callback) {
+    v8::Local<v8::Function> func =
+        v8::Function::New(context, callback, originals).ToLocalChecked();
+    func->SetName(MakeName(isolate, name));
+    CHECK(wasm_obj->Set(context, MakeName(isolate, name), func).FromJust());
+  };
+  replace("compile", &WasmCompile);
+  replace("instantiate", &WasmInstantiate);
+  replace("instantiateStreaming", &CompileAndInstantiate);
+}
+
 void InitializeV8IfNeeded() {
-  static v8::Platform* platform = nullptr;
   if (platform)
     return;
 
@@ -54,13 +315,46 @@ void InitializeV8IfNeeded() {
 
 // \cond Doxygen_Skip
 
-JsEngine::JsEngine() : isolate_(CreateIsolate()), context_(CreateContext()) {}
+JsEngine::JsEngine() : JsEngine(JsManager::HeapOptions()) {}
+
+JsEngine::JsEngine(const JsManager::HeapOptions& heap_options)
+    : idle_gc_count_(0),
+      isolate_(CreateIsolate(heap_options)),
+      context_(CreateContext()),
+      gc_start_us_(0),
+      cpu_profiler_(nullptr),
+      profile_start_us_(0) {}
 
 JsEngine::~JsEngine() {
+  if (cpu_profiler_)
+    cpu_profiler_->Dispose();
   context_.Reset();
   isolate_->Dispose();
 }
 
+double JsEngine::MonotonicTimeMs() {
+  DCHECK(platform);
+  return platform->MonotonicallyIncreasingTime() * 1000;
+}
+
+v8::Local<v8::String> JsEngine::GetPropertyName(const PropertyName& name) {
+  if (property_names_.size() <= name.id())
+    property_names_.resize(name.id() + 1);
+  v8::Eternal<v8::String>& slot = property_names_[name.id()];
+  if (slot.IsEmpty()) {
+    // Internalized strings are what V8 uses for property keys, so this also
+    // avoids V8 internalizing the string on each lookup.  The names live as
+    // long as the isolate, so they don't need to be released.
+    v8::Local<v8::String> ret =
+        v8::String::NewFromUtf8(isolate_, name.name(),
+                                v8::NewStringType::kInternalized)
+            .ToLocalChecked();
+    slot.Set(isolate_, ret);
+    return ret;
+  }
+  return slot.Get(isolate_);
+}
+
 v8::Local<v8::Object> JsEngine::global_handle() {
   return context_.Get(isolate_)->Global();
 }
@@ -69,6 +363,100 @@ v8::Local<v8::Value> JsEngine::global_value() {
   return context_.Get(isolate_)->Global();
 }
 
+void JsEngine::OnLowMemory() {
+  isolate()->LowMemoryNotification();
+}
+
+bool JsEngine::OnIdle(uint64_t idle_ms) {
+  idle_gc_count_.fetch_add(1, std::memory_order_relaxed);
+  // V8 uses deadlines in seconds on its platform clock.
+  const double deadline = (MonotonicTimeMs() + idle_ms) / 1000;
+  return !isolate()->IdleNotificationDeadline(deadline);
+}
+
+JsManager::JsHeapStats JsEngine::GetHeapStats() const {
+  v8::HeapStatistics stats;
+  isolate()->GetHeapStatistics(&stats);
+
+  JsManager::JsHeapStats ret;
+  ret.used_heap_size = stats.used_heap_size();
+  ret.total_heap_size = stats.total_heap_size();
+  ret.heap_size_limit = stats.heap_size_limit();
+  ret.external_memory = stats.external_memory();
+  ret.gc_pauses = Telemetry::Summarize(gc_pauses_);
+  ret.idle_gc_count = idle_gc_count_.load(std::memory_order_relaxed);
+  return ret;
+}
+
+bool JsEngine::StartCpuProfiling(uint32_t sample_interval_us) {
+  if (cpu_profiler_)
+    return false;
+
+  cpu_profiler_ = v8::CpuProfiler::New(isolate());
+  cpu_profiler_->SetSamplingInterval(static_cast<int>(sample_interval_us));
+  profile_start_us_ = DurationHistogram::Now();
+  cpu_profiler_->StartProfiling(v8::String::Empty(isolate()),
+                                /* record_samples= */ true);
+  return true;
+}
+
+bool JsEngine::StopCpuProfiling(JsManager::CpuProfile* profile) {
+  if (!cpu_profiler_)
+    return false;
+
+  v8::CpuProfile* v8_profile =
+      cpu_profiler_->StopProfiling(v8::String::Empty(isolate()));
+  const uint64_t end_us = DurationHistogram::Now();
+  if (!v8_profile) {
+    cpu_profiler_->Dispose();
+    cpu_profiler_ = nullptr;
+    return false;
+  }
+
+  // V8's times are on its own clock, so convert them using the start time.
+  const int64_t offset =
+      static_cast<int64_t>(profile_start_us_) - v8_profile->GetStartTime();
+  profile->start_time_us = profile_start_us_;
+  profile->end_time_us = end_us;
+
+  // Flatten the tree, parents first.
+  std::unordered_map<const v8::CpuProfileNode*, uint32_t> indices;
+  std::vector<const v8::CpuProfileNode*> pending = {
+      v8_profile->GetTopDownRoot()};
+  for (size_t i = 0; i < pending.size(); i++) {
+    const v8::CpuProfileNode* v8_node = pending[i];
+    JsManager::CpuProfileNode node;
+    node.function_name = v8_node->GetFunctionNameStr();
+    node.url = v8_node->GetScriptResourceNameStr();
+    node.line = std::max(v8_node->GetLineNumber(), 0);
+    node.column = std::max(v8_node->GetColumnNumber(), 0);
+    if (v8_node->GetParent())
+      node.parent = static_cast<int32_t>(indices.at(v8_node->GetParent()));
+    indices.emplace(v8_node, static_cast<uint32_t>(profile->nodes.size()));
+    profile->nodes.push_back(std::move(node));
+    for (int j = 0; j < v8_node->GetChildrenCount(); j++)
+      pending.push_back(v8_node->GetChild(j));
+  }
+
+  const int count = v8_profile->GetSamplesCount();
+  profile->samples.reserve(count);
+  profile->time_deltas_us.reserve(count);
+  uint64_t last_time = profile_start_us_;
+  for (int i = 0; i < count; i++) {
+    const uint64_t time = std::max<uint64_t>(
+        last_time, v8_profile->GetSampleTimestamp(i) + offset);
+    profile->samples.push_back(indices.at(v8_profile->GetSample(i)));
+    profile->time_deltas_us.push_back(
+        static_cast<uint32_t>(time - last_time));
+    last_time = time;
+  }
+
+  v8_profile->Delete();
+  cpu_profiler_->Dispose();
+  cpu_profiler_ = nullptr;
+  return true;
+}
+
 void JsEngine::OnPromiseReject(v8::PromiseRejectMessage message) {
   // When a Promise gets rejected, we immediately get a
   // kPromiseRejectWithNoHandler event.  Then, once JavaScript adds a rejection
@@ -79,11 +467,29 @@ void JsEngine::OnPromiseReject(v8::PromiseRejectMessage message) {
     promise_handler_.RemovePromise(message.GetPromise());
 }
 
+// static
+void JsEngine::OnGcPrologue(v8::Isolate* /* isolate */, v8::GCType /* type */,
+                            v8::GCCallbackFlags /* flags */, void* data) {
+  static_cast<JsEngine*>(data)->gc_start_us_ = DurationHistogram::Now();
+}
+
+// static
+void JsEngine::OnGcEpilogue(v8::Isolate* /* isolate */, v8::GCType /* type */,
+                            v8::GCCallbackFlags /* flags */, void* data) {
+  auto* engine = static_cast<JsEngine*>(data);
+  engine->gc_pauses_.Add(DurationHistogram::Now() - engine->gc_start_us_);
+}
+
 void JsEngine::AddDestructor(void* object,
                              std::function<void(void*)> destruct) {
   destructors_.emplace(object, destruct);
 }
 
+void JsEngine::AddExternalBuffer(void* data, std::function<void()> on_free) {
+  std::unique_lock<std::mutex> lock(external_mutex_);
+  external_buffers_.emplace(data, std::move(on_free));
+}
+
 JsEngine::SetupContext::SetupContext()
     : locker(Instance()->isolate_),
       handles(Instance()->isolate_),
@@ -102,6 +508,21 @@ void* JsEngine::ArrayBufferAllocator::AllocateUninitialized(size_t length) {
 }
 
 void JsEngine::ArrayBufferAllocator::Free(void* data, size_t /* length */) {
+  std::function<void()> on_free;
+  {
+    JsEngine* engine = Instance();
+    std::unique_lock<std::mutex> lock(engine->external_mutex_);
+    auto it = engine->external_buffers_.find(data);
+    if (it != engine->external_buffers_.end()) {
+      on_free = std::move(it->second);
+      engine->external_buffers_.erase(it);
+    }
+  }
+  if (on_free) {
+    on_free();
+    return;
+  }
+
   auto* destructors = &Instance()->destructors_;
   if (destructors->count(data) > 0) {
     destructors->at(data)(data);
@@ -110,16 +531,30 @@ void JsEngine::ArrayBufferAllocator::Free(void* data, size_t /* length */) {
   std::free(data);  // NOLINT
 }
 
-v8::Isolate* JsEngine::CreateIsolate() {
+v8::Isolate* JsEngine::CreateIsolate(
+    const JsManager::HeapOptions& heap_options) {
   InitializeV8IfNeeded();
 
   v8::Isolate::CreateParams create_params;
   create_params.array_buffer_allocator = &allocator_;
+  if (heap_options.max_heap_size > 0) {
+    create_params.constraints.ConfigureDefaultsFromHeapSize(
+        0, heap_options.max_heap_size);
+  }
+  if (heap_options.max_young_generation_size > 0) {
+    create_params.constraints.set_max_young_generation_size_in_bytes(
+        heap_options.max_young_generation_size);
+  }
 
   v8::Isolate* isolate = v8::Isolate::New(create_params);
   CHECK(isolate);
   isolate->SetCaptureStackTraceForUncaughtExceptions(true);
   isolate->SetPromiseRejectCallback(&::shaka::OnPromiseReject);
+  // This needs to be set before creating the context, since it enables
+  // WebAssembly.compileStreaming.
+  isolate->SetWasmStreamingCallback(&OnWasmStreaming);
+  isolate->AddGCPrologueCallback(&JsEngine::OnGcPrologue, this);
+  isolate->AddGCEpilogueCallback(&JsEngine::OnGcEpilogue, this);
 
   return isolate;
 }
@@ -128,6 +563,10 @@ v8::Global<v8::Context> JsEngine::CreateContext() {
   v8::Locker locker(isolate_);
   v8::HandleScope handles(isolate_);
   v8::Local<v8::Context> context = v8::Context::New(isolate_);
+  {
+    v8::Context::Scope context_scope(context);
+    InstallWasmHooks(isolate_, context);
+  }
   return v8::Global<v8::Context>(isolate_, context);
 }
 
@@ -14,14 +14,27 @@
 
 #include "src/mapping/js_wrappers.h"
 
+#include <algorithm>
+#include <memory>
+#include <utility>
+#include <vector>
+
 #include "src/mapping/backing_object.h"
 #include "src/mapping/convert_js.h"
+#include "src/util/crypto.h"
 #include "src/util/file_system.h"
+#include "src/util/utf8.h"
 
 namespace shaka {
 
 namespace {
 
+/**
+ * ASCII strings at least this large are stored outside the V8 heap so they
+ * aren't copied again when the GC compacts the heap.
+ */
+constexpr const size_t kExternalStringThreshold = 64 * 1024;
+
 class StaticExternalResource
     : public v8::String::ExternalOneByteStringResource {
  public:
@@ -50,6 +63,80 @@ class StaticExternalResource
   size_t data_size_;
 };
 
+/** A string resource that owns a copy of the string. */
+class OwnedExternalResource
+    : public v8::String::ExternalOneByteStringResource {
+ public:
+  OwnedExternalResource(const uint8_t* data, size_t data_size)
+      : data_(data, data + data_size) {}
+
+  SHAKA_NON_COPYABLE_OR_MOVABLE_TYPE(OwnedExternalResource);
+
+  const char* data() const override {
+    return reinterpret_cast<const char*>(data_.data());
+  }
+
+  size_t length() const override {
+    return data_.size();
+  }
+
+ protected:
+  void Dispose() override {
+    delete this;
+  }
+
+ private:
+  ~OwnedExternalResource() override {}
+
+  const std::vector<uint8_t> data_;
+};
+
+/** A string resource that uses the contents of a mapped file. */
+class MappedFileResource : public v8::String::ExternalOneByteStringResource {
+ public:
+  explicit MappedFileResource(util::MappedFile file) : file_(std::move(file)) {}
+
+  SHAKA_NON_COPYABLE_OR_MOVABLE_TYPE(MappedFileResource);
+
+  const char* data() const override {
+    return reinterpret_cast<const char*>(file_.data());
+  }
+
+  size_t length() const override {
+    return file_.size();
+  }
+
+ protected:
+  void Dispose() override {
+    delete this;
+  }
+
+ private:
+  ~MappedFileResource() override {}
+
+  util::MappedFile file_;
+};
+
+/**
+ * Creates a string containing the given script.  If possible, this uses the
+ * mapped file directly so the script isn't copied into the V8 heap; the file
+ * is unmapped once the string is collected.
+ */
+v8::Local<v8::String> MakeScriptString(util::MappedFile file) {
+  // One-byte strings are Latin-1, so the file can only be used directly if it
+  // is ASCII.  Otherwise it needs to be decoded as UTF-8.
+  const uint8_t* data = file.data();
+  const size_t size = file.size();
+  if (util::IsAscii(data, size)) {
+    auto* res = new MappedFileResource(std::move(file));
+    return v8::String::NewExternalOneByte(GetIsolate(), res).ToLocalChecked();
+  }
+  return v8::String::NewFromUtf8(GetIsolate(),
+                                 reinterpret_cast<const char*>(data),
+                                 v8::NewStringType::kNormal, size)
+      .ToLocalChecked();
+}
+
 v8::Local<v8::String> MakeExternalString(const uint8_t* data,
                                          size_t data_size) {
 #ifndef NDEBUG
@@ -87,7 +174,20 @@ void SetMemberImpl(Handle<JsObject> object, T ind, Handle<JsValue> value) {
   CHECK(object->Set(context, ind, value).IsJust());
 }
 
-bool RunScriptImpl(const std::string& path, Handle<JsString> source) {
+/**
+ * Compiles and runs the given script.
+ *
+ * @param path The path of the script, used for logging.
+ * @param source The source of the script.
+ * @param cached_data The code cache to compile with, or nullptr to compile
+ *   from source.  This takes ownership of the object.
+ * @param new_cache [OUT] Optional, if given and |cached_data| wasn't used,
+ *   will contain a new code cache for the script after it has run.
+ */
+bool RunScriptImpl(const std::string& path, Handle<JsString> source,
+                   v8::ScriptCompiler::CachedData* cached_data = nullptr,
+                   std::unique_ptr<v8::ScriptCompiler::CachedData>* new_cache =
+                       nullptr) {
   v8::Isolate* isolate = v8::Isolate::GetCurrent();
   auto context = isolate->GetCurrentContext();
   v8::HandleScope handle_scope(GetIsolate());
@@ -95,14 +195,20 @@ bool RunScriptImpl(const std::string& path, Handle<JsString> source) {
 
   // Compile the script.
   v8::TryCatch trycatch(isolate);
-  v8::MaybeLocal<v8::Script> maybe_script =
-      v8::Script::Compile(context, source, &origin);
+  v8::ScriptCompiler::Source script_source(source, origin, cached_data);
+  v8::MaybeLocal<v8::Script> maybe_script = v8::ScriptCompiler::Compile(
+      context, &script_source,
+      cached_data ? v8::ScriptCompiler::kConsumeCodeCache
+                  : v8::ScriptCompiler::kNoCompileOptions);
   v8::Local<v8::Script> script;
   if (!maybe_script.ToLocal(&script) || script.IsEmpty()) {
     LOG(ERROR) << "Error loading script " << path;
     OnUncaughtException(trycatch.Exception(), false);
     return false;
   }
+  const bool used_cache = cached_data && !cached_data->rejected;
+  if (cached_data && !used_cache)
+    VLOG(1) << "Code cache rejected for " << path;
 
   // Run the script.  Run() returns the return value from the script, which
   // will be empty if the script failed to execute.
@@ -110,6 +216,13 @@ bool RunScriptImpl(const std::string& path, Handle<JsString> source) {
     OnUncaughtException(trycatch.Exception(), false);
     return false;
   }
+
+  // Create the cache after running so it includes the functions that were
+  // compiled while running the script.
+  if (new_cache && !used_cache) {
+    new_cache->reset(
+        v8::ScriptCompiler::CreateCodeCache(script->GetUnboundScript()));
+  }
   return true;
 }
 
@@ -139,6 +252,12 @@ ReturnVal<JsValue> GetMemberRaw(Handle<JsObject> object,
   return GetMemberImpl(object, JsStringFromUtf8(name), exception);
 }
 
+ReturnVal<JsValue> GetMemberRaw(Handle<JsObject> object,
+                                const PropertyName& name,
+                                LocalVar<JsValue>* exception) {
+  return GetMemberImpl(object, name.handle(), exception);
+}
+
 ReturnVal<JsValue> GetArrayIndexRaw(Handle<JsObject> object, size_t index,
                                     LocalVar<JsValue>* exception) {
   return GetMemberImpl(object, index, exception);
@@ -149,11 +268,21 @@ void SetMemberRaw(Handle<JsObject> object, const std::string& name,
   SetMemberImpl(object, JsStringFromUtf8(name), value);
 }
 
+void SetMemberRaw(Handle<JsObject> object, const PropertyName& name,
+                  Handle<JsValue> value) {
+  SetMemberImpl(object, name.handle(), value);
+}
+
 void SetArrayIndexRaw(Handle<JsObject> object, size_t i,
                       Handle<JsValue> value) {
   SetMemberImpl(object, i, value);
 }
 
+void DeleteMemberRaw(Handle<JsObject> object, const std::string& name) {
+  v8::Local<v8::Context> context = GetIsolate()->GetCurrentContext();
+  CHECK(object->Delete(context, JsStringFromUtf8(name)).FromMaybe(false));
+}
+
 
 void SetGenericPropertyRaw(Handle<JsObject> object, const std::string& name,
                            Handle<JsFunction> getter,
@@ -238,14 +367,9 @@ bool IsDerivedFrom(BackingObject* ptr, const std::string& name) {
 
 bool RunScript(const std::string& path) {
   util::FileSystem fs;
-  std::vector<uint8_t> source;
-  CHECK(fs.ReadFile(path, &source));
-  v8::Local<v8::String> code =
-      v8::String::NewFromUtf8(GetIsolate(),
-                              reinterpret_cast<const char*>(source.data()),
-                              v8::NewStringType::kNormal, source.size())
-          .ToLocalChecked();
-  return RunScriptImpl(path, code);
+  util::MappedFile source;
+  CHECK(fs.MapFile(path, &source));
+  return RunScriptImpl(path, MakeScriptString(std::move(source)));
 }
 
 bool RunScript(const std::string& path, const uint8_t* data, size_t data_size) {
@@ -253,6 +377,63 @@ bool RunScript(const std::string& path, const uint8_t* data, size_t data_size) {
   return RunScriptImpl(path, source);
 }
 
+ScriptFiles::ScriptFiles() {}
+ScriptFiles::ScriptFiles(ScriptFiles&&) = default;
+ScriptFiles::~ScriptFiles() {}
+
+ScriptFiles& ScriptFiles::operator=(ScriptFiles&&) = default;
+
+ScriptFiles ReadScriptFiles(const std::string& path,
+                            const std::string& cache_path,
+                            const std::string& prebuilt_cache_path) {
+  ScriptFiles ret;
+  ret.path = path;
+  ret.cache_path = cache_path;
+  util::FileSystem fs;
+  CHECK(fs.MapFile(path, &ret.source));
+
+  // The cache file starts with the hash of the script it was made from, so a
+  // cache from an older script isn't used.  V8 also rejects caches from other
+  // V8 versions or flags.
+  ret.hash = util::HashData(ret.source.data(), ret.source.size());
+  auto read_cache = [&](const std::string& file) {
+    return !file.empty() && fs.FileExists(file) &&
+           fs.ReadFile(file, &ret.cache) &&
+           ret.cache.size() > ret.hash.size() &&
+           std::equal(ret.hash.begin(), ret.hash.end(), ret.cache.begin());
+  };
+
+  // Prefer the cache from an earlier launch since it was made by this device's
+  // V8; the prebuilt cache is only used until that exists.
+  if (!read_cache(cache_path) && !read_cache(prebuilt_cache_path))
+    ret.cache.clear();
+  return ret;
+}
+
+bool RunScriptWithCodeCache(ScriptFiles files) {
+  v8::ScriptCompiler::CachedData* cached_data = nullptr;
+  if (!files.cache.empty()) {
+    const size_t cache_size = files.cache.size() - files.hash.size();
+    cached_data = new v8::ScriptCompiler::CachedData(
+        files.cache.data() + files.hash.size(), static_cast<int>(cache_size));
+  }
+
+  v8::Local<v8::String> code = MakeScriptString(std::move(files.source));
+  std::unique_ptr<v8::ScriptCompiler::CachedData> new_cache;
+  if (!RunScriptImpl(files.path, code, cached_data, &new_cache))
+    return false;
+
+  if (new_cache) {
+    std::vector<uint8_t> data(files.hash);
+    data.insert(data.end(), new_cache->data,
+                new_cache->data + new_cache->length);
+    util::FileSystem fs;
+    if (!fs.WriteFile(files.cache_path, data))
+      LOG(WARNING) << "Unable to write code cache for " << files.path;
+  }
+  return true;
+}
+
 ReturnVal<JsValue> ParseJsonString(const std::string& json) {
   v8::Local<v8::String> source = MakeExternalString(
       reinterpret_cast<const uint8_t*>(json.data()), json.size());
@@ -275,6 +456,18 @@ ReturnVal<JsString> JsStringFromUtf8(const std::string& str) {
 }
 
 ReturnVal<JsString> JsStringFromUtf8(const uint8_t* data, size_t size) {
+  // One-byte strings are Latin-1, which is the same as UTF-8 for ASCII, so
+  // they can be copied directly without decoding.
+  if (util::IsAscii(data, size)) {
+    if (size >= kExternalStringThreshold) {
+      auto* res = new OwnedExternalResource(data, size);
+      return v8::String::NewExternalOneByte(GetIsolate(), res)
+          .ToLocalChecked();
+    }
+    return v8::String::NewFromOneByte(GetIsolate(), data,
+                                      v8::NewStringType::kNormal, size)
+        .ToLocalChecked();
+  }
   return v8::String::NewFromUtf8(GetIsolate(),
                                  reinterpret_cast<const char*>(data),
                                  v8::NewStringType::kNormal, size)
@@ -15,11 +15,13 @@
 #include "src/media/apple/apple_decoder.h"
 
 #include <algorithm>
+#include <functional>
 #include <unordered_map>
 #include <utility>
 
+#include "src/media/decoding_info_cache.h"
 #include "src/media/media_utils.h"
-#include "src/util/dynamic_buffer.h"
+#include "src/media/segment_encoded_frame.h"
 #include "src/util/utils.h"
 
 #ifndef kVTVideoDecoderSpecification_EnableHardwareAcceleratedVideoDecoder
@@ -39,8 +41,11 @@ namespace apple {
 
 namespace {
 
-/** The number of samples to read per chunk. */
-constexpr const size_t kAudioSampleCount = 256;
+/**
+ * The number of samples to allocate space for if the converter doesn't say how
+ * many samples each packet contains.
+ */
+constexpr const size_t kAudioSampleCount = 1024;
 
 /**
  * The sample format to use.  Must be packed and must match the sample size
@@ -113,14 +118,28 @@ util::CFRef<CMVideoFormatDescriptionRef> CreateFormatDescription(
   return ret;
 }
 
+void FreeSampleBlock(void* ref_con, void* /* block */, size_t /* size */) {
+  delete static_cast<std::shared_ptr<const void>*>(ref_con);
+}
+
+/**
+ * Creates a sample buffer that references the given data without copying it.
+ * The block buffer holds a reference to |owner| until VideoToolbox is done
+ * with the buffer.
+ */
 util::CFRef<CMSampleBufferRef> CreateSampleBuffer(
-    util::CFRef<CMVideoFormatDescriptionRef> format_desc, const uint8_t* data,
-    size_t size) {
+    util::CFRef<CMVideoFormatDescriptionRef> format_desc,
+    std::shared_ptr<const void> owner, const uint8_t* data, size_t size) {
+  CMBlockBufferCustomBlockSource source{};
+  source.version = kCMBlockBufferCustomBlockSourceVersion;
+  source.FreeBlock = &FreeSampleBlock;
+  source.refCon = new std::shared_ptr<const void>(std::move(owner));
+
   CMBlockBufferRef block = nullptr;
   CMSampleBufferRef ret = nullptr;
   const auto status = CMBlockBufferCreateWithMemoryBlock(
       kCFAllocatorDefault, const_cast<uint8_t*>(data), size, kCFAllocatorNull,
-      nullptr, 0, size, 0, &block);
+      &source, 0, size, 0, &block);
   if (status == 0) {
     CMSampleBufferCreate(kCFAllocatorDefault,  // allocator
                          block,                // dataBuffer
@@ -134,6 +153,9 @@ util::CFRef<CMSampleBufferRef> CreateSampleBuffer(
                          0,                    // numSampleSizeEntries
                          nullptr,              // sampleSizeArray
                          &ret);                // sampleBufferOut
+  } else {
+    // The block buffer only takes ownership if it was created.
+    FreeSampleBlock(source.refCon, nullptr, 0);
   }
 
   if (block)
@@ -141,16 +163,28 @@ util::CFRef<CMSampleBufferRef> CreateSampleBuffer(
   return ret;
 }
 
+/**
+ * @return Whether to decode the given stream into 10-bit buffers, so 10-bit
+ *   and HDR content isn't reduced to 8 bits before it is rendered.
+ */
+bool UseTenBitOutput(const std::string& codec, const HdrMetadata& metadata) {
+  return GetCodecBitDepth(codec) > 8 || metadata.IsHdr();
+}
+
 util::CFRef<CFMutableDictionaryRef> CreateBufferAttributes(int32_t width,
-                                                           int32_t height) {
-  util::CFRef<CFMutableDictionaryRef> ret(MakeDict(5));
+                                                           int32_t height,
+                                                           bool ten_bit) {
+  util::CFRef<CFMutableDictionaryRef> ret(MakeDict(6));
   util::CFRef<CFMutableDictionaryRef> surface_props(MakeDict(0));
 
   util::CFRef<CFNumberRef> w(
       CFNumberCreate(kCFAllocatorDefault, kCFNumberSInt32Type, &width));
   util::CFRef<CFNumberRef> h(
       CFNumberCreate(kCFAllocatorDefault, kCFNumberSInt32Type, &height));
-  int32_t pix_fmt_raw = kCVPixelFormatType_420YpCbCr8BiPlanarVideoRange;
+  // The 10-bit format has the same layout as P010.
+  int32_t pix_fmt_raw = ten_bit
+                            ? kCVPixelFormatType_420YpCbCr10BiPlanarVideoRange
+                            : kCVPixelFormatType_420YpCbCr8BiPlanarVideoRange;
   util::CFRef<CFNumberRef> pix_fmt(
       CFNumberCreate(kCFAllocatorDefault, kCFNumberSInt32Type, &pix_fmt_raw));
 
@@ -161,6 +195,10 @@ util::CFRef<CFMutableDictionaryRef> CreateBufferAttributes(int32_t width,
                        surface_props);
   CFDictionarySetValue(ret, kCVPixelBufferCGImageCompatibilityKey,
                        kCFBooleanTrue);
+  // VideoToolbox allocates these from its own pool; making them Metal
+  // compatible lets them be displayed directly from the IOSurface.
+  CFDictionarySetValue(ret, kCVPixelBufferMetalCompatibilityKey,
+                       kCFBooleanTrue);
 
   return ret;
 }
@@ -376,16 +414,34 @@ OSStatus CreateAudioConverter(uint32_t sample_rate, uint32_t channel_count,
   return AudioConverterNew(&input, &output, session);
 }
 
+/**
+ * @return Whether the two streams can be decoded by the same audio converter.
+ */
+bool IsSameAudioConfig(const StreamInfo& a, const StreamInfo& b) {
+  return !a.is_video && !b.is_video && a.codec == b.codec &&
+         a.sample_rate == b.sample_rate && a.channel_count == b.channel_count &&
+         a.extra_data == b.extra_data;
+}
+
 }  // namespace
 
 AppleDecoder::AppleDecoder()
-    : mutex_("AppleDecoder"), at_session_(nullptr, &AudioConverterDispose) {}
+    : mutex_("AppleDecoder"),
+      output_mutex_("AppleDecoder output"),
+      at_session_(nullptr, &AudioConverterDispose) {}
 AppleDecoder::~AppleDecoder() {
   ResetDecoder();
 }
 
 MediaCapabilitiesInfo AppleDecoder::DecodingInfo(
     const MediaDecodingConfiguration& config) const {
+  return DecodingInfoCache::Instance.Get(
+      "apple", config, std::bind(&AppleDecoder::QueryDecodingInfo, config));
+}
+
+// static
+MediaCapabilitiesInfo AppleDecoder::QueryDecodingInfo(
+    const MediaDecodingConfiguration& config) {
   if (config.video.content_type.empty() == config.audio.content_type.empty())
     return MediaCapabilitiesInfo();
 
@@ -429,8 +485,8 @@ MediaCapabilitiesInfo AppleDecoder::DecodingInfo(
         CreateVideoDecoderConfig(codec, extra_data);
     auto format_desc =
         CreateFormatDescription(codec, width, height, decoder_config);
-    util::CFRef<CFDictionaryRef> buffer_attr =
-        CreateBufferAttributes(width, height);
+    util::CFRef<CFDictionaryRef> buffer_attr = CreateBufferAttributes(
+        width, height, UseTenBitOutput(codec, HdrMetadata()));
 
     VTDecompressionSessionRef session;
     auto status = VTDecompressionSessionCreate(kCFAllocatorDefault, format_desc,
@@ -471,7 +527,15 @@ MediaCapabilitiesInfo AppleDecoder::DecodingInfo(
 
 void AppleDecoder::ResetDecoder() {
   std::unique_lock<Mutex> lock(mutex_);
-  ResetInternal();
+  // The audio converter can be reused after dropping its buffered data.
+  if (at_session_)
+    AudioConverterReset(at_session_.get());
+  else
+    ResetInternal();
+
+  // Drop any frames from before the reset (e.g. a seek).
+  std::unique_lock<Mutex> output_lock(output_mutex_);
+  decoded_frames_.clear();
 }
 
 MediaStatus AppleDecoder::Decode(
@@ -493,6 +557,7 @@ MediaStatus AppleDecoder::Decode(
 
     output_ = nullptr;
     ResetInternal();  // Cannot re-use decoder after flush.
+    TakeDecodedFrames(frames);
     return ret ? MediaStatus::Success : MediaStatus::FatalError;
   }
 
@@ -503,39 +568,56 @@ MediaStatus AppleDecoder::Decode(
       is_video ? &AppleDecoder::DecodeVideo : &AppleDecoder::DecodeAudio;
   auto has_session = is_video ? !!vt_session_ : !!at_session_;
 
-  if (!has_session || input->stream_info != decoder_stream_info_) {
+  if (has_session && !is_video && input->stream_info != decoder_stream_info_ &&
+      IsSameAudioConfig(*input->stream_info, *decoder_stream_info_)) {
+    // Keep the converter when switching between streams with the same config.
+    decoder_stream_info_ = input->stream_info;
+  } else if (has_session && is_video &&
+             input->stream_info != decoder_stream_info_ &&
+             ReconfigureVideoDecoder(input->stream_info)) {
+    VLOG(1) << "Reconfigured video decoder in place";
+  } else if (!has_session || input->stream_info != decoder_stream_info_) {
     ResetInternal();
     if (!(this->*init)(input->stream_info, extra_info))
       return MediaStatus::FatalError;
     decoder_stream_info_ = input->stream_info;
   }
 
-  const uint8_t* data;
+  // If possible, decrypt the frame in place so the data can be given to the
+  // decoder directly; otherwise the clear data is put in a new buffer.
+  const uint8_t* data = input->data;
   const size_t size = input->data_size;
-  std::vector<uint8_t> decrypted_data;
+  std::shared_ptr<const void> owner = input;
   if (input->encryption_info) {
-    decrypted_data.resize(input->data_size);
-    const auto status = input->Decrypt(eme, decrypted_data.data());
+    MediaStatus status;
+    if (!SegmentEncodedFrame::DecryptInPlace(input.get(), eme, &status)) {
+      auto decrypted = std::make_shared<std::vector<uint8_t>>(size);
+      status = input->Decrypt(eme, decrypted->data());
+      data = decrypted->data();
+      owner = std::move(decrypted);
+    }
     if (status != MediaStatus::Success) {
       *extra_info = "Error decrypting frame";
       return status;
     }
-    data = decrypted_data.data();
-  } else {
-    data = input->data;
   }
 
   // Store the important info in fields since we get callbacks and only get one
   // pointer for user data (this).
   input_ = input.get();
+  input_owner_ = std::move(owner);
   input_data_ = data;
   input_data_size_ = size;
   output_ = frames;
   const bool ret = (this->*decode)(data, size, extra_info);
   input_ = nullptr;
+  input_owner_.reset();
   input_data_ = nullptr;
   input_data_size_ = 0;
   output_ = nullptr;
+  // Video frames are decoded asynchronously, so this returns the frames that
+  // have finished so far, which may be from earlier calls.
+  TakeDecodedFrames(frames);
   return ret ? MediaStatus::Success : MediaStatus::FatalError;
 }
 
@@ -543,27 +625,33 @@ void AppleDecoder::OnNewVideoFrame(void* user, void* frameUser, OSStatus status,
                                    VTDecodeInfoFlags /* flags */,
                                    CVImageBufferRef buffer, CMTime pts,
                                    CMTime duration) {
+  // This is called on a VideoToolbox thread while Decode() may be running, so
+  // this can only use the fields guarded by |output_mutex_|.
   auto* decoder = reinterpret_cast<AppleDecoder*>(user);
-  auto* frame = decoder->input_;
+  const uint64_t id = reinterpret_cast<uintptr_t>(frameUser);
+  std::unique_lock<Mutex> lock(decoder->output_mutex_);
+  auto it = decoder->frames_in_flight_.find(id);
+  if (it == decoder->frames_in_flight_.end())
+    return;
+  const FrameInfo info = it->second;
+  decoder->frames_in_flight_.erase(it);
   if (status != 0)
     return;
 
-  CHECK(decoder->output_);
   CHECK(buffer);
-
   double time;
   if (pts.flags & kCMTimeFlags_Valid)
     time = CMTimeGetSeconds(pts);
   else
-    time = frame ? frame->pts : 0;
+    time = info.pts;
   double durationSec;
   if (duration.flags & kCMTimeFlags_Valid)
     durationSec = CMTimeGetSeconds(duration);
   else
-    durationSec = frame ? frame->duration : 0;
+    durationSec = info.duration;
 
-  decoder->output_->emplace_back(new AppleDecodedFrame(
-      decoder->decoder_stream_info_, time, durationSec, buffer));
+  decoder->decoded_frames_.emplace_back(
+      new AppleDecodedFrame(info.stream_info, time, durationSec, buffer));
 }
 
 OSStatus AppleDecoder::AudioInputCallback(AudioConverterRef /* conv */,
@@ -597,6 +685,8 @@ OSStatus AppleDecoder::AudioInputCallback(AudioConverterRef /* conv */,
 
 void AppleDecoder::ResetInternal() {
   if (vt_session_) {
+    // Finish the frames in flight so they aren't lost when the stream changes.
+    VTDecompressionSessionWaitForAsynchronousFrames(vt_session_);
     VTDecompressionSessionInvalidate(vt_session_);
     vt_session_ = nullptr;
   }
@@ -608,17 +698,31 @@ bool AppleDecoder::DecodeVideo(const uint8_t* data, size_t data_size,
   OSStatus status;
   if (data) {
     util::CFRef<CMSampleBufferRef> sample =
-        CreateSampleBuffer(format_desc_, data, data_size);
+        CreateSampleBuffer(format_desc_, input_owner_, data, data_size);
     if (!sample) {
       *extra_info = "Error creating sample buffer";
       return false;
     }
 
+    // Don't wait for the frame so multiple frames can be in flight in the
+    // decoder.  The output callback adds them to |decoded_frames_|.
+    uint64_t id;
+    {
+      std::unique_lock<Mutex> lock(output_mutex_);
+      id = next_frame_id_++;
+      frames_in_flight_[id] = {decoder_stream_info_, input_->pts,
+                               input_->duration};
+    }
     status = VTDecompressionSessionDecodeFrame(
-        vt_session_, sample, kVTDecodeFrame_EnableTemporalProcessing, nullptr,
-        nullptr);
-    if (status == 0)
-      status = VTDecompressionSessionWaitForAsynchronousFrames(vt_session_);
+        vt_session_, sample,
+        kVTDecodeFrame_EnableAsynchronousDecompression |
+            kVTDecodeFrame_EnableTemporalProcessing,
+        reinterpret_cast<void*>(static_cast<uintptr_t>(id)), nullptr);
+    if (status != 0) {
+      // The callback may not be called if the frame wasn't queued.
+      std::unique_lock<Mutex> lock(output_mutex_);
+      frames_in_flight_.erase(id);
+    }
   } else {
     status = VTDecompressionSessionFinishDelayedFrames(vt_session_);
     if (status == 0)
@@ -633,25 +737,45 @@ bool AppleDecoder::DecodeVideo(const uint8_t* data, size_t data_size,
   return true;
 }
 
+void AppleDecoder::TakeDecodedFrames(
+    std::vector<std::shared_ptr<DecodedFrame>>* frames) {
+  std::unique_lock<Mutex> lock(output_mutex_);
+  // The decoder may finish frames out of order, so sort them by PTS.
+  std::stable_sort(decoded_frames_.begin(), decoded_frames_.end(),
+                   [](const std::shared_ptr<DecodedFrame>& a,
+                      const std::shared_ptr<DecodedFrame>& b) {
+                     return a->pts < b->pts;
+                   });
+  frames->insert(frames->end(), decoded_frames_.begin(),
+                 decoded_frames_.end());
+  decoded_frames_.clear();
+}
+
 bool AppleDecoder::DecodeAudio(const uint8_t* data, size_t data_size,
                                std::string* extra_info) {
   if (!data)
     return true;
 
+  // The converter writes directly into the frame's buffer.  This usually fits
+  // a whole packet, but grows if the converter produces more.
   const size_t channel_count = decoder_stream_info_->channel_count;
-  util::DynamicBuffer out_buffer;
-  std::vector<uint8_t> temp_buffer;
-  temp_buffer.resize(kAudioSampleCount * kAudioSampleSize * channel_count);
+  const size_t frame_size = kAudioSampleSize * channel_count;
+  std::vector<uint8_t> buffer(audio_samples_per_packet_ * frame_size);
+  size_t sample_count = 0;
   auto* input = input_;
 
   OSStatus status = 0;
   while (status == 0) {
+    const size_t offset = sample_count * frame_size;
+    if (offset == buffer.size())
+      buffer.resize(buffer.size() * 2);
+
     AudioBufferList output{};
     output.mNumberBuffers = 1;
     output.mBuffers[0].mNumberChannels = channel_count;
-    output.mBuffers[0].mDataByteSize = temp_buffer.size();
-    output.mBuffers[0].mData = temp_buffer.data();
-    UInt32 output_size = kAudioSampleCount;
+    output.mBuffers[0].mDataByteSize = buffer.size() - offset;
+    output.mBuffers[0].mData = buffer.data() + offset;
+    UInt32 output_size = output.mBuffers[0].mDataByteSize / frame_size;
 
     status = AudioConverterFillComplexBuffer(
         at_session_.get(), &AppleDecoder::AudioInputCallback, this,
@@ -662,17 +786,13 @@ bool AppleDecoder::DecodeAudio(const uint8_t* data, size_t data_size,
       return false;
     }
 
-    out_buffer.AppendCopy(temp_buffer.data(),
-                          output_size * kAudioSampleSize * channel_count);
+    sample_count += output_size;
   }
 
-  temp_buffer.resize(out_buffer.Size());
-  out_buffer.CopyDataTo(temp_buffer.data(), temp_buffer.size());
-  const uint32_t sample_count =
-      temp_buffer.size() / kAudioSampleSize / channel_count;
+  buffer.resize(sample_count * frame_size);
   output_->emplace_back(new AppleDecodedFrame(
       decoder_stream_info_, input->pts, input->duration, kAudioSampleFormat,
-      sample_count, std::move(temp_buffer)));
+      sample_count, std::move(buffer)));
 
   return true;
 }
@@ -687,8 +807,9 @@ bool AppleDecoder::InitVideoDecoder(std::shared_ptr<const StreamInfo> info,
       CreateVideoDecoderConfig(info->codec, info->extra_data);
   format_desc_ = CreateFormatDescription(info->codec, info->width, info->height,
                                          decoder_config);
-  util::CFRef<CFDictionaryRef> buffer_attr =
-      CreateBufferAttributes(info->width, info->height);
+  util::CFRef<CFDictionaryRef> buffer_attr = CreateBufferAttributes(
+      info->width, info->height,
+      UseTenBitOutput(info->codec, info->hdr_metadata));
 
   VTDecompressionSessionRef session;
   const auto status =
@@ -705,6 +826,34 @@ bool AppleDecoder::InitVideoDecoder(std::shared_ptr<const StreamInfo> info,
   return true;
 }
 
+bool AppleDecoder::ReconfigureVideoDecoder(
+    std::shared_ptr<const StreamInfo> info) {
+  if (NormalizeCodec(info->codec) !=
+          NormalizeCodec(decoder_stream_info_->codec) ||
+      UseTenBitOutput(info->codec, info->hdr_metadata) !=
+          UseTenBitOutput(decoder_stream_info_->codec,
+                          decoder_stream_info_->hdr_metadata)) {
+    // The output buffers can't change format, so this needs a new session.
+    return false;
+  }
+
+  util::CFRef<CFDictionaryRef> decoder_config =
+      CreateVideoDecoderConfig(info->codec, info->extra_data);
+  auto format_desc = CreateFormatDescription(info->codec, info->width,
+                                             info->height, decoder_config);
+  if (!format_desc ||
+      !VTDecompressionSessionCanAcceptFormatDescription(vt_session_,
+                                                        format_desc)) {
+    return false;
+  }
+
+  // Frames in flight keep the stream info they were decoded with, so they
+  // don't need to be finished first.
+  format_desc_ = format_desc;
+  decoder_stream_info_ = info;
+  return true;
+}
+
 bool AppleDecoder::InitAudioDecoder(std::shared_ptr<const StreamInfo> info,
                                     std::string* extra_info) {
   AudioConverterRef session = nullptr;
@@ -724,6 +873,16 @@ bool AppleDecoder::InitAudioDecoder(std::shared_ptr<const StreamInfo> info,
     return false;
   }
   at_session_.reset(session);
+
+  AudioStreamBasicDescription input_desc = {0};
+  UInt32 size = sizeof(input_desc);
+  if (AudioConverterGetProperty(session,
+                                kAudioConverterCurrentInputStreamDescription,
+                                &size, &input_desc) != 0) {
+    input_desc.mFramesPerPacket = 0;
+  }
+  audio_samples_per_packet_ =
+      DEFAULT(input_desc.mFramesPerPacket, kAudioSampleCount);
   return true;
 }
 
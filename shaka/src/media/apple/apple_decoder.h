@@ -21,6 +21,7 @@
 #include <memory>
 #include <string>
 #include <type_traits>
+#include <unordered_map>
 #include <vector>
 
 #include "shaka/media/decoder.h"
@@ -54,6 +55,16 @@ class AppleDecoder : public Decoder {
       std::string* extra_info) override;
 
  private:
+  /** The info about a frame being decoded by VideoToolbox. */
+  struct FrameInfo {
+    std::shared_ptr<const StreamInfo> stream_info;
+    double pts;
+    double duration;
+  };
+
+  /** Queries VideoToolbox/AudioToolbox; the results are cached. */
+  static MediaCapabilitiesInfo QueryDecodingInfo(
+      const MediaDecodingConfiguration& config);
   static void OnNewVideoFrame(void* user, void* frameUser, OSStatus status,
                               VTDecodeInfoFlags flags, CVImageBufferRef buffer,
                               CMTime pts, CMTime duration);
@@ -63,6 +74,9 @@ class AppleDecoder : public Decoder {
 
   void ResetInternal();
 
+  /** Moves the finished frames into |frames|, in PTS order. */
+  void TakeDecodedFrames(std::vector<std::shared_ptr<DecodedFrame>>* frames);
+
   bool DecodeVideo(const uint8_t* data, size_t data_size,
                    std::string* extra_info);
   bool DecodeAudio(const uint8_t* data, size_t data_size,
@@ -70,16 +84,32 @@ class AppleDecoder : public Decoder {
 
   bool InitVideoDecoder(std::shared_ptr<const StreamInfo> info,
                         std::string* extra_info);
+  /**
+   * Tries to switch the existing VideoToolbox session to the given stream
+   * without creating a new one.  This works when only the resolution or the
+   * parameter sets change, like when switching between variants.
+   * @return Whether the session can decode the new stream.
+   */
+  bool ReconfigureVideoDecoder(std::shared_ptr<const StreamInfo> info);
   bool InitAudioDecoder(std::shared_ptr<const StreamInfo> info,
                         std::string* extra_info);
 
   Mutex mutex_;
   EncodedFrame* input_;
+  // Keeps |input_data_| alive; this is either the frame or the decrypted copy.
+  std::shared_ptr<const void> input_owner_;
   const uint8_t* input_data_;
   size_t input_data_size_;
   std::vector<std::shared_ptr<DecodedFrame>>* output_;
   std::shared_ptr<const StreamInfo> decoder_stream_info_;
 
+  // Video frames are decoded asynchronously; these are used by the output
+  // callback, which can be called on another thread.
+  Mutex output_mutex_;
+  std::unordered_map<uint64_t, FrameInfo> frames_in_flight_;
+  uint64_t next_frame_id_ = 0;
+  std::vector<std::shared_ptr<DecodedFrame>> decoded_frames_;
+
   util::CFRef<VTDecompressionSessionRef> vt_session_;
   util::CFRef<CMVideoFormatDescriptionRef> format_desc_;
 
@@ -87,6 +117,7 @@ class AppleDecoder : public Decoder {
                   OSStatus(*)(AudioConverterRef)>
       at_session_;
   AudioStreamPacketDescription audio_desc_;
+  size_t audio_samples_per_packet_ = 0;
 };
 
 }  // namespace apple
@@ -0,0 +1,320 @@
+// Copyright 2020 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     https://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "src/media/apple/sdl_iosurface_drawer.h"
+
+#define GL_SILENCE_DEPRECATION
+#include <IOSurface/IOSurface.h>
+#include <OpenGL/CGLCurrent.h>
+#include <OpenGL/CGLIOSurface.h>
+#include <OpenGL/gl.h>
+#include <OpenGL/glext.h>
+#include <glog/logging.h>
+#include <string.h>
+
+namespace shaka {
+namespace media {
+namespace apple {
+
+namespace {
+
+constexpr const char* kVertexShader = R"(
+#version 120
+varying vec2 coord;
+void main() {
+  gl_Position = gl_Vertex;
+  coord = gl_MultiTexCoord0.xy;
+}
+)";
+
+// The planes are bound as rectangle textures, so the coordinates are in
+// pixels; the chroma plane is half the size of the luma plane.
+constexpr const char* kFragmentShader = R"(
+#version 120
+#extension GL_ARB_texture_rectangle : enable
+uniform sampler2DRect y_plane;
+uniform sampler2DRect uv_plane;
+uniform mat3 yuv_matrix;
+uniform vec3 yuv_offset;
+varying vec2 coord;
+void main() {
+  vec3 yuv = vec3(texture2DRect(y_plane, coord).r,
+                  texture2DRect(uv_plane, coord / 2.0).ra);
+  gl_FragColor = vec4(yuv_matrix * (yuv - yuv_offset), 1.0);
+}
+)";
+
+GLuint CompileShader(GLenum type, const char* source) {
+  GLuint shader = glCreateShader(type);
+  glShaderSource(shader, 1, &source, nullptr);
+  glCompileShader(shader);
+  GLint status = GL_FALSE;
+  glGetShaderiv(shader, GL_COMPILE_STATUS, &status);
+  if (status != GL_TRUE) {
+    char log[512];
+    glGetShaderInfoLog(shader, sizeof(log), nullptr, log);
+    LOG(ERROR) << "Error compiling shader: " << log;
+    glDeleteShader(shader);
+    return 0;
+  }
+  return shader;
+}
+
+/**
+ * Gets the column-major matrix that converts YCbCr values (after subtracting
+ * the offset) to RGB, based on the buffer's color attachments.
+ */
+void GetYuvMatrix(CVPixelBufferRef pixel_buffer, bool full_range,
+                  GLfloat* matrix, GLfloat* offset) {
+  CFTypeRef color_matrix = CVBufferGetAttachment(
+      pixel_buffer, kCVImageBufferYCbCrMatrixKey, nullptr);
+  // Assume BT.709 unless told otherwise, since that is used for HD content.
+  double kr = 0.2126;
+  double kb = 0.0722;
+  if (color_matrix &&
+      CFEqual(color_matrix, kCVImageBufferYCbCrMatrix_ITU_R_601_4)) {
+    kr = 0.299;
+    kb = 0.114;
+  }
+  const double kg = 1 - kr - kb;
+
+  const double y_scale = full_range ? 1 : 255.0 / 219;
+  const double c_scale = full_range ? 1 : 255.0 / 224;
+  const GLfloat values[] = {
+      // Y column.
+      static_cast<GLfloat>(y_scale),
+      static_cast<GLfloat>(y_scale),
+      static_cast<GLfloat>(y_scale),
+      // Cb column.
+      0,
+      static_cast<GLfloat>(-c_scale * 2 * kb * (1 - kb) / kg),
+      static_cast<GLfloat>(c_scale * 2 * (1 - kb)),
+      // Cr column.
+      static_cast<GLfloat>(c_scale * 2 * (1 - kr)),
+      static_cast<GLfloat>(-c_scale * 2 * kr * (1 - kr) / kg),
+      0,
+  };
+  memcpy(matrix, values, sizeof(values));
+
+  offset[0] = full_range ? 0 : 16.0f / 255;
+  offset[1] = offset[2] = 128.0f / 255;
+}
+
+}  // namespace
+
+SdlIOSurfaceDrawer::SdlIOSurfaceDrawer()
+    : program_(0),
+      framebuffer_(0),
+      plane_textures_{0, 0},
+      matrix_location_(-1),
+      offset_location_(-1),
+      initialized_(false) {}
+
+SdlIOSurfaceDrawer::~SdlIOSurfaceDrawer() {}
+
+// static
+bool SdlIOSurfaceDrawer::IsRendererSupported(SDL_Renderer* renderer) {
+  SDL_RendererInfo info;
+  return renderer && SDL_GetRendererInfo(renderer, &info) == 0 &&
+         strcmp(info.name, "opengl") == 0 &&
+         (info.flags & SDL_RENDERER_TARGETTEXTURE);
+}
+
+void SdlIOSurfaceDrawer::Reset() {
+  initialized_ = false;
+  program_ = framebuffer_ = 0;
+  plane_textures_[0] = plane_textures_[1] = 0;
+}
+
+bool SdlIOSurfaceDrawer::Draw(SDL_Renderer* renderer, SDL_Texture* texture,
+                              CVPixelBufferRef pixel_buffer) {
+  const OSType type = CVPixelBufferGetPixelFormatType(pixel_buffer);
+  if (type != kCVPixelFormatType_420YpCbCr8BiPlanarVideoRange &&
+      type != kCVPixelFormatType_420YpCbCr8BiPlanarFullRange) {
+    return false;
+  }
+  IOSurfaceRef surface = CVPixelBufferGetIOSurface(pixel_buffer);
+  if (!surface)
+    return false;
+
+#if SDL_VERSION_ATLEAST(2, 0, 10)
+  // Submit any batched SDL commands before changing the GL state.
+  SDL_RenderFlush(renderer);
+#endif
+
+  // Binding the texture makes the renderer's GL context current and lets us
+  // find the GL texture behind it.
+  float tex_width, tex_height;
+  if (SDL_GL_BindTexture(texture, &tex_width, &tex_height) < 0) {
+    LOG(ERROR) << "Error binding texture: " << SDL_GetError();
+    return false;
+  }
+  GLenum target_type = GL_TEXTURE_2D;
+  GLint target_texture = 0;
+  glGetIntegerv(GL_TEXTURE_BINDING_2D, &target_texture);
+  if (!target_texture) {
+    target_type = GL_TEXTURE_RECTANGLE_ARB;
+    glGetIntegerv(GL_TEXTURE_BINDING_RECTANGLE_ARB, &target_texture);
+  }
+  SDL_GL_UnbindTexture(texture);
+  if (!target_texture || !Initialize())
+    return false;
+
+  // Save any state we change so SDL's cached state stays valid.
+  GLint old_program, old_framebuffer, old_active_texture;
+  GLint old_viewport[4];
+  GLint old_plane_textures[2];
+  glGetIntegerv(GL_CURRENT_PROGRAM, &old_program);
+  glGetIntegerv(GL_FRAMEBUFFER_BINDING_EXT, &old_framebuffer);
+  glGetIntegerv(GL_ACTIVE_TEXTURE, &old_active_texture);
+  glGetIntegerv(GL_VIEWPORT, old_viewport);
+  const GLboolean old_blend = glIsEnabled(GL_BLEND);
+  const GLboolean old_scissor = glIsEnabled(GL_SCISSOR_TEST);
+
+  bool ok = true;
+  CGLContextObj context = CGLGetCurrentContext();
+  for (GLuint i = 0; i < 2; i++) {
+    // Legacy GL contexts don't have red/red-green formats, so use luminance.
+    const GLenum format = i == 0 ? GL_LUMINANCE : GL_LUMINANCE_ALPHA;
+    glActiveTexture(GL_TEXTURE0 + i);
+    glGetIntegerv(GL_TEXTURE_BINDING_RECTANGLE_ARB, &old_plane_textures[i]);
+    glBindTexture(GL_TEXTURE_RECTANGLE_ARB, plane_textures_[i]);
+    const CGLError error = CGLTexImageIOSurface2D(
+        context, GL_TEXTURE_RECTANGLE_ARB, format,
+        IOSurfaceGetWidthOfPlane(surface, i),
+        IOSurfaceGetHeightOfPlane(surface, i), format, GL_UNSIGNED_BYTE,
+        surface, i);
+    if (error != kCGLNoError) {
+      LOG(ERROR) << "Error binding IOSurface: " << CGLErrorString(error);
+      ok = false;
+    }
+  }
+
+  glBindFramebufferEXT(GL_FRAMEBUFFER_EXT, framebuffer_);
+  glFramebufferTexture2DEXT(GL_FRAMEBUFFER_EXT, GL_COLOR_ATTACHMENT0_EXT,
+                            target_type, target_texture, 0);
+  if (ok && glCheckFramebufferStatusEXT(GL_FRAMEBUFFER_EXT) !=
+                GL_FRAMEBUFFER_COMPLETE_EXT) {
+    LOG(ERROR) << "SDL texture can't be used as a framebuffer";
+    ok = false;
+  }
+
+  if (ok) {
+    const GLfloat width = IOSurfaceGetWidthOfPlane(surface, 0);
+    const GLfloat height = IOSurfaceGetHeightOfPlane(surface, 0);
+    GLfloat matrix[9];
+    GLfloat offset[3];
+    GetYuvMatrix(pixel_buffer,
+                 type == kCVPixelFormatType_420YpCbCr8BiPlanarFullRange,
+                 matrix, offset);
+
+    glViewport(0, 0, width, height);
+    glDisable(GL_BLEND);
+    glDisable(GL_SCISSOR_TEST);
+    glUseProgram(program_);
+    glUniformMatrix3fv(matrix_location_, 1, GL_FALSE, matrix);
+    glUniform3fv(offset_location_, 1, offset);
+
+    // SDL expects the top row of the image at the start of the texture, which
+    // is the bottom of the framebuffer.
+    glBegin(GL_TRIANGLE_STRIP);
+    glTexCoord2f(0, 0);
+    glVertex2f(-1, -1);
+    glTexCoord2f(width, 0);
+    glVertex2f(1, -1);
+    glTexCoord2f(0, height);
+    glVertex2f(-1, 1);
+    glTexCoord2f(width, height);
+    glVertex2f(1, 1);
+    glEnd();
+  }
+
+  glFramebufferTexture2DEXT(GL_FRAMEBUFFER_EXT, GL_COLOR_ATTACHMENT0_EXT,
+                            target_type, 0, 0);
+  glBindFramebufferEXT(GL_FRAMEBUFFER_EXT, old_framebuffer);
+  for (GLuint i = 0; i < 2; i++) {
+    glActiveTexture(GL_TEXTURE0 + i);
+    glBindTexture(GL_TEXTURE_RECTANGLE_ARB, old_plane_textures[i]);
+  }
+  glActiveTexture(old_active_texture);
+  glUseProgram(old_program);
+  glViewport(old_viewport[0], old_viewport[1], old_viewport[2],
+             old_viewport[3]);
+  if (old_blend)
+    glEnable(GL_BLEND);
+  if (old_scissor)
+    glEnable(GL_SCISSOR_TEST);
+  return ok;
+}
+
+bool SdlIOSurfaceDrawer::Initialize() {
+  if (initialized_)
+    return program_ != 0;
+  initialized_ = true;
+
+  const GLuint vertex = CompileShader(GL_VERTEX_SHADER, kVertexShader);
+  const GLuint fragment = CompileShader(GL_FRAGMENT_SHADER, kFragmentShader);
+  if (!vertex || !fragment) {
+    glDeleteShader(vertex);
+    glDeleteShader(fragment);
+    return false;
+  }
+
+  GLuint program = glCreateProgram();
+  glAttachShader(program, vertex);
+  glAttachShader(program, fragment);
+  glLinkProgram(program);
+  glDeleteShader(vertex);
+  glDeleteShader(fragment);
+  GLint status = GL_FALSE;
+  glGetProgramiv(program, GL_LINK_STATUS, &status);
+  if (status != GL_TRUE) {
+    LOG(ERROR) << "Error linking shader program";
+    glDeleteProgram(program);
+    return false;
+  }
+
+  GLint old_program;
+  glGetIntegerv(GL_CURRENT_PROGRAM, &old_program);
+  glUseProgram(program);
+  glUniform1i(glGetUniformLocation(program, "y_plane"), 0);
+  glUniform1i(glGetUniformLocation(program, "uv_plane"), 1);
+  glUseProgram(old_program);
+  matrix_location_ = glGetUniformLocation(program, "yuv_matrix");
+  offset_location_ = glGetUniformLocation(program, "yuv_offset");
+
+  GLint old_texture;
+  glGetIntegerv(GL_TEXTURE_BINDING_RECTANGLE_ARB, &old_texture);
+  glGenTextures(2, plane_textures_);
+  for (GLuint plane_texture : plane_textures_) {
+    glBindTexture(GL_TEXTURE_RECTANGLE_ARB, plane_texture);
+    glTexParameteri(GL_TEXTURE_RECTANGLE_ARB, GL_TEXTURE_MIN_FILTER,
+                    GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_RECTANGLE_ARB, GL_TEXTURE_MAG_FILTER,
+                    GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_RECTANGLE_ARB, GL_TEXTURE_WRAP_S,
+                    GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_RECTANGLE_ARB, GL_TEXTURE_WRAP_T,
+                    GL_CLAMP_TO_EDGE);
+  }
+  glBindTexture(GL_TEXTURE_RECTANGLE_ARB, old_texture);
+  glGenFramebuffersEXT(1, &framebuffer_);
+
+  program_ = program;
+  return true;
+}
+
+}  // namespace apple
+}  // namespace media
+}  // namespace shaka
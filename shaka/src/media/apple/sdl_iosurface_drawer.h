@@ -0,0 +1,77 @@
+// Copyright 2020 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     https://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef SHAKA_EMBEDDED_MEDIA_APPLE_SDL_IOSURFACE_DRAWER_H_
+#define SHAKA_EMBEDDED_MEDIA_APPLE_SDL_IOSURFACE_DRAWER_H_
+
+#include <CoreVideo/CoreVideo.h>
+#include <SDL2/SDL.h>
+
+#include "src/util/macros.h"
+
+namespace shaka {
+namespace media {
+namespace apple {
+
+/**
+ * Draws VideoToolbox frames onto SDL textures without copying the pixels
+ * through the CPU.  The planes of the IOSurface behind the CVPixelBuffer are
+ * bound directly as OpenGL textures and converted to RGB by a shader that
+ * renders into the SDL texture.
+ *
+ * This only works with SDL's "opengl" renderer and with textures created with
+ * SDL_TEXTUREACCESS_TARGET.  This must only be used on the render thread.
+ */
+class SdlIOSurfaceDrawer {
+ public:
+  SdlIOSurfaceDrawer();
+  ~SdlIOSurfaceDrawer();
+
+  SHAKA_NON_COPYABLE_OR_MOVABLE_TYPE(SdlIOSurfaceDrawer);
+
+  /** @return Whether the given renderer can be used with this type. */
+  static bool IsRendererSupported(SDL_Renderer* renderer);
+
+  /**
+   * Forgets any GL objects so they are created again for a new renderer.  The
+   * objects are owned by the renderer's GL context, so they are freed when the
+   * old renderer is destroyed.
+   */
+  void Reset();
+
+  /**
+   * Draws the given pixel buffer onto the given texture.  The texture must be
+   * an ARGB8888 target texture with the same size as the pixel buffer.
+   *
+   * @return True on success, false on error.
+   */
+  bool Draw(SDL_Renderer* renderer, SDL_Texture* texture,
+            CVPixelBufferRef pixel_buffer);
+
+ private:
+  bool Initialize();
+
+  unsigned int program_;
+  unsigned int framebuffer_;
+  unsigned int plane_textures_[2];
+  int matrix_location_;
+  int offset_location_;
+  bool initialized_;
+};
+
+}  // namespace apple
+}  // namespace media
+}  // namespace shaka
+
+#endif  // SHAKA_EMBEDDED_MEDIA_APPLE_SDL_IOSURFACE_DRAWER_H_
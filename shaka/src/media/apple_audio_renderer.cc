@@ -17,8 +17,9 @@
 #include <AudioToolbox/AudioToolbox.h>
 #include <glog/logging.h>
 
+#include <algorithm>
 #include <atomic>
-#include <list>
+#include <vector>
 
 #include "src/debug/mutex.h"
 #include "src/media/audio_renderer_common.h"
@@ -50,8 +51,22 @@ namespace media {
 
 namespace {
 
-/** The maximum number of buffers to keep. */
-constexpr const size_t kMaxNumBuffers = 8;
+/**
+ * The number of buffers to allocate for each queue.  Half of these hold the
+ * configured buffer size, which leaves room for buffers the device returned
+ * early and for the one being filled.
+ */
+constexpr const size_t kNumBuffers = 6;
+
+/**
+ * The number of buffers the device should hold.  If it holds fewer, the
+ * buffer being filled is given to the device before it is full so the device
+ * doesn't run out.
+ */
+constexpr const size_t kMinQueuedBuffers = 2;
+
+/** The smallest buffer to allocate, in bytes. */
+constexpr const size_t kMinBufferSize = 4096;
 
 bool SetSampleFormatFields(SampleFormat format,
                            AudioStreamBasicDescription* desc) {
@@ -86,6 +101,11 @@ bool SetSampleFormatFields(SampleFormat format,
       desc->mFormatFlags = kLinearPCMFormatFlagIsFloat;
       desc->mBitsPerChannel = 64;
       return true;
+    case SampleFormat::Iec61937:
+      // AudioQueue doesn't give a way to send the samples to the sink
+      // unchanged.
+      LOG(ERROR) << "Audio passthrough isn't supported by AppleAudioRenderer";
+      return false;
 
     default:
       LOG(DFATAL) << "Unsupported sample format: " << format;
@@ -94,84 +114,166 @@ bool SetSampleFormatFields(SampleFormat format,
 }
 
 /**
- * Contains a list of buffers for use with an AudioQueue.  Buffers are created
- * for a specific queue and are stored by this class until they need to be used.
- * Once we give up a buffer, the audio device will queue that buffer to be
- * played.  Once the device has played the data, the buffer will be returned to
- * this class to be reused.
+ * A fixed pool of buffers for an AudioQueue.  The buffers are allocated when
+ * the queue is created and are recycled once the device has played them, so
+ * playback doesn't allocate.  Appended data is coalesced into the current
+ * buffer, which is given to the device once it is full, or sooner if the
+ * device is running low.  If the pool runs out (e.g. the buffer size was
+ * increased), it grows and keeps the new buffers.
  */
-class BufferList final {
+class BufferPool final {
  public:
-  BufferList() : mutex_("BufferList"), queue_(nullptr) {}
-  ~BufferList() {
-    Reset();
+  BufferPool()
+      : mutex_("BufferPool"),
+        queue_(nullptr),
+        buffer_size_(0),
+        current_(nullptr),
+        queued_count_(0),
+        resetting_(false) {}
+  ~BufferPool() {
+    FreeBuffers();
   }
 
-  void SetQueue(AudioQueueRef q) {
+  /**
+   * Frees the buffers of the old queue and allocates new buffers for the given
+   * queue.  All the buffers must have been returned by the old queue.
+   */
+  bool SetQueue(AudioQueueRef queue, size_t buffer_size) {
     std::unique_lock<Mutex> lock(mutex_);
-    Reset();
-    queue_ = q;
+    DCHECK_EQ(queued_count_, 0u);
+    FreeBuffers();
+    queue_ = queue;
+    buffer_size_ = buffer_size;
+    buffers_.reserve(kNumBuffers);
+    free_.reserve(kNumBuffers);
+    for (size_t i = 0; i < kNumBuffers; i++) {
+      if (!AllocateBuffer())
+        return false;
+    }
+    return true;
   }
 
-  AudioQueueBufferRef FindBuffer(size_t size) {
+  /**
+   * Copies the given data into the buffers, giving them to the device as they
+   * fill.
+   */
+  bool Append(const uint8_t* data, size_t size) {
     std::unique_lock<Mutex> lock(mutex_);
-    // Look for a buffer that is the exact requested size; if there isn't one
-    // available, look for one that is larger than needed.
-    auto found = buffers_.end();
-    auto capacity = [](decltype(found) it) {
-      return (*it)->mAudioDataBytesCapacity;
-    };
-    for (auto it = buffers_.begin(); it != buffers_.end(); it++) {
-      if (capacity(it) == size) {
-        found = it;
-        break;
-      } else if (capacity(it) > size &&
-                 (found == buffers_.end() || capacity(it) < capacity(found))) {
-        // Use the smallest buffer we can, but favor earlier elements.
-        found = it;
+    while (size > 0) {
+      if (!current_) {
+        if (free_.empty() && !AllocateBuffer())
+          return false;
+        current_ = free_.back();
+        free_.pop_back();
+        current_->mAudioDataByteSize = 0;
+        current_->mPacketDescriptionCount = 0;
       }
-    }
 
-    if (found != buffers_.end()) {
-      auto* ret = *found;
-      buffers_.erase(found);
-      return ret;
+      const size_t used = current_->mAudioDataByteSize;
+      const size_t to_copy =
+          std::min<size_t>(size, current_->mAudioDataBytesCapacity - used);
+      memcpy(static_cast<uint8_t*>(current_->mAudioData) + used, data,
+             to_copy);
+      current_->mAudioDataByteSize += to_copy;
+      data += to_copy;
+      size -= to_copy;
+      if (current_->mAudioDataByteSize == current_->mAudioDataBytesCapacity &&
+          !EnqueueCurrent()) {
+        return false;
+      }
     }
 
-    AudioQueueBufferRef ret;
-    const auto status = AudioQueueAllocateBuffer(queue_, size, &ret);
-    if (status != 0) {
-      LOG(DFATAL) << "Error creating AudioQueueBuffer: " << status;
-      return nullptr;
-    }
+    if (current_ && queued_count_ < kMinQueuedBuffers)
+      return EnqueueCurrent();
+    return true;
+  }
+
+  /** Called when the device returns a buffer once it has been played. */
+  void OnBufferPlayed(AudioQueueBufferRef buffer) {
+    std::unique_lock<Mutex> lock(mutex_);
+    DCHECK_GT(queued_count_, 0u);
+    queued_count_--;
+    free_.emplace_back(buffer);
+    if (!resetting_ && current_ && queued_count_ < kMinQueuedBuffers)
+      EnqueueCurrent();
+  }
+
+  /**
+   * Drops the data that hasn't been given to the device and stops giving
+   * buffers to the device until EndReset is called.  This is called before
+   * resetting the queue, which returns the device's buffers.
+   *
+   * @return The number of bytes dropped.
+   */
+  size_t BeginReset() {
+    std::unique_lock<Mutex> lock(mutex_);
+    resetting_ = true;
+    if (!current_)
+      return 0;
+    const size_t ret = current_->mAudioDataByteSize;
+    free_.emplace_back(current_);
+    current_ = nullptr;
     return ret;
   }
 
-  void ReuseBuffer(AudioQueueBufferRef buffer) {
+  void EndReset() {
     std::unique_lock<Mutex> lock(mutex_);
-    buffers_.emplace_front(buffer);
-    while (buffers_.size() > kMaxNumBuffers) {
-      FreeBuffer(buffers_.back());
-      buffers_.pop_back();
-    }
+    resetting_ = false;
   }
 
  private:
-  void Reset() {
-    for (auto* buf : buffers_)
-      FreeBuffer(buf);
-    buffers_.clear();
+  bool AllocateBuffer() {
+    AudioQueueBufferRef buffer;
+    const auto status = AudioQueueAllocateBuffer(queue_, buffer_size_, &buffer);
+    if (status != 0) {
+      LOG(DFATAL) << "Error creating AudioQueueBuffer: " << status;
+      return false;
+    }
+    if (buffers_.size() >= kNumBuffers)
+      VLOG(1) << "Growing AudioQueue buffer pool to " << buffers_.size() + 1;
+    buffers_.emplace_back(buffer);
+    free_.reserve(buffers_.size());
+    free_.emplace_back(buffer);
+    return true;
   }
 
-  void FreeBuffer(AudioQueueBufferRef buffer) {
-    const auto status = AudioQueueFreeBuffer(queue_, buffer);
-    if (status != 0)
-      LOG(DFATAL) << "Error freeing AudioQueueBuffer: " << status;
+  bool EnqueueCurrent() {
+    const auto status = AudioQueueEnqueueBuffer(queue_, current_, 0, nullptr);
+    if (status != 0) {
+      LOG(DFATAL) << "Error queuing AudioQueueBuffer: " << status;
+      free_.emplace_back(current_);
+      current_ = nullptr;
+      return false;
+    }
+    queued_count_++;
+    current_ = nullptr;
+    return true;
+  }
+
+  void FreeBuffers() {
+    for (auto* buffer : buffers_) {
+      const auto status = AudioQueueFreeBuffer(queue_, buffer);
+      if (status != 0)
+        LOG(DFATAL) << "Error freeing AudioQueueBuffer: " << status;
+    }
+    buffers_.clear();
+    free_.clear();
+    current_ = nullptr;
   }
 
   Mutex mutex_;
   AudioQueueRef queue_;
-  std::list<AudioQueueBufferRef> buffers_;
+  // The size of each buffer, in bytes.
+  size_t buffer_size_;
+  // All the buffers, so they can be freed.
+  std::vector<AudioQueueBufferRef> buffers_;
+  // The buffers that can be filled.
+  std::vector<AudioQueueBufferRef> free_;
+  // The buffer being filled, if any.
+  AudioQueueBufferRef current_;
+  // The number of buffers the device holds.
+  size_t queued_count_;
+  bool resetting_;
 };
 
 }  // namespace
@@ -212,37 +314,42 @@ class AppleAudioRenderer::Impl : public AudioRendererCommon {
       return false;
     }
 
+    // Size the buffers so half of the pool holds the configured buffer size.
+    // The buffers hold whole audio frames.
+    const size_t bytes_per_second = desc.mBytesPerFrame * desc.mSampleRate;
+    const double buffer_seconds = BufferSize() / (kNumBuffers / 2);
+    size_t buffer_size = std::max(
+        static_cast<size_t>(buffer_seconds * bytes_per_second), kMinBufferSize);
+    buffer_size -= buffer_size % desc.mBytesPerFrame;
+
     queue_size_.store(0, std::memory_order_relaxed);
-    buffers_.SetQueue(q);
-    // Update queue_ after updating buffers_ so the buffer list can free the
+    const bool allocated = buffers_.SetQueue(q, buffer_size);
+    // Update queue_ after updating buffers_ so the buffer pool can free the
     // old buffers while the old queue is still valid.
     queue_ = q;
+    if (!allocated)
+      return false;
     UpdateVolume(volume);
     return true;
   }
 
   bool AppendBuffer(const uint8_t* data, size_t size) override {
-    auto* buffer = buffers_.FindBuffer(size);
-    if (!buffer)
-      return false;
-
-    memcpy(buffer->mAudioData, data, size);
+    // Count the data before giving it to the device, since the device may
+    // return the buffer before this returns.
     queue_size_.fetch_add(size, std::memory_order_relaxed);
-    buffer->mAudioDataByteSize = size;
-    buffer->mPacketDescriptionCount = 0;
-    const auto status = AudioQueueEnqueueBuffer(queue_, buffer, 0, nullptr);
-    if (status != 0)
-      LOG(DFATAL) << "Error queuing AudioQueueBuffer: " << status;
-    return status == 0;
+    return buffers_.Append(data, size);
   }
 
   void ClearBuffer() override {
     if (!queue_)
       return;
 
+    // Drop the buffer being filled, then have the device return the rest.
+    queue_size_.fetch_sub(buffers_.BeginReset(), std::memory_order_relaxed);
     const auto status = AudioQueueReset(queue_);
     if (status != 0)
       LOG(DFATAL) << "Error clearing AudioQueue: " << status;
+    buffers_.EndReset();
     DCHECK_EQ(GetBytesBuffered(), 0);  // Should have all buffers returned to us
   }
 
@@ -285,11 +392,11 @@ class AppleAudioRenderer::Impl : public AudioRendererCommon {
     impl->queue_size_.fetch_sub(buffer->mAudioDataByteSize,
                                 std::memory_order_relaxed);
 
-    impl->buffers_.ReuseBuffer(buffer);
+    impl->buffers_.OnBufferPlayed(buffer);
   }
 
   util::CFRef<AudioQueueRef> queue_;
-  BufferList buffers_;
+  BufferPool buffers_;
   // Tracks the number of bytes buffered by the audio device.
   std::atomic<size_t> queue_size_;
 };
@@ -298,6 +405,14 @@ AppleAudioRenderer::AppleAudioRenderer() : impl_(new Impl) {}
 
 AppleAudioRenderer::~AppleAudioRenderer() {}
 
+void AppleAudioRenderer::SetBufferSize(double seconds) {
+  impl_->SetBufferSize(seconds);
+}
+
+void AppleAudioRenderer::SetPrerollWhilePaused(bool preroll) {
+  impl_->SetPrerollWhilePaused(preroll);
+}
+
 void AppleAudioRenderer::SetPlayer(const MediaPlayer* player) {
   impl_->SetPlayer(player);
 }
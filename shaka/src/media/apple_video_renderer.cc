@@ -16,7 +16,13 @@
 
 #include <glog/logging.h>
 
+#include <atomic>
+#include <utility>
+
+#include "src/media/pixel_conversion.h"
 #include "src/media/video_renderer_common.h"
+#include "src/util/cfref.h"
+#include "src/util/macros.h"
 
 namespace shaka {
 namespace media {
@@ -39,46 +45,253 @@ void FreeFramePlanar(void* info, const void*, size_t, size_t, const void**) {
   delete frame;
 }
 
+void FreeFramePacked(void* info, const void*) {
+  auto* frame = reinterpret_cast<FrameInfo*>(info);
+  delete frame;
+}
+
+void WriteBigEndian(uint32_t value, size_t size, uint8_t* dest) {
+  for (size_t i = 0; i < size; i++)
+    dest[i] = static_cast<uint8_t>(value >> (8 * (size - i - 1)));
+}
+
+CFStringRef GetColorPrimaries(uint8_t code_point) {
+  switch (code_point) {
+    case 1:
+      return kCVImageBufferColorPrimaries_ITU_R_709_2;
+    case 9:
+      return kCVImageBufferColorPrimaries_ITU_R_2020;
+    case 12:
+      return kCVImageBufferColorPrimaries_P3_D65;
+    default:
+      return nullptr;
+  }
+}
+
+CFStringRef GetTransferFunction(uint8_t code_point) {
+  switch (code_point) {
+    case 1:
+    case 6:
+    case 14:
+    case 15:
+      return kCVImageBufferTransferFunction_ITU_R_709_2;
+    case HdrMetadata::kTransferPq:
+      if (__builtin_available(macOS 10.13, iOS 11.0, *))
+        return kCVImageBufferTransferFunction_SMPTE_ST_2084_PQ;
+      return nullptr;
+    case HdrMetadata::kTransferHlg:
+      if (__builtin_available(macOS 10.13, iOS 11.0, *))
+        return kCVImageBufferTransferFunction_ITU_R_2100_HLG;
+      return nullptr;
+    default:
+      return nullptr;
+  }
+}
+
+CFStringRef GetYCbCrMatrix(uint8_t code_point) {
+  switch (code_point) {
+    case 1:
+      return kCVImageBufferYCbCrMatrix_ITU_R_709_2;
+    case 5:
+    case 6:
+      return kCVImageBufferYCbCrMatrix_ITU_R_601_4;
+    case 9:
+      return kCVImageBufferYCbCrMatrix_ITU_R_2020;
+    default:
+      return nullptr;
+  }
+}
+
+/**
+ * Attaches the given color and HDR metadata to the buffer so the system
+ * renders it without it being tone mapped here.  Buffers from VideoToolbox
+ * already have this from the bitstream, so existing values are kept.
+ */
+void AttachHdrMetadata(const HdrMetadata& metadata, CVPixelBufferRef buffer) {
+  const struct {
+    CFStringRef key;
+    CFStringRef value;
+  } kColorAttachments[] = {
+      {kCVImageBufferColorPrimariesKey,
+       GetColorPrimaries(metadata.color_primaries)},
+      {kCVImageBufferTransferFunctionKey,
+       GetTransferFunction(metadata.transfer_characteristics)},
+      {kCVImageBufferYCbCrMatrixKey,
+       GetYCbCrMatrix(metadata.matrix_coefficients)},
+  };
+  for (auto& attachment : kColorAttachments) {
+    if (attachment.value &&
+        !CVBufferGetAttachment(buffer, attachment.key, nullptr)) {
+      CVBufferSetAttachment(buffer, attachment.key, attachment.value,
+                            kCVAttachmentMode_ShouldPropagate);
+    }
+  }
+
+  if (__builtin_available(macOS 10.13, iOS 11.0, *)) {
+    // These use the same big-endian layout as the SEI messages.
+    if (metadata.has_mastering_display &&
+        !CVBufferGetAttachment(
+            buffer, kCVImageBufferMasteringDisplayColorVolumeKey, nullptr)) {
+      uint8_t data[24];
+      for (size_t i = 0; i < 3; i++) {
+        WriteBigEndian(metadata.display_primaries_x[i], 2, data + i * 4);
+        WriteBigEndian(metadata.display_primaries_y[i], 2, data + i * 4 + 2);
+      }
+      WriteBigEndian(metadata.white_point_x, 2, data + 12);
+      WriteBigEndian(metadata.white_point_y, 2, data + 14);
+      WriteBigEndian(metadata.max_display_mastering_luminance, 4, data + 16);
+      WriteBigEndian(metadata.min_display_mastering_luminance, 4, data + 20);
+      util::CFRef<CFDataRef> value(
+          CFDataCreate(kCFAllocatorDefault, data, sizeof(data)));
+      CVBufferSetAttachment(buffer,
+                            kCVImageBufferMasteringDisplayColorVolumeKey, value,
+                            kCVAttachmentMode_ShouldPropagate);
+    }
+    if (metadata.has_content_light_level &&
+        !CVBufferGetAttachment(buffer, kCVImageBufferContentLightLevelInfoKey,
+                               nullptr)) {
+      uint8_t data[4];
+      WriteBigEndian(metadata.max_content_light_level, 2, data);
+      WriteBigEndian(metadata.max_frame_average_light_level, 2, data + 2);
+      util::CFRef<CFDataRef> value(
+          CFDataCreate(kCFAllocatorDefault, data, sizeof(data)));
+      CVBufferSetAttachment(buffer, kCVImageBufferContentLightLevelInfoKey,
+                            value, kCVAttachmentMode_ShouldPropagate);
+    }
+  }
+}
+
 }  // namespace
 
 class AppleVideoRenderer::Impl final : public VideoRendererCommon {
  public:
+  Impl() : frame_rate_(0) {}
+
   CGImageRef Render(double* delay, Rational<uint32_t>* sample_aspect_ratio);
+  CVPixelBufferRef RenderPixelBuffer(double* delay,
+                                     Rational<uint32_t>* sample_aspect_ratio);
+  CVPixelBufferRef RenderPixelBufferForVsync(
+      double vsync_delay, double refresh_interval,
+      Rational<uint32_t>* sample_aspect_ratio);
+
+  double FrameRate() const {
+    return frame_rate_.load(std::memory_order_relaxed);
+  }
 
  private:
+  std::shared_ptr<DecodedFrame> GetNewFrame(
+      double* delay, Rational<uint32_t>* sample_aspect_ratio);
+  /**
+   * Records the given frame as the one being shown.
+   * @return The frame, or nullptr if it is the same as the previous frame.
+   */
+  std::shared_ptr<DecodedFrame> AcceptFrame(
+      std::shared_ptr<DecodedFrame> frame,
+      Rational<uint32_t>* sample_aspect_ratio);
+  CVPixelBufferRef MakePixelBuffer(std::shared_ptr<DecodedFrame> frame);
   CGImageRef RenderPackedFrame(std::shared_ptr<DecodedFrame> frame);
   CGImageRef RenderPlanarFrame(std::shared_ptr<DecodedFrame> frame);
+  CVPixelBufferRef MakePackedPixelBuffer(std::shared_ptr<DecodedFrame> frame);
+  CVPixelBufferRef MakePlanarPixelBuffer(std::shared_ptr<DecodedFrame> frame);
+  CVPixelBufferRef MakeTenBitPixelBuffer(std::shared_ptr<DecodedFrame> frame);
 
   std::shared_ptr<DecodedFrame> prev_frame_;
+  std::atomic<double> frame_rate_;
 };
 
 CGImageRef AppleVideoRenderer::Impl::Render(
     double* delay, Rational<uint32_t>* sample_aspect_ratio) {
-  std::shared_ptr<DecodedFrame> frame;
-  const double loc_delay = GetCurrentFrame(&frame);
-  if (delay)
-    *delay = loc_delay;
-
-  if (!frame || frame == prev_frame_)
+  auto frame = GetNewFrame(delay, sample_aspect_ratio);
+  if (!frame)
     return nullptr;
 
-  if (sample_aspect_ratio)
-    *sample_aspect_ratio = frame->stream_info->sample_aspect_ratio;
-  prev_frame_ = frame;
   switch (get<PixelFormat>(frame->format)) {
     case PixelFormat::RGB24:
       return RenderPackedFrame(frame);
 
     case PixelFormat::VideoToolbox:
     case PixelFormat::YUV420P:
+    case PixelFormat::YUV420P10:
+    case PixelFormat::P010:
       return RenderPlanarFrame(frame);
 
+    case PixelFormat::SecureSurface:
+      LOG_ONCE(ERROR) << "Secure frames can't be drawn as images";
+      return nullptr;
+
     default:
       LOG(DFATAL) << "Unsupported pixel format: " << frame->format;
       return nullptr;
   }
 }
 
+CVPixelBufferRef AppleVideoRenderer::Impl::RenderPixelBuffer(
+    double* delay, Rational<uint32_t>* sample_aspect_ratio) {
+  return MakePixelBuffer(GetNewFrame(delay, sample_aspect_ratio));
+}
+
+CVPixelBufferRef AppleVideoRenderer::Impl::RenderPixelBufferForVsync(
+    double vsync_delay, double refresh_interval,
+    Rational<uint32_t>* sample_aspect_ratio) {
+  std::shared_ptr<DecodedFrame> frame;
+  GetFrameForVsync(vsync_delay, refresh_interval, &frame);
+  return MakePixelBuffer(AcceptFrame(frame, sample_aspect_ratio));
+}
+
+CVPixelBufferRef AppleVideoRenderer::Impl::MakePixelBuffer(
+    std::shared_ptr<DecodedFrame> frame) {
+  if (!frame)
+    return nullptr;
+
+  switch (get<PixelFormat>(frame->format)) {
+    case PixelFormat::RGB24:
+      return MakePackedPixelBuffer(frame);
+
+    case PixelFormat::VideoToolbox:
+    case PixelFormat::YUV420P:
+    case PixelFormat::YUV420P10:
+    case PixelFormat::P010:
+      return MakePlanarPixelBuffer(frame);
+
+    case PixelFormat::SecureSurface:
+      LOG_ONCE(ERROR) << "Secure frames can't be copied to pixel buffers";
+      return nullptr;
+
+    default:
+      LOG(DFATAL) << "Unsupported pixel format: " << frame->format;
+      return nullptr;
+  }
+}
+
+std::shared_ptr<DecodedFrame> AppleVideoRenderer::Impl::GetNewFrame(
+    double* delay, Rational<uint32_t>* sample_aspect_ratio) {
+  std::shared_ptr<DecodedFrame> frame;
+  const double loc_delay = GetCurrentFrame(&frame);
+  if (delay)
+    *delay = loc_delay;
+  return AcceptFrame(frame, sample_aspect_ratio);
+}
+
+std::shared_ptr<DecodedFrame> AppleVideoRenderer::Impl::AcceptFrame(
+    std::shared_ptr<DecodedFrame> frame,
+    Rational<uint32_t>* sample_aspect_ratio) {
+  if (!frame || frame == prev_frame_)
+    return nullptr;
+
+  // Not every container gives frame durations, so fall back to the time since
+  // the previous frame.
+  double interval = frame->duration;
+  if (interval <= 0 && prev_frame_)
+    interval = frame->pts - prev_frame_->pts;
+  if (interval > 0 && interval < 1)
+    frame_rate_.store(1 / interval, std::memory_order_relaxed);
+
+  if (sample_aspect_ratio)
+    *sample_aspect_ratio = frame->stream_info->sample_aspect_ratio;
+  prev_frame_ = frame;
+  return frame;
+}
+
 CGImageRef AppleVideoRenderer::Impl::RenderPackedFrame(
     std::shared_ptr<DecodedFrame> frame) {
   const uint32_t width = frame->stream_info->width;
@@ -119,28 +332,104 @@ CGImageRef AppleVideoRenderer::Impl::RenderPackedFrame(
 
 CGImageRef AppleVideoRenderer::Impl::RenderPlanarFrame(
     std::shared_ptr<DecodedFrame> frame) {
+  CVPixelBufferRef pixel_buffer = MakePlanarPixelBuffer(frame);
+  if (!pixel_buffer)
+    return nullptr;
+
+  CGImage* ret;
+  // This retains the buffer, so the Frame is free to be deleted.
+  const auto status =
+      VTCreateCGImageFromCVPixelBuffer(pixel_buffer, nullptr, &ret);
+  CVPixelBufferRelease(pixel_buffer);
+
+  if (status != 0) {
+    LOG(ERROR) << "VTCreateCGImageFromCVPixelBuffer error " << status;
+    return nullptr;
+  }
+  return ret;
+}
+
+CVPixelBufferRef AppleVideoRenderer::Impl::MakePackedPixelBuffer(
+    std::shared_ptr<DecodedFrame> frame) {
+  // This wraps the frame's data, so the frame is kept alive until the buffer
+  // is destroyed.
+  auto* info = new FrameInfo;
+  info->frame = frame;
   CVPixelBufferRef pixel_buffer;
-  bool free_pixel_buffer;
+  const auto status = CVPixelBufferCreateWithBytes(
+      nullptr, frame->stream_info->width, frame->stream_info->height,
+      kCVPixelFormatType_24RGB, const_cast<uint8_t*>(frame->data[0]),
+      frame->linesize[0], &FreeFramePacked, info, nullptr, &pixel_buffer);
+  if (status != 0) {
+    LOG(ERROR) << "CVPixelBufferCreateWithBytes error " << status;
+    delete info;
+    return nullptr;
+  }
+  return pixel_buffer;
+}
+
+CVPixelBufferRef AppleVideoRenderer::Impl::MakePlanarPixelBuffer(
+    std::shared_ptr<DecodedFrame> frame) {
   auto pix_fmt = get<PixelFormat>(frame->format);
   if (pix_fmt == shaka::media::PixelFormat::VideoToolbox) {
+    // The decoder already produced an IOSurface-backed buffer, so just use it.
     uint8_t* data = const_cast<uint8_t*>(frame->data[0]);
-    pixel_buffer = reinterpret_cast<CVPixelBufferRef>(data);
-    free_pixel_buffer = false;
-  } else {
-    if (pix_fmt != PixelFormat::YUV420P)
-      return nullptr;
+    auto* pixel_buffer = reinterpret_cast<CVPixelBufferRef>(data);
+    AttachHdrMetadata(frame->GetHdrMetadata(), pixel_buffer);
+    return CVPixelBufferRetain(pixel_buffer);
+  }
+  if (pix_fmt == PixelFormat::YUV420P10 || pix_fmt == PixelFormat::P010)
+    return MakeTenBitPixelBuffer(frame);
+  if (pix_fmt != PixelFormat::YUV420P)
+    return nullptr;
+
+  const OSType cv_pix_fmt = kCVPixelFormatType_420YpCbCr8Planar;
+  auto* info = new FrameInfo;
+  info->frame = frame;
+  info->widths[0] = frame->stream_info->width;
+  info->widths[1] = info->widths[2] = frame->stream_info->width / 2;
+  info->heights[0] = frame->stream_info->height;
+  info->heights[1] = info->heights[2] = frame->stream_info->height / 2;
+
+  CVPixelBufferRef pixel_buffer;
+  const auto status = CVPixelBufferCreateWithPlanarBytes(
+      nullptr, frame->stream_info->width, frame->stream_info->height,
+      cv_pix_fmt, nullptr, 0, frame->data.size(),
+      reinterpret_cast<void**>(const_cast<uint8_t**>(frame->data.data())),
+      info->widths, info->heights, const_cast<size_t*>(frame->linesize.data()),
+      &FreeFramePlanar, info, nullptr, &pixel_buffer);
+  if (status != 0) {
+    LOG(ERROR) << "CVPixelBufferCreateWithPlanarBytes error " << status;
+    delete info;
+    return nullptr;
+  }
+  return pixel_buffer;
+}
+
+CVPixelBufferRef AppleVideoRenderer::Impl::MakeTenBitPixelBuffer(
+    std::shared_ptr<DecodedFrame> frame) {
+  // Keep all 10 bits so HDR content is rendered by the system instead of
+  // being reduced to 8 bits here.  P010 matches the CoreVideo format, so it
+  // is wrapped as-is; YUV420P10 has to be repacked into that layout.
+  const HdrMetadata metadata = frame->GetHdrMetadata();
+  const OSType cv_pix_fmt =
+      metadata.full_range ? kCVPixelFormatType_420YpCbCr10BiPlanarFullRange
+                          : kCVPixelFormatType_420YpCbCr10BiPlanarVideoRange;
+  const size_t width = frame->stream_info->width;
+  const size_t height = frame->stream_info->height;
+  const size_t chroma_width = (width + 1) / 2;
+  const size_t chroma_height = (height + 1) / 2;
 
-    const OSType cv_pix_fmt = kCVPixelFormatType_420YpCbCr8Planar;
+  CVPixelBufferRef pixel_buffer;
+  if (get<PixelFormat>(frame->format) == PixelFormat::P010) {
     auto* info = new FrameInfo;
     info->frame = frame;
-    info->widths[0] = frame->stream_info->width;
-    info->widths[1] = info->widths[2] = frame->stream_info->width / 2;
-    info->heights[0] = frame->stream_info->height;
-    info->heights[1] = info->heights[2] = frame->stream_info->height / 2;
-
+    info->widths[0] = width;
+    info->widths[1] = chroma_width;
+    info->heights[0] = height;
+    info->heights[1] = chroma_height;
     const auto status = CVPixelBufferCreateWithPlanarBytes(
-        nullptr, frame->stream_info->width, frame->stream_info->height,
-        cv_pix_fmt, nullptr, 0, frame->data.size(),
+        nullptr, width, height, cv_pix_fmt, nullptr, 0, 2,
         reinterpret_cast<void**>(const_cast<uint8_t**>(frame->data.data())),
         info->widths, info->heights,
         const_cast<size_t*>(frame->linesize.data()), &FreeFramePlanar, info,
@@ -150,22 +439,39 @@ CGImageRef AppleVideoRenderer::Impl::RenderPlanarFrame(
       delete info;
       return nullptr;
     }
+  } else {
+    util::CFRef<CFMutableDictionaryRef> attributes(CFDictionaryCreateMutable(
+        kCFAllocatorDefault, 1, &kCFTypeDictionaryKeyCallBacks,
+        &kCFTypeDictionaryValueCallBacks));
+    util::CFRef<CFDictionaryRef> surface_props(CFDictionaryCreate(
+        kCFAllocatorDefault, nullptr, nullptr, 0,
+        &kCFTypeDictionaryKeyCallBacks, &kCFTypeDictionaryValueCallBacks));
+    CFDictionarySetValue(attributes, kCVPixelBufferIOSurfacePropertiesKey,
+                         surface_props);
+    const auto status = CVPixelBufferCreate(nullptr, width, height, cv_pix_fmt,
+                                            attributes, &pixel_buffer);
+    if (status != 0) {
+      LOG(ERROR) << "CVPixelBufferCreate error " << status;
+      return nullptr;
+    }
 
-    free_pixel_buffer = true;
+    CVPixelBufferLockBaseAddress(pixel_buffer, 0);
+    ShiftPlane16(frame->data[0], frame->linesize[0],
+                 reinterpret_cast<uint8_t*>(
+                     CVPixelBufferGetBaseAddressOfPlane(pixel_buffer, 0)),
+                 CVPixelBufferGetBytesPerRowOfPlane(pixel_buffer, 0), width,
+                 height, 6);
+    InterleavePlanes16(frame->data[1], frame->linesize[1], frame->data[2],
+                       frame->linesize[2],
+                       reinterpret_cast<uint8_t*>(
+                           CVPixelBufferGetBaseAddressOfPlane(pixel_buffer, 1)),
+                       CVPixelBufferGetBytesPerRowOfPlane(pixel_buffer, 1),
+                       chroma_width, chroma_height, 6);
+    CVPixelBufferUnlockBaseAddress(pixel_buffer, 0);
   }
 
-  CGImage* ret;
-  // This retains the buffer, so the Frame is free to be deleted.
-  const auto status =
-      VTCreateCGImageFromCVPixelBuffer(pixel_buffer, nullptr, &ret);
-  if (free_pixel_buffer)
-    CVPixelBufferRelease(pixel_buffer);
-
-  if (status != 0) {
-    LOG(ERROR) << "VTCreateCGImageFromCVPixelBuffer error " << status;
-    return nullptr;
-  }
-  return ret;
+  AttachHdrMetadata(metadata, pixel_buffer);
+  return pixel_buffer;
 }
 
 
@@ -181,6 +487,26 @@ CGImageRef AppleVideoRenderer::Render(double* delay,
   return impl_->Render(delay, sample_aspect_ratio);
 }
 
+CVPixelBufferRef AppleVideoRenderer::RenderPixelBuffer(
+    double* delay, Rational<uint32_t>* sample_aspect_ratio) {
+  return impl_->RenderPixelBuffer(delay, sample_aspect_ratio);
+}
+
+CVPixelBufferRef AppleVideoRenderer::RenderPixelBufferForVsync(
+    double vsync_delay, double refresh_interval,
+    Rational<uint32_t>* sample_aspect_ratio) {
+  return impl_->RenderPixelBufferForVsync(vsync_delay, refresh_interval,
+                                          sample_aspect_ratio);
+}
+
+double AppleVideoRenderer::FrameRate() const {
+  return impl_->FrameRate();
+}
+
+void AppleVideoRenderer::TakeSnapshot(SnapshotCallback callback) const {
+  impl_->TakeSnapshot(std::move(callback));
+}
+
 void AppleVideoRenderer::SetPlayer(const MediaPlayer* player) {
   impl_->SetPlayer(player);
 }
@@ -201,5 +527,9 @@ bool AppleVideoRenderer::SetVideoFillMode(VideoFillMode mode) {
   return impl_->SetVideoFillMode(mode);
 }
 
+void AppleVideoRenderer::OnFramePresented(double age) {
+  impl_->OnFramePresented(age);
+}
+
 }  // namespace media
 }  // namespace shaka
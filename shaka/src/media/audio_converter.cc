@@ -0,0 +1,337 @@
+// Copyright 2020 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     https://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "src/media/audio_converter.h"
+
+#include <glog/logging.h>
+#include <string.h>
+
+#if defined(__SSE2__) || defined(_M_X64)
+#  include <emmintrin.h>
+#  define USE_SSE2
+#elif defined(__ARM_NEON) || defined(__ARM_NEON__)
+#  include <arm_neon.h>
+#  define USE_NEON
+#endif
+
+#include <algorithm>
+#include <cmath>
+
+namespace shaka {
+namespace media {
+
+namespace {
+
+size_t GetSampleSize(SampleFormat format) {
+  switch (format) {
+    case SampleFormat::PackedU8:
+    case SampleFormat::PlanarU8:
+      return 1;
+    case SampleFormat::PackedS16:
+    case SampleFormat::PlanarS16:
+      return 2;
+    case SampleFormat::PackedS32:
+    case SampleFormat::PlanarS32:
+    case SampleFormat::PackedFloat:
+    case SampleFormat::PlanarFloat:
+      return 4;
+    case SampleFormat::PackedS64:
+    case SampleFormat::PlanarS64:
+    case SampleFormat::PackedDouble:
+    case SampleFormat::PlanarDouble:
+      return 8;
+    default:
+      return 0;
+  }
+}
+
+template <typename T>
+void ConvertToFloat(const uint8_t* src, size_t stride, size_t count,
+                    double offset, double scale, float* dest) {
+  const T* samples = reinterpret_cast<const T*>(src);
+  for (size_t i = 0; i < count; i++) {
+    dest[i] = static_cast<float>(
+        (static_cast<double>(samples[i * stride]) - offset) * scale);
+  }
+}
+
+void ConvertS16ToFloat(const uint8_t* src, size_t stride, size_t count,
+                       float* dest) {
+  const int16_t* samples = reinterpret_cast<const int16_t*>(src);
+  constexpr const float kScale = 1.0f / 32768;
+  size_t i = 0;
+  if (stride == 1) {
+#if defined(USE_SSE2)
+    const __m128 scale = _mm_set1_ps(kScale);
+    for (; i + 8 <= count; i += 8) {
+      const __m128i value =
+          _mm_loadu_si128(reinterpret_cast<const __m128i*>(samples + i));
+      // Sign-extend by putting each value in the high half, then shifting.
+      const __m128i low = _mm_srai_epi32(_mm_unpacklo_epi16(value, value), 16);
+      const __m128i high = _mm_srai_epi32(_mm_unpackhi_epi16(value, value), 16);
+      _mm_storeu_ps(dest + i, _mm_mul_ps(_mm_cvtepi32_ps(low), scale));
+      _mm_storeu_ps(dest + i + 4, _mm_mul_ps(_mm_cvtepi32_ps(high), scale));
+    }
+#elif defined(USE_NEON)
+    for (; i + 8 <= count; i += 8) {
+      const int16x8_t value = vld1q_s16(samples + i);
+      const float32x4_t low = vcvtq_f32_s32(vmovl_s16(vget_low_s16(value)));
+      const float32x4_t high = vcvtq_f32_s32(vmovl_s16(vget_high_s16(value)));
+      vst1q_f32(dest + i, vmulq_n_f32(low, kScale));
+      vst1q_f32(dest + i + 4, vmulq_n_f32(high, kScale));
+    }
+#endif
+  }
+
+  for (; i < count; i++)
+    dest[i] = samples[i * stride] * kScale;
+}
+
+void ConvertFloatToS16(const float* src, size_t count, int16_t* dest) {
+  constexpr const float kScale = 32767;
+  size_t i = 0;
+#if defined(USE_SSE2)
+  const __m128 scale = _mm_set1_ps(kScale);
+  const __m128 min = _mm_set1_ps(-1);
+  const __m128 max = _mm_set1_ps(1);
+  for (; i + 8 <= count; i += 8) {
+    const __m128 low = _mm_mul_ps(
+        _mm_min_ps(_mm_max_ps(_mm_loadu_ps(src + i), min), max), scale);
+    const __m128 high = _mm_mul_ps(
+        _mm_min_ps(_mm_max_ps(_mm_loadu_ps(src + i + 4), min), max), scale);
+    const __m128i packed =
+        _mm_packs_epi32(_mm_cvtps_epi32(low), _mm_cvtps_epi32(high));
+    _mm_storeu_si128(reinterpret_cast<__m128i*>(dest + i), packed);
+  }
+#elif defined(USE_NEON)
+  const float32x4_t min = vdupq_n_f32(-1);
+  const float32x4_t max = vdupq_n_f32(1);
+  for (; i + 8 <= count; i += 8) {
+    const float32x4_t low =
+        vmulq_n_f32(vminq_f32(vmaxq_f32(vld1q_f32(src + i), min), max), kScale);
+    const float32x4_t high = vmulq_n_f32(
+        vminq_f32(vmaxq_f32(vld1q_f32(src + i + 4), min), max), kScale);
+    vst1q_s16(dest + i, vcombine_s16(vqmovn_s32(vcvtq_s32_f32(low)),
+                                     vqmovn_s32(vcvtq_s32_f32(high))));
+  }
+#endif
+
+  for (; i < count; i++) {
+    const float value = std::min(std::max(src[i], -1.0f), 1.0f);
+    dest[i] = static_cast<int16_t>(std::lrint(value * kScale));
+  }
+}
+
+}  // namespace
+
+AudioConverter::AudioConverter()
+    : format_(SampleFormat::Unknown),
+      sample_rate_(0),
+      channel_count_(0),
+      bytes_per_sample_(0),
+      position_(0),
+      rate_(1) {}
+
+AudioConverter::~AudioConverter() {}
+
+bool AudioConverter::IsInputFormatSupported(SampleFormat format) {
+  return GetSampleSize(format) != 0;
+}
+
+void AudioConverter::SetOutputFormat(SampleFormat format, uint32_t sample_rate,
+                                     uint32_t channel_count) {
+  DCHECK(format == SampleFormat::PackedS16 ||
+         format == SampleFormat::PackedFloat)
+      << "Unsupported output format: " << format;
+  DCHECK_GT(sample_rate, 0u);
+  DCHECK_GT(channel_count, 0u);
+  format_ = format;
+  sample_rate_ = sample_rate;
+  channel_count_ = channel_count;
+  bytes_per_sample_ = GetSampleSize(format);
+  planes_.resize(channel_count);
+  stretcher_.Configure(channel_count, sample_rate);
+  Reset();
+}
+
+void AudioConverter::Reset() {
+  position_ = 0;
+  last_samples_.assign(channel_count_, 0);
+  stretcher_.Reset();
+}
+
+bool AudioConverter::Convert(const DecodedFrame& frame, size_t skip_samples,
+                             std::vector<uint8_t>* output,
+                             size_t* output_size) {
+  DCHECK_GT(channel_count_, 0u) << "Must call SetOutputFormat first";
+  *output_size = 0;
+  if (!holds_alternative<SampleFormat>(frame.format) ||
+      !IsInputFormatSupported(get<SampleFormat>(frame.format))) {
+    LOG(DFATAL) << "Unsupported sample format: " << frame.format;
+    return false;
+  }
+
+  const size_t input_channels = frame.stream_info->channel_count;
+  const size_t sample_size = GetSampleSize(get<SampleFormat>(frame.format));
+  const size_t total_samples =
+      IsPlanarFormat(frame.format)
+          ? frame.linesize[0] / sample_size
+          : frame.linesize[0] / (sample_size * input_channels);
+  if (skip_samples >= total_samples)
+    return true;
+  const size_t count = total_samples - skip_samples;
+
+  for (size_t channel = 0; channel < channel_count_; channel++) {
+    std::vector<float>* plane = &planes_[channel];
+    plane->resize(count);
+    if (input_channels == 1) {
+      if (channel == 0)
+        ReadChannel(frame, 0, skip_samples, count, plane->data());
+      else
+        memcpy(plane->data(), planes_[0].data(), count * sizeof(float));
+    } else if (channel_count_ == 1) {
+      ReadChannel(frame, 0, skip_samples, count, plane->data());
+      scratch_.resize(count);
+      for (size_t input = 1; input < input_channels; input++) {
+        ReadChannel(frame, input, skip_samples, count, scratch_.data());
+        for (size_t i = 0; i < count; i++)
+          (*plane)[i] += scratch_[i];
+      }
+      const float scale = 1.0f / input_channels;
+      for (size_t i = 0; i < count; i++)
+        (*plane)[i] *= scale;
+    } else if (channel < input_channels) {
+      ReadChannel(frame, channel, skip_samples, count, plane->data());
+    } else {
+      std::fill(plane->begin(), plane->end(), 0.0f);
+    }
+  }
+
+  size_t output_count = Resample(count, frame.stream_info->sample_rate);
+  const float* samples = mixed_.data();
+  if (rate_ != 1 || stretcher_.is_active()) {
+    stretcher_.Process(rate_, mixed_.data(), output_count, &stretched_);
+    samples = stretched_.data();
+    output_count = stretched_.size() / channel_count_;
+  }
+
+  const size_t size = output_count * bytes_per_frame();
+  if (output->size() < size)
+    output->resize(size);
+  if (format_ == SampleFormat::PackedFloat) {
+    memcpy(output->data(), samples, size);
+  } else {
+    ConvertFloatToS16(samples, output_count * channel_count_,
+                      reinterpret_cast<int16_t*>(output->data()));
+  }
+  *output_size = size;
+  return true;
+}
+
+void AudioConverter::ReadChannel(const DecodedFrame& frame, size_t channel,
+                                 size_t skip, size_t count, float* dest) {
+  const SampleFormat format = get<SampleFormat>(frame.format);
+  const size_t sample_size = GetSampleSize(format);
+  const uint8_t* src;
+  size_t stride;
+  if (IsPlanarFormat(format)) {
+    src = frame.data[channel] + skip * sample_size;
+    stride = 1;
+  } else {
+    stride = frame.stream_info->channel_count;
+    src = frame.data[0] + (skip * stride + channel) * sample_size;
+  }
+
+  switch (format) {
+    case SampleFormat::PackedU8:
+    case SampleFormat::PlanarU8:
+      ConvertToFloat<uint8_t>(src, stride, count, 128, 1.0 / 128, dest);
+      break;
+    case SampleFormat::PackedS16:
+    case SampleFormat::PlanarS16:
+      ConvertS16ToFloat(src, stride, count, dest);
+      break;
+    case SampleFormat::PackedS32:
+    case SampleFormat::PlanarS32:
+      ConvertToFloat<int32_t>(src, stride, count, 0, 1.0 / 2147483648.0, dest);
+      break;
+    case SampleFormat::PackedS64:
+    case SampleFormat::PlanarS64:
+      ConvertToFloat<int64_t>(src, stride, count, 0, 1.0 / 9223372036854775808.0,
+                              dest);
+      break;
+    case SampleFormat::PackedFloat:
+    case SampleFormat::PlanarFloat:
+      if (stride == 1)
+        memcpy(dest, src, count * sizeof(float));
+      else
+        ConvertToFloat<float>(src, stride, count, 0, 1, dest);
+      break;
+    case SampleFormat::PackedDouble:
+    case SampleFormat::PlanarDouble:
+      ConvertToFloat<double>(src, stride, count, 0, 1, dest);
+      break;
+    default:
+      LOG(FATAL) << "Unsupported sample format: " << format;
+  }
+}
+
+size_t AudioConverter::Resample(size_t input_count, uint32_t input_rate) {
+  const size_t channels = channel_count_;
+  if (input_rate == sample_rate_ && position_ == 0) {
+    // The rates match and we are aligned with the input samples, so this is
+    // just an interleave.
+    mixed_.resize(input_count * channels);
+    for (size_t channel = 0; channel < channels; channel++) {
+      const float* input = planes_[channel].data();
+      for (size_t i = 0; i < input_count; i++)
+        mixed_[i * channels + channel] = input[i];
+      last_samples_[channel] = input[input_count - 1];
+    }
+    return input_count;
+  }
+
+  // Output the samples that fall before the last input sample; the samples
+  // after it are interpolated using the next frame.
+  const double step = static_cast<double>(input_rate) / sample_rate_;
+  const double end = static_cast<double>(input_count - 1);
+  size_t output_count = 0;
+  if (position_ < end)
+    output_count = static_cast<size_t>(std::ceil((end - position_) / step));
+
+  mixed_.resize(output_count * channels);
+  const ptrdiff_t last = static_cast<ptrdiff_t>(input_count - 1);
+  for (size_t channel = 0; channel < channels; channel++) {
+    const float* input = planes_[channel].data();
+    const float prev = last_samples_[channel];
+    auto get_sample = [&](ptrdiff_t i) {
+      return i < 0 ? prev : input[std::min(i, last)];
+    };
+    for (size_t i = 0; i < output_count; i++) {
+      const double pos = position_ + i * step;
+      const double index = std::floor(pos);
+      const ptrdiff_t offset = static_cast<ptrdiff_t>(index);
+      const float frac = static_cast<float>(pos - index);
+      const float a = get_sample(offset);
+      const float b = get_sample(offset + 1);
+      mixed_[i * channels + channel] = a + (b - a) * frac;
+    }
+    last_samples_[channel] = input[last];
+  }
+  position_ += output_count * step - static_cast<double>(input_count);
+  return output_count;
+}
+
+}  // namespace media
+}  // namespace shaka
@@ -0,0 +1,144 @@
+// Copyright 2020 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     https://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef SHAKA_EMBEDDED_MEDIA_AUDIO_CONVERTER_H_
+#define SHAKA_EMBEDDED_MEDIA_AUDIO_CONVERTER_H_
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <vector>
+
+#include "shaka/media/frames.h"
+#include "src/media/time_stretcher.h"
+#include "src/util/macros.h"
+
+namespace shaka {
+namespace media {
+
+/**
+ * Converts decoded audio to a single fixed format: packed samples of a given
+ * sample format, sample rate, and channel count.  This allows an audio device
+ * to stay open when the decoded format changes (e.g. between periods or for
+ * ads).
+ *
+ * Samples are converted to planar floats, remapped to the output channels,
+ * resampled with linear interpolation, time-stretched if the playback rate
+ * isn't 1 (see TimeStretcher), then packed into the output format.
+ * The resampler keeps state between frames so consecutive frames are played
+ * without gaps; call Reset() when the next frame isn't continuous with the
+ * previous one.
+ *
+ * Channels are mapped by index.  Mono input is copied to every output channel
+ * and mono output is the average of all input channels.  Otherwise, extra
+ * input channels are dropped and extra output channels are silent.
+ *
+ * This type is not thread-safe.
+ */
+class AudioConverter final {
+ public:
+  AudioConverter();
+  ~AudioConverter();
+
+  SHAKA_NON_COPYABLE_OR_MOVABLE_TYPE(AudioConverter);
+
+  /** @return Whether frames of the given format can be converted. */
+  static bool IsInputFormatSupported(SampleFormat format);
+
+  /**
+   * Sets the format to convert to.  This also resets the resampler.
+   *
+   * @param format The output sample format; must be PackedS16 or PackedFloat.
+   * @param sample_rate The output sample rate.
+   * @param channel_count The number of output channels.
+   */
+  void SetOutputFormat(SampleFormat format, uint32_t sample_rate,
+                       uint32_t channel_count);
+
+  /** Drops the resampler state from the previous frame. */
+  void Reset();
+
+  /**
+   * Sets the playback rate to stretch the audio to.  This is clamped to the
+   * rates TimeStretcher supports.
+   */
+  void SetPlaybackRate(double rate) {
+    rate_ = rate;
+  }
+
+  uint32_t sample_rate() const {
+    return sample_rate_;
+  }
+
+  /** @return The number of bytes in one sample of all output channels. */
+  size_t bytes_per_frame() const {
+    return bytes_per_sample_ * channel_count_;
+  }
+
+  /**
+   * Converts the samples in the given frame to the output format.
+   *
+   * @param frame The frame to convert.
+   * @param skip_samples The number of samples (per channel) at the start of the
+   *   frame to skip.
+   * @param output The buffer to write the converted samples to.  This only
+   *   grows, so it can be reused between frames.
+   * @param output_size Will contain the number of bytes written to |output|.
+   * @return True on success, false if the frame's format isn't supported.
+   */
+  bool Convert(const DecodedFrame& frame, size_t skip_samples,
+               std::vector<uint8_t>* output, size_t* output_size);
+
+ private:
+  /**
+   * Reads |count| samples from the given input channel, starting at |skip|,
+   * as floats into |dest|.
+   */
+  static void ReadChannel(const DecodedFrame& frame, size_t channel,
+                          size_t skip, size_t count, float* dest);
+
+  /**
+   * Resamples the planes in |planes_| to |mixed_|.
+   * @return The number of output samples (per channel).
+   */
+  size_t Resample(size_t input_count, uint32_t input_rate);
+
+  SampleFormat format_;
+  uint32_t sample_rate_;
+  uint32_t channel_count_;
+  size_t bytes_per_sample_;
+
+  // The position of the next output sample, in input samples relative to the
+  // start of the next frame.  If negative, the sample is interpolated between
+  // |last_samples_| and the first sample in the frame.
+  double position_;
+  // The last input sample of the previous frame, per output channel.
+  std::vector<float> last_samples_;
+
+  double rate_;
+  TimeStretcher stretcher_;
+
+  // Temporary buffers reused between frames.  |planes_| holds the input for
+  // each output channel, |mixed_| holds the interleaved output, and
+  // |stretched_| holds the time-stretched output.
+  std::vector<std::vector<float>> planes_;
+  std::vector<float> scratch_;
+  std::vector<float> mixed_;
+  std::vector<float> stretched_;
+};
+
+}  // namespace media
+}  // namespace shaka
+
+#endif  // SHAKA_EMBEDDED_MEDIA_AUDIO_CONVERTER_H_
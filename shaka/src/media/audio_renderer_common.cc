@@ -19,21 +19,36 @@
 #include <functional>
 #include <vector>
 
+#include "src/debug/trace_event.h"
+#include "src/media/time_stretcher.h"
+
 namespace shaka {
 namespace media {
 
 namespace {
 
-/** The number of seconds to buffer ahead of the current time. */
-const double kBufferTarget = 2;
+/** The default number of seconds to buffer ahead of the current time. */
+const double kDefaultBufferSize = 2;
 
 /** The minimum difference, in seconds, to introduce silence or drop frames. */
 const double kSyncLimit = 0.1;
 
+/**
+ * The most seconds of audio to buffer ahead once the playback rate has been
+ * changed while playing.  The buffered audio was stretched for the old rate,
+ * so this limits how far audio drifts from the video after a rate change.
+ */
+const double kStretchBufferSize = 0.5;
+
 /** A buffer that contains silence. */
 const uint8_t kSilenceBuffer[4096] = {0};
 
 
+/** @return Whether audio can be time-stretched to play at the given rate. */
+bool CanStretch(double rate) {
+  return rate >= TimeStretcher::kMinRate && rate <= TimeStretcher::kMaxRate;
+}
+
 uint8_t BytesPerSample(std::shared_ptr<DecodedFrame> frame) {
   switch (get<SampleFormat>(frame->format)) {
     case SampleFormat::PackedU8:
@@ -41,6 +56,7 @@ uint8_t BytesPerSample(std::shared_ptr<DecodedFrame> frame) {
       return 1;
     case SampleFormat::PackedS16:
     case SampleFormat::PlanarS16:
+    case SampleFormat::Iec61937:
       return 2;
     case SampleFormat::PackedS32:
     case SampleFormat::PlanarS32:
@@ -60,54 +76,36 @@ uint8_t BytesPerSample(std::shared_ptr<DecodedFrame> frame) {
   }
 }
 
-size_t BytesToSamples(std::shared_ptr<DecodedFrame> frame, size_t bytes) {
-  size_t bytes_per_sample =
-      BytesPerSample(frame) * frame->stream_info->channel_count;
-  return bytes / bytes_per_sample;
-}
-
-double BytesToSeconds(std::shared_ptr<DecodedFrame> frame, size_t bytes) {
-  return static_cast<double>(BytesToSamples(frame, bytes)) /
-         frame->stream_info->sample_rate;
-}
-
-/**
- * Calculates the byte sync needed to play the next frame.
- *
- * @param prev_time The previous synchronized time.
- * @param bytes_written The number of bytes written since |prev_time|.
- * @param next The next frame to be played.
- * @return If positive, the number of bytes to skip in |next|; if negative, the
- *   number of bytes of silence to play.
- */
-int64_t GetSyncBytes(double prev_time, size_t bytes_written,
-                     std::shared_ptr<DecodedFrame> next) {
-  const int64_t bytes_per_sample = BytesPerSample(next);
-  const double buffer_end = prev_time + BytesToSeconds(next, bytes_written);
-  // If the difference is small, just ignore for now.
-  if (std::abs(buffer_end - next->pts) < kSyncLimit)
-    return 0;
+}  // namespace
 
-  // Round to whole samples before converting to bytes.
-  const int64_t sample_delta = static_cast<int64_t>(
-      (buffer_end - next->pts) * next->stream_info->sample_rate);
-  return sample_delta * next->stream_info->channel_count * bytes_per_sample;
+bool AudioRendererCommon::IsBitstream(std::shared_ptr<DecodedFrame> frame) {
+  return frame && holds_alternative<SampleFormat>(frame->format) &&
+         get<SampleFormat>(frame->format) == SampleFormat::Iec61937;
 }
 
-}  // namespace
-
 AudioRendererCommon::AudioRendererCommon()
     : mutex_("AudioRendererCommon"),
       on_play_("AudioRendererCommon"),
       clock_(&util::Clock::Instance),
       player_(nullptr),
       input_(nullptr),
+      sync_time_(0),
+      written_time_(0),
+      rate_(1),
+      buffer_size_(kDefaultBufferSize),
       volume_(1),
       muted_(false),
+      preroll_(false),
+      primed_(false),
       needs_resync_(true),
+      append_dropped_(false),
+      check_drift_(false),
       shutdown_(false),
+      convert_output_(false),
+      buffer_allocations_(0),
       thread_("AudioRenderer",
-              std::bind(&AudioRendererCommon::ThreadMain, this)) {}
+              std::bind(&AudioRendererCommon::ThreadMain, this),
+              ThreadRole::Audio) {}
 
 AudioRendererCommon::~AudioRendererCommon() {
   CHECK(shutdown_) << "Must call Stop before destroying";
@@ -123,6 +121,7 @@ void AudioRendererCommon::SetPlayer(const MediaPlayer* player) {
 
   player_ = player;
   needs_resync_ = true;
+  InvalidateDeviceClock();
   if (player) {
     player->AddClient(this);
     on_play_.SignalAllIfNotSet();
@@ -141,6 +140,11 @@ void AudioRendererCommon::Detach() {
   std::unique_lock<Mutex> lock(mutex_);
   input_ = nullptr;
   SetDeviceState(/* is_playing= */ false);
+  InvalidateDeviceClock();
+  // The derived class may close the device when detached, so start with a new
+  // device when we are attached again.
+  cur_frame_.reset();
+  convert_output_ = false;
 }
 
 double AudioRendererCommon::Volume() const {
@@ -165,6 +169,31 @@ void AudioRendererCommon::SetMuted(bool muted) {
   UpdateVolume(muted ? 0 : volume_);
 }
 
+bool AudioRendererCommon::GetDeviceTime(double* time) const {
+  const DeviceClock clock = device_clock_.Load();
+  if (!clock.valid)
+    return false;
+
+  // The device stops once it plays all the written audio.
+  const uint64_t now = clock_->GetMonotonicTime();
+  const double elapsed =
+      now > clock.wall_time ? (now - clock.wall_time) / 1000.0 : 0;
+  *time = std::min(clock.media_time + elapsed * clock.rate, clock.buffer_end);
+  return true;
+}
+
+void AudioRendererCommon::SetBufferSize(double seconds) {
+  DCHECK_GT(seconds, 0);
+  std::unique_lock<Mutex> lock(mutex_);
+  buffer_size_ = seconds;
+}
+
+void AudioRendererCommon::SetPrerollWhilePaused(bool preroll) {
+  std::unique_lock<Mutex> lock(mutex_);
+  preroll_ = preroll;
+  on_play_.SignalAllIfNotSet();
+}
+
 void AudioRendererCommon::Stop() {
   {
     std::unique_lock<Mutex> lock(mutex_);
@@ -173,12 +202,36 @@ void AudioRendererCommon::Stop() {
   on_play_.SignalAllIfNotSet();
 }
 
-bool AudioRendererCommon::FillSilence(size_t bytes) {
+uint8_t* AudioRendererCommon::GetMixBuffer(size_t size) {
+  return GrowBuffer(&mix_buffer_, size);
+}
+
+double AudioRendererCommon::BufferSize() const {
+  return buffer_size_;
+}
+
+void AudioRendererCommon::SetDeviceFormat(SampleFormat format,
+                                          uint32_t sample_rate,
+                                          uint32_t channel_count) {
+  converter_.SetOutputFormat(format, sample_rate, channel_count);
+  convert_output_ = true;
+}
+
+size_t AudioRendererCommon::BufferAllocationCount() const {
+  return buffer_allocations_.load(std::memory_order_relaxed);
+}
+
+void AudioRendererCommon::OnAppendDropped() {
+  append_dropped_ = true;
+}
+
+bool AudioRendererCommon::FillSilence(std::shared_ptr<DecodedFrame> frame,
+                                      size_t bytes) {
   while (bytes > 0) {
     const size_t to_write = std::min(bytes, sizeof(kSilenceBuffer));
     if (!AppendBuffer(kSilenceBuffer, to_write))
       return false;
-    bytes_written_ += to_write;
+    written_time_ += BytesToSeconds(frame, to_write) * rate_;
     bytes -= to_write;
   }
   return true;
@@ -187,12 +240,43 @@ bool AudioRendererCommon::FillSilence(size_t bytes) {
 bool AudioRendererCommon::IsFrameSimilar(
     std::shared_ptr<DecodedFrame> frame1,
     std::shared_ptr<DecodedFrame> frame2) const {
-  return frame1 && frame2 && frame1->stream_info == frame2->stream_info &&
-         frame1->format == frame2->format;
+  if (!frame1 || !frame2)
+    return false;
+  if (convert_output_) {
+    return holds_alternative<SampleFormat>(frame2->format) &&
+           AudioConverter::IsInputFormatSupported(
+               get<SampleFormat>(frame2->format));
+  }
+  // Compare the format rather than the StreamInfo objects since a new stream
+  // (e.g. the next period or an ad) often has the same format.
+  return frame1->format == frame2->format &&
+         frame1->stream_info->sample_rate == frame2->stream_info->sample_rate &&
+         frame1->stream_info->channel_count ==
+             frame2->stream_info->channel_count;
 }
 
 bool AudioRendererCommon::WriteFrame(std::shared_ptr<DecodedFrame> frame,
                                      size_t sync_bytes) {
+  if (convert_output_) {
+    // |sync_bytes| is in the device format, so skip the input samples that
+    // cover the same media time.
+    const size_t skipped_samples = static_cast<size_t>(
+        BytesToSeconds(frame, sync_bytes) * rate_ *
+        frame->stream_info->sample_rate);
+    const size_t capacity = pack_buffer_.capacity();
+    size_t size;
+    if (!converter_.Convert(*frame, skipped_samples, &pack_buffer_, &size))
+      return false;
+    if (pack_buffer_.capacity() != capacity)
+      buffer_allocations_.fetch_add(1, std::memory_order_relaxed);
+    if (size > 0) {
+      if (!AppendBuffer(pack_buffer_.data(), size))
+        return false;
+      written_time_ += BytesToSeconds(frame, size) * rate_;
+    }
+    return true;
+  }
+
   if (IsPlanarFormat(frame->format)) {
     // We need to pack the samples into a single array.
     // Before:
@@ -206,9 +290,9 @@ bool AudioRendererCommon::WriteFrame(std::shared_ptr<DecodedFrame> frame,
     const size_t per_channel_sync = sync_bytes / channel_count;
     const size_t skipped_samples = per_channel_sync / sample_size;
     if (sample_count > skipped_samples) {
-      std::vector<uint8_t> temp(frame->linesize[0] * channel_count -
-                                sync_bytes);
-      uint8_t* output = temp.data();
+      const size_t size = (sample_count - skipped_samples) * sample_size *
+                          channel_count;
+      uint8_t* output = GrowBuffer(&pack_buffer_, size);
       for (size_t sample = skipped_samples; sample < sample_count; sample++) {
         for (size_t channel = 0; channel < channel_count; channel++) {
           std::memcpy(output, frame->data[channel] + sample * sample_size,
@@ -216,26 +300,80 @@ bool AudioRendererCommon::WriteFrame(std::shared_ptr<DecodedFrame> frame,
           output += sample_size;
         }
       }
-      if (!AppendBuffer(temp.data(), temp.size()))
+      if (!AppendBuffer(pack_buffer_.data(), size))
         return false;
-      bytes_written_ += temp.size();
+      written_time_ += BytesToSeconds(frame, size);
     }
   } else {
+    if (IsBitstream(frame) && sync_bytes > 0) {
+      // Part of a burst can't be decoded by the sink, so play or drop whole
+      // bursts.
+      const size_t size = frame->linesize[0];
+      sync_bytes = sync_bytes * 2 >= size ? size : 0;
+    }
     if (frame->linesize[0] > sync_bytes) {
       if (!AppendBuffer(frame->data[0] + sync_bytes,
                         frame->linesize[0] - sync_bytes)) {
         return false;
       }
-      bytes_written_ += frame->linesize[0] - sync_bytes;
+      written_time_ += BytesToSeconds(frame, frame->linesize[0] - sync_bytes);
     }
   }
   return true;
 }
 
+size_t AudioRendererCommon::BytesPerFrame(
+    std::shared_ptr<DecodedFrame> frame) const {
+  if (convert_output_)
+    return converter_.bytes_per_frame();
+  return BytesPerSample(frame) * frame->stream_info->channel_count;
+}
+
+uint32_t AudioRendererCommon::DeviceSampleRate(
+    std::shared_ptr<DecodedFrame> frame) const {
+  if (convert_output_)
+    return converter_.sample_rate();
+  return frame->stream_info->sample_rate;
+}
+
+double AudioRendererCommon::BytesToSeconds(std::shared_ptr<DecodedFrame> frame,
+                                           size_t bytes) const {
+  const size_t samples = bytes / BytesPerFrame(frame);
+  return static_cast<double>(samples) / DeviceSampleRate(frame);
+}
+
+int64_t AudioRendererCommon::GetSyncBytes(
+    double prev_time, double written_time,
+    std::shared_ptr<DecodedFrame> next) const {
+  const double buffer_end = prev_time + written_time;
+  // If the difference is small, just ignore for now.
+  if (std::abs(buffer_end - next->pts) < kSyncLimit)
+    return 0;
+
+  // Round to whole samples before converting to bytes.  The device plays
+  // |rate_| seconds of media each second.
+  const int64_t sample_delta = static_cast<int64_t>(
+      (buffer_end - next->pts) / rate_ * DeviceSampleRate(next));
+  return sample_delta * static_cast<int64_t>(BytesPerFrame(next));
+}
+
+uint8_t* AudioRendererCommon::GrowBuffer(std::vector<uint8_t>* buffer,
+                                         size_t size) {
+  if (buffer->size() < size) {
+    buffer->resize(size);
+    buffer_allocations_.fetch_add(1, std::memory_order_relaxed);
+  }
+  return buffer->data();
+}
+
 void AudioRendererCommon::SetClock(const util::Clock* clock) {
   clock_ = clock;
 }
 
+void AudioRendererCommon::InvalidateDeviceClock() {
+  device_clock_.Store(DeviceClock());
+}
+
 void AudioRendererCommon::ThreadMain() {
   std::unique_lock<Mutex> lock(mutex_);
   while (!shutdown_) {
@@ -244,26 +382,59 @@ void AudioRendererCommon::ThreadMain() {
       continue;
     }
 
-    // TODO(#15): Support playback rate.  For the moment, mute audio.
+    // Other rates are muted unless the audio can be time-stretched.
+    const double rate = player_->PlaybackRate();
+    const VideoPlaybackState state = player_->PlaybackState();
     const bool is_playing =
-        player_->PlaybackRate() == 1 &&
-        player_->PlaybackState() == VideoPlaybackState::Playing;
+        CanPlayAtRate(rate) && state == VideoPlaybackState::Playing;
+    // When pre-rolling, the paused device is filled like it is while playing.
+    const bool is_prerolling = preroll_ && CanPlayAtRate(rate) &&
+                               state == VideoPlaybackState::Paused;
     SetDeviceState(is_playing);
-    if (!is_playing) {
+    if (!is_playing)
+      InvalidateDeviceClock();
+    if (!is_playing && !is_prerolling) {
       on_play_.ResetAndWaitWhileUnlocked(lock);
       continue;
     }
 
     double time = player_->CurrentTime();
     const size_t buffered_bytes = GetBytesBuffered();
+    if (!needs_resync_ && cur_frame_) {
+      // The audio that is playing now was written at the end of the buffer
+      // minus the buffered audio.
+      const double buffer_end = sync_time_ + written_time_;
+      const double audio_time =
+          buffer_end - BytesToSeconds(cur_frame_, buffered_bytes) * rate_;
+      if (check_drift_ && std::abs(audio_time - time) > kSyncLimit) {
+        needs_resync_ = true;
+        InvalidateDeviceClock();
+      } else if (is_playing) {
+        device_clock_.Store({true, audio_time, clock_->GetMonotonicTime(),
+                             rate_, buffer_end});
+      }
+    }
+    rate_ = rate;
+    converter_.SetPlaybackRate(rate);
+
     std::shared_ptr<DecodedFrame> next;
     if (needs_resync_ || !cur_frame_) {
       ClearBuffer();
+      converter_.Reset();
+      check_drift_ = false;
       next = input_->GetFrame(time, FrameLocation::Near);
     } else {
+      const double buffer_size = check_drift_
+                                     ? std::min(buffer_size_, kStretchBufferSize)
+                                     : buffer_size_;
       const double buffered_extra =
-          BytesToSeconds(cur_frame_, buffered_bytes) - kBufferTarget;
+          BytesToSeconds(cur_frame_, buffered_bytes) - buffer_size;
       if (buffered_extra > 0) {
+        if (!is_playing) {
+          // The paused device won't play any of the buffer, so wait to play.
+          on_play_.ResetAndWaitWhileUnlocked(lock);
+          continue;
+        }
         util::Unlocker<Mutex> unlock(&lock);
         clock_->SleepSeconds(buffered_extra);
         continue;
@@ -273,8 +444,10 @@ void AudioRendererCommon::ThreadMain() {
     }
 
     if (!next) {
+      // Poll often enough that a small buffer doesn't run out.
+      const double delay = std::min(0.1, buffer_size_ / 4);
       util::Unlocker<Mutex> unlock(&lock);
-      clock_->SleepSeconds(0.1);
+      clock_->SleepSeconds(delay);
       continue;
     }
 
@@ -293,49 +466,83 @@ void AudioRendererCommon::ThreadMain() {
         time = player_->CurrentTime();
       }
 
+      convert_output_ = false;
       if (!InitDevice(next, muted_ ? 0 : volume_))
         return;
-      SetDeviceState(/* is_playing= */ true);
       needs_resync_ = true;
+      // The device is now open, so CanPlayAtRate knows whether it can stretch.
+      cur_frame_ = next;
+      if (!CanPlayAtRate(rate)) {
+        // The device can't play at this rate, so wait until the rate changes.
+        continue;
+      }
+      SetDeviceState(is_playing);
     }
 
     int64_t sync_bytes;
     if (needs_resync_ || !cur_frame_) {
       sync_bytes = GetSyncBytes(time, 0, next);
       sync_time_ = time;
-      bytes_written_ = 0;
+      written_time_ = 0;
     } else {
-      sync_bytes = GetSyncBytes(sync_time_, bytes_written_, next);
+      sync_bytes = GetSyncBytes(sync_time_, written_time_, next);
     }
     if (sync_bytes < 0) {
-      if (!FillSilence(-sync_bytes))
+      if (!FillSilence(next, -sync_bytes))
         return;
       sync_bytes = 0;
     }
-    if (!WriteFrame(next, sync_bytes))
-      return;
+    {
+      TRACE_EVENT("media", "Present audio");
+      TRACE_FRAME_END(next.get());
+      if (!WriteFrame(next, sync_bytes))
+        return;
+    }
     cur_frame_ = next;
-    needs_resync_ = false;
+    needs_resync_ = append_dropped_;
+    append_dropped_ = false;
+    primed_ = !is_playing;
   }
 }
 
 void AudioRendererCommon::OnPlaybackStateChanged(VideoPlaybackState old_state,
                                                  VideoPlaybackState new_state) {
   std::unique_lock<Mutex> lock(mutex_);
-  needs_resync_ = true;
+  // Audio buffered while paused starts at the paused time, so it can be
+  // played as-is.
+  if (!primed_ || old_state != VideoPlaybackState::Paused ||
+      new_state != VideoPlaybackState::Playing) {
+    needs_resync_ = true;
+  }
+  primed_ = false;
+  InvalidateDeviceClock();
   on_play_.SignalAllIfNotSet();
 }
 
 void AudioRendererCommon::OnPlaybackRateChanged(double old_rate,
                                                 double new_rate) {
   std::unique_lock<Mutex> lock(mutex_);
-  needs_resync_ = true;
+  if (convert_output_ && CanStretch(old_rate) && CanStretch(new_rate)) {
+    // Keep playing the buffered audio so there isn't a gap; the new rate is
+    // used for the next frames.  Since the buffered audio was stretched for
+    // the old rate, check that it doesn't drift too far from the video.
+    check_drift_ = true;
+  } else {
+    needs_resync_ = true;
+    InvalidateDeviceClock();
+  }
   on_play_.SignalAllIfNotSet();
 }
 
+bool AudioRendererCommon::CanPlayAtRate(double rate) const {
+  // Before the device is opened, we don't know if it can stretch the audio.
+  return rate == 1 || (CanStretch(rate) && (convert_output_ || !cur_frame_));
+}
+
 void AudioRendererCommon::OnSeeking() {
   std::unique_lock<Mutex> lock(mutex_);
   needs_resync_ = true;
+  InvalidateDeviceClock();
   on_play_.SignalAllIfNotSet();
 }
 
@@ -15,15 +15,19 @@
 #ifndef SHAKA_EMBEDDED_MEDIA_AUDIO_RENDERER_COMMON_H_
 #define SHAKA_EMBEDDED_MEDIA_AUDIO_RENDERER_COMMON_H_
 
+#include <atomic>
 #include <memory>
+#include <vector>
 
 #include "shaka/media/frames.h"
 #include "shaka/media/renderer.h"
 #include "src/debug/mutex.h"
+#include "src/media/audio_converter.h"
 #include "src/debug/thread.h"
 #include "src/debug/thread_event.h"
 #include "src/util/buffer_writer.h"
 #include "src/util/clock.h"
+#include "src/util/seqlock.h"
 
 namespace shaka {
 namespace media {
@@ -41,14 +45,31 @@ namespace media {
  * class handles the synchronization and predictions, the derived classes handle
  * how to talk to the device.
  *
- * When we are paused or seek, we need to resynchronize.  This will pick the
+ * When we are paused or seek, we need to resynchronize.  If pre-roll is
+ * enabled, this is done while paused (with the device paused), so playing can
+ * start from the already-buffered audio.  This will pick the
  * current frame based on the current time and start filling there.  From that
  * point forward, we will just append new frames sequentially.  This will also
  * handle the unlikely case of not having enough data or too much data to match
  * the frame times.
  *
- * This renderer only supports playing content the audio device natively
- * supports.  This cannot convert to a different sample format.
+ * IEC 61937 frames (compressed audio for the sink to decode) are written to
+ * the device unchanged and are never converted; the derived class must open
+ * the device as 16-bit stereo at the frame's sample rate and must not apply
+ * the volume to them.  Bursts are only dropped or padded with silence as a
+ * whole.
+ *
+ * By default, this only supports playing content the audio device natively
+ * supports and the device is reset when the format changes.  If the derived
+ * class calls SetDeviceFormat, frames are instead converted to that format so
+ * the device can stay open across format changes.  This also allows playback
+ * rates between TimeStretcher::kMinRate and kMaxRate to be played without
+ * resetting the device; otherwise audio is muted when the rate isn't 1.
+ *
+ * While the device is playing, the media time it is playing is published so
+ * it can be used as the master clock (see GetDeviceTime).  This is based on
+ * the number of bytes the device still has buffered, so the derived class
+ * should make GetBytesBuffered follow what the hardware has played.
  *
  * This type is fully thread-safe; all the pure-virtual methods are called with
  * a lock held, so derived classes do not need to use locks.
@@ -66,6 +87,20 @@ class AudioRendererCommon : public AudioRenderer, MediaPlayer::Client {
   void SetVolume(double volume) override;
   bool Muted() const override;
   void SetMuted(bool muted) override;
+  bool GetDeviceTime(double* time) const override;
+
+  /**
+   * Sets the number of seconds of audio to write to the device ahead of the
+   * current time.
+   */
+  void SetBufferSize(double seconds);
+
+  /**
+   * Sets whether to open the audio device and fill its buffer while paused, so
+   * audio starts as soon as the player plays.  The device stays paused until
+   * then.
+   */
+  void SetPrerollWhilePaused(bool preroll);
 
  protected:
   /**
@@ -74,6 +109,55 @@ class AudioRendererCommon : public AudioRenderer, MediaPlayer::Client {
    */
   void Stop();
 
+  /**
+   * @return Whether the given frame holds compressed audio for the sink to
+   *   decode (SampleFormat::Iec61937), which must be written unchanged.
+   */
+  static bool IsBitstream(std::shared_ptr<DecodedFrame> frame);
+
+  /**
+   * Gets a buffer of at least |size| bytes that the derived class can use to
+   * transform data in AppendBuffer (e.g. to apply the volume).  The buffer is
+   * reused between calls, so this only allocates when a larger buffer is
+   * needed.  This must only be called from the pure-virtual methods.
+   */
+  uint8_t* GetMixBuffer(size_t size);
+
+  /**
+   * @return The number of seconds of audio written to the device ahead of the
+   *   current time (see SetBufferSize).  This must only be called from the
+   *   pure-virtual methods.
+   */
+  double BufferSize() const;
+
+  /**
+   * Tells this class the fixed format the audio device plays.  This can only
+   * be called from InitDevice.  Once set, every frame is converted to this
+   * format (see AudioConverter) before being given to AppendBuffer, and frames
+   * with a different format, sample rate, or channel count will be played
+   * without resetting the device.
+   *
+   * @param format The device sample format; must be PackedS16 or PackedFloat.
+   * @param sample_rate The device sample rate.
+   * @param channel_count The number of device channels.
+   */
+  void SetDeviceFormat(SampleFormat format, uint32_t sample_rate,
+                       uint32_t channel_count);
+
+  /**
+   * @return The number of times the internal buffers had to be allocated.
+   *   Once buffers for the current stream exist, this shouldn't change.
+   */
+  size_t BufferAllocationCount() const;
+
+  /**
+   * Called from AppendBuffer when the device dropped some of the data without
+   * an error (e.g. its buffer is full while paused).  The written audio no
+   * longer matches the media time, so this resyncs before writing more.  This
+   * must only be called from AppendBuffer.
+   */
+  void OnAppendDropped();
+
  private:
   enum class SyncStatus {
     Success,
@@ -81,6 +165,18 @@ class AudioRendererCommon : public AudioRenderer, MediaPlayer::Client {
     FatalError,
   };
 
+  /** The media time the device was playing at a wall-clock time. */
+  struct DeviceClock {
+    bool valid;
+    double media_time;
+    /** The monotonic wall-clock time, in milliseconds. */
+    uint64_t wall_time;
+    /** The media seconds played per wall-clock second. */
+    double rate;
+    /** The media time at the end of the written audio. */
+    double buffer_end;
+  };
+
   /**
    * Initializes the audio device for playback of audio similar to the given
    * frame.  The device should start paused.
@@ -102,7 +198,9 @@ class AudioRendererCommon : public AudioRenderer, MediaPlayer::Client {
    *
    * @param data The data to buffer.
    * @param size The number of bytes in data.
-   * @return True on success, false on error.
+   * @return True on success, false on error.  If this returns an error, it is
+   *   assumed to be fatal and audio won't be played anymore.  If only some of
+   *   the data could be buffered, call OnAppendDropped() and return true.
    */
   virtual bool AppendBuffer(const uint8_t* data, size_t size) = 0;
 
@@ -127,7 +225,7 @@ class AudioRendererCommon : public AudioRenderer, MediaPlayer::Client {
   virtual void UpdateVolume(double volume) = 0;
 
   /** Fills the audio device with the given number of bytes of silence. */
-  bool FillSilence(size_t bytes);
+  bool FillSilence(std::shared_ptr<DecodedFrame> frame, size_t bytes);
 
   /**
    * Determines if the given frames are similar enough to use the same audio
@@ -139,8 +237,39 @@ class AudioRendererCommon : public AudioRenderer, MediaPlayer::Client {
 
   bool WriteFrame(std::shared_ptr<DecodedFrame> frame, size_t sync_bytes);
 
+  /** @return The number of bytes in one sample of all channels on the device. */
+  size_t BytesPerFrame(std::shared_ptr<DecodedFrame> frame) const;
+
+  /** @return The sample rate the device plays at. */
+  uint32_t DeviceSampleRate(std::shared_ptr<DecodedFrame> frame) const;
+
+  /** @return The duration of the given number of device bytes, in seconds. */
+  double BytesToSeconds(std::shared_ptr<DecodedFrame> frame,
+                        size_t bytes) const;
+
+  /**
+   * Calculates the byte sync needed to play the next frame.
+   *
+   * @param prev_time The previous synchronized time.
+   * @param written_time The media time written since |prev_time|.
+   * @param next The next frame to be played.
+   * @return If positive, the number of device bytes to skip in |next|; if
+   *   negative, the number of bytes of silence to play.
+   */
+  int64_t GetSyncBytes(double prev_time, double written_time,
+                       std::shared_ptr<DecodedFrame> next) const;
+
+  /** @return Whether audio can be played at the given playback rate. */
+  bool CanPlayAtRate(double rate) const;
+
+  /** Grows the given buffer to be at least |size| bytes. */
+  uint8_t* GrowBuffer(std::vector<uint8_t>* buffer, size_t size);
+
   void SetClock(const util::Clock* clock);
 
+  /** Stops publishing the device time until the device is playing again. */
+  void InvalidateDeviceClock();
+
   void ThreadMain();
 
 
@@ -160,11 +289,34 @@ class AudioRendererCommon : public AudioRenderer, MediaPlayer::Client {
 
   std::shared_ptr<DecodedFrame> cur_frame_;
   double sync_time_;
-  uint64_t bytes_written_;
+  // The media time written to the device since |sync_time_|.
+  double written_time_;
+  // The playback rate the audio is being written at.
+  double rate_;
+  double buffer_size_;
   double volume_;
   bool muted_;
+  bool preroll_;
+  // Whether the buffered audio was written while paused, starting at the
+  // paused time; this can be played without resyncing.
+  bool primed_;
   bool needs_resync_;
+  // Whether AppendBuffer dropped data while writing the current frame.
+  bool append_dropped_;
+  // Whether to resync if the audio drifts from the current time; this happens
+  // after the rate changes while playing.
+  bool check_drift_;
   bool shutdown_;
+  // Whether frames are converted to the format given to SetDeviceFormat.
+  bool convert_output_;
+  AudioConverter converter_;
+
+  // These buffers are reused to avoid allocating for each frame.
+  std::vector<uint8_t> pack_buffer_;
+  std::vector<uint8_t> mix_buffer_;
+  std::atomic<size_t> buffer_allocations_;
+  // This is read without holding |mutex_|.
+  util::SeqLock<DeviceClock> device_clock_;
 
   Thread thread_;
 };
@@ -0,0 +1,250 @@
+// Copyright 2020 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     https://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "src/media/caption_extractor.h"
+
+#include <algorithm>
+#include <cmath>
+#include <utility>
+
+#include "shaka/eme/configuration.h"
+#include "shaka/media/stream_info.h"
+#include "src/media/media_utils.h"
+#include "src/util/buffer_reader.h"
+
+namespace shaka {
+namespace media {
+
+namespace {
+
+/** The NAL unit types of SEI messages. */
+constexpr const uint8_t kH264SeiType = 6;
+constexpr const uint8_t kHevcPrefixSeiType = 39;
+
+/** The SEI payload type of user_data_registered_itu_t_t35. */
+constexpr const uint32_t kT35PayloadType = 4;
+
+/** The ATSC A/53 values that identify cc_data in a T.35 message. */
+constexpr const uint8_t kUsaCountryCode = 0xb5;
+constexpr const uint16_t kAtscProviderCode = 0x31;
+constexpr const uint32_t kGa94Identifier = 0x47413934;
+constexpr const uint8_t kCcDataTypeCode = 0x03;
+
+/**
+ * If the next byte pair is more than this many seconds after the last one,
+ * the segments aren't contiguous, so the caption state doesn't carry over.
+ */
+constexpr const double kMaxCaptionGap = 1;
+
+/**
+ * @return The size of the NAL unit length prefixes, or 0 if the frames use
+ *   Annex B start codes.
+ */
+size_t GetNalLengthSize(const std::vector<uint8_t>& extra_data,
+                        bool is_hevc) {
+  // The extra data is a decoder configuration record from ISO/IEC 14496-15
+  // (Section 5.3.3.1.2 for avcC and Section 8.3.3.1.2 for hvcC).  Without one,
+  // the frames use start codes.
+  if (extra_data.empty() || extra_data[0] != 1)
+    return 0;
+  if (!is_hevc && extra_data.size() >= 5)
+    return (extra_data[4] & 0x3) + 1;
+  if (is_hevc && extra_data.size() >= 23)
+    return (extra_data[21] & 0x3) + 1;
+  return 0;
+}
+
+/** Finds the offset and size of each NAL unit in the given frame. */
+void FindNalUnits(const uint8_t* data, size_t size, size_t length_size,
+                  std::vector<std::pair<size_t, size_t>>* nal_units) {
+  if (length_size > 0) {
+    util::BufferReader reader(data, size);
+    while (reader.BytesRemaining() >= length_size) {
+      const size_t nal_size = reader.ReadBits(length_size * 8);
+      if (nal_size > reader.BytesRemaining())
+        return;
+      nal_units->emplace_back(reader.data() - data, nal_size);
+      reader.Skip(nal_size);
+    }
+    return;
+  }
+
+  // ITU-T H.264 Annex B: each NAL unit starts with 00 00 01.
+  size_t start = size;
+  for (size_t i = 0; i + 2 < size;) {
+    if (data[i] == 0 && data[i + 1] == 0 && data[i + 2] == 1) {
+      if (start < i)
+        nal_units->emplace_back(start, i - start);
+      i += 3;
+      start = i;
+    } else {
+      i++;
+    }
+  }
+  if (start < size)
+    nal_units->emplace_back(start, size - start);
+}
+
+void ParseT35(const uint8_t* data, size_t size, double pts,
+              std::vector<CaptionExtractor::BytePair>* pairs) {
+  // ATSC A/53 Part 4, Section 6.2.3.
+  util::BufferReader reader(data, size);
+  if (reader.ReadUint8() != kUsaCountryCode ||
+      reader.ReadBits(16) != kAtscProviderCode ||
+      reader.ReadUint32() != kGa94Identifier ||
+      reader.ReadUint8() != kCcDataTypeCode) {
+    return;
+  }
+
+  // CEA-708 Section 4.4: cc_data().
+  const uint8_t flags = reader.ReadUint8();
+  if ((flags & 0x40) == 0)
+    return;  // process_cc_data_flag isn't set.
+  const size_t cc_count = flags & 0x1f;
+  reader.Skip(1);  // em_data
+  for (size_t i = 0; i < cc_count && reader.BytesRemaining() >= 3; i++) {
+    const uint8_t header = reader.ReadUint8();
+    const uint8_t byte1 = reader.ReadUint8();
+    const uint8_t byte2 = reader.ReadUint8();
+    // cc_type 0 is CEA-608 field 1; types 2 and 3 are CEA-708 packets.
+    const bool cc_valid = (header & 0x4) != 0;
+    if (cc_valid && (header & 0x3) == 0)
+      pairs->push_back({pts, byte1, byte2});
+  }
+}
+
+void ParseSei(const uint8_t* data, size_t size, double pts,
+              std::vector<CaptionExtractor::BytePair>* pairs) {
+  // Remove the emulation prevention bytes (00 00 03) to get the RBSP.
+  std::vector<uint8_t> rbsp;
+  rbsp.reserve(size);
+  size_t zeros = 0;
+  for (size_t i = 0; i < size; i++) {
+    if (zeros >= 2 && data[i] == 3) {
+      zeros = 0;
+      continue;
+    }
+    rbsp.push_back(data[i]);
+    zeros = data[i] == 0 ? zeros + 1 : 0;
+  }
+
+  // ITU-T H.264 Section 7.3.2.3.1: sei_message().  The last byte is the
+  // rbsp_trailing_bits.
+  util::BufferReader reader(rbsp.data(), rbsp.size());
+  while (reader.BytesRemaining() > 1) {
+    uint32_t payload_type = 0;
+    uint8_t byte;
+    do {
+      byte = reader.ReadUint8();
+      payload_type += byte;
+    } while (byte == 0xff && !reader.empty());
+    size_t payload_size = 0;
+    do {
+      byte = reader.ReadUint8();
+      payload_size += byte;
+    } while (byte == 0xff && !reader.empty());
+
+    if (payload_size > reader.BytesRemaining())
+      return;
+    if (payload_type == kT35PayloadType)
+      ParseT35(reader.data(), payload_size, pts, pairs);
+    reader.Skip(payload_size);
+  }
+}
+
+}  // namespace
+
+CaptionExtractor::CaptionExtractor() : last_pts_(NAN) {}
+
+CaptionExtractor::~CaptionExtractor() {}
+
+void CaptionExtractor::ExtractBytePairs(const EncodedFrame& frame,
+                                        std::vector<BytePair>* pairs) {
+  const std::string codec = NormalizeCodec(frame.stream_info->codec);
+  const bool is_hevc = codec == "hevc";
+  if (!is_hevc && codec != "h264")
+    return;
+
+  // SEI messages are left clear in encrypted frames, so only look at the clear
+  // bytes of each subsample.
+  std::vector<std::pair<size_t, size_t>> clear_ranges;
+  if (!frame.encryption_info) {
+    clear_ranges.emplace_back(0, frame.data_size);
+  } else {
+    size_t offset = 0;
+    for (const auto& subsample : frame.encryption_info->subsamples) {
+      clear_ranges.emplace_back(offset, offset + subsample.clear_bytes);
+      offset += subsample.clear_bytes + subsample.protected_bytes;
+    }
+  }
+
+  std::vector<std::pair<size_t, size_t>> nal_units;
+  FindNalUnits(frame.data, frame.data_size,
+               GetNalLengthSize(frame.stream_info->extra_data, is_hevc),
+               &nal_units);
+  // HEVC NAL units have a 2-byte header.
+  const size_t header_size = is_hevc ? 2 : 1;
+  for (const auto& nal_unit : nal_units) {
+    if (nal_unit.second <= header_size)
+      continue;
+    const uint8_t* nal = frame.data + nal_unit.first;
+    const uint8_t type = is_hevc ? (nal[0] >> 1) & 0x3f : nal[0] & 0x1f;
+    if (type != (is_hevc ? kHevcPrefixSeiType : kH264SeiType))
+      continue;
+
+    const size_t end = nal_unit.first + nal_unit.second;
+    for (const auto& range : clear_ranges) {
+      if (range.first <= nal_unit.first && end <= range.second) {
+        ParseSei(nal + header_size, nal_unit.second - header_size, frame.pts,
+                 pairs);
+        break;
+      }
+    }
+  }
+}
+
+void CaptionExtractor::Process(
+    const std::vector<std::shared_ptr<EncodedFrame>>& frames,
+    std::vector<std::shared_ptr<VTTCue>>* cues) {
+  std::vector<BytePair> pairs;
+  for (const auto& frame : frames)
+    ExtractBytePairs(*frame, &pairs);
+  if (pairs.empty())
+    return;
+
+  // The frames are in decode order, but the captions need to be decoded in
+  // presentation order.  The pairs within a frame stay in order.
+  std::stable_sort(
+      pairs.begin(), pairs.end(),
+      [](const BytePair& a, const BytePair& b) { return a.pts < b.pts; });
+  if (std::isnan(last_pts_) || pairs.front().pts < last_pts_ ||
+      pairs.front().pts > last_pts_ + kMaxCaptionGap) {
+    decoder_.Reset();
+  }
+  last_pts_ = pairs.back().pts;
+
+  std::vector<std::shared_ptr<VTTCue>> decoded;
+  for (const BytePair& pair : pairs)
+    decoder_.Decode(pair.pts, pair.byte1, pair.byte2, &decoded);
+  for (auto& cue : decoded) {
+    if (seen_cues_
+            .emplace(cue->start_time(), cue->end_time(), cue->text())
+            .second) {
+      cues->emplace_back(std::move(cue));
+    }
+  }
+}
+
+}  // namespace media
+}  // namespace shaka
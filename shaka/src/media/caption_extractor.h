@@ -0,0 +1,87 @@
+// Copyright 2020 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     https://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef SHAKA_EMBEDDED_MEDIA_CAPTION_EXTRACTOR_H_
+#define SHAKA_EMBEDDED_MEDIA_CAPTION_EXTRACTOR_H_
+
+#include <memory>
+#include <set>
+#include <string>
+#include <tuple>
+#include <vector>
+
+#include "shaka/media/frames.h"
+#include "shaka/media/vtt_cue.h"
+#include "src/media/cea608_decoder.h"
+#include "src/util/macros.h"
+
+namespace shaka {
+namespace media {
+
+/**
+ * Extracts the closed captions that are embedded in H.264 and HEVC frames and
+ * decodes them into cues.  The captions are carried in SEI messages
+ * (user_data_registered_itu_t_t35, with the ATSC A/53 "GA94" identifier) as
+ * CEA-708 cc_data, which holds the CEA-608 byte pairs.  Only the CEA-608 CC1
+ * channel is decoded; the CEA-708 services are skipped.
+ *
+ * This is only used from a single thread.
+ */
+class CaptionExtractor {
+ public:
+  /** A CEA-608 byte pair from field 1 of a frame. */
+  struct BytePair {
+    double pts;
+    uint8_t byte1;
+    uint8_t byte2;
+  };
+
+  CaptionExtractor();
+  ~CaptionExtractor();
+
+  SHAKA_NON_COPYABLE_OR_MOVABLE_TYPE(CaptionExtractor);
+
+  /**
+   * Reads the CEA-608 field 1 byte pairs from the given frame.  Only the clear
+   * parts of encrypted frames are read.
+   *
+   * @param frame The frame to read.
+   * @param pairs [OUT] Where to add the byte pairs, in the order they appear.
+   */
+  static void ExtractBytePairs(const EncodedFrame& frame,
+                               std::vector<BytePair>* pairs);
+
+  /**
+   * Decodes the captions in the given frames, which are in decode order and
+   * are usually a whole segment.  Cues that were already output (e.g. when a
+   * segment is appended again) aren't output again.
+   *
+   * @param frames The frames to read.
+   * @param cues [OUT] Where to add the completed cues.
+   */
+  void Process(const std::vector<std::shared_ptr<EncodedFrame>>& frames,
+               std::vector<std::shared_ptr<VTTCue>>* cues);
+
+ private:
+  Cea608Decoder decoder_;
+  // The presentation time of the last byte pair that was decoded.
+  double last_pts_;
+  // The start, end, and text of the cues that were output.
+  std::set<std::tuple<double, double, std::string>> seen_cues_;
+};
+
+}  // namespace media
+}  // namespace shaka
+
+#endif  // SHAKA_EMBEDDED_MEDIA_CAPTION_EXTRACTOR_H_
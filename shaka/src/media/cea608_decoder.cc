@@ -0,0 +1,305 @@
+// Copyright 2020 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     https://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "src/media/cea608_decoder.h"
+
+#include <algorithm>
+#include <utility>
+
+namespace shaka {
+namespace media {
+
+namespace {
+
+// The character sets from CEA-608 Section 6.4 and Annex B, in UTF-8.  The basic
+// set is mostly ASCII, with some accented letters in place of rare symbols.
+const char* const kBasicChars[] = {
+    " ", "!", "\"", "#", "$", "%", "&", "'", "(", ")", "\u00e1", "+", ",", "-",
+    ".", "/", "0", "1", "2", "3", "4", "5", "6", "7", "8", "9", ":", ";", "<",
+    "=", ">", "?", "@", "A", "B", "C", "D", "E", "F", "G", "H", "I", "J", "K",
+    "L", "M", "N", "O", "P", "Q", "R", "S", "T", "U", "V", "W", "X", "Y", "Z",
+    "[", "\u00e9", "]", "\u00ed", "\u00f3", "\u00fa", "a", "b", "c", "d", "e",
+    "f", "g", "h", "i", "j", "k", "l", "m", "n", "o", "p", "q", "r", "s", "t",
+    "u", "v", "w", "x", "y", "z", "\u00e7", "\u00f7", "\u00d1", "\u00f1",
+    "\u2588",
+};
+// Sent as 0x11 0x30-0x3f.
+const char* const kSpecialChars[] = {
+    "\u00ae", "\u00b0", "\u00bd", "\u00bf", "\u2122", "\u00a2", "\u00a3",
+    "\u266a", "\u00e0", " ", "\u00e8", "\u00e2", "\u00ea", "\u00ee", "\u00f4",
+    "\u00fb",
+};
+// Sent as 0x12 0x20-0x3f; Spanish, French, and miscellaneous.
+const char* const kExtendedChars1[] = {
+    "\u00c1", "\u00c9", "\u00d3", "\u00da", "\u00dc", "\u00fc", "\u2018",
+    "\u00a1", "*", "\u2019", "\u2014", "\u00a9", "\u2120", "\u2022", "\u201c",
+    "\u201d", "\u00c0", "\u00c2", "\u00c7", "\u00c8", "\u00ca", "\u00cb",
+    "\u00eb", "\u00ce", "\u00cf", "\u00ef", "\u00d4", "\u00d9", "\u00f9",
+    "\u00db", "\u00ab", "\u00bb",
+};
+// Sent as 0x13 0x20-0x3f; Portuguese, German, and Danish.
+const char* const kExtendedChars2[] = {
+    "\u00c3", "\u00e3", "\u00cd", "\u00cc", "\u00ec", "\u00d2", "\u00f2",
+    "\u00d5", "\u00f5", "{", "}", "\\", "^", "_", "|", "~", "\u00c4", "\u00e4",
+    "\u00d6", "\u00f6", "\u00df", "\u00a5", "\u00a4", "\u2502", "\u00c5",
+    "\u00e5", "\u00d8", "\u00f8", "\u250c", "\u2510", "\u2514", "\u2518",
+};
+
+// The row (1-based) that a preamble address code moves to, indexed by the low
+// bits of the first byte.  The second byte picks between this row and the next.
+const size_t kPreambleRows[] = {11, 1, 3, 12, 14, 5, 7, 9};
+
+}  // namespace
+
+constexpr const size_t Cea608Decoder::kRows;
+constexpr const size_t Cea608Decoder::kColumns;
+
+Cea608Decoder::Cea608Decoder() {
+  Reset();
+}
+
+Cea608Decoder::~Cea608Decoder() {}
+
+void Cea608Decoder::Reset() {
+  Clear(&displayed_);
+  Clear(&non_displayed_);
+  mode_ = Mode::None;
+  row_ = kRows - 1;
+  column_ = 0;
+  roll_up_rows_ = 2;
+  display_start_ = 0;
+  has_last_control_ = false;
+  in_channel_ = true;
+  text_mode_ = false;
+}
+
+void Cea608Decoder::Decode(double time, uint8_t byte1, uint8_t byte2,
+                           std::vector<std::shared_ptr<VTTCue>>* cues) {
+  // Remove the odd parity bits.
+  const uint8_t b1 = byte1 & 0x7f;
+  const uint8_t b2 = byte2 & 0x7f;
+  if (b1 == 0)
+    return;  // Padding.
+
+  if (b1 >= 0x10 && b1 <= 0x1f) {
+    if (has_last_control_ && last_control_[0] == b1 &&
+        last_control_[1] == b2) {
+      has_last_control_ = false;
+      return;
+    }
+    has_last_control_ = true;
+    last_control_[0] = b1;
+    last_control_[1] = b2;
+
+    // Bit 3 of the first byte selects between CC1 and CC2.
+    in_channel_ = (b1 & 0x08) == 0;
+    if (!in_channel_)
+      return;
+
+    const uint8_t code = b1 & 0xf7;
+    if ((code == 0x14 || code == 0x15) && b2 >= 0x20 && b2 <= 0x2f) {
+      HandleMiscCommand(time, b2, cues);
+    } else if (code == 0x17 && b2 >= 0x21 && b2 <= 0x23) {
+      // Tab offset.
+      column_ = std::min<size_t>(column_ + (b2 & 0x3), kColumns - 1);
+    } else if (code == 0x11 && b2 >= 0x20 && b2 <= 0x2f) {
+      // Mid-row style codes are displayed as a space.
+      WriteChar(time, " ");
+    } else if (code == 0x11 && b2 >= 0x30 && b2 <= 0x3f) {
+      WriteChar(time, kSpecialChars[b2 - 0x30]);
+    } else if ((code == 0x12 || code == 0x13) && b2 >= 0x20 && b2 <= 0x3f) {
+      // Extended characters replace the basic character sent before them for
+      // decoders that don't support them.
+      Backspace();
+      WriteChar(time, (code == 0x12 ? kExtendedChars1
+                                    : kExtendedChars2)[b2 - 0x20]);
+    } else if (b2 >= 0x40) {
+      HandlePreamble(code, b2);
+    }
+    return;
+  }
+
+  has_last_control_ = false;
+  if (b1 < 0x10) {
+    // XDS data continues until the next caption control code.
+    in_channel_ = false;
+    return;
+  }
+  if (!in_channel_)
+    return;
+
+  WriteChar(time, kBasicChars[b1 - 0x20]);
+  if (b2 >= 0x20)
+    WriteChar(time, kBasicChars[b2 - 0x20]);
+}
+
+void Cea608Decoder::HandleMiscCommand(
+    double time, uint8_t byte2, std::vector<std::shared_ptr<VTTCue>>* cues) {
+  switch (byte2) {
+    case 0x20:  // Resume caption loading.
+      SetMode(time, Mode::PopOn, cues);
+      break;
+    case 0x21:  // Backspace.
+      Backspace();
+      break;
+    case 0x24:  // Delete to end of row.
+      if (mode_ != Mode::None) {
+        Row& row = (*WriteMemory())[row_];
+        for (size_t i = column_; i < kColumns; i++)
+          row[i].clear();
+      }
+      break;
+    case 0x25:  // Roll-up captions, 2-4 rows.
+    case 0x26:
+    case 0x27:
+      roll_up_rows_ = byte2 - 0x23;
+      SetMode(time, Mode::RollUp, cues);
+      row_ = std::max(row_, roll_up_rows_ - 1);
+      break;
+    case 0x29:  // Resume direct captioning.
+      SetMode(time, Mode::PaintOn, cues);
+      break;
+    case 0x2a:  // Text restart.
+    case 0x2b:  // Resume text display.
+      text_mode_ = true;
+      break;
+    case 0x2c:  // Erase displayed memory.
+      EmitDisplayed(time, cues);
+      Clear(&displayed_);
+      break;
+    case 0x2d:  // Carriage return.
+      if (mode_ == Mode::RollUp && !text_mode_) {
+        EmitDisplayed(time, cues);
+        for (size_t i = row_ + 1 - roll_up_rows_; i < row_; i++)
+          displayed_[i] = displayed_[i + 1];
+        displayed_[row_] = Row();
+        column_ = 0;
+      }
+      break;
+    case 0x2e:  // Erase non-displayed memory.
+      Clear(&non_displayed_);
+      break;
+    case 0x2f:  // End of caption; flip the memories.
+      EmitDisplayed(time, cues);
+      std::swap(displayed_, non_displayed_);
+      mode_ = Mode::PopOn;
+      text_mode_ = false;
+      break;
+    default:
+      // Flash on and the alarm codes aren't displayed.
+      break;
+  }
+}
+
+void Cea608Decoder::HandlePreamble(uint8_t byte1, uint8_t byte2) {
+  size_t row = kPreambleRows[byte1 & 0x07];
+  if (byte1 != 0x10 && (byte2 & 0x20))
+    row++;
+  row--;
+
+  if (mode_ == Mode::RollUp) {
+    // Move the roll-up window to the new base row.
+    row = std::max(row, roll_up_rows_ - 1);
+    if (row != row_) {
+      const Memory old = displayed_;
+      Clear(&displayed_);
+      for (size_t i = 0; i < roll_up_rows_ && i <= row_; i++)
+        displayed_[row - i] = old[row_ - i];
+    }
+  }
+
+  row_ = row;
+  // Bit 4 selects an indent, in multiples of 4 columns; otherwise this sets a
+  // style and starts the row at column 0.
+  column_ = (byte2 & 0x10) ? ((byte2 & 0x0e) >> 1) * 4 : 0;
+}
+
+void Cea608Decoder::WriteChar(double time, const char* ch) {
+  if (text_mode_ || mode_ == Mode::None)
+    return;
+
+  Memory* memory = WriteMemory();
+  if (memory == &displayed_ && GetText(displayed_).empty())
+    display_start_ = time;
+  (*memory)[row_][column_] = ch;
+  // Characters past the last column replace the last character.
+  if (column_ < kColumns - 1)
+    column_++;
+}
+
+void Cea608Decoder::Backspace() {
+  if (mode_ != Mode::None && column_ > 0) {
+    column_--;
+    (*WriteMemory())[row_][column_].clear();
+  }
+}
+
+void Cea608Decoder::SetMode(double time, Mode mode,
+                            std::vector<std::shared_ptr<VTTCue>>* cues) {
+  text_mode_ = false;
+  if (mode == mode_)
+    return;
+
+  // Switching to or from roll-up captions erases the screen.
+  if (mode == Mode::RollUp || mode_ == Mode::RollUp) {
+    EmitDisplayed(time, cues);
+    Clear(&displayed_);
+    Clear(&non_displayed_);
+    if (mode == Mode::RollUp) {
+      row_ = kRows - 1;
+      column_ = 0;
+    }
+  }
+  mode_ = mode;
+}
+
+void Cea608Decoder::EmitDisplayed(double time,
+                                  std::vector<std::shared_ptr<VTTCue>>* cues) {
+  const std::string text = GetText(displayed_);
+  if (!text.empty() && time > display_start_)
+    cues->emplace_back(std::make_shared<VTTCue>(display_start_, time, text));
+  display_start_ = time;
+}
+
+Cea608Decoder::Memory* Cea608Decoder::WriteMemory() {
+  return mode_ == Mode::PopOn ? &non_displayed_ : &displayed_;
+}
+
+void Cea608Decoder::Clear(Memory* memory) {
+  for (Row& row : *memory) {
+    for (std::string& cell : row)
+      cell.clear();
+  }
+}
+
+std::string Cea608Decoder::GetText(const Memory& memory) {
+  std::string ret;
+  for (const Row& row : memory) {
+    std::string line;
+    for (const std::string& cell : row)
+      line += cell.empty() ? " " : cell;
+
+    const size_t start = line.find_first_not_of(' ');
+    if (start == std::string::npos)
+      continue;
+    const size_t end = line.find_last_not_of(' ');
+    if (!ret.empty())
+      ret += "\n";
+    ret += line.substr(start, end - start + 1);
+  }
+  return ret;
+}
+
+}  // namespace media
+}  // namespace shaka
@@ -0,0 +1,119 @@
+// Copyright 2020 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     https://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef SHAKA_EMBEDDED_MEDIA_CEA608_DECODER_H_
+#define SHAKA_EMBEDDED_MEDIA_CEA608_DECODER_H_
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <array>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "shaka/media/vtt_cue.h"
+#include "src/util/macros.h"
+
+namespace shaka {
+namespace media {
+
+/**
+ * Decodes the CC1 channel of CEA-608 closed captions into cues.  This is given
+ * the byte pairs of field 1 in presentation order.  Pop-on, roll-up, and
+ * paint-on captions are supported, including the special and extended
+ * characters; styles, colors, and the text mode channels are ignored.
+ *
+ * A cue is made each time the displayed captions change, so a caption is only
+ * output once it is removed (e.g. by the next caption or an erase command).
+ */
+class Cea608Decoder {
+ public:
+  /** The number of rows on the caption screen. */
+  static constexpr const size_t kRows = 15;
+  /** The number of columns on the caption screen. */
+  static constexpr const size_t kColumns = 32;
+
+  Cea608Decoder();
+  ~Cea608Decoder();
+
+  SHAKA_NON_COPYABLE_OR_MOVABLE_TYPE(Cea608Decoder);
+
+  /** Clears the screen and the decoder state, e.g. after a seek. */
+  void Reset();
+
+  /**
+   * Decodes the given byte pair.
+   *
+   * @param time The presentation time of the frame the pair came from.
+   * @param byte1 The first byte, including the parity bit.
+   * @param byte2 The second byte, including the parity bit.
+   * @param cues [OUT] Where to add any captions that were completed.
+   */
+  void Decode(double time, uint8_t byte1, uint8_t byte2,
+              std::vector<std::shared_ptr<VTTCue>>* cues);
+
+ private:
+  enum class Mode {
+    None,
+    PopOn,
+    RollUp,
+    PaintOn,
+  };
+
+  using Row = std::array<std::string, kColumns>;
+  using Memory = std::array<Row, kRows>;
+
+  void HandleMiscCommand(double time, uint8_t byte2,
+                         std::vector<std::shared_ptr<VTTCue>>* cues);
+  void HandlePreamble(uint8_t byte1, uint8_t byte2);
+  /** Writes the given UTF-8 character at the cursor. */
+  void WriteChar(double time, const char* ch);
+  void Backspace();
+  /** Sets the caption mode, erasing the screen if needed. */
+  void SetMode(double time, Mode mode,
+               std::vector<std::shared_ptr<VTTCue>>* cues);
+  /**
+   * Adds a cue for the displayed captions, if there are any, ending at the
+   * given time.  The next cue will start at the given time.
+   */
+  void EmitDisplayed(double time, std::vector<std::shared_ptr<VTTCue>>* cues);
+
+  /** @return The memory that characters are written to in this mode. */
+  Memory* WriteMemory();
+  static void Clear(Memory* memory);
+  static std::string GetText(const Memory& memory);
+
+  Memory displayed_;
+  Memory non_displayed_;
+  Mode mode_;
+  size_t row_;
+  size_t column_;
+  size_t roll_up_rows_;
+  // The time the displayed captions were shown.
+  double display_start_;
+  // Whether the last pair was a control code; control codes are sent twice,
+  // so the second copy is ignored.
+  bool has_last_control_;
+  uint8_t last_control_[2];
+  // Whether the current data is for CC1 (i.e. not CC2 or XDS data).
+  bool in_channel_;
+  // Whether the channel is in text mode, which isn't displayed.
+  bool text_mode_;
+};
+
+}  // namespace media
+}  // namespace shaka
+
+#endif  // SHAKA_EMBEDDED_MEDIA_CEA608_DECODER_H_
@@ -0,0 +1,160 @@
+// Copyright 2020 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     https://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "src/media/cue_index.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <tuple>
+
+namespace shaka {
+namespace media {
+
+namespace {
+
+/** The smallest number of leaves to allocate in the tree. */
+constexpr const size_t kMinLeafCount = 16;
+
+/** Incremented whenever the times of any cue change. */
+std::atomic<uint64_t> g_times_version_{0};
+
+}  // namespace
+
+CueIndex::CueIndex()
+    : leaf_count_(0), times_version_(g_times_version_), needs_rebuild_(false) {}
+CueIndex::~CueIndex() {}
+
+void CueIndex::Add(std::shared_ptr<VTTCue> cue) {
+  const double start = cue->start_time();
+  const double end = cue->end_time();
+  // Cues are usually added in order, so this can avoid re-sorting when there
+  // is room in the tree.
+  const bool in_order = entries_.empty() || entries_.back().start <= start;
+  entries_.push_back({start, end, std::move(cue)});
+  if (!needs_rebuild_ && in_order && entries_.size() <= leaf_count_)
+    SetEnd(entries_.size() - 1, end);
+  else
+    needs_rebuild_ = true;
+}
+
+void CueIndex::Remove(std::shared_ptr<VTTCue> cue) {
+  auto it = std::find_if(entries_.begin(), entries_.end(),
+                         [&](const Entry& entry) { return entry.cue == cue; });
+  if (it != entries_.end()) {
+    entries_.erase(it);
+    needs_rebuild_ = true;
+  }
+}
+
+std::vector<std::shared_ptr<VTTCue>> CueIndex::ActiveCues(double time) {
+  Update();
+  std::vector<std::shared_ptr<VTTCue>> ret;
+  ForEachActive(time, [&](const Entry& entry) { ret.emplace_back(entry.cue); });
+  return ret;
+}
+
+double CueIndex::NextChangeTime(double time) {
+  Update();
+  // The first cue that starts after |time|; or the first active cue to end.
+  double next_time = INFINITY;
+  auto it = std::upper_bound(
+      entries_.begin(), entries_.end(), time,
+      [](double time, const Entry& entry) { return time < entry.start; });
+  if (it != entries_.end())
+    next_time = it->start;
+  ForEachActive(time, [&](const Entry& entry) {
+    if (entry.end > time)
+      next_time = std::min(next_time, entry.end);
+  });
+  return next_time;
+}
+
+void CueIndex::Update() {
+  const uint64_t version = g_times_version_;
+  if (version != times_version_) {
+    times_version_ = version;
+    for (Entry& entry : entries_) {
+      entry.start = entry.cue->start_time();
+      entry.end = entry.cue->end_time();
+    }
+    needs_rebuild_ = true;
+  }
+  if (needs_rebuild_)
+    Rebuild();
+}
+
+void CueIndex::Rebuild() {
+  std::stable_sort(
+      entries_.begin(), entries_.end(),
+      [](const Entry& a, const Entry& b) { return a.start < b.start; });
+
+  // Leave room to append cues without rebuilding.
+  leaf_count_ = kMinLeafCount;
+  while (leaf_count_ < entries_.size() * 2)
+    leaf_count_ *= 2;
+  max_end_.assign(leaf_count_ * 2, -INFINITY);
+  for (size_t i = 0; i < entries_.size(); i++)
+    max_end_[leaf_count_ + i] = entries_[i].end;
+  for (size_t i = leaf_count_ - 1; i > 0; i--)
+    max_end_[i] = std::max(max_end_[i * 2], max_end_[i * 2 + 1]);
+  needs_rebuild_ = false;
+}
+
+void CueIndex::SetEnd(size_t index, double end) {
+  size_t node = leaf_count_ + index;
+  max_end_[node] = end;
+  while (node > 1) {
+    node /= 2;
+    max_end_[node] = std::max(max_end_[node * 2], max_end_[node * 2 + 1]);
+  }
+}
+
+template <typename Func>
+void CueIndex::ForEachActive(double time, Func func) const {
+  // Only cues before |limit| have started by |time|.
+  const size_t limit =
+      std::upper_bound(
+          entries_.begin(), entries_.end(), time,
+          [](double time, const Entry& entry) { return time < entry.start; }) -
+      entries_.begin();
+  if (limit == 0)
+    return;
+
+  // Walk the tree in order, skipping nodes whose cues have all ended.  Each
+  // element is the node index, the index of its first leaf, and its size.
+  std::vector<std::tuple<size_t, size_t, size_t>> nodes;
+  nodes.emplace_back(1, 0, leaf_count_);
+  while (!nodes.empty()) {
+    size_t node, first, size;
+    std::tie(node, first, size) = nodes.back();
+    nodes.pop_back();
+    if (first >= limit || max_end_[node] < time)
+      continue;
+
+    if (node >= leaf_count_) {
+      func(entries_[first]);
+    } else {
+      nodes.emplace_back(node * 2 + 1, first + size / 2, size / 2);
+      nodes.emplace_back(node * 2, first, size / 2);
+    }
+  }
+}
+
+void OnCueTimesChanged() {
+  g_times_version_++;
+}
+
+}  // namespace media
+}  // namespace shaka
@@ -0,0 +1,92 @@
+// Copyright 2020 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     https://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef SHAKA_EMBEDDED_MEDIA_CUE_INDEX_H_
+#define SHAKA_EMBEDDED_MEDIA_CUE_INDEX_H_
+
+#include <memory>
+#include <vector>
+
+#include "shaka/media/vtt_cue.h"
+
+namespace shaka {
+namespace media {
+
+/**
+ * Indexes a set of cues by their time ranges so the active cues at a time can
+ * be found without looking at every cue.  The cues are kept sorted by start
+ * time with a tree of the maximum end time over each range of cues, so a query
+ * only visits the parts of the tree that contain active cues.
+ *
+ * Cues that are added in order are appended to the index directly; otherwise
+ * the index is rebuilt the next time it is queried.  Since a cue's times can
+ * change after it is added, the index is also rebuilt if any cue's times have
+ * changed (see OnCueTimesChanged).
+ *
+ * This type is not thread-safe.
+ */
+class CueIndex {
+ public:
+  CueIndex();
+  ~CueIndex();
+
+  void Add(std::shared_ptr<VTTCue> cue);
+  void Remove(std::shared_ptr<VTTCue> cue);
+
+  /**
+   * @return The cues that should be displayed at the given time, sorted by
+   *   start time.
+   */
+  std::vector<std::shared_ptr<VTTCue>> ActiveCues(double time);
+
+  /**
+   * @return The nearest start or end time after the given time, or Infinity if
+   *   there isn't one.
+   */
+  double NextChangeTime(double time);
+
+ private:
+  struct Entry {
+    double start;
+    double end;
+    std::shared_ptr<VTTCue> cue;
+  };
+
+  void Update();
+  void Rebuild();
+  void SetEnd(size_t index, double end);
+  template <typename Func>
+  void ForEachActive(double time, Func func) const;
+
+  std::vector<Entry> entries_;
+  /**
+   * A binary tree, stored as an array, of the maximum end time of the entries
+   * under each node.  The leaves start at index |leaf_count_|.
+   */
+  std::vector<double> max_end_;
+  size_t leaf_count_;
+  uint64_t times_version_;
+  bool needs_rebuild_;
+};
+
+/**
+ * Called when the times of any cue change.  This causes every CueIndex to be
+ * rebuilt the next time it is used.
+ */
+void OnCueTimesChanged();
+
+}  // namespace media
+}  // namespace shaka
+
+#endif  // SHAKA_EMBEDDED_MEDIA_CUE_INDEX_H_
@@ -0,0 +1,517 @@
+// Copyright 2020 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     https://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "src/media/dav1d/dav1d_decoder.h"
+
+#include <glog/logging.h>
+
+extern "C" {
+#include <libavutil/mastering_display_metadata.h>
+}
+
+#include <errno.h>
+#include <string.h>
+
+#include <algorithm>
+#include <functional>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <utility>
+
+#include "src/media/decoder_thread.h"
+#include "src/media/decoding_info_cache.h"
+#include "src/media/ffmpeg/ffmpeg_decoded_frame.h"
+#include "src/media/media_utils.h"
+#include "src/media/segment_encoded_frame.h"
+#include "src/util/utils.h"
+
+namespace shaka {
+namespace media {
+namespace dav1d {
+
+namespace {
+
+#define LogError(code, extra_info)                                   \
+  LOG(ERROR) << (*(extra_info) = std::string("Error from dav1d: ") + \
+                                 strerror(-(code)))
+#define ALLOC_ERROR_STR "Error allocating memory"
+
+/**
+ * The number of pixels per second a single dav1d thread can decode for 8-bit
+ * video.  This is a conservative estimate for mid-range ARM cores (e.g. a
+ * Cortex-A72 decodes 1080p at about 15 fps per thread); desktop cores are
+ * several times faster.  10-bit video takes about twice as long.
+ */
+constexpr const double kPixelRatePerThread = 1920 * 1080 * 15;
+
+/**
+ * The number of pixels to pad the width and height of pictures to.  This is
+ * what dav1d's own allocator uses, so the decoder can write past the edges.
+ */
+constexpr const int kPictureSizeAlignment = 128;
+
+std::string GetCodecFromMime(const std::string& mime) {
+  std::unordered_map<std::string, std::string> params;
+  if (!ParseMimeType(mime, nullptr, nullptr, &params))
+    return "";
+  auto it = params.find(kCodecMimeParam);
+  return it != params.end() ? it->second : "";
+}
+
+/** @return The format of frames with the given picture parameters. */
+AVPixelFormat GetPixelFormat(const Dav1dPictureParameters& params) {
+  // The renderers only support 4:2:0, which is all the Main profile uses
+  // apart from monochrome.
+  if (params.layout != DAV1D_PIXEL_LAYOUT_I420)
+    return AV_PIX_FMT_NONE;
+  switch (params.bpc) {
+    case 8:
+      return AV_PIX_FMT_YUV420P;
+    case 10:
+      return AV_PIX_FMT_YUV420P10LE;
+    default:
+      return AV_PIX_FMT_NONE;
+  }
+}
+
+/** Copies the color info and HDR metadata of the picture to the frame. */
+bool SetColorInfo(const Dav1dPicture& pic, AVFrame* frame) {
+  // The AV1 color values are the same as the ones FFmpeg uses.
+  frame->color_primaries = static_cast<AVColorPrimaries>(pic.seq_hdr->pri);
+  frame->color_trc =
+      static_cast<AVColorTransferCharacteristic>(pic.seq_hdr->trc);
+  frame->colorspace = static_cast<AVColorSpace>(pic.seq_hdr->mtrx);
+  frame->color_range =
+      pic.seq_hdr->color_range ? AVCOL_RANGE_JPEG : AVCOL_RANGE_MPEG;
+
+  if (pic.mastering_display) {
+    AVMasteringDisplayMetadata* mastering =
+        av_mastering_display_metadata_create_side_data(frame);
+    if (!mastering)
+      return false;
+    // dav1d gives the values as fixed-point numbers.
+    for (size_t i = 0; i < 3; i++) {
+      for (size_t j = 0; j < 2; j++) {
+        mastering->display_primaries[i][j] =
+            av_make_q(pic.mastering_display->primaries[i][j], 1 << 16);
+      }
+    }
+    mastering->white_point[0] =
+        av_make_q(pic.mastering_display->white_point[0], 1 << 16);
+    mastering->white_point[1] =
+        av_make_q(pic.mastering_display->white_point[1], 1 << 16);
+    mastering->max_luminance =
+        av_make_q(pic.mastering_display->max_luminance, 1 << 8);
+    mastering->min_luminance =
+        av_make_q(pic.mastering_display->min_luminance, 1 << 14);
+    mastering->has_primaries = 1;
+    mastering->has_luminance = 1;
+  }
+  if (pic.content_light) {
+    AVContentLightMetadata* light =
+        av_content_light_metadata_create_side_data(frame);
+    if (!light)
+      return false;
+    light->MaxCLL = pic.content_light->max_content_light_level;
+    light->MaxFALL = pic.content_light->max_frame_average_light_level;
+  }
+  return true;
+}
+
+MediaCapabilitiesInfo QueryDecodingInfo(
+    const MediaDecodingConfiguration& config, uint32_t thread_count) {
+  MediaCapabilitiesInfo ret;
+  const std::string codec = GetCodecFromMime(config.video.content_type);
+  // e.g. "av01.0.08M.10"; only the Main profile (0) is 4:2:0.
+  const std::vector<std::string> parts = util::StringSplit(codec, '.');
+  const uint8_t bit_depth = GetCodecBitDepth(codec);
+  ret.supported = (parts.size() < 2 || parts[1] == "0") &&
+                  (bit_depth == 0 || bit_depth == 8 || bit_depth == 10);
+  if (!ret.supported)
+    return ret;
+
+  // This is a software decoder, so it is never power efficient; it is smooth
+  // if the threads can keep up with the pixel rate.  If the size isn't given,
+  // assume it is.
+  const double frame_rate =
+      config.video.framerate > 0 ? config.video.framerate : 30;
+  const double pixel_rate = static_cast<double>(config.video.width) *
+                            config.video.height * frame_rate *
+                            (bit_depth > 8 ? 2 : 1);
+  ret.smooth = pixel_rate <= thread_count * kPixelRatePerThread;
+  ret.power_efficient = false;
+  return ret;
+}
+
+}  // namespace
+
+Dav1dDecoder::Dav1dDecoder(const DecoderOptions& options,
+                           std::unique_ptr<Decoder> fallback)
+    : mutex_("Dav1dDecoder"),
+      options_(options),
+      fallback_(std::move(fallback)),
+      // Frames are kept for the decode window both ahead of and behind the
+      // playhead.
+      pool_(std::make_shared<ffmpeg::FFmpegFramePool>(
+          2 * DecoderThread::kDecodeBufferSize)),
+      context_(nullptr),
+      output_frame_(nullptr),
+      fallback_active_(false) {}
+
+Dav1dDecoder::~Dav1dDecoder() {
+  // This releases the pictures dav1d holds, so it must happen before the pool
+  // is destroyed.  It is safe if these fields are nullptr.
+  dav1d_close(&context_);
+  av_frame_free(&output_frame_);
+}
+
+// static
+bool Dav1dDecoder::IsDav1dCodec(const std::string& codec) {
+  return NormalizeCodec(codec) == "av01";
+}
+
+MediaCapabilitiesInfo Dav1dDecoder::DecodingInfo(
+    const MediaDecodingConfiguration& config) const {
+  if (config.video.content_type.empty() ||
+      !config.audio.content_type.empty() ||
+      config.type != MediaDecodingType::MediaSource ||
+      !IsDav1dCodec(GetCodecFromMime(config.video.content_type))) {
+    return fallback_ ? fallback_->DecodingInfo(config)
+                     : MediaCapabilitiesInfo();
+  }
+
+  // Whether it is smooth depends on the number of threads, so include that
+  // in the cache key.
+  const uint32_t thread_count = GetThreadCount();
+  return DecodingInfoCache::Instance.Get(
+      "dav1d-" + std::to_string(thread_count), config,
+      std::bind(&QueryDecodingInfo, config, thread_count));
+}
+
+void Dav1dDecoder::ResetDecoder() {
+  std::unique_lock<Mutex> lock(mutex_);
+  if (context_)
+    dav1d_flush(context_);
+  if (fallback_)
+    fallback_->ResetDecoder();
+}
+
+MediaStatus Dav1dDecoder::Decode(
+    std::shared_ptr<EncodedFrame> input, const eme::Implementation* eme,
+    std::vector<std::shared_ptr<DecodedFrame>>* frames,
+    std::string* extra_info) {
+  std::unique_lock<Mutex> lock(mutex_);
+  if (input) {
+    const bool use_fallback = !IsDav1dCodec(input->stream_info->codec);
+    const MediaStatus status =
+        SwitchDecoder(use_fallback, eme, frames, extra_info);
+    if (status != MediaStatus::Success)
+      return status;
+  }
+  if (fallback_active_)
+    return fallback_->Decode(std::move(input), eme, frames, extra_info);
+
+  if (!input) {
+    return context_ && !ReadPictures(true, frames, extra_info)
+               ? MediaStatus::FatalError
+               : MediaStatus::Success;
+  }
+
+  if (!context_ && !OpenDecoder(extra_info))
+    return MediaStatus::FatalError;
+
+  Dav1dData data{};
+  const MediaStatus status = MakeData(std::move(input), eme, &data, extra_info);
+  if (status != MediaStatus::Success)
+    return status;
+  util::Finally unref_data(std::bind(&dav1d_data_unref, &data));
+
+  // If dav1d can't take the data yet, read a picture and try again.
+  do {
+    const int send_code = dav1d_send_data(context_, &data);
+    if (send_code < 0 && send_code != DAV1D_ERR(EAGAIN)) {
+      LogError(send_code, extra_info);
+      return MediaStatus::FatalError;
+    }
+    if (!ReadPictures(false, frames, extra_info))
+      return MediaStatus::FatalError;
+  } while (data.sz > 0);
+  return MediaStatus::Success;
+}
+
+MediaStatus Dav1dDecoder::DecodeBatch(
+    const std::vector<std::shared_ptr<EncodedFrame>>& input,
+    const eme::Implementation* eme,
+    std::vector<std::shared_ptr<DecodedFrame>>* frames, size_t* consumed,
+    std::string* extra_info) {
+  // Batches are from a single stream, which is usually audio; give those to
+  // the fallback directly so it can decode them together.
+  if (!input.empty() && !IsDav1dCodec(input[0]->stream_info->codec)) {
+    std::unique_lock<Mutex> lock(mutex_);
+    *consumed = 0;
+    const MediaStatus status = SwitchDecoder(true, eme, frames, extra_info);
+    if (status != MediaStatus::Success)
+      return status;
+    return fallback_->DecodeBatch(input, eme, frames, consumed, extra_info);
+  }
+  return Decoder::DecodeBatch(input, eme, frames, consumed, extra_info);
+}
+
+void Dav1dDecoder::SetSkipNonReferenceFrames(bool skip) {
+  // dav1d can only skip frames when it is opened, so this only applies to the
+  // fallback.
+  if (fallback_)
+    fallback_->SetSkipNonReferenceFrames(skip);
+}
+
+void Dav1dDecoder::SetMaxOutputSize(uint32_t width, uint32_t height) {
+  if (fallback_)
+    fallback_->SetMaxOutputSize(width, height);
+}
+
+void Dav1dDecoder::SetPreferredPixelFormats(
+    const std::vector<PixelFormat>& formats) {
+  if (fallback_)
+    fallback_->SetPreferredPixelFormats(formats);
+}
+
+// static
+int Dav1dDecoder::AllocPicture(Dav1dPicture* pic, void* cookie) {
+  // This is called from dav1d's threads, but the pool is thread-safe.
+  auto* pool = reinterpret_cast<ffmpeg::FFmpegFramePool*>(cookie);
+  const AVPixelFormat format = GetPixelFormat(pic->p);
+  if (format == AV_PIX_FMT_NONE) {
+    LOG(ERROR) << "Unsupported AV1 pixel layout " << pic->p.layout << " at "
+               << pic->p.bpc << " bits";
+    return DAV1D_ERR(ENOTSUP);
+  }
+
+  AVFrame* frame = pool->AcquireFrame();
+  if (!frame)
+    return DAV1D_ERR(ENOMEM);
+  frame->format = format;
+  frame->width = pic->p.w;
+  frame->height = pic->p.h;
+
+  // With the padded width, every row and plane is aligned to the 64 bytes
+  // dav1d needs (DAV1D_PICTURE_ALIGNMENT).
+  const int width = FFALIGN(pic->p.w, kPictureSizeAlignment);
+  const int height = FFALIGN(pic->p.h, kPictureSizeAlignment);
+  const int bytes_per_sample = pic->p.bpc > 8 ? 2 : 1;
+  const int linesize[4] = {width * bytes_per_sample,
+                           width / 2 * bytes_per_sample,
+                           width / 2 * bytes_per_sample, 0};
+  if (pool->GetBuffer(frame, height, linesize) < 0) {
+    pool->ReleaseFrame(frame);
+    return DAV1D_ERR(ENOMEM);
+  }
+
+  for (size_t i = 0; i < 3; i++)
+    pic->data[i] = frame->data[i];
+  pic->stride[0] = linesize[0];
+  pic->stride[1] = linesize[1];
+  pic->allocator_data = frame;
+  return 0;
+}
+
+// static
+void Dav1dDecoder::ReleasePicture(Dav1dPicture* pic, void* cookie) {
+  auto* pool = reinterpret_cast<ffmpeg::FFmpegFramePool*>(cookie);
+  pool->ReleaseFrame(reinterpret_cast<AVFrame*>(pic->allocator_data));
+}
+
+// static
+void Dav1dDecoder::FreeInput(const uint8_t* /* data */, void* cookie) {
+  delete reinterpret_cast<std::shared_ptr<EncodedFrame>*>(cookie);
+}
+
+// static
+void Dav1dDecoder::FreeFrameInfo(const uint8_t* /* data */, void* cookie) {
+  delete reinterpret_cast<FrameInfo*>(cookie);
+}
+
+uint32_t Dav1dDecoder::GetThreadCount() const {
+  const uint32_t count = options_.GetThreading("av01").thread_count;
+  return count > 0 ? count : std::max(1u, std::thread::hardware_concurrency());
+}
+
+bool Dav1dDecoder::OpenDecoder(std::string* extra_info) {
+  if (!output_frame_) {
+    output_frame_ = av_frame_alloc();
+    if (!output_frame_) {
+      *extra_info = ALLOC_ERROR_STR;
+      return false;
+    }
+  }
+
+  Dav1dSettings settings;
+  dav1d_default_settings(&settings);
+  const DecoderThreadingOptions& threading = options_.GetThreading("av01");
+  // 0 means dav1d picks based on the CPU count.
+  settings.n_threads = threading.thread_count;
+  // dav1d always decodes tiles in parallel; a delay of 1 disables frame
+  // threading, which is what adds latency.
+  if (threading.low_delay || threading.thread_type == DecoderThreadType::Slice)
+    settings.max_frame_delay = 1;
+  settings.apply_grain = options_.apply_film_grain;
+  if (options_.fast_decode)
+    settings.inloop_filters = DAV1D_INLOOPFILTER_NONE;
+  // Only output the highest spatial layer, so there is one frame per input.
+  settings.all_layers = 0;
+  settings.allocator.cookie = pool_.get();
+  settings.allocator.alloc_picture_callback = &AllocPicture;
+  settings.allocator.release_picture_callback = &ReleasePicture;
+
+  const int code = dav1d_open(&context_, &settings);
+  if (code < 0) {
+    LogError(code, extra_info);
+    return false;
+  }
+  LOG(INFO) << "Using dav1d " << dav1d_version() << " for AV1";
+  return true;
+}
+
+MediaStatus Dav1dDecoder::SwitchDecoder(
+    bool use_fallback, const eme::Implementation* eme,
+    std::vector<std::shared_ptr<DecodedFrame>>* frames,
+    std::string* extra_info) {
+  if (use_fallback == fallback_active_)
+    return MediaStatus::Success;
+  if (use_fallback && !fallback_) {
+    LOG(ERROR) << (*extra_info = "No decoder for non-AV1 codec");
+    return MediaStatus::FatalError;
+  }
+
+  VLOG(1) << "Switching to " << (use_fallback ? "fallback decoder" : "dav1d");
+  MediaStatus status = MediaStatus::Success;
+  if (fallback_active_) {
+    status = fallback_->Decode(nullptr, eme, frames, extra_info);
+  } else if (context_ && !ReadPictures(true, frames, extra_info)) {
+    status = MediaStatus::FatalError;
+  }
+  fallback_active_ = use_fallback;
+  return status;
+}
+
+MediaStatus Dav1dDecoder::MakeData(std::shared_ptr<EncodedFrame> input,
+                                   const eme::Implementation* eme,
+                                   Dav1dData* data, std::string* extra_info) {
+  // If the encoded frame is encrypted, decrypt it first.  Frames that can be
+  // decrypted in place are used directly; otherwise the clear data is put in
+  // a new buffer.
+  if (input->encryption_info) {
+    if (!eme) {
+      LOG(WARNING) << (*extra_info = "No CDM given for encrypted frame");
+      return MediaStatus::KeyNotFound;
+    }
+
+    MediaStatus decrypt_status;
+    if (!SegmentEncodedFrame::DecryptInPlace(input.get(), eme,
+                                             &decrypt_status)) {
+      uint8_t* dest = dav1d_data_create(data, input->data_size);
+      if (!dest) {
+        *extra_info = ALLOC_ERROR_STR;
+        return MediaStatus::FatalError;
+      }
+      decrypt_status = input->Decrypt(eme, dest);
+    }
+    if (decrypt_status != MediaStatus::Success) {
+      dav1d_data_unref(data);
+      if (decrypt_status == MediaStatus::KeyNotFound)
+        return MediaStatus::KeyNotFound;
+      *extra_info = "CDM returned error while decrypting frame";
+      return MediaStatus::FatalError;
+    }
+  }
+
+  auto* info = new FrameInfo{input->stream_info, input->pts, input->duration};
+  if (!data->data) {
+    // dav1d reads the frame's own buffer, so keep the frame alive until dav1d
+    // is done with it.
+    auto* ref = new std::shared_ptr<EncodedFrame>(input);
+    const int code =
+        dav1d_data_wrap(data, input->data, input->data_size, &FreeInput, ref);
+    if (code < 0) {
+      delete ref;
+      delete info;
+      LogError(code, extra_info);
+      return MediaStatus::FatalError;
+    }
+  }
+
+  // dav1d gives this back with the picture made from this data.
+  const int code = dav1d_data_wrap_user_data(
+      data, reinterpret_cast<const uint8_t*>(info), &FreeFrameInfo, info);
+  if (code < 0) {
+    delete info;
+    dav1d_data_unref(data);
+    LogError(code, extra_info);
+    return MediaStatus::FatalError;
+  }
+  return MediaStatus::Success;
+}
+
+bool Dav1dDecoder::ReadPictures(
+    bool drain, std::vector<std::shared_ptr<DecodedFrame>>* frames,
+    std::string* extra_info) {
+  while (true) {
+    Dav1dPicture pic{};
+    const int code = dav1d_get_picture(context_, &pic);
+    if (code == DAV1D_ERR(EAGAIN))
+      return true;
+    if (code < 0) {
+      LogError(code, extra_info);
+      return false;
+    }
+    util::Finally unref_picture(std::bind(&dav1d_picture_unref, &pic));
+
+    // The picture is in a buffer from |pool_|, so the frame just takes a
+    // reference to it; dav1d may keep using the picture as a reference frame,
+    // but won't write to it.
+    auto* source = reinterpret_cast<AVFrame*>(pic.allocator_data);
+    output_frame_->buf[0] = av_buffer_ref(source->buf[0]);
+    if (!output_frame_->buf[0]) {
+      *extra_info = ALLOC_ERROR_STR;
+      return false;
+    }
+    output_frame_->format = source->format;
+    output_frame_->width = pic.p.w;
+    output_frame_->height = pic.p.h;
+    for (size_t i = 0; i < 3; i++) {
+      output_frame_->data[i] = reinterpret_cast<uint8_t*>(pic.data[i]);
+      output_frame_->linesize[i] = static_cast<int>(pic.stride[i > 0]);
+    }
+    output_frame_->extended_data = output_frame_->data;
+
+    auto* info = reinterpret_cast<const FrameInfo*>(pic.m.user_data.data);
+    std::shared_ptr<ffmpeg::FFmpegDecodedFrame> frame;
+    if (SetColorInfo(pic, output_frame_)) {
+      frame = ffmpeg::FFmpegDecodedFrame::CreateFrame(
+          info->stream_info, output_frame_, info->pts, info->duration, pool_);
+    }
+    if (!frame) {
+      av_frame_unref(output_frame_);
+      *extra_info = ALLOC_ERROR_STR;
+      return false;
+    }
+    frames->emplace_back(std::move(frame));
+    if (!drain)
+      return true;
+  }
+}
+
+}  // namespace dav1d
+}  // namespace media
+}  // namespace shaka
@@ -0,0 +1,127 @@
+// Copyright 2020 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     https://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef SHAKA_EMBEDDED_MEDIA_DAV1D_DAV1D_DECODER_H_
+#define SHAKA_EMBEDDED_MEDIA_DAV1D_DAV1D_DECODER_H_
+
+extern "C" {
+#include <dav1d/dav1d.h>
+#include <libavutil/frame.h>
+}
+
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "shaka/media/decoder.h"
+#include "shaka/media/frames.h"
+#include "shaka/media/stream_info.h"
+#include "src/debug/mutex.h"
+#include "src/media/ffmpeg/ffmpeg_frame_pool.h"
+
+namespace shaka {
+namespace media {
+namespace dav1d {
+
+/**
+ * A Decoder that decodes AV1 using dav1d, which is much faster than the
+ * generic FFmpeg path; other codecs are given to a fallback decoder.  dav1d
+ * decodes directly into buffers from an FFmpegFramePool, so the pictures
+ * aren't copied and this produces FFmpegDecodedFrame objects like the
+ * FFmpegDecoder does.
+ *
+ * The threading options for "av01" set the number of threads; dav1d splits
+ * them between tiles and frames itself.  Slice threading or low delay limits
+ * it to tile threads, which doesn't add latency.
+ *
+ * See Decoder::CreateDefaultDecoder.
+ */
+class Dav1dDecoder final : public Decoder {
+ public:
+  Dav1dDecoder(const DecoderOptions& options,
+               std::unique_ptr<Decoder> fallback);
+  ~Dav1dDecoder() override;
+
+  /** @return Whether the given codec string is decoded by dav1d. */
+  static bool IsDav1dCodec(const std::string& codec);
+
+  MediaCapabilitiesInfo DecodingInfo(
+      const MediaDecodingConfiguration& config) const override;
+  void ResetDecoder() override;
+  MediaStatus Decode(std::shared_ptr<EncodedFrame> input,
+                     const eme::Implementation* eme,
+                     std::vector<std::shared_ptr<DecodedFrame>>* frames,
+                     std::string* extra_info) override;
+  MediaStatus DecodeBatch(
+      const std::vector<std::shared_ptr<EncodedFrame>>& input,
+      const eme::Implementation* eme,
+      std::vector<std::shared_ptr<DecodedFrame>>* frames, size_t* consumed,
+      std::string* extra_info) override;
+  void SetSkipNonReferenceFrames(bool skip) override;
+  void SetMaxOutputSize(uint32_t width, uint32_t height) override;
+  void SetPreferredPixelFormats(
+      const std::vector<PixelFormat>& formats) override;
+
+ private:
+  /** The info of an input frame, which dav1d passes to its picture. */
+  struct FrameInfo {
+    std::shared_ptr<const StreamInfo> stream_info;
+    double pts;
+    double duration;
+  };
+
+  static int AllocPicture(Dav1dPicture* pic, void* cookie);
+  static void ReleasePicture(Dav1dPicture* pic, void* cookie);
+  static void FreeInput(const uint8_t* data, void* cookie);
+  static void FreeFrameInfo(const uint8_t* data, void* cookie);
+
+  /** @return The number of threads dav1d uses. */
+  uint32_t GetThreadCount() const;
+  bool OpenDecoder(std::string* extra_info);
+  /**
+   * Gets the frames still in the inactive decoder when switching between
+   * dav1d and the fallback decoder.
+   */
+  MediaStatus SwitchDecoder(bool use_fallback, const eme::Implementation* eme,
+                            std::vector<std::shared_ptr<DecodedFrame>>* frames,
+                            std::string* extra_info);
+  /** Fills |data| with the (decrypted) contents of the given frame. */
+  MediaStatus MakeData(std::shared_ptr<EncodedFrame> input,
+                       const eme::Implementation* eme, Dav1dData* data,
+                       std::string* extra_info);
+  /**
+   * Gets the next decoded picture, if there is one.  dav1d treats repeated
+   * calls without new data as a flush, so frame threads wait for their
+   * frames; if |drain| is true, this gets every frame still in the decoder.
+   */
+  bool ReadPictures(bool drain,
+                    std::vector<std::shared_ptr<DecodedFrame>>* frames,
+                    std::string* extra_info);
+
+  Mutex mutex_;
+  const DecoderOptions options_;
+  const std::unique_ptr<Decoder> fallback_;
+  const std::shared_ptr<ffmpeg::FFmpegFramePool> pool_;
+
+  Dav1dContext* context_;
+  AVFrame* output_frame_;
+  // Whether the last frame was given to |fallback_|.
+  bool fallback_active_;
+};
+
+}  // namespace dav1d
+}  // namespace media
+}  // namespace shaka
+
+#endif  // SHAKA_EMBEDDED_MEDIA_DAV1D_DAV1D_DECODER_H_
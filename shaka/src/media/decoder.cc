@@ -14,11 +14,17 @@
 
 #include "shaka/media/decoder.h"
 
+#include <utility>
+
 #if defined(HAS_FFMPEG_DECODER)
 #  include "src/media/ffmpeg/ffmpeg_decoder.h"
+#  ifdef HAS_DAV1D_DECODER
+#    include "src/media/dav1d/dav1d_decoder.h"
+#  endif
 #elif defined(HAS_APPLE_DECODER)
 #  include "src/media/apple/apple_decoder.h"
 #endif
+#include "src/media/media_utils.h"
 
 namespace shaka {
 namespace media {
@@ -28,9 +34,62 @@ Decoder::Decoder() {}
 Decoder::~Decoder() {}
 // \endcond Doxygen_Skip
 
+MediaStatus Decoder::DecodeBatch(
+    const std::vector<std::shared_ptr<EncodedFrame>>& input,
+    const eme::Implementation* eme,
+    std::vector<std::shared_ptr<DecodedFrame>>* frames, size_t* consumed,
+    std::string* extra_info) {
+  *consumed = 0;
+  for (auto& frame : input) {
+    const MediaStatus status = Decode(frame, eme, frames, extra_info);
+    if (status != MediaStatus::Success)
+      return status;
+    (*consumed)++;
+  }
+  return MediaStatus::Success;
+}
+
+void Decoder::SetSkipNonReferenceFrames(bool skip) {}
+
+void Decoder::SetMaxOutputSize(uint32_t width, uint32_t height) {}
+
+void Decoder::SetPreferredPixelFormats(
+    const std::vector<PixelFormat>& formats) {}
+
+DecoderOptions::DecoderOptions() {}
+DecoderOptions::DecoderOptions(const DecoderOptions&) = default;
+DecoderOptions::DecoderOptions(DecoderOptions&&) = default;
+DecoderOptions::~DecoderOptions() {}
+
+DecoderOptions& DecoderOptions::operator=(const DecoderOptions&) = default;
+DecoderOptions& DecoderOptions::operator=(DecoderOptions&&) = default;
+
+const DecoderThreadingOptions& DecoderOptions::GetThreading(
+    const std::string& codec) const {
+  // Compare the normalized names so aliases like "hev1" and "hvc1" match.
+  const std::string normalized = NormalizeCodec(codec);
+  for (const auto& pair : codec_threading) {
+    if (NormalizeCodec(pair.first) == normalized)
+      return pair.second;
+  }
+  return threading;
+}
+
 std::unique_ptr<Decoder> Decoder::CreateDefaultDecoder() {
+  return CreateDefaultDecoder(DecoderOptions());
+}
+
+std::unique_ptr<Decoder> Decoder::CreateDefaultDecoder(
+    const DecoderOptions& options) {
 #if defined(HAS_FFMPEG_DECODER)
-  return std::unique_ptr<Decoder>(new ffmpeg::FFmpegDecoder);
+  std::unique_ptr<Decoder> ffmpeg_decoder(new ffmpeg::FFmpegDecoder(options));
+#  ifdef HAS_DAV1D_DECODER
+  // AV1 is decoded by dav1d; everything else by FFmpeg.
+  return std::unique_ptr<Decoder>(
+      new dav1d::Dav1dDecoder(options, std::move(ffmpeg_decoder)));
+#  else
+  return ffmpeg_decoder;
+#  endif
 #elif defined(HAS_APPLE_DECODER)
   return std::unique_ptr<Decoder>(new apple::AppleDecoder);
 #else
@@ -22,20 +22,78 @@
 #include <utility>
 #include <vector>
 
+#include "src/debug/startup_tracer.h"
+#include "src/debug/telemetry.h"
+#include "src/debug/trace_event.h"
+#include "src/media/decrypt_thread.h"
+#include "src/media/media_utils.h"
+#include "src/media/segment_encoded_frame.h"
 #include "src/util/clock.h"
-#include "src/util/utils.h"
 
 namespace shaka {
 namespace media {
 
 namespace {
 
-/** The number of seconds to keep decoded ahead of the playhead. */
-constexpr const double kDecodeBufferSize = 1;
-
 /** The number of seconds gap before we assume we are at the end. */
 constexpr const double kEndDelta = 0.1;
 
+/**
+ * The number of frames to always decode ahead of the playhead, even if the
+ * frame or byte limits have been reached, so playback can still progress.
+ */
+constexpr const size_t kMinFramesAhead = 2;
+
+/**
+ * The number of encrypted frames to decrypt together ahead of the decoder.
+ * This lets the EME implementation share work between the frames.
+ */
+constexpr const size_t kDecryptBatchSize = 16;
+
+/**
+ * The number of audio frames to give the decoder in one call.  Audio frames
+ * are small and quick to decode, so this saves the locking and bookkeeping
+ * done for each call.  This is smaller than kDecryptBatchSize so batches are
+ * usually already decrypted.
+ */
+constexpr const size_t kAudioDecodeBatchSize = 8;
+
+/**
+ * The number of keyframes to decode ahead of the playhead in trick play.  The
+ * decoded frames have gaps between them, so the decode-ahead policy's seconds
+ * can't be used.
+ */
+constexpr const size_t kTrickPlayFramesAhead = 4;
+
+/**
+ * The number of seconds the next frame to decode can be behind the playhead
+ * before non-reference frames are skipped.  Those frames would be dropped by
+ * the renderer, so decoding them is wasted work.
+ */
+constexpr const double kSkipNonReferenceLateness = 0.1;
+
+/**
+ * The number of seconds the next frame to decode can be behind the playhead
+ * before skipping ahead to the next keyframe.
+ */
+constexpr const double kCatchUpLateness = 0.5;
+
+/**
+ * When splicing in a new audio track, the first new frame can start this many
+ * seconds before the end of the old frames.  This is about half an audio frame,
+ * so the splice has at most that much overlap or gap.
+ */
+constexpr const double kSpliceTolerance = 0.01;
+
+/** @return Whether |stream| has a decoded frame at the given time. */
+bool IsDecodedAt(StreamBase* stream, double time) {
+  for (auto& range : stream->GetBufferedRanges()) {
+    if (range.end > time)
+      return range.start <= time;
+  }
+  return false;
+}
+
 double DecodedAheadOf(StreamBase* stream, double time) {
   for (auto& range : stream->GetBufferedRanges()) {
     if (range.end > time) {
@@ -52,150 +110,504 @@ double DecodedAheadOf(StreamBase* stream, double time) {
 
 }  // namespace
 
-DecoderThread::DecoderThread(Client* client, DecodedStream* output)
+DecoderThread::DecoderThread(Client* client, DecodedStream* output,
+                             bool decrypt_ahead, WorkerPool* pool)
     : mutex_("DecoderThread"),
-      signal_("DecoderChanged"),
       client_(client),
       input_(nullptr),
       output_(output),
       decoder_(nullptr),
       cdm_(nullptr),
+      physical_memory_(GetPhysicalMemory()),
       last_frame_time_(NAN),
-      shutdown_(false),
+      seek_target_(NAN),
+      decrypted_until_(NAN),
       did_flush_(false),
+      did_seek_(false),
+      retain_behind_(kDecodeBufferSize),
       raised_waiting_event_(false),
-      thread_("Decoder", std::bind(&DecoderThread::ThreadMain, this)) {}
+      low_latency_(false),
+      suspended_(false),
+      trick_play_(false),
+      skipping_non_reference_(false),
+      max_output_width_(0),
+      max_output_height_(0),
+      decrypt_thread_(decrypt_ahead ? new DecryptThread(client, pool)
+                                    : nullptr),
+      budget_consumer_(memory::MemorySubsystem::DecodedFrames, "DecodedStream",
+                       [output]() { return output->EstimateSize(); }),
+      removed_mutex_("DecoderThread removed"),
+      removed_start_(NAN),
+      removed_end_(NAN),
+      task_("Decoder", pool, &util::Clock::Instance,
+            std::bind(&DecoderThread::DecodeStep, this)) {}
 
 DecoderThread::~DecoderThread() {
-  {
-    std::unique_lock<Mutex> lock(mutex_);
-    shutdown_ = true;
-    signal_.SignalAllIfNotSet();
-  }
-  thread_.join();
+  task_.Stop();
 }
 
 void DecoderThread::Attach(const ElementaryStream* input) {
   VLOG(2) << "Attach";
   std::unique_lock<Mutex> lock(mutex_);
   input_ = input;
+  if (decrypt_thread_ && !suspended_)
+    decrypt_thread_->Attach(input);
   if (input && decoder_)
-    signal_.SignalAllIfNotSet();
+    task_.Wake();
 }
 
 void DecoderThread::Detach() {
   VLOG(2) << "Detach";
   std::unique_lock<Mutex> lock(mutex_);
   input_ = nullptr;
+  if (decrypt_thread_)
+    decrypt_thread_->Detach();
   Reset();
 }
 
 void DecoderThread::OnSeek() {
   VLOG(2) << "OnSeek";
   std::unique_lock<Mutex> lock(mutex_);
-  Reset();
+  if (decrypt_thread_)
+    decrypt_thread_->OnSeek();
+  // Wait until the next step to reset so the frames around the playhead are
+  // kept if the new time is inside them.
+  did_seek_ = true;
 }
 
 void DecoderThread::SetCdm(eme::Implementation* cdm) {
   VLOG(2) << "SetCdm: " << cdm;
   std::unique_lock<Mutex> lock(mutex_);
   cdm_ = cdm;
+  if (decrypt_thread_)
+    decrypt_thread_->SetCdm(cdm);
 }
 
 void DecoderThread::SetDecoder(Decoder* decoder) {
   VLOG(2) << "SetDecoder: " << decoder;
   std::unique_lock<Mutex> lock(mutex_);
+  if (decoder_ && skipping_non_reference_)
+    decoder_->SetSkipNonReferenceFrames(false);
+  skipping_non_reference_ = false;
+  max_output_width_ = max_output_height_ = 0;
+  pixel_formats_.clear();
   decoder_ = decoder;
   if (decoder && input_)
-    signal_.SignalAllIfNotSet();
+    task_.Wake();
 }
 
-void DecoderThread::ThreadMain() {
+void DecoderThread::SetDecodeAheadPolicy(const DecodeAheadPolicy& policy) {
+  VLOG(2) << "SetDecodeAheadPolicy: " << policy.seconds << "s, "
+          << policy.frames << " frames, " << policy.bytes << " bytes";
   std::unique_lock<Mutex> lock(mutex_);
-  while (!shutdown_) {
-    if (!input_ || !decoder_) {
-      if (input_)
-        LOG(DFATAL) << "No decoder provided and no default decoder exists";
+  policy_ = policy;
+}
 
-      signal_.ResetAndWaitWhileUnlocked(lock);
-      continue;
-    }
+void DecoderThread::SetPriority(int priority) {
+  if (decrypt_thread_)
+    decrypt_thread_->SetPriority(priority);
+  task_.SetPriority(priority);
+}
 
-    const double cur_time = client_->CurrentTime();
-    double last_time = last_frame_time_;
+void DecoderThread::SetLowLatency(bool low_latency) {
+  std::unique_lock<Mutex> lock(mutex_);
+  low_latency_ = low_latency;
+}
 
-    if (DecodedAheadOf(output_, cur_time) > kDecodeBufferSize) {
-      VLOG(2) << "Enough buffered";
-      util::Unlocker<Mutex> unlock(&lock);
-      util::Clock::Instance.SleepSeconds(0.025);
-      continue;
+void DecoderThread::SetRetainBehind(double seconds) {
+  VLOG(2) << "SetRetainBehind: " << seconds;
+  std::unique_lock<Mutex> lock(mutex_);
+  retain_behind_ = seconds;
+}
+
+void DecoderThread::SetSuspended(bool suspended) {
+  VLOG(2) << "SetSuspended: " << suspended;
+  std::unique_lock<Mutex> lock(mutex_);
+  if (suspended == suspended_)
+    return;
+
+  suspended_ = suspended;
+  // Stop decrypting ahead while suspended; this will start again from the
+  // playhead when re-attached.
+  if (decrypt_thread_)
+    decrypt_thread_->Attach(suspended ? nullptr : input_);
+  // Drop the decoded frames when suspending to free their memory.  When
+  // resuming, this also starts decoding from the keyframe before the playhead
+  // since the frames since suspending were skipped.
+  Reset();
+  if (!suspended && input_ && decoder_)
+    task_.Wake();
+}
+
+void DecoderThread::SetTrickPlay(bool trick_play) {
+  VLOG(2) << "SetTrickPlay: " << trick_play;
+  std::unique_lock<Mutex> lock(mutex_);
+  if (trick_play == trick_play_)
+    return;
+
+  trick_play_ = trick_play;
+  // The decoded frames are either missing the frames between keyframes or
+  // have more frames than needed, so start over from the playhead.
+  Reset();
+  if (input_ && decoder_)
+    task_.Wake();
+}
+
+void DecoderThread::OnInputChanged() {
+  task_.Wake();
+}
+
+void DecoderThread::OnInputRemoved(double start, double end) {
+  VLOG(2) << "OnInputRemoved: " << start << " - " << end;
+  std::unique_lock<Mutex> lock(removed_mutex_);
+  if (std::isnan(removed_start_)) {
+    removed_start_ = start;
+    removed_end_ = end;
+  } else {
+    removed_start_ = std::min(removed_start_, start);
+    removed_end_ = std::max(removed_end_, end);
+  }
+  task_.Wake();
+}
+
+double DecoderThread::DecodeStep() {
+  std::unique_lock<Mutex> lock(mutex_);
+  if (suspended_)
+    return WorkerTask::kWaitForWake;
+  if (!input_ || !decoder_) {
+    if (input_)
+      LOG(DFATAL) << "No decoder provided and no default decoder exists";
+    return WorkerTask::kWaitForWake;
+  }
+
+  const double cur_time = client_->CurrentTime();
+  if (did_seek_) {
+    did_seek_ = false;
+    // The decoder is still in order, so if the new time is already decoded,
+    // keep decoding after the last frame as if there wasn't a seek.
+    if (IsDecodedAt(output_, cur_time))
+      VLOG(2) << "Seek target already decoded";
+    else
+      Reset();
+  }
+  {
+    double removed_start, removed_end;
+    {
+      std::unique_lock<Mutex> removed_lock(removed_mutex_);
+      removed_start = removed_start_;
+      removed_end = removed_end_;
+      removed_start_ = removed_end_ = NAN;
     }
+    if (!std::isnan(removed_start))
+      SpliceRemovedRange(removed_start, removed_end, cur_time);
+  }
+  double last_time = last_frame_time_;
+  const JsManager::MemoryPressure pressure = GetMemoryPressure();
+  const DecodeAheadPolicy policy =
+      GetEffectiveDecodeAheadPolicy(policy_, pressure, physical_memory_);
+
+  // Evict frames that are not near the current time.  This ensures we don't
+  // keep frames buffered forever.  This is done first so old frames don't
+  // count against the byte limit.
+  const double buffer_size =
+      low_latency_ ? std::min(retain_behind_, kLowLatencyDecodeBufferSize)
+                   : retain_behind_;
+  output_->Remove(0,
+                  cur_time - buffer_size * GetMemoryPressureFactor(pressure));
+
+  if (HasDecodedEnough(cur_time, policy)) {
+    VLOG(2) << "Enough buffered";
+    return 0.025;
+  }
+
+  std::shared_ptr<EncodedFrame> frame;
+  if (std::isnan(last_time)) {
+    decoder_->ResetDecoder();
+    // In trick play, the keyframe before the playhead is the frame to show.
+    seek_target_ = trick_play_ ? NAN : cur_time;
+    // Move the time forward a bit to allow gaps at the start.  This will move
+    // backward to find a keyframe anyway.
+    frame = input_->GetFrame(cur_time + StreamBase::kMaxGapSize,
+                             FrameLocation::KeyFrameBefore);
+  } else if (trick_play_) {
+    // Skip the keyframes the playhead has already passed.
+    frame = input_->GetFrame(std::max(last_time, cur_time),
+                             FrameLocation::KeyFrameAfter);
+  } else {
+    frame = input_->GetFrame(last_time, FrameLocation::After);
+    // Frames before a seek target are expected to be behind the playhead, and
+    // are needed to decode the target.
+    if (frame && std::isnan(seek_target_))
+      frame = SkipToKeyFrameIfLate(frame, cur_time);
+  }
 
-    // Evict frames that are not near the current time.  This ensures we don't
-    // keep frames buffered forever.
-    output_->Remove(0, cur_time - kDecodeBufferSize);
-
-    std::shared_ptr<EncodedFrame> frame;
-    if (std::isnan(last_time)) {
-      decoder_->ResetDecoder();
-      // Move the time forward a bit to allow gaps at the start.  This will move
-      // backward to find a keyframe anyway.
-      frame = input_->GetFrame(cur_time + StreamBase::kMaxGapSize,
-                               FrameLocation::KeyFrameBefore);
+  if (!frame) {
+    // In trick play, the last keyframe can be well before the end, so check
+    // whether the input is buffered until the end instead.
+    double end_time = last_time;
+    if (trick_play_ && !std::isnan(last_time)) {
+      const auto buffered = input_->GetBufferedRanges();
+      if (!buffered.empty())
+        end_time = std::max(end_time, buffered.back().end);
+    }
+    if (!std::isnan(last_time) &&
+        end_time + kEndDelta >= client_->Duration() && !did_flush_) {
+      // If this is the last frame, pass the null to DecodeFrame, which will
+      // flush the decoder.
+      did_flush_ = true;
     } else {
-      frame = input_->GetFrame(last_time, FrameLocation::After);
+      const double time = std::isnan(last_time) ? cur_time : last_time;
+      VLOG(2) << "No frame available at: " << time;
+      return 0.025;
     }
+  }
 
-    if (!frame) {
-      if (!std::isnan(last_time) &&
-          last_time + kEndDelta >= client_->Duration() && !did_flush_) {
-        // If this is the last frame, pass the null to DecodeFrame, which will
-        // flush the decoder.
-        did_flush_ = true;
-      } else {
-        const double time = std::isnan(last_time) ? cur_time : last_time;
-        VLOG(2) << "No frame available at: " << time;
-        util::Unlocker<Mutex> unlock(&lock);
-        util::Clock::Instance.SleepSeconds(0.025);
-        continue;
-      }
-    }
+  // Only decrypt frames that weren't part of a previous batch; this is true
+  // when |decrypted_until_| is NAN.  If the decrypt thread is used, it has
+  // already decrypted the frames it can.
+  if (frame)
+    UpdateSkipNonReference(*frame, cur_time);
+  if (frame && frame->stream_info->is_video) {
+    UpdateMaxOutputSize();
+    UpdatePixelFormats();
+  }
+
+  if (!decrypt_thread_ && frame && frame->encryption_info && cdm_ &&
+      !(frame->dts <= decrypted_until_)) {
+    DecryptAhead(frame);
+  }
 
-    std::string error;
-    std::vector<std::shared_ptr<DecodedFrame>> decoded;
-    const MediaStatus decode_status =
-        decoder_->Decode(frame, cdm_, &decoded, &error);
-    if (decode_status == MediaStatus::KeyNotFound) {
-      VLOG(2) << "Key not found";
-      // If we don't have the required key, signal the <video> and wait.
-      if (!raised_waiting_event_) {
-        raised_waiting_event_ = true;
-        client_->OnWaitingForKey();
+  // Audio frames are decoded in batches; video frames take long enough to
+  // decode that they are given to the renderers as soon as possible.
+  std::vector<std::shared_ptr<EncodedFrame>> batch;
+  if (frame) {
+    batch.emplace_back(frame);
+    if (!frame->stream_info->is_video && !trick_play_) {
+      while (batch.size() < kAudioDecodeBatchSize) {
+        auto next = input_->GetFrame(batch.back()->dts, FrameLocation::After);
+        if (!next)
+          break;
+        batch.emplace_back(std::move(next));
       }
-      // TODO: Consider adding a signal for new keys so we can avoid polling and
-      // just wait on a condition variable.
-      util::Unlocker<Mutex> unlock(&lock);
-      util::Clock::Instance.SleepSeconds(0.2);
-      continue;
     }
-    if (decode_status != MediaStatus::Success) {
-      VLOG(2) << "Decoder error: " << error;
-      client_->OnError(error);
-      break;
+  }
+
+  std::string error;
+  std::vector<std::shared_ptr<DecodedFrame>> decoded;
+  size_t consumed = 0;
+  const uint64_t decode_start = DurationHistogram::Now();
+  MediaStatus decode_status;
+  {
+    TRACE_EVENT("media", "Decode");
+    if (batch.empty()) {
+      decode_status = decoder_->Decode(nullptr, cdm_, &decoded, &error);
+    } else {
+      for (auto& encoded : batch)
+        TRACE_FRAME_END(encoded.get());
+      decode_status =
+          decoder_->DecodeBatch(batch, cdm_, &decoded, &consumed, &error);
     }
+    for (auto& decoded_frame : decoded)
+      TRACE_FRAME_BEGIN(decoded_frame.get());
+  }
+  const uint64_t decode_end = DurationHistogram::Now();
+  if (decode_status != MediaStatus::Success &&
+      decode_status != MediaStatus::KeyNotFound) {
+    VLOG(2) << "Decoder error: " << error;
+    client_->OnError(error);
+    return WorkerTask::kStop;
+  }
+
+  // When flushing there is no input frame, so use the output frames instead.
+  const BaseFrame* info_frame =
+      frame ? static_cast<const BaseFrame*>(frame.get())
+            : (decoded.empty() ? nullptr : decoded.front().get());
+  if (info_frame && (consumed > 0 || !frame)) {
+    Telemetry::StreamEntry* telemetry =
+        Telemetry::GetStream(info_frame->stream_info->is_video);
+    telemetry->decode_latency.Add(decode_end - decode_start);
+    telemetry->frames_decoded.fetch_add(decoded.size(),
+                                        std::memory_order_relaxed);
+  }
+  if (!decoded.empty())
+    StartupTracer::Instance.AddFirstMilestone("First decode");
+  // Frames decoded before a missing key are kept, so they are added before
+  // waiting for the key.
+  std::vector<std::shared_ptr<DecodedFrame>> to_add;
+  to_add.reserve(decoded.size());
+  for (auto& decoded_frame : decoded) {
+    // Frames between the keyframe and the seek target would be evicted right
+    // away, so don't make the renderers see them.
+    if (decoded_frame->pts + decoded_frame->duration <= seek_target_)
+      continue;
+    seek_target_ = NAN;
+    to_add.emplace_back(std::move(decoded_frame));
+  }
+  output_->AddFrames(to_add);
+  if (consumed > 0)
+    last_frame_time_ = batch[consumed - 1]->dts;
 
-    raised_waiting_event_ = false;
-    for (auto& decoded_frame : decoded) {
-      output_->AddFrame(decoded_frame);
+  if (decode_status == MediaStatus::KeyNotFound) {
+    VLOG(2) << "Key not found";
+    // If we don't have the required key, signal the <video> and wait.
+    if (!raised_waiting_event_) {
+      raised_waiting_event_ = true;
+      client_->OnWaitingForKey();
     }
+    // TODO: Consider adding a signal for new keys so we can avoid polling and
+    // just wait on a condition variable.
+    return 0.2;
+  }
+
+  raised_waiting_event_ = false;
+  return 0;
+}
+
+bool DecoderThread::HasDecodedEnough(double time,
+                                     const DecodeAheadPolicy& policy) const {
+  if (trick_play_)
+    return output_->CountFramesBetween(time, HUGE_VAL) >= kTrickPlayFramesAhead;
+
+  if (policy.seconds > 0 && DecodedAheadOf(output_, time) > policy.seconds)
+    return true;
 
-    if (frame)
-      last_frame_time_ = frame->dts;
+  const bool over_budget = !memory::MemoryBudget::Instance()->Fits(0);
+  if (policy.frames == 0 && policy.bytes == 0 && !over_budget)
+    return false;
+  const size_t frames_ahead = output_->CountFramesBetween(time, HUGE_VAL);
+  if (frames_ahead < kMinFramesAhead)
+    return false;
+  return over_budget || (policy.frames > 0 && frames_ahead >= policy.frames) ||
+         (policy.bytes > 0 && output_->EstimateSize() >= policy.bytes);
+}
+
+std::shared_ptr<EncodedFrame> DecoderThread::SkipToKeyFrameIfLate(
+    std::shared_ptr<EncodedFrame> frame, double time) {
+  if (trick_play_ || time - frame->pts < kCatchUpLateness)
+    return frame;
+
+  // The frames before the next keyframe would all be dropped, so skip them
+  // and start decoding from there.  If there isn't a keyframe buffered yet,
+  // keep decoding (and skipping non-reference frames) until there is.
+  auto keyframe = input_->GetFrame(time, FrameLocation::KeyFrameAfter);
+  if (!keyframe || keyframe->dts <= frame->dts)
+    return frame;
+
+  size_t skipped = 0;
+  for (auto cur = frame; cur && cur->dts < keyframe->dts;
+       cur = input_->GetFrame(cur->dts, FrameLocation::After)) {
+    skipped++;
+  }
+  VLOG(1) << "Decoding is " << (time - frame->pts)
+          << "s behind the playhead; skipping " << skipped
+          << " frames to the keyframe at " << keyframe->pts;
+  Telemetry::GetStream(frame->stream_info->is_video)
+      ->frames_skipped.fetch_add(skipped, std::memory_order_relaxed);
+  // The skipped frames may be references for frames still in the decoder.
+  decoder_->ResetDecoder();
+  return keyframe;
+}
+
+void DecoderThread::UpdateMaxOutputSize() {
+  uint32_t width;
+  uint32_t height;
+  client_->GetMaxVideoSize(&width, &height);
+  if (width != max_output_width_ || height != max_output_height_) {
+    VLOG(1) << "Video is drawn at " << width << "x" << height;
+    max_output_width_ = width;
+    max_output_height_ = height;
+    decoder_->SetMaxOutputSize(width, height);
   }
 }
 
+void DecoderThread::UpdatePixelFormats() {
+  std::vector<PixelFormat> formats = client_->GetPreferredPixelFormats();
+  if (formats != pixel_formats_) {
+    pixel_formats_ = std::move(formats);
+    decoder_->SetPreferredPixelFormats(pixel_formats_);
+  }
+}
+
+void DecoderThread::UpdateSkipNonReference(const EncodedFrame& frame,
+                                           double time) {
+  // Use separate thresholds to start and stop skipping so this doesn't flip
+  // back and forth while close to the playhead.  This stops before a frame
+  // that is still visible at the playhead, so the frame to show after a seek
+  // is never skipped.
+  const double lateness = time - (frame.pts + frame.duration);
+  bool skip = skipping_non_reference_;
+  if (trick_play_ || lateness <= 0)
+    skip = false;
+  else if (lateness > kSkipNonReferenceLateness)
+    skip = true;
+
+  if (skip != skipping_non_reference_) {
+    VLOG(1) << (skip ? "Started" : "Stopped")
+            << " skipping non-reference frames; decoding is " << lateness
+            << "s behind the playhead";
+    skipping_non_reference_ = skip;
+    decoder_->SetSkipNonReferenceFrames(skip);
+  }
+}
+
+void DecoderThread::DecryptAhead(std::shared_ptr<EncodedFrame> frame) {
+  std::vector<std::shared_ptr<EncodedFrame>> frames;
+  frames.reserve(kDecryptBatchSize);
+  while (frame && frames.size() < kDecryptBatchSize) {
+    frames.emplace_back(frame);
+    frame = input_->GetFrame(frame->dts, FrameLocation::After);
+  }
+
+  // Frames that fail (e.g. a missing key) are decrypted again when decoding,
+  // which will report the error.
+  SegmentEncodedFrame::DecryptBatchInPlace(cdm_, frames);
+  decrypted_until_ = frames.back()->dts;
+}
+
+void DecoderThread::SpliceRemovedRange(double start, double end,
+                                       double cur_time) {
+  // Removing frames behind the playhead (e.g. to free memory) or after what
+  // was decoded doesn't change the decoded frames.
+  if (std::isnan(last_frame_time_) || trick_play_ || end <= cur_time ||
+      start > last_frame_time_) {
+    return;
+  }
+  auto playing = output_->GetFrame(cur_time, FrameLocation::Near);
+  if (!playing || playing->stream_info->is_video)
+    return;
+
+  // Keep playing the old track until the switch point.  If that is already
+  // behind the playhead, switch after the frames that are already decoded so
+  // there isn't a gap while the new track is appended and decoded.
+  if (start > cur_time)
+    output_->Remove(start, HUGE_VAL);
+  const double decoded_ahead = DecodedAheadOf(output_, cur_time);
+  if (decoded_ahead <= 0) {
+    Reset();
+    return;
+  }
+
+  VLOG(2) << "Splicing new audio at " << cur_time + decoded_ahead;
+  // Drop anything the decoder is holding from the old track.
+  decoder_->ResetDecoder();
+  // Continue with the first frame that starts at the end of the decoded
+  // frames; allow a little overlap since the tracks' frames may not line up.
+  last_frame_time_ = cur_time + decoded_ahead - kSpliceTolerance;
+  seek_target_ = NAN;
+  decrypted_until_ = NAN;
+  did_flush_ = false;
+  if (decrypt_thread_)
+    decrypt_thread_->OnSeek();
+}
+
 void DecoderThread::Reset() {
+  if (decoder_ && skipping_non_reference_)
+    decoder_->SetSkipNonReferenceFrames(false);
+  skipping_non_reference_ = false;
   last_frame_time_ = NAN;
+  seek_target_ = NAN;
+  did_seek_ = false;
+  decrypted_until_ = NAN;
   did_flush_ = false;
   // Remove all the existing frames.  We'll decode them again anyway and this
   // ensures we don't keep future frames forever when seeking backwards.
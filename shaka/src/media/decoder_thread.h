@@ -15,13 +15,17 @@
 #ifndef SHAKA_EMBEDDED_MEDIA_DECODER_THREAD_H_
 #define SHAKA_EMBEDDED_MEDIA_DECODER_THREAD_H_
 
+#include <memory>
 #include <string>
+#include <vector>
 
 #include "shaka/media/decoder.h"
+#include "shaka/media/default_media_player.h"
 #include "shaka/media/streams.h"
+#include "shaka/media/worker_pool.h"
 #include "src/debug/mutex.h"
-#include "src/debug/thread.h"
-#include "src/debug/thread_event.h"
+#include "src/media/worker_task.h"
+#include "src/memory/memory_budget.h"
 #include "src/util/macros.h"
 
 namespace shaka {
@@ -32,12 +36,23 @@ class Implementation;
 
 namespace media {
 
+class DecryptThread;
+
 /**
- * Handles the thread that decodes input content.  This handles synchronizing
- * the threads and connecting the Decoder to the Stream.
+ * Handles the background task that decodes input content.  This handles
+ * synchronizing the threads and connecting the Decoder to the Stream.  The task
+ * runs on the given WorkerPool, or on its own thread if there isn't one.
  */
 class DecoderThread {
  public:
+  /**
+   * The default number of seconds to keep decoded ahead of the playhead.  This
+   * is also how long frames are kept behind the playhead.
+   */
+  static constexpr const double kDecodeBufferSize = 1;
+  /** The number of seconds to keep behind the playhead in low-latency mode. */
+  static constexpr const double kLowLatencyDecodeBufferSize = 0.25;
+
   class Client {
    public:
     virtual ~Client() {}
@@ -49,13 +64,33 @@ class DecoderThread {
     virtual void OnWaitingForKey() = 0;
 
     virtual void OnError(const std::string& error) = 0;
+
+    /**
+     * Gets the largest size video frames are drawn at, or 0x0 if there is no
+     * limit.  This is passed to the decoder.
+     */
+    virtual void GetMaxVideoSize(uint32_t* width, uint32_t* height) const {
+      *width = *height = 0;
+    }
+
+    /**
+     * Gets the pixel formats the video renderer can draw without converting,
+     * or an empty list for any format.  This is passed to the decoder.
+     */
+    virtual std::vector<PixelFormat> GetPreferredPixelFormats() const {
+      return {};
+    }
   };
 
   /**
    * @param client A client object for callback events.
    * @param output The object to put decoded frames into.
+   * @param decrypt_ahead Whether to decrypt frames ahead of the decoder on a
+   *   separate thread.
+   * @param pool The pool to decode on, or nullptr to use a new thread.
    */
-  DecoderThread(Client* client, DecodedStream* output);
+  DecoderThread(Client* client, DecodedStream* output,
+                bool decrypt_ahead = false, WorkerPool* pool = nullptr);
   ~DecoderThread();
 
   SHAKA_NON_COPYABLE_OR_MOVABLE_TYPE(DecoderThread);
@@ -67,8 +102,10 @@ class DecoderThread {
   void Detach();
 
   /**
-   * Called when the video seeks.  This should reset any internal data and start
-   * over decoding.
+   * Called when the video seeks.  If the new playhead is inside the frames
+   * that are already decoded (e.g. a short scrub backwards into the frames
+   * kept behind the playhead), decoding continues from where it was;
+   * otherwise this resets any internal data and starts over decoding.
    */
   void OnSeek();
 
@@ -77,12 +114,99 @@ class DecoderThread {
   /** Sets the decoder used to decode frames. */
   void SetDecoder(Decoder* decoder);
 
+  /** Sets how far ahead of the playhead to decode. */
+  void SetDecodeAheadPolicy(const DecodeAheadPolicy& policy);
+
+  /** Sets the priority of the task when running on a WorkerPool. */
+  void SetPriority(int priority);
+
+  /** Sets whether to keep fewer frames behind the playhead. */
+  void SetLowLatency(bool low_latency);
+
+  /**
+   * Sets how many seconds of decoded frames to keep behind the playhead.  A
+   * seek that lands in these frames doesn't need to decode them again.  The
+   * default is kDecodeBufferSize.
+   */
+  void SetRetainBehind(double seconds);
+
+  /**
+   * Sets whether decoding is suspended.  While suspended, this doesn't decode
+   * any frames and drops the frames it has already decoded.  When resumed,
+   * this starts decoding again from the keyframe before the playhead.
+   */
+  void SetSuspended(bool suspended);
+
+  /**
+   * Sets whether to only decode keyframes.  This is used for trick play at
+   * high playback rates, where decoding every frame can't keep up.  Changing
+   * this drops the decoded frames and starts decoding again from the keyframe
+   * before the playhead.
+   */
+  void SetTrickPlay(bool trick_play);
+
+  /**
+   * Called when the input stream's buffered ranges change, so new frames are
+   * decoded right away instead of the next time the thread polls.
+   */
+  void OnInputChanged();
+
+  /**
+   * Called when frames in the given range were removed from the input.  This
+   * is how an audio track switch looks from here: the app removes the old
+   * track's frames after the switch point and appends the new track's.
+   *
+   * For audio, the decoded frames before the switch point are kept so they
+   * keep playing while the new track is decoded after them; the switch point
+   * is the start of the range, or the end of the decoded frames if that is
+   * already behind the playhead.  This avoids flushing the pipeline and the
+   * audio renderer.  Removing video frames doesn't affect the decoded frames.
+   *
+   * This is called with the input's lock held, so the splice is done on the
+   * next DecodeStep.
+   */
+  void OnInputRemoved(double start, double end);
+
  private:
-  void ThreadMain();
+  /**
+   * Decodes the next frame, if needed.
+   * @return The number of seconds to wait before decoding again.
+   */
+  double DecodeStep();
   void Reset();
+  /**
+   * Drops the decoded audio frames after the given removed range and
+   * continues decoding after the remaining ones.
+   */
+  void SpliceRemovedRange(double start, double end, double cur_time);
+  /**
+   * @return Whether enough frames are decoded ahead of the given time.  This
+   *   stops early while over the memory budget.
+   */
+  bool HasDecodedEnough(double time, const DecodeAheadPolicy& policy) const;
+  /**
+   * If |frame| is too far behind the given playhead time, this skips to the
+   * next keyframe after the playhead, if one is buffered.
+   * @return The frame to decode next.
+   */
+  std::shared_ptr<EncodedFrame> SkipToKeyFrameIfLate(
+      std::shared_ptr<EncodedFrame> frame, double time);
+  /**
+   * Tells the decoder whether to skip non-reference frames based on how far
+   * the given frame is behind the playhead time.
+   */
+  void UpdateSkipNonReference(const EncodedFrame& frame, double time);
+  /** Passes the size video is drawn at to the decoder if it changed. */
+  void UpdateMaxOutputSize();
+  /** Passes the renderer's pixel formats to the decoder if they changed. */
+  void UpdatePixelFormats();
+  /**
+   * Decrypts the given frame and the frames buffered after it as a single
+   * batch, so the decoder doesn't need to decrypt them one at a time.
+   */
+  void DecryptAhead(std::shared_ptr<EncodedFrame> frame);
 
   Mutex mutex_;
-  ThreadEvent<void> signal_;
 
   Client* const client_;
   const ElementaryStream* input_;
@@ -90,12 +214,47 @@ class DecoderThread {
   Decoder* decoder_;
 
   eme::Implementation* cdm_;
+  DecodeAheadPolicy policy_;
+  const uint64_t physical_memory_;
   double last_frame_time_;
-  bool shutdown_;
+  // The playhead time when decoding restarted from a keyframe after a seek.
+  // Decoded frames that end before this are only needed as references for
+  // later frames, so they aren't buffered.  This is NAN once a frame at or
+  // after this time has been decoded.
+  double seek_target_;
+  // The DTS of the last frame that was decrypted as part of a batch.
+  double decrypted_until_;
   bool did_flush_;
+  // Set by OnSeek; the next DecodeStep checks whether the new playhead is
+  // already decoded before resetting.
+  bool did_seek_;
+  double retain_behind_;
   bool raised_waiting_event_;
+  bool low_latency_;
+  bool suspended_;
+  bool trick_play_;
+  // Whether the decoder was told to skip non-reference frames since decoding
+  // is behind the playhead.
+  bool skipping_non_reference_;
+  // The size last passed to Decoder::SetMaxOutputSize.
+  uint32_t max_output_width_;
+  uint32_t max_output_height_;
+  // The formats last passed to Decoder::SetPreferredPixelFormats.
+  std::vector<PixelFormat> pixel_formats_;
+  // If set, this decrypts frames before this thread decodes them.
+  const std::unique_ptr<DecryptThread> decrypt_thread_;
+  // Counts |output_| against the memory budget.
+  memory::MemoryBudget::Consumer budget_consumer_;
+
+  // Protects the range passed to OnInputRemoved.  This is separate from
+  // |mutex_| since it is locked with the input's lock held.
+  Mutex removed_mutex_;
+  // The range removed from the input since the last DecodeStep, or NAN.
+  double removed_start_;
+  double removed_end_;
 
-  Thread thread_;
+  // Should be last so the task starts after all the fields are initialized.
+  WorkerTask task_;
 };
 
 }  // namespace media
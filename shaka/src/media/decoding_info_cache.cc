@@ -0,0 +1,154 @@
+// Copyright 2020 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     https://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "src/media/decoding_info_cache.h"
+
+#include <glog/logging.h>
+
+#include <map>
+#include <sstream>
+#include <utility>
+#include <vector>
+
+#include "shaka/version.h"
+#include "src/media/media_utils.h"
+#include "src/util/file_system.h"
+
+namespace shaka {
+namespace media {
+
+namespace {
+
+/**
+ * Converts the given MIME type to a canonical form so equivalent types share
+ * a cache entry.
+ */
+std::string NormalizeContentType(const std::string& content_type) {
+  std::string type;
+  std::string subtype;
+  std::unordered_map<std::string, std::string> params;
+  if (!ParseMimeType(content_type, &type, &subtype, &params))
+    return content_type;
+
+  std::string ret = type + "/" + subtype;
+  for (auto& param : std::map<std::string, std::string>(params.begin(),
+                                                         params.end())) {
+    ret += ";" + param.first + "=" + param.second;
+  }
+  return ret;
+}
+
+}  // namespace
+
+DecodingInfoCache DecodingInfoCache::Instance(GetShakaEmbeddedVersion());
+
+DecodingInfoCache::DecodingInfoCache(const std::string& version)
+    : version_(version) {}
+
+DecodingInfoCache::~DecodingInfoCache() {}
+
+void DecodingInfoCache::SetFile(const std::string& path) {
+  std::unique_lock<std::mutex> lock(mutex_);
+  path_ = path;
+  Load();
+}
+
+MediaCapabilitiesInfo DecodingInfoCache::Get(
+    const std::string& decoder, const MediaDecodingConfiguration& config,
+    std::function<MediaCapabilitiesInfo()> query) {
+  const std::string key = MakeKey(decoder, config);
+  {
+    std::unique_lock<std::mutex> lock(mutex_);
+    auto it = entries_.find(key);
+    if (it != entries_.end())
+      return it->second;
+  }
+
+  // Don't hold the lock while querying since it can be slow.
+  const MediaCapabilitiesInfo ret = query();
+  std::unique_lock<std::mutex> lock(mutex_);
+  if (entries_.emplace(key, ret).second)
+    Save();
+  return ret;
+}
+
+// static
+std::string DecodingInfoCache::MakeKey(
+    const std::string& decoder, const MediaDecodingConfiguration& config) {
+  std::stringstream ret;
+  ret << decoder << "|" << static_cast<int>(config.type);
+  if (!config.video.content_type.empty()) {
+    const VideoConfiguration& video = config.video;
+    ret << "|video:" << NormalizeContentType(video.content_type) << ","
+        << video.width << "," << video.height << "," << video.bitrate << ","
+        << video.framerate << "," << video.has_alpha_channel << ","
+        << static_cast<int>(video.hdr_metadata_type) << ","
+        << static_cast<int>(video.color_gamut) << ","
+        << static_cast<int>(video.transfer_function);
+  }
+  if (!config.audio.content_type.empty()) {
+    const AudioConfiguration& audio = config.audio;
+    ret << "|audio:" << NormalizeContentType(audio.content_type) << ","
+        << audio.channels << "," << audio.bitrate << "," << audio.samplerate
+        << "," << audio.spatial_rendering;
+  }
+  return ret.str();
+}
+
+void DecodingInfoCache::Load() {
+  util::FileSystem fs;
+  std::vector<uint8_t> data;
+  if (!fs.FileExists(path_) || !fs.ReadFile(path_, &data))
+    return;
+
+  // The first line is the version, then each line is an entry with three
+  // flags (supported, smooth, power efficient), a tab, and the key.
+  std::stringstream stream(std::string(data.begin(), data.end()));
+  std::string line;
+  if (!std::getline(stream, line) || line != version_) {
+    VLOG(1) << "Ignoring decoding info cache from another version";
+    return;
+  }
+  while (std::getline(stream, line)) {
+    if (line.size() < 5 || line[3] != '\t')
+      continue;
+    MediaCapabilitiesInfo info;
+    info.supported = line[0] == '1';
+    info.smooth = line[1] == '1';
+    info.power_efficient = line[2] == '1';
+    entries_.emplace(line.substr(4), info);
+  }
+}
+
+void DecodingInfoCache::Save() const {
+  if (path_.empty())
+    return;
+
+  std::string data = version_ + "\n";
+  for (auto& entry : entries_) {
+    if (entry.first.find('\n') != std::string::npos)
+      continue;
+    data += entry.second.supported ? '1' : '0';
+    data += entry.second.smooth ? '1' : '0';
+    data += entry.second.power_efficient ? '1' : '0';
+    data += '\t' + entry.first + '\n';
+  }
+
+  util::FileSystem fs;
+  if (!fs.WriteFile(path_, std::vector<uint8_t>(data.begin(), data.end())))
+    LOG(WARNING) << "Unable to write decoding info cache";
+}
+
+}  // namespace media
+}  // namespace shaka
@@ -0,0 +1,86 @@
+// Copyright 2020 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     https://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef SHAKA_EMBEDDED_MEDIA_DECODING_INFO_CACHE_H_
+#define SHAKA_EMBEDDED_MEDIA_DECODING_INFO_CACHE_H_
+
+#include <functional>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+
+#include "shaka/media/media_capabilities.h"
+#include "src/util/macros.h"
+
+namespace shaka {
+namespace media {
+
+/**
+ * Caches the results of Decoder::DecodingInfo for the built-in decoders.
+ * Querying a decoder can be slow (e.g. searching every FFmpeg codec or
+ * creating a VideoToolbox session) and Shaka Player asks about every variant
+ * while processing the manifest.  The results only depend on the build and the
+ * device, so they can be stored in a file and reused on the next launch.
+ *
+ * This type is thread-safe.
+ */
+class DecodingInfoCache final {
+ public:
+  /**
+   * @param version The version of the library; entries stored by another
+   *   version are ignored.
+   */
+  explicit DecodingInfoCache(const std::string& version);
+  ~DecodingInfoCache();
+
+  SHAKA_NON_COPYABLE_OR_MOVABLE_TYPE(DecodingInfoCache);
+
+  /** The instance used by the built-in decoders. */
+  static DecodingInfoCache Instance;
+
+  /**
+   * Loads the entries stored in the given file and stores new entries there.
+   * If the file is missing or is from another version, it is replaced.
+   */
+  void SetFile(const std::string& path);
+
+  /**
+   * Gets the cached result for the given decoder and configuration.  If there
+   * isn't one, this calls |query| and caches its result.
+   *
+   * @param decoder A name for the decoder, which is part of the cache key.
+   * @param config The configuration to query.
+   * @param query The callback that queries the decoder.
+   */
+  MediaCapabilitiesInfo Get(const std::string& decoder,
+                            const MediaDecodingConfiguration& config,
+                            std::function<MediaCapabilitiesInfo()> query);
+
+ private:
+  static std::string MakeKey(const std::string& decoder,
+                             const MediaDecodingConfiguration& config);
+  void Load();
+  void Save() const;
+
+  // This uses a plain mutex since |Instance| is statically initialized.
+  mutable std::mutex mutex_;
+  const std::string version_;
+  std::string path_;
+  std::unordered_map<std::string, MediaCapabilitiesInfo> entries_;
+};
+
+}  // namespace media
+}  // namespace shaka
+
+#endif  // SHAKA_EMBEDDED_MEDIA_DECODING_INFO_CACHE_H_
@@ -0,0 +1,122 @@
+// Copyright 2020 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     https://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "src/media/decrypt_thread.h"
+
+#include <glog/logging.h>
+
+#include <cmath>
+#include <memory>
+#include <vector>
+
+#include "src/media/segment_encoded_frame.h"
+#include "src/util/clock.h"
+
+namespace shaka {
+namespace media {
+
+namespace {
+
+/**
+ * The number of encrypted frames to decrypt together.  This lets the EME
+ * implementation share work between the frames.
+ */
+constexpr const size_t kDecryptBatchSize = 16;
+
+}  // namespace
+
+DecryptThread::DecryptThread(DecoderThread::Client* client, WorkerPool* pool)
+    : mutex_("DecryptThread"),
+      client_(client),
+      input_(nullptr),
+      cdm_(nullptr),
+      decrypted_until_(NAN),
+      task_("Decrypt", pool, &util::Clock::Instance,
+            std::bind(&DecryptThread::DecryptStep, this)) {}
+
+DecryptThread::~DecryptThread() {
+  task_.Stop();
+}
+
+void DecryptThread::Attach(const ElementaryStream* input) {
+  std::unique_lock<Mutex> lock(mutex_);
+  input_ = input;
+  decrypted_until_ = NAN;
+  if (input && cdm_)
+    task_.Wake();
+}
+
+void DecryptThread::Detach() {
+  std::unique_lock<Mutex> lock(mutex_);
+  input_ = nullptr;
+  decrypted_until_ = NAN;
+}
+
+void DecryptThread::OnSeek() {
+  std::unique_lock<Mutex> lock(mutex_);
+  decrypted_until_ = NAN;
+}
+
+void DecryptThread::SetCdm(eme::Implementation* cdm) {
+  std::unique_lock<Mutex> lock(mutex_);
+  cdm_ = cdm;
+  if (cdm && input_)
+    task_.Wake();
+}
+
+void DecryptThread::SetPriority(int priority) {
+  task_.SetPriority(priority);
+}
+
+double DecryptThread::DecryptStep() {
+  std::unique_lock<Mutex> lock(mutex_);
+  if (!input_ || !cdm_)
+    return WorkerTask::kWaitForWake;
+
+  const double cur_time = client_->CurrentTime();
+  const double end_time = cur_time + kDecryptAheadSize;
+  std::shared_ptr<EncodedFrame> frame;
+  if (std::isnan(decrypted_until_)) {
+    // Start at the same frame the decoder will.
+    frame = input_->GetFrame(cur_time + StreamBase::kMaxGapSize,
+                             FrameLocation::KeyFrameBefore);
+  } else {
+    frame = input_->GetFrame(decrypted_until_, FrameLocation::After);
+  }
+
+  std::vector<std::shared_ptr<EncodedFrame>> frames;
+  frames.reserve(kDecryptBatchSize);
+  while (frame && frame->dts <= end_time && frames.size() < kDecryptBatchSize) {
+    frames.emplace_back(frame);
+    frame = input_->GetFrame(frame->dts, FrameLocation::After);
+  }
+  if (frames.empty()) {
+    VLOG(2) << "Enough decrypted";
+    return 0.025;
+  }
+
+  const size_t count = SegmentEncodedFrame::DecryptBatchInPlace(cdm_, frames);
+  if (count > 0)
+    decrypted_until_ = frames[count - 1]->dts;
+  if (count < frames.size()) {
+    // The decoder will raise the waiting-for-key event once it gets to this
+    // frame, so just wait for the key to be added.
+    VLOG(2) << "Key not found";
+    return 0.2;
+  }
+  return 0;
+}
+
+}  // namespace media
+}  // namespace shaka
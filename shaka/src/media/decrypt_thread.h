@@ -0,0 +1,96 @@
+// Copyright 2020 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     https://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef SHAKA_EMBEDDED_MEDIA_DECRYPT_THREAD_H_
+#define SHAKA_EMBEDDED_MEDIA_DECRYPT_THREAD_H_
+
+#include "shaka/media/streams.h"
+#include "shaka/media/worker_pool.h"
+#include "src/debug/mutex.h"
+#include "src/media/decoder_thread.h"
+#include "src/media/worker_task.h"
+#include "src/util/macros.h"
+
+namespace shaka {
+
+namespace eme {
+class Implementation;
+}  // namespace eme
+
+namespace media {
+
+/**
+ * Handles a background task that decrypts encoded frames ahead of the
+ * playhead.  The frames are decrypted in place (see
+ * SegmentEncodedFrame::DecryptBatchInPlace) so the decoder only needs to copy
+ * the clear data.  This allows decryption to overlap with decoding.  This only
+ * works with the built-in EME implementations; frames for other CDMs are left
+ * for the decoder to decrypt.
+ *
+ * Frames whose keys aren't available yet are retried later; they are left
+ * encrypted so the decoder still fails with KeyNotFound when it reaches them,
+ * which raises the waiting-for-key event as normal.
+ */
+class DecryptThread {
+ public:
+  /** The number of seconds ahead of the playhead to decrypt. */
+  static constexpr const double kDecryptAheadSize = 5;
+
+  /**
+   * @param client A client object used to get the current time.
+   * @param pool The pool to decrypt on, or nullptr to use a new thread.
+   */
+  explicit DecryptThread(DecoderThread::Client* client,
+                         WorkerPool* pool = nullptr);
+  ~DecryptThread();
+
+  SHAKA_NON_COPYABLE_OR_MOVABLE_TYPE(DecryptThread);
+
+  /** Starts decrypting frames from the given stream. */
+  void Attach(const ElementaryStream* input);
+
+  /** Stops decrypting frames from the current stream. */
+  void Detach();
+
+  /** Called when the video seeks.  This starts over at the new playhead. */
+  void OnSeek();
+
+  void SetCdm(eme::Implementation* cdm);
+
+  /** Sets the priority of the task when running on a WorkerPool. */
+  void SetPriority(int priority);
+
+ private:
+  /**
+   * Decrypts the next batch of frames, if needed.
+   * @return The number of seconds to wait before decrypting again.
+   */
+  double DecryptStep();
+
+  Mutex mutex_;
+
+  DecoderThread::Client* const client_;
+  const ElementaryStream* input_;
+  eme::Implementation* cdm_;
+  // The DTS of the last frame that doesn't need to be decrypted again.
+  double decrypted_until_;
+
+  // Should be last so the task starts after all the fields are initialized.
+  WorkerTask task_;
+};
+
+}  // namespace media
+}  // namespace shaka
+
+#endif  // SHAKA_EMBEDDED_MEDIA_DECRYPT_THREAD_H_
@@ -22,34 +22,73 @@
 #  include "src/media/ios/av_media_player.h"
 #endif
 #include "src/media/mse_media_player.h"
+#include "src/media/thumbnail_generator.h"
 
 namespace shaka {
 namespace media {
 
 class DefaultMediaPlayer::Impl {
  public:
-  Impl(ClientList* clients, VideoRenderer* video_renderer,
-       AudioRenderer* audio_renderer)
+  Impl(DefaultMediaPlayer* proxy, VideoRenderer* video_renderer,
+       AudioRenderer* audio_renderer, const DecoderOptions& decoder_options)
       : mutex("DefaultMediaPlayer"),
 #ifdef OS_IOS
-        av_player(clients),
-        playing_src_(false),
+        av_client(proxy, &av_player),
+        av_player(&av_clients),
 #endif
-        mse_player(clients, video_renderer, audio_renderer) {
+        mse_client(proxy, &mse_player),
+        mse_player(&mse_clients, video_renderer, audio_renderer,
+                   decoder_options),
+        decoder_options(decoder_options),
+        priority(0),
+        thumbnail_cache_size(ThumbnailGenerator::kDefaultCacheSize),
+        thumbnail_cpu_limit(ThumbnailGenerator::kDefaultCpuLimit),
+        proxy_(proxy) {
+    // Each player fires events to its own list so the events of a player
+    // that is prepared for a handoff are dropped.
+#ifdef OS_IOS
+    av_clients.AddClient(&av_client);
+#endif
+    mse_clients.AddClient(&mse_client);
   }
 
+#ifdef OS_IOS
+  bool playing_src() const {
+    return proxy_->GetActivePlayer() == &av_player;
+  }
+#endif
+
   Mutex mutex;
 #ifdef OS_IOS
+  ClientList av_clients;
+  BackendClient av_client;
   ios::AvMediaPlayer av_player;
-  bool playing_src_;
 #endif
+  ClientList mse_clients;
+  BackendClient mse_client;
   MseMediaPlayer mse_player;
   std::vector<std::shared_ptr<TextTrack>> text_tracks_;
+
+  // These are protected by |mutex|.  The thumbnail generator is created when
+  // the first thumbnail segment is added.
+  const DecoderOptions decoder_options;
+  int priority;
+  size_t thumbnail_cache_size;
+  double thumbnail_cpu_limit;
+  std::unique_ptr<ThumbnailGenerator> thumbnails;
+
+ private:
+  const DefaultMediaPlayer* proxy_;
 };
 
 DefaultMediaPlayer::DefaultMediaPlayer(VideoRenderer* video_renderer,
                                        AudioRenderer* audio_renderer)
-    : impl_(new Impl(GetClientList(), video_renderer, audio_renderer)) {}
+    : DefaultMediaPlayer(video_renderer, audio_renderer, DecoderOptions()) {}
+DefaultMediaPlayer::DefaultMediaPlayer(VideoRenderer* video_renderer,
+                                       AudioRenderer* audio_renderer,
+                                       const DecoderOptions& decoder_options)
+    : impl_(new Impl(this, video_renderer, audio_renderer, decoder_options)) {
+}
 DefaultMediaPlayer::~DefaultMediaPlayer() {}
 
 void DefaultMediaPlayer::SetDecoders(Decoder* video_decoder,
@@ -57,6 +96,97 @@ void DefaultMediaPlayer::SetDecoders(Decoder* video_decoder,
   impl_->mse_player.SetDecoders(video_decoder, audio_decoder);
 }
 
+void DefaultMediaPlayer::SetDecodeAheadPolicy(const DecodeAheadPolicy& video,
+                                              const DecodeAheadPolicy& audio) {
+  impl_->mse_player.SetDecodeAheadPolicy(video, audio);
+}
+
+void DefaultMediaPlayer::SetWorkerPriority(int priority) {
+  impl_->mse_player.SetWorkerPriority(priority);
+  std::unique_lock<Mutex> lock(impl_->mutex);
+  impl_->priority = priority;
+  // Thumbnails run behind playback.
+  if (impl_->thumbnails)
+    impl_->thumbnails->SetPriority(priority - 1);
+}
+
+void DefaultMediaPlayer::SetLowLatencyMode(bool low_latency) {
+  impl_->mse_player.SetLowLatencyMode(low_latency);
+}
+
+void DefaultMediaPlayer::SetAudioMasterClock(bool enabled) {
+  impl_->mse_player.SetAudioMasterClock(enabled);
+}
+
+void DefaultMediaPlayer::SetRetainBehind(double seconds) {
+  impl_->mse_player.SetRetainBehind(seconds);
+}
+
+void DefaultMediaPlayer::SetVideoSuspended(bool suspended) {
+  impl_->mse_player.SetVideoSuspended(suspended);
+}
+
+void DefaultMediaPlayer::SetPreloading(bool preloading, uint64_t memory_cap) {
+  impl_->mse_player.SetPreloading(preloading, memory_cap);
+}
+
+double DefaultMediaPlayer::AppendToPresentLatency() const {
+  return impl_->mse_player.AppendToPresentLatency();
+}
+
+bool DefaultMediaPlayer::AppendThumbnailSegment(const std::string& mime,
+                                                double timestamp_offset,
+                                                const uint8_t* data,
+                                                size_t size) {
+  std::unique_lock<Mutex> lock(impl_->mutex);
+  if (!impl_->thumbnails) {
+    impl_->thumbnails.reset(new ThumbnailGenerator(impl_->decoder_options));
+    impl_->thumbnails->SetPriority(impl_->priority - 1);
+    impl_->thumbnails->SetLimits(impl_->thumbnail_cache_size,
+                                 impl_->thumbnail_cpu_limit);
+  }
+  return impl_->thumbnails->AppendSegment(mime, timestamp_offset, data, size);
+}
+
+std::shared_ptr<DecodedFrame> DefaultMediaPlayer::GetThumbnail(double time) {
+  std::unique_lock<Mutex> lock(impl_->mutex);
+  if (!impl_->thumbnails)
+    return nullptr;
+  return impl_->thumbnails->GetThumbnail(time);
+}
+
+void DefaultMediaPlayer::SetThumbnailLimits(size_t cache_size,
+                                            double cpu_limit) {
+  std::unique_lock<Mutex> lock(impl_->mutex);
+  impl_->thumbnail_cache_size = cache_size;
+  impl_->thumbnail_cpu_limit = cpu_limit;
+  if (impl_->thumbnails)
+    impl_->thumbnails->SetLimits(cache_size, cpu_limit);
+}
+
+void DefaultMediaPlayer::ClearThumbnails() {
+  std::unique_lock<Mutex> lock(impl_->mutex);
+  impl_->thumbnails.reset();
+}
+
+void DefaultMediaPlayer::PreloadSource(const std::string& src) {
+#ifdef OS_IOS
+  impl_->av_player.PreloadSource(src);
+#endif
+}
+
+void DefaultMediaPlayer::SetSourceForwardBufferDuration(double seconds) {
+#ifdef OS_IOS
+  impl_->av_player.SetForwardBufferDuration(seconds);
+#endif
+}
+
+void DefaultMediaPlayer::SetSourcePeakBitRate(double bits_per_second) {
+#ifdef OS_IOS
+  impl_->av_player.SetPeakBitRate(bits_per_second);
+#endif
+}
+
 const void* DefaultMediaPlayer::GetIosView() {
 #ifdef OS_IOS
   return impl_->av_player.GetIosView();
@@ -89,7 +219,7 @@ MediaCapabilitiesInfo DefaultMediaPlayer::DecodingInfo(
 std::vector<std::shared_ptr<MediaTrack>> DefaultMediaPlayer::AudioTracks() {
   std::unique_lock<Mutex> lock(impl_->mutex);
 #ifdef OS_IOS
-  if (impl_->playing_src_)
+  if (impl_->playing_src())
     return impl_->av_player.AudioTracks();
 #endif
   return {};
@@ -99,7 +229,7 @@ std::vector<std::shared_ptr<const MediaTrack>> DefaultMediaPlayer::AudioTracks()
     const {
   std::unique_lock<Mutex> lock(impl_->mutex);
 #ifdef OS_IOS
-  if (impl_->playing_src_) {
+  if (impl_->playing_src()) {
     return const_cast<const ios::AvMediaPlayer&>(impl_->av_player)
         .AudioTracks();
   }
@@ -110,7 +240,7 @@ std::vector<std::shared_ptr<const MediaTrack>> DefaultMediaPlayer::AudioTracks()
 std::vector<std::shared_ptr<MediaTrack>> DefaultMediaPlayer::VideoTracks() {
   std::unique_lock<Mutex> lock(impl_->mutex);
 #ifdef OS_IOS
-  if (impl_->playing_src_)
+  if (impl_->playing_src())
     return impl_->av_player.VideoTracks();
 #endif
   return {};
@@ -120,7 +250,7 @@ std::vector<std::shared_ptr<const MediaTrack>> DefaultMediaPlayer::VideoTracks()
     const {
   std::unique_lock<Mutex> lock(impl_->mutex);
 #ifdef OS_IOS
-  if (impl_->playing_src_) {
+  if (impl_->playing_src()) {
     return const_cast<const ios::AvMediaPlayer&>(impl_->av_player)
         .VideoTracks();
   }
@@ -131,7 +261,7 @@ std::vector<std::shared_ptr<const MediaTrack>> DefaultMediaPlayer::VideoTracks()
 std::vector<std::shared_ptr<TextTrack>> DefaultMediaPlayer::TextTracks() {
   std::unique_lock<Mutex> lock(impl_->mutex);
 #ifdef OS_IOS
-  if (impl_->playing_src_)
+  if (impl_->playing_src())
     return impl_->av_player.TextTracks();
 #endif
   return impl_->text_tracks_;
@@ -141,7 +271,7 @@ std::vector<std::shared_ptr<const TextTrack>> DefaultMediaPlayer::TextTracks()
     const {
   std::unique_lock<Mutex> lock(impl_->mutex);
 #ifdef OS_IOS
-  if (impl_->playing_src_) {
+  if (impl_->playing_src()) {
     return const_cast<const ios::AvMediaPlayer&>(impl_->av_player).TextTracks();
   }
 #endif
@@ -162,22 +292,21 @@ std::shared_ptr<TextTrack> DefaultMediaPlayer::AddTextTrack(
 
 void DefaultMediaPlayer::Detach() {
   ProxyMediaPlayer::Detach();
-#ifdef OS_IOS
-  impl_->playing_src_ = true;
-#endif
 }
 
 
 MediaPlayer* DefaultMediaPlayer::CreateMse() {
-  if (!impl_->mse_player.AttachMse())
+  if (GetActivePlayer() == &impl_->mse_player ||
+      !impl_->mse_player.AttachMse())
     return nullptr;
   return &impl_->mse_player;
 }
 MediaPlayer* DefaultMediaPlayer::CreateSource(const std::string& src) {
 #ifdef OS_IOS
-  if (!impl_->av_player.AttachSource(src))
+  if (GetActivePlayer() == &impl_->av_player ||
+      !impl_->av_player.AttachSource(src)) {
     return nullptr;
-  impl_->playing_src_ = true;
+  }
   return &impl_->av_player;
 #else
   return nullptr;
@@ -19,7 +19,7 @@
 #include <atomic>
 
 #ifdef HAS_DEMUXER
-#  include "src/media/ffmpeg/ffmpeg_demuxer.h"
+#  include "src/media/mp4/cmaf_demuxer.h"
 #endif
 #include "src/util/macros.h"
 
@@ -56,8 +56,7 @@ const DemuxerFactory* DemuxerFactory::GetFactory() {
     return ret;
 
 #ifdef HAS_DEMUXER
-  static ffmpeg::FFmpegDemuxerFactory* factory =
-      new ffmpeg::FFmpegDemuxerFactory;
+  static mp4::CmafDemuxerFactory* factory = new mp4::CmafDemuxerFactory;
   return factory;
 #else
   return nullptr;
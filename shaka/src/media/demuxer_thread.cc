@@ -22,7 +22,11 @@
 #include <vector>
 
 #include "src/core/js_manager_impl.h"
+#include "src/debug/telemetry.h"
+#include "src/debug/trace_event.h"
 #include "src/media/media_utils.h"
+#include "src/util/clock.h"
+#include "src/util/utils.h"
 
 namespace shaka {
 namespace media {
@@ -44,18 +48,15 @@ DemuxerThread::DemuxerThread(const std::string& mime, Demuxer::Client* client,
                              ElementaryStream* stream)
     : mutex_("DemuxerThread"),
       new_data_("New demuxed data"),
+      pending_count_(0),
       client_(client),
       mime_(mime),
       shutdown_(false),
-      data_(nullptr),
-      data_size_(0),
-      timestamp_offset_(0),
-      window_start_(0),
-      window_end_(HUGE_VAL),
       need_key_frame_(true),
       stream_(stream),
       thread_(ShortContainerName(mime) + " demuxer",
-              std::bind(&DemuxerThread::ThreadMain, this)) {}
+              std::bind(&DemuxerThread::ThreadMain, this),
+              ThreadRole::Media) {}
 
 DemuxerThread::~DemuxerThread() {
   if (thread_.joinable())
@@ -63,12 +64,16 @@ DemuxerThread::~DemuxerThread() {
 }
 
 void DemuxerThread::Stop() {
-  shutdown_ = true;
+  {
+    // Set while locked so the background thread can't miss the signal.
+    std::unique_lock<Mutex> lock(mutex_);
+    shutdown_ = true;
+  }
   new_data_.SignalAllIfNotSet();
   thread_.join();
 }
 
-void DemuxerThread::AppendData(double timestamp_offset, double window_start,
+bool DemuxerThread::AppendData(double timestamp_offset, double window_start,
                                double window_end, const uint8_t* data,
                                size_t data_size,
                                std::function<void(bool)> on_complete) {
@@ -76,71 +81,152 @@ void DemuxerThread::AppendData(double timestamp_offset, double window_start,
   DCHECK_GT(data_size, 0u);
 
   std::unique_lock<Mutex> lock(mutex_);
-  data_ = data;
-  data_size_ = data_size;
-  timestamp_offset_ = timestamp_offset;
-  window_start_ = window_start;
-  window_end_ = window_end;
-  on_complete_ = std::move(on_complete);
-
-  new_data_.SignalAll();
+  if (pending_count_ >= kMaxQueuedAppends)
+    return false;
+
+  pending_.push_back({timestamp_offset, window_start, window_end, data,
+                      data_size, std::move(on_complete)});
+  pending_count_++;
+  // The thread may not have woken up from a previous append yet.
+  new_data_.SignalAllIfNotSet();
+  return true;
+}
+
+size_t DemuxerThread::PendingAppendCount() const {
+  std::unique_lock<Mutex> lock(mutex_);
+  return pending_count_;
+}
+
+bool DemuxerThread::HasCaptions() const {
+  std::unique_lock<Mutex> lock(mutex_);
+  return caption_track_ || !pending_cues_.empty();
+}
+
+void DemuxerThread::SetCaptionTrack(std::shared_ptr<TextTrack> track) {
+  std::vector<std::shared_ptr<VTTCue>> cues;
+  {
+    std::unique_lock<Mutex> lock(mutex_);
+    caption_track_ = track;
+    cues.swap(pending_cues_);
+  }
+  for (auto& cue : cues)
+    track->AddCue(cue);
 }
 
 void DemuxerThread::ThreadMain() {
-  using namespace std::placeholders;  // NOLINT
   auto* factory = DemuxerFactory::GetFactory();
   if (factory)
     demuxer_ = factory->Create(mime_, client_);
-  if (!demuxer_) {
-    // If we get an error before we append the first segment, then we won't have
-    // a callback yet, so we have nowhere to send the error to.  Wait until we
-    // get the first segment.
-    std::unique_lock<Mutex> lock(mutex_);
-    if (!on_complete_ && !shutdown_) {
+
+  std::unique_lock<Mutex> lock(mutex_);
+  while (!shutdown_) {
+    if (pending_.empty()) {
       new_data_.ResetAndWaitWhileUnlocked(lock);
+      continue;
     }
-    CallOnComplete(false);
-    return;
-  }
 
-  while (!shutdown_) {
-    std::unique_lock<Mutex> lock(mutex_);
-    std::vector<std::shared_ptr<EncodedFrame>> frames;
-    if (!demuxer_->Demux(timestamp_offset_, data_, data_size_, &frames)) {
-      CallOnComplete(false);
-      break;
+    PendingAppend append = std::move(pending_.front());
+    pending_.pop_front();
+    if (!demuxer_) {
+      // If we get an error before we append the first segment, then we won't
+      // have a callback yet, so we have nowhere to send the error to.  So
+      // report the error for every append.
+      pending_count_--;
+      CallOnComplete(std::move(append.on_complete), false);
+      continue;
+    }
+
+    bool success;
+    {
+      // Demux without the lock held so more appends can be queued while this
+      // one is being processed.
+      util::Unlocker<Mutex> unlock(&lock);
+      success = ProcessAppend(append);
+    }
+    pending_count_--;
+    CallOnComplete(std::move(append.on_complete), success);
+    if (!success) {
+      // The demuxer can't recover, so fail any remaining appends.
+      for (auto& remaining : pending_)
+        CallOnComplete(std::move(remaining.on_complete), false);
+      pending_.clear();
+      pending_count_ = 0;
+      demuxer_.reset();
     }
+  }
+}
 
-    for (auto& frame : frames) {
-      if (frame->pts < window_start_ ||
-          frame->pts + frame->duration > window_end_) {
-        need_key_frame_ = true;
-        VLOG(2) << "Dropping frame outside append window, pts=" << frame->pts;
+bool DemuxerThread::ProcessAppend(const PendingAppend& append) {
+  TRACE_EVENT("media", "Demux");
+  const uint64_t start = util::Clock::Instance.GetMonotonicTime();
+  std::vector<std::shared_ptr<EncodedFrame>> frames;
+  if (!demuxer_->Demux(append.timestamp_offset, append.data, append.data_size,
+                       &frames)) {
+    return false;
+  }
+
+  std::vector<std::shared_ptr<EncodedFrame>> added;
+  for (auto& frame : frames) {
+    if (frame->pts < append.window_start ||
+        frame->pts + frame->duration > append.window_end) {
+      need_key_frame_ = true;
+      VLOG(2) << "Dropping frame outside append window, pts=" << frame->pts;
+      continue;
+    }
+    if (need_key_frame_) {
+      if (frame->is_key_frame) {
+        need_key_frame_ = false;
+      } else {
+        VLOG(2) << "Dropping frame while looking for key frame, pts="
+                << frame->pts;
         continue;
       }
-      if (need_key_frame_) {
-        if (frame->is_key_frame) {
-          need_key_frame_ = false;
-        } else {
-          VLOG(2) << "Dropping frame while looking for key frame, pts="
-                  << frame->pts;
-          continue;
-        }
-      }
-      stream_->AddFrame(frame);
     }
-    CallOnComplete(true);
-    new_data_.ResetAndWaitWhileUnlocked(lock);
+    TRACE_FRAME_BEGIN(frame.get());
+    stream_->AddFrame(frame);
+    added.emplace_back(frame);
+  }
+  if (!added.empty()) {
+    const bool is_video = added.front()->stream_info->is_video;
+    Telemetry::GetStream(is_video)->frames_demuxed.fetch_add(
+        added.size(), std::memory_order_relaxed);
+    if (is_video)
+      AddCaptions(added);
+  }
+
+  VLOG(1) << "Demuxed " << append.data_size << " bytes into " << added.size()
+          << "/" << frames.size() << " frames in "
+          << (util::Clock::Instance.GetMonotonicTime() - start) << "ms";
+  return true;
+}
+
+void DemuxerThread::AddCaptions(
+    const std::vector<std::shared_ptr<EncodedFrame>>& frames) {
+  std::vector<std::shared_ptr<VTTCue>> cues;
+  captions_.Process(frames, &cues);
+  if (cues.empty())
+    return;
+
+  std::shared_ptr<TextTrack> track;
+  {
+    std::unique_lock<Mutex> lock(mutex_);
+    if (!caption_track_) {
+      // The track is created on the event thread once the append completes.
+      pending_cues_.insert(pending_cues_.end(), cues.begin(), cues.end());
+      return;
+    }
+    track = caption_track_;
   }
+  for (auto& cue : cues)
+    track->AddCue(cue);
 }
 
-void DemuxerThread::CallOnComplete(bool success) {
-  if (on_complete_) {
+void DemuxerThread::CallOnComplete(std::function<void(bool)> on_complete,
+                                   bool success) {
+  if (on_complete) {
     // on_complete must be invoked on the event thread.
-    JsManagerImpl::Instance()->MainThread()->AddInternalTask(
-        TaskPriority::Internal, "Append done",
-        std::bind(on_complete_, success));
-    on_complete_ = std::function<void(bool)>();
+    JsManagerImpl::Instance()->MainThread()->PostTask(
+        TaskPriority::Internal, std::bind(std::move(on_complete), success));
   }
 }
 
@@ -16,15 +16,19 @@
 #define SHAKA_EMBEDDED_MEDIA_DEMUXER_THREAD_H_
 
 #include <atomic>
+#include <deque>
 #include <functional>
 #include <memory>
 #include <string>
+#include <vector>
 
 #include "shaka/media/demuxer.h"
 #include "shaka/media/streams.h"
+#include "shaka/media/text_track.h"
 #include "src/debug/mutex.h"
 #include "src/debug/thread.h"
 #include "src/debug/thread_event.h"
+#include "src/media/caption_extractor.h"
 #include "src/media/types.h"
 #include "src/util/buffer_reader.h"
 #include "src/util/macros.h"
@@ -55,8 +59,15 @@ class DemuxerThread {
   /** Stops the background thread and joins it. */
   void Stop();
 
+  /** The maximum number of appends that can be queued at once. */
+  static constexpr const size_t kMaxQueuedAppends = 8;
+
   /**
-   * Appends the given data to be demuxed.
+   * Appends the given data to be demuxed.  Appends are queued and processed
+   * in order, so this can be called again before the previous append
+   * completes; the background thread will start demuxing the next append as
+   * soon as it finishes the current one.  Each append gets its own
+   * completion callback.
    *
    * @param timestamp_offset The number of seconds to move the media timestamps
    *   forward.
@@ -67,31 +78,63 @@ class DemuxerThread {
    *     on_complete or on_error.
    * @param data_size The number of bytes in |data|.
    * @param on_complete The callback to invoke once the append completes.
+   * @return False if there are already kMaxQueuedAppends pending appends; the
+   *   append is ignored in this case.
    */
-  void AppendData(double timestamp_offset, double window_start,
+  bool AppendData(double timestamp_offset, double window_start,
                   double window_end, const uint8_t* data, size_t data_size,
                   std::function<void(bool)> on_complete);
 
+  /** @return The number of appends that haven't completed yet. */
+  size_t PendingAppendCount() const;
+
+  /** @return Whether closed captions were found in the video frames. */
+  bool HasCaptions() const;
+
+  /**
+   * Sets the track to add the closed captions to.  Captions that were found
+   * before this was called are added to the track now.
+   */
+  void SetCaptionTrack(std::shared_ptr<TextTrack> track);
+
  private:
+  struct PendingAppend {
+    double timestamp_offset;
+    double window_start;
+    double window_end;
+    const uint8_t* data;
+    size_t data_size;
+    std::function<void(bool)> on_complete;
+  };
+
   void ThreadMain();
-  void CallOnComplete(bool success);
+  /** Demuxes the given append and adds the frames to the stream. */
+  bool ProcessAppend(const PendingAppend& append);
+  /** Decodes the closed captions in the given frames. */
+  void AddCaptions(const std::vector<std::shared_ptr<EncodedFrame>>& frames);
+  void CallOnComplete(std::function<void(bool)> on_complete, bool success);
 
-  Mutex mutex_;
+  mutable Mutex mutex_;
   std::unique_ptr<Demuxer> demuxer_;
   ThreadEvent<void> new_data_;
-  std::function<void(bool)> on_complete_;
+  std::deque<PendingAppend> pending_;
+  // The number of appends that have been queued but haven't completed; this
+  // includes the one currently being demuxed.
+  size_t pending_count_;
   Demuxer::Client* client_;
   std::string mime_;
   std::atomic<bool> shutdown_;
-  const uint8_t* data_;
-  size_t data_size_;
-  double timestamp_offset_;
-  double window_start_;
-  double window_end_;
   bool need_key_frame_;
 
   ElementaryStream* stream_;
 
+  // Only used on the background thread.
+  CaptionExtractor captions_;
+  // These are protected by |mutex_|.
+  std::shared_ptr<TextTrack> caption_track_;
+  // The cues that were decoded before there was a caption track.
+  std::vector<std::shared_ptr<VTTCue>> pending_cues_;
+
   // Should be last so the thread starts after all the fields are initialized.
   Thread thread_;
 };
@@ -20,6 +20,11 @@ extern "C" {
 #include <libavutil/imgutils.h>
 }
 
+#include <utility>
+
+#include "src/media/ffmpeg/ffmpeg_hdr_metadata.h"
+#include "src/memory/pool_allocator.h"
+
 namespace shaka {
 namespace media {
 namespace ffmpeg {
@@ -39,6 +44,12 @@ bool MapFrameFormat(bool is_video, AVFrame* frame,
       case AV_PIX_FMT_RGB24:
         *format = PixelFormat::RGB24;
         return true;
+      case AV_PIX_FMT_YUV420P10LE:
+        *format = PixelFormat::YUV420P10;
+        return true;
+      case AV_PIX_FMT_P010LE:
+        *format = PixelFormat::P010;
+        return true;
 
       case AV_PIX_FMT_VIDEOTOOLBOX:
         *format = PixelFormat::VideoToolbox;
@@ -102,24 +113,25 @@ bool MapFrameFormat(bool is_video, AVFrame* frame,
 }  // namespace
 
 FFmpegDecodedFrame::FFmpegDecodedFrame(
-    AVFrame* frame, double pts, double dts, double duration,
+    PrivateTag, AVFrame* frame, std::shared_ptr<FFmpegFramePool> pool,
+    double pts, double dts, double duration,
     std::shared_ptr<const StreamInfo> stream,
     variant<PixelFormat, SampleFormat> format,
     const std::vector<const uint8_t*>& data,
     const std::vector<size_t>& linesize)
     : DecodedFrame(stream, pts, dts, duration, format, frame->nb_samples, data,
                    linesize),
-      frame_(frame) {}
+      frame_(frame),
+      pool_(std::move(pool)) {}
 
 FFmpegDecodedFrame::~FFmpegDecodedFrame() {
-  av_frame_unref(frame_);
-  av_frame_free(&frame_);
+  pool_->ReleaseFrame(frame_);
 }
 
 // static
-FFmpegDecodedFrame* FFmpegDecodedFrame::CreateFrame(
+std::shared_ptr<FFmpegDecodedFrame> FFmpegDecodedFrame::CreateFrame(
     std::shared_ptr<const StreamInfo> info, AVFrame* frame, double time,
-    double duration) {
+    double duration, std::shared_ptr<FFmpegFramePool> pool) {
   variant<PixelFormat, SampleFormat> format;
   if (!MapFrameFormat(info->is_video, frame, &format))
     return nullptr;
@@ -147,12 +159,35 @@ FFmpegDecodedFrame* FFmpegDecodedFrame::CreateFrame(
     }
   }
 
-  // TODO(modmaker): Add an AVFrame pool to reuse objects.
-  AVFrame* copy = av_frame_clone(frame);
+  AVFrame* copy = pool->AcquireFrame();
   if (!copy)
     return nullptr;
-  return new (std::nothrow) FFmpegDecodedFrame(copy, time, time, duration, info,
-                                               format, data, linesize);
+  av_frame_move_ref(copy, frame);
+  return memory::MakePooledShared<FFmpegDecodedFrame>(
+      PrivateTag(), copy, pool, time, time, duration, info, format, data,
+      linesize);
+}
+
+HdrMetadata FFmpegDecodedFrame::GetHdrMetadata() const {
+  // The decoder fills these in from the bitstream (e.g. the VUI and SEI
+  // messages), which take precedence over the container.
+  HdrMetadata ret = DecodedFrame::GetHdrMetadata();
+  ReadColorInfo(frame_->color_primaries, frame_->color_trc, frame_->colorspace,
+                frame_->color_range, &ret);
+  const AVFrameSideData* side_data =
+      av_frame_get_side_data(frame_, AV_FRAME_DATA_MASTERING_DISPLAY_METADATA);
+  if (side_data) {
+    ReadMasteringDisplay(
+        *reinterpret_cast<const AVMasteringDisplayMetadata*>(side_data->data),
+        &ret);
+  }
+  side_data = av_frame_get_side_data(frame_, AV_FRAME_DATA_CONTENT_LIGHT_LEVEL);
+  if (side_data) {
+    ReadContentLightLevel(
+        *reinterpret_cast<const AVContentLightMetadata*>(side_data->data),
+        &ret);
+  }
+  return ret;
 }
 
 size_t FFmpegDecodedFrame::EstimateSize() const {
@@ -25,6 +25,7 @@ extern "C" {
 
 #include "shaka/media/frames.h"
 #include "shaka/media/stream_info.h"
+#include "src/media/ffmpeg/ffmpeg_frame_pool.h"
 #include "src/util/macros.h"
 
 namespace shaka {
@@ -33,13 +34,31 @@ namespace ffmpeg {
 
 /** This defines a single decoded media frame. */
 class FFmpegDecodedFrame final : public DecodedFrame {
+ private:
+  struct PrivateTag {};
+
  public:
+  /** Use CreateFrame instead; this is only public for allocate_shared. */
+  FFmpegDecodedFrame(PrivateTag, AVFrame* frame,
+                     std::shared_ptr<FFmpegFramePool> pool, double pts,
+                     double dts, double duration,
+                     std::shared_ptr<const StreamInfo> stream,
+                     variant<PixelFormat, SampleFormat> format,
+                     const std::vector<const uint8_t*>& data,
+                     const std::vector<size_t>& linesize);
   ~FFmpegDecodedFrame() override;
 
-  static FFmpegDecodedFrame* CreateFrame(
+  /**
+   * Creates a new frame from the given decoded frame.  This moves the buffer
+   * references out of |frame|, leaving it empty.  The frame object is taken
+   * from the given pool and is returned to it once this is destroyed.  The
+   * frame object itself is allocated from a memory::BlockPool.
+   */
+  static std::shared_ptr<FFmpegDecodedFrame> CreateFrame(
       std::shared_ptr<const StreamInfo> stream, AVFrame* frame, double time,
-      double duration);
+      double duration, std::shared_ptr<FFmpegFramePool> pool);
 
+  HdrMetadata GetHdrMetadata() const override;
   size_t EstimateSize() const override;
 
   AVFrame* raw_frame() const {
@@ -47,13 +66,8 @@ class FFmpegDecodedFrame final : public DecodedFrame {
   }
 
  private:
-  FFmpegDecodedFrame(AVFrame* frame, double pts, double dts, double duration,
-                     std::shared_ptr<const StreamInfo> stream,
-                     variant<PixelFormat, SampleFormat> format,
-                     const std::vector<const uint8_t*>& data,
-                     const std::vector<size_t>& linesize);
-
   AVFrame* frame_;
+  const std::shared_ptr<FFmpegFramePool> pool_;
 };
 
 }  // namespace ffmpeg
@@ -16,11 +16,18 @@
 
 #include <glog/logging.h>
 
+#include <algorithm>
+#include <functional>
 #include <string>
 #include <unordered_map>
+#include <utility>
 
+#include "src/media/decoder_thread.h"
+#include "src/media/decoding_info_cache.h"
 #include "src/media/ffmpeg/ffmpeg_decoded_frame.h"
 #include "src/media/media_utils.h"
+#include "src/media/pixel_conversion.h"
+#include "src/media/segment_encoded_frame.h"
 #include "src/util/utils.h"
 
 namespace shaka {
@@ -71,23 +78,92 @@ std::string GetCodecFromMime(const std::string& mime) {
   return it != params.end() ? it->second : "";
 }
 
+AVPixelFormat ToAvPixelFormat(PixelFormat format) {
+  switch (format) {
+    case PixelFormat::YUV420P:
+      return AV_PIX_FMT_YUV420P;
+    case PixelFormat::NV12:
+      return AV_PIX_FMT_NV12;
+    case PixelFormat::RGB24:
+      return AV_PIX_FMT_RGB24;
+    case PixelFormat::YUV420P10:
+      return AV_PIX_FMT_YUV420P10LE;
+    case PixelFormat::P010:
+      return AV_PIX_FMT_P010LE;
+    case PixelFormat::VideoToolbox:
+      return AV_PIX_FMT_VIDEOTOOLBOX;
+    default:
+      return AV_PIX_FMT_NONE;
+  }
+}
+
+/**
+ * @return The number of bits to drop from each component to convert between
+ *   the given formats, or 0 if we can't convert between them.
+ */
+unsigned int GetConversionShift(AVPixelFormat from, AVPixelFormat to) {
+  if (from == AV_PIX_FMT_YUV420P10LE && to == AV_PIX_FMT_YUV420P)
+    return 2;
+  // P010 stores the 10 bits in the high bits of each component.
+  if (from == AV_PIX_FMT_P010LE && to == AV_PIX_FMT_NV12)
+    return 8;
+  return 0;
+}
+
+MediaCapabilitiesInfo QueryDecodingInfo(
+    const MediaDecodingConfiguration& config) {
+  MediaCapabilitiesInfo ret;
+  const bool has_video = !config.video.content_type.empty();
+  const bool has_audio = !config.audio.content_type.empty();
+  if (has_audio == has_video || config.type != MediaDecodingType::MediaSource)
+    return ret;
+
+  const std::string codec = GetCodecFromMime(
+      has_video ? config.video.content_type : config.audio.content_type);
+  // If codec isn't given, assume supported but not hardware accelerated.
+  auto* c = FindCodec(NormalizeCodec(codec));
+  ret.supported = codec.empty() || c != nullptr;
+  ret.power_efficient = ret.smooth = c && c->wrapper_name;
+  return ret;
+}
+
 }  // namespace
 
-FFmpegDecoder::FFmpegDecoder()
+FFmpegDecoder::FFmpegDecoder(const DecoderOptions& options)
     : mutex_("FFmpegDecoder"),
+      options_(options),
+      // Frames are kept for the decode window both ahead of and behind the
+      // playhead.
+      pool_(std::make_shared<FFmpegFramePool>(
+          2 * DecoderThread::kDecodeBufferSize)),
+      convert_pool_(std::make_shared<FFmpegFramePool>(
+          2 * DecoderThread::kDecodeBufferSize)),
       decoder_ctx_(nullptr),
       received_frame_(nullptr),
+      converted_frame_(nullptr),
 #ifdef ENABLE_HARDWARE_DECODE
       hw_device_ctx_(nullptr),
+      hw_device_type_(AV_HWDEVICE_TYPE_NONE),
       hw_pix_fmt_(AV_PIX_FMT_NONE),
 #endif
-      prev_timestamp_offset_(0) {
+      prev_timestamp_offset_(0),
+      switch_time_(0),
+      send_extra_data_(false),
+      skip_non_reference_(false),
+      max_output_width_(0),
+      max_output_height_(0),
+      reopen_for_size_(false) {
 }
 
 FFmpegDecoder::~FFmpegDecoder() {
+  const FFmpegFramePool::Stats stats = pool_->GetStats();
+  VLOG(1) << "Frame pool: " << stats.buffer_allocations
+          << " buffers allocated, " << stats.buffer_reuses << " reused";
+
   // It is safe if these fields are nullptr.
   avcodec_free_context(&decoder_ctx_);
   av_frame_free(&received_frame_);
+  av_frame_free(&converted_frame_);
 #ifdef ENABLE_HARDWARE_DECODE
   av_buffer_unref(&hw_device_ctx_);
 #endif
@@ -95,19 +171,8 @@ FFmpegDecoder::~FFmpegDecoder() {
 
 MediaCapabilitiesInfo FFmpegDecoder::DecodingInfo(
     const MediaDecodingConfiguration& config) const {
-  MediaCapabilitiesInfo ret;
-  const bool has_video = !config.video.content_type.empty();
-  const bool has_audio = !config.audio.content_type.empty();
-  if (has_audio == has_video || config.type != MediaDecodingType::MediaSource)
-    return ret;
-
-  const std::string codec = GetCodecFromMime(
-      has_video ? config.video.content_type : config.audio.content_type);
-  // If codec isn't given, assume supported but not hardware accelerated.
-  auto* c = FindCodec(NormalizeCodec(codec));
-  ret.supported = codec.empty() || c != nullptr;
-  ret.power_efficient = ret.smooth = c && c->wrapper_name;
-  return ret;
+  return DecodingInfoCache::Instance.Get(
+      "ffmpeg", config, std::bind(&QueryDecodingInfo, config));
 }
 
 void FFmpegDecoder::ResetDecoder() {
@@ -115,29 +180,95 @@ void FFmpegDecoder::ResetDecoder() {
   avcodec_free_context(&decoder_ctx_);
 }
 
+void FFmpegDecoder::SetSkipNonReferenceFrames(bool skip) {
+  std::unique_lock<Mutex> lock(mutex_);
+  skip_non_reference_ = skip;
+  if (decoder_ctx_)
+    decoder_ctx_->skip_frame = skip ? AVDISCARD_NONREF : AVDISCARD_DEFAULT;
+}
+
+void FFmpegDecoder::SetMaxOutputSize(uint32_t width, uint32_t height) {
+  std::unique_lock<Mutex> lock(mutex_);
+  max_output_width_ = width;
+  max_output_height_ = height;
+  // The resolution can only change when the decoder is opened, so reopen it at
+  // the next keyframe.
+  if (decoder_ctx_ && decoder_stream_info_) {
+    reopen_for_size_ = GetLowres(*decoder_stream_info_, decoder_ctx_->codec) !=
+                       decoder_ctx_->lowres;
+  }
+}
+
+void FFmpegDecoder::SetPreferredPixelFormats(
+    const std::vector<PixelFormat>& formats) {
+  std::unique_lock<Mutex> lock(mutex_);
+  // This applies to the frames decoded after this; the decoder's own format
+  // is picked again when it is next opened.
+  preferred_formats_ = formats;
+}
+
+FFmpegFramePool::Stats FFmpegDecoder::GetFramePoolStats() const {
+  return pool_->GetStats();
+}
+
 MediaStatus FFmpegDecoder::Decode(
     std::shared_ptr<EncodedFrame> input, const eme::Implementation* eme,
     std::vector<std::shared_ptr<DecodedFrame>>* frames,
     std::string* extra_info) {
   std::unique_lock<Mutex> lock(mutex_);
+  return DecodeLocked(std::move(input), eme, frames, extra_info);
+}
+
+MediaStatus FFmpegDecoder::DecodeBatch(
+    const std::vector<std::shared_ptr<EncodedFrame>>& input,
+    const eme::Implementation* eme,
+    std::vector<std::shared_ptr<DecodedFrame>>* frames, size_t* consumed,
+    std::string* extra_info) {
+  std::unique_lock<Mutex> lock(mutex_);
+  *consumed = 0;
+  for (auto& frame : input) {
+    DCHECK(frame);
+    const MediaStatus status = DecodeLocked(frame, eme, frames, extra_info);
+    if (status != MediaStatus::Success)
+      return status;
+    (*consumed)++;
+  }
+  return MediaStatus::Success;
+}
+
+MediaStatus FFmpegDecoder::DecodeLocked(
+    std::shared_ptr<EncodedFrame> input, const eme::Implementation* eme,
+    std::vector<std::shared_ptr<DecodedFrame>>* frames,
+    std::string* extra_info) {
   if (!input && !decoder_ctx_) {
     // If there isn't a decoder, there is nothing to flush.
     return MediaStatus::Success;
   }
 
   if (input) {
-    if (!decoder_ctx_ || input->stream_info != decoder_stream_info_) {
+    if (decoder_ctx_ && input->timestamp_offset != prev_timestamp_offset_) {
+      // A new timestamp offset marks a discontinuity, like the next period or
+      // an ad.  Get the frames before it while the old offset still applies,
+      // but keep the decoder open.
+      VLOG(1) << "Draining decoder for discontinuity";
+      if (!DrainDecoder(frames, extra_info))
+        return MediaStatus::FatalError;
+    }
+
+    if (decoder_ctx_ && input->stream_info != decoder_stream_info_ &&
+        CanReconfigureInPlace(*input->stream_info)) {
+      VLOG(1) << "Reconfiguring decoder in place";
+      send_extra_data_ |=
+          input->stream_info->extra_data != decoder_stream_info_->extra_data;
+      prev_stream_info_ = decoder_stream_info_;
+      switch_time_ = input->pts;
+      decoder_stream_info_ = input->stream_info;
+    } else if (!decoder_ctx_ || input->stream_info != decoder_stream_info_ ||
+               (reopen_for_size_ && input->is_key_frame)) {
       VLOG(1) << "Reconfiguring decoder";
       // Flush the old decoder to get any existing frames.
-      if (decoder_ctx_) {
-        const int send_code = avcodec_send_packet(decoder_ctx_, nullptr);
-        if (send_code != 0) {
-          LogError(send_code, extra_info);
-          return MediaStatus::FatalError;
-        }
-        if (!ReadFromDecoder(decoder_stream_info_, nullptr, frames, extra_info))
-          return MediaStatus::FatalError;
-      }
+      if (decoder_ctx_ && !DrainDecoder(frames, extra_info))
+        return MediaStatus::FatalError;
 
       if (!InitializeDecoder(input->stream_info, true, extra_info))
         return MediaStatus::FatalError;
@@ -147,7 +278,9 @@ MediaStatus FFmpegDecoder::Decode(
   }
 
 
-  // If the encoded frame is encrypted, decrypt it first.
+  // If the encoded frame is encrypted, decrypt it first.  Frames that can be
+  // decrypted in place are used directly; otherwise the clear data is put in a
+  // new packet.
   AVPacket packet{};
   util::Finally free_decrypted_packet(std::bind(&av_packet_unref, &packet));
   if (input && input->encryption_info) {
@@ -156,25 +289,45 @@ MediaStatus FFmpegDecoder::Decode(
       return MediaStatus::KeyNotFound;
     }
 
-    int code = av_new_packet(&packet, input->data_size);
-    if (code < 0) {
-      LogError(code, extra_info);
-      return MediaStatus::FatalError;
-    }
+    MediaStatus decrypt_status;
+    if (!SegmentEncodedFrame::DecryptInPlace(input.get(), eme,
+                                             &decrypt_status)) {
+      int code = av_new_packet(&packet, input->data_size);
+      if (code < 0) {
+        LogError(code, extra_info);
+        return MediaStatus::FatalError;
+      }
 
-    MediaStatus decrypt_status = input->Decrypt(eme, packet.data);
+      decrypt_status = input->Decrypt(eme, packet.data);
+    }
     if (decrypt_status == MediaStatus::KeyNotFound)
       return MediaStatus::KeyNotFound;
     if (decrypt_status != MediaStatus::Success) {
       *extra_info = "CDM returned error while decrypting frame";
       return MediaStatus::FatalError;
     }
-  } else if (input) {
+  }
+  if (input) {
     const double timescale = input->stream_info->time_scale;
     packet.pts = static_cast<int64_t>(input->pts / timescale);
     packet.dts = static_cast<int64_t>(input->dts / timescale);
-    packet.data = const_cast<uint8_t*>(input->data);
-    packet.size = input->data_size;
+    if (!packet.data) {
+      packet.data = const_cast<uint8_t*>(input->data);
+      packet.size = input->data_size;
+    }
+
+    if (send_extra_data_) {
+      // The H.264 and HEVC decoders read new parameter sets from this without
+      // being reopened.
+      const std::vector<uint8_t>& extra_data = input->stream_info->extra_data;
+      uint8_t* side_data = av_packet_new_side_data(
+          &packet, AV_PKT_DATA_NEW_EXTRADATA, extra_data.size());
+      if (!side_data) {
+        *extra_info = ALLOC_ERROR_STR;
+        return MediaStatus::FatalError;
+      }
+      memcpy(side_data, extra_data.data(), extra_data.size());
+    }
   }
 
   bool sent_frame = false;
@@ -183,6 +336,8 @@ MediaStatus FFmpegDecoder::Decode(
     const int send_code = avcodec_send_packet(decoder_ctx_, &packet);
     if (send_code == 0) {
       sent_frame = true;
+      if (input)
+        send_extra_data_ = false;
     } else if (send_code == AVERROR_EOF) {
       // If we get EOF, this is either a flush or we are closing.  Either way,
       // stop.  If this is a flush, we can't reuse the decoder, so reset it.
@@ -201,26 +356,46 @@ MediaStatus FFmpegDecoder::Decode(
   return MediaStatus::Success;
 }
 
-#ifdef ENABLE_HARDWARE_DECODE
+// static
 AVPixelFormat FFmpegDecoder::GetPixelFormat(AVCodecContext* ctx,
                                             const AVPixelFormat* formats) {
-  AVPixelFormat desired =
-      reinterpret_cast<FFmpegDecoder*>(ctx->opaque)->hw_pix_fmt_;
-  for (size_t i = 0; formats[i] != AV_PIX_FMT_NONE; i++) {
-    if (formats[i] == desired)
-      return formats[i];
-  }
+  auto* decoder = reinterpret_cast<FFmpegDecoder*>(ctx->opaque);
+#ifdef ENABLE_HARDWARE_DECODE
+  const AVPixelFormat desired = decoder->hw_pix_fmt_;
+  if (desired != AV_PIX_FMT_NONE) {
+    for (size_t i = 0; formats[i] != AV_PIX_FMT_NONE; i++) {
+      if (formats[i] == desired)
+        return formats[i];
+    }
 #  ifdef FORCE_HARDWARE_DECODE
-  LOG(DFATAL) << "Hardware pixel format is unsupported.";
-  return AV_PIX_FMT_NONE;
+    LOG(DFATAL) << "Hardware pixel format is unsupported.";
+    return AV_PIX_FMT_NONE;
 #  else
-  LOG(ERROR) << "Hardware pixel format is unsupported, may be falling back "
-                "to software decoder.";
-  return formats[0];
+    LOG(ERROR) << "Hardware pixel format is unsupported, may be falling back "
+                  "to software decoder.";
+    return formats[0];
 #  endif
-}
+  }
 #endif
 
+  // Some decoders can output several formats; use the first one the renderer
+  // can draw directly.  This is called while Decode holds the lock.
+  for (PixelFormat preferred : decoder->preferred_formats_) {
+    const AVPixelFormat format = ToAvPixelFormat(preferred);
+    for (size_t i = 0; formats[i] != AV_PIX_FMT_NONE; i++) {
+      if (formats[i] == format)
+        return format;
+    }
+  }
+  return avcodec_default_get_format(ctx, formats);
+}
+
+// static
+int FFmpegDecoder::GetBuffer(AVCodecContext* ctx, AVFrame* frame, int flags) {
+  return reinterpret_cast<FFmpegDecoder*>(ctx->opaque)
+      ->pool_->GetBuffer(ctx, frame, flags);
+}
+
 bool FFmpegDecoder::InitializeDecoder(std::shared_ptr<const StreamInfo> info,
                                       bool allow_hardware,
                                       std::string* extra_info) {
@@ -262,6 +437,9 @@ bool FFmpegDecoder::InitializeDecoder(std::shared_ptr<const StreamInfo> info,
 #endif
 
   avcodec_free_context(&decoder_ctx_);
+  prev_stream_info_.reset();
+  send_extra_data_ = false;
+  reopen_for_size_ = false;
   decoder_ctx_ = avcodec_alloc_context3(decoder);
   if (!decoder_ctx_) {
     *extra_info = ALLOC_ERROR_STR;
@@ -276,8 +454,42 @@ bool FFmpegDecoder::InitializeDecoder(std::shared_ptr<const StreamInfo> info,
     }
   }
 
-  decoder_ctx_->thread_count = 0;  // Default is 1; 0 means auto-detect.
+  const DecoderThreadingOptions& threading =
+      options_.GetThreading(info->codec);
+  // Default is 1; 0 means auto-detect.
+  decoder_ctx_->thread_count = threading.thread_count;
+  switch (threading.thread_type) {
+    case DecoderThreadType::Auto:
+      decoder_ctx_->thread_type = FF_THREAD_FRAME | FF_THREAD_SLICE;
+      break;
+    case DecoderThreadType::Frame:
+      decoder_ctx_->thread_type = FF_THREAD_FRAME;
+      break;
+    case DecoderThreadType::Slice:
+      decoder_ctx_->thread_type = FF_THREAD_SLICE;
+      break;
+  }
+  if (threading.low_delay)
+    decoder_ctx_->flags |= AV_CODEC_FLAG_LOW_DELAY;
+  decoder_ctx_->skip_frame =
+      skip_non_reference_ ? AVDISCARD_NONREF : AVDISCARD_DEFAULT;
+  if (options_.fast_decode) {
+    decoder_ctx_->skip_loop_filter = AVDISCARD_ALL;
+    decoder_ctx_->flags2 |= AV_CODEC_FLAG2_FAST;
+  }
+#ifdef AV_CODEC_EXPORT_DATA_FILM_GRAIN
+  // Exporting the film grain parameters stops the decoder from applying them.
+  if (!options_.apply_film_grain)
+    decoder_ctx_->export_side_data |= AV_CODEC_EXPORT_DATA_FILM_GRAIN;
+#endif
+  decoder_ctx_->lowres = GetLowres(*info, decoder);
   decoder_ctx_->opaque = this;
+  decoder_ctx_->get_buffer2 = &GetBuffer;
+#if LIBAVCODEC_VERSION_MAJOR < 59
+  // The pool is thread-safe, so frame threads don't need to wait on the main
+  // decoder thread to allocate buffers.
+  decoder_ctx_->thread_safe_callbacks = 1;
+#endif
   decoder_ctx_->pkt_timebase = {.num = info->time_scale.numerator,
                                 .den = info->time_scale.denominator};
 
@@ -295,19 +507,26 @@ bool FFmpegDecoder::InitializeDecoder(std::shared_ptr<const StreamInfo> info,
   }
 
 #ifdef ENABLE_HARDWARE_DECODE
-  // If using a hardware accelerator, initialize it now.
-  av_buffer_unref(&hw_device_ctx_);
+  // If using a hardware accelerator, initialize it now.  Reuse the existing
+  // device if it is the same type.
+  if (hw_device_type_ != hw_type) {
+    av_buffer_unref(&hw_device_ctx_);
+    hw_device_type_ = AV_HWDEVICE_TYPE_NONE;
+  }
   if (allow_hardware && hw_type != AV_HWDEVICE_TYPE_NONE) {
-    const int hw_device_code =
-        av_hwdevice_ctx_create(&hw_device_ctx_, hw_type, nullptr, nullptr, 0);
-    if (hw_device_code < 0) {
-      LogError(hw_device_code, extra_info);
-      return false;
+    if (!hw_device_ctx_) {
+      const int hw_device_code = av_hwdevice_ctx_create(
+          &hw_device_ctx_, hw_type, nullptr, nullptr, 0);
+      if (hw_device_code < 0) {
+        LogError(hw_device_code, extra_info);
+        return false;
+      }
+      hw_device_type_ = hw_type;
     }
-    decoder_ctx_->get_format = &GetPixelFormat;
     decoder_ctx_->hw_device_ctx = av_buffer_ref(hw_device_ctx_);
   }
 #endif
+  decoder_ctx_->get_format = &GetPixelFormat;
 
   const int open_code = avcodec_open2(decoder_ctx_, decoder, nullptr);
   if (open_code < 0) {
@@ -331,6 +550,138 @@ bool FFmpegDecoder::InitializeDecoder(std::shared_ptr<const StreamInfo> info,
   return true;
 }
 
+int FFmpegDecoder::GetLowres(const StreamInfo& info,
+                             const AVCodec* decoder) const {
+  // Only some codecs (e.g. MPEG-2 and MPEG-4 part 2) support lowres.  Use the
+  // lowest resolution that is still at least the size the frames are drawn at.
+  int lowres = options_.lowres;
+  if (max_output_width_ > 0 && max_output_height_ > 0) {
+    while (lowres < decoder->max_lowres &&
+           (info.width >> (lowres + 1)) >= max_output_width_ &&
+           (info.height >> (lowres + 1)) >= max_output_height_) {
+      lowres++;
+    }
+  }
+  return std::min<int>(lowres, decoder->max_lowres);
+}
+
+std::shared_ptr<const StreamInfo> FFmpegDecoder::GetScaledStreamInfo(
+    std::shared_ptr<const StreamInfo> info, int width, int height) {
+  if (info->width == static_cast<uint32_t>(width) &&
+      info->height == static_cast<uint32_t>(height)) {
+    return info;
+  }
+  // Reuse the copy so the renderers see the same stream for every frame.
+  if (scaled_source_ != info ||
+      scaled_stream_info_->width != static_cast<uint32_t>(width) ||
+      scaled_stream_info_->height != static_cast<uint32_t>(height)) {
+    scaled_source_ = info;
+    scaled_stream_info_.reset(new StreamInfo(
+        info->mime_type, info->codec, info->is_video, info->time_scale,
+        info->sample_aspect_ratio, info->extra_data, width, height,
+        info->channel_count, info->sample_rate, info->hdr_metadata));
+  }
+  return scaled_stream_info_;
+}
+
+bool FFmpegDecoder::CanReconfigureInPlace(const StreamInfo& info) const {
+  if (NormalizeCodec(info.codec) !=
+          NormalizeCodec(decoder_stream_info_->codec) ||
+      info.time_scale != decoder_stream_info_->time_scale) {
+    return false;
+  }
+  if (info.extra_data == decoder_stream_info_->extra_data)
+    return true;
+
+  // Only FFmpeg's own H.264 and HEVC decoders support new extra data in
+  // packets; wrappers around OS decoders may ignore it.
+  return !decoder_ctx_->codec->wrapper_name &&
+         (decoder_ctx_->codec_id == AV_CODEC_ID_H264 ||
+          decoder_ctx_->codec_id == AV_CODEC_ID_HEVC);
+}
+
+bool FFmpegDecoder::DrainDecoder(
+    std::vector<std::shared_ptr<DecodedFrame>>* decoded,
+    std::string* extra_info) {
+  const int send_code = avcodec_send_packet(decoder_ctx_, nullptr);
+  if (send_code != 0) {
+    LogError(send_code, extra_info);
+    return false;
+  }
+  if (!ReadFromDecoder(decoder_stream_info_, nullptr, decoded, extra_info))
+    return false;
+
+  // Draining leaves the decoder at end-of-stream; flushing lets it accept new
+  // packets again.  All the frames from the previous stream are now out.
+  avcodec_flush_buffers(decoder_ctx_);
+  prev_stream_info_.reset();
+  return true;
+}
+
+bool FFmpegDecoder::ConvertToPreferredFormat(std::string* extra_info) {
+  const AVPixelFormat format =
+      static_cast<AVPixelFormat>(received_frame_->format);
+  AVPixelFormat target = AV_PIX_FMT_NONE;
+  unsigned int shift = 0;
+  for (PixelFormat preferred : preferred_formats_) {
+    const AVPixelFormat av_format = ToAvPixelFormat(preferred);
+    if (av_format == format)
+      return true;
+    if (target == AV_PIX_FMT_NONE) {
+      shift = GetConversionShift(format, av_format);
+      if (shift > 0)
+        target = av_format;
+    }
+  }
+  // If we can't convert the frame, the renderer will have to.
+  if (target == AV_PIX_FMT_NONE)
+    return true;
+
+  if (!converted_frame_) {
+    converted_frame_ = av_frame_alloc();
+    if (!converted_frame_) {
+      *extra_info = ALLOC_ERROR_STR;
+      return false;
+    }
+  }
+  converted_frame_->format = target;
+  converted_frame_->width = received_frame_->width;
+  converted_frame_->height = received_frame_->height;
+  int code = convert_pool_->GetBuffer(converted_frame_);
+  if (code >= 0)
+    code = av_frame_copy_props(converted_frame_, received_frame_);
+  if (code < 0) {
+    av_frame_unref(converted_frame_);
+    LogError(code, extra_info);
+    return false;
+  }
+
+  // Both conversions are 4:2:0, so only the number of chroma planes differs.
+  const size_t width = received_frame_->width;
+  const size_t height = received_frame_->height;
+  const size_t chroma_width = (width + 1) / 2;
+  const size_t chroma_height = (height + 1) / 2;
+  const uint8_t* const* src = received_frame_->data;
+  const int* src_linesize = received_frame_->linesize;
+  uint8_t* const* dest = converted_frame_->data;
+  const int* dest_linesize = converted_frame_->linesize;
+  ConvertPlane16To8(src[0], src_linesize[0], dest[0], dest_linesize[0], width,
+                    height, shift);
+  if (target == AV_PIX_FMT_NV12) {
+    ConvertPlane16To8(src[1], src_linesize[1], dest[1], dest_linesize[1],
+                      chroma_width * 2, chroma_height, shift);
+  } else {
+    for (size_t i = 1; i < 3; i++) {
+      ConvertPlane16To8(src[i], src_linesize[i], dest[i], dest_linesize[i],
+                        chroma_width, chroma_height, shift);
+    }
+  }
+
+  av_frame_unref(received_frame_);
+  av_frame_move_ref(received_frame_, converted_frame_);
+  return true;
+}
+
 bool FFmpegDecoder::ReadFromDecoder(
     std::shared_ptr<const StreamInfo> stream_info,
     std::shared_ptr<EncodedFrame> input,
@@ -352,13 +703,27 @@ bool FFmpegDecoder::ReadFromDecoder(
     const double time = input && timestamp == AV_NOPTS_VALUE
                             ? input->pts
                             : timestamp * timescale + offset;
-    auto* new_frame = FFmpegDecodedFrame::CreateFrame(
-        stream_info, received_frame_, time, input ? input->duration : 0);
+    // After reconfiguring in place, the frames still in the decoder are from
+    // the previous stream.
+    auto frame_stream_info = prev_stream_info_ && time < switch_time_
+                                 ? prev_stream_info_
+                                 : stream_info;
+    // Frames decoded at a reduced resolution need a stream with their size.
+    if (decoder_ctx_->lowres > 0) {
+      frame_stream_info =
+          GetScaledStreamInfo(frame_stream_info, received_frame_->width,
+                              received_frame_->height);
+    }
+    if (stream_info->is_video && !ConvertToPreferredFormat(extra_info))
+      return false;
+    auto new_frame = FFmpegDecodedFrame::CreateFrame(
+        frame_stream_info, received_frame_, time, input ? input->duration : 0,
+        pool_);
     if (!new_frame) {
       *extra_info = ALLOC_ERROR_STR;
       return false;
     }
-    decoded->emplace_back(new_frame);
+    decoded->emplace_back(std::move(new_frame));
   }
 }
 
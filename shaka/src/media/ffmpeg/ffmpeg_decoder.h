@@ -28,6 +28,7 @@ extern "C" {
 #include "shaka/media/frames.h"
 #include "shaka/media/stream_info.h"
 #include "src/debug/mutex.h"
+#include "src/media/ffmpeg/ffmpeg_frame_pool.h"
 
 namespace shaka {
 namespace media {
@@ -39,7 +40,7 @@ namespace ffmpeg {
  */
 class FFmpegDecoder : public Decoder {
  public:
-  FFmpegDecoder();
+  explicit FFmpegDecoder(const DecoderOptions& options = DecoderOptions());
   ~FFmpegDecoder() override;
 
   MediaCapabilitiesInfo DecodingInfo(
@@ -51,16 +52,57 @@ class FFmpegDecoder : public Decoder {
       std::shared_ptr<EncodedFrame> input, const eme::Implementation* eme,
       std::vector<std::shared_ptr<DecodedFrame>>* frames,
       std::string* extra_info) override;
+  MediaStatus DecodeBatch(
+      const std::vector<std::shared_ptr<EncodedFrame>>& input,
+      const eme::Implementation* eme,
+      std::vector<std::shared_ptr<DecodedFrame>>* frames, size_t* consumed,
+      std::string* extra_info) override;
+
+  void SetSkipNonReferenceFrames(bool skip) override;
+  void SetMaxOutputSize(uint32_t width, uint32_t height) override;
+  void SetPreferredPixelFormats(
+      const std::vector<PixelFormat>& formats) override;
+
+  /** @return The allocation statistics of the decoded frame pool. */
+  FFmpegFramePool::Stats GetFramePoolStats() const;
 
  private:
-#ifdef ENABLE_HARDWARE_DECODE
   static AVPixelFormat GetPixelFormat(AVCodecContext* ctx,
                                       const AVPixelFormat* formats);
-#endif
 
+  static int GetBuffer(AVCodecContext* ctx, AVFrame* frame, int flags);
+
+  MediaStatus DecodeLocked(std::shared_ptr<EncodedFrame> input,
+                           const eme::Implementation* eme,
+                           std::vector<std::shared_ptr<DecodedFrame>>* frames,
+                           std::string* extra_info);
   bool InitializeDecoder(std::shared_ptr<const StreamInfo> info,
                          bool allow_hardware,
                          std::string* extra_info);
+  /**
+   * @return Whether the current decoder can switch to the given stream without
+   *   being reopened, like when switching between variants.
+   */
+  bool CanReconfigureInPlace(const StreamInfo& info) const;
+  /**
+   * Gets all the frames still in the decoder, then resets it so it can decode
+   * more frames without being reopened.
+   */
+  bool DrainDecoder(std::vector<std::shared_ptr<DecodedFrame>>* decoded,
+                    std::string* extra_info);
+  /** @return The lowres level to decode the given stream at. */
+  int GetLowres(const StreamInfo& info, const AVCodec* decoder) const;
+  /**
+   * Gets a copy of the given stream with the given frame size, for frames the
+   * decoder output at a reduced resolution.
+   */
+  std::shared_ptr<const StreamInfo> GetScaledStreamInfo(
+      std::shared_ptr<const StreamInfo> info, int width, int height);
+  /**
+   * If the renderer can't draw |received_frame_| directly but can draw a
+   * format it can be converted to, converts it in place.
+   */
+  bool ConvertToPreferredFormat(std::string* extra_info);
   bool ReadFromDecoder(std::shared_ptr<const StreamInfo> stream_info,
                        std::shared_ptr<EncodedFrame> input,
                        std::vector<std::shared_ptr<DecodedFrame>>* decoded,
@@ -68,16 +110,47 @@ class FFmpegDecoder : public Decoder {
 
   Mutex mutex_;
   const std::string codec_;
+  const DecoderOptions options_;
+  const std::shared_ptr<FFmpegFramePool> pool_;
+  // Holds the frames converted to the renderer's format.  This is separate
+  // from |pool_| since the converted frames are a different size.
+  const std::shared_ptr<FFmpegFramePool> convert_pool_;
 
   AVCodecContext* decoder_ctx_;
   AVFrame* received_frame_;
+  AVFrame* converted_frame_;
 #ifdef ENABLE_HARDWARE_DECODE
+  // The hardware device is kept when the decoder is reopened for a new stream
+  // so GPU resources aren't reallocated.
   AVBufferRef* hw_device_ctx_;
+  AVHWDeviceType hw_device_type_;
   AVPixelFormat hw_pix_fmt_;
 #endif
   double prev_timestamp_offset_;
   // The stream the decoder is currently configured to use.
   std::shared_ptr<const StreamInfo> decoder_stream_info_;
+  // When the decoder is reconfigured in place, this is the stream it was
+  // configured for before; frames before |switch_time_| are from this stream.
+  std::shared_ptr<const StreamInfo> prev_stream_info_;
+  double switch_time_;
+  // Whether the next packet needs to carry the new stream's extra data.
+  bool send_extra_data_;
+  // Whether to skip non-reference frames; this is kept when the decoder is
+  // reopened.
+  bool skip_non_reference_;
+  // The largest size frames are drawn at, or 0 if there is no limit; see
+  // Decoder::SetMaxOutputSize.
+  uint32_t max_output_width_;
+  uint32_t max_output_height_;
+  // Whether the decoder should be reopened at the next keyframe to change the
+  // output resolution.
+  bool reopen_for_size_;
+  // The formats the renderer can draw directly, most preferred first; see
+  // Decoder::SetPreferredPixelFormats.
+  std::vector<PixelFormat> preferred_formats_;
+  // The last stream given to GetScaledStreamInfo and its scaled copy.
+  std::shared_ptr<const StreamInfo> scaled_source_;
+  std::shared_ptr<const StreamInfo> scaled_stream_info_;
 };
 
 }  // namespace ffmpeg
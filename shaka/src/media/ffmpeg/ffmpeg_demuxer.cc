@@ -22,11 +22,15 @@ extern "C" {
 
 #include <algorithm>
 #include <unordered_map>
+#include <utility>
 
 #include "src/media/ffmpeg/ffmpeg_encoded_frame.h"
+#include "src/media/ffmpeg/ffmpeg_hdr_metadata.h"
+#include "src/media/ffmpeg/ffmpeg_probe_cache.h"
 #include "src/media/media_utils.h"
-#include "src/util/buffer_reader.h"
 #include "src/util/buffer_writer.h"
+#include "src/util/clock.h"
+#include "src/util/crypto.h"
 
 // Special error code added by //third_party/ffmpeg/mov.patch
 #define AVERROR_SHAKA_RESET_DEMUXER (-123456)
@@ -39,7 +43,22 @@ namespace ffmpeg {
 
 namespace {
 
-constexpr const size_t kInitialBufferSize = 2048;
+/**
+ * The size of the IO buffer.  This matches the default used by libavformat so
+ * it doesn't need to be reallocated while reading.  The same buffer is used for
+ * the lifetime of the demuxer, including when reading new init segments.
+ */
+constexpr const size_t kInitialBufferSize = 32 * 1024;
+
+/** @return The codec given in the MIME type, or empty if not given. */
+std::string GetCodecHint(const std::string& mime) {
+  std::unordered_map<std::string, std::string> params;
+  if (!ParseMimeType(mime, nullptr, nullptr, &params) ||
+      params.count(kCodecMimeParam) == 0) {
+    return "";
+  }
+  return params.at(kCodecMimeParam);
+}
 
 std::string GetCodec(const std::string& mime, AVCodecID codec) {
   std::unordered_map<std::string, std::string> params;
@@ -95,6 +114,27 @@ std::vector<uint8_t> CreatePssh(AVEncryptionInitInfo* info) {
   return pssh;
 }
 
+/**
+ * Returns whether the codec parameters read from an init segment are complete
+ * enough to use without probing the stream.  This is only true when the codec
+ * is the one we expect, either from the MIME type or from the stream we were
+ * just reading.
+ */
+bool CanSkipProbe(const std::string& expected_codec,
+                  const AVCodecParameters* params) {
+  if (expected_codec.empty() ||
+      NormalizeCodec(expected_codec) != avcodec_get_name(params->codec_id)) {
+    return false;
+  }
+  if (params->extradata_size == 0)
+    return false;
+  if (params->codec_type == AVMEDIA_TYPE_VIDEO)
+    return params->width > 0 && params->height > 0;
+  if (params->codec_type == AVMEDIA_TYPE_AUDIO)
+    return params->channels > 0 && params->sample_rate > 0;
+  return false;
+}
+
 bool ParseAndCheckSupport(const std::string& mime, std::string* container) {
   std::string subtype;
   if (!ParseMimeType(mime, nullptr, &subtype, nullptr))
@@ -108,285 +148,6 @@ bool ParseAndCheckSupport(const std::string& mime, std::string* container) {
   return true;
 }
 
-// The FFmpeg demuxer will use its decoders to fill in certain fields.  If we
-// aren't using the FFmpeg decoders, we need to parse these fields ourselves.
-#ifndef HAS_FFMPEG_DECODER
-
-void RemoveEmulationPrevention(const uint8_t* data, size_t size,
-                               std::vector<uint8_t>* output) {
-  DCHECK_EQ(output->size(), size);
-  // A byte sequence 0x0 0x0 0x1 is used to signal the start of a NALU.  So for
-  // the body of the NALU, it needs to be escaped.  So this reverses the
-  // escaping by changing 0x0 0x0 0x3 to 0x0 0x0.
-  DCHECK_EQ(output->size(), size);
-  size_t out_pos = 0;
-  for (size_t in_pos = 0; in_pos < size;) {
-    if (in_pos + 2 < size && data[in_pos] == 0 && data[in_pos + 1] == 0 &&
-        data[in_pos + 2] == 0x3) {
-      (*output)[out_pos++] = 0;
-      (*output)[out_pos++] = 0;
-      in_pos += 3;
-    } else {
-      (*output)[out_pos++] = data[in_pos++];
-    }
-  }
-  output->resize(out_pos);
-}
-
-Rational<uint32_t> GetSarFromVuiParameters(util::BufferReader* reader) {
-  // See section E.1.1 of H.264/H.265.
-  // vui_parameters()
-  if (reader->ReadBits(1) == 0)  // aspect_ratio_info_present_flag
-    return {0, 0};               // Values we want aren't there, return unknown.
-  const uint8_t aspect_ratio_idc = reader->ReadUint8();
-  // See Table E-1 in H.264.
-  switch (aspect_ratio_idc) {
-    case 1:
-      return {1, 1};
-    case 2:
-      return {12, 11};
-    case 3:
-      return {10, 11};
-    case 4:
-      return {16, 11};
-    case 5:
-      return {40, 33};
-    case 6:
-      return {24, 11};
-    case 7:
-      return {20, 11};
-    case 8:
-      return {32, 11};
-    case 9:
-      return {80, 33};
-    case 10:
-      return {18, 11};
-    case 11:
-      return {15, 11};
-    case 12:
-      return {64, 33};
-    case 13:
-      return {160, 99};
-    case 14:
-      return {4, 3};
-    case 15:
-      return {3, 2};
-    case 16:
-      return {2, 1};
-    case 255:
-      return {reader->ReadBits(16), reader->ReadBits(16)};
-
-    default:
-      LOG(DFATAL) << "Unknown value of aspect_ratio_idc: "
-                  << static_cast<int>(aspect_ratio_idc);
-      return {0, 0};
-  }
-}
-
-Rational<uint32_t> GetSarFromH264(const std::vector<uint8_t>& extra_data) {
-  util::BufferReader reader(extra_data.data(), extra_data.size());
-  // The H.264 extra data is a AVCDecoderConfigurationRecord from
-  // Section 5.3.3.1.2 in ISO/IEC 14496-15
-  reader.Skip(5);
-  const size_t sps_count = reader.ReadUint8() & 0x1f;
-  if (sps_count == 0)
-    return {0, 0};
-
-  // There should only be one SPS, or they should be compatible since there
-  // should only be one video stream.  There may be two SPS for encrypted
-  // content with a clear lead.
-  const size_t sps_size = reader.ReadBits(16);
-  if (sps_size >= reader.BytesRemaining()) {
-    LOG(DFATAL) << "Invalid avcC configuration";
-    return {0, 0};
-  }
-
-  // This is an SPS NALU; remove the emulation prevention bytes.
-  // See ISO/IE 14496-10 Sec. 7.3.1/7.3.2 and H.264 Sec. 7.3.2.1.1.
-  std::vector<uint8_t> temp(sps_size);
-  RemoveEmulationPrevention(reader.data(), sps_size, &temp);
-  util::BufferReader sps_reader(temp.data(), temp.size());
-  if ((sps_reader.ReadUint8() & 0x1f) != 0x7) {
-    LOG(DFATAL) << "Non-SPS found in avcC configuration";
-    return {0, 0};
-  }
-
-  // seq_parameter_set_rbsp()
-  const uint8_t profile_idc = sps_reader.ReadUint8();
-  sps_reader.Skip(2);
-  sps_reader.ReadExpGolomb();  // seq_parameter_set_id
-  // Values here copied from the H.264 spec.
-  if (profile_idc == 100 || profile_idc == 110 || profile_idc == 122 ||
-      profile_idc == 244 || profile_idc == 44 || profile_idc == 83 ||
-      profile_idc == 86 || profile_idc == 118 || profile_idc == 128 ||
-      profile_idc == 138 || profile_idc == 139 || profile_idc == 134) {
-    const uint64_t chroma_format_idc = sps_reader.ReadExpGolomb();
-    if (chroma_format_idc == 3)
-      sps_reader.ReadBits(1);           // separate_colour_plane_flag
-    sps_reader.ReadExpGolomb();         // bit_depth_luma_minus8
-    sps_reader.ReadExpGolomb();         // bit_depth_chroma_minus8
-    sps_reader.SkipBits(1);             // qpprime_y_zero_transform_bypass_flag
-    if (sps_reader.ReadBits(1) == 1) {  // seq_scaling_matrix_present_flag
-      LOG(WARNING) << "Scaling matrix is unsupported";
-      return {0, 0};
-    }
-  }
-  sps_reader.ReadExpGolomb();  // log2_max_frame_num_minus4
-  const uint64_t pic_order_cnt_type = sps_reader.ReadExpGolomb();
-  if (pic_order_cnt_type == 0) {
-    sps_reader.ReadExpGolomb();  // log2_max_pic_order_cnt_lsb_minus4
-  } else if (pic_order_cnt_type == 1) {
-    sps_reader.ReadBits(1);      // delta_pic_order_always_zero_flag
-    sps_reader.ReadExpGolomb();  // offset_for_non_ref_pic
-    sps_reader.ReadExpGolomb();  // offset_for_top_to_bottom_field
-    const uint64_t count = sps_reader.ReadExpGolomb();
-    for (uint64_t i = 0; i < count; i++)
-      sps_reader.ReadExpGolomb();  // offset_for_ref_frame
-  }
-  sps_reader.ReadExpGolomb();         // max_num_ref_frames
-  sps_reader.ReadBits(1);             // gaps_in_frame_num_value_allowed_flag
-  sps_reader.ReadExpGolomb();         // pic_width_in_mbs_minus1
-  sps_reader.ReadExpGolomb();         // pic_height_in_map_units_minus1
-  if (sps_reader.ReadBits(1) == 0)    // frame_mbs_only_flag
-    sps_reader.ReadBits(1);           // mb_adaptive_frame_field_flag
-  sps_reader.ReadBits(1);             // direct_8x8_inference_flag
-  if (sps_reader.ReadBits(1) == 1) {  // frame_cropping_flag
-    sps_reader.ReadExpGolomb();       // pframe_crop_left_offset
-    sps_reader.ReadExpGolomb();       // pframe_crop_right_offset
-    sps_reader.ReadExpGolomb();       // pframe_crop_top_offset
-    sps_reader.ReadExpGolomb();       // pframe_crop_bottom_offset
-  }
-  if (sps_reader.ReadBits(1) == 0)  // vui_parameters_present_flag
-    return {0, 0};  // Values we want aren't there, return unknown.
-  // Finally, the thing we actually care about, display parameters.
-  return GetSarFromVuiParameters(&sps_reader);
-}
-
-void SkipHevcProfileTierLevel(bool profile_present,
-                              uint64_t max_sub_layers_minus1,
-                              util::BufferReader* reader) {
-  if (profile_present) {
-    reader->Skip(11);
-  }
-  reader->Skip(1);
-  std::vector<bool> sub_layer_profile_present_flag(max_sub_layers_minus1);
-  std::vector<bool> sub_layer_level_present_flag(max_sub_layers_minus1);
-  for (uint64_t i = 0; i < max_sub_layers_minus1; i++) {
-    sub_layer_profile_present_flag[i] = reader->ReadBits(1);
-    sub_layer_level_present_flag[i] = reader->ReadBits(1);
-  }
-  if (max_sub_layers_minus1 > 0 && max_sub_layers_minus1 < 8)
-    reader->SkipBits(2 * (8 - max_sub_layers_minus1));
-  for (uint64_t i = 0; i < max_sub_layers_minus1; i++) {
-    if (sub_layer_profile_present_flag[i])
-      reader->Skip(11);
-    if (sub_layer_level_present_flag[i])
-      reader->Skip(1);
-  }
-}
-
-Rational<uint32_t> GetSarFromHevc(const std::vector<uint8_t>& extra_data) {
-  util::BufferReader reader(extra_data.data(), extra_data.size());
-  // The H.265 extra data is a HEVCDecoderConfigurationRecord from
-  // Section 8.3.3.1.2 in ISO/IEC 14496-15
-  reader.Skip(22);
-  const uint8_t num_of_arrays = reader.ReadUint8();
-  uint64_t nalu_length = 0;
-  bool found = false;
-  for (uint8_t i = 0; i < num_of_arrays && !found; i++) {
-    const uint8_t nalu_type = reader.ReadUint8() & 0x3f;
-    const uint64_t num_nalus = reader.ReadBits(16);
-    for (uint64_t i = 0; i < num_nalus; i++) {
-      nalu_length = reader.ReadBits(16);
-      // Find the first SPS NALU.  Since this stream should only have one video
-      // stream, all SPS should be compatible.
-      if (nalu_type == 33) {
-        found = true;
-        break;
-      }
-      reader.Skip(nalu_length);
-    }
-  }
-  if (!found)
-    return {0, 0};  // No SPS found, return unknown.
-
-  // This is an SPS NALU; remove the emulation prevention bytes.
-  // See H.265 Sec. 7.3.1.2/7.3.2.2.1.
-  std::vector<uint8_t> temp(nalu_length);
-  RemoveEmulationPrevention(reader.data(), nalu_length, &temp);
-  util::BufferReader sps_reader(temp.data(), temp.size());
-  const uint64_t nalu_type = (sps_reader.ReadBits(16) >> 9) & 0x3f;
-  if (nalu_type != 33) {
-    LOG(DFATAL) << "Invalid NALU type found in extra data";
-    return {0, 0};
-  }
-
-  sps_reader.SkipBits(4);  // sps_video_parameter_set_id
-  const uint64_t max_sub_layers_minus1 = sps_reader.ReadBits(3);
-  sps_reader.SkipBits(1);  // sps_temporal_id_nesting_flag
-  SkipHevcProfileTierLevel(/* profile_present= */ true, max_sub_layers_minus1,
-                           &sps_reader);
-  sps_reader.ReadExpGolomb();           // sps_seq_parameter_set_id
-  if (sps_reader.ReadExpGolomb() == 3)  // chroma_format_idc
-    sps_reader.SkipBits(1);             // separate_colour_plane_flag
-  sps_reader.ReadExpGolomb();           // pic_width_in_luma_samples
-  sps_reader.ReadExpGolomb();           // pic_height_in_luma_samples
-  if (sps_reader.ReadBits(1) == 1) {    // conformance_window_flag
-    sps_reader.ReadExpGolomb();         // conf_win_left_offset
-    sps_reader.ReadExpGolomb();         // conf_win_right_offset
-    sps_reader.ReadExpGolomb();         // conf_win_top_offset
-    sps_reader.ReadExpGolomb();         // conf_win_bottom_offset
-  }
-  sps_reader.ReadExpGolomb();  // bit_depth_luma_minus8
-  sps_reader.ReadExpGolomb();  // bit_depth_chroma_minus8
-  sps_reader.ReadExpGolomb();  // log2_max_pic_order_cnt_lsb_minus4
-  const uint64_t sub_layer_ordering_info_present = sps_reader.ReadBits(1);
-  for (uint64_t i =
-           (sub_layer_ordering_info_present ? 0 : max_sub_layers_minus1);
-       i <= max_sub_layers_minus1; i++) {
-    sps_reader.ReadExpGolomb();  // sps_max_dec_pic_buffering_minus1
-    sps_reader.ReadExpGolomb();  // sps_max_num_reorder_pics
-    sps_reader.ReadExpGolomb();  // ps_max_latency_increase_plus1
-  }
-  sps_reader.ReadExpGolomb();  // log2_min_luma_coding_block_size_minus3
-  sps_reader.ReadExpGolomb();  // log2_diff_max_min_luma_coding_block_size
-  sps_reader.ReadExpGolomb();  // log2_min_luma_transform_block_size_minus2
-  sps_reader.ReadExpGolomb();  // log2_diff_max_min_luma_transform_block_size
-  sps_reader.ReadExpGolomb();  // max_transform_hierarchy_depth_inter
-  sps_reader.ReadExpGolomb();  // max_transform_hierarchy_depth_intra
-  if (sps_reader.ReadBits(1) == 1) {  // scaling_list_enabled_flag
-    LOG(WARNING) << "Scaling list isn't supported";
-    return {0, 0};
-  }
-  sps_reader.SkipBits(1);             // amp_enabled_flag
-  sps_reader.SkipBits(1);             // sample_adaptive_offset_enabled_flag
-  if (sps_reader.ReadBits(1) == 1) {  // pcm_enabled_flag
-    sps_reader.ReadBits(4);           // pcm_sample_bit_depth_luma_minus1
-    sps_reader.ReadBits(4);           // pcm_sample_bit_depth_chroma_minus1
-    sps_reader.ReadExpGolomb();  // log2_min_pcm_luma_coding_block_size_minus3
-    sps_reader.ReadExpGolomb();  // log2_diff_max_min_pcm_luma_coding_block_size
-  }
-  const uint64_t num_short_term_ref_pic_sets = sps_reader.ReadExpGolomb();
-  if (num_short_term_ref_pic_sets != 0) {
-    LOG(WARNING) << "Short-term reference pictures not supported";
-    return {0, 0};
-  }
-  if (sps_reader.ReadBits(1) == 1) {  // long_term_ref_pics_present_flag
-    const uint64_t num_long_term_ref_pics_sps = sps_reader.ReadExpGolomb();
-    for (uint64_t i = 0; i < num_long_term_ref_pics_sps; i++) {
-      sps_reader.ReadExpGolomb();  // lt_ref_pic_poc_lsb_sps
-      sps_reader.ReadBits(1);      // used_by_curr_pic_lt_sps_flag
-    }
-  }
-  sps_reader.ReadBits(1);           // sps_temporal_mvp_enabled_flag
-  sps_reader.ReadBits(1);           // strong_intra_smoothing_enabled_flag
-  if (sps_reader.ReadBits(1) != 1)  // vui_parameters_present_flag
-    return {0, 0};  // The info we want isn't there, return unknown.
-  return GetSarFromVuiParameters(&sps_reader);
-}
-
-#endif
-
 }  // namespace
 
 FFmpegDemuxer::FFmpegDemuxer(Demuxer::Client* client,
@@ -394,18 +155,19 @@ FFmpegDemuxer::FFmpegDemuxer(Demuxer::Client* client,
                              const std::string& container)
     : signal_("FFmpegDemuxer"),
       mutex_("FFmpegDemuxer"),
-      mime_type_(mime_type),
       container_(container),
       io_(nullptr),
       demuxer_ctx_(nullptr),
       client_(client),
+      mime_type_(mime_type),
       output_(nullptr),
       timestamp_offset_(0),
       input_(nullptr),
       input_size_(0),
       input_pos_(0),
       state_(State::Waiting),
-      thread_("FFmepgDemuxer", std::bind(&FFmpegDemuxer::ThreadMain, this)) {}
+      thread_("FFmepgDemuxer", std::bind(&FFmpegDemuxer::ThreadMain, this),
+              ThreadRole::Media) {}
 
 FFmpegDemuxer::~FFmpegDemuxer() {
   {
@@ -426,8 +188,22 @@ FFmpegDemuxer::~FFmpegDemuxer() {
   }
 }
 
+bool FFmpegDemuxer::SwitchType(const std::string& mime_type) {
+  std::string container;
+  if (!ParseAndCheckSupport(mime_type, &container) || container != container_)
+    return false;
+
+  // Keep the existing format context and IO buffer; the init segment for the
+  // new type will re-initialize the demuxer using them.
+  std::unique_lock<Mutex> lock(mutex_);
+  mime_type_ = mime_type;
+  return true;
+}
+
 void FFmpegDemuxer::Reset() {
-  // TODO: Add Reset capability.
+  // The format context, stream info, and IO buffer are intentionally kept so
+  // we don't need to re-probe the stream.  If the next segment is a new init
+  // segment, FFmpeg will signal us to re-initialize, which will reuse them.
 }
 
 bool FFmpegDemuxer::Demux(double timestamp_offset, const uint8_t* data,
@@ -550,12 +326,12 @@ void FFmpegDemuxer::ThreadMain() {
       DCHECK_EQ(demuxer_ctx_->nb_streams, 1u);
     }
 
-    auto* frame = ffmpeg::FFmpegEncodedFrame::MakeFrame(&pkt, cur_stream_info_,
-                                                        timestamp_offset_);
+    auto frame = ffmpeg::FFmpegEncodedFrame::MakeFrame(&pkt, cur_stream_info_,
+                                                       timestamp_offset_);
     if (frame) {
       // No need to unref |pkt| since it was moved into the encoded frame.
       DCHECK(output_);
-      output_->emplace_back(frame);
+      output_->emplace_back(std::move(frame));
     } else {
       av_packet_unref(&pkt);
       state_ = State::Errored;
@@ -566,6 +342,13 @@ void FFmpegDemuxer::ThreadMain() {
 }
 
 bool FFmpegDemuxer::ReinitDemuxer() {
+  const uint64_t start = util::Clock::Instance.GetMonotonicTime();
+  std::string mime_type;
+  {
+    std::unique_lock<Mutex> lock(mutex_);
+    mime_type = mime_type_;
+  }
+
   demuxer_ctx_.reset();
   avio_flush(io_);
 
@@ -598,10 +381,41 @@ bool FFmpegDemuxer::ReinitDemuxer() {
   }
 
   demuxer_ctx_.reset(demuxer);
-  const int find_code = avformat_find_stream_info(demuxer, nullptr);
-  if (find_code < 0) {
-    LOG_ERROR(find_code);
-    return false;
+
+  // Probing the stream requires reading frames, which is expensive.  When the
+  // init segment has the codec we expect from the MIME type (or from the
+  // stream we were just reading), it already contains everything we need.
+  // Otherwise, if we have probed this init segment before, reuse the result.
+  bool can_skip_probe = false;
+  const char* skip_reason = "";
+  std::vector<uint8_t> cache_key;
+  if (demuxer->nb_streams == 1) {
+    AVCodecParameters* params = demuxer->streams[0]->codecpar;
+    std::string expected_codec = GetCodecHint(mime_type);
+    if (expected_codec.empty() && cur_stream_info_)
+      expected_codec = cur_stream_info_->codec;
+
+    if (CanSkipProbe(expected_codec, params)) {
+      can_skip_probe = true;
+      skip_reason = "codec hint";
+    } else {
+      cache_key = GetProbeCacheKey(mime_type, params);
+      if (FFmpegProbeCache::Instance()->Get(cache_key, params)) {
+        can_skip_probe = true;
+        skip_reason = "cached";
+      }
+    }
+  }
+  if (!can_skip_probe) {
+    const int find_code = avformat_find_stream_info(demuxer, nullptr);
+    if (find_code < 0) {
+      LOG_ERROR(find_code);
+      return false;
+    }
+    if (!cache_key.empty() && demuxer->nb_streams == 1) {
+      FFmpegProbeCache::Instance()->Add(cache_key,
+                                        demuxer->streams[0]->codecpar);
+    }
   }
 
   if (demuxer_ctx_->nb_streams == 0) {
@@ -615,13 +429,16 @@ bool FFmpegDemuxer::ReinitDemuxer() {
 
   AVStream* stream = demuxer_ctx_->streams[0];
   AVCodecParameters* params = stream->codecpar;
-  const std::string expected_codec = GetCodec(mime_type_, params->codec_id);
+  const std::string expected_codec = GetCodec(mime_type, params->codec_id);
 
   const char* actual_codec = avcodec_get_name(params->codec_id);
   if (NormalizeCodec(expected_codec) != actual_codec) {
     LOG(ERROR) << "Mismatch between codec string and media.  Codec string: '"
                << expected_codec << "', media codec: '" << actual_codec
                << "' (0x" << std::hex << params->codec_id << ")";
+    // Don't reuse parameters that can't be played.
+    if (!cache_key.empty())
+      FFmpegProbeCache::Instance()->Remove(cache_key);
     return false;
   }
 
@@ -644,13 +461,57 @@ bool FFmpegDemuxer::ReinitDemuxer() {
   }
 #endif
 
+  HdrMetadata hdr_metadata;
+  if (params->codec_type == AVMEDIA_TYPE_VIDEO) {
+    ReadColorInfo(params->color_primaries, params->color_trc,
+                  params->color_space, params->color_range, &hdr_metadata);
+    int size;
+    const uint8_t* side_data = av_stream_get_side_data(
+        stream, AV_PKT_DATA_MASTERING_DISPLAY_METADATA, &size);
+    if (side_data &&
+        size >= static_cast<int>(sizeof(AVMasteringDisplayMetadata))) {
+      ReadMasteringDisplay(
+          *reinterpret_cast<const AVMasteringDisplayMetadata*>(side_data),
+          &hdr_metadata);
+    }
+    side_data = av_stream_get_side_data(
+        stream, AV_PKT_DATA_CONTENT_LIGHT_LEVEL, &size);
+    if (side_data &&
+        size >= static_cast<int>(sizeof(AVContentLightMetadata))) {
+      ReadContentLightLevel(
+          *reinterpret_cast<const AVContentLightMetadata*>(side_data),
+          &hdr_metadata);
+    }
+  }
+
   cur_stream_info_.reset(new StreamInfo(
-      mime_type_, expected_codec, params->codec_type == AVMEDIA_TYPE_VIDEO,
+      mime_type, expected_codec, params->codec_type == AVMEDIA_TYPE_VIDEO,
       {stream->time_base.num, stream->time_base.den}, sar, extra_data,
-      params->width, params->height, params->channels, params->sample_rate));
+      params->width, params->height, params->channels, params->sample_rate,
+      hdr_metadata));
+  VLOG(1) << "Initialized demuxer in "
+          << (util::Clock::Instance.GetMonotonicTime() - start) << "ms"
+          << (can_skip_probe ? " (without probing, " : "") << skip_reason
+          << (can_skip_probe ? ")" : "");
   return true;
 }
 
+std::vector<uint8_t> FFmpegDemuxer::GetProbeCacheKey(
+    const std::string& mime_type, const AVCodecParameters* params) {
+  // The key is a hash of the input FFmpeg has read so far, which contains the
+  // init segment, along with the MIME type and what FFmpeg parsed from it.
+  std::vector<uint8_t> data{mime_type.begin(), mime_type.end()};
+  data.push_back(0);
+  data.insert(data.end(), params->extradata,
+              params->extradata + params->extradata_size);
+  {
+    std::unique_lock<Mutex> lock(mutex_);
+    if (input_)
+      data.insert(data.end(), input_, input_ + input_pos_);
+  }
+  return util::HashData(data.data(), data.size());
+}
+
 void FFmpegDemuxer::UpdateEncryptionInfo() {
   if (!client_)
     return;
@@ -706,6 +567,15 @@ bool FFmpegDemuxerFactory::IsCodecVideo(const std::string& codec) const {
   return norm == "h264" || norm == "hevc" || norm == "vp8" || norm == "vp9";
 }
 
+bool FFmpegDemuxerFactory::CanSwitchType(
+    const std::string& old_mime_type, const std::string& new_mime_type) const {
+  std::string old_container;
+  std::string new_container;
+  return ParseAndCheckSupport(old_mime_type, &old_container) &&
+         ParseAndCheckSupport(new_mime_type, &new_container) &&
+         old_container == new_container;
+}
+
 std::unique_ptr<Demuxer> FFmpegDemuxerFactory::Create(
     const std::string& mime_type, Demuxer::Client* client) const {
   std::string container;
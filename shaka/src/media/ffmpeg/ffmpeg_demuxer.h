@@ -43,6 +43,7 @@ class FFmpegDemuxer : public Demuxer {
                 const std::string& container);
   ~FFmpegDemuxer() override;
 
+  bool SwitchType(const std::string& mime_type) override;
   void Reset() override;
 
   bool Demux(double timestamp_offset, const uint8_t* data, size_t size,
@@ -72,13 +73,23 @@ class FFmpegDemuxer : public Demuxer {
 
   void ThreadMain();
 
+  /**
+   * Creates a new format context to read a new init segment.  This avoids
+   * probing the stream when the init segment has the expected codec or when
+   * the same init segment was probed before.
+   */
   bool ReinitDemuxer();
+  /**
+   * Gets the key for the probe cache for the init segment that was just read.
+   * This must be called before any frames are read.
+   */
+  std::vector<uint8_t> GetProbeCacheKey(const std::string& mime_type,
+                                        const AVCodecParameters* params);
   void UpdateEncryptionInfo();
   void OnError();
 
   ThreadEvent<void> signal_;
   Mutex mutex_;
-  const std::string mime_type_;
   const std::string container_;
 
   // These fields can only be used from the background thread and aren't
@@ -89,6 +100,7 @@ class FFmpegDemuxer : public Demuxer {
   Demuxer::Client* client_;
 
   // These fields are protected by the mutex.
+  std::string mime_type_;
   std::vector<std::shared_ptr<EncodedFrame>>* output_;
   double timestamp_offset_;
   const uint8_t* input_;
@@ -104,6 +116,8 @@ class FFmpegDemuxerFactory : public DemuxerFactory {
  public:
   bool IsTypeSupported(const std::string& mime_type) const override;
   bool IsCodecVideo(const std::string& codec) const override;
+  bool CanSwitchType(const std::string& old_mime_type,
+                     const std::string& new_mime_type) const override;
 
   std::unique_ptr<Demuxer> Create(const std::string& mime_type,
                                   Demuxer::Client* client) const override;
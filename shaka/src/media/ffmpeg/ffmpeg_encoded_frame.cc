@@ -23,6 +23,7 @@ extern "C" {
 #include <vector>
 
 #include "shaka/eme/configuration.h"
+#include "src/memory/pool_allocator.h"
 
 namespace shaka {
 namespace media {
@@ -81,7 +82,7 @@ bool MakeEncryptionInfo(const AVPacket* packet,
 }  // namespace
 
 // static
-FFmpegEncodedFrame* FFmpegEncodedFrame::MakeFrame(
+std::shared_ptr<FFmpegEncodedFrame> FFmpegEncodedFrame::MakeFrame(
     AVPacket* pkt, std::shared_ptr<const StreamInfo> info,
     double timestamp_offset) {
   const double factor = info->time_scale;
@@ -93,9 +94,9 @@ FFmpegEncodedFrame* FFmpegEncodedFrame::MakeFrame(
   if (!MakeEncryptionInfo(pkt, &encryption_info))
     return nullptr;
 
-  return new (std::nothrow)
-      FFmpegEncodedFrame(pkt, pts, dts, duration, is_key_frame, info,
-                         encryption_info, timestamp_offset);
+  return memory::MakePooledShared<FFmpegEncodedFrame>(
+      PrivateTag(), pkt, pts, dts, duration, is_key_frame, info,
+      encryption_info, timestamp_offset);
 }
 
 FFmpegEncodedFrame::~FFmpegEncodedFrame() {
@@ -110,8 +111,8 @@ size_t FFmpegEncodedFrame::EstimateSize() const {
 }
 
 FFmpegEncodedFrame::FFmpegEncodedFrame(
-    AVPacket* pkt, double pts, double dts, double duration, bool is_key_frame,
-    std::shared_ptr<const StreamInfo> info,
+    PrivateTag, AVPacket* pkt, double pts, double dts, double duration,
+    bool is_key_frame, std::shared_ptr<const StreamInfo> info,
     std::shared_ptr<eme::FrameEncryptionInfo> encryption_info,
     double timestamp_offset)
     : EncodedFrame(info, pts, dts, duration, is_key_frame, pkt->data, pkt->size,
@@ -29,21 +29,29 @@ namespace ffmpeg {
 
 /** This defines a single encoded media frame. */
 class FFmpegEncodedFrame final : public EncodedFrame {
+ private:
+  struct PrivateTag {};
+
  public:
+  /** Use MakeFrame instead; this is only public for allocate_shared. */
+  FFmpegEncodedFrame(PrivateTag, AVPacket* pkt, double pts, double dts,
+                     double duration, bool is_key_frame,
+                     std::shared_ptr<const StreamInfo> info,
+                     std::shared_ptr<eme::FrameEncryptionInfo> encryption_info,
+                     double timestamp_offset);
   ~FFmpegEncodedFrame() override;
 
-  static FFmpegEncodedFrame* MakeFrame(AVPacket* pkt,
-                                       std::shared_ptr<const StreamInfo> info,
-                                       double timestamp_offset);
+  /**
+   * Creates a new frame that takes ownership of the given packet.  The frame
+   * is allocated from a memory::BlockPool.
+   */
+  static std::shared_ptr<FFmpegEncodedFrame> MakeFrame(
+      AVPacket* pkt, std::shared_ptr<const StreamInfo> info,
+      double timestamp_offset);
 
   size_t EstimateSize() const override;
 
  private:
-  FFmpegEncodedFrame(AVPacket* pkt, double pts, double dts, double duration,
-                     bool is_key_frame, std::shared_ptr<const StreamInfo> info,
-                     std::shared_ptr<eme::FrameEncryptionInfo> encryption_info,
-                     double timestamp_offset);
-
   AVPacket packet_;
 };
 
@@ -0,0 +1,293 @@
+// Copyright 2020 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     https://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "src/media/ffmpeg/ffmpeg_frame_pool.h"
+
+#include <glog/logging.h>
+
+extern "C" {
+#include <libavutil/imgutils.h>
+#include <libavutil/pixdesc.h>
+}
+
+#include <cmath>
+#include <new>
+#include <utility>
+
+#include "src/media/media_buffer.h"
+#include "src/media/media_utils.h"
+
+namespace shaka {
+namespace media {
+namespace ffmpeg {
+
+namespace {
+
+/** The frame rate to assume if the decoder doesn't know it (yet). */
+constexpr const double kDefaultFrameRate = 30;
+
+/**
+ * The number of extra buffers to keep for frames held by the decoder itself
+ * (e.g. reference frames and frames in decoding threads).
+ */
+constexpr const size_t kDecoderFrames = 16;
+
+/**
+ * The number of extra bytes to put at the end of a buffer.  The FFmpeg
+ * allocator adds this too since some decoders can write slightly past the
+ * end of the planes.
+ */
+constexpr const size_t kBufferPadding = 16 + AV_INPUT_BUFFER_PADDING_SIZE;
+
+/**
+ * The number of pixels to align the rows of frames that aren't from a
+ * decoder to, so the conversion functions can use full vectors.
+ */
+constexpr const int kRowAlignment = 32;
+
+}  // namespace
+
+struct FFmpegFramePool::Buffer {
+  // The allocator |data| came from.
+  MediaAllocator* allocator = nullptr;
+  uint8_t* data = nullptr;
+  size_t size = 0;
+  // The pool this is from, set while the buffer is in use.
+  std::shared_ptr<FFmpegFramePool> pool;
+};
+
+FFmpegFramePool::FFmpegFramePool(double window)
+    : mutex_("FFmpegFramePool"),
+      window_(window),
+      max_idle_(kDecoderFrames),
+      buffer_size_(0),
+      budget_consumer_(memory::MemorySubsystem::FramePool, "FFmpegFramePool",
+                       [this]() { return GetStats().idle_bytes; },
+                       [this](size_t) { return EvictIdleBuffers(); }) {}
+
+FFmpegFramePool::~FFmpegFramePool() {
+  // The MemoryBudget can still evict from another thread until the consumer
+  // is destroyed, so this needs to lock.
+  EvictIdleBuffers();
+  for (AVFrame* frame : idle_frames_)
+    av_frame_free(&frame);
+}
+
+int FFmpegFramePool::GetBuffer(AVCodecContext* ctx, AVFrame* frame,
+                               int flags) {
+  const AVPixelFormat format = static_cast<AVPixelFormat>(frame->format);
+  const AVPixFmtDescriptor* desc = av_pix_fmt_desc_get(format);
+  if (ctx->codec_type != AVMEDIA_TYPE_VIDEO ||
+      !(ctx->codec->capabilities & AV_CODEC_CAP_DR1) || ctx->hw_frames_ctx ||
+      !desc || (desc->flags & AV_PIX_FMT_FLAG_HWACCEL)) {
+    return avcodec_default_get_buffer2(ctx, frame, flags);
+  }
+
+  // Use the same layout as the default allocator: align the dimensions for
+  // the codec, then increase the width until every plane is aligned.
+  int width = frame->width;
+  int height = frame->height;
+  int linesize_align[AV_NUM_DATA_POINTERS];
+  avcodec_align_dimensions2(ctx, &width, &height, linesize_align);
+
+  int linesize[4];
+  bool unaligned;
+  do {
+    const int code = av_image_fill_linesizes(linesize, format, width);
+    if (code < 0)
+      return code;
+
+    width += width & ~(width - 1);
+    unaligned = false;
+    for (size_t i = 0; i < 4; i++)
+      unaligned |= linesize[i] % linesize_align[i] != 0;
+  } while (unaligned);
+
+  {
+    std::unique_lock<Mutex> lock(mutex_);
+    const double frame_rate = ctx->framerate.num > 0 && ctx->framerate.den > 0
+                                  ? av_q2d(ctx->framerate)
+                                  : kDefaultFrameRate;
+    max_idle_ = static_cast<size_t>(std::ceil(frame_rate * window_)) +
+                kDecoderFrames;
+  }
+
+  return AllocatePlanes(frame, height, linesize);
+}
+
+int FFmpegFramePool::GetBuffer(AVFrame* frame) {
+  const AVPixelFormat format = static_cast<AVPixelFormat>(frame->format);
+  int linesize[4];
+  const int code = av_image_fill_linesizes(
+      linesize, format, FFALIGN(frame->width, kRowAlignment));
+  if (code < 0)
+    return code;
+  return AllocatePlanes(frame, frame->height, linesize);
+}
+
+int FFmpegFramePool::GetBuffer(AVFrame* frame, int height,
+                               const int* linesize) {
+  return AllocatePlanes(frame, height, linesize);
+}
+
+int FFmpegFramePool::AllocatePlanes(AVFrame* frame, int height,
+                                    const int* linesize) {
+  const AVPixelFormat format = static_cast<AVPixelFormat>(frame->format);
+  uint8_t* planes[4];
+  const int size =
+      av_image_fill_pointers(planes, format, height, nullptr, linesize);
+  if (size < 0)
+    return size;
+
+  // All the planes are stored in a single buffer.
+  AVBufferRef* buffer = AcquireBuffer(size + kBufferPadding);
+  if (!buffer)
+    return AVERROR(ENOMEM);
+  frame->buf[0] = buffer;
+  av_image_fill_pointers(frame->data, format, height, buffer->data, linesize);
+  for (size_t i = 0; i < 4; i++)
+    frame->linesize[i] = linesize[i];
+  frame->extended_data = frame->data;
+  return 0;
+}
+
+AVFrame* FFmpegFramePool::AcquireFrame() {
+  {
+    std::unique_lock<Mutex> lock(mutex_);
+    if (!idle_frames_.empty()) {
+      AVFrame* ret = idle_frames_.back();
+      idle_frames_.pop_back();
+      stats_.frame_reuses++;
+      return ret;
+    }
+    stats_.frame_allocations++;
+  }
+  return av_frame_alloc();
+}
+
+void FFmpegFramePool::ReleaseFrame(AVFrame* frame) {
+  // Unref outside the lock since this may return buffers to the pool.
+  av_frame_unref(frame);
+  std::unique_lock<Mutex> lock(mutex_);
+  if (idle_frames_.size() < max_idle_) {
+    idle_frames_.push_back(frame);
+  } else {
+    lock.unlock();
+    av_frame_free(&frame);
+  }
+}
+
+FFmpegFramePool::Stats FFmpegFramePool::GetStats() const {
+  std::unique_lock<Mutex> lock(mutex_);
+  Stats ret = stats_;
+  ret.idle_buffers = idle_buffers_.size();
+  ret.idle_bytes = idle_buffers_.size() * buffer_size_;
+  return ret;
+}
+
+// static
+void FFmpegFramePool::FreeBufferData(Buffer* buffer) {
+  FreeMedia(buffer->allocator, buffer->data, buffer->size,
+            MediaAllocationCategory::DecodedFrame);
+}
+
+// static
+void FFmpegFramePool::FreeBuffer(void* opaque, uint8_t* /* data */) {
+  auto* buffer = reinterpret_cast<Buffer*>(opaque);
+  // This may be the last reference to the pool, so keep it alive until we
+  // are done with it.
+  std::shared_ptr<FFmpegFramePool> pool = std::move(buffer->pool);
+  pool->ReturnBuffer(buffer);
+}
+
+AVBufferRef* FFmpegFramePool::AcquireBuffer(size_t size) {
+  std::unique_lock<Mutex> lock(mutex_);
+  if (size != buffer_size_) {
+    // The resolution changed, so the old buffers can't be used.
+    FreeIdleBuffers();
+    buffer_size_ = size;
+  }
+
+  Buffer* buffer;
+  if (!idle_buffers_.empty()) {
+    buffer = idle_buffers_.back();
+    idle_buffers_.pop_back();
+    stats_.buffer_reuses++;
+  } else {
+    buffer = new (std::nothrow) Buffer;
+    if (!buffer)
+      return nullptr;
+    buffer->allocator = GetMediaAllocator();
+    buffer->data = reinterpret_cast<uint8_t*>(AllocateMedia(
+        buffer->allocator, size, MediaAllocationCategory::DecodedFrame));
+    if (!buffer->data) {
+      delete buffer;
+      return nullptr;
+    }
+    buffer->size = size;
+    stats_.buffer_allocations++;
+  }
+
+  AVBufferRef* ret =
+      av_buffer_create(buffer->data, static_cast<int>(buffer->size),
+                       &FreeBuffer, buffer, 0);
+  if (!ret) {
+    idle_buffers_.push_back(buffer);
+    return nullptr;
+  }
+  buffer->pool = shared_from_this();
+  return ret;
+}
+
+void FFmpegFramePool::ReturnBuffer(Buffer* buffer) {
+  std::unique_lock<Mutex> lock(mutex_);
+  // Keep fewer unused buffers while the device is low on memory.
+  const size_t max_idle = static_cast<size_t>(
+      max_idle_ * GetMemoryPressureFactor(GetMemoryPressure()));
+  if (buffer->size == buffer_size_ && idle_buffers_.size() < max_idle) {
+    idle_buffers_.push_back(buffer);
+  } else {
+    lock.unlock();
+    FreeBufferData(buffer);
+    delete buffer;
+  }
+}
+
+void FFmpegFramePool::FreeIdleBuffers() {
+  for (Buffer* buffer : idle_buffers_) {
+    FreeBufferData(buffer);
+    delete buffer;
+  }
+  idle_buffers_.clear();
+}
+
+size_t FFmpegFramePool::EvictIdleBuffers() {
+  std::vector<Buffer*> buffers;
+  {
+    std::unique_lock<Mutex> lock(mutex_);
+    buffers.swap(idle_buffers_);
+  }
+
+  size_t ret = 0;
+  for (Buffer* buffer : buffers) {
+    ret += buffer->size;
+    FreeBufferData(buffer);
+    delete buffer;
+  }
+  return ret;
+}
+
+}  // namespace ffmpeg
+}  // namespace media
+}  // namespace shaka
@@ -0,0 +1,144 @@
+// Copyright 2020 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     https://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef SHAKA_EMBEDDED_MEDIA_FFMPEG_FFMPEG_FRAME_POOL_H_
+#define SHAKA_EMBEDDED_MEDIA_FFMPEG_FFMPEG_FRAME_POOL_H_
+
+extern "C" {
+#include <libavcodec/avcodec.h>
+}
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <memory>
+#include <vector>
+
+#include "src/debug/mutex.h"
+#include "src/memory/memory_budget.h"
+#include "src/util/macros.h"
+
+namespace shaka {
+namespace media {
+namespace ffmpeg {
+
+/**
+ * A pool of AVFrame objects and video frame buffers for a single decoder.
+ * This is used as the decoder's get_buffer2 callback so the (large) frame
+ * buffers are reused instead of being reallocated for every decoded frame.
+ *
+ * The pool only keeps enough unused buffers to fill the decode window (based
+ * on the frame rate), plus what the decoder needs for reference frames; any
+ * extra buffers are freed when they are returned.  Fewer buffers are kept
+ * while under memory pressure (see JsManager::SetMemoryPressure).  Buffers
+ * hold a reference to the pool, so decoded frames can outlive the decoder.
+ * The buffers are allocated from the MediaAllocator, and the unused ones are
+ * freed first when over the MemoryBudget.
+ *
+ * This type is thread-safe.
+ */
+class FFmpegFramePool : public std::enable_shared_from_this<FFmpegFramePool> {
+ public:
+  struct Stats {
+    /** The number of frame buffers that were allocated. */
+    uint64_t buffer_allocations = 0;
+    /** The number of frame buffers that were reused from the pool. */
+    uint64_t buffer_reuses = 0;
+    /** The number of AVFrame objects that were allocated. */
+    uint64_t frame_allocations = 0;
+    /** The number of AVFrame objects that were reused from the pool. */
+    uint64_t frame_reuses = 0;
+    /** The number of unused buffers currently in the pool. */
+    uint64_t idle_buffers = 0;
+    /** The number of bytes used by the unused buffers. */
+    uint64_t idle_bytes = 0;
+  };
+
+  /**
+   * @param window The number of seconds of decoded frames that are kept
+   *   alive at once; this is used to limit the number of unused buffers.
+   */
+  explicit FFmpegFramePool(double window);
+  ~FFmpegFramePool();
+
+  SHAKA_NON_COPYABLE_OR_MOVABLE_TYPE(FFmpegFramePool);
+
+  /**
+   * Allocates the buffers for the given frame.  This should be called from
+   * the AVCodecContext::get_buffer2 callback.  This falls back to the default
+   * FFmpeg allocator for audio and hardware frames.
+   */
+  int GetBuffer(AVCodecContext* ctx, AVFrame* frame, int flags);
+
+  /**
+   * Allocates the buffers for a video frame that isn't from a decoder (e.g.
+   * a frame converted to another pixel format), using the format and size
+   * already set on the frame.
+   */
+  int GetBuffer(AVFrame* frame);
+
+  /**
+   * Allocates the buffers for a video frame using the given row sizes and
+   * number of rows, for decoders outside FFmpeg that need a specific layout.
+   * The format and size must already be set on the frame.  The buffer is
+   * aligned to MediaAllocator::kAlignment bytes.
+   */
+  int GetBuffer(AVFrame* frame, int height, const int* linesize);
+
+  /** @return An empty AVFrame object, or nullptr on allocation error. */
+  AVFrame* AcquireFrame();
+  /** Unrefs the given frame and returns it to the pool. */
+  void ReleaseFrame(AVFrame* frame);
+
+  Stats GetStats() const;
+
+ private:
+  struct Buffer;
+
+  static void FreeBufferData(Buffer* buffer);
+  static void FreeBuffer(void* opaque, uint8_t* data);
+
+  /**
+   * Allocates a single buffer for all the planes of the given frame and points
+   * the frame's planes into it.
+   */
+  int AllocatePlanes(AVFrame* frame, int height, const int* linesize);
+  AVBufferRef* AcquireBuffer(size_t size);
+  void ReturnBuffer(Buffer* buffer);
+  void FreeIdleBuffers();
+  /**
+   * Frees all the unused buffers to fit in the MemoryBudget.
+   * @return The number of bytes freed.
+   */
+  size_t EvictIdleBuffers();
+
+  mutable Mutex mutex_;
+  const double window_;
+  size_t max_idle_;
+  // The size of the buffers in |idle_buffers_|; this changes with the
+  // resolution.
+  size_t buffer_size_;
+  std::vector<Buffer*> idle_buffers_;
+  std::vector<AVFrame*> idle_frames_;
+  Stats stats_;
+
+  // This must be last so it is unregistered before the rest is destroyed.
+  memory::MemoryBudget::Consumer budget_consumer_;
+};
+
+}  // namespace ffmpeg
+}  // namespace media
+}  // namespace shaka
+
+#endif  // SHAKA_EMBEDDED_MEDIA_FFMPEG_FFMPEG_FRAME_POOL_H_
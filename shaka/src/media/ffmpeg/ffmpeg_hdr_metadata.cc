@@ -0,0 +1,83 @@
+// Copyright 2020 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     https://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "src/media/ffmpeg/ffmpeg_hdr_metadata.h"
+
+#include <cmath>
+
+namespace shaka {
+namespace media {
+namespace ffmpeg {
+
+namespace {
+
+/** The SMPTE ST 2086 units; chromaticity in 0.00002 and luminance 0.0001. */
+constexpr const double kChromaticityScale = 50000;
+constexpr const double kLuminanceScale = 10000;
+
+template <typename T>
+T ToFixed(AVRational value, double scale) {
+  return static_cast<T>(std::round(av_q2d(value) * scale));
+}
+
+}  // namespace
+
+void ReadColorInfo(AVColorPrimaries primaries,
+                   AVColorTransferCharacteristic transfer, AVColorSpace matrix,
+                   AVColorRange range, HdrMetadata* metadata) {
+  if (primaries != AVCOL_PRI_UNSPECIFIED)
+    metadata->color_primaries = static_cast<uint8_t>(primaries);
+  if (transfer != AVCOL_TRC_UNSPECIFIED)
+    metadata->transfer_characteristics = static_cast<uint8_t>(transfer);
+  if (matrix != AVCOL_SPC_UNSPECIFIED)
+    metadata->matrix_coefficients = static_cast<uint8_t>(matrix);
+  if (range != AVCOL_RANGE_UNSPECIFIED)
+    metadata->full_range = range == AVCOL_RANGE_JPEG;
+}
+
+void ReadMasteringDisplay(const AVMasteringDisplayMetadata& source,
+                          HdrMetadata* metadata) {
+  if (!source.has_primaries || !source.has_luminance)
+    return;
+
+  // FFmpeg stores the primaries in R, G, B order, but ST 2086 uses G, B, R.
+  for (size_t i = 0; i < 3; i++) {
+    const size_t src = (i + 1) % 3;
+    metadata->display_primaries_x[i] = ToFixed<uint16_t>(
+        source.display_primaries[src][0], kChromaticityScale);
+    metadata->display_primaries_y[i] = ToFixed<uint16_t>(
+        source.display_primaries[src][1], kChromaticityScale);
+  }
+  metadata->white_point_x =
+      ToFixed<uint16_t>(source.white_point[0], kChromaticityScale);
+  metadata->white_point_y =
+      ToFixed<uint16_t>(source.white_point[1], kChromaticityScale);
+  metadata->max_display_mastering_luminance =
+      ToFixed<uint32_t>(source.max_luminance, kLuminanceScale);
+  metadata->min_display_mastering_luminance =
+      ToFixed<uint32_t>(source.min_luminance, kLuminanceScale);
+  metadata->has_mastering_display = true;
+}
+
+void ReadContentLightLevel(const AVContentLightMetadata& source,
+                           HdrMetadata* metadata) {
+  metadata->max_content_light_level = static_cast<uint16_t>(source.MaxCLL);
+  metadata->max_frame_average_light_level =
+      static_cast<uint16_t>(source.MaxFALL);
+  metadata->has_content_light_level = true;
+}
+
+}  // namespace ffmpeg
+}  // namespace media
+}  // namespace shaka
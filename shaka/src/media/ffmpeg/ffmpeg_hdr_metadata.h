@@ -0,0 +1,50 @@
+// Copyright 2020 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     https://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef SHAKA_EMBEDDED_MEDIA_FFMPEG_FFMPEG_HDR_METADATA_H_
+#define SHAKA_EMBEDDED_MEDIA_FFMPEG_FFMPEG_HDR_METADATA_H_
+
+extern "C" {
+#include <libavutil/mastering_display_metadata.h>
+#include <libavutil/pixfmt.h>
+}
+
+#include "shaka/media/stream_info.h"
+
+namespace shaka {
+namespace media {
+namespace ffmpeg {
+
+/**
+ * Copies the given FFmpeg color fields into the metadata.  FFmpeg's enums use
+ * the H.273 code points, so these are copied as-is; unspecified fields leave
+ * the existing values alone.
+ */
+void ReadColorInfo(AVColorPrimaries primaries,
+                   AVColorTransferCharacteristic transfer, AVColorSpace matrix,
+                   AVColorRange range, HdrMetadata* metadata);
+
+/** Copies the given FFmpeg mastering display metadata, if it is set. */
+void ReadMasteringDisplay(const AVMasteringDisplayMetadata& source,
+                          HdrMetadata* metadata);
+
+/** Copies the given FFmpeg content light level metadata. */
+void ReadContentLightLevel(const AVContentLightMetadata& source,
+                           HdrMetadata* metadata);
+
+}  // namespace ffmpeg
+}  // namespace media
+}  // namespace shaka
+
+#endif  // SHAKA_EMBEDDED_MEDIA_FFMPEG_FFMPEG_HDR_METADATA_H_
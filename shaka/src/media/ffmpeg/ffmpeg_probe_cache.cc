@@ -0,0 +1,83 @@
+// Copyright 2020 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     https://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "src/media/ffmpeg/ffmpeg_probe_cache.h"
+
+namespace shaka {
+namespace media {
+namespace ffmpeg {
+
+namespace {
+
+/** The maximum number of init segments to store probed stream info for. */
+constexpr const size_t kMaxProbeCacheSize = 32;
+
+}  // namespace
+
+FFmpegProbeCache::FFmpegProbeCache(size_t max_size) : max_size_(max_size) {}
+
+FFmpegProbeCache::~FFmpegProbeCache() {}
+
+// static
+FFmpegProbeCache* FFmpegProbeCache::Instance() {
+  static FFmpegProbeCache instance(kMaxProbeCacheSize);
+  return &instance;
+}
+
+bool FFmpegProbeCache::Get(const std::vector<uint8_t>& key,
+                           AVCodecParameters* params) {
+  std::unique_lock<std::mutex> lock(mutex_);
+  for (auto it = entries_.begin(); it != entries_.end(); it++) {
+    if (it->first == key) {
+      if (avcodec_parameters_copy(params, it->second.get()) < 0)
+        return false;
+      // Move the entry to the front so it is evicted last.
+      entries_.splice(entries_.begin(), entries_, it);
+      return true;
+    }
+  }
+  return false;
+}
+
+void FFmpegProbeCache::Add(const std::vector<uint8_t>& key,
+                           const AVCodecParameters* params) {
+  Params copy(avcodec_parameters_alloc());
+  if (!copy || avcodec_parameters_copy(copy.get(), params) < 0)
+    return;
+
+  std::unique_lock<std::mutex> lock(mutex_);
+  for (auto it = entries_.begin(); it != entries_.end(); it++) {
+    if (it->first == key) {
+      entries_.erase(it);
+      break;
+    }
+  }
+  entries_.emplace_front(key, std::move(copy));
+  while (entries_.size() > max_size_)
+    entries_.pop_back();
+}
+
+void FFmpegProbeCache::Remove(const std::vector<uint8_t>& key) {
+  std::unique_lock<std::mutex> lock(mutex_);
+  for (auto it = entries_.begin(); it != entries_.end(); it++) {
+    if (it->first == key) {
+      entries_.erase(it);
+      return;
+    }
+  }
+}
+
+}  // namespace ffmpeg
+}  // namespace media
+}  // namespace shaka
@@ -0,0 +1,94 @@
+// Copyright 2020 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     https://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef SHAKA_EMBEDDED_MEDIA_FFMPEG_FFMPEG_PROBE_CACHE_H_
+#define SHAKA_EMBEDDED_MEDIA_FFMPEG_FFMPEG_PROBE_CACHE_H_
+
+extern "C" {
+#include <libavcodec/avcodec.h>
+}
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <list>
+#include <memory>
+#include <mutex>
+#include <utility>
+#include <vector>
+
+#include "src/util/macros.h"
+
+namespace shaka {
+namespace media {
+namespace ffmpeg {
+
+/**
+ * Stores the codec parameters that were found by probing an init segment.
+ * When switching back to a variant we have already seen (e.g. for ABR), the
+ * init segment is the same, so we can reuse the parameters instead of probing
+ * the stream again.  The instance is shared between all the demuxers so new
+ * SourceBuffers also benefit from it.
+ *
+ * The least recently used entry is evicted once there are more than
+ * |max_size| entries.
+ *
+ * This type is thread-safe.
+ */
+class FFmpegProbeCache final {
+ public:
+  explicit FFmpegProbeCache(size_t max_size);
+  ~FFmpegProbeCache();
+
+  SHAKA_NON_COPYABLE_OR_MOVABLE_TYPE(FFmpegProbeCache);
+
+  /** @return The instance used by the demuxers. */
+  static FFmpegProbeCache* Instance();
+
+  /**
+   * Copies the cached parameters for the given key into |params|.
+   * @return True if there was a cached entry, false otherwise.
+   */
+  bool Get(const std::vector<uint8_t>& key, AVCodecParameters* params);
+
+  /** Stores a copy of the given parameters, replacing any existing entry. */
+  void Add(const std::vector<uint8_t>& key, const AVCodecParameters* params);
+
+  /**
+   * Removes the entry for the given key, if any.  This is used when the
+   * cached parameters turn out to be unusable.
+   */
+  void Remove(const std::vector<uint8_t>& key);
+
+ private:
+  struct FreeParams {
+    void operator()(AVCodecParameters* params) {
+      avcodec_parameters_free(&params);
+    }
+  };
+  using Params = std::unique_ptr<AVCodecParameters, FreeParams>;
+
+  // This uses a plain mutex since this can be used during static destruction.
+  std::mutex mutex_;
+  const size_t max_size_;
+  // The entries, ordered from most to least recently used.  This is small, so
+  // a linear search is fine.
+  std::list<std::pair<std::vector<uint8_t>, Params>> entries_;
+};
+
+}  // namespace ffmpeg
+}  // namespace media
+}  // namespace shaka
+
+#endif  // SHAKA_EMBEDDED_MEDIA_FFMPEG_FFMPEG_PROBE_CACHE_H_
@@ -0,0 +1,176 @@
+// Copyright 2020 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     https://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "shaka/media/frame_snapshot.h"
+
+#include <glog/logging.h>
+
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <utility>
+
+#include "shaka/media/stream_info.h"
+#include "src/debug/thread.h"
+#include "src/debug/trace_event.h"
+#include "src/media/pixel_conversion.h"
+
+namespace shaka {
+namespace media {
+
+namespace {
+
+/** Converts the 16-bit planes of a 10-bit frame to 8-bit and converts that. */
+void Convert10BitToRgba(const DecodedFrame& frame, bool interleaved_uv,
+                        const YuvToRgbMatrix& matrix, FrameSnapshot* result) {
+  const size_t width = result->width;
+  const size_t height = result->height;
+  const size_t uv_width = (width + 1) / 2;
+  const size_t uv_height = (height + 1) / 2;
+  // YUV420P10 has the data in the low bits and P010 in the high bits.
+  const unsigned int shift = interleaved_uv ? 8 : 2;
+
+  std::vector<uint8_t> y(width * height);
+  ConvertPlane16To8(frame.data[0], frame.linesize[0], y.data(), width, width,
+                    height, shift);
+  if (interleaved_uv) {
+    std::vector<uint8_t> uv(uv_width * 2 * uv_height);
+    ConvertPlane16To8(frame.data[1], frame.linesize[1], uv.data(),
+                      uv_width * 2, uv_width * 2, uv_height, shift);
+    ConvertYuv420ToRgba(y.data(), width, uv.data(), uv.data() + 1,
+                        uv_width * 2, true, matrix, result->pixels.data(),
+                        width * 4, width, height);
+  } else {
+    std::vector<uint8_t> u(uv_width * uv_height);
+    std::vector<uint8_t> v(uv_width * uv_height);
+    ConvertPlane16To8(frame.data[1], frame.linesize[1], u.data(), uv_width,
+                      uv_width, uv_height, shift);
+    ConvertPlane16To8(frame.data[2], frame.linesize[2], v.data(), uv_width,
+                      uv_width, uv_height, shift);
+    ConvertYuv420ToRgba(y.data(), width, u.data(), v.data(), uv_width, false,
+                        matrix, result->pixels.data(), width * 4, width,
+                        height);
+  }
+}
+
+/**
+ * Runs the snapshot conversions in order on a background thread.  The thread
+ * is started when the first snapshot is taken.
+ */
+class SnapshotQueue {
+ public:
+  SnapshotQueue()
+      : thread_("FrameSnapshot", std::bind(&SnapshotQueue::ThreadMain, this),
+                ThreadRole::Background) {
+  }
+
+  void Add(std::shared_ptr<DecodedFrame> frame, SnapshotCallback callback) {
+    std::unique_lock<std::mutex> lock(mutex_);
+    jobs_.emplace_back(std::move(frame), std::move(callback));
+    cond_.notify_all();
+  }
+
+ private:
+  void ThreadMain() {
+    std::unique_lock<std::mutex> lock(mutex_);
+    while (true) {
+      while (jobs_.empty())
+        cond_.wait(lock);
+      auto job = std::move(jobs_.front());
+      jobs_.pop_front();
+
+      lock.unlock();
+      std::shared_ptr<FrameSnapshot> result;
+      if (job.first)
+        result = ConvertFrameToRgba(*job.first);
+      // Release the frame before calling back so the decoder can reuse it.
+      job.first.reset();
+      job.second(result);
+      lock.lock();
+    }
+  }
+
+  std::mutex mutex_;
+  std::condition_variable cond_;
+  std::deque<std::pair<std::shared_ptr<DecodedFrame>, SnapshotCallback>> jobs_;
+
+  // Should be last so the thread starts after all the fields are initialized.
+  Thread thread_;
+};
+
+}  // namespace
+
+FrameSnapshot::FrameSnapshot(double pts, uint32_t width, uint32_t height)
+    : pts(pts), width(width), height(height), pixels(width * height * 4) {}
+FrameSnapshot::~FrameSnapshot() {}
+
+std::shared_ptr<FrameSnapshot> ConvertFrameToRgba(const DecodedFrame& frame) {
+  TRACE_EVENT("media", "ConvertFrameToRgba");
+  if (!holds_alternative<PixelFormat>(frame.format))
+    return nullptr;
+
+  const PixelFormat format = get<PixelFormat>(frame.format);
+  const uint32_t width = frame.stream_info->width;
+  const uint32_t height = frame.stream_info->height;
+  const HdrMetadata metadata = frame.GetHdrMetadata();
+  const YuvToRgbMatrix matrix =
+      GetYuvToRgbMatrix(metadata.matrix_coefficients, metadata.full_range);
+
+  std::shared_ptr<FrameSnapshot> ret(
+      new FrameSnapshot(frame.pts, width, height));
+  switch (format) {
+    case PixelFormat::YUV420P:
+      ConvertYuv420ToRgba(frame.data[0], frame.linesize[0], frame.data[1],
+                          frame.data[2], frame.linesize[1], false, matrix,
+                          ret->pixels.data(), width * 4, width, height);
+      break;
+    case PixelFormat::NV12:
+      ConvertYuv420ToRgba(frame.data[0], frame.linesize[0], frame.data[1],
+                          frame.data[1] + 1, frame.linesize[1], true, matrix,
+                          ret->pixels.data(), width * 4, width, height);
+      break;
+    case PixelFormat::YUV420P10:
+      Convert10BitToRgba(frame, false, matrix, ret.get());
+      break;
+    case PixelFormat::P010:
+      Convert10BitToRgba(frame, true, matrix, ret.get());
+      break;
+    case PixelFormat::RGB24:
+      for (uint32_t row = 0; row < height; row++) {
+        const uint8_t* src = frame.data[0] + frame.linesize[0] * row;
+        uint8_t* dest = ret->pixels.data() + width * 4 * row;
+        for (uint32_t i = 0; i < width; i++) {
+          dest[i * 4] = src[i * 3];
+          dest[i * 4 + 1] = src[i * 3 + 1];
+          dest[i * 4 + 2] = src[i * 3 + 2];
+          dest[i * 4 + 3] = 255;
+        }
+      }
+      break;
+    default:
+      LOG(ERROR) << "Unsupported pixel format for snapshots: " << format;
+      return nullptr;
+  }
+  return ret;
+}
+
+void TakeFrameSnapshot(std::shared_ptr<DecodedFrame> frame,
+                       SnapshotCallback callback) {
+  // This is never destroyed since the thread never exits.
+  static SnapshotQueue* queue = new SnapshotQueue;
+  queue->Add(std::move(frame), std::move(callback));
+}
+
+}  // namespace media
+}  // namespace shaka
@@ -16,6 +16,9 @@
 
 #include <glog/logging.h>
 
+#include "src/debug/trace_event.h"
+#include "src/media/segment_encoded_frame.h"
+
 namespace shaka {
 namespace media {
 
@@ -28,6 +31,9 @@ std::ostream& operator<<(std::ostream& os, PixelFormat format) {
     CASE(NV12);
     CASE(RGB24);
     CASE(VideoToolbox);
+    CASE(YUV420P10);
+    CASE(P010);
+    CASE(SecureSurface);
 #undef CASE
 
     default:
@@ -55,6 +61,7 @@ std::ostream& operator<<(std::ostream& os, SampleFormat format) {
     CASE(PlanarS64);
     CASE(PlanarFloat);
     CASE(PlanarDouble);
+    CASE(Iec61937);
 #undef CASE
 
     default:
@@ -70,6 +77,8 @@ bool IsPlanarFormat(variant<PixelFormat, SampleFormat> format) {
     switch (get<PixelFormat>(format)) {
       case PixelFormat::YUV420P:
       case PixelFormat::NV12:
+      case PixelFormat::YUV420P10:
+      case PixelFormat::P010:
         return true;
       default:
         return false;
@@ -94,11 +103,14 @@ size_t GetPlaneCount(variant<PixelFormat, SampleFormat> format,
   if (holds_alternative<PixelFormat>(format)) {
     switch (get<PixelFormat>(format)) {
       case PixelFormat::YUV420P:
+      case PixelFormat::YUV420P10:
         return 3;
       case PixelFormat::NV12:
+      case PixelFormat::P010:
         return 2;
       case PixelFormat::RGB24:
       case PixelFormat::VideoToolbox:
+      case PixelFormat::SecureSurface:
         return 1;
 
       default:
@@ -126,8 +138,6 @@ size_t BaseFrame::EstimateSize() const {
 }
 
 
-class EncodedFrame::Impl {};
-
 EncodedFrame::EncodedFrame(
     std::shared_ptr<const StreamInfo> stream, double pts, double dts,
     double duration, bool is_key_frame, const uint8_t* data, size_t data_size,
@@ -147,6 +157,8 @@ MediaStatus EncodedFrame::Decrypt(const eme::Implementation* implementation,
   if (!implementation)
     return MediaStatus::FatalError;
 
+  TRACE_EVENT("media", "Decrypt");
+  TRACE_FRAME_STEP(this);
   const eme::DecryptStatus decrypt_status =
       implementation->Decrypt(encryption_info.get(), data, data_size, dest);
   switch (decrypt_status) {
@@ -182,6 +194,10 @@ DecodedFrame::DecodedFrame(std::shared_ptr<const StreamInfo> stream, double pts,
       format(format) {}
 DecodedFrame::~DecodedFrame() {}
 
+HdrMetadata DecodedFrame::GetHdrMetadata() const {
+  return stream_info ? stream_info->hdr_metadata : HdrMetadata();
+}
+
 size_t DecodedFrame::EstimateSize() const {
   // BaseFrame::EstimateSize includes sizeof(BaseFrame) and so does
   // sizeof(this), so we need to remove the extra.
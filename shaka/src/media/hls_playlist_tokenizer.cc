@@ -0,0 +1,273 @@
+// Copyright 2020 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     https://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "src/media/hls_playlist_tokenizer.h"
+
+#include <string.h>
+
+#include <unordered_map>
+
+#include "src/util/utf8.h"
+
+namespace shaka {
+namespace media {
+
+namespace {
+
+constexpr const char kHeader[] = "#EXTM3U";
+constexpr const uint8_t kByteOrderMark[] = {0xef, 0xbb, 0xbf};
+
+bool IsWhitespace(uint8_t c) {
+  return c == ' ' || c == '\t' || c == '\r';
+}
+
+/** @return Whether |c| can appear in an attribute name. */
+bool IsAttributeNameChar(uint8_t c) {
+  return (c >= 'A' && c <= 'Z') || (c >= '0' && c <= '9') || c == '-';
+}
+
+uint64_t HashLine(const uint8_t* data, size_t size) {
+  // FNV-1a.
+  uint64_t ret = 0xcbf29ce484222325ULL;
+  for (size_t i = 0; i < size; i++) {
+    ret ^= data[i];
+    ret *= 0x100000001b3ULL;
+  }
+  return ret;
+}
+
+/** @return The number of UTF-16 code units the given UTF-8 text decodes to. */
+size_t Utf16Length(const uint8_t* data, size_t size) {
+  const size_t ascii = util::AsciiPrefixLength(data, size);
+  size_t ret = ascii;
+  for (size_t i = ascii; i < size; i++) {
+    // Count the lead bytes; characters outside the BMP are surrogate pairs.
+    if ((data[i] & 0xc0) != 0x80)
+      ret += data[i] >= 0xf0 ? 2 : 1;
+  }
+  return ret;
+}
+
+/** Converts byte offsets in a line into UTF-16 offsets in the playlist. */
+class OffsetMapper {
+ public:
+  OffsetMapper(const uint8_t* line, size_t size, size_t line_offset)
+      : line_(line),
+        line_offset_(line_offset),
+        ascii_(util::IsAscii(line, size)) {}
+
+  uint32_t Map(size_t pos) const {
+    const size_t ret =
+        line_offset_ + (ascii_ ? pos : Utf16Length(line_, pos));
+    return static_cast<uint32_t>(ret);
+  }
+
+ private:
+  const uint8_t* const line_;
+  const size_t line_offset_;
+  const bool ascii_;
+};
+
+/**
+ * Parses the attribute list in the given tag value, e.g.
+ * 'METHOD=AES-128,URI="key.bin"'.  Values that aren't attribute lists (e.g.
+ * the EXTINF duration) don't produce any attributes.
+ */
+void ParseAttributes(const uint8_t* line, size_t start, size_t end,
+                     const OffsetMapper& mapper,
+                     std::vector<uint32_t>* attributes) {
+  size_t pos = start;
+  while (pos < end) {
+    const size_t key_start = pos;
+    while (pos < end && IsAttributeNameChar(line[pos]))
+      pos++;
+    if (pos == key_start || pos == end || line[pos] != '=')
+      return;
+    const size_t key_end = pos++;
+
+    size_t value_start = pos;
+    size_t value_end;
+    if (pos < end && line[pos] == '"') {
+      value_start = ++pos;
+      const void* quote = memchr(line + pos, '"', end - pos);
+      if (!quote)
+        return;
+      value_end = static_cast<const uint8_t*>(quote) - line;
+      pos = value_end + 1;
+    } else {
+      while (pos < end && line[pos] != ',')
+        pos++;
+      value_end = pos;
+    }
+
+    attributes->emplace_back(mapper.Map(key_start));
+    attributes->emplace_back(mapper.Map(key_end));
+    attributes->emplace_back(mapper.Map(value_start));
+    attributes->emplace_back(mapper.Map(value_end));
+
+    if (pos < end && line[pos] != ',')
+      return;
+    pos++;
+  }
+}
+
+}  // namespace
+
+HlsTokenTable::HlsTokenTable()
+    : match_start(0), match_end(0), match_offset(0) {}
+HlsTokenTable::~HlsTokenTable() {}
+
+
+HlsPlaylistTokenizer::HlsPlaylistTokenizer() {}
+HlsPlaylistTokenizer::~HlsPlaylistTokenizer() {}
+
+bool HlsPlaylistTokenizer::Tokenize(const uint8_t* data, size_t size,
+                                    HlsTokenTable* table, std::string* error) {
+  table->lines.clear();
+  table->attributes.clear();
+  table->match_start = table->match_end = 0;
+  table->match_offset = 0;
+
+  size_t pos = 0;
+  size_t units = 0;
+  if (size >= sizeof(kByteOrderMark) &&
+      memcmp(data, kByteOrderMark, sizeof(kByteOrderMark)) == 0) {
+    pos = sizeof(kByteOrderMark);
+    units = 1;
+  }
+  const size_t header_size = strlen(kHeader);
+  if (size - pos < header_size ||
+      memcmp(data + pos, kHeader, header_size) != 0) {
+    *error = "Playlist doesn't start with #EXTM3U";
+    return false;
+  }
+
+  std::vector<LineInfo> lines;
+  while (pos < size) {
+    // memchr is vectorized by the C library, so long lines are scanned many
+    // bytes at a time.
+    const void* newline = memchr(data + pos, '\n', size - pos);
+    const size_t next = newline
+                            ? static_cast<const uint8_t*>(newline) - data + 1
+                            : size;
+    const uint8_t* line = data + pos;
+    size_t line_size = next - pos - (newline ? 1 : 0);
+    while (line_size > 0 && IsWhitespace(line[line_size - 1]))
+      line_size--;
+
+    const bool is_tag = line_size >= 4 && memcmp(line, "#EXT", 4) == 0;
+    const bool is_uri = line_size > 0 && line[0] != '#';
+    if (is_tag || is_uri) {
+      const OffsetMapper mapper(line, line_size, units);
+      size_t name_end = line_size;
+      size_t value_start = 0;
+      const size_t first_attribute =
+          table->attributes.size() / HlsTokenTable::kAttrFieldCount;
+      if (is_tag) {
+        const void* colon = memchr(line, ':', line_size);
+        if (colon) {
+          name_end = static_cast<const uint8_t*>(colon) - line;
+          value_start = name_end + 1;
+          ParseAttributes(line, value_start, line_size, mapper,
+                          &table->attributes);
+        } else {
+          value_start = line_size;
+        }
+      }
+
+      const size_t attribute_count =
+          table->attributes.size() / HlsTokenTable::kAttrFieldCount -
+          first_attribute;
+      table->lines.emplace_back(
+          static_cast<uint32_t>(is_uri ? HlsLineKind::Uri : HlsLineKind::Tag));
+      table->lines.emplace_back(mapper.Map(0));
+      table->lines.emplace_back(mapper.Map(name_end));
+      table->lines.emplace_back(mapper.Map(value_start));
+      table->lines.emplace_back(mapper.Map(line_size));
+      table->lines.emplace_back(static_cast<uint32_t>(first_attribute));
+      table->lines.emplace_back(static_cast<uint32_t>(attribute_count));
+      lines.push_back({pos, line_size, HashLine(line, line_size), is_uri});
+    }
+
+    units += Utf16Length(data + pos, next - pos);
+    pos = next;
+  }
+
+  FindMatch(data, lines, table);
+  previous_.assign(data, data + size);
+  previous_lines_ = std::move(lines);
+  return true;
+}
+
+void HlsPlaylistTokenizer::Reset() {
+  previous_.clear();
+  previous_lines_.clear();
+}
+
+void HlsPlaylistTokenizer::FindMatch(const uint8_t* data,
+                                     const std::vector<LineInfo>& lines,
+                                     HlsTokenTable* table) const {
+  auto equal = [&](size_t index, size_t previous_index) {
+    const LineInfo& line = lines[index];
+    const LineInfo& previous = previous_lines_[previous_index];
+    return line.hash == previous.hash && line.size == previous.size &&
+           memcmp(data + line.start, previous_.data() + previous.start,
+                  line.size) == 0;
+  };
+
+  // Segment URIs are (almost always) unique, so use the first URI that was
+  // in the previous playlist to line up the two playlists.
+  std::unordered_map<uint64_t, size_t> previous_uris;
+  for (size_t i = 0; i < previous_lines_.size(); i++) {
+    if (previous_lines_[i].is_uri)
+      previous_uris.emplace(previous_lines_[i].hash, i);
+  }
+  if (previous_uris.empty())
+    return;
+
+  for (size_t i = 0; i < lines.size(); i++) {
+    if (!lines[i].is_uri)
+      continue;
+    auto it = previous_uris.find(lines[i].hash);
+    if (it == previous_uris.end() || !equal(i, it->second))
+      continue;
+
+    // Extend the match in both directions to include the tags of the
+    // segments and any other segments that are the same.
+    const size_t previous_index = it->second;
+    size_t start = i;
+    size_t previous_start = previous_index;
+    while (start > 0 && previous_start > 0 &&
+           equal(start - 1, previous_start - 1)) {
+      start--;
+      previous_start--;
+    }
+    size_t end = i + 1;
+    size_t previous_end = previous_index + 1;
+    while (end < lines.size() && previous_end < previous_lines_.size() &&
+           equal(end, previous_end)) {
+      end++;
+      previous_end++;
+    }
+
+    table->match_start = static_cast<uint32_t>(start);
+    table->match_end = static_cast<uint32_t>(end);
+    table->match_offset = static_cast<int32_t>(previous_start) -
+                          static_cast<int32_t>(start);
+    return;
+  }
+}
+
+}  // namespace media
+}  // namespace shaka
@@ -0,0 +1,144 @@
+// Copyright 2020 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     https://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef SHAKA_EMBEDDED_MEDIA_HLS_PLAYLIST_TOKENIZER_H_
+#define SHAKA_EMBEDDED_MEDIA_HLS_PLAYLIST_TOKENIZER_H_
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <string>
+#include <vector>
+
+namespace shaka {
+namespace media {
+
+/** The kinds of lines in an HLS playlist. */
+enum class HlsLineKind : uint32_t {
+  /** A tag, e.g. "#EXTINF:6.0,". */
+  Tag = 0,
+  /** The URI of a segment or playlist. */
+  Uri = 1,
+};
+
+/**
+ * Holds the lines of a tokenized HLS playlist.  This is stored as flat arrays
+ * so it can be given to JavaScript as typed arrays.  All positions are in
+ * UTF-16 code units into the playlist text, so JavaScript can pass them to
+ * String.prototype.substring on the decoded text.
+ */
+struct HlsTokenTable {
+  /** The fields of each line in |lines|. */
+  enum LineField {
+    /** The HlsLineKind of the line. */
+    kLineKind,
+    /** The start of the line. */
+    kLineStart,
+    /** The end of the tag name (e.g. "#EXTINF"); the end for URIs. */
+    kLineNameEnd,
+    /** The start of the tag value (after the ':'); the start for URIs. */
+    kLineValueStart,
+    /** The end of the line, not including trailing whitespace. */
+    kLineEnd,
+    /** The index of the line's first attribute in |attributes|. */
+    kLineFirstAttribute,
+    /** The number of attributes the tag has. */
+    kLineAttributeCount,
+    kLineFieldCount,
+  };
+
+  /** The fields of each attribute in |attributes|. */
+  enum AttributeField {
+    kAttrKeyStart,
+    kAttrKeyEnd,
+    /** The value, which doesn't include the quotes of quoted strings. */
+    kAttrValueStart,
+    kAttrValueEnd,
+    kAttrFieldCount,
+  };
+
+  HlsTokenTable();
+  ~HlsTokenTable();
+
+  /** The number of lines in the table. */
+  size_t line_count() const {
+    return lines.size() / kLineFieldCount;
+  }
+
+  /** The tags and URIs, kLineFieldCount values each.  Comments are skipped. */
+  std::vector<uint32_t> lines;
+  /**
+   * The attributes of tags that have an attribute list (e.g. EXT-X-KEY),
+   * kAttrFieldCount values each.
+   */
+  std::vector<uint32_t> attributes;
+
+  /**
+   * The lines [match_start, match_end) are the same as the lines of the
+   * previous playlist at the same index plus |match_offset|.  For a live
+   * playlist, these are the segments that were already seen, so only the
+   * other lines need to be parsed.  This is empty if nothing matched.
+   */
+  uint32_t match_start;
+  uint32_t match_end;
+  int32_t match_offset;
+};
+
+/**
+ * Splits an HLS playlist into tags, attributes, and URIs.  This doesn't
+ * interpret the tags; it replaces the line splitting and regular expressions
+ * used to parse playlists in JavaScript.  This keeps the lines of the last
+ * playlist, so refreshes of a live playlist can be compared against it.
+ */
+class HlsPlaylistTokenizer {
+ public:
+  HlsPlaylistTokenizer();
+  ~HlsPlaylistTokenizer();
+
+  /**
+   * Tokenizes the given playlist, which must be UTF-8, and compares it against
+   * the playlist given to the previous call.
+   *
+   * @param data The playlist text.
+   * @param size The number of bytes in |data|.
+   * @param table [OUT] Where to put the tokens.
+   * @param error [OUT] Where to put the error message on failure.
+   * @return True on success, false if this isn't an HLS playlist.
+   */
+  bool Tokenize(const uint8_t* data, size_t size, HlsTokenTable* table,
+                std::string* error);
+
+  /** Forgets the previous playlist, so the next one isn't compared to it. */
+  void Reset();
+
+ private:
+  struct LineInfo {
+    size_t start;
+    size_t size;
+    uint64_t hash;
+    bool is_uri;
+  };
+
+  /** Finds the lines that are the same as the previous playlist. */
+  void FindMatch(const uint8_t* data, const std::vector<LineInfo>& lines,
+                 HlsTokenTable* table) const;
+
+  std::vector<uint8_t> previous_;
+  std::vector<LineInfo> previous_lines_;
+};
+
+}  // namespace media
+}  // namespace shaka
+
+#endif  // SHAKA_EMBEDDED_MEDIA_HLS_PLAYLIST_TOKENIZER_H_
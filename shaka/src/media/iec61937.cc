@@ -0,0 +1,157 @@
+// Copyright 2020 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     https://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "src/media/iec61937.h"
+
+#include <glog/logging.h>
+
+namespace shaka {
+namespace media {
+
+namespace {
+
+/** The burst preamble sync words, Pa and Pb. */
+constexpr const uint16_t kSyncWord1 = 0xf872;
+constexpr const uint16_t kSyncWord2 = 0x4e1f;
+
+/** The burst data types from IEC 61937-2. */
+constexpr const uint16_t kDataTypeAc3 = 0x01;
+constexpr const uint16_t kDataTypeEac3 = 0x15;
+
+/** The AC-3 syncframe sync word. */
+constexpr const uint16_t kAc3SyncWord = 0x0b77;
+
+/** The number of E-AC-3 audio blocks in a burst. */
+constexpr const size_t kEac3BlocksPerBurst = 6;
+
+void WriteWord(uint16_t value, uint8_t* dest) {
+  dest[0] = static_cast<uint8_t>(value & 0xff);
+  dest[1] = static_cast<uint8_t>(value >> 8);
+}
+
+bool HasSyncWord(const uint8_t* data, size_t size) {
+  return size >= 6 && ((data[0] << 8) | data[1]) == kAc3SyncWord;
+}
+
+/** @return The "bsid" field of the syncframe, which gives the codec. */
+uint8_t GetBitstreamId(const uint8_t* data) {
+  return data[5] >> 3;
+}
+
+}  // namespace
+
+constexpr const size_t Iec61937Packetizer::kPreambleSize;
+constexpr const size_t Iec61937Packetizer::kAc3BurstSize;
+constexpr const size_t Iec61937Packetizer::kEac3BurstSize;
+
+Iec61937Packetizer::Iec61937Packetizer() : block_count_(0) {}
+
+Iec61937Packetizer::~Iec61937Packetizer() {}
+
+uint32_t Iec61937Packetizer::GetBurstSampleRate(Codec codec,
+                                                uint32_t sample_rate) {
+  return codec == Codec::Eac3 ? sample_rate * 4 : sample_rate;
+}
+
+void Iec61937Packetizer::Reset() {
+  payload_.clear();
+  block_count_ = 0;
+}
+
+Iec61937Packetizer::Result Iec61937Packetizer::AddFrame(
+    Codec codec, const uint8_t* data, size_t size,
+    std::vector<uint8_t>* burst) {
+  if (codec == Codec::Ac3) {
+    // ATSC A/52 Section 5.4.1: bsmod is the low 3 bits after bsid.
+    if (!HasSyncWord(data, size) || GetBitstreamId(data) > 10 ||
+        size > kAc3BurstSize - kPreambleSize) {
+      LOG(ERROR) << "Invalid AC-3 frame for passthrough";
+      return Result::InvalidFrame;
+    }
+    const uint16_t bsmod = data[5] & 0x7;
+    payload_.assign(data, data + size);
+    // The AC-3 length code is in bits.
+    MakeBurst(kDataTypeAc3 | static_cast<uint16_t>(bsmod << 8),
+              static_cast<uint16_t>(size * 8), kAc3BurstSize, burst);
+    return Result::Burst;
+  }
+
+  // ATSC A/52 Annex E: an E-AC-3 frame can hold several syncframes, for
+  // example an independent substream followed by dependent substreams.  Only
+  // the audio blocks of independent substream 0 count towards the burst
+  // length; the others cover the same time.
+  for (size_t pos = 0; pos < size;) {
+    const uint8_t* frame = data + pos;
+    if (!HasSyncWord(frame, size - pos) || GetBitstreamId(frame) <= 10) {
+      LOG(ERROR) << "Invalid E-AC-3 frame for passthrough";
+      Reset();
+      return Result::InvalidFrame;
+    }
+    const uint8_t stream_type = frame[2] >> 6;
+    const uint8_t substream_id = (frame[2] >> 3) & 0x7;
+    const size_t frame_size = ((((frame[2] & 0x7) << 8) | frame[3]) + 1) * 2;
+    if (frame_size > size - pos) {
+      LOG(ERROR) << "Truncated E-AC-3 frame for passthrough";
+      Reset();
+      return Result::InvalidFrame;
+    }
+    // Stream type 1 is a dependent substream.
+    if (stream_type != 1 && substream_id == 0) {
+      const uint8_t fscod = frame[4] >> 6;
+      const uint8_t numblkscod = (frame[4] >> 4) & 0x3;
+      static const size_t kBlockCounts[] = {1, 2, 3, 6};
+      block_count_ += fscod == 3 ? 6 : kBlockCounts[numblkscod];
+    }
+    pos += frame_size;
+  }
+
+  if (payload_.size() + size > kEac3BurstSize - kPreambleSize) {
+    LOG(ERROR) << "E-AC-3 frames too large for passthrough";
+    Reset();
+    return Result::InvalidFrame;
+  }
+  payload_.insert(payload_.end(), data, data + size);
+  if (block_count_ < kEac3BlocksPerBurst)
+    return Result::NeedMoreData;
+
+  // The E-AC-3 length code is in bytes.
+  MakeBurst(kDataTypeEac3, static_cast<uint16_t>(payload_.size()),
+            kEac3BurstSize, burst);
+  return Result::Burst;
+}
+
+void Iec61937Packetizer::MakeBurst(uint16_t data_type, uint16_t length_code,
+                                   size_t burst_size,
+                                   std::vector<uint8_t>* burst) {
+  burst->assign(burst_size, 0);
+  uint8_t* dest = burst->data();
+  WriteWord(kSyncWord1, dest);
+  WriteWord(kSyncWord2, dest + 2);
+  WriteWord(data_type, dest + 4);
+  WriteWord(length_code, dest + 6);
+
+  // The frame data is a sequence of big-endian 16-bit words, but the burst is
+  // little-endian samples, so swap each pair of bytes.  An odd final byte is
+  // padded with zero.
+  dest += kPreambleSize;
+  for (size_t i = 0; i < payload_.size(); i += 2) {
+    dest[i] = i + 1 < payload_.size() ? payload_[i + 1] : 0;
+    dest[i + 1] = payload_[i];
+  }
+
+  Reset();
+}
+
+}  // namespace media
+}  // namespace shaka
@@ -0,0 +1,103 @@
+// Copyright 2020 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     https://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef SHAKA_EMBEDDED_MEDIA_IEC61937_H_
+#define SHAKA_EMBEDDED_MEDIA_IEC61937_H_
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <vector>
+
+#include "src/util/macros.h"
+
+namespace shaka {
+namespace media {
+
+/**
+ * Packs compressed AC-3 and E-AC-3 frames into IEC 61937 data bursts so they
+ * can be sent to an S/PDIF or HDMI sink as if they were 16-bit stereo PCM.  The
+ * sink decodes the bursts itself, which preserves formats like Dolby Atmos
+ * (carried in E-AC-3) that a PCM decode would lose.
+ *
+ * Each burst is a preamble followed by the frame data and padded with zeros to
+ * the repetition period of the codec, which is the time the frame plays for.
+ * AC-3 bursts play at the stream's sample rate; E-AC-3 bursts need four times
+ * the bandwidth, so they play at four times the stream's sample rate.  The
+ * output is in native 16-bit little-endian sample order.
+ */
+class Iec61937Packetizer {
+ public:
+  enum class Codec {
+    Ac3,
+    Eac3,
+  };
+
+  enum class Result {
+    /** A burst is complete and was written to the output. */
+    Burst,
+    /** The frame was buffered; more frames are needed to make a burst. */
+    NeedMoreData,
+    /** The frame wasn't valid for the codec; any buffered frames are lost. */
+    InvalidFrame,
+  };
+
+  /** The number of bytes in the burst preamble. */
+  static constexpr const size_t kPreambleSize = 8;
+  /** The size of an AC-3 burst, in bytes; 1536 stereo 16-bit samples. */
+  static constexpr const size_t kAc3BurstSize = 1536 * 4;
+  /** The size of an E-AC-3 burst, in bytes; 6144 stereo 16-bit samples. */
+  static constexpr const size_t kEac3BurstSize = 6144 * 4;
+
+  Iec61937Packetizer();
+  ~Iec61937Packetizer();
+
+  SHAKA_NON_COPYABLE_OR_MOVABLE_TYPE(Iec61937Packetizer);
+
+  /**
+   * @return The sample rate the bursts of the given codec play at, for a
+   *   stream with the given sample rate.
+   */
+  static uint32_t GetBurstSampleRate(Codec codec, uint32_t sample_rate);
+
+  /** Drops any buffered frames, e.g. after a seek. */
+  void Reset();
+
+  /**
+   * Adds the given compressed frame.  AC-3 frames each make one burst.  E-AC-3
+   * frames are combined until they cover six audio blocks (1536 samples).  The
+   * frame can contain several syncframes, e.g. with dependent substreams.
+   *
+   * @param codec The codec of the frame.
+   * @param data The frame data.
+   * @param size The number of bytes in |data|.
+   * @param burst [OUT] Where to put the burst, if this returns Burst.
+   */
+  Result AddFrame(Codec codec, const uint8_t* data, size_t size,
+                  std::vector<uint8_t>* burst);
+
+ private:
+  void MakeBurst(uint16_t data_type, uint16_t length_code, size_t burst_size,
+                 std::vector<uint8_t>* burst);
+
+  // The frame data of the burst being built.
+  std::vector<uint8_t> payload_;
+  // The number of E-AC-3 audio blocks in |payload_|.
+  size_t block_count_;
+};
+
+}  // namespace media
+}  // namespace shaka
+
+#endif  // SHAKA_EMBEDDED_MEDIA_IEC61937_H_
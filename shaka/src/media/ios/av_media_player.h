@@ -37,6 +37,13 @@ class AvMediaPlayer : public MediaPlayer {
   const void* GetIosView();
   const void* GetAvPlayer();
 
+  /** @see DefaultMediaPlayer::PreloadSource */
+  void PreloadSource(const std::string& src);
+  /** @see DefaultMediaPlayer::SetSourceForwardBufferDuration */
+  void SetForwardBufferDuration(double seconds);
+  /** @see DefaultMediaPlayer::SetSourcePeakBitRate */
+  void SetPeakBitRate(double bits_per_second);
+
   MediaCapabilitiesInfo DecodingInfo(
       const MediaDecodingConfiguration& config) const override;
   struct VideoPlaybackQuality VideoPlaybackQuality() const override;
@@ -30,6 +30,19 @@
   { @"error", @"rate" }
 #define LISTEN_ITEM_KEY_PATHS \
   { @"status", @"playbackLikelyToKeepUp", @"playbackBufferEmpty" }
+#define PRELOAD_ASSET_KEYS \
+  @[ @"playable", @"tracks", @"duration" ]
+
+namespace {
+
+/**
+ * The maximum number of assets to keep loaded for future playback.  This
+ * includes assets preloaded by the app and the last asset played, which is
+ * kept for replay.
+ */
+constexpr const size_t kMaxPreloadedAssets = 4;
+
+}  // namespace
 
 @interface LayerWrapper : CALayer
 @end
@@ -49,9 +62,12 @@ class shaka::media::ios::AvMediaPlayer::Impl {
         old_ready_state_(VideoReadyState::NotAttached),
         requested_play_(false),
         loaded_(false),
+        forward_buffer_duration_(0),
+        peak_bit_rate_(0),
         player_(nil),
         player_layer_(nil),
-        observer_([[ValueObserver alloc] initWithImpl:this]) {}
+        observer_([[ValueObserver alloc] initWithImpl:this]),
+        preloaded_([[NSMutableArray alloc] init]) {}
 
   ~Impl() {
     Detach();
@@ -128,17 +144,56 @@ class shaka::media::ios::AvMediaPlayer::Impl {
     }
   }
 
+  void Preload(const std::string &src) {
+    NSURL *url = MakeUrl(src);
+    if (!url)
+      return;
+
+    std::unique_lock<SharedMutex> lock(mutex_);
+    if (FindAsset(url, /* remove= */ false))
+      return;
+    AVURLAsset *asset = [AVURLAsset URLAssetWithURL:url options:nil];
+    // This loads the playlist and the track info in the background, so it is
+    // ready by the time the asset is played.
+    [asset loadValuesAsynchronouslyForKeys:PRELOAD_ASSET_KEYS
+                         completionHandler:^{
+                         }];
+    StoreAsset(asset);
+  }
+
+  void SetForwardBufferDuration(double seconds) {
+    std::unique_lock<SharedMutex> lock(mutex_);
+    forward_buffer_duration_ = seconds;
+    if (player_)
+      player_.currentItem.preferredForwardBufferDuration = seconds;
+  }
+
+  void SetPeakBitRate(double bits_per_second) {
+    std::unique_lock<SharedMutex> lock(mutex_);
+    peak_bit_rate_ = bits_per_second;
+    if (player_)
+      player_.currentItem.preferredPeakBitRate = bits_per_second;
+  }
+
   bool Attach(const std::string &src) {
+    NSURL *url = MakeUrl(src);
+    if (!url)
+      return false;
+
     std::unique_lock<SharedMutex> lock(mutex_);
     DCHECK(!player_) << "Already attached";
 
-    auto *str = [NSString stringWithUTF8String:src.c_str()];
-    if (!str)
+    // Reuse a preloaded asset, or the previous one when replaying, so the
+    // playlist and track info don't need to be loaded again.
+    AVURLAsset *asset = FindAsset(url, /* remove= */ true);
+    if (!asset)
+      asset = [AVURLAsset URLAssetWithURL:url options:nil];
+    AVPlayerItem *item = [AVPlayerItem playerItemWithAsset:asset];
+    if (!item)
       return false;
-    auto *url = [NSURL URLWithString:str];
-    if (!url)
-      return false;
-    player_ = [AVPlayer playerWithURL:url];
+    item.preferredForwardBufferDuration = forward_buffer_duration_;
+    item.preferredPeakBitRate = peak_bit_rate_;
+    player_ = [AVPlayer playerWithPlayerItem:item];
     if (!player_)
       return false;
 
@@ -177,6 +232,11 @@ class shaka::media::ios::AvMediaPlayer::Impl {
       for (auto *name : LISTEN_ITEM_KEY_PATHS)
         [player_.currentItem removeObserver:observer_ forKeyPath:name];
 
+      // Keep the asset so replaying it doesn't need to load it again.
+      auto *asset = player_.currentItem.asset;
+      if ([asset isKindOfClass:[AVURLAsset class]] && !player_.error)
+        StoreAsset(static_cast<AVURLAsset *>(asset));
+
       [player_ pause];
       player_ = nil;
     }
@@ -257,6 +317,39 @@ class shaka::media::ios::AvMediaPlayer::Impl {
   }
 
  private:
+  static NSURL *MakeUrl(const std::string &src) {
+    auto *str = [NSString stringWithUTF8String:src.c_str()];
+    if (!str)
+      return nil;
+    return [NSURL URLWithString:str];
+  }
+
+  /** Finds a stored asset for the given URL.  This requires |mutex_|. */
+  AVURLAsset *FindAsset(NSURL *url, bool remove) {
+    for (NSUInteger i = 0; i < preloaded_.count; i++) {
+      AVURLAsset *asset = preloaded_[i];
+      if ([asset.URL isEqual:url]) {
+        if (remove)
+          [preloaded_ removeObjectAtIndex:i];
+        return asset;
+      }
+    }
+    return nil;
+  }
+
+  /**
+   * Stores an asset for future playback, dropping the oldest if there are too
+   * many.  This requires |mutex_|.
+   */
+  void StoreAsset(AVURLAsset *asset) {
+    FindAsset(asset.URL, /* remove= */ true);
+    [preloaded_ addObject:asset];
+    while (preloaded_.count > kMaxPreloadedAssets) {
+      [preloaded_[0] cancelLoading];
+      [preloaded_ removeObjectAtIndex:0];
+    }
+  }
+
   static VideoPlaybackState VideoPlaybackState(AVPlayer *player) {
     if (!player)
       return VideoPlaybackState::Detached;
@@ -348,10 +441,14 @@ class shaka::media::ios::AvMediaPlayer::Impl {
   enum VideoReadyState old_ready_state_;
   bool requested_play_;
   bool loaded_;
+  double forward_buffer_duration_;
+  double peak_bit_rate_;
 
   AVPlayer *player_;
   AVPlayerLayer *player_layer_;
   ValueObserver *observer_;
+  // The assets that are loaded for future playback, oldest first.
+  NSMutableArray<AVURLAsset *> *preloaded_;
 };
 
 @implementation LayerWrapper
@@ -578,6 +675,16 @@ void AvMediaPlayer::SetPlaybackRate(double rate) {
     player.rate = static_cast<float>(rate);
 }
 
+void AvMediaPlayer::PreloadSource(const std::string &src) {
+  impl_->Preload(src);
+}
+void AvMediaPlayer::SetForwardBufferDuration(double seconds) {
+  impl_->SetForwardBufferDuration(seconds);
+}
+void AvMediaPlayer::SetPeakBitRate(double bits_per_second) {
+  impl_->SetPeakBitRate(bits_per_second);
+}
+
 bool AvMediaPlayer::AttachSource(const std::string &src) {
   return impl_->Attach(src);
 }
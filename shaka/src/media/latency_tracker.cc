@@ -0,0 +1,70 @@
+// Copyright 2020 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     https://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "src/media/latency_tracker.h"
+
+#include <math.h>
+
+#include <algorithm>
+
+namespace shaka {
+namespace media {
+
+namespace {
+
+/**
+ * The maximum number of appends to remember.  Live streams only keep a few
+ * seconds buffered, so this is plenty even with short chunks.
+ */
+constexpr const size_t kMaxEntries = 256;
+
+}  // namespace
+
+LatencyTracker::LatencyTracker(const util::Clock* clock)
+    : mutex_("LatencyTracker"), clock_(clock) {}
+
+LatencyTracker::~LatencyTracker() {}
+
+void LatencyTracker::OnBufferedChanged(const BufferedRanges& ranges) {
+  if (ranges.empty())
+    return;
+
+  std::unique_lock<Mutex> lock(mutex_);
+  const double end = ranges.back().end;
+  if (!entries_.empty() && end <= entries_.back().end)
+    return;
+
+  entries_.push_back({end, clock_->GetMonotonicTime()});
+  if (entries_.size() > kMaxEntries)
+    entries_.pop_front();
+}
+
+double LatencyTracker::GetLatency(double time) const {
+  std::unique_lock<Mutex> lock(mutex_);
+  // The content at |time| was appended when the end first moved past it.
+  auto it = std::upper_bound(
+      entries_.begin(), entries_.end(), time,
+      [](double time, const Entry& entry) { return time < entry.end; });
+  if (it == entries_.end())
+    return NAN;
+  return (clock_->GetMonotonicTime() - it->buffered_at) / 1000.0;
+}
+
+void LatencyTracker::Reset() {
+  std::unique_lock<Mutex> lock(mutex_);
+  entries_.clear();
+}
+
+}  // namespace media
+}  // namespace shaka
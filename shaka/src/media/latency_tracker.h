@@ -0,0 +1,72 @@
+// Copyright 2020 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     https://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef SHAKA_EMBEDDED_MEDIA_LATENCY_TRACKER_H_
+#define SHAKA_EMBEDDED_MEDIA_LATENCY_TRACKER_H_
+
+#include <stdint.h>
+
+#include <deque>
+
+#include "src/debug/mutex.h"
+#include "src/media/types.h"
+#include "src/util/clock.h"
+#include "src/util/macros.h"
+
+namespace shaka {
+namespace media {
+
+/**
+ * Tracks when content was added to a stream so we can measure how long it
+ * takes from the content being appended until it is presented.  This only
+ * tracks content added to the end of the stream, which is how live streams are
+ * played.
+ */
+class LatencyTracker {
+ public:
+  explicit LatencyTracker(const util::Clock* clock);
+  ~LatencyTracker();
+
+  SHAKA_NON_COPYABLE_OR_MOVABLE_TYPE(LatencyTracker);
+
+  /** Called when the buffered ranges of the stream change. */
+  void OnBufferedChanged(const BufferedRanges& ranges);
+
+  /**
+   * @return The number of seconds since the content at the given time was
+   *   appended, or NAN if unknown.
+   */
+  double GetLatency(double time) const;
+
+  /** Forgets about any existing content, e.g. after a seek. */
+  void Reset();
+
+ private:
+  struct Entry {
+    // The end of the buffered content, in seconds.
+    double end;
+    // The monotonic time, in milliseconds, the content was buffered.
+    uint64_t buffered_at;
+  };
+
+  mutable Mutex mutex_;
+  const util::Clock* const clock_;
+  // Ordered by |end|.
+  std::deque<Entry> entries_;
+};
+
+}  // namespace media
+}  // namespace shaka
+
+#endif  // SHAKA_EMBEDDED_MEDIA_LATENCY_TRACKER_H_
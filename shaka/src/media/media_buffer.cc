@@ -0,0 +1,200 @@
+// Copyright 2020 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     https://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "src/media/media_buffer.h"
+
+#include <stdlib.h>
+#if !defined(OS_POSIX)
+#  include <malloc.h>
+#endif
+
+#include <atomic>
+#include <utility>
+
+#include "src/util/macros.h"
+
+namespace shaka {
+namespace media {
+
+namespace {
+
+constexpr const size_t kCategoryCount =
+    static_cast<size_t>(MediaAllocationCategory::DecodedFrame) + 1;
+
+/** The allocator used when the app doesn't give one. */
+class HeapAllocator final : public MediaAllocator {
+ public:
+  void* Allocate(size_t size, size_t alignment,
+                 MediaAllocationCategory /* category */) override {
+#ifdef OS_POSIX
+    void* ret;
+    if (posix_memalign(&ret, alignment, size) != 0)
+      return nullptr;
+    return ret;
+#else
+    return _aligned_malloc(size, alignment);
+#endif
+  }
+
+  void Free(void* buffer, size_t /* size */,
+            MediaAllocationCategory /* category */) override {
+#ifdef OS_POSIX
+    free(buffer);  // NOLINT
+#else
+    _aligned_free(buffer);
+#endif
+  }
+};
+
+struct CategoryStats {
+  std::atomic<uint64_t> current_bytes{0};
+  std::atomic<uint64_t> peak_bytes{0};
+  std::atomic<uint64_t> current_buffers{0};
+  std::atomic<uint64_t> total_allocations{0};
+  std::atomic<uint64_t> failed_allocations{0};
+};
+
+BEGIN_ALLOW_COMPLEX_STATICS
+HeapAllocator heap_allocator;
+END_ALLOW_COMPLEX_STATICS
+std::atomic<MediaAllocator*> current_allocator{nullptr};
+CategoryStats category_stats[kCategoryCount];
+
+CategoryStats* GetCategoryStats(MediaAllocationCategory category) {
+  const size_t index = static_cast<size_t>(category);
+  CHECK_LT(index, kCategoryCount);
+  return &category_stats[index];
+}
+
+}  // namespace
+
+const size_t MediaAllocator::kAlignment;
+
+MediaAllocator::MediaAllocator() {}
+MediaAllocator::~MediaAllocator() {}
+
+// static
+MediaAllocator::Stats MediaAllocator::GetStats(
+    MediaAllocationCategory category) {
+  CategoryStats* stats = GetCategoryStats(category);
+  Stats ret;
+  ret.current_bytes = stats->current_bytes.load(std::memory_order_relaxed);
+  ret.peak_bytes = stats->peak_bytes.load(std::memory_order_relaxed);
+  ret.current_buffers = stats->current_buffers.load(std::memory_order_relaxed);
+  ret.total_allocations =
+      stats->total_allocations.load(std::memory_order_relaxed);
+  ret.failed_allocations =
+      stats->failed_allocations.load(std::memory_order_relaxed);
+  return ret;
+}
+
+
+void SetMediaAllocator(MediaAllocator* allocator) {
+  current_allocator.store(allocator, std::memory_order_release);
+}
+
+MediaAllocator* GetMediaAllocator() {
+  MediaAllocator* ret = current_allocator.load(std::memory_order_acquire);
+  return ret ? ret : &heap_allocator;
+}
+
+void* AllocateMedia(MediaAllocator* allocator, size_t size,
+                    MediaAllocationCategory category) {
+  if (size == 0)
+    return nullptr;
+
+  CategoryStats* stats = GetCategoryStats(category);
+  void* ret = allocator->Allocate(size, MediaAllocator::kAlignment, category);
+  if (!ret) {
+    stats->failed_allocations.fetch_add(1, std::memory_order_relaxed);
+    LOG(ERROR) << "Unable to allocate " << size << " bytes for media";
+    return nullptr;
+  }
+  DCHECK_EQ(reinterpret_cast<uintptr_t>(ret) % MediaAllocator::kAlignment, 0u)
+      << "The MediaAllocator returned an unaligned buffer";
+
+  stats->total_allocations.fetch_add(1, std::memory_order_relaxed);
+  stats->current_buffers.fetch_add(1, std::memory_order_relaxed);
+  const uint64_t current =
+      stats->current_bytes.fetch_add(size, std::memory_order_relaxed) + size;
+  uint64_t peak = stats->peak_bytes.load(std::memory_order_relaxed);
+  while (current > peak && !stats->peak_bytes.compare_exchange_weak(
+                               peak, current, std::memory_order_relaxed)) {
+  }
+  return ret;
+}
+
+void FreeMedia(MediaAllocator* allocator, void* buffer, size_t size,
+               MediaAllocationCategory category) {
+  if (!buffer)
+    return;
+
+  CategoryStats* stats = GetCategoryStats(category);
+  stats->current_buffers.fetch_sub(1, std::memory_order_relaxed);
+  stats->current_bytes.fetch_sub(size, std::memory_order_relaxed);
+  allocator->Free(buffer, size, category);
+}
+
+
+MediaBuffer::MediaBuffer()
+    : allocator_(nullptr),
+      data_(nullptr),
+      size_(0),
+      category_(MediaAllocationCategory::Network) {}
+
+MediaBuffer::MediaBuffer(size_t size, MediaAllocationCategory category)
+    : allocator_(GetMediaAllocator()), size_(size), category_(category) {
+  data_ = reinterpret_cast<uint8_t*>(AllocateMedia(allocator_, size, category));
+  if (!data_)
+    size_ = 0;
+}
+
+MediaBuffer::MediaBuffer(MediaBuffer&& other)
+    : allocator_(other.allocator_),
+      data_(other.data_),
+      size_(other.size_),
+      category_(other.category_) {
+  other.allocator_ = nullptr;
+  other.data_ = nullptr;
+  other.size_ = 0;
+}
+
+MediaBuffer::~MediaBuffer() {
+  Reset();
+}
+
+MediaBuffer& MediaBuffer::operator=(MediaBuffer&& other) {
+  if (this != &other) {
+    Reset();
+    allocator_ = other.allocator_;
+    data_ = other.data_;
+    size_ = other.size_;
+    category_ = other.category_;
+    other.allocator_ = nullptr;
+    other.data_ = nullptr;
+    other.size_ = 0;
+  }
+  return *this;
+}
+
+void MediaBuffer::Reset() {
+  if (data_)
+    FreeMedia(allocator_, data_, size_, category_);
+  allocator_ = nullptr;
+  data_ = nullptr;
+  size_ = 0;
+}
+
+}  // namespace media
+}  // namespace shaka
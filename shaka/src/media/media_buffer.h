@@ -0,0 +1,139 @@
+// Copyright 2020 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     https://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef SHAKA_EMBEDDED_MEDIA_MEDIA_BUFFER_H_
+#define SHAKA_EMBEDDED_MEDIA_MEDIA_BUFFER_H_
+
+#include <glog/logging.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include <vector>
+
+#include "shaka/media/media_allocator.h"
+
+namespace shaka {
+namespace media {
+
+/**
+ * Sets the allocator used for new media buffers.  If this is nullptr, the
+ * buffers are allocated from the heap.
+ */
+void SetMediaAllocator(MediaAllocator* allocator);
+
+/** @return The allocator used for new media buffers; this is never nullptr. */
+MediaAllocator* GetMediaAllocator();
+
+/**
+ * Allocates a buffer from the given allocator and records it in the stats.
+ * @return The new buffer, or nullptr on failure or if |size| is 0.
+ */
+void* AllocateMedia(MediaAllocator* allocator, size_t size,
+                    MediaAllocationCategory category);
+
+/** Frees a buffer that was returned from AllocateMedia. */
+void FreeMedia(MediaAllocator* allocator, void* buffer, size_t size,
+               MediaAllocationCategory category);
+
+
+/**
+ * Owns a buffer that was allocated from the current MediaAllocator.  The
+ * buffer is freed with the same allocator, even if it has changed since.
+ */
+class MediaBuffer final {
+ public:
+  MediaBuffer();
+  /**
+   * Allocates a new buffer of the given size.  On failure, data() returns
+   * nullptr.
+   */
+  MediaBuffer(size_t size, MediaAllocationCategory category);
+  MediaBuffer(MediaBuffer&& other);
+  ~MediaBuffer();
+
+  MediaBuffer(const MediaBuffer&) = delete;
+  MediaBuffer& operator=(const MediaBuffer&) = delete;
+  MediaBuffer& operator=(MediaBuffer&& other);
+
+  uint8_t* data() const {
+    return data_;
+  }
+  size_t size() const {
+    return size_;
+  }
+
+ private:
+  void Reset();
+
+  MediaAllocator* allocator_;
+  uint8_t* data_;
+  size_t size_;
+  MediaAllocationCategory category_;
+};
+
+
+/**
+ * An STL allocator that uses the MediaAllocator that was current when it was
+ * created.  Copies of this (e.g. when moving a vector) keep using the same
+ * allocator.
+ */
+template <typename T, MediaAllocationCategory Category>
+class MediaStlAllocator {
+ public:
+  using value_type = T;
+
+  template <typename U>
+  struct rebind {
+    using other = MediaStlAllocator<U, Category>;
+  };
+
+  MediaStlAllocator() : allocator_(GetMediaAllocator()) {}
+  template <typename U>
+  MediaStlAllocator(const MediaStlAllocator<U, Category>& other)  // NOLINT
+      : allocator_(other.allocator_) {}
+
+  T* allocate(size_t count) {
+    void* ret = AllocateMedia(allocator_, count * sizeof(T), Category);
+    CHECK(ret || count == 0) << "Unable to allocate media buffer";
+    return reinterpret_cast<T*>(ret);
+  }
+
+  void deallocate(T* buffer, size_t count) {
+    FreeMedia(allocator_, buffer, count * sizeof(T), Category);
+  }
+
+  template <typename U>
+  bool operator==(const MediaStlAllocator<U, Category>& other) const {
+    return allocator_ == other.allocator_;
+  }
+  template <typename U>
+  bool operator!=(const MediaStlAllocator<U, Category>& other) const {
+    return allocator_ != other.allocator_;
+  }
+
+ private:
+  template <typename U, MediaAllocationCategory>
+  friend class MediaStlAllocator;
+
+  MediaAllocator* allocator_;
+};
+
+/** A buffer that holds demuxed frames. */
+using EncodedFrameBuffer = std::vector<
+    uint8_t, MediaStlAllocator<uint8_t, MediaAllocationCategory::EncodedFrame>>;
+
+}  // namespace media
+}  // namespace shaka
+
+#endif  // SHAKA_EMBEDDED_MEDIA_MEDIA_BUFFER_H_
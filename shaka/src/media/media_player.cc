@@ -15,9 +15,17 @@
 #include "shaka/media/media_player.h"
 
 #include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
 #include <vector>
 
 #include "src/debug/mutex.h"
+#include "src/debug/thread.h"
+#include "src/util/macros.h"
 #include "src/util/utils.h"
 
 namespace shaka {
@@ -74,6 +82,10 @@ MediaPlayer::Client::Client() {}
 MediaPlayer::Client::~Client() {}
 // \endcond Doxygen_Skip
 
+uint64_t MediaPlayer::GetBufferedVersion() const {
+  return 0;
+}
+
 void MediaPlayer::Client::OnAddAudioTrack(std::shared_ptr<MediaTrack> track) {}
 
 void MediaPlayer::Client::OnRemoveAudioTrack(
@@ -118,15 +130,187 @@ void MediaPlayer::Client::OnUserEvent(const std::string& name,
 
 class MediaPlayer::ClientList::Impl {
  public:
+  /** An event waiting to be delivered to an async client. */
+  struct Event {
+    enum Kind {
+      kCall,
+      kReadyState,
+      kPlaybackState,
+      kPlaybackRate,
+    };
+
+    explicit Event(std::function<void(Client*)> call)
+        : kind(kCall), call(std::move(call)) {}
+    Event(VideoReadyState old_state, VideoReadyState new_state)
+        : kind(kReadyState), old_ready(old_state), new_ready(new_state) {}
+    Event(VideoPlaybackState old_state, VideoPlaybackState new_state)
+        : kind(kPlaybackState),
+          old_playback(old_state),
+          new_playback(new_state) {}
+    Event(double old_rate, double new_rate)
+        : kind(kPlaybackRate), old_rate(old_rate), new_rate(new_rate) {}
+
+    /**
+     * Merges the given event into this one if they are changes to the same
+     * state, keeping our old value and their new value.
+     * @return Whether the event was merged.
+     */
+    bool Merge(const Event& other) {
+      if (kind == kCall || other.kind != kind)
+        return false;
+      new_ready = other.new_ready;
+      new_playback = other.new_playback;
+      new_rate = other.new_rate;
+      return true;
+    }
+
+    /** @return Whether this is a state change that doesn't change anything. */
+    bool IsNoOp() const {
+      switch (kind) {
+        case kReadyState:
+          return old_ready == new_ready;
+        case kPlaybackState:
+          return old_playback == new_playback;
+        case kPlaybackRate:
+          return old_rate == new_rate;
+        default:
+          return false;
+      }
+    }
+
+    void Deliver(Client* client) const {
+      switch (kind) {
+        case kReadyState:
+          client->OnReadyStateChanged(old_ready, new_ready);
+          break;
+        case kPlaybackState:
+          client->OnPlaybackStateChanged(old_playback, new_playback);
+          break;
+        case kPlaybackRate:
+          client->OnPlaybackRateChanged(old_rate, new_rate);
+          break;
+        default:
+          call(client);
+          break;
+      }
+    }
+
+    Kind kind;
+    std::function<void(Client*)> call;
+    VideoReadyState old_ready = VideoReadyState::NotAttached;
+    VideoReadyState new_ready = VideoReadyState::NotAttached;
+    VideoPlaybackState old_playback = VideoPlaybackState::Detached;
+    VideoPlaybackState new_playback = VideoPlaybackState::Detached;
+    double old_rate = 0;
+    double new_rate = 0;
+  };
+
+  /** Holds the queue and delivery thread for a client added asynchronously. */
+  class AsyncClient {
+   public:
+    explicit AsyncClient(Client* client)
+        : client(client),
+          stopping_(false),
+          thread_("ClientList", std::bind(&AsyncClient::ThreadMain, this)) {}
+
+    ~AsyncClient() {
+      Stop();
+      if (thread_.joinable())
+        thread_.join();
+    }
+
+    SHAKA_NON_COPYABLE_OR_MOVABLE_TYPE(AsyncClient);
+
+    bool IsDeliveryThread() const {
+      return std::this_thread::get_id() == thread_.get_id();
+    }
+
+    void Post(Event event) {
+      std::unique_lock<std::mutex> lock(mutex_);
+      if (stopping_)
+        return;
+      if (!events_.empty() && events_.back().Merge(event)) {
+        if (events_.back().IsNoOp())
+          events_.pop_back();
+        return;
+      }
+      events_.emplace_back(std::move(event));
+      cond_.notify_all();
+    }
+
+    /** Drops any queued events and tells the thread to exit. */
+    void Stop() {
+      std::unique_lock<std::mutex> lock(mutex_);
+      stopping_ = true;
+      events_.clear();
+      cond_.notify_all();
+    }
+
+    Client* const client;
+
+   private:
+    void ThreadMain() {
+      std::unique_lock<std::mutex> lock(mutex_);
+      while (true) {
+        while (events_.empty() && !stopping_)
+          cond_.wait(lock);
+        if (stopping_)
+          return;
+        Event event = std::move(events_.front());
+        events_.pop_front();
+
+        lock.unlock();
+        event.Deliver(client);
+        lock.lock();
+      }
+    }
+
+    std::mutex mutex_;
+    std::condition_variable cond_;
+    std::deque<Event> events_;
+    bool stopping_;
+
+    // Should be last so the thread starts after all the fields are initialized.
+    Thread thread_;
+  };
+
   template <typename Func, typename... Args>
   void CallClientMethod(Func func, Args&&... args) {
     util::shared_lock<SharedMutex> lock(mutex);
+    if (!async_clients.empty()) {
+      const Event event(std::bind(func, std::placeholders::_1, args...));
+      for (auto& async : async_clients)
+        async->Post(event);
+    }
     for (auto* client : clients)
       (client->*func)(std::forward<Args>(args)...);
   }
 
+  template <typename Func, typename T>
+  void CallStateChanged(Func func, T old_value, T new_value) {
+    util::shared_lock<SharedMutex> lock(mutex);
+    for (auto& async : async_clients)
+      async->Post(Event(old_value, new_value));
+    for (auto* client : clients)
+      (client->*func)(old_value, new_value);
+  }
+
+  bool HasClient(Client* client) const {
+    if (util::contains(clients, client))
+      return true;
+    for (auto& async : async_clients) {
+      if (async->client == client)
+        return true;
+    }
+    return false;
+  }
+
   SharedMutex mutex{"ClientList"};
   std::vector<Client*> clients;
+  std::vector<std::unique_ptr<AsyncClient>> async_clients;
+  // Async clients that removed themselves from their own delivery thread.
+  // These can't be joined there, so they are destroyed with the list.
+  std::vector<std::unique_ptr<AsyncClient>> removed_clients;
 };
 
 MediaPlayer::ClientList::ClientList() : impl_(new Impl) {}
@@ -134,13 +318,38 @@ MediaPlayer::ClientList::~ClientList() {}
 
 void MediaPlayer::ClientList::AddClient(Client* client) {
   std::unique_lock<SharedMutex> lock(impl_->mutex);
-  if (!util::contains(impl_->clients, client))
+  if (!impl_->HasClient(client))
     impl_->clients.emplace_back(client);
 }
 
-void MediaPlayer::ClientList::RemoveClient(Client* client) {
+void MediaPlayer::ClientList::AddAsyncClient(Client* client) {
   std::unique_lock<SharedMutex> lock(impl_->mutex);
-  util::RemoveElement(&impl_->clients, client);
+  if (!impl_->HasClient(client))
+    impl_->async_clients.emplace_back(new Impl::AsyncClient(client));
+}
+
+void MediaPlayer::ClientList::RemoveClient(Client* client) {
+  std::unique_ptr<Impl::AsyncClient> async;
+  {
+    std::unique_lock<SharedMutex> lock(impl_->mutex);
+    util::RemoveElement(&impl_->clients, client);
+    for (auto it = impl_->async_clients.begin();
+         it != impl_->async_clients.end(); it++) {
+      if ((*it)->client == client) {
+        async = std::move(*it);
+        impl_->async_clients.erase(it);
+        break;
+      }
+    }
+    if (async && async->IsDeliveryThread()) {
+      async->Stop();
+      impl_->removed_clients.emplace_back(std::move(async));
+    }
+  }
+
+  // Wait for the delivery thread outside the lock so a callback that is
+  // running can still call into the list.
+  async.reset();
 }
 
 void MediaPlayer::ClientList::OnAddAudioTrack(
@@ -174,18 +383,18 @@ void MediaPlayer::ClientList::OnRemoveTextTrack(
 
 void MediaPlayer::ClientList::OnReadyStateChanged(VideoReadyState old_state,
                                                   VideoReadyState new_state) {
-  impl_->CallClientMethod(&Client::OnReadyStateChanged, old_state, new_state);
+  impl_->CallStateChanged(&Client::OnReadyStateChanged, old_state, new_state);
 }
 
 void MediaPlayer::ClientList::OnPlaybackStateChanged(
     VideoPlaybackState old_state, VideoPlaybackState new_state) {
-  impl_->CallClientMethod(&Client::OnPlaybackStateChanged, old_state,
+  impl_->CallStateChanged(&Client::OnPlaybackStateChanged, old_state,
                           new_state);
 }
 
 void MediaPlayer::ClientList::OnPlaybackRateChanged(double old_rate,
                                                     double new_rate) {
-  impl_->CallClientMethod(&Client::OnPlaybackRateChanged, old_rate, new_rate);
+  impl_->CallStateChanged(&Client::OnPlaybackRateChanged, old_rate, new_rate);
 }
 
 void MediaPlayer::ClientList::OnError(const std::string& error) {
@@ -218,7 +427,13 @@ void MediaPlayer::ClientList::OnWaitingForKey() {
 
 void MediaPlayer::ClientList::OnUserEvent(const std::string& name,
                                           void* user_data) {
-  impl_->CallClientMethod(&Client::OnUserEvent, name, user_data);
+  // The user data is only valid during this call, so even async clients are
+  // called synchronously.
+  util::shared_lock<SharedMutex> lock(impl_->mutex);
+  for (auto& async : impl_->async_clients)
+    async->client->OnUserEvent(name, user_data);
+  for (auto* client : impl_->clients)
+    client->OnUserEvent(name, user_data);
 }
 
 
@@ -227,6 +442,10 @@ MediaPlayer::MediaPlayer() {}
 MediaPlayer::~MediaPlayer() {}
 // \endcond Doxygen_Skip
 
+void MediaPlayer::AddAsyncClient(Client* client) const {
+  AddClient(client);
+}
+
 void MediaPlayer::SetMediaPlayerForSupportChecks(const MediaPlayer* player) {
   player_.store(player, std::memory_order_relaxed);
 }
@@ -14,11 +14,19 @@
 
 #include "src/media/media_utils.h"
 
+#include <glog/logging.h>
+#ifdef OS_POSIX
+#  include <unistd.h>
+#endif
+
 #include <algorithm>
+#include <atomic>
+#include <cctype>
 #include <cstdlib>
 #include <type_traits>
 #include <utility>
 
+#include "src/util/buffer_reader.h"
 #include "src/util/macros.h"
 
 namespace shaka {
@@ -26,6 +34,25 @@ namespace media {
 
 namespace {
 
+/**
+ * The fraction of the physical memory that a single stream's decoded frames
+ * can use, if the limit isn't configured.
+ */
+constexpr const uint64_t kPhysicalMemoryDivisor = 8;
+
+/**
+ * The fraction of the physical memory that a SourceBuffer can hold, if the
+ * limit isn't configured.  Audio uses much less space than video.
+ */
+constexpr const uint64_t kVideoQuotaDivisor = 8;
+constexpr const uint64_t kAudioQuotaDivisor = 64;
+
+std::atomic<JsManager::MemoryPressure> memory_pressure{
+    JsManager::MemoryPressure::None};
+std::atomic<uint64_t> video_quota_bytes{0};
+std::atomic<uint64_t> audio_quota_bytes{0};
+std::atomic<bool> evict_played_media{true};
+
 struct StringMapping {
   const char* source;
   const char* dest;
@@ -57,6 +84,104 @@ std::string substr_end(const std::string& source, std::string::size_type start,
   return source.substr(start, end - start);
 }
 
+
+void RemoveEmulationPrevention(const uint8_t* data, size_t size,
+                               std::vector<uint8_t>* output) {
+  DCHECK_EQ(output->size(), size);
+  // A byte sequence 0x0 0x0 0x1 is used to signal the start of a NALU.  So for
+  // the body of the NALU, it needs to be escaped.  So this reverses the
+  // escaping by changing 0x0 0x0 0x3 to 0x0 0x0.
+  DCHECK_EQ(output->size(), size);
+  size_t out_pos = 0;
+  for (size_t in_pos = 0; in_pos < size;) {
+    if (in_pos + 2 < size && data[in_pos] == 0 && data[in_pos + 1] == 0 &&
+        data[in_pos + 2] == 0x3) {
+      (*output)[out_pos++] = 0;
+      (*output)[out_pos++] = 0;
+      in_pos += 3;
+    } else {
+      (*output)[out_pos++] = data[in_pos++];
+    }
+  }
+  output->resize(out_pos);
+}
+
+Rational<uint32_t> GetSarFromVuiParameters(util::BufferReader* reader) {
+  // See section E.1.1 of H.264/H.265.
+  // vui_parameters()
+  if (reader->ReadBits(1) == 0)  // aspect_ratio_info_present_flag
+    return {0, 0};               // Values we want aren't there, return unknown.
+  const uint8_t aspect_ratio_idc = reader->ReadUint8();
+  // See Table E-1 in H.264.
+  switch (aspect_ratio_idc) {
+    case 1:
+      return {1, 1};
+    case 2:
+      return {12, 11};
+    case 3:
+      return {10, 11};
+    case 4:
+      return {16, 11};
+    case 5:
+      return {40, 33};
+    case 6:
+      return {24, 11};
+    case 7:
+      return {20, 11};
+    case 8:
+      return {32, 11};
+    case 9:
+      return {80, 33};
+    case 10:
+      return {18, 11};
+    case 11:
+      return {15, 11};
+    case 12:
+      return {64, 33};
+    case 13:
+      return {160, 99};
+    case 14:
+      return {4, 3};
+    case 15:
+      return {3, 2};
+    case 16:
+      return {2, 1};
+    case 255: {
+      const uint32_t sar_width = static_cast<uint32_t>(reader->ReadBits(16));
+      const uint32_t sar_height = static_cast<uint32_t>(reader->ReadBits(16));
+      return {sar_width, sar_height};
+    }
+
+    default:
+      LOG(DFATAL) << "Unknown value of aspect_ratio_idc: "
+                  << static_cast<int>(aspect_ratio_idc);
+      return {0, 0};
+  }
+}
+
+void SkipHevcProfileTierLevel(bool profile_present,
+                              uint64_t max_sub_layers_minus1,
+                              util::BufferReader* reader) {
+  if (profile_present) {
+    reader->Skip(11);
+  }
+  reader->Skip(1);
+  std::vector<bool> sub_layer_profile_present_flag(max_sub_layers_minus1);
+  std::vector<bool> sub_layer_level_present_flag(max_sub_layers_minus1);
+  for (uint64_t i = 0; i < max_sub_layers_minus1; i++) {
+    sub_layer_profile_present_flag[i] = reader->ReadBits(1);
+    sub_layer_level_present_flag[i] = reader->ReadBits(1);
+  }
+  if (max_sub_layers_minus1 > 0 && max_sub_layers_minus1 < 8)
+    reader->SkipBits(2 * (8 - max_sub_layers_minus1));
+  for (uint64_t i = 0; i < max_sub_layers_minus1; i++) {
+    if (sub_layer_profile_present_flag[i])
+      reader->Skip(11);
+    if (sub_layer_level_present_flag[i])
+      reader->Skip(1);
+  }
+}
+
 }  // namespace
 
 bool ParseMimeType(const std::string& source, std::string* type,
@@ -140,6 +265,274 @@ std::string NormalizeCodec(const std::string& codec) {
   return simple_codec;
 }
 
+Rational<uint32_t> GetSarFromH264(const std::vector<uint8_t>& extra_data) {
+  util::BufferReader reader(extra_data.data(), extra_data.size());
+  // The H.264 extra data is a AVCDecoderConfigurationRecord from
+  // Section 5.3.3.1.2 in ISO/IEC 14496-15
+  reader.Skip(5);
+  const size_t sps_count = reader.ReadUint8() & 0x1f;
+  if (sps_count == 0)
+    return {0, 0};
+
+  // There should only be one SPS, or they should be compatible since there
+  // should only be one video stream.  There may be two SPS for encrypted
+  // content with a clear lead.
+  const size_t sps_size = reader.ReadBits(16);
+  if (sps_size >= reader.BytesRemaining()) {
+    LOG(DFATAL) << "Invalid avcC configuration";
+    return {0, 0};
+  }
+
+  // This is an SPS NALU; remove the emulation prevention bytes.
+  // See ISO/IE 14496-10 Sec. 7.3.1/7.3.2 and H.264 Sec. 7.3.2.1.1.
+  std::vector<uint8_t> temp(sps_size);
+  RemoveEmulationPrevention(reader.data(), sps_size, &temp);
+  util::BufferReader sps_reader(temp.data(), temp.size());
+  if ((sps_reader.ReadUint8() & 0x1f) != 0x7) {
+    LOG(DFATAL) << "Non-SPS found in avcC configuration";
+    return {0, 0};
+  }
+
+  // seq_parameter_set_rbsp()
+  const uint8_t profile_idc = sps_reader.ReadUint8();
+  sps_reader.Skip(2);
+  sps_reader.ReadExpGolomb();  // seq_parameter_set_id
+  // Values here copied from the H.264 spec.
+  if (profile_idc == 100 || profile_idc == 110 || profile_idc == 122 ||
+      profile_idc == 244 || profile_idc == 44 || profile_idc == 83 ||
+      profile_idc == 86 || profile_idc == 118 || profile_idc == 128 ||
+      profile_idc == 138 || profile_idc == 139 || profile_idc == 134) {
+    const uint64_t chroma_format_idc = sps_reader.ReadExpGolomb();
+    if (chroma_format_idc == 3)
+      sps_reader.ReadBits(1);           // separate_colour_plane_flag
+    sps_reader.ReadExpGolomb();         // bit_depth_luma_minus8
+    sps_reader.ReadExpGolomb();         // bit_depth_chroma_minus8
+    sps_reader.SkipBits(1);             // qpprime_y_zero_transform_bypass_flag
+    if (sps_reader.ReadBits(1) == 1) {  // seq_scaling_matrix_present_flag
+      LOG(WARNING) << "Scaling matrix is unsupported";
+      return {0, 0};
+    }
+  }
+  sps_reader.ReadExpGolomb();  // log2_max_frame_num_minus4
+  const uint64_t pic_order_cnt_type = sps_reader.ReadExpGolomb();
+  if (pic_order_cnt_type == 0) {
+    sps_reader.ReadExpGolomb();  // log2_max_pic_order_cnt_lsb_minus4
+  } else if (pic_order_cnt_type == 1) {
+    sps_reader.ReadBits(1);      // delta_pic_order_always_zero_flag
+    sps_reader.ReadExpGolomb();  // offset_for_non_ref_pic
+    sps_reader.ReadExpGolomb();  // offset_for_top_to_bottom_field
+    const uint64_t count = sps_reader.ReadExpGolomb();
+    for (uint64_t i = 0; i < count; i++)
+      sps_reader.ReadExpGolomb();  // offset_for_ref_frame
+  }
+  sps_reader.ReadExpGolomb();         // max_num_ref_frames
+  sps_reader.ReadBits(1);             // gaps_in_frame_num_value_allowed_flag
+  sps_reader.ReadExpGolomb();         // pic_width_in_mbs_minus1
+  sps_reader.ReadExpGolomb();         // pic_height_in_map_units_minus1
+  if (sps_reader.ReadBits(1) == 0)    // frame_mbs_only_flag
+    sps_reader.ReadBits(1);           // mb_adaptive_frame_field_flag
+  sps_reader.ReadBits(1);             // direct_8x8_inference_flag
+  if (sps_reader.ReadBits(1) == 1) {  // frame_cropping_flag
+    sps_reader.ReadExpGolomb();       // pframe_crop_left_offset
+    sps_reader.ReadExpGolomb();       // pframe_crop_right_offset
+    sps_reader.ReadExpGolomb();       // pframe_crop_top_offset
+    sps_reader.ReadExpGolomb();       // pframe_crop_bottom_offset
+  }
+  if (sps_reader.ReadBits(1) == 0)  // vui_parameters_present_flag
+    return {0, 0};  // Values we want aren't there, return unknown.
+  // Finally, the thing we actually care about, display parameters.
+  return GetSarFromVuiParameters(&sps_reader);
+}
+
+Rational<uint32_t> GetSarFromHevc(const std::vector<uint8_t>& extra_data) {
+  util::BufferReader reader(extra_data.data(), extra_data.size());
+  // The H.265 extra data is a HEVCDecoderConfigurationRecord from
+  // Section 8.3.3.1.2 in ISO/IEC 14496-15
+  reader.Skip(22);
+  const uint8_t num_of_arrays = reader.ReadUint8();
+  uint64_t nalu_length = 0;
+  bool found = false;
+  for (uint8_t i = 0; i < num_of_arrays && !found; i++) {
+    const uint8_t nalu_type = reader.ReadUint8() & 0x3f;
+    const uint64_t num_nalus = reader.ReadBits(16);
+    for (uint64_t i = 0; i < num_nalus; i++) {
+      nalu_length = reader.ReadBits(16);
+      // Find the first SPS NALU.  Since this stream should only have one video
+      // stream, all SPS should be compatible.
+      if (nalu_type == 33) {
+        found = true;
+        break;
+      }
+      reader.Skip(nalu_length);
+    }
+  }
+  if (!found)
+    return {0, 0};  // No SPS found, return unknown.
+
+  // This is an SPS NALU; remove the emulation prevention bytes.
+  // See H.265 Sec. 7.3.1.2/7.3.2.2.1.
+  std::vector<uint8_t> temp(nalu_length);
+  RemoveEmulationPrevention(reader.data(), nalu_length, &temp);
+  util::BufferReader sps_reader(temp.data(), temp.size());
+  const uint64_t nalu_type = (sps_reader.ReadBits(16) >> 9) & 0x3f;
+  if (nalu_type != 33) {
+    LOG(DFATAL) << "Invalid NALU type found in extra data";
+    return {0, 0};
+  }
+
+  sps_reader.SkipBits(4);  // sps_video_parameter_set_id
+  const uint64_t max_sub_layers_minus1 = sps_reader.ReadBits(3);
+  sps_reader.SkipBits(1);  // sps_temporal_id_nesting_flag
+  SkipHevcProfileTierLevel(/* profile_present= */ true, max_sub_layers_minus1,
+                           &sps_reader);
+  sps_reader.ReadExpGolomb();           // sps_seq_parameter_set_id
+  if (sps_reader.ReadExpGolomb() == 3)  // chroma_format_idc
+    sps_reader.SkipBits(1);             // separate_colour_plane_flag
+  sps_reader.ReadExpGolomb();           // pic_width_in_luma_samples
+  sps_reader.ReadExpGolomb();           // pic_height_in_luma_samples
+  if (sps_reader.ReadBits(1) == 1) {    // conformance_window_flag
+    sps_reader.ReadExpGolomb();         // conf_win_left_offset
+    sps_reader.ReadExpGolomb();         // conf_win_right_offset
+    sps_reader.ReadExpGolomb();         // conf_win_top_offset
+    sps_reader.ReadExpGolomb();         // conf_win_bottom_offset
+  }
+  sps_reader.ReadExpGolomb();  // bit_depth_luma_minus8
+  sps_reader.ReadExpGolomb();  // bit_depth_chroma_minus8
+  sps_reader.ReadExpGolomb();  // log2_max_pic_order_cnt_lsb_minus4
+  const uint64_t sub_layer_ordering_info_present = sps_reader.ReadBits(1);
+  for (uint64_t i =
+           (sub_layer_ordering_info_present ? 0 : max_sub_layers_minus1);
+       i <= max_sub_layers_minus1; i++) {
+    sps_reader.ReadExpGolomb();  // sps_max_dec_pic_buffering_minus1
+    sps_reader.ReadExpGolomb();  // sps_max_num_reorder_pics
+    sps_reader.ReadExpGolomb();  // ps_max_latency_increase_plus1
+  }
+  sps_reader.ReadExpGolomb();  // log2_min_luma_coding_block_size_minus3
+  sps_reader.ReadExpGolomb();  // log2_diff_max_min_luma_coding_block_size
+  sps_reader.ReadExpGolomb();  // log2_min_luma_transform_block_size_minus2
+  sps_reader.ReadExpGolomb();  // log2_diff_max_min_luma_transform_block_size
+  sps_reader.ReadExpGolomb();  // max_transform_hierarchy_depth_inter
+  sps_reader.ReadExpGolomb();  // max_transform_hierarchy_depth_intra
+  if (sps_reader.ReadBits(1) == 1) {  // scaling_list_enabled_flag
+    LOG(WARNING) << "Scaling list isn't supported";
+    return {0, 0};
+  }
+  sps_reader.SkipBits(1);             // amp_enabled_flag
+  sps_reader.SkipBits(1);             // sample_adaptive_offset_enabled_flag
+  if (sps_reader.ReadBits(1) == 1) {  // pcm_enabled_flag
+    sps_reader.ReadBits(4);           // pcm_sample_bit_depth_luma_minus1
+    sps_reader.ReadBits(4);           // pcm_sample_bit_depth_chroma_minus1
+    sps_reader.ReadExpGolomb();  // log2_min_pcm_luma_coding_block_size_minus3
+    sps_reader.ReadExpGolomb();  // log2_diff_max_min_pcm_luma_coding_block_size
+  }
+  const uint64_t num_short_term_ref_pic_sets = sps_reader.ReadExpGolomb();
+  if (num_short_term_ref_pic_sets != 0) {
+    LOG(WARNING) << "Short-term reference pictures not supported";
+    return {0, 0};
+  }
+  if (sps_reader.ReadBits(1) == 1) {  // long_term_ref_pics_present_flag
+    const uint64_t num_long_term_ref_pics_sps = sps_reader.ReadExpGolomb();
+    for (uint64_t i = 0; i < num_long_term_ref_pics_sps; i++) {
+      sps_reader.ReadExpGolomb();  // lt_ref_pic_poc_lsb_sps
+      sps_reader.ReadBits(1);      // used_by_curr_pic_lt_sps_flag
+    }
+  }
+  sps_reader.ReadBits(1);           // sps_temporal_mvp_enabled_flag
+  sps_reader.ReadBits(1);           // strong_intra_smoothing_enabled_flag
+  if (sps_reader.ReadBits(1) != 1)  // vui_parameters_present_flag
+    return {0, 0};  // The info we want isn't there, return unknown.
+  return GetSarFromVuiParameters(&sps_reader);
+}
+
+
+uint8_t GetCodecBitDepth(const std::string& codec) {
+  const std::vector<std::string> parts = util::StringSplit(codec, '.');
+  const std::string& type = parts[0];
+  if (type == "vp09" || type == "av01") {
+    // e.g. "vp09.02.10.10" or "av01.0.04M.10"; the fourth part is the depth.
+    return parts.size() > 3
+               ? static_cast<uint8_t>(strtol(parts[3].c_str(), nullptr, 10))
+               : 0;
+  }
+  if (type == "hvc1" || type == "hev1") {
+    // e.g. "hvc1.2.4.L153.B0"; the profile may have a profile space prefix.
+    // Profile 2 is Main 10; Main and Main Still Picture are 8-bit.
+    if (parts.size() < 2 || parts[1].empty())
+      return 0;
+    const size_t offset = isalpha(parts[1][0]) ? 1 : 0;
+    const long profile =  // NOLINT
+        strtol(parts[1].c_str() + offset, nullptr, 10);
+    if (profile == 2)
+      return 10;
+    return profile == 1 || profile == 3 ? 8 : 0;
+  }
+  if (type == "dvh1" || type == "dvhe") {
+    // Dolby Vision over HEVC is always 10-bit.
+    return 10;
+  }
+  if (type == "avc1" || type == "avc3") {
+    // e.g. "avc1.6e0028"; the first byte is the profile and High 10 is 110.
+    if (parts.size() < 2 || parts[1].size() < 2)
+      return 0;
+    const long profile =  // NOLINT
+        strtol(parts[1].substr(0, 2).c_str(), nullptr, 16);
+    return profile == 110 ? 10 : 8;
+  }
+  return 0;
+}
+
+bool ParseColorInformation(const uint8_t* data, size_t size,
+                           HdrMetadata* metadata) {
+  util::BufferReader reader(data, size);
+  if (reader.BytesRemaining() < 4)
+    return false;
+  if (reader.ReadUint32() != 0x6e636c78)  // 'nclx'
+    return true;
+  if (reader.BytesRemaining() < 7)
+    return false;
+
+  // The fields are 16 bits, but the code points are all less than 256.
+  metadata->color_primaries = static_cast<uint8_t>(reader.ReadBits(16));
+  metadata->transfer_characteristics =
+      static_cast<uint8_t>(reader.ReadBits(16));
+  metadata->matrix_coefficients = static_cast<uint8_t>(reader.ReadBits(16));
+  metadata->full_range = (reader.ReadUint8() & 0x80) != 0;
+  return true;
+}
+
+bool ParseMasteringDisplay(const uint8_t* data, size_t size,
+                           HdrMetadata* metadata) {
+  util::BufferReader reader(data, size);
+  if (reader.BytesRemaining() < 24)
+    return false;
+
+  for (size_t i = 0; i < 3; i++) {
+    metadata->display_primaries_x[i] =
+        static_cast<uint16_t>(reader.ReadBits(16));
+    metadata->display_primaries_y[i] =
+        static_cast<uint16_t>(reader.ReadBits(16));
+  }
+  metadata->white_point_x = static_cast<uint16_t>(reader.ReadBits(16));
+  metadata->white_point_y = static_cast<uint16_t>(reader.ReadBits(16));
+  metadata->max_display_mastering_luminance = reader.ReadUint32();
+  metadata->min_display_mastering_luminance = reader.ReadUint32();
+  metadata->has_mastering_display = true;
+  return true;
+}
+
+bool ParseContentLightLevel(const uint8_t* data, size_t size,
+                            HdrMetadata* metadata) {
+  util::BufferReader reader(data, size);
+  if (reader.BytesRemaining() < 4)
+    return false;
+
+  metadata->max_content_light_level =
+      static_cast<uint16_t>(reader.ReadBits(16));
+  metadata->max_frame_average_light_level =
+      static_cast<uint16_t>(reader.ReadBits(16));
+  metadata->has_content_light_level = true;
+  return true;
+}
 
 BufferedRanges IntersectionOfBufferedRanges(
     const std::vector<BufferedRanges>& sources) {
@@ -198,5 +591,84 @@ std::pair<uint32_t, uint32_t> GetScreenResolution() {
 }
 #endif
 
+uint64_t GetPhysicalMemory() {
+#if defined(OS_POSIX) && defined(_SC_PHYS_PAGES)
+  const long pages = sysconf(_SC_PHYS_PAGES);  // NOLINT(runtime/int)
+  const long page_size = sysconf(_SC_PAGESIZE);  // NOLINT(runtime/int)
+  if (pages > 0 && page_size > 0)
+    return static_cast<uint64_t>(pages) * static_cast<uint64_t>(page_size);
+#endif
+  return 0;
+}
+
+void SetMemoryPressure(JsManager::MemoryPressure pressure) {
+  memory_pressure.store(pressure, std::memory_order_relaxed);
+}
+
+JsManager::MemoryPressure GetMemoryPressure() {
+  return memory_pressure.load(std::memory_order_relaxed);
+}
+
+double GetMemoryPressureFactor(JsManager::MemoryPressure pressure) {
+  switch (pressure) {
+    case JsManager::MemoryPressure::Moderate:
+      return 0.5;
+    case JsManager::MemoryPressure::Critical:
+      return 0.25;
+    default:
+      return 1;
+  }
+}
+
+DecodeAheadPolicy GetEffectiveDecodeAheadPolicy(
+    const DecodeAheadPolicy& policy, JsManager::MemoryPressure pressure,
+    uint64_t physical_memory) {
+  DecodeAheadPolicy ret = policy;
+  if (ret.bytes == 0)
+    ret.bytes = physical_memory / kPhysicalMemoryDivisor;
+
+  // A limit of 0 means "no limit", so don't let the scaling reach 0.
+  const double factor = GetMemoryPressureFactor(pressure);
+  ret.seconds *= factor;
+  if (ret.frames > 0)
+    ret.frames = std::max(1u, static_cast<uint32_t>(ret.frames * factor));
+  if (ret.bytes > 0) {
+    ret.bytes =
+        std::max<uint64_t>(1, static_cast<uint64_t>(ret.bytes * factor));
+  }
+  return ret;
+}
+
+void SetSourceBufferQuota(const JsManager::SourceBufferQuota& quota) {
+  video_quota_bytes.store(quota.video_bytes, std::memory_order_relaxed);
+  audio_quota_bytes.store(quota.audio_bytes, std::memory_order_relaxed);
+  evict_played_media.store(quota.evict_played_media,
+                           std::memory_order_relaxed);
+}
+
+JsManager::SourceBufferQuota GetSourceBufferQuota() {
+  JsManager::SourceBufferQuota ret;
+  ret.video_bytes = video_quota_bytes.load(std::memory_order_relaxed);
+  ret.audio_bytes = audio_quota_bytes.load(std::memory_order_relaxed);
+  ret.evict_played_media = evict_played_media.load(std::memory_order_relaxed);
+  return ret;
+}
+
+uint64_t GetEffectiveSourceBufferQuota(
+    const JsManager::SourceBufferQuota& quota, bool is_video,
+    JsManager::MemoryPressure pressure, uint64_t physical_memory) {
+  uint64_t ret = is_video ? quota.video_bytes : quota.audio_bytes;
+  if (ret == 0) {
+    ret = physical_memory /
+          (is_video ? kVideoQuotaDivisor : kAudioQuotaDivisor);
+  }
+  if (ret == 0)
+    return 0;
+
+  // A limit of 0 means "no limit", so don't let the scaling reach 0.
+  return std::max<uint64_t>(
+      1, static_cast<uint64_t>(ret * GetMemoryPressureFactor(pressure)));
+}
+
 }  // namespace media
 }  // namespace shaka
@@ -21,7 +21,11 @@
 #include <utility>
 #include <vector>
 
+#include "shaka/js_manager.h"
+#include "shaka/media/default_media_player.h"
 #include "shaka/media/media_capabilities.h"
+#include "shaka/media/stream_info.h"
+#include "shaka/utils.h"
 #include "src/js/js_error.h"
 #include "src/media/types.h"
 #include "src/util/utils.h"
@@ -52,6 +56,52 @@ std::string NormalizeContainer(const std::string& container);
 /** @return The codec converted to the name FFmpeg expects. */
 std::string NormalizeCodec(const std::string& codec);
 
+/**
+ * Parses the sample aspect ratio from the SPS in the given H.264 extra data
+ * (an AVCDecoderConfigurationRecord).
+ * @return The sample aspect ratio, or 0/0 if it isn't known.
+ */
+Rational<uint32_t> GetSarFromH264(const std::vector<uint8_t>& extra_data);
+
+/**
+ * Parses the sample aspect ratio from the SPS in the given H.265 extra data
+ * (a HEVCDecoderConfigurationRecord).
+ * @return The sample aspect ratio, or 0/0 if it isn't known.
+ */
+Rational<uint32_t> GetSarFromHevc(const std::vector<uint8_t>& extra_data);
+
+/**
+ * Gets the number of bits per component of the given codec string, e.g. 10 for
+ * "hvc1.2.4.L153.B0" (HEVC Main 10).
+ * @return The bit depth, or 0 if it isn't known.
+ */
+uint8_t GetCodecBitDepth(const std::string& codec);
+
+/**
+ * Parses the contents of an MP4 'colr' box (ISO/IEC 14496-12 Sec. 12.1.5) into
+ * the given metadata.  Only the 'nclx' colour type holds code points; other
+ * types (ICC profiles) are ignored.
+ * @return False if the box is invalid.
+ */
+bool ParseColorInformation(const uint8_t* data, size_t size,
+                           HdrMetadata* metadata);
+
+/**
+ * Parses the contents of an MP4 'mdcv' box (ISO/IEC 23001-8), which holds the
+ * SMPTE ST 2086 mastering display color volume, into the given metadata.
+ * @return False if the box is invalid.
+ */
+bool ParseMasteringDisplay(const uint8_t* data, size_t size,
+                           HdrMetadata* metadata);
+
+/**
+ * Parses the contents of an MP4 'clli' box (ISO/IEC 23001-8), which holds the
+ * CTA-861.3 content light level, into the given metadata.
+ * @return False if the box is invalid.
+ */
+bool ParseContentLightLevel(const uint8_t* data, size_t size,
+                            HdrMetadata* metadata);
+
 /**
  * Returns the buffered ranges that represent the regions that are buffered in
  * all of the given sources.
@@ -72,6 +122,55 @@ MediaDecodingConfiguration ConvertMimeToDecodingConfiguration(
 /** @return the resolution of the screen. */
 std::pair<uint32_t, uint32_t> GetScreenResolution();
 
+/** @return The amount of physical memory on the device, or 0 if unknown. */
+uint64_t GetPhysicalMemory();
+
+/** Sets the memory pressure the device is under.  This is thread-safe. */
+void SetMemoryPressure(JsManager::MemoryPressure pressure);
+
+/** @return The memory pressure the device is under.  This is thread-safe. */
+JsManager::MemoryPressure GetMemoryPressure();
+
+/**
+ * @return The amount that decoding limits (e.g. how far to decode ahead) are
+ *   scaled by under the given memory pressure.
+ */
+double GetMemoryPressureFactor(JsManager::MemoryPressure pressure);
+
+/**
+ * Gets the decode-ahead limits to use under the given memory pressure.  This
+ * fills in the default byte limit based on the physical memory, then reduces
+ * each limit based on the memory pressure.
+ *
+ * @param policy The policy that was configured for the stream.
+ * @param pressure The memory pressure the device is under.
+ * @param physical_memory The amount of physical memory, or 0 if unknown.
+ */
+DecodeAheadPolicy GetEffectiveDecodeAheadPolicy(
+    const DecodeAheadPolicy& policy, JsManager::MemoryPressure pressure,
+    uint64_t physical_memory);
+
+/** Sets the limits on the size of SourceBuffers.  This is thread-safe. */
+void SetSourceBufferQuota(const JsManager::SourceBufferQuota& quota);
+
+/** @return The limits on the size of SourceBuffers.  This is thread-safe. */
+JsManager::SourceBufferQuota GetSourceBufferQuota();
+
+/**
+ * Gets the number of bytes a SourceBuffer can hold.  This fills in the default
+ * limit based on the physical memory, then reduces it based on the memory
+ * pressure.
+ *
+ * @param quota The limits that were configured.
+ * @param is_video Whether the SourceBuffer holds video.
+ * @param pressure The memory pressure the device is under.
+ * @param physical_memory The amount of physical memory, or 0 if unknown.
+ * @return The limit, in bytes, or 0 if there is no limit.
+ */
+uint64_t GetEffectiveSourceBufferQuota(
+    const JsManager::SourceBufferQuota& quota, bool is_video,
+    JsManager::MemoryPressure pressure, uint64_t physical_memory);
+
 }  // namespace media
 }  // namespace shaka
 
@@ -0,0 +1,935 @@
+// Copyright 2020 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     https://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "src/media/mp2t/ts_demuxer.h"
+
+#include <glog/logging.h>
+#include <math.h>
+#include <string.h>
+
+#include <algorithm>
+#include <unordered_map>
+#include <utility>
+
+#if defined(__SSE2__) || defined(_M_X64)
+#  include <emmintrin.h>
+#  define USE_SSE2
+#elif defined(__aarch64__) && defined(__ARM_NEON)
+#  include <arm_neon.h>
+#  define USE_NEON
+#endif
+
+#include "src/media/media_utils.h"
+#include "src/media/segment_encoded_frame.h"
+#include "src/memory/pool_allocator.h"
+#include "src/util/buffer_reader.h"
+
+namespace shaka {
+namespace media {
+namespace mp2t {
+
+namespace {
+
+// See ISO/IEC 13818-1 Sec. 2.4.3.
+constexpr const size_t kPacketSize = 188;
+constexpr const uint8_t kSyncByte = 0x47;
+constexpr const int kPatPid = 0;
+constexpr const uint8_t kPatTableId = 0x00;
+constexpr const uint8_t kPmtTableId = 0x02;
+
+// See ISO/IEC 13818-1 Table 2-34 and the HLS Sample Encryption spec.
+constexpr const uint8_t kStreamTypeAdts = 0x0f;
+constexpr const uint8_t kStreamTypeH264 = 0x1b;
+constexpr const uint8_t kStreamTypeAdtsSampleAes = 0xcf;
+constexpr const uint8_t kStreamTypeH264SampleAes = 0xdb;
+
+/** The PES timestamps are in 90kHz units and are 33 bits. */
+constexpr const uint32_t kTimescale = 90000;
+constexpr const int64_t kTimestampWrap = INT64_C(1) << 33;
+
+// See H.264 Table 7-1.
+constexpr const uint8_t kNaluSlice = 1;
+constexpr const uint8_t kNaluIdr = 5;
+constexpr const uint8_t kNaluSps = 7;
+constexpr const uint8_t kNaluPps = 8;
+constexpr const uint8_t kNaluAud = 9;
+
+/** The size of the NAL unit lengths we write. */
+constexpr const size_t kNaluLengthSize = 4;
+
+/** The number of samples in an AAC frame. */
+constexpr const uint32_t kAacFrameSamples = 1024;
+
+/** See ISO/IEC 14496-3 Table 1.18. */
+constexpr const uint32_t kAacSampleRates[] = {
+    96000, 88200, 64000, 48000, 44100, 32000, 24000,
+    22050, 16000, 12000, 11025, 8000,  7350,
+};
+constexpr const size_t kAacSampleRateCount =
+    sizeof(kAacSampleRates) / sizeof(kAacSampleRates[0]);
+
+// See the HLS Sample Encryption spec.  The start of each frame or NAL unit is
+// left clear, then the following 16-byte blocks are encrypted.  For video, only
+// one in ten blocks is encrypted; a trailing block of 16 bytes or less is left
+// clear.
+constexpr const size_t kAesBlockSize = 16;
+constexpr const size_t kSampleAesVideoLeader = 32;
+constexpr const size_t kSampleAesVideoMinSize = 48;
+constexpr const size_t kSampleAesAudioLeader = 16;
+
+/** Reads a 33-bit PES timestamp.  See ISO/IEC 13818-1 Sec. 2.4.3.7. */
+uint64_t ReadTimestamp(const uint8_t* data) {
+  return (static_cast<uint64_t>(data[0] & 0x0e) << 29) |
+         (static_cast<uint64_t>(data[1]) << 22) |
+         (static_cast<uint64_t>(data[2] & 0xfe) << 14) |
+         (static_cast<uint64_t>(data[3]) << 7) |
+         (static_cast<uint64_t>(data[4]) >> 1);
+}
+
+void WriteUint32(uint32_t value, uint8_t* dest) {
+  dest[0] = static_cast<uint8_t>(value >> 24);
+  dest[1] = static_cast<uint8_t>(value >> 16);
+  dest[2] = static_cast<uint8_t>(value >> 8);
+  dest[3] = static_cast<uint8_t>(value);
+}
+
+/**
+ * Finds the next 0x000001 start code in the given H.264 data.  Most of a frame
+ * is slice data without zero bytes, so this skips over chunks without any
+ * zeros, which can't contain a start code.
+ *
+ * @return The offset of the start code, or |size| if there isn't one.
+ */
+size_t FindStartCode(const uint8_t* data, size_t size) {
+  size_t i = 0;
+  while (i + 3 <= size) {
+#if defined(USE_SSE2)
+    const __m128i zero = _mm_setzero_si128();
+    while (i + 16 <= size) {
+      const __m128i chunk =
+          _mm_loadu_si128(reinterpret_cast<const __m128i*>(data + i));
+      if (_mm_movemask_epi8(_mm_cmpeq_epi8(chunk, zero)) != 0)
+        break;
+      i += 16;
+    }
+#elif defined(USE_NEON)
+    while (i + 16 <= size) {
+      if (vminvq_u8(vld1q_u8(data + i)) == 0)
+        break;
+      i += 16;
+    }
+#else
+    while (i + 8 <= size) {
+      uint64_t chunk;
+      memcpy(&chunk, data + i, sizeof(chunk));
+      if ((chunk - 0x0101010101010101ULL) & ~chunk & 0x8080808080808080ULL)
+        break;
+      i += 8;
+    }
+#endif
+
+    // Move to the zero byte that stopped the search, or check the tail.
+    while (i + 3 <= size && data[i] != 0)
+      i++;
+    if (i + 3 > size)
+      break;
+    if (data[i + 1] == 0 && data[i + 2] == 1)
+      return i;
+    i++;
+  }
+  return size;
+}
+
+/**
+ * Copies the given NAL unit while removing the emulation prevention bytes.
+ * See H.264 Sec. 7.4.1.
+ *
+ * @return The number of bytes written.
+ */
+size_t CopyWithoutEmulationPrevention(const uint8_t* data, size_t size,
+                                      uint8_t* dest) {
+  size_t out_pos = 0;
+  for (size_t in_pos = 0; in_pos < size;) {
+    if (in_pos + 2 < size && data[in_pos] == 0 && data[in_pos + 1] == 0 &&
+        data[in_pos + 2] == 0x3) {
+      dest[out_pos++] = 0;
+      dest[out_pos++] = 0;
+      in_pos += 3;
+    } else {
+      dest[out_pos++] = data[in_pos++];
+    }
+  }
+  return out_pos;
+}
+
+/**
+ * Parses the frame size from the given H.264 SPS NAL unit.  See H.264
+ * Sec. 7.3.2.1.1 and 7.4.2.1.1.
+ */
+bool ParseSpsSize(const std::vector<uint8_t>& sps, uint32_t* width,
+                  uint32_t* height) {
+  std::vector<uint8_t> temp(sps.size());
+  temp.resize(CopyWithoutEmulationPrevention(sps.data(), sps.size(),
+                                             temp.data()));
+  util::BufferReader reader(temp.data(), temp.size());
+  reader.Skip(1);  // NAL unit header
+  const uint8_t profile_idc = reader.ReadUint8();
+  reader.Skip(2);              // constraint flags and level_idc
+  reader.ReadExpGolomb();      // seq_parameter_set_id
+  uint64_t chroma_format_idc = 1;
+  bool separate_colour_plane = false;
+  if (profile_idc == 100 || profile_idc == 110 || profile_idc == 122 ||
+      profile_idc == 244 || profile_idc == 44 || profile_idc == 83 ||
+      profile_idc == 86 || profile_idc == 118 || profile_idc == 128 ||
+      profile_idc == 138 || profile_idc == 139 || profile_idc == 134) {
+    chroma_format_idc = reader.ReadExpGolomb();
+    if (chroma_format_idc == 3)
+      separate_colour_plane = reader.ReadBits(1) == 1;
+    reader.ReadExpGolomb();  // bit_depth_luma_minus8
+    reader.ReadExpGolomb();  // bit_depth_chroma_minus8
+    reader.SkipBits(1);      // qpprime_y_zero_transform_bypass_flag
+    if (reader.ReadBits(1) == 1) {  // seq_scaling_matrix_present_flag
+      const int count = chroma_format_idc != 3 ? 8 : 12;
+      for (int i = 0; i < count; i++) {
+        if (reader.ReadBits(1) == 0)  // seq_scaling_list_present_flag
+          continue;
+        // scaling_list(); the values are only needed to find where the list
+        // ends.
+        const int size = i < 6 ? 16 : 64;
+        uint64_t last_scale = 8;
+        uint64_t next_scale = 8;
+        for (int j = 0; j < size && next_scale != 0; j++) {
+          const uint64_t code = reader.ReadExpGolomb();  // delta_scale
+          const int64_t delta = (code & 1) ? static_cast<int64_t>(code + 1) / 2
+                                           : -static_cast<int64_t>(code / 2);
+          next_scale = static_cast<uint64_t>(
+              (static_cast<int64_t>(last_scale) + delta + 256) % 256);
+          if (next_scale != 0)
+            last_scale = next_scale;
+        }
+      }
+    }
+  }
+  reader.ReadExpGolomb();  // log2_max_frame_num_minus4
+  const uint64_t pic_order_cnt_type = reader.ReadExpGolomb();
+  if (pic_order_cnt_type == 0) {
+    reader.ReadExpGolomb();  // log2_max_pic_order_cnt_lsb_minus4
+  } else if (pic_order_cnt_type == 1) {
+    reader.SkipBits(1);      // delta_pic_order_always_zero_flag
+    reader.ReadExpGolomb();  // offset_for_non_ref_pic
+    reader.ReadExpGolomb();  // offset_for_top_to_bottom_field
+    const uint64_t count = reader.ReadExpGolomb();
+    for (uint64_t i = 0; i < count && !reader.empty(); i++)
+      reader.ReadExpGolomb();  // offset_for_ref_frame
+  }
+  reader.ReadExpGolomb();  // max_num_ref_frames
+  reader.SkipBits(1);      // gaps_in_frame_num_value_allowed_flag
+  const uint64_t width_in_mbs = reader.ReadExpGolomb() + 1;
+  const uint64_t height_in_map_units = reader.ReadExpGolomb() + 1;
+  const uint64_t frame_mbs_only = reader.ReadBits(1);
+  if (frame_mbs_only == 0)
+    reader.SkipBits(1);  // mb_adaptive_frame_field_flag
+  reader.SkipBits(1);    // direct_8x8_inference_flag
+  uint64_t crop_left = 0;
+  uint64_t crop_right = 0;
+  uint64_t crop_top = 0;
+  uint64_t crop_bottom = 0;
+  if (reader.ReadBits(1) == 1) {  // frame_cropping_flag
+    crop_left = reader.ReadExpGolomb();
+    crop_right = reader.ReadExpGolomb();
+    crop_top = reader.ReadExpGolomb();
+    crop_bottom = reader.ReadExpGolomb();
+  }
+  if (reader.empty())
+    return false;
+
+  // See H.264 Table 6-1 and equations 7-19 to 7-22.
+  const bool has_chroma = chroma_format_idc != 0 && !separate_colour_plane;
+  const uint64_t crop_unit_x = has_chroma && chroma_format_idc != 3 ? 2 : 1;
+  const uint64_t crop_unit_y = (has_chroma && chroma_format_idc == 1 ? 2 : 1) *
+                               (2 - frame_mbs_only);
+  const uint64_t full_width = width_in_mbs * 16;
+  const uint64_t full_height = (2 - frame_mbs_only) * height_in_map_units * 16;
+  const uint64_t crop_width = (crop_left + crop_right) * crop_unit_x;
+  const uint64_t crop_height = (crop_top + crop_bottom) * crop_unit_y;
+  if (crop_width >= full_width || crop_height >= full_height)
+    return false;
+  *width = static_cast<uint32_t>(full_width - crop_width);
+  *height = static_cast<uint32_t>(full_height - crop_height);
+  return true;
+}
+
+/**
+ * Creates an AVCDecoderConfigurationRecord from the given SPS and PPS.  See
+ * ISO/IEC 14496-15 Sec. 5.3.3.1.
+ */
+std::vector<uint8_t> MakeAvcC(const std::vector<uint8_t>& sps,
+                              const std::vector<uint8_t>& pps) {
+  std::vector<uint8_t> ret = {
+      1,  // configurationVersion
+      sps[1],  // AVCProfileIndication
+      sps[2],  // profile_compatibility
+      sps[3],  // AVCLevelIndication
+      0xff,    // lengthSizeMinusOne = 3
+      0xe1,    // numOfSequenceParameterSets = 1
+      static_cast<uint8_t>(sps.size() >> 8),
+      static_cast<uint8_t>(sps.size()),
+  };
+  ret.insert(ret.end(), sps.begin(), sps.end());
+  ret.push_back(1);  // numOfPictureParameterSets
+  ret.push_back(static_cast<uint8_t>(pps.size() >> 8));
+  ret.push_back(static_cast<uint8_t>(pps.size()));
+  ret.insert(ret.end(), pps.begin(), pps.end());
+  return ret;
+}
+
+/**
+ * Gets the single codec in the given MIME type, or an empty string if there
+ * isn't exactly one.
+ */
+std::string GetSingleCodec(const std::string& mime_type) {
+  std::unordered_map<std::string, std::string> params;
+  if (!ParseMimeType(mime_type, nullptr, nullptr, &params))
+    return "";
+  const std::string codecs = params[kCodecMimeParam];
+  if (codecs.find(',') != std::string::npos)
+    return "";
+  return codecs;
+}
+
+}  // namespace
+
+/**
+ * Forwards events from the fallback demuxer so we only raise OnLoadedMetaData
+ * once, even if we switch demuxers.
+ */
+class TsDemuxer::ClientProxy : public Demuxer::Client {
+ public:
+  explicit ClientProxy(TsDemuxer* demuxer) : demuxer_(demuxer) {}
+
+  void OnLoadedMetaData(double duration) override {
+    demuxer_->RaiseLoadedMetaData(duration);
+  }
+
+  void OnEncrypted(eme::MediaKeyInitDataType type, const uint8_t* data,
+                   size_t size) override {
+    if (demuxer_->client_)
+      demuxer_->client_->OnEncrypted(type, data, size);
+  }
+
+ private:
+  TsDemuxer* const demuxer_;
+};
+
+
+TsDemuxer::TsDemuxer(Demuxer::Client* client, const std::string& mime_type,
+                     const DemuxerFactory* fallback_factory)
+    : client_(client),
+      fallback_factory_(fallback_factory),
+      use_fallback_(false),
+      mime_type_(mime_type),
+      expected_codec_(GetSingleCodec(mime_type)),
+      sent_loaded_meta_data_(false),
+      pmt_pid_(-1),
+      es_pid_(-1),
+      is_video_(false),
+      is_encrypted_(false),
+      last_continuity_counter_(-1),
+      has_last_timestamp_(false),
+      last_timestamp_(0),
+      last_video_duration_(0) {}
+
+TsDemuxer::~TsDemuxer() {}
+
+bool TsDemuxer::SwitchType(const std::string& mime_type) {
+  mime_type_ = mime_type;
+  expected_codec_ = GetSingleCodec(mime_type);
+  return !fallback_ || fallback_->SwitchType(mime_type);
+}
+
+void TsDemuxer::Reset() {
+  // Keep the stream info since media segments may follow with the same
+  // parameter sets.
+  pending_.clear();
+  pes_.clear();
+  pending_frames_.clear();
+  last_continuity_counter_ = -1;
+  has_last_timestamp_ = false;
+  next_audio_pts_ = nullopt;
+  use_fallback_ = false;
+  if (fallback_)
+    fallback_->Reset();
+}
+
+bool TsDemuxer::Demux(double timestamp_offset, const uint8_t* data,
+                      size_t size,
+                      std::vector<std::shared_ptr<EncodedFrame>>* frames) {
+  if (use_fallback_)
+    return fallback_->Demux(timestamp_offset, data, size, frames);
+
+  // Only copy the input if we need to join it to a partial packet from before.
+  const uint8_t* buffer = data;
+  size_t buffer_size = size;
+  if (!pending_.empty()) {
+    pending_.insert(pending_.end(), data, data + size);
+    buffer = pending_.data();
+    buffer_size = pending_.size();
+  }
+
+  // The frames are written here as the PES packets are completed.
+  segment_ = std::make_shared<EncodedFrameBuffer>();
+  segment_->reserve(buffer_size);
+
+  size_t pos = 0;
+  while (buffer_size - pos >= kPacketSize) {
+    if (buffer[pos] != kSyncByte) {
+      const void* next =
+          memchr(buffer + pos + 1, kSyncByte, buffer_size - pos - 1);
+      const size_t next_pos =
+          next ? static_cast<const uint8_t*>(next) - buffer : buffer_size;
+      LOG(WARNING) << "Lost TS sync, skipping " << (next_pos - pos)
+                   << " bytes";
+      pos = next_pos;
+      continue;
+    }
+
+    bool needs_fallback = false;
+    if (!ParsePacket(buffer + pos, &needs_fallback)) {
+      pending_.clear();
+      pending_frames_.clear();
+      segment_.reset();
+      return false;
+    }
+    if (needs_fallback) {
+      // The fallback reads the whole input again, including the PAT.
+      pending_frames_.clear();
+      segment_.reset();
+      const bool ok = StartFallback(timestamp_offset, buffer, buffer_size,
+                                    frames);
+      pending_.clear();
+      return ok;
+    }
+    pos += kPacketSize;
+  }
+
+  // Video PES packets without a length normally end when the next one starts.
+  // Segments end on a PES boundary, so when the input ends on a packet
+  // boundary the PES packet is complete; otherwise the last frame of each
+  // append would wait for the next one, and the last frame of the stream
+  // would never be output.
+  if (pos == buffer_size && pes_.size() >= 6 && pes_[4] == 0 && pes_[5] == 0 &&
+      !FlushPes()) {
+    pending_.clear();
+    pending_frames_.clear();
+    segment_.reset();
+    return false;
+  }
+
+  OutputFrames(timestamp_offset, frames);
+  if (buffer == data)
+    pending_.assign(data + pos, data + size);
+  else
+    pending_.erase(pending_.begin(), pending_.begin() + pos);
+  return true;
+}
+
+bool TsDemuxer::ParsePacket(const uint8_t* packet, bool* needs_fallback) {
+  // See ISO/IEC 13818-1 Sec. 2.4.3.2.
+  const bool payload_start = (packet[1] & 0x40) != 0;
+  const int pid = ((packet[1] & 0x1f) << 8) | packet[2];
+  const uint8_t adaptation_field_control = (packet[3] >> 4) & 0x3;
+  const int continuity_counter = packet[3] & 0xf;
+
+  size_t offset = 4;
+  if (adaptation_field_control & 0x2)
+    offset += 1 + packet[4];
+  if ((adaptation_field_control & 0x1) == 0 || offset >= kPacketSize)
+    return true;
+  const uint8_t* payload = packet + offset;
+  const size_t payload_size = kPacketSize - offset;
+
+  if (pid == kPatPid || pid == pmt_pid_) {
+    // The PSI we need fits in a single packet, so we only need the start.
+    if (!payload_start)
+      return true;
+    return ParsePsi(payload, payload_size, pid == kPatPid, needs_fallback);
+  }
+  if (pid != es_pid_)
+    return true;
+
+  if (last_continuity_counter_ >= 0 &&
+      continuity_counter != ((last_continuity_counter_ + 1) & 0xf)) {
+    // A packet may be sent twice in a row.
+    if (continuity_counter == last_continuity_counter_)
+      return true;
+    if (!pes_.empty()) {
+      LOG(WARNING) << "TS continuity error, dropping partial PES packet";
+      pes_.clear();
+    }
+  }
+  last_continuity_counter_ = continuity_counter;
+
+  if (payload_start) {
+    // Video PES packets often don't have a length, so they end when the next
+    // one starts.
+    if (!pes_.empty() && !FlushPes())
+      return false;
+    pes_.assign(payload, payload + payload_size);
+  } else if (!pes_.empty()) {
+    pes_.insert(pes_.end(), payload, payload + payload_size);
+  }
+
+  if (pes_.size() >= 6) {
+    const size_t length = (pes_[4] << 8) | pes_[5];
+    if (length != 0 && pes_.size() >= length + 6) {
+      pes_.resize(length + 6);
+      return FlushPes();
+    }
+  }
+  return true;
+}
+
+bool TsDemuxer::ParsePsi(const uint8_t* payload, size_t size, bool is_pat,
+                         bool* needs_fallback) {
+  // See ISO/IEC 13818-1 Sec. 2.4.4.
+  const size_t pointer_field = payload[0];
+  if (pointer_field + 4 > size) {
+    LOG(ERROR) << "Invalid PSI pointer field";
+    return false;
+  }
+  const uint8_t* section = payload + 1 + pointer_field;
+  const size_t remaining = size - 1 - pointer_field;
+  const size_t section_length = ((section[1] & 0xf) << 8) | section[2];
+  if (section_length + 3 > remaining) {
+    VLOG(1) << "PSI sections that span TS packets aren't supported";
+    *needs_fallback = true;
+    return true;
+  }
+  // The section header after the length is 5 bytes and ends with a CRC.
+  if (section_length < 9) {
+    LOG(ERROR) << "Invalid PSI section";
+    return false;
+  }
+
+  if (!is_pat)
+    return section[0] != kPmtTableId ||
+           ParsePmt(section, section_length + 3, needs_fallback);
+  if (section[0] != kPatTableId)
+    return true;
+
+  // See ISO/IEC 13818-1 Sec. 2.4.4.3.  Only the first program is used.
+  const uint8_t* end = section + section_length + 3 - 4;
+  for (const uint8_t* entry = section + 8; entry + 4 <= end; entry += 4) {
+    const int program_number = (entry[0] << 8) | entry[1];
+    if (program_number != 0) {
+      pmt_pid_ = ((entry[2] & 0x1f) << 8) | entry[3];
+      break;
+    }
+  }
+  return true;
+}
+
+bool TsDemuxer::ParsePmt(const uint8_t* section, size_t size,
+                         bool* needs_fallback) {
+  // See ISO/IEC 13818-1 Sec. 2.4.4.8.
+  util::BufferReader reader(section, size - 4);  // Don't include the CRC.
+  reader.Skip(10);  // table_id through PCR_PID
+  const size_t program_info_length = reader.ReadBits(16) & 0xfff;
+  reader.Skip(program_info_length);
+
+  const std::string codec = NormalizeCodec(expected_codec_);
+  int pid = -1;
+  uint8_t stream_type = 0;
+  while (reader.BytesRemaining() >= 5) {
+    const uint8_t type = reader.ReadUint8();
+    const int es_pid = static_cast<int>(reader.ReadBits(16) & 0x1fff);
+    reader.Skip(reader.ReadBits(16) & 0xfff);  // descriptors
+    const bool is_h264 =
+        type == kStreamTypeH264 || type == kStreamTypeH264SampleAes;
+    const bool is_aac =
+        type == kStreamTypeAdts || type == kStreamTypeAdtsSampleAes;
+    if ((codec == "h264" && is_h264) || (codec == "aac" && is_aac)) {
+      pid = es_pid;
+      stream_type = type;
+      break;
+    }
+  }
+  if (pid < 0) {
+    VLOG(1) << "No supported stream for codec '" << expected_codec_ << "'";
+    *needs_fallback = true;
+    return true;
+  }
+
+  if (pid != es_pid_) {
+    pes_.clear();
+    last_continuity_counter_ = -1;
+  }
+  es_pid_ = pid;
+  is_video_ = codec == "h264";
+  is_encrypted_ = stream_type == kStreamTypeH264SampleAes ||
+                  stream_type == kStreamTypeAdtsSampleAes;
+  RaiseLoadedMetaData(HUGE_VAL);
+  return true;
+}
+
+bool TsDemuxer::FlushPes() {
+  // See ISO/IEC 13818-1 Sec. 2.4.3.6.
+  if (pes_.size() < 9 || pes_[0] != 0 || pes_[1] != 0 || pes_[2] != 1 ||
+      pes_.size() < 9u + pes_[8]) {
+    LOG(WARNING) << "Dropping invalid PES packet";
+    pes_.clear();
+    return true;
+  }
+
+  const uint8_t pts_dts_flags = pes_[7] >> 6;
+  const size_t header_size = 9 + pes_[8];
+  optional<double> pts;
+  optional<double> dts;
+  if ((pts_dts_flags & 0x2) && header_size >= 14) {
+    pts = UnwrapTimestamp(ReadTimestamp(&pes_[9])) /
+          static_cast<double>(kTimescale);
+    dts = pts;
+    if (pts_dts_flags == 0x3 && header_size >= 19) {
+      dts = UnwrapTimestamp(ReadTimestamp(&pes_[14])) /
+            static_cast<double>(kTimescale);
+    }
+  }
+
+  bool ok;
+  if (is_video_) {
+    if (pts.has_value()) {
+      ok = ParseH264(pts.value(), dts.value(), pes_.data() + header_size,
+                     pes_.size() - header_size);
+    } else {
+      LOG(WARNING) << "Dropping H.264 frame without a timestamp";
+      ok = true;
+    }
+  } else {
+    ok = ParseAdts(pts, pes_.data() + header_size, pes_.size() - header_size);
+  }
+  pes_.clear();
+  return ok;
+}
+
+bool TsDemuxer::ParseH264(double pts, double dts, const uint8_t* data,
+                          size_t size) {
+  // Convert the Annex B frame to use NAL unit lengths.  This only grows by one
+  // byte for each 3-byte start code.
+  const size_t start = segment_->size();
+  std::vector<uint8_t> sps;
+  std::vector<uint8_t> pps;
+  std::vector<eme::SubsampleInfo> subsamples;
+  size_t clear_bytes = 0;
+  bool is_key_frame = false;
+
+  size_t pos = FindStartCode(data, size);
+  while (pos < size) {
+    const size_t nalu_start = pos + 3;
+    pos = nalu_start + FindStartCode(data + nalu_start, size - nalu_start);
+    // Zero bytes before the next start code aren't part of this NAL unit.
+    size_t nalu_end = pos;
+    while (nalu_end > nalu_start && data[nalu_end - 1] == 0)
+      nalu_end--;
+    if (nalu_end == nalu_start)
+      continue;
+
+    const uint8_t* nalu = data + nalu_start;
+    const size_t nalu_size = nalu_end - nalu_start;
+    const uint8_t type = nalu[0] & 0x1f;
+    if (type == kNaluAud)
+      continue;
+    if (type == kNaluSps && sps.empty())
+      sps.assign(nalu, nalu + nalu_size);
+    else if (type == kNaluPps && pps.empty())
+      pps.assign(nalu, nalu + nalu_size);
+    else if (type == kNaluIdr)
+      is_key_frame = true;
+
+    const size_t length_pos = segment_->size();
+    segment_->resize(length_pos + kNaluLengthSize + nalu_size);
+    uint8_t* dest = segment_->data() + length_pos + kNaluLengthSize;
+    size_t written = nalu_size;
+    if (is_encrypted_ && (type == kNaluSlice || type == kNaluIdr) &&
+        nalu_size > kSampleAesVideoMinSize) {
+      // The emulation prevention bytes are added after encrypting, so they
+      // need to be removed to get the encrypted data.
+      written = CopyWithoutEmulationPrevention(nalu, nalu_size, dest);
+      segment_->resize(length_pos + kNaluLengthSize + written);
+
+      const size_t leader = std::min(written, kSampleAesVideoLeader);
+      const size_t body = written - leader;
+      const size_t protected_bytes =
+          body > 0 ? (body - 1) / kAesBlockSize * kAesBlockSize : 0;
+      subsamples.emplace_back(
+          static_cast<uint32_t>(clear_bytes + kNaluLengthSize + leader),
+          static_cast<uint32_t>(protected_bytes));
+      clear_bytes = body - protected_bytes;
+    } else {
+      memcpy(dest, nalu, nalu_size);
+      clear_bytes += kNaluLengthSize + nalu_size;
+    }
+    WriteUint32(static_cast<uint32_t>(written), dest - kNaluLengthSize);
+  }
+
+  if (!sps.empty() && !pps.empty() && (sps != sps_ || pps != pps_)) {
+    uint32_t width = 0;
+    uint32_t height = 0;
+    if (sps.size() < 4 || !ParseSpsSize(sps, &width, &height)) {
+      LOG(ERROR) << "Invalid H.264 SPS";
+      segment_->resize(start);
+      return false;
+    }
+    sps_ = std::move(sps);
+    pps_ = std::move(pps);
+    const std::vector<uint8_t> avcc = MakeAvcC(sps_, pps_);
+    UpdateStreamInfo(avcc.data(), avcc.size(), width, height, 0, 0);
+  }
+  if (segment_->size() == start)
+    return true;
+  if (!stream_info_) {
+    VLOG(1) << "Dropping H.264 frame before the first SPS and PPS";
+    segment_->resize(start);
+    return true;
+  }
+
+  std::shared_ptr<eme::FrameEncryptionInfo> encryption_info;
+  if (!subsamples.empty()) {
+    if (clear_bytes > 0)
+      subsamples.emplace_back(static_cast<uint32_t>(clear_bytes), 0);
+    encryption_info = std::make_shared<eme::FrameEncryptionInfo>(
+        eme::EncryptionScheme::AesCbc, eme::EncryptionPattern(1, 9),
+        std::vector<uint8_t>(), std::vector<uint8_t>(), subsamples);
+  }
+
+  PendingFrame frame;
+  frame.stream_info = stream_info_;
+  frame.pts = pts;
+  frame.dts = dts;
+  frame.duration = -1;
+  frame.is_key_frame = is_key_frame;
+  frame.offset = start;
+  frame.size = segment_->size() - start;
+  frame.encryption_info = std::move(encryption_info);
+  pending_frames_.emplace_back(std::move(frame));
+  return true;
+}
+
+bool TsDemuxer::ParseAdts(optional<double> pts, const uint8_t* data,
+                          size_t size) {
+  if (!pts.has_value())
+    pts = next_audio_pts_;
+  if (!pts.has_value()) {
+    LOG(WARNING) << "Dropping AAC frames without a timestamp";
+    return true;
+  }
+
+  // See ISO/IEC 14496-3 Sec. 1.A.2.2.
+  constexpr const size_t kHeaderSize = 7;
+  size_t frame_index = 0;
+  size_t pos = 0;
+  // Whether bytes were skipped to find this header, so it may be a false
+  // syncword inside the frame data.
+  bool resyncing = false;
+  while (size - pos >= kHeaderSize) {
+    const uint8_t* header = data + pos;
+    // Check the syncword and that the layer is 0.
+    if (header[0] != 0xff || (header[1] & 0xf6) != 0xf0) {
+      pos++;
+      resyncing = true;
+      continue;
+    }
+
+    const bool has_crc = (header[1] & 0x1) == 0;
+    const uint8_t profile = header[2] >> 6;
+    const uint8_t frequency_index = (header[2] >> 2) & 0xf;
+    const uint8_t channel_config = ((header[2] & 0x1) << 2) | (header[3] >> 6);
+    const size_t frame_size =
+        ((header[3] & 0x3) << 11) | (header[4] << 3) | (header[5] >> 5);
+    const size_t raw_blocks = (header[6] & 0x3) + 1;
+    const size_t header_size = has_crc ? kHeaderSize + 2 : kHeaderSize;
+    if (frequency_index >= kAacSampleRateCount ||
+        frame_size <= header_size) {
+      VLOG(1) << "Skipping invalid ADTS header";
+      pos++;
+      resyncing = true;
+      continue;
+    }
+    if (resyncing) {
+      // Only accept a header found by skipping bytes if the frame fits and is
+      // followed by another header (or the end).
+      const size_t next = pos + frame_size;
+      if (frame_size > size - pos ||
+          (size - next >= 2 &&
+           (data[next] != 0xff || (data[next + 1] & 0xf6) != 0xf0))) {
+        pos++;
+        continue;
+      }
+      resyncing = false;
+    }
+    if (frame_size > size - pos) {
+      LOG(WARNING) << "Dropping ADTS frame that spans PES packets";
+      break;
+    }
+    if (raw_blocks > 1) {
+      LOG(WARNING) << "Dropping ADTS frame with multiple raw data blocks";
+      pos += frame_size;
+      continue;
+    }
+
+    // Create an AudioSpecificConfig for the stream.  See ISO/IEC 14496-3
+    // Sec. 1.6.2.1.
+    const uint32_t sample_rate = kAacSampleRates[frequency_index];
+    const uint8_t object_type = profile + 1;
+    const uint8_t config[] = {
+        static_cast<uint8_t>((object_type << 3) | (frequency_index >> 1)),
+        static_cast<uint8_t>(((frequency_index & 0x1) << 7) |
+                             (channel_config << 3)),
+    };
+    UpdateStreamInfo(config, sizeof(config), 0, 0, channel_config,
+                     sample_rate);
+
+    const size_t offset = segment_->size();
+    const size_t raw_size = frame_size - header_size;
+    segment_->insert(segment_->end(), header + header_size,
+                     header + frame_size);
+
+    std::shared_ptr<eme::FrameEncryptionInfo> encryption_info;
+    if (is_encrypted_ && raw_size > kSampleAesAudioLeader) {
+      const size_t body = raw_size - kSampleAesAudioLeader;
+      const size_t protected_bytes = body / kAesBlockSize * kAesBlockSize;
+      std::vector<eme::SubsampleInfo> subsamples;
+      subsamples.emplace_back(kSampleAesAudioLeader,
+                              static_cast<uint32_t>(protected_bytes));
+      if (body > protected_bytes) {
+        subsamples.emplace_back(static_cast<uint32_t>(body - protected_bytes),
+                                0);
+      }
+      encryption_info = std::make_shared<eme::FrameEncryptionInfo>(
+          eme::EncryptionScheme::AesCbc, eme::EncryptionPattern(),
+          std::vector<uint8_t>(), std::vector<uint8_t>(), subsamples);
+    }
+
+    const double duration = static_cast<double>(kAacFrameSamples) / sample_rate;
+    PendingFrame frame;
+    frame.stream_info = stream_info_;
+    frame.pts = frame.dts = pts.value() + frame_index * duration;
+    frame.duration = duration;
+    frame.is_key_frame = true;
+    frame.offset = offset;
+    frame.size = raw_size;
+    frame.encryption_info = std::move(encryption_info);
+    pending_frames_.emplace_back(std::move(frame));
+
+    frame_index++;
+    next_audio_pts_ = pts.value() + frame_index * duration;
+    pos += frame_size;
+  }
+  return true;
+}
+
+void TsDemuxer::UpdateStreamInfo(const uint8_t* data, size_t size,
+                                 uint32_t width, uint32_t height,
+                                 uint32_t channel_count,
+                                 uint32_t sample_rate) {
+  if (stream_info_ && stream_info_->extra_data.size() == size &&
+      std::equal(data, data + size, stream_info_->extra_data.begin())) {
+    return;
+  }
+
+  const std::vector<uint8_t> extra_data(data, data + size);
+  const Rational<uint32_t> sar =
+      is_video_ ? GetSarFromH264(extra_data) : Rational<uint32_t>{0, 0};
+  stream_info_.reset(new StreamInfo(mime_type_, expected_codec_, is_video_,
+                                    {1, kTimescale}, sar, extra_data, width,
+                                    height, channel_count, sample_rate));
+}
+
+int64_t TsDemuxer::UnwrapTimestamp(uint64_t timestamp) {
+  int64_t ret = static_cast<int64_t>(timestamp);
+  if (has_last_timestamp_) {
+    // Pick the value closest to the last timestamp.
+    ret += last_timestamp_ - (last_timestamp_ & (kTimestampWrap - 1));
+    if (ret < last_timestamp_ - kTimestampWrap / 2)
+      ret += kTimestampWrap;
+    else if (ret > last_timestamp_ + kTimestampWrap / 2)
+      ret -= kTimestampWrap;
+  }
+  has_last_timestamp_ = true;
+  last_timestamp_ = ret;
+  return ret;
+}
+
+void TsDemuxer::OutputFrames(
+    double timestamp_offset,
+    std::vector<std::shared_ptr<EncodedFrame>>* frames) {
+  frames->reserve(frames->size() + pending_frames_.size());
+  for (size_t i = 0; i < pending_frames_.size(); i++) {
+    PendingFrame& frame = pending_frames_[i];
+    double duration = frame.duration;
+    if (duration < 0) {
+      // The last video frame uses the duration of the one before it.
+      if (i + 1 < pending_frames_.size() &&
+          pending_frames_[i + 1].dts > frame.dts) {
+        last_video_duration_ = pending_frames_[i + 1].dts - frame.dts;
+      }
+      duration = last_video_duration_;
+    }
+    frames->emplace_back(memory::MakePooledShared<SegmentEncodedFrame>(
+        std::move(frame.stream_info), frame.pts + timestamp_offset,
+        frame.dts + timestamp_offset, duration, frame.is_key_frame, segment_,
+        frame.offset, frame.size, timestamp_offset,
+        std::move(frame.encryption_info)));
+  }
+  if (!pending_frames_.empty()) {
+    VLOG(3) << "Read " << pending_frames_.size() << " frames from "
+            << segment_->size() << " bytes";
+  }
+  pending_frames_.clear();
+  segment_.reset();
+}
+
+void TsDemuxer::RaiseLoadedMetaData(double duration) {
+  if (sent_loaded_meta_data_)
+    return;
+  sent_loaded_meta_data_ = true;
+  if (client_)
+    client_->OnLoadedMetaData(duration);
+}
+
+bool TsDemuxer::StartFallback(
+    double timestamp_offset, const uint8_t* data, size_t size,
+    std::vector<std::shared_ptr<EncodedFrame>>* frames) {
+  if (!fallback_) {
+    fallback_client_.reset(new ClientProxy(this));
+    fallback_ = fallback_factory_->Create(mime_type_, fallback_client_.get());
+    if (!fallback_) {
+      LOG(ERROR) << "Unable to create fallback demuxer";
+      return false;
+    }
+  }
+
+  VLOG(1) << "Using fallback demuxer for '" << mime_type_ << "'";
+  use_fallback_ = true;
+  pmt_pid_ = es_pid_ = -1;
+  last_continuity_counter_ = -1;
+  pes_.clear();
+  stream_info_.reset();
+  sps_.clear();
+  pps_.clear();
+  return fallback_->Demux(timestamp_offset, data, size, frames);
+}
+
+}  // namespace mp2t
+}  // namespace media
+}  // namespace shaka
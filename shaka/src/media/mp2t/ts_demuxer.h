@@ -0,0 +1,167 @@
+// Copyright 2020 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     https://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef SHAKA_EMBEDDED_MEDIA_MP2T_TS_DEMUXER_H_
+#define SHAKA_EMBEDDED_MEDIA_MP2T_TS_DEMUXER_H_
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "shaka/eme/configuration.h"
+#include "shaka/media/demuxer.h"
+#include "shaka/media/stream_info.h"
+#include "shaka/optional.h"
+#include "src/media/media_buffer.h"
+
+namespace shaka {
+namespace media {
+namespace mp2t {
+
+/**
+ * An implementation of the Demuxer type that parses MPEG-2 transport streams
+ * (e.g. HLS segments) directly.  This reads a single H.264 or AAC (ADTS)
+ * elementary stream; other streams in the input (e.g. ID3 metadata) are
+ * ignored.
+ *
+ * The PES packets are reassembled into a reused buffer and the frames are
+ * written into a single buffer per call to Demux, which the frames share.  The
+ * frames are converted to the same format CmafDemuxer produces: H.264 frames
+ * use 4-byte NAL unit lengths with an 'avcC' as the extra data, and AAC frames
+ * have the ADTS headers removed with an AudioSpecificConfig as the extra data.
+ *
+ * Video PES packets usually have no length, so one ends when the next one
+ * starts.  Since segments end on a PES boundary, input that ends on a TS packet
+ * boundary also ends the current PES packet.
+ *
+ * HLS SAMPLE-AES streams are supported, but the key and IV are given by the
+ * playlist, not the stream; so the frames have an empty key ID and IV and the
+ * eme::Implementation needs to use the key and IV from its license.
+ *
+ * Content that this can't handle (e.g. other codecs or PSI that spans
+ * packets) is forwarded to a demuxer created by the given fallback factory,
+ * starting at the segment that wasn't supported.
+ */
+class TsDemuxer : public Demuxer {
+ public:
+  TsDemuxer(Demuxer::Client* client, const std::string& mime_type,
+            const DemuxerFactory* fallback_factory);
+  ~TsDemuxer() override;
+
+  bool SwitchType(const std::string& mime_type) override;
+  void Reset() override;
+
+  bool Demux(double timestamp_offset, const uint8_t* data, size_t size,
+             std::vector<std::shared_ptr<EncodedFrame>>* frames) override;
+
+ private:
+  /** A frame that has been written to |segment_| but not output yet. */
+  struct PendingFrame {
+    std::shared_ptr<const StreamInfo> stream_info;
+    // The times are in seconds, not including the timestamp offset.
+    double pts;
+    double dts;
+    // The duration, or -1 if it is based on the next frame.
+    double duration;
+    bool is_key_frame;
+    size_t offset;
+    size_t size;
+    std::shared_ptr<eme::FrameEncryptionInfo> encryption_info;
+  };
+
+  class ClientProxy;
+
+  /**
+   * Parses the given 188-byte TS packet.
+   * @param needs_fallback [OUT] Set to true if this content should be read
+   *   using the fallback demuxer.
+   * @return True on success, false on error.
+   */
+  bool ParsePacket(const uint8_t* packet, bool* needs_fallback);
+  /** Parses a PAT or PMT section that starts in the given payload. */
+  bool ParsePsi(const uint8_t* payload, size_t size, bool is_pat,
+                bool* needs_fallback);
+  bool ParsePmt(const uint8_t* section, size_t size, bool* needs_fallback);
+
+  /** Parses the PES packet in |pes_| into frames in |pending_frames_|. */
+  bool FlushPes();
+  bool ParseH264(double pts, double dts, const uint8_t* data, size_t size);
+  bool ParseAdts(optional<double> pts, const uint8_t* data, size_t size);
+  /** Updates |stream_info_| if the given extra data is new. */
+  void UpdateStreamInfo(const uint8_t* data, size_t size, uint32_t width,
+                        uint32_t height, uint32_t channel_count,
+                        uint32_t sample_rate);
+
+  /** Converts a 33-bit timestamp to one that continues from the last one. */
+  int64_t UnwrapTimestamp(uint64_t timestamp);
+
+  /** Creates frames for |pending_frames_| using the data in |segment_|. */
+  void OutputFrames(double timestamp_offset,
+                    std::vector<std::shared_ptr<EncodedFrame>>* frames);
+
+  /** Raises the OnLoadedMetaData event for the first stream only. */
+  void RaiseLoadedMetaData(double duration);
+
+  /** Switches to the fallback demuxer and passes it the given data. */
+  bool StartFallback(double timestamp_offset, const uint8_t* data, size_t size,
+                     std::vector<std::shared_ptr<EncodedFrame>>* frames);
+
+  Demuxer::Client* const client_;
+  const DemuxerFactory* const fallback_factory_;
+  std::unique_ptr<ClientProxy> fallback_client_;
+  std::unique_ptr<Demuxer> fallback_;
+  bool use_fallback_;
+
+  std::string mime_type_;
+  // The codec string from the MIME type, or empty if there isn't exactly one.
+  std::string expected_codec_;
+  bool sent_loaded_meta_data_;
+
+  // The PIDs of the PMT and of the elementary stream we read, or -1 if not
+  // known yet.
+  int pmt_pid_;
+  int es_pid_;
+  bool is_video_;
+  bool is_encrypted_;
+  int last_continuity_counter_;
+
+  // The PES packet being reassembled.  This is reused between packets to
+  // avoid reallocating.
+  std::vector<uint8_t> pes_;
+
+  std::shared_ptr<const StreamInfo> stream_info_;
+  std::vector<uint8_t> sps_;
+  std::vector<uint8_t> pps_;
+
+  bool has_last_timestamp_;
+  int64_t last_timestamp_;
+  double last_video_duration_;
+  optional<double> next_audio_pts_;
+
+  // The frame data from the current call to Demux, which the frames share.
+  std::shared_ptr<EncodedFrameBuffer> segment_;
+  std::vector<PendingFrame> pending_frames_;
+
+  // The partial TS packet that hasn't been fully appended yet.
+  std::vector<uint8_t> pending_;
+};
+
+}  // namespace mp2t
+}  // namespace media
+}  // namespace shaka
+
+#endif  // SHAKA_EMBEDDED_MEDIA_MP2T_TS_DEMUXER_H_
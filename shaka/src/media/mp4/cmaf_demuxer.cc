@@ -0,0 +1,1215 @@
+// Copyright 2020 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     https://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "src/media/mp4/cmaf_demuxer.h"
+
+#include <glog/logging.h>
+#include <math.h>
+
+#include <algorithm>
+#include <functional>
+#include <limits>
+#include <unordered_map>
+#include <utility>
+
+#include "src/media/media_utils.h"
+#include "src/media/mp2t/ts_demuxer.h"
+#include "src/media/segment_encoded_frame.h"
+#include "src/memory/pool_allocator.h"
+
+namespace shaka {
+namespace media {
+namespace mp4 {
+
+struct Box {
+  uint32_t type = 0;
+  // The start of the box, including the header.
+  const uint8_t* start = nullptr;
+  size_t total_size = 0;
+  // The body of the box, after the header.
+  const uint8_t* data = nullptr;
+  size_t size = 0;
+};
+
+namespace {
+
+constexpr uint32_t FourCC(const char (&tag)[5]) {
+  return (static_cast<uint32_t>(static_cast<uint8_t>(tag[0])) << 24) |
+         (static_cast<uint32_t>(static_cast<uint8_t>(tag[1])) << 16) |
+         (static_cast<uint32_t>(static_cast<uint8_t>(tag[2])) << 8) |
+         static_cast<uint32_t>(static_cast<uint8_t>(tag[3]));
+}
+
+// See ISO/IEC 14496-12 Sec. 8.8.7/8.8.8.
+constexpr const uint32_t kTfhdBaseDataOffset = 0x1;
+constexpr const uint32_t kTfhdSampleDescriptionIndex = 0x2;
+constexpr const uint32_t kTfhdDefaultDuration = 0x8;
+constexpr const uint32_t kTfhdDefaultSize = 0x10;
+constexpr const uint32_t kTfhdDefaultFlags = 0x20;
+constexpr const uint32_t kTrunDataOffset = 0x1;
+constexpr const uint32_t kTrunFirstSampleFlags = 0x4;
+constexpr const uint32_t kTrunSampleDuration = 0x100;
+constexpr const uint32_t kTrunSampleSize = 0x200;
+constexpr const uint32_t kTrunSampleFlags = 0x400;
+constexpr const uint32_t kTrunCompositionOffset = 0x800;
+constexpr const uint32_t kSampleDependsOnOthers = 0x01000000;
+constexpr const uint32_t kSampleIsNonSync = 0x00010000;
+// See ISO/IEC 23001-7 Sec. 7.2.
+constexpr const uint32_t kSencUseSubsamples = 0x2;
+
+/** The group description index offset for groups in the current fragment. */
+constexpr const uint32_t kFragmentLocalGroupIndex = 0x10000;
+
+/** The size, in bytes, of the AES blocks and the IVs we give to EME. */
+constexpr const size_t kIvSize = 16;
+
+/**
+ * The largest box size we accept.  This is far larger than any real segment;
+ * a larger size is from a corrupt header and would have us buffer appended
+ * data forever waiting for the end of the box.
+ */
+constexpr const uint64_t kMaxBoxSize = 256 * 1024 * 1024;
+
+enum class ReadStatus {
+  Success,
+  NeedMoreData,
+  Invalid,
+};
+
+/**
+ * Reads the header of the box at the start of the given buffer.
+ * @param can_extend_to_end Whether a box size of 0 is allowed, which means the
+ *   box extends to the end of the buffer.
+ */
+ReadStatus ReadBox(const uint8_t* data, size_t size, bool can_extend_to_end,
+                   Box* box) {
+  util::BufferReader reader(data, size);
+  if (size < 8)
+    return ReadStatus::NeedMoreData;
+  uint64_t box_size = reader.ReadUint32();
+  box->type = reader.ReadUint32();
+  if (box_size == 1) {
+    if (reader.BytesRemaining() < 8)
+      return ReadStatus::NeedMoreData;
+    box_size = reader.ReadBits(64);
+  } else if (box_size == 0) {
+    if (!can_extend_to_end)
+      return ReadStatus::Invalid;
+    box_size = size;
+  }
+  if (box->type == FourCC("uuid")) {
+    if (reader.BytesRemaining() < 16)
+      return ReadStatus::NeedMoreData;
+    reader.Skip(16);
+  }
+
+  const size_t header_size = size - reader.BytesRemaining();
+  if (box_size < header_size || box_size > kMaxBoxSize)
+    return ReadStatus::Invalid;
+  if (box_size > size)
+    return ReadStatus::NeedMoreData;
+
+  box->start = data;
+  box->total_size = static_cast<size_t>(box_size);
+  box->data = data + header_size;
+  box->size = box->total_size - header_size;
+  return ReadStatus::Success;
+}
+
+/**
+ * Calls the given callback for each child box in the given buffer.  The
+ * callback returns false to stop with an error.
+ */
+template <typename Func>
+bool ForEachBox(const uint8_t* data, size_t size, Func&& callback) {
+  // Some boxes are followed by padding (e.g. a 4-byte terminator), which is
+  // smaller than a box header; ignore it.
+  while (size >= 8) {
+    Box box;
+    if (ReadBox(data, size, /* can_extend_to_end= */ true, &box) !=
+        ReadStatus::Success) {
+      LOG(ERROR) << "Invalid MP4 box";
+      return false;
+    }
+    if (!callback(box))
+      return false;
+    data += box.total_size;
+    size -= box.total_size;
+  }
+  return true;
+}
+
+template <typename Func>
+bool ForEachBox(const Box& parent, Func&& callback) {
+  return ForEachBox(parent.data, parent.size, std::forward<Func>(callback));
+}
+
+/** Reads the version and flags of a FullBox. */
+void ReadFullBoxHeader(util::BufferReader* reader, uint8_t* version,
+                       uint32_t* flags) {
+  *version = reader->ReadUint8();
+  *flags = static_cast<uint32_t>(reader->ReadBits(24));
+}
+
+/** Reads a value that is 64-bits in version 1 of a box and 32-bits before. */
+uint64_t ReadVersionedValue(util::BufferReader* reader, uint8_t version) {
+  return version == 1 ? reader->ReadBits(64) : reader->ReadUint32();
+}
+
+/** Reads a descriptor header from an 'esds' box.  See ISO/IEC 14496-1 8.3. */
+bool ReadDescriptorHeader(util::BufferReader* reader, uint8_t* tag,
+                          size_t* size) {
+  if (reader->empty())
+    return false;
+  *tag = reader->ReadUint8();
+  *size = 0;
+  for (int i = 0; i < 4; i++) {
+    if (reader->empty())
+      return false;
+    const uint8_t byte = reader->ReadUint8();
+    *size = (*size << 7) | (byte & 0x7f);
+    if ((byte & 0x80) == 0)
+      break;
+  }
+  return *size <= reader->BytesRemaining();
+}
+
+/**
+ * Parses the given 'esds' box to get the object type and the
+ * AudioSpecificConfig.  See ISO/IEC 14496-1 Sec. 7.2.6.
+ */
+bool ParseEsds(const Box& esds, uint8_t* object_type,
+               std::vector<uint8_t>* extra_data) {
+  util::BufferReader reader(esds.data, esds.size);
+  reader.Skip(4);  // version and flags
+
+  uint8_t tag;
+  size_t size;
+  while (ReadDescriptorHeader(&reader, &tag, &size)) {
+    switch (tag) {
+      case 0x03: {  // ES_Descriptor
+        if (size < 3)
+          return false;
+        reader.Skip(2);  // ES_ID
+        const uint8_t flags = reader.ReadUint8();
+        if (flags & 0x80)  // streamDependenceFlag
+          reader.Skip(2);
+        if (flags & 0x40)  // URL_Flag
+          reader.Skip(reader.ReadUint8());
+        if (flags & 0x20)  // OCRstreamFlag
+          reader.Skip(2);
+        break;
+      }
+      case 0x04:  // DecoderConfigDescriptor
+        if (size < 13)
+          return false;
+        *object_type = reader.ReadUint8();
+        reader.Skip(12);
+        break;
+      case 0x05:  // DecoderSpecificInfo
+        extra_data->assign(reader.data(), reader.data() + size);
+        return true;
+      default:
+        reader.Skip(size);
+        break;
+    }
+  }
+  return false;
+}
+
+/** @return Whether the given MPEG-4 object type is AAC. */
+bool IsAacObjectType(uint8_t object_type) {
+  // MPEG-4 AAC and the MPEG-2 AAC profiles.
+  return object_type == 0x40 || object_type == 0x66 || object_type == 0x67 ||
+         object_type == 0x68;
+}
+
+}  // namespace
+
+/** The child boxes of a 'traf' box that we care about. */
+struct CmafDemuxer::TrackFragment {
+  Box tfhd;
+  Box tfdt;
+  std::vector<Box> truns;
+  Box sbgp;
+  Box sgpd;
+  Box senc;
+  Box saiz;
+  Box saio;
+  // The position, from the start of the stream, that offsets are relative to.
+  uint64_t base_position = 0;
+};
+
+/**
+ * Forwards events from the fallback demuxer so we only raise OnLoadedMetaData
+ * once, even if we switch demuxers.
+ */
+class CmafDemuxer::ClientProxy : public Demuxer::Client {
+ public:
+  explicit ClientProxy(CmafDemuxer* demuxer) : demuxer_(demuxer) {}
+
+  void OnLoadedMetaData(double duration) override {
+    demuxer_->RaiseLoadedMetaData(duration);
+  }
+
+  void OnEncrypted(eme::MediaKeyInitDataType type, const uint8_t* data,
+                   size_t size) override {
+    if (demuxer_->client_)
+      demuxer_->client_->OnEncrypted(type, data, size);
+  }
+
+ private:
+  CmafDemuxer* const demuxer_;
+};
+
+
+CmafDemuxer::CmafDemuxer(Demuxer::Client* client, const std::string& mime_type,
+                         const DemuxerFactory* fallback_factory)
+    : client_(client),
+      fallback_factory_(fallback_factory),
+      use_fallback_(false),
+      mime_type_(mime_type),
+      next_dts_(0),
+      sent_loaded_meta_data_(false),
+      stream_position_(0) {}
+
+CmafDemuxer::~CmafDemuxer() {}
+
+bool CmafDemuxer::SwitchType(const std::string& mime_type) {
+  mime_type_ = mime_type;
+  return !fallback_ || fallback_->SwitchType(mime_type);
+}
+
+void CmafDemuxer::Reset() {
+  // Keep the track info since media segments may follow without a new init
+  // segment.
+  pending_.clear();
+  samples_.clear();
+  stream_position_ = 0;
+  use_fallback_ = false;
+  if (fallback_)
+    fallback_->Reset();
+}
+
+bool CmafDemuxer::Demux(double timestamp_offset, const uint8_t* data,
+                        size_t size,
+                        std::vector<std::shared_ptr<EncodedFrame>>* frames) {
+  if (use_fallback_)
+    return fallback_->Demux(timestamp_offset, data, size, frames);
+
+  // Only copy the input if we need to join it to a partial box from before.
+  const uint8_t* buffer = data;
+  size_t buffer_size = size;
+  if (!pending_.empty()) {
+    pending_.insert(pending_.end(), data, data + size);
+    buffer = pending_.data();
+    buffer_size = pending_.size();
+  }
+
+  size_t pos = 0;
+  while (pos < buffer_size) {
+    Box box;
+    const ReadStatus status =
+        ReadBox(buffer + pos, buffer_size - pos,
+                /* can_extend_to_end= */ false, &box);
+    if (status == ReadStatus::NeedMoreData)
+      break;
+    if (status == ReadStatus::Invalid) {
+      LOG(ERROR) << "Invalid MP4 box";
+      pending_.clear();
+      return false;
+    }
+
+    const uint64_t box_position = stream_position_ + pos;
+    bool needs_fallback = false;
+    bool ok = true;
+    switch (box.type) {
+      case FourCC("moov"):
+        ok = ParseInit(box, &needs_fallback);
+        break;
+      case FourCC("moof"):
+        // Media segments for a stream we don't handle go to the fallback.
+        needs_fallback = !track_ && fallback_;
+        if (!needs_fallback)
+          ok = ParseFragment(box, box_position);
+        break;
+      case FourCC("mdat"):
+        // An 'mdat' before the 'moov' is a non-fragmented file.
+        needs_fallback = !track_;
+        if (!needs_fallback) {
+          ok = ReadSamples(timestamp_offset, box,
+                           box_position + (box.data - box.start), frames);
+        }
+        break;
+      default:
+        VLOG(3) << "Skipping MP4 box of type 0x" << std::hex << box.type;
+        break;
+    }
+
+    if (ok && needs_fallback) {
+      ok = StartFallback(timestamp_offset, buffer + pos, buffer_size - pos,
+                         frames);
+      pending_.clear();
+      stream_position_ = 0;
+      return ok;
+    }
+    if (!ok) {
+      pending_.clear();
+      samples_.clear();
+      return false;
+    }
+    pos += box.total_size;
+  }
+
+  stream_position_ += pos;
+  if (buffer == data)
+    pending_.assign(data + pos, data + size);
+  else
+    pending_.erase(pending_.begin(), pending_.begin() + pos);
+  return true;
+}
+
+bool CmafDemuxer::ParseInit(const Box& moov, bool* needs_fallback) {
+  uint32_t movie_timescale = 0;
+  uint64_t movie_duration = 0;
+  uint64_t fragment_duration = 0;
+  bool has_mvex = false;
+  size_t track_count = 0;
+  Box trak;
+  std::vector<uint8_t> pssh;
+  std::unordered_map<uint32_t, std::vector<uint32_t>> trex;
+
+  const bool ok = ForEachBox(moov, [&](const Box& box) {
+    util::BufferReader reader(box.data, box.size);
+    uint8_t version;
+    uint32_t flags;
+    switch (box.type) {
+      case FourCC("mvhd"):
+        ReadFullBoxHeader(&reader, &version, &flags);
+        reader.Skip(version == 1 ? 16 : 8);  // creation/modification time
+        movie_timescale = reader.ReadUint32();
+        movie_duration = ReadVersionedValue(&reader, version);
+        if (movie_duration == (version == 1 ? UINT64_MAX : UINT32_MAX))
+          movie_duration = 0;
+        break;
+      case FourCC("trak"):
+        track_count++;
+        trak = box;
+        break;
+      case FourCC("mvex"):
+        has_mvex = true;
+        return ForEachBox(box, [&](const Box& child) {
+          util::BufferReader reader(child.data, child.size);
+          ReadFullBoxHeader(&reader, &version, &flags);
+          if (child.type == FourCC("mehd")) {
+            fragment_duration = ReadVersionedValue(&reader, version);
+          } else if (child.type == FourCC("trex")) {
+            const uint32_t track_id = reader.ReadUint32();
+            reader.Skip(4);  // default_sample_description_index
+            std::vector<uint32_t>& defaults = trex[track_id];
+            for (int i = 0; i < 3; i++)
+              defaults.push_back(reader.ReadUint32());
+          }
+          return true;
+        });
+      case FourCC("pssh"):
+        pssh.insert(pssh.end(), box.start, box.start + box.total_size);
+        break;
+    }
+    return true;
+  });
+  if (!ok)
+    return false;
+
+  if (!has_mvex || track_count != 1) {
+    VLOG(1) << "Content isn't single-track fragmented MP4";
+    *needs_fallback = true;
+    return true;
+  }
+
+  std::unique_ptr<Track> track(new Track);
+  if (!ParseTrack(trak, movie_timescale, track.get(), needs_fallback))
+    return false;
+  if (*needs_fallback)
+    return true;
+
+  auto it = trex.find(track->track_id);
+  if (it != trex.end()) {
+    track->default_duration = it->second[0];
+    track->default_size = it->second[1];
+    track->default_flags = it->second[2];
+  }
+
+  track_ = std::move(track);
+  samples_.clear();
+  next_dts_ = 0;
+
+  const uint64_t duration = fragment_duration ? fragment_duration
+                                              : movie_duration;
+  if (duration == 0 || movie_timescale == 0) {
+    RaiseLoadedMetaData(HUGE_VAL);
+  } else {
+    RaiseLoadedMetaData(static_cast<double>(duration) / movie_timescale);
+  }
+  OnPssh(pssh);
+  return true;
+}
+
+bool CmafDemuxer::ParseTrack(const Box& trak, uint32_t movie_timescale,
+                             Track* track, bool* needs_fallback) {
+  uint32_t handler = 0;
+  std::vector<Box> entries;
+  uint32_t sample_count = 0;
+  // Pairs of segment_duration and media_time.
+  std::vector<std::pair<uint64_t, int64_t>> edits;
+
+  std::function<bool(const Box&)> parse_box = [&](const Box& box) {
+    util::BufferReader reader(box.data, box.size);
+    uint8_t version;
+    uint32_t flags;
+    switch (box.type) {
+      case FourCC("edts"):
+      case FourCC("mdia"):
+      case FourCC("minf"):
+      case FourCC("stbl"):
+        return ForEachBox(box, parse_box);
+
+      case FourCC("tkhd"):
+        ReadFullBoxHeader(&reader, &version, &flags);
+        reader.Skip(version == 1 ? 16 : 8);  // creation/modification time
+        track->track_id = reader.ReadUint32();
+        break;
+      case FourCC("elst"): {
+        ReadFullBoxHeader(&reader, &version, &flags);
+        const uint32_t count = reader.ReadUint32();
+        const size_t entry_size = version == 1 ? 20 : 12;
+        if (count > reader.BytesRemaining() / entry_size) {
+          LOG(ERROR) << "Invalid 'elst' box";
+          return false;
+        }
+        for (uint32_t i = 0; i < count; i++) {
+          const uint64_t segment_duration =
+              ReadVersionedValue(&reader, version);
+          const int64_t media_time =
+              version == 1 ? static_cast<int64_t>(reader.ReadBits(64))
+                           : static_cast<int32_t>(reader.ReadUint32());
+          reader.Skip(4);  // media_rate
+          edits.emplace_back(segment_duration, media_time);
+        }
+        break;
+      }
+      case FourCC("mdhd"):
+        ReadFullBoxHeader(&reader, &version, &flags);
+        reader.Skip(version == 1 ? 16 : 8);  // creation/modification time
+        track->timescale = reader.ReadUint32();
+        break;
+      case FourCC("hdlr"):
+        reader.Skip(8);  // version, flags, and pre_defined
+        handler = reader.ReadUint32();
+        break;
+      case FourCC("stsz"):
+        reader.Skip(8);  // version, flags, and sample_size
+        sample_count = reader.ReadUint32();
+        break;
+      case FourCC("stsd"):
+        reader.Skip(8);  // version, flags, and entry_count
+        return ForEachBox(reader.data(), reader.BytesRemaining(),
+                          [&](const Box& child) {
+                            entries.push_back(child);
+                            return true;
+                          });
+    }
+    return true;
+  };
+  if (!ForEachBox(trak, parse_box))
+    return false;
+
+  if (sample_count > 0 || entries.empty()) {
+    VLOG(1) << "Track isn't fragmented";
+    *needs_fallback = true;
+    return true;
+  }
+  if (track->timescale == 0) {
+    LOG(ERROR) << "Invalid track timescale";
+    return false;
+  }
+
+  // This matches how FFmpeg handles edit lists for fragmented content, which
+  // shifts all the samples by the start of the first non-empty edit.
+  int64_t empty_duration = 0;
+  for (const auto& edit : edits) {
+    if (edit.second == -1) {
+      empty_duration += edit.first;
+    } else {
+      track->time_offset = edit.second;
+      break;
+    }
+  }
+  if (empty_duration > 0 && movie_timescale > 0) {
+    track->time_offset -= static_cast<int64_t>(
+        static_cast<double>(empty_duration) * track->timescale /
+        movie_timescale);
+  }
+
+  // Encrypted content with a clear lead has both an encrypted and a clear
+  // sample entry.  These need to be for the same codec, so they are treated as
+  // the same stream.
+  for (const Box& entry : entries) {
+    if (!ParseSampleEntry(entry, handler, track, needs_fallback))
+      return false;
+    if (*needs_fallback)
+      return true;
+  }
+  return true;
+}
+
+bool CmafDemuxer::ParseSampleEntry(const Box& entry, uint32_t handler,
+                                   Track* track, bool* needs_fallback) {
+  const bool is_video = handler == FourCC("vide");
+  if (!is_video && handler != FourCC("soun")) {
+    *needs_fallback = true;
+    return true;
+  }
+
+  // See ISO/IEC 14496-12 Sec. 8.5.2.
+  util::BufferReader reader(entry.data, entry.size);
+  uint32_t width = 0;
+  uint32_t height = 0;
+  uint32_t channel_count = 0;
+  uint32_t sample_rate = 0;
+  if (is_video) {
+    if (reader.BytesRemaining() < 78) {
+      LOG(ERROR) << "Invalid visual sample entry";
+      return false;
+    }
+    reader.Skip(24);  // reserved, data_reference_index, and pre_defined
+    width = static_cast<uint32_t>(reader.ReadBits(16));
+    height = static_cast<uint32_t>(reader.ReadBits(16));
+    reader.Skip(50);  // resolution, frame_count, compressorname, and depth
+  } else {
+    if (reader.BytesRemaining() < 28) {
+      LOG(ERROR) << "Invalid audio sample entry";
+      return false;
+    }
+    reader.Skip(8);  // reserved and data_reference_index
+    const uint64_t version = reader.ReadBits(16);
+    reader.Skip(6);  // revision_level and vendor
+    channel_count = static_cast<uint32_t>(reader.ReadBits(16));
+    reader.Skip(6);  // samplesize, compression_id, and packet_size
+    sample_rate = reader.ReadUint32() >> 16;
+    // QuickTime sound sample descriptions have extra fields.
+    if (version == 1)
+      reader.Skip(16);
+    else if (version == 2)
+      reader.Skip(36);
+  }
+
+  uint32_t format = entry.type;
+  uint32_t scheme_type = 0;
+  bool has_tenc = false;
+  uint8_t object_type = 0;
+  EncryptionDefaults encryption;
+  std::vector<uint8_t> extra_data;
+  Rational<uint32_t> sar{0, 0};
+  HdrMetadata hdr_metadata;
+  std::function<bool(const Box&)> parse_box = [&](const Box& box) {
+    util::BufferReader reader(box.data, box.size);
+    switch (box.type) {
+      case FourCC("avcC"):
+      case FourCC("hvcC"):
+        extra_data.assign(box.data, box.data + box.size);
+        break;
+      case FourCC("pasp"): {
+        const uint32_t h_spacing = reader.ReadUint32();
+        const uint32_t v_spacing = reader.ReadUint32();
+        sar = Rational<uint32_t>{h_spacing, v_spacing};
+        break;
+      }
+      case FourCC("colr"):
+        if (!ParseColorInformation(box.data, box.size, &hdr_metadata)) {
+          LOG(ERROR) << "Invalid 'colr' box";
+          return false;
+        }
+        break;
+      case FourCC("mdcv"):
+        if (!ParseMasteringDisplay(box.data, box.size, &hdr_metadata)) {
+          LOG(ERROR) << "Invalid 'mdcv' box";
+          return false;
+        }
+        break;
+      case FourCC("clli"):
+        if (!ParseContentLightLevel(box.data, box.size, &hdr_metadata)) {
+          LOG(ERROR) << "Invalid 'clli' box";
+          return false;
+        }
+        break;
+      case FourCC("esds"):
+        if (!ParseEsds(box, &object_type, &extra_data)) {
+          LOG(ERROR) << "Invalid 'esds' box";
+          return false;
+        }
+        break;
+
+      case FourCC("sinf"):
+      case FourCC("schi"):
+        return ForEachBox(box, parse_box);
+      case FourCC("frma"):
+        format = reader.ReadUint32();
+        break;
+      case FourCC("schm"):
+        reader.Skip(4);  // version and flags
+        scheme_type = reader.ReadUint32();
+        break;
+      case FourCC("tenc"):
+        // The tenc box matches the 'seig' group entry after the FullBox header;
+        // the version 0 box has a reserved byte where the pattern is.
+        reader.Skip(4);  // version and flags
+        if (!ReadEncryptionDefaults(&reader, &encryption)) {
+          LOG(ERROR) << "Invalid 'tenc' box";
+          return false;
+        }
+        has_tenc = true;
+        break;
+    }
+    return true;
+  };
+  if (!ForEachBox(reader.data(), reader.BytesRemaining(), parse_box))
+    return false;
+
+  std::string codec_name;
+  switch (format) {
+    case FourCC("avc1"):
+    case FourCC("avc3"):
+      codec_name = "h264";
+      break;
+    case FourCC("hev1"):
+    case FourCC("hvc1"):
+      codec_name = "hevc";
+      break;
+    case FourCC("mp4a"):
+      if (IsAacObjectType(object_type))
+        codec_name = "aac";
+      break;
+  }
+  const bool is_encrypted =
+      entry.type == FourCC("encv") || entry.type == FourCC("enca");
+  const bool scheme_supported =
+      scheme_type == FourCC("cenc") || scheme_type == FourCC("cbcs");
+  if (codec_name.empty() || extra_data.empty() ||
+      (codec_name == "aac") == is_video ||
+      (is_encrypted && (!scheme_supported || !has_tenc))) {
+    VLOG(1) << "Unsupported sample entry 0x" << std::hex << format;
+    *needs_fallback = true;
+    return true;
+  }
+
+  std::unordered_map<std::string, std::string> params;
+  if (!ParseMimeType(mime_type_, nullptr, nullptr, &params))
+    return false;
+  const std::string expected_codec = params.count(kCodecMimeParam) > 0
+                                         ? params.at(kCodecMimeParam)
+                                         : codec_name;
+  if (NormalizeCodec(expected_codec) != codec_name) {
+    LOG(ERROR) << "Mismatch between codec string and media.  Codec string: '"
+               << expected_codec << "', media codec: '" << codec_name << "'";
+    return false;
+  }
+
+  if (track->stream_info) {
+    if (NormalizeCodec(track->stream_info->codec) != codec_name) {
+      VLOG(1) << "Sample entries have different codecs";
+      *needs_fallback = true;
+      return true;
+    }
+  } else if (is_video && !sar) {
+    sar = codec_name == "h264" ? GetSarFromH264(extra_data)
+                               : GetSarFromHevc(extra_data);
+  }
+
+  if (is_encrypted && !track->is_encrypted) {
+    track->is_encrypted = true;
+    track->scheme = scheme_type == FourCC("cenc")
+                        ? eme::EncryptionScheme::AesCtr
+                        : eme::EncryptionScheme::AesCbc;
+    track->encryption = std::move(encryption);
+  }
+  if (!track->stream_info) {
+    track->stream_info.reset(new StreamInfo(
+        mime_type_, expected_codec, is_video, {1, track->timescale}, sar,
+        extra_data, width, height, channel_count, sample_rate, hdr_metadata));
+  }
+  return true;
+}
+
+bool CmafDemuxer::ParseFragment(const Box& moof, uint64_t moof_position) {
+  if (!track_) {
+    LOG(ERROR) << "Media segment appended before an init segment";
+    return false;
+  }
+  if (!samples_.empty()) {
+    LOG(WARNING) << "Dropping " << samples_.size()
+                 << " samples from a 'moof' without an 'mdat'";
+    samples_.clear();
+  }
+
+  std::vector<uint8_t> pssh;
+  const bool ok = ForEachBox(moof, [&](const Box& box) {
+    if (box.type == FourCC("traf"))
+      return ParseTrackFragment(box, moof, moof_position);
+    if (box.type == FourCC("pssh"))
+      pssh.insert(pssh.end(), box.start, box.start + box.total_size);
+    return true;
+  });
+  if (!ok)
+    return false;
+
+  OnPssh(pssh);
+  return true;
+}
+
+bool CmafDemuxer::ParseTrackFragment(const Box& traf, const Box& moof,
+                                     uint64_t moof_position) {
+  TrackFragment frag;
+  bool ok = ForEachBox(traf, [&](const Box& box) {
+    // Only the 'seig' sample groups are used, others are ignored.
+    util::BufferReader reader(box.data, box.size);
+    reader.Skip(4);  // version and flags
+    const bool is_seig = reader.ReadUint32() == FourCC("seig");
+    switch (box.type) {
+      case FourCC("tfhd"):
+        frag.tfhd = box;
+        break;
+      case FourCC("tfdt"):
+        frag.tfdt = box;
+        break;
+      case FourCC("trun"):
+        frag.truns.push_back(box);
+        break;
+      case FourCC("sbgp"):
+        if (is_seig)
+          frag.sbgp = box;
+        break;
+      case FourCC("sgpd"):
+        if (is_seig)
+          frag.sgpd = box;
+        break;
+      case FourCC("senc"):
+        frag.senc = box;
+        break;
+      case FourCC("saiz"):
+        frag.saiz = box;
+        break;
+      case FourCC("saio"):
+        frag.saio = box;
+        break;
+    }
+    return true;
+  });
+  if (!ok)
+    return false;
+  if (!frag.tfhd.data) {
+    LOG(ERROR) << "Missing 'tfhd' box";
+    return false;
+  }
+
+  uint8_t version;
+  uint32_t flags;
+  util::BufferReader tfhd(frag.tfhd.data, frag.tfhd.size);
+  ReadFullBoxHeader(&tfhd, &version, &flags);
+  if (tfhd.ReadUint32() != track_->track_id) {
+    VLOG(1) << "Ignoring track fragment for an unknown track";
+    return true;
+  }
+  // Without the base-data-offset, the offsets are relative to the 'moof' box
+  // (both when default-base-is-moof is set and for the first 'traf').
+  frag.base_position =
+      flags & kTfhdBaseDataOffset ? tfhd.ReadBits(64) : moof_position;
+  if (flags & kTfhdSampleDescriptionIndex)
+    tfhd.Skip(4);
+  const uint32_t default_duration = flags & kTfhdDefaultDuration
+                                        ? tfhd.ReadUint32()
+                                        : track_->default_duration;
+  const uint32_t default_size =
+      flags & kTfhdDefaultSize ? tfhd.ReadUint32() : track_->default_size;
+  const uint32_t default_flags =
+      flags & kTfhdDefaultFlags ? tfhd.ReadUint32() : track_->default_flags;
+
+  if (frag.tfdt.data) {
+    util::BufferReader tfdt(frag.tfdt.data, frag.tfdt.size);
+    ReadFullBoxHeader(&tfdt, &version, &flags);
+    next_dts_ = static_cast<int64_t>(ReadVersionedValue(&tfdt, version));
+  }
+
+  // See ISO/IEC 14496-12 Sec. 8.8.8.
+  const size_t first_sample = samples_.size();
+  uint64_t data_position = frag.base_position;
+  for (const Box& box : frag.truns) {
+    util::BufferReader trun(box.data, box.size);
+    ReadFullBoxHeader(&trun, &version, &flags);
+    const uint32_t sample_count = trun.ReadUint32();
+    if (flags & kTrunDataOffset) {
+      data_position = frag.base_position +
+                      static_cast<int32_t>(trun.ReadUint32());
+    }
+    const bool has_first_flags = flags & kTrunFirstSampleFlags;
+    const uint32_t first_flags = has_first_flags ? trun.ReadUint32() : 0;
+
+    size_t per_sample_size = 0;
+    for (uint32_t field : {kTrunSampleDuration, kTrunSampleSize,
+                           kTrunSampleFlags, kTrunCompositionOffset}) {
+      if (flags & field)
+        per_sample_size += 4;
+    }
+    if (per_sample_size > 0 &&
+        sample_count > trun.BytesRemaining() / per_sample_size) {
+      LOG(ERROR) << "Invalid 'trun' box";
+      return false;
+    }
+
+    samples_.reserve(samples_.size() + sample_count);
+    for (uint32_t i = 0; i < sample_count; i++) {
+      Sample sample;
+      sample.duration =
+          flags & kTrunSampleDuration ? trun.ReadUint32() : default_duration;
+      sample.size = flags & kTrunSampleSize ? trun.ReadUint32() : default_size;
+      uint32_t sample_flags = default_flags;
+      if (flags & kTrunSampleFlags)
+        sample_flags = trun.ReadUint32();
+      else if (i == 0 && has_first_flags)
+        sample_flags = first_flags;
+      sample.composition_offset = 0;
+      if (flags & kTrunCompositionOffset) {
+        const uint32_t offset = trun.ReadUint32();
+        sample.composition_offset = version == 0
+                                        ? static_cast<int64_t>(offset)
+                                        : static_cast<int32_t>(offset);
+      }
+
+      sample.position = data_position;
+      sample.dts = next_dts_;
+      sample.is_key_frame =
+          !track_->stream_info->is_video ||
+          (sample_flags & (kSampleIsNonSync | kSampleDependsOnOthers)) == 0;
+      data_position += sample.size;
+      next_dts_ += sample.duration;
+      samples_.push_back(std::move(sample));
+    }
+  }
+
+  if (!track_->is_encrypted)
+    return true;
+
+  // Find which encryption settings apply to each sample from the sample
+  // groups.  See ISO/IEC 23001-7 Sec. 6 and ISO/IEC 14496-12 Sec. 8.9.
+  std::vector<EncryptionDefaults> local_groups;
+  if (frag.sgpd.data) {
+    util::BufferReader sgpd(frag.sgpd.data, frag.sgpd.size);
+    ReadFullBoxHeader(&sgpd, &version, &flags);
+    sgpd.Skip(4);  // grouping_type
+    const uint32_t default_length = version == 1 ? sgpd.ReadUint32() : 0;
+    if (version >= 2)
+      sgpd.Skip(4);  // default_sample_description_index
+    const uint32_t entry_count = sgpd.ReadUint32();
+    for (uint32_t i = 0; i < entry_count; i++) {
+      if (version == 1 && default_length == 0)
+        sgpd.Skip(4);  // description_length
+      local_groups.emplace_back();
+      if (!ReadEncryptionDefaults(&sgpd, &local_groups.back())) {
+        LOG(ERROR) << "Invalid 'sgpd' box";
+        return false;
+      }
+    }
+  }
+
+  const size_t count = samples_.size() - first_sample;
+  std::vector<const EncryptionDefaults*> groups(count, &track_->encryption);
+  if (frag.sbgp.data) {
+    util::BufferReader sbgp(frag.sbgp.data, frag.sbgp.size);
+    ReadFullBoxHeader(&sbgp, &version, &flags);
+    sbgp.Skip(version == 1 ? 8 : 4);  // grouping_type and parameter
+    const uint32_t entry_count = sbgp.ReadUint32();
+    size_t sample = 0;
+    for (uint32_t i = 0; i < entry_count && sample < count; i++) {
+      const uint32_t sample_count = sbgp.ReadUint32();
+      const uint32_t index = sbgp.ReadUint32();
+      const EncryptionDefaults* group = &track_->encryption;
+      if (index > kFragmentLocalGroupIndex &&
+          index - kFragmentLocalGroupIndex <= local_groups.size()) {
+        group = &local_groups[index - kFragmentLocalGroupIndex - 1];
+      } else if (index != 0) {
+        LOG(ERROR) << "Unsupported sample group description index " << index;
+        return false;
+      }
+      for (uint32_t j = 0; j < sample_count && sample < count; j++)
+        groups[sample++] = group;
+    }
+  }
+
+  return ParseEncryptionInfo(frag, moof, moof_position, groups, first_sample);
+}
+
+bool CmafDemuxer::ParseEncryptionInfo(
+    const TrackFragment& frag, const Box& moof, uint64_t moof_position,
+    const std::vector<const EncryptionDefaults*>& groups, size_t first_sample) {
+  uint8_t version;
+  uint32_t flags;
+  if (frag.senc.data) {
+    util::BufferReader senc(frag.senc.data, frag.senc.size);
+    ReadFullBoxHeader(&senc, &version, &flags);
+    const uint32_t sample_count = senc.ReadUint32();
+    if (sample_count > groups.size()) {
+      LOG(ERROR) << "Invalid 'senc' box";
+      return false;
+    }
+    for (uint32_t i = 0; i < sample_count; i++) {
+      if (!ReadSampleEncryption(&senc, *groups[i], flags & kSencUseSubsamples,
+                                &samples_[first_sample + i])) {
+        LOG(ERROR) << "Invalid 'senc' box";
+        return false;
+      }
+    }
+    return true;
+  }
+
+  // Without a 'senc' box, the same info is pointed to by the 'saiz' and 'saio'
+  // boxes.  We only support this when the data is inside the 'moof'.
+  // See ISO/IEC 14496-12 Sec. 8.7.8/8.7.9.
+  if (!frag.saiz.data || !frag.saio.data) {
+    // This is a clear fragment (e.g. the clear lead).
+    return true;
+  }
+
+  util::BufferReader saiz(frag.saiz.data, frag.saiz.size);
+  ReadFullBoxHeader(&saiz, &version, &flags);
+  if (flags & 0x1)
+    saiz.Skip(8);  // aux_info_type and aux_info_type_parameter
+  const uint8_t default_size = saiz.ReadUint8();
+  const uint32_t sample_count = saiz.ReadUint32();
+  if (sample_count > groups.size() ||
+      (default_size == 0 && sample_count > saiz.BytesRemaining())) {
+    LOG(ERROR) << "Invalid 'saiz' box";
+    return false;
+  }
+
+  util::BufferReader saio(frag.saio.data, frag.saio.size);
+  ReadFullBoxHeader(&saio, &version, &flags);
+  if (flags & 0x1)
+    saio.Skip(8);  // aux_info_type and aux_info_type_parameter
+  if (saio.ReadUint32() != 1) {
+    LOG(ERROR) << "Only a single 'saio' offset is supported";
+    return false;
+  }
+  const uint64_t position = frag.base_position + ReadVersionedValue(&saio,
+                                                                    version);
+  if (position < moof_position || position - moof_position > moof.total_size) {
+    LOG(ERROR) << "Sample auxiliary info outside the 'moof' isn't supported";
+    return false;
+  }
+
+  util::BufferReader aux(moof.start + (position - moof_position),
+                         moof.total_size - (position - moof_position));
+  for (uint32_t i = 0; i < sample_count; i++) {
+    const size_t size = default_size ? default_size : saiz.ReadUint8();
+    if (size > aux.BytesRemaining()) {
+      LOG(ERROR) << "Invalid sample auxiliary info";
+      return false;
+    }
+    util::BufferReader sample_aux(aux.data(), size);
+    aux.Skip(size);
+    const bool has_subsamples = size > groups[i]->per_sample_iv_size;
+    if (!ReadSampleEncryption(&sample_aux, *groups[i], has_subsamples,
+                              &samples_[first_sample + i])) {
+      LOG(ERROR) << "Invalid sample auxiliary info";
+      return false;
+    }
+  }
+  return true;
+}
+
+bool CmafDemuxer::ReadSampleEncryption(util::BufferReader* reader,
+                                       const EncryptionDefaults& defaults,
+                                       bool has_subsamples, Sample* sample) {
+  std::vector<uint8_t> iv;
+  if (defaults.per_sample_iv_size > 0) {
+    if (reader->BytesRemaining() < defaults.per_sample_iv_size)
+      return false;
+    iv.resize(defaults.per_sample_iv_size);
+    reader->Read(iv.data(), iv.size());
+  } else {
+    iv = defaults.constant_iv;
+  }
+
+  std::vector<eme::SubsampleInfo> subsamples;
+  if (has_subsamples) {
+    if (reader->BytesRemaining() < 2)
+      return false;
+    const size_t count = static_cast<size_t>(reader->ReadBits(16));
+    if (count > reader->BytesRemaining() / 6)
+      return false;
+    subsamples.reserve(count);
+    for (size_t i = 0; i < count; i++) {
+      const uint32_t clear_bytes = static_cast<uint32_t>(reader->ReadBits(16));
+      const uint32_t protected_bytes = reader->ReadUint32();
+      subsamples.emplace_back(clear_bytes, protected_bytes);
+    }
+  }
+
+  if (!defaults.is_protected)
+    return true;
+  // 8-byte IVs are padded with zeros to make the 16-byte counter block.
+  if (iv.size() > kIvSize)
+    return false;
+  iv.resize(kIvSize, 0);
+  sample->encryption_info = std::make_shared<eme::FrameEncryptionInfo>(
+      track_->scheme, defaults.pattern, defaults.key_id, iv, subsamples);
+  return true;
+}
+
+// static
+bool CmafDemuxer::ReadEncryptionDefaults(util::BufferReader* reader,
+                                         EncryptionDefaults* defaults) {
+  // See ISO/IEC 23001-7 Sec. 6.1/8.2.
+  if (reader->BytesRemaining() < 20)
+    return false;
+  reader->Skip(1);  // reserved
+  const uint8_t pattern = reader->ReadUint8();
+  defaults->pattern = eme::EncryptionPattern(pattern >> 4, pattern & 0xf);
+  defaults->is_protected = reader->ReadUint8() != 0;
+  defaults->per_sample_iv_size = reader->ReadUint8();
+  defaults->key_id.resize(16);
+  reader->Read(defaults->key_id.data(), defaults->key_id.size());
+  defaults->constant_iv.clear();
+  if (defaults->is_protected && defaults->per_sample_iv_size == 0) {
+    const uint8_t size = reader->ReadUint8();
+    if (size > reader->BytesRemaining())
+      return false;
+    defaults->constant_iv.resize(size);
+    reader->Read(defaults->constant_iv.data(), size);
+  }
+  return true;
+}
+
+bool CmafDemuxer::ReadSamples(
+    double timestamp_offset, const Box& mdat, uint64_t mdat_position,
+    std::vector<std::shared_ptr<EncodedFrame>>* frames) {
+  if (samples_.empty())
+    return true;
+
+  // Copy the part of the 'mdat' used by the samples into one buffer that all
+  // the frames share.
+  const uint64_t mdat_end = mdat_position + mdat.size;
+  uint64_t start = std::numeric_limits<uint64_t>::max();
+  uint64_t end = 0;
+  for (const Sample& sample : samples_) {
+    if (sample.position < mdat_position || sample.position > mdat_end ||
+        sample.size > mdat_end - sample.position) {
+      LOG(ERROR) << "Sample data isn't contained in the following 'mdat'";
+      return false;
+    }
+    start = std::min(start, sample.position);
+    end = std::max(end, sample.position + sample.size);
+  }
+  auto buffer = std::make_shared<EncodedFrameBuffer>(
+      mdat.data + (start - mdat_position), mdat.data + (end - mdat_position));
+
+  const std::shared_ptr<const StreamInfo>& info = track_->stream_info;
+  const double factor = info->time_scale;
+  frames->reserve(frames->size() + samples_.size());
+  for (Sample& sample : samples_) {
+    const int64_t dts = sample.dts - track_->time_offset;
+    const double pts =
+        (dts + sample.composition_offset) * factor + timestamp_offset;
+    frames->emplace_back(memory::MakePooledShared<SegmentEncodedFrame>(
+        info, pts, dts * factor + timestamp_offset, sample.duration * factor,
+        sample.is_key_frame, buffer, sample.position - start, sample.size,
+        timestamp_offset, std::move(sample.encryption_info)));
+  }
+  VLOG(3) << "Read " << samples_.size() << " samples from " << buffer->size()
+          << " bytes";
+  samples_.clear();
+  return true;
+}
+
+void CmafDemuxer::RaiseLoadedMetaData(double duration) {
+  if (sent_loaded_meta_data_)
+    return;
+  sent_loaded_meta_data_ = true;
+  if (client_)
+    client_->OnLoadedMetaData(duration);
+}
+
+void CmafDemuxer::OnPssh(const std::vector<uint8_t>& pssh) {
+  if (pssh.empty() || pssh == last_pssh_)
+    return;
+  last_pssh_ = pssh;
+  if (client_)
+    client_->OnEncrypted(eme::MediaKeyInitDataType::Cenc, pssh.data(),
+                         pssh.size());
+}
+
+bool CmafDemuxer::StartFallback(
+    double timestamp_offset, const uint8_t* data, size_t size,
+    std::vector<std::shared_ptr<EncodedFrame>>* frames) {
+  if (!fallback_) {
+    fallback_client_.reset(new ClientProxy(this));
+    fallback_ = fallback_factory_->Create(mime_type_, fallback_client_.get());
+    if (!fallback_) {
+      LOG(ERROR) << "Unable to create fallback demuxer";
+      return false;
+    }
+  }
+
+  VLOG(1) << "Using fallback demuxer for '" << mime_type_ << "'";
+  use_fallback_ = true;
+  track_.reset();
+  samples_.clear();
+  return fallback_->Demux(timestamp_offset, data, size, frames);
+}
+
+
+bool CmafDemuxerFactory::IsTypeSupported(const std::string& mime_type) const {
+  return fallback_.IsTypeSupported(mime_type);
+}
+
+bool CmafDemuxerFactory::IsCodecVideo(const std::string& codec) const {
+  return fallback_.IsCodecVideo(codec);
+}
+
+bool CmafDemuxerFactory::CanSwitchType(const std::string& old_mime_type,
+                                       const std::string& new_mime_type) const {
+  return fallback_.CanSwitchType(old_mime_type, new_mime_type);
+}
+
+std::unique_ptr<Demuxer> CmafDemuxerFactory::Create(
+    const std::string& mime_type, Demuxer::Client* client) const {
+  std::string subtype;
+  if (!fallback_.IsTypeSupported(mime_type) ||
+      !ParseMimeType(mime_type, nullptr, &subtype, nullptr)) {
+    return fallback_.Create(mime_type, client);
+  }
+
+  if (subtype == "mp4") {
+    return std::unique_ptr<Demuxer>(
+        new (std::nothrow) CmafDemuxer(client, mime_type, &fallback_));
+  }
+  if (subtype == "mp2t") {
+    return std::unique_ptr<Demuxer>(
+        new (std::nothrow) mp2t::TsDemuxer(client, mime_type, &fallback_));
+  }
+  return fallback_.Create(mime_type, client);
+}
+
+}  // namespace mp4
+}  // namespace media
+}  // namespace shaka
@@ -0,0 +1,193 @@
+// Copyright 2020 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     https://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef SHAKA_EMBEDDED_MEDIA_MP4_CMAF_DEMUXER_H_
+#define SHAKA_EMBEDDED_MEDIA_MP4_CMAF_DEMUXER_H_
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "shaka/eme/configuration.h"
+#include "shaka/media/demuxer.h"
+#include "shaka/media/stream_info.h"
+#include "src/media/ffmpeg/ffmpeg_demuxer.h"
+#include "src/util/buffer_reader.h"
+
+namespace shaka {
+namespace media {
+namespace mp4 {
+
+/** A view of a single MP4 box within a buffer. */
+struct Box;
+
+/**
+ * An implementation of the Demuxer type that parses fragmented MP4 (CMAF)
+ * content directly.  Each moof/mdat pair is copied into a single shared buffer
+ * and the resulting frames point into that buffer, so there is no per-sample
+ * allocation or copy.
+ *
+ * Content that this can't handle (e.g. non-fragmented MP4, multiple tracks, or
+ * unknown codecs) is forwarded to a demuxer created by the given fallback
+ * factory, starting at the init segment that wasn't supported.
+ */
+class CmafDemuxer : public Demuxer {
+ public:
+  CmafDemuxer(Demuxer::Client* client, const std::string& mime_type,
+              const DemuxerFactory* fallback_factory);
+  ~CmafDemuxer() override;
+
+  bool SwitchType(const std::string& mime_type) override;
+  void Reset() override;
+
+  bool Demux(double timestamp_offset, const uint8_t* data, size_t size,
+             std::vector<std::shared_ptr<EncodedFrame>>* frames) override;
+
+ private:
+  /** The encryption defaults from a 'tenc' box or a 'seig' sample group. */
+  struct EncryptionDefaults {
+    bool is_protected = false;
+    uint8_t per_sample_iv_size = 0;
+    eme::EncryptionPattern pattern{0, 0};
+    std::vector<uint8_t> key_id;
+    std::vector<uint8_t> constant_iv;
+  };
+
+  /** The info about the track, parsed from the init segment. */
+  struct Track {
+    uint32_t track_id = 0;
+    uint32_t timescale = 0;
+    // The offset, in timescale units, to subtract from the sample times, from
+    // the edit list.
+    int64_t time_offset = 0;
+
+    // The defaults from the 'trex' box.
+    uint32_t default_duration = 0;
+    uint32_t default_size = 0;
+    uint32_t default_flags = 0;
+
+    bool is_encrypted = false;
+    eme::EncryptionScheme scheme = eme::EncryptionScheme::AesCtr;
+    EncryptionDefaults encryption;
+
+    std::shared_ptr<const StreamInfo> stream_info;
+  };
+
+  /** A sample from a 'moof' box whose data hasn't been read yet. */
+  struct Sample {
+    // The position of the sample data from the start of the stream.
+    uint64_t position;
+    uint32_t size;
+    uint32_t duration;
+    int64_t dts;
+    int64_t composition_offset;
+    bool is_key_frame;
+    std::shared_ptr<eme::FrameEncryptionInfo> encryption_info;
+  };
+
+  struct TrackFragment;
+  class ClientProxy;
+
+  /**
+   * Parses the given 'moov' box.
+   * @param needs_fallback [OUT] Set to true if this content should be read
+   *   using the fallback demuxer.
+   * @return True on success, false on error.
+   */
+  bool ParseInit(const Box& moov, bool* needs_fallback);
+  bool ParseTrack(const Box& trak, uint32_t movie_timescale, Track* track,
+                  bool* needs_fallback);
+  /**
+   * Parses a sample entry into |track|.  The first entry defines the stream;
+   * any other entries need to be for the same codec.
+   */
+  bool ParseSampleEntry(const Box& entry, uint32_t handler, Track* track,
+                        bool* needs_fallback);
+
+  /** Parses the given 'moof' box into |samples_|. */
+  bool ParseFragment(const Box& moof, uint64_t moof_position);
+  bool ParseTrackFragment(const Box& traf, const Box& moof,
+                          uint64_t moof_position);
+  bool ParseEncryptionInfo(const TrackFragment& traf, const Box& moof,
+                           uint64_t moof_position,
+                           const std::vector<const EncryptionDefaults*>& groups,
+                           size_t first_sample);
+  /** Reads the encryption info for a single sample from a 'senc' box. */
+  bool ReadSampleEncryption(util::BufferReader* reader,
+                            const EncryptionDefaults& defaults,
+                            bool has_subsamples, Sample* sample);
+  static bool ReadEncryptionDefaults(util::BufferReader* reader,
+                                     EncryptionDefaults* defaults);
+
+  /** Creates frames for the pending samples from the given 'mdat' box. */
+  bool ReadSamples(double timestamp_offset, const Box& mdat,
+                   uint64_t mdat_position,
+                   std::vector<std::shared_ptr<EncodedFrame>>* frames);
+
+  /** Raises the OnLoadedMetaData event for the first init segment only. */
+  void RaiseLoadedMetaData(double duration);
+  /** Raises an OnEncrypted event for the given 'pssh' boxes, if new. */
+  void OnPssh(const std::vector<uint8_t>& pssh);
+
+  /** Switches to the fallback demuxer and passes it the given data. */
+  bool StartFallback(double timestamp_offset, const uint8_t* data, size_t size,
+                     std::vector<std::shared_ptr<EncodedFrame>>* frames);
+
+  Demuxer::Client* const client_;
+  const DemuxerFactory* const fallback_factory_;
+  std::unique_ptr<ClientProxy> fallback_client_;
+  std::unique_ptr<Demuxer> fallback_;
+  bool use_fallback_;
+
+  std::string mime_type_;
+  std::unique_ptr<Track> track_;
+  std::vector<Sample> samples_;
+  std::vector<uint8_t> last_pssh_;
+  // The decode time of the next sample, used when there is no 'tfdt' box.
+  int64_t next_dts_;
+  bool sent_loaded_meta_data_;
+
+  // The partial box that hasn't been fully appended yet.
+  std::vector<uint8_t> pending_;
+  // The position of the start of |pending_| from the start of the stream.
+  uint64_t stream_position_;
+};
+
+/**
+ * A DemuxerFactory that creates CmafDemuxer instances for MP4 content,
+ * mp2t::TsDemuxer instances for MPEG-2 TS content, and uses FFmpeg for
+ * everything else.
+ */
+class CmafDemuxerFactory : public DemuxerFactory {
+ public:
+  bool IsTypeSupported(const std::string& mime_type) const override;
+  bool IsCodecVideo(const std::string& codec) const override;
+  bool CanSwitchType(const std::string& old_mime_type,
+                     const std::string& new_mime_type) const override;
+
+  std::unique_ptr<Demuxer> Create(const std::string& mime_type,
+                                  Demuxer::Client* client) const override;
+
+ private:
+  ffmpeg::FFmpegDemuxerFactory fallback_;
+};
+
+}  // namespace mp4
+}  // namespace media
+}  // namespace shaka
+
+#endif  // SHAKA_EMBEDDED_MEDIA_MP4_CMAF_DEMUXER_H_
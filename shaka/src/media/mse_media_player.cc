@@ -27,31 +27,73 @@
 namespace shaka {
 namespace media {
 
+namespace {
+
+/**
+ * The default number of seconds to decode audio ahead.  Audio frames are
+ * small, so this can be larger than for video, which means fewer wakeups.
+ */
+constexpr const double kDefaultAudioDecodeAhead = 3;
+
+/**
+ * The playback rate at or above which only video keyframes are decoded.  Below
+ * this, every frame is decoded and the renderers drop what they can't show.
+ */
+constexpr const double kMinTrickPlayRate = 4;
+
+/**
+ * The number of seconds to decode ahead while preloading.  This only needs to
+ * cover the first frames so playback can start right away.
+ */
+constexpr const double kPreloadDecodeAhead = 0.5;
+
+/**
+ * The last buffered version given out.  This is shared between all the players
+ * so a cached version from one player never matches another player.
+ */
+std::atomic<uint64_t> last_buffered_version{0};
+
+}  // namespace
+
 MseMediaPlayer::MseMediaPlayer(ClientList* clients,
                                VideoRenderer* video_renderer,
-                               AudioRenderer* audio_renderer)
+                               AudioRenderer* audio_renderer,
+                               const DecoderOptions& decoder_options)
     : mutex_("MseMediaPlayer"),
       pipeline_manager_(std::bind(&MseMediaPlayer::OnStatusChanged, this,
                                   std::placeholders::_1),
                         std::bind(&MseMediaPlayer::OnSeek, this),
-                        &util::Clock::Instance),
+                        &util::Clock::Instance,
+                        [audio_renderer](double* time) {
+                          return audio_renderer->GetDeviceTime(time);
+                        }),
       pipeline_monitor_(std::bind(&MseMediaPlayer::GetBuffered, this),
                         std::bind(&MseMediaPlayer::GetDecoded, this),
                         std::bind(&MseMediaPlayer::ReadyStateChanged, this,
                                   std::placeholders::_1),
-                        &util::Clock::Instance, &pipeline_manager_),
+                        &util::Clock::Instance, &pipeline_manager_,
+                        decoder_options.worker_pool),
       old_state_(VideoPlaybackState::Initializing),
       ready_state_(VideoReadyState::NotAttached),
-      video_(this),
-      audio_(this),
+      trick_play_(false),
+      priority_(0),
+      preloading_(false),
+      preload_memory_cap_(0),
+      buffered_version_(++last_buffered_version),
+      video_(this, decoder_options),
+      audio_(this, decoder_options),
       video_renderer_(video_renderer),
       audio_renderer_(audio_renderer),
       clients_(clients),
       debug_thread_shutdown_(false),
       debug_thread_("MseMediaPlayer",
-                    std::bind(&MseMediaPlayer::DebugThreadMain, this)) {
+                    std::bind(&MseMediaPlayer::DebugThreadMain, this),
+                    ThreadRole::Background) {
   video_renderer_->SetPlayer(this);
   audio_renderer_->SetPlayer(this);
+
+  audio_policy_.seconds = kDefaultAudioDecodeAhead;
+  audio_.SetDecodeAheadPolicy(audio_policy_);
 }
 
 MseMediaPlayer::~MseMediaPlayer() {
@@ -69,6 +111,88 @@ void MseMediaPlayer::SetDecoders(Decoder* video_decoder,
   audio_.SetDecoder(audio_decoder);
 }
 
+void MseMediaPlayer::SetDecodeAheadPolicy(const DecodeAheadPolicy& video,
+                                          const DecodeAheadPolicy& audio) {
+  std::unique_lock<SharedMutex> lock(mutex_);
+  video_policy_ = video;
+  audio_policy_ = audio;
+  UpdatePolicies();
+}
+
+void MseMediaPlayer::SetWorkerPriority(int priority) {
+  std::unique_lock<SharedMutex> lock(mutex_);
+  priority_ = priority;
+  UpdatePolicies();
+}
+
+void MseMediaPlayer::SetLowLatencyMode(bool low_latency) {
+  std::unique_lock<SharedMutex> lock(mutex_);
+  pipeline_monitor_.SetLowLatency(low_latency);
+  video_.SetLowLatency(low_latency);
+  audio_.SetLowLatency(low_latency);
+}
+
+void MseMediaPlayer::SetAudioMasterClock(bool enabled) {
+  pipeline_manager_.SetUseMasterClock(enabled);
+}
+
+void MseMediaPlayer::SetRetainBehind(double seconds) {
+  std::unique_lock<SharedMutex> lock(mutex_);
+  video_.SetRetainBehind(seconds);
+  audio_.SetRetainBehind(seconds);
+}
+
+void MseMediaPlayer::SetVideoSuspended(bool suspended) {
+  const DecodedStream* stream;
+  {
+    std::unique_lock<SharedMutex> lock(mutex_);
+    if (video_.IsSuspended() == suspended)
+      return;
+    video_.SetSuspended(suspended);
+    stream = video_.IsAttached() ? video_.GetDecodedStream() : nullptr;
+  }
+
+  // Avoid holding the lock for interacting with the Renderers.
+  if (suspended)
+    video_renderer_->Detach();
+  else if (stream)
+    video_renderer_->Attach(stream);
+  // The decoded ranges no longer include (or now include) video.
+  pipeline_monitor_.Wake();
+}
+
+void MseMediaPlayer::SetPreloading(bool preloading, uint64_t memory_cap) {
+  const DecodedStream* audio_stream;
+  {
+    std::unique_lock<SharedMutex> lock(mutex_);
+    const bool changed = preloading != preloading_;
+    preloading_ = preloading;
+    preload_memory_cap_ = memory_cap;
+    UpdatePolicies();
+    if (!changed)
+      return;
+    audio_stream = audio_.IsAttached() && !audio_.IsSuspended()
+                       ? audio_.GetDecodedStream()
+                       : nullptr;
+  }
+
+  // Avoid holding the lock for interacting with the Renderers.  Audio is still
+  // decoded while preloading, but it isn't played until the swap.
+  if (preloading)
+    audio_renderer_->Detach();
+  else if (audio_stream)
+    audio_renderer_->Attach(audio_stream);
+  pipeline_monitor_.Wake();
+}
+
+double MseMediaPlayer::AppendToPresentLatency() const {
+  const double time = CurrentTime();
+  util::shared_lock<SharedMutex> lock(mutex_);
+  // Prefer video since that is what the user sees.
+  const double latency = video_.GetLatency(time);
+  return std::isnan(latency) ? audio_.GetLatency(time) : latency;
+}
+
 MediaCapabilitiesInfo MseMediaPlayer::DecodingInfo(
     const MediaDecodingConfiguration& config) const {
   if (config.type != MediaDecodingType::MediaSource ||
@@ -110,6 +234,10 @@ void MseMediaPlayer::AddClient(MediaPlayer::Client* client) const {
   clients_->AddClient(client);
 }
 
+void MseMediaPlayer::AddAsyncClient(MediaPlayer::Client* client) const {
+  clients_->AddAsyncClient(client);
+}
+
 void MseMediaPlayer::RemoveClient(MediaPlayer::Client* client) const {
   clients_->RemoveClient(client);
 }
@@ -124,6 +252,10 @@ std::vector<BufferedRange> MseMediaPlayer::GetBuffered() const {
   return IntersectionOfBufferedRanges(ranges);
 }
 
+uint64_t MseMediaPlayer::GetBufferedVersion() const {
+  return buffered_version_.load(std::memory_order_acquire);
+}
+
 VideoReadyState MseMediaPlayer::ReadyState() const {
   util::shared_lock<SharedMutex> lock(mutex_);
   return ready_state_;
@@ -231,6 +363,7 @@ double MseMediaPlayer::Duration() const {
 
 void MseMediaPlayer::SetDuration(double duration) {
   pipeline_manager_.SetDuration(duration);
+  pipeline_monitor_.Wake();
 }
 
 double MseMediaPlayer::PlaybackRate() const {
@@ -240,6 +373,8 @@ double MseMediaPlayer::PlaybackRate() const {
 void MseMediaPlayer::SetPlaybackRate(double rate) {
   const double old_rate = pipeline_manager_.GetPlaybackRate();
   pipeline_manager_.SetPlaybackRate(rate);
+  SetTrickPlay(rate >= kMinTrickPlayRate);
+  pipeline_monitor_.Wake();
   clients_->OnPlaybackRateChanged(old_rate, rate);
 }
 
@@ -263,18 +398,22 @@ bool MseMediaPlayer::AttachMse() {
 
 bool MseMediaPlayer::AddMseBuffer(const std::string& mime, bool is_video,
                                   const ElementaryStream* stream) {
+  bool video_suspended;
+  bool audio_suspended;
   {
     std::unique_lock<SharedMutex> lock(mutex_);
     if (is_video)
       video_.Attach(stream);
     else
       audio_.Attach(stream);
+    video_suspended = video_.IsSuspended();
+    audio_suspended = audio_.IsSuspended() || preloading_;
   }
 
   // Avoid holding the lock for interacting with the Renderers.
-  if (is_video)
+  if (is_video && !video_suspended)
     video_renderer_->Attach(video_.GetDecodedStream());
-  else
+  else if (!is_video && !audio_suspended)
     audio_renderer_->Attach(audio_.GetDecodedStream());
   return true;
 }
@@ -327,6 +466,8 @@ void MseMediaPlayer::Detach() {
 }
 
 void MseMediaPlayer::OnStatusChanged(VideoPlaybackState state) {
+  pipeline_monitor_.Wake();
+
   VideoPlaybackState old_state;
   {
     std::unique_lock<SharedMutex> lock(mutex_);
@@ -369,6 +510,8 @@ void MseMediaPlayer::ReadyStateChanged(VideoReadyState state) {
 }
 
 void MseMediaPlayer::OnSeek() {
+  pipeline_monitor_.Wake();
+
   // Avoid holding the lock for interacting with the Renderers.
   clients_->OnSeeking();
 
@@ -377,6 +520,55 @@ void MseMediaPlayer::OnSeek() {
   audio_.OnSeek();
 }
 
+void MseMediaPlayer::SetTrickPlay(bool trick_play) {
+  const DecodedStream* audio_stream;
+  {
+    std::unique_lock<SharedMutex> lock(mutex_);
+    if (trick_play == trick_play_)
+      return;
+    trick_play_ = trick_play;
+    video_.SetTrickPlay(trick_play);
+    // Audio can't be played at these rates, so stop decoding it.
+    audio_.SetSuspended(trick_play);
+    audio_stream = audio_.IsAttached() && !preloading_
+                       ? audio_.GetDecodedStream()
+                       : nullptr;
+  }
+
+  // Avoid holding the lock for interacting with the Renderers.
+  if (trick_play)
+    audio_renderer_->Detach();
+  else if (audio_stream)
+    audio_renderer_->Attach(audio_stream);
+}
+
+void MseMediaPlayer::UpdatePolicies() {
+  if (preloading_) {
+    // Only decode enough to start playback and run behind the other players.
+    DecodeAheadPolicy video = video_policy_;
+    DecodeAheadPolicy audio = audio_policy_;
+    video.seconds = audio.seconds = kPreloadDecodeAhead;
+    video.frames = audio.frames = 0;
+    if (preload_memory_cap_ > 0)
+      video.bytes = audio.bytes = preload_memory_cap_;
+    video_.SetDecodeAheadPolicy(video);
+    audio_.SetDecodeAheadPolicy(audio);
+    pipeline_monitor_.SetPriority(priority_ - 1);
+    video_.SetPriority(priority_ - 1);
+    audio_.SetPriority(priority_ - 1);
+  } else {
+    video_.SetDecodeAheadPolicy(video_policy_);
+    audio_.SetDecodeAheadPolicy(audio_policy_);
+    pipeline_monitor_.SetPriority(priority_);
+    video_.SetPriority(priority_);
+    audio_.SetPriority(priority_);
+  }
+}
+
+void MseMediaPlayer::OnBufferedChanged() {
+  buffered_version_.store(++last_buffered_version, std::memory_order_release);
+}
+
 void MseMediaPlayer::OnError(const std::string& error) {
   pipeline_manager_.OnError();
   clients_->OnError(error);
@@ -386,11 +578,27 @@ void MseMediaPlayer::OnWaitingForKey() {
   clients_->OnWaitingForKey();
 }
 
+void MseMediaPlayer::GetMaxVideoSize(uint32_t* width,
+                                     uint32_t* height) const {
+  video_renderer_->GetMaxFrameSize(width, height);
+}
+
+std::vector<PixelFormat> MseMediaPlayer::GetPreferredPixelFormats() const {
+  return video_renderer_->GetPreferredPixelFormats();
+}
+
 std::vector<BufferedRange> MseMediaPlayer::GetDecoded() const {
   util::shared_lock<SharedMutex> lock(mutex_);
   std::vector<std::vector<BufferedRange>> ranges;
   for (auto* ptr : {&video_, &audio_}) {
-    if (ptr->IsAttached())
+    // Suspended streams don't decode, so don't wait for them.  In trick play,
+    // the decoded keyframes have gaps between them, so the nearest keyframe
+    // is shown wherever the input is buffered.
+    if (!ptr->IsAttached() || ptr->IsSuspended())
+      continue;
+    if (ptr->IsTrickPlay())
+      ranges.emplace_back(ptr->GetBuffered());
+    else
       ranges.emplace_back(ptr->GetDecodedStream()->GetBufferedRanges());
   }
   return IntersectionOfBufferedRanges(ranges);
@@ -423,6 +631,7 @@ void MseMediaPlayer::DebugThreadMain() {
     printf("  Duration:       %.1f\n", Duration());
     printf("  Playback rate:  %.1f\n", PlaybackRate());
     printr("  Total Buffered: ", GetBuffered());
+    printf("  Latency:        %.2f\n", AppendToPresentLatency());
 
     util::shared_lock<SharedMutex> lock(mutex_);
     print_stream("Audio", &audio_);
@@ -431,15 +640,27 @@ void MseMediaPlayer::DebugThreadMain() {
 }
 
 
-MseMediaPlayer::Source::Source(MseMediaPlayer* player)
-    : default_decoder_(Decoder::CreateDefaultDecoder()),
-      decoder_thread_(player, &decoded_frames_),
+MseMediaPlayer::Source::Source(MseMediaPlayer* player,
+                               const DecoderOptions& decoder_options)
+    : default_decoder_(Decoder::CreateDefaultDecoder(decoder_options)),
+      decoder_thread_(player, &decoded_frames_, decoder_options.decrypt_ahead,
+                      decoder_options.worker_pool),
       input_(nullptr),
-      decoder_(nullptr) {
+      decoder_(nullptr),
+      player_(player),
+      monitor_(&player->pipeline_monitor_),
+      latency_(&util::Clock::Instance),
+      suspended_(false),
+      trick_play_(false) {
   decoder_thread_.SetDecoder(GetDecoder());
+  decoded_frames_.SetOnBufferedChanged(
+      std::bind(&PipelineMonitor::Wake, monitor_));
 }
 
-MseMediaPlayer::Source::~Source() {}
+MseMediaPlayer::Source::~Source() {
+  if (input_)
+    input_->SetOnBufferedChanged(nullptr);
+}
 
 const DecodedStream* MseMediaPlayer::Source::GetDecodedStream() const {
   return &decoded_frames_;
@@ -472,20 +693,81 @@ void MseMediaPlayer::Source::Attach(const ElementaryStream* stream) {
   decoded_frames_.Clear();
   decoder_thread_.Attach(stream);
   input_ = stream;
+  latency_.Reset();
+  input_->SetOnBufferedChanged(std::bind(&Source::OnInputChanged, this));
+  input_->SetOnRemoved(std::bind(&DecoderThread::OnInputRemoved,
+                                 &decoder_thread_, std::placeholders::_1,
+                                 std::placeholders::_2));
+  player_->OnBufferedChanged();
 }
 
 void MseMediaPlayer::Source::Detach() {
   decoder_thread_.Detach();
+  if (input_) {
+    input_->SetOnBufferedChanged(nullptr);
+    input_->SetOnRemoved(nullptr);
+  }
   input_ = nullptr;
+  latency_.Reset();
+  player_->OnBufferedChanged();
 }
 
 void MseMediaPlayer::Source::OnSeek() {
   decoder_thread_.OnSeek();
+  latency_.Reset();
 }
 
 void MseMediaPlayer::Source::SetCdm(eme::Implementation* cdm) {
   decoder_thread_.SetCdm(cdm);
 }
 
+void MseMediaPlayer::Source::SetDecodeAheadPolicy(
+    const DecodeAheadPolicy& policy) {
+  decoder_thread_.SetDecodeAheadPolicy(policy);
+}
+
+void MseMediaPlayer::Source::SetPriority(int priority) {
+  decoder_thread_.SetPriority(priority);
+}
+
+void MseMediaPlayer::Source::SetLowLatency(bool low_latency) {
+  decoder_thread_.SetLowLatency(low_latency);
+}
+
+void MseMediaPlayer::Source::SetRetainBehind(double seconds) {
+  decoder_thread_.SetRetainBehind(seconds);
+}
+
+bool MseMediaPlayer::Source::IsSuspended() const {
+  return suspended_;
+}
+
+void MseMediaPlayer::Source::SetSuspended(bool suspended) {
+  suspended_ = suspended;
+  decoder_thread_.SetSuspended(suspended);
+}
+
+bool MseMediaPlayer::Source::IsTrickPlay() const {
+  return trick_play_;
+}
+
+void MseMediaPlayer::Source::SetTrickPlay(bool trick_play) {
+  trick_play_ = trick_play;
+  decoder_thread_.SetTrickPlay(trick_play);
+}
+
+double MseMediaPlayer::Source::GetLatency(double time) const {
+  return latency_.GetLatency(time);
+}
+
+void MseMediaPlayer::Source::OnInputChanged() {
+  // This is called with the stream's lock held, but getting the buffered
+  // ranges doesn't lock.
+  latency_.OnBufferedChanged(input_->GetBufferedRanges());
+  player_->OnBufferedChanged();
+  decoder_thread_.OnInputChanged();
+  monitor_->Wake();
+}
+
 }  // namespace media
 }  // namespace shaka
@@ -22,11 +22,13 @@
 
 #include "shaka/eme/implementation.h"
 #include "shaka/media/decoder.h"
+#include "shaka/media/default_media_player.h"
 #include "shaka/media/media_player.h"
 #include "shaka/media/renderer.h"
 #include "src/debug/mutex.h"
 #include "src/debug/thread.h"
 #include "src/media/decoder_thread.h"
+#include "src/media/latency_tracker.h"
 #include "src/media/pipeline_manager.h"
 #include "src/media/pipeline_monitor.h"
 
@@ -40,17 +42,29 @@ namespace media {
 class MseMediaPlayer final : public MediaPlayer, DecoderThread::Client {
  public:
   MseMediaPlayer(ClientList* clients, VideoRenderer* video_renderer,
-                 AudioRenderer* audio_renderer);
+                 AudioRenderer* audio_renderer,
+                 const DecoderOptions& decoder_options);
   ~MseMediaPlayer() override;
 
   void SetDecoders(Decoder* video_decoder, Decoder* audio_decoder);
+  void SetDecodeAheadPolicy(const DecodeAheadPolicy& video,
+                            const DecodeAheadPolicy& audio);
+  void SetWorkerPriority(int priority);
+  void SetLowLatencyMode(bool low_latency);
+  void SetAudioMasterClock(bool enabled);
+  void SetRetainBehind(double seconds);
+  void SetVideoSuspended(bool suspended);
+  void SetPreloading(bool preloading, uint64_t memory_cap);
+  double AppendToPresentLatency() const;
 
   MediaCapabilitiesInfo DecodingInfo(
       const MediaDecodingConfiguration& config) const override;
   struct VideoPlaybackQuality VideoPlaybackQuality() const override;
   void AddClient(MediaPlayer::Client* client) const override;
+  void AddAsyncClient(MediaPlayer::Client* client) const override;
   void RemoveClient(MediaPlayer::Client* client) const override;
   std::vector<BufferedRange> GetBuffered() const override;
+  uint64_t GetBufferedVersion() const override;
   VideoReadyState ReadyState() const override;
   VideoPlaybackState PlaybackState() const override;
   std::vector<std::shared_ptr<MediaTrack>> AudioTracks() override;
@@ -93,7 +107,7 @@ class MseMediaPlayer final : public MediaPlayer, DecoderThread::Client {
  private:
   class Source final {
    public:
-    explicit Source(MseMediaPlayer* player);
+    Source(MseMediaPlayer* player, const DecoderOptions& decoder_options);
     ~Source();
 
     const DecodedStream* GetDecodedStream() const;
@@ -108,8 +122,20 @@ class MseMediaPlayer final : public MediaPlayer, DecoderThread::Client {
     void Detach();
     void OnSeek();
     void SetCdm(eme::Implementation* cdm);
+    void SetDecodeAheadPolicy(const DecodeAheadPolicy& policy);
+    void SetPriority(int priority);
+    void SetLowLatency(bool low_latency);
+    void SetRetainBehind(double seconds);
+    bool IsSuspended() const;
+    void SetSuspended(bool suspended);
+    bool IsTrickPlay() const;
+    void SetTrickPlay(bool trick_play);
+    /** @see LatencyTracker::GetLatency */
+    double GetLatency(double time) const;
 
    private:
+    void OnInputChanged();
+
     const std::unique_ptr<Decoder> default_decoder_;
 
     DecodedStream decoded_frames_;
@@ -117,13 +143,33 @@ class MseMediaPlayer final : public MediaPlayer, DecoderThread::Client {
     const ElementaryStream* input_;
 
     Decoder* decoder_;
+    MseMediaPlayer* const player_;
+    // Woken up when the buffered ranges change.
+    PipelineMonitor* const monitor_;
+    LatencyTracker latency_;
+    bool suspended_;
+    bool trick_play_;
   };
 
   void OnStatusChanged(VideoPlaybackState status);
   void ReadyStateChanged(VideoReadyState ready_state);
   void OnSeek();
+  /**
+   * Enters or leaves trick play.  In trick play, only video keyframes are
+   * decoded and audio is detached.
+   */
+  void SetTrickPlay(bool trick_play);
+  /**
+   * Applies the app's decode-ahead policies and worker priority, limiting them
+   * while preloading.  The lock must be held.
+   */
+  void UpdatePolicies();
+  /** Gives the buffered ranges a new version number. */
+  void OnBufferedChanged();
   void OnError(const std::string& error) override;
   void OnWaitingForKey() override;
+  void GetMaxVideoSize(uint32_t* width, uint32_t* height) const override;
+  std::vector<PixelFormat> GetPreferredPixelFormats() const override;
   std::vector<BufferedRange> GetDecoded() const;
 
   void DebugThreadMain();
@@ -133,6 +179,14 @@ class MseMediaPlayer final : public MediaPlayer, DecoderThread::Client {
   PipelineMonitor pipeline_monitor_;
   VideoPlaybackState old_state_;
   VideoReadyState ready_state_;
+  bool trick_play_;
+  // The values the app set; these are limited while preloading.
+  DecodeAheadPolicy video_policy_;
+  DecodeAheadPolicy audio_policy_;
+  int priority_;
+  bool preloading_;
+  uint64_t preload_memory_cap_;
+  std::atomic<uint64_t> buffered_version_;
 
   Source video_;
   Source audio_;
@@ -0,0 +1,230 @@
+// Copyright 2020 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     https://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "src/media/passthrough_decoder.h"
+
+#include <glog/logging.h>
+
+#include <unordered_map>
+#include <utility>
+
+#include "src/media/media_utils.h"
+#include "src/media/segment_encoded_frame.h"
+
+namespace shaka {
+namespace media {
+
+namespace {
+
+/** A decoded frame that holds a single IEC 61937 burst. */
+class BurstFrame final : public DecodedFrame {
+ public:
+  BurstFrame(std::shared_ptr<const StreamInfo> stream, double pts,
+             double duration, std::vector<uint8_t>* burst)
+      : DecodedFrame(stream, pts, pts, duration, SampleFormat::Iec61937,
+                     burst->size() / 4, {burst->data()}, {burst->size()}),
+        // Moving the vector keeps the same buffer, so |data| stays valid.
+        burst_(std::move(*burst)) {}
+
+ private:
+  const std::vector<uint8_t> burst_;
+};
+
+}  // namespace
+
+PassthroughDecoder::PassthroughDecoder(Decoder* fallback,
+                                       const std::vector<std::string>& codecs)
+    : fallback_(fallback),
+      passthrough_ac3_(false),
+      passthrough_eac3_(false),
+      burst_pts_(0),
+      burst_duration_(0),
+      has_buffered_frames_(false) {
+  for (const std::string& codec : codecs) {
+    Iec61937Packetizer::Codec passthrough_codec;
+    if (!GetPassthroughCodec(codec, &passthrough_codec)) {
+      LOG(WARNING) << "Codec " << codec << " can't be passed through";
+    } else if (passthrough_codec == Iec61937Packetizer::Codec::Ac3) {
+      passthrough_ac3_ = true;
+    } else {
+      passthrough_eac3_ = true;
+    }
+  }
+}
+
+PassthroughDecoder::~PassthroughDecoder() {}
+
+bool PassthroughDecoder::GetPassthroughCodec(
+    const std::string& codec, Iec61937Packetizer::Codec* result) {
+  // Accept both the MIME codec names and the FFmpeg names.  Dolby Atmos is
+  // carried in E-AC-3, so it doesn't have its own codec.
+  const std::string simple_codec = NormalizeCodec(codec);
+  if (simple_codec == "ac-3" || simple_codec == "ac3") {
+    *result = Iec61937Packetizer::Codec::Ac3;
+    return true;
+  }
+  if (simple_codec == "ec-3" || simple_codec == "eac3") {
+    *result = Iec61937Packetizer::Codec::Eac3;
+    return true;
+  }
+  return false;
+}
+
+MediaCapabilitiesInfo PassthroughDecoder::DecodingInfo(
+    const MediaDecodingConfiguration& config) const {
+  Iec61937Packetizer::Codec codec;
+  const std::string& mime = config.audio.content_type;
+  std::unordered_map<std::string, std::string> params;
+  if (config.video.content_type.empty() && !mime.empty() &&
+      ParseMimeType(mime, nullptr, nullptr, &params) &&
+      IsPassedThrough(params[kCodecMimeParam], &codec)) {
+    // The sink decodes the audio, so it doesn't use any CPU here.
+    MediaCapabilitiesInfo ret;
+    ret.supported = ret.smooth = ret.power_efficient =
+        config.type == MediaDecodingType::MediaSource;
+    return ret;
+  }
+
+  if (fallback_)
+    return fallback_->DecodingInfo(config);
+  return MediaCapabilitiesInfo();
+}
+
+void PassthroughDecoder::ResetDecoder() {
+  packetizer_.Reset();
+  has_buffered_frames_ = false;
+  if (fallback_)
+    fallback_->ResetDecoder();
+}
+
+MediaStatus PassthroughDecoder::Decode(
+    std::shared_ptr<EncodedFrame> input, const eme::Implementation* eme,
+    std::vector<std::shared_ptr<DecodedFrame>>* frames,
+    std::string* extra_info) {
+  Iec61937Packetizer::Codec codec;
+  if (!input || !IsPassedThrough(input->stream_info->codec, &codec)) {
+    // A partial burst can't be played, so drop it when flushing or switching
+    // to another codec.
+    packetizer_.Reset();
+    has_buffered_frames_ = false;
+    if (fallback_)
+      return fallback_->Decode(input, eme, frames, extra_info);
+    if (!input)
+      return MediaStatus::Success;
+
+    *extra_info = "No decoder for codec " + input->stream_info->codec;
+    LOG(ERROR) << *extra_info;
+    return MediaStatus::FatalError;
+  }
+
+  const uint8_t* data = input->data;
+  if (input->encryption_info) {
+    if (!eme) {
+      LOG(WARNING) << (*extra_info = "No CDM given for encrypted frame");
+      return MediaStatus::KeyNotFound;
+    }
+
+    MediaStatus decrypt_status;
+    if (!SegmentEncodedFrame::DecryptInPlace(input.get(), eme,
+                                             &decrypt_status)) {
+      decrypted_.resize(input->data_size);
+      decrypt_status = input->Decrypt(eme, decrypted_.data());
+      data = decrypted_.data();
+    }
+    if (decrypt_status == MediaStatus::KeyNotFound)
+      return MediaStatus::KeyNotFound;
+    if (decrypt_status != MediaStatus::Success) {
+      *extra_info = "CDM returned error while decrypting frame";
+      return MediaStatus::FatalError;
+    }
+  }
+
+  if (!has_buffered_frames_) {
+    burst_pts_ = input->pts;
+    burst_duration_ = 0;
+  }
+  burst_duration_ += input->duration;
+
+  std::vector<uint8_t> burst;
+  switch (packetizer_.AddFrame(codec, data, input->data_size, &burst)) {
+    case Iec61937Packetizer::Result::Burst:
+      has_buffered_frames_ = false;
+      frames->emplace_back(new BurstFrame(
+          GetBurstStreamInfo(input->stream_info, codec), burst_pts_,
+          burst_duration_, &burst));
+      return MediaStatus::Success;
+    case Iec61937Packetizer::Result::NeedMoreData:
+      has_buffered_frames_ = true;
+      return MediaStatus::Success;
+    default:
+      has_buffered_frames_ = false;
+      *extra_info = "Invalid frame for audio passthrough";
+      return MediaStatus::FatalError;
+  }
+}
+
+void PassthroughDecoder::SetSkipNonReferenceFrames(bool skip) {
+  // Every AC-3 and E-AC-3 frame is needed to make the bursts.
+  if (fallback_)
+    fallback_->SetSkipNonReferenceFrames(skip);
+}
+
+void PassthroughDecoder::SetMaxOutputSize(uint32_t width, uint32_t height) {
+  if (fallback_)
+    fallback_->SetMaxOutputSize(width, height);
+}
+
+void PassthroughDecoder::SetPreferredPixelFormats(
+    const std::vector<PixelFormat>& formats) {
+  if (fallback_)
+    fallback_->SetPreferredPixelFormats(formats);
+}
+
+bool PassthroughDecoder::IsPassedThrough(
+    const std::string& codec, Iec61937Packetizer::Codec* result) const {
+  if (!GetPassthroughCodec(codec, result))
+    return false;
+  return *result == Iec61937Packetizer::Codec::Ac3 ? passthrough_ac3_
+                                                   : passthrough_eac3_;
+}
+
+std::shared_ptr<const StreamInfo> PassthroughDecoder::GetBurstStreamInfo(
+    std::shared_ptr<const StreamInfo> source,
+    Iec61937Packetizer::Codec codec) {
+  if (source != source_info_) {
+    // Reuse the StreamInfo when the format is the same so the audio renderer
+    // doesn't reset the device at every new stream.
+    const uint32_t sample_rate =
+        Iec61937Packetizer::GetBurstSampleRate(codec, source->sample_rate);
+    if (!burst_info_ || burst_info_->codec != source->codec ||
+        burst_info_->sample_rate != sample_rate) {
+      burst_info_.reset(new StreamInfo(
+          source->mime_type, source->codec, /* is_video= */ false,
+          source->time_scale, source->sample_aspect_ratio, source->extra_data,
+          /* width= */ 0, /* height= */ 0, /* channel_count= */ 2,
+          sample_rate));
+    }
+    source_info_ = source;
+  }
+  return burst_info_;
+}
+
+
+std::unique_ptr<Decoder> Decoder::CreatePassthroughDecoder(
+    Decoder* fallback, const std::vector<std::string>& codecs) {
+  return std::unique_ptr<Decoder>(new PassthroughDecoder(fallback, codecs));
+}
+
+}  // namespace media
+}  // namespace shaka
@@ -0,0 +1,91 @@
+// Copyright 2020 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     https://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef SHAKA_EMBEDDED_MEDIA_PASSTHROUGH_DECODER_H_
+#define SHAKA_EMBEDDED_MEDIA_PASSTHROUGH_DECODER_H_
+
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "shaka/media/decoder.h"
+#include "shaka/media/stream_info.h"
+#include "src/media/iec61937.h"
+
+namespace shaka {
+namespace media {
+
+/**
+ * A Decoder that doesn't decode AC-3 and E-AC-3 audio; instead the compressed
+ * frames are packed into IEC 61937 bursts (SampleFormat::Iec61937) for the
+ * audio sink to decode.  Other codecs are given to a fallback decoder.
+ *
+ * See Decoder::CreatePassthroughDecoder.
+ */
+class PassthroughDecoder final : public Decoder {
+ public:
+  PassthroughDecoder(Decoder* fallback, const std::vector<std::string>& codecs);
+  ~PassthroughDecoder() override;
+
+  /**
+   * Gets the passthrough codec for the given codec string.
+   * @return True if the codec can be passed through.
+   */
+  static bool GetPassthroughCodec(const std::string& codec,
+                                  Iec61937Packetizer::Codec* result);
+
+  MediaCapabilitiesInfo DecodingInfo(
+      const MediaDecodingConfiguration& config) const override;
+  void ResetDecoder() override;
+  MediaStatus Decode(std::shared_ptr<EncodedFrame> input,
+                     const eme::Implementation* eme,
+                     std::vector<std::shared_ptr<DecodedFrame>>* frames,
+                     std::string* extra_info) override;
+  void SetSkipNonReferenceFrames(bool skip) override;
+  void SetMaxOutputSize(uint32_t width, uint32_t height) override;
+  void SetPreferredPixelFormats(
+      const std::vector<PixelFormat>& formats) override;
+
+ private:
+  /** @return Whether the sink accepts the given codec. */
+  bool IsPassedThrough(const std::string& codec,
+                       Iec61937Packetizer::Codec* result) const;
+
+  /**
+   * @return The StreamInfo of the bursts made from the given stream, which
+   *   describes the 16-bit stereo PCM the bursts are sent as.
+   */
+  std::shared_ptr<const StreamInfo> GetBurstStreamInfo(
+      std::shared_ptr<const StreamInfo> source,
+      Iec61937Packetizer::Codec codec);
+
+  Decoder* const fallback_;
+  bool passthrough_ac3_;
+  bool passthrough_eac3_;
+
+  Iec61937Packetizer packetizer_;
+  std::shared_ptr<const StreamInfo> source_info_;
+  std::shared_ptr<const StreamInfo> burst_info_;
+  // Holds the clear data of frames that can't be decrypted in place.
+  std::vector<uint8_t> decrypted_;
+  // The time of the frames buffered in |packetizer_|.
+  double burst_pts_;
+  double burst_duration_;
+  bool has_buffered_frames_;
+};
+
+}  // namespace media
+}  // namespace shaka
+
+#endif  // SHAKA_EMBEDDED_MEDIA_PASSTHROUGH_DECODER_H_
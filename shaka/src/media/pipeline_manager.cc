@@ -25,78 +25,91 @@ namespace media {
 
 PipelineManager::PipelineManager(
     std::function<void(VideoPlaybackState)> on_status_changed,
-    std::function<void()> on_seek, const util::Clock* clock)
+    std::function<void()> on_seek, const util::Clock* clock,
+    MasterClock master_clock)
     : mutex_("PipelineManager"),
       on_status_changed_(std::move(on_status_changed)),
       on_seek_(std::move(on_seek)),
-      clock_(clock) {
+      clock_(clock),
+      master_clock_(std::move(master_clock)),
+      use_master_clock_(false) {
   Reset();
 }
 
 PipelineManager::~PipelineManager() {}
 
+void PipelineManager::SetUseMasterClock(bool use_master_clock) {
+  std::unique_lock<Mutex> lock(mutex_);
+  // Start from the current time so switching clocks doesn't jump.
+  SyncPoint();
+  use_master_clock_.store(use_master_clock, std::memory_order_relaxed);
+  PublishLocked();
+}
+
 void PipelineManager::Reset() {
-  std::unique_lock<SharedMutex> lock(mutex_);
-  status_ = VideoPlaybackState::Initializing;
-  prev_media_time_ = 0;
-  prev_wall_time_ = clock_->GetMonotonicTime();
-  playback_rate_ = 1;
-  duration_ = NAN;
+  std::unique_lock<Mutex> lock(mutex_);
+  state_.status = VideoPlaybackState::Initializing;
+  state_.prev_media_time = 0;
+  state_.prev_wall_time = clock_->GetMonotonicTime();
+  state_.playback_rate = 1;
+  state_.duration = NAN;
   will_play_ = false;
+  PublishLocked();
 }
 
 void PipelineManager::DoneInitializing() {
   VideoPlaybackState new_status;
   {
-    std::unique_lock<SharedMutex> lock(mutex_);
-    if (status_ == VideoPlaybackState::Errored)
+    std::unique_lock<Mutex> lock(mutex_);
+    if (state_.status == VideoPlaybackState::Errored)
       return;
-    DCHECK(status_ == VideoPlaybackState::Initializing);
+    DCHECK(state_.status == VideoPlaybackState::Initializing);
     if (will_play_) {
-      new_status = status_ = VideoPlaybackState::Buffering;
+      new_status = state_.status = VideoPlaybackState::Buffering;
     } else {
-      new_status = status_ = VideoPlaybackState::Paused;
+      new_status = state_.status = VideoPlaybackState::Paused;
     }
+    PublishLocked();
   }
   on_status_changed_(new_status);
 }
 
 VideoPlaybackState PipelineManager::GetPlaybackState() const {
-  util::shared_lock<SharedMutex> lock(mutex_);
-  return status_;
+  return published_.Load().status;
 }
 
 double PipelineManager::GetDuration() const {
-  util::shared_lock<SharedMutex> lock(mutex_);
-  return duration_;
+  return published_.Load().duration;
 }
 
 void PipelineManager::SetDuration(double duration) {
   VideoPlaybackState new_status = VideoPlaybackState::Initializing;
   {
-    std::unique_lock<SharedMutex> lock(mutex_);
-    duration_ = duration;
+    std::unique_lock<Mutex> lock(mutex_);
+    state_.duration = duration;
+    PublishLocked();
 
     // Seek to duration if current time is past the new duration.
     const uint64_t wall_time = clock_->GetMonotonicTime();
-    if (!std::isnan(duration) && GetTimeFor(wall_time) > duration) {
+    if (!std::isnan(duration) && GetTimeFor(state_, wall_time) > duration) {
       {
-        util::Unlocker<SharedMutex> unlock(&lock);
+        util::Unlocker<Mutex> unlock(&lock);
         on_seek_();
       }
 
-      prev_media_time_ = duration;
-      prev_wall_time_ = wall_time;
-      if (status_ == VideoPlaybackState::Playing ||
-          status_ == VideoPlaybackState::Buffering ||
-          status_ == VideoPlaybackState::WaitingForKey) {
+      state_.prev_media_time = duration;
+      state_.prev_wall_time = wall_time;
+      if (state_.status == VideoPlaybackState::Playing ||
+          state_.status == VideoPlaybackState::Buffering ||
+          state_.status == VideoPlaybackState::WaitingForKey) {
         will_play_ = true;
-        new_status = status_ = VideoPlaybackState::Seeking;
-      } else if (status_ == VideoPlaybackState::Paused ||
-                 status_ == VideoPlaybackState::Ended) {
+        new_status = state_.status = VideoPlaybackState::Seeking;
+      } else if (state_.status == VideoPlaybackState::Paused ||
+                 state_.status == VideoPlaybackState::Ended) {
         will_play_ = false;
-        new_status = status_ = VideoPlaybackState::Seeking;
+        new_status = state_.status = VideoPlaybackState::Seeking;
       }
+      PublishLocked();
     }
   }
   if (new_status != VideoPlaybackState::Initializing)
@@ -104,38 +117,42 @@ void PipelineManager::SetDuration(double duration) {
 }
 
 double PipelineManager::GetCurrentTime() const {
-  util::shared_lock<SharedMutex> lock(mutex_);
-  return GetTimeFor(clock_->GetMonotonicTime());
+  const ClockState state = published_.Load();
+  double time;
+  if (GetMasterTime(state, &time))
+    return std::isnan(state.duration) ? time : std::min(state.duration, time);
+  return GetTimeFor(state, clock_->GetMonotonicTime());
 }
 
 void PipelineManager::SetCurrentTime(double time) {
   VideoPlaybackState new_status = VideoPlaybackState::Initializing;
   {
-    std::unique_lock<SharedMutex> lock(mutex_);
-    if (status_ != VideoPlaybackState::Initializing) {
+    std::unique_lock<Mutex> lock(mutex_);
+    if (state_.status != VideoPlaybackState::Initializing) {
       {
-        util::Unlocker<SharedMutex> unlock(&lock);
+        util::Unlocker<Mutex> unlock(&lock);
         on_seek_();
       }
 
-      prev_media_time_ =
-          std::isnan(duration_) ? time : std::min(duration_, time);
-      prev_wall_time_ = clock_->GetMonotonicTime();
-      switch (status_) {
+      state_.prev_media_time =
+          std::isnan(state_.duration) ? time : std::min(state_.duration, time);
+      state_.prev_wall_time = clock_->GetMonotonicTime();
+      switch (state_.status) {
         case VideoPlaybackState::Playing:
         case VideoPlaybackState::Buffering:
         case VideoPlaybackState::WaitingForKey:
           will_play_ = true;
-          new_status = status_ = VideoPlaybackState::Seeking;
+          new_status = state_.status = VideoPlaybackState::Seeking;
           break;
         case VideoPlaybackState::Paused:
         case VideoPlaybackState::Ended:
           will_play_ = false;
-          new_status = status_ = VideoPlaybackState::Seeking;
+          new_status = state_.status = VideoPlaybackState::Seeking;
           break;
         default:  // Ignore remaining enum values.
           break;
       }
+      PublishLocked();
     }
   }
   if (new_status != VideoPlaybackState::Initializing)
@@ -143,34 +160,35 @@ void PipelineManager::SetCurrentTime(double time) {
 }
 
 double PipelineManager::GetPlaybackRate() const {
-  util::shared_lock<SharedMutex> lock(mutex_);
-  return playback_rate_;
+  return published_.Load().playback_rate;
 }
 
 void PipelineManager::SetPlaybackRate(double rate) {
-  std::unique_lock<SharedMutex> lock(mutex_);
+  std::unique_lock<Mutex> lock(mutex_);
   SyncPoint();
-  playback_rate_ = rate;
+  state_.playback_rate = rate;
+  PublishLocked();
 }
 
 void PipelineManager::Play() {
   VideoPlaybackState new_status = VideoPlaybackState::Initializing;
   {
-    std::unique_lock<SharedMutex> lock(mutex_);
+    std::unique_lock<Mutex> lock(mutex_);
     SyncPoint();
     will_play_ = true;
-    if (status_ == VideoPlaybackState::Paused) {
+    if (state_.status == VideoPlaybackState::Paused) {
       // Assume we are stalled; we will transition to Playing quickly if not.
-      new_status = status_ = VideoPlaybackState::Buffering;
-    } else if (status_ == VideoPlaybackState::Ended) {
+      new_status = state_.status = VideoPlaybackState::Buffering;
+    } else if (state_.status == VideoPlaybackState::Ended) {
       {
-        util::Unlocker<SharedMutex> unlock(&lock);
+        util::Unlocker<Mutex> unlock(&lock);
         on_seek_();
       }
 
-      prev_media_time_ = 0;
-      new_status = status_ = VideoPlaybackState::Seeking;
+      state_.prev_media_time = 0;
+      new_status = state_.status = VideoPlaybackState::Seeking;
     }
+    PublishLocked();
   }
   if (new_status != VideoPlaybackState::Initializing)
     on_status_changed_(new_status);
@@ -179,14 +197,15 @@ void PipelineManager::Play() {
 void PipelineManager::Pause() {
   VideoPlaybackState new_status = VideoPlaybackState::Initializing;
   {
-    std::unique_lock<SharedMutex> lock(mutex_);
+    std::unique_lock<Mutex> lock(mutex_);
     SyncPoint();
     will_play_ = false;
-    if (status_ == VideoPlaybackState::Playing ||
-        status_ == VideoPlaybackState::Buffering ||
-        status_ == VideoPlaybackState::WaitingForKey) {
-      new_status = status_ = VideoPlaybackState::Paused;
+    if (state_.status == VideoPlaybackState::Playing ||
+        state_.status == VideoPlaybackState::Buffering ||
+        state_.status == VideoPlaybackState::WaitingForKey) {
+      new_status = state_.status = VideoPlaybackState::Paused;
     }
+    PublishLocked();
   }
   if (new_status != VideoPlaybackState::Initializing)
     on_status_changed_(new_status);
@@ -195,10 +214,11 @@ void PipelineManager::Pause() {
 void PipelineManager::Buffering() {
   bool status_changed = false;
   {
-    std::unique_lock<SharedMutex> lock(mutex_);
-    if (status_ == VideoPlaybackState::Playing) {
+    std::unique_lock<Mutex> lock(mutex_);
+    if (state_.status == VideoPlaybackState::Playing) {
       SyncPoint();
-      status_ = VideoPlaybackState::Buffering;
+      state_.status = VideoPlaybackState::Buffering;
+      PublishLocked();
       status_changed = true;
     }
   }
@@ -209,16 +229,17 @@ void PipelineManager::Buffering() {
 void PipelineManager::CanPlay() {
   VideoPlaybackState new_status = VideoPlaybackState::Initializing;
   {
-    std::unique_lock<SharedMutex> lock(mutex_);
+    std::unique_lock<Mutex> lock(mutex_);
     SyncPoint();
-    if (status_ == VideoPlaybackState::Buffering ||
-        status_ == VideoPlaybackState::WaitingForKey ||
-        status_ == VideoPlaybackState::Seeking) {
+    if (state_.status == VideoPlaybackState::Buffering ||
+        state_.status == VideoPlaybackState::WaitingForKey ||
+        state_.status == VideoPlaybackState::Seeking) {
       if (will_play_)
-        new_status = status_ = VideoPlaybackState::Playing;
+        new_status = state_.status = VideoPlaybackState::Playing;
       else
-        new_status = status_ = VideoPlaybackState::Paused;
+        new_status = state_.status = VideoPlaybackState::Paused;
     }
+    PublishLocked();
   }
   if (new_status != VideoPlaybackState::Initializing)
     on_status_changed_(new_status);
@@ -227,14 +248,15 @@ void PipelineManager::CanPlay() {
 void PipelineManager::OnEnded() {
   VideoPlaybackState new_status = VideoPlaybackState::Initializing;
   {
-    std::unique_lock<SharedMutex> lock(mutex_);
-    if (status_ != VideoPlaybackState::Ended &&
-        status_ != VideoPlaybackState::Errored) {
+    std::unique_lock<Mutex> lock(mutex_);
+    if (state_.status != VideoPlaybackState::Ended &&
+        state_.status != VideoPlaybackState::Errored) {
       const uint64_t wall_time = clock_->GetMonotonicTime();
-      DCHECK(!std::isnan(duration_));
-      prev_wall_time_ = wall_time;
-      prev_media_time_ = duration_;
-      new_status = status_ = VideoPlaybackState::Ended;
+      DCHECK(!std::isnan(state_.duration));
+      state_.prev_wall_time = wall_time;
+      state_.prev_media_time = state_.duration;
+      new_status = state_.status = VideoPlaybackState::Ended;
+      PublishLocked();
     }
   }
   if (new_status != VideoPlaybackState::Initializing)
@@ -244,10 +266,11 @@ void PipelineManager::OnEnded() {
 void PipelineManager::OnError() {
   bool fire_event = false;
   {
-    std::unique_lock<SharedMutex> lock(mutex_);
-    if (status_ != VideoPlaybackState::Errored) {
+    std::unique_lock<Mutex> lock(mutex_);
+    if (state_.status != VideoPlaybackState::Errored) {
       SyncPoint();
-      status_ = VideoPlaybackState::Errored;
+      state_.status = VideoPlaybackState::Errored;
+      PublishLocked();
       fire_event = true;
     }
   }
@@ -255,19 +278,38 @@ void PipelineManager::OnError() {
     on_status_changed_(VideoPlaybackState::Errored);
 }
 
-double PipelineManager::GetTimeFor(uint64_t wall_time) const {
-  if (status_ != VideoPlaybackState::Playing)
-    return prev_media_time_;
+double PipelineManager::GetTimeFor(const ClockState& state,
+                                   uint64_t wall_time) {
+  if (state.status != VideoPlaybackState::Playing)
+    return state.prev_media_time;
+
+  const uint64_t wall_diff = wall_time - state.prev_wall_time;
+  const double time =
+      state.prev_media_time + (wall_diff * state.playback_rate / 1000.0);
+  return std::isnan(state.duration) ? time : std::min(state.duration, time);
+}
 
-  const uint64_t wall_diff = wall_time - prev_wall_time_;
-  const double time = prev_media_time_ + (wall_diff * playback_rate_ / 1000.0);
-  return std::isnan(duration_) ? time : std::min(duration_, time);
+bool PipelineManager::GetMasterTime(const ClockState& state,
+                                    double* time) const {
+  return state.status == VideoPlaybackState::Playing && master_clock_ &&
+         use_master_clock_.load(std::memory_order_relaxed) &&
+         master_clock_(time);
 }
 
 void PipelineManager::SyncPoint() {
   const uint64_t wall_time = clock_->GetMonotonicTime();
-  prev_media_time_ = GetTimeFor(wall_time);
-  prev_wall_time_ = wall_time;
+  double time;
+  if (GetMasterTime(state_, &time)) {
+    state_.prev_media_time =
+        std::isnan(state_.duration) ? time : std::min(state_.duration, time);
+  } else {
+    state_.prev_media_time = GetTimeFor(state_, wall_time);
+  }
+  state_.prev_wall_time = wall_time;
+}
+
+void PipelineManager::PublishLocked() {
+  published_.Store(state_);
 }
 
 }  // namespace media
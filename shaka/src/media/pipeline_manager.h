@@ -16,11 +16,13 @@
 #define SHAKA_EMBEDDED_MEDIA_PIPELINE_MANAGER_H_
 
 #include <atomic>
+#include <functional>
 #include <thread>
 
 #include "shaka/media/media_player.h"
 #include "src/debug/mutex.h"
 #include "src/util/clock.h"
+#include "src/util/seqlock.h"
 
 namespace shaka {
 namespace media {
@@ -31,6 +33,10 @@ namespace media {
  * is in charge of tracking the amount of content that is buffered and whether
  * playback is actually possible.
  *
+ * The getters don't take a lock since they are called from many threads, often
+ * several times per frame; they read a copy of the clock state that is
+ * published after each change.
+ *
  * This type is thread safe; however if calls are made to this from multiple
  * threads at once, it is unspecified what order the changes will happen
  * including the order of the calls to |on_status_changed|.  The callback is
@@ -41,10 +47,26 @@ namespace media {
  */
 class PipelineManager {
  public:
+  /**
+   * A clock that gives the media time being played (e.g. by the audio
+   * device), or false if it isn't known.  This is called from many threads
+   * and must not block.
+   */
+  using MasterClock = std::function<bool(double* time)>;
+
   PipelineManager(std::function<void(VideoPlaybackState)> on_status_changed,
-                  std::function<void()> on_seek, const util::Clock* clock);
+                  std::function<void()> on_seek, const util::Clock* clock,
+                  MasterClock master_clock = nullptr);
   virtual ~PipelineManager();
 
+  /**
+   * Sets whether to follow the master clock while playing.  When it gives a
+   * time, that is used as the current time instead of advancing the time
+   * with the wall clock; this keeps the video in sync with devices whose
+   * clock deviates from the system clock.  Otherwise, the wall clock is used.
+   */
+  void SetUseMasterClock(bool use_master_clock);
+
   /** Resets the state to the initial state; this doesn't raise events. */
   virtual void Reset();
 
@@ -94,8 +116,25 @@ class PipelineManager {
   virtual void OnError();
 
  private:
+  /** The state that is needed to compute the current time. */
+  struct ClockState {
+    VideoPlaybackState status;
+    /** The media time at the last sync point. */
+    double prev_media_time;
+    /** The wall-clock time at the last sync point. */
+    uint64_t prev_wall_time;
+    double playback_rate;
+    double duration;
+  };
+
   /** @return The video time for the given wall-clock time. */
-  double GetTimeFor(uint64_t wall_time) const;
+  static double GetTimeFor(const ClockState& state, uint64_t wall_time);
+
+  /**
+   * Gets the time from the master clock, if it is used and the given state is
+   * playing.
+   */
+  bool GetMasterTime(const ClockState& state, double* time) const;
 
   /**
    * Introduces a time sync point.  This avoids rounding errors by reducing the
@@ -108,18 +147,19 @@ class PipelineManager {
    */
   void SyncPoint();
 
-  mutable SharedMutex mutex_;
+  /** Makes the changes to |state_| visible to the getters. */
+  void PublishLocked();
+
+  Mutex mutex_;
   const std::function<void(VideoPlaybackState)> on_status_changed_;
   const std::function<void()> on_seek_;
   const util::Clock* const clock_;
-  VideoPlaybackState status_;
-
-  /** The media time at the last sync point. */
-  double prev_media_time_;
-  /** The wall-clock time at the last sync point. */
-  uint64_t prev_wall_time_;
-  double playback_rate_;
-  double duration_;
+  const MasterClock master_clock_;
+  std::atomic<bool> use_master_clock_;
+  // The current state; this is only used while holding |mutex_|.
+  ClockState state_;
+  // A copy of |state_| that is read without holding |mutex_|.
+  util::SeqLock<ClockState> published_;
   bool will_play_;
 };
 
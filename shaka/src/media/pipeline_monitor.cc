@@ -14,10 +14,12 @@
 
 #include "src/media/pipeline_monitor.h"
 
+#include <math.h>
+
+#include <algorithm>
 #include <utility>
 
 #include "shaka/media/streams.h"
-#include "src/util/utils.h"
 
 namespace shaka {
 namespace media {
@@ -26,8 +28,15 @@ namespace {
 
 /** The number of seconds of content needed to be able to play forward. */
 constexpr const double kNeedForPlay = 0.3;
+/** The number of seconds needed to play forward in low-latency mode. */
+constexpr const double kLowLatencyNeedForPlay = 0.1;
 /** The number of seconds difference to assume we are at the end. */
 constexpr const double kEpsilon = 0.1;
+/**
+ * The minimum number of seconds to wait when waiting for the playhead.  This
+ * avoids spinning when the playhead is at the end of the range.
+ */
+constexpr const double kMinWait = 0.01;
 
 bool IsBufferedUntil(const BufferedRanges& ranges, double start_time,
                      double end_time, double duration) {
@@ -40,8 +49,18 @@ bool IsBufferedUntil(const BufferedRanges& ranges, double start_time,
   return false;
 }
 
-bool CanPlay(const BufferedRanges& ranges, double time, double duration) {
-  return IsBufferedUntil(ranges, time, time + kNeedForPlay, duration);
+bool CanPlay(const BufferedRanges& ranges, double time, double duration,
+             double need_for_play) {
+  return IsBufferedUntil(ranges, time, time + need_for_play, duration);
+}
+
+/** @return The end of the range containing the given time, or the time. */
+double BufferedEnd(const BufferedRanges& ranges, double time) {
+  for (auto& range : ranges) {
+    if (range.start <= time + StreamBase::kMaxGapSize && range.end >= time)
+      return range.end;
+  }
+  return time;
 }
 
 }  // namespace
@@ -50,34 +69,28 @@ PipelineMonitor::PipelineMonitor(
     std::function<BufferedRanges()> get_buffered,
     std::function<BufferedRanges()> get_decoded,
     std::function<void(VideoReadyState)> ready_state_changed,
-    const util::Clock* clock, PipelineManager* pipeline)
+    const util::Clock* clock, PipelineManager* pipeline, WorkerPool* pool)
     : mutex_("PipelineMonitor"),
-      start_("PipelineMonitor::Start"),
       get_buffered_(std::move(get_buffered)),
       get_decoded_(std::move(get_decoded)),
       ready_state_changed_(std::move(ready_state_changed)),
       clock_(clock),
       pipeline_(pipeline),
-      shutdown_(false),
       running_(false),
+      low_latency_(false),
       ready_state_(VideoReadyState::HaveNothing),
-      thread_("PipelineMonitor",
-              std::bind(&PipelineMonitor::ThreadMain, this)) {}
+      task_("PipelineMonitor", pool, clock,
+            std::bind(&PipelineMonitor::Step, this)) {}
 
 PipelineMonitor::~PipelineMonitor() {
-  {
-    std::unique_lock<Mutex> lock(mutex_);
-    shutdown_ = true;
-    start_.SignalAllIfNotSet();
-  }
-  thread_.join();
+  task_.Stop();
 }
 
 void PipelineMonitor::Start() {
   std::unique_lock<Mutex> lock(mutex_);
   ready_state_ = VideoReadyState::HaveNothing;
   running_ = true;
-  start_.SignalAllIfNotSet();
+  task_.Wake();
 }
 
 void PipelineMonitor::Stop() {
@@ -85,52 +98,72 @@ void PipelineMonitor::Stop() {
   running_ = false;
 }
 
-void PipelineMonitor::ThreadMain() {
+void PipelineMonitor::Wake() {
+  task_.Wake();
+}
+
+void PipelineMonitor::SetPriority(int priority) {
+  task_.SetPriority(priority);
+}
+
+void PipelineMonitor::SetLowLatency(bool low_latency) {
   std::unique_lock<Mutex> lock(mutex_);
-  while (!shutdown_) {
-    if (!running_) {
-      start_.ResetAndWaitWhileUnlocked(lock);
-      continue;
-    }
+  low_latency_ = low_latency;
+  task_.Wake();
+}
 
-    const BufferedRanges buffered = get_buffered_();
-    const BufferedRanges decoded = get_decoded_();
-    const double time = pipeline_->GetCurrentTime();
-    const double duration = pipeline_->GetDuration();
-    const auto state = pipeline_->GetPlaybackState();
-    // Don't move playhead until we have decoded at the current time.  This
-    // ensures we stop for decryption errors and that we don't blindly move
-    // forward without the correct frames.
-    // If we're already playing, keep playing until the end of the buffered
-    // range; otherwise wait until we have buffered some amount ahead of the
-    // playhead.
-    const bool is_playing = state == VideoPlaybackState::Playing;
-    const bool has_current_frame =
-        IsBufferedUntil(decoded, time, time, duration);
-    const bool can_start =
-        CanPlay(buffered, time, duration) && has_current_frame;
-    const bool can_play = is_playing ? has_current_frame : can_start;
-    if (time >= duration) {
-      pipeline_->OnEnded();
-    } else if (can_play) {
-      pipeline_->CanPlay();
-    } else {
-      pipeline_->Buffering();
-    }
+double PipelineMonitor::Step() {
+  std::unique_lock<Mutex> lock(mutex_);
+  if (!running_)
+    return WorkerTask::kWaitForWake;
+
+  const BufferedRanges buffered = get_buffered_();
+  const BufferedRanges decoded = get_decoded_();
+  const double time = pipeline_->GetCurrentTime();
+  const double duration = pipeline_->GetDuration();
+  const auto state = pipeline_->GetPlaybackState();
+  // Don't move playhead until we have decoded at the current time.  This
+  // ensures we stop for decryption errors and that we don't blindly move
+  // forward without the correct frames.
+  // If we're already playing, keep playing until the end of the buffered
+  // range; otherwise wait until we have buffered some amount ahead of the
+  // playhead.
+  const bool is_playing = state == VideoPlaybackState::Playing;
+  const bool has_current_frame = IsBufferedUntil(decoded, time, time, duration);
+  const double need_for_play =
+      low_latency_ ? kLowLatencyNeedForPlay : kNeedForPlay;
+  const bool can_start =
+      CanPlay(buffered, time, duration, need_for_play) && has_current_frame;
+  const bool can_play = is_playing ? has_current_frame : can_start;
+  if (time >= duration) {
+    pipeline_->OnEnded();
+  } else if (can_play) {
+    pipeline_->CanPlay();
+  } else {
+    pipeline_->Buffering();
+  }
 
-    if (state == VideoPlaybackState::Initializing) {
-      ChangeReadyState(VideoReadyState::HaveNothing);
-    } else if (can_play) {
-      ChangeReadyState(VideoReadyState::HaveFutureData);
-    } else if (has_current_frame) {
-      ChangeReadyState(VideoReadyState::HaveCurrentData);
-    } else {
-      ChangeReadyState(VideoReadyState::HaveMetadata);
-    }
+  if (state == VideoPlaybackState::Initializing) {
+    ChangeReadyState(VideoReadyState::HaveNothing);
+  } else if (can_play) {
+    ChangeReadyState(VideoReadyState::HaveFutureData);
+  } else if (has_current_frame) {
+    ChangeReadyState(VideoReadyState::HaveCurrentData);
+  } else {
+    ChangeReadyState(VideoReadyState::HaveMetadata);
+  }
 
-    util::Unlocker<Mutex> unlock(&lock);
-    clock_->SleepSeconds(0.01);
+  // Nothing changes on its own unless the playhead is moving, in which case
+  // wake up once it reaches the end of the decoded content or the duration.
+  double wait = HUGE_VAL;
+  if (is_playing && can_play && !(time >= duration)) {
+    const double rate = pipeline_->GetPlaybackRate();
+    if (rate > 0) {
+      const double end = std::min(BufferedEnd(decoded, time), duration);
+      wait = std::max((end - time) / rate, kMinWait);
+    }
   }
+  return wait;
 }
 
 void PipelineMonitor::ChangeReadyState(VideoReadyState new_state) {
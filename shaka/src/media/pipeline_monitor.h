@@ -18,27 +18,33 @@
 #include <functional>
 
 #include "shaka/media/media_player.h"
+#include "shaka/media/worker_pool.h"
 #include "src/debug/mutex.h"
-#include "src/debug/thread.h"
-#include "src/debug/thread_event.h"
 #include "src/media/pipeline_manager.h"
 #include "src/media/types.h"
+#include "src/media/worker_task.h"
 #include "src/util/clock.h"
 
 namespace shaka {
 namespace media {
 
 /**
- * This manages a thread that monitors the media pipeline and updates the state
- * based on the currently buffered content.  This also handles transitioning to
- * ended.
+ * This manages a background task that monitors the media pipeline and updates
+ * the state based on the currently buffered content.  This also handles
+ * transitioning to ended.  The task runs on the given WorkerPool, or on its own
+ * thread if there isn't one.
+ *
+ * The task only wakes up when Wake() is called or when the playhead will
+ * reach the end of the decoded content; so Wake() must be called whenever the
+ * buffered ranges or the pipeline state change.
  */
 class PipelineMonitor {
  public:
   PipelineMonitor(std::function<BufferedRanges()> get_buffered,
                   std::function<BufferedRanges()> get_decoded,
                   std::function<void(VideoReadyState)> ready_state_changed,
-                  const util::Clock* clock, PipelineManager* pipeline);
+                  const util::Clock* clock, PipelineManager* pipeline,
+                  WorkerPool* pool = nullptr);
   ~PipelineMonitor();
 
   /** Starts monitoring the current state. */
@@ -47,24 +53,45 @@ class PipelineMonitor {
   /** Stops monitoring and waits for a call to start. */
   void Stop();
 
+  /**
+   * Wakes the thread to check the state again.  This should be called when
+   * the buffered ranges, the playback state, or the playback rate change.
+   */
+  void Wake();
+
+  /** Sets the priority of the task when running on a WorkerPool. */
+  void SetPriority(int priority);
+
+  /**
+   * Sets whether to start playing with less content buffered ahead of the
+   * playhead, for low-latency live streams.
+   */
+  void SetLowLatency(bool low_latency);
+
  private:
-  void ThreadMain();
+  /**
+   * Checks the current state.
+   * @return The number of seconds until the state needs to be checked again.
+   */
+  double Step();
 
   void ChangeReadyState(VideoReadyState new_state);
 
   Mutex mutex_;
-  ThreadEvent<void> start_;
 
   const std::function<BufferedRanges()> get_buffered_;
   const std::function<BufferedRanges()> get_decoded_;
   const std::function<void(VideoReadyState)> ready_state_changed_;
   const util::Clock* const clock_;
   PipelineManager* const pipeline_;
-  bool shutdown_;
   bool running_;
+  bool low_latency_;
   VideoReadyState ready_state_;
 
-  Thread thread_;
+  // This doesn't use |mutex_|, so Wake() can be called from callbacks while
+  // other locks are held.  Should be last so the task starts after all the
+  // fields are initialized.
+  WorkerTask task_;
 };
 
 }  // namespace media
@@ -0,0 +1,432 @@
+// Copyright 2020 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     https://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "src/media/pixel_conversion.h"
+
+#include <glog/logging.h>
+#include <string.h>
+
+#if defined(__SSE2__) || defined(_M_X64)
+#  include <emmintrin.h>
+#  define USE_SSE2
+#elif defined(__ARM_NEON) || defined(__ARM_NEON__)
+#  include <arm_neon.h>
+#  define USE_NEON
+#endif
+
+#include <algorithm>
+#include <cmath>
+
+namespace shaka {
+namespace media {
+
+namespace {
+
+void ConvertRow16To8(const uint8_t* src, uint8_t* dest, size_t samples,
+                     unsigned int shift) {
+  size_t i = 0;
+#if defined(USE_SSE2)
+  const __m128i count = _mm_cvtsi32_si128(shift);
+  for (; i + 16 <= samples; i += 16) {
+    const __m128i low =
+        _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + i * 2));
+    const __m128i high =
+        _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + i * 2 + 16));
+    // The shift leaves at most 15 bits, so the signed saturation in packus
+    // clamps overly large values to 255.
+    const __m128i packed = _mm_packus_epi16(_mm_srl_epi16(low, count),
+                                            _mm_srl_epi16(high, count));
+    _mm_storeu_si128(reinterpret_cast<__m128i*>(dest + i), packed);
+  }
+#elif defined(USE_NEON)
+  const int16x8_t count = vdupq_n_s16(-static_cast<int16_t>(shift));
+  for (; i + 16 <= samples; i += 16) {
+    const uint16x8_t low = vreinterpretq_u16_u8(vld1q_u8(src + i * 2));
+    const uint16x8_t high = vreinterpretq_u16_u8(vld1q_u8(src + i * 2 + 16));
+    const uint8x16_t packed =
+        vcombine_u8(vqmovn_u16(vshlq_u16(low, count)),
+                    vqmovn_u16(vshlq_u16(high, count)));
+    vst1q_u8(dest + i, packed);
+  }
+#endif
+
+  for (; i < samples; i++) {
+    const unsigned int value = src[i * 2] | (src[i * 2 + 1] << 8);
+    dest[i] = static_cast<uint8_t>(std::min(value >> shift, 255u));
+  }
+}
+
+uint16_t ReadShifted16(const uint8_t* src, unsigned int shift) {
+  return static_cast<uint16_t>((src[0] | (src[1] << 8)) << shift);
+}
+
+void WriteUint16(uint16_t value, uint8_t* dest) {
+  dest[0] = static_cast<uint8_t>(value & 0xff);
+  dest[1] = static_cast<uint8_t>(value >> 8);
+}
+
+/**
+ * Halves a row of single components using the given two source rows.
+ * @return The number of output components written, which may be fewer than
+ *   |samples| if the rest need to be done by the caller.
+ */
+size_t DownscaleRow2x(const uint8_t* row0, const uint8_t* row1, uint8_t* dest,
+                      size_t samples) {
+  size_t i = 0;
+#if defined(USE_SSE2)
+  const __m128i low_bytes = _mm_set1_epi16(0x00ff);
+  for (; i + 16 <= samples; i += 16) {
+    // Average the rows, then the adjacent columns.
+    const __m128i a = _mm_avg_epu8(
+        _mm_loadu_si128(reinterpret_cast<const __m128i*>(row0 + i * 2)),
+        _mm_loadu_si128(reinterpret_cast<const __m128i*>(row1 + i * 2)));
+    const __m128i b = _mm_avg_epu8(
+        _mm_loadu_si128(reinterpret_cast<const __m128i*>(row0 + i * 2 + 16)),
+        _mm_loadu_si128(reinterpret_cast<const __m128i*>(row1 + i * 2 + 16)));
+    const __m128i a2 =
+        _mm_avg_epu16(_mm_and_si128(a, low_bytes), _mm_srli_epi16(a, 8));
+    const __m128i b2 =
+        _mm_avg_epu16(_mm_and_si128(b, low_bytes), _mm_srli_epi16(b, 8));
+    _mm_storeu_si128(reinterpret_cast<__m128i*>(dest + i),
+                     _mm_packus_epi16(a2, b2));
+  }
+#elif defined(USE_NEON)
+  for (; i + 16 <= samples; i += 16) {
+    // Average the rows, then the adjacent columns.
+    const uint8x16x2_t top = vld2q_u8(row0 + i * 2);
+    const uint8x16x2_t bottom = vld2q_u8(row1 + i * 2);
+    vst1q_u8(dest + i, vrhaddq_u8(vrhaddq_u8(top.val[0], bottom.val[0]),
+                                  vrhaddq_u8(top.val[1], bottom.val[1])));
+  }
+#endif
+  return i;
+}
+
+int16_t ToFixedPoint(double coefficient) {
+  return static_cast<int16_t>(std::lround(coefficient * 16384));
+}
+
+uint8_t ClampToByte(int value) {
+  return static_cast<uint8_t>(std::min(std::max(value, 0), 255));
+}
+
+void WriteRgba(int y, int r_add, int g_add, int b_add, uint8_t* dest) {
+  // The values have 6 fractional bits; round them to bytes.
+  dest[0] = ClampToByte((y + r_add + 32) >> 6);
+  dest[1] = ClampToByte((y + g_add + 32) >> 6);
+  dest[2] = ClampToByte((y + b_add + 32) >> 6);
+  dest[3] = 255;
+}
+
+#if defined(USE_SSE2)
+/**
+ * Converts 8 pixels.  |c| holds the offset Y values in the high bytes, |d|
+ * and |e| hold the U and V values for each pixel, minus 128.
+ */
+void ConvertPixelsToRgba(__m128i c, __m128i d, __m128i e,
+                         const YuvToRgbMatrix& matrix, uint8_t* dest) {
+  const __m128i y = _mm_mulhi_epu16(c, _mm_set1_epi16(matrix.y_scale));
+  d = _mm_slli_epi16(d, 8);
+  e = _mm_slli_epi16(e, 8);
+  const __m128i round = _mm_set1_epi16(32);
+  // This saturates, but only for values that will be clamped to 255 anyway.
+  const __m128i r =
+      _mm_adds_epi16(_mm_adds_epi16(y, round),
+                     _mm_mulhi_epi16(e, _mm_set1_epi16(matrix.r_v)));
+  const __m128i g = _mm_subs_epi16(
+      _mm_subs_epi16(_mm_adds_epi16(y, round),
+                     _mm_mulhi_epi16(d, _mm_set1_epi16(matrix.g_u))),
+      _mm_mulhi_epi16(e, _mm_set1_epi16(matrix.g_v)));
+  const __m128i b = _mm_adds_epi16(
+      _mm_adds_epi16(_mm_adds_epi16(y, round), _mm_srai_epi16(d, 1)),
+      _mm_mulhi_epi16(d, _mm_set1_epi16(matrix.b_u)));
+
+  const __m128i r8 = _mm_packus_epi16(_mm_srai_epi16(r, 6), r);
+  const __m128i g8 = _mm_packus_epi16(_mm_srai_epi16(g, 6), g);
+  const __m128i b8 = _mm_packus_epi16(_mm_srai_epi16(b, 6), b);
+  const __m128i rg = _mm_unpacklo_epi8(r8, g8);
+  const __m128i ba = _mm_unpacklo_epi8(b8, _mm_set1_epi8(-1));
+  _mm_storeu_si128(reinterpret_cast<__m128i*>(dest),
+                   _mm_unpacklo_epi16(rg, ba));
+  _mm_storeu_si128(reinterpret_cast<__m128i*>(dest + 16),
+                   _mm_unpackhi_epi16(rg, ba));
+}
+#elif defined(USE_NEON)
+/**
+ * Converts 8 pixels.  |c| holds the offset Y values shifted up by 7 bits, |d|
+ * and |e| hold the U and V values for each pixel, minus 128.
+ */
+void ConvertPixelsToRgba(int16x8_t c, int16x8_t d, int16x8_t e,
+                         const YuvToRgbMatrix& matrix, uint8_t* dest) {
+  // vqdmulh doubles the product, so this matches the scalar code.
+  const int16x8_t y = vqdmulhq_n_s16(c, matrix.y_scale);
+  d = vshlq_n_s16(d, 7);
+  e = vshlq_n_s16(e, 7);
+  const int16x8_t y_round = vqaddq_s16(y, vdupq_n_s16(32));
+  // This saturates, but only for values that will be clamped to 255 anyway.
+  const int16x8_t r = vqaddq_s16(y_round, vqdmulhq_n_s16(e, matrix.r_v));
+  const int16x8_t g =
+      vqsubq_s16(vqsubq_s16(y_round, vqdmulhq_n_s16(d, matrix.g_u)),
+                 vqdmulhq_n_s16(e, matrix.g_v));
+  const int16x8_t b = vqaddq_s16(vqaddq_s16(y_round, d),
+                                 vqdmulhq_n_s16(d, matrix.b_u));
+
+  uint8x8x4_t rgba;
+  rgba.val[0] = vqshrun_n_s16(r, 6);
+  rgba.val[1] = vqshrun_n_s16(g, 6);
+  rgba.val[2] = vqshrun_n_s16(b, 6);
+  rgba.val[3] = vdup_n_u8(255);
+  vst4_u8(dest, rgba);
+}
+#endif
+
+void ConvertRowToRgba(const uint8_t* y_row, const uint8_t* u_row,
+                      const uint8_t* v_row, bool interleaved_uv,
+                      const YuvToRgbMatrix& matrix, uint8_t* dest,
+                      size_t width) {
+  const size_t uv_step = interleaved_uv ? 2 : 1;
+  size_t i = 0;
+#if defined(USE_SSE2)
+  const __m128i zero = _mm_setzero_si128();
+  const __m128i offset = _mm_set1_epi8(static_cast<char>(matrix.y_offset));
+  const __m128i bias = _mm_set1_epi16(128);
+  for (; i + 8 <= width; i += 8) {
+    const __m128i y8 = _mm_subs_epu8(
+        _mm_loadl_epi64(reinterpret_cast<const __m128i*>(y_row + i)), offset);
+    // Put the Y values in the high bytes so mulhi_epu16 divides by 256.
+    const __m128i c = _mm_unpacklo_epi8(zero, y8);
+
+    __m128i d, e;
+    if (interleaved_uv) {
+      // Each U/V pair is used for two pixels.
+      const __m128i uv = _mm_unpacklo_epi8(
+          _mm_loadl_epi64(reinterpret_cast<const __m128i*>(u_row + i)), zero);
+      d = _mm_shufflehi_epi16(
+          _mm_shufflelo_epi16(uv, _MM_SHUFFLE(2, 2, 0, 0)),
+          _MM_SHUFFLE(2, 2, 0, 0));
+      e = _mm_shufflehi_epi16(
+          _mm_shufflelo_epi16(uv, _MM_SHUFFLE(3, 3, 1, 1)),
+          _MM_SHUFFLE(3, 3, 1, 1));
+    } else {
+      int32_t u4, v4;
+      memcpy(&u4, u_row + i / 2, sizeof(u4));
+      memcpy(&v4, v_row + i / 2, sizeof(v4));
+      const __m128i u = _mm_cvtsi32_si128(u4);
+      const __m128i v = _mm_cvtsi32_si128(v4);
+      d = _mm_unpacklo_epi8(_mm_unpacklo_epi8(u, u), zero);
+      e = _mm_unpacklo_epi8(_mm_unpacklo_epi8(v, v), zero);
+    }
+    ConvertPixelsToRgba(c, _mm_sub_epi16(d, bias), _mm_sub_epi16(e, bias),
+                        matrix, dest + i * 4);
+  }
+#elif defined(USE_NEON)
+  const uint8x8_t offset = vdup_n_u8(matrix.y_offset);
+  const int16x8_t bias = vdupq_n_s16(128);
+  for (; i + 8 <= width; i += 8) {
+    const uint8x8_t y8 = vqsub_u8(vld1_u8(y_row + i), offset);
+    const int16x8_t c = vreinterpretq_s16_u16(vshll_n_u8(y8, 7));
+
+    uint8x8_t u8, v8;
+    if (interleaved_uv) {
+      const uint8x8_t uv = vld1_u8(u_row + i);
+      const uint8x8x2_t split = vuzp_u8(uv, uv);
+      u8 = split.val[0];
+      v8 = split.val[1];
+    } else {
+      // Load 4 values of each and repeat them for two pixels.
+      uint32_t u4, v4;
+      memcpy(&u4, u_row + i / 2, sizeof(u4));
+      memcpy(&v4, v_row + i / 2, sizeof(v4));
+      u8 = vreinterpret_u8_u32(vdup_n_u32(u4));
+      v8 = vreinterpret_u8_u32(vdup_n_u32(v4));
+    }
+    // Repeat each value for two pixels.
+    u8 = vzip_u8(u8, u8).val[0];
+    v8 = vzip_u8(v8, v8).val[0];
+    ConvertPixelsToRgba(
+        c, vsubq_s16(vreinterpretq_s16_u16(vmovl_u8(u8)), bias),
+        vsubq_s16(vreinterpretq_s16_u16(vmovl_u8(v8)), bias), matrix,
+        dest + i * 4);
+  }
+#endif
+
+  for (; i < width; i++) {
+    const int c = std::max(y_row[i] - matrix.y_offset, 0);
+    const int d = u_row[(i / 2) * uv_step] - 128;
+    const int e = v_row[(i / 2) * uv_step] - 128;
+    // Use the same rounding as the SIMD code so the output doesn't depend on
+    // the width.
+    const int y = (c * matrix.y_scale) >> 8;
+    const int r_add = (e * matrix.r_v) >> 8;
+    const int g_add = -((d * matrix.g_u) >> 8) - ((e * matrix.g_v) >> 8);
+    const int b_add = d * 128 + ((d * matrix.b_u) >> 8);
+    WriteRgba(y, r_add, g_add, b_add, dest + i * 4);
+  }
+}
+
+}  // namespace
+
+void CopyPlane(const uint8_t* src, size_t src_stride, uint8_t* dest,
+               size_t dest_stride, size_t row_bytes, size_t rows) {
+  DCHECK_LE(row_bytes, src_stride);
+  DCHECK_LE(row_bytes, dest_stride);
+  if (rows == 0)
+    return;
+
+  if (src_stride == dest_stride) {
+    // The padding at the end of each row is copied too, but that is cheaper
+    // than a copy per row.  The last row may not have padding.
+    memcpy(dest, src, src_stride * (rows - 1) + row_bytes);
+    return;
+  }
+
+  for (size_t row = 0; row < rows; row++)
+    memcpy(dest + dest_stride * row, src + src_stride * row, row_bytes);
+}
+
+void ConvertPlane16To8(const uint8_t* src, size_t src_stride, uint8_t* dest,
+                       size_t dest_stride, size_t samples, size_t rows,
+                       unsigned int shift) {
+  DCHECK_GT(shift, 0u);
+  DCHECK_LE(shift, 15u);
+  DCHECK_LE(samples * 2, src_stride);
+  DCHECK_LE(samples, dest_stride);
+  for (size_t row = 0; row < rows; row++) {
+    ConvertRow16To8(src + src_stride * row, dest + dest_stride * row, samples,
+                    shift);
+  }
+}
+
+void ShiftPlane16(const uint8_t* src, size_t src_stride, uint8_t* dest,
+                  size_t dest_stride, size_t samples, size_t rows,
+                  unsigned int shift) {
+  DCHECK_LE(shift, 15u);
+  DCHECK_LE(samples * 2, src_stride);
+  DCHECK_LE(samples * 2, dest_stride);
+  for (size_t row = 0; row < rows; row++) {
+    const uint8_t* src_row = src + src_stride * row;
+    uint8_t* dest_row = dest + dest_stride * row;
+    for (size_t i = 0; i < samples; i++)
+      WriteUint16(ReadShifted16(src_row + i * 2, shift), dest_row + i * 2);
+  }
+}
+
+void InterleavePlanes16(const uint8_t* src1, size_t src1_stride,
+                        const uint8_t* src2, size_t src2_stride,
+                        uint8_t* dest, size_t dest_stride, size_t samples,
+                        size_t rows, unsigned int shift) {
+  DCHECK_LE(shift, 15u);
+  DCHECK_LE(samples * 2, src1_stride);
+  DCHECK_LE(samples * 2, src2_stride);
+  DCHECK_LE(samples * 4, dest_stride);
+  for (size_t row = 0; row < rows; row++) {
+    const uint8_t* row1 = src1 + src1_stride * row;
+    const uint8_t* row2 = src2 + src2_stride * row;
+    uint8_t* dest_row = dest + dest_stride * row;
+    for (size_t i = 0; i < samples; i++) {
+      WriteUint16(ReadShifted16(row1 + i * 2, shift), dest_row + i * 4);
+      WriteUint16(ReadShifted16(row2 + i * 2, shift), dest_row + i * 4 + 2);
+    }
+  }
+}
+
+void DownscalePlane(const uint8_t* src, size_t src_stride, size_t src_width,
+                    size_t src_rows, size_t components, unsigned int shift,
+                    uint8_t* dest, size_t dest_stride) {
+  DCHECK_GT(shift, 0u);
+  DCHECK_LE(shift, 7u);
+  DCHECK_LE(src_width * components, src_stride);
+  const size_t block = static_cast<size_t>(1) << shift;
+  const size_t dest_width = (src_width + block - 1) >> shift;
+  const size_t dest_rows = (src_rows + block - 1) >> shift;
+  DCHECK_LE(dest_width * components, dest_stride);
+
+  for (size_t row = 0; row < dest_rows; row++) {
+    const size_t src_row = row << shift;
+    const size_t block_rows = std::min(block, src_rows - src_row);
+    const uint8_t* src_row_data = src + src_stride * src_row;
+    uint8_t* dest_row = dest + dest_stride * row;
+
+    size_t i = 0;
+    if (shift == 1 && components == 1 && block_rows == 2) {
+      i = DownscaleRow2x(src_row_data, src_row_data + src_stride, dest_row,
+                         src_width / 2);
+    }
+    for (; i < dest_width; i++) {
+      const size_t src_i = i << shift;
+      const size_t block_width = std::min(block, src_width - src_i);
+      const size_t count = block_rows * block_width;
+      for (size_t c = 0; c < components; c++) {
+        size_t sum = 0;
+        for (size_t y = 0; y < block_rows; y++) {
+          const uint8_t* block_row = src_row_data + src_stride * y;
+          for (size_t x = 0; x < block_width; x++)
+            sum += block_row[(src_i + x) * components + c];
+        }
+        dest_row[i * components + c] =
+            static_cast<uint8_t>((sum + count / 2) / count);
+      }
+    }
+  }
+}
+
+YuvToRgbMatrix GetYuvToRgbMatrix(uint8_t matrix_coefficients,
+                                 bool full_range) {
+  // The luma coefficients from H.273.
+  double kr, kb;
+  switch (matrix_coefficients) {
+    case 5:  // BT.470BG
+    case 6:  // SMPTE 170M
+      kr = 0.299;
+      kb = 0.114;
+      break;
+    case 9:  // BT.2020 non-constant
+      kr = 0.2627;
+      kb = 0.0593;
+      break;
+    default:  // BT.709
+      kr = 0.2126;
+      kb = 0.0722;
+      break;
+  }
+  const double kg = 1 - kr - kb;
+  const double y_scale = full_range ? 1 : 255.0 / 219;
+  const double uv_scale = full_range ? 1 : 255.0 / 224;
+
+  YuvToRgbMatrix ret;
+  ret.y_offset = full_range ? 0 : 16;
+  ret.y_scale = ToFixedPoint(y_scale);
+  ret.r_v = ToFixedPoint(2 * (1 - kr) * uv_scale);
+  ret.g_u = ToFixedPoint(2 * kb * (1 - kb) / kg * uv_scale);
+  ret.g_v = ToFixedPoint(2 * kr * (1 - kr) / kg * uv_scale);
+  ret.b_u = ToFixedPoint(2 * (1 - kb) * uv_scale - 2);
+  return ret;
+}
+
+void ConvertYuv420ToRgba(const uint8_t* y, size_t y_stride, const uint8_t* u,
+                         const uint8_t* v, size_t uv_stride,
+                         bool interleaved_uv, const YuvToRgbMatrix& matrix,
+                         uint8_t* dest, size_t dest_stride, size_t width,
+                         size_t rows) {
+  DCHECK_LE(width, y_stride);
+  DCHECK_LE(width * 4, dest_stride);
+  for (size_t row = 0; row < rows; row++) {
+    ConvertRowToRgba(y + y_stride * row, u + uv_stride * (row / 2),
+                     v + uv_stride * (row / 2), interleaved_uv, matrix,
+                     dest + dest_stride * row, width);
+  }
+}
+
+}  // namespace media
+}  // namespace shaka
@@ -0,0 +1,166 @@
+// Copyright 2020 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     https://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef SHAKA_EMBEDDED_MEDIA_PIXEL_CONVERSION_H_
+#define SHAKA_EMBEDDED_MEDIA_PIXEL_CONVERSION_H_
+
+#include <stddef.h>
+#include <stdint.h>
+
+namespace shaka {
+namespace media {
+
+/**
+ * Copies a plane of pixel data between buffers with different strides.  If
+ * the rows are contiguous in both buffers, this is a single copy.
+ *
+ * @param src The first row of the source plane.
+ * @param src_stride The number of bytes between rows in the source.
+ * @param dest The first row of the destination plane.
+ * @param dest_stride The number of bytes between rows in the destination.
+ * @param row_bytes The number of bytes to copy from each row.
+ * @param rows The number of rows to copy.
+ */
+void CopyPlane(const uint8_t* src, size_t src_stride, uint8_t* dest,
+               size_t dest_stride, size_t row_bytes, size_t rows);
+
+/**
+ * Converts a plane of little-endian 16-bit components to 8-bit components
+ * by dropping the low |shift| bits.  For example, 10-bit data in the low bits
+ * (YUV420P10) uses a shift of 2 and 10-bit data in the high bits (P010) uses
+ * a shift of 8.  This uses SIMD instructions when available.
+ *
+ * @param src The first row of the source plane.
+ * @param src_stride The number of bytes between rows in the source.
+ * @param dest The first row of the destination plane.
+ * @param dest_stride The number of bytes between rows in the destination.
+ * @param samples The number of components in each row.
+ * @param rows The number of rows to convert.
+ * @param shift The number of bits to drop from each component.
+ */
+void ConvertPlane16To8(const uint8_t* src, size_t src_stride, uint8_t* dest,
+                       size_t dest_stride, size_t samples, size_t rows,
+                       unsigned int shift);
+
+/**
+ * Moves the data in a plane of little-endian 16-bit components from the low
+ * bits to the high bits without losing precision.  For example, this converts
+ * the Y plane of YUV420P10 to the Y plane of P010 with a shift of 6.
+ *
+ * @param src The first row of the source plane.
+ * @param src_stride The number of bytes between rows in the source.
+ * @param dest The first row of the destination plane.
+ * @param dest_stride The number of bytes between rows in the destination.
+ * @param samples The number of components in each row.
+ * @param rows The number of rows to convert.
+ * @param shift The number of bits to shift each component up by.
+ */
+void ShiftPlane16(const uint8_t* src, size_t src_stride, uint8_t* dest,
+                  size_t dest_stride, size_t samples, size_t rows,
+                  unsigned int shift);
+
+/**
+ * Interleaves two planes of little-endian 16-bit components into one plane,
+ * shifting the data up like ShiftPlane16.  For example, this converts the U
+ * and V planes of YUV420P10 to the U/V plane of P010 with a shift of 6.
+ *
+ * @param src1 The first row of the plane for the even components.
+ * @param src1_stride The number of bytes between rows in |src1|.
+ * @param src2 The first row of the plane for the odd components.
+ * @param src2_stride The number of bytes between rows in |src2|.
+ * @param dest The first row of the destination plane.
+ * @param dest_stride The number of bytes between rows in the destination.
+ * @param samples The number of components in each source row.
+ * @param rows The number of rows to convert.
+ * @param shift The number of bits to shift each component up by.
+ */
+void InterleavePlanes16(const uint8_t* src1, size_t src1_stride,
+                        const uint8_t* src2, size_t src2_stride,
+                        uint8_t* dest, size_t dest_stride, size_t samples,
+                        size_t rows, unsigned int shift);
+
+/**
+ * Downscales a plane of 8-bit components by a factor of 2^|shift| in each
+ * direction by averaging each block of source pixels.  The blocks at the right
+ * and bottom edges are partial if the size isn't a multiple of the factor.
+ * This uses SIMD instructions when available.
+ *
+ * @param src The first row of the source plane.
+ * @param src_stride The number of bytes between rows in the source.
+ * @param src_width The number of pixels in each source row.
+ * @param src_rows The number of rows in the source.
+ * @param components The number of interleaved components in each pixel (e.g.
+ *   2 for the U/V plane of NV12).
+ * @param shift The power of two to reduce the size by.
+ * @param dest The first row of the destination plane.  This holds
+ *   ceil(|src_width| / 2^|shift|) pixels in each row.
+ * @param dest_stride The number of bytes between rows in the destination.
+ */
+void DownscalePlane(const uint8_t* src, size_t src_stride, size_t src_width,
+                    size_t src_rows, size_t components, unsigned int shift,
+                    uint8_t* dest, size_t dest_stride);
+
+/**
+ * The fixed-point coefficients used to convert YUV to RGB.  The values are
+ * in units of 1/64 of an 8-bit component per 256 units of input; use
+ * GetYuvToRgbMatrix to get them.
+ */
+struct YuvToRgbMatrix {
+  /** The Y value of black (16 for video range, 0 for full range). */
+  uint8_t y_offset;
+  int16_t y_scale;
+  int16_t r_v;
+  int16_t g_u;
+  int16_t g_v;
+  /** This is relative to 2, since the full value doesn't fit in 16 bits. */
+  int16_t b_u;
+};
+
+/**
+ * Gets the coefficients for converting YUV to RGB.
+ *
+ * @param matrix_coefficients The H.273 matrix coefficients code point.  This
+ *   supports BT.601, BT.709, and BT.2020 (non-constant); others use BT.709.
+ * @param full_range Whether the samples use the full range.
+ */
+YuvToRgbMatrix GetYuvToRgbMatrix(uint8_t matrix_coefficients,
+                                 bool full_range);
+
+/**
+ * Converts 8-bit YUV 4:2:0 data to packed RGBA (R-G-B-A bytes with an opaque
+ * alpha).  The U/V data can be in separate planes (YUV420P) or interleaved in
+ * one plane (NV12).  This uses SIMD instructions when available.
+ *
+ * @param y The first row of the Y plane.
+ * @param y_stride The number of bytes between rows in the Y plane.
+ * @param u The first row of the U data.
+ * @param v The first row of the V data; for interleaved data, this is |u| + 1.
+ * @param uv_stride The number of bytes between rows in the U/V data.
+ * @param interleaved_uv Whether the U/V components are interleaved.
+ * @param matrix The coefficients to use.
+ * @param dest The first row of the destination.
+ * @param dest_stride The number of bytes between rows in the destination.
+ * @param width The number of pixels in each row.
+ * @param rows The number of rows to convert.
+ */
+void ConvertYuv420ToRgba(const uint8_t* y, size_t y_stride, const uint8_t* u,
+                         const uint8_t* v, size_t uv_stride,
+                         bool interleaved_uv, const YuvToRgbMatrix& matrix,
+                         uint8_t* dest, size_t dest_stride, size_t width,
+                         size_t rows);
+
+}  // namespace media
+}  // namespace shaka
+
+#endif  // SHAKA_EMBEDDED_MEDIA_PIXEL_CONVERSION_H_
@@ -14,6 +14,7 @@
 
 #include "shaka/media/proxy_media_player.h"
 
+#include <atomic>
 #include <cmath>
 #include <vector>
 
@@ -24,13 +25,38 @@
 namespace shaka {
 namespace media {
 
+namespace {
+
+/**
+ * If the prepared MediaPlayer is within this many seconds of the current time
+ * when the handoff happens, it continues from where it is without seeking.
+ */
+constexpr const double kHandoffTolerance = 0.1;
+
+}  // namespace
+
 class ProxyMediaPlayer::Impl {
  public:
   Impl()
-      : mutex("ProxyMediaPlayer"), player(nullptr), implementation(nullptr) {}
+      : mutex("ProxyMediaPlayer"),
+        player(nullptr),
+        secondary(nullptr),
+        mse(nullptr),
+        implementation(nullptr),
+        active(nullptr),
+        playing(false) {}
+
+  /** @return The MediaPlayer that should get the MSE calls. */
+  MediaPlayer* mse_target() const {
+    return mse ? mse : player;
+  }
 
   void reset() {
     player = nullptr;
+    secondary = nullptr;
+    mse = nullptr;
+    active = nullptr;
+    playing = false;
     fill_mode.reset();
     volume.reset();
     muted.reset();
@@ -43,8 +69,17 @@ class ProxyMediaPlayer::Impl {
   SharedMutex mutex;
   ClientList clients;
   MediaPlayer* player;
+  // The MediaPlayer prepared for a handoff.
+  MediaPlayer* secondary;
+  // The MediaPlayer (either |player| or |secondary|) that plays MSE content.
+  MediaPlayer* mse;
   std::string key_system;
   eme::Implementation* implementation;
+  // A copy of |player| that is read by BackendClient without locking, since
+  // events can be fired while |mutex| is held.
+  std::atomic<const MediaPlayer*> active;
+  // Whether the app wants the media to play.
+  bool playing;
 
   optional<VideoFillMode> fill_mode;
   optional<double> volume;
@@ -71,6 +106,10 @@ void ProxyMediaPlayer::AddClient(Client* client) const {
   impl_->clients.AddClient(client);
 }
 
+void ProxyMediaPlayer::AddAsyncClient(Client* client) const {
+  impl_->clients.AddAsyncClient(client);
+}
+
 void ProxyMediaPlayer::RemoveClient(Client* client) const {
   impl_->clients.RemoveClient(client);
 }
@@ -83,6 +122,14 @@ std::vector<BufferedRange> ProxyMediaPlayer::GetBuffered() const {
     return {};
 }
 
+uint64_t ProxyMediaPlayer::GetBufferedVersion() const {
+  util::shared_lock<SharedMutex> lock(impl_->mutex);
+  if (impl_->player)
+    return impl_->player->GetBufferedVersion();
+  else
+    return 0;
+}
+
 VideoReadyState ProxyMediaPlayer::ReadyState() const {
   util::shared_lock<SharedMutex> lock(impl_->mutex);
   if (impl_->player)
@@ -155,6 +202,7 @@ void ProxyMediaPlayer::SetMuted(bool muted) {
 
 void ProxyMediaPlayer::Play() {
   std::unique_lock<SharedMutex> lock(impl_->mutex);
+  impl_->playing = true;
   if (impl_->player)
     impl_->player->Play();
   else
@@ -163,6 +211,7 @@ void ProxyMediaPlayer::Play() {
 
 void ProxyMediaPlayer::Pause() {
   std::unique_lock<SharedMutex> lock(impl_->mutex);
+  impl_->playing = false;
   if (impl_->player)
     impl_->player->Pause();
   else
@@ -235,27 +284,29 @@ bool ProxyMediaPlayer::AttachMse() {
 
   std::unique_lock<SharedMutex> lock(impl_->mutex);
   SetFields(player);
+  impl_->mse = player;
   return true;
 }
 
 bool ProxyMediaPlayer::AddMseBuffer(const std::string& mime, bool is_video,
                                     const ElementaryStream* stream) {
   std::unique_lock<SharedMutex> lock(impl_->mutex);
-  if (!impl_->player)
+  MediaPlayer* player = impl_->mse_target();
+  if (!player)
     return false;
-  return impl_->player->AddMseBuffer(mime, is_video, stream);
+  return player->AddMseBuffer(mime, is_video, stream);
 }
 
 void ProxyMediaPlayer::MseEndOfStream() {
   std::unique_lock<SharedMutex> lock(impl_->mutex);
-  if (impl_->player)
-    impl_->player->MseEndOfStream();
+  if (MediaPlayer* player = impl_->mse_target())
+    player->MseEndOfStream();
 }
 
 void ProxyMediaPlayer::LoadedMetaData(double duration) {
   util::shared_lock<SharedMutex> lock(impl_->mutex);
-  if (impl_->player)
-    impl_->player->LoadedMetaData(duration);
+  if (MediaPlayer* player = impl_->mse_target())
+    player->LoadedMetaData(duration);
 }
 
 
@@ -266,6 +317,10 @@ bool ProxyMediaPlayer::SetEmeImplementation(
     if (!impl_->player->SetEmeImplementation(key_system, implementation))
       return false;
   }
+  if (impl_->secondary &&
+      !impl_->secondary->SetEmeImplementation(key_system, implementation)) {
+    return false;
+  }
   impl_->key_system = key_system;
   impl_->implementation = implementation;
   return true;
@@ -273,17 +328,126 @@ bool ProxyMediaPlayer::SetEmeImplementation(
 
 void ProxyMediaPlayer::Detach() {
   std::unique_lock<SharedMutex> lock(impl_->mutex);
+  if (impl_->secondary)
+    impl_->secondary->Detach();
   if (impl_->player)
     impl_->player->Detach();
   impl_->reset();
 }
 
+
+bool ProxyMediaPlayer::PrepareSourceHandoff(const std::string& src,
+                                            double start_time) {
+  if (!GetActivePlayer())
+    return false;
+  MediaPlayer* player = CreateSource(src);
+  if (!player)
+    return false;
+  return PrepareHandoff(player, /* is_mse= */ false, start_time);
+}
+
+bool ProxyMediaPlayer::PrepareMseHandoff(double start_time) {
+  if (!GetActivePlayer())
+    return false;
+  MediaPlayer* player = CreateMse();
+  if (!player)
+    return false;
+  return PrepareHandoff(player, /* is_mse= */ true, start_time);
+}
+
+bool ProxyMediaPlayer::CompleteHandoff() {
+  VideoReadyState old_ready_state;
+  VideoPlaybackState old_playback_state;
+  VideoReadyState new_ready_state;
+  VideoPlaybackState new_playback_state;
+  {
+    std::unique_lock<SharedMutex> lock(impl_->mutex);
+    MediaPlayer* old_player = impl_->player;
+    MediaPlayer* new_player = impl_->secondary;
+    if (!old_player || !new_player)
+      return false;
+
+    old_ready_state = old_player->ReadyState();
+    old_playback_state = old_player->PlaybackState();
+    const double time = old_player->CurrentTime();
+    if (std::abs(new_player->CurrentTime() - time) > kHandoffTolerance)
+      new_player->SetCurrentTime(time);
+    new_player->SetPlaybackRate(old_player->PlaybackRate());
+    new_player->SetVolume(old_player->Volume());
+    new_player->SetMuted(old_player->Muted());
+    if (impl_->playing && old_playback_state != VideoPlaybackState::Ended)
+      new_player->Play();
+
+    // Switch before detaching so the events from the old MediaPlayer are
+    // dropped.
+    impl_->player = new_player;
+    impl_->secondary = nullptr;
+    impl_->active = new_player;
+    if (impl_->mse == old_player)
+      impl_->mse = nullptr;
+    old_player->Detach();
+
+    new_ready_state = new_player->ReadyState();
+    new_playback_state = new_player->PlaybackState();
+  }
+
+  if (old_ready_state != new_ready_state)
+    impl_->clients.OnReadyStateChanged(old_ready_state, new_ready_state);
+  if (old_playback_state != new_playback_state) {
+    impl_->clients.OnPlaybackStateChanged(old_playback_state,
+                                          new_playback_state);
+  }
+  return true;
+}
+
+void ProxyMediaPlayer::CancelHandoff() {
+  std::unique_lock<SharedMutex> lock(impl_->mutex);
+  if (!impl_->secondary)
+    return;
+  impl_->secondary->Detach();
+  if (impl_->mse == impl_->secondary)
+    impl_->mse = nullptr;
+  impl_->secondary = nullptr;
+}
+
+
 MediaPlayer::ClientList* ProxyMediaPlayer::GetClientList() const {
   return &impl_->clients;
 }
 
+const MediaPlayer* ProxyMediaPlayer::GetActivePlayer() const {
+  return impl_->active.load();
+}
+
+bool ProxyMediaPlayer::PrepareHandoff(MediaPlayer* player, bool is_mse,
+                                      double start_time) {
+  std::unique_lock<SharedMutex> lock(impl_->mutex);
+  if (!impl_->player) {
+    // Playback was detached while this was being attached.
+    player->Detach();
+    return false;
+  }
+
+  if (impl_->secondary && impl_->secondary != player) {
+    impl_->secondary->Detach();
+    if (impl_->mse == impl_->secondary)
+      impl_->mse = nullptr;
+  }
+  impl_->secondary = player;
+  if (is_mse)
+    impl_->mse = player;
+
+  if (impl_->implementation)
+    player->SetEmeImplementation(impl_->key_system, impl_->implementation);
+  player->Pause();
+  player->SetMuted(true);
+  player->SetCurrentTime(start_time);
+  return true;
+}
+
 void ProxyMediaPlayer::SetFields(MediaPlayer* player) {
   impl_->player = player;
+  impl_->active = player;
   if (impl_->implementation)
     player->SetEmeImplementation(impl_->key_system, impl_->implementation);
 
@@ -300,6 +464,7 @@ void ProxyMediaPlayer::SetFields(MediaPlayer* player) {
   if (impl_->playback_rate.has_value())
     player->SetPlaybackRate(impl_->playback_rate.value());
   if (impl_->autoplay.has_value()) {
+    impl_->playing = impl_->autoplay.value();
     if (impl_->autoplay.value())
       player->Play();
     else
@@ -307,5 +472,114 @@ void ProxyMediaPlayer::SetFields(MediaPlayer* player) {
   }
 }
 
+
+
+ProxyMediaPlayer::BackendClient::BackendClient(const ProxyMediaPlayer* proxy,
+                                               const MediaPlayer* backend)
+    : proxy_(proxy), backend_(backend) {}
+
+ProxyMediaPlayer::BackendClient::~BackendClient() {}
+
+void ProxyMediaPlayer::BackendClient::OnAddAudioTrack(
+    std::shared_ptr<MediaTrack> track) {
+  if (IsActive())
+    proxy_->GetClientList()->OnAddAudioTrack(track);
+}
+
+void ProxyMediaPlayer::BackendClient::OnRemoveAudioTrack(
+    std::shared_ptr<MediaTrack> track) {
+  if (IsActive())
+    proxy_->GetClientList()->OnRemoveAudioTrack(track);
+}
+
+void ProxyMediaPlayer::BackendClient::OnAddVideoTrack(
+    std::shared_ptr<MediaTrack> track) {
+  if (IsActive())
+    proxy_->GetClientList()->OnAddVideoTrack(track);
+}
+
+void ProxyMediaPlayer::BackendClient::OnRemoveVideoTrack(
+    std::shared_ptr<MediaTrack> track) {
+  if (IsActive())
+    proxy_->GetClientList()->OnRemoveVideoTrack(track);
+}
+
+void ProxyMediaPlayer::BackendClient::OnAddTextTrack(
+    std::shared_ptr<TextTrack> track) {
+  if (IsActive())
+    proxy_->GetClientList()->OnAddTextTrack(track);
+}
+
+void ProxyMediaPlayer::BackendClient::OnRemoveTextTrack(
+    std::shared_ptr<TextTrack> track) {
+  if (IsActive())
+    proxy_->GetClientList()->OnRemoveTextTrack(track);
+}
+
+void ProxyMediaPlayer::BackendClient::OnReadyStateChanged(
+    VideoReadyState old_state, VideoReadyState new_state) {
+  if (IsActive())
+    proxy_->GetClientList()->OnReadyStateChanged(old_state, new_state);
+}
+
+void ProxyMediaPlayer::BackendClient::OnPlaybackStateChanged(
+    VideoPlaybackState old_state, VideoPlaybackState new_state) {
+  if (IsActive())
+    proxy_->GetClientList()->OnPlaybackStateChanged(old_state, new_state);
+}
+
+void ProxyMediaPlayer::BackendClient::OnPlaybackRateChanged(double old_rate,
+                                                            double new_rate) {
+  if (IsActive())
+    proxy_->GetClientList()->OnPlaybackRateChanged(old_rate, new_rate);
+}
+
+void ProxyMediaPlayer::BackendClient::OnError(const std::string& error) {
+  if (IsActive())
+    proxy_->GetClientList()->OnError(error);
+}
+
+void ProxyMediaPlayer::BackendClient::OnAttachMse() {
+  if (IsActive())
+    proxy_->GetClientList()->OnAttachMse();
+}
+
+void ProxyMediaPlayer::BackendClient::OnAttachSource() {
+  if (IsActive())
+    proxy_->GetClientList()->OnAttachSource();
+}
+
+void ProxyMediaPlayer::BackendClient::OnDetach() {
+  if (IsActive())
+    proxy_->GetClientList()->OnDetach();
+}
+
+void ProxyMediaPlayer::BackendClient::OnPlay() {
+  if (IsActive())
+    proxy_->GetClientList()->OnPlay();
+}
+
+void ProxyMediaPlayer::BackendClient::OnSeeking() {
+  if (IsActive())
+    proxy_->GetClientList()->OnSeeking();
+}
+
+void ProxyMediaPlayer::BackendClient::OnWaitingForKey() {
+  if (IsActive())
+    proxy_->GetClientList()->OnWaitingForKey();
+}
+
+void ProxyMediaPlayer::BackendClient::OnUserEvent(const std::string& name,
+                                                  void* user_data) {
+  if (IsActive())
+    proxy_->GetClientList()->OnUserEvent(name, user_data);
+}
+
+bool ProxyMediaPlayer::BackendClient::IsActive() const {
+  // While nothing is active, the MediaPlayer is being attached.
+  const MediaPlayer* active = proxy_->GetActivePlayer();
+  return !active || active == backend_;
+}
+
 }  // namespace media
 }  // namespace shaka
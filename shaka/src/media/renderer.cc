@@ -22,5 +22,19 @@ Renderer::Renderer() {}
 Renderer::~Renderer() {}
 // \endcond Doxygen_Skip
 
+bool AudioRenderer::GetDeviceTime(double* time) const {
+  return false;
+}
+
+void VideoRenderer::GetMaxFrameSize(uint32_t* width, uint32_t* height) const {
+  *width = *height = 0;
+}
+
+std::vector<PixelFormat> VideoRenderer::GetPreferredPixelFormats() const {
+  return {};
+}
+
+void VideoRenderer::OnFramePresented(double age) {}
+
 }  // namespace media
 }  // namespace shaka
@@ -16,8 +16,14 @@
 
 #include <SDL2/SDL.h>
 
+#include <algorithm>
+#include <atomic>
+#include <vector>
+
 #include "shaka/utils.h"
 #include "src/media/audio_renderer_common.h"
+#include "src/util/clock.h"
+#include "src/util/ring_buffer.h"
 #include "src/util/utils.h"
 
 namespace shaka {
@@ -25,42 +31,14 @@ namespace media {
 
 namespace {
 
-bool SDLFormatFromShaka(variant<PixelFormat, SampleFormat> format,
-                        SDL_AudioFormat* result) {
-  // Try to use the same format to avoid work by swresample.
-  switch (get<SampleFormat>(format)) {
-    case SampleFormat::PackedU8:
-    case SampleFormat::PlanarU8:
-      *result = AUDIO_U8;
-      return true;
-    case SampleFormat::PackedS16:
-    case SampleFormat::PlanarS16:
-      *result = AUDIO_S16SYS;
-      return true;
-    case SampleFormat::PackedS32:
-    case SampleFormat::PlanarS32:
-      *result = AUDIO_S32SYS;
-      return true;
-    case SampleFormat::PackedFloat:
-    case SampleFormat::PlanarFloat:
-      *result = AUDIO_F32SYS;
-      return true;
-
-    case SampleFormat::PackedDouble:
-    case SampleFormat::PlanarDouble:
-      LOG(DFATAL) << "SDL doesn't support double-precision audio.";
-      return false;
+/**
+ * The number of seconds of audio the ring buffer holds.  This is more than the
+ * default buffer size of AudioRendererCommon so it doesn't normally fill.
+ */
+constexpr const double kRingBufferSeconds = 4;
 
-    case SampleFormat::PackedS64:
-    case SampleFormat::PlanarS64:
-      LOG(DFATAL) << "SDL doesn't support 64-bit audio.";
-      return false;
-
-    default:
-      LOG(DFATAL) << "Unknown audio sample format: " << format;
-      return false;
-  }
-}
+/** How long to wait for the device to read from a full ring buffer. */
+constexpr const double kFullBufferDelay = 0.005;
 
 bool InitSdl() {
   if (!SDL_WasInit(SDL_INIT_AUDIO)) {
@@ -78,7 +56,11 @@ bool InitSdl() {
 class SdlAudioRenderer::Impl : public AudioRendererCommon {
  public:
   explicit Impl(const std::string& device_name)
-      : device_name_(device_name), audio_device_(0), volume_(0) {
+      : device_name_(device_name),
+        audio_device_(0),
+        silence_(0),
+        volume_(0),
+        passthrough_(false) {
     // Use "playback" mode on iOS.  This ensures the audio remains playing when
     // locked or muted.
     SDL_SetHint(SDL_HINT_AUDIO_CATEGORY, "playback");
@@ -105,46 +87,77 @@ class SdlAudioRenderer::Impl : public AudioRendererCommon {
     SDL_AudioSpec obtained_audio_spec;
     SDL_AudioSpec audio_spec;
     memset(&audio_spec, 0, sizeof(audio_spec));
-    if (!SDLFormatFromShaka(frame->format, &audio_spec.format))
-      return false;
+    // Always play floats and let AudioRendererCommon convert the frames.  This
+    // keeps the device open when the stream format changes.  Passthrough
+    // bursts must reach the sink unchanged, so those are played as-is.
+    passthrough_ = IsBitstream(frame);
+    audio_spec.format = passthrough_ ? AUDIO_S16LSB : AUDIO_F32SYS;
     audio_spec.freq = frame->stream_info->sample_rate;
     audio_spec.channels = static_cast<Uint8>(frame->stream_info->channel_count);
     audio_spec.samples = static_cast<Uint16>(frame->sample_count);
+    audio_spec.callback = &Impl::OnAudioCallback;
+    audio_spec.userdata = this;
 
     const char* device = device_name_.empty() ? nullptr : device_name_.c_str();
-    audio_device_ =
-        SDL_OpenAudioDevice(device, 0, &audio_spec, &obtained_audio_spec, 0);
+    // Use the device's own rate and channel count, if different, so SDL
+    // doesn't need to convert again.  Converting would corrupt passthrough
+    // bursts, so that requires the exact format.
+    const int allowed_changes =
+        passthrough_ ? 0
+                     : (SDL_AUDIO_ALLOW_FREQUENCY_CHANGE |
+                        SDL_AUDIO_ALLOW_CHANNELS_CHANGE);
+    audio_device_ = SDL_OpenAudioDevice(device, 0, &audio_spec,
+                                        &obtained_audio_spec, allowed_changes);
     if (audio_device_ == 0) {
       LOG(DFATAL) << "Error opening audio device: " << SDL_GetError();
       return false;
     }
 
     format_ = obtained_audio_spec.format;
-    volume_ = volume;
+    silence_ = obtained_audio_spec.silence;
+    volume_.store(volume, std::memory_order_relaxed);
+    const size_t bytes_per_second = obtained_audio_spec.freq *
+                                    obtained_audio_spec.channels *
+                                    SDL_AUDIO_BITSIZE(format_) / 8;
+    ring_.Reset(static_cast<size_t>(bytes_per_second * kRingBufferSeconds));
+    callback_buffer_.resize(obtained_audio_spec.size);
+    if (!passthrough_) {
+      SetDeviceFormat(SampleFormat::PackedFloat, obtained_audio_spec.freq,
+                      obtained_audio_spec.channels);
+    }
     return true;
   }
 
   bool AppendBuffer(const uint8_t* data, size_t size) override {
-    std::vector<uint8_t> temp(size);
-    SDL_MixAudioFormat(temp.data(), data, format_, size,
-                       static_cast<int>(volume_ * SDL_MIX_MAXVOLUME));
-    if (SDL_QueueAudio(audio_device_, temp.data(), size) != 0) {
-      LOG(DFATAL) << "Error appending audio: " << SDL_GetError();
-      return false;
+    while (size > 0) {
+      const size_t written = ring_.Write(data, size);
+      data += written;
+      size -= written;
+      if (size == 0)
+        break;
+
+      // The ring is full, so wait for the device to read from it.  If the
+      // device is paused, drop the rest and have the caller resync.
+      if (SDL_GetAudioDeviceStatus(audio_device_) != SDL_AUDIO_PLAYING) {
+        OnAppendDropped();
+        break;
+      }
+      util::Clock::Instance.SleepSeconds(kFullBufferDelay);
     }
     return true;
   }
 
   void ClearBuffer() override {
-    if (audio_device_ != 0)
-      SDL_ClearQueuedAudio(audio_device_);
+    if (audio_device_ != 0) {
+      // The device lock ensures the callback isn't reading from the ring.
+      SDL_LockAudioDevice(audio_device_);
+      ring_.Clear();
+      SDL_UnlockAudioDevice(audio_device_);
+    }
   }
 
   size_t GetBytesBuffered() const override {
-    if (audio_device_ != 0)
-      return SDL_GetQueuedAudioSize(audio_device_);
-    else
-      return 0;
+    return audio_device_ != 0 ? ring_.Size() : 0;
   }
 
   void SetDeviceState(bool is_playing) override {
@@ -153,7 +166,7 @@ class SdlAudioRenderer::Impl : public AudioRendererCommon {
   }
 
   void UpdateVolume(double volume) override {
-    volume_ = volume;
+    volume_.store(volume, std::memory_order_relaxed);
   }
 
   void ResetDevice() {
@@ -163,10 +176,46 @@ class SdlAudioRenderer::Impl : public AudioRendererCommon {
     }
   }
 
+  static void SDLCALL OnAudioCallback(void* user_data, Uint8* stream,
+                                      int size) {
+    reinterpret_cast<Impl*>(user_data)->FillAudio(stream,
+                                                  static_cast<size_t>(size));
+  }
+
+  /**
+   * Called on SDL's audio thread to fill the device buffer.  This can't block,
+   * so it only reads from the ring buffer and fills the rest with silence.
+   */
+  void FillAudio(uint8_t* stream, size_t size) {
+    const double volume = volume_.load(std::memory_order_relaxed);
+    // Scaling passthrough bursts would corrupt them, so they can only be
+    // muted.
+    if (volume == 1 || (passthrough_ && volume > 0)) {
+      const size_t read = ring_.Read(stream, size);
+      memset(stream + read, silence_, size - read);
+    } else {
+      memset(stream, silence_, size);
+      const size_t read = ring_.Read(
+          callback_buffer_.data(), std::min(size, callback_buffer_.size()));
+      SDL_MixAudioFormat(stream, callback_buffer_.data(), format_,
+                         static_cast<Uint32>(read),
+                         static_cast<int>(volume * SDL_MIX_MAXVOLUME));
+    }
+  }
+
   const std::string device_name_;
   SDL_AudioDeviceID audio_device_;
   SDL_AudioFormat format_;
-  double volume_;
+  Uint8 silence_;
+  std::atomic<double> volume_;
+  // Whether the device plays IEC 61937 bursts; this is only changed while the
+  // device is closed.
+  bool passthrough_;
+  // The audio written by AudioRendererCommon's thread and read by the device
+  // callback.
+  util::RingBuffer ring_;
+  // Used by the callback to apply the volume.
+  std::vector<uint8_t> callback_buffer_;
 };
 
 
@@ -184,6 +233,14 @@ std::vector<std::string> SdlAudioRenderer::ListDevices() {
   return ret;
 }
 
+void SdlAudioRenderer::SetBufferSize(double seconds) {
+  impl_->SetBufferSize(seconds);
+}
+
+void SdlAudioRenderer::SetPrerollWhilePaused(bool preroll) {
+  impl_->SetPrerollWhilePaused(preroll);
+}
+
 void SdlAudioRenderer::SetPlayer(const MediaPlayer* player) {
   impl_->SetPlayer(player);
 }
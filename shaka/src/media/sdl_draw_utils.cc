@@ -0,0 +1,54 @@
+// Copyright 2020 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     https://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "src/media/sdl_draw_utils.h"
+
+#include "shaka/media/stream_info.h"
+
+namespace shaka {
+namespace media {
+
+void DrawFrameTexture(SDL_Renderer* renderer, SDL_Texture* texture,
+                      const DecodedFrame& frame, const SDL_Rect& region,
+                      VideoFillMode mode, ShakaRect<uint32_t>* dest) {
+  ShakaRect<uint32_t> region_shaka = {region.x, region.y, region.w, region.h};
+  ShakaRect<uint32_t> src;
+  ShakaRect<uint32_t> frame_region = {0, 0, frame.stream_info->width,
+                                      frame.stream_info->height};
+  FitVideoToRegion(frame_region, region_shaka,
+                   frame.stream_info->sample_aspect_ratio, mode, &src, dest);
+  SDL_Rect src_sdl = {src.x, src.y, src.w, src.h};
+  SDL_Rect dest_sdl = {dest->x, dest->y, dest->w, dest->h};
+
+  // The frame may have been downscaled while uploading it, so map the source
+  // region onto the texture.
+  int texture_width;
+  int texture_height;
+  if (SDL_QueryTexture(texture, nullptr, nullptr, &texture_width,
+                       &texture_height) == 0 &&
+      (static_cast<uint32_t>(texture_width) != frame_region.w ||
+       static_cast<uint32_t>(texture_height) != frame_region.h)) {
+    const double x_scale = static_cast<double>(texture_width) / frame_region.w;
+    const double y_scale =
+        static_cast<double>(texture_height) / frame_region.h;
+    src_sdl = {static_cast<int>(src.x * x_scale),
+               static_cast<int>(src.y * y_scale),
+               static_cast<int>(src.w * x_scale),
+               static_cast<int>(src.h * y_scale)};
+  }
+  SDL_RenderCopy(renderer, texture, &src_sdl, &dest_sdl);
+}
+
+}  // namespace media
+}  // namespace shaka
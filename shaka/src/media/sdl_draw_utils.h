@@ -0,0 +1,45 @@
+// Copyright 2020 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     https://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef SHAKA_EMBEDDED_MEDIA_SDL_DRAW_UTILS_H_
+#define SHAKA_EMBEDDED_MEDIA_SDL_DRAW_UTILS_H_
+
+#include <SDL2/SDL.h>
+
+#include "shaka/media/frames.h"
+#include "shaka/utils.h"
+
+namespace shaka {
+namespace media {
+
+/**
+ * Copies the texture holding the given frame to the given region of the
+ * renderer, following the fill mode.  The texture can be smaller than the
+ * frame if it was downscaled while uploading.
+ *
+ * @param renderer The renderer to draw to.
+ * @param texture The texture holding |frame|.
+ * @param frame The frame that was uploaded to |texture|.
+ * @param region The region of the renderer to draw to.
+ * @param mode How to fit the frame into |region|.
+ * @param dest [OUT] Where to put the region that was drawn to.
+ */
+void DrawFrameTexture(SDL_Renderer* renderer, SDL_Texture* texture,
+                      const DecodedFrame& frame, const SDL_Rect& region,
+                      VideoFillMode mode, ShakaRect<uint32_t>* dest);
+
+}  // namespace media
+}  // namespace shaka
+
+#endif  // SHAKA_EMBEDDED_MEDIA_SDL_DRAW_UTILS_H_
@@ -0,0 +1,324 @@
+// Copyright 2020 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     https://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "shaka/media/sdl_multiview_renderer.h"
+
+#include <SDL2/SDL.h>
+#include <glog/logging.h>
+
+#include <algorithm>
+#include <limits>
+#include <vector>
+
+#include "shaka/optional.h"
+#include "shaka/sdl_frame_drawer.h"
+#include "src/debug/mutex.h"
+#include "src/media/sdl_draw_utils.h"
+#include "src/media/video_renderer_common.h"
+#include "src/util/macros.h"
+
+namespace shaka {
+namespace media {
+
+namespace {
+
+/** The VideoRenderer for one tile. */
+class Tile : public VideoRendererCommon {
+ public:
+  explicit Tile(const SDL_Rect& region)
+      : region(region), formats_mutex_("SdlMultiviewTile") {}
+
+  /**
+   * Sets the renderer the tile's frames are uploaded to.  This must be called
+   * instead of drawer.SetRenderer so the decoder sees the new formats.
+   */
+  void SetRenderer(SDL_Renderer* renderer) {
+    drawer.SetRenderer(renderer);
+    std::unique_lock<Mutex> lock(formats_mutex_);
+    formats_ = drawer.GetPreferredPixelFormats();
+  }
+
+  /**
+   * Sets the size the tile is drawn at, so the frames after this are decoded
+   * and uploaded at about that size; 0x0 uses the full size.
+   */
+  void SetDisplaySize(uint32_t width, uint32_t height) {
+    drawer.SetMaxFrameSize(width, height);
+    SetMaxFrameSize(width, height);
+  }
+
+  std::vector<PixelFormat> GetPreferredPixelFormats() const override {
+    std::unique_lock<Mutex> lock(formats_mutex_);
+    return formats_;
+  }
+
+  SdlFrameDrawer drawer;
+  SDL_Rect region;
+  // The frame that is drawn in the composited texture.
+  std::shared_ptr<DecodedFrame> drawn_frame;
+
+ private:
+  // The drawer is only used while holding the renderer's lock, so its formats
+  // are copied here for the decoder threads.
+  mutable Mutex formats_mutex_;
+  std::vector<PixelFormat> formats_;
+};
+
+}  // namespace
+
+class SdlMultiviewRenderer::Impl {
+ public:
+  explicit Impl(SDL_Renderer* renderer)
+      : mutex_("SdlMultiviewRenderer"),
+        renderer_(renderer),
+        atlas_(nullptr),
+        atlas_width_(0),
+        atlas_height_(0),
+        redraw_all_(true) {}
+  ~Impl() {
+    if (atlas_)
+      SDL_DestroyTexture(atlas_);
+  }
+
+  SHAKA_NON_COPYABLE_OR_MOVABLE_TYPE(Impl);
+
+  void SetRenderer(SDL_Renderer* renderer) {
+    std::unique_lock<Mutex> lock(mutex_);
+    if (atlas_)
+      SDL_DestroyTexture(atlas_);
+    atlas_ = nullptr;
+    atlas_width_ = atlas_height_ = 0;
+    renderer_ = renderer;
+    for (auto& tile : tiles_) {
+      tile->SetRenderer(renderer);
+      tile->drawn_frame.reset();
+    }
+    redraw_all_ = true;
+  }
+
+  size_t AddTile(const SDL_Rect& region) {
+    std::unique_lock<Mutex> lock(mutex_);
+    tiles_.emplace_back(new Tile(region));
+    tiles_.back()->SetRenderer(renderer_);
+    redraw_all_ = true;
+    return tiles_.size() - 1;
+  }
+
+  size_t TileCount() const {
+    std::unique_lock<Mutex> lock(mutex_);
+    return tiles_.size();
+  }
+
+  VideoRenderer* GetTile(size_t index) const {
+    std::unique_lock<Mutex> lock(mutex_);
+    return index < tiles_.size() ? tiles_[index].get() : nullptr;
+  }
+
+  void SetTileRegion(size_t index, const SDL_Rect& region) {
+    std::unique_lock<Mutex> lock(mutex_);
+    if (index < tiles_.size()) {
+      tiles_[index]->region = region;
+      redraw_all_ = true;
+    }
+  }
+
+  void SetFocusedTile(optional<size_t> index) {
+    std::unique_lock<Mutex> lock(mutex_);
+    focused_ = index;
+    // Redraw so the new display sizes are applied right away.
+    redraw_all_ = true;
+  }
+
+  double Render() {
+    std::unique_lock<Mutex> lock(mutex_);
+    std::vector<std::shared_ptr<DecodedFrame>> frames(tiles_.size());
+    double delay = std::numeric_limits<double>::infinity();
+    for (size_t i = 0; i < tiles_.size(); i++)
+      delay = std::min(delay, tiles_[i]->GetCurrentFrame(&frames[i]));
+    Composite(frames);
+    return tiles_.empty() ? 0 : delay;
+  }
+
+  void RenderForVsync(double vsync_delay, double refresh_interval) {
+    std::unique_lock<Mutex> lock(mutex_);
+    std::vector<std::shared_ptr<DecodedFrame>> frames(tiles_.size());
+    for (size_t i = 0; i < tiles_.size(); i++) {
+      tiles_[i]->GetFrameForVsync(vsync_delay, refresh_interval, &frames[i]);
+    }
+    Composite(frames);
+  }
+
+  void PrepareNextFrames() {
+    std::unique_lock<Mutex> lock(mutex_);
+    if (!renderer_)
+      return;
+
+    if (focused_.has_value() && focused_.value() < tiles_.size())
+      PrepareTile(tiles_[focused_.value()].get());
+    for (size_t i = 0; i < tiles_.size(); i++) {
+      if (!focused_.has_value() || i != focused_.value())
+        PrepareTile(tiles_[i].get());
+    }
+  }
+
+ private:
+  void PrepareTile(Tile* tile) {
+    std::shared_ptr<DecodedFrame> frame = tile->GetNextFrame();
+    if (frame)
+      tile->drawer.Prepare(frame);
+  }
+
+  void Composite(const std::vector<std::shared_ptr<DecodedFrame>>& frames) {
+    if (!renderer_)
+      return;
+
+    UpdateAtlas();
+    if (!atlas_) {
+      // Render targets aren't supported, so draw the tiles directly.
+      for (size_t i = 0; i < tiles_.size(); i++)
+        DrawTile(i, frames[i]);
+      return;
+    }
+
+    SDL_Texture* old_target = SDL_GetRenderTarget(renderer_);
+    SDL_SetRenderTarget(renderer_, atlas_);
+    uint8_t r, g, b, a;
+    SDL_GetRenderDrawColor(renderer_, &r, &g, &b, &a);
+    SDL_SetRenderDrawColor(renderer_, 0, 0, 0, 255);
+    if (redraw_all_)
+      SDL_RenderClear(renderer_);
+    for (size_t i = 0; i < tiles_.size(); i++) {
+      // Only draw the tiles whose frame changed since they were last drawn.
+      if (redraw_all_ || frames[i] != tiles_[i]->drawn_frame) {
+        SDL_RenderFillRect(renderer_, &tiles_[i]->region);
+        DrawTile(i, frames[i]);
+      }
+    }
+    redraw_all_ = false;
+    SDL_SetRenderDrawColor(renderer_, r, g, b, a);
+    SDL_SetRenderTarget(renderer_, old_target);
+
+    SDL_RenderCopy(renderer_, atlas_, nullptr, nullptr);
+  }
+
+  void UpdateAtlas() {
+    int width;
+    int height;
+    if (SDL_GetRendererOutputSize(renderer_, &width, &height) != 0)
+      return;
+    if (width == atlas_width_ && height == atlas_height_)
+      return;
+
+    if (atlas_)
+      SDL_DestroyTexture(atlas_);
+    atlas_ = nullptr;
+    atlas_width_ = width;
+    atlas_height_ = height;
+    redraw_all_ = true;
+    if (!SDL_RenderTargetSupported(renderer_))
+      return;
+
+    atlas_ = SDL_CreateTexture(renderer_, SDL_PIXELFORMAT_ARGB8888,
+                               SDL_TEXTUREACCESS_TARGET, width, height);
+    if (!atlas_) {
+      LOG(WARNING) << "Unable to create multiview texture, drawing tiles "
+                      "directly: "
+                   << SDL_GetError();
+      return;
+    }
+    // The tiles replace what is under them, so don't blend with the window.
+    SDL_SetTextureBlendMode(atlas_, SDL_BLENDMODE_NONE);
+  }
+
+  void DrawTile(size_t index, const std::shared_ptr<DecodedFrame>& frame) {
+    Tile* tile = tiles_[index].get();
+    tile->drawn_frame = frame;
+    if (!frame)
+      return;
+    SDL_Texture* texture = tile->drawer.Draw(frame);
+    if (!texture)
+      return;
+
+    ShakaRect<uint32_t> dest;
+    DrawFrameTexture(renderer_, texture, *frame, tile->region,
+                     tile->fill_mode(), &dest);
+
+    // This applies to the frames uploaded and decoded after this one.
+    if (focused_.has_value() && focused_.value() == index)
+      tile->SetDisplaySize(0, 0);
+    else
+      tile->SetDisplaySize(dest.w, dest.h);
+  }
+
+  mutable Mutex mutex_;
+  SDL_Renderer* renderer_;
+  // The composited tiles, the size of the renderer's output.
+  SDL_Texture* atlas_;
+  int atlas_width_;
+  int atlas_height_;
+  // Whether the whole composited texture needs to be drawn again.
+  bool redraw_all_;
+  std::vector<std::unique_ptr<Tile>> tiles_;
+  optional<size_t> focused_;
+};
+
+
+SdlMultiviewRenderer::SdlMultiviewRenderer(SDL_Renderer* renderer)
+    : impl_(new Impl(renderer)) {}
+SdlMultiviewRenderer::~SdlMultiviewRenderer() {}
+
+void SdlMultiviewRenderer::SetRenderer(SDL_Renderer* renderer) {
+  impl_->SetRenderer(renderer);
+}
+
+size_t SdlMultiviewRenderer::AddTile(const SDL_Rect& region) {
+  return impl_->AddTile(region);
+}
+
+size_t SdlMultiviewRenderer::TileCount() const {
+  return impl_->TileCount();
+}
+
+VideoRenderer* SdlMultiviewRenderer::GetTile(size_t index) const {
+  return impl_->GetTile(index);
+}
+
+void SdlMultiviewRenderer::SetTileRegion(size_t index,
+                                         const SDL_Rect& region) {
+  impl_->SetTileRegion(index, region);
+}
+
+void SdlMultiviewRenderer::SetFocusedTile(size_t index) {
+  impl_->SetFocusedTile(index);
+}
+
+void SdlMultiviewRenderer::ClearFocusedTile() {
+  impl_->SetFocusedTile(nullopt);
+}
+
+double SdlMultiviewRenderer::Render() {
+  return impl_->Render();
+}
+
+void SdlMultiviewRenderer::RenderForVsync(double vsync_delay,
+                                          double refresh_interval) {
+  impl_->RenderForVsync(vsync_delay, refresh_interval);
+}
+
+void SdlMultiviewRenderer::PrepareNextFrames() {
+  impl_->PrepareNextFrames();
+}
+
+}  // namespace media
+}  // namespace shaka
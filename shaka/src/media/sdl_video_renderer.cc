@@ -16,13 +16,16 @@
 
 #include <SDL2/SDL.h>
 
+#include <algorithm>
 #include <atomic>
+#include <utility>
 
 #include "shaka/optional.h"
 #include "shaka/sdl_frame_drawer.h"
 #include "shaka/utils.h"
 #include "src/debug/mutex.h"
 #include "src/debug/thread.h"
+#include "src/media/sdl_draw_utils.h"
 #include "src/media/video_renderer_common.h"
 #include "src/util/clock.h"
 #include "src/util/macros.h"
@@ -34,7 +37,9 @@ namespace media {
 class SdlManualVideoRenderer::Impl : public VideoRendererCommon {
  public:
   explicit Impl(SDL_Renderer* renderer)
-      : mutex_("SdlManualVideoRenderer"), renderer_(renderer) {
+      : mutex_("SdlManualVideoRenderer"),
+        renderer_(renderer),
+        scale_to_display_(false) {
     sdl_drawer_.SetRenderer(renderer);
   }
 
@@ -49,45 +54,75 @@ class SdlManualVideoRenderer::Impl : public VideoRendererCommon {
     return renderer_;
   }
 
+  std::vector<PixelFormat> GetPreferredPixelFormats() const {
+    std::unique_lock<Mutex> lock(mutex_);
+    return sdl_drawer_.GetPreferredPixelFormats();
+  }
+
   double Render(const SDL_Rect* region) {
     std::shared_ptr<DecodedFrame> frame;
     const double delay = GetCurrentFrame(&frame);
+    DrawFrame(frame, region);
+    return delay;
+  }
 
+  void RenderForVsync(double vsync_delay, double refresh_interval,
+                      const SDL_Rect* region) {
+    std::shared_ptr<DecodedFrame> frame;
+    GetFrameForVsync(vsync_delay, refresh_interval, &frame);
+    DrawFrame(frame, region);
+  }
+
+  void SetScaleToDisplaySize(bool enabled) {
+    std::unique_lock<Mutex> lock(mutex_);
+    scale_to_display_ = enabled;
+    if (!enabled) {
+      sdl_drawer_.SetMaxFrameSize(0, 0);
+      SetMaxFrameSize(0, 0);
+    }
+  }
+
+  void PrepareNextFrame() {
+    std::shared_ptr<DecodedFrame> frame = GetNextFrame();
+    std::unique_lock<Mutex> lock(mutex_);
+    if (frame && renderer_)
+      sdl_drawer_.Prepare(frame);
+  }
+
+ private:
+  void DrawFrame(const std::shared_ptr<DecodedFrame>& frame,
+                 const SDL_Rect* region) {
     std::unique_lock<Mutex> lock(mutex_);
     if (frame && renderer_) {
       SDL_Texture* texture = sdl_drawer_.Draw(frame);
       if (texture) {
-        ShakaRect<uint32_t> region_shaka;
+        SDL_Rect bounds;
         if (region) {
-          region_shaka = {region->x, region->y, region->w, region->h};
+          bounds = *region;
         } else {
-          int w = frame->stream_info->width;
-          int h = frame->stream_info->height;
-          SDL_GetRendererOutputSize(renderer_, &w, &h);
-          region_shaka.x = region_shaka.y = 0;
-          region_shaka.w = w;
-          region_shaka.h = h;
+          bounds.x = bounds.y = 0;
+          bounds.w = frame->stream_info->width;
+          bounds.h = frame->stream_info->height;
+          SDL_GetRendererOutputSize(renderer_, &bounds.w, &bounds.h);
         }
 
-        ShakaRect<uint32_t> src, dest;
-        ShakaRect<uint32_t> frame_region = {0, 0, frame->stream_info->width,
-                                            frame->stream_info->height};
-        FitVideoToRegion(frame_region, region_shaka,
-                         frame->stream_info->sample_aspect_ratio, fill_mode(),
-                         &src, &dest);
-        SDL_Rect src_sdl = {src.x, src.y, src.w, src.h};
-        SDL_Rect dest_sdl = {dest.x, dest.y, dest.w, dest.h};
-        SDL_RenderCopy(renderer_, texture, &src_sdl, &dest_sdl);
+        ShakaRect<uint32_t> dest;
+        DrawFrameTexture(renderer_, texture, *frame, bounds, fill_mode(),
+                         &dest);
+
+        if (scale_to_display_) {
+          // This applies to the frames uploaded and decoded after this one.
+          sdl_drawer_.SetMaxFrameSize(dest.w, dest.h);
+          SetMaxFrameSize(dest.w, dest.h);
+        }
       }
     }
-
-    return delay;
   }
 
- private:
   mutable Mutex mutex_;
   SdlFrameDrawer sdl_drawer_;
   SDL_Renderer* renderer_;
+  bool scale_to_display_;
 };
 
 class SdlThreadVideoRenderer::Impl {
@@ -96,7 +131,8 @@ class SdlThreadVideoRenderer::Impl {
       : renderer_(renderer),
         region_(region ? optional<SDL_Rect>(*region) : nullopt),
         shutdown_(false),
-        thread_("SdlThreadVideo", std::bind(&Impl::ThreadMain, this)) {}
+        thread_("SdlThreadVideo", std::bind(&Impl::ThreadMain, this),
+                ThreadRole::Video) {}
   ~Impl() {
     shutdown_.store(true, std::memory_order_relaxed);
     thread_.join();
@@ -110,8 +146,15 @@ class SdlThreadVideoRenderer::Impl {
       const double delay =
           renderer_->Render(region_.has_value() ? &region_.value() : nullptr);
       SDL_RenderPresent(renderer_->GetRenderer());
-
-      util::Clock::Instance.SleepSeconds(delay);
+      renderer_->OnFramePresented(0);
+
+      // Upload the next frame while waiting so the next Render call only needs
+      // to copy it to the screen.
+      const uint64_t start = util::Clock::Instance.GetMonotonicTime();
+      renderer_->PrepareNextFrame();
+      const double elapsed =
+          (util::Clock::Instance.GetMonotonicTime() - start) / 1000.0;
+      util::Clock::Instance.SleepSeconds(std::max(delay - elapsed, 0.0));
     }
   }
 
@@ -137,6 +180,24 @@ double SdlManualVideoRenderer::Render(const SDL_Rect* region) {
   return impl_->Render(region);
 }
 
+void SdlManualVideoRenderer::RenderForVsync(double vsync_delay,
+                                            double refresh_interval,
+                                            const SDL_Rect* region) {
+  impl_->RenderForVsync(vsync_delay, refresh_interval, region);
+}
+
+void SdlManualVideoRenderer::PrepareNextFrame() {
+  impl_->PrepareNextFrame();
+}
+
+void SdlManualVideoRenderer::TakeSnapshot(SnapshotCallback callback) const {
+  impl_->TakeSnapshot(std::move(callback));
+}
+
+void SdlManualVideoRenderer::SetScaleToDisplaySize(bool enabled) {
+  impl_->SetScaleToDisplaySize(enabled);
+}
+
 void SdlManualVideoRenderer::SetPlayer(const MediaPlayer* player) {
   impl_->SetPlayer(player);
 }
@@ -152,6 +213,17 @@ VideoPlaybackQuality SdlManualVideoRenderer::VideoPlaybackQuality() const {
 bool SdlManualVideoRenderer::SetVideoFillMode(VideoFillMode mode) {
   return impl_->SetVideoFillMode(mode);
 }
+void SdlManualVideoRenderer::GetMaxFrameSize(uint32_t* width,
+                                             uint32_t* height) const {
+  impl_->GetMaxFrameSize(width, height);
+}
+std::vector<PixelFormat> SdlManualVideoRenderer::GetPreferredPixelFormats()
+    const {
+  return impl_->GetPreferredPixelFormats();
+}
+void SdlManualVideoRenderer::OnFramePresented(double age) {
+  impl_->OnFramePresented(age);
+}
 
 
 SdlThreadVideoRenderer::SdlThreadVideoRenderer(SDL_Renderer* renderer)
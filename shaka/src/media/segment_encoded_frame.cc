@@ -0,0 +1,238 @@
+// Copyright 2020 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     https://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "src/media/segment_encoded_frame.h"
+
+#include <glog/logging.h>
+#include <string.h>
+
+#include <algorithm>
+#include <utility>
+
+#include "shaka/eme/implementation.h"
+#include "src/debug/trace_event.h"
+#include "src/eme/implementation_extensions.h"
+
+namespace shaka {
+namespace media {
+
+namespace {
+
+constexpr const size_t kBlockSize = 16;
+
+/**
+ * Writes the given frame's data into the secure buffer, decrypting it using
+ * the given info, which is nullptr if the data is already clear.
+ */
+bool WriteToSecureBuffer(const EncodedFrame* frame,
+                         const eme::ImplementationExtensions* extensions,
+                         const eme::FrameEncryptionInfo* info,
+                         const eme::SecureBuffer& dest, MediaStatus* status) {
+  if (dest.size < frame->data_size) {
+    LOG(DFATAL) << "Secure buffer is too small for the frame";
+    *status = MediaStatus::FatalError;
+    return true;
+  }
+
+  TRACE_EVENT("media", "Decrypt");
+  TRACE_FRAME_STEP(frame);
+  const eme::DecryptStatus decrypt_status = extensions->DecryptToSecureBuffer(
+      info, frame->data, frame->data_size, dest);
+  switch (decrypt_status) {
+    case eme::DecryptStatus::Success:
+      *status = MediaStatus::Success;
+      return true;
+    case eme::DecryptStatus::KeyNotFound:
+      *status = MediaStatus::KeyNotFound;
+      return true;
+    case eme::DecryptStatus::NotSupported:
+      return false;
+    default:
+      *status = MediaStatus::FatalError;
+      return true;
+  }
+}
+
+}  // namespace
+
+SegmentEncodedFrame::SegmentEncodedFrame(
+    std::shared_ptr<const StreamInfo> info, double pts, double dts,
+    double duration, bool is_key_frame,
+    std::shared_ptr<EncodedFrameBuffer> buffer, size_t offset, size_t size,
+    double timestamp_offset,
+    std::shared_ptr<eme::FrameEncryptionInfo> encryption_info)
+    : EncodedFrame(info, pts, dts, duration, is_key_frame,
+                   buffer->data() + offset, size, timestamp_offset,
+                   encryption_info),
+      buffer_(std::move(buffer)),
+      mutex_("SegmentEncodedFrame"),
+      is_decrypted_(false) {
+  DCHECK_LE(offset + size, buffer_->size());
+  impl_.reset(new Impl(this));
+}
+
+SegmentEncodedFrame::~SegmentEncodedFrame() {}
+
+// static
+bool SegmentEncodedFrame::CanDecryptInPlace(
+    const eme::FrameEncryptionInfo& info) {
+  if (info.scheme != eme::EncryptionScheme::AesCtr)
+    return false;
+  for (const auto& subsample : info.subsamples) {
+    if (subsample.protected_bytes % kBlockSize != 0)
+      return false;
+  }
+  return true;
+}
+
+// static
+SegmentEncodedFrame* SegmentEncodedFrame::FromFrame(EncodedFrame* frame) {
+  return frame && frame->impl_ ? frame->impl_->segment_frame : nullptr;
+}
+
+// static
+size_t SegmentEncodedFrame::DecryptBatchInPlace(
+    const eme::Implementation* implementation,
+    const std::vector<std::shared_ptr<EncodedFrame>>& frames) {
+  const eme::ImplementationExtensions* extensions =
+      eme::ImplementationExtensions::Get(implementation);
+  if (!extensions)
+    return frames.size();
+
+  std::vector<eme::DecryptSample> samples;
+  std::vector<size_t> started;
+  samples.reserve(frames.size());
+  started.reserve(frames.size());
+  for (size_t i = 0; i < frames.size(); i++) {
+    SegmentEncodedFrame* frame = FromFrame(frames[i].get());
+    eme::DecryptSample sample;
+    if (frame && frame->encryption_info &&
+        frame->StartDecryptInPlace(&sample)) {
+      samples.emplace_back(sample);
+      started.emplace_back(i);
+    }
+  }
+  if (samples.empty())
+    return frames.size();
+
+  TRACE_EVENT("media", "Decrypt batch");
+  for (size_t i : started)
+    TRACE_FRAME_STEP(frames[i].get());
+  extensions->DecryptSamples(samples.data(), samples.size());
+  size_t ret = frames.size();
+  for (size_t i = 0; i < samples.size(); i++) {
+    FromFrame(frames[started[i]].get())->FinishDecryptInPlace(
+        samples[i].status);
+    if (samples[i].status == eme::DecryptStatus::KeyNotFound)
+      ret = std::min(ret, started[i]);
+  }
+  return ret;
+}
+
+// static
+bool SegmentEncodedFrame::DecryptInPlace(
+    EncodedFrame* frame, const eme::Implementation* implementation,
+    MediaStatus* status) {
+  SegmentEncodedFrame* segment_frame = FromFrame(frame);
+  if (!segment_frame)
+    return false;
+  if (segment_frame->is_decrypted_) {
+    *status = MediaStatus::Success;
+    return true;
+  }
+  // Only the built-in EME implementations allow decrypting in place; app CDMs
+  // always get a separate output buffer.
+  if (!segment_frame->encryption_info ||
+      !CanDecryptInPlace(*segment_frame->encryption_info) ||
+      !eme::ImplementationExtensions::Get(implementation)) {
+    return false;
+  }
+
+  std::unique_lock<Mutex> lock(segment_frame->mutex_);
+  if (!segment_frame->is_decrypted_) {
+    // The frames from the segment don't overlap, so this only touches our own
+    // part of the buffer.
+    *status = segment_frame->EncodedFrame::Decrypt(
+        implementation, const_cast<uint8_t*>(segment_frame->data));
+    if (*status != MediaStatus::Success)
+      return true;
+    segment_frame->is_decrypted_ = true;
+  }
+  *status = MediaStatus::Success;
+  return true;
+}
+
+// static
+bool SegmentEncodedFrame::DecryptToSecureBuffer(
+    EncodedFrame* frame, const eme::Implementation* implementation,
+    const eme::SecureBuffer& dest, MediaStatus* status) {
+  const eme::ImplementationExtensions* extensions =
+      eme::ImplementationExtensions::Get(implementation);
+  if (!extensions)
+    return false;
+
+  SegmentEncodedFrame* segment_frame = FromFrame(frame);
+  if (!segment_frame) {
+    return WriteToSecureBuffer(frame, extensions, frame->encryption_info.get(),
+                               dest, status);
+  }
+
+  // If the frame was already decrypted in place, it only needs to be copied.
+  std::unique_lock<Mutex> lock(segment_frame->mutex_);
+  return WriteToSecureBuffer(
+      frame, extensions,
+      segment_frame->is_decrypted_ ? nullptr : frame->encryption_info.get(),
+      dest, status);
+}
+
+MediaStatus SegmentEncodedFrame::Decrypt(
+    const eme::Implementation* implementation, uint8_t* dest) const {
+  std::unique_lock<Mutex> lock(mutex_);
+  if (is_decrypted_) {
+    memcpy(dest, data, data_size);
+    return MediaStatus::Success;
+  }
+  return EncodedFrame::Decrypt(implementation, dest);
+}
+
+bool SegmentEncodedFrame::StartDecryptInPlace(eme::DecryptSample* sample) {
+  if (is_decrypted_ || !CanDecryptInPlace(*encryption_info))
+    return false;
+
+  mutex_.lock();
+  if (is_decrypted_) {
+    mutex_.unlock();
+    return false;
+  }
+  sample->info = encryption_info.get();
+  sample->data = data;
+  sample->data_size = data_size;
+  sample->dest = const_cast<uint8_t*>(data);
+  return true;
+}
+
+void SegmentEncodedFrame::FinishDecryptInPlace(eme::DecryptStatus status) {
+  if (status == eme::DecryptStatus::Success)
+    is_decrypted_ = true;
+  mutex_.unlock();
+}
+
+size_t SegmentEncodedFrame::EstimateSize() const {
+  // The buffer is shared, so each frame only counts its own part of it, which
+  // is already included in the base size.
+  return EncodedFrame::EstimateSize() + sizeof(*this) - sizeof(EncodedFrame);
+}
+
+}  // namespace media
+}  // namespace shaka
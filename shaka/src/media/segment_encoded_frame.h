@@ -0,0 +1,161 @@
+// Copyright 2020 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     https://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef SHAKA_EMBEDDED_MEDIA_SEGMENT_ENCODED_FRAME_H_
+#define SHAKA_EMBEDDED_MEDIA_SEGMENT_ENCODED_FRAME_H_
+
+#include <atomic>
+#include <memory>
+#include <vector>
+
+#include "shaka/media/frames.h"
+#include "src/debug/mutex.h"
+#include "src/media/media_buffer.h"
+
+namespace shaka {
+
+namespace eme {
+struct DecryptSample;
+struct SecureBuffer;
+}  // namespace eme
+
+namespace media {
+
+/**
+ * An encoded frame whose data is a slice of a buffer that is shared with the
+ * other frames from the same segment.  This avoids a per-sample allocation and
+ * copy when demuxing.
+ *
+ * Since the frame owns (its part of) the buffer, it can be decrypted in place.
+ * Once it has been, the frame holds clear data and Decrypt() just copies it.
+ */
+class SegmentEncodedFrame final : public EncodedFrame {
+ public:
+  SegmentEncodedFrame(std::shared_ptr<const StreamInfo> info, double pts,
+                      double dts, double duration, bool is_key_frame,
+                      std::shared_ptr<EncodedFrameBuffer> buffer,
+                      size_t offset, size_t size, double timestamp_offset,
+                      std::shared_ptr<eme::FrameEncryptionInfo> encryption_info);
+  ~SegmentEncodedFrame() override;
+
+  /**
+   * @return Whether the given frame can be decrypted in place.  This is only
+   *   true for "cenc" where each subsample only contains whole blocks, since
+   *   those don't need any data from outside the protected range.
+   */
+  static bool CanDecryptInPlace(const eme::FrameEncryptionInfo& info);
+
+  /**
+   * @return The given frame as a SegmentEncodedFrame, or nullptr if it is
+   *   another type of frame.
+   */
+  static SegmentEncodedFrame* FromFrame(EncodedFrame* frame);
+
+  /**
+   * Attempts to decrypt the given frame's data in place, so @a data holds the
+   * clear frame afterwards.  This avoids copying the frame into a separate
+   * buffer.  This is only supported for a SegmentEncodedFrame, for encryption
+   * schemes that can be decrypted in place, and for the built-in EME
+   * implementations (see eme::ImplementationExtensions).
+   *
+   * @param frame The frame to decrypt.
+   * @param implementation The EME implementation to decrypt with.
+   * @param status [OUT] Will contain the result of decrypting, if this
+   *   returns true.
+   * @return True if the frame was decrypted in place (or that was attempted),
+   *   false if the frame needs to be decrypted using Decrypt().
+   */
+  static bool DecryptInPlace(EncodedFrame* frame,
+                             const eme::Implementation* implementation,
+                             MediaStatus* status);
+
+  /**
+   * Attempts to decrypt the given frame's data into protected memory that is
+   * read by a secure decoder.  Clear frames are copied into the buffer, since
+   * a secure decoder can only read from protected memory.  This works for any
+   * frame type, but only with EME implementations whose extensions support
+   * secure buffers (see eme::ImplementationExtensions::DecryptToSecureBuffer).
+   * A SegmentEncodedFrame that was already decrypted in place is copied as a
+   * clear frame.
+   *
+   * @param frame The frame to decrypt.
+   * @param implementation The EME implementation to decrypt with.
+   * @param dest The buffer to write the frame to.
+   * @param status [OUT] Will contain the result of decrypting, if this
+   *   returns true.
+   * @return True if the frame was written to the buffer (or that was
+   *   attempted), false if the EME implementation doesn't support secure
+   *   buffers and the frame needs to be decrypted using Decrypt().
+   */
+  static bool DecryptToSecureBuffer(EncodedFrame* frame,
+                                    const eme::Implementation* implementation,
+                                    const eme::SecureBuffer& dest,
+                                    MediaStatus* status);
+
+  /**
+   * Decrypts the given frames in place with a single call to
+   * eme::ImplementationExtensions::DecryptSamples.  Frames that can't be
+   * decrypted in place or that fail to decrypt are left alone and are
+   * decrypted individually when they are decoded.  This does nothing if the
+   * EME implementation doesn't support batches (e.g. it is from the app).
+   *
+   * @param implementation The EME implementation to decrypt with.
+   * @param frames The frames to decrypt.
+   * @return The number of frames at the start of |frames| that don't need to
+   *   be decrypted again.  If this is less than the size, the next frame
+   *   couldn't be decrypted since its key isn't available yet.
+   */
+  static size_t DecryptBatchInPlace(
+      const eme::Implementation* implementation,
+      const std::vector<std::shared_ptr<EncodedFrame>>& frames);
+
+  MediaStatus Decrypt(const eme::Implementation* implementation,
+                      uint8_t* dest) const override;
+
+  size_t EstimateSize() const override;
+
+ private:
+  /**
+   * Starts decrypting this frame in place as part of a batch.  If this returns
+   * true, this fills in |sample| and FinishDecryptInPlace must be called once
+   * the batch is done.
+   */
+  bool StartDecryptInPlace(eme::DecryptSample* sample);
+
+  /** Finishes decrypting this frame in place with the given result. */
+  void FinishDecryptInPlace(eme::DecryptStatus status);
+
+  const std::shared_ptr<EncodedFrameBuffer> buffer_;
+  // Protects decrypting the data, so another thread doesn't see a partially
+  // decrypted frame.  When decrypting as part of a batch, this is held from
+  // StartDecryptInPlace until FinishDecryptInPlace.
+  mutable Mutex mutex_;
+  std::atomic<bool> is_decrypted_;
+};
+
+/**
+ * The private data of an EncodedFrame.  This is only created for a
+ * SegmentEncodedFrame, so we can find those frames without RTTI.
+ */
+class EncodedFrame::Impl final {
+ public:
+  explicit Impl(SegmentEncodedFrame* frame) : segment_frame(frame) {}
+
+  SegmentEncodedFrame* const segment_frame;
+};
+
+}  // namespace media
+}  // namespace shaka
+
+#endif  // SHAKA_EMBEDDED_MEDIA_SEGMENT_ENCODED_FRAME_H_
@@ -19,6 +19,33 @@
 namespace shaka {
 namespace media {
 
+constexpr const uint8_t HdrMetadata::kUnspecified;
+constexpr const uint8_t HdrMetadata::kBt2020;
+constexpr const uint8_t HdrMetadata::kTransferPq;
+constexpr const uint8_t HdrMetadata::kTransferHlg;
+
+HdrMetadata::HdrMetadata()
+    : color_primaries(kUnspecified),
+      transfer_characteristics(kUnspecified),
+      matrix_coefficients(kUnspecified),
+      full_range(false),
+      has_mastering_display(false),
+      display_primaries_x{0, 0, 0},
+      display_primaries_y{0, 0, 0},
+      white_point_x(0),
+      white_point_y(0),
+      max_display_mastering_luminance(0),
+      min_display_mastering_luminance(0),
+      has_content_light_level(false),
+      max_content_light_level(0),
+      max_frame_average_light_level(0) {}
+
+bool HdrMetadata::IsHdr() const {
+  return transfer_characteristics == kTransferPq ||
+         transfer_characteristics == kTransferHlg;
+}
+
+
 class StreamInfo::Impl {};
 
 StreamInfo::StreamInfo(const std::string& mime, const std::string& codec,
@@ -26,7 +53,8 @@ StreamInfo::StreamInfo(const std::string& mime, const std::string& codec,
                        Rational<uint32_t> sample_aspect_ratio,
                        const std::vector<uint8_t>& extra_data, uint32_t width,
                        uint32_t height, uint32_t channel_count,
-                       uint32_t sample_rate)
+                       uint32_t sample_rate,
+                       const HdrMetadata& hdr_metadata)
     : mime_type(mime),
       codec(codec),
       time_scale(time_scale),
@@ -36,7 +64,8 @@ StreamInfo::StreamInfo(const std::string& mime, const std::string& codec,
       width(width),
       height(height),
       channel_count(channel_count),
-      sample_rate(sample_rate) {}
+      sample_rate(sample_rate),
+      hdr_metadata(hdr_metadata) {}
 StreamInfo::~StreamInfo() {}
 
 }  // namespace media
@@ -18,15 +18,19 @@
 #include <stdio.h>
 
 #include <algorithm>
+#include <atomic>
 #include <cmath>
+#include <deque>
+#include <functional>
 #include <iterator>
-#include <list>
 #include <unordered_set>
 #include <utility>
+#include <vector>
 
 #include "src/debug/mutex.h"
 #include "src/media/media_utils.h"
 #include "src/util/macros.h"
+#include "src/util/shared_lock.h"
 
 namespace shaka {
 namespace media {
@@ -61,6 +65,8 @@ bool FrameExtendsPast(const std::shared_ptr<BaseFrame>& a,
          GetTime<OrderByDts>(b);
 }
 
+using FrameList = std::deque<std::shared_ptr<BaseFrame>>;
+
 template <typename Iter>
 void UpdatePtsRanges(Iter range) {
   DCHECK(!range->frames.empty());
@@ -76,70 +82,133 @@ void UpdatePtsRanges(Iter range) {
  * Returns an iterator to the first element in |list| that is greater than or
  * equal to |frame|.
  *
- * This performs a linear search through |list| to find the element.  This will
- * perform a forward or reverse search depending on which would (likely) be
- * better.
- *
- * If we are inserting a frame at the end, this is O(1) time (usual case),
- * otherwise this is O(n).
+ * This performs a binary search through |list|, so this is O(log n).
  *
- * This returns a non-const iterator because a standard library bug in
- * libstdc++ 4.8 makes std::list::insert require non-const iterators.
- * See: https://gcc.gnu.org/bugzilla/show_bug.cgi?id=57158
+ * This returns a non-const iterator because older versions of libstdc++ don't
+ * accept const iterators in std::deque::insert.
  */
 template <bool OrderByDts>
-std::list<std::shared_ptr<BaseFrame>>::iterator FrameLowerBound(
-    const std::list<std::shared_ptr<BaseFrame>>& list, double time) {
-  auto& mutable_list =
-      const_cast<std::list<std::shared_ptr<BaseFrame>>&>(list);  // NOLINT
-  if (list.empty())
-    return mutable_list.end();
-
-  if (time - GetTime<OrderByDts>(list.front()) <
-      GetTime<OrderByDts>(list.back()) - time) {
-    // Closer to the front, find the first element that is not less than |time|.
-    auto notLessThan = [&time](const std::shared_ptr<BaseFrame>& other) {
-      return GetTime<OrderByDts>(other) >= time;
-    };
-    return std::find_if(mutable_list.begin(), mutable_list.end(), notLessThan);
-  }
+FrameList::iterator FrameLowerBound(const FrameList& list, double time) {
+  auto& mutable_list = const_cast<FrameList&>(list);  // NOLINT
+  return std::lower_bound(
+      mutable_list.begin(), mutable_list.end(), time,
+      [](const std::shared_ptr<BaseFrame>& frame, double time) {
+        return GetTime<OrderByDts>(frame) < time;
+      });
+}
 
-  // Closer to the end, first use a reverse search to find the first (in
-  // reverse order) that is less than |time|.
-  auto isLessThan = [&time](const std::shared_ptr<BaseFrame>& other) {
-    return GetTime<OrderByDts>(other) < time;
-  };
-  auto rit =
-      std::find_if(mutable_list.rbegin(), mutable_list.rend(), isLessThan);
-  // |*rit| is equal to the first element (going backwards) that is less than
-  // |frame|.  We want to return |rit - 1| as a forward iterator, namely the
-  // first element that is not less than |frame|.  The |base()| of a reverse
-  // iterator is the same element as |*(rit - 1)|, so return that.
-  // See: http://en.cppreference.com/w/cpp/iterator/reverse_iterator/base
-  return rit.base();
+/** @return The sum of the estimated sizes of the given frames. */
+size_t SumFrameSizes(FrameList::const_iterator begin,
+                     FrameList::const_iterator end) {
+  size_t ret = 0;
+  for (; begin != end; begin++)
+    ret += (*begin)->EstimateSize();
+  return ret;
 }
 
 struct Range {
   Range() {}
   ~Range() {}
 
+  Range(Range&&) = default;
+  Range& operator=(Range&&) = default;
   SHAKA_NON_COPYABLE_TYPE(Range);
 
-  std::list<std::shared_ptr<BaseFrame>> frames;
+  FrameList frames;
+  // The times of the key frames in |frames|, sorted.  This uses the same times
+  // as the frame ordering (DTS or PTS) so seeking doesn't need to walk back
+  // through every frame in a long GOP to find a key frame.
+  std::vector<double> key_frames;
 
   double start_pts = HUGE_VAL;
   double end_pts = -HUGE_VAL;
 };
 
+using RangeList = std::vector<Range>;
+
+/** Adds a key frame with the given time to the key frame index of |range|. */
+void AddKeyFrame(Range* range, double time) {
+  auto it = std::lower_bound(range->key_frames.begin(),
+                             range->key_frames.end(), time);
+  if (it == range->key_frames.end() || *it != time)
+    range->key_frames.insert(it, time);
+}
+
+/** Removes the key frame with the given time from the index of |range|. */
+void RemoveKeyFrame(Range* range, double time) {
+  auto it = std::lower_bound(range->key_frames.begin(),
+                             range->key_frames.end(), time);
+  if (it != range->key_frames.end() && *it == time)
+    range->key_frames.erase(it);
+}
+
+/** Rebuilds the key frame index of |range| from its frames; this is O(n). */
+template <bool OrderByDts>
+void UpdateKeyFrames(Range* range) {
+  range->key_frames.clear();
+  for (auto& frame : range->frames) {
+    if (frame->is_key_frame)
+      range->key_frames.push_back(GetTime<OrderByDts>(frame));
+  }
+}
+
+/**
+ * Returns an iterator to the first range in |ranges| where |pred| returns true.
+ * Since ranges are sorted and don't overlap, |pred| must return false for
+ * every range before the returned one and true after it.  This performs a
+ * binary search, so this is O(log n).
+ */
+template <typename Pred>
+RangeList::iterator FindFirstRange(RangeList* ranges, Pred pred) {
+  return std::partition_point(ranges->begin(), ranges->end(),
+                              [&](const Range& range) { return !pred(range); });
+}
+
 }  // namespace
 
 class StreamBase::Impl {
  public:
   explicit Impl(bool order_by_dts)
-      : mutex("StreamBase"), order_by_dts(order_by_dts) {}
+      : mutex("StreamBase"),
+        buffered_snapshot(std::make_shared<std::vector<BufferedRange>>()),
+        estimated_size(0),
+        order_by_dts(order_by_dts) {}
+
+  /**
+   * Publishes a new snapshot of |buffered_ranges|.  This must be called with
+   * |mutex| held exclusively after changing the ranges.  If the ranges
+   * changed, this calls |on_buffered_changed|.
+   */
+  void PublishSnapshot() {
+    auto snapshot = std::make_shared<std::vector<BufferedRange>>();
+    snapshot->reserve(buffered_ranges.size());
+    for (const Range& range : buffered_ranges)
+      snapshot->emplace_back(range.start_pts, range.end_pts);
+    if (*snapshot == *buffered_snapshot)
+      return;
+
+    std::atomic_store(&buffered_snapshot,
+                      std::shared_ptr<const std::vector<BufferedRange>>(
+                          std::move(snapshot)));
+    if (on_buffered_changed)
+      on_buffered_changed();
+  }
 
-  Mutex mutex;
-  std::list<Range> buffered_ranges;
+  // Readers (e.g. the decoder and renderers) take a shared lock; only adding
+  // and removing frames takes an exclusive lock.
+  SharedMutex mutex;
+  // The buffered ranges, ordered by time.  Since ranges don't overlap, these
+  // are ordered by both PTS and DTS.
+  RangeList buffered_ranges;
+  // An immutable copy of the times in |buffered_ranges|.  This is replaced
+  // atomically so GetBufferedRanges() doesn't need to lock |mutex|.
+  std::shared_ptr<const std::vector<BufferedRange>> buffered_snapshot;
+  // The sum of the estimated sizes of every frame in |buffered_ranges|.
+  std::atomic<size_t> estimated_size;
+  // Called with |mutex| held when the buffered ranges change.
+  std::function<void()> on_buffered_changed;
+  // Called with |mutex| held when Remove() removes frames.
+  std::function<void(double, double)> on_removed;
   const bool order_by_dts;
 };
 
@@ -149,18 +218,29 @@ StreamBase::StreamBase(bool order_by_dts) : impl_(new Impl(order_by_dts)) {}
 StreamBase::~StreamBase() {}
 
 size_t StreamBase::EstimateSize() const {
-  std::unique_lock<Mutex> lock(impl_->mutex);
-
-  size_t size = 0;
-  for (auto& range : impl_->buffered_ranges) {
-    for (auto& frame : range.frames)
-      size += frame->EstimateSize();
-  }
-  return size;
+  return impl_->estimated_size.load(std::memory_order_relaxed);
 }
 
 void StreamBase::AddFrameInternal(std::shared_ptr<BaseFrame> frame) {
-  std::unique_lock<Mutex> lock(impl_->mutex);
+  std::unique_lock<SharedMutex> lock(impl_->mutex);
+  AddFrameLocked(std::move(frame));
+  AssertRangesSorted();
+  impl_->PublishSnapshot();
+}
+
+void StreamBase::AddFramesInternal(
+    const std::vector<std::shared_ptr<BaseFrame>>& frames) {
+  if (frames.empty())
+    return;
+
+  std::unique_lock<SharedMutex> lock(impl_->mutex);
+  for (auto& frame : frames)
+    AddFrameLocked(frame);
+  AssertRangesSorted();
+  impl_->PublishSnapshot();
+}
+
+void StreamBase::AddFrameLocked(std::shared_ptr<BaseFrame> frame) {
   DCHECK(frame);
 
   auto extendsPast =
@@ -171,72 +251,93 @@ void StreamBase::AddFrameInternal(std::shared_ptr<BaseFrame> frame) {
 
   // Find the first buffered range that ends after |frame|.
   auto range_it =
-      std::find_if(impl_->buffered_ranges.begin(), impl_->buffered_ranges.end(),
-                   [&](const Range& range) {
-                     return extendsPast(range.frames.back(), frame);
-                   });
+      FindFirstRange(&impl_->buffered_ranges, [&](const Range& range) {
+        return extendsPast(range.frames.back(), frame);
+      });
 
+  const double time = getTime(frame);
+  const bool is_key_frame = frame->is_key_frame;
+  impl_->estimated_size += frame->EstimateSize();
   if (range_it == impl_->buffered_ranges.end()) {
     // |frame| was after every existing range, create a new one.
-    impl_->buffered_ranges.emplace_back();
-    impl_->buffered_ranges.back().start_pts = frame->pts;
-    impl_->buffered_ranges.back().end_pts = frame->pts + frame->duration;
-    impl_->buffered_ranges.back().frames.emplace_back(frame);
+    range_it = impl_->buffered_ranges.emplace(range_it);
+    range_it->start_pts = frame->pts;
+    range_it->end_pts = frame->pts + frame->duration;
+    range_it->frames.emplace_back(frame);
   } else if (!extendsPast(frame, range_it->frames.front())) {
     // |frame| is before this range, so it starts a new range before this one.
-    auto it = impl_->buffered_ranges.emplace(range_it);
-    it->start_pts = frame->pts;
-    it->end_pts = frame->pts + frame->duration;
-    it->frames.emplace_back(frame);
+    range_it = impl_->buffered_ranges.emplace(range_it);
+    range_it->start_pts = frame->pts;
+    range_it->end_pts = frame->pts + frame->duration;
+    range_it->frames.emplace_back(frame);
   } else {
     // |frame| is inside the current range.
-    auto frame_it = lowerBound(range_it->frames, getTime(frame));
+    auto frame_it = lowerBound(range_it->frames, time);
     range_it->start_pts = std::min(range_it->start_pts, frame->pts);
     range_it->end_pts =
         std::max(range_it->end_pts, frame->pts + frame->duration);
-    if (frame_it != range_it->frames.end() &&
-        getTime(*frame_it) == getTime(frame)) {
+    if (frame_it != range_it->frames.end() && getTime(*frame_it) == time) {
+      impl_->estimated_size -= (*frame_it)->EstimateSize();
+      if ((*frame_it)->is_key_frame && !is_key_frame)
+        RemoveKeyFrame(&*range_it, time);
       swap(*frame_it, frame);
     } else {
       range_it->frames.insert(frame_it, frame);
     }
   }
+  if (is_key_frame)
+    AddKeyFrame(&*range_it, time);
 
-  // If the frame closed a gap, then merge the buffered ranges.
+  // If the frame closed a gap, then merge the buffered ranges.  There are
+  // usually only a few ranges, so this doesn't need to be fast.
   DCHECK_NE(0u, impl_->buffered_ranges.size());
-  for (auto it = std::next(impl_->buffered_ranges.begin());
-       it != impl_->buffered_ranges.end();) {
-    auto prev = std::prev(it);
-    if (extendsPast(prev->frames.back(), it->frames.front())) {
-      // Move all elements from |it->frames| to the end of |prev->frames|.
-      // Since both lists are sorted and |prev < it|, this will remain sorted.
-      prev->frames.splice(prev->frames.end(), it->frames);
-      prev->start_pts = std::min(prev->start_pts, it->start_pts);
-      prev->end_pts = std::max(prev->end_pts, it->end_pts);
-      it = impl_->buffered_ranges.erase(it);
+  for (size_t i = 1; i < impl_->buffered_ranges.size();) {
+    Range* prev = &impl_->buffered_ranges[i - 1];
+    Range* cur = &impl_->buffered_ranges[i];
+    if (extendsPast(prev->frames.back(), cur->frames.front())) {
+      // Move all frames from the smaller range into the larger one.  Since
+      // both are sorted and |prev < cur|, this will remain sorted.
+      if (prev->frames.size() >= cur->frames.size()) {
+        prev->frames.insert(prev->frames.end(),
+                            std::make_move_iterator(cur->frames.begin()),
+                            std::make_move_iterator(cur->frames.end()));
+      } else {
+        cur->frames.insert(cur->frames.begin(),
+                           std::make_move_iterator(prev->frames.begin()),
+                           std::make_move_iterator(prev->frames.end()));
+        swap(prev->frames, cur->frames);
+      }
+      prev->key_frames.insert(prev->key_frames.end(), cur->key_frames.begin(),
+                              cur->key_frames.end());
+      prev->start_pts = std::min(prev->start_pts, cur->start_pts);
+      prev->end_pts = std::max(prev->end_pts, cur->end_pts);
+      impl_->buffered_ranges.erase(impl_->buffered_ranges.begin() + i);
     } else {
-      it++;
+      i++;
     }
   }
+}
 
-  AssertRangesSorted();
+void StreamBase::SetOnBufferedChanged(
+    std::function<void()> on_buffered_changed) const {
+  std::unique_lock<SharedMutex> lock(impl_->mutex);
+  impl_->on_buffered_changed = std::move(on_buffered_changed);
 }
 
-std::vector<BufferedRange> StreamBase::GetBufferedRanges() const {
-  std::unique_lock<Mutex> lock(impl_->mutex);
-  AssertRangesSorted();
+void StreamBase::SetOnRemoved(
+    std::function<void(double, double)> on_removed) const {
+  std::unique_lock<SharedMutex> lock(impl_->mutex);
+  impl_->on_removed = std::move(on_removed);
+}
 
-  std::vector<BufferedRange> ret;
-  ret.reserve(impl_->buffered_ranges.size());
-  for (const Range& range : impl_->buffered_ranges) {
-    ret.emplace_back(range.start_pts, range.end_pts);
-  }
-  return ret;
+std::vector<BufferedRange> StreamBase::GetBufferedRanges() const {
+  // This doesn't lock |mutex| so it never waits for the demuxer to add frames.
+  return *std::atomic_load(&impl_->buffered_snapshot);
 }
 
 size_t StreamBase::CountFramesBetween(double start_time,
                                       double end_time) const {
-  std::unique_lock<Mutex> lock(impl_->mutex);
+  util::shared_lock<SharedMutex> lock(impl_->mutex);
   AssertRangesSorted();
 
   auto getTime = impl_->order_by_dts ? &GetTime<true> : &GetTime<false>;
@@ -245,10 +346,9 @@ size_t StreamBase::CountFramesBetween(double start_time,
 
   // Find the first buffered range that includes or is after |start_time|.
   auto range_it =
-      std::find_if(impl_->buffered_ranges.begin(), impl_->buffered_ranges.end(),
-                   [&](const Range& range) {
-                     return getTime(range.frames.back()) >= start_time;
-                   });
+      FindFirstRange(&impl_->buffered_ranges, [&](const Range& range) {
+        return getTime(range.frames.back()) >= start_time;
+      });
 
   size_t num_frames = 0;
   for (; range_it != impl_->buffered_ranges.end(); range_it++) {
@@ -271,15 +371,19 @@ void StreamBase::Remove(double start, double end) {
   // Note that remove always uses PTS, even when sorting using DTS.  This is
   // intended to work like the MSE definition.
 
-  std::unique_lock<Mutex> lock(impl_->mutex);
+  std::unique_lock<SharedMutex> lock(impl_->mutex);
+  auto updateKeyFrames =
+      impl_->order_by_dts ? &UpdateKeyFrames<true> : &UpdateKeyFrames<false>;
   bool is_removing = false;
-  for (auto it = impl_->buffered_ranges.begin();
-       it != impl_->buffered_ranges.end();) {
+  bool removed_any = false;
+  for (size_t i = 0; i < impl_->buffered_ranges.size();) {
+    Range* range = &impl_->buffered_ranges[i];
+    FrameList* frames = &range->frames;
     // These represent the range of frames within this buffer to delete.
-    auto frame_del_start = is_removing ? it->frames.begin() : it->frames.end();
-    auto frame_del_end = it->frames.end();
+    auto frame_del_start = is_removing ? frames->begin() : frames->end();
+    auto frame_del_end = frames->end();
 
-    for (auto frame = it->frames.begin(); frame != it->frames.end(); frame++) {
+    for (auto frame = frames->begin(); frame != frames->end(); frame++) {
       if (!is_removing) {
         // Only start deleting frames whose start time is in the range.
         if ((*frame)->pts >= start && (*frame)->pts < end) {
@@ -294,42 +398,54 @@ void StreamBase::Remove(double start, double end) {
       }
     }
 
-    if (frame_del_start != it->frames.begin() &&
-        frame_del_start != it->frames.end() &&
-        frame_del_end != it->frames.end()) {
+    impl_->estimated_size -= SumFrameSizes(frame_del_start, frame_del_end);
+    if (frame_del_start != frame_del_end)
+      removed_any = true;
+    if (frame_del_start != frames->begin() &&
+        frame_del_start != frames->end() && frame_del_end != frames->end()) {
       // We deleted a partial range, so we need to split the buffered range.
-      auto new_it = impl_->buffered_ranges.emplace(it);  // new_it + 1 == it
-
-      // Move the elements before |frame_del_start| from |it->frames| to
-      // |new_it->frames|.
-      new_it->frames.splice(new_it->frames.end(), it->frames,
-                            it->frames.begin(), frame_del_start);
-
-      it->frames.erase(it->frames.begin(), frame_del_end);
-      UpdatePtsRanges(it);
-      UpdatePtsRanges(new_it);
-      it++;  // list::emplace() doesn't invalidate any iterators.
+      // Move the elements before |frame_del_start| to a new range before this
+      // one.
+      Range new_range;
+      new_range.frames.assign(std::make_move_iterator(frames->begin()),
+                              std::make_move_iterator(frame_del_start));
+      frames->erase(frames->begin(), frame_del_end);
+      UpdatePtsRanges(range);
+      UpdatePtsRanges(&new_range);
+      updateKeyFrames(range);
+      updateKeyFrames(&new_range);
+
+      impl_->buffered_ranges.insert(impl_->buffered_ranges.begin() + i,
+                                    std::move(new_range));
+      i += 2;
     } else {
-      it->frames.erase(frame_del_start, frame_del_end);
-      if (it->frames.empty()) {
-        it = impl_->buffered_ranges.erase(it);
+      frames->erase(frame_del_start, frame_del_end);
+      if (frames->empty()) {
+        impl_->buffered_ranges.erase(impl_->buffered_ranges.begin() + i);
       } else {
-        UpdatePtsRanges(it);
-        it++;
+        UpdatePtsRanges(range);
+        if (frame_del_start != frame_del_end)
+          updateKeyFrames(range);
+        i++;
       }
     }
   }
 
   AssertRangesSorted();
+  if (removed_any && impl_->on_removed)
+    impl_->on_removed(start, end);
+  impl_->PublishSnapshot();
 }
 
 void StreamBase::Clear() {
-  std::unique_lock<Mutex> lock(impl_->mutex);
+  std::unique_lock<SharedMutex> lock(impl_->mutex);
   impl_->buffered_ranges.clear();
+  impl_->estimated_size = 0;
+  impl_->PublishSnapshot();
 }
 
 void StreamBase::DebugPrint(bool all_frames) const {
-  std::unique_lock<Mutex> lock(impl_->mutex);
+  util::shared_lock<SharedMutex> lock(impl_->mutex);
   DebugPrintLocked(all_frames);
 }
 
@@ -359,7 +475,7 @@ void StreamBase::DebugPrintLocked(bool all_frames) const {
 
 std::shared_ptr<BaseFrame> StreamBase::GetFrameInternal(
     double time, FrameLocation kind) const {
-  std::unique_lock<Mutex> lock(impl_->mutex);
+  util::shared_lock<SharedMutex> lock(impl_->mutex);
   AssertRangesSorted();
 
   auto getTime = impl_->order_by_dts ? &GetTime<true> : &GetTime<false>;
@@ -367,13 +483,15 @@ std::shared_ptr<BaseFrame> StreamBase::GetFrameInternal(
       impl_->order_by_dts ? &FrameLowerBound<true> : &FrameLowerBound<false>;
 
   // Find the first buffered range that includes or is after |time|.
-  auto it = std::find_if(
-      impl_->buffered_ranges.begin(), impl_->buffered_ranges.end(),
-      [&](const Range& range) { return getTime(range.frames.back()) >= time; });
+  auto it = FindFirstRange(&impl_->buffered_ranges, [&](const Range& range) {
+    return getTime(range.frames.back()) >= time;
+  });
 
   if (it == impl_->buffered_ranges.end()) {
-    if (kind == FrameLocation::After || impl_->buffered_ranges.empty())
+    if (kind == FrameLocation::After || kind == FrameLocation::KeyFrameAfter ||
+        impl_->buffered_ranges.empty()) {
       return nullptr;
+    }
 
     it = std::prev(impl_->buffered_ranges.end());
   }
@@ -410,17 +528,38 @@ std::shared_ptr<BaseFrame> StreamBase::GetFrameInternal(
       return prev_diff < diff && diff != 0 ? *prev_it : *frame_it;
     }
 
-    case FrameLocation::KeyFrameBefore:
+    case FrameLocation::KeyFrameBefore: {
       if (frame_it == it->frames.end())
         frame_it = std::prev(it->frames.end());
       else if (frame_it != it->frames.begin() && getTime(*frame_it) > time)
         frame_it--;  // If frame_it is a future frame, move backward.
 
       DCHECK((*it->frames.begin())->is_key_frame);
-      while (!(*frame_it)->is_key_frame)
-        frame_it--;
+      DCHECK(!it->key_frames.empty());
+      // Use the key frame index to find the last key frame at or before
+      // |frame_it|.  The first frame in a range is always a key frame.
+      const double frame_time = getTime(*frame_it);
+      auto key_it = std::upper_bound(it->key_frames.begin(),
+                                     it->key_frames.end(), frame_time);
+      if (key_it != it->key_frames.begin())
+        frame_it = lowerBound(it->frames, *std::prev(key_it));
+      DCHECK((*frame_it)->is_key_frame);
 
       return getTime(*frame_it) <= time ? *frame_it : nullptr;
+    }
+
+    case FrameLocation::KeyFrameAfter: {
+      // Ranges always start with a key frame, so if there isn't one after
+      // |time| in this range, use the start of the next range.
+      auto key_it = std::upper_bound(it->key_frames.begin(),
+                                     it->key_frames.end(), time);
+      if (key_it != it->key_frames.end())
+        return *lowerBound(it->frames, *key_it);
+      else if (std::next(it) != impl_->buffered_ranges.end())
+        return std::next(it)->frames.front();
+      else
+        return nullptr;
+    }
   }
 }
 
@@ -438,6 +577,13 @@ void StreamBase::AssertRangesSorted() const {
     CHECK_LE(range.start_pts, range.end_pts);
     CHECK(std::is_sorted(range.frames.begin(), range.frames.end(),
                          frame_less_than));
+    // - Have an index entry for each key frame.
+    CHECK_EQ(static_cast<size_t>(std::count_if(
+                 range.frames.begin(), range.frames.end(),
+                 [](const std::shared_ptr<BaseFrame>& frame) {
+                   return frame->is_key_frame;
+                 })),
+             range.key_frames.size());
     return true;
   };
   auto range_less_than = [&](const Range& first, const Range& second) {
@@ -12,12 +12,14 @@
 // See the License for the specific language governing permissions and
 // limitations under the License.
 
-#include <algorithm>
-#include <cmath>
+#include <glog/logging.h>
+
 #include <unordered_set>
 
 #include "shaka/media/text_track.h"
 #include "src/debug/mutex.h"
+#include "src/media/cue_index.h"
+#include "src/media/webvtt_parser.h"
 #include "src/util/utils.h"
 
 namespace shaka {
@@ -30,6 +32,7 @@ class TextTrack::Impl {
   Mutex mutex;
   TextTrackMode mode;
   std::vector<std::shared_ptr<VTTCue>> cues;
+  CueIndex index;
   std::unordered_set<Client*> clients;
 };
 
@@ -60,32 +63,45 @@ std::vector<std::shared_ptr<VTTCue>> TextTrack::cues() const {
 }
 
 std::vector<std::shared_ptr<VTTCue>> TextTrack::active_cues(double time) const {
-  auto cues = this->cues();
-
-  std::vector<std::shared_ptr<VTTCue>> ret;
-  for (auto& cue : cues) {
-    if (cue->start_time() <= time && cue->end_time() >= time)
-      ret.emplace_back(cue);
-  }
-  return ret;
+  std::unique_lock<Mutex> lock(impl_->mutex);
+  return impl_->index.ActiveCues(time);
 }
 
 double TextTrack::NextCueChangeTime(double time) const {
-  auto cues = this->cues();
-
-  double next_time = INFINITY;
-  for (auto& cue : cues) {
-    if (cue->start_time() > time)
-      next_time = std::min(next_time, cue->start_time());
-    else if (cue->end_time() > time)
-      next_time = std::min(next_time, cue->end_time());
+  std::unique_lock<Mutex> lock(impl_->mutex);
+  return impl_->index.NextChangeTime(time);
+}
+
+void TextTrack::GetActiveCueChanges(
+    double previous_time, double time,
+    std::vector<std::shared_ptr<VTTCue>>* added,
+    std::vector<std::shared_ptr<VTTCue>>* removed) const {
+  std::unique_lock<Mutex> lock(impl_->mutex);
+  auto old_cues = impl_->index.ActiveCues(previous_time);
+  auto new_cues = impl_->index.ActiveCues(time);
+  std::unordered_set<VTTCue*> old_set;
+  for (auto& cue : old_cues)
+    old_set.insert(cue.get());
+  std::unordered_set<VTTCue*> new_set;
+  for (auto& cue : new_cues)
+    new_set.insert(cue.get());
+
+  added->clear();
+  for (auto& cue : new_cues) {
+    if (old_set.count(cue.get()) == 0)
+      added->emplace_back(cue);
+  }
+  removed->clear();
+  for (auto& cue : old_cues) {
+    if (new_set.count(cue.get()) == 0)
+      removed->emplace_back(cue);
   }
-  return next_time;
 }
 
 void TextTrack::AddCue(std::shared_ptr<VTTCue> cue) {
   std::unique_lock<Mutex> lock(impl_->mutex);
   impl_->cues.emplace_back(cue);
+  impl_->index.Add(cue);
 
   for (Client* client : impl_->clients)
     client->OnCueAdded(cue);
@@ -94,11 +110,25 @@ void TextTrack::AddCue(std::shared_ptr<VTTCue> cue) {
 void TextTrack::RemoveCue(std::shared_ptr<VTTCue> cue) {
   std::unique_lock<Mutex> lock(impl_->mutex);
   util::RemoveElement(&impl_->cues, cue);
+  impl_->index.Remove(cue);
 
   for (Client* client : impl_->clients)
     client->OnCueRemoved(cue);
 }
 
+bool TextTrack::AddWebVttCues(const uint8_t* data, size_t size,
+                              double offset) {
+  std::vector<std::shared_ptr<VTTCue>> cues;
+  std::string error;
+  if (!ParseWebVtt(data, size, offset, &cues, &error)) {
+    LOG(ERROR) << "Error parsing WebVTT: " << error;
+    return false;
+  }
+  for (auto& cue : cues)
+    AddCue(cue);
+  return true;
+}
+
 
 void TextTrack::AddClient(Client* client) {
   std::unique_lock<Mutex> lock(impl_->mutex);
@@ -0,0 +1,285 @@
+// Copyright 2020 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     https://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "src/media/thumbnail_generator.h"
+
+#include <glog/logging.h>
+
+#include <algorithm>
+#include <cmath>
+#include <functional>
+
+#include "shaka/media/stream_info.h"
+#include "src/util/clock.h"
+
+namespace shaka {
+namespace media {
+
+namespace {
+
+/**
+ * The number of bytes of keyframes to keep.  Once there are more, the ones
+ * farthest from the last requested time are removed.
+ */
+constexpr const size_t kMaxKeyFrameBytes = 16 * 1024 * 1024;
+
+/**
+ * The amount to reduce the resolution by, as a power of two.  Only some
+ * decoders support this.
+ */
+constexpr const uint8_t kThumbnailLowres = 1;
+
+DecoderOptions GetThumbnailOptions(const DecoderOptions& player_options) {
+  // Use a single thread so the decoding only uses one core, and reduce the
+  // quality since the frames are shown small.
+  DecoderOptions ret = player_options;
+  ret.threading = DecoderThreadingOptions();
+  ret.threading.thread_count = 1;
+  ret.threading.low_delay = true;
+  ret.codec_threading.clear();
+  ret.decrypt_ahead = false;
+  ret.fast_decode = true;
+  ret.lowres = kThumbnailLowres;
+  return ret;
+}
+
+}  // namespace
+
+ThumbnailGenerator::ThumbnailGenerator(const DecoderOptions& options)
+    : mutex_("ThumbnailGenerator"),
+      key_frame_bytes_(0),
+      last_request_(0),
+      cache_size_(kDefaultCacheSize),
+      cpu_limit_(kDefaultCpuLimit),
+      options_(GetThumbnailOptions(options)),
+      task_("Thumbnails", options.worker_pool, &util::Clock::Instance,
+            std::bind(&ThumbnailGenerator::Step, this),
+            ThreadRole::Background) {}
+
+ThumbnailGenerator::~ThumbnailGenerator() {
+  task_.Stop();
+}
+
+bool ThumbnailGenerator::AppendSegment(const std::string& mime,
+                                       double timestamp_offset,
+                                       const uint8_t* data, size_t size) {
+  const DemuxerFactory* factory = DemuxerFactory::GetFactory();
+  if (!factory || !factory->IsTypeSupported(mime))
+    return false;
+
+  {
+    std::unique_lock<Mutex> lock(mutex_);
+    pending_.push_back({mime, timestamp_offset, {data, data + size}});
+  }
+  task_.Wake();
+  return true;
+}
+
+std::shared_ptr<DecodedFrame> ThumbnailGenerator::GetThumbnail(double time) {
+  std::unique_lock<Mutex> lock(mutex_);
+  last_request_ = time;
+  if (key_frames_.empty())
+    return nullptr;
+
+  // Use the keyframe at or before the time, or the first one.
+  auto key_frame = key_frames_.upper_bound(time);
+  if (key_frame != key_frames_.begin())
+    --key_frame;
+  const double key_time = key_frame->first;
+
+  auto cached = thumbnail_index_.find(key_time);
+  if (cached != thumbnail_index_.end()) {
+    thumbnails_.splice(thumbnails_.begin(), thumbnails_, cached->second);
+    return cached->second->second;
+  }
+
+  requested_ = key_time;
+  task_.Wake();
+
+  // Until it is decoded, use the closest thumbnail we have.
+  if (thumbnail_index_.empty())
+    return nullptr;
+  auto next = thumbnail_index_.lower_bound(key_time);
+  if (next == thumbnail_index_.end())
+    return std::prev(next)->second->second;
+  if (next == thumbnail_index_.begin())
+    return next->second->second;
+  auto prev = std::prev(next);
+  if (key_time - prev->first <= next->first - key_time)
+    return prev->second->second;
+  return next->second->second;
+}
+
+void ThumbnailGenerator::SetLimits(size_t cache_size, double cpu_limit) {
+  std::unique_lock<Mutex> lock(mutex_);
+  cache_size_ = std::max<size_t>(cache_size, 1);
+  cpu_limit_ = std::min(std::max(cpu_limit, 0.01), 1.0);
+  while (thumbnails_.size() > cache_size_) {
+    thumbnail_index_.erase(thumbnails_.back().first);
+    thumbnails_.pop_back();
+  }
+}
+
+void ThumbnailGenerator::SetPriority(int priority) {
+  task_.SetPriority(priority);
+}
+
+void ThumbnailGenerator::Clear() {
+  std::unique_lock<Mutex> lock(mutex_);
+  pending_.clear();
+  key_frames_.clear();
+  key_frame_bytes_ = 0;
+  thumbnails_.clear();
+  thumbnail_index_.clear();
+  requested_.reset();
+}
+
+void ThumbnailGenerator::OnLoadedMetaData(double duration) {}
+
+void ThumbnailGenerator::OnEncrypted(eme::MediaKeyInitDataType type,
+                                     const uint8_t* data, size_t size) {}
+
+double ThumbnailGenerator::Step() {
+  optional<Segment> segment;
+  std::shared_ptr<EncodedFrame> key_frame;
+  double key_time = 0;
+  double cpu_limit;
+  {
+    std::unique_lock<Mutex> lock(mutex_);
+    if (!pending_.empty()) {
+      segment = std::move(pending_.front());
+      pending_.pop_front();
+    } else if (requested_.has_value()) {
+      key_time = requested_.value();
+      requested_.reset();
+      auto it = key_frames_.find(key_time);
+      if (it != key_frames_.end() && thumbnail_index_.count(key_time) == 0)
+        key_frame = it->second;
+    } else {
+      return WorkerTask::kWaitForWake;
+    }
+    cpu_limit = cpu_limit_;
+  }
+
+  const uint64_t start = util::Clock::Instance.GetMonotonicTime();
+  if (segment.has_value()) {
+    DemuxSegment(segment.value());
+  } else if (key_frame) {
+    std::shared_ptr<DecodedFrame> thumbnail = DecodeKeyFrame(key_frame);
+    if (thumbnail) {
+      std::unique_lock<Mutex> lock(mutex_);
+      // The keyframes may have been cleared while decoding.
+      if (key_frames_.count(key_time) > 0 &&
+          thumbnail_index_.count(key_time) == 0) {
+        thumbnails_.emplace_front(key_time, thumbnail);
+        thumbnail_index_[key_time] = thumbnails_.begin();
+        while (thumbnails_.size() > cache_size_) {
+          thumbnail_index_.erase(thumbnails_.back().first);
+          thumbnails_.pop_back();
+        }
+      }
+    }
+  }
+
+  // Wait long enough that this is only busy for |cpu_limit| of the time.
+  const double elapsed =
+      (util::Clock::Instance.GetMonotonicTime() - start) / 1000.0;
+  return elapsed * (1 - cpu_limit) / cpu_limit;
+}
+
+void ThumbnailGenerator::DemuxSegment(const Segment& segment) {
+  const DemuxerFactory* factory = DemuxerFactory::GetFactory();
+  if (!factory)
+    return;
+  if (demuxer_ && segment.mime != demuxer_mime_) {
+    if (!factory->CanSwitchType(demuxer_mime_, segment.mime) ||
+        !demuxer_->SwitchType(segment.mime)) {
+      demuxer_.reset();
+    }
+  }
+  if (!demuxer_)
+    demuxer_ = factory->Create(segment.mime, this);
+  demuxer_mime_ = segment.mime;
+  if (!demuxer_) {
+    LOG(ERROR) << "Unable to create a demuxer for thumbnails: "
+               << segment.mime;
+    return;
+  }
+
+  std::vector<std::shared_ptr<EncodedFrame>> frames;
+  if (!demuxer_->Demux(segment.timestamp_offset, segment.data.data(),
+                       segment.data.size(), &frames)) {
+    LOG(ERROR) << "Error demuxing thumbnail segment";
+    demuxer_.reset();
+    return;
+  }
+
+  std::unique_lock<Mutex> lock(mutex_);
+  for (auto& frame : frames) {
+    // There is no EME implementation for the thumbnails, so encrypted frames
+    // can't be used.
+    if (!frame->is_key_frame || !frame->stream_info->is_video ||
+        frame->encryption_info) {
+      continue;
+    }
+    auto& entry = key_frames_[frame->pts];
+    if (entry)
+      key_frame_bytes_ -= entry->data_size;
+    key_frame_bytes_ += frame->data_size;
+    entry = std::move(frame);
+  }
+  EvictKeyFrames();
+}
+
+std::shared_ptr<DecodedFrame> ThumbnailGenerator::DecodeKeyFrame(
+    std::shared_ptr<EncodedFrame> frame) {
+  if (!decoder_) {
+    decoder_ = Decoder::CreateDefaultDecoder(options_);
+    if (!decoder_) {
+      LOG(ERROR) << "No decoder available for thumbnails";
+      return nullptr;
+    }
+  }
+
+  // Each keyframe is decoded on its own, so reset the decoder and flush it to
+  // get the frame out.
+  decoder_->ResetDecoder();
+  std::vector<std::shared_ptr<DecodedFrame>> decoded;
+  std::string error;
+  if (decoder_->Decode(frame, nullptr, &decoded, &error) !=
+          MediaStatus::Success ||
+      decoder_->Decode(nullptr, nullptr, &decoded, &error) !=
+          MediaStatus::Success) {
+    LOG(ERROR) << "Error decoding thumbnail: " << error;
+    return nullptr;
+  }
+  return decoded.empty() ? nullptr : decoded.front();
+}
+
+void ThumbnailGenerator::EvictKeyFrames() {
+  // |mutex_| is held by the caller.
+  while (key_frame_bytes_ > kMaxKeyFrameBytes && key_frames_.size() > 1) {
+    auto first = key_frames_.begin();
+    auto last = std::prev(key_frames_.end());
+    auto evict = std::abs(first->first - last_request_) >
+                         std::abs(last->first - last_request_)
+                     ? first
+                     : last;
+    key_frame_bytes_ -= evict->second->data_size;
+    key_frames_.erase(evict);
+  }
+}
+
+}  // namespace media
+}  // namespace shaka
@@ -0,0 +1,146 @@
+// Copyright 2020 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     https://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef SHAKA_EMBEDDED_MEDIA_THUMBNAIL_GENERATOR_H_
+#define SHAKA_EMBEDDED_MEDIA_THUMBNAIL_GENERATOR_H_
+
+#include <deque>
+#include <list>
+#include <map>
+#include <memory>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "shaka/media/decoder.h"
+#include "shaka/media/demuxer.h"
+#include "shaka/media/frames.h"
+#include "shaka/optional.h"
+#include "src/debug/mutex.h"
+#include "src/media/worker_task.h"
+#include "src/util/macros.h"
+
+namespace shaka {
+namespace media {
+
+/**
+ * Decodes the keyframes of a trick-play (I-frame only) video stream into
+ * thumbnails for scrub previews.  Segments are demuxed in the background and
+ * only their keyframes are kept.  A keyframe is decoded when its thumbnail is
+ * asked for, at a low priority, with a single decoder thread, and with the
+ * decoder's quality-reducing options (see DecoderOptions::fast_decode).  The
+ * most recently used thumbnails are kept.
+ *
+ * This type is thread-safe.
+ */
+class ThumbnailGenerator : Demuxer::Client {
+ public:
+  /** The default number of thumbnails to keep. */
+  static constexpr const size_t kDefaultCacheSize = 16;
+
+  /** The default fraction of a CPU core the decoding can use. */
+  static constexpr const double kDefaultCpuLimit = 0.25;
+
+  /**
+   * @param options The options the player's decoders use.  The thumbnail
+   *   decoder uses the same pool, but changes the other options.
+   */
+  explicit ThumbnailGenerator(const DecoderOptions& options);
+  ~ThumbnailGenerator() override;
+
+  SHAKA_NON_COPYABLE_OR_MOVABLE_TYPE(ThumbnailGenerator);
+
+  /**
+   * Adds a segment of the trick-play stream.  The data is copied.
+   *
+   * @param mime The full MIME type of the segment.
+   * @param timestamp_offset The number of seconds to move the timestamps
+   *   forward.
+   * @param data The segment data.
+   * @param size The number of bytes in |data|.
+   * @return False if the MIME type can't be demuxed.
+   */
+  bool AppendSegment(const std::string& mime, double timestamp_offset,
+                     const uint8_t* data, size_t size);
+
+  /**
+   * Gets the thumbnail for the keyframe at or before the given time.  If that
+   * keyframe hasn't been decoded yet, it is queued to be decoded (replacing
+   * any earlier request) and the closest thumbnail that was decoded is
+   * returned instead.
+   *
+   * @return The thumbnail, or nullptr if none were decoded yet.
+   */
+  std::shared_ptr<DecodedFrame> GetThumbnail(double time);
+
+  /**
+   * Sets the number of thumbnails to keep and the fraction of a CPU core the
+   * decoding can use (e.g. 0.25 means the decoder is idle at least 75% of the
+   * time while it has work).
+   */
+  void SetLimits(size_t cache_size, double cpu_limit);
+
+  /** Sets the priority of the decoding when it runs on a WorkerPool. */
+  void SetPriority(int priority);
+
+  /** Removes all the keyframes and thumbnails. */
+  void Clear();
+
+ private:
+  struct Segment {
+    std::string mime;
+    double timestamp_offset;
+    std::vector<uint8_t> data;
+  };
+
+  void OnLoadedMetaData(double duration) override;
+  void OnEncrypted(eme::MediaKeyInitDataType type, const uint8_t* data,
+                   size_t size) override;
+
+  double Step();
+  void DemuxSegment(const Segment& segment);
+  /** Decodes the given keyframe and returns the frame, or nullptr. */
+  std::shared_ptr<DecodedFrame> DecodeKeyFrame(
+      std::shared_ptr<EncodedFrame> frame);
+  void EvictKeyFrames();
+
+  Mutex mutex_;
+  std::deque<Segment> pending_;
+  // The keyframes, keyed by their time.
+  std::map<double, std::shared_ptr<EncodedFrame>> key_frames_;
+  size_t key_frame_bytes_;
+  // The decoded thumbnails, most recently used first, and an index into them
+  // by time.
+  std::list<std::pair<double, std::shared_ptr<DecodedFrame>>> thumbnails_;
+  std::map<double, decltype(thumbnails_)::iterator> thumbnail_index_;
+  // The time of the keyframe to decode next.
+  optional<double> requested_;
+  double last_request_;
+  size_t cache_size_;
+  double cpu_limit_;
+
+  // These are only used on the background task.
+  const DecoderOptions options_;
+  std::string demuxer_mime_;
+  std::unique_ptr<Demuxer> demuxer_;
+  std::unique_ptr<Decoder> decoder_;
+
+  // Should be last so the task starts after all the fields are initialized.
+  WorkerTask task_;
+};
+
+}  // namespace media
+}  // namespace shaka
+
+#endif  // SHAKA_EMBEDDED_MEDIA_THUMBNAIL_GENERATOR_H_
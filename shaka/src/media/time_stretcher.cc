@@ -0,0 +1,212 @@
+// Copyright 2020 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     https://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "src/media/time_stretcher.h"
+
+#include <glog/logging.h>
+
+#include <algorithm>
+#include <cmath>
+
+namespace shaka {
+namespace media {
+
+namespace {
+
+/** The size of the overlapping windows, in seconds. */
+constexpr const double kWindowSeconds = 0.02;
+
+/** How far a window can be shifted to match the waveform, in seconds. */
+constexpr const double kSearchSeconds = 0.005;
+
+/**
+ * The distance between samples and window positions compared in the first,
+ * coarse, search for the best window.  The best coarse position is then
+ * refined using every sample.
+ */
+constexpr const size_t kCoarseStep = 4;
+
+}  // namespace
+
+constexpr const double TimeStretcher::kMinRate;
+constexpr const double TimeStretcher::kMaxRate;
+
+TimeStretcher::TimeStretcher()
+    : channels_(0),
+      window_(0),
+      half_window_(0),
+      search_(0),
+      active_(false),
+      started_(false),
+      window_start_(0),
+      position_(0) {}
+
+TimeStretcher::~TimeStretcher() {}
+
+void TimeStretcher::Configure(uint32_t channel_count, uint32_t sample_rate) {
+  channels_ = channel_count;
+  half_window_ = std::max<size_t>(
+      static_cast<size_t>(sample_rate * kWindowSeconds / 2), kCoarseStep);
+  window_ = half_window_ * 2;
+  search_ = static_cast<size_t>(sample_rate * kSearchSeconds);
+  Reset();
+}
+
+void TimeStretcher::Reset() {
+  active_ = false;
+  started_ = false;
+  input_.clear();
+  window_start_ = 0;
+  position_ = 0;
+}
+
+void TimeStretcher::Process(double rate, const float* input, size_t frames,
+                            std::vector<float>* output) {
+  DCHECK_GT(channels_, 0u) << "Must call Configure first";
+  output->clear();
+  if (!active_ && rate == 1) {
+    output->assign(input, input + frames * channels_);
+    return;
+  }
+
+  active_ = true;
+  input_.insert(input_.end(), input, input + frames * channels_);
+  if (rate == 1) {
+    Flush(output);
+    return;
+  }
+
+  rate = std::min(std::max(rate, kMinRate), kMaxRate);
+  const size_t total = input_.size() / channels_;
+  if (!started_) {
+    // Output the first half-window directly; the next window will be faded
+    // in over the second half.
+    if (total < window_)
+      return;
+    output->insert(output->end(), input_.begin(),
+                   input_.begin() + half_window_ * channels_);
+    window_start_ = 0;
+    position_ = half_window_ * rate;
+    started_ = true;
+  }
+
+  while (true) {
+    const size_t nominal = static_cast<size_t>(position_);
+    if (nominal + search_ + window_ > total ||
+        window_start_ + window_ > total) {
+      break;
+    }
+
+    // Cross-fade from the samples that followed the previous window to the
+    // start of the new window.
+    const size_t best = FindBestWindow(nominal);
+    const float* fade_out = &input_[(window_start_ + half_window_) * channels_];
+    const float* fade_in = &input_[best * channels_];
+    const size_t start = output->size();
+    output->resize(start + half_window_ * channels_);
+    float* dest = output->data() + start;
+    for (size_t i = 0; i < half_window_; i++) {
+      const float weight = (i + 0.5f) / half_window_;
+      for (size_t c = 0; c < channels_; c++) {
+        const size_t index = i * channels_ + c;
+        dest[index] =
+            fade_out[index] + (fade_in[index] - fade_out[index]) * weight;
+      }
+    }
+
+    window_start_ = best;
+    position_ += half_window_ * rate;
+  }
+
+  // Drop the input that can't be used anymore.
+  const size_t nominal = static_cast<size_t>(position_);
+  const size_t drop =
+      std::min(window_start_, nominal > search_ ? nominal - search_ : 0);
+  if (drop > 0) {
+    input_.erase(input_.begin(), input_.begin() + drop * channels_);
+    window_start_ -= drop;
+    position_ -= static_cast<double>(drop);
+  }
+}
+
+size_t TimeStretcher::FindBestWindow(size_t nominal) {
+  const size_t lower = nominal > search_ ? nominal - search_ : 0;
+  const size_t upper = nominal + search_;
+
+  // Compare using the sum of the channels to reduce the work.
+  mono_template_.resize(half_window_);
+  const float* prev = &input_[(window_start_ + half_window_) * channels_];
+  for (size_t i = 0; i < half_window_; i++) {
+    float sum = 0;
+    for (size_t c = 0; c < channels_; c++)
+      sum += prev[i * channels_ + c];
+    mono_template_[i] = sum;
+  }
+  mono_input_.resize(upper - lower + half_window_);
+  for (size_t i = 0; i < mono_input_.size(); i++) {
+    const float* sample = &input_[(lower + i) * channels_];
+    float sum = 0;
+    for (size_t c = 0; c < channels_; c++)
+      sum += sample[c];
+    mono_input_[i] = sum;
+  }
+
+  // Use the normalized cross-correlation so louder windows aren't favored.
+  auto score = [&](size_t start, size_t step) {
+    const float* candidate = &mono_input_[start - lower];
+    float correlation = 0;
+    float energy = 0;
+    for (size_t i = 0; i < half_window_; i += step) {
+      correlation += mono_template_[i] * candidate[i];
+      energy += candidate[i] * candidate[i];
+    }
+    return correlation / std::sqrt(energy + 1e-9f);
+  };
+
+  size_t best = nominal;
+  float best_score = -INFINITY;
+  for (size_t start = lower; start <= upper; start += kCoarseStep) {
+    const float value = score(start, kCoarseStep);
+    if (value > best_score) {
+      best_score = value;
+      best = start;
+    }
+  }
+
+  const size_t coarse = best;
+  best_score = -INFINITY;
+  const size_t refine_lower =
+      std::max(lower, coarse > kCoarseStep ? coarse - kCoarseStep + 1 : 0);
+  const size_t refine_upper = std::min(upper, coarse + kCoarseStep - 1);
+  for (size_t start = refine_lower; start <= refine_upper; start++) {
+    const float value = score(start, 1);
+    if (value > best_score) {
+      best_score = value;
+      best = start;
+    }
+  }
+  return best;
+}
+
+void TimeStretcher::Flush(std::vector<float>* output) {
+  // The output so far ends with the first half of the previous window, so
+  // continue with the samples that follow it.
+  const size_t from = started_ ? (window_start_ + half_window_) * channels_ : 0;
+  output->insert(output->end(), input_.begin() + std::min(from, input_.size()),
+                 input_.end());
+  Reset();
+}
+
+}  // namespace media
+}  // namespace shaka
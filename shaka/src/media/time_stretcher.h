@@ -0,0 +1,111 @@
+// Copyright 2020 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     https://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef SHAKA_EMBEDDED_MEDIA_TIME_STRETCHER_H_
+#define SHAKA_EMBEDDED_MEDIA_TIME_STRETCHER_H_
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <vector>
+
+#include "src/util/macros.h"
+
+namespace shaka {
+namespace media {
+
+/**
+ * Changes the speed of audio without changing its pitch, using WSOLA
+ * (waveform-similarity overlap-add).  The input is split into overlapping
+ * windows which are taken from the input every |rate| half-windows and added
+ * to the output every half-window.  Each window is shifted slightly so it
+ * lines up with the waveform of the previous one, which avoids the phasing
+ * artifacts of a plain overlap-add.
+ *
+ * At a rate of 1, samples are passed through unchanged.  When the rate
+ * returns to 1, the buffered input is flushed so there is no extra latency or
+ * CPU cost during normal playback.
+ *
+ * This works on packed float samples.  This type is not thread-safe.
+ */
+class TimeStretcher final {
+ public:
+  /** The slowest rate that sounds acceptable. */
+  static constexpr const double kMinRate = 0.8;
+  /** The fastest rate that sounds acceptable. */
+  static constexpr const double kMaxRate = 1.5;
+
+  TimeStretcher();
+  ~TimeStretcher();
+
+  SHAKA_NON_COPYABLE_OR_MOVABLE_TYPE(TimeStretcher);
+
+  /** Sets the format of the samples; this also resets the stretcher. */
+  void Configure(uint32_t channel_count, uint32_t sample_rate);
+
+  /** Drops any buffered input; the next samples won't overlap old ones. */
+  void Reset();
+
+  /** @return Whether input is buffered and Process needs to be called. */
+  bool is_active() const {
+    return active_;
+  }
+
+  /**
+   * Stretches the given samples.  Some input may be buffered until enough
+   * input is available to produce output.
+   *
+   * @param rate The playback rate to play at.
+   * @param input The packed samples to stretch.
+   * @param frames The number of samples (per channel) in |input|.
+   * @param output Will be filled with the stretched packed samples.
+   */
+  void Process(double rate, const float* input, size_t frames,
+               std::vector<float>* output);
+
+ private:
+  /**
+   * Finds the start of the input window near |nominal| that best matches the
+   * waveform following the previous window.
+   */
+  size_t FindBestWindow(size_t nominal);
+
+  /** Writes the rest of the buffered input to |output| and stops stretching. */
+  void Flush(std::vector<float>* output);
+
+  size_t channels_;
+  // The size of the windows and the distance the windows can be shifted, in
+  // samples (per channel).
+  size_t window_;
+  size_t half_window_;
+  size_t search_;
+
+  bool active_;
+  bool started_;
+  // The buffered input, packed.
+  std::vector<float> input_;
+  // The start of the previous window in |input_|.
+  size_t window_start_;
+  // The nominal start of the next window in |input_|.
+  double position_;
+
+  // Temporary buffers used to find the best window, with the channels summed.
+  std::vector<float> mono_template_;
+  std::vector<float> mono_input_;
+};
+
+}  // namespace media
+}  // namespace shaka
+
+#endif  // SHAKA_EMBEDDED_MEDIA_TIME_STRETCHER_H_
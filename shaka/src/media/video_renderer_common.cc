@@ -14,7 +14,14 @@
 
 #include "src/media/video_renderer_common.h"
 
+#include <math.h>
+
 #include <algorithm>
+#include <utility>
+
+#include "src/debug/startup_tracer.h"
+#include "src/debug/telemetry.h"
+#include "src/debug/trace_event.h"
 
 namespace shaka {
 namespace media {
@@ -27,6 +34,25 @@ constexpr const double kMinVideoDelay = 1.0 / 120;
 /** The maximum delay, in seconds, to delay between drawing frames. */
 constexpr const double kMaxVideoDelay = 1.0 / 15;
 
+/**
+ * The delay, in seconds, between checking for frames when there is no input
+ * stream (e.g. while video is suspended).
+ */
+constexpr const double kDetachedVideoDelay = 0.1;
+
+/**
+ * The weight of a new presentation in the averaged render latency and A/V
+ * offset.  The first presentations are weighted more so the averages settle
+ * quickly.
+ */
+constexpr const double kPresentationWeight = 0.1;
+
+/**
+ * The maximum render latency, in seconds, to compensate for.  Larger values are
+ * more likely a stalled app than a slow display.
+ */
+constexpr const double kMaxRenderLatency = 0.25;
+
 }  // namespace
 
 VideoRendererCommon::VideoRendererCommon()
@@ -35,7 +61,14 @@ VideoRendererCommon::VideoRendererCommon()
       input_(nullptr),
       quality_(),
       fill_mode_(VideoFillMode::MaintainRatio),
-      prev_time_(-1) {}
+      max_frame_width_(0),
+      max_frame_height_(0),
+      prev_time_(-1),
+      vsync_repeats_(0),
+      pending_pts_(0),
+      pending_duration_(0),
+      pending_target_(-1),
+      presented_count_(0) {}
 
 VideoRendererCommon::~VideoRendererCommon() {
   if (player_)
@@ -50,14 +83,19 @@ double VideoRendererCommon::GetCurrentFrame(
     std::shared_ptr<DecodedFrame>* frame) {
   std::unique_lock<Mutex> lock(mutex_);
 
-  if (!player_ || !input_ ||
-      player_->PlaybackState() == VideoPlaybackState::Seeking) {
+  if (!player_ || !input_)
+    return kDetachedVideoDelay;
+  const VideoPlaybackState state = player_->PlaybackState();
+  if (state == VideoPlaybackState::Seeking) {
     // If we are seeking, don't draw anything.  If the caller doesn't clear
     // the display, we will still show the frame before the seek.
     return kMinVideoDelay;
   }
 
-  const double time = player_->CurrentTime();
+  // Select the frame that should be visible once it reaches the display.
+  const double speed =
+      state == VideoPlaybackState::Playing ? player_->PlaybackRate() : 0;
+  const double time = player_->CurrentTime() + quality_.render_latency * speed;
   auto ideal_frame = input_->GetFrame(time, FrameLocation::Near);
   if (!ideal_frame)
     return kMinVideoDelay;
@@ -67,6 +105,11 @@ double VideoRendererCommon::GetCurrentFrame(
   // complicated and sacrificing AV sync.
 
   *frame = ideal_frame;
+  if (ideal_frame->pts != prev_time_) {
+    TRACE_EVENT("media", "Present video");
+    TRACE_FRAME_END(ideal_frame.get());
+    OnFrameSelectedLocked(*ideal_frame, time);
+  }
 
   auto next_frame = input_->GetFrame(ideal_frame->pts, FrameLocation::After);
   const double total_delay = next_frame ? next_frame->pts - time : 0;
@@ -77,20 +120,164 @@ double VideoRendererCommon::GetCurrentFrame(
     const size_t count =
         input_->CountFramesBetween(prev_time_, ideal_frame->pts);
     quality_.dropped_video_frames += count;
+    Telemetry::GetStream(/* is_video= */ true)
+        ->frames_dropped.fetch_add(count, std::memory_order_relaxed);
     quality_.total_video_frames += count;
     if (ideal_frame->pts != prev_time_)
       quality_.total_video_frames++;
   } else {
     quality_.total_video_frames++;
+    StartupTracer::Instance.AddFirstMilestone("First render");
   }
   prev_time_ = ideal_frame->pts;
 
   return delay;
 }
 
+void VideoRendererCommon::GetFrameForVsync(
+    double vsync_delay, double refresh_interval,
+    std::shared_ptr<DecodedFrame>* frame) {
+  std::unique_lock<Mutex> lock(mutex_);
+
+  if (!player_ || !input_)
+    return;
+  const VideoPlaybackState state = player_->PlaybackState();
+  if (state == VideoPlaybackState::Seeking)
+    return;
+
+  // The amount of media time that passes while the frame is displayed.
+  const double speed =
+      state == VideoPlaybackState::Playing ? player_->PlaybackRate() : 0;
+  const double vsync_span = refresh_interval * speed;
+  const double target = player_->CurrentTime() +
+                        (vsync_delay + quality_.render_latency) * speed +
+                        vsync_span / 2;
+  auto ideal_frame = input_->GetFrame(target, FrameLocation::Near);
+  if (!ideal_frame)
+    return;
+
+  std::shared_ptr<DecodedFrame> prev_frame;
+  std::shared_ptr<DecodedFrame> next_frame;
+  if (prev_time_ >= 0) {
+    prev_frame = input_->GetFrame(prev_time_, FrameLocation::Near);
+    if (prev_frame && prev_frame->pts == prev_time_)
+      next_frame = input_->GetFrame(prev_time_, FrameLocation::After);
+    else
+      prev_frame.reset();
+  }
+
+  // The number of vsyncs each frame should be shown for; e.g. 2.5 for 24fps at
+  // 60Hz, which means alternating between 2 and 3.
+  double cadence = 0;
+  auto chosen = ideal_frame;
+  if (prev_frame && next_frame && vsync_span > 0) {
+    cadence = (next_frame->pts - prev_frame->pts) / vsync_span;
+    if (ideal_frame == prev_frame && vsync_repeats_ >= ceil(cadence) &&
+        next_frame->pts <= target + vsync_span) {
+      // Don't show the frame for longer than the cadence allows.
+      chosen = next_frame;
+    } else if (ideal_frame == next_frame && vsync_repeats_ < floor(cadence) &&
+               next_frame->pts >= target - vsync_span) {
+      // Don't switch before the frame has been shown for its cadence.
+      chosen = prev_frame;
+    }
+  }
+
+  *frame = chosen;
+  if (chosen == prev_frame) {
+    vsync_repeats_++;
+    if (cadence > 0 && vsync_repeats_ > ceil(cadence))
+      quality_.repeated_vsyncs++;
+    return;
+  }
+
+  if (prev_time_ >= 0) {
+    const size_t count = input_->CountFramesBetween(prev_time_, chosen->pts);
+    quality_.dropped_video_frames += count;
+    Telemetry::GetStream(/* is_video= */ true)
+        ->frames_dropped.fetch_add(count, std::memory_order_relaxed);
+    quality_.total_video_frames += count;
+    if (chosen->pts != prev_time_)
+      quality_.total_video_frames++;
+    if (prev_frame && chosen != next_frame)
+      quality_.cadence_breaks++;
+  } else {
+    quality_.total_video_frames++;
+    StartupTracer::Instance.AddFirstMilestone("First render");
+  }
+  {
+    TRACE_EVENT("media", "Present video");
+    TRACE_FRAME_END(chosen.get());
+  }
+  OnFrameSelectedLocked(*chosen, target - vsync_span / 2);
+  prev_time_ = chosen->pts;
+  vsync_repeats_ = 1;
+}
+
+std::shared_ptr<DecodedFrame> VideoRendererCommon::GetNextFrame() const {
+  std::unique_lock<Mutex> lock(mutex_);
+  if (!player_ || !input_ || prev_time_ < 0 ||
+      player_->PlaybackState() == VideoPlaybackState::Seeking) {
+    return nullptr;
+  }
+  return input_->GetFrame(prev_time_, FrameLocation::After);
+}
+
+void VideoRendererCommon::TakeSnapshot(SnapshotCallback callback) const {
+  std::shared_ptr<DecodedFrame> frame;
+  {
+    std::unique_lock<Mutex> lock(mutex_);
+    if (input_ && prev_time_ >= 0) {
+      frame = input_->GetFrame(prev_time_, FrameLocation::Near);
+      if (frame && frame->pts != prev_time_)
+        frame.reset();
+    }
+  }
+  TakeFrameSnapshot(std::move(frame), std::move(callback));
+}
+
+void VideoRendererCommon::OnFramePresented(double age) {
+  std::unique_lock<Mutex> lock(mutex_);
+  if (!player_ || pending_target_ < 0 ||
+      player_->PlaybackState() != VideoPlaybackState::Playing) {
+    return;
+  }
+  const double rate = player_->PlaybackRate();
+  if (rate <= 0)
+    return;
+
+  const double presented_time = player_->CurrentTime() - age * rate;
+  const double offset = presented_time - pending_pts_;
+  if (offset > std::max(pending_duration_, kMinVideoDelay))
+    quality_.late_video_frames++;
+  quality_.presented_video_frames++;
+
+  // The frame was selected for the time it was expected to be shown, so any
+  // remaining difference is latency that isn't being compensated for yet.
+  const double missed_latency = (presented_time - pending_target_) / rate;
+  const double weight =
+      std::max(1.0 / (presented_count_ + 1), kPresentationWeight);
+  presented_count_++;
+  quality_.av_sync_offset += (offset - quality_.av_sync_offset) * weight;
+  quality_.render_latency = std::max(
+      std::min(quality_.render_latency + missed_latency * weight,
+               kMaxRenderLatency),
+      0.0);
+  pending_target_ = -1;
+}
+
 void VideoRendererCommon::OnSeeking() {
   std::unique_lock<Mutex> lock(mutex_);
   prev_time_ = -1;
+  vsync_repeats_ = 0;
+  pending_target_ = -1;
+}
+
+void VideoRendererCommon::OnFrameSelectedLocked(const DecodedFrame& frame,
+                                                double target_time) {
+  pending_pts_ = frame.pts;
+  pending_duration_ = frame.duration;
+  pending_target_ = target_time;
 }
 
 void VideoRendererCommon::SetPlayer(const MediaPlayer* player) {
@@ -123,5 +310,16 @@ bool VideoRendererCommon::SetVideoFillMode(VideoFillMode mode) {
   return true;
 }
 
+void VideoRendererCommon::GetMaxFrameSize(uint32_t* width,
+                                          uint32_t* height) const {
+  *width = max_frame_width_.load(std::memory_order_relaxed);
+  *height = max_frame_height_.load(std::memory_order_relaxed);
+}
+
+void VideoRendererCommon::SetMaxFrameSize(uint32_t width, uint32_t height) {
+  max_frame_width_.store(width, std::memory_order_relaxed);
+  max_frame_height_.store(height, std::memory_order_relaxed);
+}
+
 }  // namespace media
 }  // namespace shaka
@@ -18,6 +18,7 @@
 #include <atomic>
 #include <memory>
 
+#include "shaka/media/frame_snapshot.h"
 #include "shaka/media/media_player.h"
 #include "shaka/media/renderer.h"
 #include "src/debug/mutex.h"
@@ -28,6 +29,11 @@ namespace media {
 /**
  * Holds common code between our VideoRenderer types.  This handles selecting
  * the current frame, tracking frame counts, and changing fields.
+ *
+ * When the app reports when frames are shown (see OnFramePresented), this
+ * measures how long after selection a frame reaches the display and selects
+ * frames that far ahead of the clock, so the frame on screen matches the
+ * audio being heard.
  */
 class VideoRendererCommon : public VideoRenderer, MediaPlayer::Client {
  public:
@@ -43,6 +49,33 @@ class VideoRendererCommon : public VideoRenderer, MediaPlayer::Client {
    */
   double GetCurrentFrame(std::shared_ptr<DecodedFrame>* frame);
 
+  /**
+   * Gets the frame to show at the next vsync and updates frame statistics.
+   * This follows the cadence of the content relative to the display (e.g. 3:2
+   * pulldown of 24fps content at 60Hz), so each frame is shown for a steady
+   * number of vsyncs even if the clock jitters.  The cadence is only broken
+   * when it would drift more than a vsync from the clock.
+   *
+   * @param vsync_delay The time, in seconds, until the next vsync.
+   * @param refresh_interval The time, in seconds, between vsyncs.
+   * @param frame [OUT] Where to put the resulting frame.
+   */
+  void GetFrameForVsync(double vsync_delay, double refresh_interval,
+                        std::shared_ptr<DecodedFrame>* frame);
+
+  /**
+   * @return The frame after the one last returned from GetCurrentFrame, or
+   *   nullptr if it isn't known yet.
+   */
+  std::shared_ptr<DecodedFrame> GetNextFrame() const;
+
+  /**
+   * Converts the frame last returned from GetCurrentFrame to RGBA on a
+   * background thread.  This only holds a reference to the frame, so it
+   * doesn't block rendering or decoding.
+   */
+  void TakeSnapshot(SnapshotCallback callback) const;
+
 
   void SetPlayer(const MediaPlayer* player) override;
   void Attach(const DecodedStream* stream) override;
@@ -50,17 +83,44 @@ class VideoRendererCommon : public VideoRenderer, MediaPlayer::Client {
 
   struct VideoPlaybackQuality VideoPlaybackQuality() const override;
   bool SetVideoFillMode(VideoFillMode mode) override;
+  void GetMaxFrameSize(uint32_t* width, uint32_t* height) const override;
+  void OnFramePresented(double age) override;
+
+ protected:
+  /**
+   * Sets the size the video is drawn at, so the decoder can output smaller
+   * frames; 0x0 decodes frames at their full size.
+   */
+  void SetMaxFrameSize(uint32_t width, uint32_t height);
 
  private:
   void OnSeeking() override;
 
+  /**
+   * Called when a new frame is selected to remember when it should be shown,
+   * so it can be compared against when it is presented.
+   */
+  void OnFrameSelectedLocked(const DecodedFrame& frame, double target_time);
+
   mutable Mutex mutex_;
 
   const MediaPlayer* player_;
   const DecodedStream* input_;
   struct VideoPlaybackQuality quality_;
   std::atomic<VideoFillMode> fill_mode_;
+  std::atomic<uint32_t> max_frame_width_;
+  std::atomic<uint32_t> max_frame_height_;
   double prev_time_;
+  // The number of vsyncs the frame at |prev_time_| has been shown for.
+  uint32_t vsync_repeats_;
+
+  // The selected frame that hasn't been presented yet; |pending_target_| is
+  // the playback time it was selected for, or -1 if there isn't one.
+  double pending_pts_;
+  double pending_duration_;
+  double pending_target_;
+  // The number of presented frames the averages below are based on.
+  uint32_t presented_count_;
 };
 
 }  // namespace media
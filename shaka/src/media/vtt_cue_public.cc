@@ -15,6 +15,7 @@
 #include <cmath>
 
 #include "shaka/media/vtt_cue.h"
+#include "src/media/cue_index.h"
 
 namespace shaka {
 namespace media {
@@ -84,6 +85,7 @@ VTTCue& VTTCue::operator=(VTTCue&& cue) {
   align_ = cue.align_;
   pause_on_exit_ = cue.pause_on_exit_;
   snap_to_lines_ = cue.snap_to_lines_;
+  OnCueTimesChanged();
   return *this;
 }
 
@@ -105,6 +107,7 @@ double VTTCue::start_time() const {
 void VTTCue::SetStartTime(double time) {
   std::unique_lock<std::mutex> lock(mutex_);
   start_time_ = time;
+  OnCueTimesChanged();
 }
 
 double VTTCue::end_time() const {
@@ -115,6 +118,7 @@ double VTTCue::end_time() const {
 void VTTCue::SetEndTime(double time) {
   std::unique_lock<std::mutex> lock(mutex_);
   end_time_ = time;
+  OnCueTimesChanged();
 }
 
 bool VTTCue::pause_on_exit() const {
@@ -0,0 +1,316 @@
+// Copyright 2020 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     https://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "src/media/webvtt_parser.h"
+
+#include <glog/logging.h>
+#include <stdlib.h>
+
+#include <cstring>
+
+#include "src/util/utils.h"
+
+namespace shaka {
+namespace media {
+
+namespace {
+
+constexpr const char* kArrow = "-->";
+
+/** The timescale of the MPEG-2 TS times in X-TIMESTAMP-MAP. */
+constexpr const double kMpegTsTimescale = 90000;
+
+std::vector<std::string> SplitLines(const char* data, size_t size) {
+  std::vector<std::string> ret;
+  size_t start = 0;
+  for (size_t i = 0; i < size; i++) {
+    if (data[i] == '\r' || data[i] == '\n') {
+      ret.emplace_back(data + start, data + i);
+      if (data[i] == '\r' && i + 1 < size && data[i + 1] == '\n')
+        i++;
+      start = i + 1;
+    }
+  }
+  if (start < size)
+    ret.emplace_back(data + start, data + size);
+  return ret;
+}
+
+bool IsWhitespace(char c) {
+  return c == ' ' || c == '\t';
+}
+
+/** @return Whether |line| is |keyword| alone or followed by whitespace. */
+bool StartsWithKeyword(const std::string& line, const char* keyword) {
+  const size_t length = strlen(keyword);
+  return line.compare(0, length, keyword) == 0 &&
+         (line.size() == length || IsWhitespace(line[length]));
+}
+
+bool ParseDigits(const std::string& str, size_t min_length, uint64_t* value) {
+  if (str.size() < min_length)
+    return false;
+  *value = 0;
+  for (char c : str) {
+    if (c < '0' || c > '9')
+      return false;
+    *value = *value * 10 + (c - '0');
+  }
+  return true;
+}
+
+/** Parses a number, which must use the entire string. */
+bool ParseNumber(const std::string& str, double* value) {
+  if (str.empty())
+    return false;
+  char* end;
+  *value = strtod(str.c_str(), &end);
+  return *end == '\0';
+}
+
+/** Parses a percentage (e.g. "12.5%"), returning the number. */
+bool ParsePercentage(const std::string& str, double* value) {
+  return !str.empty() && str.back() == '%' &&
+         ParseNumber(str.substr(0, str.size() - 1), value) && *value >= 0 &&
+         *value <= 100;
+}
+
+/** Parses a WebVTT timestamp, which is "[hh:]mm:ss.ttt". */
+bool ParseTimestamp(const std::string& str, double* time) {
+  const std::vector<std::string> parts = util::StringSplit(str, ':');
+  if (parts.size() != 2 && parts.size() != 3)
+    return false;
+  const std::string& last = parts.back();
+  uint64_t hours = 0, minutes, seconds, millis;
+  if (last.size() != 6 || last[2] != '.' ||
+      !ParseDigits(last.substr(0, 2), 2, &seconds) ||
+      !ParseDigits(last.substr(3), 3, &millis) ||
+      !ParseDigits(parts[parts.size() - 2], 2, &minutes) ||
+      (parts.size() == 3 && !ParseDigits(parts[0], 2, &hours))) {
+    return false;
+  }
+  if (minutes >= 60 || seconds >= 60)
+    return false;
+
+  *time = hours * 3600 + minutes * 60 + seconds + millis / 1000.0;
+  return true;
+}
+
+/**
+ * Parses the X-TIMESTAMP-MAP header, which maps a local cue time to an MPEG-2
+ * TS time, and gets the offset to apply to the cues.
+ */
+bool ParseTimestampMap(const std::string& value, double* offset) {
+  uint64_t mpegts = 0;
+  double local = 0;
+  for (const std::string& part : util::StringSplit(value, ',')) {
+    if (part.compare(0, 7, "MPEGTS:") == 0) {
+      if (!ParseDigits(part.substr(7), 1, &mpegts))
+        return false;
+    } else if (part.compare(0, 6, "LOCAL:") == 0) {
+      if (!ParseTimestamp(part.substr(6), &local))
+        return false;
+    } else {
+      return false;
+    }
+  }
+  *offset = mpegts / kMpegTsTimescale - local;
+  return true;
+}
+
+void ParseSetting(const std::string& name, const std::string& value,
+                  VTTCue* cue) {
+  // Invalid settings are ignored.
+  double number;
+  if (name == "vertical") {
+    if (value == "rl")
+      cue->SetVertical(DirectionSetting::RightToLeft);
+    else if (value == "lr")
+      cue->SetVertical(DirectionSetting::LeftToRight);
+  } else if (name == "line") {
+    const size_t comma = value.find(',');
+    const std::string line = value.substr(0, comma);
+    if (ParsePercentage(line, &number)) {
+      cue->SetSnapToLines(false);
+      cue->SetLine(number);
+    } else if (ParseNumber(line, &number)) {
+      cue->SetSnapToLines(true);
+      cue->SetLine(number);
+    }
+
+    if (comma != std::string::npos) {
+      const std::string align = value.substr(comma + 1);
+      if (align == "start")
+        cue->SetLineAlign(LineAlignSetting::Start);
+      else if (align == "center")
+        cue->SetLineAlign(LineAlignSetting::Center);
+      else if (align == "end")
+        cue->SetLineAlign(LineAlignSetting::End);
+    }
+  } else if (name == "position") {
+    const size_t comma = value.find(',');
+    if (ParsePercentage(value.substr(0, comma), &number))
+      cue->SetPosition(number);
+
+    if (comma != std::string::npos) {
+      const std::string align = value.substr(comma + 1);
+      if (align == "line-left")
+        cue->SetPositionAlign(PositionAlignSetting::LineLeft);
+      else if (align == "center")
+        cue->SetPositionAlign(PositionAlignSetting::Center);
+      else if (align == "line-right")
+        cue->SetPositionAlign(PositionAlignSetting::LineRight);
+    }
+  } else if (name == "size") {
+    if (ParsePercentage(value, &number))
+      cue->SetSize(number);
+  } else if (name == "align") {
+    if (value == "start")
+      cue->SetAlign(AlignSetting::Start);
+    else if (value == "center")
+      cue->SetAlign(AlignSetting::Center);
+    else if (value == "end")
+      cue->SetAlign(AlignSetting::End);
+    else if (value == "left")
+      cue->SetAlign(AlignSetting::Left);
+    else if (value == "right")
+      cue->SetAlign(AlignSetting::Right);
+  }
+}
+
+/**
+ * Parses a cue timing line, which is "start --> end [settings]".
+ * @return The new cue, or nullptr if the line is invalid.
+ */
+std::shared_ptr<VTTCue> ParseTimingLine(const std::string& line,
+                                        double offset) {
+  const size_t arrow = line.find(kArrow);
+  DCHECK_NE(arrow, std::string::npos);
+
+  std::vector<std::string> tokens;
+  std::string token;
+  for (char c : line.substr(arrow + strlen(kArrow))) {
+    if (IsWhitespace(c)) {
+      if (!token.empty())
+        tokens.emplace_back(std::move(token));
+      token.clear();
+    } else {
+      token.push_back(c);
+    }
+  }
+  if (!token.empty())
+    tokens.emplace_back(std::move(token));
+
+  double start;
+  double end;
+  if (tokens.empty() ||
+      !ParseTimestamp(util::TrimAsciiWhitespace(line.substr(0, arrow)),
+                      &start) ||
+      !ParseTimestamp(tokens[0], &end)) {
+    return nullptr;
+  }
+
+  auto cue = std::make_shared<VTTCue>(start + offset, end + offset, "");
+  for (size_t i = 1; i < tokens.size(); i++) {
+    const size_t colon = tokens[i].find(':');
+    if (colon != std::string::npos && colon > 0) {
+      ParseSetting(tokens[i].substr(0, colon), tokens[i].substr(colon + 1),
+                   cue.get());
+    }
+  }
+  return cue;
+}
+
+}  // namespace
+
+bool ParseWebVtt(const uint8_t* data, size_t size, double offset,
+                 std::vector<std::shared_ptr<VTTCue>>* cues,
+                 std::string* error) {
+  const char* text = reinterpret_cast<const char*>(data);
+  if (size >= 3 && memcmp(text, "\xef\xbb\xbf", 3) == 0) {
+    text += 3;
+    size -= 3;
+  }
+  const std::vector<std::string> lines = SplitLines(text, size);
+  if (lines.empty() || !StartsWithKeyword(lines[0], "WEBVTT")) {
+    *error = "Missing WEBVTT header";
+    return false;
+  }
+
+  // The header continues until the first blank line.
+  size_t i = 1;
+  for (; i < lines.size() && !lines[i].empty(); i++) {
+    const char kTimestampMap[] = "X-TIMESTAMP-MAP=";
+    if (lines[i].compare(0, sizeof(kTimestampMap) - 1, kTimestampMap) == 0) {
+      double map_offset;
+      if (!ParseTimestampMap(lines[i].substr(sizeof(kTimestampMap) - 1),
+                             &map_offset)) {
+        *error = "Invalid X-TIMESTAMP-MAP header";
+        return false;
+      }
+      offset += map_offset;
+    }
+  }
+
+  while (i < lines.size()) {
+    if (lines[i].empty()) {
+      i++;
+      continue;
+    }
+
+    if (StartsWithKeyword(lines[i], "NOTE") ||
+        StartsWithKeyword(lines[i], "STYLE") ||
+        StartsWithKeyword(lines[i], "REGION")) {
+      while (i < lines.size() && !lines[i].empty())
+        i++;
+      continue;
+    }
+
+    // A cue starts with an optional ID line, followed by the timing line.
+    std::string id;
+    if (lines[i].find(kArrow) == std::string::npos) {
+      id = lines[i++];
+      if (i == lines.size() || lines[i].find(kArrow) == std::string::npos) {
+        // Not a cue, skip the block.
+        while (i < lines.size() && !lines[i].empty())
+          i++;
+        continue;
+      }
+    }
+    std::shared_ptr<VTTCue> cue = ParseTimingLine(lines[i++], offset);
+
+    // The cue text continues until a blank line or another timing line.
+    std::string payload;
+    for (; i < lines.size() && !lines[i].empty(); i++) {
+      if (lines[i].find(kArrow) != std::string::npos)
+        break;
+      if (!payload.empty())
+        payload.push_back('\n');
+      payload += lines[i];
+    }
+
+    if (cue) {
+      cue->SetId(id);
+      cue->SetText(payload);
+      cues->emplace_back(std::move(cue));
+    } else {
+      VLOG(1) << "Ignoring WebVTT cue with invalid timing";
+    }
+  }
+
+  return true;
+}
+
+}  // namespace media
+}  // namespace shaka
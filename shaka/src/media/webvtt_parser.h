@@ -0,0 +1,46 @@
+// Copyright 2020 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     https://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef SHAKA_EMBEDDED_MEDIA_WEBVTT_PARSER_H_
+#define SHAKA_EMBEDDED_MEDIA_WEBVTT_PARSER_H_
+
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "shaka/media/vtt_cue.h"
+
+namespace shaka {
+namespace media {
+
+/**
+ * Parses a WebVTT file (or a segment of one) into cues.  This supports the cue
+ * timings and settings and the HLS X-TIMESTAMP-MAP header; STYLE, REGION, and
+ * NOTE blocks are skipped, and the cue text is kept as-is, including any tags.
+ *
+ * @param data The WebVTT text, encoded in UTF-8.
+ * @param size The number of bytes in @a data.
+ * @param offset The time, in seconds, to add to every cue.
+ * @param cues [OUT] Will be filled with the parsed cues, in file order.
+ * @param error [OUT] Will be filled with a description of the error, if any.
+ * @return True on success, false if the file isn't valid WebVTT.
+ */
+bool ParseWebVtt(const uint8_t* data, size_t size, double offset,
+                 std::vector<std::shared_ptr<VTTCue>>* cues,
+                 std::string* error);
+
+}  // namespace media
+}  // namespace shaka
+
+#endif  // SHAKA_EMBEDDED_MEDIA_WEBVTT_PARSER_H_
@@ -0,0 +1,273 @@
+// Copyright 2020 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     https://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "src/media/worker_task.h"
+
+#include <glog/logging.h>
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <utility>
+
+#include "src/debug/telemetry.h"
+#include "src/util/utils.h"
+
+namespace shaka {
+namespace media {
+
+namespace {
+
+/** The run time of a task that is waiting to be woken. */
+constexpr const uint64_t kNever = std::numeric_limits<uint64_t>::max();
+
+/** @return The time, in milliseconds, to run a step after the given delay. */
+uint64_t GetRunTime(uint64_t now, double delay) {
+  if (delay <= 0)
+    return now;
+  if (std::isinf(delay) || delay * 1000 >= kNever - now)
+    return kNever;
+  return now + static_cast<uint64_t>(delay * 1000);
+}
+
+}  // namespace
+
+WorkerPool::WorkerPool(size_t thread_count) : impl_(new Impl(thread_count)) {}
+
+WorkerPool::~WorkerPool() {}
+
+size_t WorkerPool::thread_count() const {
+  return impl_->thread_count();
+}
+
+
+WorkerPool::Impl::Impl(size_t thread_count) : next_id_(0), shutdown_(false) {
+  if (thread_count == 0)
+    thread_count = std::max(std::thread::hardware_concurrency(), 1u);
+  for (size_t i = 0; i < thread_count; i++) {
+    threads_.emplace_back(
+        new Thread("Worker " + std::to_string(i),
+                   std::bind(&WorkerPool::Impl::ThreadMain, this),
+                   ThreadRole::Media));
+  }
+}
+
+WorkerPool::Impl::~Impl() {
+  {
+    std::unique_lock<std::mutex> lock(mutex_);
+    DCHECK(tasks_.empty()) << "Players must be destroyed before the WorkerPool";
+    shutdown_ = true;
+    cond_.notify_all();
+  }
+  for (auto& thread : threads_)
+    thread->join();
+}
+
+uint64_t WorkerPool::Impl::AddTask(std::function<double()> step) {
+  std::unique_lock<std::mutex> lock(mutex_);
+  const uint64_t id = next_id_++;
+  Task& task = tasks_[id];
+  task.step = std::move(step);
+  task.priority = 0;
+  task.run_at = util::Clock::Instance.GetMonotonicTime();
+  task.woken_at = 0;
+  task.running = false;
+  task.woken = false;
+  task.stopped = false;
+  cond_.notify_one();
+  return id;
+}
+
+void WorkerPool::Impl::Wake(uint64_t id) {
+  std::unique_lock<std::mutex> lock(mutex_);
+  auto it = tasks_.find(id);
+  if (it == tasks_.end() || it->second.stopped)
+    return;
+
+  if (!it->second.woken_at)
+    it->second.woken_at = DurationHistogram::Now();
+  if (it->second.running) {
+    it->second.woken = true;
+  } else {
+    it->second.run_at = util::Clock::Instance.GetMonotonicTime();
+    cond_.notify_one();
+  }
+}
+
+void WorkerPool::Impl::SetPriority(uint64_t id, int priority) {
+  std::unique_lock<std::mutex> lock(mutex_);
+  auto it = tasks_.find(id);
+  if (it != tasks_.end())
+    it->second.priority = priority;
+}
+
+void WorkerPool::Impl::RemoveTask(uint64_t id) {
+  std::unique_lock<std::mutex> lock(mutex_);
+  auto it = tasks_.find(id);
+  if (it == tasks_.end())
+    return;
+
+  DCHECK(it->second.running_on != std::this_thread::get_id())
+      << "Cannot remove a task from its own step";
+  it->second.stopped = true;
+  while (it->second.running)
+    task_done_.wait(lock);
+  tasks_.erase(it);
+}
+
+void WorkerPool::Impl::ThreadMain() {
+  std::unique_lock<std::mutex> lock(mutex_);
+  while (!shutdown_) {
+    double wait;
+    Task* task = NextTask(util::Clock::Instance.GetMonotonicTime(), &wait);
+    if (!task) {
+      util::Clock::Instance.WaitForSignal(&cond_, &lock, wait);
+      Telemetry::OnWakeup();
+      continue;
+    }
+
+    // Another task may also be ready; let an idle thread check for it.
+    cond_.notify_one();
+
+    if (task->woken_at) {
+      Telemetry::OnQueueLatency(DurationHistogram::Now() - task->woken_at);
+      task->woken_at = 0;
+    }
+    task->running = true;
+    task->running_on = std::this_thread::get_id();
+    task->woken = false;
+    double delay;
+    {
+      util::Unlocker<std::mutex> unlock(&lock);
+      delay = task->step();
+    }
+    task->running = false;
+    task->running_on = std::thread::id();
+
+    // |task| is still valid since RemoveTask waits for the step to finish.
+    if (delay < 0)
+      task->stopped = true;
+    if (task->woken)
+      delay = 0;
+    task->run_at =
+        task->stopped
+            ? kNever
+            : GetRunTime(util::Clock::Instance.GetMonotonicTime(), delay);
+    task_done_.notify_all();
+  }
+}
+
+WorkerPool::Impl::Task* WorkerPool::Impl::NextTask(uint64_t now,
+                                                   double* wait) {
+  // There are only a few tasks per player, so a linear search is cheap enough.
+  Task* ret = nullptr;
+  uint64_t next_run_at = kNever;
+  for (auto& pair : tasks_) {
+    Task& task = pair.second;
+    if (task.running || task.stopped)
+      continue;
+
+    if (task.run_at > now) {
+      next_run_at = std::min(next_run_at, task.run_at);
+    } else if (!ret || task.priority > ret->priority ||
+               (task.priority == ret->priority && task.run_at < ret->run_at)) {
+      ret = &task;
+    }
+  }
+
+  *wait = next_run_at == kNever ? HUGE_VAL : (next_run_at - now) / 1000.0;
+  return ret;
+}
+
+
+WorkerTask::WorkerTask(const std::string& name, WorkerPool* pool,
+                       const util::Clock* clock, std::function<double()> step,
+                       ThreadRole role)
+    : pool_(pool ? pool->impl_.get() : nullptr),
+      clock_(clock),
+      step_(std::move(step)),
+      pool_id_(0),
+      woken_at_(0),
+      woken_(false),
+      stopped_(false) {
+  if (pool_) {
+    pool_id_ = pool_->AddTask(step_);
+  } else {
+    thread_.reset(
+        new Thread(name, std::bind(&WorkerTask::ThreadMain, this), role));
+  }
+}
+
+WorkerTask::~WorkerTask() {
+  Stop();
+}
+
+void WorkerTask::Wake() {
+  if (pool_) {
+    pool_->Wake(pool_id_);
+  } else {
+    std::unique_lock<std::mutex> lock(mutex_);
+    if (!woken_at_)
+      woken_at_ = DurationHistogram::Now();
+    woken_ = true;
+    cond_.notify_all();
+  }
+}
+
+void WorkerTask::SetPriority(int priority) {
+  if (pool_)
+    pool_->SetPriority(pool_id_, priority);
+}
+
+void WorkerTask::Stop() {
+  if (pool_) {
+    pool_->RemoveTask(pool_id_);
+    return;
+  }
+
+  {
+    std::unique_lock<std::mutex> lock(mutex_);
+    stopped_ = true;
+    cond_.notify_all();
+  }
+  if (thread_->joinable())
+    thread_->join();
+}
+
+void WorkerTask::ThreadMain() {
+  std::unique_lock<std::mutex> lock(mutex_);
+  while (!stopped_) {
+    if (woken_at_) {
+      Telemetry::OnQueueLatency(DurationHistogram::Now() - woken_at_);
+      woken_at_ = 0;
+    }
+    // Any Wake() calls after this will be seen by the step or will run it
+    // again.
+    woken_ = false;
+    double delay;
+    {
+      util::Unlocker<std::mutex> unlock(&lock);
+      delay = step_();
+    }
+    if (delay < 0)
+      break;
+    if (!woken_ && !stopped_ && delay > 0) {
+      clock_->WaitForSignal(&cond_, &lock, delay);
+      Telemetry::OnWakeup();
+    }
+  }
+}
+
+}  // namespace media
+}  // namespace shaka
@@ -0,0 +1,164 @@
+// Copyright 2020 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     https://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef SHAKA_EMBEDDED_MEDIA_WORKER_TASK_H_
+#define SHAKA_EMBEDDED_MEDIA_WORKER_TASK_H_
+
+#include <math.h>
+
+#include <condition_variable>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+#include "shaka/media/worker_pool.h"
+#include "src/debug/thread.h"
+#include "src/util/clock.h"
+#include "src/util/macros.h"
+
+namespace shaka {
+namespace media {
+
+/**
+ * Runs a step function repeatedly in the background, either on its own thread
+ * or on a shared WorkerPool.  The step returns how long to wait before it is
+ * run again; the wait ends early when Wake() is called.  The step is never run
+ * on two threads at once.
+ */
+class WorkerTask {
+ public:
+  /** Returned from the step to wait until Wake() is called. */
+  static constexpr const double kWaitForWake = HUGE_VAL;
+  /** Returned from the step to stop running it. */
+  static constexpr const double kStop = -1;
+
+  /**
+   * Creates a new task and starts running the step.
+   *
+   * @param name The name of the task, used to name the thread.
+   * @param pool The pool to run on, or nullptr to use a new thread.
+   * @param clock The clock used to wait between steps on a new thread.  The
+   *   pool always uses the real clock.
+   * @param step The function to run.  This returns the number of seconds to
+   *   wait before running it again, or one of the constants above.
+   * @param role The role of the new thread; this isn't used with a pool.
+   */
+  WorkerTask(const std::string& name, WorkerPool* pool,
+             const util::Clock* clock, std::function<double()> step,
+             ThreadRole role = ThreadRole::Media);
+  ~WorkerTask();
+
+  SHAKA_NON_COPYABLE_OR_MOVABLE_TYPE(WorkerTask);
+
+  /**
+   * Runs the step again as soon as possible.  If the step is currently running,
+   * it is run again once it finishes, even if it said to wait.
+   */
+  void Wake();
+
+  /**
+   * Sets the priority of the task.  When running on a pool, ready tasks with a
+   * higher priority run first.  This is ignored when using a new thread.
+   */
+  void SetPriority(int priority);
+
+  /**
+   * Stops running the step and waits for the current run to finish.  This must
+   * not be called from the step.
+   */
+  void Stop();
+
+ private:
+  void ThreadMain();
+
+  WorkerPool::Impl* const pool_;
+  const util::Clock* const clock_;
+  const std::function<double()> step_;
+  uint64_t pool_id_;
+
+  std::mutex mutex_;
+  std::condition_variable cond_;
+  // The time, in microseconds, of the first Wake() since the step last ran.
+  uint64_t woken_at_;
+  bool woken_;
+  bool stopped_;
+
+  // Should be last so the thread starts after all the fields are initialized.
+  std::unique_ptr<Thread> thread_;
+};
+
+/**
+ * The shared state of a WorkerPool.  The threads pick the ready task with the
+ * highest priority, so a slow task only delays other tasks when every thread
+ * is busy.
+ */
+class WorkerPool::Impl {
+ public:
+  explicit Impl(size_t thread_count);
+  ~Impl();
+
+  SHAKA_NON_COPYABLE_OR_MOVABLE_TYPE(Impl);
+
+  size_t thread_count() const {
+    return threads_.size();
+  }
+
+  /** Adds a task that runs the given step, and returns its ID. */
+  uint64_t AddTask(std::function<double()> step);
+  void Wake(uint64_t id);
+  void SetPriority(uint64_t id, int priority);
+  /** Removes the task, waiting for it to finish if it is running. */
+  void RemoveTask(uint64_t id);
+
+ private:
+  struct Task {
+    std::function<double()> step;
+    int priority;
+    // The monotonic time, in milliseconds, the task should run next.
+    uint64_t run_at;
+    // The time, in microseconds, the task was woken, or 0 if it wasn't.
+    uint64_t woken_at;
+    std::thread::id running_on;
+    bool running;
+    bool woken;
+    bool stopped;
+  };
+
+  void ThreadMain();
+  /**
+   * Finds the ready task with the highest priority.  If no task is ready, this
+   * returns nullptr and sets |*wait| to the seconds until the next one is.
+   */
+  Task* NextTask(uint64_t now, double* wait);
+
+  std::mutex mutex_;
+  // Signalled when a task becomes ready or the pool is shutting down.
+  std::condition_variable cond_;
+  // Signalled when a task finishes running.
+  std::condition_variable task_done_;
+  std::unordered_map<uint64_t, Task> tasks_;
+  uint64_t next_id_;
+  bool shutdown_;
+
+  std::vector<std::unique_ptr<Thread>> threads_;
+};
+
+}  // namespace media
+}  // namespace shaka
+
+#endif  // SHAKA_EMBEDDED_MEDIA_WORKER_TASK_H_
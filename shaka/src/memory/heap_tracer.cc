@@ -14,9 +14,12 @@
 
 #include "src/memory/heap_tracer.h"
 
+#include <algorithm>
+#include <limits>
 #include <utility>
 
 #include "src/core/js_manager_impl.h"
+#include "src/debug/duration_histogram.h"
 #include "src/mapping/backing_object.h"
 #include "src/memory/object_tracker.h"
 #include "src/util/utils.h"
@@ -30,6 +33,12 @@ bool Traceable::IsRootedAlive() const {
 bool Traceable::IsShortLived() const {
   return false;
 }
+std::string Traceable::TraceTypeName() const {
+  return "(other)";
+}
+size_t Traceable::TraceSize() const {
+  return 0;
+}
 
 
 HeapTracer::HeapTracer() : mutex_("HeapTracer") {}
@@ -51,36 +60,65 @@ void HeapTracer::BeginPass() {
 
 void HeapTracer::TraceAll(
     const std::unordered_set<const Traceable*>& ref_alive) {
-  {
-    std::unique_lock<Mutex> lock(mutex_);
-    pending_.insert(ref_alive.begin(), ref_alive.end());
+  AddRoots(ref_alive);
+  while (TraceStep(std::numeric_limits<size_t>::max())) {
   }
+}
+
+void HeapTracer::AddRoots(const std::unordered_set<const Traceable*>& roots) {
+  std::unique_lock<Mutex> lock(mutex_);
+  pending_.insert(roots.begin(), roots.end());
+}
 
-  while (true) {
-    std::unordered_set<const Traceable*> to_trace;
-
-    {
-      std::unique_lock<Mutex> lock(mutex_);
-      to_trace = std::move(pending_);
-
-      // We need to be careful about circular dependencies.  Only traverse if we
-      // have not seen it before.
-      for (auto it = to_trace.begin(); it != to_trace.end();) {
-        if (*it && alive_.count(*it) == 0) {
-          alive_.insert(*it);
-          ++it;
-        } else {
-          it = to_trace.erase(it);
-        }
-      }
+bool HeapTracer::TraceStep(size_t max_count) {
+  std::vector<const Traceable*> to_trace;
+  {
+    std::unique_lock<Mutex> lock(mutex_);
+    // We need to be careful about circular dependencies.  Only traverse if we
+    // have not seen it before.
+    auto it = pending_.begin();
+    while (it != pending_.end() && to_trace.size() < max_count) {
+      if (*it && alive_.insert(*it).second)
+        to_trace.push_back(*it);
+      it = pending_.erase(it);
     }
+  }
 
-    if (to_trace.empty())
-      break;
+  // Don't hold the lock since Trace() will add pending objects.
+  if (!profiling_.load(std::memory_order_relaxed)) {
     for (const Traceable* ptr : to_trace) {
       ptr->Trace(this);
     }
+    return HasPendingObjects();
+  }
+
+  // Trace() only adds the children as pending, so each time is just for that
+  // object.  Collect the times locally so the lock is only taken once.
+  std::unordered_map<std::string, ProfileEntry> times;
+  for (const Traceable* ptr : to_trace) {
+    const uint64_t start = DurationHistogram::Now();
+    ptr->Trace(this);
+    const uint64_t duration = DurationHistogram::Now() - start;
+    ProfileEntry& entry = times[ptr->TraceTypeName()];
+    entry.count++;
+    entry.total_us += duration;
+    entry.max_us = std::max(entry.max_us, duration);
+  }
+  {
+    std::unique_lock<std::mutex> lock(profile_mutex_);
+    for (auto& pair : times) {
+      ProfileEntry& entry = profile_[pair.first];
+      entry.count += pair.second.count;
+      entry.total_us += pair.second.total_us;
+      entry.max_us = std::max(entry.max_us, pair.second.max_us);
+    }
   }
+  return HasPendingObjects();
+}
+
+bool HeapTracer::HasPendingObjects() const {
+  std::unique_lock<Mutex> lock(mutex_);
+  return !pending_.empty();
 }
 
 void HeapTracer::ResetState() {
@@ -90,5 +128,43 @@ void HeapTracer::ResetState() {
   pending_.clear();
 }
 
+void HeapTracer::SetProfilingEnabled(bool enabled) {
+  profiling_.store(enabled, std::memory_order_relaxed);
+}
+
+std::string HeapTracer::DumpProfile() const {
+  std::vector<std::pair<std::string, ProfileEntry>> sorted;
+  {
+    std::unique_lock<std::mutex> lock(profile_mutex_);
+    sorted.assign(profile_.begin(), profile_.end());
+  }
+  // Show the types with the most time spent tracing first.
+  std::sort(sorted.begin(), sorted.end(),
+            [](const std::pair<std::string, ProfileEntry>& a,
+               const std::pair<std::string, ProfileEntry>& b) {
+              return a.second.total_us > b.second.total_us;
+            });
+
+  std::string ret = util::StringPrintf("%-30s %10s %10s %10s %10s\n", "Type",
+                                       "Traces", "Total(us)", "Avg(us)",
+                                       "Max(us)");
+  for (const auto& pair : sorted) {
+    const ProfileEntry& entry = pair.second;
+    const uint64_t avg_us = entry.total_us / entry.count;
+    ret += util::StringPrintf(
+        "%-30s %10llu %10llu %10llu %10llu\n", pair.first.c_str(),
+        static_cast<unsigned long long>(entry.count),  // NOLINT
+        static_cast<unsigned long long>(entry.total_us),  // NOLINT
+        static_cast<unsigned long long>(avg_us),  // NOLINT
+        static_cast<unsigned long long>(entry.max_us));  // NOLINT
+  }
+  return ret;
+}
+
+void HeapTracer::ResetProfile() {
+  std::unique_lock<std::mutex> lock(profile_mutex_);
+  profile_.clear();
+}
+
 }  // namespace memory
 }  // namespace shaka
@@ -17,11 +17,14 @@
 
 #include <glog/logging.h>
 
+#include <atomic>
 #include <list>
+#include <mutex>
 #include <string>
 #include <type_traits>
 #include <unordered_map>
 #include <unordered_set>
+#include <utility>
 #include <vector>
 
 #include "shaka/optional.h"
@@ -34,6 +37,7 @@ class BackingObject;
 
 namespace memory {
 class HeapTracer;
+class ObjectTracker;
 
 /**
  * Defines an object that can be traced by the HeapTracer.  Any object that
@@ -48,9 +52,15 @@ class Traceable {
    */
   static constexpr const uint64_t kShortLiveDurationMs = 5000;
 
-
+  Traceable() {}
+  // The ref count belongs to the object, so copies start without references.
+  Traceable(const Traceable&) {}
   virtual ~Traceable() {}
 
+  Traceable& operator=(const Traceable&) {
+    return *this;
+  }
+
   /**
    * Called during a GC run.  This should call HeapTracer::Trace on all
    * Traceable members.  Be sure to call the base method when overriding.
@@ -75,6 +85,52 @@ class Traceable {
    * thrown.
    */
   virtual bool IsShortLived() const;
+
+  /** @return The name of the type, used when profiling GC tracing. */
+  virtual std::string TraceTypeName() const;
+
+  /**
+   * @return The size of the object, in bytes, used for memory reports.  This
+   *   doesn't include memory the object points to.
+   */
+  virtual size_t TraceSize() const;
+
+ private:
+  friend class ObjectTracker;
+
+  // The number of C++ references (e.g. RefPtr) to this object.  This is
+  // managed by the ObjectTracker.
+  mutable std::atomic<uint32_t> ref_count_{0};
+};
+
+
+/**
+ * Gets whether values of the given type can hold Traceable objects.  This is
+ * used to skip iterating containers of plain values (e.g. strings or numbers)
+ * when tracing, since tracing their elements does nothing.
+ */
+template <typename T>
+struct is_traceable
+    : std::is_base_of<Traceable, typename std::remove_cv<T>::type> {};
+template <typename T>
+struct is_traceable<std::vector<T>> : is_traceable<T> {};
+template <typename T>
+struct is_traceable<std::list<T>> : is_traceable<T> {};
+template <typename T>
+struct is_traceable<optional<T>> : is_traceable<T> {};
+template <typename First, typename Second>
+struct is_traceable<std::pair<First, Second>>
+    : std::integral_constant<bool, is_traceable<First>::value ||
+                                       is_traceable<Second>::value> {};
+template <typename Key, typename Value>
+struct is_traceable<std::unordered_map<Key, Value>>
+    : is_traceable<std::pair<Key, Value>> {};
+template <>
+struct is_traceable<variant<>> : std::false_type {};
+template <typename First, typename... Rest>
+struct is_traceable<variant<First, Rest...>>
+    : std::integral_constant<bool, is_traceable<First>::value ||
+                                       is_traceable<variant<Rest...>>::value> {
 };
 
 
@@ -105,24 +161,24 @@ class HeapTracer {
    */
   void Trace(const Traceable* ptr);
 
+  // Containers are only iterated if their elements can hold Traceable
+  // objects; this is decided at compile time.
   template <typename T>
   void Trace(const std::vector<T>* array) {
-    for (const T& item : *array) {
-      Trace(&item);
-    }
+    TraceElements(array, is_traceable<T>());
   }
   template <typename T>
   void Trace(const std::list<T>* array) {
-    for (const T& item : *array) {
-      Trace(&item);
-    }
+    TraceElements(array, is_traceable<T>());
   }
   template <typename Key, typename Value>
   void Trace(const std::unordered_map<Key, Value>* map) {
-    for (const auto& pair : *map) {
-      Trace(&pair.first);
-      Trace(&pair.second);
-    }
+    TraceElements(map, is_traceable<std::pair<Key, Value>>());
+  }
+  template <typename First, typename Second>
+  void Trace(const std::pair<First, Second>* pair) {
+    Trace(&pair->first);
+    Trace(&pair->second);
   }
   template <typename T>
   void Trace(const optional<T>* opt) {
@@ -149,14 +205,62 @@ class HeapTracer {
 
   /**
    * Traces the given objects, including all pending objects and all recursive
-   * children.  This MUST be called at least once each GC pass.
+   * children.  This MUST be called at least once each GC pass, unless the
+   * objects are traced using AddRoots and TraceStep.
    */
   void TraceAll(const std::unordered_set<const Traceable*>& ref_alive);
 
+  /** Adds the given objects to be traced by TraceStep. */
+  void AddRoots(const std::unordered_set<const Traceable*>& roots);
+
+  /**
+   * Traces some of the pending objects.  Children of the traced objects are
+   * added as pending objects, so this needs to be called until it returns
+   * false.  This allows the GC pass to be split into steps with other work
+   * (e.g. JavaScript) running between them.
+   *
+   * @param max_count The maximum number of objects to trace.
+   * @return True if there are still pending objects to trace.
+   */
+  bool TraceStep(size_t max_count);
+
+  /** @return Whether there are pending objects that haven't been traced. */
+  bool HasPendingObjects() const;
+
   /** Resets the stored state. */
   void ResetState();
 
+  /**
+   * Sets whether to record the time spent tracing each type of object.  This
+   * is disabled by default since it adds a clock read for every object traced.
+   */
+  void SetProfilingEnabled(bool enabled);
+
+  /**
+   * @return A human-readable table of the time spent tracing each type of
+   *   object, sorted by the total time.
+   */
+  std::string DumpProfile() const;
+
+  /** Clears the recorded tracing times. */
+  void ResetProfile();
+
  private:
+  struct ProfileEntry {
+    uint64_t count = 0;
+    uint64_t total_us = 0;
+    uint64_t max_us = 0;
+  };
+
+  template <typename Container>
+  void TraceElements(const Container*, std::false_type) {}
+  template <typename Container>
+  void TraceElements(const Container* container, std::true_type) {
+    for (const auto& item : *container) {
+      Trace(&item);
+    }
+  }
+
   template <size_t I, typename... Types>
   struct VariantHelper {
     static void Trace(HeapTracer* tracer, const variant<Types...>* variant) {
@@ -174,9 +278,13 @@ class HeapTracer {
     }
   };
 
-  Mutex mutex_;
+  mutable Mutex mutex_;
   std::unordered_set<const Traceable*> alive_;
   std::unordered_set<const Traceable*> pending_;
+
+  std::atomic<bool> profiling_{false};
+  mutable std::mutex profile_mutex_;
+  std::unordered_map<std::string, ProfileEntry> profile_;
 };
 
 }  // namespace memory
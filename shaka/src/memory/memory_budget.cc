@@ -0,0 +1,153 @@
+// Copyright 2020 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     https://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "src/memory/memory_budget.h"
+
+#include <glog/logging.h>
+
+#include <algorithm>
+#include <utility>
+#include <vector>
+
+#include "shaka/media/media_allocator.h"
+
+namespace shaka {
+namespace memory {
+
+namespace {
+
+/** @return The bytes held by downloads in progress. */
+uint64_t GetNetworkUsage() {
+  using media::MediaAllocationCategory;
+  return media::MediaAllocator::GetStats(MediaAllocationCategory::Network)
+      .current_bytes;
+}
+
+}  // namespace
+
+MemoryBudget::Consumer::Consumer(MemorySubsystem subsystem,
+                                 const std::string& name,
+                                 GetUsageCallback get_usage,
+                                 EvictCallback evict)
+    : subsystem_(subsystem),
+      name_(name),
+      get_usage_(std::move(get_usage)),
+      evict_(std::move(evict)) {
+  DCHECK(subsystem_ != MemorySubsystem::Network)
+      << "Network usage comes from the MediaAllocator";
+  MemoryBudget::Instance()->AddConsumer(this);
+}
+
+MemoryBudget::Consumer::~Consumer() {
+  MemoryBudget::Instance()->RemoveConsumer(this);
+}
+
+
+MemoryBudget::MemoryBudget()
+    : mutex_("MemoryBudget"), budget_(0), evicted_bytes_(0) {}
+
+MemoryBudget::~MemoryBudget() {
+  DCHECK(consumers_.empty());
+}
+
+// static
+MemoryBudget* MemoryBudget::Instance() {
+  static MemoryBudget instance;
+  return &instance;
+}
+
+void MemoryBudget::SetBudget(uint64_t bytes) {
+  {
+    std::unique_lock<Mutex> lock(mutex_);
+    budget_ = bytes;
+  }
+  Enforce(0);
+}
+
+MemoryBudget::Usage MemoryBudget::GetUsage() const {
+  std::unique_lock<Mutex> lock(mutex_);
+  Usage ret;
+  ret.budget = budget_;
+  ret.evicted_bytes = evicted_bytes_;
+  ret.consumers.reserve(consumers_.size());
+  for (Consumer* consumer : consumers_) {
+    const uint64_t bytes = consumer->get_usage_();
+    ret.bytes[static_cast<size_t>(consumer->subsystem_)] += bytes;
+    ret.consumers.push_back({consumer->subsystem_, consumer->name_, bytes});
+  }
+  ret.bytes[static_cast<size_t>(MemorySubsystem::Network)] = GetNetworkUsage();
+  for (uint64_t bytes : ret.bytes)
+    ret.total_bytes += bytes;
+  return ret;
+}
+
+bool MemoryBudget::Fits(size_t extra_bytes) const {
+  std::unique_lock<Mutex> lock(mutex_);
+  return budget_ == 0 || TotalUsageLocked() + extra_bytes <= budget_;
+}
+
+bool MemoryBudget::Enforce(size_t extra_bytes) {
+  std::unique_lock<Mutex> lock(mutex_);
+  if (budget_ == 0)
+    return true;
+  uint64_t total = TotalUsageLocked();
+  if (total + extra_bytes <= budget_)
+    return true;
+
+  // Sort so we evict by subsystem, but keep the registration order within a
+  // subsystem so older consumers are evicted first.
+  std::vector<Consumer*> order(consumers_.begin(), consumers_.end());
+  std::stable_sort(order.begin(), order.end(),
+                   [](const Consumer* a, const Consumer* b) {
+                     return a->subsystem_ < b->subsystem_;
+                   });
+  for (Consumer* consumer : order) {
+    if (total + extra_bytes <= budget_)
+      break;
+    if (!consumer->evict_)
+      continue;
+
+    const size_t freed = consumer->evict_(total + extra_bytes - budget_);
+    total -= std::min<uint64_t>(total, freed);
+    evicted_bytes_ += freed;
+  }
+
+  if (total + extra_bytes > budget_) {
+    VLOG(1) << "Unable to fit " << extra_bytes
+            << " bytes in the memory budget; " << total << " of " << budget_
+            << " bytes used";
+    return false;
+  }
+  return true;
+}
+
+void MemoryBudget::AddConsumer(Consumer* consumer) {
+  std::unique_lock<Mutex> lock(mutex_);
+  consumers_.push_back(consumer);
+}
+
+void MemoryBudget::RemoveConsumer(Consumer* consumer) {
+  std::unique_lock<Mutex> lock(mutex_);
+  consumers_.remove(consumer);
+}
+
+uint64_t MemoryBudget::TotalUsageLocked() const {
+  uint64_t ret = GetNetworkUsage();
+  for (Consumer* consumer : consumers_)
+    ret += consumer->get_usage_();
+  return ret;
+}
+
+}  // namespace memory
+}  // namespace shaka
@@ -0,0 +1,171 @@
+// Copyright 2020 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     https://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef SHAKA_EMBEDDED_MEMORY_MEMORY_BUDGET_H_
+#define SHAKA_EMBEDDED_MEMORY_MEMORY_BUDGET_H_
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <functional>
+#include <list>
+#include <string>
+#include <vector>
+
+#include "src/debug/mutex.h"
+#include "src/util/macros.h"
+
+namespace shaka {
+namespace memory {
+
+/**
+ * The parts of the library that hold large amounts of memory.  These are
+ * listed in the order they are evicted when over budget; the ones that are
+ * cheapest to get back come first.
+ */
+enum class MemorySubsystem : uint8_t {
+  /** Responses in the native segment cache. */
+  SegmentCache,
+  /** Unused decoder frame buffers. */
+  FramePool,
+  /** Decoded frames waiting to be rendered. */
+  DecodedFrames,
+  /** Demuxed frames in the MSE SourceBuffers. */
+  EncodedFrames,
+  /** Downloads in progress. */
+  Network,
+};
+
+constexpr const size_t kMemorySubsystemCount =
+    static_cast<size_t>(MemorySubsystem::Network) + 1;
+
+/**
+ * Tracks the memory used by the media caches of every player and keeps them
+ * within a single process-wide budget.  Each cache registers a Consumer that
+ * reports how much it holds and, if possible, can free some of it.  When an
+ * allocation wouldn't fit, consumers are asked to evict in MemorySubsystem
+ * order until it does.  Consumers that can't evict (e.g. frames that haven't
+ * been played yet) are only counted; their owners should check Fits() before
+ * growing.
+ *
+ * The callbacks are called with an internal lock held, so they must not call
+ * back into this type.
+ *
+ * This type is thread-safe.
+ */
+class MemoryBudget final {
+ public:
+  /** The memory used by a single Consumer. */
+  struct ConsumerUsage {
+    MemorySubsystem subsystem;
+    std::string name;
+    uint64_t bytes;
+  };
+
+  /** The current memory usage. */
+  struct Usage {
+    /** The budget, or 0 if there is no limit. */
+    uint64_t budget = 0;
+    /** The total bytes used by every subsystem. */
+    uint64_t total_bytes = 0;
+    /** The bytes used by each subsystem, indexed by MemorySubsystem. */
+    uint64_t bytes[kMemorySubsystemCount] = {};
+    /** The total number of bytes that were evicted to fit in the budget. */
+    uint64_t evicted_bytes = 0;
+    /** The usage of each Consumer, in the order they were registered. */
+    std::vector<ConsumerUsage> consumers;
+  };
+
+  /**
+   * Registers a memory consumer for the lifetime of this object.  This should
+   * be the last member of its owner so it is unregistered before the state the
+   * callbacks use is destroyed.
+   */
+  class Consumer final {
+   public:
+    /** @return The number of bytes currently held. */
+    using GetUsageCallback = std::function<size_t()>;
+    /**
+     * Tries to free at least the given number of bytes.
+     * @return The number of bytes that were freed.
+     */
+    using EvictCallback = std::function<size_t(size_t)>;
+
+    /**
+     * @param subsystem The subsystem the memory counts against.
+     * @param name A name for this consumer, used in memory reports.
+     * @param get_usage Called to get the current usage.
+     * @param evict Called to free memory, or nullptr if this can't evict.
+     */
+    Consumer(MemorySubsystem subsystem, const std::string& name,
+             GetUsageCallback get_usage, EvictCallback evict = nullptr);
+    ~Consumer();
+
+    SHAKA_NON_COPYABLE_OR_MOVABLE_TYPE(Consumer);
+
+   private:
+    friend class MemoryBudget;
+
+    const MemorySubsystem subsystem_;
+    const std::string name_;
+    const GetUsageCallback get_usage_;
+    const EvictCallback evict_;
+  };
+
+  MemoryBudget();
+  ~MemoryBudget();
+
+  SHAKA_NON_COPYABLE_OR_MOVABLE_TYPE(MemoryBudget);
+
+  /** @return The process-wide instance. */
+  static MemoryBudget* Instance();
+
+  /**
+   * Sets the maximum number of bytes the consumers can hold; 0 means no limit.
+   * This evicts what it can if the consumers are over the new budget.
+   */
+  void SetBudget(uint64_t bytes);
+
+  /** @return The current usage of every subsystem. */
+  Usage GetUsage() const;
+
+  /** @return Whether |extra_bytes| more can be held without going over. */
+  bool Fits(size_t extra_bytes) const;
+
+  /**
+   * Evicts from the consumers, in MemorySubsystem order, until |extra_bytes|
+   * more fit in the budget.  This must not be called with any lock held that
+   * an EvictCallback uses.
+   *
+   * @return Whether |extra_bytes| now fit.
+   */
+  bool Enforce(size_t extra_bytes);
+
+ private:
+  void AddConsumer(Consumer* consumer);
+  void RemoveConsumer(Consumer* consumer);
+
+  /** @return The total usage; |mutex_| must be held. */
+  uint64_t TotalUsageLocked() const;
+
+  mutable Mutex mutex_;
+  std::list<Consumer*> consumers_;
+  uint64_t budget_;
+  uint64_t evicted_bytes_;
+};
+
+}  // namespace memory
+}  // namespace shaka
+
+#endif  // SHAKA_EMBEDDED_MEMORY_MEMORY_BUDGET_H_
@@ -14,6 +14,11 @@
 
 #include "src/memory/object_tracker.h"
 
+#include <algorithm>
+#include <typeindex>
+#include <typeinfo>
+#include <utility>
+
 #include "src/mapping/backing_object.h"
 #include "src/memory/heap_tracer.h"
 #include "src/util/clock.h"
@@ -22,55 +27,139 @@
 namespace shaka {
 namespace memory {
 
+namespace {
+
+/** Used to spread the threads across the shards. */
+std::atomic<size_t> g_next_shard{0};
+
+}  // namespace
+
+ObjectTracker::Shard::Shard() : mutex("ObjectTracker shard") {}
+
+ObjectTracker::Shard::~Shard() {}
+
 void ObjectTracker::RegisterObject(Traceable* object) {
-  std::unique_lock<Mutex> lock(mutex_);
-  DCHECK(objects_.count(object) == 0 || to_delete_.count(object) == 1);
-  objects_.emplace(object, 0u);
-  to_delete_.erase(object);
+  thread_local const size_t shard_index =
+      g_next_shard.fetch_add(1, std::memory_order_relaxed) % kShardCount;
+
+  PendingObject pending{object, object->IsShortLived(), 0};
+  if (pending.is_short_lived)
+    pending.register_time = util::Clock::Instance.GetMonotonicTime();
 
-  if (object->IsShortLived())
-    last_alive_time_.emplace(object, util::Clock::Instance.GetMonotonicTime());
+  Shard& shard = shards_[shard_index];
+  std::unique_lock<Mutex> lock(shard.mutex);
+  shard.objects.push_back(pending);
+}
+
+void ObjectTracker::MergePendingObjects() {
+  std::vector<PendingObject> pending;
+  for (Shard& shard : shards_) {
+    {
+      std::unique_lock<Mutex> lock(shard.mutex);
+      if (shard.objects.empty())
+        continue;
+      pending.swap(shard.objects);
+    }
+
+    for (const PendingObject& item : pending) {
+      // An object may be allocated where one in |to_delete_| was.
+      DCHECK(objects_.count(item.object) == 0 ||
+             to_delete_.count(item.object) == 1);
+      objects_.insert(item.object);
+      to_delete_.erase(item.object);
+      if (item.is_short_lived)
+        last_alive_time_.emplace(item.object, item.register_time);
+    }
+    pending.clear();
+  }
 }
 
 void ObjectTracker::ForceAlive(const Traceable* ptr) {
-  std::unique_lock<Mutex> lock(mutex_);
   tracer_->ForceAlive(ptr);
 }
 
-void ObjectTracker::AddRef(const Traceable* object) {
-  if (object) {
-    std::unique_lock<Mutex> lock(mutex_);
-    auto* key = const_cast<Traceable*>(object);  // NOLINT
-    DCHECK_EQ(objects_.count(key), 1u);
-    objects_[key]++;
+void ObjectTracker::OnFirstRef(const Traceable* object) {
+  // A GC may be running that already saw the zero ref count.  The HeapTracer
+  // has its own lock, so this doesn't need ours.
+  tracer_->ForceAlive(object);
+}
 
-    tracer_->ForceAlive(object);
-  }
+void ObjectTracker::AddRefLocked(const Traceable* object) {
+  std::unique_lock<Mutex> lock(mutex_);
+  MergePendingObjects();
+  auto* key = const_cast<Traceable*>(object);  // NOLINT
+  DCHECK_EQ(objects_.count(key), 1u);
+  // Objects that are being deleted may already be invalid pointers.
+  if (to_delete_.count(key) > 0)
+    return;
+
+  object->ref_count_.fetch_add(1, std::memory_order_relaxed);
+  tracer_->ForceAlive(object);
+}
+
+void ObjectTracker::RemoveRefLocked(const Traceable* object) {
+  std::unique_lock<Mutex> lock(mutex_);
+  MergePendingObjects();
+  auto* key = const_cast<Traceable*>(object);  // NOLINT
+  DCHECK_EQ(objects_.count(key), 1u);
+  // During Dispose(), objects may be destroyed with existing references to
+  // them.  This means that |object| may be an invalid pointer.
+  if (to_delete_.count(key) > 0)
+    return;
+
+  CHECK_GT(object->ref_count_.fetch_sub(1, std::memory_order_acq_rel), 0u);
+  if (last_alive_time_.count(key) > 0)
+    last_alive_time_[key] = util::Clock::Instance.GetMonotonicTime();
 }
 
-void ObjectTracker::RemoveRef(const Traceable* object) {
-  if (object) {
+size_t ObjectTracker::GetObjectCount() {
+  std::unique_lock<Mutex> lock(mutex_);
+  MergePendingObjects();
+  return objects_.size();
+}
+
+std::vector<ObjectTracker::TypeStats> ObjectTracker::GetTypeStats() {
+  // Group by the dynamic type first so the (slower) type name is only
+  // computed once per type.
+  std::unordered_map<std::type_index, TypeStats> types;
+  {
     std::unique_lock<Mutex> lock(mutex_);
-    auto* key = const_cast<Traceable*>(object);  // NOLINT
-    DCHECK_EQ(objects_.count(key), 1u);
-    CHECK_GT(objects_[key], 0u);
-    objects_[key]--;
-
-    // Don't use IsShortLived() here since |object| may be an invalid pointer.
-    // During Dispose(), objects may be destroyed with existing references to
-    // them.  This means that |object| may be an invalid pointer.
-    if (last_alive_time_.count(key) > 0)
-      last_alive_time_[key] = util::Clock::Instance.GetMonotonicTime();
+    MergePendingObjects();
+    const bool destroying = destroying_.load(std::memory_order_acquire);
+    for (Traceable* object : objects_) {
+      // Objects being destroyed are still in |objects_| while the lock is
+      // released; they may already be deleted.
+      if (destroying && to_delete_.count(object) > 0)
+        continue;
+
+      TypeStats& stats = types[std::type_index(typeid(*object))];
+      if (stats.count == 0)
+        stats.type_name = object->TraceTypeName();
+      stats.count++;
+      stats.bytes += object->TraceSize();
+    }
   }
+
+  std::vector<TypeStats> ret;
+  ret.reserve(types.size());
+  for (auto& pair : types)
+    ret.emplace_back(std::move(pair.second));
+  std::sort(ret.begin(), ret.end(), [](const TypeStats& a, const TypeStats& b) {
+    return a.bytes != b.bytes ? a.bytes > b.bytes : a.count > b.count;
+  });
+  return ret;
 }
 
-std::unordered_set<const Traceable*> ObjectTracker::GetAliveObjects() const {
+std::unordered_set<const Traceable*> ObjectTracker::GetAliveObjects() {
   std::unique_lock<Mutex> lock(mutex_);
+  MergePendingObjects();
   std::unordered_set<const Traceable*> ret;
   ret.reserve(objects_.size());
-  for (auto& pair : objects_) {
-    if (pair.second != 0 || IsJsAlive(pair.first))
-      ret.insert(pair.first);
+  for (Traceable* object : objects_) {
+    if (object->ref_count_.load(std::memory_order_acquire) != 0 ||
+        IsJsAlive(object)) {
+      ret.insert(object);
+    }
   }
   return ret;
 }
@@ -78,15 +167,16 @@ std::unordered_set<const Traceable*> ObjectTracker::GetAliveObjects() const {
 void ObjectTracker::FreeDeadObjects(
     const std::unordered_set<const Traceable*>& alive) {
   std::unique_lock<Mutex> lock(mutex_);
+  MergePendingObjects();
   std::unordered_set<Traceable*> to_delete;
   to_delete.reserve(objects_.size());
-  for (auto pair : objects_) {
+  for (Traceable* object : objects_) {
     // |alive| also contains objects that have a non-zero ref count.  But we
     // need to check against our ref count also to ensure new objects that
     // are created while the GC is running are not deleted.
-    if (pair.second == 0u && alive.count(pair.first) == 0 &&
-        !IsJsAlive(pair.first)) {
-      to_delete.insert(pair.first);
+    if (object->ref_count_.load(std::memory_order_acquire) == 0u &&
+        alive.count(object) == 0 && !IsJsAlive(object)) {
+      to_delete.insert(object);
     }
   }
   to_delete_ = to_delete;
@@ -99,6 +189,8 @@ ObjectTracker::ObjectTracker(HeapTracer* tracer)
 
 ObjectTracker::~ObjectTracker() {
   CHECK(objects_.empty());
+  for (Shard& shard : shards_)
+    CHECK(shard.objects.empty());
 }
 
 bool ObjectTracker::IsJsAlive(Traceable* object) const {
@@ -113,17 +205,14 @@ bool ObjectTracker::IsJsAlive(Traceable* object) const {
 }
 
 uint32_t ObjectTracker::GetRefCount(Traceable* object) const {
-  std::unique_lock<Mutex> lock(mutex_);
-  DCHECK_EQ(1u, objects_.count(object));
-  return objects_.at(object);
+  return object->ref_count_.load(std::memory_order_acquire);
 }
 
 void ObjectTracker::Dispose() {
   std::unique_lock<Mutex> lock(mutex_);
-  while (!objects_.empty()) {
-    std::unordered_set<Traceable*> to_delete;
-    for (auto& pair : objects_)
-      to_delete.insert(pair.first);
+  // Destructors can create new objects, so merge those in each time.
+  for (MergePendingObjects(); !objects_.empty(); MergePendingObjects()) {
+    std::unordered_set<Traceable*> to_delete = objects_;
     to_delete_ = to_delete;
 
     DestroyObjects(to_delete, &lock);
@@ -134,6 +223,7 @@ void ObjectTracker::DestroyObjects(
     const std::unordered_set<Traceable*>& to_delete,
     std::unique_lock<Mutex>* lock) {
   DCHECK(lock->owns_lock());
+  destroying_.store(true, std::memory_order_release);
   {
     util::Unlocker<Mutex> unlock(lock);
     // Don't hold lock so destructor can call AddRef.
@@ -145,13 +235,14 @@ void ObjectTracker::DestroyObjects(
   // Don't remove elements from |objects_| until after the destructor so the
   // destructor can call AddRef.
   for (auto it = objects_.begin(); it != objects_.end();) {
-    if (to_delete_.count(it->first) > 0) {
-      last_alive_time_.erase(it->first);
+    if (to_delete_.count(*it) > 0) {
+      last_alive_time_.erase(*it);
       it = objects_.erase(it);
     } else {
       it++;
     }
   }
+  destroying_.store(false, std::memory_order_release);
 }
 
 }  // namespace memory
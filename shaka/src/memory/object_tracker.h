@@ -17,12 +17,16 @@
 
 #include <glog/logging.h>
 
+#include <array>
+#include <atomic>
 #include <memory>
+#include <string>
 #include <unordered_map>
 #include <unordered_set>
 #include <vector>
 
 #include "src/debug/mutex.h"
+#include "src/memory/heap_tracer.h"
 #include "src/util/macros.h"
 #include "src/util/pseudo_singleton.h"
 #include "src/util/templates.h"
@@ -38,37 +42,98 @@ class ClearKeyImplementationTest;
 
 namespace memory {
 
-class HeapTracer;
-class Traceable;
-
 /**
  * Defines a dynamic object tracker.  This is a singleton class.  This is used
  * to track the dynamic backing objects that we create so we can free them when
  * they are no longer used.  Deriving from BackingObjectBase will automatically
  * use this as the backing store for 'new' usages.  Objects allocated using this
  * should not use 'delete'.
+ *
+ * Ref counts are stored in the objects themselves, so adding and removing
+ * references only uses atomics.  The lock is only taken when an object gains
+ * its first reference (so a running GC sees it as alive), when a short-lived
+ * object loses its last reference (to record the time), or while objects are
+ * being destroyed.
+ *
+ * Objects are created on many threads, so new objects are first added to one
+ * of several shards (picked per thread), each with its own lock.  The shards
+ * are merged into the main set whenever the whole set is needed (e.g. at the
+ * start of a GC run).
  */
 class ObjectTracker final : public PseudoSingleton<ObjectTracker> {
  public:
+  /** The objects of a single type. */
+  struct TypeStats {
+    std::string type_name;
+    size_t count = 0;
+    size_t bytes = 0;
+  };
+
   explicit ObjectTracker(HeapTracer* tracer);
   ~ObjectTracker();
 
   SHAKA_NON_COPYABLE_OR_MOVABLE_TYPE(ObjectTracker);
 
-  /** Registers the given object to be tracked. */
+  /**
+   * Registers the given object to be tracked.  This can be called from any
+   * thread.
+   */
   void RegisterObject(Traceable* object);
 
   /** @see HeapTracer::ForceAlive */
   void ForceAlive(const Traceable* ptr);
 
   /** Increment the reference count of the given object. */
-  void AddRef(const Traceable* object);
+  void AddRef(const Traceable* object) {
+    if (!object)
+      return;
+    if (destroying_.load(std::memory_order_acquire)) {
+      AddRefLocked(object);
+      return;
+    }
+    if (object->ref_count_.fetch_add(1, std::memory_order_relaxed) == 0)
+      OnFirstRef(object);
+  }
 
   /** Decrement the reference count of the given object. */
-  void RemoveRef(const Traceable* object);
+  void RemoveRef(const Traceable* object) {
+    if (!object)
+      return;
+    if (destroying_.load(std::memory_order_acquire)) {
+      RemoveRefLocked(object);
+      return;
+    }
+
+    uint32_t count = object->ref_count_.load(std::memory_order_relaxed);
+    while (true) {
+      DCHECK_GT(count, 0u);
+      // Short-lived objects need to record when their last reference was
+      // removed before a GC can see the zero count.
+      if (count == 1 && object->IsShortLived()) {
+        RemoveRefLocked(object);
+        return;
+      }
+      if (object->ref_count_.compare_exchange_weak(
+              count, count - 1, std::memory_order_acq_rel,
+              std::memory_order_relaxed)) {
+        return;
+      }
+    }
+  }
+
+  /** @return The number of objects being tracked. */
+  size_t GetObjectCount();
+
+  /**
+   * Gets the number and size of the objects being tracked, grouped by type.
+   * This can be called from any thread.
+   *
+   * @return The stats of each type, sorted by size, largest first.
+   */
+  std::vector<TypeStats> GetTypeStats();
 
   /** Get all the objects that have a non-zero ref count. */
-  std::unordered_set<const Traceable*> GetAliveObjects() const;
+  std::unordered_set<const Traceable*> GetAliveObjects();
 
   /**
    * Called from the HeapTracer to free objects during a GC run.
@@ -89,15 +154,45 @@ class ObjectTracker final : public PseudoSingleton<ObjectTracker> {
   /** @return The number of references to the given object. */
   uint32_t GetRefCount(Traceable* object) const;
 
+  /**
+   * Moves the objects registered in the shards into |objects_|.  This must be
+   * called with |mutex_| locked.
+   */
+  void MergePendingObjects();
+
+  void OnFirstRef(const Traceable* object);
+  void AddRefLocked(const Traceable* object);
+  void RemoveRefLocked(const Traceable* object);
+
   void DestroyObjects(const std::unordered_set<Traceable*>& to_delete,
                       std::unique_lock<Mutex>* lock);
 
+  struct PendingObject {
+    Traceable* object;
+    bool is_short_lived;
+    uint64_t register_time;
+  };
+  struct Shard {
+    Shard();
+    ~Shard();
+
+    Mutex mutex;
+    std::vector<PendingObject> objects;
+  };
+  static constexpr const size_t kShardCount = 8;
+
+  std::array<Shard, kShardCount> shards_;
+
+  // This is locked before any shard lock.
   mutable Mutex mutex_;
   HeapTracer* tracer_;
-  // A map of object pointer to ref count.
-  std::unordered_map<Traceable*, uint32_t> objects_;
+  std::unordered_set<Traceable*> objects_;
   std::unordered_map<Traceable*, uint64_t> last_alive_time_;
   std::unordered_set<Traceable*> to_delete_;
+  // Set while objects are being deleted.  Their destructors can drop
+  // references to other objects in the same batch, so the ref counts are
+  // changed under the lock to skip objects that were already deleted.
+  std::atomic<bool> destroying_{false};
 };
 
 }  // namespace memory
@@ -0,0 +1,131 @@
+// Copyright 2020 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     https://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "src/memory/pool_allocator.h"
+
+#include <mutex>
+
+#include "src/util/utils.h"
+
+namespace shaka {
+namespace memory {
+
+namespace {
+
+/** Used to spread the threads across the shards. */
+std::atomic<size_t> g_next_shard{0};
+
+/** Every pool that exists, so the counters can be summed. */
+struct Pools {
+  std::mutex mutex;
+  std::vector<BlockPool*> pools;
+};
+
+/** @return The shard the current thread should use. */
+size_t GetShardIndex(size_t shard_count) {
+  thread_local const size_t index =
+      g_next_shard.fetch_add(1, std::memory_order_relaxed);
+  return index % shard_count;
+}
+
+Pools* GetPools() {
+  // Intentionally leaked since pools can outlive static destruction.
+  static Pools* pools = new Pools;
+  return pools;
+}
+
+}  // namespace
+
+BlockPool::Shard::Shard() : mutex("BlockPool shard") {}
+
+BlockPool::Shard::~Shard() {}
+
+BlockPool::BlockPool(size_t block_size)
+    : block_size_(block_size), allocations_(0), heap_allocations_(0) {
+  Pools* pools = GetPools();
+  std::unique_lock<std::mutex> lock(pools->mutex);
+  pools->pools.emplace_back(this);
+}
+
+BlockPool::~BlockPool() {
+  {
+    Pools* pools = GetPools();
+    std::unique_lock<std::mutex> lock(pools->mutex);
+    util::RemoveElement(&pools->pools, this);
+  }
+  for (Shard& shard : shards_) {
+    for (void* block : shard.blocks)
+      ::operator delete(block);
+  }
+}
+
+// static
+BlockPool::Stats BlockPool::GetStats() {
+  Stats ret;
+  Pools* pools = GetPools();
+  std::unique_lock<std::mutex> lock(pools->mutex);
+  for (BlockPool* pool : pools->pools) {
+    ret.allocations += pool->allocations_.load(std::memory_order_relaxed);
+    ret.heap_allocations +=
+        pool->heap_allocations_.load(std::memory_order_relaxed);
+  }
+  return ret;
+}
+
+// static
+void BlockPool::ResetStats() {
+  Pools* pools = GetPools();
+  std::unique_lock<std::mutex> lock(pools->mutex);
+  for (BlockPool* pool : pools->pools) {
+    pool->allocations_.store(0, std::memory_order_relaxed);
+    pool->heap_allocations_.store(0, std::memory_order_relaxed);
+  }
+}
+
+void* BlockPool::Allocate() {
+  const size_t shard_index = GetShardIndex(kShardCount);
+  allocations_.fetch_add(1, std::memory_order_relaxed);
+
+  // Frames are usually freed on a different thread than they were created
+  // on, so look in the other shards before going to the heap.
+  for (size_t i = 0; i < kShardCount; i++) {
+    Shard& shard = shards_[(shard_index + i) % kShardCount];
+    std::unique_lock<Mutex> lock(shard.mutex);
+    if (!shard.blocks.empty()) {
+      void* ret = shard.blocks.back();
+      shard.blocks.pop_back();
+      return ret;
+    }
+  }
+
+  heap_allocations_.fetch_add(1, std::memory_order_relaxed);
+  return ::operator new(block_size_);
+}
+
+void BlockPool::Free(void* block) {
+  const size_t shard_index = GetShardIndex(kShardCount);
+
+  Shard& shard = shards_[shard_index];
+  {
+    std::unique_lock<Mutex> lock(shard.mutex);
+    if (shard.blocks.size() < kMaxBlocksPerShard) {
+      shard.blocks.emplace_back(block);
+      return;
+    }
+  }
+  ::operator delete(block);
+}
+
+}  // namespace memory
+}  // namespace shaka
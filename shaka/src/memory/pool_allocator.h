@@ -0,0 +1,157 @@
+// Copyright 2020 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     https://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef SHAKA_EMBEDDED_MEMORY_POOL_ALLOCATOR_H_
+#define SHAKA_EMBEDDED_MEMORY_POOL_ALLOCATOR_H_
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <array>
+#include <atomic>
+#include <cstddef>
+#include <memory>
+#include <new>
+#include <utility>
+#include <vector>
+
+#include "src/debug/mutex.h"
+#include "src/util/macros.h"
+
+namespace shaka {
+namespace memory {
+
+/**
+ * Holds freed blocks of a single size so they can be reused without going
+ * through the heap.  This is meant for small objects that are created and
+ * destroyed at a high rate, like media frames.
+ *
+ * Like ObjectTracker, the free blocks are split across several shards (picked
+ * per thread), each with its own lock, so threads rarely contend.  Blocks are
+ * returned to the shard of the thread that frees them; if a thread's shard is
+ * empty, it takes a block from another shard before falling back to the heap.
+ * Each shard only keeps a few blocks; the rest are returned to the heap.
+ *
+ * This type is thread-safe.
+ */
+class BlockPool final {
+ public:
+  /** The counters for every pool in the process. */
+  struct Stats {
+    /** The number of blocks that were requested. */
+    uint64_t allocations = 0;
+    /** The number of those that had to be allocated from the heap. */
+    uint64_t heap_allocations = 0;
+  };
+
+  explicit BlockPool(size_t block_size);
+  ~BlockPool();
+
+  SHAKA_NON_COPYABLE_OR_MOVABLE_TYPE(BlockPool);
+
+  /** @return The sum of the counters of every pool. */
+  static Stats GetStats();
+  /** Clears the counters of every pool. */
+  static void ResetStats();
+
+  size_t block_size() const {
+    return block_size_;
+  }
+
+  /** @return A new block of block_size() bytes. */
+  void* Allocate();
+  /** Returns a block that was returned from Allocate. */
+  void Free(void* block);
+
+ private:
+  struct Shard {
+    Shard();
+    ~Shard();
+
+    Mutex mutex;
+    std::vector<void*> blocks;
+  };
+
+  static constexpr const size_t kShardCount = 8;
+  static constexpr const size_t kMaxBlocksPerShard = 64;
+
+  const size_t block_size_;
+  std::array<Shard, kShardCount> shards_;
+  std::atomic<uint64_t> allocations_;
+  std::atomic<uint64_t> heap_allocations_;
+};
+
+/**
+ * A standard allocator that allocates single objects from a BlockPool for the
+ * type.  This is meant for use with std::allocate_shared, which rebinds this
+ * to its internal type so the object and the shared_ptr control block are
+ * allocated together from one pool.  Arrays are allocated from the heap.
+ */
+template <typename T>
+class PoolAllocator {
+ public:
+  using value_type = T;
+
+  PoolAllocator() {}
+  template <typename U>
+  PoolAllocator(const PoolAllocator<U>&) {}  // NOLINT(runtime/explicit)
+
+  T* allocate(size_t n) {
+    if (n == 1)
+      return static_cast<T*>(GetPool()->Allocate());
+    return static_cast<T*>(::operator new(n * sizeof(T)));
+  }
+
+  void deallocate(T* ptr, size_t n) {
+    if (n == 1)
+      GetPool()->Free(ptr);
+    else
+      ::operator delete(ptr);
+  }
+
+ private:
+  static_assert(alignof(T) <= alignof(std::max_align_t),
+                "Over-aligned types can't be allocated from a pool");
+
+  static BlockPool* GetPool() {
+    // Intentionally leaked so objects can be freed during static destruction.
+    static BlockPool* pool = new BlockPool(sizeof(T));
+    return pool;
+  }
+};
+
+template <typename T, typename U>
+bool operator==(const PoolAllocator<T>&, const PoolAllocator<U>&) {
+  return true;
+}
+
+template <typename T, typename U>
+bool operator!=(const PoolAllocator<T>&, const PoolAllocator<U>&) {
+  return false;
+}
+
+/**
+ * Creates a new shared object whose memory (including the control block) is
+ * taken from a BlockPool.
+ */
+template <typename T, typename... Args>
+std::shared_ptr<T> MakePooledShared(Args&&... args) {
+  return std::allocate_shared<T>(PoolAllocator<T>(),
+                                 std::forward<Args>(args)...);
+}
+
+}  // namespace memory
+}  // namespace shaka
+
+#endif  // SHAKA_EMBEDDED_MEMORY_POOL_ALLOCATOR_H_
@@ -17,18 +17,26 @@
 #include <glog/logging.h>
 
 #include "src/mapping/backing_object.h"
+#include "src/mapping/js_engine.h"
 #include "src/memory/object_tracker.h"
 #include "src/util/clock.h"
 
 namespace shaka {
 namespace memory {
 
+namespace {
+
+/** The number of objects to trace between checking the deadline. */
+constexpr const size_t kTraceStepSize = 256;
+
+}  // namespace
+
 V8HeapTracer::V8HeapTracer() {}
 
 V8HeapTracer::~V8HeapTracer() {}
 
 bool V8HeapTracer::IsTracingDone() {
-  return fields_.empty();
+  return fields_.empty() && !HasPendingObjects();
 }
 
 void V8HeapTracer::TracePrologue(TraceFlags /* flags */) {
@@ -39,7 +47,7 @@ void V8HeapTracer::TracePrologue(TraceFlags /* flags */) {
 
 void V8HeapTracer::TraceEpilogue(TraceSummary* /* trace_summary */) {
   VLOG(2) << "GC run ended";
-  CHECK(fields_.empty());
+  CHECK(IsTracingDone());
   ObjectTracker::Instance()->FreeDeadObjects(alive());
   ResetState();
 }
@@ -54,16 +62,23 @@ void V8HeapTracer::RegisterV8References(
     fields_.insert(reinterpret_cast<Traceable*>(pair.first));
 }
 
-bool V8HeapTracer::AdvanceTracing(double /* deadline_ms */) {
+bool V8HeapTracer::AdvanceTracing(double deadline_ms) {
   VLOG(2) << "GC run step";
   util::Clock clock;
   const uint64_t start = clock.GetMonotonicTime();
-  TraceAll(fields_);
+  AddRoots(fields_);
+  fields_.clear();
+
+  size_t steps = 0;
+  bool has_more;
+  do {
+    has_more = TraceStep(kTraceStepSize);
+    steps++;
+  } while (has_more && JsEngine::MonotonicTimeMs() < deadline_ms);
 
-  VLOG(2) << "Tracing " << fields_.size() << " objects took "
+  VLOG(2) << "Tracing " << steps << " steps took "
           << ((clock.GetMonotonicTime() - start) / 1000.0) << " seconds";
-  fields_.clear();
-  return false;
+  return !has_more;
 }
 
 }  // namespace memory
@@ -88,9 +88,11 @@ class V8HeapTracer : public v8::EmbedderHeapTracer, public HeapTracer {
       const std::vector<std::pair<void*, void*>>& internal_fields) override;
 
   /**
-   * Called by V8 to advance the GC run.  We should only take |deadline_ms|
-   * time to complete, telling V8 whether there is more work to do.
-   * @return True if there is more work to do, false if done.
+   * Called by V8 to advance the GC run.  This traces objects in small steps
+   * and stops once V8's clock reaches |deadline_ms|, so the GC pause doesn't
+   * scale with the number of objects.  Any remaining objects are traced in
+   * later calls.  A deadline of infinity means tracing should be finished.
+   * @return True if tracing is done, false if there is more work to do.
    */
   bool AdvanceTracing(double deadline_ms) override;
 
@@ -14,6 +14,8 @@
 
 #import "shaka/ShakaPlayer.h"
 
+#include <algorithm>
+#include <cmath>
 #include <list>
 #include <memory>
 #include <unordered_map>
@@ -186,6 +188,65 @@ class NetworkFilter final : public shaka::NetworkFilters {
   __weak id<ShakaPlayerNetworkFilter> filter_;
 };
 
+bool TracksEqual(const shaka::Track &a, const shaka::Track &b) {
+  return a.id() == b.id() && a.active() == b.active() && a.type() == b.type() &&
+         a.bandwidth() == b.bandwidth() && a.language() == b.language() &&
+         a.label() == b.label() && a.kind() == b.kind() && a.width() == b.width() &&
+         a.height() == b.height() && a.frameRate() == b.frameRate() &&
+         a.mimeType() == b.mimeType() && a.codecs() == b.codecs() &&
+         a.audioCodec() == b.audioCodec() && a.videoCodec() == b.videoCodec() &&
+         a.primary() == b.primary() && a.roles() == b.roles() && a.videoId() == b.videoId() &&
+         a.audioId() == b.audioId() && a.channelsCount() == b.channelsCount() &&
+         a.audioBandwidth() == b.audioBandwidth() && a.videoBandwidth() == b.videoBandwidth();
+}
+
+/**
+ * Holds the last track list that was converted to Objective-C.  The track lists are usually
+ * polled to update the UI, but rarely change, so this returns the same array when the tracks are
+ * unchanged instead of creating new ShakaTrack objects every time.
+ */
+class TrackCache final {
+ public:
+  TrackCache() : mutex_("TrackCache") {}
+
+  NSArray<ShakaTrack *> *Convert(const std::vector<shaka::Track> &tracks) {
+    std::unique_lock<shaka::Mutex> lock(mutex_);
+    if (objc_ && tracks.size() == tracks_.size() &&
+        std::equal(tracks.begin(), tracks.end(), tracks_.begin(), &TracksEqual)) {
+      return objc_;
+    }
+
+    tracks_ = tracks;
+    // Copy into an immutable array since the same array is given to multiple callers.
+    objc_ = [shaka::util::ObjcConverter<std::vector<shaka::Track>>::ToObjc(tracks) copy];
+    return objc_;
+  }
+
+ private:
+  shaka::Mutex mutex_;
+  std::vector<shaka::Track> tracks_;
+  NSArray<ShakaTrack *> *objc_;
+};
+
+/**
+ * Calls the given block on the main thread with the given results.  The results are converted
+ * using the given function on the main thread.
+ */
+template <typename T, typename Convert, typename Block>
+void CallBlockOnMainThread(const typename shaka::AsyncResults<T>::variant_type &results,
+                           Convert convert, Block block) {
+  // Copy the results since the callback may outlive them.
+  auto local_results = results;
+  dispatch_async(dispatch_get_main_queue(), ^{
+    if (shaka::holds_alternative<shaka::Error>(local_results)) {
+      block(nil, [[ShakaPlayerError alloc]
+                     initWithError:shaka::get<shaka::Error>(local_results)]);
+    } else {
+      block(convert(shaka::get<T>(local_results)), nil);
+    }
+  });
+}
+
 }  // namespace
 
 @implementation ShakaPlayerUiInfo
@@ -239,6 +300,9 @@ std::shared_ptr<shaka::JsManager> ShakaGetGlobalEngine() {
 
   std::unique_ptr<shaka::media::DefaultMediaPlayer> _media_player;
   std::unique_ptr<shaka::Player> _player;
+
+  std::shared_ptr<TrackCache> _text_tracks;
+  std::shared_ptr<TrackCache> _variant_tracks;
 }
 
 @end
@@ -262,6 +326,8 @@ std::shared_ptr<shaka::JsManager> ShakaGetGlobalEngine() {
 
     // Set up player.
     _player.reset(new shaka::Player(_engine.get()));
+    _text_tracks = std::make_shared<TrackCache>();
+    _variant_tracks = std::make_shared<TrackCache>();
     const auto initResults = _player->Initialize(&_client, _media_player.get());
     if (initResults.has_error()) {
       if (error) {
@@ -469,7 +535,7 @@ std::shared_ptr<shaka::JsManager> ShakaGetGlobalEngine() {
   if (results.has_error())
     return [[NSArray<ShakaTrack *> alloc] init];
   else
-    return shaka::util::ObjcConverter<std::vector<shaka::Track>>::ToObjc(results.results());
+    return _text_tracks->Convert(results.results());
 }
 
 - (NSArray<ShakaTrack *> *)getVariantTracks {
@@ -477,7 +543,50 @@ std::shared_ptr<shaka::JsManager> ShakaGetGlobalEngine() {
   if (results.has_error())
     return [[NSArray<ShakaTrack *> alloc] init];
   else
-    return shaka::util::ObjcConverter<std::vector<shaka::Track>>::ToObjc(results.results());
+    return _variant_tracks->Convert(results.results());
+}
+
+- (void)getStatsWithBlock:(void (^)(ShakaStats *, ShakaPlayerError *))block {
+  _player->GetStats([block](const shaka::AsyncResults<shaka::Stats>::variant_type &results) {
+    CallBlockOnMainThread<shaka::Stats>(
+        results, [](const shaka::Stats &stats) { return [[ShakaStats alloc] initWithCpp:stats]; },
+        block);
+  });
+}
+
+- (void)getBufferedInfoWithBlock:(void (^)(ShakaBufferedInfo *, ShakaPlayerError *))block {
+  _player->GetBufferedInfo(
+      [block](const shaka::AsyncResults<shaka::BufferedInfo>::variant_type &results) {
+        CallBlockOnMainThread<shaka::BufferedInfo>(
+            results,
+            [](const shaka::BufferedInfo &info) {
+              return [[ShakaBufferedInfo alloc] initWithCpp:info];
+            },
+            block);
+      });
+}
+
+- (void)getTextTracksWithBlock:(void (^)(NSArray<ShakaTrack *> *, ShakaPlayerError *))block {
+  // The cache is shared with the callback so it can be used after the player is destroyed.
+  std::shared_ptr<TrackCache> cache = _text_tracks;
+  _player->GetTextTracks(
+      [cache, block](const shaka::AsyncResults<std::vector<shaka::Track>>::variant_type &results) {
+        CallBlockOnMainThread<std::vector<shaka::Track>>(
+            results, [cache](const std::vector<shaka::Track> &tracks) {
+              return cache->Convert(tracks);
+            }, block);
+      });
+}
+
+- (void)getVariantTracksWithBlock:(void (^)(NSArray<ShakaTrack *> *, ShakaPlayerError *))block {
+  std::shared_ptr<TrackCache> cache = _variant_tracks;
+  _player->GetVariantTracks(
+      [cache, block](const shaka::AsyncResults<std::vector<shaka::Track>>::variant_type &results) {
+        CallBlockOnMainThread<std::vector<shaka::Track>>(
+            results, [cache](const std::vector<shaka::Track> &tracks) {
+              return cache->Convert(tracks);
+            }, block);
+      });
 }
 
 
@@ -514,8 +623,13 @@ std::shared_ptr<shaka::JsManager> ShakaGetGlobalEngine() {
   _player->Configure(namePath.UTF8String, static_cast<bool>(value));
 }
 
+- (void)preload:(NSString *)uri {
+  _media_player->PreloadSource(uri.UTF8String);
+}
+
 - (void)configure:(const NSString *)namePath withDouble:(double)value {
   _player->Configure(namePath.UTF8String, value);
+  [self configureSourcePlayer:namePath withDouble:value];
 }
 
 - (void)configure:(const NSString *)namePath withString:(const NSString *)value {
@@ -529,6 +643,20 @@ std::shared_ptr<shaka::JsManager> ShakaGetGlobalEngine() {
 
 - (void)configureWithDefault:(const NSString *)namePath {
   _player->Configure(namePath.UTF8String, shaka::DefaultValue);
+  [self configureSourcePlayer:namePath withDouble:0];
+}
+
+/**
+ * Applies the configuration values that also control native (src=) playback,
+ * which Shaka Player doesn't handle.  A value of 0 lets AVPlayer choose.
+ */
+- (void)configureSourcePlayer:(const NSString *)namePath withDouble:(double)value {
+  if (!std::isfinite(value))
+    value = 0;
+  if ([namePath isEqualToString:@"streaming.bufferingGoal"])
+    _media_player->SetSourceForwardBufferDuration(value);
+  else if ([namePath isEqualToString:@"abr.restrictions.maxBandwidth"])
+    _media_player->SetSourcePeakBitRate(value);
 }
 
 - (BOOL)getConfigurationBool:(const NSString *)namePath {
@@ -14,6 +14,7 @@
 
 #import "shaka/ShakaPlayerStorage.h"
 
+#include <memory>
 #include <unordered_map>
 
 #include "shaka/error_objc.h"
@@ -21,10 +22,16 @@
 #include "src/js/offline_externs+Internal.h"
 #include "src/js/offline_externs.h"
 #include "src/public/ShakaPlayer+Internal.h"
+#include "src/public/url_session_scheme_plugin.h"
 #include "src/util/objc_utils.h"
 
 namespace {
 
+// The plugin for background downloads, if enabled.  This keeps the engine
+// alive since the registration is lost if the engine is destroyed.
+std::shared_ptr<shaka::JsManager> gBackgroundEngine;
+std::unique_ptr<shaka::UrlSessionSchemePlugin> gBackgroundPlugin;
+
 class NativeClient : public shaka::Storage::Client {
  public:
   NativeClient() {}
@@ -70,6 +77,25 @@ std::unordered_map<std::string, std::string> ToUnorderedMap(
 
 @implementation ShakaPlayerStorage
 
++ (void)enableBackgroundDownloadsWithIdentifier:(NSString *)identifier {
+  if (gBackgroundPlugin)
+    return;
+
+  gBackgroundEngine = ShakaGetGlobalEngine();
+  gBackgroundPlugin.reset(new shaka::UrlSessionSchemePlugin(identifier.UTF8String));
+  gBackgroundEngine->RegisterNetworkScheme("http", gBackgroundPlugin.get());
+  gBackgroundEngine->RegisterNetworkScheme("https", gBackgroundPlugin.get());
+}
+
++ (BOOL)handleEventsForBackgroundURLSession:(NSString *)identifier
+                          completionHandler:(void (^)(void))completionHandler {
+  if (!gBackgroundPlugin || gBackgroundPlugin->identifier() != identifier.UTF8String)
+    return NO;
+
+  gBackgroundPlugin->SetBackgroundEventsHandler(completionHandler);
+  return YES;
+}
+
 - (instancetype)init {
   return [self initWithPlayer:nil andError:nil];
 }
@@ -137,15 +163,23 @@ std::unordered_map<std::string, std::string> ToUnorderedMap(
 }
 
 - (void)store:(NSString *)uri withBlock:(void (^)(ShakaStoredContent *, ShakaPlayerError *))block {
-  auto results = _storage->Store(uri.UTF8String);
-  shaka::util::CallBlockForFuture(self, std::move(results), block);
+  [self store:uri withAppMetadata:@{} andBlock:block];
 }
 
 - (void)store:(NSString *)uri
     withAppMetadata:(NSDictionary<NSString *, NSString *> *)data
            andBlock:(void (^)(ShakaStoredContent *, ShakaPlayerError *))block {
+  // Segments use the background session until the store finishes.
+  shaka::UrlSessionSchemePlugin *plugin = gBackgroundPlugin.get();
+  if (plugin)
+    plugin->OnStoreStarted();
   auto results = _storage->Store(uri.UTF8String, ToUnorderedMap(data));
-  shaka::util::CallBlockForFuture(self, std::move(results), block);
+  shaka::util::CallBlockForFuture(self, std::move(results),
+                                  ^(ShakaStoredContent *content, ShakaPlayerError *error) {
+                                    if (plugin)
+                                      plugin->OnStoreFinished();
+                                    block(content, error);
+                                  });
 }
 
 
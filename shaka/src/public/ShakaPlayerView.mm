@@ -14,6 +14,8 @@
 
 #import "shaka/ShakaPlayerView.h"
 
+#include <algorithm>
+#include <cmath>
 #include <unordered_set>
 
 #include "shaka/utils.h"
@@ -22,8 +24,11 @@
 
 @interface ShakaPlayerView () {
   CADisplayLink *_renderDisplayLink;
-  NSTimer *_textLoopTimer;
+  // The content frame rate the display link's rate was chosen for.
+  NSInteger _linkFrameRate;
+  CFTimeInterval _lastTextUpdate;
   CALayer *_imageLayer;
+  AVSampleBufferDisplayLayer *_videoLayer;
   CALayer *_textLayer;
   CALayer *_avPlayerLayer;
   ShakaPlayer *_player;
@@ -32,7 +37,8 @@
   NSMutableDictionary<NSValue *, NSSet<CALayer *> *> *_cues;
 }
 
-- (void)renderLoop;
+- (void)renderLoop:(CADisplayLink *)link;
+- (void)displayPixelBuffer:(CVPixelBufferRef)buffer;
 
 @end
 
@@ -55,7 +61,7 @@
 }
 
 - (void)renderLoop:(CADisplayLink *)sender {
-  [self->_target renderLoop];
+  [self->_target renderLoop:sender];
 }
 
 @end
@@ -88,7 +94,6 @@
 
 - (void)dealloc {
   [_renderDisplayLink invalidate];
-  [_textLoopTimer invalidate];
 }
 
 - (void)setup {
@@ -96,21 +101,18 @@
       [CADisplayLink displayLinkWithTarget:[[LoopWrapper alloc] initWithTarget:self]
                                   selector:@selector(renderLoop:)];
   [_renderDisplayLink addToRunLoop:[NSRunLoop mainRunLoop] forMode:NSRunLoopCommonModes];
+  _linkFrameRate = 0;
+  _lastTextUpdate = 0;
 
-  // Use a block with a capture to a weak variable to ensure that the
-  // view will be destroyed once there are no other references.
-  __weak ShakaPlayerView *weakSelf = self;
-  _textLoopTimer = [NSTimer timerWithTimeInterval:0.25
-                                          repeats:YES
-                                            block:^(NSTimer *timer) {
-                                              [weakSelf textLoop];
-                                            }];
-  [[NSRunLoop mainRunLoop] addTimer:_textLoopTimer forMode:NSRunLoopCommonModes];
 
-
-  // Set up the image layer.
+  // Set up the image layer.  The frames are drawn by the video layer inside
+  // it; the image layer clips the video to the region it is displayed in.
   _imageLayer = [CALayer layer];
+  _imageLayer.masksToBounds = YES;
   [self.layer addSublayer:_imageLayer];
+  _videoLayer = [[AVSampleBufferDisplayLayer alloc] init];
+  _videoLayer.videoGravity = AVLayerVideoGravityResize;
+  [_imageLayer addSublayer:_videoLayer];
 
   // Set up the text layer.
   _textLayer = [CALayer layer];
@@ -118,6 +120,7 @@
 
   // Disable default animations.
   _imageLayer.actions = @{@"position": [NSNull null], @"bounds": [NSNull null]};
+  _videoLayer.actions = @{@"position": [NSNull null], @"bounds": [NSNull null]};
 
   _gravity = shaka::VideoFillMode::MaintainRatio;
   _cues = [[NSMutableDictionary alloc] init];
@@ -158,20 +161,71 @@
 
 // MARK: rendering
 
-- (void)renderLoop {
+/**
+ * Picks the display link rate for the given content frame rate.  This uses the
+ * smallest multiple of the content rate that evenly divides the display's
+ * maximum rate (e.g. 24Hz or 48Hz on a 120Hz ProMotion display), so each frame
+ * is shown for the same number of vsyncs.  If there isn't one (e.g. 24fps on a
+ * 60Hz display), this returns 0 to use the display's rate and the renderer
+ * paces the frames (e.g. 3:2 pulldown).
+ */
+- (NSInteger)displayRateForFrameRate:(NSInteger)frameRate {
+  const NSInteger maxRate = (self.window.screen ?: [UIScreen mainScreen]).maximumFramesPerSecond;
+  if (frameRate <= 0 || maxRate <= 0)
+    return 0;
+  for (NSInteger rate = frameRate; rate <= maxRate; rate += frameRate) {
+    if (maxRate % rate == 0)
+      return rate;
+  }
+  return 0;
+}
+
+- (void)updateDisplayLinkRate {
+  const NSInteger frameRate =
+      static_cast<NSInteger>(std::round(_player.videoRenderer->FrameRate()));
+  if (frameRate == _linkFrameRate)
+    return;
+  _linkFrameRate = frameRate;
+
+  const NSInteger rate = [self displayRateForFrameRate:frameRate];
+  if (@available(iOS 15.0, tvOS 15.0, *)) {
+    _renderDisplayLink.preferredFrameRateRange =
+        rate > 0 ? CAFrameRateRangeMake(rate, rate, rate) : CAFrameRateRangeDefault;
+  } else {
+    _renderDisplayLink.preferredFramesPerSecond = rate;
+  }
+}
+
+- (void)renderLoop:(CADisplayLink *)link {
+  // Text is updated less often, but is still done here so the view does no
+  // work between vsyncs.
+  if (link.timestamp - _lastTextUpdate >= 0.25) {
+    _lastTextUpdate = link.timestamp;
+    [self textLoop];
+  }
+
   if (!_player || !_player.mediaPlayer ||
       _player.mediaPlayer->PlaybackState() == shaka::media::VideoPlaybackState::Detached) {
-    self->_imageLayer.contents = nil;
+    [_videoLayer flushAndRemoveImage];
     return;
   }
 
-  shaka::Rational<uint32_t> aspect_ratio;
-  if (CGImageRef image = _player.videoRenderer->Render(nullptr, &aspect_ratio)) {
-    _imageLayer.contents = (__bridge_transfer id)image;
+  [self updateDisplayLinkRate];
 
+  // Select the frame for when this vsync's content is shown, following the
+  // content's cadence at the link's rate.
+  const double vsyncDelay = std::max(0.0, link.targetTimestamp - CACurrentMediaTime());
+  const double refreshInterval = link.targetTimestamp - link.timestamp;
+  shaka::Rational<uint32_t> aspect_ratio;
+  if (CVPixelBufferRef buffer = _player.videoRenderer->RenderPixelBufferForVsync(
+          vsyncDelay, refreshInterval, &aspect_ratio)) {
     // Fit image in frame.
-    shaka::ShakaRect<uint32_t> image_bounds = {0, 0, CGImageGetWidth(image),
-                                               CGImageGetHeight(image)};
+    shaka::ShakaRect<uint32_t> image_bounds = {
+        0,
+        0,
+        static_cast<uint32_t>(CVPixelBufferGetWidth(buffer)),
+        static_cast<uint32_t>(CVPixelBufferGetHeight(buffer)),
+    };
     shaka::ShakaRect<uint32_t> dest_bounds = {
         0,
         0,
@@ -182,13 +236,44 @@
     shaka::ShakaRect<uint32_t> dest;
     shaka::FitVideoToRegion(image_bounds, dest_bounds, aspect_ratio,
                             _player.videoRenderer->fill_mode(), &src, &dest);
-    _imageLayer.contentsRect = CGRectMake(
-        static_cast<CGFloat>(src.x) / image_bounds.w, static_cast<CGFloat>(src.y) / image_bounds.h,
-        static_cast<CGFloat>(src.w) / image_bounds.w, static_cast<CGFloat>(src.h) / image_bounds.h);
+    // Stretch the whole image so the |src| region covers the image layer, which clips the rest.
+    const CGFloat scale_x = static_cast<CGFloat>(dest.w) / src.w;
+    const CGFloat scale_y = static_cast<CGFloat>(dest.h) / src.h;
     _imageLayer.frame = CGRectMake(dest.x, dest.y, dest.w, dest.h);
+    _videoLayer.frame = CGRectMake(-(src.x * scale_x), -(src.y * scale_y),
+                                   image_bounds.w * scale_x, image_bounds.h * scale_y);
+
+    [self displayPixelBuffer:buffer];
+    CVPixelBufferRelease(buffer);
   }
 }
 
+- (void)displayPixelBuffer:(CVPixelBufferRef)buffer {
+  // Wrap the buffer in a sample buffer so the layer draws straight from its
+  // IOSurface without copying it.
+  CMVideoFormatDescriptionRef format;
+  if (CMVideoFormatDescriptionCreateForImageBuffer(kCFAllocatorDefault, buffer, &format) != 0)
+    return;
+  CMSampleTimingInfo timing = {kCMTimeInvalid, kCMTimeInvalid, kCMTimeInvalid};
+  CMSampleBufferRef sample;
+  const OSStatus status = CMSampleBufferCreateReadyWithImageBuffer(kCFAllocatorDefault, buffer,
+                                                                   format, &timing, &sample);
+  CFRelease(format);
+  if (status != 0)
+    return;
+
+  // The renderer already handles the timing, so show the frame now.
+  CFArrayRef attachments = CMSampleBufferGetSampleAttachmentsArray(sample, YES);
+  auto *dict = static_cast<CFMutableDictionaryRef>(
+      const_cast<void *>(CFArrayGetValueAtIndex(attachments, 0)));
+  CFDictionarySetValue(dict, kCMSampleAttachmentKey_DisplayImmediately, kCFBooleanTrue);
+
+  if (_videoLayer.status == AVQueuedSampleBufferRenderingStatusFailed)
+    [_videoLayer flush];
+  [_videoLayer enqueueSampleBuffer:sample];
+  CFRelease(sample);
+}
+
 - (void)layoutSubviews {
   [super layoutSubviews];
   if (_avPlayerLayer)
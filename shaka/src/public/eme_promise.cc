@@ -26,6 +26,28 @@
 namespace shaka {
 namespace eme {
 
+namespace {
+
+js::JsError MakeError(ExceptionType except_type, const std::string& message) {
+  switch (except_type) {
+    case ExceptionType::TypeError:
+      return js::JsError::TypeError(message);
+    case ExceptionType::RangeError:
+      return js::JsError::RangeError(message);
+    case ExceptionType::NotSupported:
+      return js::JsError::DOMException(NotSupportedError, message);
+    case ExceptionType::InvalidState:
+      return js::JsError::DOMException(InvalidStateError, message);
+    case ExceptionType::QuotaExceeded:
+      return js::JsError::DOMException(QuotaExceededError, message);
+
+    default:
+      return js::JsError::DOMException(UnknownError, message);
+  }
+}
+
+}  // namespace
+
 EmePromise::Impl::Impl(const Promise& promise, bool has_value)
     : promise_(MakeJsRef<Promise>(promise)),
       is_pending_(false),
@@ -45,15 +67,14 @@ void EmePromise::Impl::Resolve() {
 
     RefPtr<Promise> promise = promise_;
     bool has_value = has_value_;
-    JsManagerImpl::Instance()->MainThread()->AddInternalTask(
-        TaskPriority::Internal, "DoResolvePromise", [=]() {
-          LocalVar<JsValue> value;
-          if (has_value)
-            value = ToJsValue(false);
-          else
-            value = JsUndefined();
-          promise->ResolveWith(value);
-        });
+    JsManagerImpl::Instance()->MainThreadCompletions()->Push([=]() {
+      LocalVar<JsValue> value;
+      if (has_value)
+        value = ToJsValue(false);
+      else
+        value = JsUndefined();
+      promise->ResolveWith(value, /* run_events */ false);
+    });
   }
 }
 
@@ -67,15 +88,14 @@ void EmePromise::Impl::ResolveWith(bool value) {
 
     RefPtr<Promise> promise = promise_;
     bool has_value = has_value_;
-    JsManagerImpl::Instance()->MainThread()->AddInternalTask(
-        TaskPriority::Internal, "DoResolvePromise", [=]() {
-          LocalVar<JsValue> js_value;
-          if (has_value)
-            js_value = ToJsValue(value);
-          else
-            js_value = JsUndefined();
-          promise->ResolveWith(js_value);
-        });
+    JsManagerImpl::Instance()->MainThreadCompletions()->Push([=]() {
+      LocalVar<JsValue> js_value;
+      if (has_value)
+        js_value = ToJsValue(value);
+      else
+        js_value = JsUndefined();
+      promise->ResolveWith(js_value, /* run_events */ false);
+    });
   }
 }
 
@@ -84,34 +104,10 @@ void EmePromise::Impl::Reject(ExceptionType except_type,
   bool expected = false;
   if (is_pending_.compare_exchange_strong(expected, true)) {
     RefPtr<Promise> promise = promise_;
-    JsManagerImpl::Instance()->MainThread()->AddInternalTask(
-        TaskPriority::Internal, "DoRejectPromise", [=]() {
-          switch (except_type) {
-            case ExceptionType::TypeError:
-              promise->RejectWith(js::JsError::TypeError(message));
-              break;
-            case ExceptionType::RangeError:
-              promise->RejectWith(js::JsError::RangeError(message));
-              break;
-            case ExceptionType::NotSupported:
-              promise->RejectWith(
-                  js::JsError::DOMException(NotSupportedError, message));
-              break;
-            case ExceptionType::InvalidState:
-              promise->RejectWith(
-                  js::JsError::DOMException(InvalidStateError, message));
-              break;
-            case ExceptionType::QuotaExceeded:
-              promise->RejectWith(
-                  js::JsError::DOMException(QuotaExceededError, message));
-              break;
-
-            default:
-              promise->RejectWith(
-                  js::JsError::DOMException(UnknownError, message));
-              break;
-          }
-        });
+    JsManagerImpl::Instance()->MainThreadCompletions()->Push([=]() {
+      promise->RejectWith(MakeError(except_type, message),
+                          /* run_events */ false);
+    });
   }
 }
 
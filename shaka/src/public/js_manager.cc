@@ -14,17 +14,36 @@
 
 #include "shaka/js_manager.h"
 
+#include <algorithm>
+#include <future>
+#include <limits>
+#include <string>
+#include <utility>
+
 #include "shaka/error.h"
 #include "src/core/js_manager_impl.h"
 #include "src/core/js_object_wrapper.h"
+#include "src/core/segment_cache.h"
+#include "src/core/storage_thread.h"
+#include "src/core/wasm_module_cache.h"
+#include "src/debug/lock_profiler.h"
+#include "src/debug/telemetry.h"
+#include "src/debug/thread.h"
+#include "src/debug/trace_event.h"
 #include "src/js/js_error.h"
 #include "src/js/net.h"
 #include "src/mapping/callback.h"
 #include "src/mapping/convert_js.h"
+#include "src/mapping/js_engine.h"
 #include "src/mapping/js_utils.h"
 #include "src/mapping/js_wrappers.h"
 #include "src/mapping/promise.h"
 #include "src/mapping/register_member.h"
+#include "src/media/media_buffer.h"
+#include "src/media/media_utils.h"
+#include "src/memory/memory_budget.h"
+#include "src/memory/object_tracker.h"
+#include "src/util/clock.h"
 
 namespace shaka {
 
@@ -45,11 +64,39 @@ class ProgressClient : public SchemePlugin::Client {
   RefPtr<Callback> on_progress_;
 };
 
+JsManager::MemoryUsage ConvertMemoryUsage(
+    const memory::MemoryBudget::Usage& usage) {
+  using memory::MemorySubsystem;
+  auto get = [&usage](MemorySubsystem subsystem) {
+    return usage.bytes[static_cast<size_t>(subsystem)];
+  };
+  JsManager::MemoryUsage ret;
+  ret.budget = usage.budget;
+  ret.total_bytes = usage.total_bytes;
+  ret.segment_cache_bytes = get(MemorySubsystem::SegmentCache);
+  ret.frame_pool_bytes = get(MemorySubsystem::FramePool);
+  ret.decoded_frame_bytes = get(MemorySubsystem::DecodedFrames);
+  ret.encoded_frame_bytes = get(MemorySubsystem::EncodedFrames);
+  ret.network_bytes = get(MemorySubsystem::Network);
+  ret.evicted_bytes = usage.evicted_bytes;
+  return ret;
+}
+
 }  // namespace
 
-JsManager::JsManager() : impl_(new JsManagerImpl(StartupOptions())) {}
+JsManager::JsManager()
+    : impl_(new JsManagerImpl(StartupOptions(), HeapOptions(),
+                              EventLoopMode::OwnThread)) {}
 JsManager::JsManager(const StartupOptions& options)
-    : impl_(new JsManagerImpl(options)) {}
+    : impl_(new JsManagerImpl(options, HeapOptions(),
+                              EventLoopMode::OwnThread)) {}
+JsManager::JsManager(const StartupOptions& options,
+                     const HeapOptions& heap_options)
+    : impl_(new JsManagerImpl(options, heap_options,
+                              EventLoopMode::OwnThread)) {}
+JsManager::JsManager(const StartupOptions& options,
+                     const HeapOptions& heap_options, EventLoopMode mode)
+    : impl_(new JsManagerImpl(options, heap_options, mode)) {}
 JsManager::~JsManager() {}
 
 JsManager::JsManager(JsManager&&) = default;
@@ -64,6 +111,280 @@ void JsManager::WaitUntilFinished() {
   impl_->WaitUntilFinished();
 }
 
+double JsManager::RunUntilIdle(double max_time) {
+  const uint64_t now = util::Clock::Instance.GetMonotonicTime();
+  const double max_ms = std::max(max_time, 0.0) * 1000;
+  // Avoid overflowing for very large (or infinite) times.
+  const uint64_t deadline_ms =
+      max_ms < static_cast<double>(std::numeric_limits<uint32_t>::max())
+          ? now + static_cast<uint64_t>(max_ms)
+          : std::numeric_limits<uint64_t>::max();
+  const uint64_t delay_ms = impl_->MainThread()->RunUntilIdle(deadline_ms);
+  if (delay_ms == std::numeric_limits<uint64_t>::max())
+    return std::numeric_limits<double>::infinity();
+  return delay_ms / 1000.0;
+}
+
+AsyncResults<void> JsManager::WhenReady() const {
+  std::shared_future<void> ready = impl_->ready();
+  // Convert to the std::future<variant<monostate, Error>> that AsyncResults
+  // expects; see RunScript.
+  auto future = std::async(std::launch::deferred,
+                           [ready]() -> variant<monostate, Error> {
+                             ready.wait();
+                             return monostate();
+                           });
+  return future.share();
+}
+
+void JsManager::Preconnect(const std::string& url) {
+  impl_->NetworkThread()->Preconnect(url);
+}
+
+void JsManager::Preconnect(const std::vector<std::string>& urls) {
+  impl_->NetworkThread()->Preconnect(urls);
+}
+
+void JsManager::SetNetworkOptions(const NetworkOptions& options) {
+  impl_->NetworkThread()->SetOptions(options);
+}
+
+void JsManager::AddCachedSegment(const std::string& uri,
+                                 const std::string& range, const uint8_t* data,
+                                 size_t size) {
+  SegmentCache* cache = impl_->NetworkThread()->segment_cache();
+  if (!cache->enabled())
+    return;
+
+  std::shared_ptr<SegmentCache::Entry> entry(new SegmentCache::Entry);
+  entry->status = range.empty() ? 200 : 206;
+  entry->status_text = range.empty() ? "OK" : "Partial Content";
+  entry->uri = uri;
+  entry->data.assign(data, data + size);
+  cache->Put(SegmentCache::MakeKey(uri, range), std::move(entry));
+}
+
+JsManager::SegmentCacheStats JsManager::GetSegmentCacheStats() const {
+  const SegmentCache::Stats stats =
+      impl_->NetworkThread()->segment_cache()->GetStats();
+  SegmentCacheStats ret;
+  ret.hits = stats.hits;
+  ret.misses = stats.misses;
+  ret.evictions = stats.evictions;
+  ret.entry_count = stats.entry_count;
+  ret.total_bytes = stats.total_bytes;
+  return ret;
+}
+
+void JsManager::SetBeaconOptions(const BeaconOptions& options) {
+  BeaconQueue::Options beacon_options;
+  beacon_options.url = options.url;
+  beacon_options.flush_interval_ms = options.flush_interval_ms;
+  beacon_options.max_events = options.max_events;
+  beacon_options.compress = options.compress;
+  impl_->NetworkThread()->SetBeaconOptions(beacon_options);
+}
+
+void JsManager::AddBeaconEvent(const std::string& name,
+                               const std::string& data) {
+  impl_->NetworkThread()->AddBeaconEvent(name, data);
+}
+
+void JsManager::AddBeaconMetric(const std::string& name, double value) {
+  impl_->NetworkThread()->AddBeaconMetric(name, value);
+}
+
+JsManager::BeaconStats JsManager::GetBeaconStats() const {
+  const BeaconQueue::Stats stats = impl_->NetworkThread()->GetBeaconStats();
+  BeaconStats ret;
+  ret.batch_count = stats.batch_count;
+  ret.failed_batch_count = stats.failed_batch_count;
+  ret.item_count = stats.item_count;
+  ret.coalesced_count = stats.coalesced_count;
+  ret.dropped_count = stats.dropped_count;
+  return ret;
+}
+
+JsManager::StorageStats JsManager::GetStorageStats() const {
+  const StorageThread::Stats stats = impl_->StorageThread()->GetStats();
+  StorageStats ret;
+  ret.operation_count = stats.task_count;
+  ret.queue_depth = stats.queue_depth;
+  ret.max_queue_depth = stats.max_queue_depth;
+  if (stats.task_count > 0) {
+    ret.average_latency_ms =
+        static_cast<double>(stats.total_latency_ms) / stats.task_count;
+  }
+  ret.max_latency_ms = stats.max_latency_ms;
+  return ret;
+}
+
+JsManager::WasmStats JsManager::GetWasmStats() const {
+  const WasmModuleCache& cache = WasmModuleCache::Instance;
+  WasmStats ret;
+  ret.cache_hit_count = cache.hit_count();
+  ret.cache_miss_count = cache.miss_count();
+  ret.compile_times = Telemetry::Summarize(cache.compile_times());
+  ret.cached_compile_times = Telemetry::Summarize(cache.cached_compile_times());
+  ret.instantiate_times = Telemetry::Summarize(cache.instantiate_times());
+  return ret;
+}
+
+void JsManager::SetMemoryPressure(MemoryPressure pressure) {
+  media::SetMemoryPressure(pressure);
+  if (pressure == MemoryPressure::Critical) {
+    impl_->NetworkThread()->segment_cache()->Clear();
+    impl_->NetworkThread()->http_cache()->ClearMemory();
+  }
+  if (pressure != MemoryPressure::None) {
+    impl_->MainThread()->AddInternalTask(
+        TaskPriority::Immediate, "LowMemoryNotification",
+        []() { JsEngine::Instance()->OnLowMemory(); });
+  }
+}
+
+void JsManager::SetSourceBufferQuota(const SourceBufferQuota& quota) {
+  media::SetSourceBufferQuota(quota);
+}
+
+void JsManager::SetMemoryBudget(uint64_t bytes) {
+  memory::MemoryBudget::Instance()->SetBudget(bytes);
+}
+
+JsManager::MemoryUsage JsManager::GetMemoryUsage() const {
+  return ConvertMemoryUsage(memory::MemoryBudget::Instance()->GetUsage());
+}
+
+// static
+void JsManager::SetThreadOptions(ThreadRole role,
+                                 const ThreadOptions& options) {
+  Thread::SetOptions(role, options);
+}
+
+// static
+void JsManager::SetMediaAllocator(media::MediaAllocator* allocator) {
+  media::SetMediaAllocator(allocator);
+}
+
+JsManager::JsHeapStats JsManager::GetJsHeapStats() const {
+  return impl_->MainThread()
+      ->InvokeOrSchedule([]() {
+        JsHeapStats ret = JsEngine::Instance()->GetHeapStats();
+        ret.native_object_count =
+            memory::ObjectTracker::Instance()->GetObjectCount();
+        return ret;
+      })
+      .get();
+}
+
+JsManager::MemoryReport JsManager::GetMemoryReport() const {
+  MemoryReport ret;
+  ret.js_heap = GetJsHeapStats();
+
+  const memory::MemoryBudget::Usage usage =
+      memory::MemoryBudget::Instance()->GetUsage();
+  ret.media = ConvertMemoryUsage(usage);
+  for (const auto& consumer : usage.consumers) {
+    BufferMemoryUsage buffer;
+    buffer.name = consumer.name;
+    buffer.bytes = consumer.bytes;
+    if (consumer.subsystem == memory::MemorySubsystem::EncodedFrames)
+      ret.source_buffers.emplace_back(std::move(buffer));
+    else if (consumer.subsystem == memory::MemorySubsystem::DecodedFrames)
+      ret.decoded_streams.emplace_back(std::move(buffer));
+  }
+
+  for (auto& stats : memory::ObjectTracker::Instance()->GetTypeStats()) {
+    NativeTypeMemoryUsage type;
+    type.type_name = std::move(stats.type_name);
+    type.count = stats.count;
+    type.bytes = stats.bytes;
+    ret.native_types.emplace_back(std::move(type));
+  }
+  return ret;
+}
+
+AsyncResults<void> JsManager::StartCpuProfiling(double max_duration,
+                                                uint32_t sample_interval_us) {
+  const uint64_t max_duration_ms =
+      static_cast<uint64_t>(std::max(max_duration, 0.0) * 1000);
+  auto* impl = impl_.get();
+  std::shared_future<bool> started =
+      impl->MainThread()->InvokeOrSchedule([=]() {
+        return impl->CpuProfiler()->Start(max_duration_ms, sample_interval_us);
+      });
+  // Convert to the std::future<variant<monostate, Error>> that AsyncResults
+  // expects; see RunScript.
+  auto future = std::async(std::launch::deferred,
+                           [started]() -> variant<monostate, Error> {
+                             if (started.get())
+                               return monostate();
+                             return Error(
+                                 "CPU profiling is already running or isn't "
+                                 "supported by the JavaScript engine");
+                           });
+  return future.share();
+}
+
+AsyncResults<JsManager::CpuProfile> JsManager::StopCpuProfiling() {
+  auto* impl = impl_.get();
+  return impl->MainThread()->InvokeOrSchedule(
+      [impl]() -> variant<CpuProfile, Error> {
+        CpuProfile profile;
+        if (!impl->CpuProfiler()->Stop(&profile))
+          return Error("CPU profiling wasn't started");
+        return profile;
+      });
+}
+
+void JsManager::SetTimerSlack(uint64_t slack_ms) {
+  impl_->MainThread()->SetTimerSlack(slack_ms);
+}
+
+JsManager::EventLoopStats JsManager::GetEventLoopStats() const {
+  return impl_->MainThread()->GetStats();
+}
+
+void JsManager::SetLongTaskThreshold(uint64_t threshold_ms) {
+  impl_->MainThread()->SetLongTaskThreshold(threshold_ms);
+}
+
+void JsManager::SetLockProfilingEnabled(bool enabled) {
+  LockProfiler::SetEnabled(enabled);
+}
+
+std::string JsManager::GetLockProfile() const {
+  return LockProfiler::Dump();
+}
+
+void JsManager::ResetLockProfile() {
+  LockProfiler::Reset();
+}
+
+void JsManager::SetGcProfilingEnabled(bool enabled) {
+  impl_->HeapTracer()->SetProfilingEnabled(enabled);
+}
+
+std::string JsManager::GetGcProfile() const {
+  return impl_->HeapTracer()->DumpProfile();
+}
+
+void JsManager::ResetGcProfile() {
+  impl_->HeapTracer()->ResetProfile();
+}
+
+void JsManager::SetTracingEnabled(bool enabled) {
+  TraceRecorder::SetEnabled(enabled);
+}
+
+std::string JsManager::GetTraceJson() const {
+  return TraceRecorder::GetChromeTraceJson();
+}
+
+void JsManager::ResetTrace() {
+  TraceRecorder::Reset();
+}
+
 AsyncResults<void> JsManager::RunScript(const std::string& path) {
   auto run_future = impl_->RunScript(path)->future();
   // This creates a std::future that will invoke the given method when the
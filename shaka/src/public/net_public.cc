@@ -13,13 +13,100 @@
 // limitations under the License.
 
 #include "shaka/net.h"
+
+#include <stdlib.h>
+
+#include <utility>
+
 #include "src/core/ref_ptr.h"
 #include "src/js/net.h"
 #include "src/mapping/js_utils.h"
 #include "src/memory/object_tracker.h"
+#include "src/util/file_system.h"
+#include "src/util/url.h"
+#include "src/util/utils.h"
 
 namespace shaka {
 
+namespace {
+
+std::future<optional<Error>> MakeResult(optional<Error> error) {
+  std::promise<optional<Error>> ret;
+  ret.set_value(std::move(error));
+  return ret.get_future();
+}
+
+int HexValue(char c) {
+  if (c >= '0' && c <= '9')
+    return c - '0';
+  if (c >= 'a' && c <= 'f')
+    return c - 'a' + 10;
+  if (c >= 'A' && c <= 'F')
+    return c - 'A' + 10;
+  return -1;
+}
+
+/** Decodes the %XX escapes in the given URI path. */
+bool PercentDecode(const std::string& source, std::string* result) {
+  result->clear();
+  result->reserve(source.size());
+  for (size_t i = 0; i < source.size(); i++) {
+    if (source[i] != '%') {
+      result->push_back(source[i]);
+      continue;
+    }
+    if (i + 2 >= source.size())
+      return false;
+    const int high = HexValue(source[i + 1]);
+    const int low = HexValue(source[i + 2]);
+    if (high < 0 || low < 0)
+      return false;
+    result->push_back(static_cast<char>(high * 16 + low));
+    i += 2;
+  }
+  return true;
+}
+
+/**
+ * Parses a "bytes=start-[end]" Range header for a file of the given size.
+ * @param header The value of the header.
+ * @param start [OUT] The first byte of the range.
+ * @param end [OUT] One past the last byte of the range.
+ * @return Whether the range is valid and satisfiable.
+ */
+bool ParseRange(const std::string& header, size_t file_size, size_t* start,
+                size_t* end) {
+  const std::string value = util::TrimAsciiWhitespace(header);
+  if (value.compare(0, 6, "bytes=") != 0)
+    return false;
+
+  const char* begin = value.c_str() + 6;
+  char* parse_end;
+  if (*begin < '0' || *begin > '9')
+    return false;
+  const unsigned long long first = strtoull(begin, &parse_end, 10);  // NOLINT
+  if (*parse_end != '-' || first >= file_size)
+    return false;
+
+  unsigned long long last = file_size - 1;  // NOLINT
+  begin = parse_end + 1;
+  if (*begin != '\0') {
+    if (*begin < '0' || *begin > '9')
+      return false;
+    last = strtoull(begin, &parse_end, 10);
+    if (*parse_end != '\0' || last < first)
+      return false;
+    if (last >= file_size)
+      last = file_size - 1;
+  }
+
+  *start = static_cast<size_t>(first);
+  *end = static_cast<size_t>(last) + 1;
+  return true;
+}
+
+}  // namespace
+
 class Request::Impl {
  public:
   RefPtr<js::Request> request;
@@ -84,6 +171,11 @@ void Response::SetDataCopy(const uint8_t* data, size_t size) {
   impl_->response->data.SetFromBuffer(data, size);
 }
 
+void Response::SetDataExternal(const uint8_t* data, size_t size,
+                               std::function<void()> on_free) {
+  impl_->response->data.SetFromExternal(data, size, std::move(on_free));
+}
+
 Response::Response()
     : timeMs(0), fromCache(false), impl_(new Impl{MakeJsRef<js::Response>()}) {}
 
@@ -118,6 +210,9 @@ SchemePlugin::~SchemePlugin() {}
 SchemePlugin::Client::Client() {}
 SchemePlugin::Client::~Client() {}
 
+FileSchemePlugin::FileSchemePlugin() {}
+FileSchemePlugin::~FileSchemePlugin() {}
+
 NetworkFilters::NetworkFilters() {}
 NetworkFilters::~NetworkFilters() {}
 // \endcond Doxygen_Skip
@@ -133,4 +228,43 @@ std::future<optional<Error>> NetworkFilters::OnResponseFilter(
   return {};
 }
 
+std::future<optional<Error>> FileSchemePlugin::OnNetworkRequest(
+    const std::string& uri, RequestType /* type */, const Request& request,
+    Client* /* client */, Response* response) {
+  if (request.method != "GET" && request.method != "HEAD")
+    return MakeResult(Error("Unsupported method for file: " + request.method));
+
+  util::Url url;
+  std::string path;
+  if (!util::Url::Parse(uri, &url) || url.scheme() != "file" ||
+      !PercentDecode(url.path(), &path) || path.empty()) {
+    return MakeResult(Error("Invalid file URI: " + uri));
+  }
+
+  // Empty files can't be mapped, so handle them separately.
+  util::FileSystem file_system;
+  util::MappedFile file;
+  const ssize_t file_size = file_system.FileSize(path);
+  if (file_size < 0 || (file_size > 0 && !file_system.MapFile(path, &file)))
+    return MakeResult(Error("Unable to read file: " + path));
+
+  size_t start = 0;
+  size_t end = file.size();
+  for (const auto& header : request.headers) {
+    if (util::ToAsciiLower(header.first) == "range" &&
+        !ParseRange(header.second, file.size(), &start, &end)) {
+      return MakeResult(Error("Unsatisfiable range for file: " + path));
+    }
+  }
+
+  response->uri = uri;
+  response->originalUri = uri;
+  response->headers["content-length"] = std::to_string(end - start);
+  if (request.method == "GET" && file.valid()) {
+    const uint8_t* data = file.data() + start;
+    response->SetDataExternal(data, end - start, file.Release());
+  }
+  return MakeResult(nullopt);
+}
+
 }  // namespace shaka
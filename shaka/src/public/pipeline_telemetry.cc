@@ -0,0 +1,37 @@
+// Copyright 2020 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     https://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "shaka/pipeline_telemetry.h"
+
+#include "src/debug/telemetry.h"
+
+namespace shaka {
+
+std::vector<PipelineTelemetry::Thread> PipelineTelemetry::GetThreads() {
+  return Telemetry::GetThreads();
+}
+
+std::vector<PipelineTelemetry::Stream> PipelineTelemetry::GetStreams() {
+  return Telemetry::GetStreams();
+}
+
+PipelineTelemetry::FrameAllocations PipelineTelemetry::GetFrameAllocations() {
+  return Telemetry::GetFrameAllocations();
+}
+
+void PipelineTelemetry::Reset() {
+  Telemetry::Reset();
+}
+
+}  // namespace shaka
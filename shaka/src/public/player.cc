@@ -14,14 +14,18 @@
 
 #include "shaka/player.h"
 
+#include <atomic>
 #include <functional>
 #include <list>
+#include <memory>
 
 #include "shaka/version.h"
 #include "src/core/js_manager_impl.h"
 #include "src/core/js_object_wrapper.h"
 #include "src/debug/mutex.h"
+#include "src/debug/startup_tracer.h"
 #include "src/js/dom/document.h"
+#include "src/js/native_abr_manager.h"
 #include "src/js/manifest.h"
 #include "src/js/mse/video_element.h"
 #include "src/js/net.h"
@@ -84,10 +88,19 @@ struct impl::ConvertHelper<Player::LogLevel> {
 
 class Player::Impl : public JsObjectWrapper {
  public:
-  explicit Impl(JsManager* engine) : filters_mutex_("Player::Impl") {
+  explicit Impl(JsManager* engine)
+      : filters_mutex_("Player::Impl"), media_player_(nullptr) {
     CHECK(engine) << "Must pass a JsManager instance";
   }
   ~Impl() {
+    if (uses_snapshot_) {
+      // Stop the timer on the main thread so it can't be running while we are
+      // destroyed.
+      JsManagerImpl::Instance()
+          ->MainThread()
+          ->InvokeOrSchedule([this]() { SetStateSnapshotIntervalRaw(0); })
+          .wait();
+    }
     if (object_)
       CallMethod<void>("destroy").wait();
     if (video_)
@@ -102,6 +115,7 @@ class Player::Impl : public JsObjectWrapper {
     // constructor.  Since the Environment might not be setup yet, run this in
     // an internal task so we know it is ready.
     DCHECK(!JsManagerImpl::Instance()->MainThread()->BelongsToCurrentThread());
+    media_player_.store(player, std::memory_order_release);
     const auto callback = [=]() -> Converter<void>::variant_type {
       LocalVar<JsValue> player_ctor = GetDescendant(
           JsEngine::Instance()->global_handle(), {"shaka", "Player"});
@@ -128,23 +142,20 @@ class Player::Impl : public JsObjectWrapper {
       Init(UnsafeJsCast<JsObject>(result_or_except));
       return AttachListeners(client);
     };
-    return JsManagerImpl::Instance()
-        ->MainThread()
-        ->AddInternalTask(TaskPriority::Internal, "Player ctor",
-                          std::move(callback))
-        ->future();
+    return JsManagerImpl::Instance()->MainThread()->InvokeOrSchedule(
+        std::move(callback));
   }
 
   Converter<void>::future_type Attach(media::MediaPlayer* player) {
     RefPtr<js::mse::HTMLVideoElement> new_elem(new js::mse::HTMLVideoElement(
         js::dom::Document::EnsureGlobalDocument(), player));
     auto future = CallMethod<void>("attach", new_elem);
-    return SetVideoWhenResolved(future, new_elem);
+    return SetVideoWhenResolved(future, new_elem, player);
   }
 
   Converter<void>::future_type Detach() {
     auto future = CallMethod<void>("detach");
-    return SetVideoWhenResolved(future, nullptr);
+    return SetVideoWhenResolved(future, nullptr, nullptr);
   }
 
   template <typename T>
@@ -170,20 +181,144 @@ class Player::Impl : public JsObjectWrapper {
     }
   }
 
+  Converter<void>::future_type SetAbrManager(AbrManager* abr) {
+    auto callback = std::bind(&Impl::SetAbrManagerRaw, this, abr);
+    return JsManagerImpl::Instance()->MainThread()->InvokeOrSchedule(
+        std::move(callback));
+  }
+
   void* GetRawJsValue() {
     return &object_;
   }
 
+  void SetStateSnapshotInterval(uint64_t interval_ms) {
+    uses_snapshot_ = true;
+    JsManagerImpl::Instance()->MainThread()->InvokeOrSchedule(
+        std::bind(&Impl::SetStateSnapshotIntervalRaw, this, interval_ms));
+  }
+
+  PlaybackPosition GetPlaybackPosition() const {
+    PlaybackPosition ret;
+    media::MediaPlayer* player = media_player_.load(std::memory_order_acquire);
+    if (player) {
+      ret.current_time = player->CurrentTime();
+      ret.duration = player->Duration();
+      ret.playback_rate = player->PlaybackRate();
+      ret.state = player->PlaybackState();
+    }
+    return ret;
+  }
+
+  StateSnapshot GetStateSnapshot() const {
+    std::shared_ptr<const StateSnapshot> snapshot =
+        std::atomic_load(&snapshot_);
+    return snapshot ? *snapshot : StateSnapshot();
+  }
+
  private:
+  void SetStateSnapshotIntervalRaw(uint64_t interval_ms) {
+    DCHECK(JsManagerImpl::Instance()->MainThread()->BelongsToCurrentThread());
+    TaskRunner* main_thread = JsManagerImpl::Instance()->MainThread();
+    if (snapshot_timer_ >= 0)
+      main_thread->CancelTimer(snapshot_timer_);
+    snapshot_timer_ = -1;
+    if (interval_ms > 0) {
+      snapshot_timer_ = main_thread->AddRepeatedTimer(
+          interval_ms, std::bind(&Impl::UpdateStateSnapshot, this));
+      UpdateStateSnapshot();
+    }
+  }
+
+  void UpdateStateSnapshot() {
+    DCHECK(JsManagerImpl::Instance()->MainThread()->BelongsToCurrentThread());
+    if (!object_)
+      return;
+
+    std::shared_ptr<StateSnapshot> snapshot(new StateSnapshot);
+    if (!GetStateField("isBuffering", &snapshot->is_buffering) ||
+        !GetStateField("isLive", &snapshot->is_live) ||
+        !GetStateField("isAudioOnly", &snapshot->is_audio_only) ||
+        !GetStateField("seekRange", &snapshot->seek_range) ||
+        !GetStateField("getBufferedInfo", &snapshot->buffered_info) ||
+        !GetStateField("getStats", &snapshot->stats)) {
+      return;
+    }
+    snapshot->valid = true;
+    std::shared_ptr<const StateSnapshot> ret(std::move(snapshot));
+    std::atomic_store(&snapshot_, ret);
+  }
+
+  /** Calls the given getter and stores the converted result in |*field|. */
+  template <typename T>
+  bool GetStateField(const std::string& name, T* field) {
+    LocalVar<JsValue> result;
+    auto error = CallMemberFunction(object_, name, 0, nullptr, &result);
+    if (holds_alternative<Error>(error)) {
+      VLOG(1) << "Error updating state snapshot: " << get<Error>(error).message;
+      return false;
+    }
+    auto converted = Converter<T>::Convert(name, result);
+    if (holds_alternative<Error>(converted))
+      return false;
+    *field = std::move(get<T>(converted));
+    return true;
+  }
+
+  Converter<void>::variant_type SetAbrManagerRaw(AbrManager* abr) {
+    DCHECK(JsManagerImpl::Instance()->MainThread()->BelongsToCurrentThread());
+    if (!object_)
+      return Error("The Player must be initialized first.");
+
+    LocalVar<JsValue> factory;
+    RefPtr<js::NativeAbrManager> bridge;
+    if (abr) {
+      // Shaka Player creates the AbrManager with |new abrFactory()|; since
+      // a constructor that returns an object evaluates to that object, this
+      // wraps the bridge in a function that returns it.
+      bridge = new js::NativeAbrManager(abr, &media_player_);
+      LocalVar<JsValue> function_ctor =
+          GetDescendant(JsEngine::Instance()->global_handle(), {"Function"});
+      LocalVar<JsValue> ctor_args[] = {
+          ToJsValue(std::string("manager")),
+          ToJsValue(std::string("return function() { return manager; };"))};
+      LocalVar<JsValue> make_factory;
+      if (!InvokeConstructor(UnsafeJsCast<JsFunction>(function_ctor), 2,
+                             ctor_args, &make_factory)) {
+        return ConvertError(make_factory);
+      }
+      LocalVar<JsValue> bridge_value = bridge->JsThis();
+      if (!InvokeMethod(UnsafeJsCast<JsFunction>(make_factory),
+                        JsEngine::Instance()->global_handle(), 1,
+                        &bridge_value, &factory)) {
+        return ConvertError(factory);
+      }
+    } else {
+      factory = GetDescendant(JsEngine::Instance()->global_handle(),
+                              {"shaka", "abr", "SimpleAbrManager"});
+    }
+
+    LocalVar<JsObject> config = CreateObject();
+    SetMemberRaw(config, "abrFactory", factory);
+    LocalVar<JsValue> config_value = RawToJsValue(config);
+    LocalVar<JsValue> result;
+    auto error =
+        CallMemberFunction(object_, "configure", 1, &config_value, &result);
+    if (holds_alternative<Error>(error))
+      return get<Error>(error);
+    abr_bridge_ = bridge;
+    return {};
+  }
+
   Converter<void>::future_type SetVideoWhenResolved(
       Converter<void>::future_type future,
-      RefPtr<js::mse::HTMLVideoElement> video) {
+      RefPtr<js::mse::HTMLVideoElement> video, media::MediaPlayer* player) {
     auto then = [=]() -> Converter<void>::variant_type {
       auto results = future.get();
       if (!holds_alternative<Error>(results)) {
         if (video_)
           video_->Detach();
         video_ = video;
+        media_player_.store(player, std::memory_order_release);
       }
       return results;
     };
@@ -251,6 +386,12 @@ class Player::Impl : public JsObjectWrapper {
     net_engine.Init(get<Handle<JsObject>>(results));
 
     auto req_filter = [this](RequestType type, js::Request request) {
+      // Let the network thread prioritize the request by its type.
+      RequestPriorityHints* hints =
+          JsManagerImpl::Instance()->NetworkThread()->priority_hints();
+      for (const std::string& uri : request.uris)
+        hints->Add(uri, type);
+
       Promise ret = Promise::PendingPromise();
       std::shared_ptr<Request> pub_request(new Request(std::move(request)));
       StepNetworkFilter(type, pub_request, filters_.begin(),
@@ -298,14 +439,38 @@ class Player::Impl : public JsObjectWrapper {
 
     // Don't call these with the lock held since they can cause Promises to get
     // handled and can call back into this method.
+    OnFiltersDone(*obj);
     obj->Finalize();
     results.ResolveWith(JsUndefined(), /* run_events= */ false);
   }
 
+  void OnFiltersDone(const Request& request) {
+    // The filters may have added other CDNs; slow requests for one URI can be
+    // hedged to the others.
+    JsManagerImpl::Instance()->NetworkThread()->hedge_policy()->AddAlternates(
+        request.uris);
+  }
+
+  void OnFiltersDone(const Response& /* response */) {}
+
  private:
   RefPtr<js::mse::HTMLVideoElement> video_;
+  // The JavaScript AbrManager that forwards to the native one given to
+  // SetAbrManager, or null if Shaka Player's default is used.
+  RefPtr<js::NativeAbrManager> abr_bridge_;
   Mutex filters_mutex_;
   std::list<NetworkFilters*> filters_;
+  // The MediaPlayer that |video_| uses; this can be read from any thread.
+  std::atomic<media::MediaPlayer*> media_player_;
+  // Whether SetStateSnapshotInterval was called, so the destructor needs to
+  // stop the timer.
+  bool uses_snapshot_ = false;
+  // The timer that updates |snapshot_|, or -1.  This is only used on the main
+  // thread.
+  int snapshot_timer_ = -1;
+  // This is only accessed with std::atomic_load/atomic_store so it can be read
+  // from any thread.
+  std::shared_ptr<const StateSnapshot> snapshot_;
 };
 
 // \cond Doxygen_Skip
@@ -426,10 +591,133 @@ AsyncResults<BufferedRange> Player::SeekRange() const {
   return impl_->CallMethod<BufferedRange>("seekRange");
 }
 
+void Player::IsAudioOnly(AsyncCallback<bool> callback,
+                         AsyncExecutor executor) const {
+  impl_->CallMethodWithCallback<bool>(std::move(callback), std::move(executor),
+                                      "isAudioOnly");
+}
+
+void Player::IsBuffering(AsyncCallback<bool> callback,
+                         AsyncExecutor executor) const {
+  impl_->CallMethodWithCallback<bool>(std::move(callback), std::move(executor),
+                                      "isBuffering");
+}
+
+void Player::IsInProgress(AsyncCallback<bool> callback,
+                          AsyncExecutor executor) const {
+  impl_->CallMethodWithCallback<bool>(std::move(callback), std::move(executor),
+                                      "isInProgress");
+}
+
+void Player::IsLive(AsyncCallback<bool> callback,
+                    AsyncExecutor executor) const {
+  impl_->CallMethodWithCallback<bool>(std::move(callback), std::move(executor),
+                                      "isLive");
+}
+
+void Player::IsTextTrackVisible(AsyncCallback<bool> callback,
+                                AsyncExecutor executor) const {
+  impl_->CallMethodWithCallback<bool>(std::move(callback), std::move(executor),
+                                      "isTextTrackVisible");
+}
+
+void Player::UsingEmbeddedTextTrack(AsyncCallback<bool> callback,
+                                    AsyncExecutor executor) const {
+  impl_->CallMethodWithCallback<bool>(std::move(callback), std::move(executor),
+                                      "usingEmbeddedTextTrack");
+}
+
+void Player::AssetUri(AsyncCallback<optional<std::string>> callback,
+                      AsyncExecutor executor) const {
+  impl_->CallMethodWithCallback<optional<std::string>>(std::move(callback),
+                                                       std::move(executor),
+                                                       "assetUri");
+}
+
+void Player::DrmInfo(AsyncCallback<optional<shaka::DrmInfo>> callback,
+                     AsyncExecutor executor) const {
+  impl_->CallMethodWithCallback<optional<shaka::DrmInfo>>(std::move(callback),
+                                                          std::move(executor),
+                                                          "drmInfo");
+}
+
+void Player::GetAudioLanguagesAndRoles(
+    AsyncCallback<std::vector<LanguageRole>> callback,
+    AsyncExecutor executor) const {
+  impl_->CallMethodWithCallback<std::vector<LanguageRole>>(
+      std::move(callback), std::move(executor), "getAudioLanguagesAndRoles");
+}
+
+void Player::GetBufferedInfo(AsyncCallback<BufferedInfo> callback,
+                             AsyncExecutor executor) const {
+  impl_->CallMethodWithCallback<BufferedInfo>(std::move(callback),
+                                              std::move(executor),
+                                              "getBufferedInfo");
+}
+
+void Player::GetExpiration(AsyncCallback<double> callback,
+                           AsyncExecutor executor) const {
+  impl_->CallMethodWithCallback<double>(
+      std::move(callback), std::move(executor), "getExpiration");
+}
+
+void Player::GetStats(AsyncCallback<Stats> callback,
+                      AsyncExecutor executor) const {
+  impl_->CallMethodWithCallback<Stats>(std::move(callback), std::move(executor),
+                                       "getStats");
+}
+
+void Player::GetTextTracks(AsyncCallback<std::vector<Track>> callback,
+                           AsyncExecutor executor) const {
+  impl_->CallMethodWithCallback<std::vector<Track>>(std::move(callback),
+                                                    std::move(executor),
+                                                    "getTextTracks");
+}
+
+void Player::GetVariantTracks(AsyncCallback<std::vector<Track>> callback,
+                              AsyncExecutor executor) const {
+  impl_->CallMethodWithCallback<std::vector<Track>>(std::move(callback),
+                                                    std::move(executor),
+                                                    "getVariantTracks");
+}
+
+void Player::GetTextLanguagesAndRoles(
+    AsyncCallback<std::vector<LanguageRole>> callback,
+    AsyncExecutor executor) const {
+  impl_->CallMethodWithCallback<std::vector<LanguageRole>>(
+      std::move(callback), std::move(executor), "getTextLanguagesAndRoles");
+}
+
+void Player::KeySystem(AsyncCallback<std::string> callback,
+                       AsyncExecutor executor) const {
+  impl_->CallMethodWithCallback<std::string>(std::move(callback),
+                                             std::move(executor), "keySystem");
+}
+
+void Player::SeekRange(AsyncCallback<BufferedRange> callback,
+                       AsyncExecutor executor) const {
+  impl_->CallMethodWithCallback<BufferedRange>(std::move(callback),
+                                               std::move(executor),
+                                               "seekRange");
+}
+
+void Player::SetStateSnapshotInterval(uint64_t interval_ms) {
+  impl_->SetStateSnapshotInterval(interval_ms);
+}
+
+Player::StateSnapshot Player::GetStateSnapshot() const {
+  return impl_->GetStateSnapshot();
+}
+
+Player::PlaybackPosition Player::GetPlaybackPosition() const {
+  return impl_->GetPlaybackPosition();
+}
+
 
 AsyncResults<void> Player::Load(const std::string& manifest_uri,
                                 double start_time,
                                 const std::string& mime_type) {
+  StartupTracer::Instance.AddMilestone("Player::Load");
   return impl_->CallMethod<void>("load", manifest_uri, LoadHelper(start_time),
                                  mime_type);
 }
@@ -534,6 +822,10 @@ void Player::RemoveNetworkFilters(NetworkFilters* filters) {
   impl_->RemoveNetworkFilters(filters);
 }
 
+AsyncResults<void> Player::SetAbrManager(AbrManager* abr) {
+  return impl_->SetAbrManager(abr);
+}
+
 AsyncResults<bool> Player::Configure(const std::string& name_path,
                                      const uint8_t* data, size_t data_size) {
   return impl_->CallMethod<bool>("configure", name_path,
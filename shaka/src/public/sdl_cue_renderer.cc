@@ -0,0 +1,600 @@
+// Copyright 2020 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     https://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "shaka/sdl_cue_renderer.h"
+
+#include <SDL2/SDL.h>
+#include <glog/logging.h>
+#include <string.h>
+
+#include <algorithm>
+#include <cmath>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "src/util/macros.h"
+
+namespace shaka {
+
+namespace {
+
+/** The size of the glyph atlas texture. */
+constexpr const int kAtlasSize = 1024;
+
+/** The font size, as a fraction of the video height. */
+constexpr const double kFontSizeFraction = 0.05;
+constexpr const int kMinFontSize = 8;
+
+/** The color of the boxes behind each line of text. */
+constexpr const uint8_t kBackgroundAlpha = 204;
+
+constexpr const uint32_t kReplacementCharacter = 0xfffd;
+
+/** The settings of a cue that affect how it is drawn. */
+struct CueState {
+  explicit CueState(const media::VTTCue& cue)
+      : text(cue.text()),
+        line(cue.line()),
+        position(cue.position()),
+        size(cue.size()),
+        snap_to_lines(cue.snap_to_lines()),
+        line_align(cue.line_align()),
+        position_align(cue.position_align()),
+        align(cue.align()) {}
+
+  bool operator==(const CueState& other) const {
+    return text == other.text && SameValue(line, other.line) &&
+           SameValue(position, other.position) && size == other.size &&
+           snap_to_lines == other.snap_to_lines &&
+           line_align == other.line_align &&
+           position_align == other.position_align && align == other.align;
+  }
+
+  /** NAN is used for "auto", so it needs to compare equal to itself. */
+  static bool SameValue(double a, double b) {
+    return a == b || (std::isnan(a) && std::isnan(b));
+  }
+
+  std::string text;
+  double line;
+  double position;
+  double size;
+  bool snap_to_lines;
+  media::LineAlignSetting line_align;
+  media::PositionAlignSetting position_align;
+  media::AlignSetting align;
+};
+
+/**
+ * Decodes the UTF-8 code point at the given position and moves past it.
+ * Invalid bytes are replaced with U+FFFD.
+ */
+uint32_t DecodeUtf8(const std::string& text, size_t* pos) {
+  const uint8_t lead = static_cast<uint8_t>(text[(*pos)++]);
+  if (lead < 0x80)
+    return lead;
+
+  size_t length;
+  uint32_t ret;
+  if (lead >= 0xc2 && lead <= 0xdf) {
+    length = 1;
+    ret = lead & 0x1f;
+  } else if (lead >= 0xe0 && lead <= 0xef) {
+    length = 2;
+    ret = lead & 0x0f;
+  } else if (lead >= 0xf0 && lead <= 0xf4) {
+    length = 3;
+    ret = lead & 0x07;
+  } else {
+    return kReplacementCharacter;
+  }
+
+  for (size_t i = 0; i < length; i++) {
+    if (*pos >= text.size() || (text[*pos] & 0xc0) != 0x80)
+      return kReplacementCharacter;
+    ret = (ret << 6) | (text[(*pos)++] & 0x3f);
+  }
+  return ret;
+}
+
+/**
+ * Converts the cue text into paragraphs of code points.  Markup tags are
+ * removed and character references are decoded.
+ */
+std::vector<std::vector<uint32_t>> ParseCueText(const std::string& text) {
+  struct Reference {
+    const char* name;
+    uint32_t codepoint;
+  };
+  // A codepoint of 0 means the reference is dropped.
+  constexpr const Reference kReferences[] = {
+      {"&amp;", '&'},  {"&lt;", '<'},     {"&gt;", '>'},
+      {"&lrm;", 0},    {"&rlm;", 0},      {"&nbsp;", 0xa0},
+  };
+
+  std::vector<std::vector<uint32_t>> ret(1);
+  size_t pos = 0;
+  while (pos < text.size()) {
+    const char c = text[pos];
+    if (c == '<') {
+      const size_t end = text.find('>', pos);
+      pos = end == std::string::npos ? text.size() : end + 1;
+    } else if (c == '\n') {
+      ret.emplace_back();
+      pos++;
+    } else if (c == '\r') {
+      pos++;
+    } else if (c == '&') {
+      bool found = false;
+      for (const Reference& ref : kReferences) {
+        const size_t length = strlen(ref.name);
+        if (text.compare(pos, length, ref.name) == 0) {
+          if (ref.codepoint)
+            ret.back().emplace_back(ref.codepoint);
+          pos += length;
+          found = true;
+          break;
+        }
+      }
+      if (!found) {
+        ret.back().emplace_back('&');
+        pos++;
+      }
+    } else {
+      ret.back().emplace_back(DecodeUtf8(text, &pos));
+    }
+  }
+  return ret;
+}
+
+}  // namespace
+
+class SdlCueRenderer::Impl {
+ public:
+  explicit Impl(std::shared_ptr<GlyphRasterizer> rasterizer)
+      : rasterizer_(rasterizer),
+        renderer_(nullptr),
+        atlas_(nullptr),
+        output_(nullptr),
+        width_(0),
+        height_(0),
+        font_size_(0),
+        ascent_(0),
+        line_height_(0),
+        shelf_x_(0),
+        shelf_y_(0),
+        shelf_height_(0),
+        valid_(false) {}
+
+  ~Impl() {
+    DestroyTextures();
+  }
+
+  SHAKA_NON_COPYABLE_OR_MOVABLE_TYPE(Impl);
+
+  void SetRenderer(SDL_Renderer* renderer) {
+    DestroyTextures();
+    renderer_ = renderer;
+  }
+
+  void SetSize(uint32_t width, uint32_t height) {
+    if (width == static_cast<uint32_t>(width_) &&
+        height == static_cast<uint32_t>(height_)) {
+      return;
+    }
+
+    DestroyTextures();
+    width_ = static_cast<int>(width);
+    height_ = static_cast<int>(height);
+    const long font_size = std::lround(height * kFontSizeFraction);
+    font_size_ = std::max(kMinFontSize, static_cast<int>(font_size));
+    rasterizer_->GetLineMetrics(font_size_, &ascent_, &line_height_);
+    if (line_height_ <= 0)
+      line_height_ = font_size_;
+  }
+
+  SDL_Texture* Draw(const std::vector<std::shared_ptr<media::VTTCue>>& cues) {
+    std::vector<CueState> states;
+    states.reserve(cues.size());
+    for (auto& cue : cues)
+      states.emplace_back(*cue);
+    if (valid_ && states == states_)
+      return output_;
+
+    states_ = std::move(states);
+    valid_ = false;
+    if (states_.empty())
+      return nullptr;
+    if (!renderer_ || width_ == 0 || height_ == 0) {
+      LOG(DFATAL) << "Must call SetRenderer and SetSize before Draw";
+      return nullptr;
+    }
+    if (!CreateTextures())
+      return nullptr;
+
+    SDL_Texture* old_target = SDL_GetRenderTarget(renderer_);
+    SDL_BlendMode old_blend_mode;
+    uint8_t old_r, old_g, old_b, old_a;
+    SDL_GetRenderDrawBlendMode(renderer_, &old_blend_mode);
+    SDL_GetRenderDrawColor(renderer_, &old_r, &old_g, &old_b, &old_a);
+
+    bool ok = SDL_SetRenderTarget(renderer_, output_) == 0;
+    if (ok) {
+      SDL_SetRenderDrawBlendMode(renderer_, SDL_BLENDMODE_NONE);
+      SDL_SetRenderDrawColor(renderer_, 0, 0, 0, 0);
+      SDL_RenderClear(renderer_);
+      SDL_SetRenderDrawBlendMode(renderer_, SDL_BLENDMODE_BLEND);
+
+      // Cues with an automatic line are stacked up from the bottom.
+      int auto_bottom = height_ - line_height_ / 2;
+      for (const CueState& cue : states_)
+        DrawCue(cue, &auto_bottom);
+    } else {
+      LOG(ERROR) << "Error setting render target: " << SDL_GetError();
+    }
+
+    SDL_SetRenderTarget(renderer_, old_target);
+    SDL_SetRenderDrawBlendMode(renderer_, old_blend_mode);
+    SDL_SetRenderDrawColor(renderer_, old_r, old_g, old_b, old_a);
+    valid_ = ok;
+    return ok ? output_ : nullptr;
+  }
+
+ private:
+  struct CachedGlyph {
+    SDL_Rect rect;
+    int left;
+    int top;
+    int advance;
+  };
+
+  struct Line {
+    std::vector<uint32_t> text;
+    int width = 0;
+  };
+
+  void DestroyTextures() {
+    if (atlas_)
+      SDL_DestroyTexture(atlas_);
+    if (output_)
+      SDL_DestroyTexture(output_);
+    atlas_ = output_ = nullptr;
+    glyphs_.clear();
+    shelf_x_ = shelf_y_ = shelf_height_ = 0;
+    valid_ = false;
+  }
+
+  bool CreateTextures() {
+    if (!atlas_) {
+      atlas_ = SDL_CreateTexture(renderer_, SDL_PIXELFORMAT_ARGB8888,
+                                 SDL_TEXTUREACCESS_STATIC, kAtlasSize,
+                                 kAtlasSize);
+      if (!atlas_) {
+        LOG(ERROR) << "Error creating glyph atlas: " << SDL_GetError();
+        return false;
+      }
+      SDL_SetTextureBlendMode(atlas_, SDL_BLENDMODE_BLEND);
+    }
+    if (!output_) {
+      output_ = SDL_CreateTexture(renderer_, SDL_PIXELFORMAT_ARGB8888,
+                                  SDL_TEXTUREACCESS_TARGET, width_, height_);
+      if (!output_) {
+        LOG(ERROR) << "Error creating cue texture: " << SDL_GetError();
+        return false;
+      }
+      SDL_SetTextureBlendMode(output_, SDL_BLENDMODE_BLEND);
+    }
+    return true;
+  }
+
+  /**
+   * Gets the given glyph, rasterizing it and adding it to the atlas if it
+   * isn't there yet.
+   */
+  bool GetGlyph(uint32_t codepoint, CachedGlyph* result) {
+    auto it = glyphs_.find(codepoint);
+    if (it != glyphs_.end()) {
+      *result = it->second;
+      return true;
+    }
+
+    GlyphRasterizer::Glyph glyph;
+    if (!rasterizer_->RasterizeGlyph(codepoint, font_size_, &glyph)) {
+      if (codepoint == kReplacementCharacter ||
+          !GetGlyph(kReplacementCharacter, result)) {
+        return false;
+      }
+      glyphs_.emplace(codepoint, *result);
+      return true;
+    }
+
+    CachedGlyph cached;
+    cached.rect = {0, 0, 0, 0};
+    cached.left = glyph.left;
+    cached.top = glyph.top;
+    cached.advance = glyph.advance;
+    if (glyph.width > 0 && glyph.height > 0 &&
+        glyph.alpha.size() >= static_cast<size_t>(glyph.width) * glyph.height) {
+      if (!AddToAtlas(glyph, &cached.rect))
+        return false;
+    }
+    glyphs_.emplace(codepoint, cached);
+    *result = cached;
+    return true;
+  }
+
+  /** Copies the given glyph into free space in the atlas. */
+  bool AddToAtlas(const GlyphRasterizer::Glyph& glyph, SDL_Rect* rect) {
+    // Leave a pixel between glyphs so filtering doesn't blend neighbors.
+    const int width = glyph.width + 1;
+    const int height = glyph.height + 1;
+    if (width > kAtlasSize || height > kAtlasSize) {
+      LOG_ONCE(ERROR) << "Glyph too large for the atlas";
+      return false;
+    }
+
+    // Glyphs are packed in rows ("shelves"); start a new one when this one is
+    // full.  When the atlas is full, throw away every glyph and start again.
+    // Anything already drawn is flushed by SDL before the atlas is changed.
+    if (shelf_x_ + width > kAtlasSize) {
+      shelf_x_ = 0;
+      shelf_y_ += shelf_height_;
+      shelf_height_ = 0;
+    }
+    if (shelf_y_ + height > kAtlasSize) {
+      VLOG(1) << "Glyph atlas is full, clearing it";
+      glyphs_.clear();
+      shelf_x_ = shelf_y_ = shelf_height_ = 0;
+    }
+
+    *rect = {shelf_x_, shelf_y_, glyph.width, glyph.height};
+    shelf_x_ += width;
+    shelf_height_ = std::max(shelf_height_, height);
+
+    // The glyphs are stored as white with the coverage as alpha.
+    pixels_.resize(static_cast<size_t>(glyph.width) * glyph.height);
+    for (size_t i = 0; i < pixels_.size(); i++)
+      pixels_[i] = (static_cast<uint32_t>(glyph.alpha[i]) << 24) | 0xffffff;
+    if (SDL_UpdateTexture(atlas_, rect, pixels_.data(),
+                          glyph.width * sizeof(uint32_t)) != 0) {
+      LOG(ERROR) << "Error updating glyph atlas: " << SDL_GetError();
+      return false;
+    }
+    return true;
+  }
+
+  int MeasureText(const std::vector<uint32_t>& text) {
+    int ret = 0;
+    CachedGlyph glyph;
+    for (uint32_t codepoint : text) {
+      if (GetGlyph(codepoint, &glyph))
+        ret += glyph.advance;
+    }
+    return ret;
+  }
+
+  /** Splits the given paragraph into lines no wider than |max_width|. */
+  void WrapText(const std::vector<uint32_t>& paragraph, int max_width,
+                std::vector<Line>* lines) {
+    lines->emplace_back();
+    size_t pos = 0;
+    while (pos < paragraph.size()) {
+      // Each word keeps the space after it.
+      auto space = std::find(paragraph.begin() + pos, paragraph.end(), ' ');
+      const size_t word_end = space == paragraph.end()
+                                  ? paragraph.size()
+                                  : space - paragraph.begin() + 1;
+      std::vector<uint32_t> word(paragraph.begin() + pos,
+                                 paragraph.begin() + word_end);
+      pos = word_end;
+
+      // Trailing spaces don't count towards the width of the line.
+      std::vector<uint32_t> trimmed = word;
+      if (!trimmed.empty() && trimmed.back() == ' ')
+        trimmed.pop_back();
+      const int word_width = MeasureText(word);
+      const int trimmed_width = MeasureText(trimmed);
+
+      Line* line = &lines->back();
+      if (!line->text.empty() && line->width + trimmed_width > max_width) {
+        lines->emplace_back();
+        line = &lines->back();
+      }
+      line->text.insert(line->text.end(), word.begin(), word.end());
+      line->width += word_width;
+    }
+
+    for (Line& line : *lines) {
+      while (!line.text.empty() && line.text.back() == ' ') {
+        line.text.pop_back();
+        line.width = MeasureText(line.text);
+      }
+    }
+  }
+
+  /**
+   * Lays out and draws the given cue.  This follows the WebVTT cue box rules
+   * for horizontal cues.
+   * @see https://w3c.github.io/webvtt/#processing-cue-settings
+   */
+  void DrawCue(const CueState& cue, int* auto_bottom) {
+    using media::AlignSetting;
+    using media::LineAlignSetting;
+    using media::PositionAlignSetting;
+
+    double position = cue.position;
+    if (std::isnan(position)) {
+      if (cue.align == AlignSetting::Left || cue.align == AlignSetting::Start)
+        position = 0;
+      else if (cue.align == AlignSetting::Right ||
+               cue.align == AlignSetting::End)
+        position = 100;
+      else
+        position = 50;
+    }
+    PositionAlignSetting position_align = cue.position_align;
+    if (position_align == PositionAlignSetting::Auto) {
+      if (cue.align == AlignSetting::Left || cue.align == AlignSetting::Start)
+        position_align = PositionAlignSetting::LineLeft;
+      else if (cue.align == AlignSetting::Right ||
+               cue.align == AlignSetting::End)
+        position_align = PositionAlignSetting::LineRight;
+      else
+        position_align = PositionAlignSetting::Center;
+    }
+
+    double max_size;
+    switch (position_align) {
+      case PositionAlignSetting::LineLeft:
+        max_size = 100 - position;
+        break;
+      case PositionAlignSetting::LineRight:
+        max_size = position;
+        break;
+      default:
+        max_size = 2 * std::min(position, 100 - position);
+        break;
+    }
+    const double size = std::max(0.0, std::min(cue.size, max_size));
+    double left;
+    switch (position_align) {
+      case PositionAlignSetting::LineLeft:
+        left = position;
+        break;
+      case PositionAlignSetting::LineRight:
+        left = position - size;
+        break;
+      default:
+        left = position - size / 2;
+        break;
+    }
+
+    const int padding = font_size_ / 4;
+    const int box_x = static_cast<int>(left * width_ / 100);
+    const int box_width = static_cast<int>(size * width_ / 100);
+    std::vector<Line> lines;
+    for (auto& paragraph : ParseCueText(cue.text))
+      WrapText(paragraph, std::max(0, box_width - 2 * padding), &lines);
+    const int box_height = static_cast<int>(lines.size()) * line_height_;
+
+    int box_y;
+    if (std::isnan(cue.line)) {
+      box_y = *auto_bottom - box_height;
+      *auto_bottom = box_y;
+    } else if (cue.snap_to_lines) {
+      // Negative line numbers count up from the bottom, -1 being the last.
+      const int line = static_cast<int>(cue.line);
+      if (line >= 0)
+        box_y = line * line_height_;
+      else
+        box_y = height_ + (line + 1) * line_height_ - box_height;
+    } else {
+      box_y = static_cast<int>(cue.line * height_ / 100);
+      if (cue.line_align == LineAlignSetting::Center)
+        box_y -= box_height / 2;
+      else if (cue.line_align == LineAlignSetting::End)
+        box_y -= box_height;
+    }
+    box_y = std::max(0, std::min(box_y, height_ - box_height));
+
+    for (size_t i = 0; i < lines.size(); i++) {
+      const Line& line = lines[i];
+      const int free_space = box_width - 2 * padding - line.width;
+      int x = box_x + padding;
+      if (cue.align == AlignSetting::Center)
+        x += free_space / 2;
+      else if (cue.align == AlignSetting::End ||
+               cue.align == AlignSetting::Right)
+        x += free_space;
+      x = std::max(padding, std::min(x, width_ - padding - line.width));
+      const int y = box_y + static_cast<int>(i) * line_height_;
+
+      if (!line.text.empty()) {
+        const SDL_Rect background = {x - padding, y, line.width + 2 * padding,
+                                     line_height_};
+        SDL_SetRenderDrawColor(renderer_, 0, 0, 0, kBackgroundAlpha);
+        SDL_RenderFillRect(renderer_, &background);
+      }
+
+      CachedGlyph glyph;
+      for (uint32_t codepoint : line.text) {
+        if (!GetGlyph(codepoint, &glyph))
+          continue;
+        if (glyph.rect.w > 0) {
+          const SDL_Rect dest = {x + glyph.left, y + ascent_ - glyph.top,
+                                 glyph.rect.w, glyph.rect.h};
+          SDL_RenderCopy(renderer_, atlas_, &glyph.rect, &dest);
+        }
+        x += glyph.advance;
+      }
+    }
+  }
+
+  const std::shared_ptr<GlyphRasterizer> rasterizer_;
+  SDL_Renderer* renderer_;
+  SDL_Texture* atlas_;
+  SDL_Texture* output_;
+  int width_;
+  int height_;
+  int font_size_;
+  int ascent_;
+  int line_height_;
+
+  std::unordered_map<uint32_t, CachedGlyph> glyphs_;
+  // The position of the next glyph in the atlas.
+  int shelf_x_;
+  int shelf_y_;
+  int shelf_height_;
+  // A buffer used to convert glyphs before uploading them.
+  std::vector<uint32_t> pixels_;
+
+  // The cues that were drawn to |output_|.
+  std::vector<CueState> states_;
+  // Whether |output_| holds |states_|.
+  bool valid_;
+};
+
+
+SdlCueRenderer::GlyphRasterizer::Glyph::Glyph()
+    : width(0), height(0), left(0), top(0), advance(0) {}
+SdlCueRenderer::GlyphRasterizer::Glyph::~Glyph() {}
+
+SdlCueRenderer::GlyphRasterizer::~GlyphRasterizer() {}
+
+
+SdlCueRenderer::SdlCueRenderer(std::shared_ptr<GlyphRasterizer> rasterizer)
+    : impl_(new Impl(rasterizer)) {}
+SdlCueRenderer::SdlCueRenderer(SdlCueRenderer&&) = default;
+SdlCueRenderer::~SdlCueRenderer() {}
+SdlCueRenderer& SdlCueRenderer::operator=(SdlCueRenderer&&) = default;
+
+void SdlCueRenderer::SetRenderer(SDL_Renderer* renderer) {
+  impl_->SetRenderer(renderer);
+}
+
+void SdlCueRenderer::SetSize(uint32_t width, uint32_t height) {
+  impl_->SetSize(width, height);
+}
+
+SDL_Texture* SdlCueRenderer::Draw(const media::TextTrack& track, double time) {
+  return impl_->Draw(track.active_cues(time));
+}
+
+SDL_Texture* SdlCueRenderer::Draw(
+    const std::vector<std::shared_ptr<media::VTTCue>>& cues) {
+  return impl_->Draw(cues);
+}
+
+}  // namespace shaka
@@ -16,12 +16,19 @@
 
 #include <SDL2/SDL.h>
 #ifdef __APPLE__
+#  include <TargetConditionals.h>
 #  include <VideoToolbox/VideoToolbox.h>
 #endif
 
 #include <list>
 #include <unordered_set>
+#include <vector>
 
+#if defined(__APPLE__) && TARGET_OS_OSX
+#  include "src/media/apple/sdl_iosurface_drawer.h"
+#  define HAS_IOSURFACE_DRAWER
+#endif
+#include "src/media/pixel_conversion.h"
 #include "src/util/macros.h"
 
 namespace shaka {
@@ -30,11 +37,15 @@ namespace {
 
 constexpr const size_t kMaxTextures = 8;
 
+/** The largest power of two to downscale frames by while uploading them. */
+constexpr const unsigned int kMaxDownscaleShift = 3;
+
 struct TextureInfo {
-  TextureInfo(SDL_Texture* texture, uint32_t pixel_format, int width,
-              int height)
+  TextureInfo(SDL_Texture* texture, uint32_t pixel_format, int access,
+              int width, int height)
       : texture(texture),
         pixel_format(pixel_format),
+        access(access),
         width(width),
         height(height) {}
 
@@ -46,8 +57,12 @@ struct TextureInfo {
 
   SDL_Texture* texture;
   uint32_t pixel_format;
+  int access;
   int width;
   int height;
+  // The frame that was uploaded to the texture.  This is a weak pointer so a
+  // new frame that reuses the same memory isn't mistaken for this one.
+  std::weak_ptr<media::DecodedFrame> frame;
 };
 
 
@@ -59,9 +74,11 @@ Uint32 SdlPixelFormatFromPublic(
     case media::PixelFormat::VideoToolbox:
 #  endif
     case media::PixelFormat::NV12:
+    case media::PixelFormat::P010:
       return SDL_PIXELFORMAT_NV12;
 #endif
     case media::PixelFormat::YUV420P:
+    case media::PixelFormat::YUV420P10:
       return SDL_PIXELFORMAT_IYUV;
     case media::PixelFormat::RGB24:
       return SDL_PIXELFORMAT_RGB24;
@@ -76,12 +93,17 @@ Uint32 SdlPixelFormatFromPublic(
 
 class SdlFrameDrawer::Impl {
  public:
-  Impl() : renderer_(nullptr) {}
+  Impl()
+      : renderer_(nullptr),
+        current_(nullptr),
+        max_frame_width_(0),
+        max_frame_height_(0) {}
   ~Impl() {}
 
   SHAKA_NON_COPYABLE_OR_MOVABLE_TYPE(Impl);
 
   void SetRenderer(SDL_Renderer* renderer) {
+    current_ = nullptr;
     textures_.clear();
     texture_formats_.clear();
     renderer_ = renderer;
@@ -97,36 +119,215 @@ class SdlFrameDrawer::Impl {
         LOG(DFATAL) << "No supported texture formats";
       }
     }
+
+#ifdef HAS_IOSURFACE_DRAWER
+    iosurface_drawer_.Reset();
+    use_iosurface_ =
+        media::apple::SdlIOSurfaceDrawer::IsRendererSupported(renderer) &&
+        texture_formats_.count(SDL_PIXELFORMAT_ARGB8888) > 0;
+#endif
+  }
+
+  void SetMaxFrameSize(uint32_t width, uint32_t height) {
+    max_frame_width_ = width;
+    max_frame_height_ = height;
+  }
+
+  std::vector<media::PixelFormat> GetPreferredPixelFormats() const {
+    // SDL doesn't have 10-bit textures, so those formats are never listed.
+    // VideoToolbox frames are used directly, so they are preferred.
+    std::vector<media::PixelFormat> ret;
+#ifdef __APPLE__
+#  ifdef HAS_IOSURFACE_DRAWER
+    if (use_iosurface_ || texture_formats_.count(SDL_PIXELFORMAT_NV12) > 0)
+#  else
+    if (texture_formats_.count(SDL_PIXELFORMAT_NV12) > 0)
+#  endif
+      ret.emplace_back(media::PixelFormat::VideoToolbox);
+#endif
+    for (auto format : {media::PixelFormat::YUV420P, media::PixelFormat::NV12,
+                        media::PixelFormat::RGB24}) {
+      if (texture_formats_.count(SdlPixelFormatFromPublic(format)) > 0)
+        ret.emplace_back(format);
+    }
+    return ret;
   }
 
   SDL_Texture* Draw(std::shared_ptr<media::DecodedFrame> frame) {
     if (!frame)
       return nullptr;
 
+    // The frame may have already been uploaded by Prepare or by an earlier
+    // call; a frame is usually drawn several times while it is current.
+    TextureInfo* info = FindTexture(frame);
+    if (!info)
+      info = Upload(frame);
+    if (!info)
+      return nullptr;
+
+    current_ = info;
+    return info->texture;
+  }
+
+  bool Prepare(std::shared_ptr<media::DecodedFrame> frame) {
+    return frame && (FindTexture(frame) || Upload(frame));
+  }
+
+ private:
+  TextureInfo* FindTexture(std::shared_ptr<media::DecodedFrame> frame) {
+    for (auto it = textures_.begin(); it != textures_.end(); it++) {
+      if (it->frame.lock() == frame) {
+        MarkUsed(it);
+        return &textures_.back();
+      }
+    }
+    return nullptr;
+  }
+
+  TextureInfo* Upload(std::shared_ptr<media::DecodedFrame> frame) {
+#ifdef HAS_IOSURFACE_DRAWER
+    if (use_iosurface_ && get<media::PixelFormat>(frame->format) ==
+                              media::PixelFormat::VideoToolbox) {
+      // Convert the frame on the GPU so it never needs to be read back.
+      TextureInfo* info =
+          GetTexture(SDL_PIXELFORMAT_ARGB8888, SDL_TEXTUREACCESS_TARGET,
+                     frame->stream_info->width, frame->stream_info->height);
+      auto* pix_buf = reinterpret_cast<CVPixelBufferRef>(
+          const_cast<uint8_t*>(frame->data[0]));
+      if (info && iosurface_drawer_.Draw(renderer_, info->texture, pix_buf)) {
+        info->frame = frame;
+        return info;
+      }
+
+      LOG(WARNING) << "Unable to draw IOSurface directly, falling back to "
+                      "copying frames";
+      use_iosurface_ = false;
+    }
+#endif
+
+    if (get<media::PixelFormat>(frame->format) ==
+        media::PixelFormat::SecureSurface) {
+      // The CPU can't read these, so they can't be uploaded to a texture.
+      LOG_ONCE(ERROR) << "Secure frames can't be drawn with SDL";
+      return nullptr;
+    }
+
     auto sdl_pix_fmt = SdlPixelFormatFromPublic(frame->format);
     if (sdl_pix_fmt == SDL_PIXELFORMAT_UNKNOWN ||
         texture_formats_.count(sdl_pix_fmt) == 0) {
       return nullptr;
     }
 
-    SDL_Texture* texture = GetTexture(sdl_pix_fmt, frame->stream_info->width,
-                                      frame->stream_info->height);
-    if (!texture)
-      return nullptr;
+    const unsigned int shift = GetDownscaleShift(*frame);
+    if (shift > 0) {
+      const uint32_t block = 1u << shift;
+      TextureInfo* info = GetTexture(
+          sdl_pix_fmt, SDL_TEXTUREACCESS_STREAMING,
+          (frame->stream_info->width + block - 1) >> shift,
+          (frame->stream_info->height + block - 1) >> shift);
+      if (!info || !DownscaleOntoTexture(frame, info, shift))
+        return nullptr;
+      info->frame = frame;
+      return info;
+    }
 
-    if (!DrawOntoTexture(frame, texture, sdl_pix_fmt))
+    TextureInfo* info =
+        GetTexture(sdl_pix_fmt, SDL_TEXTUREACCESS_STREAMING,
+                   frame->stream_info->width, frame->stream_info->height);
+    if (!info || !DrawOntoTexture(frame, info->texture, sdl_pix_fmt))
       return nullptr;
 
-    return texture;
+    info->frame = frame;
+    return info;
+  }
+
+  /** @return The power of two to downscale the frame by while uploading. */
+  unsigned int GetDownscaleShift(const media::DecodedFrame& frame) const {
+    const auto pix_fmt = get<media::PixelFormat>(frame.format);
+    if (max_frame_width_ == 0 || max_frame_height_ == 0 ||
+        (pix_fmt != media::PixelFormat::YUV420P &&
+         pix_fmt != media::PixelFormat::NV12)) {
+      return 0;
+    }
+
+    // Keep the texture at least as large as it is drawn.
+    unsigned int shift = 0;
+    while (shift < kMaxDownscaleShift &&
+           (frame.stream_info->width >> (shift + 1)) >= max_frame_width_ &&
+           (frame.stream_info->height >> (shift + 1)) >= max_frame_height_) {
+      shift++;
+    }
+    return shift;
+  }
+
+  bool DownscaleOntoTexture(std::shared_ptr<media::DecodedFrame> frame,
+                            TextureInfo* info, unsigned int shift) {
+    uint8_t* pixels;
+    int pitch;
+    if (SDL_LockTexture(info->texture, nullptr,
+                        reinterpret_cast<void**>(&pixels), &pitch) < 0) {
+      LOG(DFATAL) << "Error locking texture: " << SDL_GetError();
+      return false;
+    }
+
+    // The locked planes are contiguous, like in DrawOntoTexture.
+    const uint32_t width = frame->stream_info->width;
+    const uint32_t height = frame->stream_info->height;
+    const uint32_t chroma_width = (width + 1) / 2;
+    const uint32_t chroma_height = (height + 1) / 2;
+    media::DownscalePlane(frame->data[0], frame->linesize[0], width, height, 1,
+                          shift, pixels, pitch);
+    uint8_t* chroma = pixels + pitch * info->height;
+    if (get<media::PixelFormat>(frame->format) == media::PixelFormat::NV12) {
+      media::DownscalePlane(frame->data[1], frame->linesize[1], chroma_width,
+                            chroma_height, 2, shift, chroma,
+                            (pitch + 1) / 2 * 2);
+    } else {
+      const size_t chroma_pitch = (pitch + 1) / 2;
+      const size_t dest_chroma_height = (info->height + 1) / 2;
+      media::DownscalePlane(frame->data[1], frame->linesize[1], chroma_width,
+                            chroma_height, 1, shift, chroma, chroma_pitch);
+      media::DownscalePlane(frame->data[2], frame->linesize[2], chroma_width,
+                            chroma_height, 1, shift,
+                            chroma + chroma_pitch * dest_chroma_height,
+                            chroma_pitch);
+    }
+
+    SDL_UnlockTexture(info->texture);
+    return true;
   }
 
- private:
   bool DrawOntoTexture(std::shared_ptr<media::DecodedFrame> frame,
                        SDL_Texture* texture, Uint32 sdl_pix_fmt) {
     const uint8_t* const* frame_data = frame->data.data();
     const size_t* frame_linesize = frame->linesize.data();
-
-    if (sdl_pix_fmt == SDL_PIXELFORMAT_IYUV) {
+    const auto pix_fmt = get<media::PixelFormat>(frame->format);
+    const uint32_t width = frame->stream_info->width;
+    const uint32_t height = frame->stream_info->height;
+    const uint32_t chroma_width = (width + 1) / 2;
+    const uint32_t chroma_height = (height + 1) / 2;
+
+    if (pix_fmt == media::PixelFormat::YUV420P10) {
+      // SDL doesn't support 10-bit textures, so convert to 8-bit while copying
+      // into the texture.  The locked IYUV planes are contiguous.
+      uint8_t* pixels;
+      int pitch;
+      if (SDL_LockTexture(texture, nullptr, reinterpret_cast<void**>(&pixels),
+                          &pitch) < 0) {
+        LOG(DFATAL) << "Error locking texture: " << SDL_GetError();
+        return false;
+      }
+      const size_t chroma_pitch = (pitch + 1) / 2;
+      uint8_t* u_plane = pixels + pitch * height;
+      uint8_t* v_plane = u_plane + chroma_pitch * chroma_height;
+      media::ConvertPlane16To8(frame_data[0], frame_linesize[0], pixels, pitch,
+                               width, height, 2);
+      media::ConvertPlane16To8(frame_data[1], frame_linesize[1], u_plane,
+                               chroma_pitch, chroma_width, chroma_height, 2);
+      media::ConvertPlane16To8(frame_data[2], frame_linesize[2], v_plane,
+                               chroma_pitch, chroma_width, chroma_height, 2);
+      SDL_UnlockTexture(texture);
+    } else if (sdl_pix_fmt == SDL_PIXELFORMAT_IYUV) {
       if (SDL_UpdateYUVTexture(
               texture, nullptr, frame_data[0], frame_linesize[0], frame_data[1],
               frame_linesize[1], frame_data[2], frame_linesize[2]) < 0) {
@@ -135,8 +336,7 @@ class SdlFrameDrawer::Impl {
       }
 #if SDL_VERSION_ATLEAST(2, 0, 4)
 #  ifdef __APPLE__
-    } else if (get<media::PixelFormat>(frame->format) ==
-               media::PixelFormat::VideoToolbox) {
+    } else if (pix_fmt == media::PixelFormat::VideoToolbox) {
       auto* pix_buf = reinterpret_cast<CVPixelBufferRef>(
           const_cast<uint8_t*>(frame->data[0]));
       uint8_t* pixels;
@@ -146,9 +346,7 @@ class SdlFrameDrawer::Impl {
         LOG(DFATAL) << "Error locking texture: " << SDL_GetError();
         return false;
       }
-      if (static_cast<size_t>(pitch) !=
-              CVPixelBufferGetBytesPerRowOfPlane(pix_buf, 0) ||
-          !CVPixelBufferIsPlanar(pix_buf) ||
+      if (!CVPixelBufferIsPlanar(pix_buf) ||
           CVPixelBufferGetPlaneCount(pix_buf) != 2) {
         LOG(DFATAL) << "Invalid pixel buffer";
         SDL_UnlockTexture(texture);
@@ -161,10 +359,27 @@ class SdlFrameDrawer::Impl {
         return false;
       }
 
-      const size_t size0 = pitch * frame->stream_info->height;
-      memcpy(pixels, CVPixelBufferGetBaseAddressOfPlane(pix_buf, 0), size0);
-      memcpy(pixels + size0, CVPixelBufferGetBaseAddressOfPlane(pix_buf, 1),
-             size0 / 2);
+      const auto* y_plane = reinterpret_cast<const uint8_t*>(
+          CVPixelBufferGetBaseAddressOfPlane(pix_buf, 0));
+      const auto* uv_plane = reinterpret_cast<const uint8_t*>(
+          CVPixelBufferGetBaseAddressOfPlane(pix_buf, 1));
+      const size_t y_stride = CVPixelBufferGetBytesPerRowOfPlane(pix_buf, 0);
+      const size_t uv_stride = CVPixelBufferGetBytesPerRowOfPlane(pix_buf, 1);
+      const OSType type = CVPixelBufferGetPixelFormatType(pix_buf);
+      if (type == kCVPixelFormatType_420YpCbCr10BiPlanarVideoRange ||
+          type == kCVPixelFormatType_420YpCbCr10BiPlanarFullRange) {
+        // 10-bit buffers are laid out like P010; SDL doesn't have 10-bit
+        // textures, so these need to be reduced to 8 bits.
+        media::ConvertPlane16To8(y_plane, y_stride, pixels, pitch, width,
+                                 height, 8);
+        media::ConvertPlane16To8(uv_plane, uv_stride, pixels + pitch * height,
+                                 (pitch + 1) / 2 * 2, chroma_width * 2,
+                                 chroma_height, 8);
+      } else {
+        media::CopyPlane(y_plane, y_stride, pixels, pitch, width, height);
+        media::CopyPlane(uv_plane, uv_stride, pixels + pitch * height,
+                         (pitch + 1) / 2 * 2, chroma_width * 2, chroma_height);
+      }
 
       CVPixelBufferUnlockBaseAddress(pix_buf, kCVPixelBufferLock_ReadOnly);
       SDL_UnlockTexture(texture);
@@ -179,26 +394,20 @@ class SdlFrameDrawer::Impl {
         return false;
       }
 
-      if (static_cast<size_t>(pitch) == frame_linesize[0]) {
-        // TODO: Sometimes there is a green bar at the bottom.
-        const size_t size0 = pitch * frame->stream_info->height;
-        memcpy(pixels, frame_data[0], size0);
-        memcpy(pixels + size0, frame_data[1], size0 / 2);
+      // FFmpeg may add padding to the rows, which is dropped when the strides
+      // differ.  The interleaved U/V plane follows the Y plane.
+      const size_t uv_pitch = (pitch + 1) / 2 * 2;
+      uint8_t* uv_plane = pixels + pitch * height;
+      if (pix_fmt == media::PixelFormat::P010) {
+        media::ConvertPlane16To8(frame_data[0], frame_linesize[0], pixels,
+                                 pitch, width, height, 8);
+        media::ConvertPlane16To8(frame_data[1], frame_linesize[1], uv_plane,
+                                 uv_pitch, chroma_width * 2, chroma_height, 8);
       } else {
-        // FFmpeg may add padding to the rows, so we need to drop it by manually
-        // copying each line.
-        DCHECK_GE(frame_linesize[0], pitch);
-        const int min_width = std::min<size_t>(pitch, frame_linesize[0]);
-        for (uint32_t row = 0; row < frame->stream_info->height; row++) {
-          uint8_t* dest = pixels + pitch * row;
-          const uint8_t* src = frame_data[0] + frame_linesize[0] * row;
-          memcpy(dest, src, min_width);
-        }
-        for (uint32_t row = 0; row < frame->stream_info->height / 2; row++) {
-          uint8_t* dest = pixels + pitch * (row + frame->stream_info->height);
-          const uint8_t* src = frame_data[1] + frame_linesize[1] * row;
-          memcpy(dest, src, min_width);
-        }
+        media::CopyPlane(frame_data[0], frame_linesize[0], pixels, pitch,
+                         width, height);
+        media::CopyPlane(frame_data[1], frame_linesize[1], uv_plane, uv_pitch,
+                         chroma_width * 2, chroma_height);
       }
 
       SDL_UnlockTexture(texture);
@@ -214,40 +423,62 @@ class SdlFrameDrawer::Impl {
     return true;
   }
 
-  SDL_Texture* GetTexture(Uint32 pixel_format, int width, int height) {
+  void MarkUsed(std::list<TextureInfo>::iterator it) {
+    if (std::next(it) != textures_.end()) {
+      // Move the texture to the end so elements at the beginning are ones
+      // that were least-recently used.
+      textures_.splice(textures_.end(), textures_, it);
+    }
+  }
+
+  /**
+   * Gets a texture to upload a new frame to.  This never returns the texture
+   * that is currently being displayed, so the textures act as a ring where the
+   * next frame can be uploaded while the current one is still shown.
+   */
+  TextureInfo* GetTexture(Uint32 pixel_format, int access, int width,
+                          int height) {
     if (!renderer_)
       return nullptr;
 
     for (auto it = textures_.begin(); it != textures_.end(); it++) {
-      if (it->pixel_format == pixel_format && it->width == width &&
-          it->height == height) {
-        if (std::next(it) != textures_.end()) {
-          // Move the texture to the end so elements at the beginning are ones
-          // that were least-recently used.
-          textures_.splice(textures_.end(), textures_, it);
-        }
-
-        return it->texture;
+      if (&*it != current_ && it->pixel_format == pixel_format &&
+          it->access == access && it->width == width && it->height == height) {
+        it->frame.reset();
+        MarkUsed(it);
+        return &textures_.back();
       }
     }
 
-    while (!textures_.empty() && textures_.size() >= kMaxTextures) {
-      textures_.erase(textures_.begin());
+    for (auto it = textures_.begin();
+         it != textures_.end() && textures_.size() >= kMaxTextures;) {
+      if (&*it == current_)
+        it++;
+      else
+        it = textures_.erase(it);
     }
 
-    SDL_Texture* texture = SDL_CreateTexture(
-        renderer_, pixel_format, SDL_TEXTUREACCESS_STREAMING, width, height);
-    if (texture)
-      textures_.emplace_back(texture, pixel_format, width, height);
-    else
+    SDL_Texture* texture =
+        SDL_CreateTexture(renderer_, pixel_format, access, width, height);
+    if (!texture) {
       LOG(DFATAL) << "Error creating texture: " << SDL_GetError();
-
-    return texture;
+      return nullptr;
+    }
+    textures_.emplace_back(texture, pixel_format, access, width, height);
+    return &textures_.back();
   }
 
   std::list<TextureInfo> textures_;
   std::unordered_set<Uint32> texture_formats_;
   SDL_Renderer* renderer_;
+  // The texture that was returned from the last call to Draw.
+  TextureInfo* current_;
+  uint32_t max_frame_width_;
+  uint32_t max_frame_height_;
+#ifdef HAS_IOSURFACE_DRAWER
+  media::apple::SdlIOSurfaceDrawer iosurface_drawer_;
+  bool use_iosurface_ = false;
+#endif
 };
 
 SdlFrameDrawer::SdlFrameDrawer() : impl_(new Impl) {}
@@ -259,8 +490,21 @@ void SdlFrameDrawer::SetRenderer(SDL_Renderer* renderer) {
   impl_->SetRenderer(renderer);
 }
 
+void SdlFrameDrawer::SetMaxFrameSize(uint32_t width, uint32_t height) {
+  impl_->SetMaxFrameSize(width, height);
+}
+
+std::vector<media::PixelFormat> SdlFrameDrawer::GetPreferredPixelFormats()
+    const {
+  return impl_->GetPreferredPixelFormats();
+}
+
 SDL_Texture* SdlFrameDrawer::Draw(std::shared_ptr<media::DecodedFrame> frame) {
   return impl_->Draw(frame);
 }
 
+bool SdlFrameDrawer::Prepare(std::shared_ptr<media::DecodedFrame> frame) {
+  return impl_->Prepare(frame);
+}
+
 }  // namespace shaka
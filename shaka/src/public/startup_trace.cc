@@ -0,0 +1,37 @@
+// Copyright 2020 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     https://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "shaka/startup_trace.h"
+
+#include "src/debug/startup_tracer.h"
+
+namespace shaka {
+
+std::vector<StartupTrace::Event> StartupTrace::GetEvents() {
+  return StartupTracer::Instance.GetEvents();
+}
+
+std::string StartupTrace::GetChromeTraceJson() {
+  return StartupTracer::Instance.GetChromeTraceJson();
+}
+
+void StartupTrace::AddMilestone(const std::string& name) {
+  StartupTracer::Instance.AddMilestone(name);
+}
+
+void StartupTrace::Reset() {
+  StartupTracer::Instance.Reset();
+}
+
+}  // namespace shaka
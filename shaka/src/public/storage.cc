@@ -14,7 +14,11 @@
 
 #include "shaka/storage.h"
 
+#include <future>
+#include <memory>
+
 #include "src/core/js_object_wrapper.h"
+#include "src/core/offline_index.h"
 #include "src/js/offline_externs.h"
 #include "src/mapping/any.h"
 #include "src/mapping/names.h"
@@ -39,6 +43,34 @@ void Storage::Client::OnProgress(StoredContent /* content */,
                                  double /* progress */) {}
 
 
+namespace {
+
+OfflineIndex::Entry ToIndexEntry(const StoredContent& content) {
+  js::StoredContent internal = content.GetInternal();
+  OfflineIndex::Entry ret;
+  ret.offline_uri = std::move(internal.offlineUri);
+  ret.original_manifest_uri = std::move(internal.originalManifestUri);
+  ret.duration = internal.duration;
+  ret.size = internal.size;
+  ret.expiration = internal.expiration;
+  ret.app_metadata = std::move(internal.appMetadata);
+  return ret;
+}
+
+StoredContent FromIndexEntry(const OfflineIndex::Entry& entry) {
+  js::StoredContent ret;
+  ret.offlineUri = entry.offline_uri;
+  ret.originalManifestUri = entry.original_manifest_uri;
+  ret.duration = entry.duration;
+  ret.size = entry.size;
+  ret.expiration = entry.expiration;
+  ret.appMetadata = entry.app_metadata;
+  return StoredContent(std::move(ret));
+}
+
+}  // namespace
+
+
 class Storage::Impl : public JsObjectWrapper {
  public:
   Impl(JsManager* engine, const Global<JsObject>* player) : player_(player) {
@@ -91,11 +123,29 @@ class Storage::Impl : public JsObjectWrapper {
 
       return monostate();
     };
-    return JsManagerImpl::Instance()
-        ->MainThread()
-        ->AddInternalTask(TaskPriority::Internal, "Storage ctor",
-                          std::move(callback))
-        ->future();
+    return JsManagerImpl::Instance()->MainThread()->InvokeOrSchedule(
+        std::move(callback));
+  }
+
+  /**
+   * Calls the given member method and calls |on_done| with the results on the
+   * JS main thread before the returned future is resolved.
+   */
+  template <typename Ret, typename... Args>
+  typename Converter<Ret>::future_type CallMethodThen(
+      std::function<void(const typename Converter<Ret>::variant_type&)>
+          on_done,
+      const std::string& name, Args&&... args) const {
+    auto promise =
+        std::make_shared<std::promise<typename Converter<Ret>::variant_type>>();
+    auto callback =
+        [promise, on_done](const typename Converter<Ret>::variant_type& ret) {
+          on_done(ret);
+          promise->set_value(ret);
+        };
+    CallMethodWithCallback<Ret>(std::move(callback), nullptr, name,
+                                std::forward<Args>(args)...);
+    return promise->get_future().share();
   }
 
  private:
@@ -119,6 +169,8 @@ AsyncResults<bool> Storage::Support(JsManager* engine) {
 
 AsyncResults<void> Storage::DeleteAll(JsManager* engine) {
   DCHECK(engine);
+  // This is rare, so just list the (now empty) database again afterwards.
+  OfflineIndex::Instance.Invalidate();
   return Impl::CallGlobalMethod<void>(
       {"shaka", "offline", "Storage", "deleteAll"});
 }
@@ -156,11 +208,44 @@ AsyncResults<bool> Storage::Configure(const std::string& name_path,
 }
 
 AsyncResults<std::vector<StoredContent>> Storage::List() {
-  return impl_->CallMethod<std::vector<StoredContent>>("list");
+  using variant_type = AsyncResults<std::vector<StoredContent>>::variant_type;
+
+  // Listing through JavaScript reads every stored manifest, so use the index
+  // when it is up to date.
+  std::vector<OfflineIndex::Entry> entries;
+  if (OfflineIndex::Instance.GetAll(&entries)) {
+    std::vector<StoredContent> ret;
+    ret.reserve(entries.size());
+    for (auto& entry : entries)
+      ret.emplace_back(FromIndexEntry(entry));
+    std::promise<variant_type> promise;
+    promise.set_value(std::move(ret));
+    return promise.get_future().share();
+  }
+
+  const uint64_t generation = OfflineIndex::Instance.GetGeneration();
+  auto on_done = [generation](const variant_type& results) {
+    if (holds_alternative<Error>(results))
+      return;
+    std::vector<OfflineIndex::Entry> entries;
+    for (auto& content : get<std::vector<StoredContent>>(results))
+      entries.emplace_back(ToIndexEntry(content));
+    OfflineIndex::Instance.Reset(entries, generation);
+  };
+  return impl_->CallMethodThen<std::vector<StoredContent>>(std::move(on_done),
+                                                           "list");
 }
 
 AsyncResults<void> Storage::Remove(const std::string& content_uri) {
-  return impl_->CallMethod<void>("remove", content_uri);
+  OfflineIndex::Instance.BeginUpdate();
+  auto on_done = [content_uri](const AsyncResults<void>::variant_type& ret) {
+    if (holds_alternative<Error>(ret))
+      OfflineIndex::Instance.FailUpdate();
+    else
+      OfflineIndex::Instance.FinishRemove(content_uri);
+  };
+  return impl_->CallMethodThen<void>(std::move(on_done), "remove",
+                                     content_uri);
 }
 
 AsyncResults<bool> Storage::RemoveEmeSessions() {
@@ -168,13 +253,21 @@ AsyncResults<bool> Storage::RemoveEmeSessions() {
 }
 
 AsyncResults<StoredContent> Storage::Store(const std::string& uri) {
-  return impl_->CallMethod<StoredContent>("store", uri);
+  return Store(uri, {});
 }
 
 AsyncResults<StoredContent> Storage::Store(
     const std::string& uri,
     const std::unordered_map<std::string, std::string>& app_metadata) {
-  return impl_->CallMethod<StoredContent>("store", uri, app_metadata);
+  OfflineIndex::Instance.BeginUpdate();
+  auto on_done = [](const AsyncResults<StoredContent>::variant_type& ret) {
+    if (holds_alternative<Error>(ret))
+      OfflineIndex::Instance.FailUpdate();
+    else
+      OfflineIndex::Instance.FinishStore(ToIndexEntry(get<StoredContent>(ret)));
+  };
+  return impl_->CallMethodThen<StoredContent>(std::move(on_done), "store", uri,
+                                              app_metadata);
 }
 
 }  // namespace shaka
@@ -0,0 +1,81 @@
+// Copyright 2020 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     https://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef SHAKA_EMBEDDED_PUBLIC_URL_SESSION_SCHEME_PLUGIN_H_
+#define SHAKA_EMBEDDED_PUBLIC_URL_SESSION_SCHEME_PLUGIN_H_
+
+#include <functional>
+#include <future>
+#include <memory>
+#include <string>
+
+#include "shaka/net.h"
+#include "src/util/macros.h"
+
+namespace shaka {
+
+/**
+ * A scheme plugin for "http" and "https" that uses NSURLSession.  While
+ * content is being stored, segment requests use a background session so the
+ * transfers continue while the app is suspended.  The OS downloads those to a
+ * file, which is mapped into the response instead of being read into memory.
+ * Every other request uses a default session.
+ *
+ * Note the JavaScript that starts the next request doesn't run while the app
+ * is suspended, so only the segments that were already requested finish in
+ * the background.
+ */
+class UrlSessionSchemePlugin final : public SchemePlugin {
+ public:
+  /**
+   * @param identifier The identifier of the background session.  This must
+   *   be the same each time the app runs so the OS can deliver the events of
+   *   transfers that finished while the app wasn't running.
+   */
+  explicit UrlSessionSchemePlugin(const std::string& identifier);
+  ~UrlSessionSchemePlugin() override;
+
+  SHAKA_NON_COPYABLE_OR_MOVABLE_TYPE(UrlSessionSchemePlugin);
+
+  /** @return The identifier of the background session. */
+  const std::string& identifier() const;
+
+  /**
+   * Called when content starts or stops being stored.  Segment requests use
+   * the background session while any store is in progress.
+   */
+  void OnStoreStarted();
+  void OnStoreFinished();
+
+  /**
+   * Sets the callback the app got from
+   * application:handleEventsForBackgroundURLSession:completionHandler:.  It
+   * is called once the session has delivered all its pending events.
+   */
+  void SetBackgroundEventsHandler(std::function<void()> handler);
+
+  std::future<optional<Error>> OnNetworkRequest(const std::string& uri,
+                                                RequestType type,
+                                                const Request& request,
+                                                Client* client,
+                                                Response* response) override;
+
+ private:
+  class Impl;
+  std::unique_ptr<Impl> impl_;
+};
+
+}  // namespace shaka
+
+#endif  // SHAKA_EMBEDDED_PUBLIC_URL_SESSION_SCHEME_PLUGIN_H_
@@ -0,0 +1,325 @@
+// Copyright 2020 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     https://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "src/public/url_session_scheme_plugin.h"
+
+#import <Foundation/Foundation.h>
+#include <glog/logging.h>
+
+#include <atomic>
+#include <mutex>
+#include <unordered_map>
+#include <utility>
+
+#include "src/debug/mutex.h"
+#include "src/util/file_system.h"
+#include "src/util/objc_utils.h"
+#include "src/util/utils.h"
+
+namespace shaka {
+
+namespace {
+
+/** A request that is waiting for a background download task. */
+struct PendingDownload {
+  PendingDownload(const std::string &uri, SchemePlugin::Client *client, Response *response)
+      : uri(uri),
+        client(client),
+        response(response),
+        last_progress(CFAbsoluteTimeGetCurrent()) {}
+
+  const std::string uri;
+  SchemePlugin::Client *const client;
+  Response *const response;
+  std::promise<optional<Error>> promise;
+  util::MappedFile file;
+  CFAbsoluteTime last_progress;
+};
+
+/** Tracks the downloads of the background session; this is thread-safe. */
+class PendingDownloads {
+ public:
+  PendingDownloads() : mutex_("UrlSessionSchemePlugin") {}
+
+  void Add(NSUInteger task_id, std::shared_ptr<PendingDownload> download) {
+    std::unique_lock<Mutex> lock(mutex_);
+    downloads_[task_id] = std::move(download);
+  }
+
+  std::shared_ptr<PendingDownload> Find(NSUInteger task_id, bool remove) {
+    std::unique_lock<Mutex> lock(mutex_);
+    auto it = downloads_.find(task_id);
+    if (it == downloads_.end())
+      return nullptr;
+    std::shared_ptr<PendingDownload> ret = it->second;
+    if (remove)
+      downloads_.erase(it);
+    return ret;
+  }
+
+  void SetEventsHandler(std::function<void()> handler) {
+    std::unique_lock<Mutex> lock(mutex_);
+    events_handler_ = std::move(handler);
+  }
+
+  std::function<void()> TakeEventsHandler() {
+    std::unique_lock<Mutex> lock(mutex_);
+    std::function<void()> ret = std::move(events_handler_);
+    events_handler_ = nullptr;
+    return ret;
+  }
+
+ private:
+  Mutex mutex_;
+  std::unordered_map<NSUInteger, std::shared_ptr<PendingDownload>> downloads_;
+  std::function<void()> events_handler_;
+};
+
+std::future<optional<Error>> MakeResult(optional<Error> error) {
+  std::promise<optional<Error>> promise;
+  promise.set_value(std::move(error));
+  return promise.get_future();
+}
+
+NSMutableURLRequest *MakeUrlRequest(const std::string &uri, const Request &request) {
+  NSURL *url = [NSURL URLWithString:util::ObjcConverter<std::string>::ToObjc(uri)];
+  if (!url)
+    return nil;
+
+  NSMutableURLRequest *ret = [NSMutableURLRequest requestWithURL:url];
+  ret.HTTPMethod = util::ObjcConverter<std::string>::ToObjc(request.method);
+  for (const auto &header : request.headers) {
+    [ret setValue:util::ObjcConverter<std::string>::ToObjc(header.second)
+        forHTTPHeaderField:util::ObjcConverter<std::string>::ToObjc(header.first)];
+  }
+  if (request.body_size() != 0)
+    ret.HTTPBody = [NSData dataWithBytes:request.body() length:request.body_size()];
+  return ret;
+}
+
+/** Fills in the response info, but not the data. */
+optional<Error> FillResponse(const std::string &uri, NSURLResponse *url_response,
+                             Response *response) {
+  response->originalUri = uri;
+  response->uri = url_response.URL ? url_response.URL.absoluteString.UTF8String : uri;
+  if (![url_response isKindOfClass:[NSHTTPURLResponse class]])
+    return nullopt;
+
+  NSHTTPURLResponse *http = static_cast<NSHTTPURLResponse *>(url_response);
+  for (NSString *key in http.allHeaderFields) {
+    NSString *value = http.allHeaderFields[key];
+    response->headers[util::ToAsciiLower(key.UTF8String)] = value.UTF8String;
+  }
+  if (http.statusCode < 200 || http.statusCode > 299)
+    return Error("Bad HTTP status " + std::to_string(http.statusCode) + " for " + uri);
+  return nullopt;
+}
+
+}  // namespace
+
+}  // namespace shaka
+
+/** Handles the events of the background session. */
+@interface ShakaUrlSessionDelegate : NSObject <NSURLSessionDownloadDelegate>
+
+- (void)addTask:(NSURLSessionTask *)task
+    withDownload:(std::shared_ptr<shaka::PendingDownload>)download;
+
+- (void)setBackgroundEventsHandler:(std::function<void()>)handler;
+
+@end
+
+@implementation ShakaUrlSessionDelegate {
+  shaka::PendingDownloads _downloads;
+}
+
+- (void)addTask:(NSURLSessionTask *)task
+    withDownload:(std::shared_ptr<shaka::PendingDownload>)download {
+  _downloads.Add(task.taskIdentifier, std::move(download));
+}
+
+- (void)setBackgroundEventsHandler:(std::function<void()>)handler {
+  _downloads.SetEventsHandler(std::move(handler));
+}
+
+- (void)URLSession:(NSURLSession *)session
+                 downloadTask:(NSURLSessionDownloadTask *)task
+                 didWriteData:(int64_t)bytesWritten
+            totalBytesWritten:(int64_t)totalBytesWritten
+    totalBytesExpectedToWrite:(int64_t)totalBytesExpectedToWrite {
+  auto download = _downloads.Find(task.taskIdentifier, /* remove= */ false);
+  if (!download)
+    return;
+
+  const CFAbsoluteTime now = CFAbsoluteTimeGetCurrent();
+  const int64_t remaining = totalBytesExpectedToWrite > totalBytesWritten
+                                ? totalBytesExpectedToWrite - totalBytesWritten
+                                : 0;
+  download->client->OnProgress((now - download->last_progress) * 1000, bytesWritten, remaining);
+  download->last_progress = now;
+}
+
+- (void)URLSession:(NSURLSession *)session
+                 downloadTask:(NSURLSessionDownloadTask *)task
+    didFinishDownloadingToURL:(NSURL *)location {
+  // The OS deletes the file once this returns, but the mapping stays valid.
+  auto download = _downloads.Find(task.taskIdentifier, /* remove= */ false);
+  shaka::util::FileSystem file_system;
+  if (download && file_system.FileSize(location.path.UTF8String) > 0 &&
+      !file_system.MapFile(location.path.UTF8String, &download->file)) {
+    LOG(ERROR) << "Unable to map downloaded file " << location.path.UTF8String;
+  }
+}
+
+- (void)URLSession:(NSURLSession *)session
+                    task:(NSURLSessionTask *)task
+    didCompleteWithError:(NSError *)error {
+  // Transfers started before the app was relaunched have no request to finish.
+  auto download = _downloads.Find(task.taskIdentifier, /* remove= */ true);
+  if (!download)
+    return;
+
+  if (error) {
+    download->promise.set_value(shaka::Error("Error downloading " + download->uri + ": " +
+                                             error.localizedDescription.UTF8String));
+    return;
+  }
+
+  auto result = shaka::FillResponse(download->uri, task.response, download->response);
+  if (!result.has_value() && download->file.valid()) {
+    const size_t size = download->file.size();
+    const uint8_t *data = download->file.data();
+    download->response->SetDataExternal(data, size, download->file.Release());
+  }
+  download->promise.set_value(std::move(result));
+}
+
+- (void)URLSessionDidFinishEventsForBackgroundURLSession:(NSURLSession *)session {
+  std::function<void()> handler = _downloads.TakeEventsHandler();
+  if (handler) {
+    // UIKit requires this to be called on the main thread.
+    dispatch_async(dispatch_get_main_queue(), ^{
+      handler();
+    });
+  }
+}
+
+@end
+
+namespace shaka {
+
+class UrlSessionSchemePlugin::Impl {
+ public:
+  explicit Impl(const std::string &identifier) : identifier(identifier), store_count(0) {
+    delegate = [[ShakaUrlSessionDelegate alloc] init];
+
+    NSURLSessionConfiguration *config = [NSURLSessionConfiguration
+        backgroundSessionConfigurationWithIdentifier:util::ObjcConverter<std::string>::ToObjc(
+                                                         identifier)];
+    config.sessionSendsLaunchEvents = YES;
+    config.discretionary = NO;
+    NSOperationQueue *queue = [[NSOperationQueue alloc] init];
+    queue.maxConcurrentOperationCount = 1;
+    background_session = [NSURLSession sessionWithConfiguration:config
+                                                       delegate:delegate
+                                                  delegateQueue:queue];
+
+    NSURLSessionConfiguration *default_config =
+        [NSURLSessionConfiguration defaultSessionConfiguration];
+    default_session = [NSURLSession sessionWithConfiguration:default_config];
+  }
+
+  ~Impl() {
+    // Outstanding transfers keep going in the background session; they are
+    // delivered the next time a session with this identifier is created.
+    [background_session finishTasksAndInvalidate];
+    [default_session invalidateAndCancel];
+  }
+
+  const std::string identifier;
+  std::atomic<int> store_count;
+  ShakaUrlSessionDelegate *delegate;
+  NSURLSession *background_session;
+  NSURLSession *default_session;
+};
+
+UrlSessionSchemePlugin::UrlSessionSchemePlugin(const std::string &identifier)
+    : impl_(new Impl(identifier)) {}
+
+UrlSessionSchemePlugin::~UrlSessionSchemePlugin() {}
+
+const std::string &UrlSessionSchemePlugin::identifier() const {
+  return impl_->identifier;
+}
+
+void UrlSessionSchemePlugin::OnStoreStarted() {
+  impl_->store_count++;
+}
+
+void UrlSessionSchemePlugin::OnStoreFinished() {
+  const int count = --impl_->store_count;
+  DCHECK_GE(count, 0);
+}
+
+void UrlSessionSchemePlugin::SetBackgroundEventsHandler(std::function<void()> handler) {
+  [impl_->delegate setBackgroundEventsHandler:std::move(handler)];
+}
+
+std::future<optional<Error>> UrlSessionSchemePlugin::OnNetworkRequest(const std::string &uri,
+                                                                      RequestType type,
+                                                                      const Request &request,
+                                                                      Client *client,
+                                                                      Response *response) {
+  NSMutableURLRequest *url_request = MakeUrlRequest(uri, request);
+  if (!url_request)
+    return MakeResult(Error("Invalid URI: " + uri));
+
+  // Background sessions only support downloading to a file, which only works
+  // for requests without a body.
+  if (type == RequestType::Segment && impl_->store_count > 0 && request.body_size() == 0) {
+    std::shared_ptr<PendingDownload> download(new PendingDownload(uri, client, response));
+    auto ret = download->promise.get_future();
+    NSURLSessionDownloadTask *task =
+        [impl_->background_session downloadTaskWithRequest:url_request];
+    [impl_->delegate addTask:task withDownload:std::move(download)];
+    [task resume];
+    return ret;
+  }
+
+  auto promise = std::make_shared<std::promise<optional<Error>>>();
+  auto ret = promise->get_future();
+  NSURLSessionDataTask *task = [impl_->default_session
+      dataTaskWithRequest:url_request
+        completionHandler:^(NSData *data, NSURLResponse *url_response, NSError *error) {
+          if (error) {
+            promise->set_value(
+                Error("Error downloading " + uri + ": " + error.localizedDescription.UTF8String));
+            return;
+          }
+
+          auto result = FillResponse(uri, url_response, response);
+          if (!result.has_value() && data.length != 0) {
+            // Keep the NSData alive until the JavaScript buffer is freed.
+            __block NSData *keep_alive = data;
+            response->SetDataExternal(static_cast<const uint8_t *>(data.bytes), data.length, ^{
+              keep_alive = nil;
+            });
+          }
+          promise->set_value(std::move(result));
+        }];
+  [task resume];
+  return ret;
+}
+
+}  // namespace shaka
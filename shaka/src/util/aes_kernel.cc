@@ -0,0 +1,364 @@
+// Copyright 2020 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     https://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "src/util/aes_kernel.h"
+
+#include <glog/logging.h>
+#include <string.h>
+
+#if (defined(__x86_64__) || defined(__i386__)) && \
+    (defined(__GNUC__) || defined(__clang__))
+#  include <cpuid.h>
+#  include <wmmintrin.h>
+#  define USE_AES_NI
+// This allows using the instructions without compiling everything with -maes;
+// they are only used after checking the CPU supports them.
+#  define AES_TARGET __attribute__((target("aes")))
+#elif defined(__aarch64__) && \
+    (defined(__ARM_FEATURE_CRYPTO) || defined(__ARM_FEATURE_AES))
+#  include <arm_neon.h>
+#  define USE_ARM_CE
+#  define AES_TARGET
+#endif
+
+#if defined(USE_AES_NI) || defined(USE_ARM_CE)
+#  define HAS_AES_KERNEL
+#endif
+
+#include <algorithm>
+
+namespace shaka {
+namespace util {
+
+#if defined(HAS_AES_KERNEL)
+namespace {
+
+/** The number of blocks to process together to keep the AES unit busy. */
+constexpr const size_t kParallelBlocks = 4;
+
+using RoundKeys = uint8_t[11][AES_BLOCK_SIZE];
+
+/** Increments the block counter in the low 64 bits of a CTR counter block. */
+void IncrementCounter(uint8_t* counter) {
+  for (size_t i = AES_BLOCK_SIZE; i > AES_BLOCK_SIZE / 2; i--) {
+    if (++counter[i - 1] != 0)
+      break;
+  }
+}
+
+#if defined(USE_AES_NI)
+
+AES_TARGET __m128i ExpandKeyStep(__m128i key, __m128i assist) {
+  assist = _mm_shuffle_epi32(assist, 0xff);
+  key = _mm_xor_si128(key, _mm_slli_si128(key, 4));
+  key = _mm_xor_si128(key, _mm_slli_si128(key, 4));
+  key = _mm_xor_si128(key, _mm_slli_si128(key, 4));
+  return _mm_xor_si128(key, assist);
+}
+
+AES_TARGET void ExpandKey(const uint8_t* key, bool for_decrypt,
+                          RoundKeys keys) {
+  __m128i k[11];
+  // The round constant must be an immediate, so this can't be a loop.
+  k[0] = _mm_loadu_si128(reinterpret_cast<const __m128i*>(key));
+  k[1] = ExpandKeyStep(k[0], _mm_aeskeygenassist_si128(k[0], 0x01));
+  k[2] = ExpandKeyStep(k[1], _mm_aeskeygenassist_si128(k[1], 0x02));
+  k[3] = ExpandKeyStep(k[2], _mm_aeskeygenassist_si128(k[2], 0x04));
+  k[4] = ExpandKeyStep(k[3], _mm_aeskeygenassist_si128(k[3], 0x08));
+  k[5] = ExpandKeyStep(k[4], _mm_aeskeygenassist_si128(k[4], 0x10));
+  k[6] = ExpandKeyStep(k[5], _mm_aeskeygenassist_si128(k[5], 0x20));
+  k[7] = ExpandKeyStep(k[6], _mm_aeskeygenassist_si128(k[6], 0x40));
+  k[8] = ExpandKeyStep(k[7], _mm_aeskeygenassist_si128(k[7], 0x80));
+  k[9] = ExpandKeyStep(k[8], _mm_aeskeygenassist_si128(k[8], 0x1b));
+  k[10] = ExpandKeyStep(k[9], _mm_aeskeygenassist_si128(k[9], 0x36));
+
+  for (size_t i = 0; i < 11; i++) {
+    __m128i value = k[i];
+    if (for_decrypt) {
+      // The equivalent inverse cipher uses the keys in reverse order with
+      // InvMixColumns applied to the middle rounds.
+      value = k[10 - i];
+      if (i != 0 && i != 10)
+        value = _mm_aesimc_si128(value);
+    }
+    _mm_storeu_si128(reinterpret_cast<__m128i*>(keys[i]), value);
+  }
+}
+
+#  define LOAD(ptr) _mm_loadu_si128(reinterpret_cast<const __m128i*>(ptr))
+#  define STORE(ptr, value) \
+    _mm_storeu_si128(reinterpret_cast<__m128i*>(ptr), value)
+
+AES_TARGET void DecryptCbcBlocks(const RoundKeys keys, const uint8_t* data,
+                                 size_t blocks, uint8_t* iv, uint8_t* dest) {
+  __m128i k[11];
+  for (size_t i = 0; i < 11; i++)
+    k[i] = LOAD(keys[i]);
+
+  __m128i prev = LOAD(iv);
+  size_t i = 0;
+  // Unlike encryption, CBC decryption doesn't depend on the previous output,
+  // so multiple blocks can be in flight at once.
+  for (; i + kParallelBlocks <= blocks; i += kParallelBlocks) {
+    const uint8_t* src = data + i * AES_BLOCK_SIZE;
+    const __m128i c0 = LOAD(src);
+    const __m128i c1 = LOAD(src + AES_BLOCK_SIZE);
+    const __m128i c2 = LOAD(src + AES_BLOCK_SIZE * 2);
+    const __m128i c3 = LOAD(src + AES_BLOCK_SIZE * 3);
+    __m128i x0 = _mm_xor_si128(c0, k[0]);
+    __m128i x1 = _mm_xor_si128(c1, k[0]);
+    __m128i x2 = _mm_xor_si128(c2, k[0]);
+    __m128i x3 = _mm_xor_si128(c3, k[0]);
+    for (size_t round = 1; round < 10; round++) {
+      x0 = _mm_aesdec_si128(x0, k[round]);
+      x1 = _mm_aesdec_si128(x1, k[round]);
+      x2 = _mm_aesdec_si128(x2, k[round]);
+      x3 = _mm_aesdec_si128(x3, k[round]);
+    }
+    uint8_t* out = dest + i * AES_BLOCK_SIZE;
+    STORE(out, _mm_xor_si128(_mm_aesdeclast_si128(x0, k[10]), prev));
+    STORE(out + AES_BLOCK_SIZE,
+          _mm_xor_si128(_mm_aesdeclast_si128(x1, k[10]), c0));
+    STORE(out + AES_BLOCK_SIZE * 2,
+          _mm_xor_si128(_mm_aesdeclast_si128(x2, k[10]), c1));
+    STORE(out + AES_BLOCK_SIZE * 3,
+          _mm_xor_si128(_mm_aesdeclast_si128(x3, k[10]), c2));
+    prev = c3;
+  }
+  for (; i < blocks; i++) {
+    const __m128i c = LOAD(data + i * AES_BLOCK_SIZE);
+    __m128i x = _mm_xor_si128(c, k[0]);
+    for (size_t round = 1; round < 10; round++)
+      x = _mm_aesdec_si128(x, k[round]);
+    STORE(dest + i * AES_BLOCK_SIZE,
+          _mm_xor_si128(_mm_aesdeclast_si128(x, k[10]), prev));
+    prev = c;
+  }
+  STORE(iv, prev);
+}
+
+AES_TARGET void CryptCtrBlocks(const RoundKeys keys, const uint8_t* data,
+                               size_t blocks, uint8_t* counter, uint8_t* dest) {
+  __m128i k[11];
+  for (size_t i = 0; i < 11; i++)
+    k[i] = LOAD(keys[i]);
+
+  uint8_t counters[kParallelBlocks][AES_BLOCK_SIZE];
+  for (size_t i = 0; i < blocks; i += kParallelBlocks) {
+    const size_t count = std::min(kParallelBlocks, blocks - i);
+    __m128i x[kParallelBlocks];
+    for (size_t j = 0; j < count; j++) {
+      memcpy(counters[j], counter, AES_BLOCK_SIZE);
+      IncrementCounter(counter);
+      x[j] = _mm_xor_si128(LOAD(counters[j]), k[0]);
+    }
+    for (size_t round = 1; round < 10; round++) {
+      for (size_t j = 0; j < count; j++)
+        x[j] = _mm_aesenc_si128(x[j], k[round]);
+    }
+    for (size_t j = 0; j < count; j++) {
+      const size_t offset = (i + j) * AES_BLOCK_SIZE;
+      STORE(dest + offset, _mm_xor_si128(_mm_aesenclast_si128(x[j], k[10]),
+                                         LOAD(data + offset)));
+    }
+  }
+}
+
+#  undef LOAD
+#  undef STORE
+
+#elif defined(USE_ARM_CE)
+
+uint32_t SubWord(uint32_t word) {
+  // AESE with a zero key is ShiftRows(SubBytes(x)); since every column is the
+  // same, the ShiftRows has no effect.
+  const uint8x16_t value = vaeseq_u8(vreinterpretq_u8_u32(vdupq_n_u32(word)),
+                                     vdupq_n_u8(0));
+  return vgetq_lane_u32(vreinterpretq_u32_u8(value), 0);
+}
+
+void ExpandKey(const uint8_t* key, bool for_decrypt, RoundKeys keys) {
+  static const uint8_t kRoundConstants[] = {0x01, 0x02, 0x04, 0x08, 0x10,
+                                            0x20, 0x40, 0x80, 0x1b, 0x36};
+  // The words are little-endian, so RotWord is a right rotation.
+  uint32_t words[44];
+  memcpy(words, key, AES_BLOCK_SIZE);
+  for (size_t i = 4; i < 44; i++) {
+    uint32_t temp = words[i - 1];
+    if (i % 4 == 0) {
+      temp = SubWord((temp >> 8) | (temp << 24)) ^ kRoundConstants[i / 4 - 1];
+    }
+    words[i] = words[i - 4] ^ temp;
+  }
+
+  for (size_t i = 0; i < 11; i++) {
+    uint8x16_t value = vld1q_u8(reinterpret_cast<const uint8_t*>(words + i * 4));
+    if (for_decrypt) {
+      // The equivalent inverse cipher uses the keys in reverse order with
+      // InvMixColumns applied to the middle rounds.
+      value = vld1q_u8(reinterpret_cast<const uint8_t*>(words + (10 - i) * 4));
+      if (i != 0 && i != 10)
+        value = vaesimcq_u8(value);
+    }
+    vst1q_u8(keys[i], value);
+  }
+}
+
+uint8x16_t DecryptBlock(const uint8x16_t* k, uint8x16_t x) {
+  for (size_t round = 0; round < 9; round++)
+    x = vaesimcq_u8(vaesdq_u8(x, k[round]));
+  return veorq_u8(vaesdq_u8(x, k[9]), k[10]);
+}
+
+uint8x16_t EncryptBlock(const uint8x16_t* k, uint8x16_t x) {
+  for (size_t round = 0; round < 9; round++)
+    x = vaesmcq_u8(vaeseq_u8(x, k[round]));
+  return veorq_u8(vaeseq_u8(x, k[9]), k[10]);
+}
+
+void DecryptCbcBlocks(const RoundKeys keys, const uint8_t* data, size_t blocks,
+                      uint8_t* iv, uint8_t* dest) {
+  uint8x16_t k[11];
+  for (size_t i = 0; i < 11; i++)
+    k[i] = vld1q_u8(keys[i]);
+
+  uint8x16_t prev = vld1q_u8(iv);
+  size_t i = 0;
+  // Unlike encryption, CBC decryption doesn't depend on the previous output,
+  // so multiple blocks can be in flight at once.
+  for (; i + kParallelBlocks <= blocks; i += kParallelBlocks) {
+    const uint8_t* src = data + i * AES_BLOCK_SIZE;
+    const uint8x16_t c0 = vld1q_u8(src);
+    const uint8x16_t c1 = vld1q_u8(src + AES_BLOCK_SIZE);
+    const uint8x16_t c2 = vld1q_u8(src + AES_BLOCK_SIZE * 2);
+    const uint8x16_t c3 = vld1q_u8(src + AES_BLOCK_SIZE * 3);
+    uint8_t* out = dest + i * AES_BLOCK_SIZE;
+    vst1q_u8(out, veorq_u8(DecryptBlock(k, c0), prev));
+    vst1q_u8(out + AES_BLOCK_SIZE, veorq_u8(DecryptBlock(k, c1), c0));
+    vst1q_u8(out + AES_BLOCK_SIZE * 2, veorq_u8(DecryptBlock(k, c2), c1));
+    vst1q_u8(out + AES_BLOCK_SIZE * 3, veorq_u8(DecryptBlock(k, c3), c2));
+    prev = c3;
+  }
+  for (; i < blocks; i++) {
+    const uint8x16_t c = vld1q_u8(data + i * AES_BLOCK_SIZE);
+    vst1q_u8(dest + i * AES_BLOCK_SIZE, veorq_u8(DecryptBlock(k, c), prev));
+    prev = c;
+  }
+  vst1q_u8(iv, prev);
+}
+
+void CryptCtrBlocks(const RoundKeys keys, const uint8_t* data, size_t blocks,
+                    uint8_t* counter, uint8_t* dest) {
+  uint8x16_t k[11];
+  for (size_t i = 0; i < 11; i++)
+    k[i] = vld1q_u8(keys[i]);
+
+  for (size_t i = 0; i < blocks; i++) {
+    const uint8x16_t keystream = EncryptBlock(k, vld1q_u8(counter));
+    IncrementCounter(counter);
+    const size_t offset = i * AES_BLOCK_SIZE;
+    vst1q_u8(dest + offset, veorq_u8(keystream, vld1q_u8(data + offset)));
+  }
+}
+
+#endif
+
+}  // namespace
+#endif  // HAS_AES_KERNEL
+
+AesKernel::AesKernel(eme::EncryptionScheme scheme, const uint8_t* key)
+    : scheme_(scheme), iv_(), keystream_(), keystream_offset_(0) {
+#if defined(HAS_AES_KERNEL)
+  ExpandKey(key, scheme == eme::EncryptionScheme::AesCbc, round_keys_);
+#endif
+}
+
+AesKernel::~AesKernel() {
+  // Don't leave the key in memory.
+  memset(round_keys_, 0, sizeof(round_keys_));
+}
+
+// static
+bool AesKernel::IsSupported() {
+#if defined(USE_AES_NI)
+  unsigned int eax, ebx, ecx, edx;
+  return __get_cpuid(1, &eax, &ebx, &ecx, &edx) && (ecx & bit_AES);
+#elif defined(USE_ARM_CE)
+  // This was compiled for a CPU that always has the extensions.
+  return true;
+#else
+  return false;
+#endif
+}
+
+// static
+std::unique_ptr<AesKernel> AesKernel::Create(eme::EncryptionScheme scheme,
+                                             const std::vector<uint8_t>& key) {
+  if (key.size() != AES_BLOCK_SIZE || !IsSupported())
+    return nullptr;
+  return std::unique_ptr<AesKernel>(new AesKernel(scheme, key.data()));
+}
+
+void AesKernel::SetIv(const uint8_t* iv) {
+  memcpy(iv_, iv, AES_BLOCK_SIZE);
+  keystream_offset_ = 0;
+}
+
+bool AesKernel::Decrypt(const uint8_t* data, size_t data_size, uint8_t* dest) {
+  if (scheme_ == eme::EncryptionScheme::AesCtr) {
+    DecryptCtr(data, data_size, dest);
+    return true;
+  }
+
+  if (data_size % AES_BLOCK_SIZE != 0) {
+    LOG(ERROR) << "CBC requires protected ranges to be a multiple of the "
+                  "block size.";
+    return false;
+  }
+#if defined(HAS_AES_KERNEL)
+  DecryptCbcBlocks(round_keys_, data, data_size / AES_BLOCK_SIZE, iv_, dest);
+#endif
+  return true;
+}
+
+void AesKernel::DecryptCtr(const uint8_t* data, size_t data_size,
+                           uint8_t* dest) {
+  // First use the rest of the keystream from the previous call.
+  while (data_size > 0 && keystream_offset_ != 0) {
+    *dest++ = *data++ ^ keystream_[keystream_offset_];
+    keystream_offset_ = (keystream_offset_ + 1) % AES_BLOCK_SIZE;
+    data_size--;
+  }
+
+#if defined(HAS_AES_KERNEL)
+  const size_t blocks = data_size / AES_BLOCK_SIZE;
+  CryptCtrBlocks(round_keys_, data, blocks, iv_, dest);
+  data += blocks * AES_BLOCK_SIZE;
+  dest += blocks * AES_BLOCK_SIZE;
+  data_size -= blocks * AES_BLOCK_SIZE;
+
+  if (data_size > 0) {
+    // Decrypt the partial block and keep the rest of the keystream for the
+    // next call.
+    memset(keystream_, 0, AES_BLOCK_SIZE);
+    CryptCtrBlocks(round_keys_, keystream_, 1, iv_, keystream_);
+    for (size_t i = 0; i < data_size; i++)
+      dest[i] = data[i] ^ keystream_[i];
+    keystream_offset_ = data_size;
+  }
+#endif
+}
+
+}  // namespace util
+}  // namespace shaka
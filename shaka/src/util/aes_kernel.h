@@ -0,0 +1,87 @@
+// Copyright 2020 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     https://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef SHAKA_EMBEDDED_UTIL_AES_KERNEL_H_
+#define SHAKA_EMBEDDED_UTIL_AES_KERNEL_H_
+
+#include <memory>
+#include <vector>
+
+#include "src/util/decryptor.h"
+#include "src/util/macros.h"
+
+namespace shaka {
+namespace util {
+
+/**
+ * Decrypts AES-128 CTR or CBC data using the CPU's AES instructions (AES-NI on
+ * x86 and the Cryptography Extensions on ARMv8).  This keeps the expanded key
+ * and the chaining state in the object, so each call goes directly to the
+ * instructions without any library overhead.
+ *
+ * This is used by Decryptor when the CPU supports it; otherwise the platform
+ * crypto library is used.
+ */
+class AesKernel {
+ public:
+  ~AesKernel();
+
+  SHAKA_NON_COPYABLE_OR_MOVABLE_TYPE(AesKernel);
+
+  /** @return Whether the current CPU supports the required instructions. */
+  static bool IsSupported();
+
+  /**
+   * Creates a new kernel that decrypts with the given 128-bit key.
+   *
+   * @return The new kernel, or nullptr if this isn't supported.
+   */
+  static std::unique_ptr<AesKernel> Create(eme::EncryptionScheme scheme,
+                                           const std::vector<uint8_t>& key);
+
+  /** Starts a new decrypt operation using the given IV. */
+  void SetIv(const uint8_t* iv);
+
+  /**
+   * Decrypts the given data into the given buffer; they may be the same
+   * buffer.  For CTR, this continues the keystream from the previous call, so
+   * this can be given any size.  For CBC, the size must be a multiple of
+   * AES_BLOCK_SIZE.
+   */
+  bool Decrypt(const uint8_t* data, size_t data_size, uint8_t* dest);
+
+ private:
+  static constexpr const size_t kRounds = 10;
+
+  AesKernel(eme::EncryptionScheme scheme, const uint8_t* key);
+
+  void DecryptCtr(const uint8_t* data, size_t data_size, uint8_t* dest);
+
+  const eme::EncryptionScheme scheme_;
+  // For CTR, these are the encryption round keys; for CBC, these are the round
+  // keys for the equivalent inverse cipher.
+  uint8_t round_keys_[kRounds + 1][AES_BLOCK_SIZE];
+  // For CTR, this is the counter for the next block; for CBC, this is the
+  // previous ciphertext block.
+  uint8_t iv_[AES_BLOCK_SIZE];
+  // For CTR, the keystream for the current block and how much has been used.
+  // This is only used when a call ends in the middle of a block.
+  uint8_t keystream_[AES_BLOCK_SIZE];
+  size_t keystream_offset_;
+};
+
+}  // namespace util
+}  // namespace shaka
+
+#endif  // SHAKA_EMBEDDED_UTIL_AES_KERNEL_H_
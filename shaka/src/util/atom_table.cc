@@ -0,0 +1,44 @@
+// Copyright 2020 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     https://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+
+#include "src/util/atom_table.h"
+
+namespace shaka {
+namespace util {
+
+constexpr const AtomTable::Atom AtomTable::kNoAtom;
+
+AtomTable::AtomTable() {}
+
+AtomTable::~AtomTable() {}
+
+AtomTable::Atom AtomTable::Intern(const std::string& str) {
+  std::unique_lock<std::mutex> lock(mutex_);
+  auto it = atoms_.find(str);
+  if (it != atoms_.end())
+    return it->second;
+  const Atom ret = static_cast<Atom>(atoms_.size());
+  atoms_.emplace(str, ret);
+  return ret;
+}
+
+AtomTable::Atom AtomTable::FindAtom(const std::string& str) const {
+  std::unique_lock<std::mutex> lock(mutex_);
+  auto it = atoms_.find(str);
+  return it != atoms_.end() ? it->second : kNoAtom;
+}
+
+}  // namespace util
+}  // namespace shaka
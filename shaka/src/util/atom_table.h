@@ -0,0 +1,68 @@
+// Copyright 2020 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     https://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+
+#ifndef SHAKA_EMBEDDED_UTIL_ATOM_TABLE_H_
+#define SHAKA_EMBEDDED_UTIL_ATOM_TABLE_H_
+
+#include <stdint.h>
+
+#include <mutex>
+#include <string>
+#include <unordered_map>
+
+#include "src/util/macros.h"
+
+namespace shaka {
+namespace util {
+
+/**
+ * Interns strings as small integers ("atoms") so names that are looked up
+ * often can be compared as integers instead of as strings.  Atoms are given
+ * out in order starting at 0 and are never reused.
+ *
+ * This type is thread-safe.
+ */
+class AtomTable final {
+ public:
+  using Atom = uint32_t;
+
+  /** The value FindAtom returns if the string hasn't been interned. */
+  static constexpr const Atom kNoAtom = UINT32_MAX;
+
+  AtomTable();
+  ~AtomTable();
+
+  SHAKA_NON_COPYABLE_OR_MOVABLE_TYPE(AtomTable);
+
+  /** Gets the atom for the given string, adding it if it isn't there. */
+  Atom Intern(const std::string& str);
+
+  /**
+   * Gets the atom for the given string, or kNoAtom if it hasn't been interned.
+   * This doesn't add the string, so lookups of arbitrary strings (e.g. from
+   * JavaScript) don't grow the table.
+   */
+  Atom FindAtom(const std::string& str) const;
+
+ private:
+  // This uses a plain mutex since tables are often statically initialized.
+  mutable std::mutex mutex_;
+  std::unordered_map<std::string, Atom> atoms_;
+};
+
+}  // namespace util
+}  // namespace shaka
+
+#endif  // SHAKA_EMBEDDED_UTIL_ATOM_TABLE_H_
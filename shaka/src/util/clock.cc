@@ -14,7 +14,9 @@
 
 #include "src/util/clock.h"
 
+#include <atomic>
 #include <chrono>
+#include <cmath>
 #include <thread>
 
 #include "src/util/macros.h"
@@ -26,20 +28,54 @@ BEGIN_ALLOW_COMPLEX_STATICS
 const Clock Clock::Instance;
 END_ALLOW_COMPLEX_STATICS
 
+namespace {
+
+std::atomic<const Clock*> instance_override{nullptr};
+
+/** @return The clock that |clock| should forward to, or nullptr. */
+const Clock* GetOverride(const Clock* clock) {
+  return clock == &Clock::Instance ? instance_override.load() : nullptr;
+}
+
+}  // namespace
+
+void Clock::SetInstanceOverride(const Clock* clock) {
+  instance_override.store(clock);
+}
+
 uint64_t Clock::GetMonotonicTime() const {
+  if (const Clock* clock = GetOverride(this))
+    return clock->GetMonotonicTime();
   return std::chrono::steady_clock::now().time_since_epoch() /
          std::chrono::milliseconds(1);
 }
 
 uint64_t Clock::GetEpochTime() const {
+  if (const Clock* clock = GetOverride(this))
+    return clock->GetEpochTime();
   return std::chrono::system_clock::now().time_since_epoch() /
          std::chrono::milliseconds(1);
 }
 
 void Clock::SleepSeconds(double seconds) const {
+  if (const Clock* clock = GetOverride(this))
+    return clock->SleepSeconds(seconds);
   std::this_thread::sleep_for(
       std::chrono::milliseconds(static_cast<int64_t>(seconds * 1000)));
 }
 
+void Clock::WaitForSignal(std::condition_variable* cond,
+                          std::unique_lock<std::mutex>* lock,
+                          double seconds) const {
+  if (const Clock* clock = GetOverride(this))
+    return clock->WaitForSignal(cond, lock, seconds);
+  if (std::isinf(seconds)) {
+    cond->wait(*lock);
+    return;
+  }
+  cond->wait_for(*lock, std::chrono::milliseconds(
+                            static_cast<int64_t>(seconds * 1000)));
+}
+
 }  // namespace util
 }  // namespace shaka
@@ -17,6 +17,9 @@
 
 #include <stdint.h>
 
+#include <condition_variable>
+#include <mutex>
+
 namespace shaka {
 namespace util {
 
@@ -28,6 +31,14 @@ class Clock {
   /** Contains a static instance of the clock. */
   static const Clock Instance;
 
+  /**
+   * Makes Clock::Instance forward all its calls to the given clock.  This is
+   * used to run the whole pipeline on simulated time (see VirtualClock).  This
+   * should be called before any players are created; passing nullptr restores
+   * the system time.  This doesn't take ownership of the clock.
+   */
+  static void SetInstanceOverride(const Clock* clock);
+
   /**
    * @return The current time, in milliseconds.  The value is not specific, but
    *   is guaranteed to be increasing over the course of the program.
@@ -39,6 +50,16 @@ class Clock {
 
   /** Sleeps for the given number of seconds. */
   virtual void SleepSeconds(double seconds) const;
+
+  /**
+   * Waits for the given condition variable to be signaled, for at most the
+   * given number of seconds.  The lock must be held and will be held again
+   * when this returns.  This can return early due to spurious wakeups.  If
+   * |seconds| is infinite, this waits until signaled.
+   */
+  virtual void WaitForSignal(std::condition_variable* cond,
+                             std::unique_lock<std::mutex>* lock,
+                             double seconds) const;
 };
 
 }  // namespace util
@@ -0,0 +1,51 @@
+// Copyright 2020 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     https://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "src/util/decryptor.h"
+
+#include <string.h>
+
+#include <algorithm>
+
+#include "src/util/aes_kernel.h"
+
+namespace shaka {
+namespace util {
+
+bool Decryptor::DecryptPattern(const uint8_t* data, size_t data_size,
+                               uint32_t crypt_blocks, uint32_t skip_blocks,
+                               uint8_t* dest) {
+  const size_t crypt_size = AES_BLOCK_SIZE * crypt_blocks;
+  const size_t skip_size = AES_BLOCK_SIZE * skip_blocks;
+  size_t offset = 0;
+  // Each run goes directly to the decryptor (or kernel) that keeps the chaining
+  // state, so this doesn't need to set anything up for each block.
+  while (crypt_size > 0 && data_size - offset >= crypt_size) {
+    if (!Decrypt(data + offset, crypt_size, dest + offset))
+      return false;
+    offset += crypt_size;
+
+    const size_t clear_size = std::min(skip_size, data_size - offset);
+    if (dest != data)
+      memcpy(dest + offset, data + offset, clear_size);
+    offset += clear_size;
+  }
+
+  if (dest != data)
+    memcpy(dest + offset, data + offset, data_size - offset);
+  return true;
+}
+
+}  // namespace util
+}  // namespace shaka
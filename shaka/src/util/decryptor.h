@@ -26,6 +26,8 @@
 namespace shaka {
 namespace util {
 
+class AesKernel;
+
 /**
  * A utility class that decrypts data.  This stores the current decryption state
  * so it can be reused for a single decrypt operation.  This will only succeed
@@ -40,6 +42,18 @@ class Decryptor {
 
   SHAKA_NON_COPYABLE_OR_MOVABLE_TYPE(Decryptor);
 
+  /** @return The encryption scheme this decrypts. */
+  eme::EncryptionScheme scheme() const {
+    return scheme_;
+  }
+
+  /**
+   * Starts a new decrypt operation using the given IV.  This reuses the
+   * expanded key and cipher context, so this is much cheaper than creating a
+   * new Decryptor for each sample.
+   */
+  bool ResetIv(const std::vector<uint8_t>& iv);
+
   /**
    * Decrypts the given partial block into the given buffer.  This must be
    * given a partial block and |data_size + block_offset <= AES_BLOCK_SIZE|.
@@ -53,6 +67,16 @@ class Decryptor {
    */
   bool Decrypt(const uint8_t* data, size_t data_size, uint8_t* dest);
 
+  /**
+   * Decrypts the given subsample that uses pattern encryption (e.g. "cbcs").
+   * This decrypts |crypt_blocks| blocks then copies |skip_blocks| blocks, until
+   * the end of the data.  If the end doesn't have enough data for
+   * |crypt_blocks| blocks, it is copied as-is.
+   */
+  bool DecryptPattern(const uint8_t* data, size_t data_size,
+                      uint32_t crypt_blocks, uint32_t skip_blocks,
+                      uint8_t* dest);
+
  private:
   bool InitIfNeeded();
 
@@ -62,6 +86,8 @@ class Decryptor {
 
   struct Impl;
   std::unique_ptr<Impl> extra_;
+  // If set, this decrypts using the CPU's AES instructions instead of |extra_|.
+  std::unique_ptr<AesKernel> kernel_;
 };
 
 }  // namespace util
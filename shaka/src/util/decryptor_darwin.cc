@@ -16,6 +16,7 @@
 #include <Security/Security.h>
 #include <glog/logging.h>  // NOLINT(build/include_alpha)
 
+#include "src/util/aes_kernel.h"
 #include "src/util/decryptor.h"
 
 namespace shaka {
@@ -33,20 +34,63 @@ void IncrementIv(std::vector<uint8_t>* iv) {
 
 }  // namespace
 
-struct Decryptor::Impl {};
+struct Decryptor::Impl {
+  ~Impl() {
+    if (cryptor)
+      CCCryptorRelease(cryptor);
+  }
+
+  // For CTR, this encrypts the counter blocks using ECB; for CBC, this
+  // decrypts the data directly.  This holds the expanded key.
+  CCCryptorRef cryptor = nullptr;
+};
 
 Decryptor::Decryptor(eme::EncryptionScheme scheme,
                      const std::vector<uint8_t>& key,
                      const std::vector<uint8_t>& iv)
-    : scheme_(scheme), key_(key), iv_(iv) {
+    : scheme_(scheme),
+      key_(key),
+      iv_(iv),
+      extra_(new Impl),
+      kernel_(AesKernel::Create(scheme, key)) {
   DCHECK_EQ(AES_BLOCK_SIZE, key.size());
   DCHECK_EQ(AES_BLOCK_SIZE, iv.size());
+  if (kernel_)
+    kernel_->SetIv(iv_.data());
 }
 
 Decryptor::~Decryptor() {}
 
+bool Decryptor::ResetIv(const std::vector<uint8_t>& iv) {
+  DCHECK_EQ(AES_BLOCK_SIZE, iv.size());
+  iv_ = iv;
+  if (kernel_) {
+    kernel_->SetIv(iv_.data());
+    return true;
+  }
+  // CTR tracks the counter in |iv_|, so only CBC needs to reset the cryptor.
+  if (scheme_ == eme::EncryptionScheme::AesCtr || !extra_->cryptor)
+    return true;
+
+  CCCryptorStatus result = CCCryptorReset(extra_->cryptor, iv_.data());
+  if (result != kCCSuccess) {
+    LOG(ERROR) << "Error resetting cryptor: " << result;
+    return false;
+  }
+  return true;
+}
+
 bool Decryptor::DecryptPartialBlock(const uint8_t* data, size_t data_size,
                                     uint32_t block_offset, uint8_t* dest) {
+  // The kernel tracks the offset within the current CTR block itself.
+  if (kernel_ &&
+      (scheme_ == eme::EncryptionScheme::AesCtr || block_offset == 0)) {
+    return kernel_->Decrypt(data, data_size, dest);
+  }
+
+  if (!InitIfNeeded())
+    return false;
+
   if (scheme_ == eme::EncryptionScheme::AesCtr) {
     // Mac/iOS only supports CBC, so we need to implement CTR mode based on
     // their AES encryption.
@@ -55,9 +99,9 @@ bool Decryptor::DecryptPartialBlock(const uint8_t* data, size_t data_size,
     while (data_offset < data_size) {
       uint8_t encrypted_iv[AES_BLOCK_SIZE];
       size_t length;
-      CCCryptorStatus result = CCCrypt(
-          kCCEncrypt, kCCAlgorithmAES128, 0, key_.data(), key_.size(), nullptr,
-          iv_.data(), iv_.size(), encrypted_iv, AES_BLOCK_SIZE, &length);
+      CCCryptorStatus result =
+          CCCryptorUpdate(extra_->cryptor, iv_.data(), iv_.size(),
+                          encrypted_iv, AES_BLOCK_SIZE, &length);
       if (result != kCCSuccess) {
         LOG(ERROR) << "Error decrypting data: " << result;
         return false;
@@ -88,11 +132,10 @@ bool Decryptor::DecryptPartialBlock(const uint8_t* data, size_t data_size,
       return false;
     }
 
-    // This uses AES-CBC.
+    // This uses AES-CBC.  The cryptor tracks the chaining between calls.
     size_t length;
-    CCCryptorStatus result =
-        CCCrypt(kCCDecrypt, kCCAlgorithmAES128, 0, key_.data(), key_.size(),
-                iv_.data(), data, data_size, dest, data_size, &length);
+    CCCryptorStatus result = CCCryptorUpdate(extra_->cryptor, data, data_size,
+                                             dest, data_size, &length);
     if (result != kCCSuccess) {
       LOG(ERROR) << "Error decrypting data: " << result;
       return false;
@@ -101,10 +144,6 @@ bool Decryptor::DecryptPartialBlock(const uint8_t* data, size_t data_size,
       LOG(ERROR) << "Not all data decrypted";
       return false;
     }
-
-    if (data_size >= AES_BLOCK_SIZE) {
-      iv_.assign(data + data_size - AES_BLOCK_SIZE, data + data_size);
-    }
   }
 
   return true;
@@ -115,6 +154,18 @@ bool Decryptor::Decrypt(const uint8_t* data, size_t data_size, uint8_t* dest) {
 }
 
 bool Decryptor::InitIfNeeded() {
+  if (!extra_->cryptor) {
+    const bool is_ctr = scheme_ == eme::EncryptionScheme::AesCtr;
+    CCCryptorStatus result = CCCryptorCreate(
+        is_ctr ? kCCEncrypt : kCCDecrypt, kCCAlgorithmAES128,
+        is_ctr ? kCCOptionECBMode : 0, key_.data(), key_.size(),
+        is_ctr ? nullptr : iv_.data(), &extra_->cryptor);
+    if (result != kCCSuccess) {
+      LOG(ERROR) << "Error creating cryptor: " << result;
+      extra_->cryptor = nullptr;
+      return false;
+    }
+  }
   return true;
 }
 
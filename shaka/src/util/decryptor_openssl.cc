@@ -17,6 +17,7 @@
 #include <openssl/err.h>
 #include <openssl/evp.h>
 
+#include "src/util/aes_kernel.h"
 #include "src/util/decryptor.h"
 
 namespace shaka {
@@ -30,44 +31,58 @@ struct Decryptor::Impl {
 Decryptor::Decryptor(eme::EncryptionScheme scheme,
                      const std::vector<uint8_t>& key,
                      const std::vector<uint8_t>& iv)
-    : scheme_(scheme), key_(key), iv_(iv), extra_(new Impl) {
+    : scheme_(scheme),
+      key_(key),
+      iv_(iv),
+      extra_(new Impl),
+      kernel_(AesKernel::Create(scheme, key)) {
   DCHECK_EQ(AES_BLOCK_SIZE, key.size());
   DCHECK_EQ(AES_BLOCK_SIZE, iv.size());
+  if (kernel_)
+    kernel_->SetIv(iv_.data());
 }
 
 Decryptor::~Decryptor() {}
 
+bool Decryptor::ResetIv(const std::vector<uint8_t>& iv) {
+  DCHECK_EQ(AES_BLOCK_SIZE, iv.size());
+  iv_ = iv;
+  if (kernel_) {
+    kernel_->SetIv(iv_.data());
+    return true;
+  }
+  // If the context hasn't been created yet, it will use the new IV.
+  if (!extra_->ctx)
+    return true;
+
+  // Passing no cipher or key only resets the IV and keeps the key schedule.
+  if (!EVP_DecryptInit_ex(extra_->ctx.get(), nullptr, nullptr, nullptr,
+                          iv_.data()) ||
+      !EVP_CIPHER_CTX_set_padding(extra_->ctx.get(), 0)) {
+    LOG(ERROR) << "Error resetting OpenSSL context: "
+               << ERR_error_string(ERR_get_error(), nullptr);
+    return false;
+  }
+  return true;
+}
+
 bool Decryptor::DecryptPartialBlock(const uint8_t* data, size_t data_size,
                                     uint32_t block_offset, uint8_t* dest) {
   DCHECK_LE(block_offset + data_size, AES_BLOCK_SIZE);
 
-  if (!InitIfNeeded())
-    return false;
-
   if (scheme_ != eme::EncryptionScheme::AesCtr) {
     LOG(ERROR) << "Cannot have block offset when using CBC";
     return false;
   }
-
-  uint8_t temp_source[AES_BLOCK_SIZE] = {0};
-  uint8_t temp_dest[AES_BLOCK_SIZE];
-  const size_t partial_size =
-      std::min<size_t>(AES_BLOCK_SIZE - block_offset, data_size);
-  memcpy(temp_source + block_offset, data, partial_size);
-
-  int num_bytes_read;
-  if (!EVP_DecryptUpdate(extra_->ctx.get(), temp_dest, &num_bytes_read,
-                         temp_source, AES_BLOCK_SIZE) ||
-      num_bytes_read != AES_BLOCK_SIZE) {
-    LOG(ERROR) << "Error decrypting data: "
-               << ERR_error_string(ERR_get_error(), nullptr);
-    return false;
-  }
-  memcpy(dest, temp_dest + block_offset, partial_size);
-  return true;
+  // The cipher context (or kernel) keeps the rest of the keystream from the
+  // previous call, so this continues from the current offset in the block.
+  return Decrypt(data, data_size, dest);
 }
 
 bool Decryptor::Decrypt(const uint8_t* data, size_t data_size, uint8_t* dest) {
+  if (kernel_)
+    return kernel_->Decrypt(data, data_size, dest);
+
   if (!InitIfNeeded())
     return false;
 
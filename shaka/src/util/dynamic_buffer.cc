@@ -18,12 +18,130 @@
 
 #include <algorithm>
 #include <cstring>
+#include <mutex>
+#include <utility>
 
 namespace shaka {
 namespace util {
 
+namespace {
+
+/** Chunks bigger than this are freed instead of pooled. */
+constexpr const size_t kMaxPooledChunkSize = 4 * 1024 * 1024;
+/** The most memory the pool will keep in unused chunks. */
+constexpr const size_t kMaxPooledBytes = 8 * 1024 * 1024;
+
+}  // namespace
+
+/** A sub-buffer; once unused, this is returned to the ChunkPool. */
+struct DynamicBuffer::Chunk {
+  explicit Chunk(media::MediaBuffer buffer) : buffer(std::move(buffer)) {}
+
+  media::MediaBuffer buffer;
+};
+
+/**
+ * Holds unused chunks so they can be reused by other buffers.  Chunk sizes are
+ * powers of two, starting at kMinBufferSize, so each size class can be reused
+ * for any allocation that fits in it.
+ */
+class DynamicBuffer::ChunkPool {
+ public:
+  static ChunkPool* Instance() {
+    // Intentionally leaked since chunks can be freed during static destruction.
+    static ChunkPool* pool = new ChunkPool;
+    return pool;
+  }
+
+  std::shared_ptr<Chunk> Acquire(size_t size) {
+    size_t capacity = kMinBufferSize;
+    size_t size_class = 0;
+    while (capacity < size && capacity <= kMaxPooledChunkSize) {
+      capacity *= 2;
+      size_class++;
+    }
+
+    media::MediaBuffer buffer;
+    if (capacity <= kMaxPooledChunkSize) {
+      std::unique_lock<std::mutex> lock(mutex_);
+      auto& chunks = chunks_[size_class];
+      if (!chunks.empty()) {
+        buffer = std::move(chunks.back());
+        chunks.pop_back();
+        pooled_bytes_ -= buffer.size();
+      }
+    } else {
+      capacity = size;
+    }
+    if (!buffer.data()) {
+      buffer = media::MediaBuffer(capacity,
+                                  media::MediaAllocationCategory::Network);
+      CHECK(buffer.data()) << "Unable to allocate network buffer";
+    }
+
+    return std::shared_ptr<Chunk>(new Chunk(std::move(buffer)),
+                                  [this](Chunk* chunk) { Release(chunk); });
+  }
+
+ private:
+  static constexpr const size_t kSizeClassCount = 7;
+  static_assert(kMinBufferSize << (kSizeClassCount - 1) == kMaxPooledChunkSize,
+                "Size classes must cover every pooled size");
+
+  ChunkPool() : pooled_bytes_(0) {}
+
+  void Release(Chunk* chunk) {
+    const size_t size = chunk->buffer.size();
+    if (size <= kMaxPooledChunkSize) {
+      size_t size_class = 0;
+      while ((kMinBufferSize << size_class) < size)
+        size_class++;
+
+      std::unique_lock<std::mutex> lock(mutex_);
+      if (pooled_bytes_ + size <= kMaxPooledBytes) {
+        pooled_bytes_ += size;
+        chunks_[size_class].emplace_back(std::move(chunk->buffer));
+      }
+    }
+    delete chunk;
+  }
+
+  std::mutex mutex_;
+  std::vector<media::MediaBuffer> chunks_[kSizeClassCount];
+  size_t pooled_bytes_;
+};
+
 const size_t DynamicBuffer::kMinBufferSize;
 
+
+DynamicBuffer::Slice::Slice() : size_(0) {}
+DynamicBuffer::Slice::~Slice() {}
+
+DynamicBuffer::Slice::Slice(const Slice&) = default;
+DynamicBuffer::Slice::Slice(Slice&&) = default;
+DynamicBuffer::Slice& DynamicBuffer::Slice::operator=(const Slice&) = default;
+DynamicBuffer::Slice& DynamicBuffer::Slice::operator=(Slice&&) = default;
+
+size_t DynamicBuffer::Slice::Read(size_t offset, uint8_t* dest,
+                                  size_t size) const {
+  size_t copied = 0;
+  for (auto& range : ranges_) {
+    if (copied == size)
+      break;
+    if (offset >= range.size) {
+      offset -= range.size;
+      continue;
+    }
+
+    const size_t to_copy = std::min(range.size - offset, size - copied);
+    std::memcpy(dest + copied, range.data + offset, to_copy);
+    copied += to_copy;
+    offset = 0;
+  }
+  return copied;
+}
+
+
 DynamicBuffer::DynamicBuffer() {}
 DynamicBuffer::~DynamicBuffer() {}
 
@@ -40,8 +158,9 @@ size_t DynamicBuffer::Size() const {
 void DynamicBuffer::AppendCopy(const void* buffer, size_t size) {
   if (!buffers_.empty()) {
     auto* info = &buffers_.back();
-    const size_t to_copy = std::min(info->capacity - info->used, size);
-    std::memcpy(info->buffer.get() + info->used, buffer, to_copy);
+    const size_t to_copy =
+        std::min(info->chunk->buffer.size() - info->used, size);
+    std::memcpy(info->chunk->buffer.data() + info->used, buffer, to_copy);
     info->used += to_copy;
     buffer = reinterpret_cast<const uint8_t*>(buffer) + to_copy;
     size -= to_copy;
@@ -49,12 +168,31 @@ void DynamicBuffer::AppendCopy(const void* buffer, size_t size) {
 
   if (size > 0) {
     const size_t capacity = std::max(kMinBufferSize, size);
-    auto* ptr = new uint8_t[capacity];
-    std::memcpy(ptr, buffer, size);
-    buffers_.emplace_back(ptr, size, capacity);
+    auto chunk = ChunkPool::Instance()->Acquire(capacity);
+    std::memcpy(chunk->buffer.data(), buffer, size);
+    buffers_.emplace_back(std::move(chunk), size);
   }
 }
 
+DynamicBuffer::Slice DynamicBuffer::GetSlice(size_t offset, size_t size) const {
+  Slice ret;
+  for (auto& buffer : buffers_) {
+    if (ret.size_ == size)
+      break;
+    if (offset >= buffer.used) {
+      offset -= buffer.used;
+      continue;
+    }
+
+    const size_t range_size = std::min(buffer.used - offset, size - ret.size_);
+    ret.ranges_.push_back(
+        {buffer.chunk, buffer.chunk->buffer.data() + offset, range_size});
+    ret.size_ += range_size;
+    offset = 0;
+  }
+  return ret;
+}
+
 std::string DynamicBuffer::CreateString() const {
   std::string ret(Size(), '\0');
   CopyDataTo(reinterpret_cast<uint8_t*>(&ret[0]), ret.size());
@@ -64,15 +202,14 @@ std::string DynamicBuffer::CreateString() const {
 void DynamicBuffer::CopyDataTo(uint8_t* dest, size_t size) const {
   for (auto& buffer : buffers_) {
     CHECK_GE(size, buffer.used);
-    std::memcpy(dest, buffer.buffer.get(), buffer.used);
+    std::memcpy(dest, buffer.chunk->buffer.data(), buffer.used);
     dest += buffer.used;
     size -= buffer.used;
   }
 }
 
-DynamicBuffer::SubBuffer::SubBuffer(uint8_t* buffer, size_t used,
-                                    size_t capacity)
-    : buffer(buffer), used(used), capacity(capacity) {}
+DynamicBuffer::SubBuffer::SubBuffer(std::shared_ptr<Chunk> chunk, size_t used)
+    : chunk(std::move(chunk)), used(used) {}
 
 DynamicBuffer::SubBuffer::~SubBuffer() {}
 
@@ -18,6 +18,9 @@
 #include <list>
 #include <memory>
 #include <string>
+#include <vector>
+
+#include "src/media/media_buffer.h"
 
 namespace shaka {
 namespace util {
@@ -27,9 +30,58 @@ namespace util {
  * copies.  This does so by storing an array of the sub-buffers it stores.  This
  * means that you cannot get a singular data pointer.  There are helper methods
  * that can copy this to a contiguous buffer (e.g. std::string).
+ *
+ * The sub-buffers are allocated from the MediaAllocator since this holds
+ * downloaded media.  Once they are no longer used, they are kept in a small
+ * process-wide pool (grouped by size) so the next buffer can reuse them.
  */
 class DynamicBuffer {
+ private:
+  struct Chunk;
+
  public:
+  /**
+   * A read-only view of part of a DynamicBuffer.  This holds a reference to
+   * the sub-buffers it uses, so it stays valid after the DynamicBuffer is
+   * cleared or destroyed; appending to the DynamicBuffer doesn't change it.
+   * This allows reading the data without first copying it to a contiguous
+   * buffer.
+   */
+  class Slice {
+   public:
+    Slice();
+    ~Slice();
+
+    Slice(const Slice&);
+    Slice(Slice&&);
+    Slice& operator=(const Slice&);
+    Slice& operator=(Slice&&);
+
+    /** @return The size of the slice, in bytes. */
+    size_t size() const {
+      return size_;
+    }
+
+    /**
+     * Copies up to |size| bytes, starting at the given offset in the slice,
+     * into the given buffer.
+     * @return The number of bytes copied.
+     */
+    size_t Read(size_t offset, uint8_t* dest, size_t size) const;
+
+   private:
+    friend class DynamicBuffer;
+
+    struct Range {
+      std::shared_ptr<const Chunk> chunk;
+      const uint8_t* data;
+      size_t size;
+    };
+
+    std::vector<Range> ranges_;
+    size_t size_;
+  };
+
   DynamicBuffer();
   ~DynamicBuffer();
 
@@ -41,7 +93,10 @@ class DynamicBuffer {
   /** @return The total size of the buffer, in bytes. */
   size_t Size() const;
 
-  /** Clears the contents of the buffer. */
+  /**
+   * Clears the contents of the buffer.  Sub-buffers that aren't used by a
+   * Slice are returned to the pool.
+   */
   void Clear() {
     buffers_.clear();
   }
@@ -49,6 +104,11 @@ class DynamicBuffer {
   /** Appends to the buffer by copying the given data. */
   void AppendCopy(const void* buffer, size_t size);
 
+  /**
+   * @return A read-only view of |size| bytes starting at the given offset.
+   *   The range is clamped to the current contents.
+   */
+  Slice GetSlice(size_t offset, size_t size) const;
 
   /** @return A new string that contains the data in the buffer. */
   std::string CreateString() const;
@@ -59,15 +119,16 @@ class DynamicBuffer {
  private:
   friend class DynamicBufferTest;
 
+  class ChunkPool;
+
   static constexpr const size_t kMinBufferSize = 64 * 1024;
 
   struct SubBuffer {
-    SubBuffer(uint8_t* buffer, size_t used, size_t capacity);
+    SubBuffer(std::shared_ptr<Chunk> chunk, size_t used);
     ~SubBuffer();
 
-    std::unique_ptr<uint8_t[]> buffer;
+    std::shared_ptr<Chunk> chunk;
     size_t used;
-    size_t capacity;
   };
 
   std::list<SubBuffer> buffers_;
@@ -21,6 +21,7 @@
 #include <glog/logging.h>
 
 #include <fstream>
+#include <utility>
 
 #include "src/util/cfref.h"
 
@@ -39,6 +40,43 @@ std::string GetBundleDir() {
 
 }  // namespace
 
+MappedFile::MappedFile() : data_(nullptr), size_(0) {}
+
+MappedFile::MappedFile(const uint8_t* data, size_t size,
+                       std::function<void()> unmap)
+    : data_(data), size_(size), unmap_(std::move(unmap)) {}
+
+MappedFile::MappedFile(MappedFile&& other) : MappedFile() {
+  *this = std::move(other);
+}
+
+MappedFile::~MappedFile() {
+  Reset();
+}
+
+MappedFile& MappedFile::operator=(MappedFile&& other) {
+  Reset();
+  data_ = other.data_;
+  size_ = other.size_;
+  unmap_ = other.Release();
+  return *this;
+}
+
+std::function<void()> MappedFile::Release() {
+  std::function<void()> ret = std::move(unmap_);
+  unmap_ = nullptr;
+  data_ = nullptr;
+  size_ = 0;
+  return ret;
+}
+
+void MappedFile::Reset() {
+  std::function<void()> unmap = Release();
+  if (unmap)
+    unmap();
+}
+
+
 FileSystem::FileSystem() {}
 FileSystem::~FileSystem() {}
 
@@ -121,5 +159,15 @@ bool FileSystem::WriteFile(const std::string& path,
   return true;
 }
 
+bool FileSystem::MapFile(const std::string& path, MappedFile* file) const {
+  const uint8_t* data;
+  size_t size;
+  std::function<void()> unmap = MapFile(path, &data, &size);
+  if (!unmap)
+    return false;
+  *file = MappedFile(data, size, std::move(unmap));
+  return true;
+}
+
 }  // namespace util
 }  // namespace shaka
@@ -15,6 +15,7 @@
 #ifndef SHAKA_EMBEDDED_UTIL_FILE_SYSTEM_H_
 #define SHAKA_EMBEDDED_UTIL_FILE_SYSTEM_H_
 
+#include <functional>
 #include <string>
 #include <vector>
 
@@ -23,6 +24,49 @@
 namespace shaka {
 namespace util {
 
+/**
+ * The contents of a file that is mapped into memory.  The file is unmapped
+ * when this is destroyed.
+ */
+class MappedFile {
+ public:
+  MappedFile();
+  MappedFile(const uint8_t* data, size_t size, std::function<void()> unmap);
+  MappedFile(MappedFile&& other);
+  ~MappedFile();
+
+  SHAKA_NON_COPYABLE_TYPE(MappedFile);
+
+  MappedFile& operator=(MappedFile&& other);
+
+  /** @return Whether this contains a mapped file. */
+  bool valid() const {
+    return data_ != nullptr;
+  }
+
+  const uint8_t* data() const {
+    return data_;
+  }
+
+  size_t size() const {
+    return size_;
+  }
+
+  /**
+   * Releases ownership of the mapping.  This object becomes invalid.
+   * @return A callback that unmaps the file.
+   */
+  std::function<void()> Release();
+
+  /** Unmaps the file, if any. */
+  void Reset();
+
+ private:
+  const uint8_t* data_;
+  size_t size_;
+  std::function<void()> unmap_;
+};
+
 /**
  * An abstraction of the file system.  This manages interactions with the file
  * system like reading and writing files.
@@ -39,6 +83,12 @@ class FileSystem {
   /** @return The directory name of the given path. */
   static std::string DirName(const std::string& path);
 
+  /**
+   * @return The given path made absolute using the working directory, or an
+   *   empty string on error.
+   */
+  static std::string AbsolutePath(const std::string& path);
+
   /** @return The full path to the given static file. */
   static std::string GetPathForStaticFile(const std::string& static_data_dir,
                                           bool is_bundle_relative,
@@ -97,6 +147,41 @@ class FileSystem {
    */
   MUST_USE_RESULT virtual bool WriteFile(
       const std::string& path, const std::vector<uint8_t>& data) const;
+
+  /**
+   * Writes the file so only the current user can read or write it (i.e. mode
+   * 0600).  If the file already exists, its permissions are reset too.
+   * @param path The path of the file to write to.
+   * @param data The data to write into the file.
+   * @return True on success, false on error.
+   */
+  MUST_USE_RESULT virtual bool WritePrivateFile(
+      const std::string& path, const std::vector<uint8_t>& data) const;
+
+  /**
+   * Maps the contents of the given file into memory.  The pages are only read
+   * from disk when they are used.  The mapping is private, so writes to the
+   * memory don't change the file.
+   *
+   * @param path The path of the file to map.
+   * @param data [OUT] Where to put the pointer to the contents of the file.
+   * @param size [OUT] Where to put the size of the file.
+   * @return A callback that unmaps the file, or nullptr on error.  The file
+   *   must not be empty.
+   */
+  virtual std::function<void()> MapFile(const std::string& path,
+                                        const uint8_t** data,
+                                        size_t* size) const;
+
+  /**
+   * Maps the contents of the given file into memory, like above.
+   *
+   * @param path The path of the file to map.
+   * @param file [OUT] Where to put the mapped file.
+   * @return True on success, false on error.
+   */
+  MUST_USE_RESULT bool MapFile(const std::string& path,
+                               MappedFile* file) const;
 };
 
 }  // namespace util
@@ -13,8 +13,13 @@
 // limitations under the License.
 
 #include <dirent.h>
+#include <errno.h>
+#include <fcntl.h>
 #include <glog/logging.h>
 #include <libgen.h>
+#include <limits.h>
+#include <string.h>
+#include <sys/mman.h>
 #include <sys/stat.h>
 #include <unistd.h>
 
@@ -50,6 +55,20 @@ std::string FileSystem::DirName(const std::string& path) {
   return dirname(&copy[0]);
 }
 
+// static
+std::string FileSystem::AbsolutePath(const std::string& path) {
+  if (!path.empty() && path[0] == kDirectorySeparator)
+    return path;
+
+  std::string cwd(PATH_MAX, '\0');
+  if (!getcwd(&cwd[0], cwd.size())) {
+    PLOG(ERROR) << "Error getting the working directory";
+    return "";
+  }
+  cwd.resize(strlen(cwd.c_str()));
+  return PathJoin(cwd, path);
+}
+
 bool FileSystem::FileExists(const std::string& path) const {
   // Cannot use fstream for this since it allows opening directories.
   struct stat info;
@@ -103,5 +122,67 @@ bool FileSystem::ListFiles(const std::string& path,
   return true;
 }
 
+bool FileSystem::WritePrivateFile(const std::string& path,
+                                  const std::vector<uint8_t>& data) const {
+  const int fd = open(path.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0600);
+  if (fd < 0) {
+    PLOG(ERROR) << "Error opening file '" << path << "'";
+    return false;
+  }
+  // The mode is only used when creating the file.
+  if (fchmod(fd, 0600) != 0) {
+    PLOG(ERROR) << "Error setting permissions of file '" << path << "'";
+    close(fd);
+    return false;
+  }
+
+  size_t written = 0;
+  while (written < data.size()) {
+    const ssize_t count =
+        write(fd, data.data() + written, data.size() - written);
+    if (count < 0 && errno == EINTR)
+      continue;
+    if (count < 0) {
+      PLOG(ERROR) << "Error writing file '" << path << "'";
+      close(fd);
+      return false;
+    }
+    written += count;
+  }
+  if (close(fd) != 0) {
+    PLOG(ERROR) << "Error writing file '" << path << "'";
+    return false;
+  }
+  return true;
+}
+
+std::function<void()> FileSystem::MapFile(const std::string& path,
+                                          const uint8_t** data,
+                                          size_t* size) const {
+  const int fd = open(path.c_str(), O_RDONLY);
+  if (fd < 0) {
+    PLOG(ERROR) << "Error opening file '" << path << "'";
+    return nullptr;
+  }
+
+  struct stat info;
+  void* ptr = MAP_FAILED;
+  if (fstat(fd, &info) == 0 && info.st_size > 0) {
+    ptr = mmap(nullptr, info.st_size, PROT_READ | PROT_WRITE, MAP_PRIVATE, fd,
+               0);
+  }
+  // The mapping stays valid after the file is closed.
+  close(fd);
+  if (ptr == MAP_FAILED) {
+    PLOG(ERROR) << "Error mapping file '" << path << "'";
+    return nullptr;
+  }
+
+  const size_t map_size = info.st_size;
+  *data = static_cast<const uint8_t*>(ptr);
+  *size = map_size;
+  return [ptr, map_size]() { munmap(ptr, map_size); };
+}
+
 }  // namespace util
 }  // namespace shaka
@@ -12,6 +12,9 @@
 // See the License for the specific language governing permissions and
 // limitations under the License.
 
+// Windows.h must be included before the other Windows headers.
+#include <Windows.h>
+
 #include <Shlwapi.h>
 #include <glog/logging.h>
 
@@ -34,6 +37,11 @@ std::string FileSystem::DirName(const std::string& path) {
 #error "Not implemented for Windows"
 }
 
+// static
+std::string FileSystem::AbsolutePath(const std::string& path) {
+#error "Not implemented for Windows"
+}
+
 bool FileSystem::FileExists(const std::string& path) const {
   // Cannot use fstream for this since it allows opening directories.
   return PathFileExists(path.c_str());
@@ -52,5 +60,47 @@ bool FileSystem::ListFiles(const std::string& path,
   return true;
 }
 
+bool FileSystem::WritePrivateFile(const std::string& path,
+                                  const std::vector<uint8_t>& data) const {
+#error "Not implemented for Windows"
+}
+
+std::function<void()> FileSystem::MapFile(const std::string& path,
+                                          const uint8_t** data,
+                                          size_t* size) const {
+  HANDLE file = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ,
+                            nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL,
+                            nullptr);
+  if (file == INVALID_HANDLE_VALUE) {
+    LOG(ERROR) << "Error opening file '" << path << "': " << GetLastError();
+    return nullptr;
+  }
+
+  LARGE_INTEGER file_size;
+  HANDLE mapping = nullptr;
+  if (GetFileSizeEx(file, &file_size) && file_size.QuadPart > 0) {
+    // Copy-on-write to match the private mappings on POSIX.
+    mapping = CreateFileMappingA(file, nullptr, PAGE_WRITECOPY, 0, 0, nullptr);
+  }
+  // The mapping object keeps the file open.
+  CloseHandle(file);
+  if (!mapping) {
+    LOG(ERROR) << "Error mapping file '" << path << "': " << GetLastError();
+    return nullptr;
+  }
+
+  void* ptr = MapViewOfFile(mapping, FILE_MAP_COPY, 0, 0, 0);
+  // The view keeps the mapping object alive.
+  CloseHandle(mapping);
+  if (!ptr) {
+    LOG(ERROR) << "Error mapping file '" << path << "': " << GetLastError();
+    return nullptr;
+  }
+
+  *data = static_cast<const uint8_t*>(ptr);
+  *size = static_cast<size_t>(file_size.QuadPart);
+  return [ptr]() { UnmapViewOfFile(ptr); };
+}
+
 }  // namespace util
 }  // namespace shaka
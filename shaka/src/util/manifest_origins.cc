@@ -0,0 +1,138 @@
+// Copyright 2020 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     https://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "src/util/manifest_origins.h"
+
+#include <algorithm>
+#include <utility>
+
+#include "src/util/url.h"
+#include "src/util/utils.h"
+
+namespace shaka {
+namespace util {
+
+namespace {
+
+/** The attributes that hold segment or playlist URLs. */
+constexpr const char* kUrlAttributes[] = {
+    // DASH
+    "media=\"",
+    "initialization=\"",
+    "sourceURL=\"",
+    // HLS
+    "URI=\"",
+};
+
+/** @return The origin of the given URL, or empty if it isn't http(s). */
+std::string GetOrigin(const std::string& source) {
+  Url url;
+  if (!Url::Parse(TrimAsciiWhitespace(source), &url) || !url.has_authority())
+    return "";
+  const std::string scheme = ToAsciiLower(url.scheme());
+  if ((scheme != "http" && scheme != "https") || url.host().empty())
+    return "";
+  // Leave out any user info; only the host is connected to.
+  const std::string port = url.port();
+  return scheme + "://" + ToAsciiLower(url.host()) +
+         (port.empty() ? "" : ":" + port) + "/";
+}
+
+class OriginList {
+ public:
+  OriginList(const std::string& manifest_url, size_t max_count)
+      : manifest_origin_(GetOrigin(manifest_url)), max_count_(max_count) {}
+
+  bool full() const {
+    return origins_.size() >= max_count_;
+  }
+
+  void Add(const std::string& url) {
+    const std::string origin = GetOrigin(url);
+    if (!full() && !origin.empty() && origin != manifest_origin_ &&
+        std::find(origins_.begin(), origins_.end(), origin) == origins_.end()) {
+      origins_.push_back(origin);
+    }
+  }
+
+  std::vector<std::string> Take() {
+    return std::move(origins_);
+  }
+
+ private:
+  const std::string manifest_origin_;
+  const size_t max_count_;
+  std::vector<std::string> origins_;
+};
+
+/** Adds the text between each |open| and the following |close|. */
+void AddDelimited(const std::string& manifest, const std::string& open,
+                  char close, OriginList* origins) {
+  size_t pos = 0;
+  while (!origins->full() &&
+         (pos = manifest.find(open, pos)) != std::string::npos) {
+    pos += open.size();
+    const size_t end = manifest.find(close, pos);
+    if (end == std::string::npos)
+      return;
+    origins->Add(manifest.substr(pos, end - pos));
+    pos = end;
+  }
+}
+
+/** Adds the DASH BaseURL elements, which can have attributes. */
+void AddBaseUrls(const std::string& manifest, OriginList* origins) {
+  size_t pos = 0;
+  while (!origins->full() &&
+         (pos = manifest.find("<BaseURL", pos)) != std::string::npos) {
+    pos = manifest.find('>', pos);
+    if (pos == std::string::npos)
+      return;
+    const size_t end = manifest.find('<', ++pos);
+    if (end == std::string::npos)
+      return;
+    origins->Add(manifest.substr(pos, end - pos));
+    pos = end;
+  }
+}
+
+/** Adds the HLS lines that aren't tags or comments. */
+void AddPlaylistLines(const std::string& manifest, OriginList* origins) {
+  size_t pos = 0;
+  while (!origins->full() && pos < manifest.size()) {
+    size_t end = manifest.find('\n', pos);
+    if (end == std::string::npos)
+      end = manifest.size();
+    if (manifest[pos] != '#')
+      origins->Add(manifest.substr(pos, end - pos));
+    pos = end + 1;
+  }
+}
+
+}  // namespace
+
+std::vector<std::string> FindManifestOrigins(const std::string& manifest,
+                                             const std::string& manifest_url,
+                                             size_t max_count) {
+  OriginList origins(manifest_url, max_count);
+  AddBaseUrls(manifest, &origins);
+  for (const char* attribute : kUrlAttributes)
+    AddDelimited(manifest, attribute, '"', &origins);
+  if (manifest.compare(0, 7, "#EXTM3U") == 0)
+    AddPlaylistLines(manifest, &origins);
+  return origins.Take();
+}
+
+}  // namespace util
+}  // namespace shaka
@@ -0,0 +1,46 @@
+// Copyright 2020 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     https://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef SHAKA_EMBEDDED_UTIL_MANIFEST_ORIGINS_H_
+#define SHAKA_EMBEDDED_UTIL_MANIFEST_ORIGINS_H_
+
+#include <stddef.h>
+
+#include <string>
+#include <vector>
+
+namespace shaka {
+namespace util {
+
+/**
+ * Finds the hosts the segments of the given DASH or HLS manifest are on, so
+ * they can be connected to before the manifest is parsed.  This looks at the
+ * DASH BaseURL elements and segment URL attributes and at the HLS URI lines
+ * and attributes.  Only absolute http(s) URLs are used; relative ones are on
+ * the manifest's host, which is already connected.
+ *
+ * @param manifest The text of the manifest.
+ * @param manifest_url The URL the manifest was loaded from.
+ * @param max_count The maximum number of origins to return.
+ * @return The distinct origins (e.g. "https://cdn.example.com:8443/"), in the
+ *   order they first appear, not including the manifest's own origin.
+ */
+std::vector<std::string> FindManifestOrigins(const std::string& manifest,
+                                             const std::string& manifest_url,
+                                             size_t max_count);
+
+}  // namespace util
+}  // namespace shaka
+
+#endif  // SHAKA_EMBEDDED_UTIL_MANIFEST_ORIGINS_H_
@@ -0,0 +1,76 @@
+// Copyright 2020 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     https://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "src/util/ring_buffer.h"
+
+#include <algorithm>
+#include <cstring>
+
+namespace shaka {
+namespace util {
+
+RingBuffer::RingBuffer() : read_pos_(0), write_pos_(0) {}
+
+RingBuffer::~RingBuffer() {}
+
+void RingBuffer::Reset(size_t capacity) {
+  // Use a power of two so the offsets stay correct when the positions wrap.
+  size_t size = capacity > 0 ? 1 : 0;
+  while (size < capacity)
+    size *= 2;
+  buffer_.assign(size, 0);
+  Clear();
+}
+
+void RingBuffer::Clear() {
+  read_pos_.store(0, std::memory_order_relaxed);
+  write_pos_.store(0, std::memory_order_release);
+}
+
+size_t RingBuffer::Write(const uint8_t* data, size_t size) {
+  const size_t capacity = buffer_.size();
+  const size_t write = write_pos_.load(std::memory_order_relaxed);
+  // Acquire so we don't overwrite data the consumer is still copying.
+  const size_t read = read_pos_.load(std::memory_order_acquire);
+  const size_t to_write = std::min(size, capacity - (write - read));
+  if (to_write == 0)
+    return 0;
+
+  const size_t offset = write % capacity;
+  const size_t first = std::min(to_write, capacity - offset);
+  std::memcpy(buffer_.data() + offset, data, first);
+  std::memcpy(buffer_.data(), data + first, to_write - first);
+  // Release so the consumer sees the data before the new position.
+  write_pos_.store(write + to_write, std::memory_order_release);
+  return to_write;
+}
+
+size_t RingBuffer::Read(uint8_t* dest, size_t size) {
+  const size_t capacity = buffer_.size();
+  const size_t read = read_pos_.load(std::memory_order_relaxed);
+  const size_t write = write_pos_.load(std::memory_order_acquire);
+  const size_t to_read = std::min(size, write - read);
+  if (to_read == 0)
+    return 0;
+
+  const size_t offset = read % capacity;
+  const size_t first = std::min(to_read, capacity - offset);
+  std::memcpy(dest, buffer_.data() + offset, first);
+  std::memcpy(dest + first, buffer_.data(), to_read - first);
+  read_pos_.store(read + to_read, std::memory_order_release);
+  return to_read;
+}
+
+}  // namespace util
+}  // namespace shaka
@@ -0,0 +1,91 @@
+// Copyright 2020 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     https://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef SHAKA_EMBEDDED_UTIL_RING_BUFFER_H_
+#define SHAKA_EMBEDDED_UTIL_RING_BUFFER_H_
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <atomic>
+#include <vector>
+
+#include "src/util/macros.h"
+
+namespace shaka {
+namespace util {
+
+/**
+ * A fixed-size, lock-free byte queue for a single producer thread and a single
+ * consumer thread.  This is used to pass data to real-time callbacks (e.g. an
+ * audio device) which can't block on a lock.
+ *
+ * Write() can only be called by the producer thread and Read() can only be
+ * called by the consumer thread; Size() can be called from either thread.
+ * Reset() and Clear() can only be called when neither thread is using the
+ * buffer.
+ */
+class RingBuffer {
+ public:
+  RingBuffer();
+  ~RingBuffer();
+
+  SHAKA_NON_COPYABLE_OR_MOVABLE_TYPE(RingBuffer);
+
+  /** @return The maximum number of bytes the buffer can hold. */
+  size_t Capacity() const {
+    return buffer_.size();
+  }
+
+  /** @return The number of bytes in the buffer that haven't been read. */
+  size_t Size() const {
+    // Load the read position first so the difference never underflows.
+    const size_t read = read_pos_.load(std::memory_order_acquire);
+    const size_t write = write_pos_.load(std::memory_order_acquire);
+    return write - read;
+  }
+
+  /**
+   * Clears the contents and changes the capacity of the buffer.  The capacity
+   * is rounded up to a power of two.
+   */
+  void Reset(size_t capacity);
+
+  /** Clears the contents of the buffer. */
+  void Clear();
+
+  /**
+   * Copies as much of the given data into the buffer as will fit.
+   * @return The number of bytes written.
+   */
+  size_t Write(const uint8_t* data, size_t size);
+
+  /**
+   * Copies up to |size| bytes out of the buffer.
+   * @return The number of bytes read.
+   */
+  size_t Read(uint8_t* dest, size_t size);
+
+ private:
+  std::vector<uint8_t> buffer_;
+  // These are the total number of bytes written/read; they only increase, and
+  // the unsigned math still works when they wrap.
+  std::atomic<size_t> read_pos_;
+  std::atomic<size_t> write_pos_;
+};
+
+}  // namespace util
+}  // namespace shaka
+
+#endif  // SHAKA_EMBEDDED_UTIL_RING_BUFFER_H_
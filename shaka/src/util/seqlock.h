@@ -0,0 +1,96 @@
+// Copyright 2020 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     https://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef SHAKA_EMBEDDED_UTIL_SEQLOCK_H_
+#define SHAKA_EMBEDDED_UTIL_SEQLOCK_H_
+
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+
+#include <atomic>
+#include <thread>
+#include <type_traits>
+
+#include "src/util/macros.h"
+
+namespace shaka {
+namespace util {
+
+/**
+ * Holds a small value that is read often from many threads and changed
+ * rarely.  Readers never block or write shared memory, so they don't contend
+ * with each other; a read is retried if it overlaps a write.
+ *
+ * Store() can only be called by one thread at a time (e.g. while holding
+ * another lock); Load() can be called from any thread.
+ */
+template <typename T>
+class SeqLock {
+  static_assert(std::is_trivially_copyable<T>::value,
+                "SeqLock values must be trivially copyable");
+
+ public:
+  explicit SeqLock(const T& value = T()) : sequence_(0) {
+    Store(value);
+  }
+
+  SHAKA_NON_COPYABLE_OR_MOVABLE_TYPE(SeqLock);
+
+  /** Replaces the stored value. */
+  void Store(const T& value) {
+    uint64_t words[kWordCount] = {};
+    memcpy(words, &value, sizeof(T));
+
+    // An odd sequence marks a write in progress.
+    const uint32_t sequence = sequence_.load(std::memory_order_relaxed);
+    sequence_.store(sequence + 1, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+    for (size_t i = 0; i < kWordCount; i++)
+      words_[i].store(words[i], std::memory_order_relaxed);
+    sequence_.store(sequence + 2, std::memory_order_release);
+  }
+
+  /** @return A copy of the stored value. */
+  T Load() const {
+    uint64_t words[kWordCount];
+    while (true) {
+      const uint32_t before = sequence_.load(std::memory_order_acquire);
+      if ((before & 1) == 0) {
+        for (size_t i = 0; i < kWordCount; i++)
+          words[i] = words_[i].load(std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_acquire);
+        if (sequence_.load(std::memory_order_relaxed) == before)
+          break;
+      }
+      std::this_thread::yield();
+    }
+
+    T ret;
+    memcpy(&ret, words, sizeof(T));
+    return ret;
+  }
+
+ private:
+  static constexpr const size_t kWordCount =
+      (sizeof(T) + sizeof(uint64_t) - 1) / sizeof(uint64_t);
+
+  std::atomic<uint32_t> sequence_;
+  std::atomic<uint64_t> words_[kWordCount];
+};
+
+}  // namespace util
+}  // namespace shaka
+
+#endif  // SHAKA_EMBEDDED_UTIL_SEQLOCK_H_
@@ -0,0 +1,340 @@
+// Copyright 2020 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     https://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "src/util/url.h"
+
+#include <glog/logging.h>
+#include <string.h>
+
+#include <algorithm>
+#include <limits>
+#include <list>
+#include <mutex>
+#include <unordered_map>
+#include <utility>
+
+namespace shaka {
+namespace util {
+
+namespace {
+
+/** The number of resolved URLs ResolveUrl keeps. */
+constexpr const size_t kResolveCacheSize = 256;
+
+bool IsAlpha(char c) {
+  return (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z');
+}
+
+bool IsValidScheme(const std::string& source, size_t end) {
+  if (end == 0 || !IsAlpha(source[0]))
+    return false;
+  for (size_t i = 1; i < end; i++) {
+    const char c = source[i];
+    if (!IsAlpha(c) && !(c >= '0' && c <= '9') && c != '+' && c != '-' &&
+        c != '.') {
+      return false;
+    }
+  }
+  return true;
+}
+
+/** Implements the remove_dot_segments algorithm from RFC 3986 section 5.2.4. */
+std::string RemoveDotSegments(std::string input) {
+  std::string output;
+  output.reserve(input.size());
+  auto remove_last_segment = [&output]() {
+    const size_t pos = output.rfind('/');
+    output.erase(pos == std::string::npos ? 0 : pos);
+  };
+
+  // Rather than removing from the front of |input|, this moves |i| forward.
+  // When a prefix is replaced by "/", the last character of the prefix is
+  // changed to "/" instead.
+  size_t i = 0;
+  while (i < input.size()) {
+    const size_t remaining = input.size() - i;
+    if (input.compare(i, 3, "../") == 0) {
+      i += 3;
+    } else if (input.compare(i, 2, "./") == 0) {
+      i += 2;
+    } else if (input.compare(i, 3, "/./") == 0) {
+      i += 2;
+    } else if (remaining == 2 && input.compare(i, 2, "/.") == 0) {
+      i++;
+      input[i] = '/';
+    } else if (input.compare(i, 4, "/../") == 0) {
+      i += 3;
+      remove_last_segment();
+    } else if (remaining == 3 && input.compare(i, 3, "/..") == 0) {
+      i += 2;
+      input[i] = '/';
+      remove_last_segment();
+    } else if ((remaining == 1 && input[i] == '.') ||
+               (remaining == 2 && input.compare(i, 2, "..") == 0)) {
+      break;
+    } else {
+      size_t next = input.find('/', i + 1);
+      if (next == std::string::npos)
+        next = input.size();
+      output.append(input, i, next - i);
+      i = next;
+    }
+  }
+  return output;
+}
+
+/** A least-recently-used cache of resolved URLs. */
+class ResolveCache {
+ public:
+  bool Get(const std::string& key, std::string* result) {
+    std::unique_lock<std::mutex> lock(mutex_);
+    auto it = index_.find(key);
+    if (it == index_.end())
+      return false;
+    entries_.splice(entries_.begin(), entries_, it->second);
+    *result = it->second->second;
+    return true;
+  }
+
+  void Put(const std::string& key, const std::string& result) {
+    std::unique_lock<std::mutex> lock(mutex_);
+    if (index_.count(key) > 0)
+      return;
+    entries_.emplace_front(key, result);
+    index_.emplace(key, entries_.begin());
+    if (entries_.size() > kResolveCacheSize) {
+      index_.erase(entries_.back().first);
+      entries_.pop_back();
+    }
+  }
+
+ private:
+  using Entry = std::pair<std::string, std::string>;
+
+  std::mutex mutex_;
+  // Most recently used first.
+  std::list<Entry> entries_;
+  std::unordered_map<std::string, std::list<Entry>::iterator> index_;
+};
+
+}  // namespace
+
+Url::Url() {}
+Url::Url(const Url&) = default;
+Url::Url(Url&&) = default;
+Url::~Url() {}
+
+Url& Url::operator=(const Url&) = default;
+Url& Url::operator=(Url&&) = default;
+
+// static
+bool Url::Parse(const std::string& source, Url* url) {
+  if (source.size() >= std::numeric_limits<uint32_t>::max())
+    return false;
+  for (char c : source) {
+    if ((c >= 0 && c < 0x20) || c == 0x7f)
+      return false;
+  }
+
+  // This follows the regular expression from RFC 3986 appendix B.
+  Url ret;
+  size_t pos = 0;
+  const size_t scheme_end = source.find_first_of(":/?#");
+  if (scheme_end != std::string::npos && source[scheme_end] == ':' &&
+      scheme_end > 0) {
+    if (!IsValidScheme(source, scheme_end))
+      return false;
+    ret.scheme_end_ = static_cast<uint32_t>(scheme_end);
+    pos = scheme_end + 1;
+  }
+
+  if (source.compare(pos, 2, "//") == 0) {
+    ret.has_authority_ = true;
+    pos = std::min(source.find_first_of("/?#", pos + 2), source.size());
+  }
+
+  ret.path_begin_ = static_cast<uint32_t>(pos);
+  pos = std::min(source.find_first_of("?#", pos), source.size());
+  ret.path_end_ = static_cast<uint32_t>(pos);
+
+  if (pos < source.size() && source[pos] == '?') {
+    ret.has_query_ = true;
+    pos = std::min(source.find('#', pos), source.size());
+  }
+  ret.query_end_ = static_cast<uint32_t>(pos);
+  ret.has_fragment_ = pos < source.size();
+
+  ret.spec_ = source;
+  *url = std::move(ret);
+  return true;
+}
+
+std::string Url::scheme() const {
+  return spec_.substr(0, scheme_end_);
+}
+
+std::string Url::authority() const {
+  if (!has_authority_)
+    return "";
+  const size_t begin = (is_absolute() ? scheme_end_ + 1 : 0) + 2;
+  return spec_.substr(begin, path_begin_ - begin);
+}
+
+std::string Url::host() const {
+  std::string ret = authority();
+  const size_t at = ret.rfind('@');
+  if (at != std::string::npos)
+    ret.erase(0, at + 1);
+  // Don't treat the colons in an IPv6 address as the port.
+  const size_t colon = ret.rfind(':');
+  if (colon != std::string::npos && ret.find(']', colon) == std::string::npos)
+    ret.erase(colon);
+  return ret;
+}
+
+std::string Url::port() const {
+  const std::string auth = authority();
+  const size_t colon = auth.rfind(':');
+  if (colon == std::string::npos ||
+      auth.find_first_of("]@", colon) != std::string::npos) {
+    return "";
+  }
+  return auth.substr(colon + 1);
+}
+
+std::string Url::path() const {
+  return spec_.substr(path_begin_, path_end_ - path_begin_);
+}
+
+std::string Url::query() const {
+  if (!has_query_)
+    return "";
+  return spec_.substr(path_end_ + 1, query_end_ - path_end_ - 1);
+}
+
+std::string Url::fragment() const {
+  if (!has_fragment_)
+    return "";
+  return spec_.substr(query_end_ + 1);
+}
+
+Url Url::Resolve(const Url& reference) const {
+  DCHECK(is_absolute());
+
+  // RFC 3986 section 5.2.2.
+  const Url* authority_source;
+  const Url* query_source;
+  std::string path;
+  if (reference.is_absolute()) {
+    return reference.ResolveAbsolute();
+  } else if (reference.has_authority_) {
+    authority_source = &reference;
+    query_source = &reference;
+    path = RemoveDotSegments(reference.path());
+  } else if (reference.path_begin_ == reference.path_end_) {
+    authority_source = this;
+    query_source = reference.has_query_ ? &reference : this;
+    path = this->path();
+  } else {
+    authority_source = this;
+    query_source = &reference;
+    if (reference.spec_[reference.path_begin_] == '/') {
+      path = RemoveDotSegments(reference.path());
+    } else if (has_authority_ && path_begin_ == path_end_) {
+      // RFC 3986 section 5.2.3.
+      path = RemoveDotSegments("/" + reference.path());
+    } else {
+      const size_t slash = spec_.rfind('/', path_end_ - 1);
+      const size_t dir_end =
+          slash == std::string::npos || slash < path_begin_ ? path_begin_
+                                                            : slash + 1;
+      path = RemoveDotSegments(
+          spec_.substr(path_begin_, dir_end - path_begin_) + reference.path());
+    }
+  }
+
+  // RFC 3986 section 5.3.
+  std::string spec;
+  spec.reserve(spec_.size() + reference.spec_.size());
+  spec.append(spec_, 0, scheme_end_ + 1);
+  if (authority_source->has_authority_)
+    spec += "//" + authority_source->authority();
+  spec += path;
+  if (query_source->has_query_)
+    spec += "?" + query_source->query();
+  if (reference.has_fragment_)
+    spec += "#" + reference.fragment();
+
+  Url ret;
+  CHECK(Parse(spec, &ret));
+  return ret;
+}
+
+Url Url::ResolveAbsolute() const {
+  std::string spec;
+  spec.reserve(spec_.size());
+  spec.append(spec_, 0, path_begin_);
+  spec += RemoveDotSegments(path());
+  spec.append(spec_, path_end_, std::string::npos);
+
+  Url ret;
+  CHECK(Parse(spec, &ret));
+  return ret;
+}
+
+bool ResolveUrl(const std::string& base, const std::string& relative,
+                std::string* result) {
+  static ResolveCache* cache = new ResolveCache;
+
+  // Neither URL can contain a newline, so this is unique.
+  const std::string key = base + "\n" + relative;
+  if (cache->Get(key, result))
+    return true;
+
+  Url base_url;
+  Url relative_url;
+  if (!Url::Parse(base, &base_url) || !base_url.is_absolute() ||
+      !Url::Parse(relative, &relative_url)) {
+    return false;
+  }
+
+  *result = base_url.Resolve(relative_url).spec();
+  cache->Put(key, *result);
+  return true;
+}
+
+std::string FilePathToUrl(const std::string& path) {
+  constexpr const char kHex[] = "0123456789ABCDEF";
+  // The characters allowed in a path segment (RFC 3986 section 3.3), plus the
+  // separator.
+  constexpr const char kAllowed[] = "-._~!$&'()*+,;=:@/";
+  std::string ret = "file://";
+  if (path.empty() || path[0] != '/')
+    ret += '/';
+  for (char c : path) {
+    const uint8_t b = static_cast<uint8_t>(c);
+    if (IsAlpha(c) || (c >= '0' && c <= '9') ||
+        memchr(kAllowed, c, sizeof(kAllowed) - 1) != nullptr) {
+      ret += c;
+    } else {
+      ret += '%';
+      ret += kHex[b >> 4];
+      ret += kHex[b & 0xf];
+    }
+  }
+  return ret;
+}
+
+}  // namespace util
+}  // namespace shaka
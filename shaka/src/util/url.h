@@ -0,0 +1,124 @@
+// Copyright 2020 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     https://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef SHAKA_EMBEDDED_UTIL_URL_H_
+#define SHAKA_EMBEDDED_UTIL_URL_H_
+
+#include <stdint.h>
+
+#include <string>
+
+namespace shaka {
+namespace util {
+
+/**
+ * A parsed URL reference (RFC 3986).  This stores the URL once along with the
+ * offsets of each component, so parsing doesn't allocate a string per
+ * component.  The accessors return the components without their delimiters.
+ *
+ * Parsing is purely syntactic; it doesn't normalize the URL or check the
+ * components beyond the scheme.  Control characters are rejected.
+ */
+class Url final {
+ public:
+  Url();
+  Url(const Url&);
+  Url(Url&&);
+  ~Url();
+
+  Url& operator=(const Url&);
+  Url& operator=(Url&&);
+
+  /**
+   * Parses the given URL reference, which can be absolute or relative.
+   * @return True on success, false if the URL is invalid.
+   */
+  static bool Parse(const std::string& source, Url* url);
+
+  /** @return The whole URL. */
+  const std::string& spec() const {
+    return spec_;
+  }
+
+  bool is_absolute() const {
+    return scheme_end_ != 0;
+  }
+  bool has_authority() const {
+    return has_authority_;
+  }
+  bool has_query() const {
+    return has_query_;
+  }
+  bool has_fragment() const {
+    return has_fragment_;
+  }
+
+  std::string scheme() const;
+  std::string authority() const;
+  /** @return The host from the authority, without user info or port. */
+  std::string host() const;
+  /** @return The port from the authority, empty if there isn't one. */
+  std::string port() const;
+  std::string path() const;
+  std::string query() const;
+  std::string fragment() const;
+
+  /**
+   * Resolves the given reference against this URL (RFC 3986 section 5.2).
+   * This URL must be absolute.
+   */
+  Url Resolve(const Url& reference) const;
+
+ private:
+  /** @return A copy of this URL with the dot segments removed from the path. */
+  Url ResolveAbsolute() const;
+
+  std::string spec_;
+  // |spec_| is laid out as:
+  //   [scheme ":"] ["//" authority] path ["?" query] ["#" fragment]
+  // The scheme ends at |scheme_end_| (0 if there is no scheme); the authority
+  // ends at |path_begin_|; the query ends at |query_end_|.
+  uint32_t scheme_end_ = 0;
+  uint32_t path_begin_ = 0;
+  uint32_t path_end_ = 0;
+  uint32_t query_end_ = 0;
+  bool has_authority_ = false;
+  bool has_query_ = false;
+  bool has_fragment_ = false;
+};
+
+/**
+ * Resolves |relative| against |base|, like Url::Resolve.  Manifests resolve
+ * the same relative URLs against the same base many times (e.g. on every
+ * refresh), so recent results are cached.  This is thread-safe.
+ *
+ * @param base The absolute URL to resolve against.
+ * @param relative The URL reference to resolve.
+ * @param result [OUT] Will contain the resolved URL.
+ * @return True on success, false if either URL is invalid or |base| isn't
+ *   absolute.
+ */
+bool ResolveUrl(const std::string& base, const std::string& relative,
+                std::string* result);
+
+/**
+ * Converts the given absolute file path to a file: URL.  Bytes that can't
+ * appear in a URL path are percent-encoded.
+ */
+std::string FilePathToUrl(const std::string& path);
+
+}  // namespace util
+}  // namespace shaka
+
+#endif  // SHAKA_EMBEDDED_UTIL_URL_H_
@@ -0,0 +1,102 @@
+// Copyright 2020 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     https://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "src/util/utf8.h"
+
+#include <string.h>
+
+#if defined(__SSE2__) || defined(_M_X64)
+#  include <emmintrin.h>
+#  define USE_SSE2
+#elif defined(__aarch64__) && defined(__ARM_NEON)
+#  include <arm_neon.h>
+#  define USE_NEON
+#endif
+
+namespace shaka {
+namespace util {
+
+size_t AsciiPrefixLength(const uint8_t* data, size_t size) {
+  size_t i = 0;
+#if defined(USE_SSE2)
+  for (; i + 16 <= size; i += 16) {
+    const __m128i chunk =
+        _mm_loadu_si128(reinterpret_cast<const __m128i*>(data + i));
+    if (_mm_movemask_epi8(chunk) != 0)
+      break;
+  }
+#elif defined(USE_NEON)
+  for (; i + 16 <= size; i += 16) {
+    if (vmaxvq_u8(vld1q_u8(data + i)) >= 0x80)
+      break;
+  }
+#else
+  for (; i + 8 <= size; i += 8) {
+    uint64_t chunk;
+    memcpy(&chunk, data + i, sizeof(chunk));
+    if (chunk & 0x8080808080808080ULL)
+      break;
+  }
+#endif
+
+  // Find the exact position within the chunk that failed, or check the tail.
+  while (i < size && data[i] < 0x80)
+    i++;
+  return i;
+}
+
+bool IsValidUtf8(const uint8_t* data, size_t size) {
+  size_t i = 0;
+  while (true) {
+    i += AsciiPrefixLength(data + i, size - i);
+    if (i == size)
+      return true;
+
+    // See the table of well-formed byte sequences in section 3.9 of the
+    // Unicode standard.  Only the second byte has a restricted range; the
+    // others must be in [0x80, 0xbf].
+    const uint8_t lead = data[i];
+    size_t length;
+    uint8_t min = 0x80;
+    uint8_t max = 0xbf;
+    if (lead >= 0xc2 && lead <= 0xdf) {
+      length = 2;
+    } else if (lead >= 0xe0 && lead <= 0xef) {
+      length = 3;
+      if (lead == 0xe0)
+        min = 0xa0;  // Overlong.
+      else if (lead == 0xed)
+        max = 0x9f;  // Surrogates.
+    } else if (lead >= 0xf0 && lead <= 0xf4) {
+      length = 4;
+      if (lead == 0xf0)
+        min = 0x90;  // Overlong.
+      else if (lead == 0xf4)
+        max = 0x8f;  // Above U+10FFFF.
+    } else {
+      return false;
+    }
+
+    if (size - i < length || data[i + 1] < min || data[i + 1] > max)
+      return false;
+    for (size_t j = 2; j < length; j++) {
+      if ((data[i + j] & 0xc0) != 0x80)
+        return false;
+    }
+    i += length;
+  }
+}
+
+}  // namespace util
+}  // namespace shaka
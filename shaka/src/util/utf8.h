@@ -0,0 +1,47 @@
+// Copyright 2020 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     https://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef SHAKA_EMBEDDED_UTIL_UTF8_H_
+#define SHAKA_EMBEDDED_UTIL_UTF8_H_
+
+#include <stddef.h>
+#include <stdint.h>
+
+namespace shaka {
+namespace util {
+
+/**
+ * @return The number of bytes at the start of the given buffer that are ASCII
+ *   (i.e. less than 0x80).  This checks 16 bytes at a time using SSE2 or NEON
+ *   when available.
+ */
+size_t AsciiPrefixLength(const uint8_t* data, size_t size);
+
+/** @return Whether the given buffer only contains ASCII characters. */
+inline bool IsAscii(const uint8_t* data, size_t size) {
+  return AsciiPrefixLength(data, size) == size;
+}
+
+/**
+ * @return Whether the given buffer is valid UTF-8.  This rejects overlong
+ *   encodings, surrogates, and code points above U+10FFFF.  Runs of ASCII are
+ *   skipped using AsciiPrefixLength, so mostly-ASCII text (e.g. manifests) is
+ *   checked at close to memory speed.
+ */
+bool IsValidUtf8(const uint8_t* data, size_t size);
+
+}  // namespace util
+}  // namespace shaka
+
+#endif  // SHAKA_EMBEDDED_UTIL_UTF8_H_
@@ -0,0 +1,255 @@
+// Copyright 2020 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     https://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "src/util/virtual_clock.h"
+
+#include <glog/logging.h>
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <functional>
+#include <limits>
+
+#include "src/debug/thread.h"
+
+namespace shaka {
+namespace util {
+
+namespace {
+
+/**
+ * The amount of real time that nothing can use the clock before the
+ * auto-advance thread moves the time forward.  This gives threads that were
+ * signaled by the woken threads a chance to run.
+ */
+constexpr const std::chrono::microseconds kQuietPeriod{100};
+
+/**
+ * The amount of real time to wait for threads that were woken by the clock
+ * to wait on it again.  Those threads may be blocked on something else (or
+ * may have exited), so the time is advanced anyway after this.
+ */
+constexpr const std::chrono::milliseconds kStallPeriod{10};
+
+/** The clock that woke the current thread, if it hasn't waited again. */
+thread_local const VirtualClock* woken_by = nullptr;
+
+uint64_t ToMilliseconds(double seconds) {
+  if (seconds <= 0)
+    return 0;
+  return static_cast<uint64_t>(std::ceil(seconds * 1000));
+}
+
+}  // namespace
+
+VirtualClock::VirtualClock(uint64_t start_time)
+    : activity_(0), busy_(0), now_(start_time), auto_advance_(false) {}
+
+VirtualClock::~VirtualClock() {
+  StopAutoAdvance();
+  DCHECK(waiters_.empty());
+}
+
+uint64_t VirtualClock::GetMonotonicTime() const {
+  std::unique_lock<std::mutex> lock(mutex_);
+  return now_;
+}
+
+uint64_t VirtualClock::GetEpochTime() const {
+  return GetMonotonicTime();
+}
+
+void VirtualClock::SleepSeconds(double seconds) const {
+  std::unique_lock<std::mutex> lock(mutex_);
+  Waiter waiter{now_ + ToMilliseconds(seconds), nullptr, nullptr, false, 0};
+  if (waiter.deadline == now_)
+    return;
+
+  AddWaiter(&waiter);
+  while (!waiter.woken)
+    time_cond_.wait(lock);
+  RemoveWaiter(&waiter);
+}
+
+void VirtualClock::WaitForSignal(std::condition_variable* cond,
+                                 std::unique_lock<std::mutex>* lock,
+                                 double seconds) const {
+  if (std::isinf(seconds)) {
+    cond->wait(*lock);
+    return;
+  }
+
+  Waiter waiter{0, cond, lock->mutex(), false, 0};
+  {
+    std::unique_lock<std::mutex> clock_lock(mutex_);
+    waiter.deadline = now_ + ToMilliseconds(seconds);
+    if (waiter.deadline == now_)
+      return;
+    AddWaiter(&waiter);
+  }
+
+  // Since we hold |lock| until we start waiting and AdvanceTo() locks it
+  // before signaling, we can't miss the wakeup.
+  cond->wait(*lock);
+
+  // AdvanceTo() may be about to lock the mutex to signal us, so we need to
+  // release it while we wait for that to finish.
+  lock->unlock();
+  {
+    std::unique_lock<std::mutex> clock_lock(mutex_);
+    while (waiter.pins > 0)
+      unpin_cond_.wait(clock_lock);
+    RemoveWaiter(&waiter);
+  }
+  lock->lock();
+}
+
+size_t VirtualClock::WaiterCount() const {
+  std::unique_lock<std::mutex> lock(mutex_);
+  return waiters_.size();
+}
+
+void VirtualClock::AdvanceTime(uint64_t delta_ms) {
+  uint64_t time;
+  {
+    std::unique_lock<std::mutex> lock(mutex_);
+    time = now_ + delta_ms;
+  }
+  AdvanceTo(time);
+}
+
+bool VirtualClock::AdvanceToNextDeadline() {
+  uint64_t deadline = std::numeric_limits<uint64_t>::max();
+  {
+    std::unique_lock<std::mutex> lock(mutex_);
+    for (Waiter* waiter : waiters_) {
+      if (!waiter->woken)
+        deadline = std::min(deadline, waiter->deadline);
+    }
+  }
+  if (deadline == std::numeric_limits<uint64_t>::max())
+    return false;
+
+  AdvanceTo(deadline);
+  return true;
+}
+
+void VirtualClock::StartAutoAdvance() {
+  std::unique_lock<std::mutex> lock(mutex_);
+  if (thread_)
+    return;
+  auto_advance_ = true;
+  thread_.reset(
+      new Thread("VirtualClock", std::bind(&VirtualClock::AutoAdvanceMain,
+                                           this)));
+}
+
+void VirtualClock::StopAutoAdvance() {
+  std::unique_ptr<Thread> thread;
+  {
+    std::unique_lock<std::mutex> lock(mutex_);
+    auto_advance_ = false;
+    advance_cond_.notify_all();
+    thread.swap(thread_);
+  }
+  if (thread)
+    thread->join();
+}
+
+void VirtualClock::AddWaiter(Waiter* waiter) const {
+  // |mutex_| is held by the caller.
+  waiters_.push_back(waiter);
+  activity_++;
+  if (woken_by == this) {
+    woken_by = nullptr;
+    if (busy_ > 0 && --busy_ == 0)
+      advance_cond_.notify_all();
+  }
+}
+
+void VirtualClock::RemoveWaiter(Waiter* waiter) const {
+  // |mutex_| is held by the caller.
+  waiters_.erase(std::find(waiters_.begin(), waiters_.end(), waiter));
+  activity_++;
+  if (waiter->woken) {
+    woken_by = this;
+    busy_++;
+  }
+}
+
+void VirtualClock::AdvanceTo(uint64_t time) {
+  std::vector<Waiter*> to_signal;
+  {
+    std::unique_lock<std::mutex> lock(mutex_);
+    now_ = std::max(now_, time);
+    for (Waiter* waiter : waiters_) {
+      if (!waiter->woken && waiter->deadline <= now_) {
+        waiter->woken = true;
+        if (waiter->cond) {
+          waiter->pins++;
+          to_signal.push_back(waiter);
+        }
+      }
+    }
+    time_cond_.notify_all();
+  }
+
+  // The waiting threads hold their mutex until they start waiting, so locking
+  // it ensures they see the signal.  We can't hold |mutex_| here since the
+  // waiting threads lock it while holding their mutex.
+  for (Waiter* waiter : to_signal) {
+    std::unique_lock<std::mutex> lock(*waiter->mutex);
+    waiter->cond->notify_all();
+  }
+
+  if (!to_signal.empty()) {
+    std::unique_lock<std::mutex> lock(mutex_);
+    for (Waiter* waiter : to_signal)
+      waiter->pins--;
+    unpin_cond_.notify_all();
+  }
+}
+
+void VirtualClock::AutoAdvanceMain() {
+  std::unique_lock<std::mutex> lock(mutex_);
+  uint64_t last_activity = activity_;
+  auto quiet_since = std::chrono::steady_clock::now();
+  while (auto_advance_) {
+    advance_cond_.wait_for(lock, kQuietPeriod);
+    if (!auto_advance_)
+      break;
+
+    const auto real_now = std::chrono::steady_clock::now();
+    if (activity_ != last_activity) {
+      last_activity = activity_;
+      quiet_since = real_now;
+      continue;
+    }
+    if (busy_ > 0 && real_now - quiet_since < kStallPeriod)
+      continue;
+
+    // Any threads that are still busy are blocked on something else; don't
+    // wait for them again.
+    busy_ = 0;
+    lock.unlock();
+    AdvanceToNextDeadline();
+    lock.lock();
+    last_activity = activity_;
+    quiet_since = std::chrono::steady_clock::now();
+  }
+}
+
+}  // namespace util
+}  // namespace shaka
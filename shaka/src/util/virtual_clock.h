@@ -0,0 +1,132 @@
+// Copyright 2020 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     https://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef SHAKA_EMBEDDED_UTIL_VIRTUAL_CLOCK_H_
+#define SHAKA_EMBEDDED_UTIL_VIRTUAL_CLOCK_H_
+
+#include <stdint.h>
+
+#include <condition_variable>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+#include "src/util/clock.h"
+#include "src/util/macros.h"
+
+namespace shaka {
+
+class Thread;
+
+namespace util {
+
+/**
+ * A Clock that uses simulated time.  The time only moves forward when it is
+ * advanced, either manually using AdvanceTime() or by a background thread
+ * once the threads that wait on this clock are all blocked.  Waits complete
+ * as soon as the simulated time reaches their deadline, so a pipeline that
+ * uses this runs as fast as the CPU allows instead of in real time.  This is
+ * meant for load tests and fuzzing of long playbacks.
+ *
+ * To use this for the whole pipeline, pass it to Clock::SetInstanceOverride
+ * before creating any players.  Threads shouldn't wait on this clock while
+ * holding a mutex that another thread waits on using WaitForSignal, since
+ * waking that thread needs to lock the mutex.
+ *
+ * This type is thread-safe.
+ */
+class VirtualClock final : public Clock {
+ public:
+  /**
+   * @param start_time The time, in milliseconds, that the clock starts at.
+   *   This is used for both the monotonic and the epoch times.
+   */
+  explicit VirtualClock(uint64_t start_time);
+  ~VirtualClock() override;
+
+  SHAKA_NON_COPYABLE_OR_MOVABLE_TYPE(VirtualClock);
+
+  uint64_t GetMonotonicTime() const override;
+  uint64_t GetEpochTime() const override;
+  void SleepSeconds(double seconds) const override;
+  void WaitForSignal(std::condition_variable* cond,
+                     std::unique_lock<std::mutex>* lock,
+                     double seconds) const override;
+
+  /** @return The number of threads that are waiting on this clock. */
+  size_t WaiterCount() const;
+
+  /**
+   * Moves the time forward by the given number of milliseconds, waking any
+   * waits whose deadline is reached.
+   */
+  void AdvanceTime(uint64_t delta_ms);
+
+  /**
+   * Moves the time forward to the earliest deadline of the waiting threads.
+   * @return False if there are no threads waiting with a deadline.
+   */
+  bool AdvanceToNextDeadline();
+
+  /**
+   * Starts a background thread that calls AdvanceToNextDeadline() whenever
+   * the threads that were woken by this clock are waiting again and nothing
+   * else has used this clock for a short (real) time.  Threads that block on
+   * something other than this clock are given a longer time to wake up.
+   */
+  void StartAutoAdvance();
+
+  /** Stops the background thread started by StartAutoAdvance(). */
+  void StopAutoAdvance();
+
+ private:
+  struct Waiter {
+    uint64_t deadline;
+    // The condition variable and mutex to signal; these are null for sleeps.
+    std::condition_variable* cond;
+    std::mutex* mutex;
+    // Whether the deadline was reached.
+    bool woken;
+    // The number of threads that are signaling |cond|; the waiter can't be
+    // removed until this is 0.
+    size_t pins;
+  };
+
+  void AddWaiter(Waiter* waiter) const;
+  void RemoveWaiter(Waiter* waiter) const;
+  void AdvanceTo(uint64_t time);
+  void AutoAdvanceMain();
+
+  mutable std::mutex mutex_;
+  // Signaled when the time changes, to wake sleeping threads.
+  mutable std::condition_variable time_cond_;
+  // Signaled when a waiter is unpinned.
+  mutable std::condition_variable unpin_cond_;
+  // Signaled to wake the auto-advance thread.
+  mutable std::condition_variable advance_cond_;
+  mutable std::vector<Waiter*> waiters_;
+  // Incremented whenever a thread starts or stops waiting.
+  mutable uint64_t activity_;
+  // The number of threads that were woken by this clock and haven't waited on
+  // it again.
+  mutable size_t busy_;
+  uint64_t now_;
+  bool auto_advance_;
+  std::unique_ptr<Thread> thread_;
+};
+
+}  // namespace util
+}  // namespace shaka
+
+#endif  // SHAKA_EMBEDDED_UTIL_VIRTUAL_CLOCK_H_
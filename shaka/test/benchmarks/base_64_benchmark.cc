@@ -0,0 +1,80 @@
+// Copyright 2020 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     https://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <string>
+
+#include "benchmarks/benchmark.h"
+#include "src/js/base_64.h"
+
+namespace shaka {
+namespace benchmark {
+
+namespace {
+
+/** The input sizes to measure, from key IDs to large license payloads. */
+constexpr const size_t kSizes[] = {16, 1024, 1024 * 1024};
+
+ByteString MakeData(size_t size) {
+  ByteString ret(size);
+  for (size_t i = 0; i < size; i++)
+    ret[i] = static_cast<uint8_t>(i * 7 + 3);
+  return ret;
+}
+
+void RunEncode(size_t size, bool url, State* state) {
+  const ByteString data = MakeData(size);
+  while (state->KeepRunning()) {
+    const std::string encoded = url
+                                    ? js::Base64::EncodeUrl(data.data(), size)
+                                    : js::Base64::Encode(data.data(), size);
+    DoNotOptimize(encoded);
+  }
+  state->SetBytesProcessed(state->iterations() * size);
+}
+
+void RunDecode(size_t size, bool url, State* state) {
+  const ByteString data = MakeData(size);
+  const std::string encoded = url ? js::Base64::EncodeUrl(data.data(), size)
+                                  : js::Base64::Encode(data.data(), size);
+  while (state->KeepRunning()) {
+    ExceptionOr<ByteString> decoded =
+        url ? js::Base64::DecodeUrl(encoded) : js::Base64::Decode(encoded);
+    if (!holds_alternative<ByteString>(decoded)) {
+      state->SkipWithError("Error decoding");
+      return;
+    }
+    DoNotOptimize(decoded);
+  }
+  state->SetBytesProcessed(state->iterations() * size);
+}
+
+}  // namespace
+
+SHAKA_REGISTER_BENCHMARKS(RegisterBase64Benchmarks) {
+  for (size_t size : kSizes) {
+    for (bool url : {false, true}) {
+      const std::string suffix =
+          (url ? "url/" : "standard/") + std::to_string(size);
+      RegisterBenchmark("Base64/Encode/" + suffix, [=](State* state) {
+        RunEncode(size, url, state);
+      });
+      RegisterBenchmark("Base64/Decode/" + suffix, [=](State* state) {
+        RunDecode(size, url, state);
+      });
+    }
+  }
+}
+
+}  // namespace benchmark
+}  // namespace shaka
@@ -0,0 +1,316 @@
+// Copyright 2020 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     https://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "benchmarks/benchmark.h"
+
+#include <glog/logging.h>
+#include <inttypes.h>
+#include <stdio.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <chrono>
+#include <ctime>
+#include <fstream>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#include "src/util/utils.h"
+
+namespace shaka {
+namespace benchmark {
+
+namespace {
+
+/** The most iterations a benchmark will be run for. */
+constexpr const uint64_t kMaxIterations = 1000000000;
+
+struct Benchmark {
+  std::string name;
+  BenchmarkFunction function;
+};
+
+struct Result {
+  std::string name;
+  uint64_t iterations = 0;
+  double real_seconds = 0;
+  double cpu_seconds = 0;
+  uint64_t bytes_processed = 0;
+  uint64_t items_processed = 0;
+  std::string label;
+  std::string error_message;
+  std::map<std::string, double> counters;
+};
+
+std::vector<Benchmark>* GetBenchmarks() {
+  // Benchmarks are registered during static initialization, so this can't be
+  // a global.
+  static std::vector<Benchmark>* benchmarks = new std::vector<Benchmark>;
+  return benchmarks;
+}
+
+std::vector<std::function<void()>>* GetCleanups() {
+  static std::vector<std::function<void()>>* cleanups =
+      new std::vector<std::function<void()>>;
+  return cleanups;
+}
+
+double GetRealTime() {
+  return std::chrono::duration<double>(
+             std::chrono::steady_clock::now().time_since_epoch())
+      .count();
+}
+
+double GetCpuTime() {
+  return static_cast<double>(std::clock()) / CLOCKS_PER_SEC;
+}
+
+std::string JsonEscape(const std::string& value) {
+  std::string ret;
+  for (char c : value) {
+    if (c == '"' || c == '\\') {
+      ret.push_back('\\');
+      ret.push_back(c);
+    } else if (static_cast<unsigned char>(c) < 0x20) {
+      ret += util::StringPrintf("\\u%04x", c);
+    } else {
+      ret.push_back(c);
+    }
+  }
+  return ret;
+}
+
+Result RunBenchmark(const Benchmark& benchmark, double min_seconds) {
+  Result result;
+  result.name = benchmark.name;
+
+  // Like Google Benchmark, run with increasing iteration counts until the run
+  // takes long enough to be measured accurately.
+  uint64_t iterations = 1;
+  while (true) {
+    State state(iterations);
+    benchmark.function(&state);
+    if (state.error_occurred()) {
+      result.error_message = state.error_message();
+      return result;
+    }
+
+    const double seconds = state.real_seconds();
+    if (seconds >= min_seconds || iterations >= kMaxIterations) {
+      result.iterations = state.iterations();
+      result.real_seconds = state.real_seconds();
+      result.cpu_seconds = state.cpu_seconds();
+      result.bytes_processed = state.bytes_processed();
+      result.items_processed = state.items_processed();
+      result.label = state.label();
+      result.counters = state.counters;
+      return result;
+    }
+
+    // Predict how many iterations are needed, with some padding, but don't
+    // grow too fast in case the first iterations were unusually fast.
+    double multiplier = seconds <= 0 ? 10 : min_seconds * 1.4 / seconds;
+    multiplier = std::min(multiplier, 10.0);
+    const uint64_t next = static_cast<uint64_t>(iterations * multiplier);
+    iterations = std::min(std::max(next, iterations + 1), kMaxIterations);
+  }
+}
+
+void PrintResult(const Result& result) {
+  if (!result.error_message.empty()) {
+    printf("%-48s ERROR: %s\n", result.name.c_str(),
+           result.error_message.c_str());
+    return;
+  }
+
+  const double real_ns = result.real_seconds * 1e9 / result.iterations;
+  const double cpu_ns = result.cpu_seconds * 1e9 / result.iterations;
+  std::string extra;
+  if (result.bytes_processed) {
+    extra += util::StringPrintf(
+        " %10.2f MB/s",
+        result.bytes_processed / result.real_seconds / (1024 * 1024));
+  }
+  if (result.items_processed) {
+    extra += util::StringPrintf(" %12.2f items/s",
+                                result.items_processed / result.real_seconds);
+  }
+  for (auto& pair : result.counters)
+    extra += util::StringPrintf(" %s=%g", pair.first.c_str(), pair.second);
+  if (!result.label.empty())
+    extra += " " + result.label;
+  printf("%-48s %14.0f ns %14.0f ns %12" PRIu64 "%s\n", result.name.c_str(),
+         real_ns, cpu_ns, result.iterations, extra.c_str());
+}
+
+bool WriteJson(const std::string& path, const std::vector<Result>& results) {
+  char host_name[256] = {0};
+  gethostname(host_name, sizeof(host_name) - 1);
+  char date[64] = {0};
+  const std::time_t now = std::time(nullptr);
+  std::strftime(date, sizeof(date), "%Y-%m-%dT%H:%M:%S%z",
+                std::localtime(&now));
+
+  std::ofstream out(path);
+  out << "{\n";
+  out << "  \"context\": {\n";
+  out << "    \"date\": \"" << date << "\",\n";
+  out << "    \"host_name\": \"" << JsonEscape(host_name) << "\",\n";
+  out << "    \"num_cpus\": " << std::thread::hardware_concurrency() << ",\n";
+#ifdef NDEBUG
+  out << "    \"library_build_type\": \"release\"\n";
+#else
+  out << "    \"library_build_type\": \"debug\"\n";
+#endif
+  out << "  },\n";
+  out << "  \"benchmarks\": [";
+  for (size_t i = 0; i < results.size(); i++) {
+    const Result& result = results[i];
+    out << (i == 0 ? "\n" : ",\n");
+    out << "    {\n";
+    out << "      \"name\": \"" << JsonEscape(result.name) << "\",\n";
+    out << "      \"run_name\": \"" << JsonEscape(result.name) << "\",\n";
+    out << "      \"run_type\": \"iteration\",\n";
+    if (!result.error_message.empty()) {
+      out << "      \"error_occurred\": true,\n";
+      out << "      \"error_message\": \"" << JsonEscape(result.error_message)
+          << "\"\n";
+      out << "    }";
+      continue;
+    }
+
+    out << "      \"iterations\": " << result.iterations << ",\n";
+    out << "      \"real_time\": "
+        << util::StringPrintf("%.3f",
+                              result.real_seconds * 1e9 / result.iterations)
+        << ",\n";
+    out << "      \"cpu_time\": "
+        << util::StringPrintf("%.3f",
+                              result.cpu_seconds * 1e9 / result.iterations)
+        << ",\n";
+    out << "      \"time_unit\": \"ns\"";
+    if (result.bytes_processed) {
+      out << ",\n      \"bytes_per_second\": "
+          << util::StringPrintf("%.3f",
+                                result.bytes_processed / result.real_seconds);
+    }
+    if (result.items_processed) {
+      out << ",\n      \"items_per_second\": "
+          << util::StringPrintf("%.3f",
+                                result.items_processed / result.real_seconds);
+    }
+    for (auto& pair : result.counters) {
+      out << ",\n      \"" << JsonEscape(pair.first)
+          << "\": " << util::StringPrintf("%.6g", pair.second);
+    }
+    if (!result.label.empty())
+      out << ",\n      \"label\": \"" << JsonEscape(result.label) << "\"";
+    out << "\n    }";
+  }
+  out << "\n  ]\n";
+  out << "}\n";
+  return out.good();
+}
+
+}  // namespace
+
+State::State(uint64_t max_iterations)
+    : max_iterations_(max_iterations),
+      iterations_(0),
+      bytes_processed_(0),
+      items_processed_(0),
+      started_(false),
+      running_(false),
+      real_start_(0),
+      cpu_start_(0),
+      real_seconds_(0),
+      cpu_seconds_(0) {}
+
+State::~State() {}
+
+bool State::KeepRunning() {
+  if (!started_) {
+    started_ = true;
+    ResumeTiming();
+  }
+  if (iterations_ < max_iterations_ && !error_occurred()) {
+    iterations_++;
+    return true;
+  }
+
+  if (running_)
+    PauseTiming();
+  return false;
+}
+
+void State::PauseTiming() {
+  DCHECK(running_);
+  real_seconds_ += GetRealTime() - real_start_;
+  cpu_seconds_ += GetCpuTime() - cpu_start_;
+  running_ = false;
+}
+
+void State::ResumeTiming() {
+  DCHECK(!running_);
+  running_ = true;
+  real_start_ = GetRealTime();
+  cpu_start_ = GetCpuTime();
+}
+
+void State::SkipWithError(const std::string& message) {
+  error_message_ = message.empty() ? "Unknown error" : message;
+}
+
+void RegisterBenchmark(const std::string& name, BenchmarkFunction function) {
+  GetBenchmarks()->push_back({name, std::move(function)});
+}
+
+int RunBenchmarks(const std::string& filter, double min_seconds,
+                  const std::string& json_path) {
+  printf("%-48s %17s %17s %12s\n", "Benchmark", "Time", "CPU", "Iterations");
+  printf("%s\n", std::string(98, '-').c_str());
+
+  std::vector<Result> results;
+  for (const Benchmark& benchmark : *GetBenchmarks()) {
+    if (benchmark.name.find(filter) == std::string::npos)
+      continue;
+
+    results.emplace_back(RunBenchmark(benchmark, min_seconds));
+    PrintResult(results.back());
+    fflush(stdout);
+  }
+
+  for (auto& cleanup : *GetCleanups())
+    cleanup();
+  GetCleanups()->clear();
+
+  if (!json_path.empty() && !WriteJson(json_path, results)) {
+    LOG(ERROR) << "Error writing benchmark results to " << json_path;
+    return 1;
+  }
+  return 0;
+}
+
+void RegisterCleanup(std::function<void()> cleanup) {
+  GetCleanups()->emplace_back(std::move(cleanup));
+}
+
+void ListBenchmarks() {
+  for (const Benchmark& benchmark : *GetBenchmarks())
+    printf("%s\n", benchmark.name.c_str());
+}
+
+}  // namespace benchmark
+}  // namespace shaka
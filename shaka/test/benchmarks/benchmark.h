@@ -0,0 +1,194 @@
+// Copyright 2020 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     https://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef SHAKA_EMBEDDED_TEST_BENCHMARKS_BENCHMARK_H_
+#define SHAKA_EMBEDDED_TEST_BENCHMARKS_BENCHMARK_H_
+
+#include <stdint.h>
+
+#include <functional>
+#include <map>
+#include <string>
+
+#include "src/util/macros.h"
+
+namespace shaka {
+namespace benchmark {
+
+/**
+ * Holds the state of a single run of a benchmark.  A benchmark function does
+ * its setup, then loops while KeepRunning() returns true, doing one unit of
+ * work per iteration.  Only the time inside the loop is measured.  This
+ * follows the Google Benchmark API so the benchmarks read the same.
+ */
+class State final {
+ public:
+  explicit State(uint64_t max_iterations);
+  ~State();
+
+  SHAKA_NON_COPYABLE_OR_MOVABLE_TYPE(State);
+
+  /**
+   * Starts the timer on the first call.
+   * @return True if another iteration should be run; false once done, which
+   *   also stops the timer.
+   */
+  bool KeepRunning();
+
+  /** Stops the timer so setup work inside the loop isn't measured. */
+  void PauseTiming();
+
+  /** Starts the timer again after PauseTiming(). */
+  void ResumeTiming();
+
+  /** Sets the total number of bytes processed across all iterations. */
+  void SetBytesProcessed(uint64_t bytes) {
+    bytes_processed_ = bytes;
+  }
+
+  /** Sets the total number of items processed across all iterations. */
+  void SetItemsProcessed(uint64_t items) {
+    items_processed_ = items;
+  }
+
+  /** Sets extra info to report with the results. */
+  void SetLabel(const std::string& label) {
+    label_ = label;
+  }
+
+  /**
+   * Marks this benchmark as failed (e.g. when a feature isn't available).
+   * KeepRunning() returns false after this.
+   */
+  void SkipWithError(const std::string& message);
+
+  /** @return The number of iterations run so far. */
+  uint64_t iterations() const {
+    return iterations_;
+  }
+
+  uint64_t max_iterations() const {
+    return max_iterations_;
+  }
+  uint64_t bytes_processed() const {
+    return bytes_processed_;
+  }
+  uint64_t items_processed() const {
+    return items_processed_;
+  }
+  const std::string& label() const {
+    return label_;
+  }
+  bool error_occurred() const {
+    return !error_message_.empty();
+  }
+  const std::string& error_message() const {
+    return error_message_;
+  }
+  /** @return The measured wall-clock time, in seconds. */
+  double real_seconds() const {
+    return real_seconds_;
+  }
+  /** @return The measured CPU time of the process, in seconds. */
+  double cpu_seconds() const {
+    return cpu_seconds_;
+  }
+
+  /**
+   * Extra values to report with the results, such as the time to the first
+   * frame.  These are written as extra fields in the JSON output.
+   */
+  std::map<std::string, double> counters;
+
+ private:
+  const uint64_t max_iterations_;
+  uint64_t iterations_;
+  uint64_t bytes_processed_;
+  uint64_t items_processed_;
+  std::string label_;
+  std::string error_message_;
+
+  bool started_;
+  bool running_;
+  double real_start_;
+  double cpu_start_;
+  double real_seconds_;
+  double cpu_seconds_;
+};
+
+using BenchmarkFunction = std::function<void(State*)>;
+
+/**
+ * Registers a benchmark to run.  Names use "/" to separate the parameters
+ * (e.g. "Decode/h264/1080p").
+ */
+void RegisterBenchmark(const std::string& name, BenchmarkFunction function);
+
+/**
+ * Runs the registered benchmarks whose name contains |filter|.  This prints a
+ * table of the results and, if |json_path| isn't empty, writes the results to
+ * that file in the Google Benchmark JSON format so they can be compared by CI
+ * tools.
+ *
+ * @param filter A substring of the benchmarks to run, or empty to run all.
+ * @param min_seconds The minimum time to run each benchmark for.
+ * @param json_path The file to write the results to, or empty.
+ * @return The process exit code.  Benchmarks that were skipped with an error
+ *   are reported in the results but don't fail the run.
+ */
+int RunBenchmarks(const std::string& filter, double min_seconds,
+                  const std::string& json_path);
+
+/**
+ * Registers a function to call after all the benchmarks have run.  This can
+ * free state that is shared between runs of a benchmark.
+ */
+void RegisterCleanup(std::function<void()> cleanup);
+
+/** Calls the given function when constructed; used to register benchmarks. */
+struct Registrar final {
+  explicit Registrar(void (*register_function)()) {
+    register_function();
+  }
+};
+
+/** Prints the names of the registered benchmarks. */
+void ListBenchmarks();
+
+/**
+ * Prevents the compiler from optimizing away the computation of the given
+ * value.
+ */
+template <typename T>
+void DoNotOptimize(const T& value) {
+  asm volatile("" : : "r,m"(value) : "memory");
+}
+
+}  // namespace benchmark
+}  // namespace shaka
+
+/**
+ * Defines a function that registers benchmarks.  This runs when the program
+ * starts, so each benchmark file can register its own benchmarks, including
+ * ones that are parameterized by the test media.  The media files aren't
+ * available yet, so they should only be read when the benchmark runs.
+ */
+#define SHAKA_REGISTER_BENCHMARKS(name)                           \
+  void name();                                                    \
+  BEGIN_ALLOW_COMPLEX_STATICS                                     \
+  static ::shaka::benchmark::Registrar name##_registrar(&name);   \
+  END_ALLOW_COMPLEX_STATICS                                       \
+  void name()
+
+#endif  // SHAKA_EMBEDDED_TEST_BENCHMARKS_BENCHMARK_H_
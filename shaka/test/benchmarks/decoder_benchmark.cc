@@ -0,0 +1,89 @@
+// Copyright 2020 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     https://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "benchmarks/benchmark.h"
+#include "benchmarks/media_helpers.h"
+#include "shaka/media/decoder.h"
+#include "src/util/utils.h"
+
+namespace shaka {
+namespace benchmark {
+
+namespace {
+
+/**
+ * Measures decoding every frame in the given files.  Each iteration decodes
+ * the whole stream, so the items processed are the decoded frames per second.
+ */
+void BenchmarkDecode(const std::vector<std::string>& files, State* state) {
+  std::vector<std::shared_ptr<media::EncodedFrame>> frames;
+  if (!DemuxMediaFiles("video/mp4", files, &frames) || frames.empty()) {
+    state->SkipWithError("Error demuxing media");
+    return;
+  }
+  auto stream = frames[0]->stream_info;
+  state->SetLabel(util::StringPrintf("%s %ux%u", stream->codec.c_str(),
+                                     stream->width, stream->height));
+
+  auto decoder = media::Decoder::CreateDefaultDecoder();
+  if (!decoder) {
+    state->SkipWithError("No default decoder");
+    return;
+  }
+
+  uint64_t bytes = 0;
+  uint64_t frame_count = 0;
+  std::string error;
+  std::vector<std::shared_ptr<media::DecodedFrame>> decoded;
+  while (state->KeepRunning()) {
+    decoder->ResetDecoder();
+    // Run one extra time to pass nullptr to flush the last frames.
+    for (size_t i = 0; i <= frames.size(); i++) {
+      auto frame = i < frames.size() ? frames[i] : nullptr;
+      if (decoder->Decode(frame, nullptr, &decoded, &error) !=
+          media::MediaStatus::Success) {
+        state->SkipWithError("Error decoding: " + error);
+        return;
+      }
+      if (frame)
+        bytes += frame->data_size;
+      frame_count += decoded.size();
+      decoded.clear();
+    }
+  }
+  state->SetBytesProcessed(bytes);
+  state->SetItemsProcessed(frame_count);
+}
+
+}  // namespace
+
+SHAKA_REGISTER_BENCHMARKS(RegisterDecoderBenchmarks) {
+  RegisterBenchmark("Decode/h264/low", [](State* state) {
+    BenchmarkDecode({"clear_low_frag_init.mp4", "clear_low_frag_seg1.mp4"},
+                    state);
+  });
+  RegisterBenchmark("Decode/h264/high", [](State* state) {
+    BenchmarkDecode({"clear_high.mp4"}, state);
+  });
+  RegisterBenchmark("Decode/hevc/low", [](State* state) {
+    BenchmarkDecode({"clear_low_hevc.mp4"}, state);
+  });
+}
+
+}  // namespace benchmark
+}  // namespace shaka
@@ -0,0 +1,135 @@
+// Copyright 2020 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     https://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "benchmarks/benchmark.h"
+#include "shaka/eme/implementation_helper.h"
+#include "src/eme/clearkey_implementation.h"
+
+namespace shaka {
+namespace benchmark {
+
+namespace {
+
+/** The size of each frame to decrypt. */
+constexpr const size_t kFrameSize = 1024 * 1024;
+/** The number of subsamples per frame, each with a small clear header. */
+constexpr const size_t kSubsampleCount = 16;
+constexpr const uint32_t kClearBytes = 64;
+/** The number of frames to decrypt together in the batch benchmarks. */
+constexpr const size_t kBatchSize = 16;
+
+class NullImplementationHelper : public eme::ImplementationHelper {
+ public:
+  std::string DataPathPrefix() const override {
+    return "";
+  }
+  void OnMessage(const std::string& session_id,
+                 eme::MediaKeyMessageType message_type, const uint8_t* data,
+                 size_t data_size) const override {}
+  void OnKeyStatusChange(const std::string& session_id) const override {}
+};
+
+}  // namespace
+
+class DecryptBenchmark {
+ public:
+  /**
+   * Measures decrypting a frame with the given scheme with the ClearKey
+   * implementation.  The data isn't real encrypted data, but the cost of
+   * decrypting doesn't depend on the contents.
+   */
+  static void Run(eme::EncryptionScheme scheme, eme::EncryptionPattern pattern,
+                  size_t batch_size, State* state) {
+    const std::vector<uint8_t> key_id(16, 'k');
+    const std::vector<uint8_t> key(16, 'a');
+    const std::vector<uint8_t> iv(16, 'i');
+    const uint32_t subsample_size = kFrameSize / kSubsampleCount;
+    const std::vector<eme::SubsampleInfo> subsamples(
+        kSubsampleCount,
+        eme::SubsampleInfo(kClearBytes, subsample_size - kClearBytes));
+    eme::FrameEncryptionInfo info(scheme, pattern, key_id, iv, subsamples);
+
+    NullImplementationHelper helper;
+    eme::ClearKeyImplementation clear_key(&helper);
+    clear_key.LoadKeyForTesting(key_id, key);
+
+    std::vector<std::vector<uint8_t>> input(batch_size,
+                                            std::vector<uint8_t>(kFrameSize));
+    std::vector<std::vector<uint8_t>> output(batch_size,
+                                             std::vector<uint8_t>(kFrameSize));
+    std::vector<eme::DecryptSample> samples(batch_size);
+    for (size_t i = 0; i < batch_size; i++) {
+      samples[i].info = &info;
+      samples[i].data = input[i].data();
+      samples[i].data_size = kFrameSize;
+      samples[i].dest = output[i].data();
+    }
+
+    uint64_t bytes = 0;
+    while (state->KeepRunning()) {
+      if (batch_size == 1) {
+        if (clear_key.Decrypt(&info, input[0].data(), kFrameSize,
+                              output[0].data()) !=
+            eme::DecryptStatus::Success) {
+          state->SkipWithError("Error decrypting");
+          return;
+        }
+      } else {
+        clear_key.DecryptSamples(samples.data(), samples.size());
+        for (auto& sample : samples) {
+          if (sample.status != eme::DecryptStatus::Success) {
+            state->SkipWithError("Error decrypting");
+            return;
+          }
+        }
+      }
+      bytes += kFrameSize * batch_size;
+    }
+    state->SetBytesProcessed(bytes);
+    state->SetItemsProcessed(state->iterations() * batch_size);
+  }
+};
+
+SHAKA_REGISTER_BENCHMARKS(RegisterDecryptBenchmarks) {
+  struct Scheme {
+    const char* name;
+    eme::EncryptionScheme scheme;
+    eme::EncryptionPattern pattern;
+  };
+  const Scheme schemes[] = {
+      {"cenc", eme::EncryptionScheme::AesCtr, eme::EncryptionPattern()},
+      {"cens", eme::EncryptionScheme::AesCtr, eme::EncryptionPattern(1, 9)},
+      {"cbc1", eme::EncryptionScheme::AesCbc, eme::EncryptionPattern()},
+      {"cbcs", eme::EncryptionScheme::AesCbc, eme::EncryptionPattern(1, 9)},
+  };
+  for (const Scheme& scheme : schemes) {
+    RegisterBenchmark(std::string("Decrypt/") + scheme.name,
+                      [scheme](State* state) {
+                        DecryptBenchmark::Run(scheme.scheme, scheme.pattern, 1,
+                                              state);
+                      });
+    RegisterBenchmark(std::string("Decrypt/") + scheme.name + "/batch",
+                      [scheme](State* state) {
+                        DecryptBenchmark::Run(scheme.scheme, scheme.pattern,
+                                              kBatchSize, state);
+                      });
+  }
+}
+
+}  // namespace benchmark
+}  // namespace shaka
@@ -0,0 +1,82 @@
+// Copyright 2020 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     https://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "benchmarks/benchmark.h"
+#include "benchmarks/media_helpers.h"
+#include "shaka/media/demuxer.h"
+#include "src/test/media_files.h"
+
+namespace shaka {
+namespace benchmark {
+
+namespace {
+
+/**
+ * Measures demuxing the given files, in order, with a new demuxer each
+ * iteration.
+ */
+void BenchmarkDemux(const std::string& mime,
+                    const std::vector<std::string>& files, State* state) {
+  std::vector<std::vector<uint8_t>> data;
+  for (auto& file : files)
+    data.emplace_back(GetMediaFile(file));
+
+  auto* factory = media::DemuxerFactory::GetFactory();
+  if (!factory || !factory->IsTypeSupported(mime)) {
+    state->SkipWithError("Demuxer not supported: " + mime);
+    return;
+  }
+
+  NullDemuxerClient client;
+  uint64_t bytes = 0;
+  uint64_t frame_count = 0;
+  std::vector<std::shared_ptr<media::EncodedFrame>> frames;
+  while (state->KeepRunning()) {
+    auto demuxer = factory->Create(mime, &client);
+    for (auto& buffer : data) {
+      if (!demuxer->Demux(0, buffer.data(), buffer.size(), &frames)) {
+        state->SkipWithError("Error demuxing media");
+        return;
+      }
+      bytes += buffer.size();
+    }
+    frame_count += frames.size();
+    frames.clear();
+  }
+  state->SetBytesProcessed(bytes);
+  state->SetItemsProcessed(frame_count);
+}
+
+}  // namespace
+
+SHAKA_REGISTER_BENCHMARKS(RegisterDemuxerBenchmarks) {
+  RegisterBenchmark("Demux/mp4", [](State* state) {
+    BenchmarkDemux("video/mp4", {"clear_high.mp4"}, state);
+  });
+  RegisterBenchmark("Demux/fmp4", [](State* state) {
+    BenchmarkDemux("video/mp4",
+                   {"clear_low_frag_init.mp4", "clear_low_frag_seg1.mp4"},
+                   state);
+  });
+  RegisterBenchmark("Demux/webm", [](State* state) {
+    BenchmarkDemux("video/webm", {"clear_low.webm"}, state);
+  });
+}
+
+}  // namespace benchmark
+}  // namespace shaka
@@ -0,0 +1,65 @@
+// Copyright 2020 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     https://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <gflags/gflags.h>
+#include <glog/logging.h>
+
+#include <string>
+
+#include "benchmarks/benchmark.h"
+#include "benchmarks/media_helpers.h"
+#include "src/test/media_files.h"
+#include "src/util/file_system.h"
+
+namespace shaka {
+namespace benchmark {
+
+namespace {
+
+BEGIN_ALLOW_COMPLEX_STATICS
+DEFINE_string(benchmark_filter, "",
+              "Only run the benchmarks whose name contains this value.");
+DEFINE_string(benchmark_out, "",
+              "A file to write the results to, in the Google Benchmark JSON "
+              "format.");
+END_ALLOW_COMPLEX_STATICS
+DEFINE_double(benchmark_min_time, 0.5,
+              "The minimum number of seconds to run each benchmark for.");
+DEFINE_bool(benchmark_list_tests, false,
+            "Print the names of the benchmarks and exit.");
+
+int RunAll(int argc, char** argv) {
+  gflags::ParseCommandLineFlags(&argc, &argv, true);
+  FLAGS_alsologtostderr = true;
+  google::InitGoogleLogging(argv[0]);
+
+  if (FLAGS_benchmark_list_tests) {
+    ListBenchmarks();
+    return 0;
+  }
+
+  InitMediaFiles(argv[0]);
+  SetDataDirectory(util::FileSystem::DirName(argv[0]));
+  return RunBenchmarks(FLAGS_benchmark_filter, FLAGS_benchmark_min_time,
+                       FLAGS_benchmark_out);
+}
+
+}  // namespace
+
+}  // namespace benchmark
+}  // namespace shaka
+
+int main(int argc, char** argv) {
+  return shaka::benchmark::RunAll(argc, argv);
+}
@@ -0,0 +1,59 @@
+// Copyright 2020 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     https://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "benchmarks/media_helpers.h"
+
+#include "src/test/media_files.h"
+#include "src/util/macros.h"
+
+namespace shaka {
+namespace benchmark {
+
+namespace {
+
+BEGIN_ALLOW_COMPLEX_STATICS
+std::string g_data_directory;
+END_ALLOW_COMPLEX_STATICS
+
+}  // namespace
+
+void SetDataDirectory(const std::string& dir) {
+  g_data_directory = dir;
+}
+
+std::string GetDataDirectory() {
+  return g_data_directory;
+}
+
+bool DemuxMediaFiles(
+    const std::string& mime, const std::vector<std::string>& files,
+    std::vector<std::shared_ptr<media::EncodedFrame>>* frames) {
+  auto* factory = media::DemuxerFactory::GetFactory();
+  if (!factory || !factory->IsTypeSupported(mime))
+    return false;
+
+  NullDemuxerClient client;
+  auto demuxer = factory->Create(mime, &client);
+  if (!demuxer)
+    return false;
+  for (const std::string& file : files) {
+    const std::vector<uint8_t> data = GetMediaFile(file);
+    if (!demuxer->Demux(0, data.data(), data.size(), frames))
+      return false;
+  }
+  return true;
+}
+
+}  // namespace benchmark
+}  // namespace shaka
@@ -0,0 +1,56 @@
+// Copyright 2020 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     https://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef SHAKA_EMBEDDED_TEST_BENCHMARKS_MEDIA_HELPERS_H_
+#define SHAKA_EMBEDDED_TEST_BENCHMARKS_MEDIA_HELPERS_H_
+
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "shaka/media/demuxer.h"
+#include "shaka/media/frames.h"
+
+namespace shaka {
+namespace benchmark {
+
+/** A Demuxer client that ignores the events. */
+class NullDemuxerClient : public media::Demuxer::Client {
+ public:
+  void OnLoadedMetaData(double duration) override {}
+  void OnEncrypted(eme::MediaKeyInitDataType type, const uint8_t* data,
+                   size_t size) override {}
+};
+
+/**
+ * Sets the directory that holds the library's data files (e.g.
+ * shaka-player.compiled.js).  This is the directory of the executable.
+ */
+void SetDataDirectory(const std::string& dir);
+
+/** @return The directory that holds the library's data files. */
+std::string GetDataDirectory();
+
+/**
+ * Demuxes the given test media files, in order, using a single demuxer.
+ * @return True on success, false on error.
+ */
+bool DemuxMediaFiles(const std::string& mime,
+                     const std::vector<std::string>& files,
+                     std::vector<std::shared_ptr<media::EncodedFrame>>* frames);
+
+}  // namespace benchmark
+}  // namespace shaka
+
+#endif  // SHAKA_EMBEDDED_TEST_BENCHMARKS_MEDIA_HELPERS_H_
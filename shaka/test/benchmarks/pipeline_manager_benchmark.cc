@@ -0,0 +1,70 @@
+// Copyright 2020 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     https://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <atomic>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "benchmarks/benchmark.h"
+#include "src/media/pipeline_manager.h"
+#include "src/util/clock.h"
+
+namespace shaka {
+namespace benchmark {
+
+namespace {
+
+/**
+ * Measures reading the current time while the given number of other threads
+ * also read it, like the decoder threads, renderers, and JavaScript do during
+ * playback.
+ */
+void BenchmarkGetCurrentTime(size_t other_threads, State* state) {
+  media::PipelineManager manager([](media::VideoPlaybackState) {}, []() {},
+                                 &util::Clock::Instance);
+  manager.DoneInitializing();
+  manager.Play();
+  manager.CanPlay();
+
+  std::atomic<bool> done{false};
+  std::vector<std::thread> threads;
+  for (size_t i = 0; i < other_threads; i++) {
+    threads.emplace_back([&]() {
+      while (!done)
+        DoNotOptimize(manager.GetCurrentTime());
+    });
+  }
+
+  while (state->KeepRunning())
+    DoNotOptimize(manager.GetCurrentTime());
+  state->SetItemsProcessed(state->iterations());
+
+  done = true;
+  for (std::thread& thread : threads)
+    thread.join();
+}
+
+}  // namespace
+
+SHAKA_REGISTER_BENCHMARKS(RegisterPipelineManagerBenchmarks) {
+  for (size_t threads : {0, 1, 3}) {
+    RegisterBenchmark(
+        "PipelineManager/GetCurrentTime/" + std::to_string(threads + 1),
+        [threads](State* state) { BenchmarkGetCurrentTime(threads, state); });
+  }
+}
+
+}  // namespace benchmark
+}  // namespace shaka
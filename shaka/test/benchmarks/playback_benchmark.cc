@@ -0,0 +1,198 @@
+// Copyright 2020 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     https://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <gflags/gflags.h>
+#include <glog/logging.h>
+#include <sys/resource.h>
+
+#include <string>
+
+#include "benchmarks/benchmark.h"
+#include "benchmarks/media_helpers.h"
+#include "benchmarks/playback_helpers.h"
+#include "shaka/js_manager.h"
+#include "shaka/media/default_media_player.h"
+#include "shaka/player.h"
+#include "src/util/utils.h"
+
+namespace shaka {
+namespace benchmark {
+
+namespace {
+
+DEFINE_double(playback_rate, 4,
+              "The playback rate to use for the playback benchmarks.  The "
+              "headless display runs faster by the same amount, so the "
+              "frames shown per second of media are the same as at 1x.");
+
+/** The URI prefix of the local files; relative URIs are resolved to this. */
+constexpr const char* kBaseUri = "bench://media/";
+
+/** The extra time, in seconds, to wait for playback before giving up. */
+constexpr const double kTimeout = 30;
+
+/** @return The CPU time used by the whole process, in seconds. */
+double GetProcessCpuSeconds() {
+  rusage usage;
+  getrusage(RUSAGE_SELF, &usage);
+  return usage.ru_utime.tv_sec + usage.ru_utime.tv_usec / 1e6 +
+         usage.ru_stime.tv_sec + usage.ru_stime.tv_usec / 1e6;
+}
+
+/** @return The peak resident set size of the process, in MB. */
+double GetPeakRssMb() {
+  rusage usage;
+  getrusage(RUSAGE_SELF, &usage);
+#if defined(OS_MAC) || defined(OS_IOS)
+  return usage.ru_maxrss / (1024.0 * 1024);  // Bytes.
+#else
+  return usage.ru_maxrss / 1024.0;  // Kilobytes.
+#endif
+}
+
+/**
+ * @return The JavaScript engine used for the playback benchmarks.  There can
+ *   only be one per program, so it is created on first use and shared.
+ */
+JsManager* GetJsManager() {
+  static JsManager* engine = nullptr;
+  static LocalMediaScheme* scheme = nullptr;
+  if (!engine) {
+    JsManager::StartupOptions options;
+    options.dynamic_data_dir = GetDataDirectory();
+    options.static_data_dir = GetDataDirectory();
+    engine = new JsManager(options);
+    scheme = new LocalMediaScheme;
+    if (engine->RegisterNetworkScheme("bench", scheme).has_error())
+      LOG(FATAL) << "Unable to register the benchmark network scheme";
+
+    RegisterCleanup([]() {
+      delete engine;
+      delete scheme;
+      engine = nullptr;
+      scheme = nullptr;
+    });
+  }
+  return engine;
+}
+
+/**
+ * Measures playing the given manifest from start to end with headless
+ * renderers.  This reports the time to the first frame, the CPU used per
+ * second of media once playing, the peak memory usage, and the dropped frames.
+ */
+void BenchmarkPlayback(const std::string& manifest, State* state) {
+  JsManager* engine = GetJsManager();
+  HeadlessVideoRenderer video_renderer(FLAGS_playback_rate);
+  NullAudioRenderer audio_renderer;
+  media::DefaultMediaPlayer media_player(&video_renderer, &audio_renderer);
+  media::MediaPlayer::SetMediaPlayerForSupportChecks(&media_player);
+
+  double first_frame_ms = 0;
+  double cpu_seconds = 0;
+  double media_seconds = 0;
+  uint64_t dropped_frames = 0;
+  uint64_t total_frames = 0;
+  const std::string url = kBaseUri + manifest;
+  while (state->KeepRunning()) {
+    PlayerClient client;
+    Player player(engine);
+    if (player.Initialize(&client, &media_player).has_error()) {
+      state->SkipWithError("Error initializing Player");
+      break;
+    }
+
+    const media::VideoPlaybackQuality start_quality =
+        media_player.VideoPlaybackQuality();
+    video_renderer.ResetFirstFrame();
+    const double load_start = GetRealTime();
+    auto load = player.Load(url);
+    if (load.has_error()) {
+      state->SkipWithError("Error loading: " + load.error().message);
+      break;
+    }
+    media_player.SetPlaybackRate(FLAGS_playback_rate);
+
+    auto has_failed = [&]() {
+      return !client.error().empty() ||
+             media_player.PlaybackState() ==
+                 media::VideoPlaybackState::Errored;
+    };
+    if (!WaitFor(kTimeout, [&]() {
+          return video_renderer.first_frame_time() != 0 || has_failed();
+        }) ||
+        has_failed()) {
+      state->SkipWithError("Error waiting for the first frame: " +
+                           client.error());
+      break;
+    }
+    first_frame_ms += (video_renderer.first_frame_time() - load_start) * 1000;
+
+    // Only measure the CPU once playing, so the startup costs (e.g. parsing
+    // the manifest) are only included in the time to first frame.
+    const double cpu_start = GetProcessCpuSeconds();
+    const double media_start = media_player.CurrentTime();
+    const double timeout =
+        media_player.Duration() / FLAGS_playback_rate + kTimeout;
+    if (!WaitFor(timeout, [&]() {
+          return media_player.PlaybackState() ==
+                     media::VideoPlaybackState::Ended ||
+                 has_failed();
+        }) ||
+        has_failed()) {
+      state->SkipWithError("Error waiting for the end: " + client.error());
+      break;
+    }
+    cpu_seconds += GetProcessCpuSeconds() - cpu_start;
+    media_seconds += media_player.CurrentTime() - media_start;
+
+    const media::VideoPlaybackQuality quality =
+        media_player.VideoPlaybackQuality();
+    dropped_frames +=
+        quality.dropped_video_frames - start_quality.dropped_video_frames;
+    total_frames +=
+        quality.total_video_frames - start_quality.total_video_frames;
+
+    if (player.Unload().has_error() || player.Destroy().has_error()) {
+      state->SkipWithError("Error unloading Player");
+      break;
+    }
+  }
+  media::MediaPlayer::SetMediaPlayerForSupportChecks(nullptr);
+  if (state->error_occurred())
+    return;
+
+  const double iterations = static_cast<double>(state->iterations());
+  state->counters["time_to_first_frame_ms"] = first_frame_ms / iterations;
+  state->counters["cpu_seconds_per_media_second"] =
+      media_seconds > 0 ? cpu_seconds / media_seconds : 0;
+  state->counters["peak_rss_mb"] = GetPeakRssMb();
+  state->counters["dropped_frames"] = dropped_frames / iterations;
+  state->counters["total_frames"] = total_frames / iterations;
+  state->SetLabel(util::StringPrintf("%gx", FLAGS_playback_rate));
+}
+
+}  // namespace
+
+SHAKA_REGISTER_BENCHMARKS(RegisterPlaybackBenchmarks) {
+  RegisterBenchmark("Playback/dash", [](State* state) {
+    BenchmarkPlayback(kDashManifestName, state);
+  });
+  RegisterBenchmark("Playback/hls", [](State* state) {
+    BenchmarkPlayback(kHlsManifestName, state);
+  });
+}
+
+}  // namespace benchmark
+}  // namespace shaka
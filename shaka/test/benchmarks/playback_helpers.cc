@@ -0,0 +1,168 @@
+// Copyright 2020 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     https://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "benchmarks/playback_helpers.h"
+
+#include <chrono>
+#include <memory>
+#include <utility>
+#include <vector>
+
+#include "src/test/media_files.h"
+#include "src/util/clock.h"
+
+namespace shaka {
+namespace benchmark {
+
+namespace {
+
+/** The refresh interval of the simulated display, at a playback rate of 1. */
+constexpr const double kRefreshInterval = 1.0 / 60;
+
+/** How often to check the player state while waiting. */
+constexpr const double kPollInterval = 0.01;
+
+/** The media playlist that the HLS master playlist points to. */
+constexpr const char* kHlsMediaPlaylistName = "video.m3u8";
+
+constexpr const char* kDashManifest = R"(<?xml version="1.0" encoding="UTF-8"?>
+<MPD xmlns="urn:mpeg:dash:schema:mpd:2011" minBufferTime="PT2S"
+     profiles="urn:mpeg:dash:profile:isoff-live:2011" type="static"
+     mediaPresentationDuration="PT5S">
+  <Period id="0">
+    <AdaptationSet id="0" contentType="video" mimeType="video/mp4">
+      <Representation id="0" bandwidth="300000" codecs="avc1.42c01e"
+                      width="256" height="110">
+        <SegmentList timescale="1" duration="5">
+          <Initialization sourceURL="clear_low_frag_init.mp4"/>
+          <SegmentURL media="clear_low_frag_seg1.mp4"/>
+        </SegmentList>
+      </Representation>
+    </AdaptationSet>
+  </Period>
+</MPD>
+)";
+constexpr const char* kHlsMasterPlaylist = R"(#EXTM3U
+#EXT-X-STREAM-INF:BANDWIDTH=300000,CODECS="avc1.42c01e",RESOLUTION=256x110
+video.m3u8
+)";
+constexpr const char* kHlsMediaPlaylist = R"(#EXTM3U
+#EXT-X-VERSION:6
+#EXT-X-TARGETDURATION:5
+#EXT-X-PLAYLIST-TYPE:VOD
+#EXT-X-MAP:URI="clear_low_frag_init.mp4"
+#EXTINF:5.0,
+clear_low_frag_seg1.mp4
+#EXT-X-ENDLIST
+)";
+
+void SetData(const std::string& data, Response* response) {
+  response->SetDataCopy(reinterpret_cast<const uint8_t*>(data.data()),
+                        data.size());
+}
+
+}  // namespace
+
+double GetRealTime() {
+  return std::chrono::duration<double>(
+             std::chrono::steady_clock::now().time_since_epoch())
+      .count();
+}
+
+bool WaitFor(double timeout, std::function<bool()> done) {
+  const double end = GetRealTime() + timeout;
+  while (!done()) {
+    if (GetRealTime() > end)
+      return false;
+    util::Clock::Instance.SleepSeconds(kPollInterval);
+  }
+  return true;
+}
+
+
+LocalMediaScheme::LocalMediaScheme() {}
+
+LocalMediaScheme::LocalMediaScheme(Generator generator)
+    : generator_(std::move(generator)) {}
+
+LocalMediaScheme::~LocalMediaScheme() {}
+
+std::future<optional<Error>> LocalMediaScheme::OnNetworkRequest(
+    const std::string& uri, RequestType type, const Request& request,
+    Client* client, Response* response) {
+  std::string path = uri.substr(uri.rfind('/') + 1);
+  path = path.substr(0, path.find('?'));
+
+  std::string data;
+  std::string mime;
+  if (generator_ && generator_(path, &data, &mime)) {
+    SetData(data, response);
+    response->headers["content-type"] = mime;
+  } else if (path == kDashManifestName) {
+    SetData(kDashManifest, response);
+    response->headers["content-type"] = "application/dash+xml";
+  } else if (path == kHlsManifestName || path == kHlsMediaPlaylistName) {
+    SetData(path == kHlsMediaPlaylistName ? kHlsMediaPlaylist
+                                          : kHlsMasterPlaylist,
+            response);
+    response->headers["content-type"] = "application/x-mpegurl";
+  } else {
+    const std::vector<uint8_t> media = GetMediaFile(path);
+    response->SetDataCopy(media.data(), media.size());
+    response->headers["content-type"] = "video/mp4";
+  }
+  return {};
+}
+
+
+HeadlessVideoRenderer::HeadlessVideoRenderer(double playback_rate)
+    : refresh_interval_(kRefreshInterval / playback_rate),
+      first_frame_time_(0),
+      shutdown_(false),
+      thread_("HeadlessVsync",
+              std::bind(&HeadlessVideoRenderer::ThreadMain, this)) {}
+
+HeadlessVideoRenderer::~HeadlessVideoRenderer() {
+  shutdown_.store(true, std::memory_order_release);
+  thread_.join();
+}
+
+void HeadlessVideoRenderer::ThreadMain() {
+  while (!shutdown_.load(std::memory_order_acquire)) {
+    std::shared_ptr<media::DecodedFrame> frame;
+    GetFrameForVsync(0, refresh_interval_, &frame);
+    if (frame && first_frame_time() == 0)
+      first_frame_time_.store(GetRealTime(), std::memory_order_release);
+    util::Clock::Instance.SleepSeconds(refresh_interval_);
+  }
+}
+
+
+PlayerClient::PlayerClient() : mutex_("PlayerClient") {}
+
+PlayerClient::~PlayerClient() {}
+
+void PlayerClient::OnError(const Error& error) {
+  std::unique_lock<Mutex> lock(mutex_);
+  if (error_.empty())
+    error_ = error.message.empty() ? "Unknown player error" : error.message;
+}
+
+std::string PlayerClient::error() const {
+  std::unique_lock<Mutex> lock(mutex_);
+  return error_;
+}
+
+}  // namespace benchmark
+}  // namespace shaka
@@ -0,0 +1,143 @@
+// Copyright 2020 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     https://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef SHAKA_EMBEDDED_TEST_BENCHMARKS_PLAYBACK_HELPERS_H_
+#define SHAKA_EMBEDDED_TEST_BENCHMARKS_PLAYBACK_HELPERS_H_
+
+#include <atomic>
+#include <functional>
+#include <future>
+#include <string>
+
+#include "shaka/media/renderer.h"
+#include "shaka/net.h"
+#include "shaka/player.h"
+#include "src/debug/mutex.h"
+#include "src/debug/thread.h"
+#include "src/media/video_renderer_common.h"
+
+namespace shaka {
+namespace benchmark {
+
+/**
+ * The names of the manifests LocalMediaScheme serves.  The test media is a
+ * single 5 second, 256x110 H.264 segment.
+ */
+constexpr const char* kDashManifestName = "dash.mpd";
+constexpr const char* kHlsManifestName = "master.m3u8";
+
+/** @return The current real time, in seconds. */
+double GetRealTime();
+
+/**
+ * Waits until |done| returns true, or until |timeout| real seconds pass.  This
+ * polls using util::Clock::Instance, so this follows an overridden clock.
+ * @return True if |done| returned true, false on timeout.
+ */
+bool WaitFor(double timeout, std::function<bool()> done);
+
+/**
+ * Serves the manifests and the test media files without using the network.
+ * Any query string is ignored when finding the media files.
+ */
+class LocalMediaScheme : public SchemePlugin {
+ public:
+  /**
+   * Gets the contents of a generated file.
+   * @param path The file name, without the query string.
+   * @param data [OUT] Where to put the contents.
+   * @param mime [OUT] Where to put the MIME type.
+   * @return True if the path is a generated file, false to use the defaults.
+   */
+  using Generator = std::function<bool(const std::string& path,
+                                       std::string* data, std::string* mime)>;
+
+  LocalMediaScheme();
+  explicit LocalMediaScheme(Generator generator);
+  ~LocalMediaScheme() override;
+
+  std::future<optional<Error>> OnNetworkRequest(const std::string& uri,
+                                                RequestType type,
+                                                const Request& request,
+                                                Client* client,
+                                                Response* response) override;
+
+ private:
+  const Generator generator_;
+};
+
+/**
+ * A video renderer that picks frames for a simulated display but doesn't draw
+ * them.  The display runs faster by the playback rate so the frame statistics
+ * match playing at 1x.
+ */
+class HeadlessVideoRenderer : public media::VideoRendererCommon {
+ public:
+  explicit HeadlessVideoRenderer(double playback_rate);
+  ~HeadlessVideoRenderer() override;
+
+  /** @return The real time the first frame was shown, or 0 if not yet. */
+  double first_frame_time() const {
+    return first_frame_time_.load(std::memory_order_acquire);
+  }
+
+  void ResetFirstFrame() {
+    first_frame_time_.store(0, std::memory_order_release);
+  }
+
+ private:
+  void ThreadMain();
+
+  const double refresh_interval_;
+  std::atomic<double> first_frame_time_;
+  std::atomic<bool> shutdown_;
+  Thread thread_;
+};
+
+/** An audio renderer that ignores the audio; the test media is video-only. */
+class NullAudioRenderer : public media::AudioRenderer {
+ public:
+  void SetPlayer(const media::MediaPlayer* player) override {}
+  void Attach(const media::DecodedStream* stream) override {}
+  void Detach() override {}
+
+  double Volume() const override {
+    return 0;
+  }
+  void SetVolume(double volume) override {}
+  bool Muted() const override {
+    return true;
+  }
+  void SetMuted(bool muted) override {}
+};
+
+/** A Player client that keeps the first error. */
+class PlayerClient : public Player::Client {
+ public:
+  PlayerClient();
+  ~PlayerClient() override;
+
+  void OnError(const Error& error) override;
+
+  std::string error() const;
+
+ private:
+  mutable Mutex mutex_;
+  std::string error_;
+};
+
+}  // namespace benchmark
+}  // namespace shaka
+
+#endif  // SHAKA_EMBEDDED_TEST_BENCHMARKS_PLAYBACK_HELPERS_H_
@@ -0,0 +1,119 @@
+// Copyright 2020 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     https://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <SDL2/SDL.h>
+
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "benchmarks/benchmark.h"
+#include "benchmarks/media_helpers.h"
+#include "shaka/media/decoder.h"
+#include "shaka/sdl_frame_drawer.h"
+#include "src/util/utils.h"
+
+namespace shaka {
+namespace benchmark {
+
+namespace {
+
+/**
+ * The number of distinct frames to draw.  This is more than the number of
+ * textures SdlFrameDrawer keeps, so every Draw call uploads the frame.
+ */
+constexpr const size_t kFrameCount = 32;
+
+bool DecodeFrames(const std::vector<std::string>& files,
+                  std::vector<std::shared_ptr<media::DecodedFrame>>* frames) {
+  std::vector<std::shared_ptr<media::EncodedFrame>> encoded;
+  if (!DemuxMediaFiles("video/mp4", files, &encoded))
+    return false;
+  auto decoder = media::Decoder::CreateDefaultDecoder();
+  if (!decoder)
+    return false;
+
+  std::string error;
+  for (size_t i = 0; i <= encoded.size() && frames->size() < kFrameCount;
+       i++) {
+    auto frame = i < encoded.size() ? encoded[i] : nullptr;
+    if (decoder->Decode(frame, nullptr, frames, &error) !=
+        media::MediaStatus::Success) {
+      return false;
+    }
+  }
+  return !frames->empty();
+}
+
+/** Measures uploading decoded frames to SDL textures. */
+void BenchmarkUpload(const std::vector<std::string>& files, State* state) {
+  std::vector<std::shared_ptr<media::DecodedFrame>> frames;
+  if (!DecodeFrames(files, &frames)) {
+    state->SkipWithError("Error decoding media");
+    return;
+  }
+  state->SetLabel(util::StringPrintf("%ux%u", frames[0]->stream_info->width,
+                                     frames[0]->stream_info->height));
+
+  if (SDL_InitSubSystem(SDL_INIT_VIDEO) < 0) {
+    state->SkipWithError(std::string("Error initializing SDL: ") +
+                         SDL_GetError());
+    return;
+  }
+  SDL_Window* window = SDL_CreateWindow("", SDL_WINDOWPOS_UNDEFINED,
+                                        SDL_WINDOWPOS_UNDEFINED, 64, 64,
+                                        SDL_WINDOW_HIDDEN);
+  SDL_Renderer* renderer =
+      window ? SDL_CreateRenderer(window, -1, 0) : nullptr;
+  if (!renderer) {
+    state->SkipWithError(std::string("Error creating SDL renderer: ") +
+                         SDL_GetError());
+  } else {
+    SdlFrameDrawer drawer;
+    drawer.SetRenderer(renderer);
+    uint64_t bytes = 0;
+    size_t index = 0;
+    while (state->KeepRunning()) {
+      auto& frame = frames[index];
+      if (!drawer.Draw(frame)) {
+        state->SkipWithError("Error drawing frame");
+        break;
+      }
+      bytes += frame->EstimateSize();
+      index = (index + 1) % frames.size();
+    }
+    state->SetBytesProcessed(bytes);
+    state->SetItemsProcessed(state->iterations());
+    SDL_DestroyRenderer(renderer);
+  }
+
+  if (window)
+    SDL_DestroyWindow(window);
+  SDL_QuitSubSystem(SDL_INIT_VIDEO);
+}
+
+}  // namespace
+
+SHAKA_REGISTER_BENCHMARKS(RegisterSdlFrameDrawerBenchmarks) {
+  RegisterBenchmark("SdlFrameDrawer/Upload/low", [](State* state) {
+    BenchmarkUpload({"clear_low_frag_init.mp4", "clear_low_frag_seg1.mp4"},
+                    state);
+  });
+  RegisterBenchmark("SdlFrameDrawer/Upload/high", [](State* state) {
+    BenchmarkUpload({"clear_high.mp4"}, state);
+  });
+}
+
+}  // namespace benchmark
+}  // namespace shaka
@@ -0,0 +1,105 @@
+// Copyright 2020 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     https://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <memory>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "benchmarks/benchmark.h"
+#include "shaka/media/frames.h"
+#include "shaka/media/streams.h"
+
+namespace shaka {
+namespace benchmark {
+
+namespace {
+
+using StreamType = media::Stream<media::BaseFrame, true>;
+
+/** The duration of each frame, as in 30fps video. */
+constexpr const double kFrameDuration = 1.0 / 30;
+/** The number of frames between keyframes. */
+constexpr const size_t kKeyFrameInterval = 60;
+
+std::vector<std::shared_ptr<media::BaseFrame>> MakeFrames(size_t count) {
+  std::vector<std::shared_ptr<media::BaseFrame>> ret;
+  ret.reserve(count);
+  for (size_t i = 0; i < count; i++) {
+    ret.emplace_back(new media::BaseFrame(nullptr, i * kFrameDuration,
+                                          i * kFrameDuration, kFrameDuration,
+                                          i % kKeyFrameInterval == 0));
+  }
+  return ret;
+}
+
+/** Measures appending |count| frames to an empty stream. */
+void BenchmarkInsert(size_t count, State* state) {
+  const auto frames = MakeFrames(count);
+  while (state->KeepRunning()) {
+    state->PauseTiming();
+    {
+      StreamType stream;
+      state->ResumeTiming();
+      for (auto& frame : frames)
+        stream.AddFrame(frame);
+      state->PauseTiming();
+    }
+    state->ResumeTiming();
+  }
+  state->SetItemsProcessed(state->iterations() * count);
+}
+
+/** Measures finding frames at random times in a stream of |count| frames. */
+void BenchmarkLookup(size_t count, media::FrameLocation kind, State* state) {
+  StreamType stream;
+  for (auto& frame : MakeFrames(count))
+    stream.AddFrame(frame);
+
+  // Use a fixed seed so each run looks up the same times.
+  std::mt19937 random(0);
+  std::uniform_real_distribution<double> times(0, count * kFrameDuration);
+  std::vector<double> lookups(1024);
+  for (double& time : lookups)
+    time = times(random);
+
+  size_t index = 0;
+  while (state->KeepRunning()) {
+    DoNotOptimize(stream.GetFrame(lookups[index], kind));
+    index = (index + 1) % lookups.size();
+  }
+  state->SetItemsProcessed(state->iterations());
+}
+
+}  // namespace
+
+SHAKA_REGISTER_BENCHMARKS(RegisterStreamsBenchmarks) {
+  for (size_t count : {1000, 10000, 100000}) {
+    const std::string suffix = "/" + std::to_string(count);
+    RegisterBenchmark("StreamBase/Insert" + suffix, [count](State* state) {
+      BenchmarkInsert(count, state);
+    });
+    RegisterBenchmark("StreamBase/Lookup/Near" + suffix, [count](State* state) {
+      BenchmarkLookup(count, media::FrameLocation::Near, state);
+    });
+    RegisterBenchmark("StreamBase/Lookup/KeyFrameBefore" + suffix,
+                      [count](State* state) {
+                        BenchmarkLookup(
+                            count, media::FrameLocation::KeyFrameBefore, state);
+                      });
+  }
+}
+
+}  // namespace benchmark
+}  // namespace shaka
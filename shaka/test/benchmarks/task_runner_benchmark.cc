@@ -0,0 +1,63 @@
+// Copyright 2020 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     https://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "benchmarks/benchmark.h"
+#include "src/core/task_runner.h"
+#include "src/util/clock.h"
+
+namespace shaka {
+namespace benchmark {
+
+namespace {
+
+/** The number of tasks to schedule at once in the throughput benchmark. */
+constexpr const size_t kTaskCount = 1000;
+
+void RunLoop(TaskRunner::RunLoop loop) {
+  loop();
+}
+
+/**
+ * Measures the round-trip time of scheduling a task from another thread and
+ * waiting for it to complete.
+ */
+void BenchmarkDispatch(State* state) {
+  TaskRunner runner(&RunLoop, &util::Clock::Instance, /* is_worker= */ true);
+  while (state->KeepRunning()) {
+    runner.AddInternalTask(TaskPriority::Internal, "", []() {})->GetValue();
+  }
+  state->SetItemsProcessed(state->iterations());
+}
+
+/** Measures scheduling many tasks at once and waiting for them all to run. */
+void BenchmarkThroughput(State* state) {
+  TaskRunner runner(&RunLoop, &util::Clock::Instance, /* is_worker= */ true);
+  while (state->KeepRunning()) {
+    for (size_t i = 0; i < kTaskCount; i++)
+      runner.AddInternalTask(TaskPriority::Internal, "", []() {});
+    // Tasks of the same priority run in order, so wait for one more task.
+    runner.AddInternalTask(TaskPriority::Internal, "", []() {})->GetValue();
+  }
+  state->SetItemsProcessed(state->iterations() * (kTaskCount + 1));
+}
+
+}  // namespace
+
+SHAKA_REGISTER_BENCHMARKS(RegisterTaskRunnerBenchmarks) {
+  RegisterBenchmark("TaskRunner/Dispatch", &BenchmarkDispatch);
+  RegisterBenchmark("TaskRunner/Throughput", &BenchmarkThroughput);
+}
+
+}  // namespace benchmark
+}  // namespace shaka
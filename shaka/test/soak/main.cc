@@ -0,0 +1,393 @@
+// Copyright 2020 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     https://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+// A soak test that plays for many hours of simulated time to find memory that
+// grows slowly over a long session.  This alternates between a live stream and
+// seeking around a VOD stream, with a new Player each time, and samples the
+// memory used by each subsystem periodically.  This fails if any of them grow
+// faster than their limit.  The whole pipeline runs on a VirtualClock, so
+// 12 hours of playback takes minutes.
+
+#include <gflags/gflags.h>
+#include <glog/logging.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include <functional>
+#include <random>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "benchmarks/playback_helpers.h"
+#include "shaka/js_manager.h"
+#include "shaka/media/default_media_player.h"
+#include "shaka/player.h"
+#include "soak/memory_monitor.h"
+#include "src/test/media_files.h"
+#include "src/util/clock.h"
+#include "src/util/file_system.h"
+#include "src/util/utils.h"
+#include "src/util/virtual_clock.h"
+
+namespace shaka {
+namespace soak {
+
+namespace {
+
+DEFINE_double(hours, 12, "The simulated hours to play for.");
+DEFINE_double(live_minutes, 30,
+              "The simulated minutes to play the live stream for each time.");
+DEFINE_int32(seeks, 100, "The number of seeks in the VOD stream each time.");
+DEFINE_double(seconds_between_seeks, 3,
+              "The simulated seconds to play after each seek.");
+DEFINE_double(sample_seconds, 60,
+              "The simulated seconds between memory samples.");
+DEFINE_double(warmup_minutes, 60,
+              "The simulated minutes of samples to ignore at the start, while "
+              "the caches fill up.");
+DEFINE_double(max_growth_mb_per_hour, 1,
+              "The default growth limit, in MB per hour, for each subsystem's "
+              "memory.");
+DEFINE_double(max_object_growth_per_hour, 10,
+              "The default growth limit, in objects per hour, for each native "
+              "object type.");
+BEGIN_ALLOW_COMPLEX_STATICS
+DEFINE_string(growth_limits, "",
+              "Limits for specific subsystems, as comma-separated name=limit "
+              "pairs (e.g. 'rss=4,objects/SourceBuffer=0').  These are in the "
+              "same units as the default limits.");
+DEFINE_string(samples_out, "",
+              "A file to write the memory samples to, in CSV format.");
+END_ALLOW_COMPLEX_STATICS
+
+/** The URI prefix of the local files; relative URIs are resolved to this. */
+constexpr const char* kBaseUri = "soak://media/";
+
+/** The extra time, in (real) seconds, to wait for playback before giving up. */
+constexpr const double kTimeout = 30;
+
+/** The duration, in seconds, of the test media segment. */
+constexpr const int kSegmentDuration = 5;
+
+/** The number of segments in the live playlist. */
+constexpr const int kLiveWindowSegments = 6;
+
+/** The number of segments in the VOD playlist. */
+constexpr const int kVodSegments = 120;
+
+/** @return A master playlist with the given media playlist. */
+std::string MakeMasterPlaylist(const std::string& media_playlist) {
+  return "#EXTM3U\n"
+         "#EXT-X-STREAM-INF:BANDWIDTH=300000,CODECS=\"avc1.42c01e\","
+         "RESOLUTION=256x110\n" +
+         media_playlist + "\n";
+}
+
+/**
+ * @return A media playlist that repeats the test segment, starting at the
+ *   given media sequence number.  The segment always has the same timestamps,
+ *   so each one is its own discontinuity.
+ */
+std::string MakeMediaPlaylist(int first_segment, int count, bool is_live) {
+  std::string ret = util::StringPrintf(
+      "#EXTM3U\n"
+      "#EXT-X-VERSION:6\n"
+      "#EXT-X-TARGETDURATION:%d\n"
+      "#EXT-X-MEDIA-SEQUENCE:%d\n"
+      "#EXT-X-DISCONTINUITY-SEQUENCE:%d\n"
+      "#EXT-X-MAP:URI=\"clear_low_frag_init.mp4\"\n",
+      kSegmentDuration, first_segment, first_segment);
+  if (!is_live)
+    ret += "#EXT-X-PLAYLIST-TYPE:VOD\n";
+  for (int i = first_segment; i < first_segment + count; i++) {
+    if (i != first_segment)
+      ret += "#EXT-X-DISCONTINUITY\n";
+    // Use a different URI for each segment, like a real stream.
+    ret += util::StringPrintf("#EXTINF:%d.0,\nclear_low_frag_seg1.mp4?n=%d\n",
+                              kSegmentDuration, i);
+  }
+  if (!is_live)
+    ret += "#EXT-X-ENDLIST\n";
+  return ret;
+}
+
+/** Serves the live and VOD playlists. */
+bool GeneratePlaylist(const std::string& path, std::string* data,
+                      std::string* mime) {
+  *mime = "application/x-mpegurl";
+  if (path == "live.m3u8") {
+    *data = MakeMasterPlaylist("live_video.m3u8");
+  } else if (path == "live_video.m3u8") {
+    // The window slides with the (simulated) time.
+    const uint64_t now = util::Clock::Instance.GetEpochTime() / 1000;
+    const int last = static_cast<int>(now / kSegmentDuration);
+    *data = MakeMediaPlaylist(last - kLiveWindowSegments + 1,
+                              kLiveWindowSegments, /* is_live= */ true);
+  } else if (path == "vod.m3u8") {
+    *data = MakeMasterPlaylist("vod_video.m3u8");
+  } else if (path == "vod_video.m3u8") {
+    *data = MakeMediaPlaylist(0, kVodSegments, /* is_live= */ false);
+  } else {
+    return false;
+  }
+  return true;
+}
+
+bool ParseLimits(const std::string& str,
+                 std::unordered_map<std::string, double>* limits) {
+  if (str.empty())
+    return true;
+  for (const std::string& pair : util::StringSplit(str, ',')) {
+    const size_t equals = pair.find('=');
+    if (equals == std::string::npos)
+      return false;
+    char* end;
+    const double limit = strtod(pair.c_str() + equals + 1, &end);
+    if (equals + 1 == pair.size() || *end != '\0')
+      return false;
+    (*limits)[pair.substr(0, equals)] = limit;
+  }
+  return true;
+}
+
+class SoakTest {
+ public:
+  SoakTest(JsManager* engine, MemoryMonitor* monitor)
+      : engine_(engine),
+        monitor_(monitor),
+        video_renderer_(/* playback_rate= */ 1),
+        media_player_(&video_renderer_, &audio_renderer_),
+        random_(/* seed= */ 1234),
+        start_time_(Now()),
+        next_sample_(start_time_) {
+    media::MediaPlayer::SetMediaPlayerForSupportChecks(&media_player_);
+  }
+
+  ~SoakTest() {
+    media::MediaPlayer::SetMediaPlayerForSupportChecks(nullptr);
+  }
+
+  /** @return True on success, false if playback failed. */
+  bool Run() {
+    const double end = start_time_ + FLAGS_hours * 60 * 60;
+    for (int cycle = 1; Now() < end; cycle++) {
+      LOG(INFO) << "Cycle " << cycle << " at "
+                << (Now() - start_time_) / (60 * 60) << " hours";
+      if (!PlayLive() || !PlaySeeks())
+        return false;
+    }
+    Sample();
+    return true;
+  }
+
+ private:
+  /** @return The (simulated) time, in seconds. */
+  static double Now() {
+    return util::Clock::Instance.GetMonotonicTime() / 1000.0;
+  }
+
+  void Sample() {
+    monitor_->AddSample(Now() - start_time_, engine_->GetMemoryReport(),
+                        GetResidentBytes());
+    next_sample_ = Now() + FLAGS_sample_seconds;
+  }
+
+  bool HasFailed(const benchmark::PlayerClient& client) const {
+    return !client.error().empty() ||
+           media_player_.PlaybackState() == media::VideoPlaybackState::Errored;
+  }
+
+  /**
+   * Waits until |done| returns true, taking samples while waiting.
+   * @return True if |done| returned true, false on error or timeout.
+   */
+  bool WaitAndSample(const benchmark::PlayerClient& client, double timeout,
+                     std::function<bool()> done) {
+    bool failed = false;
+    const bool finished = benchmark::WaitFor(timeout, [&]() {
+      if (Now() >= next_sample_)
+        Sample();
+      failed = HasFailed(client);
+      return failed || done();
+    });
+    if (!finished || failed) {
+      LOG(ERROR) << "Playback failed at "
+                 << (Now() - start_time_) / (60 * 60)
+                 << " hours: " << (failed ? client.error() : "timeout");
+      return false;
+    }
+    return true;
+  }
+
+  /** Plays for the given (simulated) seconds. */
+  bool PlayFor(const benchmark::PlayerClient& client, double seconds) {
+    const double end = Now() + seconds;
+    return WaitAndSample(client, seconds + kTimeout,
+                         [&]() { return Now() >= end; });
+  }
+
+  /** Calls |play| with a new Player that has loaded the given manifest. */
+  bool WithPlayer(const std::string& manifest,
+                  std::function<bool(const benchmark::PlayerClient&)> play) {
+    benchmark::PlayerClient client;
+    Player player(engine_);
+    if (player.Initialize(&client, &media_player_).has_error()) {
+      LOG(ERROR) << "Error initializing Player";
+      return false;
+    }
+    video_renderer_.ResetFirstFrame();
+    auto load = player.Load(kBaseUri + manifest);
+    if (load.has_error()) {
+      LOG(ERROR) << "Error loading " << manifest << ": "
+                 << load.error().message;
+      return false;
+    }
+    if (!WaitAndSample(client, kTimeout, [&]() {
+          return video_renderer_.first_frame_time() != 0;
+        }) ||
+        !play(client)) {
+      return false;
+    }
+    if (player.Unload().has_error() || player.Destroy().has_error()) {
+      LOG(ERROR) << "Error unloading Player";
+      return false;
+    }
+    return true;
+  }
+
+  bool PlayLive() {
+    return WithPlayer("live.m3u8", [this](const benchmark::PlayerClient& c) {
+      return PlayFor(c, FLAGS_live_minutes * 60);
+    });
+  }
+
+  bool PlaySeeks() {
+    return WithPlayer("vod.m3u8", [this](const benchmark::PlayerClient& c) {
+      // Don't seek too close to the end, so playback doesn't end.
+      std::uniform_real_distribution<double> distribution(
+          0, kVodSegments * kSegmentDuration - FLAGS_seconds_between_seeks -
+                 kSegmentDuration);
+      for (int i = 0; i < FLAGS_seeks; i++) {
+        const double target = distribution(random_);
+        media_player_.SetCurrentTime(target);
+        if (!WaitAndSample(c, kTimeout,
+                           [&]() {
+                             return media_player_.PlaybackState() ==
+                                        media::VideoPlaybackState::Playing &&
+                                    media_player_.CurrentTime() > target;
+                           }) ||
+            !PlayFor(c, FLAGS_seconds_between_seeks)) {
+          return false;
+        }
+      }
+      return true;
+    });
+  }
+
+  JsManager* const engine_;
+  MemoryMonitor* const monitor_;
+  benchmark::HeadlessVideoRenderer video_renderer_;
+  benchmark::NullAudioRenderer audio_renderer_;
+  media::DefaultMediaPlayer media_player_;
+  std::mt19937 random_;
+  const double start_time_;
+  double next_sample_;
+};
+
+/** Prints the growth of each subsystem. @return Whether all are in limits. */
+bool PrintResults(const std::vector<GrowthResult>& results) {
+  auto format = [](double value, bool is_count) {
+    return is_count ? util::StringPrintf("%.1f", value)
+                    : util::StringPrintf("%.2f MB", value / (1024 * 1024));
+  };
+  bool passed = true;
+  printf("%-40s %12s %12s %14s %14s\n", "Subsystem", "First", "Last",
+         "Growth/hour", "Limit/hour");
+  for (auto& result : results) {
+    printf("%-40s %12s %12s %14s %14s%s\n", result.name.c_str(),
+           format(result.first, result.is_count).c_str(),
+           format(result.last, result.is_count).c_str(),
+           format(result.growth_per_hour, result.is_count).c_str(),
+           format(result.limit_per_hour, result.is_count).c_str(),
+           result.failed() ? "  FAILED" : "");
+    passed &= !result.failed();
+  }
+  return passed;
+}
+
+int RunSoak(int argc, char** argv) {
+  gflags::ParseCommandLineFlags(&argc, &argv, true);
+  FLAGS_alsologtostderr = true;
+  google::InitGoogleLogging(argv[0]);
+
+  std::unordered_map<std::string, double> limits;
+  if (!ParseLimits(FLAGS_growth_limits, &limits)) {
+    LOG(ERROR) << "Invalid --growth_limits: " << FLAGS_growth_limits;
+    return 1;
+  }
+  InitMediaFiles(argv[0]);
+
+  // Start the clock at the real time so the JavaScript Date is reasonable.
+  util::VirtualClock clock(util::Clock::Instance.GetEpochTime());
+  util::Clock::SetInstanceOverride(&clock);
+  clock.StartAutoAdvance();
+
+  MemoryMonitor monitor(FLAGS_max_growth_mb_per_hour,
+                        FLAGS_max_object_growth_per_hour, limits);
+  bool played;
+  {
+    // The scheme must outlive the engine.
+    benchmark::LocalMediaScheme scheme(&GeneratePlaylist);
+    JsManager::StartupOptions options;
+    options.dynamic_data_dir = util::FileSystem::DirName(argv[0]);
+    options.static_data_dir = options.dynamic_data_dir;
+    JsManager engine(options);
+    if (engine.RegisterNetworkScheme("soak", &scheme).has_error()) {
+      LOG(ERROR) << "Unable to register the soak network scheme";
+      played = false;
+    } else {
+      SoakTest test(&engine, &monitor);
+      played = test.Run();
+    }
+  }
+  clock.StopAutoAdvance();
+  util::Clock::SetInstanceOverride(nullptr);
+
+  if (!FLAGS_samples_out.empty()) {
+    const std::string csv = monitor.ToCsv();
+    util::FileSystem fs;
+    if (!fs.WriteFile(FLAGS_samples_out,
+                      std::vector<uint8_t>(csv.begin(), csv.end()))) {
+      LOG(ERROR) << "Unable to write " << FLAGS_samples_out;
+    }
+  }
+
+  const std::vector<GrowthResult> results =
+      monitor.Analyze(FLAGS_warmup_minutes * 60);
+  if (results.empty())
+    LOG(ERROR) << "Not enough samples after the warmup to measure growth";
+  const bool passed = PrintResults(results) && played && !results.empty();
+  fprintf(stderr, "SOAK RESULTS: %s\n", passed ? "PASS" : "FAIL");
+  return passed ? 0 : 1;
+}
+
+}  // namespace
+
+}  // namespace soak
+}  // namespace shaka
+
+int main(int argc, char** argv) {
+  return shaka::soak::RunSoak(argc, argv);
+}
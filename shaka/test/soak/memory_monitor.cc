@@ -0,0 +1,172 @@
+// Copyright 2020 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     https://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "soak/memory_monitor.h"
+
+#if defined(OS_MAC) || defined(OS_IOS)
+#  include <mach/mach.h>
+#else
+#  include <unistd.h>
+
+#  include <fstream>
+#endif
+
+#include "src/util/utils.h"
+
+namespace shaka {
+namespace soak {
+
+namespace {
+
+/** The fewest samples that a line is fitted to. */
+constexpr const size_t kMinSamples = 3;
+
+constexpr const double kSecondsPerHour = 60 * 60;
+
+constexpr const double kBytesPerMb = 1024 * 1024;
+
+}  // namespace
+
+uint64_t GetResidentBytes() {
+#if defined(OS_MAC) || defined(OS_IOS)
+  mach_task_basic_info info;
+  mach_msg_type_number_t count = MACH_TASK_BASIC_INFO_COUNT;
+  if (task_info(mach_task_self(), MACH_TASK_BASIC_INFO,
+                reinterpret_cast<task_info_t>(&info), &count) != KERN_SUCCESS) {
+    return 0;
+  }
+  return info.resident_size;
+#else
+  // The second field is the resident pages.
+  std::ifstream statm("/proc/self/statm");
+  uint64_t size;
+  uint64_t resident;
+  if (!(statm >> size >> resident))
+    return 0;
+  return resident * static_cast<uint64_t>(sysconf(_SC_PAGESIZE));
+#endif
+}
+
+
+MemoryMonitor::MemoryMonitor(
+    double mb_limit, double count_limit,
+    const std::unordered_map<std::string, double>& limits)
+    : mb_limit_(mb_limit), count_limit_(count_limit), limits_(limits) {}
+
+MemoryMonitor::~MemoryMonitor() {}
+
+void MemoryMonitor::AddSample(double time,
+                              const JsManager::MemoryReport& report,
+                              uint64_t resident_bytes) {
+  times_.emplace_back(time);
+  if (resident_bytes > 0)
+    Add("rss", false, resident_bytes);
+
+  Add("js_heap", false, report.js_heap.used_heap_size);
+  Add("js_external", false, report.js_heap.external_memory);
+  Add("native_objects", true, report.js_heap.native_object_count);
+
+  Add("segment_cache", false, report.media.segment_cache_bytes);
+  Add("frame_pool", false, report.media.frame_pool_bytes);
+  Add("decoded_frames", false, report.media.decoded_frame_bytes);
+  Add("encoded_frames", false, report.media.encoded_frame_bytes);
+  Add("network", false, report.media.network_bytes);
+
+  for (auto& type : report.native_types)
+    Add("objects/" + type.type_name, true, type.count);
+
+  // Types that weren't in this report have no objects.
+  for (auto& pair : series_) {
+    if (pair.second.values.size() < times_.size())
+      pair.second.values.emplace_back(0);
+  }
+}
+
+std::vector<GrowthResult> MemoryMonitor::Analyze(double warmup) const {
+  size_t start = 0;
+  while (start < times_.size() && times_[start] < warmup)
+    start++;
+  const size_t count = times_.size() - start;
+  if (count < kMinSamples)
+    return {};
+
+  double mean_time = 0;
+  for (size_t i = start; i < times_.size(); i++)
+    mean_time += times_[i];
+  mean_time /= count;
+  double time_variance = 0;
+  for (size_t i = start; i < times_.size(); i++)
+    time_variance += (times_[i] - mean_time) * (times_[i] - mean_time);
+  if (time_variance == 0)
+    return {};
+
+  std::vector<GrowthResult> ret;
+  for (auto& pair : series_) {
+    const std::vector<double>& values = pair.second.values;
+    double mean_value = 0;
+    for (size_t i = start; i < values.size(); i++)
+      mean_value += values[i];
+    mean_value /= count;
+    double covariance = 0;
+    for (size_t i = start; i < values.size(); i++)
+      covariance += (times_[i] - mean_time) * (values[i] - mean_value);
+
+    GrowthResult result;
+    result.name = pair.first;
+    result.is_count = pair.second.is_count;
+    result.first = values[start];
+    result.last = values.back();
+    result.growth_per_hour = covariance / time_variance * kSecondsPerHour;
+    auto it = limits_.find(pair.first);
+    if (it != limits_.end())
+      result.limit_per_hour = it->second;
+    else
+      result.limit_per_hour = result.is_count ? count_limit_ : mb_limit_;
+    if (!result.is_count)
+      result.limit_per_hour *= kBytesPerMb;
+    ret.emplace_back(result);
+  }
+  return ret;
+}
+
+std::string MemoryMonitor::ToCsv() const {
+  std::string ret = "time";
+  for (auto& pair : series_)
+    ret += "," + pair.first;
+  ret += "\n";
+  for (size_t i = 0; i < times_.size(); i++) {
+    ret += util::StringPrintf("%.3f", times_[i]);
+    for (auto& pair : series_)
+      ret += util::StringPrintf(",%.0f", pair.second.values[i]);
+    ret += "\n";
+  }
+  return ret;
+}
+
+void MemoryMonitor::Add(const std::string& name, bool is_count,
+                        double value) {
+  auto it = series_.find(name);
+  if (it == series_.end()) {
+    // This is new, so it was 0 in the earlier samples.
+    it = series_.emplace(name, Series{is_count, {}}).first;
+    it->second.values.resize(times_.size() - 1, 0);
+  }
+  if (it->second.values.size() < times_.size())
+    it->second.values.emplace_back(value);
+  else
+    it->second.values.back() += value;  // Types with the same name.
+}
+
+}  // namespace soak
+}  // namespace shaka
@@ -0,0 +1,112 @@
+// Copyright 2020 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     https://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef SHAKA_EMBEDDED_TEST_SOAK_MEMORY_MONITOR_H_
+#define SHAKA_EMBEDDED_TEST_SOAK_MEMORY_MONITOR_H_
+
+#include <stdint.h>
+
+#include <map>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "shaka/js_manager.h"
+
+namespace shaka {
+namespace soak {
+
+/** @return The resident set size of the process, in bytes, or 0 if unknown. */
+uint64_t GetResidentBytes();
+
+/** The growth of one subsystem over the soak run. */
+struct GrowthResult {
+  /** The name of the subsystem, e.g. "js_heap" or "objects/SourceBuffer". */
+  std::string name;
+  /** Whether the values are object counts; otherwise they are bytes. */
+  bool is_count;
+  /** The value of the first and last samples that were fitted. */
+  double first;
+  double last;
+  /** The slope of the fitted line, in bytes or objects per hour. */
+  double growth_per_hour;
+  /** The largest allowed growth, in bytes or objects per hour. */
+  double limit_per_hour;
+
+  bool failed() const {
+    return growth_per_hour > limit_per_hour;
+  }
+};
+
+/**
+ * Collects periodic samples of the memory used by each subsystem and checks
+ * whether any of them grow steadily.  The growth is the slope of a
+ * least-squares line through the samples, so the normal rise and fall while
+ * playing (e.g. buffering, GC) averages out over a long run and only steady
+ * growth (i.e. a leak) remains.
+ */
+class MemoryMonitor {
+ public:
+  /**
+   * @param mb_limit The default allowed growth for byte values, in MB per
+   *   hour.
+   * @param count_limit The default allowed growth for object counts, in
+   *   objects per hour.
+   * @param limits The allowed growth of specific subsystems, by name; these
+   *   are in MB or objects per hour too.
+   */
+  MemoryMonitor(double mb_limit, double count_limit,
+                const std::unordered_map<std::string, double>& limits);
+  ~MemoryMonitor();
+
+  /**
+   * Adds a sample.
+   * @param time The time of the sample, in seconds.
+   * @param report The memory report from the JsManager.
+   * @param resident_bytes The resident set size of the process.
+   */
+  void AddSample(double time, const JsManager::MemoryReport& report,
+                 uint64_t resident_bytes);
+
+  /**
+   * Fits a line to each subsystem's samples.
+   * @param warmup Samples before this time, in seconds, are ignored so the
+   *   caches filling up at the start isn't counted as growth.
+   * @return The growth of each subsystem with at least 3 samples to fit.
+   */
+  std::vector<GrowthResult> Analyze(double warmup) const;
+
+  /** @return The samples as CSV, one row per sample. */
+  std::string ToCsv() const;
+
+ private:
+  struct Series {
+    bool is_count;
+    std::vector<double> values;
+  };
+
+  void Add(const std::string& name, bool is_count, double value);
+
+  const double mb_limit_;
+  const double count_limit_;
+  const std::unordered_map<std::string, double> limits_;
+  std::vector<double> times_;
+  // Sorted by name, so the results are printed in a stable order.
+  std::map<std::string, Series> series_;
+};
+
+}  // namespace soak
+}  // namespace shaka
+
+#endif  // SHAKA_EMBEDDED_TEST_SOAK_MEMORY_MONITOR_H_
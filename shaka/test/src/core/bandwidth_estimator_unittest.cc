@@ -0,0 +1,117 @@
+// Copyright 2020 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     https://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "src/core/bandwidth_estimator.h"
+
+#include <gtest/gtest.h>
+
+#include <string>
+
+namespace shaka {
+
+namespace {
+
+BandwidthEstimator::Transfer MakeTransfer(uint64_t bytes, double ttfb_ms,
+                                          double total_ms) {
+  BandwidthEstimator::Transfer ret;
+  ret.bytes = bytes;
+  ret.ttfb_ms = ttfb_ms;
+  ret.total_ms = total_ms;
+  return ret;
+}
+
+}  // namespace
+
+TEST(BandwidthEstimatorTest, NoEstimateWithoutRequests) {
+  BandwidthEstimator estimator;
+  BandwidthEstimator::Estimate estimate;
+  EXPECT_FALSE(estimator.GetEstimate("", &estimate));
+  EXPECT_FALSE(estimator.GetEstimate("example.com", &estimate));
+}
+
+TEST(BandwidthEstimatorTest, ExcludesTimeToFirstByte) {
+  BandwidthEstimator estimator;
+  // 1 MB in 1 second after a 500ms wait is 8 Mbps.
+  estimator.AddTransfer("example.com", MakeTransfer(1000000, 500, 1500));
+
+  BandwidthEstimator::Estimate estimate;
+  ASSERT_TRUE(estimator.GetEstimate("example.com", &estimate));
+  EXPECT_DOUBLE_EQ(8e6, estimate.throughput_bps);
+  EXPECT_DOUBLE_EQ(8e6, estimate.throughput_p50_bps);
+  EXPECT_DOUBLE_EQ(8e6, estimate.throughput_p10_bps);
+  EXPECT_DOUBLE_EQ(500, estimate.ttfb_ms);
+  EXPECT_EQ(1u, estimate.throughput_samples);
+  EXPECT_EQ(1u, estimate.request_count);
+}
+
+TEST(BandwidthEstimatorTest, SmallRequestsOnlyAffectLatency) {
+  BandwidthEstimator estimator;
+  estimator.AddTransfer("example.com", MakeTransfer(1000000, 100, 1100));
+  estimator.AddTransfer("example.com", MakeTransfer(100, 100, 101));
+
+  BandwidthEstimator::Estimate estimate;
+  ASSERT_TRUE(estimator.GetEstimate("example.com", &estimate));
+  EXPECT_DOUBLE_EQ(8e6, estimate.throughput_bps);
+  EXPECT_EQ(1u, estimate.throughput_samples);
+  EXPECT_EQ(2u, estimate.request_count);
+}
+
+TEST(BandwidthEstimatorTest, TracksHostsSeparately) {
+  BandwidthEstimator estimator;
+  estimator.AddTransfer("fast", MakeTransfer(1000000, 0, 100));
+  estimator.AddTransfer("slow", MakeTransfer(1000000, 0, 10000));
+
+  BandwidthEstimator::Estimate fast;
+  BandwidthEstimator::Estimate slow;
+  BandwidthEstimator::Estimate all;
+  ASSERT_TRUE(estimator.GetEstimate("fast", &fast));
+  ASSERT_TRUE(estimator.GetEstimate("slow", &slow));
+  ASSERT_TRUE(estimator.GetEstimate("", &all));
+  EXPECT_DOUBLE_EQ(80e6, fast.throughput_bps);
+  EXPECT_DOUBLE_EQ(0.8e6, slow.throughput_bps);
+  EXPECT_LT(slow.throughput_bps, all.throughput_bps);
+  EXPECT_LT(all.throughput_bps, fast.throughput_bps);
+  EXPECT_EQ(2u, all.request_count);
+}
+
+TEST(BandwidthEstimatorTest, FollowsChangingThroughput) {
+  BandwidthEstimator estimator;
+  for (int i = 0; i < 10; i++)
+    estimator.AddTransfer("", MakeTransfer(1000000, 0, 1000));
+  for (int i = 0; i < 10; i++)
+    estimator.AddTransfer("", MakeTransfer(1000000, 0, 4000));
+
+  // After 40 seconds at 2 Mbps, the average is close to the new value.
+  BandwidthEstimator::Estimate estimate;
+  ASSERT_TRUE(estimator.GetEstimate("", &estimate));
+  EXPECT_NEAR(2e6, estimate.throughput_bps, 0.01e6);
+  EXPECT_DOUBLE_EQ(2e6, estimate.throughput_p10_bps);
+  EXPECT_EQ(20u, estimate.throughput_samples);
+}
+
+TEST(BandwidthEstimatorTest, EvictsOldHosts) {
+  BandwidthEstimator estimator;
+  for (size_t i = 0; i <= BandwidthEstimator::kMaxHosts; i++) {
+    estimator.AddTransfer("host" + std::to_string(i),
+                          MakeTransfer(100, 10, 10));
+  }
+
+  BandwidthEstimator::Estimate estimate;
+  EXPECT_FALSE(estimator.GetEstimate("host0", &estimate));
+  EXPECT_TRUE(estimator.GetEstimate("host1", &estimate));
+  EXPECT_TRUE(estimator.GetEstimate(
+      "host" + std::to_string(BandwidthEstimator::kMaxHosts), &estimate));
+}
+
+}  // namespace shaka
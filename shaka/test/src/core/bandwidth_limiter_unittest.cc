@@ -0,0 +1,95 @@
+// Copyright 2018 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     https://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "src/core/bandwidth_limiter.h"
+
+#include <gmock/gmock.h>
+#include <gtest/gtest.h>
+
+namespace shaka {
+
+namespace {
+
+using testing::Return;
+
+class MockClock : public util::Clock {
+ public:
+  MOCK_CONST_METHOD0(GetMonotonicTime, uint64_t());
+};
+
+}  // namespace
+
+TEST(BandwidthLimiterTest, AllowsEverythingWithoutLimit) {
+  MockClock clock;
+  EXPECT_CALL(clock, GetMonotonicTime()).Times(0);
+
+  BandwidthLimiter limiter(&clock);
+  limiter.OnReceived(1000000);
+  EXPECT_TRUE(limiter.CanReceive());
+  EXPECT_EQ(0u, limiter.GetDelayMs());
+}
+
+TEST(BandwidthLimiterTest, WaitsForBytesToBeAvailable) {
+  MockClock clock;
+  BandwidthLimiter limiter(&clock);
+
+  EXPECT_CALL(clock, GetMonotonicTime()).WillRepeatedly(Return(1000));
+  limiter.SetLimit(1000);
+  EXPECT_TRUE(limiter.CanReceive());
+  limiter.OnReceived(1500);
+  EXPECT_FALSE(limiter.CanReceive());
+  // The 500 bytes over the limit plus one more need to be available.
+  EXPECT_EQ(501u, limiter.GetDelayMs());
+
+  EXPECT_CALL(clock, GetMonotonicTime()).WillRepeatedly(Return(1250));
+  EXPECT_FALSE(limiter.CanReceive());
+  EXPECT_EQ(251u, limiter.GetDelayMs());
+
+  EXPECT_CALL(clock, GetMonotonicTime()).WillRepeatedly(Return(1501));
+  EXPECT_TRUE(limiter.CanReceive());
+}
+
+TEST(BandwidthLimiterTest, OnlyAllowsOneSecondBurst) {
+  MockClock clock;
+  BandwidthLimiter limiter(&clock);
+
+  EXPECT_CALL(clock, GetMonotonicTime()).WillRepeatedly(Return(0));
+  limiter.SetLimit(1000);
+
+  EXPECT_CALL(clock, GetMonotonicTime()).WillRepeatedly(Return(10000));
+  EXPECT_TRUE(limiter.CanReceive());
+  limiter.OnReceived(2000);
+  EXPECT_EQ(1001u, limiter.GetDelayMs());
+}
+
+TEST(BandwidthLimiterTest, KeepsPartialBytes) {
+  MockClock clock;
+  BandwidthLimiter limiter(&clock);
+
+  EXPECT_CALL(clock, GetMonotonicTime()).WillRepeatedly(Return(0));
+  limiter.SetLimit(400);
+  limiter.OnReceived(402);
+  EXPECT_EQ(8u, limiter.GetDelayMs());
+
+  // Each millisecond only adds 0.4 bytes, which would be lost if the time
+  // always moved forward.
+  for (uint64_t time = 1; time < 8; time++) {
+    EXPECT_CALL(clock, GetMonotonicTime()).WillRepeatedly(Return(time));
+    EXPECT_FALSE(limiter.CanReceive());
+  }
+  EXPECT_CALL(clock, GetMonotonicTime()).WillRepeatedly(Return(8));
+  EXPECT_TRUE(limiter.CanReceive());
+}
+
+}  // namespace shaka
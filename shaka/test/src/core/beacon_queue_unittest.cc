@@ -0,0 +1,171 @@
+// Copyright 2020 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     https://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "src/core/beacon_queue.h"
+
+#include <gmock/gmock.h>
+#include <gtest/gtest.h>
+#include <zlib.h>
+
+#include <cmath>
+#include <string>
+
+namespace shaka {
+
+namespace {
+
+using testing::Return;
+
+class MockClock : public util::Clock {
+ public:
+  MOCK_CONST_METHOD0(GetMonotonicTime, uint64_t());
+  MOCK_CONST_METHOD0(GetEpochTime, uint64_t());
+};
+
+BeaconQueue::Options MakeOptions(size_t max_events) {
+  BeaconQueue::Options options;
+  options.url = "https://example.com/beacon";
+  options.flush_interval_ms = 1000;
+  options.max_events = max_events;
+  options.compress = false;
+  return options;
+}
+
+}  // namespace
+
+class BeaconQueueTest : public testing::Test {
+ public:
+  BeaconQueueTest() : queue_(&clock_) {}
+
+  void SetUp() override {
+    EXPECT_CALL(clock_, GetEpochTime()).WillRepeatedly(Return(5000));
+    SetTime(100);
+  }
+
+ protected:
+  void SetTime(uint64_t time) {
+    EXPECT_CALL(clock_, GetMonotonicTime()).WillRepeatedly(Return(time));
+  }
+
+  MockClock clock_;
+  BeaconQueue queue_;
+};
+
+TEST_F(BeaconQueueTest, DisabledWithoutUrl) {
+  EXPECT_FALSE(queue_.AddEvent("play", ""));
+  EXPECT_FALSE(queue_.AddMetric("bitrate", 1));
+  EXPECT_EQ(-1, queue_.GetDelayMs());
+  EXPECT_EQ(0u, queue_.GetStats().item_count);
+}
+
+TEST_F(BeaconQueueTest, BuildsBatchAfterInterval) {
+  queue_.SetOptions(MakeOptions(10));
+  EXPECT_TRUE(queue_.AddEvent("play", "{\"id\":1}"));
+  SetTime(400);
+  EXPECT_FALSE(queue_.AddMetric("bitrate", 1.5));
+  EXPECT_EQ(700, queue_.GetDelayMs());
+
+  BeaconQueue::Batch batch;
+  EXPECT_FALSE(queue_.TakeBatch(&batch));
+
+  SetTime(1100);
+  EXPECT_EQ(0, queue_.GetDelayMs());
+  ASSERT_TRUE(queue_.TakeBatch(&batch));
+  EXPECT_EQ("https://example.com/beacon", batch.url);
+  EXPECT_FALSE(batch.compressed);
+  EXPECT_EQ(
+      "{\"events\":[{\"name\":\"play\",\"data\":\"{\\\"id\\\":1}\","
+      "\"time\":5000,\"count\":1}],"
+      "\"metrics\":[{\"name\":\"bitrate\",\"count\":1,\"sum\":1.5,"
+      "\"min\":1.5,\"max\":1.5,\"last\":1.5}],\"dropped\":0}",
+      batch.body);
+
+  EXPECT_EQ(-1, queue_.GetDelayMs());
+  EXPECT_FALSE(queue_.TakeBatch(&batch));
+}
+
+TEST_F(BeaconQueueTest, CoalescesRepeatedItems) {
+  queue_.SetOptions(MakeOptions(10));
+  queue_.AddEvent("stall", "a");
+  queue_.AddEvent("stall", "a");
+  queue_.AddEvent("stall", "b");
+  queue_.AddMetric("fps", 30);
+  queue_.AddMetric("fps", 20);
+  queue_.AddMetric("fps", 25);
+  queue_.AddMetric("fps", NAN);
+
+  SetTime(2000);
+  BeaconQueue::Batch batch;
+  ASSERT_TRUE(queue_.TakeBatch(&batch));
+  EXPECT_EQ(
+      "{\"events\":["
+      "{\"name\":\"stall\",\"data\":\"a\",\"time\":5000,\"count\":2},"
+      "{\"name\":\"stall\",\"data\":\"b\",\"time\":5000,\"count\":1}],"
+      "\"metrics\":[{\"name\":\"fps\",\"count\":3,\"sum\":75,"
+      "\"min\":20,\"max\":30,\"last\":25}],\"dropped\":0}",
+      batch.body);
+
+  const BeaconQueue::Stats stats = queue_.GetStats();
+  EXPECT_EQ(6u, stats.item_count);
+  EXPECT_EQ(3u, stats.coalesced_count);
+  EXPECT_EQ(1u, stats.batch_count);
+}
+
+TEST_F(BeaconQueueTest, DropsOldestEventsWhenFull) {
+  queue_.SetOptions(MakeOptions(2));
+  EXPECT_TRUE(queue_.AddEvent("a", ""));
+  // A full buffer is sent right away.
+  EXPECT_TRUE(queue_.AddEvent("b", ""));
+  EXPECT_EQ(0, queue_.GetDelayMs());
+  queue_.AddEvent("c", "");
+
+  BeaconQueue::Batch batch;
+  ASSERT_TRUE(queue_.TakeBatch(&batch));
+  EXPECT_EQ(
+      "{\"events\":[{\"name\":\"b\",\"data\":\"\",\"time\":5000,\"count\":1},"
+      "{\"name\":\"c\",\"data\":\"\",\"time\":5000,\"count\":1}],"
+      "\"metrics\":[],\"dropped\":1}",
+      batch.body);
+  EXPECT_EQ(1u, queue_.GetStats().dropped_count);
+}
+
+TEST_F(BeaconQueueTest, CompressesBatches) {
+  BeaconQueue::Options options = MakeOptions(1);
+  options.compress = true;
+  queue_.SetOptions(options);
+  const std::string data(1000, 'x');
+  queue_.AddEvent("big", data);
+
+  BeaconQueue::Batch batch;
+  ASSERT_TRUE(queue_.TakeBatch(&batch));
+  ASSERT_TRUE(batch.compressed);
+  EXPECT_LT(batch.body.size(), data.size());
+
+  std::string decoded(2000, '\0');
+  z_stream stream = {};
+  ASSERT_EQ(Z_OK, inflateInit2(&stream, 15 + 16));
+  stream.next_in = reinterpret_cast<Bytef*>(&batch.body[0]);
+  stream.avail_in = static_cast<uInt>(batch.body.size());
+  stream.next_out = reinterpret_cast<Bytef*>(&decoded[0]);
+  stream.avail_out = static_cast<uInt>(decoded.size());
+  EXPECT_EQ(Z_STREAM_END, inflate(&stream, Z_FINISH));
+  decoded.resize(stream.total_out);
+  inflateEnd(&stream);
+  EXPECT_EQ(
+      "{\"events\":[{\"name\":\"big\",\"data\":\"" + data +
+          "\",\"time\":5000,\"count\":1}],\"metrics\":[],\"dropped\":0}",
+      decoded);
+}
+
+}  // namespace shaka
@@ -0,0 +1,88 @@
+// Copyright 2020 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     https://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "src/core/completion_queue.h"
+
+#include <gtest/gtest.h>
+
+#include <thread>
+#include <vector>
+
+#include "src/debug/thread_event.h"
+#include "src/util/clock.h"
+
+namespace shaka {
+
+TEST(CompletionQueueTest, RunsCompletionsInOneBatch) {
+  TaskRunner runner([](TaskRunner::RunLoop loop) { loop(); },
+                    &util::Clock::Instance, true);
+  int batches = 0;
+  CompletionQueue queue(&runner, [&batches]() { batches++; });
+
+  // Block the runner so the completions are queued together.
+  ThreadEvent<void> delay("");
+  runner.PostTask(TaskPriority::Internal, [&delay]() { delay.GetValue(); });
+
+  std::vector<int> order;
+  for (int i = 0; i < 10; i++)
+    queue.Push([&order, i]() { order.push_back(i); });
+  delay.SignalAll();
+  runner.WaitUntilFinished();
+
+  EXPECT_EQ(order, std::vector<int>({0, 1, 2, 3, 4, 5, 6, 7, 8, 9}));
+  EXPECT_EQ(1u, queue.batch_count());
+  EXPECT_EQ(1, batches);
+
+  // A completion pushed after the batch ran starts a new batch.
+  queue.Push([&order]() { order.push_back(10); });
+  runner.WaitUntilFinished();
+  EXPECT_EQ(11u, order.size());
+  EXPECT_EQ(2u, queue.batch_count());
+  EXPECT_EQ(2, batches);
+}
+
+TEST(CompletionQueueTest, AcceptsCompletionsFromManyThreads) {
+  constexpr const int kThreadCount = 4;
+  constexpr const int kPushCount = 1000;
+  TaskRunner runner([](TaskRunner::RunLoop loop) { loop(); },
+                    &util::Clock::Instance, true);
+  CompletionQueue queue(&runner, nullptr);
+
+  // Only the runner thread touches these, so they don't need a lock.
+  std::vector<int> last(kThreadCount, -1);
+  int count = 0;
+  bool in_order = true;
+
+  std::vector<std::thread> threads;
+  for (int t = 0; t < kThreadCount; t++) {
+    threads.emplace_back([&, t]() {
+      for (int i = 0; i < kPushCount; i++) {
+        queue.Push([&, t, i]() {
+          in_order = in_order && last[t] == i - 1;
+          last[t] = i;
+          count++;
+        });
+      }
+    });
+  }
+  for (auto& thread : threads)
+    thread.join();
+  runner.WaitUntilFinished();
+
+  EXPECT_EQ(kThreadCount * kPushCount, count);
+  EXPECT_TRUE(in_order);
+  EXPECT_LE(queue.batch_count(), static_cast<size_t>(count));
+}
+
+}  // namespace shaka
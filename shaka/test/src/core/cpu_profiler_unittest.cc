@@ -0,0 +1,92 @@
+// Copyright 2020 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     https://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "src/core/cpu_profiler.h"
+
+#include <gtest/gtest.h>
+
+#include <string>
+#include <vector>
+
+namespace shaka {
+
+namespace {
+
+JsManager::CpuProfileNode MakeNode(const std::string& name, int32_t parent) {
+  JsManager::CpuProfileNode node;
+  node.function_name = name;
+  node.parent = parent;
+  return node;
+}
+
+}  // namespace
+
+TEST(CpuProfilerTest, AddsTaskFrames) {
+  JsManager::CpuProfile profile;
+  profile.start_time_us = 1000;
+  profile.nodes.push_back(MakeNode("(root)", -1));
+  profile.nodes.push_back(MakeNode("foo", 0));
+  profile.nodes.push_back(MakeNode("bar", 1));
+  profile.samples = {2, 1, 2};
+  profile.time_deltas_us = {10, 10, 10};
+
+  // The second sample is between tasks, so it stays under the root.
+  const std::vector<TaskRunner::TaskSpan> spans = {
+      {"task-a", 1000, 1015},
+      {"task-b", 1025, 1040},
+  };
+  CpuProfiler::AddTaskFrames(spans, &profile);
+
+  struct Expected {
+    std::string name;
+    int32_t parent;
+    bool is_task;
+  };
+  const std::vector<Expected> expected = {
+      {"(root)", -1, false}, {"task-a", 0, true}, {"foo", 1, false},
+      {"bar", 2, false},     {"foo", 0, false},   {"task-b", 0, true},
+      {"foo", 5, false},     {"bar", 6, false},
+  };
+  ASSERT_EQ(expected.size(), profile.nodes.size());
+  for (size_t i = 0; i < expected.size(); i++) {
+    EXPECT_EQ(expected[i].name, profile.nodes[i].function_name) << i;
+    EXPECT_EQ(expected[i].parent, profile.nodes[i].parent) << i;
+    EXPECT_EQ(expected[i].is_task, profile.nodes[i].is_task) << i;
+  }
+  EXPECT_EQ(std::vector<uint32_t>({3, 4, 7}), profile.samples);
+  EXPECT_EQ(std::vector<uint32_t>({10, 10, 10}), profile.time_deltas_us);
+}
+
+TEST(CpuProfilerTest, SharesTaskNodes) {
+  JsManager::CpuProfile profile;
+  profile.start_time_us = 0;
+  profile.nodes.push_back(MakeNode("(root)", -1));
+  profile.nodes.push_back(MakeNode("foo", 0));
+  profile.samples = {1, 1};
+  profile.time_deltas_us = {5, 10};
+
+  const std::vector<TaskRunner::TaskSpan> spans = {
+      {"setTimeout", 0, 10},
+      {"setTimeout", 12, 20},
+  };
+  CpuProfiler::AddTaskFrames(spans, &profile);
+
+  ASSERT_EQ(3u, profile.nodes.size());
+  EXPECT_EQ("setTimeout", profile.nodes[1].function_name);
+  EXPECT_TRUE(profile.nodes[1].is_task);
+  EXPECT_EQ(1, profile.nodes[2].parent);
+  EXPECT_EQ(std::vector<uint32_t>({2, 2}), profile.samples);
+}
+
+}  // namespace shaka
@@ -0,0 +1,85 @@
+// Copyright 2020 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     https://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "src/core/hedge_policy.h"
+
+#include <gtest/gtest.h>
+
+#include <string>
+
+namespace shaka {
+
+TEST(HedgePolicyTest, NeedsEnoughSamples) {
+  HedgePolicy policy;
+  for (size_t i = 1; i < HedgePolicy::kMinSamples; i++)
+    policy.AddTtfb(500);
+  EXPECT_LT(policy.GetDelayMs(95), 0);
+
+  policy.AddTtfb(500);
+  EXPECT_EQ(500, policy.GetDelayMs(95));
+}
+
+TEST(HedgePolicyTest, UsesPercentileOfRecentSamples) {
+  HedgePolicy policy;
+  for (int i = 1; i <= 100; i++)
+    policy.AddTtfb(i * 10);
+
+  // Only the last 50 samples (510-1000) are used.
+  EXPECT_EQ(760, policy.GetDelayMs(50));
+  EXPECT_EQ(980, policy.GetDelayMs(95));
+  EXPECT_EQ(1000, policy.GetDelayMs(100));
+}
+
+TEST(HedgePolicyTest, HasMinimumDelay) {
+  HedgePolicy policy;
+  for (size_t i = 0; i < HedgePolicy::kMinSamples; i++)
+    policy.AddTtfb(5);
+  EXPECT_EQ(HedgePolicy::kMinDelayMs, policy.GetDelayMs(95));
+}
+
+TEST(HedgePolicyTest, FindsAlternates) {
+  HedgePolicy policy;
+  policy.AddAlternates({"https://a.com/seg", "https://b.com/seg",
+                        "https://c.com/seg"});
+  policy.AddAlternates({"https://a.com/other"});
+
+  EXPECT_EQ("https://b.com/seg", policy.GetAlternate("https://a.com/seg"));
+  EXPECT_EQ("https://c.com/seg", policy.GetAlternate("https://b.com/seg"));
+  EXPECT_EQ("https://a.com/seg", policy.GetAlternate("https://c.com/seg"));
+  EXPECT_EQ("", policy.GetAlternate("https://a.com/other"));
+}
+
+TEST(HedgePolicyTest, EvictsOldAlternates) {
+  HedgePolicy policy;
+  for (size_t i = 0; i < HedgePolicy::kMaxAlternates; i++)
+    policy.AddAlternates({"a" + std::to_string(i), "b" + std::to_string(i)});
+
+  EXPECT_EQ("", policy.GetAlternate("a0"));
+  EXPECT_EQ("", policy.GetAlternate("b0"));
+  const std::string last = std::to_string(HedgePolicy::kMaxAlternates - 1);
+  EXPECT_EQ("b" + last, policy.GetAlternate("a" + last));
+}
+
+TEST(HedgePolicyTest, CountsWins) {
+  HedgePolicy policy;
+  policy.OnHedgeDone(true);
+  policy.OnHedgeDone(false);
+  policy.OnHedgeDone(true);
+
+  const HedgePolicy::Stats stats = policy.GetStats();
+  EXPECT_EQ(3u, stats.hedge_count);
+  EXPECT_EQ(2u, stats.win_count);
+}
+
+}  // namespace shaka
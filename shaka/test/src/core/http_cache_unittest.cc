@@ -0,0 +1,203 @@
+// Copyright 2020 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     https://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "src/core/http_cache.h"
+
+#include <glog/logging.h>
+#include <gtest/gtest.h>
+
+#include <string>
+#include <vector>
+
+#include "src/test/temp_dir_test.h"
+#include "src/util/file_system.h"
+
+namespace shaka {
+
+namespace {
+
+constexpr const uint64_t kNow = 1000000;
+
+std::shared_ptr<HttpCache::Entry> MakeEntry(size_t size) {
+  std::shared_ptr<HttpCache::Entry> ret(new HttpCache::Entry);
+  ret->status_text = "OK";
+  ret->uri = "https://example.com/manifest.mpd";
+  ret->headers["content-type"] = "application/dash+xml";
+  ret->headers["etag"] = "\"abc\"";
+  ret->data.resize(size, static_cast<uint8_t>(size));
+  ret->fresh_until = kNow + 60;
+  return ret;
+}
+
+}  // namespace
+
+class HttpCacheTest : public TempDirTest {
+ public:
+  void SetUp() override {
+    TempDirTest::SetUp();
+    dir_ = util::FileSystem::PathJoin(temp_dir_, "cache");
+  }
+
+ protected:
+  size_t CountFiles() {
+    std::vector<std::string> files;
+    CHECK(fs_.ListFiles(dir_, &files));
+    return files.size();
+  }
+
+  std::string dir_;
+};
+
+TEST_F(HttpCacheTest, GetsFreshnessFromHeaders) {
+  EXPECT_EQ(kNow + 30,
+            HttpCache::GetFreshUntil({{"cache-control", "public, max-age=30"}},
+                                     kNow));
+  EXPECT_EQ(kNow, HttpCache::GetFreshUntil(
+                      {{"cache-control", "no-cache, max-age=30"}}, kNow));
+  EXPECT_EQ(kNow, HttpCache::GetFreshUntil({}, kNow));
+
+  // Expires is relative to Date when both are given.
+  EXPECT_EQ(kNow + 120,
+            HttpCache::GetFreshUntil(
+                {{"date", "Sun, 06 Nov 1994 08:49:37 GMT"},
+                 {"expires", "Sun, 06 Nov 1994 08:51:37 GMT"}},
+                kNow));
+  EXPECT_EQ(1583020800u,
+            HttpCache::GetFreshUntil(
+                {{"expires", "Sun, 01 Mar 2020 00:00:00 GMT"}}, kNow));
+  EXPECT_EQ(kNow,
+            HttpCache::GetFreshUntil({{"expires", "invalid"}}, kNow));
+}
+
+TEST_F(HttpCacheTest, ChecksWhetherResponsesCanBeStored) {
+  EXPECT_TRUE(HttpCache::CanStore(200, {{"etag", "\"a\""}}, kNow));
+  EXPECT_TRUE(HttpCache::CanStore(
+      206, {{"last-modified", "Sun, 06 Nov 1994 08:49:37 GMT"}}, kNow));
+  EXPECT_TRUE(
+      HttpCache::CanStore(200, {{"cache-control", "max-age=10"}}, kNow));
+  EXPECT_TRUE(HttpCache::CanStore(
+      200, {{"etag", "\"a\""}, {"vary", "Accept-Encoding"}}, kNow));
+
+  // Nothing to validate with and not fresh.
+  EXPECT_FALSE(HttpCache::CanStore(200, {}, kNow));
+  EXPECT_FALSE(HttpCache::CanStore(404, {{"etag", "\"a\""}}, kNow));
+  EXPECT_FALSE(HttpCache::CanStore(
+      200, {{"etag", "\"a\""}, {"cache-control", "no-store"}}, kNow));
+  EXPECT_FALSE(HttpCache::CanStore(
+      200, {{"etag", "\"a\""}, {"cache-control", "private"}}, kNow));
+  EXPECT_FALSE(HttpCache::CanStore(
+      200, {{"cache-control", "Private, max-age=10"}}, kNow));
+  EXPECT_FALSE(HttpCache::CanStore(
+      200, {{"etag", "\"a\""}, {"vary", "Cookie"}}, kNow));
+}
+
+TEST_F(HttpCacheTest, GetsValidatorHeaders) {
+  auto entry = MakeEntry(10);
+  entry->headers["last-modified"] = "Sun, 06 Nov 1994 08:49:37 GMT";
+  EXPECT_EQ((std::vector<std::string>{
+                "If-None-Match: \"abc\"",
+                "If-Modified-Since: Sun, 06 Nov 1994 08:49:37 GMT"}),
+            entry->GetValidatorHeaders());
+}
+
+TEST_F(HttpCacheTest, StoresInMemoryWithoutDirectory) {
+  HttpCache cache(1000);
+  auto entry = MakeEntry(10);
+  cache.Put("foo", entry);
+  EXPECT_EQ(entry, cache.Get("foo"));
+  EXPECT_EQ(nullptr, cache.Get("bar"));
+
+  cache.ClearMemory();
+  EXPECT_EQ(nullptr, cache.Get("foo"));
+}
+
+TEST_F(HttpCacheTest, DisabledWithoutSize) {
+  HttpCache cache;
+  EXPECT_FALSE(cache.enabled());
+  cache.Put("foo", MakeEntry(10));
+  EXPECT_EQ(nullptr, cache.Get("foo"));
+}
+
+TEST_F(HttpCacheTest, PersistsEntries) {
+  const std::string key = SegmentCache::MakeKey("https://example.com/init",
+                                                "bytes=0-99");
+  auto entry = MakeEntry(100);
+  {
+    HttpCache cache(10000);
+    cache.SetDirectory(dir_, nullptr);
+    cache.Put(key, entry);
+  }
+  EXPECT_EQ(1u, CountFiles());
+
+  HttpCache cache(10000);
+  cache.SetDirectory(dir_, nullptr);
+  auto found = cache.Get(key);
+  ASSERT_TRUE(found);
+  EXPECT_EQ(entry->status, found->status);
+  EXPECT_EQ(entry->status_text, found->status_text);
+  EXPECT_EQ(entry->uri, found->uri);
+  EXPECT_EQ(entry->headers, found->headers);
+  EXPECT_EQ(entry->data, found->data);
+  EXPECT_EQ(entry->fresh_until, found->fresh_until);
+  EXPECT_EQ(nullptr, cache.Get("https://example.com/init"));
+}
+
+TEST_F(HttpCacheTest, EvictsLeastRecentlyUsedFiles) {
+  HttpCache cache(1000);
+  cache.SetDirectory(dir_, nullptr);
+  cache.Put("a", MakeEntry(300));
+  cache.Put("b", MakeEntry(300));
+  EXPECT_EQ(2u, CountFiles());
+
+  // Using "a" from disk makes "b" the oldest.
+  cache.ClearMemory();
+  ASSERT_TRUE(cache.Get("a"));
+  cache.Put("c", MakeEntry(300));
+  EXPECT_EQ(2u, CountFiles());
+
+  cache.ClearMemory();
+  EXPECT_TRUE(cache.Get("a"));
+  EXPECT_EQ(nullptr, cache.Get("b"));
+  EXPECT_TRUE(cache.Get("c"));
+
+  cache.SetMaxSize(0);
+  EXPECT_EQ(0u, CountFiles());
+}
+
+TEST_F(HttpCacheTest, RefreshesEntries) {
+  HttpCache cache(10000);
+  cache.SetDirectory(dir_, nullptr);
+  auto entry = MakeEntry(10);
+  cache.Put("foo", entry);
+
+  auto refreshed = cache.Refresh(
+      "foo",
+      {{"cache-control", "max-age=100"},
+       {"content-length", "0"},
+       {"etag", "\"def\""}},
+      kNow + 1000);
+  ASSERT_TRUE(refreshed);
+  EXPECT_EQ(kNow + 1100, refreshed->fresh_until);
+  EXPECT_EQ("\"def\"", refreshed->headers.at("etag"));
+  EXPECT_EQ(0u, refreshed->headers.count("content-length"));
+  EXPECT_EQ(entry->data, refreshed->data);
+
+  cache.ClearMemory();
+  auto found = cache.Get("foo");
+  ASSERT_TRUE(found);
+  EXPECT_EQ(kNow + 1100, found->fresh_until);
+  EXPECT_EQ(nullptr, cache.Refresh("bar", {}, kNow));
+}
+
+}  // namespace shaka
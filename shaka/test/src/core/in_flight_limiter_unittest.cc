@@ -0,0 +1,77 @@
+// Copyright 2020 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     https://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "src/core/in_flight_limiter.h"
+
+#include <gtest/gtest.h>
+
+namespace shaka {
+
+namespace {
+
+const int kFirst = 0;
+const int kSecond = 0;
+const int kThird = 0;
+
+}  // namespace
+
+TEST(InFlightLimiterTest, AllowsEverythingWithoutLimit) {
+  InFlightLimiter limiter;
+  EXPECT_TRUE(limiter.TryReceive(&kFirst, 1000000));
+  EXPECT_TRUE(limiter.TryReceive(&kSecond, 1000000));
+  EXPECT_EQ(2000000u, limiter.in_flight_bytes());
+}
+
+TEST(InFlightLimiterTest, LetsLargestRequestContinue) {
+  InFlightLimiter limiter;
+  limiter.SetLimits(1000, 0);
+  EXPECT_TRUE(limiter.TryReceive(&kFirst, 600));
+  EXPECT_TRUE(limiter.TryReceive(&kSecond, 300));
+
+  EXPECT_FALSE(limiter.TryReceive(&kSecond, 200));
+  EXPECT_TRUE(limiter.TryReceive(&kFirst, 200));
+  EXPECT_EQ(1100u, limiter.in_flight_bytes());
+
+  // Once the first completes, the second can continue.
+  EXPECT_TRUE(limiter.TakeReleased());
+  EXPECT_FALSE(limiter.TakeReleased());
+  limiter.Release(&kFirst);
+  EXPECT_TRUE(limiter.TakeReleased());
+  EXPECT_EQ(300u, limiter.in_flight_bytes());
+  EXPECT_TRUE(limiter.TryReceive(&kSecond, 200));
+}
+
+TEST(InFlightLimiterTest, AllowsEachRequestItsOwnBytes) {
+  InFlightLimiter limiter;
+  limiter.SetLimits(1000, 100);
+  EXPECT_TRUE(limiter.TryReceive(&kFirst, 1000));
+  EXPECT_TRUE(limiter.TryReceive(&kSecond, 100));
+  EXPECT_TRUE(limiter.TryReceive(&kThird, 50));
+  EXPECT_TRUE(limiter.TryReceive(&kThird, 50));
+  EXPECT_FALSE(limiter.TryReceive(&kThird, 1));
+}
+
+TEST(InFlightLimiterTest, IgnoresEmptyReleases) {
+  InFlightLimiter limiter;
+  limiter.SetLimits(1000, 0);
+  EXPECT_TRUE(limiter.TakeReleased());
+
+  limiter.Release(&kFirst);
+  EXPECT_FALSE(limiter.TakeReleased());
+  EXPECT_TRUE(limiter.TryReceive(&kFirst, 0));
+  limiter.Release(&kFirst);
+  EXPECT_FALSE(limiter.TakeReleased());
+}
+
+}  // namespace shaka
@@ -0,0 +1,162 @@
+// Copyright 2020 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     https://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "src/core/offline_index.h"
+
+#include <glog/logging.h>
+#include <gtest/gtest.h>
+
+#include <limits>
+#include <string>
+#include <vector>
+
+#include "src/test/temp_dir_test.h"
+#include "src/util/file_system.h"
+
+namespace shaka {
+
+namespace {
+
+OfflineIndex::Entry MakeEntry(const std::string& uri) {
+  OfflineIndex::Entry entry;
+  entry.offline_uri = uri;
+  entry.original_manifest_uri = "https://example.com/" + uri + ".mpd";
+  entry.duration = 123.456;
+  entry.size = 1024;
+  entry.expiration = std::numeric_limits<double>::infinity();
+  return entry;
+}
+
+}  // namespace
+
+class OfflineIndexTest : public TempDirTest {
+ public:
+  void SetUp() override {
+    TempDirTest::SetUp();
+    path_ = util::FileSystem::PathJoin(temp_dir_, "index");
+  }
+
+ protected:
+  std::string path_;
+};
+
+TEST_F(OfflineIndexTest, IsOnlyUsedOnceListed) {
+  OfflineIndex index;
+  std::vector<OfflineIndex::Entry> entries;
+  EXPECT_FALSE(index.GetAll(&entries));
+
+  // Storing content doesn't tell us about the content that was already there.
+  index.BeginUpdate();
+  index.FinishStore(MakeEntry("a"));
+  EXPECT_FALSE(index.GetAll(&entries));
+
+  index.Reset({MakeEntry("a"), MakeEntry("b")}, index.GetGeneration());
+  ASSERT_TRUE(index.GetAll(&entries));
+  ASSERT_EQ(2u, entries.size());
+  EXPECT_EQ("a", entries[0].offline_uri.value());
+  EXPECT_EQ("b", entries[1].offline_uri.value());
+}
+
+TEST_F(OfflineIndexTest, TracksUpdates) {
+  OfflineIndex index;
+  index.Reset({MakeEntry("a")}, index.GetGeneration());
+
+  std::vector<OfflineIndex::Entry> entries;
+  index.BeginUpdate();
+  EXPECT_FALSE(index.GetAll(&entries));
+  index.FinishStore(MakeEntry("b"));
+  ASSERT_TRUE(index.GetAll(&entries));
+  EXPECT_EQ(2u, entries.size());
+
+  index.BeginUpdate();
+  index.FinishRemove("a");
+  ASSERT_TRUE(index.GetAll(&entries));
+  ASSERT_EQ(1u, entries.size());
+  EXPECT_EQ("b", entries[0].offline_uri.value());
+
+  index.BeginUpdate();
+  index.FailUpdate();
+  EXPECT_FALSE(index.GetAll(&entries));
+}
+
+TEST_F(OfflineIndexTest, IgnoresStaleLists) {
+  OfflineIndex index;
+  const uint64_t generation = index.GetGeneration();
+  index.BeginUpdate();
+  index.FinishStore(MakeEntry("b"));
+
+  // The list started before "b" was stored, so it may be missing.
+  index.Reset({MakeEntry("a")}, generation);
+  std::vector<OfflineIndex::Entry> entries;
+  EXPECT_FALSE(index.GetAll(&entries));
+}
+
+TEST_F(OfflineIndexTest, PersistsEntries) {
+  OfflineIndex::Entry entry = MakeEntry("offline:manifest/1");
+  entry.original_manifest_uri = "https://example.com/a\tb\n.mpd";
+  entry.app_metadata["name"] = "Big, Buck: Bunny";
+  entry.app_metadata["empty"] = "";
+  OfflineIndex::Entry no_uri;
+  no_uri.duration = 0.1;
+  {
+    OfflineIndex index;
+    index.SetFile(path_);
+    index.Reset({entry, no_uri}, index.GetGeneration());
+  }
+
+  OfflineIndex index;
+  index.SetFile(path_);
+  std::vector<OfflineIndex::Entry> entries;
+  ASSERT_TRUE(index.GetAll(&entries));
+  ASSERT_EQ(2u, entries.size());
+  EXPECT_EQ(entry.offline_uri, entries[0].offline_uri);
+  EXPECT_EQ(entry.original_manifest_uri, entries[0].original_manifest_uri);
+  EXPECT_EQ(entry.duration, entries[0].duration);
+  EXPECT_EQ(entry.size, entries[0].size);
+  EXPECT_EQ(entry.expiration, entries[0].expiration);
+  EXPECT_EQ(entry.app_metadata, entries[0].app_metadata);
+  EXPECT_FALSE(entries[1].offline_uri.has_value());
+  EXPECT_EQ(0.1, entries[1].duration);
+}
+
+TEST_F(OfflineIndexTest, DropsFileDuringUpdates) {
+  {
+    OfflineIndex index;
+    index.SetFile(path_);
+    index.Reset({MakeEntry("a")}, index.GetGeneration());
+    EXPECT_TRUE(fs_.FileExists(path_));
+
+    // If the app exits now, the content may have been stored.
+    index.BeginUpdate();
+    EXPECT_FALSE(fs_.FileExists(path_));
+  }
+
+  OfflineIndex index;
+  index.SetFile(path_);
+  std::vector<OfflineIndex::Entry> entries;
+  EXPECT_FALSE(index.GetAll(&entries));
+}
+
+TEST_F(OfflineIndexTest, IgnoresInvalidFiles) {
+  const std::string data = "shaka-offline-index 1\nnot an entry\n";
+  ASSERT_TRUE(
+      fs_.WriteFile(path_, std::vector<uint8_t>(data.begin(), data.end())));
+
+  OfflineIndex index;
+  index.SetFile(path_);
+  std::vector<OfflineIndex::Entry> entries;
+  EXPECT_FALSE(index.GetAll(&entries));
+}
+
+}  // namespace shaka
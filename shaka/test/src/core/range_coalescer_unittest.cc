@@ -0,0 +1,111 @@
+// Copyright 2020 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     https://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "src/core/range_coalescer.h"
+
+#include <gtest/gtest.h>
+
+#include <string>
+#include <vector>
+
+namespace shaka {
+
+namespace {
+
+const std::string kUrl = "https://example.com/video.mp4";
+
+}  // namespace
+
+TEST(RangeCoalescerTest, GroupsAdjacentRanges) {
+  // The requests can be made in any order.
+  const std::vector<RangeRequest> ranges = {
+      {kUrl, 100, 199}, {kUrl, 0, 99}, {kUrl, 200, 499}};
+  const std::vector<RangeGroup> groups = GroupRangeRequests(ranges);
+  ASSERT_EQ(1u, groups.size());
+  EXPECT_EQ(std::vector<size_t>({1, 0, 2}), groups[0].requests);
+  EXPECT_EQ(499u, groups[0].end);
+}
+
+TEST(RangeCoalescerTest, GroupsOverlappingRanges) {
+  const std::vector<RangeRequest> ranges = {
+      {kUrl, 0, 149}, {kUrl, 100, 199}, {kUrl, 20, 50}, {kUrl, 0, 149}};
+  const std::vector<RangeGroup> groups = GroupRangeRequests(ranges);
+  ASSERT_EQ(1u, groups.size());
+  EXPECT_EQ(std::vector<size_t>({0, 3, 2, 1}), groups[0].requests);
+  EXPECT_EQ(199u, groups[0].end);
+}
+
+TEST(RangeCoalescerTest, DoesNotGroupGappedRanges) {
+  const std::vector<RangeRequest> ranges = {
+      {kUrl, 0, 99}, {kUrl, 101, 199}, {kUrl, 200, 299}};
+  const std::vector<RangeGroup> groups = GroupRangeRequests(ranges);
+  ASSERT_EQ(2u, groups.size());
+  EXPECT_EQ(std::vector<size_t>({0}), groups[0].requests);
+  EXPECT_EQ(99u, groups[0].end);
+  EXPECT_EQ(std::vector<size_t>({1, 2}), groups[1].requests);
+  EXPECT_EQ(299u, groups[1].end);
+}
+
+TEST(RangeCoalescerTest, DoesNotGroupDifferentKeys) {
+  const std::vector<RangeRequest> ranges = {
+      {kUrl, 0, 99}, {kUrl + "\nX-Header: 1", 100, 199}};
+  const std::vector<RangeGroup> groups = GroupRangeRequests(ranges);
+  ASSERT_EQ(2u, groups.size());
+  EXPECT_EQ(1u, groups[0].requests.size());
+  EXPECT_EQ(1u, groups[1].requests.size());
+}
+
+TEST(RangeCoalescerTest, SplitsTheResponse) {
+  // A group of 0-99, 100-199 (which overlaps the next) and 150-299 is
+  // downloaded as 0-299.
+  const std::vector<RangeRequest> ranges = {
+      {kUrl, 0, 99}, {kUrl, 100, 199}, {kUrl, 150, 299}};
+  const std::vector<RangeGroup> groups = GroupRangeRequests(ranges);
+  ASSERT_EQ(1u, groups.size());
+  ASSERT_EQ(299u, groups[0].end);
+
+  size_t offset;
+  size_t size;
+  ASSERT_TRUE(GetCoalescedPart(0, 300, ranges[0], &offset, &size));
+  EXPECT_EQ(0u, offset);
+  EXPECT_EQ(100u, size);
+  ASSERT_TRUE(GetCoalescedPart(0, 300, ranges[1], &offset, &size));
+  EXPECT_EQ(100u, offset);
+  EXPECT_EQ(100u, size);
+  ASSERT_TRUE(GetCoalescedPart(0, 300, ranges[2], &offset, &size));
+  EXPECT_EQ(150u, offset);
+  EXPECT_EQ(150u, size);
+}
+
+TEST(RangeCoalescerTest, SplitsAResponseThatDoesNotStartAtZero) {
+  size_t offset;
+  size_t size;
+  ASSERT_TRUE(GetCoalescedPart(1000, 500, {kUrl, 1200, 1499}, &offset, &size));
+  EXPECT_EQ(200u, offset);
+  EXPECT_EQ(300u, size);
+}
+
+TEST(RangeCoalescerTest, DetectsShortenedResponses) {
+  size_t offset;
+  size_t size;
+  // The server only returned 0-249.
+  EXPECT_TRUE(GetCoalescedPart(0, 250, {kUrl, 0, 99}, &offset, &size));
+  EXPECT_FALSE(GetCoalescedPart(0, 250, {kUrl, 150, 299}, &offset, &size));
+  EXPECT_FALSE(GetCoalescedPart(0, 250, {kUrl, 250, 299}, &offset, &size));
+  EXPECT_FALSE(GetCoalescedPart(0, 0, {kUrl, 0, 0}, &offset, &size));
+  // The body starts after the range.
+  EXPECT_FALSE(GetCoalescedPart(100, 500, {kUrl, 0, 99}, &offset, &size));
+}
+
+}  // namespace shaka
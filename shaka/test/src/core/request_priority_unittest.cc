@@ -0,0 +1,67 @@
+// Copyright 2020 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     https://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "src/core/request_priority.h"
+
+#include <gtest/gtest.h>
+
+#include <string>
+
+namespace shaka {
+
+TEST(RequestPriorityTest, MapsRequestTypes) {
+  EXPECT_EQ(RequestPriority::Critical,
+            GetRequestPriority(RequestType::License));
+  EXPECT_EQ(RequestPriority::High, GetRequestPriority(RequestType::Manifest));
+  EXPECT_EQ(RequestPriority::High, GetRequestPriority(RequestType::Timing));
+  EXPECT_EQ(RequestPriority::Normal, GetRequestPriority(RequestType::Segment));
+  EXPECT_EQ(RequestPriority::Normal, GetRequestPriority(RequestType::App));
+  EXPECT_EQ(RequestPriority::Normal, GetRequestPriority(RequestType::Unknown));
+
+  EXPECT_GT(GetStreamWeight(RequestPriority::Critical),
+            GetStreamWeight(RequestPriority::High));
+  EXPECT_GT(GetStreamWeight(RequestPriority::High),
+            GetStreamWeight(RequestPriority::Normal));
+  EXPECT_GT(GetStreamWeight(RequestPriority::Normal),
+            GetStreamWeight(RequestPriority::Background));
+}
+
+TEST(RequestPriorityTest, HintsDefaultToNormal) {
+  RequestPriorityHints hints;
+  EXPECT_EQ(RequestPriority::Normal, hints.Get("https://example.com/a"));
+
+  hints.Add("https://example.com/a", RequestType::License);
+  EXPECT_EQ(RequestPriority::Critical, hints.Get("https://example.com/a"));
+  EXPECT_EQ(RequestPriority::Normal, hints.Get("https://example.com/b"));
+}
+
+TEST(RequestPriorityTest, HintsUseLatestType) {
+  RequestPriorityHints hints;
+  hints.Add("https://example.com/a", RequestType::Manifest);
+  hints.Add("https://example.com/a", RequestType::Segment);
+  EXPECT_EQ(RequestPriority::Normal, hints.Get("https://example.com/a"));
+}
+
+TEST(RequestPriorityTest, HintsEvictOldest) {
+  RequestPriorityHints hints;
+  for (size_t i = 0; i <= RequestPriorityHints::kMaxHints; i++)
+    hints.Add("url" + std::to_string(i), RequestType::License);
+
+  EXPECT_EQ(RequestPriority::Normal, hints.Get("url0"));
+  EXPECT_EQ(RequestPriority::Critical, hints.Get("url1"));
+  EXPECT_EQ(RequestPriority::Critical,
+            hints.Get("url" + std::to_string(RequestPriorityHints::kMaxHints)));
+}
+
+}  // namespace shaka
@@ -0,0 +1,129 @@
+// Copyright 2018 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     https://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "src/core/segment_cache.h"
+
+#include <gtest/gtest.h>
+
+#include "src/memory/memory_budget.h"
+
+namespace shaka {
+
+namespace {
+
+std::shared_ptr<const SegmentCache::Entry> MakeEntry(size_t size) {
+  std::shared_ptr<SegmentCache::Entry> ret(new SegmentCache::Entry);
+  ret->data.resize(size, static_cast<uint8_t>(size));
+  return ret;
+}
+
+}  // namespace
+
+TEST(SegmentCacheTest, StoresEntries) {
+  SegmentCache cache(100);
+  auto entry = MakeEntry(10);
+  cache.Put("foo", entry);
+
+  EXPECT_EQ(entry, cache.Get("foo"));
+  EXPECT_EQ(nullptr, cache.Get("bar"));
+
+  const SegmentCache::Stats stats = cache.GetStats();
+  EXPECT_EQ(1u, stats.hits);
+  EXPECT_EQ(1u, stats.misses);
+  EXPECT_EQ(0u, stats.evictions);
+  EXPECT_EQ(1u, stats.entry_count);
+  EXPECT_EQ(10u, stats.total_bytes);
+}
+
+TEST(SegmentCacheTest, KeysIncludeRange) {
+  SegmentCache cache(100);
+  cache.Put(SegmentCache::MakeKey("http://foo", "bytes=0-9"), MakeEntry(10));
+
+  EXPECT_NE(nullptr, cache.Get(SegmentCache::MakeKey("http://foo",
+                                                     "bytes=0-9")));
+  EXPECT_EQ(nullptr, cache.Get(SegmentCache::MakeKey("http://foo",
+                                                     "bytes=10-19")));
+  EXPECT_EQ(nullptr, cache.Get(SegmentCache::MakeKey("http://foo", "")));
+}
+
+TEST(SegmentCacheTest, EvictsLeastRecentlyUsed) {
+  SegmentCache cache(30);
+  cache.Put("a", MakeEntry(10));
+  cache.Put("b", MakeEntry(10));
+  cache.Put("c", MakeEntry(10));
+
+  // Use "a" so "b" is the oldest.
+  ASSERT_NE(nullptr, cache.Get("a"));
+  cache.Put("d", MakeEntry(10));
+
+  EXPECT_NE(nullptr, cache.Get("a"));
+  EXPECT_EQ(nullptr, cache.Get("b"));
+  EXPECT_NE(nullptr, cache.Get("c"));
+  EXPECT_NE(nullptr, cache.Get("d"));
+  EXPECT_EQ(1u, cache.GetStats().evictions);
+  EXPECT_EQ(30u, cache.GetStats().total_bytes);
+}
+
+TEST(SegmentCacheTest, ReplacesExistingEntries) {
+  SegmentCache cache(30);
+  cache.Put("a", MakeEntry(10));
+  auto entry = MakeEntry(20);
+  cache.Put("a", entry);
+
+  EXPECT_EQ(entry, cache.Get("a"));
+  EXPECT_EQ(1u, cache.GetStats().entry_count);
+  EXPECT_EQ(20u, cache.GetStats().total_bytes);
+  EXPECT_EQ(0u, cache.GetStats().evictions);
+}
+
+TEST(SegmentCacheTest, IgnoresLargeEntries) {
+  SegmentCache cache(30);
+  cache.Put("a", MakeEntry(10));
+  cache.Put("b", MakeEntry(31));
+
+  EXPECT_NE(nullptr, cache.Get("a"));
+  EXPECT_EQ(nullptr, cache.Get("b"));
+  EXPECT_EQ(0u, cache.GetStats().evictions);
+}
+
+TEST(SegmentCacheTest, ShrinksWhenResized) {
+  SegmentCache cache(30);
+  cache.Put("a", MakeEntry(10));
+  cache.Put("b", MakeEntry(10));
+  cache.Put("c", MakeEntry(10));
+
+  cache.SetMaxSize(15);
+  EXPECT_EQ(1u, cache.GetStats().entry_count);
+  EXPECT_NE(nullptr, cache.Get("c"));
+
+  cache.SetMaxSize(0);
+  EXPECT_FALSE(cache.enabled());
+  EXPECT_EQ(0u, cache.GetStats().entry_count);
+  EXPECT_EQ(0u, cache.GetStats().total_bytes);
+}
+
+TEST(SegmentCacheTest, EvictsToFitMemoryBudget) {
+  SegmentCache cache(100);
+  memory::MemoryBudget::Instance()->SetBudget(25);
+  cache.Put("a", MakeEntry(10));
+  cache.Put("b", MakeEntry(10));
+  cache.Put("c", MakeEntry(10));
+  memory::MemoryBudget::Instance()->SetBudget(0);
+
+  EXPECT_EQ(2u, cache.GetStats().entry_count);
+  EXPECT_EQ(nullptr, cache.Get("a"));
+  EXPECT_NE(nullptr, cache.Get("c"));
+}
+
+}  // namespace shaka
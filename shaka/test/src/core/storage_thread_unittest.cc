@@ -0,0 +1,103 @@
+// Copyright 2020 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     https://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "src/core/storage_thread.h"
+
+#include <gmock/gmock.h>
+#include <gtest/gtest.h>
+
+#include <future>
+#include <vector>
+
+namespace shaka {
+
+namespace {
+
+constexpr const size_t kTaskCount = 5;
+
+}  // namespace
+
+class StorageThreadTest : public testing::Test {
+ public:
+  StorageThreadTest()
+      : main_thread_([](TaskRunner::RunLoop loop) { loop(); },
+                     &util::Clock::Instance, /* is_worker */ true),
+        storage_(&main_thread_, &util::Clock::Instance) {}
+
+  ~StorageThreadTest() override {
+    storage_.Stop();
+    main_thread_.Stop();
+  }
+
+ protected:
+  TaskRunner main_thread_;
+  StorageThread storage_;
+};
+
+TEST_F(StorageThreadTest, RunsTasksInOrder) {
+  std::vector<size_t> work_order;
+  std::vector<size_t> done_order;
+  std::promise<void> finished;
+
+  for (size_t i = 0; i < kTaskCount; i++) {
+    storage_.AddTask(
+        "Test",
+        [&, i]() {
+          EXPECT_FALSE(main_thread_.BelongsToCurrentThread());
+          work_order.push_back(i);
+        },
+        [&, i]() {
+          EXPECT_TRUE(main_thread_.BelongsToCurrentThread());
+          done_order.push_back(i);
+          if (i + 1 == kTaskCount)
+            finished.set_value();
+        });
+  }
+  finished.get_future().wait();
+
+  const std::vector<size_t> expected = {0, 1, 2, 3, 4};
+  EXPECT_EQ(expected, work_order);
+  EXPECT_EQ(expected, done_order);
+}
+
+TEST_F(StorageThreadTest, TracksQueueDepth) {
+  std::promise<void> unblock;
+  std::shared_future<void> unblocked = unblock.get_future().share();
+  std::promise<void> finished;
+
+  for (size_t i = 0; i < kTaskCount; i++) {
+    storage_.AddTask(
+        "Test", [unblocked]() { unblocked.wait(); },
+        [&, i]() {
+          if (i + 1 == kTaskCount)
+            finished.set_value();
+        });
+  }
+
+  StorageThread::Stats stats = storage_.GetStats();
+  EXPECT_EQ(kTaskCount, stats.queue_depth);
+  EXPECT_EQ(kTaskCount, stats.max_queue_depth);
+  EXPECT_EQ(0u, stats.task_count);
+
+  unblock.set_value();
+  finished.get_future().wait();
+
+  stats = storage_.GetStats();
+  EXPECT_EQ(0u, stats.queue_depth);
+  EXPECT_EQ(kTaskCount, stats.max_queue_depth);
+  EXPECT_EQ(kTaskCount, stats.task_count);
+  EXPECT_GE(stats.total_latency_ms, stats.max_latency_ms);
+}
+
+}  // namespace shaka
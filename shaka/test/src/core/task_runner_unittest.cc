@@ -17,6 +17,14 @@
 #include <gmock/gmock.h>
 #include <gtest/gtest.h>
 
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <future>
+#include <limits>
+#include <string>
+#include <vector>
+
 #include "src/debug/thread_event.h"
 #include "src/memory/heap_tracer.h"
 
@@ -29,12 +37,20 @@ using testing::InSequence;
 using testing::MockFunction;
 using testing::NiceMock;
 using testing::Return;
+using testing::ReturnPointee;
 using testing::StrictMock;
 
 class MockClock : public util::Clock {
  public:
   MOCK_CONST_METHOD0(GetMonotonicTime, uint64_t());
   MOCK_CONST_METHOD1(SleepSeconds, void(double));
+
+  void WaitForSignal(std::condition_variable* cond,
+                     std::unique_lock<std::mutex>* lock,
+                     double seconds) const override {
+    // The fake time doesn't advance while we wait, so return immediately so
+    // the runner will see the new time.
+  }
 };
 
 class TaskWatcher {
@@ -81,6 +97,30 @@ TEST(TaskRunnerTest, DelaysTimers) {
   runner.WaitUntilFinished();
 }
 
+TEST(TaskRunnerTest, AlignsTimersToSlack) {
+  StrictMock<TaskWatcher> watcher;
+  NiceMock<MockClock> clock;
+  MockFunction<void()> start;
+
+  {
+    InSequence seq;
+    EXPECT_CALL(clock, GetMonotonicTime()).WillRepeatedly(Return(0));
+    EXPECT_CALL(start, Call()).Times(1);
+    EXPECT_CALL(clock, GetMonotonicTime()).WillOnce(Return(5));
+    EXPECT_CALL(clock, GetMonotonicTime()).WillOnce(Return(7));
+    EXPECT_CALL(clock, GetMonotonicTime()).WillOnce(Return(9));
+    EXPECT_CALL(clock, GetMonotonicTime()).WillOnce(Return(10));
+    EXPECT_CALL(watcher, Call()).Times(1);
+    EXPECT_CALL(clock, GetMonotonicTime()).WillRepeatedly(Return(11));
+  }
+
+  TaskRunner runner([](TaskRunner::RunLoop loop) { loop(); }, &clock, true);
+  runner.SetTimerSlack(10);
+  runner.AddTimer(5, MockTask(&watcher));
+  start.Call();
+  runner.WaitUntilFinished();
+}
+
 TEST(TaskRunnerTest, FiresTimersBasedOnRegisterOrder) {
   StrictMock<TaskWatcher> watcher1;
   StrictMock<TaskWatcher> watcher2;
@@ -216,6 +256,56 @@ TEST(TaskRunnerTest, CancelsRepeatedTimers) {
   runner.WaitUntilFinished();
 }
 
+TEST(TaskRunnerTest, CancelsRepeatedTimersFromCallback) {
+  NiceMock<MockClock> clock;
+  MockFunction<void()> start;
+  int count = 0;
+  int id = 0;
+
+  {
+    InSequence seq;
+    EXPECT_CALL(clock, GetMonotonicTime()).WillRepeatedly(Return(0));
+    EXPECT_CALL(start, Call()).Times(1);
+    EXPECT_CALL(clock, GetMonotonicTime()).WillRepeatedly(Return(100));
+  }
+
+  TaskRunner runner([](TaskRunner::RunLoop loop) { loop(); }, &clock, true);
+  id = runner.AddRepeatedTimer(10, [&]() {
+    count++;
+    runner.CancelTimer(id);
+  });
+  start.Call();
+  util::Clock::Instance.SleepSeconds(0.01);
+  runner.Stop();
+  EXPECT_EQ(1, count);
+}
+
+TEST(TaskRunnerTest, FiresManyTimersInOrder) {
+  NiceMock<MockClock> clock;
+  MockFunction<void()> start;
+  std::vector<int> order;
+
+  {
+    InSequence seq;
+    EXPECT_CALL(clock, GetMonotonicTime()).WillRepeatedly(Return(0));
+    EXPECT_CALL(start, Call()).Times(1);
+    EXPECT_CALL(clock, GetMonotonicTime()).WillRepeatedly(Return(1000));
+  }
+
+  TaskRunner runner([](TaskRunner::RunLoop loop) { loop(); }, &clock, true);
+  // Register the timers with delays in a scrambled order.
+  for (int i = 0; i < 100; i++) {
+    const int delay = (i * 37) % 100;
+    runner.AddTimer(delay, [&order, delay]() { order.push_back(delay); });
+  }
+  start.Call();
+  runner.WaitUntilFinished();
+
+  ASSERT_EQ(100u, order.size());
+  for (int i = 0; i < 100; i++)
+    EXPECT_EQ(i, order[i]);
+}
+
 TEST(TaskRunnerTest, IgnoresUnknownWhenCanceling) {
   StrictMock<TaskWatcher> watcher;
   NiceMock<MockClock> clock;
@@ -298,4 +388,277 @@ TEST(TaskRunnerTest, PassesReturnValues) {
   EXPECT_EQ(1234.5, data->GetValue());
 }
 
+TEST(TaskRunnerTest, DoesntPollWhenIdle) {
+  TaskRunner runner([](TaskRunner::RunLoop loop) { loop(); },
+                    &util::Clock::Instance, true);
+  runner.WaitUntilFinished();
+  runner.GetWakeupsPerSecond();
+
+  // The old implementation polled every 1ms.  With no work, this should only
+  // wake up when new tasks are added.
+  util::Clock::Instance.SleepSeconds(0.1);
+  EXPECT_LT(runner.GetWakeupsPerSecond(), 50);
+
+  std::function<int()> cb = []() { return 12; };
+  auto data = runner.AddInternalTask(TaskPriority::Internal, "", std::move(cb));
+  EXPECT_EQ(12, data->GetValue());
+}
+
+TEST(TaskRunnerTest, PostsTasksInOrder) {
+  StrictMock<TaskWatcher> watcher1;
+  StrictMock<TaskWatcher> watcher2;
+  NiceMock<MockClock> clock;
+
+  {
+    InSequence seq;
+    EXPECT_CALL(watcher2, Call()).Times(1);
+    EXPECT_CALL(watcher1, Call()).Times(1);
+  }
+
+  ThreadEvent<void> delay("");
+  TaskRunner runner(
+      [&](TaskRunner::RunLoop loop) {
+        delay.GetValue();
+        loop();
+      },
+      &clock, true);
+  runner.PostTask(TaskPriority::Internal, MockTask(&watcher1));
+  runner.PostTask(TaskPriority::Immediate, MockTask(&watcher2));
+  delay.SignalAll();
+  runner.WaitUntilFinished();
+}
+
+TEST(TaskRunnerTest, ReusesTaskMemory) {
+  constexpr const int kTaskCount = 100;
+  NiceMock<MockClock> clock;
+
+  TaskRunner runner([](TaskRunner::RunLoop loop) { loop(); }, &clock, true);
+  int count = 0;
+  for (int i = 0; i < kTaskCount; i++) {
+    runner.PostTask(TaskPriority::Internal, [&count]() { count++; });
+    runner.WaitUntilFinished();
+  }
+  EXPECT_EQ(kTaskCount, count);
+  // Each task finishes before the next is posted, so they all use the same
+  // memory.
+  EXPECT_EQ(1u, runner.task_allocation_count());
+
+  // Queueing many tasks at once only allocates as many as are pending.
+  ThreadEvent<void> delay("");
+  runner.PostTask(TaskPriority::Internal, [&delay]() { delay.GetValue(); });
+  for (int i = 0; i < 10; i++)
+    runner.PostTask(TaskPriority::Internal, [&count]() { count++; });
+  delay.SignalAll();
+  runner.WaitUntilFinished();
+  EXPECT_EQ(kTaskCount + 10, count);
+  EXPECT_EQ(11u, runner.task_allocation_count());
+
+  // Large callbacks aren't pooled.
+  std::array<char, 1024> large{};
+  runner.PostTask(TaskPriority::Internal,
+                  [large, &count]() { count += large[0] + 1; });
+  runner.WaitUntilFinished();
+  EXPECT_EQ(12u, runner.task_allocation_count());
+}
+
+TEST(TaskRunnerTest, ManualRunsTasksOnCallingThread) {
+  NiceMock<MockClock> clock;
+  ON_CALL(clock, GetMonotonicTime()).WillByDefault(Return(0));
+
+  int wrapper_count = 0;
+  TaskRunner runner(
+      [&](TaskRunner::RunLoop loop) {
+        wrapper_count++;
+        loop();
+      },
+      &clock, true, /* is_manual */ true);
+  EXPECT_TRUE(runner.BelongsToCurrentThread());
+
+  std::vector<int> calls;
+  runner.PostTask(TaskPriority::Internal, [&]() { calls.push_back(1); });
+  runner.PostTask(TaskPriority::Immediate, [&]() { calls.push_back(2); });
+  runner.AddTimer(10, [&]() { calls.push_back(3); });
+  // Nothing runs until the tasks are pumped.
+  EXPECT_TRUE(calls.empty());
+
+  EXPECT_EQ(10u, runner.RunUntilIdle(100));
+  EXPECT_EQ((std::vector<int>{2, 1}), calls);
+  EXPECT_EQ(1, wrapper_count);
+
+  ON_CALL(clock, GetMonotonicTime()).WillByDefault(Return(10));
+  EXPECT_EQ(std::numeric_limits<uint64_t>::max(), runner.RunUntilIdle(100));
+  EXPECT_EQ((std::vector<int>{2, 1, 3}), calls);
+  EXPECT_FALSE(runner.HasPendingWork());
+}
+
+TEST(TaskRunnerTest, ManualStopsAtDeadline) {
+  NiceMock<MockClock> clock;
+  ON_CALL(clock, GetMonotonicTime()).WillByDefault(Return(0));
+
+  TaskRunner runner([](TaskRunner::RunLoop loop) { loop(); }, &clock, true,
+                    /* is_manual */ true);
+  int count = 0;
+  runner.PostTask(TaskPriority::Internal, [&]() {
+    count++;
+    ON_CALL(clock, GetMonotonicTime()).WillByDefault(Return(50));
+  });
+  runner.PostTask(TaskPriority::Internal, [&]() { count++; });
+
+  EXPECT_EQ(0u, runner.RunUntilIdle(50));
+  EXPECT_EQ(1, count);
+  runner.WaitUntilFinished();
+  EXPECT_EQ(2, count);
+}
+
+TEST(TaskRunnerTest, ManualInvokesSynchronously) {
+  NiceMock<MockClock> clock;
+  ON_CALL(clock, GetMonotonicTime()).WillByDefault(Return(0));
+
+  TaskRunner runner([](TaskRunner::RunLoop loop) { loop(); }, &clock, true,
+                    /* is_manual */ true);
+  auto future = runner.InvokeOrSchedule([]() { return 5; });
+  ASSERT_EQ(std::future_status::ready,
+            future.wait_for(std::chrono::seconds(0)));
+  EXPECT_EQ(5, future.get());
+}
+
+TEST(TaskRunnerTest, CallsIdleHandlerWhenIdle) {
+  NiceMock<MockClock> clock;
+  ON_CALL(clock, GetMonotonicTime()).WillByDefault(Return(0));
+
+  std::atomic<int> idle_calls{0};
+  std::atomic<uint64_t> idle_ms{0};
+  ThreadEvent<void> idle("");
+  {
+    TaskRunner runner([](TaskRunner::RunLoop loop) { loop(); }, &clock, true);
+    runner.AddInternalTask(TaskPriority::Internal, "", [&]() {
+      runner.SetIdleHandler([&](uint64_t ms) {
+        idle_ms = ms;
+        idle_calls++;
+        idle.SignalAllIfNotSet();
+        // There is no more work, so this shouldn't be called again.
+        return false;
+      });
+    });
+    idle.GetValue();
+    runner.Stop();
+  }
+
+  EXPECT_EQ(1, idle_calls.load());
+  EXPECT_EQ(TaskRunner::kMaxIdleMs, idle_ms.load());
+}
+
+TEST(TaskRunnerTest, RecordsTaskStats) {
+  NiceMock<MockClock> clock;
+  ON_CALL(clock, GetMonotonicTime()).WillByDefault(Return(0));
+
+  TaskRunner runner([](TaskRunner::RunLoop loop) { loop(); }, &clock, true,
+                    /* is_manual */ true);
+  // Every task is a long task.
+  runner.SetLongTaskThreshold(0);
+  runner.AddInternalTask(TaskPriority::Internal, "Parse", []() {});
+  runner.AddInternalTask(TaskPriority::Internal, "Parse", []() {});
+  runner.PostTask(TaskPriority::Events, []() {});
+  ON_CALL(clock, GetMonotonicTime()).WillByDefault(Return(3));
+  runner.RunUntilIdle(100);
+
+  const JsManager::EventLoopStats stats = runner.GetStats();
+  EXPECT_EQ(2u, stats.internal_wait.count);
+  EXPECT_EQ(3000u, stats.internal_wait.max_us);
+  EXPECT_EQ(1u, stats.event_wait.count);
+  EXPECT_EQ(0u, stats.timer_delay.count);
+  EXPECT_EQ(3u, stats.task_duration.count);
+
+  EXPECT_EQ(3u, stats.long_task_count);
+  ASSERT_EQ(3u, stats.recent_long_tasks.size());
+  // Events run first since they have a higher priority.
+  EXPECT_EQ("(Events)", stats.recent_long_tasks[0].name);
+  EXPECT_EQ("Parse", stats.recent_long_tasks[1].name);
+
+  // Only named tasks are grouped by name.
+  ASSERT_EQ(1u, stats.named_tasks.size());
+  EXPECT_EQ("Parse", stats.named_tasks[0].name);
+  EXPECT_EQ(2u, stats.named_tasks[0].count);
+}
+
+TEST(TaskRunnerTest, SlicedTasksYieldToOtherTasks) {
+  NiceMock<MockClock> clock;
+  uint64_t time = 0;
+  ON_CALL(clock, GetMonotonicTime()).WillByDefault(ReturnPointee(&time));
+
+  TaskRunner runner([](TaskRunner::RunLoop loop) { loop(); }, &clock, true,
+                    /* is_manual */ true);
+  std::vector<std::string> calls;
+  int steps = 0;
+  runner.PostSlicedTask(TaskPriority::Internal, [&]() {
+    calls.push_back("step");
+    if (steps++ == 0) {
+      // Another task is waiting and this step took a full time slice.
+      runner.PostTask(TaskPriority::Internal,
+                      [&]() { calls.push_back("other"); });
+      time += 10;
+    }
+    return steps < 3;
+  });
+  runner.RunUntilIdle(1000);
+
+  EXPECT_EQ((std::vector<std::string>{"step", "other", "step", "step"}),
+            calls);
+}
+
+TEST(TaskRunnerTest, SlicedTasksDontYieldWithoutOtherTasks) {
+  NiceMock<MockClock> clock;
+  uint64_t time = 0;
+  ON_CALL(clock, GetMonotonicTime()).WillByDefault(ReturnPointee(&time));
+
+  TaskRunner runner([](TaskRunner::RunLoop loop) { loop(); }, &clock, true,
+                    /* is_manual */ true);
+  int steps = 0;
+  runner.PostSlicedTask(TaskPriority::Internal, [&]() {
+    time += 10;
+    return ++steps < 3;
+  });
+  runner.RunUntilIdle(1000);
+
+  EXPECT_EQ(3, steps);
+  // It all ran as one task.
+  EXPECT_EQ(1u, runner.GetStats().task_duration.count);
+}
+
+// This is a micro-benchmark of the cost to dispatch tasks with a given number
+// of other pending timers.  This is disabled by default; run with
+// --gtest_also_run_disabled_tests to see the results.
+TEST(TaskRunnerTest, DISABLED_DispatchBenchmark) {
+  using std::chrono::duration_cast;
+  using std::chrono::nanoseconds;
+  using std::chrono::steady_clock;
+  constexpr const int kDispatchCount = 10000;
+
+  for (int pending : {10, 1000, 100000}) {
+    ThreadEvent<void> delay("");
+    TaskRunner runner(
+        [&](TaskRunner::RunLoop loop) {
+          delay.GetValue();
+          loop();
+        },
+        &util::Clock::Instance, true);
+    // These will never fire, but will stay pending while we dispatch.
+    for (int i = 0; i < pending; i++)
+      runner.AddRepeatedTimer(3600 * 1000 + i, []() {});
+
+    int count = 0;
+    for (int i = 0; i < kDispatchCount; i++)
+      runner.AddTimer(0, [&count]() { count++; });
+
+    const auto start = steady_clock::now();
+    delay.SignalAll();
+    runner.WaitUntilFinished();
+    const auto ns = duration_cast<nanoseconds>(steady_clock::now() - start);
+    EXPECT_EQ(kDispatchCount, count);
+
+    LOG(INFO) << "Dispatch with " << pending << " pending timers: "
+              << (ns.count() / kDispatchCount) << " ns per task";
+  }
+}
+
 }  // namespace shaka
@@ -0,0 +1,162 @@
+// Copyright 2020 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     https://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "src/core/tls_session_cache.h"
+
+#include <glog/logging.h>
+#include <gtest/gtest.h>
+#include <sys/stat.h>
+#include <time.h>
+
+#include <string>
+#include <vector>
+
+#include "src/test/temp_dir_test.h"
+#include "src/util/file_system.h"
+
+namespace shaka {
+
+namespace {
+
+uint64_t InOneHour() {
+  return static_cast<uint64_t>(time(nullptr)) + 3600;
+}
+
+}  // namespace
+
+class TlsSessionCacheTest : public TempDirTest {
+ public:
+  void SetUp() override {
+    TempDirTest::SetUp();
+    path_ = util::FileSystem::PathJoin(temp_dir_, "sessions");
+  }
+
+ protected:
+  std::string path_;
+};
+
+TEST_F(TlsSessionCacheTest, StoresSessions) {
+  TlsSessionCache cache;
+  const std::vector<uint8_t> session = {1, 2, 3};
+  cache.Put("example.com", session, InOneHour());
+
+  std::vector<uint8_t> found;
+  ASSERT_TRUE(cache.Get("example.com", &found));
+  EXPECT_EQ(session, found);
+  EXPECT_FALSE(cache.Get("example.org", &found));
+}
+
+TEST_F(TlsSessionCacheTest, IgnoresExpiredSessions) {
+  TlsSessionCache cache;
+  cache.Put("example.com", {1, 2, 3}, static_cast<uint64_t>(time(nullptr)));
+
+  std::vector<uint8_t> found;
+  EXPECT_FALSE(cache.Get("example.com", &found));
+}
+
+TEST_F(TlsSessionCacheTest, EvictsSessionThatExpiresFirst) {
+  TlsSessionCache cache;
+  const uint64_t expiration = InOneHour();
+  cache.Put("first.com", {1}, expiration);
+  for (size_t i = 1; i < TlsSessionCache::kMaxEntries; i++)
+    cache.Put("host" + std::to_string(i), {2}, expiration + i);
+
+  std::vector<uint8_t> found;
+  EXPECT_TRUE(cache.Get("first.com", &found));
+  cache.Put("last.com", {3}, expiration + 1000);
+  EXPECT_FALSE(cache.Get("first.com", &found));
+  EXPECT_TRUE(cache.Get("host1", &found));
+  EXPECT_TRUE(cache.Get("last.com", &found));
+}
+
+TEST_F(TlsSessionCacheTest, PersistsSessions) {
+  const std::vector<uint8_t> session = {0, 0xab, 0xff, 7};
+  {
+    TlsSessionCache cache;
+    cache.SetPersistent(true);
+    cache.SetFile(path_);
+    cache.Put("example.com", session, InOneHour());
+  }
+
+  // The sessions can resume a connection, so only the app can read them.
+  struct stat info;
+  ASSERT_EQ(stat(path_.c_str(), &info), 0);
+  EXPECT_EQ(info.st_mode & 0777, 0600u);
+
+  TlsSessionCache cache;
+  cache.SetFile(path_);
+  cache.SetPersistent(true);
+  std::vector<uint8_t> found;
+  ASSERT_TRUE(cache.Get("example.com", &found));
+  EXPECT_EQ(session, found);
+}
+
+TEST_F(TlsSessionCacheTest, DoesNotPersistByDefault) {
+  {
+    TlsSessionCache cache;
+    cache.SetPersistent(true);
+    cache.SetFile(path_);
+    cache.Put("example.com", {1, 2, 3}, InOneHour());
+  }
+  ASSERT_TRUE(fs_.FileExists(path_));
+
+  // The stored sessions aren't used, and are deleted with the next session.
+  TlsSessionCache cache;
+  cache.SetFile(path_);
+  std::vector<uint8_t> found;
+  EXPECT_FALSE(cache.Get("example.com", &found));
+
+  cache.Put("other.com", {4, 5, 6}, InOneHour());
+  EXPECT_TRUE(cache.Get("other.com", &found));
+  EXPECT_FALSE(fs_.FileExists(path_));
+}
+
+TEST_F(TlsSessionCacheTest, TogglesPersistence) {
+  const std::vector<uint8_t> session = {1, 2, 3};
+  TlsSessionCache cache;
+  cache.SetFile(path_);
+  cache.Put("example.com", session, InOneHour());
+
+  // Enabling persistence saves the sessions from this run.
+  cache.SetPersistent(true);
+  ASSERT_TRUE(fs_.FileExists(path_));
+  {
+    TlsSessionCache other;
+    other.SetPersistent(true);
+    other.SetFile(path_);
+    std::vector<uint8_t> found;
+    ASSERT_TRUE(other.Get("example.com", &found));
+    EXPECT_EQ(session, found);
+  }
+
+  // Disabling it deletes the file but keeps the sessions in memory.
+  cache.SetPersistent(false);
+  EXPECT_FALSE(fs_.FileExists(path_));
+  std::vector<uint8_t> found;
+  EXPECT_TRUE(cache.Get("example.com", &found));
+}
+
+TEST_F(TlsSessionCacheTest, IgnoresInvalidFiles) {
+  const std::string data = "not a cache\n1\texample.com\t00\n";
+  ASSERT_TRUE(
+      fs_.WriteFile(path_, std::vector<uint8_t>(data.begin(), data.end())));
+
+  TlsSessionCache cache;
+  cache.SetPersistent(true);
+  cache.SetFile(path_);
+  std::vector<uint8_t> found;
+  EXPECT_FALSE(cache.Get("example.com", &found));
+}
+
+}  // namespace shaka
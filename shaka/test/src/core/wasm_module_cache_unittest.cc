@@ -0,0 +1,104 @@
+// Copyright 2020 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     https://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "src/core/wasm_module_cache.h"
+
+#include <glog/logging.h>
+#include <gtest/gtest.h>
+
+#include <string>
+#include <vector>
+
+#include "src/test/temp_dir_test.h"
+#include "src/util/file_system.h"
+
+namespace shaka {
+
+namespace {
+
+const std::vector<uint8_t> kModule = {0x00, 0x61, 0x73, 0x6d,
+                                      0x01, 0x00, 0x00, 0x00};
+const std::vector<uint8_t> kCompiled = {1, 2, 3, 4, 5, 6};
+
+}  // namespace
+
+class WasmModuleCacheTest : public TempDirTest {
+ public:
+  void SetUp() override {
+    TempDirTest::SetUp();
+    dir_ = util::FileSystem::PathJoin(temp_dir_, "wasm");
+  }
+
+ protected:
+  std::string dir_;
+};
+
+TEST_F(WasmModuleCacheTest, KeysByContents) {
+  const std::string key =
+      WasmModuleCache::MakeKey(kModule.data(), kModule.size());
+  EXPECT_EQ(key, WasmModuleCache::MakeKey(kModule.data(), kModule.size()));
+  EXPECT_NE(key, WasmModuleCache::MakeKey(kModule.data(), kModule.size() - 1));
+}
+
+TEST_F(WasmModuleCacheTest, StoresModules) {
+  const std::string key =
+      WasmModuleCache::MakeKey(kModule.data(), kModule.size());
+  {
+    WasmModuleCache cache;
+    cache.SetDirectory(dir_);
+    EXPECT_TRUE(fs_.DirectoryExists(dir_));
+
+    std::vector<uint8_t> compiled;
+    EXPECT_FALSE(cache.Read(key, &compiled));
+    cache.Write(key, kCompiled.data(), kCompiled.size());
+    ASSERT_TRUE(cache.Read(key, &compiled));
+    EXPECT_EQ(compiled, kCompiled);
+    EXPECT_EQ(cache.hit_count(), 1u);
+    EXPECT_EQ(cache.miss_count(), 1u);
+  }
+
+  // The next launch finds the module.
+  WasmModuleCache cache;
+  cache.SetDirectory(dir_);
+  std::vector<uint8_t> compiled;
+  ASSERT_TRUE(cache.Read(key, &compiled));
+  EXPECT_EQ(compiled, kCompiled);
+}
+
+TEST_F(WasmModuleCacheTest, RemovesModules) {
+  const std::string key =
+      WasmModuleCache::MakeKey(kModule.data(), kModule.size());
+  WasmModuleCache cache;
+  cache.SetDirectory(dir_);
+  cache.Write(key, kCompiled.data(), kCompiled.size());
+  cache.Remove(key);
+
+  std::vector<uint8_t> compiled;
+  EXPECT_FALSE(cache.Read(key, &compiled));
+  std::vector<std::string> files;
+  ASSERT_TRUE(fs_.ListFiles(dir_, &files));
+  EXPECT_TRUE(files.empty());
+}
+
+TEST_F(WasmModuleCacheTest, IgnoresWritesWithoutDirectory) {
+  const std::string key =
+      WasmModuleCache::MakeKey(kModule.data(), kModule.size());
+  WasmModuleCache cache;
+  cache.Write(key, kCompiled.data(), kCompiled.size());
+
+  std::vector<uint8_t> compiled;
+  EXPECT_FALSE(cache.Read(key, &compiled));
+}
+
+}  // namespace shaka
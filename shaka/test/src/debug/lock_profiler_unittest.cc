@@ -0,0 +1,103 @@
+// Copyright 2020 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     https://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "src/debug/lock_profiler.h"
+
+#include <gtest/gtest.h>
+
+#include <mutex>
+#include <thread>
+
+#include "src/debug/mutex.h"
+#include "src/debug/thread_event.h"
+
+namespace shaka {
+
+class LockProfilerTest : public testing::Test {
+ public:
+  void SetUp() override {
+    LockProfiler::Reset();
+    LockProfiler::SetEnabled(true);
+  }
+
+  void TearDown() override {
+    LockProfiler::SetEnabled(false);
+    LockProfiler::Reset();
+  }
+};
+
+TEST_F(LockProfilerTest, BucketsDurations) {
+  LockProfiler::Histogram histogram;
+  histogram.Add(0);
+  histogram.Add(1);
+  histogram.Add(3);
+  histogram.Add(1000);
+  histogram.Add(1ull << 40);
+
+  EXPECT_EQ(5u, histogram.count);
+  EXPECT_EQ(1004u + (1ull << 40), histogram.total_us);
+  EXPECT_EQ(1ull << 40, histogram.max_us);
+  EXPECT_EQ(1u, histogram.buckets[0]);
+  EXPECT_EQ(1u, histogram.buckets[1]);
+  EXPECT_EQ(1u, histogram.buckets[2]);
+  EXPECT_EQ(1u, histogram.buckets[10]);
+  EXPECT_EQ(1u, histogram.buckets[LockProfiler::kBucketCount - 1]);
+}
+
+TEST_F(LockProfilerTest, SharesEntriesByName) {
+  auto* first = LockProfiler::GetEntry(LockProfiler::Kind::Lock, "Foo");
+  EXPECT_EQ(first, LockProfiler::GetEntry(LockProfiler::Kind::Lock, "Foo"));
+  EXPECT_NE(first, LockProfiler::GetEntry(LockProfiler::Kind::Event, "Foo"));
+  EXPECT_NE(first, LockProfiler::GetEntry(LockProfiler::Kind::Lock, "Bar"));
+}
+
+TEST_F(LockProfilerTest, RecordsLocks) {
+  auto* entry = LockProfiler::GetEntry(LockProfiler::Kind::Lock,
+                                       "LockProfilerTest.RecordsLocks");
+  Mutex first("LockProfilerTest.RecordsLocks");
+  Mutex second("LockProfilerTest.RecordsLocks");
+  { std::unique_lock<Mutex> lock(first); }
+  {
+    std::unique_lock<Mutex> lock(second);
+    std::this_thread::sleep_for(std::chrono::milliseconds(2));
+  }
+  EXPECT_EQ(2u, entry->wait.count);
+  EXPECT_EQ(2u, entry->hold.count);
+  EXPECT_GE(entry->hold.max_us, 2000u);
+
+  LockProfiler::SetEnabled(false);
+  { std::unique_lock<Mutex> lock(first); }
+  EXPECT_EQ(2u, entry->wait.count);
+  EXPECT_EQ(2u, entry->hold.count);
+}
+
+TEST_F(LockProfilerTest, RecordsEvents) {
+  auto* entry = LockProfiler::GetEntry(LockProfiler::Kind::Event,
+                                       "LockProfilerTest.RecordsEvents");
+  ThreadEvent<void> event("LockProfilerTest.RecordsEvents");
+  std::thread thread([&]() {
+    std::this_thread::sleep_for(std::chrono::milliseconds(2));
+    event.SignalAll();
+  });
+  event.GetValue();
+  thread.join();
+
+  EXPECT_EQ(1u, entry->wait.count);
+  EXPECT_GE(entry->wait.max_us, 1000u);
+  EXPECT_EQ(0u, entry->hold.count);
+  EXPECT_NE(std::string::npos,
+            LockProfiler::Dump().find("LockProfilerTest.RecordsEvents"));
+}
+
+}  // namespace shaka
@@ -0,0 +1,92 @@
+// Copyright 2020 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     https://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "src/debug/startup_tracer.h"
+
+#include <gmock/gmock.h>
+#include <gtest/gtest.h>
+
+namespace shaka {
+
+namespace {
+
+using testing::Return;
+
+class MockClock : public util::Clock {
+ public:
+  MOCK_CONST_METHOD0(GetMonotonicTime, uint64_t());
+};
+
+}  // namespace
+
+TEST(StartupTracerTest, RecordsEventsInStartOrder) {
+  MockClock clock;
+  StartupTracer tracer(&clock);
+
+  EXPECT_CALL(clock, GetMonotonicTime()).WillOnce(Return(100));
+  const uint64_t start = tracer.Now();
+  EXPECT_CALL(clock, GetMonotonicTime()).WillOnce(Return(120));
+  tracer.AddMilestone("Inner");
+  EXPECT_CALL(clock, GetMonotonicTime()).WillOnce(Return(150));
+  tracer.AddSpan("Outer", start);
+
+  auto events = tracer.GetEvents();
+  ASSERT_EQ(2u, events.size());
+  EXPECT_EQ("Outer", events[0].name);
+  EXPECT_EQ(100u, events[0].start_ms);
+  EXPECT_EQ(50u, events[0].duration_ms);
+  EXPECT_EQ("Inner", events[1].name);
+  EXPECT_EQ(120u, events[1].start_ms);
+  EXPECT_EQ(0u, events[1].duration_ms);
+}
+
+TEST(StartupTracerTest, RecordsFirstMilestoneOnce) {
+  MockClock clock;
+  StartupTracer tracer(&clock);
+
+  EXPECT_CALL(clock, GetMonotonicTime())
+      .WillOnce(Return(10))
+      .WillOnce(Return(20))
+      .WillOnce(Return(30));
+  tracer.AddFirstMilestone("First");
+  tracer.AddFirstMilestone("First");
+  tracer.Reset();
+  tracer.AddFirstMilestone("First");
+
+  auto events = tracer.GetEvents();
+  ASSERT_EQ(1u, events.size());
+  EXPECT_EQ(30u, events[0].start_ms);
+}
+
+TEST(StartupTracerTest, CreatesChromeTraceJson) {
+  MockClock clock;
+  StartupTracer tracer(&clock);
+
+  EXPECT_CALL(clock, GetMonotonicTime())
+      .WillOnce(Return(2))
+      .WillOnce(Return(5));
+  tracer.AddMilestone("A \"quoted\" name");
+  tracer.AddSpan("Span", 1);
+
+  EXPECT_EQ(
+      "{\"traceEvents\":["
+      "{\"name\":\"Span\",\"cat\":\"startup\",\"pid\":0,\"tid\":0,"
+      "\"ts\":1000,\"ph\":\"X\",\"dur\":4000},"
+      "{\"name\":\"A \\\"quoted\\\" name\",\"cat\":\"startup\",\"pid\":0,"
+      "\"tid\":0,\"ts\":2000,\"ph\":\"i\",\"s\":\"g\"}"
+      "],\"displayTimeUnit\":\"ms\"}",
+      tracer.GetChromeTraceJson());
+}
+
+}  // namespace shaka
@@ -0,0 +1,133 @@
+// Copyright 2020 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     https://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "src/debug/telemetry.h"
+
+#include <gtest/gtest.h>
+
+#include <chrono>
+#include <mutex>
+#include <thread>
+
+#include "src/debug/thread.h"
+#include "src/debug/thread_event.h"
+
+namespace shaka {
+
+namespace {
+
+const PipelineTelemetry::Thread* FindThread(
+    const std::vector<PipelineTelemetry::Thread>& threads,
+    const std::string& name) {
+  for (auto& thread : threads) {
+    if (thread.name == name)
+      return &thread;
+  }
+  return nullptr;
+}
+
+}  // namespace
+
+class TelemetryTest : public testing::Test {
+ public:
+  void SetUp() override {
+    Telemetry::Reset();
+  }
+
+  void TearDown() override {
+    Telemetry::Reset();
+  }
+};
+
+TEST_F(TelemetryTest, TracksThreads) {
+  std::mutex mutex;
+  ThreadEvent<void> event("TelemetryTest");
+  ThreadEvent<void> done("TelemetryTest done");
+  Thread thread("TelemetryTest", [&]() {
+    // Use some CPU time so it shows up.
+    const auto end =
+        std::chrono::steady_clock::now() + std::chrono::milliseconds(5);
+    while (std::chrono::steady_clock::now() < end) {
+    }
+    Telemetry::OnQueueLatency(100);
+
+    std::unique_lock<std::mutex> lock(mutex);
+    done.SignalAll();
+    event.ResetAndWaitWhileUnlocked(lock);
+  });
+
+  done.GetValue();
+  {
+    std::unique_lock<std::mutex> lock(mutex);
+    event.SignalAll();
+  }
+  thread.join();
+
+  auto* info = FindThread(Telemetry::GetThreads(), "TelemetryTest");
+  ASSERT_TRUE(info);
+  EXPECT_GT(info->cpu_seconds, 0.001);
+  EXPECT_EQ(1u, info->wakeups);
+  EXPECT_EQ(1u, info->queue_latency.count);
+  EXPECT_EQ(100u, info->queue_latency.max_us);
+  EXPECT_EQ(info->queue_latency.buckets.size(),
+            static_cast<size_t>(DurationHistogram::kBucketCount));
+}
+
+TEST_F(TelemetryTest, RemovesDestroyedThreads) {
+  {
+    Thread thread("TelemetryTest", []() {});
+    thread.join();
+    EXPECT_TRUE(FindThread(Telemetry::GetThreads(), "TelemetryTest"));
+  }
+  EXPECT_FALSE(FindThread(Telemetry::GetThreads(), "TelemetryTest"));
+}
+
+TEST_F(TelemetryTest, IgnoresUnknownThreads) {
+  std::thread thread([]() {
+    Telemetry::OnWakeup();
+    Telemetry::OnQueueLatency(100);
+  });
+  thread.join();
+
+  for (auto& info : Telemetry::GetThreads())
+    EXPECT_EQ(0u, info.wakeups) << info.name;
+}
+
+TEST_F(TelemetryTest, TracksStreams) {
+  EXPECT_TRUE(Telemetry::GetStreams().empty());
+
+  Telemetry::StreamEntry* video = Telemetry::GetStream(/* is_video= */ true);
+  video->frames_demuxed += 10;
+  video->frames_decoded += 8;
+  video->frames_dropped += 1;
+  video->frames_skipped += 3;
+  video->decode_latency.Add(1000);
+  video->decode_latency.Add(3000);
+
+  auto streams = Telemetry::GetStreams();
+  ASSERT_EQ(1u, streams.size());
+  EXPECT_EQ("video", streams[0].name);
+  EXPECT_EQ(10u, streams[0].frames_demuxed);
+  EXPECT_EQ(8u, streams[0].frames_decoded);
+  EXPECT_EQ(1u, streams[0].frames_dropped);
+  EXPECT_EQ(3u, streams[0].frames_skipped);
+  EXPECT_EQ(2u, streams[0].decode_latency.count);
+  EXPECT_EQ(2000, streams[0].decode_latency.average_us);
+  EXPECT_EQ(3000u, streams[0].decode_latency.max_us);
+
+  Telemetry::Reset();
+  EXPECT_TRUE(Telemetry::GetStreams().empty());
+}
+
+}  // namespace shaka
@@ -0,0 +1,97 @@
+// Copyright 2020 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     https://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "src/debug/trace_event.h"
+
+#include <gtest/gtest.h>
+
+#include <string>
+
+namespace shaka {
+
+namespace {
+
+size_t CountOccurrences(const std::string& str, const std::string& find) {
+  size_t count = 0;
+  for (size_t pos = str.find(find); pos != std::string::npos;
+       pos = str.find(find, pos + 1)) {
+    count++;
+  }
+  return count;
+}
+
+}  // namespace
+
+class TraceEventTest : public testing::Test {
+ public:
+  void SetUp() override {
+    TraceRecorder::Reset();
+    TraceRecorder::SetEnabled(true);
+  }
+
+  void TearDown() override {
+    TraceRecorder::SetEnabled(false);
+    TraceRecorder::Reset();
+  }
+};
+
+TEST_F(TraceEventTest, RecordsScopedEvents) {
+  { ScopedTraceEvent event("test", "Outer"); }
+
+  const std::string json = TraceRecorder::GetChromeTraceJson();
+  EXPECT_EQ(0u, json.find("{\"traceEvents\":["));
+  EXPECT_NE(std::string::npos,
+            json.find("{\"cat\":\"test\",\"name\":\"Outer\",\"ph\":\"X\""));
+  EXPECT_NE(std::string::npos, json.find("\"name\":\"thread_name\""));
+}
+
+TEST_F(TraceEventTest, RecordsFlowEvents) {
+  int frame;
+  TraceRecorder::AddEvent("frame", "frame", TraceRecorder::Phase::FlowBegin,
+                          10, 0, TraceRecorder::FrameId(&frame));
+  TraceRecorder::AddEvent("frame", "frame", TraceRecorder::Phase::FlowEnd, 20,
+                          0, TraceRecorder::FrameId(&frame));
+
+  const std::string json = TraceRecorder::GetChromeTraceJson();
+  const std::string id = std::to_string(TraceRecorder::FrameId(&frame));
+  EXPECT_NE(std::string::npos, json.find("\"ph\":\"s\""));
+  EXPECT_NE(std::string::npos,
+            json.find("\"ts\":10,\"bp\":\"e\",\"id\":" + id));
+  EXPECT_NE(std::string::npos, json.find("\"ph\":\"f\""));
+  EXPECT_NE(std::string::npos,
+            json.find("\"ts\":20,\"bp\":\"e\",\"id\":" + id));
+}
+
+TEST_F(TraceEventTest, IgnoresEventsWhileDisabled) {
+  TraceRecorder::SetEnabled(false);
+  { ScopedTraceEvent event("test", "Ignored"); }
+  EXPECT_EQ(std::string::npos,
+            TraceRecorder::GetChromeTraceJson().find("Ignored"));
+}
+
+TEST_F(TraceEventTest, KeepsMostRecentEvents) {
+  TraceRecorder::AddEvent("test", "First", TraceRecorder::Phase::Complete, 0,
+                          1, 0);
+  for (size_t i = 0; i < TraceRecorder::kMaxEvents; i++) {
+    TraceRecorder::AddEvent("test", "Other", TraceRecorder::Phase::Complete,
+                            i + 1, 1, 0);
+  }
+
+  const std::string json = TraceRecorder::GetChromeTraceJson();
+  EXPECT_EQ(std::string::npos, json.find("First"));
+  EXPECT_EQ(static_cast<size_t>(TraceRecorder::kMaxEvents),
+            CountOccurrences(json, "Other"));
+}
+
+}  // namespace shaka
@@ -14,9 +14,14 @@
 
 #include "src/eme/clearkey_implementation.h"
 
+#include <glog/logging.h>
 #include <gmock/gmock.h>
 #include <gtest/gtest.h>
 
+#include <atomic>
+#include <chrono>
+#include <thread>
+
 #include "src/mapping/byte_buffer.h"
 #include "src/public/eme_promise_impl.h"
 
@@ -63,6 +68,7 @@ using ::testing::_;
 using ::testing::InSequence;
 using ::testing::MockFunction;
 using ::testing::NiceMock;
+using ::testing::Return;
 using ::testing::StrictMock;
 
 // There are more tests in JavaScript: //shaka/test/tests/eme.js.
@@ -169,6 +175,152 @@ TEST_F(ClearKeyImplementationTest, Decrypt_KeyNotFound) {
       DecryptStatus::KeyNotFound);
 }
 
+TEST_F(ClearKeyImplementationTest, RegistersExtensions) {
+  NiceMock<MockImplementationHelper> helper;
+  std::unique_ptr<ClearKeyImplementation> clear_key(
+      new ClearKeyImplementation(&helper));
+  const Implementation* implementation = clear_key.get();
+  EXPECT_EQ(static_cast<const ImplementationExtensions*>(clear_key.get()),
+            ImplementationExtensions::Get(implementation));
+
+  clear_key.reset();
+  EXPECT_EQ(nullptr, ImplementationExtensions::Get(implementation));
+}
+
+TEST_F(ClearKeyImplementationTest, PrefetchLicenseLoadsKeyCacheOnce) {
+  StrictMock<MockImplementationHelper> helper;
+  EXPECT_CALL(helper, DataPathPrefix()).WillOnce(Return(""));
+
+  ClearKeyImplementation clear_key(&helper);
+  const ImplementationExtensions* extensions = &clear_key;
+  extensions->PrefetchLicense(MediaKeyInitDataType::Cenc, kKeyId,
+                              sizeof(kKeyId));
+  extensions->PrefetchLicense(MediaKeyInitDataType::Cenc, kKeyId,
+                              sizeof(kKeyId));
+}
+
+TEST_F(ClearKeyImplementationTest, DecryptSamples) {
+  NiceMock<MockImplementationHelper> helper;
+  ClearKeyImplementation clear_key(&helper);
+  LoadKeyForTesting(&clear_key, MakeVector(kKeyId), MakeVector(kKey));
+
+  std::unique_ptr<FrameEncryptionInfo> info(new FrameEncryptionInfo(
+      EncryptionScheme::AesCtr, MakeVector(kKeyId), MakeVector(kIv)));
+  std::unique_ptr<FrameEncryptionInfo> missing_info(new FrameEncryptionInfo(
+      EncryptionScheme::AesCtr, std::vector<uint8_t>(16, 0), MakeVector(kIv)));
+  std::vector<uint8_t> first = MakeVector(kEncryptedData);
+  std::vector<uint8_t> missing = MakeVector(kEncryptedData);
+  std::vector<uint8_t> second = MakeVector(kEncryptedData);
+  DecryptSample samples[] = {
+      {info.get(), first.data(), first.size(), first.data(),
+       DecryptStatus::OtherError},
+      {missing_info.get(), missing.data(), missing.size(), missing.data(),
+       DecryptStatus::OtherError},
+      {info.get(), second.data(), second.size(), second.data(),
+       DecryptStatus::OtherError},
+  };
+  clear_key.DecryptSamples(samples, 3);
+
+  // A missing key only affects that sample.
+  EXPECT_EQ(samples[0].status, DecryptStatus::Success);
+  EXPECT_EQ(samples[1].status, DecryptStatus::KeyNotFound);
+  EXPECT_EQ(samples[2].status, DecryptStatus::Success);
+  EXPECT_EQ(first, MakeVector(kClearData));
+  EXPECT_EQ(missing, MakeVector(kEncryptedData));
+  EXPECT_EQ(second, MakeVector(kClearData));
+}
+
+TEST_F(ClearKeyImplementationTest, Decrypt_ChangesScheme) {
+  NiceMock<MockImplementationHelper> helper;
+  ClearKeyImplementation clear_key(&helper);
+  LoadKeyForTesting(&clear_key, MakeVector(kKeyId), MakeVector(kKey));
+
+  // The cached decryptor should be replaced when the scheme changes; CBC
+  // decryption of CTR data produces different output.
+  std::unique_ptr<FrameEncryptionInfo> ctr_info(new FrameEncryptionInfo(
+      EncryptionScheme::AesCtr, MakeVector(kKeyId), MakeVector(kIv)));
+  std::unique_ptr<FrameEncryptionInfo> cbc_info(new FrameEncryptionInfo(
+      EncryptionScheme::AesCbc, MakeVector(kKeyId), MakeVector(kIv)));
+  std::vector<uint8_t> data(kEncryptedData, kEncryptedData + AES_BLOCK_SIZE);
+  ASSERT_EQ(clear_key.Decrypt(cbc_info.get(), data.data(), data.size(),
+                              data.data()),
+            DecryptStatus::Success);
+  EXPECT_NE(data, MakeVector(kClearData, AES_BLOCK_SIZE));
+
+  data.assign(kEncryptedData, kEncryptedData + AES_BLOCK_SIZE);
+  ASSERT_EQ(clear_key.Decrypt(ctr_info.get(), data.data(), data.size(),
+                              data.data()),
+            DecryptStatus::Success);
+  EXPECT_EQ(data, MakeVector(kClearData, AES_BLOCK_SIZE));
+}
+
+TEST_F(ClearKeyImplementationTest, Decrypt_InParallel) {
+  NiceMock<MockImplementationHelper> helper;
+  ClearKeyImplementation clear_key(&helper);
+  LoadKeyForTesting(&clear_key, MakeVector(kKeyId), MakeVector(kKey));
+
+  // Each thread needs its own decryptor state, so decrypting the same key on
+  // several threads at once should give the same results.
+  std::unique_ptr<FrameEncryptionInfo> info(new FrameEncryptionInfo(
+      EncryptionScheme::AesCtr, MakeVector(kKeyId), MakeVector(kIv)));
+  std::atomic<int> failures{0};
+  auto decrypt = [&]() {
+    for (int i = 0; i < 1000; i++) {
+      std::vector<uint8_t> data = MakeVector(kEncryptedData);
+      if (clear_key.Decrypt(info.get(), data.data(), data.size(),
+                            data.data()) != DecryptStatus::Success ||
+          data != MakeVector(kClearData)) {
+        failures++;
+      }
+    }
+  };
+  std::thread first(decrypt);
+  std::thread second(decrypt);
+  first.join();
+  second.join();
+  EXPECT_EQ(0, failures.load());
+}
+
+// This measures decrypt throughput for audio-sized samples, where setting up
+// the cipher is a large part of the cost.  This is disabled by default; run
+// with --gtest_also_run_disabled_tests to see the results.
+TEST_F(ClearKeyImplementationTest, DISABLED_DecryptBenchmark) {
+  using std::chrono::duration_cast;
+  using std::chrono::microseconds;
+  using std::chrono::steady_clock;
+  constexpr const int kIterations = 10000;
+  constexpr const size_t kSampleSizes[] = {512, 4096, 65536};
+
+  NiceMock<MockImplementationHelper> helper;
+  ClearKeyImplementation clear_key(&helper);
+  LoadKeyForTesting(&clear_key, MakeVector(kKeyId), MakeVector(kKey));
+  std::unique_ptr<FrameEncryptionInfo> info(new FrameEncryptionInfo(
+      EncryptionScheme::AesCtr, MakeVector(kKeyId), MakeVector(kIv)));
+
+  for (size_t size : kSampleSizes) {
+    std::vector<uint8_t> data(size, 0x12);
+
+    auto start = steady_clock::now();
+    for (int i = 0; i < kIterations; i++) {
+      util::Decryptor decryptor(info->scheme, MakeVector(kKey), info->iv);
+      ASSERT_TRUE(decryptor.Decrypt(data.data(), data.size(), data.data()));
+    }
+    auto us = duration_cast<microseconds>(steady_clock::now() - start);
+    LOG(INFO) << "New decryptor, " << size << " byte samples: "
+              << (us.count() * 1000 / kIterations) << " ns per sample";
+
+    start = steady_clock::now();
+    for (int i = 0; i < kIterations; i++) {
+      ASSERT_EQ(clear_key.Decrypt(info.get(), data.data(), data.size(),
+                                  data.data()),
+                DecryptStatus::Success);
+    }
+    us = duration_cast<microseconds>(steady_clock::now() - start);
+    LOG(INFO) << "ClearKeyImplementation, " << size << " byte samples: "
+              << (us.count() * 1000 / kIterations) << " ns per sample";
+  }
+}
+
 TEST_F(ClearKeyImplementationTest, HandlesMissingSessionId) {
   StrictMock<MockImplementationHelper> helper;
   StrictMock<MockEmePromiseImpl> promise_impl;
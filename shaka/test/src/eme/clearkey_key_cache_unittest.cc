@@ -0,0 +1,135 @@
+// Copyright 2020 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     https://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "src/eme/clearkey_key_cache.h"
+
+#include <glog/logging.h>
+#include <gtest/gtest.h>
+#include <sys/stat.h>
+
+#include <string>
+#include <vector>
+
+#include "src/test/temp_dir_test.h"
+#include "src/util/file_system.h"
+
+namespace shaka {
+namespace eme {
+
+namespace {
+
+const std::vector<uint8_t> kKeyId1(16, 1);
+const std::vector<uint8_t> kKeyId2(16, 2);
+const std::vector<uint8_t> kKey1(16, 0xab);
+const std::vector<uint8_t> kKey2(16, 0xcd);
+
+}  // namespace
+
+class ClearKeyKeyCacheTest : public TempDirTest {
+ public:
+  void SetUp() override {
+    TempDirTest::SetUp();
+    dir_ = util::FileSystem::PathJoin(temp_dir_, "eme");
+  }
+
+ protected:
+  std::string dir_;
+};
+
+TEST_F(ClearKeyKeyCacheTest, StoresKeys) {
+  ClearKeyKeyCache cache;
+  std::vector<uint8_t> key;
+  EXPECT_FALSE(cache.Get(kKeyId1, &key));
+
+  cache.Put(kKeyId1, kKey1);
+  ASSERT_TRUE(cache.Get(kKeyId1, &key));
+  EXPECT_EQ(key, kKey1);
+  EXPECT_FALSE(cache.Get(kKeyId2, &key));
+
+  // Invalid keys are ignored.
+  cache.Put(kKeyId2, std::vector<uint8_t>(4));
+  EXPECT_FALSE(cache.Get(kKeyId2, &key));
+}
+
+TEST_F(ClearKeyKeyCacheTest, DropsOldestKeys) {
+  ClearKeyKeyCache cache;
+  for (size_t i = 0; i <= ClearKeyKeyCache::kMaxKeys; i++) {
+    std::vector<uint8_t> key_id(16, 0);
+    key_id[0] = static_cast<uint8_t>(i);
+    key_id[1] = static_cast<uint8_t>(i >> 8);
+    cache.Put(key_id, kKey1);
+  }
+
+  std::vector<uint8_t> key;
+  EXPECT_FALSE(cache.Get(std::vector<uint8_t>(16, 0), &key));
+  std::vector<uint8_t> key_id(16, 0);
+  key_id[0] = 1;
+  EXPECT_TRUE(cache.Get(key_id, &key));
+}
+
+TEST_F(ClearKeyKeyCacheTest, PersistsKeys) {
+  {
+    ClearKeyKeyCache cache;
+    cache.SetDirectory(dir_);
+    cache.Put(kKeyId1, kKey1);
+    cache.Put(kKeyId2, kKey2);
+    cache.Save();
+  }
+
+  // The keys are stored in the clear, so only the user can read them.
+  std::vector<std::string> files;
+  ASSERT_TRUE(fs_.ListFiles(dir_, &files));
+  ASSERT_FALSE(files.empty());
+  for (auto& file : files) {
+    struct stat info;
+    ASSERT_EQ(
+        stat(util::FileSystem::PathJoin(dir_, file).c_str(), &info), 0);
+    EXPECT_EQ(info.st_mode & 0777, 0600u) << file;
+  }
+
+  ClearKeyKeyCache cache;
+  cache.SetDirectory(dir_);
+  std::vector<uint8_t> key;
+  ASSERT_TRUE(cache.Get(kKeyId1, &key));
+  EXPECT_EQ(key, kKey1);
+  ASSERT_TRUE(cache.Get(kKeyId2, &key));
+  EXPECT_EQ(key, kKey2);
+}
+
+TEST_F(ClearKeyKeyCacheTest, IgnoresOldFiles) {
+  // Older versions obfuscated the keys with a key stored next to them.
+  ASSERT_TRUE(fs_.CreateDirectory(dir_));
+  const std::string secret_path =
+      util::FileSystem::PathJoin(dir_, "clearkey_keys.secret");
+  const std::string keys_path =
+      util::FileSystem::PathJoin(dir_, "clearkey_keys");
+  ASSERT_TRUE(fs_.WriteFile(secret_path, std::vector<uint8_t>(16, 7)));
+  ASSERT_TRUE(fs_.WriteFile(keys_path, std::vector<uint8_t>(64, 9)));
+  ASSERT_EQ(chmod(keys_path.c_str(), 0644), 0);
+
+  ClearKeyKeyCache cache;
+  cache.SetDirectory(dir_);
+  std::vector<uint8_t> key;
+  EXPECT_FALSE(cache.Get(std::vector<uint8_t>(16, 9), &key));
+
+  cache.Put(kKeyId1, kKey1);
+  cache.Save();
+  EXPECT_FALSE(fs_.FileExists(secret_path));
+  struct stat info;
+  ASSERT_EQ(stat(keys_path.c_str(), &info), 0);
+  EXPECT_EQ(info.st_mode & 0777, 0600u);
+}
+
+}  // namespace eme
+}  // namespace shaka
@@ -0,0 +1,121 @@
+// Copyright 2020 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     https://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "src/js/base_64.h"
+
+#include <gtest/gtest.h>
+
+#include <string>
+
+namespace shaka {
+namespace js {
+
+namespace {
+
+/** A simple implementation to compare the vectorized one against. */
+std::string ReferenceEncode(const ByteString& input) {
+  const char kCodes[] =
+      "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+  std::string ret;
+  for (size_t i = 0; i < input.size(); i += 3) {
+    uint32_t temp = input[i] << 16;
+    if (i + 1 < input.size())
+      temp |= input[i + 1] << 8;
+    if (i + 2 < input.size())
+      temp |= input[i + 2];
+    ret += kCodes[(temp >> 18) & 0x3f];
+    ret += kCodes[(temp >> 12) & 0x3f];
+    ret += i + 1 < input.size() ? kCodes[(temp >> 6) & 0x3f] : '=';
+    ret += i + 2 < input.size() ? kCodes[temp & 0x3f] : '=';
+  }
+  return ret;
+}
+
+ByteString MakeData(size_t size) {
+  ByteString ret(size);
+  uint32_t state = 12345;
+  for (auto& b : ret) {
+    state = state * 1103515245 + 12345;
+    b = static_cast<uint8_t>(state >> 16);
+  }
+  return ret;
+}
+
+}  // namespace
+
+TEST(Base64Test, Encode) {
+  EXPECT_EQ(Base64::Encode(ByteString("")), "");
+  EXPECT_EQ(Base64::Encode(ByteString("M")), "TQ==");
+  EXPECT_EQ(Base64::Encode(ByteString("Ma")), "TWE=");
+  EXPECT_EQ(Base64::Encode(ByteString("Man")), "TWFu");
+  EXPECT_EQ(Base64::Encode(ByteString("\xfb\xff\xbf")), "+/+/");
+  EXPECT_EQ(Base64::EncodeUrl(ByteString("\xfb\xff\xbf")), "-_-_");
+  EXPECT_EQ(Base64::EncodeUrl(ByteString("Ma")), "TWE");
+}
+
+TEST(Base64Test, Decode) {
+  auto check = [](ExceptionOr<ByteString> actual, const std::string& expected) {
+    ASSERT_TRUE(holds_alternative<ByteString>(actual));
+    EXPECT_EQ(get<ByteString>(actual), ByteString(expected));
+  };
+  check(Base64::Decode("TQ=="), "M");
+  check(Base64::Decode("TWE="), "Ma");
+  check(Base64::Decode("TWE"), "Ma");
+  check(Base64::Decode("TWFu"), "Man");
+  check(Base64::Decode("+/+/"), "\xfb\xff\xbf");
+  check(Base64::DecodeUrl("-_-_"), "\xfb\xff\xbf");
+
+  EXPECT_FALSE(holds_alternative<ByteString>(Base64::Decode("T")));
+  EXPECT_FALSE(holds_alternative<ByteString>(Base64::Decode("TQ=a")));
+  EXPECT_FALSE(holds_alternative<ByteString>(Base64::Decode("-_-_")));
+  EXPECT_FALSE(holds_alternative<ByteString>(Base64::DecodeUrl("+/+/")));
+}
+
+TEST(Base64Test, LargeInputs) {
+  // Cover every remainder around the vector block sizes.
+  for (size_t size = 0; size < 200; size++) {
+    const ByteString data = MakeData(size);
+    const std::string expected = ReferenceEncode(data);
+    const std::string encoded = Base64::Encode(data);
+    ASSERT_EQ(encoded, expected) << "size=" << size;
+    EXPECT_EQ(Base64::Encode(data.data(), data.size()), expected);
+
+    auto decoded = Base64::Decode(encoded);
+    ASSERT_TRUE(holds_alternative<ByteString>(decoded)) << "size=" << size;
+    EXPECT_EQ(get<ByteString>(decoded), data) << "size=" << size;
+
+    const std::string url = Base64::EncodeUrl(data.data(), data.size());
+    auto url_decoded = Base64::DecodeUrl(url);
+    ASSERT_TRUE(holds_alternative<ByteString>(url_decoded)) << "size=" << size;
+    EXPECT_EQ(get<ByteString>(url_decoded), data) << "size=" << size;
+  }
+}
+
+TEST(Base64Test, RejectsInvalidCharactersInBlocks) {
+  const std::string valid = Base64::Encode(MakeData(96));
+  for (size_t i = 0; i < valid.size(); i++) {
+    for (char c : {'*', '=', '\x80', '\0'}) {
+      std::string input = valid;
+      input[i] = c;
+      // '=' is allowed only as trailing padding.
+      const bool expect_valid = c == '=' && i == valid.size() - 1;
+      EXPECT_EQ(holds_alternative<ByteString>(Base64::Decode(input)),
+                expect_valid)
+          << "index=" << i << " char=" << static_cast<int>(c);
+    }
+  }
+}
+
+}  // namespace js
+}  // namespace shaka
@@ -0,0 +1,122 @@
+// Copyright 2020 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     https://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "src/js/chunked_response.h"
+
+#include <gtest/gtest.h>
+
+#include <vector>
+
+namespace shaka {
+namespace js {
+
+namespace {
+
+/** Appends an MP4 box with the given type and payload size. */
+void AddBox(const char* type, size_t payload_size, std::vector<uint8_t>* data) {
+  const uint32_t size = static_cast<uint32_t>(payload_size + 8);
+  data->push_back(static_cast<uint8_t>(size >> 24));
+  data->push_back(static_cast<uint8_t>(size >> 16));
+  data->push_back(static_cast<uint8_t>(size >> 8));
+  data->push_back(static_cast<uint8_t>(size));
+  data->insert(data->end(), type, type + 4);
+  data->insert(data->end(), payload_size, 0xab);
+}
+
+}  // namespace
+
+TEST(ChunkedResponseTest, FindsCompleteBoxes) {
+  std::vector<uint8_t> data;
+  AddBox("moof", 16, &data);
+  AddBox("mdat", 32, &data);
+  EXPECT_EQ(64u, FindCompleteBoxes(data.data(), data.size()));
+  EXPECT_EQ(24u, FindCompleteBoxes(data.data(), data.size() - 1));
+  EXPECT_EQ(0u, FindCompleteBoxes(data.data(), 20));
+
+  // Data that isn't MP4 is given as-is.
+  const std::vector<uint8_t> text = {0, 0, 0, 2, 'a', 'b', 'c', 'd', 'e'};
+  EXPECT_EQ(text.size(), FindCompleteBoxes(text.data(), text.size()));
+}
+
+TEST(ChunkedResponseTest, GivesCompleteBoxesAsTheyArrive) {
+  std::vector<uint8_t> data;
+  AddBox("moof", 16, &data);
+  AddBox("mdat", 32, &data);
+
+  ChunkedResponse chunked;
+  size_t start;
+  size_t length;
+  // Only the first box is complete.
+  ASSERT_TRUE(chunked.NextChunk(data.data(), 40, &start, &length));
+  EXPECT_EQ(0u, start);
+  EXPECT_EQ(24u, length);
+  // Nothing new is complete.
+  ASSERT_TRUE(chunked.NextChunk(data.data(), 50, &start, &length));
+  EXPECT_EQ(24u, start);
+  EXPECT_EQ(0u, length);
+  ASSERT_TRUE(chunked.NextChunk(data.data(), data.size(), &start, &length));
+  EXPECT_EQ(24u, start);
+  EXPECT_EQ(40u, length);
+
+  chunked.Finish(data.size(), &start, &length);
+  EXPECT_EQ(64u, start);
+  EXPECT_EQ(0u, length);
+}
+
+TEST(ChunkedResponseTest, FinishGivesPartialBoxes) {
+  std::vector<uint8_t> data;
+  AddBox("moof", 16, &data);
+  AddBox("mdat", 32, &data);
+  data.resize(50);  // The response ended mid-box.
+
+  ChunkedResponse chunked;
+  size_t start;
+  size_t length;
+  ASSERT_TRUE(chunked.NextChunk(data.data(), data.size(), &start, &length));
+  EXPECT_EQ(24u, length);
+  chunked.Finish(data.size(), &start, &length);
+  EXPECT_EQ(24u, start);
+  EXPECT_EQ(26u, length);
+}
+
+TEST(ChunkedResponseTest, IgnoresProgressAfterFinishing) {
+  // A progress event can be queued before the request completes but run
+  // after it; it must not replace the final chunk.
+  std::vector<uint8_t> data;
+  AddBox("moof", 16, &data);
+  AddBox("mdat", 32, &data);
+
+  ChunkedResponse chunked;
+  size_t start;
+  size_t length;
+  ASSERT_TRUE(chunked.NextChunk(data.data(), 30, &start, &length));
+  EXPECT_EQ(24u, length);
+  chunked.Finish(data.size(), &start, &length);
+  EXPECT_EQ(24u, start);
+  EXPECT_EQ(40u, length);
+
+  start = length = 123;
+  EXPECT_FALSE(chunked.NextChunk(data.data(), data.size(), &start, &length));
+  EXPECT_EQ(123u, start);
+  EXPECT_EQ(123u, length);
+
+  // A new request starts over.
+  chunked.Reset();
+  ASSERT_TRUE(chunked.NextChunk(data.data(), data.size(), &start, &length));
+  EXPECT_EQ(0u, start);
+  EXPECT_EQ(64u, length);
+}
+
+}  // namespace js
+}  // namespace shaka
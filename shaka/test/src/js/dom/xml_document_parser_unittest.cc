@@ -0,0 +1,81 @@
+// Copyright 2020 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     https://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "src/js/dom/xml_document_parser.h"
+
+#include <gtest/gtest.h>
+
+#include <string>
+#include <thread>
+
+namespace shaka {
+namespace js {
+namespace dom {
+
+using Event = XMLParsedEvents::Event;
+
+TEST(XMLParsedEventsTest, ParsesEvents) {
+  const std::string text =
+      "<top xmlns:foo=\"urn:foo\" a=\"1\"><foo:item foo:b=\"2\">text</foo:item>"
+      "<!--comment--></top>";
+  XMLParsedEvents parsed;
+  ASSERT_TRUE(parsed.Parse(text));
+
+  auto& events = parsed.events;
+  ASSERT_EQ(6u, events.size());
+  EXPECT_EQ(Event::kStartElement, events[0].type);
+  EXPECT_EQ("top", events[0].text);
+  EXPECT_FALSE(events[0].namespace_uri.has_value());
+  ASSERT_EQ(1u, events[0].attributes.size());
+  EXPECT_EQ("a", events[0].attributes[0].local_name);
+  EXPECT_EQ("1", events[0].attributes[0].value);
+  EXPECT_FALSE(events[0].attributes[0].namespace_uri.has_value());
+
+  EXPECT_EQ(Event::kStartElement, events[1].type);
+  EXPECT_EQ("item", events[1].text);
+  EXPECT_EQ("urn:foo", events[1].namespace_uri.value());
+  EXPECT_EQ("foo", events[1].namespace_prefix.value());
+  ASSERT_EQ(1u, events[1].attributes.size());
+  EXPECT_EQ("b", events[1].attributes[0].local_name);
+  EXPECT_EQ("urn:foo", events[1].attributes[0].namespace_uri.value());
+  EXPECT_EQ("foo", events[1].attributes[0].namespace_prefix.value());
+
+  EXPECT_EQ(Event::kText, events[2].type);
+  EXPECT_EQ("text", events[2].text);
+  EXPECT_EQ(Event::kEndElement, events[3].type);
+  EXPECT_EQ(Event::kComment, events[4].type);
+  EXPECT_EQ("comment", events[4].text);
+  EXPECT_EQ(Event::kEndElement, events[5].type);
+}
+
+TEST(XMLParsedEventsTest, FailsForInvalidDocuments) {
+  XMLParsedEvents parsed;
+  EXPECT_FALSE(parsed.Parse("<top><item></top>"));
+  EXPECT_TRUE(parsed.events.empty());
+  EXPECT_FALSE(parsed.Parse("<top a=\"1\" a=\"2\" />"));
+  EXPECT_FALSE(parsed.Parse("<top><?foo bar?></top>"));
+}
+
+TEST(XMLParsedEventsTest, CanParseOnAnotherThread) {
+  XMLParsedEvents parsed;
+  bool success = false;
+  std::thread thread([&]() { success = parsed.Parse("<top><a /></top>"); });
+  thread.join();
+  EXPECT_TRUE(success);
+  EXPECT_EQ(4u, parsed.events.size());
+}
+
+}  // namespace dom
+}  // namespace js
+}  // namespace shaka
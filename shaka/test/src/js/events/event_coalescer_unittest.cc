@@ -0,0 +1,78 @@
+// Copyright 2020 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     https://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "src/js/events/event_coalescer.h"
+
+#include <gtest/gtest.h>
+
+namespace shaka {
+namespace js {
+namespace events {
+
+TEST(EventCoalescerTest, MergesEventsInARow) {
+  EventCoalescer coalescer;
+  const uint64_t id =
+      coalescer.OnCoalescedEventScheduled(EventType::RateChange);
+  EXPECT_NE(0u, id);
+  EXPECT_EQ(0u, coalescer.OnCoalescedEventScheduled(EventType::RateChange));
+  EXPECT_EQ(0u, coalescer.OnCoalescedEventScheduled(EventType::RateChange));
+
+  // Once dispatched, a new event is needed.
+  coalescer.OnCoalescedEventDispatched(id);
+  EXPECT_NE(0u, coalescer.OnCoalescedEventScheduled(EventType::RateChange));
+}
+
+TEST(EventCoalescerTest, KeepsOrderWithOtherEvents) {
+  // waiting, playing, waiting: the second "waiting" must be delivered after
+  // "playing", so it can't be merged with the first.
+  EventCoalescer coalescer;
+  const uint64_t first =
+      coalescer.OnCoalescedEventScheduled(EventType::Waiting);
+  EXPECT_NE(0u, first);
+  coalescer.OnEventScheduled();  // playing
+  const uint64_t second =
+      coalescer.OnCoalescedEventScheduled(EventType::Waiting);
+  EXPECT_NE(0u, second);
+  EXPECT_NE(first, second);
+
+  // Events after the second one are merged with it, not the first.
+  EXPECT_EQ(0u, coalescer.OnCoalescedEventScheduled(EventType::Waiting));
+  coalescer.OnCoalescedEventDispatched(first);
+  EXPECT_EQ(0u, coalescer.OnCoalescedEventScheduled(EventType::Waiting));
+  coalescer.OnCoalescedEventDispatched(second);
+  EXPECT_NE(0u, coalescer.OnCoalescedEventScheduled(EventType::Waiting));
+}
+
+TEST(EventCoalescerTest, KeepsOrderBetweenCoalescedTypes) {
+  // waiting, ratechange, waiting: each is delivered in order.
+  EventCoalescer coalescer;
+  EXPECT_NE(0u, coalescer.OnCoalescedEventScheduled(EventType::Waiting));
+  EXPECT_NE(0u, coalescer.OnCoalescedEventScheduled(EventType::RateChange));
+  EXPECT_NE(0u, coalescer.OnCoalescedEventScheduled(EventType::Waiting));
+  // But repeating the last one is merged.
+  EXPECT_EQ(0u, coalescer.OnCoalescedEventScheduled(EventType::Waiting));
+}
+
+TEST(EventCoalescerTest, MergesAfterEarlierEvents) {
+  // An event scheduled before the pending one doesn't stop later events from
+  // being merged with it.
+  EventCoalescer coalescer;
+  coalescer.OnEventScheduled();  // pause
+  EXPECT_NE(0u, coalescer.OnCoalescedEventScheduled(EventType::Waiting));
+  EXPECT_EQ(0u, coalescer.OnCoalescedEventScheduled(EventType::Waiting));
+}
+
+}  // namespace events
+}  // namespace js
+}  // namespace shaka
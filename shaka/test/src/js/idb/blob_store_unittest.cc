@@ -0,0 +1,219 @@
+// Copyright 2020 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     https://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "src/js/idb/blob_store.h"
+
+#include <glog/logging.h>
+#include <gmock/gmock.h>
+#include <gtest/gtest.h>
+
+#include <string>
+#include <vector>
+
+#include "src/js/idb/sqlite.h"
+#include "src/test/temp_dir_test.h"
+
+namespace shaka {
+namespace js {
+namespace idb {
+
+namespace {
+
+constexpr const char* kDbName = "db";
+constexpr const char* kStoreName = "store";
+
+proto::Value MakeBytes(size_t size, char fill) {
+  proto::Value ret;
+  ret.set_kind(proto::ArrayBuffer);
+  ret.set_value_bytes(std::string(size, fill));
+  return ret;
+}
+
+std::vector<uint8_t> Serialize(const proto::Value& value) {
+  std::string ret;
+  CHECK(value.SerializeToString(&ret));
+  return std::vector<uint8_t>(ret.begin(), ret.end());
+}
+
+}  // namespace
+
+class BlobStoreTest : public TempDirTest {
+ public:
+  void SetUp() override {
+    TempDirTest::SetUp();
+    dir_ = util::FileSystem::PathJoin(temp_dir_, "blobs");
+
+    ASSERT_EQ(connection_.Init(), DatabaseStatus::Success);
+    ASSERT_EQ(connection_.BeginTransaction(&transaction_),
+              DatabaseStatus::Success);
+    ASSERT_EQ(transaction_.CreateDb(kDbName, 1), DatabaseStatus::Success);
+    ASSERT_EQ(transaction_.CreateObjectStore(kDbName, kStoreName),
+              DatabaseStatus::Success);
+  }
+
+ protected:
+  std::vector<std::string> ListFiles() const {
+    std::vector<std::string> files;
+    if (fs_.DirectoryExists(dir_))
+      CHECK(fs_.ListFiles(dir_, &files));
+    return files;
+  }
+
+  std::string dir_;
+  SqliteConnection connection_{""};
+  SqliteTransaction transaction_;
+};
+
+TEST_F(BlobStoreTest, KeepsSmallValuesInline) {
+  BlobStore blobs(dir_);
+  proto::Value value = MakeBytes(BlobStore::kMinFileSize - 1, 'a');
+  ASSERT_TRUE(blobs.StoreLargeValues(&value));
+  EXPECT_TRUE(value.has_value_bytes());
+  EXPECT_TRUE(ListFiles().empty());
+}
+
+TEST_F(BlobStoreTest, StoresLargeValuesInFiles) {
+  BlobStore blobs(dir_);
+  proto::Value value;
+  value.set_kind(proto::OtherObject);
+  auto* entry = value.mutable_value_object()->add_entries();
+  entry->set_key("data");
+  *entry->mutable_value() = MakeBytes(BlobStore::kMinFileSize, 'a');
+
+  ASSERT_TRUE(blobs.StoreLargeValues(&value));
+  const proto::Value& stored = value.value_object().entries(0).value();
+  EXPECT_EQ(proto::ArrayBuffer, stored.kind());
+  ASSERT_TRUE(stored.has_value_file());
+  EXPECT_THAT(ListFiles(), testing::ElementsAre(stored.value_file()));
+
+  std::vector<uint8_t> contents;
+  ASSERT_TRUE(fs_.ReadFile(
+      util::FileSystem::PathJoin(dir_, stored.value_file()), &contents));
+  EXPECT_EQ(std::vector<uint8_t>(BlobStore::kMinFileSize, 'a'), contents);
+}
+
+TEST_F(BlobStoreTest, SharesFilesWithSameData) {
+  BlobStore blobs(dir_);
+  proto::Value first = MakeBytes(BlobStore::kMinFileSize, 'a');
+  proto::Value second = MakeBytes(BlobStore::kMinFileSize, 'a');
+  proto::Value third = MakeBytes(BlobStore::kMinFileSize, 'b');
+  ASSERT_TRUE(blobs.StoreLargeValues(&first));
+  ASSERT_TRUE(blobs.StoreLargeValues(&second));
+  ASSERT_TRUE(blobs.StoreLargeValues(&third));
+
+  EXPECT_EQ(first.value_file(), second.value_file());
+  EXPECT_NE(first.value_file(), third.value_file());
+  EXPECT_EQ(2u, ListFiles().size());
+}
+
+TEST_F(BlobStoreTest, DoesntUseFilesForTemporaryDatabases) {
+  EXPECT_EQ("", BlobStore::DirForDatabase(""));
+  EXPECT_NE("", BlobStore::DirForDatabase("/foo/db"));
+
+  BlobStore blobs("");
+  proto::Value value = MakeBytes(BlobStore::kMinFileSize, 'a');
+  ASSERT_TRUE(blobs.StoreLargeValues(&value));
+  EXPECT_TRUE(value.has_value_bytes());
+}
+
+TEST_F(BlobStoreTest, RemovesUnusedFiles) {
+  BlobStore blobs(dir_);
+  proto::Value used = MakeBytes(BlobStore::kMinFileSize, 'a');
+  proto::Value unused = MakeBytes(BlobStore::kMinFileSize, 'b');
+  ASSERT_TRUE(blobs.StoreLargeValues(&used));
+  ASSERT_TRUE(blobs.StoreLargeValues(&unused));
+
+  int64_t key;
+  ASSERT_EQ(transaction_.AddData(kDbName, kStoreName, Serialize(used), &key,
+                                 {used.value_file()}),
+            DatabaseStatus::Success);
+
+  blobs.RemoveUnusedFiles(&transaction_);
+  EXPECT_THAT(ListFiles(), testing::ElementsAre(used.value_file()));
+
+  ASSERT_EQ(transaction_.DeleteData(kDbName, kStoreName, key),
+            DatabaseStatus::Success);
+  blobs.RemoveUnusedFiles(&transaction_);
+  EXPECT_TRUE(ListFiles().empty());
+}
+
+TEST_F(BlobStoreTest, KeepsSharedFilesUntilUnused) {
+  BlobStore blobs(dir_);
+  proto::Value first = MakeBytes(BlobStore::kMinFileSize, 'a');
+  proto::Value second = MakeBytes(BlobStore::kMinFileSize, 'a');
+  ASSERT_TRUE(blobs.StoreLargeValues(&first));
+  ASSERT_TRUE(blobs.StoreLargeValues(&second));
+  const std::string file = first.value_file();
+
+  int64_t key1, key2;
+  ASSERT_EQ(transaction_.AddData(kDbName, kStoreName, Serialize(first), &key1,
+                                 {file}),
+            DatabaseStatus::Success);
+  ASSERT_EQ(transaction_.AddData(kDbName, kStoreName, Serialize(second),
+                                 &key2, {file}),
+            DatabaseStatus::Success);
+  int64_t count;
+  ASSERT_EQ(transaction_.CountFileReferences(file, &count),
+            DatabaseStatus::Success);
+  EXPECT_EQ(2, count);
+
+  ASSERT_EQ(transaction_.DeleteData(kDbName, kStoreName, key1),
+            DatabaseStatus::Success);
+  blobs.RemoveUnusedFiles(&transaction_);
+  EXPECT_THAT(ListFiles(), testing::ElementsAre(file));
+
+  ASSERT_EQ(transaction_.DeleteData(kDbName, kStoreName, key2),
+            DatabaseStatus::Success);
+  blobs.RemoveUnusedFiles(&transaction_);
+  EXPECT_TRUE(ListFiles().empty());
+}
+
+TEST_F(BlobStoreTest, BuildsFileIndexForOldDatabases) {
+  BlobStore blobs(dir_);
+  proto::Value value = MakeBytes(BlobStore::kMinFileSize, 'a');
+  ASSERT_TRUE(blobs.StoreLargeValues(&value));
+
+  // Older versions didn't record the files.
+  int64_t key;
+  ASSERT_EQ(transaction_.AddData(kDbName, kStoreName, Serialize(value), &key),
+            DatabaseStatus::Success);
+  ASSERT_EQ(transaction_.SetHasFileIndex(false), DatabaseStatus::Success);
+  blobs.RemoveUnusedFiles(&transaction_);
+  EXPECT_EQ(1u, ListFiles().size());
+
+  ASSERT_TRUE(BlobStore::BuildFileIndex(&transaction_));
+  bool has_index;
+  ASSERT_EQ(transaction_.HasFileIndex(&has_index), DatabaseStatus::Success);
+  EXPECT_TRUE(has_index);
+  blobs.RemoveUnusedFiles(&transaction_);
+  EXPECT_THAT(ListFiles(), testing::ElementsAre(value.value_file()));
+}
+
+TEST_F(BlobStoreTest, KeepsFilesIfEntriesAreInvalid) {
+  BlobStore blobs(dir_);
+  proto::Value value = MakeBytes(BlobStore::kMinFileSize, 'a');
+  ASSERT_TRUE(blobs.StoreLargeValues(&value));
+
+  int64_t key;
+  ASSERT_EQ(transaction_.AddData(kDbName, kStoreName, {0xff, 0xff}, &key),
+            DatabaseStatus::Success);
+  ASSERT_EQ(transaction_.SetHasFileIndex(false), DatabaseStatus::Success);
+  EXPECT_FALSE(BlobStore::BuildFileIndex(&transaction_));
+  blobs.RemoveUnusedFiles(&transaction_);
+  EXPECT_EQ(1u, ListFiles().size());
+}
+
+}  // namespace idb
+}  // namespace js
+}  // namespace shaka
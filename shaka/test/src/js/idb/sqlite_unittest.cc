@@ -14,8 +14,18 @@
 
 #include "src/js/idb/sqlite.h"
 
+#include <glog/logging.h>
 #include <gmock/gmock.h>
 #include <gtest/gtest.h>
+#include <sqlite3.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+#include <chrono>
+#include <string>
+#include <unordered_set>
+#include <utility>
+#include <vector>
 
 namespace shaka {
 namespace js {
@@ -26,6 +36,20 @@ namespace {
 constexpr const char* kDbName = "db";
 constexpr const char* kStoreName = "store";
 
+/** @return The number of free pages in the given database file. */
+int64_t GetFreePages(const std::string& path) {
+  sqlite3* db;
+  CHECK_EQ(sqlite3_open(path.c_str(), &db), SQLITE_OK);
+  sqlite3_stmt* stmt;
+  CHECK_EQ(sqlite3_prepare_v2(db, "PRAGMA freelist_count", -1, &stmt, nullptr),
+           SQLITE_OK);
+  CHECK_EQ(sqlite3_step(stmt), SQLITE_ROW);
+  const int64_t ret = sqlite3_column_int64(stmt, 0);
+  sqlite3_finalize(stmt);
+  sqlite3_close(db);
+  return ret;
+}
+
 }  // namespace
 
 class SqliteTest : public testing::Test {
@@ -235,6 +259,34 @@ TEST_F(SqliteTest, DeleteData_KeyNotFound) {
 }
 
 
+TEST_F(SqliteTest, FileReferences) {
+  int64_t key;
+  ASSERT_EQ(transaction_.AddData(kDbName, kStoreName, {1}, &key, {"a", "b"}),
+            DatabaseStatus::Success);
+  ASSERT_EQ(transaction_.UpdateData(kDbName, kStoreName, 100, {1}, {"a"}),
+            DatabaseStatus::Success);
+
+  std::unordered_set<std::string> files;
+  ASSERT_EQ(transaction_.ListReferencedFiles(&files), DatabaseStatus::Success);
+  EXPECT_EQ(files, std::unordered_set<std::string>({"a", "b"}));
+  int64_t count;
+  ASSERT_EQ(transaction_.CountFileReferences("a", &count),
+            DatabaseStatus::Success);
+  EXPECT_EQ(count, 2);
+
+  // Replacing or deleting an entry removes its references.
+  ASSERT_EQ(transaction_.UpdateData(kDbName, kStoreName, key, {2}, {"c"}),
+            DatabaseStatus::Success);
+  ASSERT_EQ(transaction_.CountFileReferences("b", &count),
+            DatabaseStatus::Success);
+  EXPECT_EQ(count, 0);
+  ASSERT_EQ(transaction_.DeleteObjectStore(kDbName, kStoreName),
+            DatabaseStatus::Success);
+  files.clear();
+  ASSERT_EQ(transaction_.ListReferencedFiles(&files), DatabaseStatus::Success);
+  EXPECT_TRUE(files.empty());
+}
+
 TEST_F(SqliteTest, MultipleStores) {
   int64_t new_key;
   ASSERT_EQ(transaction_.AddData(kDbName, kStoreName, {4, 5, 6}, &new_key),
@@ -346,6 +398,99 @@ TEST_F(SqliteTest, HandlesSeparateTransactions) {
   }
 }
 
+TEST(SqliteConnectionTest, RunMaintenance_VacuumsFreePages) {
+  std::string path = "/tmp/sqliteXXXXXX";
+  const int fd = mkstemp(&path[0]);
+  ASSERT_NE(fd, -1);
+  close(fd);
+  ASSERT_EQ(unlink(path.c_str()), 0);
+
+  {
+    SqliteConnection connection(path);
+    ASSERT_EQ(connection.Init(), DatabaseStatus::Success);
+
+    std::vector<int64_t> keys(32);
+    {
+      SqliteTransaction trans;
+      ASSERT_EQ(connection.BeginTransaction(&trans), DatabaseStatus::Success);
+      ASSERT_EQ(trans.CreateDb(kDbName, 1), DatabaseStatus::Success);
+      ASSERT_EQ(trans.CreateObjectStore(kDbName, kStoreName),
+                DatabaseStatus::Success);
+      for (int64_t& key : keys) {
+        ASSERT_EQ(trans.AddData(kDbName, kStoreName,
+                                std::vector<uint8_t>(256 * 1024), &key),
+                  DatabaseStatus::Success);
+      }
+      ASSERT_EQ(trans.Commit(), DatabaseStatus::Success);
+    }
+    ASSERT_EQ(connection.RunMaintenance(), DatabaseStatus::Success);
+    EXPECT_EQ(GetFreePages(path), 0);
+
+    {
+      SqliteTransaction trans;
+      ASSERT_EQ(connection.BeginTransaction(&trans), DatabaseStatus::Success);
+      for (int64_t key : keys) {
+        ASSERT_EQ(trans.DeleteData(kDbName, kStoreName, key),
+                  DatabaseStatus::Success);
+      }
+      ASSERT_EQ(trans.Commit(), DatabaseStatus::Success);
+    }
+    const int64_t free_pages = GetFreePages(path);
+    ASSERT_GT(free_pages, SqliteConnection::kVacuumPages);
+
+    // This is skipped while there is a transaction.
+    {
+      SqliteTransaction trans;
+      ASSERT_EQ(connection.BeginTransaction(&trans), DatabaseStatus::Success);
+      ASSERT_EQ(connection.RunMaintenance(), DatabaseStatus::Success);
+      ASSERT_EQ(trans.Commit(), DatabaseStatus::Success);
+    }
+    EXPECT_EQ(GetFreePages(path), free_pages);
+
+    // Each call only vacuums a bounded number of pages.
+    ASSERT_EQ(connection.RunMaintenance(), DatabaseStatus::Success);
+    EXPECT_EQ(GetFreePages(path),
+              free_pages - SqliteConnection::kVacuumPages);
+    while (GetFreePages(path) >= SqliteConnection::kMinVacuumPages)
+      ASSERT_EQ(connection.RunMaintenance(), DatabaseStatus::Success);
+  }
+
+  ASSERT_EQ(unlink(path.c_str()), 0);
+  unlink((path + "-wal").c_str());
+  unlink((path + "-shm").c_str());
+}
+
+
+// This measures the rate of small inserts and reads, where preparing the
+// statement is a large part of the cost.  This is disabled by default; run
+// with --gtest_also_run_disabled_tests to see the results.
+TEST_F(SqliteTest, DISABLED_DataBenchmark) {
+  using std::chrono::duration_cast;
+  using std::chrono::microseconds;
+  using std::chrono::steady_clock;
+  constexpr const int kIterations = 20000;
+  const std::vector<uint8_t> data(1024, 0x12);
+
+  std::vector<int64_t> keys(kIterations);
+  auto start = steady_clock::now();
+  for (int i = 0; i < kIterations; i++) {
+    ASSERT_EQ(transaction_.AddData(kDbName, kStoreName, data, &keys[i]),
+              DatabaseStatus::Success);
+  }
+  auto us = duration_cast<microseconds>(steady_clock::now() - start);
+  LOG(INFO) << "AddData: " << (kIterations * 1000000LL / us.count())
+            << " inserts per second";
+
+  std::vector<uint8_t> result;
+  start = steady_clock::now();
+  for (int i = 0; i < kIterations; i++) {
+    ASSERT_EQ(transaction_.GetData(kDbName, kStoreName, keys[i], &result),
+              DatabaseStatus::Success);
+  }
+  us = duration_cast<microseconds>(steady_clock::now() - start);
+  LOG(INFO) << "GetData: " << (kIterations * 1000000LL / us.count())
+            << " reads per second";
+}
 
 class SqliteFindTest : public SqliteTest {
  public:
@@ -428,6 +573,101 @@ TEST_F(SqliteFindTest, FindData_End) {
             DatabaseStatus::NotFound);
 }
 
+TEST_F(SqliteFindTest, ListData) {
+  using Entries = std::vector<std::pair<int64_t, std::vector<uint8_t>>>;
+  const std::vector<uint8_t> body = {1, 2, 3};
+
+  Entries entries;
+  ASSERT_EQ(transaction_.ListData(kDbName, kStoreName, nullopt, true, 3,
+                                  &entries),
+            DatabaseStatus::Success);
+  EXPECT_EQ(entries, Entries({{5, body}, {6, body}, {10, body}}));
+
+  entries.clear();
+  ASSERT_EQ(
+      transaction_.ListData(kDbName, kStoreName, 10, false, 10, &entries),
+      DatabaseStatus::Success);
+  EXPECT_EQ(entries, Entries({{6, body}, {5, body}}));
+
+  entries.clear();
+  ASSERT_EQ(transaction_.ListData(kDbName, kStoreName, 11, true, 10, &entries),
+            DatabaseStatus::Success);
+  EXPECT_TRUE(entries.empty());
+  ASSERT_EQ(transaction_.ListData(kDbName, "foo", nullopt, true, 10, &entries),
+            DatabaseStatus::Success);
+  EXPECT_TRUE(entries.empty());
+}
+
+TEST_F(SqliteFindTest, GetAllData) {
+  using Entries = std::vector<std::pair<int64_t, std::vector<uint8_t>>>;
+  const std::vector<uint8_t> body = {1, 2, 3};
+
+  Entries entries;
+  ASSERT_EQ(transaction_.GetAllData(kDbName, kStoreName, KeyRange(), 0,
+                                    &entries),
+            DatabaseStatus::Success);
+  EXPECT_EQ(entries, Entries({{5, body}, {6, body}, {10, body}, {11, body}}));
+
+  KeyRange range;
+  range.lower = 5;
+  range.lower_open = true;
+  range.upper = 10;
+  entries.clear();
+  ASSERT_EQ(
+      transaction_.GetAllData(kDbName, kStoreName, range, 0, &entries),
+      DatabaseStatus::Success);
+  EXPECT_EQ(entries, Entries({{6, body}, {10, body}}));
+
+  entries.clear();
+  ASSERT_EQ(
+      transaction_.GetAllData(kDbName, kStoreName, range, 1, &entries),
+      DatabaseStatus::Success);
+  EXPECT_EQ(entries, Entries({{6, body}}));
+
+  entries.clear();
+  ASSERT_EQ(transaction_.GetAllData(kDbName, "foo", range, 0, &entries),
+            DatabaseStatus::Success);
+  EXPECT_TRUE(entries.empty());
+}
+
+TEST_F(SqliteFindTest, GetAllKeys) {
+  std::vector<int64_t> keys;
+  ASSERT_EQ(
+      transaction_.GetAllKeys(kDbName, kStoreName, KeyRange(), 3, &keys),
+      DatabaseStatus::Success);
+  EXPECT_EQ(keys, std::vector<int64_t>({5, 6, 10}));
+
+  KeyRange range;
+  range.upper = 11;
+  range.upper_open = true;
+  keys.clear();
+  ASSERT_EQ(transaction_.GetAllKeys(kDbName, kStoreName, range, 0, &keys),
+            DatabaseStatus::Success);
+  EXPECT_EQ(keys, std::vector<int64_t>({5, 6, 10}));
+}
+
+TEST_F(SqliteFindTest, CountData) {
+  int64_t count;
+  ASSERT_EQ(transaction_.CountData(kDbName, kStoreName, KeyRange(), &count),
+            DatabaseStatus::Success);
+  EXPECT_EQ(count, 4);
+
+  KeyRange range;
+  range.lower = 6;
+  range.upper = 6;
+  ASSERT_EQ(transaction_.CountData(kDbName, kStoreName, range, &count),
+            DatabaseStatus::Success);
+  EXPECT_EQ(count, 1);
+
+  range.upper_open = true;
+  ASSERT_EQ(transaction_.CountData(kDbName, kStoreName, range, &count),
+            DatabaseStatus::Success);
+  EXPECT_EQ(count, 0);
+  ASSERT_EQ(transaction_.CountData(kDbName, "foo", KeyRange(), &count),
+            DatabaseStatus::Success);
+  EXPECT_EQ(count, 0);
+}
+
 }  // namespace idb
 }  // namespace js
 }  // namespace shaka
@@ -0,0 +1,64 @@
+// Copyright 2020 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     https://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "src/js/progress_throttle.h"
+
+#include <gtest/gtest.h>
+
+namespace shaka {
+namespace js {
+
+TEST(ProgressThrottleTest, ThrottlesToTheInterval) {
+  ProgressThrottle throttle;
+  // The first data always posts a task.
+  EXPECT_TRUE(throttle.OnDataReceived(1000, 50));
+  throttle.OnTaskRun();
+
+  EXPECT_FALSE(throttle.OnDataReceived(1010, 50));
+  EXPECT_FALSE(throttle.OnDataReceived(1049, 50));
+  EXPECT_TRUE(throttle.OnDataReceived(1050, 50));
+}
+
+TEST(ProgressThrottleTest, OnlyOneTaskIsPending) {
+  ProgressThrottle throttle;
+  EXPECT_TRUE(throttle.OnDataReceived(1000, 50));
+  EXPECT_FALSE(throttle.OnDataReceived(2000, 50));
+  EXPECT_FALSE(throttle.OnDataReceived(3000, 0));
+
+  throttle.OnTaskRun();
+  EXPECT_TRUE(throttle.OnDataReceived(3000, 50));
+}
+
+TEST(ProgressThrottleTest, ZeroIntervalIsUnthrottled) {
+  ProgressThrottle throttle;
+  for (int i = 0; i < 5; i++) {
+    // Every data callback after the task runs posts another, even at the same
+    // time.
+    EXPECT_TRUE(throttle.OnDataReceived(1000, 0));
+    throttle.OnTaskRun();
+  }
+}
+
+TEST(ProgressThrottleTest, ResetStartsOver) {
+  ProgressThrottle throttle;
+  EXPECT_TRUE(throttle.OnDataReceived(1000, 50));
+  throttle.OnTaskRun();
+  EXPECT_FALSE(throttle.OnDataReceived(1010, 50));
+
+  throttle.Reset();
+  EXPECT_TRUE(throttle.OnDataReceived(1010, 50));
+}
+
+}  // namespace js
+}  // namespace shaka
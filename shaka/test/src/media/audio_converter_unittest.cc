@@ -0,0 +1,203 @@
+// Copyright 2020 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     https://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "src/media/audio_converter.h"
+
+#include <gtest/gtest.h>
+
+#include <algorithm>
+#include <cstring>
+#include <memory>
+#include <vector>
+
+namespace shaka {
+namespace media {
+
+namespace {
+
+std::shared_ptr<StreamInfo> MakeStreamInfo(uint32_t channels,
+                                           uint32_t sample_rate) {
+  return std::shared_ptr<StreamInfo>{new StreamInfo(
+      "", "", false, {0, 0}, {0, 0}, {}, 0, 0, channels, sample_rate)};
+}
+
+std::shared_ptr<DecodedFrame> MakeFrame(std::shared_ptr<StreamInfo> info,
+                                        SampleFormat format,
+                                        std::vector<const uint8_t*> data,
+                                        std::vector<size_t> linesize) {
+  return std::shared_ptr<DecodedFrame>(new DecodedFrame(
+      info, 0, 0, 0.01, format, 0, std::move(data), std::move(linesize)));
+}
+
+std::vector<float> ToFloats(const std::vector<uint8_t>& data, size_t size) {
+  std::vector<float> ret(size / sizeof(float));
+  memcpy(ret.data(), data.data(), size);
+  return ret;
+}
+
+std::vector<int16_t> ToS16(const std::vector<uint8_t>& data, size_t size) {
+  std::vector<int16_t> ret(size / sizeof(int16_t));
+  memcpy(ret.data(), data.data(), size);
+  return ret;
+}
+
+}  // namespace
+
+TEST(AudioConverterTest, ConvertsPlanarToPacked) {
+  const float left[] = {0.5f, -0.5f, 0.25f};
+  const float right[] = {1, -1, 0};
+  auto frame = MakeFrame(MakeStreamInfo(2, 100), SampleFormat::PlanarFloat,
+                         {reinterpret_cast<const uint8_t*>(left),
+                          reinterpret_cast<const uint8_t*>(right)},
+                         {sizeof(left), sizeof(right)});
+
+  AudioConverter converter;
+  converter.SetOutputFormat(SampleFormat::PackedFloat, 100, 2);
+  std::vector<uint8_t> output;
+  size_t size;
+  ASSERT_TRUE(converter.Convert(*frame, 0, &output, &size));
+  EXPECT_EQ(ToFloats(output, size),
+            (std::vector<float>{0.5f, 1, -0.5f, -1, 0.25f, 0}));
+
+  // Skips the given number of samples.
+  ASSERT_TRUE(converter.Convert(*frame, 2, &output, &size));
+  EXPECT_EQ(ToFloats(output, size), (std::vector<float>{0.25f, 0}));
+}
+
+TEST(AudioConverterTest, ConvertsFloatToS16) {
+  // Use more than 8 samples to use the SIMD path, plus some extra.
+  std::vector<float> input;
+  for (int i = 0; i < 19; i++)
+    input.push_back((i - 9) / 8.0f);
+  auto frame = MakeFrame(MakeStreamInfo(1, 100), SampleFormat::PackedFloat,
+                         {reinterpret_cast<const uint8_t*>(input.data())},
+                         {input.size() * sizeof(float)});
+
+  AudioConverter converter;
+  converter.SetOutputFormat(SampleFormat::PackedS16, 100, 1);
+  std::vector<uint8_t> output;
+  size_t size;
+  ASSERT_TRUE(converter.Convert(*frame, 0, &output, &size));
+  const std::vector<int16_t> samples = ToS16(output, size);
+  ASSERT_EQ(input.size(), samples.size());
+  for (size_t i = 0; i < input.size(); i++) {
+    // Values outside [-1, 1] are clamped.
+    const float expected = std::min(std::max(input[i], -1.0f), 1.0f) * 32767;
+    EXPECT_NEAR(expected, samples[i], 1) << "i=" << i;
+  }
+}
+
+TEST(AudioConverterTest, ConvertsIntegerFormats) {
+  const int16_t s16[] = {-32768, -16384, 0, 16384, 8192, 0, 0, 0, 16384};
+  const uint8_t u8[] = {0, 64, 128, 192};
+
+  AudioConverter converter;
+  converter.SetOutputFormat(SampleFormat::PackedFloat, 100, 1);
+  std::vector<uint8_t> output;
+  size_t size;
+
+  auto frame = MakeFrame(MakeStreamInfo(1, 100), SampleFormat::PlanarS16,
+                         {reinterpret_cast<const uint8_t*>(s16)}, {sizeof(s16)});
+  ASSERT_TRUE(converter.Convert(*frame, 0, &output, &size));
+  EXPECT_EQ(ToFloats(output, size),
+            (std::vector<float>{-1, -0.5f, 0, 0.5f, 0.25f, 0, 0, 0, 0.5f}));
+
+  frame = MakeFrame(MakeStreamInfo(1, 100), SampleFormat::PackedU8, {u8},
+                    {sizeof(u8)});
+  ASSERT_TRUE(converter.Convert(*frame, 0, &output, &size));
+  EXPECT_EQ(ToFloats(output, size),
+            (std::vector<float>{-1, -0.5f, 0, 0.5f}));
+}
+
+TEST(AudioConverterTest, MapsChannels) {
+  const float mono[] = {0.5f, -0.25f};
+  const float stereo[] = {0.5f, 0, -0.5f, -0.25f};
+  std::vector<uint8_t> output;
+  size_t size;
+
+  AudioConverter converter;
+  converter.SetOutputFormat(SampleFormat::PackedFloat, 100, 2);
+  auto frame = MakeFrame(MakeStreamInfo(1, 100), SampleFormat::PackedFloat,
+                         {reinterpret_cast<const uint8_t*>(mono)},
+                         {sizeof(mono)});
+  ASSERT_TRUE(converter.Convert(*frame, 0, &output, &size));
+  EXPECT_EQ(ToFloats(output, size),
+            (std::vector<float>{0.5f, 0.5f, -0.25f, -0.25f}));
+
+  converter.SetOutputFormat(SampleFormat::PackedFloat, 100, 1);
+  frame = MakeFrame(MakeStreamInfo(2, 100), SampleFormat::PackedFloat,
+                    {reinterpret_cast<const uint8_t*>(stereo)},
+                    {sizeof(stereo)});
+  ASSERT_TRUE(converter.Convert(*frame, 0, &output, &size));
+  EXPECT_EQ(ToFloats(output, size), (std::vector<float>{0.25f, -0.375f}));
+
+  converter.SetOutputFormat(SampleFormat::PackedFloat, 100, 3);
+  ASSERT_TRUE(converter.Convert(*frame, 0, &output, &size));
+  EXPECT_EQ(ToFloats(output, size),
+            (std::vector<float>{0.5f, 0, 0, -0.5f, -0.25f, 0}));
+}
+
+TEST(AudioConverterTest, ResamplesAcrossFrames) {
+  // A ramp at 100 Hz played at 200 Hz should be interpolated linearly,
+  // including between the frames.
+  const float first[] = {0, 1, 2, 3};
+  const float second[] = {4, 5, 6, 7};
+  auto info = MakeStreamInfo(1, 100);
+  auto frame1 = MakeFrame(info, SampleFormat::PackedFloat,
+                          {reinterpret_cast<const uint8_t*>(first)},
+                          {sizeof(first)});
+  auto frame2 = MakeFrame(info, SampleFormat::PackedFloat,
+                          {reinterpret_cast<const uint8_t*>(second)},
+                          {sizeof(second)});
+
+  AudioConverter converter;
+  converter.SetOutputFormat(SampleFormat::PackedFloat, 200, 1);
+  std::vector<uint8_t> output;
+  size_t size;
+  std::vector<float> all;
+  ASSERT_TRUE(converter.Convert(*frame1, 0, &output, &size));
+  std::vector<float> samples = ToFloats(output, size);
+  all.insert(all.end(), samples.begin(), samples.end());
+  ASSERT_TRUE(converter.Convert(*frame2, 0, &output, &size));
+  samples = ToFloats(output, size);
+  all.insert(all.end(), samples.begin(), samples.end());
+
+  // The last input sample is held until the next frame.
+  ASSERT_EQ(14u, all.size());
+  for (size_t i = 0; i < all.size(); i++)
+    EXPECT_FLOAT_EQ(i / 2.0f, all[i]) << "i=" << i;
+}
+
+TEST(AudioConverterTest, Downsamples) {
+  std::vector<float> input;
+  for (int i = 0; i < 480; i++)
+    input.push_back(static_cast<float>(i));
+  auto frame = MakeFrame(MakeStreamInfo(1, 48000), SampleFormat::PackedFloat,
+                         {reinterpret_cast<const uint8_t*>(input.data())},
+                         {input.size() * sizeof(float)});
+
+  AudioConverter converter;
+  converter.SetOutputFormat(SampleFormat::PackedFloat, 44100, 1);
+  std::vector<uint8_t> output;
+  size_t size;
+  ASSERT_TRUE(converter.Convert(*frame, 0, &output, &size));
+  const std::vector<float> samples = ToFloats(output, size);
+  // The last sample is held until the next frame.
+  EXPECT_NEAR(441u, samples.size(), 1);
+  for (size_t i = 0; i < samples.size(); i++)
+    EXPECT_NEAR(i * 48000.0 / 44100, samples[i], 1e-3) << "i=" << i;
+}
+
+}  // namespace media
+}  // namespace shaka
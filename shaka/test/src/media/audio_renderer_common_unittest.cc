@@ -32,6 +32,7 @@ namespace {
 using testing::_;
 using testing::Args;
 using testing::AtLeast;
+using testing::DoubleEq;
 using testing::InSequence;
 using testing::InvokeWithoutArgs;
 using testing::MockFunction;
@@ -56,9 +57,9 @@ const uint8_t kData3[] = {9, 10};
     return (val);                  \
   })
 
-std::shared_ptr<StreamInfo> MakeStreamInfo() {
-  return std::shared_ptr<StreamInfo>{
-      new StreamInfo("", "", false, {0, 0}, {0, 0}, {}, 0, 0, 1, kSampleRate)};
+std::shared_ptr<StreamInfo> MakeStreamInfo(uint32_t channel_count = 1) {
+  return std::shared_ptr<StreamInfo>{new StreamInfo(
+      "", "", false, {0, 0}, {0, 0}, {}, 0, 0, channel_count, kSampleRate)};
 }
 
 template <size_t N>
@@ -136,6 +137,11 @@ class TestAudioRenderer : public AudioRendererCommon {
     AudioRendererCommon::Stop();
   }
 
+  using AudioRendererCommon::BufferAllocationCount;
+  using AudioRendererCommon::GetMixBuffer;
+  using AudioRendererCommon::OnAppendDropped;
+  using AudioRendererCommon::SetDeviceFormat;
+
   MOCK_METHOD2(InitDevice, bool(std::shared_ptr<DecodedFrame>, double));
   MOCK_METHOD2(AppendBuffer, bool(const uint8_t*, size_t));
   MOCK_METHOD0(ClearBuffer, void());
@@ -270,6 +276,29 @@ TEST_F(AudioRendererCommonTest, StopsOnError) {
   util::Clock::Instance.SleepSeconds(0.1);
 }
 
+TEST_F(AudioRendererCommonTest, ResyncsAfterDroppedData) {
+  auto info = MakeStreamInfo();
+  stream.AddFrame(MakeFrame(info, 0, kData1));
+
+  ThreadEvent<void> did_append("");
+  {
+    InSequence seq;
+    EXPECT_CALL(renderer, ClearBuffer()).Times(1);
+    EXPECT_CALL(renderer, AppendBuffer(kData1, sizeof(kData1)))
+        .WillOnce(InvokeWithoutArgs([&]() {
+          renderer.OnAppendDropped();
+          return true;
+        }));
+    // The frame is written again after clearing the device.
+    EXPECT_CALL(renderer, ClearBuffer()).Times(1);
+    EXPECT_CALL(renderer, AppendBuffer(kData1, sizeof(kData1)))
+        .WillOnce(SignalAndReturn(did_append, true));
+  }
+
+  renderer.Attach(&stream);
+  WAIT_WITH_TIMEOUT(did_append);
+}
+
 TEST_F(AudioRendererCommonTest, StopsAfterEnoughBuffered) {
   auto info = MakeStreamInfo();
   stream.AddFrame(MakeFrame(info, 0, kData1));
@@ -299,6 +328,75 @@ TEST_F(AudioRendererCommonTest, StopsAfterEnoughBuffered) {
   WAIT_WITH_TIMEOUT(did_append);
 }
 
+TEST_F(AudioRendererCommonTest, UsesBufferSize) {
+  auto info = MakeStreamInfo();
+  stream.AddFrame(MakeFrame(info, 0, kData1));
+  stream.AddFrame(MakeFrame(info, 2, kData2));
+
+  ThreadEvent<void> did_sleep("");
+  ThreadEvent<void> done("");
+  {
+    InSequence seq;
+    EXPECT_CALL(renderer, GetBytesBuffered()).WillRepeatedly(Return(0));
+    EXPECT_CALL(renderer, AppendBuffer(kData1, sizeof(kData1))).Times(1);
+    // One second is buffered, which is more than the buffer size.
+    EXPECT_CALL(renderer, GetBytesBuffered()).WillRepeatedly(Return(2));
+  }
+  EXPECT_CALL(clock, SleepSeconds(DoubleEq(0.5)))
+      .WillOnce(InvokeWithoutArgs([&]() { did_sleep.SignalAll(); }))
+      .WillRepeatedly(Return());
+  EXPECT_CALL(renderer, AppendBuffer(kData2, sizeof(kData2))).Times(0);
+
+  renderer.SetBufferSize(0.5);
+  renderer.Attach(&stream);
+  WAIT_WITH_TIMEOUT(did_sleep);
+}
+
+TEST_F(AudioRendererCommonTest, PublishesDeviceTime) {
+  auto info = MakeStreamInfo();
+  stream.AddFrame(MakeFrame(info, 0, kData1));
+
+  ThreadEvent<void> did_sleep("");
+  ThreadEvent<void> done("");
+  {
+    InSequence seq;
+    EXPECT_CALL(renderer, GetBytesBuffered()).WillRepeatedly(Return(0));
+    EXPECT_CALL(renderer, AppendBuffer(kData1, sizeof(kData1))).Times(1);
+    // Two seconds were written and one second is still buffered.
+    EXPECT_CALL(renderer, GetBytesBuffered()).WillRepeatedly(Return(2));
+  }
+  // Keep the renderer thread in the first sleep so it doesn't publish again.
+  EXPECT_CALL(clock, SleepSeconds(_))
+      .WillOnce(InvokeWithoutArgs([&]() {
+        did_sleep.SignalAll();
+        done.GetValue();
+      }))
+      .WillRepeatedly(Return());
+
+  double time;
+  EXPECT_FALSE(renderer.GetDeviceTime(&time));
+  renderer.SetBufferSize(0.5);
+  renderer.Attach(&stream);
+  WAIT_WITH_TIMEOUT(did_sleep);
+
+  EXPECT_TRUE(renderer.GetDeviceTime(&time));
+  EXPECT_EQ(1, time);
+  EXPECT_CALL(clock, GetMonotonicTime()).WillRepeatedly(Return(500));
+  EXPECT_TRUE(renderer.GetDeviceTime(&time));
+  EXPECT_EQ(1.5, time);
+  // The time doesn't go past the written audio.
+  EXPECT_CALL(clock, GetMonotonicTime()).WillRepeatedly(Return(5000));
+  EXPECT_TRUE(renderer.GetDeviceTime(&time));
+  EXPECT_EQ(2, time);
+
+  ON_CALL(player, PlaybackState())
+      .WillByDefault(Return(VideoPlaybackState::Paused));
+  player_client->OnPlaybackStateChanged(VideoPlaybackState::Playing,
+                                        VideoPlaybackState::Paused);
+  EXPECT_FALSE(renderer.GetDeviceTime(&time));
+  done.SignalAll();
+}
+
 TEST_F(AudioRendererCommonTest, InjectsSilenceBetweenFrames) {
   auto info = MakeStreamInfo();
   stream.AddFrame(MakeFrame(info, 0, kData1));
@@ -367,9 +465,47 @@ TEST_F(AudioRendererCommonTest, HandlesPlanarFormats) {
   WAIT_WITH_TIMEOUT(did_append);
 }
 
-TEST_F(AudioRendererCommonTest, ResetsDeviceForNewStream) {
+TEST_F(AudioRendererCommonTest, ReusesBufferForPlanarFormats) {
+  // 2 Channels, 4 bytes-per-sample, 3 samples; so each frame is 1.5 seconds.
+  const uint8_t data[12] = {0};
+  std::shared_ptr<StreamInfo> info(
+      new StreamInfo("", "", false, {0, 0}, {0, 0}, {}, 0, 0, 2, kSampleRate));
+  for (int i = 0; i < 4; i++) {
+    stream.AddFrame(std::shared_ptr<DecodedFrame>(
+        new DecodedFrame(info, i * 1.5, i * 1.5, 1.5, SampleFormat::PlanarS32,
+                         0, {data, data}, {sizeof(data), sizeof(data)})));
+  }
+
+  ThreadEvent<void> did_append("");
+  {
+    InSequence seq;
+    EXPECT_CALL(renderer, AppendBuffer(_, sizeof(data) * 2)).Times(3);
+    EXPECT_CALL(renderer, AppendBuffer(_, sizeof(data) * 2))
+        .WillOnce(SignalAndReturn(did_append, true));
+  }
+
+  renderer.Attach(&stream);
+  WAIT_WITH_TIMEOUT(did_append);
+  // Only the first frame should need to allocate.
+  EXPECT_EQ(renderer.BufferAllocationCount(), 1u);
+}
+
+TEST_F(AudioRendererCommonTest, ReusesMixBuffer) {
+  EXPECT_EQ(renderer.BufferAllocationCount(), 0u);
+  uint8_t* buffer = renderer.GetMixBuffer(16);
+  EXPECT_EQ(renderer.BufferAllocationCount(), 1u);
+
+  EXPECT_EQ(renderer.GetMixBuffer(8), buffer);
+  EXPECT_EQ(renderer.GetMixBuffer(16), buffer);
+  EXPECT_EQ(renderer.BufferAllocationCount(), 1u);
+
+  renderer.GetMixBuffer(32);
+  EXPECT_EQ(renderer.BufferAllocationCount(), 2u);
+}
+
+TEST_F(AudioRendererCommonTest, ResetsDeviceForNewFormat) {
   auto info1 = MakeStreamInfo();
-  auto info2 = MakeStreamInfo();
+  auto info2 = MakeStreamInfo(/* channel_count= */ 2);
   auto frame1 = MakeFrame(info1, 0, kData1);
   auto frame2 = MakeFrame(info2, 2, kData2);
   stream.AddFrame(frame1);
@@ -385,7 +521,7 @@ TEST_F(AudioRendererCommonTest, ResetsDeviceForNewStream) {
     // synchronize the new frame.
     EXPECT_CALL(player, CurrentTime()).WillRepeatedly(Return(1));
     EXPECT_CALL(renderer, InitDevice(frame2, 1)).Times(1);
-    EXPECT_CALL(renderer, AppendBuffer(_, 2)).Times(1);  // Silence
+    EXPECT_CALL(renderer, AppendBuffer(_, 4)).Times(1);  // Silence
     EXPECT_CALL(renderer, AppendBuffer(kData2, sizeof(kData2)))
         .WillOnce(SignalAndReturn(did_append, true));
     EXPECT_CALL(player, CurrentTime()).WillRepeatedly(Return(4));
@@ -395,6 +531,92 @@ TEST_F(AudioRendererCommonTest, ResetsDeviceForNewStream) {
   WAIT_WITH_TIMEOUT(did_append);
 }
 
+TEST_F(AudioRendererCommonTest, KeepsDeviceForNewStreamWithSameFormat) {
+  // For example, the next period or an ad; the device shouldn't be reopened
+  // if it can play the new stream as-is.
+  auto info1 = MakeStreamInfo();
+  auto info2 = MakeStreamInfo();
+  auto frame1 = MakeFrame(info1, 0, kData1);
+  auto frame2 = MakeFrame(info2, 2, kData2);
+  stream.AddFrame(frame1);
+  stream.AddFrame(frame2);
+
+  ThreadEvent<void> did_append("");
+  {
+    InSequence seq;
+    EXPECT_CALL(renderer, InitDevice(frame1, 1)).Times(1);
+    EXPECT_CALL(renderer, AppendBuffer(kData1, sizeof(kData1))).Times(1);
+    EXPECT_CALL(renderer, AppendBuffer(kData2, sizeof(kData2)))
+        .WillOnce(SignalAndReturn(did_append, true));
+  }
+
+  renderer.Attach(&stream);
+  WAIT_WITH_TIMEOUT(did_append);
+}
+
+TEST_F(AudioRendererCommonTest, KeepsDeviceWhenConverting) {
+  auto info1 = MakeStreamInfo();
+  auto info2 = MakeStreamInfo();
+  auto frame1 = MakeFrame(info1, 0, kData1);
+  auto frame2 = MakeFrame(info2, 2, kData2);
+  stream.AddFrame(frame1);
+  stream.AddFrame(frame2);
+
+  // The frames are converted from PackedU8 to PackedS16, so each sample is two
+  // bytes.  Since the device can play any format, it isn't reset for the new
+  // stream.
+  ThreadEvent<void> did_append("");
+  {
+    InSequence seq;
+    EXPECT_CALL(renderer, InitDevice(frame1, 1))
+        .WillOnce(InvokeWithoutArgs([&]() {
+          renderer.SetDeviceFormat(SampleFormat::PackedS16, kSampleRate, 1);
+          return true;
+        }));
+    EXPECT_CALL(renderer, AppendBuffer(_, sizeof(kData1) * 2)).Times(1);
+    EXPECT_CALL(renderer, AppendBuffer(_, sizeof(kData2) * 2))
+        .WillOnce(SignalAndReturn(did_append, true));
+  }
+
+  renderer.Attach(&stream);
+  WAIT_WITH_TIMEOUT(did_append);
+}
+
+TEST_F(AudioRendererCommonTest, MutesOtherRatesWithoutConversion) {
+  ON_CALL(player, PlaybackRate()).WillByDefault(Return(1.25));
+  stream.AddFrame(MakeFrame(MakeStreamInfo(), 0, kData1));
+
+  ThreadEvent<void> did_init("");
+  EXPECT_CALL(renderer, InitDevice(_, _))
+      .WillOnce(SignalAndReturn(did_init, true));
+  EXPECT_CALL(renderer, AppendBuffer(_, _)).Times(0);
+
+  renderer.Attach(&stream);
+  WAIT_WITH_TIMEOUT(did_init);
+  util::Clock::Instance.SleepSeconds(0.01);
+}
+
+TEST_F(AudioRendererCommonTest, StretchesOtherRatesWhenConverting) {
+  ON_CALL(player, PlaybackRate()).WillByDefault(Return(1.25));
+  auto info = MakeStreamInfo();
+  for (int i = 0; i < 8; i++)
+    stream.AddFrame(MakeFrame(info, i * 2, kData1));
+
+  ThreadEvent<void> did_append("");
+  EXPECT_CALL(renderer, InitDevice(_, _)).WillOnce(InvokeWithoutArgs([&]() {
+    renderer.SetDeviceFormat(SampleFormat::PackedS16, kSampleRate, 1);
+    return true;
+  }));
+  EXPECT_CALL(renderer, SetDeviceState(true)).Times(AtLeast(1));
+  EXPECT_CALL(renderer, SetDeviceState(false)).Times(0);
+  EXPECT_CALL(renderer, AppendBuffer(_, _))
+      .WillOnce(SignalAndReturn(did_append, true))
+      .WillRepeatedly(Return(true));
+
+  renderer.Attach(&stream);
+  WAIT_WITH_TIMEOUT(did_append);
+}
+
 TEST_F(AudioRendererCommonTest, HandlesSeeks) {
   auto info = MakeStreamInfo();
   stream.AddFrame(MakeFrame(info, 0, kData1));
@@ -472,5 +694,50 @@ TEST_F(AudioRendererCommonTest, HandlesSeeks) {
   WAIT_WITH_TIMEOUT(on_done);
 }
 
+TEST_F(AudioRendererCommonTest, PrerollsWhilePaused) {
+  auto info = MakeStreamInfo();
+  stream.AddFrame(MakeFrame(info, 0, kData1));
+  stream.AddFrame(MakeFrame(info, 2, kData2));
+
+  VideoPlaybackState state = VideoPlaybackState::Paused;
+  size_t buffered = 0;
+  ON_CALL(player, PlaybackState()).WillByDefault(ReturnPointee(&state));
+  ON_CALL(renderer, GetBytesBuffered()).WillByDefault(ReturnPointee(&buffered));
+
+  ThreadEvent<void> did_append("");
+  ThreadEvent<void> did_play("");
+  EXPECT_CALL(renderer, SetDeviceState(false)).Times(AtLeast(1));
+  {
+    InSequence seq;
+    // The device is filled while paused, then played without clearing it.
+    EXPECT_CALL(renderer, ClearBuffer()).Times(1);
+    EXPECT_CALL(renderer, InitDevice(_, _)).Times(1);
+    EXPECT_CALL(renderer, AppendBuffer(kData1, sizeof(kData1)))
+        .WillOnce(InvokeWithoutArgs([&]() {
+          buffered = 4;
+          return true;
+        }));
+    EXPECT_CALL(renderer, AppendBuffer(kData2, sizeof(kData2)))
+        .WillOnce(InvokeWithoutArgs([&]() {
+          buffered = 8;
+          did_append.SignalAll();
+          return true;
+        }));
+    EXPECT_CALL(renderer, SetDeviceState(true))
+        .WillOnce(InvokeWithoutArgs([&]() { did_play.SignalAll(); }))
+        .WillRepeatedly(Return());
+  }
+
+  renderer.SetPrerollWhilePaused(true);
+  renderer.Attach(&stream);
+  WAIT_WITH_TIMEOUT(did_append);
+
+  state = VideoPlaybackState::Playing;
+  player_client->OnPlaybackStateChanged(VideoPlaybackState::Paused,
+                                        VideoPlaybackState::Playing);
+  WAIT_WITH_TIMEOUT(did_play);
+  renderer.Stop();
+}
+
 }  // namespace media
 }  // namespace shaka
@@ -0,0 +1,201 @@
+// Copyright 2020 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     https://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "src/media/caption_extractor.h"
+
+#include <gtest/gtest.h>
+
+#include <list>
+#include <memory>
+#include <vector>
+
+#include "shaka/eme/configuration.h"
+#include "shaka/media/stream_info.h"
+
+namespace shaka {
+namespace media {
+
+namespace {
+
+// An avcC record with 4-byte NAL unit lengths.
+const std::vector<uint8_t> kAvcConfig = {1, 0x64, 0, 0x1f, 0xff, 0xe0, 0};
+
+std::shared_ptr<const StreamInfo> MakeStreamInfo(
+    const std::string& codec, const std::vector<uint8_t>& extra_data) {
+  return std::shared_ptr<const StreamInfo>(
+      new StreamInfo("video/mp4", codec, true, {1, 1000}, {0, 0}, extra_data,
+                     640, 480, 0, 0));
+}
+
+/** Creates an SEI NAL unit (without a length or start code) with cc_data. */
+std::vector<uint8_t> MakeSei(const std::vector<uint8_t>& nal_header,
+                             const std::vector<uint8_t>& cc_triplets) {
+  std::vector<uint8_t> payload = {0xb5, 0x00, 0x31, 'G', 'A', '9', '4', 0x03};
+  payload.push_back(static_cast<uint8_t>(0x40 | (cc_triplets.size() / 3)));
+  payload.push_back(0xff);  // em_data
+  payload.insert(payload.end(), cc_triplets.begin(), cc_triplets.end());
+
+  std::vector<uint8_t> rbsp = {4, static_cast<uint8_t>(payload.size())};
+  rbsp.insert(rbsp.end(), payload.begin(), payload.end());
+  rbsp.push_back(0x80);
+
+  // Add emulation prevention bytes.
+  std::vector<uint8_t> ret = nal_header;
+  size_t zeros = 0;
+  for (uint8_t byte : rbsp) {
+    if (zeros >= 2 && byte <= 3) {
+      ret.push_back(3);
+      zeros = 0;
+    }
+    ret.push_back(byte);
+    zeros = byte == 0 ? zeros + 1 : 0;
+  }
+  return ret;
+}
+
+/** Adds a 4-byte length before the given NAL unit. */
+void AppendWithLength(const std::vector<uint8_t>& nal,
+                      std::vector<uint8_t>* frame) {
+  const uint32_t size = nal.size();
+  frame->push_back(static_cast<uint8_t>(size >> 24));
+  frame->push_back(static_cast<uint8_t>(size >> 16));
+  frame->push_back(static_cast<uint8_t>(size >> 8));
+  frame->push_back(static_cast<uint8_t>(size));
+  frame->insert(frame->end(), nal.begin(), nal.end());
+}
+
+class CaptionExtractorTest : public testing::Test {
+ protected:
+  std::shared_ptr<EncodedFrame> MakeFrame(
+      std::shared_ptr<const StreamInfo> info, double pts,
+      const std::vector<uint8_t>& data,
+      std::shared_ptr<eme::FrameEncryptionInfo> encryption_info = nullptr) {
+    buffers_.emplace_back(data);
+    const std::vector<uint8_t>& buffer = buffers_.back();
+    return std::make_shared<EncodedFrame>(info, pts, pts, 1, true,
+                                          buffer.data(), buffer.size(), 0,
+                                          encryption_info);
+  }
+
+  std::vector<CaptionExtractor::BytePair> Extract(const EncodedFrame& frame) {
+    std::vector<CaptionExtractor::BytePair> ret;
+    CaptionExtractor::ExtractBytePairs(frame, &ret);
+    return ret;
+  }
+
+  // Holds the frame data for the frames.
+  std::list<std::vector<uint8_t>> buffers_;
+};
+
+}  // namespace
+
+TEST_F(CaptionExtractorTest, ExtractsFromH264) {
+  std::vector<uint8_t> data;
+  AppendWithLength({0x65, 1, 2, 3}, &data);  // A slice.
+  // The first triplet is invalid; the second is CEA-708; the zeros need an
+  // emulation prevention byte.
+  AppendWithLength(MakeSei({0x06}, {0x00, 0x00, 0x00, 0x03, 0x00, 0x00, 0xfc,
+                                    'H', 'I', 0xfc, 0x94, 0x2f}),
+                   &data);
+  auto frame = MakeFrame(MakeStreamInfo("avc1.64001f", kAvcConfig), 2, data);
+
+  auto pairs = Extract(*frame);
+  ASSERT_EQ(2u, pairs.size());
+  EXPECT_EQ(2, pairs[0].pts);
+  EXPECT_EQ('H', pairs[0].byte1);
+  EXPECT_EQ('I', pairs[0].byte2);
+  EXPECT_EQ(0x94, pairs[1].byte1);
+  EXPECT_EQ(0x2f, pairs[1].byte2);
+}
+
+TEST_F(CaptionExtractorTest, ExtractsFromAnnexB) {
+  std::vector<uint8_t> data = {0, 0, 0, 1, 0x09, 0xf0, 0, 0, 1};
+  const std::vector<uint8_t> sei = MakeSei({0x06}, {0xfc, 'A', 'B'});
+  data.insert(data.end(), sei.begin(), sei.end());
+  auto frame = MakeFrame(MakeStreamInfo("h264", {}), 0, data);
+
+  auto pairs = Extract(*frame);
+  ASSERT_EQ(1u, pairs.size());
+  EXPECT_EQ('A', pairs[0].byte1);
+}
+
+TEST_F(CaptionExtractorTest, ExtractsFromHevc) {
+  std::vector<uint8_t> config(23);
+  config[0] = 1;
+  config[21] = 0x3;
+  std::vector<uint8_t> data;
+  AppendWithLength(MakeSei({39 << 1, 1}, {0xfc, 'A', 'B'}), &data);
+  auto frame = MakeFrame(MakeStreamInfo("hvc1.1.6.L93.90", config), 0, data);
+
+  EXPECT_EQ(1u, Extract(*frame).size());
+  // Other codecs are ignored.
+  auto other = MakeFrame(MakeStreamInfo("vp09.00.10.08", config), 0, data);
+  EXPECT_EQ(0u, Extract(*other).size());
+}
+
+TEST_F(CaptionExtractorTest, OnlyReadsClearData) {
+  std::vector<uint8_t> data;
+  AppendWithLength(MakeSei({0x06}, {0xfc, 'A', 'B'}), &data);
+  const uint32_t size = data.size();
+  auto info = MakeStreamInfo("avc1.64001f", kAvcConfig);
+
+  auto clear = MakeFrame(
+      info, 0, data,
+      std::make_shared<eme::FrameEncryptionInfo>(
+          eme::EncryptionScheme::AesCtr, eme::EncryptionPattern(0, 0),
+          std::vector<uint8_t>(16, 1), std::vector<uint8_t>(16, 2),
+          std::vector<eme::SubsampleInfo>{{size, 0}}));
+  EXPECT_EQ(1u, Extract(*clear).size());
+
+  auto encrypted = MakeFrame(
+      info, 0, data,
+      std::make_shared<eme::FrameEncryptionInfo>(
+          eme::EncryptionScheme::AesCtr, eme::EncryptionPattern(0, 0),
+          std::vector<uint8_t>(16, 1), std::vector<uint8_t>(16, 2),
+          std::vector<eme::SubsampleInfo>{{5, size - 5}}));
+  EXPECT_EQ(0u, Extract(*encrypted).size());
+}
+
+TEST_F(CaptionExtractorTest, DecodesInPresentationOrder) {
+  auto info = MakeStreamInfo("avc1.64001f", kAvcConfig);
+  auto make_frame = [&](double pts, std::vector<uint8_t> triplets) {
+    std::vector<uint8_t> data;
+    AppendWithLength(MakeSei({0x06}, triplets), &data);
+    return MakeFrame(info, pts, data);
+  };
+  // Resume caption loading, "Hi", end of caption, then erase the display.  The
+  // frames are in decode order, so the pts aren't in order.
+  std::vector<std::shared_ptr<EncodedFrame>> frames = {
+      make_frame(0, {0xfc, 0x94, 0x20}),
+      make_frame(2, {0xfc, 0x94, 0x2f}),
+      make_frame(1, {0xfc, 'H', 'i'}),
+      make_frame(4, {0xfc, 0x94, 0x2c}),
+  };
+
+  CaptionExtractor extractor;
+  std::vector<std::shared_ptr<VTTCue>> cues;
+  extractor.Process(frames, &cues);
+  ASSERT_EQ(1u, cues.size());
+  EXPECT_EQ(2, cues[0]->start_time());
+  EXPECT_EQ(4, cues[0]->end_time());
+  EXPECT_EQ("Hi", cues[0]->text());
+
+  // Appending the same segment again doesn't duplicate the cues.
+  cues.clear();
+  extractor.Process(frames, &cues);
+  EXPECT_TRUE(cues.empty());
+}
+
+}  // namespace media
+}  // namespace shaka
@@ -0,0 +1,160 @@
+// Copyright 2020 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     https://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "src/media/cea608_decoder.h"
+
+#include <gtest/gtest.h>
+
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace shaka {
+namespace media {
+
+namespace {
+
+// Control codes for CC1.
+constexpr const uint8_t kMisc = 0x14;
+constexpr const uint8_t kResumeCaptionLoading = 0x20;
+constexpr const uint8_t kRollUp2 = 0x25;
+constexpr const uint8_t kEraseDisplayed = 0x2c;
+constexpr const uint8_t kCarriageReturn = 0x2d;
+constexpr const uint8_t kEndOfCaption = 0x2f;
+// Preamble address code for row 15, column 0.
+constexpr const uint8_t kRow15[] = {0x14, 0x60};
+
+class Cea608DecoderTest : public testing::Test {
+ protected:
+  /** Sends the given control code twice, like an encoder would. */
+  void Control(double time, uint8_t byte1, uint8_t byte2) {
+    decoder_.Decode(time, byte1, byte2, &cues_);
+    decoder_.Decode(time, byte1, byte2, &cues_);
+  }
+
+  void Text(double time, const std::string& text) {
+    for (size_t i = 0; i < text.size(); i += 2) {
+      decoder_.Decode(time, text[i], i + 1 < text.size() ? text[i + 1] : 0,
+                      &cues_);
+    }
+  }
+
+  void ExpectCue(size_t index, double start, double end,
+                 const std::string& text) {
+    ASSERT_LT(index, cues_.size());
+    EXPECT_EQ(start, cues_[index]->start_time());
+    EXPECT_EQ(end, cues_[index]->end_time());
+    EXPECT_EQ(text, cues_[index]->text());
+  }
+
+  Cea608Decoder decoder_;
+  std::vector<std::shared_ptr<VTTCue>> cues_;
+};
+
+}  // namespace
+
+TEST_F(Cea608DecoderTest, PopOnCaptions) {
+  Control(0, kMisc, kResumeCaptionLoading);
+  Control(0, kRow15[0], kRow15[1]);
+  Text(0, "Hello");
+  // Nothing is shown until the memories are flipped.
+  EXPECT_TRUE(cues_.empty());
+  Control(1, kMisc, kEndOfCaption);
+  EXPECT_TRUE(cues_.empty());
+
+  // The next caption is loaded while the first is shown.
+  Control(2, kMisc, kResumeCaptionLoading);
+  Control(2, 0x13, 0x60);  // Row 13.
+  Text(2, "Two");
+  Control(2, kRow15[0], kRow15[1]);
+  Text(2, "lines");
+  Control(3, kMisc, kEndOfCaption);
+  Control(5, kMisc, kEraseDisplayed);
+
+  ASSERT_EQ(2u, cues_.size());
+  ExpectCue(0, 1, 3, "Hello");
+  ExpectCue(1, 3, 5, "Two\nlines");
+}
+
+TEST_F(Cea608DecoderTest, RollUpCaptions) {
+  Control(0, kMisc, kRollUp2);
+  Control(0, kRow15[0], kRow15[1]);
+  Text(1, "One");
+  Control(2, kMisc, kCarriageReturn);
+  Text(2.5, "Two");
+  Control(3, kMisc, kCarriageReturn);
+  Text(3, "Three");
+  Control(4, kMisc, kCarriageReturn);
+
+  ASSERT_EQ(3u, cues_.size());
+  ExpectCue(0, 1, 2, "One");
+  ExpectCue(1, 2, 3, "One\nTwo");
+  // Only two rows are shown, so the first row scrolled off.
+  ExpectCue(2, 3, 4, "Two\nThree");
+}
+
+TEST_F(Cea608DecoderTest, IgnoresRepeatedControlCodes) {
+  Control(0, kMisc, kResumeCaptionLoading);
+  Text(0, "A");
+  Control(1, kMisc, kEndOfCaption);
+  // A third copy of a control code isn't a repeat.
+  decoder_.Decode(2, kMisc, kEndOfCaption, &cues_);
+  Control(3, kMisc, kEraseDisplayed);
+
+  ASSERT_EQ(1u, cues_.size());
+  ExpectCue(0, 1, 2, "A");
+}
+
+TEST_F(Cea608DecoderTest, SpecialCharacters) {
+  Control(0, kMisc, kResumeCaptionLoading);
+  // Extended characters replace the character before them.
+  Text(0, "caf");
+  decoder_.Decode(0, 'E', 0, &cues_);
+  Control(0, 0x12, 0x21);  // Capital E with acute.
+  Text(0, " ");
+  Control(0, 0x11, 0x37);  // Music note.
+  Text(0, "*");  // Basic characters include some accented letters.
+  Control(1, kMisc, kEndOfCaption);
+  Control(2, kMisc, kEraseDisplayed);
+
+  ASSERT_EQ(1u, cues_.size());
+  ExpectCue(0, 1, 2, "caf\u00c9 \u266a\u00e1");
+}
+
+TEST_F(Cea608DecoderTest, IgnoresOtherChannels) {
+  // Parity bits are ignored.
+  Control(0, 0x94, 0x20);
+  Text(0, "A");
+  // Switch to CC2, which uses a different first byte.
+  Control(0, 0x1c, kResumeCaptionLoading);
+  Text(0, "B");
+  Control(1, 0x1c, kEndOfCaption);
+  Control(2, kMisc, kEndOfCaption);
+  Control(3, kMisc, kEraseDisplayed);
+
+  ASSERT_EQ(1u, cues_.size());
+  ExpectCue(0, 2, 3, "A");
+}
+
+TEST_F(Cea608DecoderTest, Reset) {
+  Control(0, kMisc, kResumeCaptionLoading);
+  Text(0, "A");
+  Control(1, kMisc, kEndOfCaption);
+  decoder_.Reset();
+  Control(2, kMisc, kEraseDisplayed);
+  EXPECT_TRUE(cues_.empty());
+}
+
+}  // namespace media
+}  // namespace shaka
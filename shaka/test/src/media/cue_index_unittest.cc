@@ -0,0 +1,142 @@
+// Copyright 2020 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     https://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "src/media/cue_index.h"
+
+#include <gmock/gmock.h>
+#include <gtest/gtest.h>
+#include <math.h>
+
+#include <memory>
+#include <random>
+#include <vector>
+
+namespace shaka {
+namespace media {
+
+namespace {
+
+using testing::ElementsAre;
+
+std::shared_ptr<VTTCue> MakeCue(double start, double end) {
+  return std::make_shared<VTTCue>(start, end, "");
+}
+
+}  // namespace
+
+TEST(CueIndexTest, FindsActiveCues) {
+  auto first = MakeCue(0, 10);
+  auto second = MakeCue(5, 15);
+  auto third = MakeCue(20, 30);
+  CueIndex index;
+  index.Add(first);
+  index.Add(second);
+  index.Add(third);
+
+  EXPECT_THAT(index.ActiveCues(0), ElementsAre(first));
+  EXPECT_THAT(index.ActiveCues(7), ElementsAre(first, second));
+  EXPECT_THAT(index.ActiveCues(10), ElementsAre(first, second));
+  EXPECT_THAT(index.ActiveCues(17), ElementsAre());
+  EXPECT_THAT(index.ActiveCues(30), ElementsAre(third));
+  EXPECT_THAT(index.ActiveCues(31), ElementsAre());
+}
+
+TEST(CueIndexTest, SortsCuesAddedOutOfOrder) {
+  auto first = MakeCue(0, 10);
+  auto second = MakeCue(5, 15);
+  CueIndex index;
+  index.Add(second);
+  index.Add(first);
+
+  EXPECT_THAT(index.ActiveCues(7), ElementsAre(first, second));
+}
+
+TEST(CueIndexTest, RemovesCues) {
+  auto first = MakeCue(0, 10);
+  auto second = MakeCue(5, 15);
+  CueIndex index;
+  index.Add(first);
+  index.Add(second);
+  index.Remove(first);
+
+  EXPECT_THAT(index.ActiveCues(7), ElementsAre(second));
+  EXPECT_EQ(15, index.NextChangeTime(7));
+}
+
+TEST(CueIndexTest, SeesChangedTimes) {
+  auto cue = MakeCue(0, 10);
+  CueIndex index;
+  index.Add(cue);
+  EXPECT_THAT(index.ActiveCues(5), ElementsAre(cue));
+
+  cue->SetStartTime(20);
+  cue->SetEndTime(30);
+  EXPECT_THAT(index.ActiveCues(5), ElementsAre());
+  EXPECT_THAT(index.ActiveCues(25), ElementsAre(cue));
+}
+
+TEST(CueIndexTest, FindsNextChangeTime) {
+  CueIndex index;
+  EXPECT_EQ(INFINITY, index.NextChangeTime(0));
+
+  index.Add(MakeCue(0, 10));
+  index.Add(MakeCue(5, 15));
+  index.Add(MakeCue(20, 30));
+  EXPECT_EQ(5, index.NextChangeTime(0));
+  EXPECT_EQ(10, index.NextChangeTime(5));
+  EXPECT_EQ(15, index.NextChangeTime(10));
+  EXPECT_EQ(20, index.NextChangeTime(15));
+  EXPECT_EQ(30, index.NextChangeTime(20));
+  EXPECT_EQ(INFINITY, index.NextChangeTime(30));
+}
+
+TEST(CueIndexTest, MatchesLinearSearch) {
+  std::mt19937 rand(1234);
+  std::uniform_real_distribution<double> start_dist(0, 1000);
+  std::uniform_real_distribution<double> length_dist(0, 20);
+
+  CueIndex index;
+  std::vector<std::shared_ptr<VTTCue>> cues;
+  for (int i = 0; i < 2000; i++) {
+    const double start = start_dist(rand);
+    cues.emplace_back(MakeCue(start, start + length_dist(rand)));
+    index.Add(cues.back());
+  }
+  // Add a long cue to check it doesn't hide the others.
+  cues.emplace_back(MakeCue(0, 2000));
+  index.Add(cues.back());
+
+  for (double time = 0; time < 1020; time += 0.7) {
+    std::vector<VTTCue*> expected;
+    double next_time = INFINITY;
+    for (auto& cue : cues) {
+      if (cue->start_time() <= time && cue->end_time() >= time)
+        expected.emplace_back(cue.get());
+      if (cue->start_time() > time)
+        next_time = std::min(next_time, cue->start_time());
+      else if (cue->end_time() > time)
+        next_time = std::min(next_time, cue->end_time());
+    }
+
+    std::vector<VTTCue*> actual;
+    for (auto& cue : index.ActiveCues(time))
+      actual.emplace_back(cue.get());
+    EXPECT_THAT(actual, testing::UnorderedElementsAreArray(expected))
+        << "At " << time;
+    EXPECT_EQ(next_time, index.NextChangeTime(time)) << "At " << time;
+  }
+}
+
+}  // namespace media
+}  // namespace shaka
@@ -13,8 +13,12 @@
 // limitations under the License.
 
 #include <gmock/gmock.h>
+#include <glog/logging.h>
 #include <gtest/gtest.h>
 
+#include <algorithm>
+#include <chrono>
+
 extern "C" {
 #include <libavutil/imgutils.h>
 }
@@ -28,6 +32,10 @@ extern "C" {
 #include "src/test/media_files.h"
 #include "src/util/crypto.h"
 
+#ifdef HAS_FFMPEG_DECODER
+#  include "src/media/ffmpeg/ffmpeg_decoder.h"
+#endif
+
 namespace shaka {
 namespace media {
 
@@ -176,6 +184,100 @@ TEST_F(DecoderIntegration, CanDecodeWithAdaptation) {
   EXPECT_TRUE(saw_second_stream);
 }
 
+#ifdef HAS_FFMPEG_DECODER
+TEST_F(DecoderIntegration, ReusesFrameBuffers) {
+  std::vector<std::shared_ptr<EncodedFrame>> frames;
+  ASSERT_NO_FATAL_FAILURE(DemuxFiles({kMp4LowInit, kMp4LowSeg}, &frames));
+
+  ffmpeg::FFmpegDecoder decoder;
+  for (size_t i = 0; i <= frames.size(); i++) {
+    auto frame = i < frames.size() ? frames[i] : nullptr;
+    std::string error;
+    // The decoded frames are dropped right away, so their buffers should be
+    // reused for later frames.
+    std::vector<std::shared_ptr<DecodedFrame>> decoded_frames;
+    ASSERT_EQ(decoder.Decode(frame, nullptr, &decoded_frames, &error),
+              MediaStatus::Success)
+        << error;
+  }
+
+  const ffmpeg::FFmpegFramePool::Stats stats = decoder.GetFramePoolStats();
+  EXPECT_GT(stats.buffer_reuses, 0u);
+  EXPECT_LT(stats.buffer_allocations, frames.size());
+  EXPECT_GT(stats.frame_reuses, 0u);
+  EXPECT_EQ(stats.idle_bytes > 0, stats.idle_buffers > 0);
+}
+#endif
+
+TEST(DecoderOptionsTest, GetThreading) {
+  DecoderOptions options;
+  options.threading.thread_count = 2;
+  DecoderThreadingOptions hevc;
+  hevc.thread_count = 4;
+  hevc.thread_type = DecoderThreadType::Frame;
+  options.codec_threading["hvc1"] = hevc;
+
+  EXPECT_EQ(2u, options.GetThreading("avc1.42c01e").thread_count);
+  EXPECT_EQ(2u, options.GetThreading("").thread_count);
+  // Aliases of the same codec use the same options.
+  EXPECT_EQ(4u, options.GetThreading("hvc1.1.6.L93.90").thread_count);
+  EXPECT_EQ(4u, options.GetThreading("hev1").thread_count);
+  EXPECT_EQ(DecoderThreadType::Frame,
+            options.GetThreading("hevc").thread_type);
+}
+
+// This is a benchmark of the decoder throughput with different threading
+// configurations.  This is disabled by default; run with
+// --gtest_also_run_disabled_tests to see the results.
+TEST_F(DecoderIntegration, DISABLED_ThreadingBenchmark) {
+  using std::chrono::duration_cast;
+  using std::chrono::microseconds;
+  using std::chrono::steady_clock;
+
+  struct Config {
+    const char* name;
+    uint32_t thread_count;
+    DecoderThreadType thread_type;
+    bool low_delay;
+  };
+  const Config kConfigs[] = {
+      {"auto", 0, DecoderThreadType::Auto, false},
+      {"single", 1, DecoderThreadType::Auto, false},
+      {"frame-4", 4, DecoderThreadType::Frame, false},
+      {"slice-4", 4, DecoderThreadType::Slice, false},
+      {"low-delay", 0, DecoderThreadType::Auto, true},
+  };
+
+  for (const char* file : {kMp4High, kMp4Hevc}) {
+    std::vector<std::shared_ptr<EncodedFrame>> frames;
+    ASSERT_NO_FATAL_FAILURE(DemuxFiles({file}, &frames));
+
+    for (const Config& config : kConfigs) {
+      DecoderOptions options;
+      options.threading.thread_count = config.thread_count;
+      options.threading.thread_type = config.thread_type;
+      options.threading.low_delay = config.low_delay;
+      auto decoder = Decoder::CreateDefaultDecoder(options);
+
+      size_t decoded_count = 0;
+      const auto start = steady_clock::now();
+      for (size_t i = 0; i <= frames.size(); i++) {
+        auto frame = i < frames.size() ? frames[i] : nullptr;
+        std::string error;
+        std::vector<std::shared_ptr<DecodedFrame>> decoded_frames;
+        ASSERT_EQ(decoder->Decode(frame, nullptr, &decoded_frames, &error),
+                  MediaStatus::Success)
+            << error;
+        decoded_count += decoded_frames.size();
+      }
+      const auto us =
+          duration_cast<microseconds>(steady_clock::now() - start).count();
+      EXPECT_EQ(frames.size(), decoded_count);
+      LOG(INFO) << file << " with " << config.name << ": "
+                << (decoded_count * 1e6 / std::max<int64_t>(us, 1)) << " fps";
+    }
+  }
+}
 
 class DecoderDecryptIntegration : public testing::TestWithParam<std::string> {
  protected:
@@ -0,0 +1,120 @@
+// Copyright 2020 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     https://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "src/media/decoding_info_cache.h"
+
+#include <glog/logging.h>
+#include <gtest/gtest.h>
+
+#include <string>
+
+#include "src/test/temp_dir_test.h"
+#include "src/util/file_system.h"
+
+namespace shaka {
+namespace media {
+
+namespace {
+
+MediaDecodingConfiguration MakeConfig(const std::string& content_type) {
+  MediaDecodingConfiguration ret;
+  ret.type = MediaDecodingType::MediaSource;
+  ret.video.content_type = content_type;
+  return ret;
+}
+
+}  // namespace
+
+class DecodingInfoCacheTest : public TempDirTest {
+ public:
+  void SetUp() override {
+    TempDirTest::SetUp();
+    path_ = util::FileSystem::PathJoin(temp_dir_, "cache");
+  }
+
+ protected:
+  /** Gets the result from the cache, counting the queries made. */
+  MediaCapabilitiesInfo Get(DecodingInfoCache* cache,
+                            const MediaDecodingConfiguration& config) {
+    return cache->Get("test", config, [this]() {
+      queries_++;
+      MediaCapabilitiesInfo ret;
+      ret.supported = ret.power_efficient = true;
+      return ret;
+    });
+  }
+
+  std::string path_;
+  int queries_ = 0;
+};
+
+TEST_F(DecodingInfoCacheTest, CachesResults) {
+  DecodingInfoCache cache("1");
+  const auto info =
+      Get(&cache, MakeConfig("video/mp4; codecs=\"avc1.42E01E\""));
+  EXPECT_TRUE(info.supported);
+  EXPECT_FALSE(info.smooth);
+  EXPECT_TRUE(info.power_efficient);
+  EXPECT_EQ(queries_, 1);
+
+  // Equivalent MIME types share an entry.
+  Get(&cache, MakeConfig("video/mp4;codecs=\"avc1.42E01E\""));
+  EXPECT_EQ(queries_, 1);
+
+  // Other configurations are queried again.
+  Get(&cache, MakeConfig("video/mp4; codecs=\"hvc1.1.6.L93.90\""));
+  EXPECT_EQ(queries_, 2);
+  auto config = MakeConfig("video/mp4; codecs=\"avc1.42E01E\"");
+  config.video.width = 1920;
+  Get(&cache, config);
+  EXPECT_EQ(queries_, 3);
+}
+
+TEST_F(DecodingInfoCacheTest, PersistsResults) {
+  const auto config = MakeConfig("video/mp4; codecs=\"avc1.42E01E\"");
+  {
+    DecodingInfoCache cache("1");
+    cache.SetFile(path_);
+    Get(&cache, config);
+    EXPECT_EQ(queries_, 1);
+  }
+  ASSERT_TRUE(fs_.FileExists(path_));
+
+  DecodingInfoCache cache("1");
+  cache.SetFile(path_);
+  const auto info = cache.Get("test", config, []() {
+    ADD_FAILURE() << "Should use the stored result";
+    return MediaCapabilitiesInfo();
+  });
+  EXPECT_TRUE(info.supported);
+  EXPECT_FALSE(info.smooth);
+  EXPECT_TRUE(info.power_efficient);
+}
+
+TEST_F(DecodingInfoCacheTest, IgnoresOtherVersions) {
+  const auto config = MakeConfig("video/mp4; codecs=\"avc1.42E01E\"");
+  {
+    DecodingInfoCache cache("1");
+    cache.SetFile(path_);
+    Get(&cache, config);
+  }
+
+  DecodingInfoCache cache("2");
+  cache.SetFile(path_);
+  Get(&cache, config);
+  EXPECT_EQ(queries_, 2);
+}
+
+}  // namespace media
+}  // namespace shaka
@@ -0,0 +1,173 @@
+// Copyright 2020 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     https://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "src/media/decrypt_thread.h"
+
+#include <gmock/gmock.h>
+#include <gtest/gtest.h>
+
+#include <chrono>
+#include <functional>
+#include <future>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "shaka/eme/implementation.h"
+#include "src/eme/implementation_extensions.h"
+#include "src/media/segment_encoded_frame.h"
+
+namespace shaka {
+namespace media {
+
+namespace {
+
+using ::testing::_;
+using ::testing::Invoke;
+using ::testing::NiceMock;
+using ::testing::Return;
+using ::testing::StrictMock;
+
+constexpr const size_t kFrameSize = 20;
+
+class MockClient : public DecoderThread::Client {
+ public:
+  MOCK_CONST_METHOD0(CurrentTime, double());
+  MOCK_CONST_METHOD0(Duration, double());
+  MOCK_METHOD0(OnWaitingForKey, void());
+  MOCK_METHOD1(OnError, void(const std::string&));
+};
+
+class MockImplementation : public eme::Implementation,
+                           public eme::ImplementationExtensions {
+ public:
+  MockImplementation() : ImplementationExtensions(this) {}
+
+  MOCK_CONST_METHOD2(GetExpiration, bool(const std::string&, int64_t*));
+  MOCK_CONST_METHOD2(GetKeyStatuses,
+                     bool(const std::string&,
+                          std::vector<eme::KeyStatusInfo>*));
+  MOCK_METHOD2(SetServerCertificate, void(eme::EmePromise, eme::Data));
+  MOCK_METHOD5(CreateSessionAndGenerateRequest,
+               void(eme::EmePromise, std::function<void(const std::string&)>,
+                    eme::MediaKeySessionType, eme::MediaKeyInitDataType,
+                    eme::Data));
+  MOCK_METHOD2(Load, void(const std::string&, eme::EmePromise));
+  MOCK_METHOD3(Update, void(const std::string&, eme::EmePromise, eme::Data));
+  MOCK_METHOD2(Close, void(const std::string&, eme::EmePromise));
+  MOCK_METHOD2(Remove, void(const std::string&, eme::EmePromise));
+  MOCK_CONST_METHOD4(Decrypt,
+                     eme::DecryptStatus(const eme::FrameEncryptionInfo*,
+                                        const uint8_t*, size_t, uint8_t*));
+  MOCK_CONST_METHOD2(DecryptSamples, void(eme::DecryptSample*, size_t));
+};
+
+/** A fake decryption that just inverts the bits. */
+void FakeDecrypt(eme::DecryptSample* sample) {
+  for (size_t i = 0; i < sample->data_size; i++)
+    sample->dest[i] = ~sample->data[i];
+  sample->status = eme::DecryptStatus::Success;
+}
+
+/** Adds one-second encrypted frames to the given stream. */
+void AddFrames(std::shared_ptr<EncodedFrameBuffer> buffer,
+               ElementaryStream* stream) {
+  const size_t count = buffer->size() / kFrameSize;
+  for (size_t i = 0; i < count; i++) {
+    auto info = std::make_shared<eme::FrameEncryptionInfo>(
+        eme::EncryptionScheme::AesCtr, eme::EncryptionPattern(0, 0),
+        std::vector<uint8_t>(16, 1), std::vector<uint8_t>(16, 2),
+        std::vector<eme::SubsampleInfo>{{4, 16}});
+    stream->AddFrame(std::make_shared<SegmentEncodedFrame>(
+        nullptr, i, i, 1, true, buffer, i * kFrameSize, kFrameSize, 0, info));
+  }
+}
+
+std::vector<uint8_t> GetFrames(const EncodedFrameBuffer& buffer,
+                               size_t start, size_t end) {
+  return std::vector<uint8_t>(buffer.begin() + start * kFrameSize,
+                              buffer.begin() + end * kFrameSize);
+}
+
+}  // namespace
+
+TEST(DecryptThreadTest, DecryptsAheadOfPlayhead) {
+  auto buffer = std::make_shared<EncodedFrameBuffer>(10 * kFrameSize, 0x0f);
+  ElementaryStream stream;
+  AddFrames(buffer, &stream);
+
+  NiceMock<MockClient> client;
+  StrictMock<MockImplementation> cdm;
+  std::promise<void> done;
+  ON_CALL(client, CurrentTime()).WillByDefault(Return(0));
+  // Only the frames within the decrypt-ahead window are decrypted.
+  EXPECT_CALL(cdm, DecryptSamples(_, 6))
+      .WillOnce(Invoke([&](eme::DecryptSample* samples, size_t count) {
+        for (size_t i = 0; i < count; i++)
+          FakeDecrypt(&samples[i]);
+        done.set_value();
+      }));
+
+  {
+    DecryptThread thread(&client);
+    thread.Attach(&stream);
+    thread.SetCdm(&cdm);
+    ASSERT_EQ(std::future_status::ready,
+              done.get_future().wait_for(std::chrono::seconds(1)));
+  }
+
+  EXPECT_EQ(std::vector<uint8_t>(6 * kFrameSize, 0xf0),
+            GetFrames(*buffer, 0, 6));
+  EXPECT_EQ(std::vector<uint8_t>(4 * kFrameSize, 0x0f),
+            GetFrames(*buffer, 6, 10));
+}
+
+TEST(DecryptThreadTest, RetriesMissingKeys) {
+  auto buffer = std::make_shared<EncodedFrameBuffer>(4 * kFrameSize, 0x0f);
+  ElementaryStream stream;
+  AddFrames(buffer, &stream);
+
+  NiceMock<MockClient> client;
+  StrictMock<MockImplementation> cdm;
+  std::promise<void> done;
+  ON_CALL(client, CurrentTime()).WillByDefault(Return(0));
+  EXPECT_CALL(cdm, DecryptSamples(_, 4))
+      .WillOnce(Invoke([&](eme::DecryptSample* samples, size_t count) {
+        FakeDecrypt(&samples[0]);
+        FakeDecrypt(&samples[1]);
+        samples[2].status = eme::DecryptStatus::KeyNotFound;
+        FakeDecrypt(&samples[3]);
+      }));
+  // The frames after the one missing a key are tried again; the decrypted
+  // frame is skipped.
+  EXPECT_CALL(cdm, DecryptSamples(_, 1))
+      .WillOnce(Invoke([&](eme::DecryptSample* samples, size_t count) {
+        EXPECT_EQ(buffer->data() + 2 * kFrameSize, samples[0].data);
+        FakeDecrypt(&samples[0]);
+        done.set_value();
+      }));
+
+  {
+    DecryptThread thread(&client);
+    thread.Attach(&stream);
+    thread.SetCdm(&cdm);
+    ASSERT_EQ(std::future_status::ready,
+              done.get_future().wait_for(std::chrono::seconds(2)));
+  }
+
+  EXPECT_EQ(EncodedFrameBuffer(4 * kFrameSize, 0xf0), *buffer);
+}
+
+}  // namespace media
+}  // namespace shaka
@@ -17,6 +17,8 @@
 #include <gmock/gmock.h>
 #include <gtest/gtest.h>
 
+#include <algorithm>
+
 #include "src/media/media_utils.h"
 #include "src/test/media_files.h"
 #include "src/util/crypto.h"
@@ -42,7 +44,13 @@ class MockClient : public Demuxer::Client {
                void(eme::MediaKeyInitDataType, const uint8_t*, size_t));
 };
 
-void RunDemuxerTest(const std::vector<std::string>& files) {
+/**
+ * Demuxes the given files and checks the frames against the expected info.
+ * If |append_size| is given, the files are given to the demuxer in chunks of
+ * that size.
+ */
+void RunDemuxerTest(const std::vector<std::string>& files,
+                    size_t append_size = 0) {
   NiceMock<MockClient> client;
   std::unique_ptr<Demuxer> demuxer;
 
@@ -60,8 +68,11 @@ void RunDemuxerTest(const std::vector<std::string>& files) {
 
     const std::vector<uint8_t> media_data = GetMediaFile(file);
     std::vector<std::shared_ptr<EncodedFrame>> frames;
-    ASSERT_TRUE(
-        demuxer->Demux(0, media_data.data(), media_data.size(), &frames));
+    const size_t chunk_size = append_size ? append_size : media_data.size();
+    for (size_t pos = 0; pos < media_data.size(); pos += chunk_size) {
+      const size_t size = std::min(chunk_size, media_data.size() - pos);
+      ASSERT_TRUE(demuxer->Demux(0, media_data.data() + pos, size, &frames));
+    }
     ASSERT_EQ(frames.size(), info.frames().size());
     if (!frames.empty()) {
       // All frames for the same input file should have the same stream object.
@@ -115,9 +126,64 @@ TEST(DemuxerTest, SegmentedWithAdaptation) {
       {"clear_low_frag_init.mp4", "clear_low_frag_seg1.mp4", "clear_high.mp4"});
 }
 
+TEST(DemuxerTest, SegmentedWithSplitAppends) {
+  RunDemuxerTest({"clear_low_frag_init.mp4", "clear_low_frag_seg1.mp4"}, 1000);
+}
+
 TEST(DemuxerTest, Encrypted) {
   RunDemuxerTest({"encrypted_low.mp4"});
 }
 
+TEST(DemuxerTest, RejectsOversizedBoxes) {
+  // Box headers that claim 4 GB and 2^60 bytes.  Without a limit, the appended
+  // data would be buffered forever waiting for the rest of the box.
+  const std::vector<std::vector<uint8_t>> headers = {
+      {0xff, 0xff, 0xff, 0xff, 'm', 'd', 'a', 't'},
+      {0, 0, 0, 1, 'm', 'o', 'o', 'f', 0x10, 0, 0, 0, 0, 0, 0, 0},
+  };
+  for (const auto& header : headers) {
+    NiceMock<MockClient> client;
+    std::unique_ptr<Demuxer> demuxer =
+        DemuxerFactory::GetFactory()->Create("video/mp4", &client);
+    ASSERT_TRUE(demuxer);
+
+    std::vector<std::shared_ptr<EncodedFrame>> frames;
+    EXPECT_FALSE(demuxer->Demux(0, header.data(), header.size(), &frames));
+    EXPECT_TRUE(frames.empty());
+  }
+}
+
+TEST(DemuxerTest, EncryptedFrameInfo) {
+  const std::vector<uint8_t> expected_key_id = {
+      0xab, 0xba, 0x27, 0x1e, 0x8b, 0xcf, 0x55, 0x2b,
+      0xbd, 0x2e, 0x86, 0xa4, 0x34, 0xa9, 0xa5, 0xd9,
+  };
+
+  NiceMock<MockClient> client;
+  EXPECT_CALL(client, OnEncrypted(eme::MediaKeyInitDataType::Cenc, _, _))
+      .Times(1);
+  std::unique_ptr<Demuxer> demuxer =
+      DemuxerFactory::GetFactory()->Create("video/mp4", &client);
+  ASSERT_TRUE(demuxer);
+
+  const std::vector<uint8_t> media_data = GetMediaFile("encrypted_low.mp4");
+  std::vector<std::shared_ptr<EncodedFrame>> frames;
+  ASSERT_TRUE(demuxer->Demux(0, media_data.data(), media_data.size(), &frames));
+
+  size_t encrypted_count = 0;
+  for (auto& frame : frames) {
+    if (!frame->encryption_info)
+      continue;
+    encrypted_count++;
+    EXPECT_EQ(frame->encryption_info->scheme, eme::EncryptionScheme::AesCtr);
+    EXPECT_EQ(frame->encryption_info->key_id, expected_key_id);
+    ASSERT_EQ(frame->encryption_info->subsamples.size(), 1u);
+    EXPECT_EQ(frame->encryption_info->subsamples[0].clear_bytes +
+                  frame->encryption_info->subsamples[0].protected_bytes,
+              frame->data_size);
+  }
+  EXPECT_EQ(encrypted_count, 24u);
+}
+
 }  // namespace media
 }  // namespace shaka
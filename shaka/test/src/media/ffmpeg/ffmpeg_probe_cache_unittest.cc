@@ -0,0 +1,138 @@
+// Copyright 2020 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     https://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "src/media/ffmpeg/ffmpeg_probe_cache.h"
+
+#include <gtest/gtest.h>
+#include <string.h>
+
+#include <memory>
+#include <vector>
+
+namespace shaka {
+namespace media {
+namespace ffmpeg {
+
+namespace {
+
+struct FreeParams {
+  void operator()(AVCodecParameters* params) {
+    avcodec_parameters_free(&params);
+  }
+};
+using Params = std::unique_ptr<AVCodecParameters, FreeParams>;
+
+Params MakeParams(int width, const std::vector<uint8_t>& extra_data) {
+  Params ret(avcodec_parameters_alloc());
+  ret->codec_type = AVMEDIA_TYPE_VIDEO;
+  ret->codec_id = AV_CODEC_ID_H264;
+  ret->width = width;
+  ret->height = 240;
+  if (!extra_data.empty()) {
+    ret->extradata = static_cast<uint8_t*>(
+        av_mallocz(extra_data.size() + AV_INPUT_BUFFER_PADDING_SIZE));
+    memcpy(ret->extradata, extra_data.data(), extra_data.size());
+    ret->extradata_size = static_cast<int>(extra_data.size());
+  }
+  return ret;
+}
+
+std::vector<uint8_t> GetExtraData(const AVCodecParameters* params) {
+  return std::vector<uint8_t>(params->extradata,
+                              params->extradata + params->extradata_size);
+}
+
+}  // namespace
+
+TEST(FFmpegProbeCacheTest, ReturnsCachedParams) {
+  FFmpegProbeCache cache(4);
+  const std::vector<uint8_t> key = {1, 2, 3};
+  const std::vector<uint8_t> extra_data = {0xa, 0xb, 0xc};
+  cache.Add(key, MakeParams(320, extra_data).get());
+
+  Params params = MakeParams(0, {});
+  ASSERT_TRUE(cache.Get(key, params.get()));
+  EXPECT_EQ(AV_CODEC_ID_H264, params->codec_id);
+  EXPECT_EQ(320, params->width);
+  EXPECT_EQ(240, params->height);
+  EXPECT_EQ(extra_data, GetExtraData(params.get()));
+
+  // The cache stores a copy, so later hits get the same values.
+  params = MakeParams(0, {});
+  ASSERT_TRUE(cache.Get(key, params.get()));
+  EXPECT_EQ(320, params->width);
+  EXPECT_EQ(extra_data, GetExtraData(params.get()));
+}
+
+TEST(FFmpegProbeCacheTest, MissesUnknownKeys) {
+  FFmpegProbeCache cache(4);
+  Params params = MakeParams(123, {0xa});
+  EXPECT_FALSE(cache.Get({1, 2, 3}, params.get()));
+
+  cache.Add({1, 2, 3}, MakeParams(320, {}).get());
+  EXPECT_FALSE(cache.Get({1, 2, 4}, params.get()));
+  EXPECT_FALSE(cache.Get({1, 2}, params.get()));
+  EXPECT_FALSE(cache.Get({}, params.get()));
+
+  // A miss doesn't change the given parameters.
+  EXPECT_EQ(123, params->width);
+  EXPECT_EQ(std::vector<uint8_t>({0xa}), GetExtraData(params.get()));
+}
+
+TEST(FFmpegProbeCacheTest, ReplacesEntries) {
+  FFmpegProbeCache cache(4);
+  const std::vector<uint8_t> key = {1, 2, 3};
+  cache.Add(key, MakeParams(320, {0xa}).get());
+  cache.Add(key, MakeParams(640, {0xb}).get());
+
+  Params params = MakeParams(0, {});
+  ASSERT_TRUE(cache.Get(key, params.get()));
+  EXPECT_EQ(640, params->width);
+  EXPECT_EQ(std::vector<uint8_t>({0xb}), GetExtraData(params.get()));
+}
+
+TEST(FFmpegProbeCacheTest, RemovesEntries) {
+  FFmpegProbeCache cache(4);
+  cache.Add({1}, MakeParams(320, {}).get());
+  cache.Add({2}, MakeParams(640, {}).get());
+  cache.Remove({1});
+  // Removing a missing entry does nothing.
+  cache.Remove({3});
+
+  Params params = MakeParams(0, {});
+  EXPECT_FALSE(cache.Get({1}, params.get()));
+  ASSERT_TRUE(cache.Get({2}, params.get()));
+  EXPECT_EQ(640, params->width);
+}
+
+TEST(FFmpegProbeCacheTest, EvictsLeastRecentlyUsed) {
+  FFmpegProbeCache cache(2);
+  cache.Add({1}, MakeParams(1, {}).get());
+  cache.Add({2}, MakeParams(2, {}).get());
+
+  // Using the first entry makes the second one the least recently used.
+  Params params = MakeParams(0, {});
+  ASSERT_TRUE(cache.Get({1}, params.get()));
+  cache.Add({3}, MakeParams(3, {}).get());
+
+  EXPECT_FALSE(cache.Get({2}, params.get()));
+  ASSERT_TRUE(cache.Get({1}, params.get()));
+  EXPECT_EQ(1, params->width);
+  ASSERT_TRUE(cache.Get({3}, params.get()));
+  EXPECT_EQ(3, params->width);
+}
+
+}  // namespace ffmpeg
+}  // namespace media
+}  // namespace shaka
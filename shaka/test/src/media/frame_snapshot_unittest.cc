@@ -0,0 +1,129 @@
+// Copyright 2020 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     https://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "shaka/media/frame_snapshot.h"
+
+#include <gtest/gtest.h>
+
+#include <atomic>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "test/src/test/test_utils.h"
+
+namespace shaka {
+namespace media {
+
+namespace {
+
+constexpr const uint32_t kWidth = 20;
+constexpr const uint32_t kHeight = 4;
+
+std::shared_ptr<StreamInfo> MakeStreamInfo() {
+  return std::shared_ptr<StreamInfo>{new StreamInfo(
+      "", "", true, {0, 0}, {0, 0}, {}, kWidth, kHeight, 0, 0)};
+}
+
+std::shared_ptr<DecodedFrame> MakeFrame(
+    PixelFormat format, const std::vector<const uint8_t*>& data,
+    const std::vector<size_t>& linesize) {
+  return std::shared_ptr<DecodedFrame>(new DecodedFrame(
+      MakeStreamInfo(), 2, 2, 0.01, format, 0, data, linesize));
+}
+
+}  // namespace
+
+TEST(FrameSnapshotTest, ConvertsYuv) {
+  // Video-range white.
+  const std::vector<uint8_t> y(kWidth * kHeight, 235);
+  const std::vector<uint8_t> uv(kWidth * kHeight / 2, 128);
+  auto frame = MakeFrame(PixelFormat::YUV420P, {y.data(), uv.data(), uv.data()},
+                         {kWidth, kWidth / 2, kWidth / 2});
+
+  auto snapshot = ConvertFrameToRgba(*frame);
+  ASSERT_TRUE(snapshot);
+  EXPECT_EQ(2, snapshot->pts);
+  EXPECT_EQ(kWidth, snapshot->width);
+  EXPECT_EQ(kHeight, snapshot->height);
+  ASSERT_EQ(kWidth * kHeight * 4, snapshot->pixels.size());
+  for (uint8_t value : snapshot->pixels)
+    EXPECT_EQ(255, value);
+}
+
+TEST(FrameSnapshotTest, ConvertsRgb) {
+  // Add padding to the rows.
+  constexpr const size_t kStride = kWidth * 3 + 4;
+  std::vector<uint8_t> rgb(kStride * kHeight);
+  for (size_t i = 0; i < rgb.size(); i++)
+    rgb[i] = static_cast<uint8_t>(i);
+  auto frame = MakeFrame(PixelFormat::RGB24, {rgb.data()}, {kStride});
+
+  auto snapshot = ConvertFrameToRgba(*frame);
+  ASSERT_TRUE(snapshot);
+  for (size_t row = 0; row < kHeight; row++) {
+    for (size_t i = 0; i < kWidth; i++) {
+      const uint8_t* pixel = &snapshot->pixels[(row * kWidth + i) * 4];
+      EXPECT_EQ(rgb[row * kStride + i * 3], pixel[0]);
+      EXPECT_EQ(rgb[row * kStride + i * 3 + 1], pixel[1]);
+      EXPECT_EQ(rgb[row * kStride + i * 3 + 2], pixel[2]);
+      EXPECT_EQ(255, pixel[3]);
+    }
+  }
+}
+
+TEST(FrameSnapshotTest, FailsForUnsupportedFormats) {
+  auto frame = MakeFrame(PixelFormat::VideoToolbox, {nullptr}, {0});
+  EXPECT_FALSE(ConvertFrameToRgba(*frame));
+}
+
+TEST(FrameSnapshotTest, ConvertsInBackground) {
+  const std::vector<uint8_t> rgb(kWidth * 3 * kHeight, 10);
+  auto frame = MakeFrame(PixelFormat::RGB24, {rgb.data()}, {kWidth * 3});
+  std::weak_ptr<DecodedFrame> weak_frame = frame;
+
+  std::mutex mutex;
+  std::shared_ptr<FrameSnapshot> result;
+  std::thread::id callback_thread;
+  std::atomic<bool> done{false};
+  TakeFrameSnapshot(std::move(frame),
+                    [&](std::shared_ptr<FrameSnapshot> snapshot) {
+                      std::unique_lock<std::mutex> lock(mutex);
+                      result = snapshot;
+                      callback_thread = std::this_thread::get_id();
+                      done = true;
+                    });
+  ASSERT_TRUE(WaitUntilOrTimeout([&]() { return done.load(); }));
+
+  std::unique_lock<std::mutex> lock(mutex);
+  ASSERT_TRUE(result);
+  EXPECT_EQ(10, result->pixels[0]);
+  EXPECT_NE(std::this_thread::get_id(), callback_thread);
+  // The frame is released once it is converted.
+  EXPECT_TRUE(weak_frame.expired());
+}
+
+TEST(FrameSnapshotTest, CallsBackWithoutFrame) {
+  std::atomic<bool> done{false};
+  std::atomic<bool> got_null{false};
+  TakeFrameSnapshot(nullptr, [&](std::shared_ptr<FrameSnapshot> snapshot) {
+    got_null = !snapshot;
+    done = true;
+  });
+  ASSERT_TRUE(WaitUntilOrTimeout([&]() { return done.load(); }));
+  EXPECT_TRUE(got_null);
+}
+
+}  // namespace media
+}  // namespace shaka
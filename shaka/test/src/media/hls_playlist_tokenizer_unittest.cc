@@ -0,0 +1,161 @@
+// Copyright 2020 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     https://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "src/media/hls_playlist_tokenizer.h"
+
+#include <gtest/gtest.h>
+
+#include <string>
+#include <vector>
+
+namespace shaka {
+namespace media {
+
+namespace {
+
+using Table = HlsTokenTable;
+
+bool Tokenize(HlsPlaylistTokenizer* tokenizer, const std::string& text,
+              HlsTokenTable* table) {
+  std::string error;
+  return tokenizer->Tokenize(reinterpret_cast<const uint8_t*>(text.data()),
+                             text.size(), table, &error);
+}
+
+uint32_t LineField(const HlsTokenTable& table, size_t line,
+                   HlsTokenTable::LineField field) {
+  return table.lines[line * Table::kLineFieldCount + field];
+}
+
+/** @return The text between the given line fields. */
+std::string LineText(const std::string& text, const HlsTokenTable& table,
+                     size_t line, HlsTokenTable::LineField start,
+                     HlsTokenTable::LineField end) {
+  const uint32_t begin = LineField(table, line, start);
+  return text.substr(begin, LineField(table, line, end) - begin);
+}
+
+std::string AttributeText(const std::string& text, const HlsTokenTable& table,
+                          size_t attribute,
+                          HlsTokenTable::AttributeField start) {
+  const uint32_t* fields =
+      &table.attributes[attribute * Table::kAttrFieldCount];
+  return text.substr(fields[start], fields[start + 1] - fields[start]);
+}
+
+std::string MakeLivePlaylist(int first_segment, int count) {
+  std::string ret = "#EXTM3U\n#EXT-X-TARGETDURATION:6\n#EXT-X-MEDIA-SEQUENCE:" +
+                    std::to_string(first_segment) + "\n";
+  for (int i = first_segment; i < first_segment + count; i++)
+    ret += "#EXTINF:6.0,\nsegment" + std::to_string(i) + ".ts\n";
+  return ret;
+}
+
+}  // namespace
+
+TEST(HlsPlaylistTokenizerTest, TokenizesLines) {
+  const std::string text =
+      "#EXTM3U\r\n"
+      "# A comment\n"
+      "#EXT-X-KEY:METHOD=AES-128,URI=\"key,1.bin\",IV=0x1234\n"
+      "\n"
+      "#EXTINF:6.0,Title  \n"
+      "seg.ts";
+  HlsPlaylistTokenizer tokenizer;
+  HlsTokenTable table;
+  ASSERT_TRUE(Tokenize(&tokenizer, text, &table));
+  ASSERT_EQ(4u, table.line_count());
+
+  EXPECT_EQ(static_cast<uint32_t>(HlsLineKind::Tag),
+            LineField(table, 0, Table::kLineKind));
+  EXPECT_EQ("#EXTM3U",
+            LineText(text, table, 0, Table::kLineStart, Table::kLineEnd));
+
+  EXPECT_EQ("#EXT-X-KEY",
+            LineText(text, table, 1, Table::kLineStart, Table::kLineNameEnd));
+  EXPECT_EQ(0u, LineField(table, 1, Table::kLineFirstAttribute));
+  ASSERT_EQ(3u, LineField(table, 1, Table::kLineAttributeCount));
+  EXPECT_EQ("METHOD", AttributeText(text, table, 0, Table::kAttrKeyStart));
+  EXPECT_EQ("AES-128", AttributeText(text, table, 0, Table::kAttrValueStart));
+  EXPECT_EQ("key,1.bin", AttributeText(text, table, 1, Table::kAttrValueStart));
+  EXPECT_EQ("IV", AttributeText(text, table, 2, Table::kAttrKeyStart));
+  EXPECT_EQ("0x1234", AttributeText(text, table, 2, Table::kAttrValueStart));
+
+  EXPECT_EQ("6.0,Title",
+            LineText(text, table, 2, Table::kLineValueStart, Table::kLineEnd));
+  EXPECT_EQ(0u, LineField(table, 2, Table::kLineAttributeCount));
+
+  EXPECT_EQ(static_cast<uint32_t>(HlsLineKind::Uri),
+            LineField(table, 3, Table::kLineKind));
+  EXPECT_EQ("seg.ts",
+            LineText(text, table, 3, Table::kLineStart, Table::kLineEnd));
+}
+
+TEST(HlsPlaylistTokenizerTest, UsesUtf16Offsets) {
+  // "é" is two bytes in UTF-8 and "😀" is four; in UTF-16 they are one and
+  // two code units.
+  HlsPlaylistTokenizer tokenizer;
+  HlsTokenTable table;
+  ASSERT_TRUE(Tokenize(&tokenizer,
+                       "\xef\xbb\xbf#EXTM3U\n"
+                       "#EXTINF:6,caf\xc3\xa9\n"
+                       "\xf0\x9f\x98\x80.ts\n",
+                       &table));
+  ASSERT_EQ(3u, table.line_count());
+  EXPECT_EQ(1u, LineField(table, 0, Table::kLineStart));
+  EXPECT_EQ(9u, LineField(table, 1, Table::kLineStart));
+  EXPECT_EQ(17u, LineField(table, 1, Table::kLineValueStart));
+  EXPECT_EQ(23u, LineField(table, 1, Table::kLineEnd));
+  EXPECT_EQ(24u, LineField(table, 2, Table::kLineStart));
+  EXPECT_EQ(29u, LineField(table, 2, Table::kLineEnd));
+}
+
+TEST(HlsPlaylistTokenizerTest, RejectsNonPlaylists) {
+  HlsPlaylistTokenizer tokenizer;
+  HlsTokenTable table;
+  EXPECT_FALSE(Tokenize(&tokenizer, "", &table));
+  EXPECT_FALSE(Tokenize(&tokenizer, "WEBVTT\n", &table));
+  EXPECT_FALSE(Tokenize(&tokenizer, "\n#EXTM3U\n", &table));
+}
+
+TEST(HlsPlaylistTokenizerTest, MatchesPreviousLivePlaylist) {
+  HlsPlaylistTokenizer tokenizer;
+  HlsTokenTable table;
+  ASSERT_TRUE(Tokenize(&tokenizer, MakeLivePlaylist(10, 5), &table));
+  EXPECT_EQ(table.match_start, table.match_end);
+
+  // Two segments were removed and three were added.  The header is 3 lines
+  // and each segment is 2 lines.
+  ASSERT_TRUE(Tokenize(&tokenizer, MakeLivePlaylist(12, 6), &table));
+  ASSERT_EQ(15u, table.line_count());
+  EXPECT_EQ(3u, table.match_start);
+  EXPECT_EQ(9u, table.match_end);
+  EXPECT_EQ(4, table.match_offset);
+
+  // Nothing in common.
+  ASSERT_TRUE(Tokenize(&tokenizer, MakeLivePlaylist(100, 2), &table));
+  EXPECT_EQ(table.match_start, table.match_end);
+
+  ASSERT_TRUE(Tokenize(&tokenizer, MakeLivePlaylist(100, 2), &table));
+  EXPECT_EQ(0u, table.match_start);
+  EXPECT_EQ(7u, table.match_end);
+  EXPECT_EQ(0, table.match_offset);
+
+  tokenizer.Reset();
+  ASSERT_TRUE(Tokenize(&tokenizer, MakeLivePlaylist(100, 2), &table));
+  EXPECT_EQ(table.match_start, table.match_end);
+}
+
+}  // namespace media
+}  // namespace shaka
@@ -0,0 +1,177 @@
+// Copyright 2020 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     https://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "src/media/iec61937.h"
+
+#include <gtest/gtest.h>
+
+#include <vector>
+
+namespace shaka {
+namespace media {
+
+namespace {
+
+using Codec = Iec61937Packetizer::Codec;
+using Result = Iec61937Packetizer::Result;
+
+/** Creates an AC-3 syncframe with the given size, bsid, and bsmod. */
+std::vector<uint8_t> MakeAc3Frame(size_t size, uint8_t bsmod) {
+  std::vector<uint8_t> ret(size);
+  for (size_t i = 0; i < size; i++)
+    ret[i] = static_cast<uint8_t>(i);
+  ret[0] = 0x0b;
+  ret[1] = 0x77;
+  ret[5] = static_cast<uint8_t>((8 << 3) | bsmod);
+  return ret;
+}
+
+/**
+ * Creates an E-AC-3 syncframe with the given size (which must be even), stream
+ * type, and number of audio blocks code.
+ */
+std::vector<uint8_t> MakeEac3Frame(size_t size, uint8_t stream_type,
+                                   uint8_t numblkscod) {
+  std::vector<uint8_t> ret(size, 0xab);
+  const size_t frmsiz = size / 2 - 1;
+  ret[0] = 0x0b;
+  ret[1] = 0x77;
+  ret[2] = static_cast<uint8_t>((stream_type << 6) | (frmsiz >> 8));
+  ret[3] = static_cast<uint8_t>(frmsiz & 0xff);
+  ret[4] = static_cast<uint8_t>(numblkscod << 4);
+  ret[5] = 16 << 3;
+  return ret;
+}
+
+uint16_t ReadWord(const std::vector<uint8_t>& burst, size_t offset) {
+  return static_cast<uint16_t>(burst[offset] | (burst[offset + 1] << 8));
+}
+
+}  // namespace
+
+TEST(Iec61937PacketizerTest, PacketizesAc3) {
+  Iec61937Packetizer packetizer;
+  const std::vector<uint8_t> frame = MakeAc3Frame(100, 3);
+  std::vector<uint8_t> burst;
+  ASSERT_EQ(Result::Burst, packetizer.AddFrame(Codec::Ac3, frame.data(),
+                                               frame.size(), &burst));
+
+  ASSERT_EQ(Iec61937Packetizer::kAc3BurstSize, burst.size());
+  EXPECT_EQ(0xf872, ReadWord(burst, 0));
+  EXPECT_EQ(0x4e1f, ReadWord(burst, 2));
+  EXPECT_EQ(0x0301, ReadWord(burst, 4));  // bsmod 3, data type 1.
+  EXPECT_EQ(100 * 8, ReadWord(burst, 6));
+  // The payload is byte-swapped.
+  EXPECT_EQ(0x77, burst[8]);
+  EXPECT_EQ(0x0b, burst[9]);
+  EXPECT_EQ(frame[99], burst[8 + 98]);
+  EXPECT_EQ(frame[98], burst[8 + 99]);
+  for (size_t i = 8 + 100; i < burst.size(); i++)
+    ASSERT_EQ(0, burst[i]);
+
+  EXPECT_EQ(48000u, Iec61937Packetizer::GetBurstSampleRate(Codec::Ac3, 48000));
+}
+
+TEST(Iec61937PacketizerTest, PadsOddAc3Frames) {
+  Iec61937Packetizer packetizer;
+  const std::vector<uint8_t> frame = MakeAc3Frame(9, 0);
+  std::vector<uint8_t> burst;
+  ASSERT_EQ(Result::Burst, packetizer.AddFrame(Codec::Ac3, frame.data(),
+                                               frame.size(), &burst));
+  EXPECT_EQ(0, burst[8 + 8]);
+  EXPECT_EQ(frame[8], burst[8 + 9]);
+}
+
+TEST(Iec61937PacketizerTest, RejectsInvalidFrames) {
+  Iec61937Packetizer packetizer;
+  std::vector<uint8_t> burst;
+  std::vector<uint8_t> frame = MakeAc3Frame(100, 0);
+  frame[0] = 0;
+  EXPECT_EQ(Result::InvalidFrame, packetizer.AddFrame(Codec::Ac3, frame.data(),
+                                                      frame.size(), &burst));
+
+  // An E-AC-3 frame isn't valid AC-3 and vice versa.
+  frame = MakeEac3Frame(100, 0, 3);
+  EXPECT_EQ(Result::InvalidFrame, packetizer.AddFrame(Codec::Ac3, frame.data(),
+                                                      frame.size(), &burst));
+  frame = MakeAc3Frame(100, 0);
+  EXPECT_EQ(Result::InvalidFrame, packetizer.AddFrame(
+                                      Codec::Eac3, frame.data(), frame.size(),
+                                      &burst));
+
+  frame = MakeAc3Frame(Iec61937Packetizer::kAc3BurstSize, 0);
+  EXPECT_EQ(Result::InvalidFrame, packetizer.AddFrame(Codec::Ac3, frame.data(),
+                                                      frame.size(), &burst));
+}
+
+TEST(Iec61937PacketizerTest, PacketizesEac3) {
+  Iec61937Packetizer packetizer;
+  // A frame with 6 blocks and a dependent substream.
+  std::vector<uint8_t> frame = MakeEac3Frame(200, 0, 3);
+  const std::vector<uint8_t> dependent = MakeEac3Frame(50, 1, 3);
+  frame.insert(frame.end(), dependent.begin(), dependent.end());
+
+  std::vector<uint8_t> burst;
+  ASSERT_EQ(Result::Burst, packetizer.AddFrame(Codec::Eac3, frame.data(),
+                                               frame.size(), &burst));
+  ASSERT_EQ(Iec61937Packetizer::kEac3BurstSize, burst.size());
+  EXPECT_EQ(0xf872, ReadWord(burst, 0));
+  EXPECT_EQ(0x4e1f, ReadWord(burst, 2));
+  EXPECT_EQ(0x15, ReadWord(burst, 4));
+  EXPECT_EQ(250, ReadWord(burst, 6));
+  EXPECT_EQ(0x77, burst[8]);
+  EXPECT_EQ(0x0b, burst[9]);
+  EXPECT_EQ(0x77, burst[8 + 200]);
+  EXPECT_EQ(0x0b, burst[8 + 201]);
+
+  EXPECT_EQ(192000u,
+            Iec61937Packetizer::GetBurstSampleRate(Codec::Eac3, 48000));
+}
+
+TEST(Iec61937PacketizerTest, CombinesShortEac3Frames) {
+  Iec61937Packetizer packetizer;
+  // Each frame has 2 blocks, so it takes 3 frames for a burst.
+  const std::vector<uint8_t> frame = MakeEac3Frame(100, 0, 1);
+  std::vector<uint8_t> burst;
+  EXPECT_EQ(Result::NeedMoreData, packetizer.AddFrame(Codec::Eac3, frame.data(),
+                                                      frame.size(), &burst));
+  EXPECT_EQ(Result::NeedMoreData, packetizer.AddFrame(Codec::Eac3, frame.data(),
+                                                      frame.size(), &burst));
+  ASSERT_EQ(Result::Burst, packetizer.AddFrame(Codec::Eac3, frame.data(),
+                                               frame.size(), &burst));
+  EXPECT_EQ(300, ReadWord(burst, 6));
+
+  // Reset drops the buffered frames.
+  EXPECT_EQ(Result::NeedMoreData, packetizer.AddFrame(Codec::Eac3, frame.data(),
+                                                      frame.size(), &burst));
+  packetizer.Reset();
+  EXPECT_EQ(Result::NeedMoreData, packetizer.AddFrame(Codec::Eac3, frame.data(),
+                                                      frame.size(), &burst));
+  EXPECT_EQ(Result::NeedMoreData, packetizer.AddFrame(Codec::Eac3, frame.data(),
+                                                      frame.size(), &burst));
+  ASSERT_EQ(Result::Burst, packetizer.AddFrame(Codec::Eac3, frame.data(),
+                                               frame.size(), &burst));
+  EXPECT_EQ(300, ReadWord(burst, 6));
+}
+
+TEST(Iec61937PacketizerTest, RejectsTruncatedEac3) {
+  Iec61937Packetizer packetizer;
+  const std::vector<uint8_t> frame = MakeEac3Frame(100, 0, 3);
+  std::vector<uint8_t> burst;
+  EXPECT_EQ(Result::InvalidFrame,
+            packetizer.AddFrame(Codec::Eac3, frame.data(), 50, &burst));
+}
+
+}  // namespace media
+}  // namespace shaka
@@ -0,0 +1,83 @@
+// Copyright 2020 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     https://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "src/media/latency_tracker.h"
+
+#include <gmock/gmock.h>
+#include <gtest/gtest.h>
+#include <math.h>
+
+namespace shaka {
+namespace media {
+
+namespace {
+
+using testing::Return;
+
+class MockClock : public util::Clock {
+ public:
+  MOCK_CONST_METHOD0(GetMonotonicTime, uint64_t());
+};
+
+}  // namespace
+
+TEST(LatencyTrackerTest, ReportsTimeSinceAppend) {
+  MockClock clock;
+  LatencyTracker tracker(&clock);
+
+  EXPECT_CALL(clock, GetMonotonicTime()).WillOnce(Return(1000));
+  tracker.OnBufferedChanged({{0, 2}});
+  EXPECT_CALL(clock, GetMonotonicTime()).WillOnce(Return(1500));
+  tracker.OnBufferedChanged({{0, 4}});
+
+  EXPECT_CALL(clock, GetMonotonicTime()).WillRepeatedly(Return(3000));
+  EXPECT_DOUBLE_EQ(2, tracker.GetLatency(0));
+  EXPECT_DOUBLE_EQ(2, tracker.GetLatency(1.5));
+  EXPECT_DOUBLE_EQ(1.5, tracker.GetLatency(2));
+  EXPECT_DOUBLE_EQ(1.5, tracker.GetLatency(3.9));
+  EXPECT_TRUE(isnan(tracker.GetLatency(4)));
+}
+
+TEST(LatencyTrackerTest, IgnoresContentBeforeTheEnd) {
+  MockClock clock;
+  LatencyTracker tracker(&clock);
+
+  EXPECT_CALL(clock, GetMonotonicTime()).WillOnce(Return(1000));
+  tracker.OnBufferedChanged({{0, 2}});
+  // Filling in a gap or removing content doesn't move the end.
+  tracker.OnBufferedChanged({{0, 1}});
+  tracker.OnBufferedChanged({{0, 1}, {1.5, 2}});
+  tracker.OnBufferedChanged({});
+
+  EXPECT_CALL(clock, GetMonotonicTime()).WillRepeatedly(Return(2000));
+  EXPECT_DOUBLE_EQ(1, tracker.GetLatency(1.8));
+}
+
+TEST(LatencyTrackerTest, ForgetsContentOnReset) {
+  MockClock clock;
+  LatencyTracker tracker(&clock);
+
+  EXPECT_CALL(clock, GetMonotonicTime()).WillOnce(Return(1000));
+  tracker.OnBufferedChanged({{0, 2}});
+  tracker.Reset();
+  EXPECT_TRUE(isnan(tracker.GetLatency(1)));
+
+  EXPECT_CALL(clock, GetMonotonicTime()).WillOnce(Return(5000));
+  tracker.OnBufferedChanged({{0, 2}});
+  EXPECT_CALL(clock, GetMonotonicTime()).WillOnce(Return(5250));
+  EXPECT_DOUBLE_EQ(0.25, tracker.GetLatency(1));
+}
+
+}  // namespace media
+}  // namespace shaka
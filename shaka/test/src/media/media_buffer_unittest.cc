@@ -0,0 +1,126 @@
+// Copyright 2020 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     https://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "src/media/media_buffer.h"
+
+#include <gmock/gmock.h>
+#include <gtest/gtest.h>
+
+#include <utility>
+
+namespace shaka {
+namespace media {
+
+namespace {
+
+using testing::_;
+using testing::Invoke;
+using testing::Return;
+
+class MockMediaAllocator : public MediaAllocator {
+ public:
+  MOCK_METHOD3(Allocate, void*(size_t, size_t, MediaAllocationCategory));
+  MOCK_METHOD3(Free, void(void*, size_t, MediaAllocationCategory));
+};
+
+class MediaBufferTest : public testing::Test {
+ protected:
+  void TearDown() override {
+    SetMediaAllocator(nullptr);
+  }
+};
+
+}  // namespace
+
+TEST_F(MediaBufferTest, UsesHeapByDefault) {
+  const auto before =
+      MediaAllocator::GetStats(MediaAllocationCategory::Network);
+  {
+    MediaBuffer buffer(100, MediaAllocationCategory::Network);
+    ASSERT_NE(nullptr, buffer.data());
+    EXPECT_EQ(100u, buffer.size());
+    EXPECT_EQ(0u, reinterpret_cast<uintptr_t>(buffer.data()) %
+                      MediaAllocator::kAlignment);
+
+    const auto during =
+        MediaAllocator::GetStats(MediaAllocationCategory::Network);
+    EXPECT_EQ(before.current_bytes + 100, during.current_bytes);
+    EXPECT_EQ(before.current_buffers + 1, during.current_buffers);
+    EXPECT_EQ(before.total_allocations + 1, during.total_allocations);
+    EXPECT_GE(during.peak_bytes, during.current_bytes);
+  }
+
+  const auto after =
+      MediaAllocator::GetStats(MediaAllocationCategory::Network);
+  EXPECT_EQ(before.current_bytes, after.current_bytes);
+  EXPECT_EQ(before.current_buffers, after.current_buffers);
+}
+
+TEST_F(MediaBufferTest, UsesCustomAllocator) {
+  alignas(64) uint8_t data[128];
+  MockMediaAllocator allocator;
+  EXPECT_CALL(allocator, Allocate(128, MediaAllocator::kAlignment,
+                                  MediaAllocationCategory::DecodedFrame))
+      .WillOnce(Return(data));
+  SetMediaAllocator(&allocator);
+
+  MediaBuffer buffer(128, MediaAllocationCategory::DecodedFrame);
+  EXPECT_EQ(data, buffer.data());
+
+  // The buffer is freed by the allocator it came from, even after changing it.
+  SetMediaAllocator(nullptr);
+  MediaBuffer moved(std::move(buffer));
+  EXPECT_EQ(nullptr, buffer.data());  // NOLINT(bugprone-use-after-move)
+  EXPECT_CALL(allocator,
+              Free(data, 128, MediaAllocationCategory::DecodedFrame));
+}
+
+TEST_F(MediaBufferTest, HandlesAllocationFailures) {
+  MockMediaAllocator allocator;
+  EXPECT_CALL(allocator, Allocate(_, _, _)).WillOnce(Return(nullptr));
+  EXPECT_CALL(allocator, Free(_, _, _)).Times(0);
+  SetMediaAllocator(&allocator);
+
+  const auto before =
+      MediaAllocator::GetStats(MediaAllocationCategory::EncodedFrame);
+  MediaBuffer buffer(10, MediaAllocationCategory::EncodedFrame);
+  EXPECT_EQ(nullptr, buffer.data());
+  EXPECT_EQ(0u, buffer.size());
+  const auto after =
+      MediaAllocator::GetStats(MediaAllocationCategory::EncodedFrame);
+  EXPECT_EQ(before.failed_allocations + 1, after.failed_allocations);
+}
+
+TEST_F(MediaBufferTest, SupportsVectors) {
+  MockMediaAllocator allocator;
+  EXPECT_CALL(allocator, Allocate(_, _, MediaAllocationCategory::EncodedFrame))
+      .WillRepeatedly(Invoke([](size_t size, size_t, MediaAllocationCategory) {
+        return new uint8_t[size];
+      }));
+  EXPECT_CALL(allocator, Free(_, _, MediaAllocationCategory::EncodedFrame))
+      .WillRepeatedly(Invoke([](void* buffer, size_t, MediaAllocationCategory) {
+        delete[] reinterpret_cast<uint8_t*>(buffer);
+      }));
+  SetMediaAllocator(&allocator);
+
+  EncodedFrameBuffer buffer;
+  for (uint8_t i = 0; i < 200; i++)
+    buffer.push_back(i);
+  EncodedFrameBuffer moved(std::move(buffer));
+  ASSERT_EQ(200u, moved.size());
+  EXPECT_EQ(199, moved.back());
+}
+
+}  // namespace media
+}  // namespace shaka
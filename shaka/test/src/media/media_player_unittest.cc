@@ -0,0 +1,157 @@
+// Copyright 2020 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     https://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "shaka/media/media_player.h"
+
+#include <gmock/gmock.h>
+#include <gtest/gtest.h>
+
+#include <chrono>
+#include <string>
+#include <thread>
+
+#include "src/debug/thread_event.h"
+
+namespace shaka {
+namespace media {
+
+namespace {
+
+using testing::_;
+using testing::InSequence;
+using testing::Invoke;
+using testing::InvokeWithoutArgs;
+
+class MockClient : public MediaPlayer::Client {
+ public:
+  MOCK_METHOD2(OnReadyStateChanged, void(VideoReadyState, VideoReadyState));
+  MOCK_METHOD2(OnPlaybackStateChanged,
+               void(VideoPlaybackState, VideoPlaybackState));
+  MOCK_METHOD2(OnPlaybackRateChanged, void(double, double));
+  MOCK_METHOD1(OnError, void(const std::string&));
+  MOCK_METHOD0(OnSeeking, void());
+  MOCK_METHOD2(OnUserEvent, void(const std::string&, void*));
+};
+
+}  // namespace
+
+TEST(MediaPlayerClientListTest, CallsAsyncClientsOnAnotherThread) {
+  MockClient client;
+  MediaPlayer::ClientList list;
+  list.AddAsyncClient(&client);
+
+  ThreadEvent<std::thread::id> called("");
+  EXPECT_CALL(client, OnError("error")).WillOnce(InvokeWithoutArgs([&]() {
+    called.SignalAll(std::this_thread::get_id());
+  }));
+
+  list.OnError("error");
+  EXPECT_NE(std::this_thread::get_id(), called.GetValue());
+  list.RemoveClient(&client);
+}
+
+TEST(MediaPlayerClientListTest, MergesQueuedStateChanges) {
+  MockClient client;
+  MediaPlayer::ClientList list;
+  list.AddAsyncClient(&client);
+
+  ThreadEvent<void> blocked("");
+  ThreadEvent<void> unblock("");
+  ThreadEvent<void> done("");
+  {
+    InSequence seq;
+    EXPECT_CALL(client, OnSeeking()).WillOnce(InvokeWithoutArgs([&]() {
+      blocked.SignalAll();
+      unblock.GetValue();
+    }));
+    EXPECT_CALL(client, OnPlaybackStateChanged(VideoPlaybackState::Paused,
+                                               VideoPlaybackState::Playing))
+        .Times(1);
+    EXPECT_CALL(client, OnError("error")).Times(1);
+    EXPECT_CALL(client, OnReadyStateChanged(VideoReadyState::HaveMetadata,
+                                            VideoReadyState::HaveEnoughData))
+        .Times(1);
+    EXPECT_CALL(client, OnSeeking()).WillOnce(InvokeWithoutArgs([&]() {
+      done.SignalAll();
+    }));
+  }
+  EXPECT_CALL(client, OnPlaybackRateChanged(_, _)).Times(0);
+
+  // Hold the delivery thread so the next events are queued.
+  list.OnSeeking();
+  blocked.GetValue();
+
+  list.OnPlaybackStateChanged(VideoPlaybackState::Paused,
+                              VideoPlaybackState::Buffering);
+  list.OnPlaybackStateChanged(VideoPlaybackState::Buffering,
+                              VideoPlaybackState::Playing);
+  list.OnError("error");
+  list.OnReadyStateChanged(VideoReadyState::HaveMetadata,
+                           VideoReadyState::HaveCurrentData);
+  list.OnReadyStateChanged(VideoReadyState::HaveCurrentData,
+                           VideoReadyState::HaveEnoughData);
+  // These cancel out, so nothing is delivered.
+  list.OnPlaybackRateChanged(1, 2);
+  list.OnPlaybackRateChanged(2, 1);
+  list.OnSeeking();
+
+  unblock.SignalAll();
+  done.GetValue();
+  list.RemoveClient(&client);
+}
+
+TEST(MediaPlayerClientListTest, CallsUserEventsSynchronously) {
+  MockClient client;
+  MediaPlayer::ClientList list;
+  list.AddAsyncClient(&client);
+
+  int data = 0;
+  const std::thread::id id = std::this_thread::get_id();
+  EXPECT_CALL(client, OnUserEvent("event", &data))
+      .WillOnce(Invoke([id](const std::string&, void*) {
+        EXPECT_EQ(id, std::this_thread::get_id());
+      }));
+  list.OnUserEvent("event", &data);
+  list.RemoveClient(&client);
+}
+
+TEST(MediaPlayerClientListTest, DropsQueuedEventsWhenRemoved) {
+  MockClient client;
+  MediaPlayer::ClientList list;
+  list.AddAsyncClient(&client);
+
+  ThreadEvent<void> blocked("");
+  ThreadEvent<void> unblock("");
+  EXPECT_CALL(client, OnSeeking()).WillOnce(InvokeWithoutArgs([&]() {
+    blocked.SignalAll();
+    unblock.GetValue();
+  }));
+  EXPECT_CALL(client, OnError(_)).Times(0);
+
+  list.OnSeeking();
+  blocked.GetValue();
+  list.OnError("error");
+
+  std::thread remover([&]() { list.RemoveClient(&client); });
+  // Give RemoveClient a chance to drop the queued events before the delivery
+  // thread continues.
+  std::this_thread::sleep_for(std::chrono::milliseconds(10));
+  unblock.SignalAll();
+  remover.join();
+
+  list.OnError("error");
+}
+
+}  // namespace media
+}  // namespace shaka
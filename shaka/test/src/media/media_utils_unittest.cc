@@ -206,5 +206,137 @@ TEST(MediaUtilsTest, ConvertMimeToDecodingConfiguration) {
   }
 }
 
+TEST(MediaUtilsTest, GetCodecBitDepth) {
+  EXPECT_EQ(GetCodecBitDepth("hvc1.2.4.L153.B0"), 10);
+  EXPECT_EQ(GetCodecBitDepth("hev1.A2.4.L153.B0"), 10);
+  EXPECT_EQ(GetCodecBitDepth("hvc1.1.6.L93.90"), 8);
+  EXPECT_EQ(GetCodecBitDepth("vp09.02.10.10.01.09.16.09.01"), 10);
+  EXPECT_EQ(GetCodecBitDepth("vp09.00.10.08"), 8);
+  EXPECT_EQ(GetCodecBitDepth("av01.0.04M.10"), 10);
+  EXPECT_EQ(GetCodecBitDepth("dvh1.05.06"), 10);
+  EXPECT_EQ(GetCodecBitDepth("avc1.6e0028"), 10);
+  EXPECT_EQ(GetCodecBitDepth("avc1.42e01e"), 8);
+  EXPECT_EQ(GetCodecBitDepth("vp09"), 0);
+  EXPECT_EQ(GetCodecBitDepth("hvc1"), 0);
+  EXPECT_EQ(GetCodecBitDepth("mp4a.40.2"), 0);
+}
+
+TEST(MediaUtilsTest, ParseHdrBoxes) {
+  HdrMetadata metadata;
+  EXPECT_FALSE(metadata.IsHdr());
+
+  // 'nclx' with BT.2020 primaries, PQ, BT.2020 matrix, and limited range.
+  const uint8_t colr[] = {'n', 'c', 'l', 'x', 0, 9, 0, 16, 0, 9, 0x00};
+  ASSERT_TRUE(ParseColorInformation(colr, sizeof(colr), &metadata));
+  EXPECT_EQ(metadata.color_primaries, HdrMetadata::kBt2020);
+  EXPECT_EQ(metadata.transfer_characteristics, HdrMetadata::kTransferPq);
+  EXPECT_EQ(metadata.matrix_coefficients, HdrMetadata::kBt2020);
+  EXPECT_FALSE(metadata.full_range);
+  EXPECT_TRUE(metadata.IsHdr());
+  EXPECT_FALSE(ParseColorInformation(colr, sizeof(colr) - 1, &metadata));
+
+  // ICC profiles are ignored.
+  const uint8_t colr_icc[] = {'p', 'r', 'o', 'f', 1, 2, 3};
+  EXPECT_TRUE(ParseColorInformation(colr_icc, sizeof(colr_icc), &metadata));
+  EXPECT_EQ(metadata.transfer_characteristics, HdrMetadata::kTransferPq);
+
+  // Display P3 primaries with a D65 white point, 1000 to 0.0001 nits.
+  const uint8_t mdcv[] = {
+      0x33, 0xc2, 0x86, 0xc4,  // G
+      0x1d, 0x4c, 0x0b, 0xb8,  // B
+      0x84, 0xd0, 0x3e, 0x80,  // R
+      0x3d, 0x13, 0x40, 0x42,  // White point
+      0x00, 0x98, 0x96, 0x80,  // Max luminance
+      0x00, 0x00, 0x00, 0x01,  // Min luminance
+  };
+  EXPECT_FALSE(ParseMasteringDisplay(mdcv, 20, &metadata));
+  EXPECT_FALSE(metadata.has_mastering_display);
+  ASSERT_TRUE(ParseMasteringDisplay(mdcv, sizeof(mdcv), &metadata));
+  EXPECT_TRUE(metadata.has_mastering_display);
+  EXPECT_EQ(metadata.display_primaries_x[0], 13250);
+  EXPECT_EQ(metadata.display_primaries_y[0], 34500);
+  EXPECT_EQ(metadata.display_primaries_x[2], 34000);
+  EXPECT_EQ(metadata.white_point_x, 15635);
+  EXPECT_EQ(metadata.white_point_y, 16450);
+  EXPECT_EQ(metadata.max_display_mastering_luminance, 10000000u);
+  EXPECT_EQ(metadata.min_display_mastering_luminance, 1u);
+
+  const uint8_t clli[] = {0x03, 0xe8, 0x01, 0x90};
+  ASSERT_TRUE(ParseContentLightLevel(clli, sizeof(clli), &metadata));
+  EXPECT_TRUE(metadata.has_content_light_level);
+  EXPECT_EQ(metadata.max_content_light_level, 1000);
+  EXPECT_EQ(metadata.max_frame_average_light_level, 400);
+}
+
+TEST(MediaUtilsTest, GetEffectiveDecodeAheadPolicy) {
+  constexpr const uint64_t kMemory = 512 * 1024 * 1024;
+  DecodeAheadPolicy policy;
+  policy.seconds = 2;
+  policy.frames = 30;
+
+  {
+    auto ret = GetEffectiveDecodeAheadPolicy(
+        policy, JsManager::MemoryPressure::None, kMemory);
+    EXPECT_EQ(ret.seconds, 2);
+    EXPECT_EQ(ret.frames, 30u);
+    // The byte limit defaults to a fraction of the physical memory.
+    EXPECT_EQ(ret.bytes, kMemory / 8);
+  }
+
+  {
+    auto ret = GetEffectiveDecodeAheadPolicy(
+        policy, JsManager::MemoryPressure::Moderate, kMemory);
+    EXPECT_EQ(ret.seconds, 1);
+    EXPECT_EQ(ret.frames, 15u);
+    EXPECT_EQ(ret.bytes, kMemory / 16);
+  }
+
+  {
+    policy.bytes = 1000;
+    auto ret = GetEffectiveDecodeAheadPolicy(
+        policy, JsManager::MemoryPressure::Critical, kMemory);
+    EXPECT_EQ(ret.seconds, 0.5);
+    EXPECT_EQ(ret.frames, 7u);
+    EXPECT_EQ(ret.bytes, 250u);
+  }
+
+  {
+    // "No limit" stays that way, and limits never reach 0.
+    policy.seconds = 0;
+    policy.frames = 1;
+    policy.bytes = 0;
+    auto ret = GetEffectiveDecodeAheadPolicy(
+        policy, JsManager::MemoryPressure::Critical, 0);
+    EXPECT_EQ(ret.seconds, 0);
+    EXPECT_EQ(ret.frames, 1u);
+    EXPECT_EQ(ret.bytes, 0u);
+  }
+}
+
+TEST(MediaUtilsTest, GetEffectiveSourceBufferQuota) {
+  constexpr const uint64_t kMemory = 512 * 1024 * 1024;
+  JsManager::SourceBufferQuota quota;
+
+  // The limits default to a fraction of the physical memory.
+  EXPECT_EQ(kMemory / 8,
+            GetEffectiveSourceBufferQuota(
+                quota, true, JsManager::MemoryPressure::None, kMemory));
+  EXPECT_EQ(kMemory / 64,
+            GetEffectiveSourceBufferQuota(
+                quota, false, JsManager::MemoryPressure::None, kMemory));
+  EXPECT_EQ(0u, GetEffectiveSourceBufferQuota(
+                    quota, true, JsManager::MemoryPressure::Critical, 0));
+
+  quota.video_bytes = 1000;
+  quota.audio_bytes = 2;
+  EXPECT_EQ(1000u, GetEffectiveSourceBufferQuota(
+                       quota, true, JsManager::MemoryPressure::None, 0));
+  EXPECT_EQ(500u,
+            GetEffectiveSourceBufferQuota(
+                quota, true, JsManager::MemoryPressure::Moderate, kMemory));
+  EXPECT_EQ(1u, GetEffectiveSourceBufferQuota(
+                    quota, false, JsManager::MemoryPressure::Critical, 0));
+}
+
 }  // namespace media
 }  // namespace shaka
@@ -0,0 +1,682 @@
+// Copyright 2020 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     https://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "src/media/mp2t/ts_demuxer.h"
+
+#include <gmock/gmock.h>
+#include <gtest/gtest.h>
+
+#include <algorithm>
+#include <map>
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace shaka {
+namespace media {
+namespace mp2t {
+
+namespace {
+
+using testing::_;
+using testing::NiceMock;
+
+constexpr const size_t kPacketSize = 188;
+constexpr const int kPmtPid = 0x20;
+constexpr const int kEsPid = 0x100;
+constexpr const uint8_t kStreamTypeAdts = 0x0f;
+constexpr const uint8_t kStreamTypeH264 = 0x1b;
+constexpr const uint8_t kStreamTypeAdtsSampleAes = 0xcf;
+constexpr const uint8_t kStreamTypeH264SampleAes = 0xdb;
+
+constexpr const char kVideoType[] = "video/mp2t; codecs=\"avc1.42c01e\"";
+constexpr const char kAudioType[] = "audio/mp2t; codecs=\"mp4a.40.2\"";
+
+// A 320x240 baseline SPS and a PPS.
+const std::vector<uint8_t> kSps = {0x67, 0x42, 0xc0, 0x1e,
+                                   0xda, 0x05, 0x07, 0xe4};
+const std::vector<uint8_t> kPps = {0x68, 0xce, 0x38, 0x80};
+
+class MockClient : public Demuxer::Client {
+ public:
+  MOCK_METHOD1(OnLoadedMetaData, void(double));
+  MOCK_METHOD3(OnEncrypted,
+               void(eme::MediaKeyInitDataType, const uint8_t*, size_t));
+};
+
+/** A demuxer that records the data it is given. */
+class FakeDemuxer : public Demuxer {
+ public:
+  explicit FakeDemuxer(std::vector<uint8_t>* data) : data_(data) {}
+
+  void Reset() override {}
+
+  bool Demux(double timestamp_offset, const uint8_t* data, size_t size,
+             std::vector<std::shared_ptr<EncodedFrame>>* frames) override {
+    data_->insert(data_->end(), data, data + size);
+    return true;
+  }
+
+ private:
+  std::vector<uint8_t>* data_;
+};
+
+class FakeDemuxerFactory : public DemuxerFactory {
+ public:
+  bool IsTypeSupported(const std::string& mime_type) const override {
+    return true;
+  }
+  bool IsCodecVideo(const std::string& codec) const override {
+    return false;
+  }
+  std::unique_ptr<Demuxer> Create(const std::string& mime_type,
+                                  Demuxer::Client* client) const override {
+    return std::unique_ptr<Demuxer>(new FakeDemuxer(&data));
+  }
+
+  /** The data given to the fallback demuxers. */
+  mutable std::vector<uint8_t> data;
+};
+
+/** Writes TS packets for tests. */
+class TsWriter {
+ public:
+  /** Adds a PAT with the given (program number, PMT PID) pairs. */
+  void AddPat(const std::vector<std::pair<int, int>>& programs) {
+    std::vector<uint8_t> entries;
+    for (auto& program : programs) {
+      entries.push_back(static_cast<uint8_t>(program.first >> 8));
+      entries.push_back(static_cast<uint8_t>(program.first));
+      entries.push_back(static_cast<uint8_t>(0xe0 | (program.second >> 8)));
+      entries.push_back(static_cast<uint8_t>(program.second));
+    }
+    // transport_stream_id, version, section_number, last_section_number.
+    const std::vector<uint8_t> header = {0, 1, 0xc1, 0, 0};
+    AddSection(0, 0x00, header, entries);
+  }
+
+  void AddPat() {
+    AddPat({{1, kPmtPid}});
+  }
+
+  /** Adds a PMT with the given (stream type, PID) pairs. */
+  void AddPmt(const std::vector<std::pair<uint8_t, int>>& streams) {
+    std::vector<uint8_t> entries;
+    for (auto& stream : streams) {
+      entries.push_back(stream.first);
+      entries.push_back(static_cast<uint8_t>(0xe0 | (stream.second >> 8)));
+      entries.push_back(static_cast<uint8_t>(stream.second));
+      entries.push_back(0xf0);  // ES_info_length
+      entries.push_back(0);
+    }
+    // program_number, version, section numbers, PCR_PID, program_info_length.
+    const std::vector<uint8_t> header = {0, 1, 0xc1, 0, 0, 0xe1, 0, 0xf0, 0};
+    AddSection(kPmtPid, 0x02, header, entries);
+  }
+
+  void AddPmt(uint8_t stream_type) {
+    AddPmt({{stream_type, kEsPid}});
+  }
+
+  /**
+   * Adds a PES packet with the given payload, split into TS packets.
+   * @param is_video Whether this is a video PES, which has no length.
+   */
+  void AddPes(uint64_t pts, const std::vector<uint8_t>& payload,
+              bool is_video) {
+    std::vector<uint8_t> pes = {0, 0, 1, static_cast<uint8_t>(
+                                             is_video ? 0xe0 : 0xc0)};
+    const size_t length = is_video ? 0 : payload.size() + 8;
+    pes.push_back(static_cast<uint8_t>(length >> 8));
+    pes.push_back(static_cast<uint8_t>(length));
+    pes.push_back(0x80);
+    pes.push_back(0x80);  // PTS only
+    pes.push_back(5);
+    pes.push_back(static_cast<uint8_t>(0x21 | ((pts >> 29) & 0x0e)));
+    pes.push_back(static_cast<uint8_t>(pts >> 22));
+    pes.push_back(static_cast<uint8_t>(((pts >> 14) & 0xfe) | 1));
+    pes.push_back(static_cast<uint8_t>(pts >> 7));
+    pes.push_back(static_cast<uint8_t>(((pts << 1) & 0xfe) | 1));
+    pes.insert(pes.end(), payload.begin(), payload.end());
+    AddPayload(kEsPid, pes);
+  }
+
+  /** Splits the given payload into TS packets for the PID. */
+  void AddPayload(int pid, const std::vector<uint8_t>& payload) {
+    for (size_t pos = 0; pos < payload.size();) {
+      const size_t size = std::min(payload.size() - pos, kPacketSize - 4);
+      AddPacket(pid, pos == 0, payload.data() + pos, size);
+      pos += size;
+    }
+  }
+
+  /** Adds a packet, using adaptation field stuffing for short payloads. */
+  void AddPacket(int pid, bool payload_start, const uint8_t* payload,
+                 size_t size) {
+    const size_t start = data.size();
+    const bool needs_stuffing = size < kPacketSize - 4;
+    data.push_back(0x47);
+    data.push_back(static_cast<uint8_t>((payload_start ? 0x40 : 0) |
+                                        (pid >> 8)));
+    data.push_back(static_cast<uint8_t>(pid));
+    data.push_back(
+        static_cast<uint8_t>((needs_stuffing ? 0x30 : 0x10) | counters_[pid]));
+    counters_[pid] = (counters_[pid] + 1) & 0xf;
+    if (needs_stuffing) {
+      const size_t field_size = kPacketSize - 4 - 1 - size;
+      data.push_back(static_cast<uint8_t>(field_size));
+      if (field_size > 0) {
+        data.push_back(0);  // flags
+        data.insert(data.end(), field_size - 1, 0xff);
+      }
+    }
+    data.insert(data.end(), payload, payload + size);
+    EXPECT_EQ(start + kPacketSize, data.size());
+  }
+
+  std::vector<uint8_t> data;
+
+ private:
+  void AddSection(int pid, uint8_t table_id, const std::vector<uint8_t>& header,
+                  const std::vector<uint8_t>& entries) {
+    const size_t section_length = header.size() + entries.size() + 4;
+    std::vector<uint8_t> payload = {
+        0,  // pointer_field
+        table_id,
+        static_cast<uint8_t>(0xb0 | (section_length >> 8)),
+        static_cast<uint8_t>(section_length),
+    };
+    payload.insert(payload.end(), header.begin(), header.end());
+    payload.insert(payload.end(), entries.begin(), entries.end());
+    payload.insert(payload.end(), 4, 0);  // CRC, which isn't checked.
+    payload.resize(kPacketSize - 4, 0xff);
+    AddPacket(pid, true, payload.data(), payload.size());
+  }
+
+  std::map<int, int> counters_;
+};
+
+/** @return An Annex B video frame of the given size. */
+std::vector<uint8_t> MakeVideoFrame(bool is_key_frame, size_t slice_size,
+                                    uint8_t fill = 0xab) {
+  std::vector<uint8_t> ret;
+  const std::vector<uint8_t> start_code = {0, 0, 0, 1};
+  if (is_key_frame) {
+    ret.insert(ret.end(), start_code.begin(), start_code.end());
+    ret.insert(ret.end(), kSps.begin(), kSps.end());
+    ret.insert(ret.end(), start_code.begin(), start_code.end());
+    ret.insert(ret.end(), kPps.begin(), kPps.end());
+  }
+  ret.insert(ret.end(), start_code.begin(), start_code.end());
+  ret.push_back(is_key_frame ? 0x65 : 0x41);
+  ret.insert(ret.end(), slice_size - 1, fill);
+  return ret;
+}
+
+/** @return An ADTS frame (AAC LC, 44.1kHz, stereo) with the given payload. */
+std::vector<uint8_t> MakeAdtsFrame(size_t raw_size, uint8_t fill = 0xcd) {
+  const size_t frame_size = raw_size + 7;
+  std::vector<uint8_t> ret = {
+      0xff,
+      0xf1,  // MPEG-4, layer 0, no CRC
+      static_cast<uint8_t>((1 << 6) | (4 << 2)),  // AAC LC, 44.1kHz
+      static_cast<uint8_t>((2 << 6) | (frame_size >> 11)),
+      static_cast<uint8_t>(frame_size >> 3),
+      static_cast<uint8_t>(((frame_size & 0x7) << 5) | 0x1f),
+      0xfc,  // One raw data block
+  };
+  ret.insert(ret.end(), raw_size, fill);
+  return ret;
+}
+
+std::vector<uint8_t> Concat(const std::vector<std::vector<uint8_t>>& parts) {
+  std::vector<uint8_t> ret;
+  for (auto& part : parts)
+    ret.insert(ret.end(), part.begin(), part.end());
+  return ret;
+}
+
+}  // namespace
+
+class TsDemuxerTest : public testing::Test {
+ protected:
+  std::unique_ptr<TsDemuxer> MakeDemuxer(const std::string& mime_type) {
+    return std::unique_ptr<TsDemuxer>(
+        new TsDemuxer(&client_, mime_type, &fallback_factory_));
+  }
+
+  NiceMock<MockClient> client_;
+  FakeDemuxerFactory fallback_factory_;
+};
+
+TEST_F(TsDemuxerTest, ReadsH264Frames) {
+  TsWriter writer;
+  writer.AddPat();
+  writer.AddPmt(kStreamTypeH264);
+  writer.AddPes(90000, MakeVideoFrame(true, 100), true);
+  writer.AddPes(93000, MakeVideoFrame(false, 50), true);
+  writer.AddPes(96000, MakeVideoFrame(false, 60), true);
+
+  EXPECT_CALL(client_, OnLoadedMetaData(_)).Times(1);
+  auto demuxer = MakeDemuxer(kVideoType);
+  std::vector<std::shared_ptr<EncodedFrame>> frames;
+  ASSERT_TRUE(demuxer->Demux(0, writer.data.data(), writer.data.size(),
+                             &frames));
+  ASSERT_EQ(3u, frames.size());
+
+  EXPECT_TRUE(frames[0]->is_key_frame);
+  EXPECT_FALSE(frames[1]->is_key_frame);
+  EXPECT_DOUBLE_EQ(1, frames[0]->pts);
+  EXPECT_DOUBLE_EQ(93000 / 90000.0, frames[1]->pts);
+  EXPECT_NEAR(3000 / 90000.0, frames[0]->duration, 0.000001);
+  // The last frame uses the duration of the one before it.
+  EXPECT_NEAR(3000 / 90000.0, frames[2]->duration, 0.000001);
+
+  // The NAL units use 4-byte lengths.
+  ASSERT_EQ(4 + kSps.size() + 4 + kPps.size() + 4 + 100,
+            frames[0]->data_size);
+  EXPECT_EQ(std::vector<uint8_t>({0, 0, 0, 8}),
+            std::vector<uint8_t>(frames[0]->data, frames[0]->data + 4));
+  ASSERT_EQ(4u + 50u, frames[1]->data_size);
+  EXPECT_EQ(std::vector<uint8_t>({0, 0, 0, 50, 0x41}),
+            std::vector<uint8_t>(frames[1]->data, frames[1]->data + 5));
+
+  ASSERT_TRUE(frames[0]->stream_info);
+  EXPECT_TRUE(frames[0]->stream_info->is_video);
+  EXPECT_EQ(320u, frames[0]->stream_info->width);
+  EXPECT_EQ(240u, frames[0]->stream_info->height);
+  EXPECT_EQ(frames[0]->stream_info.get(), frames[2]->stream_info.get());
+  EXPECT_TRUE(fallback_factory_.data.empty());
+}
+
+TEST_F(TsDemuxerTest, ReadsAdtsFrames) {
+  TsWriter writer;
+  writer.AddPat();
+  writer.AddPmt(kStreamTypeAdts);
+  writer.AddPes(90000, Concat({MakeAdtsFrame(20), MakeAdtsFrame(30)}), false);
+
+  auto demuxer = MakeDemuxer(kAudioType);
+  std::vector<std::shared_ptr<EncodedFrame>> frames;
+  ASSERT_TRUE(demuxer->Demux(0, writer.data.data(), writer.data.size(),
+                             &frames));
+  ASSERT_EQ(2u, frames.size());
+  // The ADTS headers are removed.
+  EXPECT_EQ(20u, frames[0]->data_size);
+  EXPECT_EQ(30u, frames[1]->data_size);
+  EXPECT_DOUBLE_EQ(1, frames[0]->pts);
+  EXPECT_DOUBLE_EQ(1 + 1024 / 44100.0, frames[1]->pts);
+  ASSERT_TRUE(frames[0]->stream_info);
+  EXPECT_EQ(44100u, frames[0]->stream_info->sample_rate);
+  EXPECT_EQ(2u, frames[0]->stream_info->channel_count);
+  EXPECT_EQ(std::vector<uint8_t>({0x12, 0x10}),
+            frames[0]->stream_info->extra_data);
+}
+
+TEST_F(TsDemuxerTest, UsesFirstProgramAndMatchingStream) {
+  TsWriter writer;
+  // Program 0 is the network PID, which isn't a PMT.
+  writer.AddPat({{0, 0x10}, {1, kPmtPid}, {2, 0x30}});
+  // Only the stream that matches the codec is read.
+  writer.AddPmt({{kStreamTypeAdts, 0x101}, {kStreamTypeH264, kEsPid}});
+  writer.AddPes(90000, MakeVideoFrame(true, 100), true);
+
+  auto demuxer = MakeDemuxer(kVideoType);
+  std::vector<std::shared_ptr<EncodedFrame>> frames;
+  ASSERT_TRUE(demuxer->Demux(0, writer.data.data(), writer.data.size(),
+                             &frames));
+  ASSERT_EQ(1u, frames.size());
+  EXPECT_TRUE(fallback_factory_.data.empty());
+}
+
+TEST_F(TsDemuxerTest, FallsBackForUnsupportedStreams) {
+  TsWriter writer;
+  writer.AddPat();
+  writer.AddPmt(0x24);  // HEVC
+  writer.AddPes(90000, MakeVideoFrame(true, 100), true);
+
+  auto demuxer = MakeDemuxer("video/mp2t; codecs=\"hvc1.1.6.L93.B0\"");
+  std::vector<std::shared_ptr<EncodedFrame>> frames;
+  ASSERT_TRUE(demuxer->Demux(0, writer.data.data(), writer.data.size(),
+                             &frames));
+  EXPECT_TRUE(frames.empty());
+  // The fallback gets the whole input, including the PAT.
+  EXPECT_EQ(writer.data, fallback_factory_.data);
+
+  // Later data goes straight to the fallback.
+  TsWriter more;
+  more.AddPes(93000, MakeVideoFrame(false, 50), true);
+  ASSERT_TRUE(demuxer->Demux(0, more.data.data(), more.data.size(), &frames));
+  EXPECT_EQ(writer.data.size() + more.data.size(),
+            fallback_factory_.data.size());
+}
+
+TEST_F(TsDemuxerTest, FallsBackForPsiSpanningPackets) {
+  TsWriter writer;
+  // A PMT section that claims to be longer than the packet.
+  std::vector<uint8_t> payload = {0, 0x02, 0xb1, 0xff};
+  payload.resize(kPacketSize - 4, 0);
+  writer.AddPat();
+  writer.AddPacket(kPmtPid, true, payload.data(), payload.size());
+
+  auto demuxer = MakeDemuxer(kVideoType);
+  std::vector<std::shared_ptr<EncodedFrame>> frames;
+  ASSERT_TRUE(demuxer->Demux(0, writer.data.data(), writer.data.size(),
+                             &frames));
+  EXPECT_EQ(writer.data, fallback_factory_.data);
+}
+
+TEST_F(TsDemuxerTest, FailsForInvalidPsi) {
+  TsWriter writer;
+  // The pointer field points past the end of the packet.
+  std::vector<uint8_t> payload(kPacketSize - 4, 0xff);
+  payload[0] = 200;
+  writer.AddPacket(0, true, payload.data(), payload.size());
+
+  auto demuxer = MakeDemuxer(kVideoType);
+  std::vector<std::shared_ptr<EncodedFrame>> frames;
+  EXPECT_FALSE(demuxer->Demux(0, writer.data.data(), writer.data.size(),
+                              &frames));
+}
+
+TEST_F(TsDemuxerTest, ReassemblesPesAcrossPackets) {
+  // A frame that needs several TS packets.
+  const std::vector<uint8_t> frame = MakeVideoFrame(true, 1000);
+  TsWriter writer;
+  writer.AddPat();
+  writer.AddPmt(kStreamTypeH264);
+  writer.AddPes(90000, frame, true);
+
+  auto demuxer = MakeDemuxer(kVideoType);
+  std::vector<std::shared_ptr<EncodedFrame>> frames;
+  ASSERT_TRUE(demuxer->Demux(0, writer.data.data(), writer.data.size(),
+                             &frames));
+  ASSERT_EQ(1u, frames.size());
+  ASSERT_EQ(frame.size(), frames[0]->data_size);
+  // The start codes are replaced by lengths, so the slice data is the same.
+  EXPECT_TRUE(std::equal(frame.end() - 999, frame.end(),
+                         frames[0]->data + frames[0]->data_size - 999));
+}
+
+TEST_F(TsDemuxerTest, ReassemblesPesAcrossDemuxCalls) {
+  TsWriter writer;
+  writer.AddPat();
+  writer.AddPmt(kStreamTypeH264);
+  writer.AddPes(90000, MakeVideoFrame(true, 1000), true);
+  writer.AddPes(93000, MakeVideoFrame(false, 500), true);
+
+  // Give the data in chunks that split packets.
+  auto demuxer = MakeDemuxer(kVideoType);
+  std::vector<std::shared_ptr<EncodedFrame>> frames;
+  for (size_t pos = 0; pos < writer.data.size(); pos += 100) {
+    const size_t size = std::min<size_t>(100, writer.data.size() - pos);
+    ASSERT_TRUE(demuxer->Demux(0, writer.data.data() + pos, size, &frames));
+  }
+  ASSERT_EQ(2u, frames.size());
+  EXPECT_EQ(4 + kSps.size() + 4 + kPps.size() + 4 + 1000,
+            frames[0]->data_size);
+  EXPECT_EQ(4u + 500u, frames[1]->data_size);
+}
+
+TEST_F(TsDemuxerTest, ReassemblesBoundedPesAcrossDemuxCalls) {
+  // An audio PES has a length, so it isn't output until it is complete, even
+  // if an append ends on a packet boundary.
+  TsWriter writer;
+  writer.AddPat();
+  writer.AddPmt(kStreamTypeAdts);
+  writer.AddPes(90000, Concat({MakeAdtsFrame(200), MakeAdtsFrame(200)}),
+                false);
+
+  auto demuxer = MakeDemuxer(kAudioType);
+  std::vector<std::shared_ptr<EncodedFrame>> frames;
+  const size_t split = 3 * kPacketSize;
+  ASSERT_TRUE(demuxer->Demux(0, writer.data.data(), split, &frames));
+  EXPECT_TRUE(frames.empty());
+  ASSERT_TRUE(demuxer->Demux(0, writer.data.data() + split,
+                             writer.data.size() - split, &frames));
+  EXPECT_EQ(2u, frames.size());
+}
+
+TEST_F(TsDemuxerTest, OutputsLastFrameOfEachAppend) {
+  TsWriter writer;
+  writer.AddPat();
+  writer.AddPmt(kStreamTypeH264);
+  writer.AddPes(90000, MakeVideoFrame(true, 100), true);
+  const size_t first_end = writer.data.size();
+  writer.AddPes(93000, MakeVideoFrame(false, 50), true);
+
+  auto demuxer = MakeDemuxer(kVideoType);
+  std::vector<std::shared_ptr<EncodedFrame>> frames;
+  ASSERT_TRUE(demuxer->Demux(0, writer.data.data(), first_end, &frames));
+  ASSERT_EQ(1u, frames.size());
+  EXPECT_DOUBLE_EQ(1, frames[0]->pts);
+
+  // The last frame of the stream is output too.
+  ASSERT_TRUE(demuxer->Demux(0, writer.data.data() + first_end,
+                             writer.data.size() - first_end, &frames));
+  ASSERT_EQ(2u, frames.size());
+  EXPECT_DOUBLE_EQ(93000 / 90000.0, frames[1]->pts);
+}
+
+TEST_F(TsDemuxerTest, RecoversFromLostSync) {
+  TsWriter writer;
+  writer.AddPat();
+  writer.AddPmt(kStreamTypeH264);
+  writer.AddPes(90000, MakeVideoFrame(true, 100), true);
+  const size_t garbage_pos = writer.data.size();
+  writer.AddPes(93000, MakeVideoFrame(false, 50), true);
+  // Insert garbage between packets; it doesn't contain a sync byte.
+  writer.data.insert(writer.data.begin() + garbage_pos, 37, 0x11);
+
+  auto demuxer = MakeDemuxer(kVideoType);
+  std::vector<std::shared_ptr<EncodedFrame>> frames;
+  ASSERT_TRUE(demuxer->Demux(0, writer.data.data(), writer.data.size(),
+                             &frames));
+  EXPECT_EQ(2u, frames.size());
+}
+
+TEST_F(TsDemuxerTest, DropsPesWithContinuityError) {
+  TsWriter writer;
+  writer.AddPat();
+  writer.AddPmt(kStreamTypeH264);
+  writer.AddPes(90000, MakeVideoFrame(true, 100), true);
+  const size_t lost_pos = writer.data.size() + kPacketSize;
+  writer.AddPes(93000, MakeVideoFrame(false, 500), true);
+  writer.AddPes(96000, MakeVideoFrame(false, 50), true);
+  // Lose the second packet of the second frame.
+  writer.data.erase(writer.data.begin() + lost_pos,
+                    writer.data.begin() + lost_pos + kPacketSize);
+
+  auto demuxer = MakeDemuxer(kVideoType);
+  std::vector<std::shared_ptr<EncodedFrame>> frames;
+  ASSERT_TRUE(demuxer->Demux(0, writer.data.data(), writer.data.size(),
+                             &frames));
+  ASSERT_EQ(2u, frames.size());
+  EXPECT_DOUBLE_EQ(1, frames[0]->pts);
+  EXPECT_DOUBLE_EQ(96000 / 90000.0, frames[1]->pts);
+}
+
+TEST_F(TsDemuxerTest, IgnoresDuplicatePackets) {
+  TsWriter writer;
+  writer.AddPat();
+  writer.AddPmt(kStreamTypeH264);
+  writer.AddPes(90000, MakeVideoFrame(true, 500), true);
+  // Send the second packet of the frame twice.
+  const size_t dup_pos = 3 * kPacketSize;
+  const std::vector<uint8_t> packet(writer.data.begin() + dup_pos,
+                                    writer.data.begin() + dup_pos +
+                                        kPacketSize);
+  writer.data.insert(writer.data.begin() + dup_pos + kPacketSize,
+                     packet.begin(), packet.end());
+
+  auto demuxer = MakeDemuxer(kVideoType);
+  std::vector<std::shared_ptr<EncodedFrame>> frames;
+  ASSERT_TRUE(demuxer->Demux(0, writer.data.data(), writer.data.size(),
+                             &frames));
+  ASSERT_EQ(1u, frames.size());
+  EXPECT_EQ(4 + kSps.size() + 4 + kPps.size() + 4 + 500,
+            frames[0]->data_size);
+}
+
+TEST_F(TsDemuxerTest, HandlesTruncatedData) {
+  TsWriter writer;
+  writer.AddPat();
+  writer.AddPmt(kStreamTypeH264);
+  writer.AddPes(90000, MakeVideoFrame(true, 100), true);
+  // A packet whose adaptation field fills the whole packet.
+  std::vector<uint8_t> packet(kPacketSize, 0xff);
+  packet[0] = 0x47;
+  packet[1] = kEsPid >> 8;
+  packet[2] = kEsPid & 0xff;
+  packet[3] = 0x30;
+  packet[4] = 200;
+  writer.data.insert(writer.data.end(), packet.begin(), packet.end());
+  // A PES packet whose header is cut short.
+  const std::vector<uint8_t> short_pes = {0, 0, 1, 0xe0, 0, 0, 0x80};
+  writer.AddPayload(kEsPid, short_pes);
+
+  auto demuxer = MakeDemuxer(kVideoType);
+  std::vector<std::shared_ptr<EncodedFrame>> frames;
+  // The input ends in the middle of a packet, which is kept for later.  The
+  // frame isn't complete until the next PES packet starts.
+  ASSERT_TRUE(demuxer->Demux(0, writer.data.data(), writer.data.size() - 50,
+                             &frames));
+  EXPECT_TRUE(frames.empty());
+  // The short PES packet is dropped.
+  ASSERT_TRUE(demuxer->Demux(0, writer.data.data() + writer.data.size() - 50,
+                             50, &frames));
+  EXPECT_EQ(1u, frames.size());
+
+  // Data that is too short for a packet is kept until Reset.
+  ASSERT_TRUE(demuxer->Demux(0, writer.data.data(), 100, &frames));
+  demuxer->Reset();
+  TsWriter more;
+  more.AddPat();
+  more.AddPmt(kStreamTypeH264);
+  more.AddPes(93000, MakeVideoFrame(true, 100), true);
+  ASSERT_TRUE(demuxer->Demux(0, more.data.data(), more.data.size(), &frames));
+  EXPECT_EQ(2u, frames.size());
+}
+
+TEST_F(TsDemuxerTest, SkipsFalseAdtsSyncwords) {
+  // Data before the first frame that looks like an ADTS header with an
+  // invalid sample rate and one with a frame size that doesn't fit.
+  const std::vector<uint8_t> junk = {0x01, 0xff, 0xf1, 0xfc, 0x80, 0x00, 0x1f,
+                                     0xfc, 0xff, 0xf1, 0x50, 0x83, 0xff, 0xff,
+                                     0xfc};
+  TsWriter writer;
+  writer.AddPat();
+  writer.AddPmt(kStreamTypeAdts);
+  writer.AddPes(90000, Concat({junk, MakeAdtsFrame(20), MakeAdtsFrame(30)}),
+                false);
+
+  auto demuxer = MakeDemuxer(kAudioType);
+  std::vector<std::shared_ptr<EncodedFrame>> frames;
+  ASSERT_TRUE(demuxer->Demux(0, writer.data.data(), writer.data.size(),
+                             &frames));
+  ASSERT_EQ(2u, frames.size());
+  EXPECT_EQ(20u, frames[0]->data_size);
+  EXPECT_EQ(30u, frames[1]->data_size);
+}
+
+TEST_F(TsDemuxerTest, SampleAesVideoSubsamples) {
+  TsWriter writer;
+  writer.AddPat();
+  writer.AddPmt(kStreamTypeH264SampleAes);
+  // A 100-byte IDR slice and a 40-byte one, which is too short to encrypt.
+  writer.AddPes(90000,
+                Concat({MakeVideoFrame(true, 100),
+                        {0, 0, 0, 1, 0x65},
+                        std::vector<uint8_t>(39, 0xab)}),
+                true);
+
+  auto demuxer = MakeDemuxer(kVideoType);
+  std::vector<std::shared_ptr<EncodedFrame>> frames;
+  ASSERT_TRUE(demuxer->Demux(0, writer.data.data(), writer.data.size(),
+                             &frames));
+  ASSERT_EQ(1u, frames.size());
+  const auto& info = frames[0]->encryption_info;
+  ASSERT_TRUE(info);
+  EXPECT_EQ(eme::EncryptionScheme::AesCbc, info->scheme);
+  EXPECT_EQ(1u, info->pattern.encrypted_blocks);
+  EXPECT_EQ(9u, info->pattern.clear_blocks);
+  // The key ID and IV come from the playlist.
+  EXPECT_TRUE(info->key_id.empty());
+  EXPECT_TRUE(info->iv.empty());
+
+  // The SPS and PPS are clear, then the slice has a 32-byte clear leader, and
+  // the rest is encrypted except the last partial block; the 68-byte body
+  // has 64 protected bytes.  The short slice is clear.
+  const size_t header = 4 + kSps.size() + 4 + kPps.size();
+  ASSERT_EQ(2u, info->subsamples.size());
+  EXPECT_EQ(header + 4 + 32, info->subsamples[0].clear_bytes);
+  EXPECT_EQ(64u, info->subsamples[0].protected_bytes);
+  EXPECT_EQ(4u + 4u + 40u, info->subsamples[1].clear_bytes);
+  EXPECT_EQ(0u, info->subsamples[1].protected_bytes);
+
+  size_t total = 0;
+  for (auto& subsample : info->subsamples)
+    total += subsample.clear_bytes + subsample.protected_bytes;
+  EXPECT_EQ(frames[0]->data_size, total);
+}
+
+TEST_F(TsDemuxerTest, SampleAesAudioSubsamples) {
+  TsWriter writer;
+  writer.AddPat();
+  writer.AddPmt(kStreamTypeAdtsSampleAes);
+  writer.AddPes(90000, Concat({MakeAdtsFrame(50), MakeAdtsFrame(10)}), false);
+
+  auto demuxer = MakeDemuxer(kAudioType);
+  std::vector<std::shared_ptr<EncodedFrame>> frames;
+  ASSERT_TRUE(demuxer->Demux(0, writer.data.data(), writer.data.size(),
+                             &frames));
+  ASSERT_EQ(2u, frames.size());
+
+  // A 16-byte clear leader, then whole encrypted blocks and a clear tail.
+  const auto& info = frames[0]->encryption_info;
+  ASSERT_TRUE(info);
+  EXPECT_EQ(eme::EncryptionScheme::AesCbc, info->scheme);
+  ASSERT_EQ(2u, info->subsamples.size());
+  EXPECT_EQ(16u, info->subsamples[0].clear_bytes);
+  EXPECT_EQ(32u, info->subsamples[0].protected_bytes);
+  EXPECT_EQ(2u, info->subsamples[1].clear_bytes);
+  EXPECT_EQ(0u, info->subsamples[1].protected_bytes);
+
+  // A frame no larger than the leader is clear.
+  EXPECT_FALSE(frames[1]->encryption_info);
+}
+
+TEST_F(TsDemuxerTest, UnwrapsTimestamps) {
+  const uint64_t wrap = UINT64_C(1) << 33;
+  TsWriter writer;
+  writer.AddPat();
+  writer.AddPmt(kStreamTypeH264);
+  writer.AddPes(wrap - 3000, MakeVideoFrame(true, 100), true);
+  writer.AddPes(0, MakeVideoFrame(false, 50), true);
+  writer.AddPes(3000, MakeVideoFrame(false, 50), true);
+
+  auto demuxer = MakeDemuxer(kVideoType);
+  std::vector<std::shared_ptr<EncodedFrame>> frames;
+  ASSERT_TRUE(demuxer->Demux(0, writer.data.data(), writer.data.size(),
+                             &frames));
+  ASSERT_EQ(3u, frames.size());
+  const double first = (wrap - 3000) / 90000.0;
+  EXPECT_DOUBLE_EQ(first, frames[0]->pts);
+  EXPECT_DOUBLE_EQ(first + 3000 / 90000.0, frames[1]->pts);
+  EXPECT_DOUBLE_EQ(first + 6000 / 90000.0, frames[2]->pts);
+  EXPECT_NEAR(3000 / 90000.0, frames[0]->duration, 0.000001);
+}
+
+}  // namespace mp2t
+}  // namespace media
+}  // namespace shaka
@@ -373,5 +373,48 @@ TEST(PipelineManagerTest, PlayAfterEnd) {
   EXPECT_EQ(pipeline.GetPlaybackState(), VideoPlaybackState::Playing);
 }
 
+TEST(PipelineManagerTest, FollowsMasterClock) {
+  NiceMock<MockClock> clock;
+  NiceMock<MockFunction<void(VideoPlaybackState)>> client;
+  auto callback = std::bind(&decltype(client)::Call, &client, _1);
+  bool has_master_time = true;
+  double master_time = 0;
+  auto master_clock = [&](double* time) {
+    *time = master_time;
+    return has_master_time;
+  };
+
+  EXPECT_CALL(clock, GetMonotonicTime()).WillRepeatedly(Return(0));
+  PipelineManager pipeline(callback, &IgnoreSeek, &clock, master_clock);
+  pipeline.DoneInitializing();
+  pipeline.Play();
+  pipeline.CanPlay();
+
+  // The master clock isn't used until enabled.
+  master_time = 1.5;
+  EXPECT_EQ(pipeline.GetCurrentTime(), 0);
+  pipeline.SetUseMasterClock(true);
+  EXPECT_EQ(pipeline.GetCurrentTime(), 1.5);
+
+  // The wall clock continues from the master time when it isn't known.
+  EXPECT_CALL(clock, GetMonotonicTime()).WillRepeatedly(Return(1000));
+  master_time = 2;
+  EXPECT_EQ(pipeline.GetCurrentTime(), 2);
+  pipeline.Pause();
+  has_master_time = false;
+  EXPECT_EQ(pipeline.GetCurrentTime(), 2);
+  pipeline.Play();
+  pipeline.CanPlay();
+  EXPECT_CALL(clock, GetMonotonicTime()).WillRepeatedly(Return(2000));
+  EXPECT_EQ(pipeline.GetCurrentTime(), 3);
+
+  // The master clock is only used while playing.
+  has_master_time = true;
+  master_time = 5;
+  pipeline.Buffering();
+  master_time = 6;
+  EXPECT_EQ(pipeline.GetCurrentTime(), 5);
+}
+
 }  // namespace media
 }  // namespace shaka
@@ -18,6 +18,8 @@
 #include <gtest/gtest.h>
 #include <math.h>
 
+#include <future>
+
 #include "src/media/pipeline_manager.h"
 #include "src/util/clock.h"
 
@@ -28,7 +30,9 @@ namespace {
 
 using testing::_;
 using testing::AtLeast;
+using testing::DoubleEq;
 using testing::InSequence;
+using testing::Invoke;
 using testing::MockFunction;
 using testing::NiceMock;
 using testing::Return;
@@ -39,6 +43,11 @@ class MockClock : public util::Clock {
  public:
   MOCK_CONST_METHOD0(GetMonotonicTime, uint64_t());
   MOCK_CONST_METHOD1(SleepSeconds, void(double));
+  // By default, this returns immediately so the monitor checks the state
+  // again, since the fake time and state don't signal changes.
+  MOCK_CONST_METHOD3(WaitForSignal,
+                     void(std::condition_variable*,
+                          std::unique_lock<std::mutex>*, double));
 };
 
 class MockPipelineManager : public PipelineManager {
@@ -162,5 +171,129 @@ TEST(PipelineMonitorTest, ChangesPiplineStatuses) {
   util::Clock::Instance.SleepSeconds(0.01);
 }
 
+TEST(PipelineMonitorTest, WaitsForPlayheadToReachDecodedEnd) {
+  NiceMock<MockClock> clock;
+  NiceMock<MockPipelineManager> pipeline(&clock);
+  MockFunction<BufferedRanges()> get_buffered;
+  MockFunction<BufferedRanges()> get_decoded;
+  NiceMock<MockFunction<void(VideoReadyState)>> ready_state_changed;
+
+  EXPECT_CALL(pipeline, GetPlaybackState())
+      .WillRepeatedly(Return(VideoPlaybackState::Playing));
+  EXPECT_CALL(pipeline, GetCurrentTime()).WillRepeatedly(Return(1));
+  EXPECT_CALL(pipeline, GetDuration()).WillRepeatedly(Return(10));
+  EXPECT_CALL(pipeline, GetPlaybackRate()).WillRepeatedly(Return(2));
+  EXPECT_CALL(get_buffered, Call())
+      .WillRepeatedly(Return(BufferedRanges{{0, 5}}));
+  EXPECT_CALL(get_decoded, Call())
+      .WillRepeatedly(Return(BufferedRanges{{0, 3}}));
+  // The playhead reaches the end of the decoded range in 1 second.
+  EXPECT_CALL(clock, WaitForSignal(_, _, DoubleEq(1))).Times(AtLeast(1));
+
+  PipelineMonitor monitor(CALLBACK(get_buffered), CALLBACK(get_decoded),
+                          CALLBACK1(ready_state_changed), &clock, &pipeline);
+  monitor.Start();
+  util::Clock::Instance.SleepSeconds(0.01);
+}
+
+TEST(PipelineMonitorTest, WaitsForWakeWhilePaused) {
+  NiceMock<MockClock> clock;
+  NiceMock<MockPipelineManager> pipeline(&clock);
+  MockFunction<BufferedRanges()> get_buffered;
+  NiceMock<MockFunction<void(VideoReadyState)>> ready_state_changed;
+
+  EXPECT_CALL(pipeline, GetPlaybackState())
+      .WillRepeatedly(Return(VideoPlaybackState::Paused));
+  EXPECT_CALL(pipeline, GetDuration()).WillRepeatedly(Return(10));
+  EXPECT_CALL(get_buffered, Call())
+      .WillRepeatedly(Return(BufferedRanges{{0, 5}}));
+  EXPECT_CALL(clock, WaitForSignal(_, _, HUGE_VAL)).Times(AtLeast(1));
+
+  PipelineMonitor monitor(CALLBACK(get_buffered), CALLBACK(get_buffered),
+                          CALLBACK1(ready_state_changed), &clock, &pipeline);
+  monitor.Start();
+  util::Clock::Instance.SleepSeconds(0.01);
+}
+
+TEST(PipelineMonitorTest, NeedsLessBufferedInLowLatencyMode) {
+  NiceMock<MockClock> clock;
+  NiceMock<MockPipelineManager> pipeline(&clock);
+  MockFunction<BufferedRanges()> get_buffered;
+  MockFunction<void(VideoReadyState)> ready_state_changed;
+  std::promise<void> has_current_data;
+  std::promise<void> has_future_data;
+
+  EXPECT_CALL(pipeline, GetPlaybackState())
+      .WillRepeatedly(Return(VideoPlaybackState::Paused));
+  EXPECT_CALL(pipeline, GetCurrentTime()).WillRepeatedly(Return(0));
+  EXPECT_CALL(pipeline, GetDuration()).WillRepeatedly(Return(10));
+  EXPECT_CALL(get_buffered, Call())
+      .WillRepeatedly(Return(BufferedRanges{{0, 0.2}}));
+  {
+    InSequence seq;
+    EXPECT_CALL(ready_state_changed, Call(VideoReadyState::HaveCurrentData))
+        .WillOnce(
+            Invoke([&](VideoReadyState) { has_current_data.set_value(); }));
+    EXPECT_CALL(ready_state_changed, Call(VideoReadyState::HaveFutureData))
+        .WillOnce(
+            Invoke([&](VideoReadyState) { has_future_data.set_value(); }));
+  }
+
+  PipelineMonitor monitor(CALLBACK(get_buffered), CALLBACK(get_buffered),
+                          CALLBACK1(ready_state_changed), &clock, &pipeline);
+  monitor.Start();
+  ASSERT_EQ(std::future_status::ready, has_current_data.get_future().wait_for(
+                                           std::chrono::seconds(1)));
+
+  monitor.SetLowLatency(true);
+  ASSERT_EQ(std::future_status::ready, has_future_data.get_future().wait_for(
+                                           std::chrono::seconds(1)));
+}
+
+TEST(PipelineMonitorTest, ChecksStateWhenWoken) {
+  NiceMock<MockPipelineManager> pipeline(&util::Clock::Instance);
+  MockFunction<BufferedRanges()> get_buffered;
+  MockFunction<void(VideoReadyState)> ready_state_changed;
+  std::promise<void> has_future_data;
+  std::promise<void> has_metadata;
+
+  EXPECT_CALL(pipeline, GetPlaybackState())
+      .WillRepeatedly(Return(VideoPlaybackState::Paused));
+  EXPECT_CALL(pipeline, GetDuration()).WillRepeatedly(Return(10));
+  {
+    InSequence seq;
+    EXPECT_CALL(get_buffered, Call())
+        .WillRepeatedly(Return(BufferedRanges{{0, 5}}));
+    EXPECT_CALL(ready_state_changed, Call(VideoReadyState::HaveFutureData))
+        .WillOnce(
+            Invoke([&](VideoReadyState) { has_future_data.set_value(); }));
+    EXPECT_CALL(get_buffered, Call())
+        .WillRepeatedly(Return(BufferedRanges()));
+    EXPECT_CALL(ready_state_changed, Call(VideoReadyState::HaveMetadata))
+        .WillOnce(
+            Invoke([&](VideoReadyState) { has_metadata.set_value(); }));
+    EXPECT_CALL(get_buffered, Call())
+        .WillRepeatedly(Return(BufferedRanges()));
+  }
+
+  // This uses the real clock, so the monitor only checks the state again once
+  // it is woken.
+  PipelineMonitor monitor(CALLBACK(get_buffered), CALLBACK(get_buffered),
+                          CALLBACK1(ready_state_changed),
+                          &util::Clock::Instance, &pipeline);
+  monitor.Start();
+  ASSERT_EQ(std::future_status::ready, has_future_data.get_future().wait_for(
+                                           std::chrono::seconds(1)));
+
+  // The buffered ranges changed, but we didn't wake the monitor.
+  auto metadata_future = has_metadata.get_future();
+  EXPECT_EQ(std::future_status::timeout,
+            metadata_future.wait_for(std::chrono::milliseconds(50)));
+
+  monitor.Wake();
+  ASSERT_EQ(std::future_status::ready,
+            metadata_future.wait_for(std::chrono::seconds(1)));
+}
+
 }  // namespace media
 }  // namespace shaka
@@ -0,0 +1,322 @@
+// Copyright 2020 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     https://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "src/media/pixel_conversion.h"
+
+#include <glog/logging.h>
+#include <gtest/gtest.h>
+
+#include <algorithm>
+#include <chrono>
+#include <vector>
+
+namespace shaka {
+namespace media {
+
+namespace {
+
+/** Creates a plane of 16-bit little-endian components. */
+std::vector<uint8_t> MakePlane16(size_t samples, size_t rows, size_t stride,
+                                 unsigned int shift) {
+  std::vector<uint8_t> ret(stride * rows, 0xff);
+  for (size_t row = 0; row < rows; row++) {
+    for (size_t i = 0; i < samples; i++) {
+      const uint16_t value = static_cast<uint16_t>(((row + i) & 0xff) << shift);
+      ret[row * stride + i * 2] = value & 0xff;
+      ret[row * stride + i * 2 + 1] = value >> 8;
+    }
+  }
+  return ret;
+}
+
+}  // namespace
+
+TEST(PixelConversionTest, CopyPlane) {
+  // Use an odd width so it doesn't line up with the SIMD sizes.
+  constexpr const size_t kWidth = 37;
+  constexpr const size_t kRows = 5;
+  std::vector<uint8_t> src(48 * kRows);
+  for (size_t i = 0; i < src.size(); i++)
+    src[i] = static_cast<uint8_t>(i);
+
+  std::vector<uint8_t> dest(40 * kRows, 0);
+  CopyPlane(src.data(), 48, dest.data(), 40, kWidth, kRows);
+  for (size_t row = 0; row < kRows; row++) {
+    for (size_t i = 0; i < 40; i++) {
+      EXPECT_EQ(i < kWidth ? src[row * 48 + i] : 0, dest[row * 40 + i])
+          << "row=" << row << ", i=" << i;
+    }
+  }
+
+  std::vector<uint8_t> same(48 * kRows, 0);
+  CopyPlane(src.data(), 48, same.data(), 48, kWidth, kRows);
+  for (size_t row = 0; row < kRows; row++) {
+    for (size_t i = 0; i < kWidth; i++)
+      EXPECT_EQ(src[row * 48 + i], same[row * 48 + i]);
+  }
+}
+
+TEST(PixelConversionTest, ConvertsLowBits) {
+  // YUV420P10 stores 10 bits in the low bits.
+  constexpr const size_t kSamples = 53;
+  constexpr const size_t kRows = 3;
+  constexpr const size_t kStride = 128;
+  const std::vector<uint8_t> src = MakePlane16(kSamples, kRows, kStride, 2);
+
+  std::vector<uint8_t> dest(64 * kRows, 0);
+  ConvertPlane16To8(src.data(), kStride, dest.data(), 64, kSamples, kRows, 2);
+  for (size_t row = 0; row < kRows; row++) {
+    for (size_t i = 0; i < 64; i++) {
+      EXPECT_EQ(i < kSamples ? (row + i) & 0xff : 0u, dest[row * 64 + i])
+          << "row=" << row << ", i=" << i;
+    }
+  }
+}
+
+TEST(PixelConversionTest, ConvertsHighBits) {
+  // P010 stores 10 bits in the high bits.
+  constexpr const size_t kSamples = 70;
+  constexpr const size_t kRows = 2;
+  constexpr const size_t kStride = 160;
+  const std::vector<uint8_t> src = MakePlane16(kSamples, kRows, kStride, 8);
+
+  std::vector<uint8_t> dest(kSamples * kRows, 0);
+  ConvertPlane16To8(src.data(), kStride, dest.data(), kSamples, kSamples,
+                    kRows, 8);
+  for (size_t row = 0; row < kRows; row++) {
+    for (size_t i = 0; i < kSamples; i++)
+      EXPECT_EQ((row + i) & 0xff, dest[row * kSamples + i]);
+  }
+}
+
+TEST(PixelConversionTest, ClampsOutOfRangeValues) {
+  // Values past 10 bits aren't valid, but shouldn't wrap around.
+  const std::vector<uint8_t> src(64, 0xff);
+  std::vector<uint8_t> dest(32, 0);
+  ConvertPlane16To8(src.data(), 64, dest.data(), 32, 32, 1, 2);
+  for (uint8_t value : dest)
+    EXPECT_EQ(255u, value);
+}
+
+TEST(PixelConversionTest, ShiftsToHighBits) {
+  // Converts the YUV420P10 Y plane to the P010 Y plane.
+  constexpr const size_t kSamples = 21;
+  constexpr const size_t kRows = 3;
+  const std::vector<uint8_t> src = MakePlane16(kSamples, kRows, 48, 2);
+  const std::vector<uint8_t> expected = MakePlane16(kSamples, kRows, 64, 8);
+
+  std::vector<uint8_t> dest(64 * kRows, 0xff);
+  ShiftPlane16(src.data(), 48, dest.data(), 64, kSamples, kRows, 6);
+  EXPECT_EQ(expected, dest);
+}
+
+TEST(PixelConversionTest, InterleavesPlanes) {
+  // Converts the YUV420P10 U and V planes to the P010 U/V plane.
+  constexpr const size_t kSamples = 5;
+  constexpr const size_t kRows = 2;
+  const std::vector<uint8_t> u = MakePlane16(kSamples, kRows, 16, 0);
+  std::vector<uint8_t> v = MakePlane16(kSamples, kRows, 12, 0);
+  for (size_t i = 0; i < v.size(); i += 2)
+    v[i + 1] = 0x3;
+
+  std::vector<uint8_t> dest(24 * kRows, 0);
+  InterleavePlanes16(u.data(), 16, v.data(), 12, dest.data(), 24, kSamples,
+                     kRows, 6);
+  for (size_t row = 0; row < kRows; row++) {
+    for (size_t i = 0; i < kSamples; i++) {
+      const uint8_t* pair = dest.data() + row * 24 + i * 4;
+      const uint8_t value = static_cast<uint8_t>(row + i);
+      EXPECT_EQ((value << 6) & 0xff, pair[0]);
+      EXPECT_EQ(value >> 2, pair[1]);
+      EXPECT_EQ((value << 6) & 0xff, pair[2]);
+      EXPECT_EQ((value >> 2) | (0x3 << 6), pair[3]);
+    }
+  }
+}
+
+// This is a micro-benchmark of the plane conversions used to draw frames.
+// This is disabled by default; run with --gtest_also_run_disabled_tests to see
+// the results.
+TEST(PixelConversionTest, ConvertYuv420ToRgba_Colors) {
+  struct Color {
+    uint8_t y, u, v;
+    uint8_t r, g, b;
+  };
+  // BT.709 video-range values.
+  const Color kColors[] = {
+      {16, 128, 128, 0, 0, 0},        // Black
+      {235, 128, 128, 255, 255, 255},  // White
+      {63, 102, 240, 255, 0, 0},      // Red
+      {173, 42, 26, 0, 255, 0},       // Green
+      {32, 240, 118, 0, 0, 255},      // Blue
+  };
+  const YuvToRgbMatrix matrix = GetYuvToRgbMatrix(1, /* full_range= */ false);
+
+  for (const Color& color : kColors) {
+    // Use enough pixels to use the SIMD code plus some left over.
+    constexpr const size_t kWidth = 19;
+    std::vector<uint8_t> y(kWidth * 2, color.y);
+    std::vector<uint8_t> u(kWidth, color.u);
+    std::vector<uint8_t> v(kWidth, color.v);
+    std::vector<uint8_t> dest(kWidth * 4 * 2);
+    ConvertYuv420ToRgba(y.data(), kWidth, u.data(), v.data(), kWidth / 2 + 1,
+                        false, matrix, dest.data(), kWidth * 4, kWidth, 2);
+    for (size_t i = 0; i < kWidth * 2; i++) {
+      EXPECT_NEAR(color.r, dest[i * 4], 2) << "i=" << i;
+      EXPECT_NEAR(color.g, dest[i * 4 + 1], 2) << "i=" << i;
+      EXPECT_NEAR(color.b, dest[i * 4 + 2], 2) << "i=" << i;
+      EXPECT_EQ(255, dest[i * 4 + 3]) << "i=" << i;
+    }
+  }
+}
+
+TEST(PixelConversionTest, ConvertYuv420ToRgba_MatchesScalar) {
+  constexpr const size_t kWidth = 37;
+  constexpr const size_t kRows = 6;
+  constexpr const size_t kUvWidth = (kWidth + 1) / 2;
+  std::vector<uint8_t> y(kWidth * kRows);
+  std::vector<uint8_t> u(kUvWidth * kRows / 2);
+  std::vector<uint8_t> v(kUvWidth * kRows / 2);
+  std::vector<uint8_t> uv(kUvWidth * 2 * kRows / 2);
+  for (size_t i = 0; i < y.size(); i++)
+    y[i] = static_cast<uint8_t>(i * 7);
+  for (size_t i = 0; i < u.size(); i++) {
+    u[i] = uv[i * 2] = static_cast<uint8_t>(i * 13);
+    v[i] = uv[i * 2 + 1] = static_cast<uint8_t>(255 - i * 11);
+  }
+
+  for (bool full_range : {false, true}) {
+    const YuvToRgbMatrix matrix = GetYuvToRgbMatrix(6, full_range);
+    std::vector<uint8_t> planar(kWidth * 4 * kRows);
+    std::vector<uint8_t> interleaved(kWidth * 4 * kRows);
+    ConvertYuv420ToRgba(y.data(), kWidth, u.data(), v.data(), kUvWidth, false,
+                        matrix, planar.data(), kWidth * 4, kWidth, kRows);
+    ConvertYuv420ToRgba(y.data(), kWidth, uv.data(), uv.data() + 1,
+                        kUvWidth * 2, true, matrix, interleaved.data(),
+                        kWidth * 4, kWidth, kRows);
+    EXPECT_EQ(planar, interleaved);
+
+    // Converting one pixel at a time only uses the scalar code.
+    for (size_t row = 0; row < kRows; row++) {
+      for (size_t i = 0; i < kWidth; i++) {
+        uint8_t pixel[4];
+        const size_t uv_offset = (row / 2) * kUvWidth + i / 2;
+        ConvertYuv420ToRgba(&y[row * kWidth + i], kWidth, &u[uv_offset],
+                            &v[uv_offset], kUvWidth, false, matrix, pixel, 4,
+                            1, 1);
+        for (size_t j = 0; j < 4; j++) {
+          EXPECT_EQ(pixel[j], planar[(row * kWidth + i) * 4 + j])
+              << "full_range=" << full_range << ", row=" << row
+              << ", i=" << i;
+        }
+      }
+    }
+  }
+}
+
+TEST(PixelConversionTest, DownscalesPlanes) {
+  // Use odd sizes so there are partial blocks and leftovers from the SIMD
+  // code.
+  constexpr const size_t kWidth = 75;
+  constexpr const size_t kRows = 7;
+  constexpr const size_t kStride = 80;
+  std::vector<uint8_t> src(kStride * kRows);
+  for (size_t i = 0; i < src.size(); i++)
+    src[i] = static_cast<uint8_t>((i * 37) ^ (i >> 3));
+
+  for (size_t components : {1, 2}) {
+    const size_t width = kWidth / components;
+    for (unsigned int shift : {1, 2, 3}) {
+      const size_t block = 1u << shift;
+      const size_t dest_width = (width + block - 1) / block;
+      const size_t dest_rows = (kRows + block - 1) / block;
+      const size_t dest_stride = dest_width * components + 3;
+      std::vector<uint8_t> dest(dest_stride * dest_rows, 0);
+      DownscalePlane(src.data(), kStride, width, kRows, components, shift,
+                     dest.data(), dest_stride);
+
+      for (size_t row = 0; row < dest_rows; row++) {
+        for (size_t i = 0; i < dest_width; i++) {
+          for (size_t c = 0; c < components; c++) {
+            double sum = 0;
+            size_t count = 0;
+            for (size_t y = row * block; y < std::min(kRows, (row + 1) * block);
+                 y++) {
+              for (size_t x = i * block;
+                   x < std::min(width, (i + 1) * block); x++) {
+                sum += src[y * kStride + x * components + c];
+                count++;
+              }
+            }
+            // The SIMD code rounds in steps, so it can be off by one.
+            EXPECT_NEAR(sum / count,
+                        dest[row * dest_stride + i * components + c], 1)
+                << "components=" << components << ", shift=" << shift
+                << ", row=" << row << ", i=" << i;
+          }
+        }
+      }
+    }
+  }
+}
+
+TEST(PixelConversionTest, DISABLED_Benchmark) {
+  using std::chrono::duration_cast;
+  using std::chrono::microseconds;
+  using std::chrono::steady_clock;
+  constexpr const int kIterations = 50;
+
+  struct Resolution {
+    const char* name;
+    size_t width;
+    size_t height;
+  };
+  const Resolution kResolutions[] = {
+      {"720p", 1280, 720},
+      {"1080p", 1920, 1080},
+      {"4k", 3840, 2160},
+  };
+
+  for (const Resolution& res : kResolutions) {
+    // Add padding to the rows like FFmpeg does.
+    const size_t stride8 = res.width + 64;
+    const size_t stride16 = res.width * 2 + 64;
+    const size_t rows = res.height * 3 / 2;  // Luma and both chroma planes.
+    std::vector<uint8_t> src16(stride16 * rows, 0x12);
+    std::vector<uint8_t> src8(stride8 * rows, 0x12);
+    std::vector<uint8_t> dest(res.width * rows);
+
+    auto start = steady_clock::now();
+    for (int i = 0; i < kIterations; i++) {
+      CopyPlane(src8.data(), stride8, dest.data(), res.width, res.width,
+                rows);
+    }
+    auto us = duration_cast<microseconds>(steady_clock::now() - start);
+    LOG(INFO) << "8-bit copy at " << res.name << ": "
+              << (us.count() / kIterations) << " us per frame";
+
+    // YUV420P10 and P010 only differ in the shift amount.
+    start = steady_clock::now();
+    for (int i = 0; i < kIterations; i++) {
+      ConvertPlane16To8(src16.data(), stride16, dest.data(), res.width,
+                        res.width, rows, 2);
+    }
+    us = duration_cast<microseconds>(steady_clock::now() - start);
+    LOG(INFO) << "10-bit conversion at " << res.name << ": "
+              << (us.count() / kIterations) << " us per frame";
+  }
+}
+
+}  // namespace media
+}  // namespace shaka
@@ -0,0 +1,255 @@
+// Copyright 2020 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     https://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "shaka/media/proxy_media_player.h"
+
+#include <gmock/gmock.h>
+#include <gtest/gtest.h>
+
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace shaka {
+namespace media {
+
+namespace {
+
+using testing::NiceMock;
+using testing::Return;
+using testing::StrictMock;
+
+class MockMediaPlayer : public MediaPlayer {
+ public:
+  MOCK_CONST_METHOD1(DecodingInfo,
+                     MediaCapabilitiesInfo(const MediaDecodingConfiguration&));
+  MOCK_CONST_METHOD0(VideoPlaybackQuality, struct VideoPlaybackQuality());
+  MOCK_CONST_METHOD1(AddClient, void(Client*));
+  MOCK_CONST_METHOD1(RemoveClient, void(Client*));
+  MOCK_CONST_METHOD0(GetBuffered, std::vector<BufferedRange>());
+  MOCK_CONST_METHOD0(GetBufferedVersion, uint64_t());
+  MOCK_CONST_METHOD0(ReadyState, VideoReadyState());
+  MOCK_CONST_METHOD0(PlaybackState, VideoPlaybackState());
+  MOCK_METHOD0(AudioTracks, std::vector<std::shared_ptr<MediaTrack>>());
+  MOCK_CONST_METHOD0(AudioTracks,
+                     std::vector<std::shared_ptr<const MediaTrack>>());
+  MOCK_METHOD0(VideoTracks, std::vector<std::shared_ptr<MediaTrack>>());
+  MOCK_CONST_METHOD0(VideoTracks,
+                     std::vector<std::shared_ptr<const MediaTrack>>());
+  MOCK_METHOD0(TextTracks, std::vector<std::shared_ptr<TextTrack>>());
+  MOCK_CONST_METHOD0(TextTracks,
+                     std::vector<std::shared_ptr<const TextTrack>>());
+  MOCK_METHOD3(AddTextTrack,
+               std::shared_ptr<TextTrack>(TextTrackKind, const std::string&,
+                                          const std::string&));
+  MOCK_METHOD1(SetVideoFillMode, bool(VideoFillMode));
+  MOCK_CONST_METHOD0(Width, uint32_t());
+  MOCK_CONST_METHOD0(Height, uint32_t());
+  MOCK_CONST_METHOD0(Volume, double());
+  MOCK_METHOD1(SetVolume, void(double));
+  MOCK_CONST_METHOD0(Muted, bool());
+  MOCK_METHOD1(SetMuted, void(bool));
+  MOCK_METHOD0(Play, void());
+  MOCK_METHOD0(Pause, void());
+  MOCK_CONST_METHOD0(CurrentTime, double());
+  MOCK_METHOD1(SetCurrentTime, void(double));
+  MOCK_CONST_METHOD0(Duration, double());
+  MOCK_METHOD1(SetDuration, void(double));
+  MOCK_CONST_METHOD0(PlaybackRate, double());
+  MOCK_METHOD1(SetPlaybackRate, void(double));
+  MOCK_METHOD1(AttachSource, bool(const std::string&));
+  MOCK_METHOD0(AttachMse, bool());
+  MOCK_METHOD3(AddMseBuffer,
+               bool(const std::string&, bool, const ElementaryStream*));
+  MOCK_METHOD1(LoadedMetaData, void(double));
+  MOCK_METHOD0(MseEndOfStream, void());
+  MOCK_METHOD2(SetEmeImplementation,
+               bool(const std::string&, eme::Implementation*));
+  MOCK_METHOD0(Detach, void());
+};
+
+class MockClient : public MediaPlayer::Client {
+ public:
+  MOCK_METHOD2(OnReadyStateChanged, void(VideoReadyState, VideoReadyState));
+  MOCK_METHOD2(OnPlaybackStateChanged,
+               void(VideoPlaybackState, VideoPlaybackState));
+  MOCK_METHOD0(OnPlay, void());
+  MOCK_METHOD0(OnDetach, void());
+};
+
+class TestProxyMediaPlayer : public ProxyMediaPlayer {
+ public:
+  using ProxyMediaPlayer::BackendClient;
+  using ProxyMediaPlayer::GetActivePlayer;
+
+  NiceMock<MockMediaPlayer> mse;
+  NiceMock<MockMediaPlayer> src;
+
+  MediaCapabilitiesInfo DecodingInfo(
+      const MediaDecodingConfiguration& config) const override {
+    return MediaCapabilitiesInfo();
+  }
+  std::vector<std::shared_ptr<MediaTrack>> AudioTracks() override {
+    return {};
+  }
+  std::vector<std::shared_ptr<const MediaTrack>> AudioTracks() const override {
+    return {};
+  }
+  std::vector<std::shared_ptr<MediaTrack>> VideoTracks() override {
+    return {};
+  }
+  std::vector<std::shared_ptr<const MediaTrack>> VideoTracks() const override {
+    return {};
+  }
+  std::vector<std::shared_ptr<TextTrack>> TextTracks() override {
+    return {};
+  }
+  std::vector<std::shared_ptr<const TextTrack>> TextTracks() const override {
+    return {};
+  }
+  std::shared_ptr<TextTrack> AddTextTrack(
+      TextTrackKind kind, const std::string& label,
+      const std::string& language) override {
+    return nullptr;
+  }
+
+ private:
+  MediaPlayer* CreateMse() override {
+    return &mse;
+  }
+  MediaPlayer* CreateSource(const std::string& src_url) override {
+    return &src;
+  }
+};
+
+}  // namespace
+
+TEST(ProxyMediaPlayerTest, HandsOffToPreparedPlayer) {
+  TestProxyMediaPlayer proxy;
+  ASSERT_TRUE(proxy.AttachMse());
+  proxy.Play();
+  EXPECT_EQ(&proxy.mse, proxy.GetActivePlayer());
+
+  // The prepared player is loaded paused and muted at the handoff time.
+  EXPECT_CALL(proxy.src, Pause());
+  EXPECT_CALL(proxy.src, SetMuted(true));
+  EXPECT_CALL(proxy.src, SetCurrentTime(10));
+  ASSERT_TRUE(proxy.PrepareSourceHandoff("foo.m3u8", 10));
+  EXPECT_EQ(&proxy.mse, proxy.GetActivePlayer());
+  testing::Mock::VerifyAndClearExpectations(&proxy.src);
+
+  // The prepared player is already close to the current time, so it doesn't
+  // seek; it takes the state of the old player.
+  ON_CALL(proxy.mse, CurrentTime()).WillByDefault(Return(10.05));
+  ON_CALL(proxy.mse, PlaybackRate()).WillByDefault(Return(2));
+  ON_CALL(proxy.mse, Volume()).WillByDefault(Return(0.5));
+  ON_CALL(proxy.mse, Muted()).WillByDefault(Return(false));
+  ON_CALL(proxy.src, CurrentTime()).WillByDefault(Return(10));
+  EXPECT_CALL(proxy.src, SetCurrentTime(testing::_)).Times(0);
+  EXPECT_CALL(proxy.src, SetPlaybackRate(2));
+  EXPECT_CALL(proxy.src, SetVolume(0.5));
+  EXPECT_CALL(proxy.src, SetMuted(false));
+  EXPECT_CALL(proxy.src, Play());
+  EXPECT_CALL(proxy.mse, Detach());
+  ASSERT_TRUE(proxy.CompleteHandoff());
+
+  EXPECT_EQ(&proxy.src, proxy.GetActivePlayer());
+  EXPECT_EQ(10, proxy.CurrentTime());
+  // There is nothing left to hand off to.
+  EXPECT_FALSE(proxy.CompleteHandoff());
+}
+
+TEST(ProxyMediaPlayerTest, FiresStateChangesOnHandoff) {
+  TestProxyMediaPlayer proxy;
+  StrictMock<MockClient> client;
+  proxy.AddClient(&client);
+  ASSERT_TRUE(proxy.AttachMse());
+  ASSERT_TRUE(proxy.PrepareSourceHandoff("foo.m3u8", 0));
+
+  ON_CALL(proxy.mse, ReadyState())
+      .WillByDefault(Return(VideoReadyState::HaveEnoughData));
+  ON_CALL(proxy.mse, PlaybackState())
+      .WillByDefault(Return(VideoPlaybackState::Paused));
+  ON_CALL(proxy.src, ReadyState())
+      .WillByDefault(Return(VideoReadyState::HaveMetadata));
+  ON_CALL(proxy.src, PlaybackState())
+      .WillByDefault(Return(VideoPlaybackState::Paused));
+  EXPECT_CALL(client, OnReadyStateChanged(VideoReadyState::HaveEnoughData,
+                                          VideoReadyState::HaveMetadata));
+  EXPECT_CALL(proxy.src, Play()).Times(0);
+  ASSERT_TRUE(proxy.CompleteHandoff());
+}
+
+TEST(ProxyMediaPlayerTest, CancelsHandoff) {
+  TestProxyMediaPlayer proxy;
+  // There is nothing to hand off from.
+  EXPECT_FALSE(proxy.PrepareSourceHandoff("foo.m3u8", 0));
+
+  ASSERT_TRUE(proxy.AttachMse());
+  ASSERT_TRUE(proxy.PrepareSourceHandoff("foo.m3u8", 0));
+  EXPECT_CALL(proxy.src, Detach());
+  EXPECT_CALL(proxy.mse, Detach()).Times(0);
+  proxy.CancelHandoff();
+  EXPECT_FALSE(proxy.CompleteHandoff());
+  EXPECT_EQ(&proxy.mse, proxy.GetActivePlayer());
+}
+
+TEST(ProxyMediaPlayerTest, SendsMseCallsToMsePlayer) {
+  TestProxyMediaPlayer proxy;
+  ASSERT_TRUE(proxy.AttachSource("foo.m3u8"));
+  ASSERT_TRUE(proxy.PrepareMseHandoff(0));
+
+  EXPECT_CALL(proxy.mse, LoadedMetaData(20));
+  EXPECT_CALL(proxy.src, LoadedMetaData(testing::_)).Times(0);
+  proxy.LoadedMetaData(20);
+}
+
+TEST(ProxyMediaPlayerTest, ForwardsBufferedVersion) {
+  TestProxyMediaPlayer proxy;
+  // Without a player, the changes aren't tracked.
+  EXPECT_EQ(0u, proxy.GetBufferedVersion());
+
+  ASSERT_TRUE(proxy.AttachMse());
+  EXPECT_CALL(proxy.mse, GetBufferedVersion()).WillOnce(Return(12));
+  EXPECT_EQ(12u, proxy.GetBufferedVersion());
+}
+
+TEST(ProxyMediaPlayerTest, DropsEventsFromInactivePlayer) {
+  TestProxyMediaPlayer proxy;
+  TestProxyMediaPlayer::BackendClient mse_client(&proxy, &proxy.mse);
+  TestProxyMediaPlayer::BackendClient src_client(&proxy, &proxy.src);
+  StrictMock<MockClient> client;
+  proxy.AddClient(&client);
+
+  // While nothing is active, events from either player are fired.
+  EXPECT_CALL(client, OnPlay()).Times(2);
+  mse_client.OnPlay();
+  src_client.OnPlay();
+  testing::Mock::VerifyAndClearExpectations(&client);
+
+  ASSERT_TRUE(proxy.AttachMse());
+  ASSERT_TRUE(proxy.PrepareSourceHandoff("foo.m3u8", 0));
+  EXPECT_CALL(client, OnPlay());
+  mse_client.OnPlay();
+  src_client.OnPlay();
+  testing::Mock::VerifyAndClearExpectations(&client);
+
+  ASSERT_TRUE(proxy.CompleteHandoff());
+  EXPECT_CALL(client, OnDetach());
+  mse_client.OnDetach();
+  src_client.OnDetach();
+}
+
+}  // namespace media
+}  // namespace shaka
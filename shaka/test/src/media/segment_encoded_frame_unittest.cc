@@ -0,0 +1,355 @@
+// Copyright 2020 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     https://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "src/media/segment_encoded_frame.h"
+
+#include <gmock/gmock.h>
+#include <gtest/gtest.h>
+
+#include <functional>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "shaka/eme/implementation.h"
+#include "src/eme/implementation_extensions.h"
+
+namespace shaka {
+namespace media {
+
+namespace {
+
+using ::testing::_;
+using ::testing::Invoke;
+using ::testing::Return;
+using ::testing::StrictMock;
+
+class MockImplementation : public eme::Implementation {
+ public:
+  MOCK_CONST_METHOD2(GetExpiration, bool(const std::string&, int64_t*));
+  MOCK_CONST_METHOD2(GetKeyStatuses,
+                     bool(const std::string&,
+                          std::vector<eme::KeyStatusInfo>*));
+  MOCK_METHOD2(SetServerCertificate, void(eme::EmePromise, eme::Data));
+  MOCK_METHOD5(CreateSessionAndGenerateRequest,
+               void(eme::EmePromise, std::function<void(const std::string&)>,
+                    eme::MediaKeySessionType, eme::MediaKeyInitDataType,
+                    eme::Data));
+  MOCK_METHOD2(Load, void(const std::string&, eme::EmePromise));
+  MOCK_METHOD3(Update, void(const std::string&, eme::EmePromise, eme::Data));
+  MOCK_METHOD2(Close, void(const std::string&, eme::EmePromise));
+  MOCK_METHOD2(Remove, void(const std::string&, eme::EmePromise));
+  MOCK_CONST_METHOD4(Decrypt,
+                     eme::DecryptStatus(const eme::FrameEncryptionInfo*,
+                                        const uint8_t*, size_t, uint8_t*));
+};
+
+/** A mock of a built-in EME implementation, which has the extensions. */
+class MockBuiltInImplementation : public MockImplementation,
+                                  public eme::ImplementationExtensions {
+ public:
+  MockBuiltInImplementation() : ImplementationExtensions(this) {}
+
+  MOCK_CONST_METHOD2(DecryptSamples, void(eme::DecryptSample*, size_t));
+  MOCK_CONST_METHOD4(DecryptToSecureBuffer,
+                     eme::DecryptStatus(const eme::FrameEncryptionInfo*,
+                                        const uint8_t*, size_t,
+                                        const eme::SecureBuffer&));
+};
+
+/** A fake decryption that just inverts the bits. */
+eme::DecryptStatus FakeDecrypt(const eme::FrameEncryptionInfo*,
+                               const uint8_t* data, size_t size,
+                               uint8_t* dest) {
+  for (size_t i = 0; i < size; i++)
+    dest[i] = ~data[i];
+  return eme::DecryptStatus::Success;
+}
+
+std::shared_ptr<eme::FrameEncryptionInfo> MakeInfo(
+    eme::EncryptionScheme scheme, uint32_t protected_bytes) {
+  return std::make_shared<eme::FrameEncryptionInfo>(
+      scheme, eme::EncryptionPattern(0, 0), std::vector<uint8_t>(16, 1),
+      std::vector<uint8_t>(16, 2),
+      std::vector<eme::SubsampleInfo>{{4, protected_bytes}});
+}
+
+std::shared_ptr<SegmentEncodedFrame> MakeFrame(
+    std::shared_ptr<EncodedFrameBuffer> buffer, size_t offset, size_t size,
+    std::shared_ptr<eme::FrameEncryptionInfo> info) {
+  return std::make_shared<SegmentEncodedFrame>(nullptr, 0, 0, 1, true, buffer,
+                                               offset, size, 0, info);
+}
+
+bool DecryptInPlace(std::shared_ptr<SegmentEncodedFrame> frame,
+                    const eme::Implementation* cdm, MediaStatus* status) {
+  return SegmentEncodedFrame::DecryptInPlace(frame.get(), cdm, status);
+}
+
+bool DecryptToSecureBuffer(std::shared_ptr<EncodedFrame> frame,
+                           const eme::Implementation* cdm,
+                           const eme::SecureBuffer& dest,
+                           MediaStatus* status) {
+  return SegmentEncodedFrame::DecryptToSecureBuffer(frame.get(), cdm, dest,
+                                                    status);
+}
+
+}  // namespace
+
+TEST(SegmentEncodedFrameTest, SharesBuffer) {
+  auto buffer = std::make_shared<EncodedFrameBuffer>(100, 7);
+  auto first = MakeFrame(buffer, 0, 40, nullptr);
+  auto second = MakeFrame(buffer, 40, 60, nullptr);
+
+  EXPECT_EQ(buffer->data(), first->data);
+  EXPECT_EQ(buffer->data() + 40, second->data);
+  EXPECT_EQ(60u, second->data_size);
+  // Each frame counts its own part of the buffer.
+  EXPECT_LT(first->EstimateSize(), second->EstimateSize());
+}
+
+TEST(SegmentEncodedFrameTest, FindsSegmentFrames) {
+  auto buffer = std::make_shared<EncodedFrameBuffer>(20, 0x0f);
+  auto segment_frame = MakeFrame(buffer, 0, 20, nullptr);
+  EncodedFrame other_frame(nullptr, 0, 0, 1, true, buffer->data(), 20, 0,
+                           nullptr);
+
+  EXPECT_EQ(segment_frame.get(),
+            SegmentEncodedFrame::FromFrame(segment_frame.get()));
+  EXPECT_EQ(nullptr, SegmentEncodedFrame::FromFrame(&other_frame));
+  EXPECT_EQ(nullptr, SegmentEncodedFrame::FromFrame(nullptr));
+}
+
+TEST(SegmentEncodedFrameTest, DecryptsInPlace) {
+  auto buffer = std::make_shared<EncodedFrameBuffer>(40, 0x0f);
+  auto first = MakeFrame(buffer, 0, 20,
+                         MakeInfo(eme::EncryptionScheme::AesCtr, 16));
+  auto second = MakeFrame(buffer, 20, 20,
+                          MakeInfo(eme::EncryptionScheme::AesCtr, 16));
+
+  StrictMock<MockBuiltInImplementation> cdm;
+  EXPECT_CALL(cdm, Decrypt(first->encryption_info.get(), first->data, 20,
+                           const_cast<uint8_t*>(first->data)))
+      .WillOnce(Invoke(&FakeDecrypt));
+
+  MediaStatus status = MediaStatus::FatalError;
+  ASSERT_TRUE(DecryptInPlace(first, &cdm, &status));
+  EXPECT_EQ(MediaStatus::Success, status);
+  EXPECT_EQ(std::vector<uint8_t>(20, 0xf0),
+            std::vector<uint8_t>(buffer->begin(), buffer->begin() + 20));
+  EXPECT_EQ(std::vector<uint8_t>(20, 0x0f),
+            std::vector<uint8_t>(buffer->begin() + 20, buffer->end()));
+
+  // Once decrypted, the frame isn't decrypted again.
+  status = MediaStatus::FatalError;
+  ASSERT_TRUE(DecryptInPlace(first, &cdm, &status));
+  EXPECT_EQ(MediaStatus::Success, status);
+
+  std::vector<uint8_t> dest(20);
+  EXPECT_EQ(MediaStatus::Success, first->Decrypt(&cdm, dest.data()));
+  EXPECT_EQ(std::vector<uint8_t>(20, 0xf0), dest);
+}
+
+TEST(SegmentEncodedFrameTest, DoesntDecryptInPlaceWithoutExtensions) {
+  auto buffer = std::make_shared<EncodedFrameBuffer>(20, 0x0f);
+  auto frame = MakeFrame(buffer, 0, 20,
+                         MakeInfo(eme::EncryptionScheme::AesCtr, 16));
+
+  // CDMs from the app may not support decrypting in place, so they always get
+  // a separate buffer.
+  StrictMock<MockImplementation> cdm;
+  MediaStatus status;
+  EXPECT_FALSE(DecryptInPlace(frame, &cdm, &status));
+
+  std::vector<uint8_t> dest(20);
+  EXPECT_CALL(cdm, Decrypt(frame->encryption_info.get(), frame->data, 20,
+                           dest.data()))
+      .WillOnce(Invoke(&FakeDecrypt));
+  EXPECT_EQ(MediaStatus::Success, frame->Decrypt(&cdm, dest.data()));
+  EXPECT_EQ(std::vector<uint8_t>(20, 0xf0), dest);
+  EXPECT_EQ(EncodedFrameBuffer(20, 0x0f), *buffer);
+}
+
+TEST(SegmentEncodedFrameTest, RetriesAfterKeyNotFound) {
+  auto buffer = std::make_shared<EncodedFrameBuffer>(20, 0x0f);
+  auto frame = MakeFrame(buffer, 0, 20,
+                         MakeInfo(eme::EncryptionScheme::AesCtr, 16));
+
+  StrictMock<MockBuiltInImplementation> cdm;
+  EXPECT_CALL(cdm, Decrypt(_, _, _, _))
+      .WillOnce(Return(eme::DecryptStatus::KeyNotFound))
+      .WillOnce(Invoke(&FakeDecrypt));
+
+  MediaStatus status;
+  ASSERT_TRUE(DecryptInPlace(frame, &cdm, &status));
+  EXPECT_EQ(MediaStatus::KeyNotFound, status);
+  EXPECT_EQ(EncodedFrameBuffer(20, 0x0f), *buffer);
+
+  ASSERT_TRUE(DecryptInPlace(frame, &cdm, &status));
+  EXPECT_EQ(MediaStatus::Success, status);
+  EXPECT_EQ(EncodedFrameBuffer(20, 0xf0), *buffer);
+}
+
+TEST(SegmentEncodedFrameTest, DecryptsBatchInPlace) {
+  auto buffer = std::make_shared<EncodedFrameBuffer>(60, 0x0f);
+  auto first = MakeFrame(buffer, 0, 20,
+                         MakeInfo(eme::EncryptionScheme::AesCtr, 16));
+  auto cbcs = MakeFrame(buffer, 20, 20,
+                        MakeInfo(eme::EncryptionScheme::AesCbc, 16));
+  auto third = MakeFrame(buffer, 40, 20,
+                         MakeInfo(eme::EncryptionScheme::AesCtr, 16));
+
+  // The CBC frame can't be decrypted in place, so it is skipped; the others
+  // are decrypted in a single call.
+  StrictMock<MockBuiltInImplementation> cdm;
+  EXPECT_CALL(cdm, DecryptSamples(_, 2))
+      .WillOnce(Invoke([&](eme::DecryptSample* samples, size_t count) {
+        EXPECT_EQ(first->data, samples[0].data);
+        EXPECT_EQ(third->data, samples[1].data);
+        FakeDecrypt(samples[0].info, samples[0].data, samples[0].data_size,
+                    samples[0].dest);
+        samples[0].status = eme::DecryptStatus::Success;
+        samples[1].status = eme::DecryptStatus::KeyNotFound;
+      }));
+  // Only the frames before the missing key are done.
+  EXPECT_EQ(2u, SegmentEncodedFrame::DecryptBatchInPlace(
+                    &cdm, {first, cbcs, third}));
+  EXPECT_EQ(std::vector<uint8_t>(20, 0xf0),
+            std::vector<uint8_t>(buffer->begin(), buffer->begin() + 20));
+  EXPECT_EQ(std::vector<uint8_t>(40, 0x0f),
+            std::vector<uint8_t>(buffer->begin() + 20, buffer->end()));
+
+  // The decrypted frame isn't decrypted again, but the failed one is retried.
+  EXPECT_CALL(cdm, Decrypt(third->encryption_info.get(), third->data, 20,
+                           const_cast<uint8_t*>(third->data)))
+      .WillOnce(Invoke(&FakeDecrypt));
+  MediaStatus status;
+  ASSERT_TRUE(DecryptInPlace(first, &cdm, &status));
+  EXPECT_EQ(MediaStatus::Success, status);
+  ASSERT_TRUE(DecryptInPlace(third, &cdm, &status));
+  EXPECT_EQ(MediaStatus::Success, status);
+  EXPECT_EQ(std::vector<uint8_t>(20, 0xf0),
+            std::vector<uint8_t>(buffer->begin() + 40, buffer->end()));
+}
+
+TEST(SegmentEncodedFrameTest, DoesntDecryptBatchWithoutExtensions) {
+  auto buffer = std::make_shared<EncodedFrameBuffer>(40, 0x0f);
+  auto first = MakeFrame(buffer, 0, 20,
+                         MakeInfo(eme::EncryptionScheme::AesCtr, 16));
+  auto second = MakeFrame(buffer, 20, 20,
+                          MakeInfo(eme::EncryptionScheme::AesCtr, 16));
+
+  // CDMs from the app don't support batches, so the frames are left for the
+  // decoder to decrypt.
+  StrictMock<MockImplementation> cdm;
+  EXPECT_EQ(2u,
+            SegmentEncodedFrame::DecryptBatchInPlace(&cdm, {first, second}));
+  EXPECT_EQ(EncodedFrameBuffer(40, 0x0f), *buffer);
+}
+
+TEST(SegmentEncodedFrameTest, DoesntDecryptPartialBlocksInPlace) {
+  auto buffer = std::make_shared<EncodedFrameBuffer>(40, 0x0f);
+  auto partial = MakeFrame(buffer, 0, 20,
+                           MakeInfo(eme::EncryptionScheme::AesCtr, 10));
+  auto cbcs = MakeFrame(buffer, 20, 20,
+                        MakeInfo(eme::EncryptionScheme::AesCbc, 16));
+
+  StrictMock<MockBuiltInImplementation> cdm;
+  MediaStatus status;
+  EXPECT_FALSE(DecryptInPlace(partial, &cdm, &status));
+  EXPECT_FALSE(DecryptInPlace(cbcs, &cdm, &status));
+
+  // They can still be decrypted into another buffer.
+  std::vector<uint8_t> dest(20);
+  EXPECT_CALL(cdm, Decrypt(cbcs->encryption_info.get(), cbcs->data, 20,
+                           dest.data()))
+      .WillOnce(Invoke(&FakeDecrypt));
+  EXPECT_EQ(MediaStatus::Success, cbcs->Decrypt(&cdm, dest.data()));
+  EXPECT_EQ(std::vector<uint8_t>(20, 0xf0), dest);
+  EXPECT_EQ(EncodedFrameBuffer(40, 0x0f), *buffer);
+}
+
+TEST(SegmentEncodedFrameTest, DecryptsToSecureBuffer) {
+  auto buffer = std::make_shared<EncodedFrameBuffer>(40, 0x0f);
+  auto first = MakeFrame(buffer, 0, 20,
+                         MakeInfo(eme::EncryptionScheme::AesCtr, 16));
+  auto second = MakeFrame(buffer, 20, 20,
+                          MakeInfo(eme::EncryptionScheme::AesCtr, 16));
+
+  StrictMock<MockBuiltInImplementation> cdm;
+  int handle;
+  const eme::SecureBuffer dest{&handle, 8, 32};
+  EXPECT_CALL(cdm, DecryptToSecureBuffer(first->encryption_info.get(),
+                                         first->data, 20, _))
+      .WillOnce(Invoke([&](const eme::FrameEncryptionInfo*, const uint8_t*,
+                           size_t, const eme::SecureBuffer& buffer) {
+        EXPECT_EQ(&handle, buffer.handle);
+        EXPECT_EQ(8u, buffer.offset);
+        return eme::DecryptStatus::Success;
+      }));
+  MediaStatus status = MediaStatus::FatalError;
+  ASSERT_TRUE(DecryptToSecureBuffer(first, &cdm, dest, &status));
+  EXPECT_EQ(MediaStatus::Success, status);
+
+  // A frame that was already decrypted in place is copied as a clear frame.
+  EXPECT_CALL(cdm, Decrypt(_, _, _, _)).WillOnce(Invoke(&FakeDecrypt));
+  EXPECT_CALL(cdm, DecryptToSecureBuffer(nullptr, second->data, 20, _))
+      .WillOnce(Return(eme::DecryptStatus::Success));
+  ASSERT_TRUE(DecryptInPlace(second, &cdm, &status));
+  ASSERT_TRUE(DecryptToSecureBuffer(second, &cdm, dest, &status));
+  EXPECT_EQ(MediaStatus::Success, status);
+  EXPECT_EQ(EncodedFrameBuffer(20, 0x0f),
+            EncodedFrameBuffer(buffer->begin(), buffer->begin() + 20));
+}
+
+TEST(SegmentEncodedFrameTest, DecryptsOtherFramesToSecureBuffer) {
+  std::vector<uint8_t> data(20, 0x0f);
+  auto frame = std::make_shared<EncodedFrame>(
+      nullptr, 0, 0, 1, true, data.data(), data.size(), 0,
+      MakeInfo(eme::EncryptionScheme::AesCbc, 16));
+
+  StrictMock<MockBuiltInImplementation> cdm;
+  int handle;
+  EXPECT_CALL(cdm, DecryptToSecureBuffer(frame->encryption_info.get(),
+                                         data.data(), 20, _))
+      .WillOnce(Return(eme::DecryptStatus::Success));
+  MediaStatus status = MediaStatus::FatalError;
+  ASSERT_TRUE(DecryptToSecureBuffer(frame, &cdm, {&handle, 0, 20}, &status));
+  EXPECT_EQ(MediaStatus::Success, status);
+}
+
+TEST(SegmentEncodedFrameTest, FallsBackWithoutSecureBuffers) {
+  auto buffer = std::make_shared<EncodedFrameBuffer>(20, 0x0f);
+  auto frame = MakeFrame(buffer, 0, 20,
+                         MakeInfo(eme::EncryptionScheme::AesCtr, 16));
+
+  // CDMs from the app can't use secure buffers.
+  int handle;
+  MediaStatus status = MediaStatus::Success;
+  StrictMock<MockImplementation> app_cdm;
+  EXPECT_FALSE(
+      DecryptToSecureBuffer(frame, &app_cdm, {&handle, 0, 20}, &status));
+
+  StrictMock<MockBuiltInImplementation> cdm;
+  EXPECT_CALL(cdm, DecryptToSecureBuffer(_, _, _, _))
+      .WillOnce(Return(eme::DecryptStatus::NotSupported))
+      .WillOnce(Return(eme::DecryptStatus::KeyNotFound));
+  EXPECT_FALSE(DecryptToSecureBuffer(frame, &cdm, {&handle, 0, 20}, &status));
+
+  ASSERT_TRUE(DecryptToSecureBuffer(frame, &cdm, {&handle, 0, 20}, &status));
+  EXPECT_EQ(MediaStatus::KeyNotFound, status);
+}
+
+}  // namespace media
+}  // namespace shaka
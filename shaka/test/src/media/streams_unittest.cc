@@ -14,9 +14,16 @@
 
 #include "shaka/media/streams.h"
 
+#include <glog/logging.h>
 #include <gtest/gtest.h>
 #include <math.h>
 
+#include <atomic>
+#include <chrono>
+#include <thread>
+#include <utility>
+#include <vector>
+
 namespace shaka {
 namespace media {
 
@@ -279,6 +286,91 @@ TEST(StreamBaseTest, GetFrame_KeyFrameBefore_WontReturnFutureFrames) {
   EXPECT_EQ(nullptr, frame);
 }
 
+TEST(StreamBaseTest, GetFrame_KeyFrameBefore_SkipsLongGop) {
+  StreamType buffer;
+  for (int i = 0; i < 100; i++)
+    buffer.AddFrame(MakeFrame(i, i + 1, i % 30 == 0));
+  ASSERT_EQ(1u, buffer.GetBufferedRanges().size());
+
+  const BaseFrame* frame =
+      buffer.GetFrame(59.5, FrameLocation::KeyFrameBefore).get();
+  ASSERT_NE(nullptr, frame);
+  EXPECT_EQ(30, frame->pts);
+
+  frame = buffer.GetFrame(200, FrameLocation::KeyFrameBefore).get();
+  ASSERT_NE(nullptr, frame);
+  EXPECT_EQ(90, frame->pts);
+}
+
+TEST(StreamBaseTest, GetFrame_KeyFrameBefore_TracksReplacedFrames) {
+  StreamType buffer;
+  buffer.AddFrame(MakeFrame(0, 10));
+  buffer.AddFrame(MakeFrame(10, 20, false));
+  buffer.AddFrame(MakeFrame(20, 30, false));
+
+  // Replacing a frame with a key frame adds it to the index.
+  buffer.AddFrame(MakeFrame(10, 20));
+  const BaseFrame* frame =
+      buffer.GetFrame(25, FrameLocation::KeyFrameBefore).get();
+  ASSERT_NE(nullptr, frame);
+  EXPECT_EQ(10, frame->pts);
+
+  // Replacing it with a non-key frame removes it again.
+  buffer.AddFrame(MakeFrame(10, 20, false));
+  frame = buffer.GetFrame(25, FrameLocation::KeyFrameBefore).get();
+  ASSERT_NE(nullptr, frame);
+  EXPECT_EQ(0, frame->pts);
+}
+
+TEST(StreamBaseTest, GetFrame_KeyFrameBefore_AfterMergeAndRemove) {
+  StreamType buffer;
+  buffer.AddFrame(MakeFrame(0, 10));
+  buffer.AddFrame(MakeFrame(10, 20, false));
+  buffer.AddFrame(MakeFrame(30, 40));
+  buffer.AddFrame(MakeFrame(40, 50, false));
+  ASSERT_EQ(2u, buffer.GetBufferedRanges().size());
+
+  // Closing the gap merges the ranges and their key frames.
+  buffer.AddFrame(MakeFrame(20, 30, false));
+  ASSERT_EQ(1u, buffer.GetBufferedRanges().size());
+  const BaseFrame* frame =
+      buffer.GetFrame(45, FrameLocation::KeyFrameBefore).get();
+  ASSERT_NE(nullptr, frame);
+  EXPECT_EQ(30, frame->pts);
+  frame = buffer.GetFrame(25, FrameLocation::KeyFrameBefore).get();
+  ASSERT_NE(nullptr, frame);
+  EXPECT_EQ(0, frame->pts);
+
+  // Removing the first GOP leaves the second key frame.
+  buffer.Remove(0, 10);
+  ASSERT_EQ(1u, buffer.GetBufferedRanges().size());
+  frame = buffer.GetFrame(45, FrameLocation::KeyFrameBefore).get();
+  ASSERT_NE(nullptr, frame);
+  EXPECT_EQ(30, frame->pts);
+  EXPECT_EQ(nullptr, buffer.GetFrame(25, FrameLocation::KeyFrameBefore).get());
+}
+
+TEST(StreamBaseTest, GetFrame_KeyFrameAfter_SkipsOtherFrames) {
+  StreamType buffer;
+  buffer.AddFrame(MakeFrame(0, 10));
+  buffer.AddFrame(MakeFrame(10, 20, false));
+  buffer.AddFrame(MakeFrame(20, 30));
+  buffer.AddFrame(MakeFrame(30, 40, false));
+  buffer.AddFrame(MakeFrame(50, 60));
+  ASSERT_EQ(2u, buffer.GetBufferedRanges().size());
+
+  const BaseFrame* frame =
+      buffer.GetFrame(0, FrameLocation::KeyFrameAfter).get();
+  ASSERT_NE(nullptr, frame);
+  EXPECT_EQ(20, frame->pts);
+
+  // Continues in the next range.
+  frame = buffer.GetFrame(20, FrameLocation::KeyFrameAfter).get();
+  ASSERT_NE(nullptr, frame);
+  EXPECT_EQ(50, frame->pts);
+
+  EXPECT_EQ(nullptr, buffer.GetFrame(50, FrameLocation::KeyFrameAfter).get());
+}
 
 TEST(StreamBaseTest, GetFrame_After_GetsNext) {
   StreamType buffer;
@@ -393,6 +485,72 @@ TEST(StreamBaseTest, GetFrame_Near_ReturnsNull) {
 }
 
 
+TEST(StreamBaseTest, CallsOnBufferedChanged) {
+  StreamType buffer;
+  int calls = 0;
+  buffer.SetOnBufferedChanged([&]() { calls++; });
+
+  buffer.AddFrame(MakeFrame(0, 10));
+  EXPECT_EQ(1, calls);
+  buffer.AddFrame(MakeFrame(10, 20));
+  EXPECT_EQ(2, calls);
+  // Replacing a frame doesn't change the ranges.
+  buffer.AddFrame(MakeFrame(10, 20));
+  EXPECT_EQ(2, calls);
+  // Removing nothing doesn't change the ranges.
+  buffer.Remove(30, 40);
+  EXPECT_EQ(2, calls);
+  buffer.Remove(0, 10);
+  EXPECT_EQ(3, calls);
+
+  buffer.SetOnBufferedChanged(nullptr);
+  buffer.Clear();
+  EXPECT_EQ(3, calls);
+}
+
+TEST(StreamBaseTest, CallsOnRemoved) {
+  StreamType buffer;
+  std::vector<std::pair<double, double>> calls;
+  buffer.SetOnRemoved(
+      [&](double start, double end) { calls.emplace_back(start, end); });
+
+  buffer.AddFrame(MakeFrame(0, 10));
+  buffer.AddFrame(MakeFrame(10, 20));
+  buffer.AddFrame(MakeFrame(20, 30));
+  // Removing nothing doesn't call it.
+  buffer.Remove(40, 50);
+  EXPECT_TRUE(calls.empty());
+  buffer.Remove(15, INFINITY);
+  ASSERT_EQ(1u, calls.size());
+  EXPECT_EQ(15, calls[0].first);
+  EXPECT_EQ(INFINITY, calls[0].second);
+
+  buffer.SetOnRemoved(nullptr);
+  buffer.Remove(0, 10);
+  EXPECT_EQ(1u, calls.size());
+}
+
+TEST(StreamBaseTest, AddFrames_AddsAllFramesAtOnce) {
+  StreamType buffer;
+  int calls = 0;
+  buffer.SetOnBufferedChanged([&]() { calls++; });
+
+  buffer.AddFrames({MakeFrame(20, 30), MakeFrame(0, 10), MakeFrame(10, 20),
+                    MakeFrame(40, 50)});
+  EXPECT_EQ(1, calls);
+  EXPECT_EQ(4u, buffer.CountFramesBetween(-1, 60));
+
+  auto ranges = buffer.GetBufferedRanges();
+  ASSERT_EQ(2u, ranges.size());
+  EXPECT_EQ(0, ranges[0].start);
+  EXPECT_EQ(30, ranges[0].end);
+  EXPECT_EQ(40, ranges[1].start);
+  EXPECT_EQ(50, ranges[1].end);
+
+  buffer.AddFrames({});
+  EXPECT_EQ(1, calls);
+}
+
 TEST(StreamBaseTest, Remove_RemovesWholeRange) {
   StreamType buffer;
   buffer.AddFrame(MakeFrame(0, 1));
@@ -548,5 +706,102 @@ TEST(StreamBaseTest, Remove_RemovesUntilKeyframe) {
   EXPECT_EQ(8, buffered[0].end);
 }
 
+TEST(StreamBaseTest, EstimateSize_TracksFrames) {
+  StreamType buffer;
+  EXPECT_EQ(0u, buffer.EstimateSize());
+
+  auto frame = MakeFrame(0, 1);
+  const size_t frame_size = frame->EstimateSize();
+  buffer.AddFrame(frame);
+  buffer.AddFrame(MakeFrame(1, 2));
+  buffer.AddFrame(MakeFrame(5, 6));
+  EXPECT_EQ(frame_size * 3, buffer.EstimateSize());
+
+  // Replacing a frame shouldn't count it twice.
+  buffer.AddFrame(MakeFrame(1, 2));
+  EXPECT_EQ(frame_size * 3, buffer.EstimateSize());
+
+  buffer.Remove(0, 1);
+  EXPECT_EQ(frame_size * 2, buffer.EstimateSize());
+
+  buffer.Clear();
+  EXPECT_EQ(0u, buffer.EstimateSize());
+}
+
+TEST(StreamBaseTest, SupportsConcurrentReaders) {
+  constexpr const int kFrameCount = 1000;
+  StreamType buffer;
+  std::atomic<bool> done{false};
+
+  // Readers should always see a consistent view of the stream while frames are
+  // being added.
+  auto reader = [&]() {
+    while (!done) {
+      auto ranges = buffer.GetBufferedRanges();
+      ASSERT_LE(ranges.size(), 1u);
+      if (!ranges.empty()) {
+        EXPECT_EQ(0, ranges[0].start);
+        EXPECT_TRUE(buffer.GetFrame(0, FrameLocation::Near));
+      }
+    }
+  };
+  std::thread reader1(reader);
+  std::thread reader2(reader);
+
+  for (int i = 0; i < kFrameCount; i++)
+    buffer.AddFrame(MakeFrame(i, i + 1));
+  done = true;
+  reader1.join();
+  reader2.join();
+
+  auto ranges = buffer.GetBufferedRanges();
+  ASSERT_EQ(1u, ranges.size());
+  EXPECT_EQ(kFrameCount, ranges[0].end);
+}
+
+// This is a micro-benchmark of buffering a long stream of frames.  This is
+// disabled by default; run with --gtest_also_run_disabled_tests to see the
+// results.  Debug builds validate the whole stream on every call, so this uses
+// fewer frames there.
+TEST(StreamBaseTest, DISABLED_LongStreamBenchmark) {
+  using std::chrono::duration_cast;
+  using std::chrono::nanoseconds;
+  using std::chrono::steady_clock;
+#ifdef NDEBUG
+  constexpr const int kFrameCount = 1000000;
+#else
+  constexpr const int kFrameCount = 10000;
+#endif
+  constexpr const double kFrameDuration = 0.02;
+
+  StreamType buffer;
+  auto start = steady_clock::now();
+  for (int i = 0; i < kFrameCount; i++)
+    buffer.AddFrame(MakeFrame(i * kFrameDuration, (i + 1) * kFrameDuration));
+  auto ns = duration_cast<nanoseconds>(steady_clock::now() - start);
+  LOG(INFO) << "AddFrame with " << kFrameCount
+            << " frames: " << (ns.count() / kFrameCount) << " ns per frame";
+
+  start = steady_clock::now();
+  size_t found = 0;
+  for (int i = 0; i < kFrameCount; i++) {
+    if (buffer.GetFrame(i * kFrameDuration, FrameLocation::Near))
+      found++;
+  }
+  ns = duration_cast<nanoseconds>(steady_clock::now() - start);
+  EXPECT_EQ(static_cast<size_t>(kFrameCount), found);
+  LOG(INFO) << "GetFrame with " << kFrameCount
+            << " frames: " << (ns.count() / kFrameCount) << " ns per call";
+
+  start = steady_clock::now();
+  size_t size = 0;
+  for (int i = 0; i < kFrameCount; i++)
+    size += buffer.EstimateSize();
+  ns = duration_cast<nanoseconds>(steady_clock::now() - start);
+  EXPECT_NE(0u, size);
+  LOG(INFO) << "EstimateSize with " << kFrameCount
+            << " frames: " << (ns.count() / kFrameCount) << " ns per call";
+}
+
 }  // namespace media
 }  // namespace shaka
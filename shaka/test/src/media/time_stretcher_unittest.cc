@@ -0,0 +1,143 @@
+// Copyright 2020 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     https://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "src/media/time_stretcher.h"
+
+#include <gtest/gtest.h>
+
+#include <algorithm>
+#include <cmath>
+#include <vector>
+
+namespace shaka {
+namespace media {
+
+namespace {
+
+constexpr const uint32_t kSampleRate = 48000;
+constexpr const uint32_t kChannels = 2;
+constexpr const double kPi = 3.14159265358979323846;
+/** The number of samples (per channel) to give the stretcher at once. */
+constexpr const size_t kChunkSize = 1024;
+
+/** Creates |seconds| of a packed stereo sine wave. */
+std::vector<float> MakeSine(double frequency, double seconds) {
+  const size_t count = static_cast<size_t>(seconds * kSampleRate);
+  std::vector<float> ret(count * kChannels);
+  for (size_t i = 0; i < count; i++) {
+    const float value = static_cast<float>(
+        0.5 * std::sin(2 * kPi * frequency * i / kSampleRate));
+    for (size_t c = 0; c < kChannels; c++)
+      ret[i * kChannels + c] = value;
+  }
+  return ret;
+}
+
+/** Stretches |input| in chunks and returns the combined output. */
+std::vector<float> Stretch(TimeStretcher* stretcher, double rate,
+                           const std::vector<float>& input) {
+  std::vector<float> ret;
+  std::vector<float> output;
+  const size_t frames = input.size() / kChannels;
+  for (size_t i = 0; i < frames; i += kChunkSize) {
+    const size_t count = std::min(kChunkSize, frames - i);
+    stretcher->Process(rate, input.data() + i * kChannels, count, &output);
+    ret.insert(ret.end(), output.begin(), output.end());
+  }
+  return ret;
+}
+
+/** @return The frequency of the first channel, using the zero crossings. */
+double GetFrequency(const std::vector<float>& samples) {
+  size_t crossings = 0;
+  for (size_t i = kChannels; i < samples.size(); i += kChannels) {
+    if ((samples[i - kChannels] < 0) != (samples[i] < 0))
+      crossings++;
+  }
+  const double seconds =
+      static_cast<double>(samples.size() / kChannels) / kSampleRate;
+  return crossings / 2.0 / seconds;
+}
+
+}  // namespace
+
+TEST(TimeStretcherTest, PassesThroughAtNormalRate) {
+  TimeStretcher stretcher;
+  stretcher.Configure(kChannels, kSampleRate);
+
+  const std::vector<float> input = MakeSine(440, 0.1);
+  EXPECT_EQ(input, Stretch(&stretcher, 1, input));
+  EXPECT_FALSE(stretcher.is_active());
+}
+
+TEST(TimeStretcherTest, ChangesDurationButNotPitch) {
+  const std::vector<float> input = MakeSine(440, 2);
+  const double input_seconds =
+      static_cast<double>(input.size() / kChannels) / kSampleRate;
+  for (double rate : {0.8, 1.25, 1.5}) {
+    TimeStretcher stretcher;
+    stretcher.Configure(kChannels, kSampleRate);
+    const std::vector<float> output = Stretch(&stretcher, rate, input);
+    EXPECT_TRUE(stretcher.is_active());
+
+    // Some input is buffered, so allow for a few windows of difference.
+    const double output_seconds =
+        static_cast<double>(output.size() / kChannels) / kSampleRate;
+    EXPECT_NEAR(input_seconds / rate, output_seconds, 0.05) << "rate=" << rate;
+    EXPECT_NEAR(440, GetFrequency(output), 440 * 0.02) << "rate=" << rate;
+  }
+}
+
+TEST(TimeStretcherTest, FlushesWhenReturningToNormalRate) {
+  TimeStretcher stretcher;
+  stretcher.Configure(kChannels, kSampleRate);
+
+  const std::vector<float> input = MakeSine(440, 0.5);
+  const std::vector<float> stretched = Stretch(&stretcher, 1.25, input);
+  ASSERT_TRUE(stretcher.is_active());
+
+  // The buffered input is played, followed by the new input.
+  std::vector<float> output;
+  stretcher.Process(1, input.data(), kChunkSize, &output);
+  EXPECT_FALSE(stretcher.is_active());
+  EXPECT_GT(output.size(), kChunkSize * kChannels);
+
+  // The buffered input follows the last window, so the wave is continuous.
+  EXPECT_NEAR(stretched.back(), output[0], 0.05);
+  EXPECT_EQ(std::vector<float>(input.begin(), input.begin() + kChunkSize * 2),
+            std::vector<float>(output.end() - kChunkSize * 2, output.end()));
+
+  stretcher.Process(1, input.data(), kChunkSize, &output);
+  EXPECT_EQ(kChunkSize * kChannels, output.size());
+}
+
+TEST(TimeStretcherTest, Reset) {
+  TimeStretcher stretcher;
+  stretcher.Configure(kChannels, kSampleRate);
+
+  const std::vector<float> input = MakeSine(440, 0.1);
+  Stretch(&stretcher, 0.8, input);
+  ASSERT_TRUE(stretcher.is_active());
+
+  stretcher.Reset();
+  EXPECT_FALSE(stretcher.is_active());
+  std::vector<float> output;
+  stretcher.Process(1, input.data(), kChunkSize, &output);
+  EXPECT_EQ(std::vector<float>(input.begin(),
+                               input.begin() + kChunkSize * kChannels),
+            output);
+}
+
+}  // namespace media
+}  // namespace shaka
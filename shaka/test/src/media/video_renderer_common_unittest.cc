@@ -18,6 +18,7 @@
 #include <gtest/gtest.h>
 
 #include <memory>
+#include <vector>
 
 #include "shaka/media/frames.h"
 #include "shaka/media/streams.h"
@@ -31,16 +32,42 @@ using testing::_;
 using testing::InSequence;
 using testing::MockFunction;
 using testing::Return;
+using testing::ReturnPointee;
 using testing::SaveArg;
 
 constexpr const double kMinDelay = 1.0 / 120;
 
-std::shared_ptr<DecodedFrame> MakeFrame(double start) {
-  auto* ret = new DecodedFrame(nullptr, start, start, 0.01, PixelFormat::RGB24,
-                               0, {}, {});
+std::shared_ptr<DecodedFrame> MakeFrame(double start, double duration = 0.01) {
+  auto* ret = new DecodedFrame(nullptr, start, start, duration,
+                               PixelFormat::RGB24, 0, {}, {});
   return std::shared_ptr<DecodedFrame>(ret);
 }
 
+/**
+ * Selects a frame for each of |count| vsyncs of a |refresh_rate| display,
+ * adding a small amount of jitter to the clock, and returns the number of
+ * vsyncs each frame was shown for.
+ */
+std::vector<int> RenderVsyncs(double refresh_rate, int count,
+                              VideoRendererCommon* renderer, double* time) {
+  std::vector<int> ret;
+  std::shared_ptr<DecodedFrame> prev_frame;
+  for (int i = 0; i < count; i++) {
+    const double jitter = ((i * 7) % 5 - 2) * 0.0015;
+    *time = i / refresh_rate + jitter;
+
+    std::shared_ptr<DecodedFrame> frame;
+    renderer->GetFrameForVsync(0, 1 / refresh_rate, &frame);
+    EXPECT_TRUE(frame);
+    if (frame == prev_frame)
+      ret.back()++;
+    else
+      ret.push_back(1);
+    prev_frame = frame;
+  }
+  return ret;
+}
+
 class MockMediaPlayer : public MediaPlayer {
  public:
   MOCK_CONST_METHOD1(DecodingInfo,
@@ -129,6 +156,26 @@ TEST(VideoRendererCommonTest, WorksWithNoFrames) {
   EXPECT_FALSE(cur_frame);
 }
 
+TEST(VideoRendererCommonTest, PollsSlowerWhenDetached) {
+  DecodedStream stream;
+  stream.AddFrame(MakeFrame(0.0));
+
+  MockMediaPlayer player;
+  EXPECT_CALL(player, PlaybackState())
+      .WillRepeatedly(Return(VideoPlaybackState::Playing));
+  EXPECT_CALL(player, CurrentTime()).WillRepeatedly(Return(0));
+
+  VideoRendererCommon renderer;
+  renderer.SetPlayer(&player);
+  renderer.Attach(&stream);
+  renderer.Detach();
+
+  std::shared_ptr<DecodedFrame> cur_frame;
+  const double delay = renderer.GetCurrentFrame(&cur_frame);
+  EXPECT_FALSE(cur_frame);
+  EXPECT_GT(delay, kMinDelay);
+}
+
 TEST(VideoRendererCommonTest, DrawsFrameInPast) {
   DecodedStream stream;
   auto frame = MakeFrame(0.0);
@@ -313,5 +360,151 @@ TEST(VideoRendererCommonTest, TracksNewFrames) {
 #undef FRAME_AT
 }
 
+TEST(VideoRendererCommonTest, CompensatesForPresentationLatency) {
+  DecodedStream stream;
+  for (int i = 0; i < 10; i++)
+    stream.AddFrame(MakeFrame(i * 0.01));
+
+  MockMediaPlayer player;
+  double time = 0;
+  EXPECT_CALL(player, PlaybackState())
+      .WillRepeatedly(Return(VideoPlaybackState::Playing));
+  EXPECT_CALL(player, PlaybackRate()).WillRepeatedly(Return(1));
+  EXPECT_CALL(player, CurrentTime()).WillRepeatedly(ReturnPointee(&time));
+
+  VideoRendererCommon renderer;
+  renderer.SetPlayer(&player);
+  renderer.Attach(&stream);
+
+  std::shared_ptr<DecodedFrame> cur_frame;
+  renderer.GetCurrentFrame(&cur_frame);
+  EXPECT_EQ(cur_frame, stream.GetFrame(0, FrameLocation::Near));
+
+  // The frame is shown 20ms after it was selected, after its end.
+  time = 0.02;
+  renderer.OnFramePresented(0);
+  auto quality = renderer.VideoPlaybackQuality();
+  EXPECT_EQ(quality.presented_video_frames, 1u);
+  EXPECT_EQ(quality.late_video_frames, 1u);
+  EXPECT_DOUBLE_EQ(quality.render_latency, 0.02);
+  EXPECT_DOUBLE_EQ(quality.av_sync_offset, 0.02);
+
+  // Presenting the same frame again isn't counted.
+  renderer.OnFramePresented(0);
+  EXPECT_EQ(renderer.VideoPlaybackQuality().presented_video_frames, 1u);
+
+  // The next frame is selected for when it will be shown.
+  time = 0.03;
+  renderer.GetCurrentFrame(&cur_frame);
+  EXPECT_EQ(cur_frame, stream.GetFrame(0.05, FrameLocation::Near));
+  time = 0.06;
+  renderer.OnFramePresented(0.01);
+  quality = renderer.VideoPlaybackQuality();
+  EXPECT_EQ(quality.presented_video_frames, 2u);
+  EXPECT_EQ(quality.late_video_frames, 1u);
+  EXPECT_DOUBLE_EQ(quality.render_latency, 0.02);
+  EXPECT_DOUBLE_EQ(quality.av_sync_offset, 0.01);
+}
+
+TEST(VideoRendererCommonTest, FollowsCadenceFor24FpsAt60Hz) {
+  DecodedStream stream;
+  for (int i = 0; i < 48; i++)
+    stream.AddFrame(MakeFrame(i / 24.0, 1 / 24.0));
+
+  double time = 0;
+  MockMediaPlayer player;
+  EXPECT_CALL(player, PlaybackState())
+      .WillRepeatedly(Return(VideoPlaybackState::Playing));
+  EXPECT_CALL(player, PlaybackRate()).WillRepeatedly(Return(1));
+  EXPECT_CALL(player, CurrentTime()).WillRepeatedly(ReturnPointee(&time));
+
+  VideoRendererCommon renderer;
+  renderer.SetPlayer(&player);
+  renderer.Attach(&stream);
+
+  // 1.5 seconds of playback, so the last frames are all full.
+  const std::vector<int> repeats = RenderVsyncs(60, 90, &renderer, &time);
+  ASSERT_GT(repeats.size(), 30u);
+  // Every frame should be shown for 2 or 3 vsyncs, alternating on average.
+  int total = 0;
+  for (size_t i = 1; i < repeats.size() - 1; i++) {
+    EXPECT_GE(repeats[i], 2) << "frame " << i;
+    EXPECT_LE(repeats[i], 3) << "frame " << i;
+    total += repeats[i];
+  }
+  EXPECT_NEAR(static_cast<double>(total) / (repeats.size() - 2), 2.5, 0.1);
+
+  const auto quality = renderer.VideoPlaybackQuality();
+  EXPECT_EQ(quality.dropped_video_frames, 0u);
+  EXPECT_EQ(quality.total_video_frames, repeats.size());
+  EXPECT_EQ(quality.repeated_vsyncs, 0u);
+  EXPECT_EQ(quality.cadence_breaks, 0u);
+}
+
+TEST(VideoRendererCommonTest, FollowsCadenceFor30FpsAt60Hz) {
+  DecodedStream stream;
+  for (int i = 0; i < 30; i++)
+    stream.AddFrame(MakeFrame(i / 30.0, 1 / 30.0));
+
+  double time = 0;
+  MockMediaPlayer player;
+  EXPECT_CALL(player, PlaybackState())
+      .WillRepeatedly(Return(VideoPlaybackState::Playing));
+  EXPECT_CALL(player, PlaybackRate()).WillRepeatedly(Return(1));
+  EXPECT_CALL(player, CurrentTime()).WillRepeatedly(ReturnPointee(&time));
+
+  VideoRendererCommon renderer;
+  renderer.SetPlayer(&player);
+  renderer.Attach(&stream);
+
+  const std::vector<int> repeats = RenderVsyncs(60, 56, &renderer, &time);
+  ASSERT_EQ(repeats.size(), 28u);
+  for (size_t i = 0; i < repeats.size(); i++)
+    EXPECT_EQ(repeats[i], 2) << "frame " << i;
+
+  const auto quality = renderer.VideoPlaybackQuality();
+  EXPECT_EQ(quality.dropped_video_frames, 0u);
+  EXPECT_EQ(quality.total_video_frames, 28u);
+  EXPECT_EQ(quality.repeated_vsyncs, 0u);
+  EXPECT_EQ(quality.cadence_breaks, 0u);
+}
+
+TEST(VideoRendererCommonTest, BreaksCadenceWhenClockJumps) {
+  DecodedStream stream;
+  for (int i = 0; i < 30; i++)
+    stream.AddFrame(MakeFrame(i / 30.0, 1 / 30.0));
+
+  double time = 0;
+  MockMediaPlayer player;
+  EXPECT_CALL(player, PlaybackState())
+      .WillRepeatedly(Return(VideoPlaybackState::Playing));
+  EXPECT_CALL(player, PlaybackRate()).WillRepeatedly(Return(1));
+  EXPECT_CALL(player, CurrentTime()).WillRepeatedly(ReturnPointee(&time));
+
+  VideoRendererCommon renderer;
+  renderer.SetPlayer(&player);
+  renderer.Attach(&stream);
+
+  std::shared_ptr<DecodedFrame> frame;
+  renderer.GetFrameForVsync(0, 1 / 60.0, &frame);
+  EXPECT_EQ(frame, stream.GetFrame(0, FrameLocation::Near));
+
+  // The clock jumps ahead three frames, so the cadence can't be kept.
+  time = 0.1;
+  renderer.GetFrameForVsync(0, 1 / 60.0, &frame);
+  EXPECT_EQ(frame, stream.GetFrame(0.1, FrameLocation::Near));
+
+  // The clock stalls, so the frame is shown longer than its cadence.
+  renderer.GetFrameForVsync(0, 1 / 60.0, &frame);
+  renderer.GetFrameForVsync(0, 1 / 60.0, &frame);
+  EXPECT_EQ(frame, stream.GetFrame(0.1, FrameLocation::Near));
+
+  const auto quality = renderer.VideoPlaybackQuality();
+  EXPECT_EQ(quality.dropped_video_frames, 2u);
+  EXPECT_EQ(quality.total_video_frames, 4u);
+  EXPECT_EQ(quality.cadence_breaks, 1u);
+  EXPECT_EQ(quality.repeated_vsyncs, 1u);
+}
+
 }  // namespace media
 }  // namespace shaka
@@ -0,0 +1,159 @@
+// Copyright 2020 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     https://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "src/media/webvtt_parser.h"
+
+#include <gtest/gtest.h>
+#include <math.h>
+
+#include <string>
+#include <vector>
+
+namespace shaka {
+namespace media {
+
+namespace {
+
+std::vector<std::shared_ptr<VTTCue>> Parse(const std::string& text,
+                                           double offset = 0) {
+  std::vector<std::shared_ptr<VTTCue>> cues;
+  std::string error;
+  EXPECT_TRUE(ParseWebVtt(reinterpret_cast<const uint8_t*>(text.data()),
+                          text.size(), offset, &cues, &error))
+      << error;
+  return cues;
+}
+
+}  // namespace
+
+TEST(WebVttParserTest, ParsesCues) {
+  auto cues = Parse(
+      "WEBVTT\n"
+      "\n"
+      "00:00:01.000 --> 00:00:02.500\n"
+      "First\n"
+      "\n"
+      "second-id\n"
+      "01:02:03.004 --> 01:02:04.000\n"
+      "Second\n"
+      "line\n");
+  ASSERT_EQ(2u, cues.size());
+  EXPECT_EQ("", cues[0]->id());
+  EXPECT_EQ(1, cues[0]->start_time());
+  EXPECT_EQ(2.5, cues[0]->end_time());
+  EXPECT_EQ("First", cues[0]->text());
+  EXPECT_EQ("second-id", cues[1]->id());
+  EXPECT_DOUBLE_EQ(3723.004, cues[1]->start_time());
+  EXPECT_EQ(3724, cues[1]->end_time());
+  EXPECT_EQ("Second\nline", cues[1]->text());
+}
+
+TEST(WebVttParserTest, HandlesLineEndingsAndByteOrderMark) {
+  auto cues = Parse(
+      "\xef\xbb\xbfWEBVTT - Title\r\n"
+      "\r\n"
+      "00:01.000 --> 00:02.000\r"
+      "One\r"
+      "\r"
+      "00:03.000 --> 00:04.000\r\n"
+      "Two");
+  ASSERT_EQ(2u, cues.size());
+  EXPECT_EQ("One", cues[0]->text());
+  EXPECT_EQ(3, cues[1]->start_time());
+  EXPECT_EQ("Two", cues[1]->text());
+}
+
+TEST(WebVttParserTest, ParsesSettings) {
+  auto cues = Parse(
+      "WEBVTT\n"
+      "\n"
+      "00:01.000 --> 00:02.000 vertical:rl line:10%,end position:20%,line-left"
+      " size:50% align:start\n"
+      "Text\n"
+      "\n"
+      "00:03.000 --> 00:04.000 line:-2 align:bogus foo:bar\n"
+      "Text\n");
+  ASSERT_EQ(2u, cues.size());
+  EXPECT_EQ(DirectionSetting::RightToLeft, cues[0]->vertical());
+  EXPECT_FALSE(cues[0]->snap_to_lines());
+  EXPECT_EQ(10, cues[0]->line());
+  EXPECT_EQ(LineAlignSetting::End, cues[0]->line_align());
+  EXPECT_EQ(20, cues[0]->position());
+  EXPECT_EQ(PositionAlignSetting::LineLeft, cues[0]->position_align());
+  EXPECT_EQ(50, cues[0]->size());
+  EXPECT_EQ(AlignSetting::Start, cues[0]->align());
+
+  EXPECT_TRUE(cues[1]->snap_to_lines());
+  EXPECT_EQ(-2, cues[1]->line());
+  EXPECT_EQ(AlignSetting::Center, cues[1]->align());
+  EXPECT_TRUE(isnan(cues[1]->position()));
+}
+
+TEST(WebVttParserTest, SkipsOtherBlocks) {
+  auto cues = Parse(
+      "WEBVTT\n"
+      "\n"
+      "NOTE a comment\n"
+      "00:01.000 --> 00:02.000\n"
+      "\n"
+      "STYLE\n"
+      "::cue { color: red }\n"
+      "\n"
+      "00:03.000 --> 00:04.000\n"
+      "Cue\n");
+  ASSERT_EQ(1u, cues.size());
+  EXPECT_EQ(3, cues[0]->start_time());
+}
+
+TEST(WebVttParserTest, SkipsInvalidCues) {
+  auto cues = Parse(
+      "WEBVTT\n"
+      "\n"
+      "00:01.000 --> 00:02\n"
+      "Bad\n"
+      "\n"
+      "00:61.000 --> 00:62.000\n"
+      "Bad\n"
+      "\n"
+      "00:03.000 --> 00:04.000\n"
+      "Good\n");
+  ASSERT_EQ(1u, cues.size());
+  EXPECT_EQ("Good", cues[0]->text());
+}
+
+TEST(WebVttParserTest, AppliesOffsets) {
+  auto cues = Parse(
+      "WEBVTT\n"
+      "X-TIMESTAMP-MAP=MPEGTS:900000,LOCAL:00:00:02.000\n"
+      "\n"
+      "00:03.000 --> 00:04.000\n"
+      "Text\n",
+      100);
+  ASSERT_EQ(1u, cues.size());
+  EXPECT_EQ(111, cues[0]->start_time());
+  EXPECT_EQ(112, cues[0]->end_time());
+}
+
+TEST(WebVttParserTest, RejectsMissingHeader) {
+  const std::string text = "00:01.000 --> 00:02.000\nText\n";
+  std::vector<std::shared_ptr<VTTCue>> cues;
+  std::string error;
+  EXPECT_FALSE(ParseWebVtt(reinterpret_cast<const uint8_t*>(text.data()),
+                           text.size(), 0, &cues, &error));
+  EXPECT_FALSE(ParseWebVtt(reinterpret_cast<const uint8_t*>("WEBVTTX"), 7, 0,
+                           &cues, &error));
+}
+
+}  // namespace media
+}  // namespace shaka
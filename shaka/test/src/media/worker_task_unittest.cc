@@ -0,0 +1,199 @@
+// Copyright 2020 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     https://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "src/media/worker_task.h"
+
+#include <gtest/gtest.h>
+
+#include <atomic>
+#include <chrono>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+#include "src/util/clock.h"
+
+namespace shaka {
+namespace media {
+
+namespace {
+
+constexpr const std::chrono::seconds kTimeout(1);
+
+}  // namespace
+
+TEST(WorkerTaskTest, RunsWhenWokenOnThread) {
+  std::atomic<int> count{0};
+  std::promise<void> first_run;
+  std::promise<void> second_run;
+  WorkerTask task("Test", nullptr, &util::Clock::Instance, [&]() {
+    const int run = ++count;
+    if (run == 1)
+      first_run.set_value();
+    else if (run == 2)
+      second_run.set_value();
+    return WorkerTask::kWaitForWake;
+  });
+
+  ASSERT_EQ(std::future_status::ready,
+            first_run.get_future().wait_for(kTimeout));
+  auto second_future = second_run.get_future();
+  EXPECT_EQ(std::future_status::timeout,
+            second_future.wait_for(std::chrono::milliseconds(20)));
+
+  task.Wake();
+  ASSERT_EQ(std::future_status::ready, second_future.wait_for(kTimeout));
+  task.Stop();
+  EXPECT_EQ(2, count);
+}
+
+TEST(WorkerTaskTest, RunsWhenWokenOnPool) {
+  WorkerPool pool(2);
+  std::atomic<int> count{0};
+  std::promise<void> first_run;
+  std::promise<void> second_run;
+  WorkerTask task("Test", &pool, &util::Clock::Instance, [&]() {
+    const int run = ++count;
+    if (run == 1)
+      first_run.set_value();
+    else if (run == 2)
+      second_run.set_value();
+    return WorkerTask::kWaitForWake;
+  });
+
+  ASSERT_EQ(std::future_status::ready,
+            first_run.get_future().wait_for(kTimeout));
+  auto second_future = second_run.get_future();
+  EXPECT_EQ(std::future_status::timeout,
+            second_future.wait_for(std::chrono::milliseconds(20)));
+
+  task.Wake();
+  ASSERT_EQ(std::future_status::ready, second_future.wait_for(kTimeout));
+  task.Stop();
+  EXPECT_EQ(2, count);
+}
+
+TEST(WorkerTaskTest, RunsAgainAfterDelay) {
+  WorkerPool pool(1);
+  std::atomic<int> count{0};
+  std::promise<void> second_run;
+  WorkerTask task("Test", &pool, &util::Clock::Instance, [&]() {
+    if (++count == 1)
+      return 0.01;
+    second_run.set_value();
+    return WorkerTask::kWaitForWake;
+  });
+
+  ASSERT_EQ(std::future_status::ready,
+            second_run.get_future().wait_for(kTimeout));
+}
+
+TEST(WorkerTaskTest, StopsWhenStepReturnsStop) {
+  WorkerPool pool(1);
+  for (WorkerPool* task_pool : {static_cast<WorkerPool*>(nullptr), &pool}) {
+    std::atomic<int> count{0};
+    std::promise<void> first_run;
+    WorkerTask task("Test", task_pool, &util::Clock::Instance, [&]() {
+      if (++count == 1)
+        first_run.set_value();
+      return WorkerTask::kStop;
+    });
+
+    ASSERT_EQ(std::future_status::ready,
+              first_run.get_future().wait_for(kTimeout));
+    task.Wake();
+    util::Clock::Instance.SleepSeconds(0.02);
+    EXPECT_EQ(1, count);
+  }
+}
+
+TEST(WorkerTaskTest, RunsAgainIfWokenWhileRunning) {
+  WorkerPool pool(1);
+  std::promise<void> created;
+  std::shared_future<void> created_future = created.get_future().share();
+  std::promise<void> second_run;
+  std::atomic<int> count{0};
+  std::unique_ptr<WorkerTask> task;
+  task.reset(new WorkerTask("Test", &pool, &util::Clock::Instance, [&]() {
+    const int run = ++count;
+    if (run == 1) {
+      created_future.wait();
+      task->Wake();
+    } else if (run == 2) {
+      second_run.set_value();
+    }
+    return WorkerTask::kWaitForWake;
+  }));
+  created.set_value();
+
+  ASSERT_EQ(std::future_status::ready,
+            second_run.get_future().wait_for(kTimeout));
+  task.reset();
+}
+
+TEST(WorkerTaskTest, RunsHigherPriorityFirst) {
+  WorkerPool pool(1);
+  std::mutex mutex;
+  std::vector<int> order;
+  std::promise<void> blocked;
+  std::promise<void> unblock;
+  std::shared_future<void> unblock_future = unblock.get_future().share();
+  std::promise<void> low_run;
+  std::promise<void> high_run;
+
+  // Block the only thread so both tasks are ready at the same time.
+  WorkerTask blocker("Blocker", &pool, &util::Clock::Instance, [&]() {
+    blocked.set_value();
+    unblock_future.wait();
+    return WorkerTask::kWaitForWake;
+  });
+  ASSERT_EQ(std::future_status::ready,
+            blocked.get_future().wait_for(kTimeout));
+
+  auto make_step = [&](int id, std::promise<void>* promise) {
+    return [&mutex, &order, id, promise]() {
+      {
+        std::unique_lock<std::mutex> lock(mutex);
+        order.push_back(id);
+      }
+      promise->set_value();
+      return WorkerTask::kWaitForWake;
+    };
+  };
+  WorkerTask low("Low", &pool, &util::Clock::Instance,
+                 make_step(1, &low_run));
+  WorkerTask high("High", &pool, &util::Clock::Instance,
+                  make_step(2, &high_run));
+  low.SetPriority(-1);
+  high.SetPriority(1);
+  unblock.set_value();
+
+  ASSERT_EQ(std::future_status::ready, low_run.get_future().wait_for(kTimeout));
+  ASSERT_EQ(std::future_status::ready,
+            high_run.get_future().wait_for(kTimeout));
+  std::unique_lock<std::mutex> lock(mutex);
+  EXPECT_EQ(std::vector<int>({2, 1}), order);
+}
+
+TEST(WorkerPoolTest, UsesCpuCountByDefault) {
+  WorkerPool pool;
+  EXPECT_GE(pool.thread_count(), 1u);
+
+  WorkerPool small_pool(3);
+  EXPECT_EQ(3u, small_pool.thread_count());
+}
+
+}  // namespace media
+}  // namespace shaka
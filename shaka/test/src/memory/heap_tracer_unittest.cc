@@ -36,6 +36,10 @@ class TestObject : public BackingObject {
     // setup the JavaScript engine, so we can't trace any JavaScript objects.
   }
 
+  std::string TraceTypeName() const override {
+    return "TestObject";
+  }
+
  private:
   BackingObjectFactoryBase* factory() const override {
     return nullptr;
@@ -55,6 +59,31 @@ class TestObjectWithBackingChild : public TestObject {
   Member<TestObject> member3;
 };
 
+class TestObjectWithContainers : public TestObject {
+ public:
+  void Trace(HeapTracer* tracer) const override {
+    tracer->Trace(&members);
+    tracer->Trace(&map);
+    tracer->Trace(&names);
+  }
+
+  std::vector<Member<TestObject>> members;
+  std::unordered_map<std::string, Member<TestObject>> map;
+  std::vector<std::string> names;
+};
+
+static_assert(is_traceable<Member<TestObject>>::value, "");
+static_assert(is_traceable<std::vector<Member<TestObject>>>::value, "");
+static_assert(is_traceable<std::unordered_map<std::string,
+                                              Member<TestObject>>>::value,
+              "");
+static_assert(is_traceable<variant<double, Member<TestObject>>>::value, "");
+static_assert(!is_traceable<std::vector<std::string>>::value, "");
+static_assert(!is_traceable<std::list<optional<double>>>::value, "");
+static_assert(!is_traceable<std::unordered_map<std::string, bool>>::value,
+              "");
+static_assert(!is_traceable<variant<double, std::string>>::value, "");
+
 }  // namespace
 
 class HeapTracerTest : public testing::Test {
@@ -183,5 +212,63 @@ TEST_F(HeapTracerTest, SupportsCircularReferences) {
   ExpectAlive(root, A, B, C);
 }
 
+TEST_F(HeapTracerTest, TracesInSteps) {
+  auto* root = new TestObjectWithBackingChild;
+  auto* A = new TestObjectWithBackingChild;
+  auto* B = new TestObjectWithBackingChild;
+  auto* C = new TestObjectWithBackingChild;
+  auto* D = new TestObjectWithBackingChild;
+  root->member1 = A;
+  root->member2 = B;
+  A->member1 = C;
+  C->member1 = root;
+
+  heap_tracer.BeginPass();
+  heap_tracer.AddRoots({root});
+  EXPECT_TRUE(heap_tracer.HasPendingObjects());
+
+  // Each step only traces one object, the children are traced later.
+  EXPECT_TRUE(heap_tracer.TraceStep(1));
+  ExpectAlive(root);
+  ExpectDead(A, B, C);
+
+  size_t steps = 1;
+  while (heap_tracer.TraceStep(1))
+    steps++;
+  EXPECT_FALSE(heap_tracer.HasPendingObjects());
+  EXPECT_GE(steps, 3u);
+  ExpectAlive(root, A, B, C);
+  ExpectDead(D);
+}
+
+TEST_F(HeapTracerTest, TracesContainers) {
+  auto* root = new TestObjectWithContainers;
+  auto* A = new TestObject;
+  auto* B = new TestObject;
+  auto* C = new TestObject;
+  root->members.emplace_back(A);
+  root->map.emplace("b", B);
+  root->names.emplace_back("c");
+
+  RunTracer({}, root);
+  ExpectAlive(root, A, B);
+  ExpectDead(C);
+}
+
+TEST_F(HeapTracerTest, ProfilesTracingByType) {
+  auto* root = new TestObjectWithBackingChild;
+  root->member1 = new TestObject;
+
+  RunTracer({}, root);
+  EXPECT_EQ(std::string::npos, heap_tracer.DumpProfile().find("TestObject"));
+
+  heap_tracer.SetProfilingEnabled(true);
+  RunTracer({}, root);
+  EXPECT_NE(std::string::npos, heap_tracer.DumpProfile().find("TestObject"));
+
+  heap_tracer.ResetProfile();
+  EXPECT_EQ(std::string::npos, heap_tracer.DumpProfile().find("TestObject"));
+}
+
 }  // namespace memory
 }  // namespace shaka
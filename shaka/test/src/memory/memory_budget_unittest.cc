@@ -0,0 +1,136 @@
+// Copyright 2020 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     https://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "src/memory/memory_budget.h"
+
+#include <gtest/gtest.h>
+
+#include <algorithm>
+#include <string>
+#include <vector>
+
+namespace shaka {
+namespace memory {
+
+namespace {
+
+/** A fake cache that records the order it was evicted in. */
+class FakeCache {
+ public:
+  FakeCache(MemorySubsystem subsystem, size_t size, bool can_evict,
+            std::vector<std::string>* log, const std::string& name)
+      : size_(size),
+        consumer_(subsystem, name, [this]() { return size_; },
+                  can_evict ? MemoryBudget::Consumer::EvictCallback(
+                                  [this, log, name](size_t bytes) {
+                                    log->push_back(name);
+                                    const size_t freed = std::min(bytes, size_);
+                                    size_ -= freed;
+                                    return freed;
+                                  })
+                            : nullptr) {}
+
+  size_t size() const {
+    return size_;
+  }
+
+ private:
+  size_t size_;
+  MemoryBudget::Consumer consumer_;
+};
+
+class MemoryBudgetTest : public testing::Test {
+ protected:
+  void TearDown() override {
+    MemoryBudget::Instance()->SetBudget(0);
+  }
+
+  std::vector<std::string> log_;
+};
+
+}  // namespace
+
+TEST_F(MemoryBudgetTest, ReportsUsage) {
+  FakeCache decoded(MemorySubsystem::DecodedFrames, 100, false, &log_, "a");
+  FakeCache encoded(MemorySubsystem::EncodedFrames, 20, false, &log_, "b");
+  FakeCache encoded2(MemorySubsystem::EncodedFrames, 30, false, &log_, "c");
+
+  const MemoryBudget::Usage usage = MemoryBudget::Instance()->GetUsage();
+  EXPECT_EQ(0u, usage.budget);
+  EXPECT_EQ(100u, usage.bytes[static_cast<size_t>(
+                      MemorySubsystem::DecodedFrames)]);
+  EXPECT_EQ(50u, usage.bytes[static_cast<size_t>(
+                     MemorySubsystem::EncodedFrames)]);
+  EXPECT_EQ(0u,
+            usage.bytes[static_cast<size_t>(MemorySubsystem::SegmentCache)]);
+  EXPECT_LE(150u, usage.total_bytes);
+
+  ASSERT_EQ(3u, usage.consumers.size());
+  EXPECT_EQ("b", usage.consumers[1].name);
+  EXPECT_EQ(MemorySubsystem::EncodedFrames, usage.consumers[1].subsystem);
+  EXPECT_EQ(20u, usage.consumers[1].bytes);
+}
+
+TEST_F(MemoryBudgetTest, NoLimitByDefault) {
+  FakeCache cache(MemorySubsystem::SegmentCache, 100, true, &log_, "a");
+  EXPECT_TRUE(MemoryBudget::Instance()->Fits(1000000));
+  EXPECT_TRUE(MemoryBudget::Instance()->Enforce(1000000));
+  EXPECT_TRUE(log_.empty());
+  EXPECT_EQ(100u, cache.size());
+}
+
+TEST_F(MemoryBudgetTest, EvictsInPriorityOrder) {
+  // Register in the opposite order to ensure the subsystem is used.
+  FakeCache decoded(MemorySubsystem::DecodedFrames, 100, true, &log_, "c");
+  FakeCache pool(MemorySubsystem::FramePool, 100, true, &log_, "b");
+  FakeCache cache(MemorySubsystem::SegmentCache, 100, true, &log_, "a");
+
+  MemoryBudget* budget = MemoryBudget::Instance();
+  budget->SetBudget(1000);
+  EXPECT_TRUE(budget->Fits(500));
+  EXPECT_FALSE(budget->Fits(800));
+
+  const uint64_t evicted = budget->GetUsage().evicted_bytes;
+  EXPECT_TRUE(budget->Enforce(850));
+  EXPECT_EQ(0u, cache.size());
+  EXPECT_EQ(50u, pool.size());
+  EXPECT_EQ(100u, decoded.size());
+  EXPECT_EQ((std::vector<std::string>{"a", "b"}), log_);
+  EXPECT_EQ(evicted + 150, budget->GetUsage().evicted_bytes);
+}
+
+TEST_F(MemoryBudgetTest, SkipsConsumersThatCantEvict) {
+  FakeCache encoded(MemorySubsystem::EncodedFrames, 100, false, &log_, "a");
+  FakeCache decoded(MemorySubsystem::DecodedFrames, 100, true, &log_, "b");
+
+  MemoryBudget* budget = MemoryBudget::Instance();
+  budget->SetBudget(150);
+  EXPECT_EQ((std::vector<std::string>{"b"}), log_);
+  EXPECT_EQ(50u, decoded.size());
+
+  EXPECT_FALSE(budget->Enforce(100));
+  EXPECT_EQ(0u, decoded.size());
+  EXPECT_EQ(100u, encoded.size());
+}
+
+TEST_F(MemoryBudgetTest, UnregistersConsumers) {
+  {
+    FakeCache cache(MemorySubsystem::SegmentCache, 100, true, &log_, "a");
+    EXPECT_EQ(100u, MemoryBudget::Instance()->GetUsage().bytes[0]);
+  }
+  EXPECT_EQ(0u, MemoryBudget::Instance()->GetUsage().bytes[0]);
+}
+
+}  // namespace memory
+}  // namespace shaka
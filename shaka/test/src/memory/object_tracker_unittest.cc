@@ -17,6 +17,9 @@
 #include <gtest/gtest.h>
 
 #include <functional>
+#include <memory>
+#include <thread>
+#include <vector>
 
 #include "src/core/ref_ptr.h"
 #include "src/mapping/backing_object.h"
@@ -43,6 +46,13 @@ class TestObject : public BackingObject {
       on_destroy();
   }
 
+  std::string TraceTypeName() const override {
+    return "TestObject";
+  }
+  size_t TraceSize() const override {
+    return sizeof(*this);
+  }
+
   std::function<void()> on_destroy;
 
  private:
@@ -74,11 +84,13 @@ class ObjectTrackerTest : public testing::Test {
 };
 
 TEST_F(ObjectTrackerTest, BasicFlow) {
+  EXPECT_EQ(tracker.GetObjectCount(), 0u);
   bool is_free = false;
   TestObject* obj = new TestObject(&is_free);
   ASSERT_TRUE(obj);
   ExpectZeroRefs(obj);
   ASSERT_FALSE(is_free);
+  EXPECT_EQ(tracker.GetObjectCount(), 1u);
 
   {
     // Note, this will not free the object even though it is the last reference.
@@ -101,6 +113,46 @@ TEST_F(ObjectTrackerTest, BasicFlow) {
   tracker.FreeDeadObjects(js_alive);
   // The pointer is invalid at this point.
   EXPECT_TRUE(is_free);
+  EXPECT_EQ(tracker.GetObjectCount(), 0u);
+}
+
+TEST_F(ObjectTrackerTest, GetsTypeStats) {
+  EXPECT_TRUE(tracker.GetTypeStats().empty());
+
+  bool is_free[2];
+  new TestObject(&is_free[0]);
+  new TestObject(&is_free[1]);
+  const std::vector<ObjectTracker::TypeStats> stats = tracker.GetTypeStats();
+  ASSERT_EQ(1u, stats.size());
+  EXPECT_EQ("TestObject", stats[0].type_name);
+  EXPECT_EQ(2u, stats[0].count);
+  EXPECT_EQ(2 * sizeof(TestObject), stats[0].bytes);
+
+  tracker.FreeDeadObjects({});
+  EXPECT_TRUE(is_free[0]);
+  EXPECT_TRUE(is_free[1]);
+  EXPECT_TRUE(tracker.GetTypeStats().empty());
+}
+
+TEST_F(ObjectTrackerTest, RegistersObjectsFromManyThreads) {
+  constexpr const size_t kThreadCount = 4;
+  constexpr const size_t kObjectCount = 100;
+  std::unique_ptr<bool[]> is_free(new bool[kThreadCount * kObjectCount]);
+  std::vector<std::thread> threads;
+  for (size_t i = 0; i < kThreadCount; i++) {
+    threads.emplace_back([&, i]() {
+      for (size_t j = 0; j < kObjectCount; j++)
+        new TestObject(&is_free[i * kObjectCount + j]);
+    });
+  }
+  for (auto& thread : threads)
+    thread.join();
+  EXPECT_EQ(tracker.GetObjectCount(), kThreadCount * kObjectCount);
+
+  tracker.FreeDeadObjects({});
+  EXPECT_EQ(tracker.GetObjectCount(), 0u);
+  for (size_t i = 0; i < kThreadCount * kObjectCount; i++)
+    EXPECT_TRUE(is_free[i]);
 }
 
 TEST_F(ObjectTrackerTest, Dispose) {
@@ -188,5 +240,29 @@ TEST_F(ObjectTrackerTest, RefCounts) {
   tracker.Dispose();
 }
 
+TEST_F(ObjectTrackerTest, CanRemoveRefsInDestructors) {
+  bool is_free1, is_free2, is_free3;
+  TestObject* obj1 = new TestObject(&is_free1);
+  TestObject* obj2 = new TestObject(&is_free2);
+  TestObject* obj3 = new TestObject(&is_free3);
+
+  // |obj1| and |obj2| reference each other and |obj1| references |obj3|.  When
+  // they are freed together, the references to the already deleted object
+  // should be ignored.
+  tracker.AddRef(obj2);
+  tracker.AddRef(obj3);
+  obj1->on_destroy = [&]() {
+    tracker.RemoveRef(obj2);
+    tracker.RemoveRef(obj3);
+  };
+  tracker.AddRef(obj1);
+  obj2->on_destroy = [&]() { tracker.RemoveRef(obj1); };
+
+  tracker.Dispose();
+  EXPECT_TRUE(is_free1);
+  EXPECT_TRUE(is_free2);
+  EXPECT_TRUE(is_free3);
+}
+
 }  // namespace memory
 }  // namespace shaka
@@ -0,0 +1,99 @@
+// Copyright 2020 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     https://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "src/memory/pool_allocator.h"
+
+#include <gtest/gtest.h>
+
+#include <thread>
+#include <vector>
+
+namespace shaka {
+namespace memory {
+
+namespace {
+
+struct Object {
+  Object(int value, bool* destroyed) : value(value), destroyed(destroyed) {}
+  ~Object() {
+    *destroyed = true;
+  }
+
+  int value;
+  bool* destroyed;
+};
+
+}  // namespace
+
+class PoolAllocatorTest : public testing::Test {
+ protected:
+  void SetUp() override {
+    BlockPool::ResetStats();
+  }
+};
+
+TEST_F(PoolAllocatorTest, ReusesFreedBlocks) {
+  BlockPool pool(32);
+  void* first = pool.Allocate();
+  pool.Free(first);
+  EXPECT_EQ(first, pool.Allocate());
+
+  void* second = pool.Allocate();
+  EXPECT_NE(first, second);
+  pool.Free(first);
+  pool.Free(second);
+
+  const BlockPool::Stats stats = BlockPool::GetStats();
+  EXPECT_EQ(3u, stats.allocations);
+  EXPECT_EQ(2u, stats.heap_allocations);
+}
+
+TEST_F(PoolAllocatorTest, ReusesBlocksFreedOnOtherThreads) {
+  BlockPool pool(32);
+  std::vector<void*> blocks;
+  for (int i = 0; i < 4; i++)
+    blocks.emplace_back(pool.Allocate());
+
+  std::thread thread([&]() {
+    for (void* block : blocks)
+      pool.Free(block);
+  });
+  thread.join();
+
+  for (int i = 0; i < 4; i++)
+    pool.Free(pool.Allocate());
+  EXPECT_EQ(4u, BlockPool::GetStats().heap_allocations);
+}
+
+TEST_F(PoolAllocatorTest, MakesSharedObjects) {
+  bool destroyed = false;
+  auto object = MakePooledShared<Object>(12, &destroyed);
+  EXPECT_EQ(12, object->value);
+  object.reset();
+  EXPECT_TRUE(destroyed);
+
+  // The second object reuses the memory of the first.
+  destroyed = false;
+  object = MakePooledShared<Object>(34, &destroyed);
+  EXPECT_EQ(34, object->value);
+  object.reset();
+  EXPECT_TRUE(destroyed);
+
+  const BlockPool::Stats stats = BlockPool::GetStats();
+  EXPECT_EQ(2u, stats.allocations);
+  EXPECT_EQ(1u, stats.heap_allocations);
+}
+
+}  // namespace memory
+}  // namespace shaka
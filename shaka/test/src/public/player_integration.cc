@@ -17,6 +17,7 @@
 
 #include <chrono>
 #include <memory>
+#include <thread>
 
 #include "shaka/eme/implementation_registry.h"
 #include "shaka/js_manager.h"
@@ -151,6 +152,67 @@ TEST_F(PlayerIntegration, Player_BasicFlow) {
   ASSERT_SUCCESS(player->Unload());
 }
 
+TEST_F(PlayerIntegration, Player_CallbackGetters) {
+  ASSERT_SUCCESS(player->Load(kManifestUrl));
+
+  auto signal = std::make_shared<ThreadEvent<void>>("");
+  player->IsLive([=](const AsyncResults<bool>::variant_type& results) {
+    ASSERT_TRUE(holds_alternative<bool>(results));
+    EXPECT_FALSE(get<bool>(results));
+    signal->SignalAll();
+  });
+  ASSERT_EQ(signal->future().wait_for(std::chrono::seconds(10)),
+            std::future_status::ready);
+
+  // The executor is used to run the callback.
+  signal->Reset();
+  int executor_calls = 0;
+  player->GetStats(
+      [=](const AsyncResults<Stats>::variant_type& results) {
+        EXPECT_TRUE(holds_alternative<Stats>(results));
+        signal->SignalAll();
+      },
+      [&](std::function<void()> task) {
+        executor_calls++;
+        task();
+      });
+  ASSERT_EQ(signal->future().wait_for(std::chrono::seconds(10)),
+            std::future_status::ready);
+  EXPECT_EQ(executor_calls, 1);
+
+  ASSERT_SUCCESS(player->Unload());
+}
+
+TEST_F(PlayerIntegration, Player_StateSnapshot) {
+  EXPECT_FALSE(player->GetStateSnapshot().valid);
+  ASSERT_SUCCESS(player->Load(kManifestUrl));
+
+  player->SetStateSnapshotInterval(10);
+  const auto start = std::chrono::steady_clock::now();
+  while (!player->GetStateSnapshot().valid) {
+    ASSERT_LT(std::chrono::steady_clock::now() - start,
+              std::chrono::seconds(10));
+    std::this_thread::sleep_for(std::chrono::milliseconds(10));
+  }
+  const Player::StateSnapshot snapshot = player->GetStateSnapshot();
+  EXPECT_FALSE(snapshot.is_live);
+  EXPECT_FALSE(snapshot.is_audio_only);
+
+  player->SetStateSnapshotInterval(0);
+  ASSERT_SUCCESS(player->Unload());
+}
+
+TEST_F(PlayerIntegration, Player_GetPlaybackPosition) {
+  ASSERT_SUCCESS(player->Load(kManifestUrl));
+
+  const Player::PlaybackPosition position = player->GetPlaybackPosition();
+  EXPECT_NE(position.state, media::VideoPlaybackState::Detached);
+  EXPECT_EQ(position.current_time, g_media_player->CurrentTime());
+  EXPECT_EQ(position.duration, g_media_player->Duration());
+
+  ASSERT_SUCCESS(player->Unload());
+}
+
 TEST_F(PlayerIntegration, Player_PlaysWidevine) {
   if (!eme::ImplementationRegistry::GetImplementation("com.widevine.alpha"))
     GTEST_SKIP();
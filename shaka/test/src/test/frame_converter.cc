@@ -37,6 +37,10 @@ int GetFFmpegFormat(variant<media::PixelFormat, media::SampleFormat> format) {
       return AV_PIX_FMT_NV12;
     case media::PixelFormat::RGB24:
       return AV_PIX_FMT_RGB24;
+    case media::PixelFormat::YUV420P10:
+      return AV_PIX_FMT_YUV420P10LE;
+    case media::PixelFormat::P010:
+      return AV_PIX_FMT_P010LE;
 
     default:
       return AV_PIX_FMT_NONE;
@@ -0,0 +1,70 @@
+// Copyright 2020 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     https://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "src/test/temp_dir_test.h"
+
+#ifdef OS_POSIX
+#  include <ftw.h>
+#  include <stdio.h>
+#  include <stdlib.h>
+#  include <unistd.h>
+#endif
+#include <glog/logging.h>
+
+#include "src/util/darwin_utils.h"
+
+namespace shaka {
+
+namespace {
+
+#ifdef OS_POSIX
+int DeleteItem(const char* path, const struct stat* st, int flags,
+               struct FTW*) {
+  const int status = flags == FTW_DP ? rmdir(path) : unlink(path);
+  if (status != 0) {
+    PLOG(FATAL) << "Error deleting file/directory " << path << " with status "
+                << status;
+  }
+  return status;
+}
+#endif
+
+}  // namespace
+
+void TempDirTest::SetUp() {
+#ifdef OS_POSIX
+#  ifdef OS_IOS
+  temp_dir_ = util::GetTemporaryDirectory() + "/dirXXXXXX";
+#  else
+  temp_dir_ = "/tmp/dirXXXXXX";
+#  endif
+  if (!mkdtemp(&temp_dir_[0]))
+    PLOG(FATAL) << "Error creating temp directory";
+#else
+#  error "Not implemented for Windows"
+#endif
+}
+
+void TempDirTest::TearDown() {
+#ifdef OS_POSIX
+  // This traverses a directory tree and calls the given method.  FTW_DEPTH
+  // makes this a post-order traversal instead of a pre-order traversal.
+  if (nftw(temp_dir_.c_str(), DeleteItem, FOPEN_MAX, FTW_DEPTH))
+    PLOG(FATAL) << "Error traversing folder.";
+#else
+#  error "Not implemented for Windows"
+#endif
+}
+
+}  // namespace shaka
@@ -0,0 +1,43 @@
+// Copyright 2020 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     https://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef SHAKA_EMBEDDED_TEST_TEMP_DIR_TEST_H_
+#define SHAKA_EMBEDDED_TEST_TEMP_DIR_TEST_H_
+
+#include <gtest/gtest.h>
+
+#include <string>
+
+#include "src/util/file_system.h"
+
+namespace shaka {
+
+/**
+ * A test fixture that creates a new, empty temporary directory for each test.
+ * The directory and everything in it is deleted after the test.  Subclasses
+ * that override SetUp/TearDown need to call the versions here.
+ */
+class TempDirTest : public testing::Test {
+ public:
+  void SetUp() override;
+  void TearDown() override;
+
+ protected:
+  util::FileSystem fs_;
+  std::string temp_dir_;
+};
+
+}  // namespace shaka
+
+#endif  // SHAKA_EMBEDDED_TEST_TEMP_DIR_TEST_H_
@@ -0,0 +1,116 @@
+// Copyright 2020 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     https://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "src/util/aes_kernel.h"
+
+#include <gtest/gtest.h>
+
+#include <vector>
+
+namespace shaka {
+namespace util {
+
+namespace {
+
+// These use the AES-128 test vectors from NIST SP 800-38A.
+const std::vector<uint8_t> kKey = {0x2b, 0x7e, 0x15, 0x16, 0x28, 0xae,
+                                   0xd2, 0xa6, 0xab, 0xf7, 0x15, 0x88,
+                                   0x09, 0xcf, 0x4f, 0x3c};
+const std::vector<uint8_t> kPlaintext = {
+    0x6b, 0xc1, 0xbe, 0xe2, 0x2e, 0x40, 0x9f, 0x96, 0xe9, 0x3d, 0x7e,
+    0x11, 0x73, 0x93, 0x17, 0x2a, 0xae, 0x2d, 0x8a, 0x57, 0x1e, 0x03,
+    0xac, 0x9c, 0x9e, 0xb7, 0x6f, 0xac, 0x45, 0xaf, 0x8e, 0x51, 0x30,
+    0xc8, 0x1c, 0x46, 0xa3, 0x5c, 0xe4, 0x11, 0xe5, 0xfb, 0xc1, 0x19,
+    0x1a, 0x0a, 0x52, 0xef, 0xf6, 0x9f, 0x24, 0x45, 0xdf, 0x4f, 0x9b,
+    0x17, 0xad, 0x2b, 0x41, 0x7b, 0xe6, 0x6c, 0x37, 0x10};
+
+const std::vector<uint8_t> kCbcIv = {0x00, 0x01, 0x02, 0x03, 0x04, 0x05,
+                                     0x06, 0x07, 0x08, 0x09, 0x0a, 0x0b,
+                                     0x0c, 0x0d, 0x0e, 0x0f};
+const std::vector<uint8_t> kCbcCiphertext = {
+    0x76, 0x49, 0xab, 0xac, 0x81, 0x19, 0xb2, 0x46, 0xce, 0xe9, 0x8e,
+    0x9b, 0x12, 0xe9, 0x19, 0x7d, 0x50, 0x86, 0xcb, 0x9b, 0x50, 0x72,
+    0x19, 0xee, 0x95, 0xdb, 0x11, 0x3a, 0x91, 0x76, 0x78, 0xb2, 0x73,
+    0xbe, 0xd6, 0xb8, 0xe3, 0xc1, 0x74, 0x3b, 0x71, 0x16, 0xe6, 0x9e,
+    0x22, 0x22, 0x95, 0x16, 0x3f, 0xf1, 0xca, 0xa1, 0x68, 0x1f, 0xac,
+    0x09, 0x12, 0x0e, 0xca, 0x30, 0x75, 0x86, 0xe1, 0xa7};
+
+const std::vector<uint8_t> kCtrIv = {0xf0, 0xf1, 0xf2, 0xf3, 0xf4, 0xf5,
+                                     0xf6, 0xf7, 0xf8, 0xf9, 0xfa, 0xfb,
+                                     0xfc, 0xfd, 0xfe, 0xff};
+const std::vector<uint8_t> kCtrCiphertext = {
+    0x87, 0x4d, 0x61, 0x91, 0xb6, 0x20, 0xe3, 0x26, 0x1b, 0xef, 0x68,
+    0x64, 0x99, 0x0d, 0xb6, 0xce, 0x98, 0x06, 0xf6, 0x6b, 0x79, 0x70,
+    0xfd, 0xff, 0x86, 0x17, 0x18, 0x7b, 0xb9, 0xff, 0xfd, 0xff, 0x5a,
+    0xe4, 0xdf, 0x3e, 0xdb, 0xd5, 0xd3, 0x5e, 0x5b, 0x4f, 0x09, 0x02,
+    0x0d, 0xb0, 0x3e, 0xab, 0x1e, 0x03, 0x1d, 0xda, 0x2f, 0xbe, 0x03,
+    0xd1, 0x79, 0x21, 0x70, 0xa0, 0xf3, 0x00, 0x9c, 0xee};
+
+}  // namespace
+
+TEST(AesKernelTest, DecryptsCbc) {
+  auto kernel = AesKernel::Create(eme::EncryptionScheme::AesCbc, kKey);
+  if (!kernel) {
+    EXPECT_FALSE(AesKernel::IsSupported());
+    return;
+  }
+
+  std::vector<uint8_t> dest(kCbcCiphertext.size());
+  kernel->SetIv(kCbcIv.data());
+  ASSERT_TRUE(kernel->Decrypt(kCbcCiphertext.data(), kCbcCiphertext.size(),
+                              dest.data()));
+  EXPECT_EQ(kPlaintext, dest);
+
+  // The chaining continues between calls and works in place.
+  dest = kCbcCiphertext;
+  kernel->SetIv(kCbcIv.data());
+  ASSERT_TRUE(kernel->Decrypt(dest.data(), 16, dest.data()));
+  ASSERT_TRUE(kernel->Decrypt(dest.data() + 16, 48, dest.data() + 16));
+  EXPECT_EQ(kPlaintext, dest);
+
+  EXPECT_FALSE(kernel->Decrypt(kCbcCiphertext.data(), 10, dest.data()));
+}
+
+TEST(AesKernelTest, DecryptsCtr) {
+  auto kernel = AesKernel::Create(eme::EncryptionScheme::AesCtr, kKey);
+  if (!kernel) {
+    EXPECT_FALSE(AesKernel::IsSupported());
+    return;
+  }
+
+  std::vector<uint8_t> dest(kCtrCiphertext.size());
+  kernel->SetIv(kCtrIv.data());
+  ASSERT_TRUE(kernel->Decrypt(kCtrCiphertext.data(), kCtrCiphertext.size(),
+                              dest.data()));
+  EXPECT_EQ(kPlaintext, dest);
+
+  // Partial blocks continue the keystream in the next call.
+  dest.assign(dest.size(), 0);
+  kernel->SetIv(kCtrIv.data());
+  size_t offset = 0;
+  for (size_t size : {5, 20, 7, 32}) {
+    ASSERT_TRUE(kernel->Decrypt(kCtrCiphertext.data() + offset, size,
+                                dest.data() + offset));
+    offset += size;
+  }
+  EXPECT_EQ(kPlaintext, dest);
+}
+
+TEST(AesKernelTest, OnlySupports128BitKeys) {
+  EXPECT_FALSE(AesKernel::Create(eme::EncryptionScheme::AesCtr,
+                                 std::vector<uint8_t>(32, 1)));
+}
+
+}  // namespace util
+}  // namespace shaka
@@ -0,0 +1,42 @@
+// Copyright 2020 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     https://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+
+#include "src/util/atom_table.h"
+
+#include <gtest/gtest.h>
+
+namespace shaka {
+namespace util {
+
+TEST(AtomTableTest, InternsStrings) {
+  AtomTable table;
+  EXPECT_EQ(table.Intern("foo"), 0u);
+  EXPECT_EQ(table.Intern("bar"), 1u);
+  EXPECT_EQ(table.Intern("foo"), 0u);
+  EXPECT_EQ(table.Intern(""), 2u);
+}
+
+TEST(AtomTableTest, FindsWithoutAdding) {
+  AtomTable table;
+  EXPECT_EQ(table.FindAtom("foo"), AtomTable::kNoAtom);
+  EXPECT_EQ(table.Intern("bar"), 0u);
+  EXPECT_EQ(table.FindAtom("foo"), AtomTable::kNoAtom);
+  EXPECT_EQ(table.FindAtom("bar"), 0u);
+  EXPECT_EQ(table.Intern("foo"), 1u);
+  EXPECT_EQ(table.FindAtom("foo"), 1u);
+}
+
+}  // namespace util
+}  // namespace shaka
@@ -17,7 +17,9 @@
 #include <glog/logging.h>
 #include <gtest/gtest.h>
 #include <stdlib.h>
+#include <string.h>
 
+#include <string>
 #include <vector>
 
 namespace shaka {
@@ -128,5 +130,60 @@ TEST_F(DynamicBufferTest, BiggerThanBuffer) {
   EXPECT_EQ(expected, actual);
 }
 
+TEST_F(DynamicBufferTest, GetSlice) {
+  DynamicBuffer buf;
+  std::vector<uint8_t> temp = GetRandomBytes(GetMinBufferSize() - 100);
+  std::vector<uint8_t> extra = GetRandomBytes(500);
+  buf.AppendCopy(temp.data(), temp.size());
+  buf.AppendCopy(extra.data(), extra.size());
+
+  // Spans both sub-buffers.
+  const size_t offset = temp.size() - 50;
+  DynamicBuffer::Slice slice = buf.GetSlice(offset, 200);
+  ASSERT_EQ(200u, slice.size());
+
+  std::vector<uint8_t> expected(temp.begin() + offset, temp.end());
+  expected.insert(expected.end(), extra.begin(), extra.begin() + 150);
+  std::vector<uint8_t> actual(200);
+  EXPECT_EQ(200u, slice.Read(0, actual.data(), actual.size()));
+  EXPECT_EQ(expected, actual);
+
+  // Reads are clamped to the end of the slice.
+  EXPECT_EQ(20u, slice.Read(180, actual.data(), actual.size()));
+  EXPECT_EQ(0, memcmp(actual.data(), expected.data() + 180, 20));
+
+  // The range is clamped to the end of the buffer.
+  EXPECT_EQ(100u, buf.GetSlice(buf.Size() - 100, 1000).size());
+  EXPECT_EQ(0u, buf.GetSlice(buf.Size(), 10).size());
+}
+
+TEST_F(DynamicBufferTest, SliceOutlivesBuffer) {
+  DynamicBuffer::Slice slice;
+  {
+    DynamicBuffer buf;
+    buf.AppendCopy(kData1, kData1Size);
+    slice = buf.GetSlice(0, buf.Size());
+    buf.Clear();
+    buf.AppendCopy(kData2, kData2Size);
+  }
+
+  std::string actual(slice.size(), '\0');
+  slice.Read(0, reinterpret_cast<uint8_t*>(&actual[0]), actual.size());
+  EXPECT_EQ(std::string(kData1, kData1Size), actual);
+}
+
+TEST_F(DynamicBufferTest, AppendDoesntChangeSlice) {
+  DynamicBuffer buf;
+  buf.AppendCopy(kData1, kData1Size);
+  DynamicBuffer::Slice slice = buf.GetSlice(0, buf.Size());
+  buf.AppendCopy(kData2, kData2Size);
+
+  EXPECT_EQ(kData1Size, slice.size());
+  std::string actual(kData1Size, '\0');
+  EXPECT_EQ(kData1Size, slice.Read(0, reinterpret_cast<uint8_t*>(&actual[0]),
+                                   kData1Size + 10));
+  EXPECT_EQ(std::string(kData1, kData1Size), actual);
+}
+
 }  // namespace util
 }  // namespace shaka
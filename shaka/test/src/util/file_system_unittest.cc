@@ -14,51 +14,27 @@
 
 #include "src/util/file_system.h"
 
-#ifdef OS_POSIX
-#  include <ftw.h>
-#endif
 #include <glog/logging.h>
 #include <gmock/gmock.h>
 #include <gtest/gtest.h>
-#include <stdlib.h>
 
 #include <fstream>
+#include <utility>
 
-#include "src/util/darwin_utils.h"
+#include "src/test/temp_dir_test.h"
 
 namespace shaka {
 namespace util {
 
 using testing::UnorderedElementsAre;
 
-class FileSystemTest : public testing::Test {
+class FileSystemTest : public TempDirTest {
  public:
   void SetUp() override {
-#ifdef OS_POSIX
-#  ifdef OS_IOS
-    temp_dir = GetTemporaryDirectory() + "/dirXXXXXX";
-#  else
-    temp_dir = "/tmp/dirXXXXXX";
-#  endif
-    if (!mkdtemp(&temp_dir[0]))
-      PLOG(FATAL) << "Error creating temp directory";
-    existing_file = temp_dir + "/" + "existing";
-    non_exist = temp_dir + "/" + "non_existing";
+    TempDirTest::SetUp();
+    existing_file = temp_dir_ + "/" + "existing";
+    non_exist = temp_dir_ + "/" + "non_existing";
     Touch(existing_file);
-#else
-#  error "Not implemented for Windows"
-#endif
-  }
-
-  void TearDown() override {
-#ifdef OS_POSIX
-    // This traverses a directory tree and calls the given method.  FTW_DEPTH
-    // makes this a post-order traversal instead of a pre-order traversal.
-    if (nftw(temp_dir.c_str(), DeleteItem, FOPEN_MAX, FTW_DEPTH))
-      PLOG(FATAL) << "Error traversing folder.";
-#else
-#  error "Not implemented for Windows"
-#endif
   }
 
  protected:
@@ -68,105 +44,137 @@ class FileSystemTest : public testing::Test {
       PLOG(FATAL) << "Unable to touch file " << path;
   }
 
-#ifdef OS_POSIX
-  static int DeleteItem(const char* path, const struct stat* st, int flags,
-                        struct FTW*) {
-    const int status = flags == FTW_DP ? rmdir(path) : unlink(path);
-    if (status != 0) {
-      PLOG(FATAL) << "Error deleting file/directory " << path << " with status "
-                  << status;
-    }
-    return status;
-  }
-#endif
-
- protected:
-  FileSystem fs;
-  std::string temp_dir;
   std::string existing_file;
   std::string non_exist;
 };
 
 TEST_F(FileSystemTest, FileExists) {
-  EXPECT_TRUE(fs.FileExists(existing_file));
-  EXPECT_FALSE(fs.FileExists(temp_dir));
-  EXPECT_FALSE(fs.FileExists(non_exist));
+  EXPECT_TRUE(fs_.FileExists(existing_file));
+  EXPECT_FALSE(fs_.FileExists(temp_dir_));
+  EXPECT_FALSE(fs_.FileExists(non_exist));
 }
 
 TEST_F(FileSystemTest, DirectoryExists) {
-  EXPECT_TRUE(fs.DirectoryExists(temp_dir));
-  EXPECT_FALSE(fs.DirectoryExists(existing_file));
-  EXPECT_FALSE(fs.DirectoryExists(non_exist));
+  EXPECT_TRUE(fs_.DirectoryExists(temp_dir_));
+  EXPECT_FALSE(fs_.DirectoryExists(existing_file));
+  EXPECT_FALSE(fs_.DirectoryExists(non_exist));
 }
 
 TEST_F(FileSystemTest, ListFiles) {
   // Note that SetUp/TearDown is called for EACH test, so this gets its own
   // directory.
-  Touch(FileSystem::PathJoin(temp_dir, "other"));
+  Touch(FileSystem::PathJoin(temp_dir_, "other"));
 
   std::vector<std::string> files;
-  ASSERT_TRUE(fs.ListFiles(temp_dir, &files));
+  ASSERT_TRUE(fs_.ListFiles(temp_dir_, &files));
   ASSERT_THAT(files, UnorderedElementsAre("existing", "other"));
 }
 
 TEST_F(FileSystemTest, ReadAndWrite) {
-  const std::string path = FileSystem::PathJoin(temp_dir, "file");
+  const std::string path = FileSystem::PathJoin(temp_dir_, "file");
   Touch(path);
 
   std::vector<uint8_t> file_data;
-  ASSERT_TRUE(fs.ReadFile(path, &file_data));
+  ASSERT_TRUE(fs_.ReadFile(path, &file_data));
   EXPECT_TRUE(file_data.empty());
 
   const std::vector<uint8_t> expected_data = {0x01, 0x02, 0x03, 0x04};
-  ASSERT_TRUE(fs.WriteFile(path, expected_data));
+  ASSERT_TRUE(fs_.WriteFile(path, expected_data));
 
-  ASSERT_TRUE(fs.ReadFile(path, &file_data));
+  ASSERT_TRUE(fs_.ReadFile(path, &file_data));
   EXPECT_EQ(expected_data, file_data);
 
   // Writing to an existing file should erase old data.
-  ASSERT_TRUE(fs.WriteFile(path, expected_data));
-  ASSERT_TRUE(fs.ReadFile(path, &file_data));
+  ASSERT_TRUE(fs_.WriteFile(path, expected_data));
+  ASSERT_TRUE(fs_.ReadFile(path, &file_data));
+  EXPECT_EQ(expected_data, file_data);
+}
+
+TEST_F(FileSystemTest, MapFile) {
+  const std::string path = FileSystem::PathJoin(temp_dir_, "file");
+  const std::vector<uint8_t> expected_data = {0x01, 0x02, 0x03, 0x04};
+  ASSERT_TRUE(fs_.WriteFile(path, expected_data));
+
+  const uint8_t* data = nullptr;
+  size_t size = 0;
+  std::function<void()> unmap = fs_.MapFile(path, &data, &size);
+  ASSERT_TRUE(unmap);
+  ASSERT_EQ(expected_data.size(), size);
+  EXPECT_EQ(expected_data, std::vector<uint8_t>(data, data + size));
+
+  // Writing to the mapping shouldn't change the file.
+  const_cast<uint8_t*>(data)[0] = 0xff;
+  unmap();
+  std::vector<uint8_t> file_data;
+  ASSERT_TRUE(fs_.ReadFile(path, &file_data));
   EXPECT_EQ(expected_data, file_data);
+
+  EXPECT_FALSE(fs_.MapFile(non_exist, &data, &size));
+  EXPECT_FALSE(fs_.MapFile(existing_file, &data, &size));
+}
+
+TEST_F(FileSystemTest, MappedFile) {
+  const std::string path = FileSystem::PathJoin(temp_dir_, "file");
+  const std::vector<uint8_t> expected_data = {0x01, 0x02, 0x03, 0x04};
+  ASSERT_TRUE(fs_.WriteFile(path, expected_data));
+
+  MappedFile file;
+  EXPECT_FALSE(file.valid());
+  ASSERT_TRUE(fs_.MapFile(path, &file));
+  ASSERT_TRUE(file.valid());
+  EXPECT_EQ(expected_data,
+            std::vector<uint8_t>(file.data(), file.data() + file.size()));
+
+  MappedFile moved(std::move(file));
+  EXPECT_FALSE(file.valid());
+  ASSERT_TRUE(moved.valid());
+  EXPECT_EQ(expected_data.size(), moved.size());
+  moved.Reset();
+  EXPECT_FALSE(moved.valid());
+
+  EXPECT_FALSE(fs_.MapFile(non_exist, &file));
+  EXPECT_FALSE(fs_.MapFile(existing_file, &file));
+  EXPECT_FALSE(file.valid());
 }
 
 TEST_F(FileSystemTest, FileSize) {
-  const std::string path = FileSystem::PathJoin(temp_dir, "file");
+  const std::string path = FileSystem::PathJoin(temp_dir_, "file");
   Touch(path);
 
-  ASSERT_EQ(fs.FileSize(non_exist), -1);
-  ASSERT_TRUE(fs.FileExists(path));
-  ASSERT_EQ(fs.FileSize(path), 0);
+  ASSERT_EQ(fs_.FileSize(non_exist), -1);
+  ASSERT_TRUE(fs_.FileExists(path));
+  ASSERT_EQ(fs_.FileSize(path), 0);
 
   const std::vector<uint8_t> expected_data = {0x01, 0x02, 0x03, 0x04};
-  ASSERT_TRUE(fs.WriteFile(path, expected_data));
+  ASSERT_TRUE(fs_.WriteFile(path, expected_data));
 
-  ASSERT_EQ(fs.FileSize(path), expected_data.size());
+  ASSERT_EQ(fs_.FileSize(path), expected_data.size());
 }
 
 TEST_F(FileSystemTest, Delete) {
-  const std::string path = FileSystem::PathJoin(temp_dir, "file");
+  const std::string path = FileSystem::PathJoin(temp_dir_, "file");
   Touch(path);
 
-  ASSERT_TRUE(fs.FileExists(path));
-  ASSERT_TRUE(fs.DeleteFile(path));
-  ASSERT_FALSE(fs.FileExists(path));
-  ASSERT_FALSE(fs.DeleteFile(path));
+  ASSERT_TRUE(fs_.FileExists(path));
+  ASSERT_TRUE(fs_.DeleteFile(path));
+  ASSERT_FALSE(fs_.FileExists(path));
+  ASSERT_FALSE(fs_.DeleteFile(path));
 }
 
 TEST_F(FileSystemTest, CreateDirectory) {
-  const std::string first_path = FileSystem::PathJoin(temp_dir, "dir");
+  const std::string first_path = FileSystem::PathJoin(temp_dir_, "dir");
 
-  ASSERT_FALSE(fs.DirectoryExists(first_path));
-  ASSERT_TRUE(fs.CreateDirectory(first_path));
-  ASSERT_TRUE(fs.DirectoryExists(first_path));
+  ASSERT_FALSE(fs_.DirectoryExists(first_path));
+  ASSERT_TRUE(fs_.CreateDirectory(first_path));
+  ASSERT_TRUE(fs_.DirectoryExists(first_path));
 
-  const std::string second_path = FileSystem::PathJoin(temp_dir, "dir2");
+  const std::string second_path = FileSystem::PathJoin(temp_dir_, "dir2");
   const std::string nested_path = FileSystem::PathJoin(second_path, "nest");
-  ASSERT_FALSE(fs.DirectoryExists(second_path));
-  ASSERT_FALSE(fs.DirectoryExists(nested_path));
-  ASSERT_TRUE(fs.CreateDirectory(nested_path));
-  ASSERT_TRUE(fs.DirectoryExists(second_path));
-  ASSERT_TRUE(fs.DirectoryExists(nested_path));
+  ASSERT_FALSE(fs_.DirectoryExists(second_path));
+  ASSERT_FALSE(fs_.DirectoryExists(nested_path));
+  ASSERT_TRUE(fs_.CreateDirectory(nested_path));
+  ASSERT_TRUE(fs_.DirectoryExists(second_path));
+  ASSERT_TRUE(fs_.DirectoryExists(nested_path));
 }
 
 TEST_F(FileSystemTest, PathJoin) {
@@ -0,0 +1,81 @@
+// Copyright 2020 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     https://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "src/util/manifest_origins.h"
+
+#include <gtest/gtest.h>
+
+#include <string>
+#include <vector>
+
+namespace shaka {
+namespace util {
+
+namespace {
+
+constexpr const char kManifestUrl[] = "https://example.com/path/manifest.mpd";
+
+}  // namespace
+
+TEST(ManifestOriginsTest, FindsDashUrls) {
+  const std::string manifest = R"(<?xml version="1.0"?>
+<MPD xmlns="urn:mpeg:dash:schema:mpd:2011"
+     xmlns:xsi="http://www.w3.org/2001/XMLSchema-instance">
+  <BaseURL serviceLocation="a">https://CDN1.example.com/base/</BaseURL>
+  <BaseURL>https://cdn2.example.com:8443/base/</BaseURL>
+  <BaseURL>relative/</BaseURL>
+  <Period>
+    <AdaptationSet>
+      <SegmentTemplate media="http://cdn3.example.com/$Number$.mp4"
+                       initialization="https://cdn1.example.com/init.mp4" />
+      <Representation>
+        <BaseURL>https://example.com/same/</BaseURL>
+      </Representation>
+    </AdaptationSet>
+  </Period>
+</MPD>)";
+  EXPECT_EQ(FindManifestOrigins(manifest, kManifestUrl, 10),
+            (std::vector<std::string>{"https://cdn1.example.com/",
+                                      "https://cdn2.example.com:8443/",
+                                      "http://cdn3.example.com/"}));
+}
+
+TEST(ManifestOriginsTest, FindsHlsUrls) {
+  const std::string manifest =
+      "#EXTM3U\r\n"
+      "#EXT-X-MEDIA:TYPE=AUDIO,GROUP-ID=\"a\","
+      "URI=\"https://audio.example.com/a.m3u8\"\r\n"
+      "#EXT-X-STREAM-INF:BANDWIDTH=1000\r\n"
+      "https://user@video.example.com/v.m3u8\r\n"
+      "#EXT-X-STREAM-INF:BANDWIDTH=2000\r\n"
+      "video/v2.m3u8\r\n"
+      "ftp://other.example.com/v3.m3u8\r\n";
+  EXPECT_EQ(FindManifestOrigins(manifest, kManifestUrl, 10),
+            (std::vector<std::string>{"https://audio.example.com/",
+                                      "https://video.example.com/"}));
+}
+
+TEST(ManifestOriginsTest, LimitsCount) {
+  const std::string manifest =
+      "<MPD><BaseURL>https://a.example.com/</BaseURL>"
+      "<BaseURL>https://b.example.com/</BaseURL>"
+      "<BaseURL>https://c.example.com/</BaseURL></MPD>";
+  EXPECT_EQ(FindManifestOrigins(manifest, kManifestUrl, 2),
+            (std::vector<std::string>{"https://a.example.com/",
+                                      "https://b.example.com/"}));
+  EXPECT_TRUE(FindManifestOrigins("<MPD></MPD>", kManifestUrl, 2).empty());
+}
+
+}  // namespace util
+}  // namespace shaka
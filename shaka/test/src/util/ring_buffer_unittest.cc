@@ -0,0 +1,147 @@
+// Copyright 2020 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     https://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "src/util/ring_buffer.h"
+
+#include <gtest/gtest.h>
+
+#include <algorithm>
+#include <thread>
+#include <vector>
+
+namespace shaka {
+namespace util {
+
+namespace {
+
+const uint8_t kData[] = {1, 2, 3, 4, 5, 6, 7, 8, 9, 10};
+
+}  // namespace
+
+TEST(RingBufferTest, RoundsCapacityToPowerOfTwo) {
+  RingBuffer buffer;
+  EXPECT_EQ(0u, buffer.Capacity());
+
+  buffer.Reset(5);
+  EXPECT_EQ(8u, buffer.Capacity());
+  buffer.Reset(16);
+  EXPECT_EQ(16u, buffer.Capacity());
+  buffer.Reset(17);
+  EXPECT_EQ(32u, buffer.Capacity());
+}
+
+TEST(RingBufferTest, ReadsAndWrites) {
+  RingBuffer buffer;
+  buffer.Reset(16);
+
+  ASSERT_EQ(4u, buffer.Write(kData, 4));
+  ASSERT_EQ(6u, buffer.Write(kData + 4, 6));
+  EXPECT_EQ(10u, buffer.Size());
+
+  uint8_t out[10] = {0};
+  ASSERT_EQ(3u, buffer.Read(out, 3));
+  EXPECT_EQ(7u, buffer.Size());
+  ASSERT_EQ(7u, buffer.Read(out + 3, 10));
+  EXPECT_EQ(0u, buffer.Size());
+  EXPECT_EQ(std::vector<uint8_t>(kData, kData + 10),
+            std::vector<uint8_t>(out, out + 10));
+
+  EXPECT_EQ(0u, buffer.Read(out, 10));
+}
+
+TEST(RingBufferTest, StopsWhenFull) {
+  RingBuffer buffer;
+  buffer.Reset(8);
+
+  EXPECT_EQ(8u, buffer.Write(kData, 10));
+  EXPECT_EQ(8u, buffer.Size());
+  EXPECT_EQ(0u, buffer.Write(kData, 1));
+
+  uint8_t out[8] = {0};
+  ASSERT_EQ(8u, buffer.Read(out, 8));
+  EXPECT_EQ(std::vector<uint8_t>(kData, kData + 8),
+            std::vector<uint8_t>(out, out + 8));
+}
+
+TEST(RingBufferTest, WrapsAround) {
+  RingBuffer buffer;
+  buffer.Reset(8);
+
+  uint8_t out[10] = {0};
+  ASSERT_EQ(6u, buffer.Write(kData, 6));
+  ASSERT_EQ(6u, buffer.Read(out, 6));
+
+  // This write spans the end of the storage.
+  ASSERT_EQ(7u, buffer.Write(kData, 7));
+  EXPECT_EQ(7u, buffer.Size());
+  ASSERT_EQ(7u, buffer.Read(out, 10));
+  EXPECT_EQ(std::vector<uint8_t>(kData, kData + 7),
+            std::vector<uint8_t>(out, out + 7));
+}
+
+TEST(RingBufferTest, Clear) {
+  RingBuffer buffer;
+  buffer.Reset(8);
+
+  ASSERT_EQ(5u, buffer.Write(kData, 5));
+  buffer.Clear();
+  EXPECT_EQ(0u, buffer.Size());
+  EXPECT_EQ(8u, buffer.Capacity());
+
+  uint8_t out[8] = {0};
+  EXPECT_EQ(0u, buffer.Read(out, 8));
+  ASSERT_EQ(8u, buffer.Write(kData, 8));
+}
+
+TEST(RingBufferTest, ProducerAndConsumerThreads) {
+  constexpr const size_t kTotalSize = 1024 * 1024;
+  RingBuffer buffer;
+  buffer.Reset(1000);
+
+  std::thread producer([&]() {
+    uint8_t chunk[333];
+    size_t written = 0;
+    while (written < kTotalSize) {
+      const size_t size = std::min(sizeof(chunk), kTotalSize - written);
+      for (size_t i = 0; i < size; i++)
+        chunk[i] = static_cast<uint8_t>(written + i);
+      size_t offset = 0;
+      while (offset < size) {
+        offset += buffer.Write(chunk + offset, size - offset);
+        if (offset < size)
+          std::this_thread::yield();
+      }
+      written += size;
+    }
+  });
+
+  uint8_t chunk[257];
+  size_t read = 0;
+  bool matched = true;
+  while (read < kTotalSize) {
+    const size_t size = buffer.Read(chunk, sizeof(chunk));
+    for (size_t i = 0; i < size; i++)
+      matched &= chunk[i] == static_cast<uint8_t>(read + i);
+    read += size;
+    if (size == 0)
+      std::this_thread::yield();
+  }
+  producer.join();
+
+  EXPECT_TRUE(matched);
+  EXPECT_EQ(0u, buffer.Size());
+}
+
+}  // namespace util
+}  // namespace shaka
@@ -0,0 +1,79 @@
+// Copyright 2020 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     https://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "src/util/seqlock.h"
+
+#include <gtest/gtest.h>
+
+#include <atomic>
+#include <thread>
+#include <vector>
+
+namespace shaka {
+namespace util {
+
+namespace {
+
+struct Value {
+  uint64_t first;
+  double second;
+  uint32_t third;
+};
+
+}  // namespace
+
+TEST(SeqLockTest, StoresValues) {
+  SeqLock<Value> lock({1, 2.5, 3});
+  Value value = lock.Load();
+  EXPECT_EQ(1u, value.first);
+  EXPECT_EQ(2.5, value.second);
+  EXPECT_EQ(3u, value.third);
+
+  lock.Store({4, 5.5, 6});
+  value = lock.Load();
+  EXPECT_EQ(4u, value.first);
+  EXPECT_EQ(5.5, value.second);
+  EXPECT_EQ(6u, value.third);
+}
+
+TEST(SeqLockTest, ReadersSeeConsistentValues) {
+  constexpr const uint64_t kWriteCount = 100000;
+  SeqLock<Value> lock({0, 0, 0});
+  std::atomic<bool> done{false};
+  std::atomic<uint64_t> torn_reads{0};
+
+  std::vector<std::thread> readers;
+  for (int i = 0; i < 3; i++) {
+    readers.emplace_back([&]() {
+      while (!done) {
+        const Value value = lock.Load();
+        if (value.second != value.first * 2 ||
+            value.third != static_cast<uint32_t>(value.first))
+          torn_reads++;
+      }
+    });
+  }
+
+  for (uint64_t i = 1; i <= kWriteCount; i++)
+    lock.Store({i, i * 2.0, static_cast<uint32_t>(i)});
+  done = true;
+  for (std::thread& reader : readers)
+    reader.join();
+
+  EXPECT_EQ(0u, torn_reads);
+  EXPECT_EQ(kWriteCount, lock.Load().first);
+}
+
+}  // namespace util
+}  // namespace shaka
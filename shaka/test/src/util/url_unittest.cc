@@ -0,0 +1,174 @@
+// Copyright 2020 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     https://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "src/util/url.h"
+
+#include <gtest/gtest.h>
+
+namespace shaka {
+namespace util {
+
+namespace {
+
+constexpr const char kBase[] = "http://a/b/c/d;p?q";
+
+std::string Resolve(const std::string& relative) {
+  std::string ret;
+  EXPECT_TRUE(ResolveUrl(kBase, relative, &ret)) << relative;
+  return ret;
+}
+
+}  // namespace
+
+TEST(UrlTest, ParsesComponents) {
+  Url url;
+  ASSERT_TRUE(Url::Parse("https://user@example.com:8080/a/b?x=1#frag", &url));
+  EXPECT_TRUE(url.is_absolute());
+  EXPECT_TRUE(url.has_authority());
+  EXPECT_TRUE(url.has_query());
+  EXPECT_TRUE(url.has_fragment());
+  EXPECT_EQ("https", url.scheme());
+  EXPECT_EQ("user@example.com:8080", url.authority());
+  EXPECT_EQ("example.com", url.host());
+  EXPECT_EQ("8080", url.port());
+  EXPECT_EQ("/a/b", url.path());
+  EXPECT_EQ("x=1", url.query());
+  EXPECT_EQ("frag", url.fragment());
+
+  ASSERT_TRUE(Url::Parse("http://[::1]/", &url));
+  EXPECT_EQ("[::1]", url.host());
+  EXPECT_EQ("", url.port());
+
+  ASSERT_TRUE(Url::Parse("../foo?#", &url));
+  EXPECT_FALSE(url.is_absolute());
+  EXPECT_FALSE(url.has_authority());
+  EXPECT_TRUE(url.has_query());
+  EXPECT_TRUE(url.has_fragment());
+  EXPECT_EQ("../foo", url.path());
+  EXPECT_EQ("", url.query());
+  EXPECT_EQ("", url.fragment());
+
+  ASSERT_TRUE(Url::Parse("data:text/plain,abc", &url));
+  EXPECT_EQ("data", url.scheme());
+  EXPECT_FALSE(url.has_authority());
+  EXPECT_EQ("text/plain,abc", url.path());
+
+  // A colon after a slash isn't a scheme.
+  ASSERT_TRUE(Url::Parse("a/b:c", &url));
+  EXPECT_FALSE(url.is_absolute());
+  EXPECT_EQ("a/b:c", url.path());
+}
+
+TEST(UrlTest, RejectsInvalidUrls) {
+  Url url;
+  EXPECT_FALSE(Url::Parse("1http://foo", &url));
+  EXPECT_FALSE(Url::Parse("ht_tp://foo", &url));
+  EXPECT_FALSE(Url::Parse("http://foo/\nbar", &url));
+  EXPECT_FALSE(Url::Parse(std::string("http://foo/\0", 12), &url));
+
+  std::string ret;
+  EXPECT_FALSE(ResolveUrl("foo/bar", "baz", &ret));
+  EXPECT_FALSE(ResolveUrl("http://foo/", "1a:b", &ret));
+}
+
+TEST(UrlTest, ResolvesNormalExamples) {
+  // RFC 3986 section 5.4.1.
+  EXPECT_EQ("g:h", Resolve("g:h"));
+  EXPECT_EQ("http://a/b/c/g", Resolve("g"));
+  EXPECT_EQ("http://a/b/c/g", Resolve("./g"));
+  EXPECT_EQ("http://a/b/c/g/", Resolve("g/"));
+  EXPECT_EQ("http://a/g", Resolve("/g"));
+  EXPECT_EQ("http://g", Resolve("//g"));
+  EXPECT_EQ("http://a/b/c/d;p?y", Resolve("?y"));
+  EXPECT_EQ("http://a/b/c/g?y", Resolve("g?y"));
+  EXPECT_EQ("http://a/b/c/d;p?q#s", Resolve("#s"));
+  EXPECT_EQ("http://a/b/c/g#s", Resolve("g#s"));
+  EXPECT_EQ("http://a/b/c/g?y#s", Resolve("g?y#s"));
+  EXPECT_EQ("http://a/b/c/;x", Resolve(";x"));
+  EXPECT_EQ("http://a/b/c/g;x", Resolve("g;x"));
+  EXPECT_EQ("http://a/b/c/g;x?y#s", Resolve("g;x?y#s"));
+  EXPECT_EQ("http://a/b/c/d;p?q", Resolve(""));
+  EXPECT_EQ("http://a/b/c/", Resolve("."));
+  EXPECT_EQ("http://a/b/c/", Resolve("./"));
+  EXPECT_EQ("http://a/b/", Resolve(".."));
+  EXPECT_EQ("http://a/b/", Resolve("../"));
+  EXPECT_EQ("http://a/b/g", Resolve("../g"));
+  EXPECT_EQ("http://a/", Resolve("../.."));
+  EXPECT_EQ("http://a/", Resolve("../../"));
+  EXPECT_EQ("http://a/g", Resolve("../../g"));
+}
+
+TEST(UrlTest, ResolvesAbnormalExamples) {
+  // RFC 3986 section 5.4.2.
+  EXPECT_EQ("http://a/g", Resolve("../../../g"));
+  EXPECT_EQ("http://a/g", Resolve("../../../../g"));
+  EXPECT_EQ("http://a/g", Resolve("/./g"));
+  EXPECT_EQ("http://a/g", Resolve("/../g"));
+  EXPECT_EQ("http://a/b/c/g.", Resolve("g."));
+  EXPECT_EQ("http://a/b/c/.g", Resolve(".g"));
+  EXPECT_EQ("http://a/b/c/g..", Resolve("g.."));
+  EXPECT_EQ("http://a/b/c/..g", Resolve("..g"));
+  EXPECT_EQ("http://a/b/g", Resolve("./../g"));
+  EXPECT_EQ("http://a/b/c/g/", Resolve("./g/."));
+  EXPECT_EQ("http://a/b/c/g/h", Resolve("g/./h"));
+  EXPECT_EQ("http://a/b/c/h", Resolve("g/../h"));
+  EXPECT_EQ("http://a/b/c/g;x=1/y", Resolve("g;x=1/./y"));
+  EXPECT_EQ("http://a/b/c/y", Resolve("g;x=1/../y"));
+  EXPECT_EQ("http://a/b/c/g?y/./x", Resolve("g?y/./x"));
+  EXPECT_EQ("http://a/b/c/g?y/../x", Resolve("g?y/../x"));
+  EXPECT_EQ("http://a/b/c/g#s/./x", Resolve("g#s/./x"));
+  EXPECT_EQ("http://a/b/c/g#s/../x", Resolve("g#s/../x"));
+  EXPECT_EQ("http:g", Resolve("http:g"));
+}
+
+TEST(UrlTest, ResolvesAgainstEmptyPath) {
+  std::string ret;
+  ASSERT_TRUE(ResolveUrl("http://example.com", "foo", &ret));
+  EXPECT_EQ("http://example.com/foo", ret);
+  ASSERT_TRUE(ResolveUrl("http://example.com?q", "#f", &ret));
+  EXPECT_EQ("http://example.com?q#f", ret);
+}
+
+TEST(UrlTest, ConvertsFilePaths) {
+  EXPECT_EQ("file:///data/app/", FilePathToUrl("/data/app/"));
+  EXPECT_EQ("file:///my%20dir/a%23b%3Fc%25", FilePathToUrl("/my dir/a#b?c%"));
+  EXPECT_EQ("file:///C:/data", FilePathToUrl("C:/data"));
+
+  // Relative URLs in JavaScript are resolved against the static data dir.
+  std::string ret;
+  ASSERT_TRUE(ResolveUrl(FilePathToUrl("/my dir/"), "a/../b.mpd", &ret));
+  EXPECT_EQ("file:///my%20dir/b.mpd", ret);
+  ASSERT_TRUE(ResolveUrl(FilePathToUrl("/my dir/"), "https://cdn/m", &ret));
+  EXPECT_EQ("https://cdn/m", ret);
+}
+
+TEST(UrlTest, CachedResultsMatch) {
+  std::string first;
+  std::string second;
+  ASSERT_TRUE(ResolveUrl("https://cdn/v/", "seg-1.mp4", &first));
+  ASSERT_TRUE(ResolveUrl("https://cdn/v/", "seg-1.mp4", &second));
+  EXPECT_EQ("https://cdn/v/seg-1.mp4", first);
+  EXPECT_EQ(first, second);
+
+  // Fill the cache so the first entry is evicted.
+  for (int i = 0; i < 1000; i++) {
+    ASSERT_TRUE(
+        ResolveUrl("https://cdn/v/", "seg" + std::to_string(i), &second));
+  }
+  ASSERT_TRUE(ResolveUrl("https://cdn/v/", "seg-1.mp4", &second));
+  EXPECT_EQ(first, second);
+}
+
+}  // namespace util
+}  // namespace shaka
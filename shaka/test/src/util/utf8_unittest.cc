@@ -0,0 +1,80 @@
+// Copyright 2020 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     https://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "src/util/utf8.h"
+
+#include <gtest/gtest.h>
+
+#include <string>
+
+namespace shaka {
+namespace util {
+
+namespace {
+
+bool IsValid(const std::string& str) {
+  return IsValidUtf8(reinterpret_cast<const uint8_t*>(str.data()), str.size());
+}
+
+size_t AsciiPrefix(const std::string& str) {
+  return AsciiPrefixLength(reinterpret_cast<const uint8_t*>(str.data()),
+                           str.size());
+}
+
+}  // namespace
+
+TEST(Utf8Test, AsciiPrefixLength) {
+  EXPECT_EQ(AsciiPrefix(""), 0u);
+  EXPECT_EQ(AsciiPrefix("abc"), 3u);
+  EXPECT_EQ(AsciiPrefix("ab\xc3\xa9"), 2u);
+
+  // Check every position around the vector sizes.
+  for (size_t size = 1; size < 40; size++) {
+    for (size_t pos = 0; pos < size; pos++) {
+      std::string str(size, 'a');
+      str[pos] = '\x80';
+      EXPECT_EQ(AsciiPrefix(str), pos) << "size=" << size << " pos=" << pos;
+    }
+    EXPECT_EQ(AsciiPrefix(std::string(size, '\x7f')), size);
+  }
+}
+
+TEST(Utf8Test, AcceptsValid) {
+  EXPECT_TRUE(IsValid(""));
+  EXPECT_TRUE(IsValid("Foobar"));
+  EXPECT_TRUE(IsValid("F\xe2\x82\xac \xf0\x90\x8d\x88"));
+  EXPECT_TRUE(IsValid("\xc2\x80"));          // U+0080
+  EXPECT_TRUE(IsValid("\xe0\xa0\x80"));      // U+0800
+  EXPECT_TRUE(IsValid("\xed\x9f\xbf"));      // U+D7FF
+  EXPECT_TRUE(IsValid("\xef\xbf\xbf"));      // U+FFFF
+  EXPECT_TRUE(IsValid("\xf4\x8f\xbf\xbf"));  // U+10FFFF
+  EXPECT_TRUE(IsValid(std::string(100, 'a') + "\xc3\xa9" +
+                      std::string(100, 'b')));
+}
+
+TEST(Utf8Test, RejectsInvalid) {
+  EXPECT_FALSE(IsValid("\x80"));              // Lone continuation.
+  EXPECT_FALSE(IsValid("\xc0\xaf"));          // Overlong.
+  EXPECT_FALSE(IsValid("\xe0\x9f\xbf"));      // Overlong.
+  EXPECT_FALSE(IsValid("\xf0\x8f\xbf\xbf"));  // Overlong.
+  EXPECT_FALSE(IsValid("\xed\xa0\x80"));      // Surrogate.
+  EXPECT_FALSE(IsValid("\xf4\x90\x80\x80"));  // Above U+10FFFF.
+  EXPECT_FALSE(IsValid("\xf5\x80\x80\x80"));
+  EXPECT_FALSE(IsValid("\xe2\x82"));          // Truncated.
+  EXPECT_FALSE(IsValid("\xe2\x82z"));
+  EXPECT_FALSE(IsValid(std::string(100, 'a') + "\xff"));
+}
+
+}  // namespace util
+}  // namespace shaka
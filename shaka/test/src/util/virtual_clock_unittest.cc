@@ -0,0 +1,146 @@
+// Copyright 2020 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     https://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "src/util/virtual_clock.h"
+
+#include <gtest/gtest.h>
+
+#include <atomic>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+
+#include "test/src/test/test_utils.h"
+
+namespace shaka {
+namespace util {
+
+namespace {
+
+constexpr const uint64_t kStartTime = 1000;
+
+/** Waits until the given number of threads are waiting on the clock. */
+void WaitForWaiters(const VirtualClock& clock, size_t count) {
+  ASSERT_TRUE(
+      WaitUntilOrTimeout([&]() { return clock.WaiterCount() == count; }));
+}
+
+}  // namespace
+
+TEST(VirtualClockTest, OnlyMovesWhenAdvanced) {
+  VirtualClock clock(kStartTime);
+  EXPECT_EQ(kStartTime, clock.GetMonotonicTime());
+  EXPECT_EQ(kStartTime, clock.GetEpochTime());
+  // Nothing is waiting, so there is no deadline to move to.
+  EXPECT_FALSE(clock.AdvanceToNextDeadline());
+
+  clock.AdvanceTime(250);
+  EXPECT_EQ(kStartTime + 250, clock.GetMonotonicTime());
+  EXPECT_EQ(kStartTime + 250, clock.GetEpochTime());
+}
+
+TEST(VirtualClockTest, SleepsUntilDeadline) {
+  VirtualClock clock(kStartTime);
+  std::atomic<bool> done{false};
+  std::thread thread([&]() {
+    clock.SleepSeconds(5);
+    done = true;
+  });
+
+  WaitForWaiters(clock, 1);
+  clock.AdvanceTime(4999);
+  clock.SleepSeconds(0);  // Doesn't block.
+  EXPECT_FALSE(done);
+
+  clock.AdvanceTime(1);
+  thread.join();
+  EXPECT_TRUE(done);
+  EXPECT_EQ(kStartTime + 5000, clock.GetMonotonicTime());
+}
+
+TEST(VirtualClockTest, WaitForSignal) {
+  VirtualClock clock(kStartTime);
+  std::mutex mutex;
+  std::condition_variable cond;
+  bool signaled = false;
+
+  // The wait ends when the deadline is reached.
+  std::thread thread([&]() {
+    std::unique_lock<std::mutex> lock(mutex);
+    clock.WaitForSignal(&cond, &lock, 2);
+    EXPECT_TRUE(lock.owns_lock());
+  });
+  WaitForWaiters(clock, 1);
+  ASSERT_TRUE(clock.AdvanceToNextDeadline());
+  thread.join();
+  EXPECT_EQ(kStartTime + 2000, clock.GetMonotonicTime());
+  EXPECT_EQ(0u, clock.WaiterCount());
+
+  // The wait also ends when signaled, without moving the time.
+  thread = std::thread([&]() {
+    std::unique_lock<std::mutex> lock(mutex);
+    while (!signaled)
+      clock.WaitForSignal(&cond, &lock, 10);
+  });
+  WaitForWaiters(clock, 1);
+  {
+    std::unique_lock<std::mutex> lock(mutex);
+    signaled = true;
+    cond.notify_all();
+  }
+  thread.join();
+  EXPECT_EQ(kStartTime + 2000, clock.GetMonotonicTime());
+  EXPECT_EQ(0u, clock.WaiterCount());
+}
+
+TEST(VirtualClockTest, AutoAdvancesFasterThanRealTime) {
+  VirtualClock clock(kStartTime);
+
+  // Two threads that wake at different rates; this is 100 hours of time.
+  constexpr const uint64_t kHour = 60 * 60 * 1000;
+  std::thread fast([&]() {
+    for (int i = 0; i < 200; i++)
+      clock.SleepSeconds(30 * 60);
+  });
+  std::thread slow([&]() {
+    for (int i = 0; i < 100; i++)
+      clock.SleepSeconds(60 * 60);
+  });
+  // Start once both threads are waiting so they start at the same time.
+  WaitForWaiters(clock, 2);
+  clock.StartAutoAdvance();
+  fast.join();
+  slow.join();
+  clock.StopAutoAdvance();
+
+  EXPECT_EQ(kStartTime + 100 * kHour, clock.GetMonotonicTime());
+}
+
+TEST(VirtualClockTest, OverridesClockInstance) {
+  VirtualClock clock(kStartTime);
+  Clock::SetInstanceOverride(&clock);
+  EXPECT_EQ(kStartTime, Clock::Instance.GetMonotonicTime());
+  clock.AdvanceTime(10);
+  EXPECT_EQ(kStartTime + 10, Clock::Instance.GetEpochTime());
+
+  // Other clocks aren't affected.
+  Clock other;
+  EXPECT_NE(kStartTime + 10, other.GetMonotonicTime());
+
+  Clock::SetInstanceOverride(nullptr);
+  EXPECT_NE(kStartTime + 10, Clock::Instance.GetMonotonicTime());
+}
+
+}  // namespace util
+}  // namespace shaka
@@ -105,6 +105,33 @@ describe('events', function() {
     expect(extra_listener).not.toHaveBeenCalled();
   });
 
+  it('dispatches to listeners in insert order', function() {
+    var calls = [];
+    event_target.addEventListener('extra_event', function() {
+      calls.push(1);
+    });
+    event_target.addEventListener('other_event', function() {
+      calls.push(0);
+    });
+    event_target.addEventListener('extra_event', function() {
+      calls.push(2);
+    });
+
+    event_target.dispatchEvent(new Event('extra_event'));
+
+    expect(calls).toEqual([1, 2]);
+  });
+
+  it('removes listeners outside of dispatch', function() {
+    event_target.removeEventListener('error', add_listener);
+    event_target.removeEventListener('never_added', add_listener);
+
+    event_target.dispatchEvent(new Event('error'));
+
+    expect(on_listener).toHaveBeenCalled();
+    expect(add_listener).not.toHaveBeenCalled();
+  });
+
   describe('stopImmediatePropagation', function() {
     it('stops remaining listeners', function() {
       add_listener.and.callFake(function(evt) {
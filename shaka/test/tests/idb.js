@@ -553,6 +553,39 @@ testGroup('IndexedDB', () => {
         expectEq(values, [key1, key3, null]);
       });
 
+      test('SeesChangesWhileIterating', async () => {
+        const trans = db.transaction(storeName, 'readwrite');
+        const store = trans.objectStore(storeName);
+
+        // Add enough entries that the cursor has to query more than once.
+        for (let i = 0; i < 40; i++) {
+          store.put({data: 'd'});
+        }
+
+        const data = [];
+        const req = store.openCursor();
+        req.onerror = fail;
+        req.onsuccess = () => {
+          const cursor = req.result;
+          if (!cursor) {
+            return;
+          }
+
+          data.push(cursor.value.data);
+          if (cursor.key == key1) {
+            store.delete(key2);
+            store.put({data: 'e'}, key3);
+          }
+          cursor.continue();
+        };
+
+        await promisify(trans);
+        expectEq(data.length, 42);
+        expectEq(data[0], 'a');
+        expectEq(data[1], 'e');
+        expectEq(data[41], 'd');
+      });
+
       test('DeleteWhenReadOnly', async () => {
         const trans = db.transaction(storeName);
         const store = trans.objectStore(storeName);
@@ -592,6 +625,68 @@ testGroup('IndexedDB', () => {
         };
       }
     });
+
+    testGroup('GetAll', () => {
+      let keys;
+
+      beforeEach(async () => {
+        const trans = db.transaction(storeName, 'readwrite');
+        const store = trans.objectStore(storeName);
+        keys = await Promise.all([
+          promisify(store.add({data: 'a'})),
+          promisify(store.add({data: 'b'})),
+          promisify(store.add({data: 'c'})),
+        ]);
+      });
+
+      test('GetsAllValues', async () => {
+        const store = db.transaction(storeName).objectStore(storeName);
+        const results = await Promise.all([
+          promisify(store.getAll()),
+          promisify(store.getAll(null, 2)),
+          promisify(store.getAll(keys[1])),
+        ]);
+        expectEq(results[0], [{data: 'a'}, {data: 'b'}, {data: 'c'}]);
+        expectEq(results[1], [{data: 'a'}, {data: 'b'}]);
+        expectEq(results[2], [{data: 'b'}]);
+      });
+
+      test('GetsAllKeys', async () => {
+        const store = db.transaction(storeName).objectStore(storeName);
+        const range = IDBKeyRange.lowerBound(keys[0], true);
+        const results = await Promise.all([
+          promisify(store.getAllKeys()),
+          promisify(store.getAllKeys(range)),
+        ]);
+        expectEq(results[0], keys);
+        expectEq(results[1], keys.slice(1));
+      });
+
+      test('Counts', async () => {
+        const store = db.transaction(storeName).objectStore(storeName);
+        const range = IDBKeyRange.bound(keys[0], keys[1], false, true);
+        const results = await Promise.all([
+          promisify(store.count()),
+          promisify(store.count(keys[0])),
+          promisify(store.count(range)),
+        ]);
+        expectEq(results, [3, 1, 1]);
+      });
+
+      test('KeyRanges', () => {
+        const range = IDBKeyRange.bound(2, 5, true, false);
+        expectEq(range.lower, 2);
+        expectEq(range.upper, 5);
+        expectEq(range.lowerOpen, true);
+        expectEq(range.upperOpen, false);
+        expectEq(range.includes(2), false);
+        expectEq(range.includes(5), true);
+        expectEq(IDBKeyRange.only(3).includes(3), true);
+        expectEq(IDBKeyRange.upperBound(3).includes(-10), true);
+        expectToThrow(() => IDBKeyRange.bound(5, 2), 'DataError');
+        expectToThrow(() => IDBKeyRange.bound(2, 2, true), 'DataError');
+      });
+    });
   });
 
   testGroup('Transactions', () => {
@@ -661,6 +756,42 @@ testGroup('IndexedDB', () => {
       await Promise.all([promisify(trans1), promisify(trans2)]);
     });
 
+    test('CommitsQueuedTransactionsInOrder', async () => {
+      const count = 10;
+      const events = [];
+      const keys = [];
+      const waiting = [];
+      for (let i = 0; i < count; i++) {
+        const trans = db.transaction(storeName, 'readwrite');
+        const add = trans.objectStore(storeName).add({index: i});
+        add.onsuccess = () => {
+          keys.push(add.result);
+          events.push('success' + i);
+        };
+        trans.oncomplete = () => events.push('complete' + i);
+        waiting.push(new Promise((resolve, reject) => {
+          trans.addEventListener('complete', resolve);
+          trans.addEventListener('error', reject);
+        }));
+      }
+      await Promise.all(waiting);
+
+      const expected = [];
+      for (let i = 0; i < count; i++) {
+        expected.push('success' + i, 'complete' + i);
+      }
+      expectEq(events, expected);
+
+      const trans = db.transaction(storeName);
+      const store = trans.objectStore(storeName);
+      const values =
+          await Promise.all(keys.map((key) => promisify(store.get(key))));
+      for (let i = 0; i < count; i++) {
+        expectEq(values[i], {index: i});
+      }
+      await promisify(trans);
+    });
+
     test('OnlyIncludesTheGivenObjectStores', () => {
       const trans = db.transaction(storeName);
       expectToThrow(() => trans.objectStore(storeName2), 'NotFoundError');
@@ -465,6 +465,18 @@ testGroup('TestType', function() {
       }
     });
 
+    test('WrapsExternalData', function() {
+      let test = new TestType();
+      let buf = new Uint8Array(test.getExternalByteBuffer());
+      expectEq(buf.length, 5);
+      for (let i = 0; i < buf.length; i++) {
+        expectEq(buf[i], i + 1);
+      }
+      expectTrue(test.isExpectedByteBuffer(buf));
+      buf = null;
+      gc();
+    });
+
     test('CanUseSubViews', function() {
       const buffer1 = new Uint8Array([1, 2, 3, 4, 5]);
       const buffer2 = new Uint8Array([1, 2, 3, 4, 5, 6, 7, 8]);
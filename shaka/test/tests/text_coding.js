@@ -36,6 +36,27 @@ testGroup('TextCoders', () => {
           [0x46, 0xe2, 0x82, 0xac, 0x20, 0xf0, 0x90, 0x8d, 0x88]);
       expectEq(new TextDecoder().decode(data), 'F\u20ac \ud800\udf48');
     });
+
+    test('DecodesLargeAscii', () => {
+      const data = new Uint8Array(100000).fill(0x61);
+      const str = new TextDecoder().decode(data);
+      expectEq(str.length, 100000);
+      expectEq(str, 'a'.repeat(100000));
+    });
+
+    test('FatalThrowsForInvalidData', () => {
+      const decoder = new TextDecoder('utf-8', {fatal: true});
+      expectEq(decoder.fatal, true);
+      // Overlong encoding of '/'.
+      expectToThrow(() => decoder.decode(new Uint8Array([0x46, 0xc0, 0xaf])));
+      // Truncated sequence.
+      expectToThrow(() => decoder.decode(new Uint8Array([0x46, 0xe2, 0x82])));
+      // Surrogate.
+      expectToThrow(() => decoder.decode(new Uint8Array([0xed, 0xa0, 0x80])));
+
+      const data = new Uint8Array([0x46, 0xe2, 0x82, 0xac]);
+      expectEq(decoder.decode(data), 'F\u20ac');
+    });
   });
 
   testGroup('TextEncoder', () => {
@@ -0,0 +1,40 @@
+// Copyright 2020 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     https://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+testGroup('URL', function() {
+  test('ParsesComponents', function() {
+    const url = new URL('https://user@example.com:8080/a/b?x=1#frag');
+    expectEq(url.href, 'https://user@example.com:8080/a/b?x=1#frag');
+    expectEq(url.protocol, 'https:');
+    expectEq(url.host, 'example.com:8080');
+    expectEq(url.hostname, 'example.com');
+    expectEq(url.port, '8080');
+    expectEq(url.pathname, '/a/b');
+    expectEq(url.search, '?x=1');
+    expectEq(url.hash, '#frag');
+    expectEq(url.toString(), url.href);
+  });
+
+  test('ResolvesAgainstBase', function() {
+    expectEq(new URL('../g?y', 'http://a/b/c/d;p?q').href, 'http://a/b/g?y');
+    expectEq(new URL('//g', 'http://a/b/c/d;p?q').href, 'http://g');
+    expectEq(new URL('#s', 'http://a/b/c/d;p?q').href, 'http://a/b/c/d;p?q#s');
+  });
+
+  test('ThrowsForInvalidUrls', function() {
+    expectToThrow(() => new URL('foo/bar'), 'TypeError');
+    expectToThrow(() => new URL('foo', 'bar'), 'TypeError');
+    expectToThrow(() => new URL('1http://foo'), 'TypeError');
+  });
+});
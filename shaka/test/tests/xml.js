@@ -87,6 +87,141 @@ testGroup('XML', function() {
     expectEq(fifth.getAttributeNS('https://example.com/bar', 'attr'), null);
   });
 
+  test('CreatesAttrObjects', function() {
+    const text = '<top a="1" b="2" />';
+    let document = new DOMParser().parseFromString(text, 'text/xml');
+    let element = document.documentElement;
+
+    let attrs = element.attributes;
+    expectEq(attrs.length, 2);
+    expectEq(attrs[0].name, 'a');
+    expectEq(attrs[0].value, '1');
+    expectEq(attrs[1].name, 'b');
+    expectEq(attrs[1].value, '2');
+
+    element.setAttribute('a', '3');
+    expectEq(attrs[0].value, '3');
+    element.setAttribute('c', '4');
+    element.removeAttribute('b');
+
+    attrs = element.attributes;
+    expectEq(attrs.length, 2);
+    expectEq(attrs[0].name, 'a');
+    expectEq(attrs[1].name, 'c');
+    expectEq(attrs[1].value, '4');
+    expectEq(element.getAttribute('b'), null);
+  });
+
+  test('ParsesLargeDocuments', function() {
+    const count = 5000;
+    let segments = [];
+    for (let i = 0; i < count; i++) {
+      segments.push('<S t="' + (i * 2) + '" d="2" />\n');
+    }
+    const text = '<SegmentTimeline xmlns="urn:mpeg:dash:schema:mpd:2011">\n' +
+        segments.join('') + '</SegmentTimeline>';
+
+    let document = new DOMParser().parseFromString(text, 'text/xml');
+    let timeline = document.documentElement;
+    let elements = Array.prototype.filter.call(
+        timeline.childNodes, (node) => node instanceof Element);
+    expectEq(elements.length, count);
+    expectEq(elements[10].namespaceURI, 'urn:mpeg:dash:schema:mpd:2011');
+    expectEq(elements[10].getAttribute('t'), '20');
+    expectEq(elements[count - 1].getAttribute('d'), '2');
+  });
+
+  test('RejectsDuplicateAttributes', function() {
+    const text = '<top a="1" a="2" />';
+    expectToThrow(() => new DOMParser().parseFromString(text, 'text/xml'));
+  });
+
+  test('FindsElementsByTagName', function() {
+    const text = [
+      '<MPD>',
+      '<Period id="1"><AdaptationSet id="a">',
+      '<Representation id="r1" /><Representation id="r2" />',
+      '</AdaptationSet></Period>',
+      '<Period id="2"><AdaptationSet id="b">',
+      '<Representation id="r3" />',
+      '</AdaptationSet></Period>',
+      '</MPD>'
+    ].join('');
+
+    let document = new DOMParser().parseFromString(text, 'text/xml');
+    let ids = (elements) => elements.map((e) => e.getAttribute('id'));
+    expectEq(ids(document.getElementsByTagName('Representation')),
+             ['r1', 'r2', 'r3']);
+    expectEq(ids(document.getElementsByTagName('Period')), ['1', '2']);
+    expectEq(document.getElementsByTagName('Missing').length, 0);
+
+    let periods = document.getElementsByTagName('Period');
+    expectEq(ids(periods[0].getElementsByTagName('Representation')),
+             ['r1', 'r2']);
+    expectEq(ids(periods[1].getElementsByTagName('Representation')), ['r3']);
+    expectEq(periods[1].querySelector('AdaptationSet').getAttribute('id'), 'b');
+
+    // Changes to the tree are seen by later queries.
+    let adaptation = periods[0].getElementsByTagName('AdaptationSet')[0];
+    let moved = adaptation.removeChild(adaptation.firstChild);
+    expectEq(ids(document.getElementsByTagName('Representation')),
+             ['r2', 'r3']);
+    expectEq(moved.getElementsByTagName('Representation').length, 0);
+    periods[1].firstChild.appendChild(moved);
+    expectEq(ids(periods[1].getElementsByTagName('Representation')),
+             ['r3', 'r1']);
+  });
+
+  test('AppliesMpdPatches', function() {
+    const mpd = [
+      '<MPD id="live" type="dynamic" publishTime="2020-01-01T00:00:00Z">',
+      '<PatchLocation ttl="60">patch.mpp</PatchLocation>',
+      '<Period id="1"><AdaptationSet id="a">',
+      '<SegmentTemplate><SegmentTimeline><S t="0" d="2" /></SegmentTimeline>',
+      '</SegmentTemplate>',
+      '<Representation id="r1" />',
+      '</AdaptationSet></Period>',
+      '</MPD>'
+    ].join('');
+    const patch = [
+      '<Patch mpdId="live" originalPublishTime="2020-01-01T00:00:00Z" ',
+      '    publishTime="2020-01-01T00:00:02Z">',
+      '<add sel="/MPD/Period[@id=\'1\']/AdaptationSet[1]/SegmentTemplate/',
+      'SegmentTimeline"><S t="2" d="2" /></add>',
+      '<add sel="/MPD/Period[@id=\'1\']/AdaptationSet/Representation" ',
+      '    pos="before"><Representation id="r0" /></add>',
+      '<replace sel="/MPD/Period[@id=\'1\']/@id">2</replace>',
+      '<add sel="/MPD" type="@minimumUpdatePeriod">PT2S</add>',
+      '<remove sel="/MPD/@type" />',
+      '</Patch>'
+    ].join('');
+
+    let parser = new DOMParser();
+    let document = parser.parseFromString(mpd, 'text/xml');
+    let patched = parser.parseFromString(patch, 'text/xml');
+    expectSame(patched, document);
+
+    let root = document.documentElement;
+    expectEq(root.getAttribute('publishTime'), '2020-01-01T00:00:02Z');
+    expectEq(root.getAttribute('minimumUpdatePeriod'), 'PT2S');
+    expectEq(root.getAttribute('type'), null);
+    expectEq(document.getElementsByTagName('Period')[0].getAttribute('id'),
+             '2');
+    let ids = (elements) => elements.map((e) => e.getAttribute('id'));
+    expectEq(ids(document.getElementsByTagName('Representation')),
+             ['r0', 'r1']);
+    let times = document.getElementsByTagName('S').map(
+        (e) => e.getAttribute('t'));
+    expectEq(times, ['0', '2']);
+
+    // A patch for an older version can't be applied.
+    expectToThrow(() => parser.parseFromString(patch, 'text/xml'));
+
+    // Other documents are unaffected.
+    let other = parser.parseFromString('<Patch mpdId="x" />', 'text/xml');
+    expectNotSame(other, document);
+  });
+
   function expectElement(element, tag, localName, prefix, ns) {
     expectInstanceOf(element, Element);
     expectEq(element.tagName, tag);
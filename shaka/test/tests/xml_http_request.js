@@ -162,6 +162,62 @@ testGroup('XMLHttpRequest', function() {
     });
   });
 
+  // This is a benchmark of the time between calling send() and getting the
+  // first byte of the response.  This includes the time for the network thread
+  // to notice the new request.
+  xtest('TimeToFirstByteBenchmark', function() {
+    const count = 20;
+    let total = 0;
+
+    function sendOne(i) {
+      if (i == count) {
+        console.log('Average time-to-first-byte: ' + (total / count) + 'ms');
+        return Promise.resolve();
+      }
+
+      return new Promise((resolve) => {
+        let xhr = new XMLHttpRequest();
+        xhr.onabort = xhr.onerror = xhr.ontimeout = fail;
+
+        let start;
+        let gotFirstByte = false;
+        xhr.open('GET', 'https://httpbin.org/bytes/1024');
+        xhr.onreadystatechange = function() {
+          if (xhr.readyState == 3 && !gotFirstByte) {  // LOADING
+            gotFirstByte = true;
+            total += Date.now() - start;
+          }
+        };
+        xhr.onload = function() {
+          expectEq(xhr.status, 200);
+          resolve();
+        };
+        start = Date.now();
+        xhr.send();
+      }).then(() => sendOne(i + 1));
+    }
+
+    return sendOne(0);
+  });
+
+  testGroup('open', function() {
+    test('ResolvesRelativeUrls', function() {
+      // Relative URLs are resolved against the static data dir, like a page
+      // resolves them against its own URL; this doesn't send anything.
+      const xhr = new XMLHttpRequest();
+      xhr.open('GET', 'data/../manifest.mpd');
+      expectEq(xhr.readyState, 1);  // OPENED
+      xhr.open('GET', '/abs/manifest.mpd');
+      expectEq(xhr.readyState, 1);  // OPENED
+    });
+
+    test('ThrowsForInvalidUrls', function() {
+      const xhr = new XMLHttpRequest();
+      expectToThrow(() => xhr.open('GET', '1http://foo'), 'SyntaxError');
+      expectEq(xhr.readyState, 0);  // UNSENT
+    });
+  });
+
   testGroup('abort', function() {
     xtest('Synchronously', function() {
       return new Promise((resolve) => {
@@ -69,7 +69,7 @@ class CodeWriter(object):
   @contextlib.contextmanager
   def Namespace(self, name=None):
     """Returns a context manager that writes a namespace."""
-    self.Write('namespace %s {', name or '')
+    self.Write('namespace %s{', name + ' ' if name else '')
     self.Write()
     yield
     self.Write()
@@ -122,6 +122,24 @@ def _GetDefault(t):
   return type_map[t.name]
 
 
+def _NeedsTrace(t, other_types):
+  """Returns whether a field of the given IDL type can hold JavaScript objects.
+
+  Only other dictionaries hold JavaScript objects; the primitive types don't
+  need to be traced.
+  """
+  if t.name == 'record':
+    return _NeedsTrace(t.element_type[1], other_types)
+  elif t.name == 'sequence':
+    return _NeedsTrace(t.element_type, other_types)
+  return t.name in other_types
+
+
+def _GetPropertyNameVar(t, attr):
+  """Returns the name of the PropertyName variable for the given field."""
+  return 'k%s_%s' % (t.name, attr.name)
+
+
 def _GenerateJsHeader(results, f, name, public_header):
   """Generates the header for the JavaScript mapping type."""
   other_types = [t.name for t in results.types]
@@ -135,19 +153,29 @@ def _GenerateJsHeader(results, f, name, public_header):
   writer.Write('#include "shaka/optional.h"')
   writer.Write('#include "%s"', public_header)
   writer.Write('#include "src/mapping/convert_js.h"')
+  writer.Write('#include "src/mapping/js_wrappers.h"')
   writer.Write('#include "src/mapping/struct.h"')
+  writer.Write('#include "src/memory/heap_tracer.h"')
   writer.Write()
   with writer.Namespace('shaka'):
     with writer.Namespace('js'):
       for t in results.types:
+        # These don't use ADD_DICT_FIELD; the conversions are generated for
+        # each field instead (see _GenerateJsSource).
         with writer.Block('struct %s : Struct' % t.name, semicolon=True):
           writer.Write('DECLARE_STRUCT_SPECIAL_METHODS_MOVE_ONLY(%s);', t.name)
           writer.Write()
+          writer.Write('bool TryConvert(Handle<JsValue> value) override;')
+          writer.Write('ReturnVal<JsValue> ToJsValue() const override;')
+          writer.Write('void Trace(memory::HeapTracer* tracer) const override;')
+          writer.Write()
 
           for attr in t.members:
-            writer.Write('ADD_DICT_FIELD(%s, %s);',
+            default = _GetDefault(attr.type)
+            writer.Write('%s %s%s;',
+                         _MapCppType(attr.type, other_types, is_public=False),
                          attr.name,
-                         _MapCppType(attr.type, other_types, is_public=False))
+                         ' = ' + default if default else '')
         writer.Write()
     writer.Write()
 
@@ -171,16 +199,60 @@ def _GenerateJsHeader(results, f, name, public_header):
 
 
 def _GenerateJsSource(results, f, header):
-  """Generates the source file for the JavaScript mapping type."""
+  """Generates the source file for the JavaScript mapping type.
+
+  Rather than the generic Struct field converters, this generates the
+  conversion of each field directly, using PropertyName objects so the
+  property names are only converted to JavaScript strings once.
+  """
+  other_types = [t.name for t in results.types]
   writer = embed_utils.CodeWriter(f)
   writer.Write('#include "%s"', header)
   writer.Write()
   with writer.Namespace('shaka'):
     with writer.Namespace('js'):
+      with writer.Namespace():
+        for t in results.types:
+          for attr in t.members:
+            writer.Write('const PropertyName %s("%s");',
+                         _GetPropertyNameVar(t, attr), attr.name)
+      writer.Write()
+
       for t in results.types:
         writer.Write('DEFINE_STRUCT_SPECIAL_METHODS_MOVE_ONLY(%s);', t.name)
         writer.Write()
 
+        with writer.Block(
+            'bool %s::TryConvert(Handle<JsValue> value)' % t.name):
+          with writer.Block('if (!Struct::TryConvert(value))'):
+            writer.Write('return false;')
+          writer.Write()
+          writer.Write('LocalVar<JsObject> object = '
+                       'UnsafeJsCast<JsObject>(value);')
+          for attr in t.members:
+            writer.Write('(void)shaka::FromJsValue(GetMemberRaw(object, %s), '
+                         '&%s);', _GetPropertyNameVar(t, attr), attr.name)
+          writer.Write('return true;')
+        writer.Write()
+
+        with writer.Block('ReturnVal<JsValue> %s::ToJsValue() const' % t.name):
+          writer.Write('LocalVar<JsValue> ret = Struct::ToJsValue();')
+          writer.Write('LocalVar<JsObject> object = '
+                       'UnsafeJsCast<JsObject>(ret);')
+          for attr in t.members:
+            writer.Write('SetMemberRaw(object, %s, shaka::ToJsValue(%s));',
+                         _GetPropertyNameVar(t, attr), attr.name)
+          writer.Write('return ret;')
+        writer.Write()
+
+        with writer.Block(
+            'void %s::Trace(memory::HeapTracer* tracer) const' % t.name):
+          writer.Write('Struct::Trace(tracer);')
+          for attr in t.members:
+            if _NeedsTrace(attr.type, other_types):
+              writer.Write('tracer->Trace(&%s);', attr.name)
+        writer.Write()
+
 
 def _GeneratePublicHeader(results, f, name):
   """Generates the header for the public C++ type."""